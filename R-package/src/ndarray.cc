@@ -121,6 +121,50 @@ inline void RowToColMajor(const mx_float *in_data,
   }
 }
 
+/*!
+ * \brief copy the values of an NDArray into R memory of size values.
+ *  R arrays are column major with the shape reversed, the same layout as the
+ *  row major NDArray, so a float32 CPU NDArray is converted in one pass from
+ *  its own memory, the others go through a float buffer.
+ */
+inline void CopyToR(NDArrayHandle handle, size_t size, double *out) {
+  // type flag of float32
+  const int kFloat32 = 0;
+  Context ctx;
+  int dtype;
+  MX_CALL(MXNDArrayGetContext(handle, &ctx.dev_type, &ctx.dev_id));
+  MX_CALL(MXNDArrayGetDType(handle, &dtype));
+  if (ctx.dev_type == Context::kCPU && dtype == kFloat32) {
+    void *data;
+    MX_CALL(MXNDArrayWaitToRead(handle));
+    MX_CALL(MXNDArrayGetRawData(handle, &data));
+    const mx_float *in = static_cast<const mx_float*>(data);
+    std::copy(in, in + size, out);
+  } else {
+    std::vector<mx_float> temp(size);
+    MX_CALL(MXNDArraySyncCopyToCPU(handle, dmlc::BeginPtr(temp), size));
+    std::copy(temp.begin(), temp.end(), out);
+  }
+}
+
+/*! \brief copy size values of R memory into an NDArray, the reverse of CopyToR */
+inline void CopyFromR(const double *in, size_t size, NDArrayHandle handle) {
+  const int kFloat32 = 0;
+  Context ctx;
+  int dtype;
+  MX_CALL(MXNDArrayGetContext(handle, &ctx.dev_type, &ctx.dev_id));
+  MX_CALL(MXNDArrayGetDType(handle, &dtype));
+  if (ctx.dev_type == Context::kCPU && dtype == kFloat32) {
+    void *data;
+    MX_CALL(MXNDArrayWaitToWrite(handle));
+    MX_CALL(MXNDArrayGetRawData(handle, &data));
+    std::copy(in, in + size, static_cast<mx_float*>(data));
+  } else {
+    std::vector<mx_float> temp(in, in + size);
+    MX_CALL(MXNDArraySyncCopyFromCPU(handle, dmlc::BeginPtr(temp), size));
+  }
+}
+
 void NDArrayPacker::Push(const NDArray::RObjectType& nd) {
   NDArray arr(nd);
   Rcpp::Dimension rshape = arr.dim();
@@ -205,11 +249,8 @@ NDArray NDArray::Slice(mx_uint begin, mx_uint end) const {
 
 Rcpp::NumericVector NDArray::AsNumericVector() const {
   Rcpp::Dimension rshape = this->dim();
-  std::vector<mx_float> temp(rshape.prod());
-  MX_CALL(MXNDArraySyncCopyToCPU(
-      ptr_->handle, dmlc::BeginPtr(temp), temp.size()));
   Rcpp::NumericVector ret(rshape);
-  std::copy(temp.begin(), temp.end(), ret.begin());
+  CopyToR(ptr_->handle, ret.size(), ret.begin());
   return ret;
 }
 
@@ -305,11 +346,7 @@ NDArray::RObjectType NDArray::Array(
   Rcpp::RObject dim = rdata.attr("dim");
   Rcpp::Dimension rshape(dim);
   RObjectType ret = NDArray::Empty(rshape, ctx);
-  std::vector<mx_float> temp(rdata.size());
-  std::copy(rdata.begin(), rdata.end(), temp.begin());
-  MX_CALL(MXNDArraySyncCopyFromCPU(
-      NDArray(ret)->handle,
-      dmlc::BeginPtr(temp), rdata.size()));
+  CopyFromR(rdata.begin(), rdata.size(), NDArray(ret)->handle);
   return ret;
 }
 
@@ -21,14 +21,17 @@
 
 #define MXNET_USE_OPENCV 	0
 #define MXNET_PREDICT_ONLY 	1
+#if !defined(_OPENMP)
 #define DISABLE_OPENMP 1
+#endif
 
 #include "src/ndarray/ndarray_function.cc"
 #include "src/ndarray/ndarray.cc"
 #include "src/engine/engine.cc"
-#include "src/engine/naive_engine.cc"
+#include "src/engine/inline_engine.cc"
 #include "src/symbol/graph_executor.cc"
 #include "src/symbol/graph_memory_allocator.cc"
+#include "src/symbol/inference_optimizer.cc"
 #include "src/symbol/static_graph.cc"
 #include "src/symbol/symbol.cc"
 #include "src/operator/operator.cc"
@@ -46,6 +49,7 @@
 #include "src/operator/leaky_relu.cc"
 #include "src/operator/lrn.cc"
 #include "src/operator/pooling.cc"
+#include "src/operator/quantization.cc"
 #include "src/operator/regression_output.cc"
 #include "src/operator/reshape.cc"
 #include "src/operator/slice_channel.cc"
@@ -114,6 +114,21 @@ class Predictor(object):
     def __del__(self):
         _check_call(_LIB.MXPredFree(self.handle))
 
+    def share(self):
+        """Create a predictor of the same network which shares the parameters
+        of this one, to predict concurrently from another thread.
+
+        Returns
+        -------
+        out : Predictor
+            The new predictor.
+        """
+        handle = PredictorHandle()
+        _check_call(_LIB.MXPredCreateShared(self.handle, ctypes.byref(handle)))
+        out = Predictor.__new__(Predictor)
+        out.handle = handle
+        return out
+
     def forward(self, **kwargs):
         """Perform forward to get the output.
 
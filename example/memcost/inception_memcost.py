@@ -87,4 +87,4 @@ texec = softmax.simple_bind(ctx=mx.cpu(),
                             data=(batch_size, 3, 224, 224),
                             grad_req=grad_req)
 # We extract the memory cost from the execution plan
-print(texec.debug_str().split('\n')[-3])
+print([l for l in texec.debug_str().split('\n') if 'MB allocated' in l][0])
@@ -232,9 +232,11 @@ def get_vgg_rpn_test(num_classes=21, num_anchors=9):
         data=rpn_cls_score_reshape, mode="channel", name="rpn_cls_prob")
     rpn_cls_prob_reshape = mx.symbol.Reshape(
         data=rpn_cls_prob, shape=(0, 2 * num_anchors, -1, 0), name='rpn_cls_prob_reshape')
-    group = mx.symbol.Custom(
+    group = mx.symbol.Proposal(
         cls_prob=rpn_cls_prob_reshape, bbox_pred=rpn_bbox_pred, im_info=im_info, name='rois',
-        op_type='proposal', feat_stride=16, scales=(8, 16, 32), ratios=(0.5, 1, 2), output_score=True)
+        feature_stride=16, scales=(8, 16, 32), ratios=(0.5, 1, 2), output_score=True,
+        rpn_pre_nms_top_n=config.TEST.RPN_PRE_NMS_TOP_N, rpn_post_nms_top_n=config.TEST.RPN_POST_NMS_TOP_N,
+        threshold=config.TEST.RPN_NMS_THRESH, rpn_min_size=config.TEST.RPN_MIN_SIZE)
     # rois = group[0]
     # score = group[1]
 
@@ -270,9 +272,11 @@ def get_vgg_test(num_classes=21, num_anchors=9):
         data=rpn_cls_score_reshape, mode="channel", name="rpn_cls_prob")
     rpn_cls_prob_reshape = mx.symbol.Reshape(
         data=rpn_cls_prob, shape=(0, 2 * num_anchors, -1, 0), name='rpn_cls_prob_reshape')
-    rois = mx.symbol.Custom(
+    rois = mx.symbol.Proposal(
         cls_prob=rpn_cls_prob_reshape, bbox_pred=rpn_bbox_pred, im_info=im_info, name='rois',
-        op_type='proposal', feat_stride=16, scales=(8, 16, 32), ratios=(0.5, 1, 2))
+        feature_stride=16, scales=(8, 16, 32), ratios=(0.5, 1, 2),
+        rpn_pre_nms_top_n=config.TEST.RPN_PRE_NMS_TOP_N, rpn_post_nms_top_n=config.TEST.RPN_POST_NMS_TOP_N,
+        threshold=config.TEST.RPN_NMS_THRESH, rpn_min_size=config.TEST.RPN_MIN_SIZE)
 
     # Fast R-CNN
     pool5 = mx.symbol.ROIPooling(
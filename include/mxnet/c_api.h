@@ -34,6 +34,8 @@ typedef float mx_float;
 typedef void *NDArrayHandle;
 /*! \brief handle to a mxnet narray function that changes NDArray */
 typedef const void *FunctionHandle;
+/*! \brief handle to the keyword parameters of a function, reused by invocations */
+typedef void *FunctionParamsHandle;
 /*! \brief handle to a function that takes param and creates symbol */
 typedef void *AtomicSymbolCreator;
 /*! \brief handle to a symbol that can be bind as operator */
@@ -56,10 +58,17 @@ typedef void *RtcHandle;
 typedef void *OptimizerCreator;
 /*! \brief handle to Optimizer*/
 typedef void *OptimizerHandle;
+/*! \brief handle to a graph of engine operations*/
+typedef void *EngineGraphHandle;
+/*! \brief handle to a shared memory region*/
+typedef void *SharedMemHandle;
 
 MXNET_EXTERN_C typedef void (*ExecutorMonitorCallback)(const char*,
                                                        NDArrayHandle,
                                                        void *);
+MXNET_EXTERN_C typedef void (*ExecutorGradReadyCallback)(mx_uint, void *);
+/*! \brief releases the external data of a NDArray, called with the data and its argument */
+MXNET_EXTERN_C typedef void (*NDArrayDeleter)(void *, void *);
 
 MXNET_EXTERN_C {
 struct NativeOpInfo {
@@ -160,6 +169,153 @@ MXNET_DLL int MXRandomSeed(int seed);
  * \return 0 when success, -1 when failure happens.
  */
 MXNET_DLL int MXNotifyShutdown();
+/*!
+ * \brief Get memory pool statistics of a device.
+ * \param dev_type device type of the context.
+ * \param dev_id device id of the context.
+ * \param used bytes currently allocated by users.
+ * \param cached bytes held by the memory pool but currently free.
+ * \param wasted bytes lost to size class rounding of allocated blocks.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXStorageGetStats(int dev_type,
+                                int dev_id,
+                                size_t *used,
+                                size_t *cached,
+                                size_t *wasted);
+/*!
+ * \brief Get statistics of the memory arena of a device, reserved up front when
+ *  MXNET_GPU_MEM_ARENA_FRACTION is set. The arena is fragmented when largest_free
+ *  is much smaller than free.
+ * \param dev_type device type of the context.
+ * \param dev_id device id of the context.
+ * \param capacity bytes reserved, 0 when the device has no arena.
+ * \param free bytes free in the arena.
+ * \param largest_free bytes of the largest free block of the arena.
+ * \param overflow bytes allocated outside of the arena once it was full.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXStorageGetArenaStats(int dev_type,
+                                     int dev_id,
+                                     size_t *capacity,
+                                     size_t *free,
+                                     size_t *largest_free,
+                                     size_t *overflow);
+/*!
+ * \brief Pin existing host memory, such as a numpy array, so that the copies
+ *  from and to the gpu use it directly. It must be unpinned before it is freed.
+ * \param ptr pointer to the memory.
+ * \param size size of the memory in bytes.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXStorageRegisterHostMemory(void *ptr, size_t size);
+/*!
+ * \brief Unpin host memory pinned by MXStorageRegisterHostMemory.
+ * \param ptr pointer to the memory.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXStorageUnregisterHostMemory(void *ptr);
+/*!
+ * \brief Set the origin of the allocations of the calling thread, such as "weights",
+ *  reported by the allocation trace. It is kept by the arrays created with delayed
+ *  allocation, until they are allocated.
+ * \param origin the origin, NULL for none.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXStorageSetAllocOrigin(const char *origin);
+/*!
+ * \brief Write the allocation trace as JSON, recorded when MXNET_STORAGE_TRACE is set.
+ * \param fname the file name.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXStorageDumpTrace(const char *fname);
+/*!
+ * \brief Get the usage of the temp space of a device.
+ * \param dev_type device type of the context.
+ * \param dev_id device id of the context.
+ * \param bytes bytes held by the temp space.
+ * \param num_bound number of copies of the temp space bound to operators.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXResourceGetTempSpaceStats(int dev_type,
+                                          int dev_id,
+                                          size_t *bytes,
+                                          int *num_bound);
+/*!
+ * \brief Free the temp space of a device once the operators using it complete.
+ * \param dev_type device type of the context.
+ * \param dev_id device id of the context.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXResourceReleaseTempSpace(int dev_type, int dev_id);
+/*!
+ * \brief Set up configuration of profiler
+ * \param mode indicate the working mode of profiler,
+ *  record only symbolic operator when mode == 0,
+ *  record all operator when mode == 1
+ * \param filename where to save trace file
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXSetProfilerConfig(int mode, const char* filename);
+/*!
+ * \brief Set up state of profiler
+ * \param state indicate the working state of profiler,
+ *  profiler not running when state == 0,
+ *  profiler running when state == 1
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXSetProfilerState(int state);
+/*!
+ * \brief Save profile and stop profiler.
+ *  The trace file can be loaded in chrome://tracing.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXDumpProfile();
+/*!
+ * \brief Set the bulk size of synchronous imperative operations
+ *  pushed by the calling thread, 0 disables bulk execution.
+ * \param bulk_size the new bulk size.
+ * \param prev_bulk_size the previous bulk size.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXEngineSetBulkSize(int bulk_size, int* prev_bulk_size);
+/*!
+ * \brief Get the runtime counters of the engine, such as the operations
+ *  pushed, the queue lengths and the busy time of the workers.
+ *  The returned arrays are valid until the next call in the same thread.
+ * \param out_size number of counters.
+ * \param out_names the names of the counters.
+ * \param out_values the values of the counters.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXEngineGetStats(mx_uint *out_size,
+                               const char ***out_names,
+                               uint64_t **out_values);
+/*!
+ * \brief Start capturing the operations pushed by the calling thread
+ *  into a graph, they are not executed until the graph is pushed.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXEngineBeginCapture();
+/*!
+ * \brief Stop the capture of the calling thread.
+ * \param out the graph of the captured operations.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXEngineEndCapture(EngineGraphHandle *out);
+/*!
+ * \brief Push all the operations of a captured graph.
+ * \param handle the graph.
+ * \param priority the priority of the operations.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXEnginePushGraph(EngineGraphHandle handle, int priority);
+/*!
+ * \brief Free a captured graph after its pushed replays complete.
+ * \param handle the graph.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXEngineFreeGraph(EngineGraphHandle handle);
 //-------------------------------------
 // Part 1: NDArray creation and deletion
 //-------------------------------------
@@ -208,6 +364,92 @@ MXNET_DLL int MXNDArrayCreateEx(const mx_uint *shape,
                               int delay_alloc,
                               int dtype,
                               NDArrayHandle *out);
+/*!
+ * \brief create a CPU NDArray over external data without copying it, e.g. the
+ *  buffer of a numpy array. The data is read and written in place until the NDArray
+ *  and all its copies are freed and their pending operations are finished, then
+ *  deleter is called.
+ * \param data the head of the contiguous data, aligned for dtype
+ * \param shape the pointer to the shape
+ * \param ndim the dimension of the shape
+ * \param dtype data type of the data
+ * \param deleter called with data and deleter_arg to release the data, can be NULL
+ * \param deleter_arg the argument of deleter
+ * \param out the returning handle
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayCreateFromCPUData(void *data,
+                                         const mx_uint *shape,
+                                         mx_uint ndim,
+                                         int dtype,
+                                         NDArrayDeleter deleter,
+                                         void *deleter_arg,
+                                         NDArrayHandle *out);
+/*!
+ * \brief create or open a named shared memory region of the host, for processes
+ *  handing arrays to each other without copy. The creator removes the name when
+ *  freed, the memory is released once no process nor NDArray maps it.
+ * \param name the name, starting with a slash
+ * \param bytes the size
+ * \param create whether to create the region, otherwise it is opened
+ * \param out the returning handle
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXSharedMemCreate(const char *name,
+                                size_t bytes,
+                                int create,
+                                SharedMemHandle *out);
+/*!
+ * \brief get the memory of a shared memory region, to write it from the host
+ * \param handle the handle to the region
+ * \param out_data the head of the region
+ * \param out_bytes the size of the region
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXSharedMemGetData(SharedMemHandle handle,
+                                 void **out_data,
+                                 size_t *out_bytes);
+/*!
+ * \brief create a CPU NDArray over a part of a shared memory region without copying
+ *  it, which keeps the region mapped until the NDArray and all its copies are freed
+ * \param handle the handle to the region
+ * \param offset the offset in bytes of the data, aligned for dtype
+ * \param shape the pointer to the shape
+ * \param ndim the dimension of the shape
+ * \param dtype data type of the data
+ * \param out the returning handle
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXSharedMemGetNDArray(SharedMemHandle handle,
+                                    size_t offset,
+                                    const mx_uint *shape,
+                                    mx_uint ndim,
+                                    int dtype,
+                                    NDArrayHandle *out);
+/*!
+ * \brief free a handle to a shared memory region
+ * \param handle the handle to the region
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXSharedMemFree(SharedMemHandle handle);
+/*!
+ * \brief evaluate an elementwise arithmetic expression of float32 NDArrays of the
+ *  same shape in one pass, without temporary arrays
+ * \param program the expression in postfix, space separated tokens of iK for the
+ *  K-th input, sK for the K-th scalar, and + - * / for the arithmetic
+ * \param num_inputs number of inputs
+ * \param inputs the contiguous inputs
+ * \param num_scalars number of scalars
+ * \param scalars the scalars
+ * \param out the target NDArray, which can also be one of the inputs
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayEvalFused(const char *program,
+                                 mx_uint num_inputs,
+                                 NDArrayHandle *inputs,
+                                 mx_uint num_scalars,
+                                 const mx_float *scalars,
+                                 NDArrayHandle out);
 /*!
  * \brief create a NDArray handle that is loaded from raw bytes.
  * \param buf the head of the raw bytes
@@ -240,6 +482,34 @@ MXNET_DLL int MXNDArraySave(const char* fname,
                             mx_uint num_args,
                             NDArrayHandle* args,
                             const char** keys);
+/*!
+ * \brief Save list of narray into a local file whose data are aligned, so
+ *  that it can be memory mapped by MXPredCreateFromFile. It is loaded by
+ *  MXNDArrayLoad as well.
+ * \param fname name of the file.
+ * \param num_args number of arguments to save.
+ * \param args the array of NDArrayHandles to be saved.
+ * \param keys the name of the NDArray, optional, can be NULL
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArraySaveAligned(const char* fname,
+                                   mx_uint num_args,
+                                   NDArrayHandle* args,
+                                   const char** keys);
+/*!
+ * \brief Save list of narray into a file in the aligned format in the
+ *  background. It returns once the copies of the arrays are scheduled, the
+ *  arrays can then be modified, and MXNDArrayWaitAll waits for the file.
+ * \param fname name of the file.
+ * \param num_args number of arguments to save.
+ * \param args the array of NDArrayHandles to be saved.
+ * \param keys the name of the NDArray, optional, can be NULL
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArraySaveAsync(const char* fname,
+                                 mx_uint num_args,
+                                 NDArrayHandle* args,
+                                 const char** keys);
 /*!
  * \brief Load list of narray from the file.
  * \param fname name of the file.
@@ -320,6 +590,29 @@ MXNET_DLL int MXNDArraySlice(NDArrayHandle handle,
                              mx_uint slice_begin,
                              mx_uint slice_end,
                              NDArrayHandle *out);
+/*!
+ * \brief Slice the NDArray along any axis without copy. The result is a
+ *  strided view unless the dimensions before axis are 1, which needs a
+ *  single index (slice_end == slice_begin + 1) or the last axis.
+ * \param handle the handle to the narraya
+ * \param axis The axis to slice
+ * \param slice_begin The beginning index of slice
+ * \param slice_end The ending index of slice
+ * \param out The NDArrayHandle of sliced NDArray
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArraySliceAxis(NDArrayHandle handle,
+                                 mx_uint axis,
+                                 mx_uint slice_begin,
+                                 mx_uint slice_end,
+                                 NDArrayHandle *out);
+/*!
+ * \brief get whether the NDArray is contiguous, not a strided view.
+ * \param handle the handle to the narray
+ * \param out 1 if it is contiguous, 0 otherwise
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayIsContiguous(NDArrayHandle handle, int *out);
 /*!
  * \brief Index the NDArray along axis 0.
  * \param handle the handle to the narraya
@@ -360,6 +653,16 @@ MXNET_DLL int MXNDArrayGetShape(NDArrayHandle handle,
  */
 MXNET_DLL int MXNDArrayGetData(NDArrayHandle handle,
                                mx_float **out_pdata);
+/*!
+ * \brief get the head of the data of a contiguous CPU NDArray of any data type.
+ *  The caller waits for the pending operations with MXNDArrayWaitToRead or
+ *  MXNDArrayWaitToWrite before accessing it.
+ * \param handle the handle to the narray
+ * \param out_pdata pointer holder to get pointer of data, NULL for an empty NDArray
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayGetRawData(NDArrayHandle handle,
+                                  void **out_pdata);
 /*!
  * \brief get the type of the data in NDArray
  * \param handle the handle to the narray
@@ -468,6 +771,47 @@ MXNET_DLL int MXFuncInvokeEx(FunctionHandle fun,
                              int num_params,
                              char **param_keys,
                              char **param_vals);
+/*!
+ * \brief create the keyword parameters of a function, which are converted once and
+ *  reused by the invocations of MXFuncInvokeBatch
+ * \param fun the function
+ * \param num_params number of keyword parameters
+ * \param param_keys keys for keyword parameters
+ * \param param_vals values for keyword parameters
+ * \param out the returning handle
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXFuncCreateParams(FunctionHandle fun,
+                                 int num_params,
+                                 const char **param_keys,
+                                 const char **param_vals,
+                                 FunctionParamsHandle *out);
+/*!
+ * \brief free the keyword parameters of a function
+ * \param handle the handle to be freed
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXFuncFreeParams(FunctionParamsHandle handle);
+/*!
+ * \brief invoke a list of functions in one call, which are pushed to the engine
+ *  as a bulk. The arguments of the calls are concatenated in order, each call
+ *  takes as many of them as given by MXFuncDescribe.
+ * \param num_calls number of calls
+ * \param funs the function of each call
+ * \param use_vars the normal arguments of the calls
+ * \param scalar_args the scalar arguments of the calls
+ * \param mutate_vars the mutate arguments of the calls
+ * \param params the keyword parameters of each call created by MXFuncCreateParams
+ *  for the same function, NULL for none, or NULL if no call has them
+ * \return 0 when success, -1 when failure happens
+ * \sa MXFuncDescribe
+ */
+MXNET_DLL int MXFuncInvokeBatch(mx_uint num_calls,
+                                FunctionHandle *funs,
+                                NDArrayHandle *use_vars,
+                                mx_float *scalar_args,
+                                NDArrayHandle *mutate_vars,
+                                FunctionParamsHandle *params);
 //--------------------------------------------
 // Part 3: symbolic configuration generation
 //--------------------------------------------
@@ -545,7 +889,7 @@ MXNET_DLL int MXSymbolCreateGroup(mx_uint num_symbols,
                                   SymbolHandle *symbols,
                                   SymbolHandle *out);
 /*!
- * \brief Load a symbol from a json file.
+ * \brief Load a symbol from a json file or a file saved by MXSymbolSaveToBinaryFile.
  * \param fname the file name.
  * \param out the output symbol.
  * \return 0 when success, -1 when failure happens
@@ -565,6 +909,15 @@ MXNET_DLL int MXSymbolCreateFromJSON(const char *json, SymbolHandle *out);
  * \return 0 when success, -1 when failure happens
  */
 MXNET_DLL int MXSymbolSaveToFile(SymbolHandle symbol, const char *fname);
+/*!
+ * \brief Save a symbol into a binary file, which loads much faster than json.
+ *  The distinct operators are saved once, so an unrolled network parses each of them once.
+ *  Use json to exchange symbols between versions and language bindings.
+ * \param symbol the input symbol.
+ * \param fname the file name.
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXSymbolSaveToBinaryFile(SymbolHandle symbol, const char *fname);
 /*!
  * \brief Save a symbol into a json string
  * \param symbol the input symbol.
@@ -855,6 +1208,35 @@ MXNET_DLL int MXExecutorFree(ExecutorHandle handle);
  * \return 0 when success, -1 when failure happens
  */
 MXNET_DLL int MXExecutorPrint(ExecutorHandle handle, const char **out_str);
+/*!
+ * \brief Get the estimated cost of each node of the executor, and their totals.
+ * \param handle the executor.
+ * \param out_json pointer to hold the cost as json.
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorPrintCost(ExecutorHandle handle, const char **out_json);
+/*!
+ * \brief Enable or disable the timing of each node of the executor.
+ * \param handle the executor.
+ * \param enable whether to time the nodes.
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorSetProfiling(ExecutorHandle handle, int enable);
+/*!
+ * \brief Get the times of each node of the executor, summed over the iterations
+ *  since the profiling was enabled.
+ * \param handle the executor.
+ * \param reset whether to clear the times.
+ * \param out_json pointer to hold the times as json.
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorPrintProfile(ExecutorHandle handle, int reset, const char **out_json);
+/*!
+ * \brief Do the lazy work of the first forward now, see Executor::Warmup.
+ * \param handle the executor.
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorWarmup(ExecutorHandle handle);
 /*!
  * \brief Executor forward method
  *
@@ -985,12 +1367,68 @@ MXNET_DLL int MXExecutorBindEX(SymbolHandle symbol_handle,
                                NDArrayHandle *aux_states,
                                ExecutorHandle shared_exec,
                                ExecutorHandle *out);
+/*!
+ * \brief Generate Executor from symbol with a memory budget,
+ *  the same as MXExecutorBindEX, but forward nodes are recomputed in
+ *  backward so that the planned memory of each context fits the budget.
+ *
+ * \param mem_budget_mb memory budget of each context in MB, 0 means no budget.
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorBindWithBudget(SymbolHandle symbol_handle,
+                                       int dev_type,
+                                       int dev_id,
+                                       mx_uint num_map_keys,
+                                       const char** map_keys,
+                                       const int* map_dev_types,
+                                       const int* map_dev_ids,
+                                       mx_uint len,
+                                       NDArrayHandle *in_args,
+                                       NDArrayHandle *arg_grad_store,
+                                       mx_uint *grad_req_type,
+                                       mx_uint aux_states_len,
+                                       NDArrayHandle *aux_states,
+                                       ExecutorHandle shared_exec,
+                                       mx_uint mem_budget_mb,
+                                       ExecutorHandle *out);
+/*!
+ * \brief Create an executor of the same graph with new shapes of the arguments,
+ *  which shares memory with the given executor. The graph is not rebuilt.
+ *
+ * \param handle the executor to reshape
+ * \param len length of in_args and arg_grad_store
+ * \param in_args in args array, of the new shapes
+ * \param arg_grad_store arg grads handle array, can be NULL where no gradient is requested
+ * \param aux_states_len length of aux_states
+ * \param aux_states auxiliary states array
+ * \param out output executor handle
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorReshape(ExecutorHandle handle,
+                                mx_uint len,
+                                NDArrayHandle *in_args,
+                                NDArrayHandle *arg_grad_store,
+                                mx_uint aux_states_len,
+                                NDArrayHandle *aux_states,
+                                ExecutorHandle *out);
 /*!
  * \brief set a call back to notify the completion of operation
  */
 MXNET_DLL int MXExecutorSetMonitorCallback(ExecutorHandle handle,
                                            ExecutorMonitorCallback callback,
                                            void* callback_handle);
+/*!
+ * \brief set a call back notified during backward with the index of each argument
+ *  whose gradient operator has been pushed, operations pushed in the callback
+ *  that read the gradient are scheduled after it.
+ * \param handle the executor
+ * \param callback the callback, takes the argument index and callback_handle
+ * \param callback_handle the handle passed to the callback
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorSetGradReadyCallback(ExecutorHandle handle,
+                                             ExecutorGradReadyCallback callback,
+                                             void* callback_handle);
 //--------------------------------------------
 // Part 5: IO Interface
 //--------------------------------------------
@@ -1055,6 +1493,19 @@ MXNET_DLL int MXDataIterNext(DataIterHandle handle,
  * \return 0 when success, -1 when failure happens
  */
 MXNET_DLL int MXDataIterBeforeFirst(DataIterHandle handle);
+/*!
+ * \brief Call iterator.Reset with new values of some of its parameters,
+ *  such as the data shape between the epochs of a progressive resizing
+ * \param handle the handle to iterator
+ * \param num_param number of parameter
+ * \param keys parameter keys
+ * \param vals parameter values
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXDataIterReset(DataIterHandle handle,
+                              mx_uint num_param,
+                              const char **keys,
+                              const char **vals);
 
 /*!
  * \brief Get the handle to the NDArray of underlying data
@@ -1064,6 +1515,17 @@ MXNET_DLL int MXDataIterBeforeFirst(DataIterHandle handle);
  */
 MXNET_DLL int MXDataIterGetData(DataIterHandle handle,
                                 NDArrayHandle *out);
+/*!
+ * \brief Get the handles to the NDArrays of the batch after the data and the label,
+ *  the column indices and the row pointers of a batch in compressed sparse row format
+ * \param handle the handle pointer to the data iterator
+ * \param out_size the number of arrays
+ * \param out handles to the arrays
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXDataIterGetExtraData(DataIterHandle handle,
+                                     mx_uint *out_size,
+                                     NDArrayHandle **out);
 /*!
  * \brief Get the image index by array.
  * \param handle the handle pointer to the data iterator
@@ -1082,6 +1544,21 @@ MXNET_DLL int MXDataIterGetIndex(DataIterHandle handle,
  */
 MXNET_DLL int MXDataIterGetPadNum(DataIterHandle handle,
                                   int *pad);
+/*!
+ * \brief Get the bucket key of the current data batch
+ * \param handle the handle pointer to the data iterator
+ * \param bucket_key the bucket key, -1 for an iterator without buckets
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXDataIterGetBucketKey(DataIterHandle handle,
+                                     int *bucket_key);
+/*!
+ * \brief Get the counters of the stages of the io pipelines, summed over all the iterators.
+ * \param reset whether to reset the counters after
+ * \param out_json the counters as json, valid until the next call in the thread
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXDataIterGetStats(int reset, const char **out_json);
 
 /*!
  * \brief Get the handle to the NDArray of underlying label
@@ -1158,6 +1635,38 @@ MXNET_DLL int MXKVStorePull(KVStoreHandle handle,
                             const int* keys,
                             NDArrayHandle* vals,
                             int priority);
+/*!
+ * \brief Push a list of row sparse (key, value) pairs to kvstore
+ * \param handle handle to the kvstore
+ * \param num the number of key-value pairs
+ * \param keys the list of keys
+ * \param row_ids the row indices of each value, on cpu
+ * \param vals the list of the pushed rows
+ * \param priority the priority of the action
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStorePushRowSparse(KVStoreHandle handle,
+                                     mx_uint num,
+                                     const int* keys,
+                                     NDArrayHandle* row_ids,
+                                     NDArrayHandle* vals,
+                                     int priority);
+/*!
+ * \brief pull some rows of a list of keys from the kvstore
+ * \param handle handle to the kvstore
+ * \param num the number of key-value pairs
+ * \param keys the list of keys
+ * \param row_ids the row indices to pull, on cpu
+ * \param vals the buffers of the pulled rows
+ * \param priority the priority of the action
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStorePullRowSparse(KVStoreHandle handle,
+                                     mx_uint num,
+                                     const int* keys,
+                                     NDArrayHandle* row_ids,
+                                     NDArrayHandle* vals,
+                                     int priority);
 /*!
  * \brief user-defined updater for the kvstore
  * It's this updater's responsibility to delete \a recv and \a local
@@ -1188,6 +1697,18 @@ MXNET_DLL int MXKVStoreSetUpdater(KVStoreHandle handle,
  */
 MXNET_DLL int MXKVStoreGetType(KVStoreHandle handle,
                                const char** type);
+/*!
+ * \brief get the counters of the communication of a kvstore, such as the bytes
+ *  sent to each server, the push, pull and wait times of this worker, and the
+ *  arrival skew of the workers and the update times of each server
+ * \param handle handle to the KVStore
+ * \param reset whether to reset the counters after
+ * \param out_json the counters as json
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStoreGetStats(KVStoreHandle handle,
+                                int reset,
+                                const char** out_json);
 //--------------------------------------------
 // Part 6: advanced KVStore for multi-machines
 //--------------------------------------------
@@ -1267,6 +1788,47 @@ MXNET_DLL int MXKVStoreRunServer(KVStoreHandle handle,
                                  MXKVStoreServerController controller,
                                  void *controller_handle);
 
+/*!
+ * \brief set the compression of gradients pushed by the distributed kvstore
+ * \param handle handle to the KVStore
+ * \param num_params number of parameters
+ * \param keys keys of the parameters, "type" and "threshold"
+ * \param vals values of the parameters
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStoreSetGradientCompression(KVStoreHandle handle,
+                                              mx_uint num_params,
+                                              const char** keys,
+                                              const char** vals);
+
+/*!
+ * \brief set the type the values of some keys are sent in by the distributed kvstore
+ * \param handle handle to the KVStore
+ * \param num number of keys
+ * \param keys the keys
+ * \param dtype the type flag, float32 or float16
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStoreSetWireDType(KVStoreHandle handle,
+                                    mx_uint num,
+                                    const int* keys,
+                                    int dtype);
+
+/*!
+ * \brief let the servers of the distributed kvstore update by a native optimizer
+ * \param handle handle to the KVStore
+ * \param name name of the optimizer registered by MXNET_REGISTER_OPTIMIZER
+ * \param num_params number of parameters
+ * \param keys keys of the parameters, with "learning_rate" and "wd"
+ * \param vals values of the parameters
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStoreSetServerOptimizer(KVStoreHandle handle,
+                                          const char* name,
+                                          mx_uint num_params,
+                                          const char** keys,
+                                          const char** vals);
+
 /**
  * \return Send a command to all server nodes
  *
@@ -1329,6 +1891,22 @@ MXNET_DLL int MXRecordIOReaderFree(RecordIOHandle *handle);
 MXNET_DLL int MXRecordIOReaderReadRecord(RecordIOHandle *handle,
                                         char const **buf, size_t *size);
 
+/**
+ * \brief Get the current position of a RecordIO writer, where the next record is written
+ * \param handle handle to RecordIO object
+ * \param pos pointer to return the position
+ * \return 0 when success, -1 when failure happens
+*/
+MXNET_DLL int MXRecordIOWriterTell(RecordIOHandle handle, size_t *pos);
+
+/**
+ * \brief Set the position of a RecordIO reader, the next record is read from there
+ * \param handle handle to RecordIO object
+ * \param pos position of a record, given by MXRecordIOWriterTell
+ * \return 0 when success, -1 when failure happens
+*/
+MXNET_DLL int MXRecordIOReaderSeek(RecordIOHandle handle, size_t pos);
+
 /**
  * \brief Create a MXRtc object
 */
@@ -1371,6 +1949,43 @@ MXNET_DLL int MXOptimizerUpdate(OptimizerHandle handle,
                                 NDArrayHandle grad,
                                 mx_float lr,
                                 mx_float wd);
+/*!
+ * \brief update a list of weights at once, the updates of the weights on the
+ *  same device may be fused by the optimizer
+ * \param handle the optimizer
+ * \param num the number of weights
+ * \param indices the unique index of each weight
+ * \param weights the weights
+ * \param grads the gradients
+ * \param lrs the learning rate of each weight
+ * \param wds the weight decay of each weight
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXOptimizerUpdateMulti(OptimizerHandle handle,
+                                     mx_uint num,
+                                     const int *indices,
+                                     NDArrayHandle *weights,
+                                     NDArrayHandle *grads,
+                                     const mx_float *lrs,
+                                     const mx_float *wds);
+/*!
+ * \brief update a weight with a row sparse gradient, see Optimizer::UpdateRowSparse
+ * \param handle the optimizer
+ * \param index the unique index of the weight
+ * \param weight the weight, of shape (num_rows, ...)
+ * \param row_ids the sorted unique row indices on cpu
+ * \param grad the gradient of the rows, of shape (num_row_ids, ...)
+ * \param lr the learning rate
+ * \param wd the weight decay
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXOptimizerUpdateRowSparse(OptimizerHandle handle,
+                                         int index,
+                                         NDArrayHandle weight,
+                                         NDArrayHandle row_ids,
+                                         NDArrayHandle grad,
+                                         mx_float lr,
+                                         mx_float wd);
 
 MXNET_DLL int MXCustomOpRegister(const char* op_type, CustomOpPropCreator creator);
 
@@ -31,6 +31,25 @@ typedef float mx_float;
 typedef void *PredictorHandle;
 /*! \brief handle to NDArray list */
 typedef void *NDListHandle;
+/*! \brief handle to a batching front-end of a predictor */
+typedef void *PredBatcherHandle;
+/*! \brief handle to a host of several models */
+typedef void *PredHostHandle;
+/*! \brief handle to a data parallel predictor over several devices */
+typedef void *PredMultiHandle;
+/*!
+ * \brief callback of a request of MXPredBatcherSubmit, called from the thread of the batcher
+ * \param error NULL on success, otherwise the error message
+ * \param num_outputs The number of outputs.
+ * \param outputs The outputs of the request, only valid during the callback.
+ * \param output_sizes The number of elements of each output.
+ * \param arg The argument given to MXPredBatcherSubmit.
+ */
+typedef void (*PredBatchCallback)(const char* error,
+                                  mx_uint num_outputs,
+                                  const mx_float** outputs,
+                                  const mx_uint* output_sizes,
+                                  void* arg);
 
 /*!
  * \brief Get the last error happeneed.
@@ -101,6 +120,257 @@ MXNET_DLL int MXPredCreatePartialOut(const char* symbol_json_str,
                                      mx_uint num_output_nodes,
                                      const char** output_keys,
                                      PredictorHandle* out);
+/*!
+ * \brief create a predictor wich customized outputs from a parameter file.
+ *
+ *  A file saved by MXNDArraySaveAligned is memory mapped, so the parameters
+ *  are read on demand by page faults and a cpu predictor uses them without
+ *  copy. A gpu predictor copies each parameter from the mapped pages. Other
+ *  parameter files are read as by MXPredCreatePartialOut.
+ *
+ * \param symbol_json_str The JSON string of the symbol.
+ * \param param_file The path of the parameter ndarray file.
+ * \param dev_type The device type, 1: cpu, 2:gpu
+ * \param dev_id The device id of the predictor.
+ * \param num_input_nodes Number of input nodes to the net.
+ * \param input_keys The name of input argument.
+ * \param input_shape_indptr Index pointer of shapes of each input node.
+ * \param input_shape_data A flatted data of shapes of each input node.
+ * \param num_output_nodes Number of output nodes to the net, 0 for the outputs of the symbol.
+ * \param output_keys The name of output argument.
+ * \param out The created predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredCreateFromFile(const char* symbol_json_str,
+                                   const char* param_file,
+                                   int dev_type, int dev_id,
+                                   mx_uint num_input_nodes,
+                                   const char** input_keys,
+                                   const mx_uint* input_shape_indptr,
+                                   const mx_uint* input_shape_data,
+                                   mx_uint num_output_nodes,
+                                   const char** output_keys,
+                                   PredictorHandle* out);
+/*!
+ * \brief create a predictor as MXPredCreateFromFile, with the symbol read from a file.
+ *
+ *  The symbol file is either json or saved by MXSymbolSaveToBinaryFile. The binary
+ *  format parses each distinct operator once, which is much faster for unrolled networks.
+ *
+ * \param symbol_file The path of the symbol file.
+ * \param param_file The path of the parameter ndarray file.
+ * \param dev_type The device type, 1: cpu, 2:gpu
+ * \param dev_id The device id of the predictor.
+ * \param num_input_nodes Number of input nodes to the net.
+ * \param input_keys The name of input argument.
+ * \param input_shape_indptr Index pointer of shapes of each input node.
+ * \param input_shape_data A flatted data of shapes of each input node.
+ * \param num_output_nodes Number of output nodes to the net, 0 for the outputs of the symbol.
+ * \param output_keys The name of output argument.
+ * \param out The created predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredCreateFromSymbolFile(const char* symbol_file,
+                                         const char* param_file,
+                                         int dev_type, int dev_id,
+                                         mx_uint num_input_nodes,
+                                         const char** input_keys,
+                                         const mx_uint* input_shape_indptr,
+                                         const mx_uint* input_shape_data,
+                                         mx_uint num_output_nodes,
+                                         const char** output_keys,
+                                         PredictorHandle* out);
+/*!
+ * \brief create a predictor of the same network as another one, which shares
+ *  its parameters instead of loading them again.
+ *
+ *  The new predictor has its own inputs, outputs and intermediate results, so
+ *  that the predictors created from the same one can run forward concurrently,
+ *  each of them from one thread at a time. The parameters are kept alive until
+ *  all of the predictors sharing them are freed.
+ * \param handle The predictor whose parameters are shared.
+ * \param out The created predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredCreateShared(PredictorHandle handle, PredictorHandle* out);
+/*!
+ * \brief create a host of several models sharing the devices.
+ * \param out The created host handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredHostCreate(PredHostHandle* out);
+/*!
+ * \brief create the predictor of a model in a host, as MXPredCreate.
+ *
+ *  The memory allocated for the model, by this predictor and those created from
+ *  it by MXPredCreateShared, is limited to its quota. The models created with
+ *  shared_activations on the same device share the memory of their intermediate
+ *  results, which then only grows to that of the largest of them. They must run
+ *  one at a time: the outputs of one of them are only valid until the forward of
+ *  another one. The operations of a model of a positive priority run on
+ *  the gpu streams of the highest priority, before those of the other models,
+ *  and those of a negative priority run after them.
+ * \param host The host handle.
+ * \param name The name of the model, unique in the host.
+ * \param memory_quota_mb The memory quota of the model in MB, 0 for no limit.
+ * \param shared_activations Whether to share the memory of the intermediate results.
+ * \param priority The priority of the model, 0 by default.
+ * \param symbol_json_str The JSON string of the symbol.
+ * \param param_bytes The in-memory raw bytes of parameter ndarray file.
+ * \param param_size The size of parameter ndarray file.
+ * \param dev_type The device type, 1: cpu, 2:gpu
+ * \param dev_id The device id of the predictor.
+ * \param num_input_nodes Number of input nodes to the net.
+ * \param input_keys The name of the input argument.
+ * \param input_shape_indptr Index pointer of shapes of each input node.
+ * \param input_shape_data A flattened data of shapes of each input node.
+ * \param out The created predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredHostCreatePredictor(PredHostHandle host,
+                                        const char* name,
+                                        mx_uint memory_quota_mb,
+                                        int shared_activations,
+                                        int priority,
+                                        const char* symbol_json_str,
+                                        const void* param_bytes,
+                                        int param_size,
+                                        int dev_type, int dev_id,
+                                        mx_uint num_input_nodes,
+                                        const char** input_keys,
+                                        const mx_uint* input_shape_indptr,
+                                        const mx_uint* input_shape_data,
+                                        PredictorHandle* out);
+/*!
+ * \brief Free a host, after all the predictors created in it are freed.
+ * \param host The host handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredHostFree(PredHostHandle host);
+/*!
+ * \brief create a front-end which batches the requests of single samples.
+ *
+ *  The requests are queued, and a thread of the batcher runs a forward for up
+ *  to max_batch of them, once there are max_batch requests or the oldest one
+ *  waited timeout_us. Partial batches run on executors reshaped to their size.
+ *  The predictor must not be used directly until the batcher is freed.
+ * \param handle The predictor, created with max_batch as the first dimension of
+ *  every input.
+ * \param max_batch The maximum batch size.
+ * \param timeout_us The maximum time in microseconds a request waits for a batch.
+ * \param out The created batcher handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredBatcherCreate(PredictorHandle handle,
+                                  mx_uint max_batch,
+                                  mx_uint timeout_us,
+                                  PredBatcherHandle* out);
+/*!
+ * \brief queue the request of a sample, thread safe.
+ * \param handle The batcher handle.
+ * \param num_inputs The number of given inputs, the others are zero.
+ * \param input_keys The names of the inputs.
+ * \param input_data The data of the inputs, each of the shape of one sample. They are
+ *  copied before this function returns.
+ * \param callback Called with the outputs of the sample.
+ * \param callback_arg The argument of the callback.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredBatcherSubmit(PredBatcherHandle handle,
+                                  mx_uint num_inputs,
+                                  const char** input_keys,
+                                  const mx_float** input_data,
+                                  PredBatchCallback callback,
+                                  void* callback_arg);
+/*!
+ * \brief Free a batcher, after the queued requests are answered.
+ * \param handle The batcher handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredBatcherFree(PredBatcherHandle handle);
+/*!
+ * \brief create a predictor which splits each batch over several devices.
+ *
+ *  Each device binds its own executor, with the parameters loaded once in the host
+ *  and copied to it. A forward splits the batch in proportion to the throughput of
+ *  the devices, measured by their previous forwards, runs the parts concurrently
+ *  and gathers the outputs in the host. The devices start with equal parts, and
+ *  the executor of a device is reshaped when its part changes by more than 1/32
+ *  of the batch. Every input and output must have the batch as first dimension.
+ * \param symbol_json_str The JSON string of the symbol.
+ * \param param_bytes The in-memory raw bytes of parameter ndarray file.
+ * \param param_size The size of parameter ndarray file.
+ * \param dev_type The device type, 1: cpu, 2:gpu
+ * \param num_devices The number of devices.
+ * \param dev_ids The ids of the devices.
+ * \param num_input_nodes Number of input nodes to the net.
+ * \param input_keys The name of the input argument.
+ * \param input_shape_indptr Index pointer of shapes of each input node.
+ * \param input_shape_data A flattened data of shapes of each input node, of the
+ *  whole batch, which must be at least num_devices.
+ * \param out The created predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredMultiCreate(const char* symbol_json_str,
+                                const void* param_bytes,
+                                int param_size,
+                                int dev_type,
+                                mx_uint num_devices,
+                                const int* dev_ids,
+                                mx_uint num_input_nodes,
+                                const char** input_keys,
+                                const mx_uint* input_shape_indptr,
+                                const mx_uint* input_shape_data,
+                                PredMultiHandle* out);
+/*!
+ * \brief set the input of the whole batch of a data parallel predictor.
+ * \param handle The predictor handle.
+ * \param key The name of the input.
+ * \param data The data of the batch, copied before this function returns.
+ * \param size The number of elements of the batch.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredMultiSetInput(PredMultiHandle handle,
+                                  const char* key,
+                                  const mx_float* data,
+                                  mx_uint size);
+/*!
+ * \brief run the forward of the batch on the devices, and wait for the outputs.
+ * \param handle The predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredMultiForward(PredMultiHandle handle);
+/*!
+ * \brief Get the shape of an output of the whole batch.
+ *  The returned shape_data is valid until the predictor is freed.
+ * \param handle The predictor handle.
+ * \param index The index of the output.
+ * \param shape_data Used to hold pointer to the shape data.
+ * \param shape_ndim Used to hold shape dimension.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredMultiGetOutputShape(PredMultiHandle handle,
+                                        mx_uint index,
+                                        mx_uint** shape_data,
+                                        mx_uint* shape_ndim);
+/*!
+ * \brief Get an output of the whole batch.
+ * \param handle The predictor handle.
+ * \param index The index of the output.
+ * \param data The buffer of the output.
+ * \param size The number of elements of the output.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredMultiGetOutput(PredMultiHandle handle,
+                                   mx_uint index,
+                                   mx_float* data,
+                                   mx_uint size);
+/*!
+ * \brief Free a data parallel predictor.
+ * \param handle The predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredMultiFree(PredMultiHandle handle);
 /*!
  * \brief Get the shape of output node.
  *  The returned shape_data and shape_ndim is only valid before next call to MXPred function.
@@ -127,6 +397,23 @@ MXNET_DLL int MXPredSetInput(PredictorHandle handle,
                              const char* key,
                              const mx_float* data,
                              mx_uint size);
+/*!
+ * \brief Get the memory of an input of a cpu predictor, to write the input in
+ *  place of MXPredSetInput without a copy.
+ *
+ *  It waits for the previous forward to finish reading the input. The pointer
+ *  is valid until the predictor is freed, and must not be written during a
+ *  forward.
+ * \param handle The predictor handle.
+ * \param key The name of input node.
+ * \param data Used to hold the pointer to the float32 input.
+ * \param size Used to hold the number of elements of the input.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredGetInputPtr(PredictorHandle handle,
+                                const char* key,
+                                mx_float** data,
+                                mx_uint* size);
 /*!
  * \brief Run a forward pass to get the output.
  * \param handle The handle of the predictor.
@@ -162,6 +449,22 @@ MXNET_DLL int MXPredGetOutput(PredictorHandle handle,
                               mx_uint index,
                               mx_float* data,
                               mx_uint size);
+/*!
+ * \brief Get the memory of an output of a cpu predictor, to read the output in
+ *  place of MXPredGetOutput without a copy.
+ *
+ *  It waits for the forward to finish. The pointer is valid until the next
+ *  forward or until the predictor is freed.
+ * \param handle The handle of the predictor.
+ * \param index The index of output node, set to 0 if there is only one output.
+ * \param data Used to hold the pointer to the float32 output.
+ * \param size Used to hold the number of elements of the output.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredGetOutputPtr(PredictorHandle handle,
+                                 mx_uint index,
+                                 const mx_float** data,
+                                 mx_uint* size);
 /*!
  * \brief Free a predictor handle.
  * \param handle The handle of the predictor.
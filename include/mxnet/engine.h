@@ -11,6 +11,8 @@
 #include <memory>
 #include <functional>
 #endif
+#include <string>
+#include <utility>
 #include <vector>
 #include "./base.h"
 
@@ -29,6 +31,10 @@ struct Opr;
 typedef Var* VarHandle;
 /*! \brief Operator pointer type, usually hold by user.*/
 typedef Opr* OprHandle;
+/*! \brief Internal representation of a captured graph of operations. */
+struct Graph;
+/*! \brief Graph pointer type, usually hold by user.*/
+typedef Graph* GraphHandle;
 /*!
  * \brief OnComplete Callback to the engine,
  *  called by AsyncFn when action completes
@@ -64,10 +70,18 @@ enum class FnProperty {
   kCopyToGPU,
   /*! \brief Prioritized sync operation on CPU */
   kCPUPrioritized,
+  /*! \brief Prioritized sync operation on GPU, such as the reductions of a kvstore */
+  kGPUPrioritized,
   /*! \brief Asynchronous function call */
   kAsync
 };  // enum class FnProperty
 
+/*!
+ * \brief operations pushed with at least this priority are latency critical, on a gpu
+ *  they run on their own workers whose streams have the highest priority.
+ */
+const int kHighPriority = 1 << 16;
+
 /*!
  * \brief Dependency engine that schedules operations.
 */
@@ -83,6 +97,8 @@ class MXNET_API Engine {
   typedef engine::VarHandle VarHandle;
   /*! \brief Operator pointer */
   typedef engine::OprHandle OprHandle;
+  /*! \brief Graph pointer */
+  typedef engine::GraphHandle GraphHandle;
   /*!
    * \brief Notify the engine about a shutdown,
    *  This can help engine to print less messages into display.
@@ -106,12 +122,15 @@ class MXNET_API Engine {
    *                   mutate.
    * \param mutable_vars The variables that current operation will mutate.
    * \param prop Property of the function.
+   * \param opr_name The operator name, used by the profiler.
+   *                 The string must outlive the operator.
    * \return The new operator allocated.
    */
   virtual OprHandle NewOperator(AsyncFn fn,
                                 std::vector<VarHandle> const& const_vars,
                                 std::vector<VarHandle> const& mutable_vars,
-                                FnProperty prop = FnProperty::kNormal) = 0;
+                                FnProperty prop = FnProperty::kNormal,
+                                const char* opr_name = nullptr) = 0;
   /*!
    * \brief Delete the given operator.
    * \param op The operator to delete.
@@ -138,12 +157,15 @@ class MXNET_API Engine {
    * \param mutable_vars The variables that current operation will mutate.
    * \param prop Property of the function.
    * \param priority Priority of the action, as hint to the engine.
+   * \param opr_name The operator name, used by the profiler.
+   *                 The string must outlive the execution of the operation.
    */
   virtual void PushAsync(AsyncFn exec_fun, Context exec_ctx,
                          std::vector<VarHandle> const& const_vars,
                          std::vector<VarHandle> const& mutable_vars,
                          FnProperty prop = FnProperty::kNormal,
-                         int priority = 0) = 0;
+                         int priority = 0,
+                         const char* opr_name = nullptr) = 0;
   /*!
    * \brief Schedule the deletion of a variable.
    *
@@ -192,18 +214,107 @@ class MXNET_API Engine {
    * \param mutable_vars The variables that current operation will mutate.
    * \param prop Property of the function.
    * \param priority Priority of the action, as hint to the engine.
-   * \tparam SyncFn the synchronous function to be pushed.
-   */
-  template<typename SyncFn>
-  inline void PushSync(SyncFn exec_fn, Context exec_ctx,
-                       std::vector<VarHandle> const& const_vars,
-                       std::vector<VarHandle> const& mutable_vars,
-                       FnProperty prop = FnProperty::kNormal,
-                       int priority = 0) {
+   * \param opr_name The operator name, used by the profiler.
+   */
+  virtual void PushSync(SyncFn exec_fn, Context exec_ctx,
+                        std::vector<VarHandle> const& const_vars,
+                        std::vector<VarHandle> const& mutable_vars,
+                        FnProperty prop = FnProperty::kNormal,
+                        int priority = 0,
+                        const char* opr_name = nullptr) {
     this->PushAsync([exec_fn](RunContext ctx, CallbackOnComplete on_complete) {
         exec_fn(ctx);
         on_complete();
-      }, exec_ctx, const_vars, mutable_vars, prop, priority);
+      }, exec_ctx, const_vars, mutable_vars, prop, priority, opr_name);
+  }
+  /*!
+   * \brief Set the maximum number of synchronous operations pushed by the
+   *  calling thread that are grouped into one engine operation.
+   *
+   *  Consecutive operations pushed by PushSync with FnProperty::kNormal
+   *  on the same context are appended to a bulk, which is pushed when it
+   *  is full, on any other push, or on WaitForVar and WaitForAll.
+   *  0 disables bulk execution, which is the default.
+   *  Engines that do not support bulk execution ignore this.
+   * \param bulk_size the new bulk size.
+   * \return the previous bulk size.
+   */
+  virtual int set_bulk_size(int bulk_size) {
+    return 0;
+  }
+  /*!
+   * \brief Whether the callback of a function pushed by \ref PushAsync can be
+   *  called after the function returns, from another thread.
+   * \return false when the function has to call it before returning.
+   */
+  virtual bool SupportAsyncComplete() const {
+    return true;
+  }
+  /*!
+   * \brief Whether a synchronous function on a gpu may complete once its
+   *  kernels are queued on the stream of its RunContext. The engine then
+   *  orders the operations depending on it after the kernels, and waits for
+   *  them only before the host uses the variables.
+   * \return false when the function has to wait for its stream.
+   */
+  virtual bool SupportStreamOrderedComplete() const {
+    return false;
+  }
+  /*!
+   * \brief Get the runtime counters of the engine as name and value pairs,
+   *  cheap enough to be sampled periodically. Counters ending with _us are
+   *  microseconds. Engines without counters return none.
+   * \param stats the counters.
+   */
+  virtual void GetStats(std::vector<std::pair<std::string, uint64_t> >* stats) {
+    stats->clear();
+  }
+#if MXNET_USE_CUDA
+  /*!
+   * \brief Called by a synchronous gpu function after queuing its kernels,
+   *  waits for them unless the engine supports stream ordered completion.
+   * \param ctx the RunContext of the function.
+   */
+  inline void WaitForStream(RunContext ctx) const {
+    if (!this->SupportStreamOrderedComplete()) ctx.get_stream<gpu>()->Wait();
+  }
+#endif
+  /*!
+   * \brief Start recording the operations pushed by the calling thread into
+   *  a graph instead of executing them.
+   *
+   *  The operations of the graph are executed by \ref PushGraph, with the
+   *  same functions on the same variables. The dependencies between them are
+   *  computed once by \ref EndCapture, so that a replay only depends on each
+   *  variable of the graph once. \ref WaitForVar and \ref WaitForAll cannot
+   *  be called during the capture.
+   */
+  virtual void BeginCapture() {
+    LOG(FATAL) << "the engine does not support graph capture";
+  }
+  /*!
+   * \brief Stop the capture of the calling thread.
+   * \return the graph of the operations pushed since \ref BeginCapture.
+   */
+  virtual GraphHandle EndCapture() {
+    LOG(FATAL) << "the engine does not support graph capture";
+    return nullptr;
+  }
+  /*!
+   * \brief Push all the operations of a captured graph, in the order they
+   *  were pushed with respect to the other operations on their variables.
+   * \param graph the graph to push.
+   * \param priority Priority of the action, as hint to the engine.
+   */
+  virtual void PushGraph(GraphHandle graph, int priority = 0) {
+    LOG(FATAL) << "the engine does not support graph capture";
+  }
+  /*!
+   * \brief Delete a captured graph after its pushed replays complete.
+   * \param graph the graph to delete.
+   */
+  virtual void DeleteGraph(GraphHandle graph) {
+    LOG(FATAL) << "the engine does not support graph capture";
   }
 
  protected:
@@ -30,6 +30,14 @@ class IIterator : public dmlc::DataIter<DType> {
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) = 0;
   /*! \brief reset the iterator */
   virtual void BeforeFirst(void) = 0;
+  /*!
+   * \brief reset the iterator with new values of some of its parameters, such as the
+   *  data shape between the epochs of a progressive resizing. The threads are kept.
+   * \param kwargs key-value pairs, the given ones override those of Init
+   */
+  virtual void Reset(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    LOG(FATAL) << "the parameters of this iterator cannot change at reset";
+  }
   /*! \brief move to next item */
   virtual bool Next(void) = 0;
   /*! \brief get current data */
@@ -58,7 +66,11 @@ struct DataInst {
  * \brief DataBatch of NDArray, returned by Iterator
  */
 struct DataBatch {
-  /*! \brief content of dense data, if this DataBatch is dense */
+  /*!
+   * \brief content of dense data, if this DataBatch is dense. The data and the label
+   *  come first, a batch in compressed sparse row format is followed by its column
+   *  indices and row pointers.
+   */
   std::vector<NDArray> data;
   /*! \brief index of image data */
   std::vector<uint64_t> index;
@@ -66,6 +78,8 @@ struct DataBatch {
   std::string extra_data;
   /*! \brief num of example padded to batch */
   int num_batch_padd;
+  /*! \brief bucket of a batch of variable shape, such as the padded length of sequences, -1 if none */
+  int bucket_key = -1;
 };  // struct DataBatch
 
 /*! \brief typedef the factory function of data iterator */
@@ -10,6 +10,7 @@
 #include <unordered_map>
 #include <string>
 #include <functional>
+#include <utility>
 #include "./ndarray.h"
 #if MXNET_USE_DIST_KVSTORE
 #include "ps/ps.h"
@@ -127,6 +128,81 @@ class KVStore {
   virtual void Pull(const std::vector<int>& keys,
                     const std::vector<NDArray*>& values,
                     int priority = 0) = 0;
+  /*!
+   * \brief push a list of row sparse values into the store
+   *
+   * The value of \a keys[i] is zero except the rows \a row_ids[i], given by
+   * \a values[i], of shape (row_ids[i].Size(), ...). Only these rows are sent,
+   * the pushed rows of a key are summed, and the updater is applied to the
+   * touched rows of the stored value only
+   *
+   * \code
+   * updater(key, merged_rows, &stored_rows);
+   * \endcode
+   *
+   * so the updater must not keep a state of the shape of the value, e.g. SGD
+   * without momentum. Without updater the touched rows are assigned. A native
+   * server optimizer updates the rows by Optimizer::UpdateRowSparse instead.
+   *
+   * \param keys the list of keys
+   * \param row_ids the sorted unique 0-based row indices of each value, on cpu.
+   *   They are read when this function is called
+   * \param values the list of the pushed rows
+   * \param priority Priority of the action.
+   */
+  virtual void PushRowSparse(const std::vector<int>& keys,
+                             const std::vector<NDArray>& row_ids,
+                             const std::vector<NDArray>& values,
+                             int priority = 0) {
+    LOG(FATAL) << "row sparse push is not supported by kvstore " << type_;
+  }
+  /*!
+   * \brief pull some rows of a list of keys from the store
+   *
+   * \param keys the list of keys
+   * \param row_ids the sorted unique 0-based row indices to pull, on cpu.
+   *   They are read when this function is called
+   * \param values the buffers for the pulled rows, of shape (row_ids[i].Size(), ...)
+   * \param priority Priority of the action.
+   */
+  virtual void PullRowSparse(const std::vector<int>& keys,
+                             const std::vector<NDArray>& row_ids,
+                             const std::vector<NDArray*>& values,
+                             int priority = 0) {
+    LOG(FATAL) << "row sparse pull is not supported by kvstore " << type_;
+  }
+
+  /*!
+   * \brief take the next part of a dataset read by all of the workers
+   *
+   * The parts of an epoch are given in order by the first server, each to a
+   * single worker, so that the faster workers read more parts. All of the
+   * workers must count the epochs of the dataset the same way.
+   *
+   * \param dataset the name of the dataset
+   * \param epoch the epoch the part is read in
+   * \param num_parts the number of parts of the dataset
+   * \return the index of the part, or -1 when all parts of the epoch are taken
+   */
+  virtual int TakeDataPart(const std::string& dataset, int epoch, int num_parts) {
+    LOG(FATAL) << "dynamic data parts are not supported by kvstore " << type_;
+    return -1;
+  }
+  /*!
+   * \brief get the counters of the communication of this worker and of the
+   *  servers, such as the bytes sent to each server, the push and pull times,
+   *  and the arrival skew of the workers in the sync rounds of the servers
+   * \param reset whether to reset the counters after
+   * \return the counters as json
+   */
+  virtual std::string GetStats(bool reset) {
+    return "{}";
+  }
+  /*!
+   * \return the kvstore giving the data parts of this worker, the last created
+   *  distributed kvstore, or NULL
+   */
+  static KVStore* DataPartServer();
 
   /**
    * \brief the prototype of user-defined updater
@@ -146,6 +222,24 @@ class KVStore {
     updater_ = updater;
   }
 
+  /*!
+   * \brief let the servers update the stored values by a native optimizer
+   *
+   * The optimizer registered by MXNET_REGISTER_OPTIMIZER runs on the engine of
+   * the servers, so that the updates of different keys overlap, instead of the
+   * updater set by the servers. All workers must call it with the same
+   * arguments before any push.
+   *
+   * \param name the name of the optimizer, such as "ccsgd"
+   * \param kwargs the parameters of Init, with "learning_rate" and "wd"
+   *  which are given to every Update
+   */
+  virtual void SetServerOptimizer(
+      const std::string& name,
+      const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    LOG(FATAL) << "server optimizers are not supported by kvstore " << type_;
+  }
+
   /******************************************************
    * the following are used for multi-machines.
    ******************************************************/
@@ -231,6 +325,33 @@ class KVStore {
    */
   virtual void Barrier() { }
 
+  /*!
+   * \brief set the compression of the gradients pushed to servers,
+   *  only the distributed kvstore compresses gradients.
+   *
+   *  Must be called by all workers after the kvstore is created and before
+   *  any \ref Init, and the servers are configured by worker 0.
+   *
+   * \param kwargs the parameters, such as {"type", "2bit"}, {"threshold", "0.5"}
+   */
+  virtual void SetGradientCompression(
+      const std::vector<std::pair<std::string, std::string> >& kwargs) { }
+
+  /*!
+   * \brief set the type the values of some keys are sent in between the workers
+   *  and the servers, only the distributed kvstore sends them.
+   *
+   *  The values of float16 keys are converted by the workers before the pushes and
+   *  after the pulls, the servers store and merge them in float32. The keys left
+   *  in float32, such as the statistics of batch normalization, are sent as is.
+   *  The initialization is always in float32, and compressed pushes take
+   *  precedence.
+   *
+   * \param keys the keys
+   * \param dtype mshadow::kFloat32, the default, or mshadow::kFloat16
+   */
+  virtual void SetWireDType(const std::vector<int>& keys, int dtype) { }
+
   /**
    * \brief Send a command to all server nodes
    *
@@ -265,6 +386,8 @@ class KVStore {
   virtual void RunServer(const Controller& controller) { }
 
  protected:
+  /*! \brief set the kvstore returned by \ref DataPartServer */
+  static void SetDataPartServer(KVStore* kv);
   /**
    * \brief the user-defined  updater
    */
@@ -14,6 +14,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <utility>
 #include <unordered_map>
 #include "./ndarray.h"
@@ -58,6 +59,19 @@ class MXRtc {
             unsigned int  block_dim_X,
             unsigned int  block_dim_Y,
             unsigned int  block_dim_Z);
+  /*!
+   * \brief launch a kernel on a stream directly, used inside engine operations.
+   * \param args pointers to the inputs followed by pointers to the outputs.
+   * \param dev_id device the stream belongs to.
+   * \param stream the stream to launch on, the kernel runs asynchronously.
+   * \param grid_dim_X kernel grid dimensions.
+   * \param block_dim_X kernel block dimensions.
+   */
+  void launch(std::vector<float*> args,
+              int dev_id,
+              mshadow::Stream<mshadow::gpu> *stream,
+              unsigned int grid_dim_X,
+              unsigned int block_dim_X);
 
  private:
   static const char str_type[];
@@ -69,6 +83,7 @@ class MXRtc {
   char* ptx_;
   std::unordered_map<int, CUmodule> module_;
   std::unordered_map<int, CUfunction> func_;
+  std::mutex mutex_;
 
   /*!
    * \brief add supporting code to kernel.
@@ -81,6 +96,10 @@ class MXRtc {
    * \brief compile the kernel with nvrtc.
    */
   char* compile(const std::string& name, const std::string& code);
+  /*!
+   * \brief get the kernel function on a device, load the module when first used.
+   */
+  CUfunction get_function(int dev_id);
 };
 
 }  // namespace mxnet
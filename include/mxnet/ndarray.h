@@ -31,7 +31,7 @@ namespace mxnet {
 class NDArray {
  public:
   /*! \brief default cosntructor */
-  NDArray() {}
+  NDArray() : stride_(0) {}
   /*!
    * \brief constructing a new dynamic NDArray
    * \param shape the shape of array
@@ -42,7 +42,7 @@ class NDArray {
   NDArray(const TShape &shape, Context ctx,
           bool delay_alloc = false, int dtype = mshadow::default_type_flag)
       : ptr_(std::make_shared<Chunk>(shape.Size(), ctx, delay_alloc, dtype)),
-        shape_(shape), offset_(0), dtype_(dtype) {
+        shape_(shape), offset_(0), stride_(0), dtype_(dtype) {
   }
   /*!
    * \brief constructing a static NDArray that shares data with TBlob
@@ -53,7 +53,19 @@ class NDArray {
    */
   NDArray(const TBlob &data, int dev_id)
       : ptr_(std::make_shared<Chunk>(data, dev_id)), shape_(data.shape_), offset_(0),
-        dtype_(data.type_flag_) {
+        stride_(0), dtype_(data.type_flag_) {
+  }
+  /*!
+   * \brief constructing a static NDArray of memory kept alive by holder, such
+   *  as a mapped file, instead of the caller
+   * \param data the memory content of static data
+   * \param dev_id the device id this tensor sits at
+   * \param holder released when the NDArray and its copies are destroyed
+   */
+  NDArray(const TBlob &data, int dev_id, std::shared_ptr<void> holder)
+      : ptr_(std::make_shared<Chunk>(data, dev_id)), shape_(data.shape_), offset_(0),
+        stride_(0), dtype_(data.type_flag_) {
+    ptr_->holder = holder;
   }
   /*!
    * \return the shape of current NDArray
@@ -70,8 +82,18 @@ class NDArray {
       res = TBlob(static_cast<DType*>(ptr_->shandle.dptr)
         + offset_, shape_, ptr_->shandle.ctx.dev_mask());
     });
+    if (stride_ != 0) res.stride_ = stride_;
     return res;
   }
+  /*!
+   * \return whether the elements are contiguous, false for the views of
+   *  \ref SliceAxis. The data of a strided view is a TBlob whose rows of the
+   *  last dimension are stride_ elements apart, which is read and written by
+   *  the mshadow expressions of FlatTo2D, e.g. the elementwise operators.
+   */
+  inline bool is_contiguous() const {
+    return stride_ == 0;
+  }
   /*!
    * \return the context of NDArray, this function is only valid when the NDArray is not empty
    */
@@ -228,6 +250,7 @@ class NDArray {
   inline NDArray Slice(index_t begin, index_t end) const {
     NDArray ret = *this;
     CHECK(!is_none()) << "NDArray is not initialized";
+    CHECK(is_contiguous()) << "Slice of a strided view";
     CHECK_GE(shape_[0], end) << "Slice end index out of range";
     size_t length = shape_.ProdShape(1, shape_.ndim());
     ret.offset_ += begin * length;
@@ -242,6 +265,7 @@ class NDArray {
   inline NDArray At(index_t idx) const {
     NDArray ret = *this;
     CHECK(!is_none()) << "NDArray is not initialized";
+    CHECK(is_contiguous()) << "At of a strided view";
     CHECK_GE(shape_[0], idx) << "index out of range";
     size_t length = shape_.ProdShape(1, shape_.ndim());
     ret.offset_ += idx * length;
@@ -256,10 +280,48 @@ class NDArray {
   inline NDArray Reshape(const TShape &shape) const {
     CHECK_GE(shape_.Size(), shape.Size())
         << "NDArray.Reshape: target shape size is different from current shape";
+    CHECK(is_contiguous()) << "NDArray.Reshape: the view is strided, reshape its Contiguous()";
     NDArray ret = *this;
     ret.shape_ = shape;
     return ret;
   }
+  /*!
+   * \brief Slice a NDArray along any axis without copy.
+   *
+   *  The view is contiguous when the dimensions before axis are 1, otherwise
+   *  it is strided, which needs either a single index (end == begin + 1) or
+   *  the last axis, e.g. a time step of (batch, time, feature) data.
+   * \param axis the axis to slice
+   * \param begin begin index in the axis
+   * \param end end index in the axis
+   * \return sliced NDArray of the same number of dimensions
+   */
+  inline NDArray SliceAxis(index_t axis, index_t begin, index_t end) const {
+    CHECK(!is_none()) << "NDArray is not initialized";
+    CHECK(is_contiguous()) << "SliceAxis of a strided view";
+    CHECK_LT(axis, shape_.ndim()) << "SliceAxis axis out of range";
+    CHECK(begin < end && end <= shape_[axis]) << "SliceAxis index out of range";
+    const index_t outer = shape_.ProdShape(0, axis);
+    const index_t inner = shape_.ProdShape(axis + 1, shape_.ndim());
+    NDArray ret = *this;
+    ret.offset_ += begin * inner;
+    ret.shape_[axis] = end - begin;
+    if (outer != 1 && ret.shape_.Size() != 0) {
+      CHECK(end == begin + 1 || axis + 1 == shape_.ndim())
+          << "SliceAxis: the slice of axis " << axis << " of " << shape_
+          << " is not a strided view, it needs a single index or the last axis";
+      // the rows of the last dimension are a slice of axis apart
+      ret.stride_ = shape_[axis] * inner;
+    }
+    return ret;
+  }
+  /*!
+   * \return this NDArray if it is contiguous, otherwise a contiguous copy of
+   *  the view on the same context
+   */
+  inline NDArray Contiguous() const {
+    return is_contiguous() ? *this : this->Copy(this->ctx());
+  }
   /*!
    * \brief Allocate the space if it is delayed allocated.
    * This is an internal function used by system that normal user should not use
@@ -267,6 +329,15 @@ class NDArray {
   inline void CheckAndAlloc() const {
     ptr_->CheckAndAlloc();
   }
+  /*!
+   * \brief Grow the storage of this array to at least size elements, without
+   *  keeping the content. The arrays viewing the same storage, such as its
+   *  slices, use the new storage from their next operation on.
+   *  This is an internal function used by system that normal user should not use
+   * \param size the number of elements of the storage
+   * \return a 1-D array of size elements on the whole storage
+   */
+  NDArray GrowStorage(size_t size) const;
   /*!
    * \brief Save list of narray into the Stream.x
    * \param fo The stream of output.
@@ -285,6 +356,60 @@ class NDArray {
   static void Load(dmlc::Stream* fi,
                    std::vector<NDArray>* data,
                    std::vector<std::string>* keys);
+  /*!
+   * \brief Save list of narray in the aligned format, in which the arrays start
+   *  at aligned offsets after an index, so that LoadMapped can use the file
+   *  without copy. Load reads both formats.
+   * \param fo The stream of output.
+   * \param data the NDArrays to be saved.
+   * \param names the name of the NDArray, optional, can be zero length.
+   */
+  static void SaveAligned(dmlc::Stream* fo,
+                          const std::vector<NDArray>& data,
+                          const std::vector<std::string>& names);
+  /*!
+   * \brief Load list of narray of a local file by mapping it in memory.
+   *
+   *  The arrays of a file in the aligned format are cpu NDArrays of the mapped
+   *  pages, which are read from the disk on their first access and shared by
+   *  the processes mapping the file. Writes to them are private to the process.
+   *  Files in the other format, or not local, are read by Load.
+   * \param fname The name of the file.
+   * \param data the NDArrays to be loaded
+   * \param keys the name of the NDArray, if saved in the file.
+   */
+  /*!
+   * \brief Save list of narray to a file in the aligned format in the background.
+   *
+   *  The arrays are copied to cpu, in pinned memory for the gpu ones, by the
+   *  engine after their pending writes, and the file is written by another
+   *  thread. It returns immediately, so the arrays can be updated while the
+   *  file is written, and Engine::WaitForAll waits for the file to be closed.
+   *  An error is logged instead of raised.
+   * \param fname The name of the file.
+   * \param data the NDArrays to be saved.
+   * \param names the name of the NDArray, optional, can be zero length.
+   */
+  static void SaveAsync(const std::string& fname,
+                        const std::vector<NDArray>& data,
+                        const std::vector<std::string>& names);
+  static void LoadMapped(const std::string& fname,
+                         std::vector<NDArray>* data,
+                         std::vector<std::string>* keys);
+  /*!
+   * \brief Load list of narray of a file to the contexts they were saved from.
+   *
+   *  The arrays of a local file in the aligned format are copied from the
+   *  mapped pages by the engine, so that they are read and copied to the
+   *  devices in parallel, and returned before the copies finish. The other
+   *  files are read by Load.
+   * \param fname The name of the file.
+   * \param data the NDArrays to be loaded
+   * \param keys the name of the NDArray, if saved in the file.
+   */
+  static void LoadParallel(const std::string& fname,
+                           std::vector<NDArray>* data,
+                           std::vector<std::string>* keys);
 
  private:
   /*! \brief the real data chunk that backs NDArray */
@@ -300,6 +425,10 @@ class NDArray {
     bool static_data;
     /*! \brief whether allocation is delayed */
     bool delay_alloc;
+    /*! \brief keeps the static data alive, e.g. a mapped file */
+    std::shared_ptr<void> holder;
+    /*! \brief origin of a delayed allocation in the allocation trace, empty for none */
+    std::string origin;
     /*! \brief default cosntructor */
     Chunk() : static_data(true), delay_alloc(false) {
       var  = Engine::Get()->NewVariable();
@@ -324,19 +453,31 @@ class NDArray {
       var = Engine::Get()->NewVariable();
       shandle.size = size * mshadow::mshadow_sizeof(dtype);
       shandle.ctx = ctx;
-      if (!delay_alloc_) this->CheckAndAlloc();
+      if (!delay_alloc_) {
+        this->CheckAndAlloc();
+      } else if (Storage::GetAllocOrigin() != nullptr) {
+        // allocated later, usually by an engine thread
+        origin = Storage::GetAllocOrigin();
+      }
     }
     /*! \brief check if delay alloc is on, do alloc if not yet done */
     inline void CheckAndAlloc(void) {
       if (delay_alloc) {
-        shandle = Storage::Get()->Alloc(shandle.size, shandle.ctx);
+        if (origin.size() != 0) {
+          Storage::AllocOriginScope scope(origin.c_str());
+          shandle = Storage::Get()->Alloc(shandle.size, shandle.ctx);
+        } else {
+          shandle = Storage::Get()->Alloc(shandle.size, shandle.ctx);
+        }
         delay_alloc = false;
       }
     }
     /*! \brief destructor */
     ~Chunk() {
       if (static_data || delay_alloc) {
-        Engine::Get()->DeleteVariable([](RunContext s) {}, shandle.ctx, var);
+        // the holder is released after the pending operations
+        std::shared_ptr<void> h = holder;
+        Engine::Get()->DeleteVariable([h](RunContext s) {}, shandle.ctx, var);
       } else {
         Storage::Handle h = this->shandle;
         Engine::Get()->DeleteVariable([h](RunContext s) {
@@ -351,6 +492,8 @@ class NDArray {
   TShape shape_;
   /*! \brief offset in chunk */
   size_t offset_;
+  /*! \brief number of elements between the rows of the last dimension, 0 if contiguous */
+  index_t stride_;
   /*! \brief type of data */
   int dtype_;
 };
@@ -376,6 +519,20 @@ void CopyFromTo(const NDArray &from, NDArray *to, int priority = 0);
  */
 void ElementwiseSum(const std::vector<NDArray> &source, NDArray *out, int priority = 0);
 
+/*!
+ * \brief Evaluate an elementwise arithmetic expression of float32 arrays of the same
+ *  shape in one pass, without temporary arrays. out can also be one of the inputs.
+ * \param program the expression in postfix, space separated tokens of iK for the
+ *  K-th input, sK for the K-th scalar, and + - * / for the arithmetic
+ * \param inputs the contiguous inputs
+ * \param scalars the scalars
+ * \param out the target ndarray
+ */
+void FusedElemwise(const std::string &program,
+                   const std::vector<NDArray> &inputs,
+                   const std::vector<real_t> &scalars,
+                   NDArray *out);
+
 /*!
  * \brief elementwise add
  * \param lhs left operand
@@ -477,7 +634,12 @@ enum NDArrayFunctionTypeMask {
    *  most function should support this, except copy between different
    *  devices, which requires the NDArray to be pre-initialized with context
    */
-  kAcceptEmptyMutateTarget = 1 << 2
+  kAcceptEmptyMutateTarget = 1 << 2,
+  /*!
+   * \brief whether this function reads and writes the strided views of
+   *  NDArray::SliceAxis, otherwise they are given as contiguous copies
+   */
+  kAcceptStridedArgs = 1 << 3
 };
 /*! \brief Registry entry for NDArrayFunction */
 struct NDArrayFunctionReg
@@ -35,6 +35,16 @@ enum OpReqType {
   kAddTo
 };
 
+/*! \brief memory layout of the 4D float data of an operator on cpu */
+enum DataLayout {
+  /*! \brief the operator computes each element alone and runs on the layout of its inputs */
+  kLayoutAny = -1,
+  /*! \brief the plain (batch, channel, y, x) order */
+  kLayoutNCHW = 0,
+  /*! \brief channels blocked by 8, stored as (batch, channel / 8, y, x, 8) */
+  kLayoutNCHW8c = 1
+};
+
 /*!
  * \brief All the possible information needed by Operator.Forward and Backward
  *  This is the superset of RunContext.
@@ -336,6 +346,28 @@ class OperatorProperty {
       const std::vector<TShape> &in_shape) const {
     return std::vector<ResourceRequest>();
   }
+  /*!
+   * \brief Declare the memory layouts the operator runs on cpu, the preferred first.
+   *  The executor only calls it for a node whose inputs and outputs are all 4D float32
+   *  with a multiple of 8 channels, and puts all of them in the chosen layout.
+   *  An operator listing a blocked layout has a layout parameter that the executor sets.
+   * \param in_shape The input shape to the operator, corresponds to shapes of in_data.
+   * \return the supported layouts, {kLayoutAny} for element-wise operators
+   */
+  virtual std::vector<int> ListCPULayouts(const std::vector<TShape> &in_shape) const {
+    return std::vector<int>{kLayoutNCHW};
+  }
+  /*!
+   * \brief Declare the inputs the forward pass reads in any float type, converting
+   *  each element to the operator's type on load. The executor then gives such an
+   *  input the storage of the Cast that produces it, and skips the Cast, when only
+   *  forward passes that convert on load read the Cast output.
+   * \param ctx The context the operator runs on.
+   * \return the indices of such inputs in in_data
+   */
+  virtual std::vector<int> CastOnLoadInputs(const Context &ctx) const {
+    return std::vector<int>();
+  }
   /*!
    * \brief Declare the input requirement of Backward pass.
    *
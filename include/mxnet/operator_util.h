@@ -381,6 +381,14 @@ class SimpleOpRegEntry {
   virtual TSelf& set_gradient(int dev_mask,
                               BinaryGradFunctionT1 fgrad,
                               SimpleOpInplaceOption inplace_out_lhs_grad) = 0;
+  /*!
+   * \brief set whether the imperative function reads and writes the strided
+   *  views of NDArray::SliceAxis directly, e.g. with the FlatTo2D tensors of
+   *  the TBlobs. Otherwise they are given as contiguous copies.
+   *  This must be called after set_function.
+   * \param accept_strided whether to accept strided views.
+   */
+  virtual TSelf& set_accept_strided(bool accept_strided) = 0;
   /*!
    * \brief Describe the function.
    * \param description The description of the function.
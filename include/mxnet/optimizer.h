@@ -57,6 +57,39 @@ class Optimizer {
    */
   virtual void Update(const int index, NDArray *weight,
                       const NDArray *grad, const float lr, const float wd) = 0;
+  /*!
+   *  \brief Update a list of weights with their gradients. Optimizers can
+   *  fuse the updates of the weights on the same device, by default the
+   *  weights are updated one by one.
+   *  \param indices the unique index of each weight.
+   *  \param weights the weights to update.
+   *  \param grads gradient for each weight.
+   *  \param lrs learning rate for each update.
+   *  \param wds weight decay for each update.
+   */
+  virtual void UpdateMulti(const std::vector<int>& indices,
+                           const std::vector<NDArray*>& weights,
+                           const std::vector<const NDArray*>& grads,
+                           const std::vector<float>& lrs,
+                           const std::vector<float>& wds) {
+    for (size_t i = 0; i < indices.size(); ++i) {
+      Update(indices[i], weights[i], grads[i], lrs[i], wds[i]);
+    }
+  }
+  /*!
+   *  \brief Update a weight with a row sparse gradient, whose rows other than
+   *  row_ids are zero. Optimizers can update the given rows only, by default
+   *  the gradient is made dense for Update.
+   *  \param index the unique index for the weight.
+   *  \param weight the weight to update, of shape (num_rows, ...).
+   *  \param row_ids the sorted unique 0-based row indices in the real type, on
+   *   cpu. They are read when this function is called.
+   *  \param grad the gradient of the rows, of shape (row_ids.Size(), ...).
+   *  \param lr learning rate for this update.
+   *  \param wd weight decay for this update.
+   */
+  virtual void UpdateRowSparse(const int index, NDArray *weight, const NDArray &row_ids,
+                               const NDArray *grad, const float lr, const float wd);
   /*!
    * \brief create Optimizer
    * \param type_name the type string of the Optimizer
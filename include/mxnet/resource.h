@@ -21,7 +21,12 @@ struct ResourceRequest {
     /*! \brief mshadow::Random<xpu> object */
     kRandom,
     /*! \brief A dynamic temp space that can be arbitrary size */
-    kTempSpace
+    kTempSpace,
+    /*!
+     * \brief ParallelRandomState of a counter based generator, whose
+     *  copies can be used by concurrent operations
+     */
+    kParallelRandom
   };
   /*! \brief type of resources */
   Type type;
@@ -36,6 +41,22 @@ struct ResourceRequest {
 };
 
 
+/*!
+ * \brief State of a counter based random number generator.
+ *
+ *  The n-th number of the sequence is given by (key, stream, counter + n / 4),
+ *  so that the numbers can be generated in parallel without shared state.
+ *  An operation sampling n numbers advances the counter by n.
+ */
+struct ParallelRandomState {
+  /*! \brief the key given by the seed of the device */
+  uint32_t key[2];
+  /*! \brief the copy of the resource */
+  uint32_t stream;
+  /*! \brief the offset of the next number in units of 4 numbers */
+  uint64_t counter;
+};
+
 /*!
  * \brief Resources used by mxnet operations.
  *  A resource is something special other than NDArray,
@@ -70,6 +91,15 @@ struct Resource {
     ret->set_stream(stream);
     return ret;
   }
+  /*!
+   * \brief Get the state of a counter based random number generator,
+   *  to sample with the functions of src/common/philox.h.
+   * \return the state, owned by the resource.
+   */
+  inline ParallelRandomState* get_parallel_random() const {
+    CHECK_EQ(req.type, ResourceRequest::kParallelRandom);
+    return static_cast<ParallelRandomState*>(ptr_);
+  }
   /*!
    * \brief Get space requested as mshadow Tensor.
    *  The caller can request arbitrary size.
@@ -141,9 +171,8 @@ struct Resource {
    *  The existing allocated address will remain valdd
    *  until release is called.
    *
-   *  Even if user do not call release, the space occupation
-   *  of the resource will remain at most two times of maximum
-   *  requested space.
+   *  Even if user do not call release, a space replaced by a
+   *  bigger one is freed after the operation using it completes.
    */
   void release() const;
   /*!
@@ -177,6 +206,21 @@ class ResourceManager {
    * \param seed the seed to the random number generators on all devices.
    */
   virtual void SeedRandom(uint32_t seed) = 0;
+  /*!
+   * \brief Free the temp space of a device once the operations using it complete.
+   *
+   *  The temp space is also shrunk when it is much bigger than the recent
+   *  requests, and released when an allocation of the device fails.
+   * \param ctx the device.
+   */
+  virtual void ReleaseTempSpace(Context ctx) = 0;
+  /*!
+   * \brief Get the usage of the temp space of a device.
+   * \param ctx the device.
+   * \param bytes the bytes held by the temp space.
+   * \param num_bound the number of copies of the temp space bound to requests.
+   */
+  virtual void GetTempSpaceStats(Context ctx, size_t* bytes, int* num_bound) = 0;
   /*! \brief virtual destructor */
   virtual ~ResourceManager() DMLC_THROW_EXCEPTION {}
   /*!
@@ -7,6 +7,8 @@
 #define MXNET_STORAGE_H_
 
 #include <memory>
+#include <ostream>
+#include <string>
 #include "./base.h"
 
 namespace mxnet {
@@ -45,6 +47,73 @@ class MXNET_API Storage {
    * \param handle Handle struect.
    */
   virtual void Free(Handle handle) = 0;
+  /*!
+   * \brief Get memory statistics of a device.
+   * \param ctx Context information about the device and ID.
+   * \param used Bytes currently allocated by users.
+   * \param cached Bytes held by the memory pool but currently free.
+   * \param wasted Bytes lost to size class rounding of allocated blocks.
+   */
+  virtual void GetStats(Context ctx, size_t* used, size_t* cached, size_t* wasted) = 0;
+  /*!
+   * \brief Get statistics of the memory arena of a device, reserved up front
+   *  when MXNET_GPU_MEM_ARENA_FRACTION is set.
+   * \param ctx Context information about the device and ID.
+   * \param capacity Bytes reserved, 0 when the device has no arena.
+   * \param free Bytes free in the arena.
+   * \param largest_free Bytes of the largest free block of the arena.
+   * \param overflow Bytes allocated outside of the arena once it was full.
+   */
+  virtual void GetArenaStats(Context ctx, size_t* capacity, size_t* free,
+                             size_t* largest_free, size_t* overflow) = 0;
+  /*!
+   * \brief Pin existing host memory, such as the buffers of a data iterator,
+   *  so that the copies from and to the gpu use it directly, asynchronously.
+   * \param ptr Pointer to the memory.
+   * \param size Size of the memory in bytes.
+   */
+  virtual void RegisterHostMemory(void* ptr, size_t size) = 0;
+  /*!
+   * \brief Unpin host memory pinned by RegisterHostMemory, before it is freed.
+   * \param ptr Pointer to the memory.
+   */
+  virtual void UnregisterHostMemory(void* ptr) = 0;
+  /*!
+   * \brief Write the allocation trace as JSON: for each context, the bytes
+   *  allocated by each origin now and at the peak, and the timeline of the peak.
+   *  The trace is recorded when MXNET_STORAGE_TRACE is set.
+   * \param os the stream to write to.
+   */
+  virtual void DumpTrace(std::ostream* os) = 0;
+  /*!
+   * \brief Limit the bytes allocated by an origin, such as a model, on each device.
+   *  An allocation of the origin over its quota fails.
+   * \param origin the origin.
+   * \param bytes the quota, 0 for no limit.
+   */
+  virtual void SetOriginQuota(const std::string& origin, size_t bytes) = 0;
+  /*! \return whether the allocations are traced, set by MXNET_STORAGE_TRACE */
+  static bool TraceEnabled();
+  /*!
+   * \brief Set the origin of the allocations of the calling thread, such as
+   *  "workspace" or the name of an operator, reported by the allocation trace
+   *  and charged to the quota of the origin.
+   * \param origin a string alive until the origin is set again, nullptr for none.
+   * \return the previous origin.
+   */
+  static const char* SetAllocOrigin(const char* origin);
+  /*! \return the origin of the allocations of the calling thread, nullptr for none */
+  static const char* GetAllocOrigin();
+  /*! \brief set the allocation origin of the calling thread within a scope */
+  class AllocOriginScope {
+   public:
+    explicit AllocOriginScope(const char* origin) : prev_(SetAllocOrigin(origin)) {}
+    ~AllocOriginScope() { SetAllocOrigin(prev_); }
+
+   private:
+    /*! \brief the origin restored at the end of the scope */
+    const char* prev_;
+  };
   /*!
    * \brief Destructor.
    */
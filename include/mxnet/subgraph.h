@@ -0,0 +1,80 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file subgraph.h
+ * \brief backends executing the subgraphs of the nodes they support,
+ *  such as vendor inference libraries. The executor groups the supported
+ *  nodes into _Subgraph nodes, see MXNET_SUBGRAPH_BACKEND.
+ */
+#ifndef MXNET_SUBGRAPH_H_
+#define MXNET_SUBGRAPH_H_
+
+#include <dmlc/registry.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "./base.h"
+#include "./operator.h"
+
+namespace mxnet {
+/*!
+ * \brief an external runtime executing subgraphs. It declares the nodes it
+ *  supports, and creates the operator of a subgraph of them.
+ */
+class SubgraphBackend {
+ public:
+  /*! \brief virtual destructor */
+  virtual ~SubgraphBackend() {}
+  /*!
+   * \brief whether a node can be in a subgraph of the backend
+   * \param op the operator of the node
+   * \param in_shapes the shapes of its inputs, empty when unknown
+   * \param ctx the context the node runs on
+   */
+  virtual bool Supports(const OperatorProperty &op,
+                        const std::vector<TShape> &in_shapes,
+                        const Context &ctx) const = 0;
+  /*!
+   * \brief create the operator of a subgraph
+   * \param symbol_json the subgraph as the json of a symbol, its variables are
+   *  named arg0, arg1, ... by the position of the input they stand for
+   * \param ctx the context to run on
+   * \param in_shapes the shapes of the inputs
+   * \param in_types the types of the inputs
+   * \return the operator, whose Forward takes the inputs in their order and
+   *  writes the outputs of the symbol. Only the Forward is called.
+   */
+  virtual Operator* CreateOperator(const std::string &symbol_json,
+                                   Context ctx,
+                                   const std::vector<TShape> &in_shapes,
+                                   const std::vector<int> &in_types) const = 0;
+  /*!
+   * \return the backend registered with a name, created on first use and kept
+   *  for the life of the process, nullptr if there is none
+   */
+  static SubgraphBackend* Get(const std::string &name);
+};
+
+/*! \brief typedef the factory function of subgraph backends */
+typedef std::function<SubgraphBackend *()> SubgraphBackendFactory;
+/*!
+ * \brief Registry entry for SubgraphBackend factory functions.
+ */
+struct SubgraphBackendReg
+    : public dmlc::FunctionRegEntryBase<SubgraphBackendReg,
+                                        SubgraphBackendFactory> {
+};
+/*!
+ * \brief Macro to register a subgraph backend
+ *
+ * \code
+ * MXNET_REGISTER_SUBGRAPH_BACKEND(mylib)
+ * .describe("Runs the convolutions and activations with mylib")
+ * .set_body([]() {
+ *     return new MyLibBackend();
+ *   });
+ * \endcode
+ */
+#define MXNET_REGISTER_SUBGRAPH_BACKEND(name)                           \
+  DMLC_REGISTRY_REGISTER(::mxnet::SubgraphBackendReg, SubgraphBackendReg, name)
+}  // namespace mxnet
+#endif  // MXNET_SUBGRAPH_H_
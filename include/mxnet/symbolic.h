@@ -230,6 +230,29 @@ class Symbol {
    * \param reader the JSON read to read json.
    */
   void Load(dmlc::JSONReader *reader);
+  /*!
+   * \brief save the symbol in the binary format, which loads much faster than JSON.
+   *  JSON remains the interchange format between versions and language bindings.
+   * \param fo the stream to write to.
+   */
+  void Save(dmlc::Stream *fo) const;
+  /*!
+   * \brief load the symbol from the binary format.
+   * \param fi the stream to read from.
+   * \return whether the load succeeded, false when the stream is not a binary symbol.
+   */
+  bool Load(dmlc::Stream *fi);
+  /*!
+   * \brief load the symbol from a buffer in either the binary format or JSON.
+   * \param data the content of the buffer.
+   * \param size the number of bytes of the buffer.
+   */
+  void LoadBuffer(const char *data, size_t size);
+  /*!
+   * \brief load the symbol from a file in either the binary format or JSON.
+   * \param fname the name of the file, can be a URI such as s3:// and hdfs://.
+   */
+  void LoadFile(const std::string &fname);
   /*!
    * \brief get number of outputs of this symbol
    * \return number of outputs
@@ -306,6 +329,13 @@ class Symbol {
    * \param out_graph the pointer holder of the output graph
    */
   void ToStaticGraph(StaticGraph *out_graph) const;
+  /*!
+   * \brief Convert symbol into internal static graph, with the inference memo
+   *  of the last graphs converted from the same unchanged nodes.
+   *
+   * \param out_graph the pointer holder of the output graph
+   */
+  void ToCachedStaticGraph(StaticGraph *out_graph) const;
   /*!
    * \brief create equivalence of symbol from static graphs.
    *  This operation will change the content of current symbol.
@@ -353,11 +383,65 @@ class Executor {
    * \param os the output stream we like to print to.
    */
   virtual void Print(std::ostream &os) const {} // NOLINT(*)
+  /*!
+   * \brief print the estimated cost of each node as json, its flops, the bytes
+   *  it reads and writes, of its parameters and of its workspace, with the
+   *  totals of the forward and backward passes and their arithmetic intensity.
+   * \param os the output stream we like to print to.
+   */
+  virtual void PrintCost(std::ostream &os) const {} // NOLINT(*)
+  /*!
+   * \brief enable or disable the timing of each node. The nodes, including those
+   *  bulked into segments, are timed by events on their gpu stream, or by the
+   *  host clock on a cpu, and their times are summed over the iterations.
+   *  Timing waits for the kernels of each node, so it slows down the execution.
+   * \param enable whether to time the nodes.
+   */
+  virtual void SetProfiling(bool enable) {}
+  /*!
+   * \brief set the priority of the executor over the others. Its operations are pushed
+   *  with the priority of their critical path plus priority * kHighPriority, those of
+   *  a positive priority are latency critical and those of a negative one run after
+   *  the others.
+   * \param priority the priority, 0 by default.
+   */
+  virtual void SetPriority(int priority) {}
+  /*!
+   * \brief do at once the work the first forward would do lazily, so that it runs
+   *  as fast as the next ones: touch the planned memory, then run an inference
+   *  forward on the bound arrays, which creates the engine workers and streams of
+   *  the devices, grows the temporary space and selects the algorithms of the
+   *  operators. It waits for the forward, whose outputs are then meaningless unless
+   *  the inputs were set.
+   */
+  virtual void Warmup() {}
+  /*!
+   * \brief print the times of each node timed by SetProfiling as json, and the
+   *  mean times of the forward and backward passes.
+   * \param os the output stream we like to print to.
+   * \param reset whether to clear the times after printing them.
+   */
+  virtual void PrintProfile(std::ostream &os, bool reset) {} // NOLINT(*)
   /*!
    * \brief get array of outputs in the executor.
    * \return array of outputs in the executor.
    */
   virtual const std::vector<NDArray> &outputs() const = 0;
+  /*!
+   * \brief Create an executor of the same graph with new shapes of the arguments.
+   *  The graph, context assignment and gradient requests of this executor are reused,
+   *  and the memory is shared with it, so the two cannot run in parallel.
+   *  Operators whose input shapes do not change are shared as well.
+   *
+   * \param in_args the NDArray that stores the input arguments, of the new shapes.
+   * \param arg_grad_store NDArray that is used to store the gradient of the arguments,
+   *  can be empty NDArray where this executor does not request the gradient.
+   * \param aux_states NDArray that is used as internal state in op.
+   * \return a new executor.
+   */
+  virtual Executor *Reshape(const std::vector<NDArray> &in_args,
+                            const std::vector<NDArray> &arg_grad_store,
+                            const std::vector<NDArray> &aux_states) = 0;
   /*!
    * \brief Create an operator by bind symbol with context and arguments.
    *  If user do not want to compute the gradients of i-th argument, grad_req_type[i] can be kNullOp.
@@ -370,6 +454,8 @@ class Executor {
    * \param grad_req_type requirment type of gradient saving. Can only be in {kNullOp, kAddTo, kWriteTo}.
    * \param aux_states NDArray that is used as internal state in op
    * \param shared_exec input executor to share memory with.
+   * \param mem_budget memory budget of each context in bytes, forward nodes are
+   *  recomputed in backward to fit in it. 0 means no budget.
    * \return a new executor.
    */
   static Executor *Bind(Symbol symbol,
@@ -379,7 +465,8 @@ class Executor {
                         const std::vector<NDArray> &arg_grad_store,
                         const std::vector<OpReqType> &grad_req_type,
                         const std::vector<NDArray> &aux_states,
-                        Executor* shared_exec = NULL);
+                        Executor* shared_exec = NULL,
+                        size_t mem_budget = 0);
   /*!
    * \brief the prototype of user-defined monitor callback
    */
@@ -388,6 +475,18 @@ class Executor {
    * \brief Install a callback to notify the completion of operation.
    */
   virtual void SetMonitorCallback(const MonitorCallback& callback) {}
+  /*!
+   * \brief the prototype of callback notified with the index of an argument
+   *  whose gradient operator has been pushed to the engine.
+   */
+  typedef std::function<void(uint32_t)> GradReadyCallback;
+  /*!
+   * \brief Install a callback called during Backward, once for each argument with gradient,
+   *  right after the operator writing its gradient is pushed.
+   *  Operations pushed in the callback that read the gradient are scheduled after it,
+   *  so communication can start while the rest of the backward pass is running.
+   */
+  virtual void SetGradReadyCallback(const GradReadyCallback& callback) {}
 };  // class operator
 }  // namespace mxnet
 #endif  // MXNET_SYMBOLIC_H_
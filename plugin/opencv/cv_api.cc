@@ -7,7 +7,11 @@
 #include <dmlc/base.h>
 #include <mxnet/base.h>
 #include <mxnet/ndarray.h>
+#include <dmlc/omp.h>
 #include <opencv2/opencv.hpp>
+#include <memory>
+#include <string>
+#include <vector>
 #include "cv_api.h"
 #include "../../src/c_api/c_api_error.h"
 
@@ -147,3 +151,58 @@ MXNET_DLL int MXCVcopyMakeBorder(NDArrayHandle src,
   *out = tmp;
   API_END();
 }
+
+MXNET_DLL int MXCVImdecodeBatch(const mx_uint num,
+                                const unsigned char **imgs,
+                                const mx_uint *lens,
+                                const int flag,
+                                const int interpolation,
+                                const int nthreads,
+                                NDArrayHandle out) {
+  API_BEGIN();
+  NDArray ndout = *static_cast<NDArray*>(out);
+  CHECK_GE(flag, 0) << "flag must be 0 (grayscale) or 1 (colored).";
+  CHECK_EQ(ndout.shape().ndim(), 4) << "out must be (num, height, width, channels)";
+  CHECK_EQ(ndout.ctx(), Context::CPU());
+  CHECK(ndout.dtype() == mshadow::kUint8 || ndout.dtype() == mshadow::kFloat32)
+      << "out must be uint8 or float32";
+  CHECK_LE(num, ndout.shape()[0]) << "more images than the batch size";
+  const int c = flag == 0 ? 1 : 3;
+  CHECK_EQ(ndout.shape()[3], c) << "channels of out do not match flag";
+  // the buffers of the caller may go before the operation runs
+  std::shared_ptr<std::vector<std::string> > bufs = std::make_shared<std::vector<std::string> >();
+  for (mx_uint i = 0; i < num; ++i) {
+    bufs->emplace_back(reinterpret_cast<const char*>(imgs[i]), lens[i]);
+  }
+  const int h = ndout.shape()[1], w = ndout.shape()[2];
+  const int nthread = nthreads > 0 ? nthreads : omp_get_max_threads();
+  Engine::Get()->PushSync([=](RunContext ctx){
+      ndout.CheckAndAlloc();
+      const bool f32 = ndout.dtype() == mshadow::kFloat32;
+      const int type = c == 3 ? CV_8UC3 : CV_8U;
+      const size_t stride = static_cast<size_t>(h) * w * c;
+      #pragma omp parallel for num_threads(nthread) schedule(dynamic)
+      for (int i = 0; i < static_cast<int>(bufs->size()); ++i) {
+        const std::string &str = (*bufs)[i];
+        cv::Mat buf(1, str.size(), CV_8U, const_cast<char*>(str.data()));
+        cv::Mat img = cv::imdecode(buf, flag);
+        CHECK(!img.empty()) << "cannot decode image " << i;
+        if (f32) {
+          cv::Mat dst(h, w, c == 3 ? CV_32FC3 : CV_32F,
+                      static_cast<float*>(ndout.data().dptr_) + i * stride);
+          if (img.rows != h || img.cols != w) {
+            cv::resize(img, img, cv::Size(w, h), 0, 0, interpolation);
+          }
+          img.convertTo(dst, dst.type());
+        } else {
+          cv::Mat dst(h, w, type, static_cast<uint8_t*>(ndout.data().dptr_) + i * stride);
+          if (img.rows != h || img.cols != w) {
+            cv::resize(img, dst, cv::Size(w, h), 0, 0, interpolation);
+          } else {
+            img.copyTo(dst);
+          }
+        }
+      }
+    }, ndout.ctx(), {}, {ndout.var()}, FnProperty::kNormal, 0, "ImdecodeBatch");
+  API_END();
+}
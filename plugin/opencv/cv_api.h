@@ -32,4 +32,25 @@ MXNET_DLL int MXCVcopyMakeBorder(
   const double value,
   NDArrayHandle *out);
 
+/*!
+ * \brief decode a batch of images, resize them and write them into a batch,
+ *  in parallel and in a single engine operation.
+ * \param num number of images
+ * \param imgs the encoded images
+ * \param lens the bytes of each image
+ * \param flag 0 (grayscale) or 1 (colored)
+ * \param interpolation the interpolation of the resize
+ * \param nthreads number of decoding threads, 0 for the openmp default
+ * \param out the batch, (num, height, width, channels) of uint8 or float32 on cpu
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXCVImdecodeBatch(
+  const mx_uint num,
+  const unsigned char **imgs,
+  const mx_uint *lens,
+  const int flag,
+  const int interpolation,
+  const int nthreads,
+  NDArrayHandle out);
+
 #endif  // PLUGIN_OPENCV_CV_API_H_
@@ -31,6 +31,44 @@ def imdecode(str_img, flag=1):
                                  flag, ctypes.byref(hdl)))
     return mx.nd.NDArray(hdl)
 
+def imdecode_batch(str_imgs, size, out=None, flag=1,
+                   interpolation=cv2.INTER_LINEAR, num_threads=0):
+    """Decode a batch of images from str buffers and resize them to size.
+    The images are decoded in parallel by a single engine operation, which
+    runs while the previous batches are still computed.
+
+    Parameters
+    ----------
+    str_imgs : list of str
+        str buffers read from image files
+    size : tuple
+        target size in (width, height)
+    out : NDArray
+        batch of (n, height, width, channels) uint8 or float32 on cpu,
+        n at least len(str_imgs). A uint8 batch is created if None.
+    flag : int
+        same as flag for cv2.imdecode
+    interpolation : int
+        same as interpolation for cv2.imresize
+    num_threads : int
+        number of decoding threads, 0 for the default
+
+    Returns
+    -------
+    out : NDArray
+        the batch, with BGR color channel order
+    """
+    if out is None:
+        out = mx.nd.empty((len(str_imgs), size[1], size[0], 3 if flag else 1),
+                          dtype='uint8')
+    bufs = (ctypes.c_char_p * len(str_imgs))(*str_imgs)
+    lens = (mx_uint * len(str_imgs))(*[len(s) for s in str_imgs])
+    check_call(_LIB.MXCVImdecodeBatch(mx_uint(len(str_imgs)),
+                                      ctypes.cast(bufs, ctypes.POINTER(ctypes.c_char_p)),
+                                      lens, flag, interpolation,
+                                      num_threads, out.handle))
+    return out
+
 def resize(src, size, interpolation=cv2.INTER_LINEAR):
     """Decode image from str buffer.
     Wrapper for cv2.imresize that uses mx.nd.NDArray
@@ -1,7 +1,7 @@
 /*!
  * Copyright (c) 2015 by Contributors
- * \file iter_sframe_image.cc
- * \brief
+ * \file iter_sframe.cc
+ * \brief iterators over the images or arrays of an sframe
  * \author Bing Xu
 */
 
@@ -9,10 +9,15 @@
 #include <dmlc/base.h>
 #include <dmlc/io.h>
 #include <dmlc/omp.h>
+#include <dmlc/common.h>
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
+#include <dmlc/threadediter.h>
+#include <algorithm>
 #include <string>
 #include <memory>
+#include <utility>
+#include <vector>
 #include <unity/lib/image_util.hpp>
 #include <unity/lib/gl_sframe.hpp>
 #include <unity/lib/gl_sarray.hpp>
@@ -33,6 +38,12 @@ struct SFrameParam : public dmlc::Parameter<SFrameParam> {
   std::string label_field;
   TShape data_shape;
   TShape label_shape;
+  /*! \brief a sequence of names of image augmenters, seperated by , */
+  std::string aug_seq;
+  /*! \brief number of threads reading and decoding the rows */
+  int preprocess_threads;
+  /*! \brief rows read by each thread per chunk */
+  int rows_per_thread;
   DMLC_DECLARE_PARAMETER(SFrameParam) {
     DMLC_DECLARE_FIELD(path_sframe).set_default("")
     .describe("Dataset Param: path to image dataset sframe");
@@ -44,96 +55,122 @@ struct SFrameParam : public dmlc::Parameter<SFrameParam> {
     .describe("Dataset Param: input data instance shape");
     DMLC_DECLARE_FIELD(label_shape)
     .describe("Dataset Param: input label instance shape");
+    DMLC_DECLARE_FIELD(aug_seq).set_default("aug_default")
+    .describe("Augmentation Param: the augmenter names to represent"
+              " sequence of augmenters to be applied, seperated by comma.");
+    DMLC_DECLARE_FIELD(preprocess_threads).set_lower_bound(1).set_default(4)
+    .describe("Backend Param: Number of threads reading and decoding segments "
+              "of the sframe, at most the number of cores.");
+    DMLC_DECLARE_FIELD(rows_per_thread).set_lower_bound(1).set_default(256)
+    .describe("Backend Param: Number of rows read by each thread per chunk.");
   }
-};  // struct SFrameImageParam
+};  // struct SFrameParam
 
-class SFrameIterBase : public IIterator<DataInst> {
+/*!
+ * \brief parser of an sframe into chunks of instances.
+ *
+ *  Only the data and label columns are read. A chunk is preprocess_threads
+ *  consecutive segments of rows_per_thread rows, each thread of the openmp
+ *  pool reads its segment with its own range iterator and decodes it, as
+ *  ImageRecordIOParser does for the records of a chunk.
+ */
+class SFrameParser {
  public:
-  SFrameIterBase() {}
-
-  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+  /*!
+   * \brief initialize the parser
+   * \param image whether the data column holds images, or arrays otherwise
+   */
+  inline void Init(const std::vector<std::pair<std::string, std::string> >& kwargs,
+                   bool image) {
     param_.InitAllowUnknown(kwargs);
+    image_ = image;
+    if (image_) {
+      CHECK_EQ(param_.data_shape.ndim(), 3)
+        << "Image shape must be (channel, height, width)";
+    }
+    int maxthread, threadget;
+    #pragma omp parallel
+    {
+      maxthread = std::max(omp_get_num_procs(), 1);
+    }
+    param_.preprocess_threads = std::min(maxthread, param_.preprocess_threads);
+    #pragma omp parallel num_threads(param_.preprocess_threads)
+    {
+      threadget = omp_get_num_threads();
+    }
+    param_.preprocess_threads = threadget;
+    if (image_) {
+      std::vector<std::string> aug_names = dmlc::Split(param_.aug_seq, ',');
+      augmenters_.resize(threadget);
+      for (int i = 0; i < threadget; ++i) {
+        for (const auto& aug_name : aug_names) {
+          augmenters_[i].emplace_back(ImageAugmenter::Create(aug_name));
+          augmenters_[i].back()->Init(kwargs);
+        }
+      }
+    }
+    for (int i = 0; i < threadget; ++i) {
+      prnds_.emplace_back(new common::RANDOM_ENGINE((i + 1) * kRandMagic));
+    }
+    // project the needed columns, the others are never read
     sframe_ = graphlab::gl_sframe(param_.path_sframe)[{param_.data_field, param_.label_field}];
-    range_it_.reset(new graphlab::gl_sframe_range(sframe_.range_iterator()));
+    num_rows_ = sframe_.size();
     this->BeforeFirst();
   }
-
-  virtual ~SFrameIterBase() {}
-
-  virtual void BeforeFirst() {
-    idx_ = 0;
-    *range_it_ = sframe_.range_iterator();
-    current_it_ = range_it_->begin();
-  }
-
-  virtual const DataInst &Value(void) const {
-    return out_;
+  /*! \brief rewind to the first row */
+  inline void BeforeFirst() {
+    row_ = 0;
   }
-
-  virtual bool Next() = 0;
-
- protected:
-  /*! \brief index of instance */
-  index_t idx_;
-  /*! \brief output of sframe iterator */
-  DataInst out_;
-  /*! \brief temp space */
-  InstVector tmp_;
-  /*! \brief sframe iter parameter */
-  SFrameParam param_;
-  /*! \brief sframe object*/
-  graphlab::gl_sframe sframe_;
-  /*! \brief sframe range iterator */
-  std::unique_ptr<graphlab::gl_sframe_range> range_it_;
-  /*! \brief current iterator in range iterator */
-  graphlab::gl_sframe_range::iterator current_it_;
-
- protected:
-  /*! \brief copy data */
-  template<int dim>
-  void Copy_(mshadow::Tensor<cpu, dim> tensor, const graphlab::flex_vec &vec) {
-    CHECK_EQ(tensor.shape_.Size(), vec.size());
-    CHECK_EQ(tensor.CheckContiguous(), true);
-    mshadow::Tensor<cpu, 1> flatten(tensor.dptr_, mshadow::Shape1(tensor.shape_.Size()));
-    for (index_t i = 0; i < vec.size(); ++i) {
-      flatten[i] = static_cast<float>(vec[i]);
+  /*! \brief parse the next chunk, one instance vector per thread */
+  inline bool ParseNext(std::vector<InstVector> *out_vec) {
+    if (row_ >= num_rows_) return false;
+    const size_t begin = row_;
+    const size_t seg = static_cast<size_t>(param_.rows_per_thread);
+    row_ = std::min(num_rows_, begin + seg * param_.preprocess_threads);
+    out_vec->resize(param_.preprocess_threads);
+    #pragma omp parallel num_threads(param_.preprocess_threads)
+    {
+      CHECK(omp_get_num_threads() == param_.preprocess_threads);
+      const int tid = omp_get_thread_num();
+      InstVector &out = (*out_vec)[tid];
+      out.Clear();
+      const size_t sbegin = std::min(row_, begin + seg * tid);
+      const size_t send = std::min(row_, sbegin + seg);
+      if (sbegin != send) {
+        graphlab::gl_sframe_range range = sframe_.range_iterator(sbegin, send);
+        size_t index = sbegin;
+        for (auto it = range.begin(); it != range.end(); ++it, ++index) {
+          if (image_) {
+            this->PushImage(*it, index, tid, &out);
+          } else {
+            this->PushArray(*it, index, &out);
+          }
+        }
+      }
     }
-  }
-};  // class SFrameIterBase
-
-class SFrameImageIter : public SFrameIterBase {
- public:
-  SFrameImageIter() :
-    augmenter_(new ImageAugmenter()), prnd_(new common::RANDOM_ENGINE(8964)) {}
-
-  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
-    Parent::Init(kwargs);
-    augmenter_->Init(kwargs);
-    CHECK_EQ(Parent::param_.data_shape.ndim(), 3)
-      << "Image shpae must be (channel, height, width)";
+    return true;
   }
 
-  bool Next(void) override {
-    if (Parent::current_it_ == Parent::range_it_->end()) {
-      return false;
+ private:
+  // magic number to seed prng
+  static const int kRandMagic = 111;
+  /*! \brief decode and augment the image of a row */
+  inline void PushImage(const std::vector<graphlab::flexible_type> &row, size_t index,
+                        int tid, InstVector *out) {
+    graphlab::image_type gl_img = row[0];
+    graphlab::flex_vec gl_label = row[1];
+    CHECK_EQ(gl_label.size(), param_.label_shape.Size()) << "Label shape does not match";
+    cv::Mat buf(1, gl_img.m_image_data_size, CV_8U,
+                const_cast<unsigned char*>(gl_img.get_image_data()));
+    cv::Mat res = cv::imdecode(buf, -1);
+    for (auto& aug : augmenters_[tid]) {
+      res = aug->Process(res, prnds_[tid].get());
     }
-    graphlab::image_type gl_img = (*Parent::current_it_)[0];
-    graphlab::flex_vec gl_label = (*Parent::current_it_)[1];
-    // TODO(bing): check not decoded
-    // TODO(bing): check img shape
-    CHECK_EQ(gl_label.size(), Parent::param_.label_shape.Size()) << "Label shape does not match";
-    const unsigned char *raw_data = gl_img.get_image_data();
-    cv::Mat res;
-    cv::Mat buf(1, gl_img.m_image_data_size, CV_8U, const_cast<unsigned char*>(raw_data));
-    res = cv::imdecode(buf, -1);
-    res = augmenter_->Process(res, prnd_.get());
     const int n_channels = res.channels();
-    if (!tmp_.Size()) {
-      tmp_.Push(Parent::idx_++,
-                Parent::param_.data_shape.get<3>(),
-                Parent::param_.label_shape.get<1>());
-    }
-    mshadow::Tensor<cpu, 3> data = Parent::tmp_.data().Back();
+    out->Push(static_cast<unsigned>(index),
+              mshadow::Shape3(n_channels, res.rows, res.cols),
+              mshadow::Shape1(param_.label_shape.Size()));
+    mshadow::Tensor<cpu, 3> data = out->data().Back();
     std::vector<int> swap_indices;
     if (n_channels == 1) swap_indices = {0};
     if (n_channels == 3) swap_indices = {2, 1, 0};
@@ -146,77 +183,139 @@ class SFrameImageIter : public SFrameIterBase {
         im_data += n_channels;
       }
     }
-    mshadow::Tensor<cpu, 1> label = Parent::tmp_.label().Back();
-    Parent::Copy_<1>(label, gl_label);
-    res.release();
-    out_ = Parent::tmp_[0];
-    ++current_it_;
-    return true;
+    Copy_<1>(out->label().Back(), gl_label);
+  }
+  /*! \brief copy the array of a row */
+  inline void PushArray(const std::vector<graphlab::flexible_type> &row, size_t index,
+                        InstVector *out) {
+    graphlab::flex_vec gl_data = row[0];
+    graphlab::flex_vec gl_label = row[1];
+    CHECK_EQ(gl_data.size(), param_.data_shape.Size()) << "Data shape does not match";
+    CHECK_EQ(gl_label.size(), param_.label_shape.Size()) << "Label shape does not match";
+    out->Push(static_cast<unsigned>(index),
+              param_.data_shape.get<3>(),
+              mshadow::Shape1(param_.label_shape.Size()));
+    Copy_<3>(out->data().Back(), gl_data);
+    Copy_<1>(out->label().Back(), gl_label);
   }
+  /*! \brief copy data */
+  template<int dim>
+  static void Copy_(mshadow::Tensor<cpu, dim> tensor, const graphlab::flex_vec &vec) {
+    CHECK_EQ(tensor.shape_.Size(), vec.size());
+    CHECK_EQ(tensor.CheckContiguous(), true);
+    mshadow::Tensor<cpu, 1> flatten(tensor.dptr_, mshadow::Shape1(tensor.shape_.Size()));
+    for (index_t i = 0; i < vec.size(); ++i) {
+      flatten[i] = static_cast<float>(vec[i]);
+    }
+  }
+  /*! \brief sframe iter parameter */
+  SFrameParam param_;
+  /*! \brief whether the data column holds images */
+  bool image_;
+  /*! \brief augmenters of each thread */
+  std::vector<std::vector<std::unique_ptr<ImageAugmenter> > > augmenters_;
+  /*! \brief random engine of each thread */
+  std::vector<std::unique_ptr<common::RANDOM_ENGINE> > prnds_;
+  /*! \brief sframe object, projected on the data and label columns */
+  graphlab::gl_sframe sframe_;
+  /*! \brief number of rows */
+  size_t num_rows_;
+  /*! \brief first row of the next chunk */
+  size_t row_;
+};  // class SFrameParser
 
- private:
-  /*! \brief parent type */
-  typedef SFrameIterBase Parent;
-  /*! \brief image augmenter */
-  std::unique_ptr<ImageAugmenter> augmenter_;
-  /*! \brief randim generator*/
-  std::unique_ptr<common::RANDOM_ENGINE> prnd_;
-};  // class SFrameImageIter
-
-class SFrameDataIter : public SFrameIterBase {
+/*! \brief iterator over the instances of the chunks parsed in a background thread */
+class SFrameIter : public IIterator<DataInst> {
  public:
+  explicit SFrameIter(bool image) : image_(image), data_(nullptr) {}
+
+  virtual ~SFrameIter() {
+    iter_.Destroy();
+    delete data_;
+  }
+
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    parser_.Init(kwargs, image_);
+    // prefetch at most 4 chunks
+    iter_.set_max_capacity(4);
+    iter_.Init([this](std::vector<InstVector> **dptr) {
+        if (*dptr == nullptr) {
+          *dptr = new std::vector<InstVector>();
+        }
+        return parser_.ParseNext(*dptr);
+      },
+      [this]() { parser_.BeforeFirst(); });
+    vec_ptr_ = inst_ptr_ = 0;
+  }
+
+  void BeforeFirst() override {
+    if (data_ != nullptr) iter_.Recycle(&data_);
+    iter_.BeforeFirst();
+    vec_ptr_ = inst_ptr_ = 0;
+  }
+
   bool Next() override {
-    if (Parent::current_it_ == Parent::range_it_->end()) {
-      return false;
-    }
-    graphlab::flex_vec gl_data = (*Parent::current_it_)[0];
-    graphlab::flex_vec gl_label = (*Parent::current_it_)[1];
-    CHECK_EQ(gl_data.size(), Parent::param_.data_shape.Size()) << "Data shape does not match";
-    CHECK_EQ(gl_label.size(), Parent::param_.label_shape.Size()) << "Label shape does not match";
-    if (!Parent::tmp_.Size()) {
-        Parent::tmp_.Push(Parent::idx_++,
-                  Parent::param_.data_shape.get<3>(),
-                  Parent::param_.label_shape.get<1>());
+    while (true) {
+      if (data_ != nullptr) {
+        while (vec_ptr_ < data_->size() && inst_ptr_ >= (*data_)[vec_ptr_].Size()) {
+          ++vec_ptr_;
+          inst_ptr_ = 0;
+        }
+        if (vec_ptr_ < data_->size()) {
+          out_ = (*data_)[vec_ptr_][inst_ptr_++];
+          return true;
+        }
+        iter_.Recycle(&data_);
+      }
+      if (!iter_.Next(&data_)) return false;
+      vec_ptr_ = inst_ptr_ = 0;
     }
-    mshadow::Tensor<cpu, 3> data = Parent::tmp_.data().Back();
-    Parent::Copy_<3>(data, gl_data);
-    mshadow::Tensor<cpu, 1> label = Parent::tmp_.label().Back();
-    Parent::Copy_<1>(label, gl_label);
-    out_ = Parent::tmp_[0];
-    ++current_it_;
-    return true;
+  }
+
+  const DataInst &Value(void) const override {
+    return out_;
   }
 
  private:
-  /*! \brief parent type */
-  typedef SFrameIterBase Parent;
-};  // class SFrameDataIter
+  /*! \brief whether the data column holds images */
+  bool image_;
+  /*! \brief output of sframe iterator */
+  DataInst out_;
+  /*! \brief current chunk */
+  std::vector<InstVector> *data_;
+  /*! \brief position in the current chunk */
+  size_t vec_ptr_, inst_ptr_;
+  /*! \brief parser of the chunks */
+  SFrameParser parser_;
+  /*! \brief background thread of the parser */
+  dmlc::ThreadedIter<std::vector<InstVector> > iter_;
+};  // class SFrameIter
 
 DMLC_REGISTER_PARAMETER(SFrameParam);
 
 MXNET_REGISTER_IO_ITER(SFrameImageIter)
-.describe("Naive SFrame image iterator prototype")
+.describe("SFrame image iterator, decoding segments of rows in parallel")
 .add_arguments(SFrameParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
-.add_arguments(ImageAugmentParam::__FIELDS__())
+.add_arguments(ListDefaultAugParams())
 .add_arguments(ImageNormalizeParam::__FIELDS__())
 .set_body([]() {
     return new PrefetcherIter(
         new BatchLoader(
             new ImageNormalizeIter(
-              new SFrameImageIter())));
+              new SFrameIter(true))));
     });
 
 MXNET_REGISTER_IO_ITER(SFrameDataIter)
-.describe("Naive SFrame data iterator prototype")
+.describe("SFrame data iterator, reading segments of rows in parallel")
 .add_arguments(SFrameParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
 .set_body([]() {
     return new PrefetcherIter(
         new BatchLoader(
-              new SFrameDataIter()));
+              new SFrameIter(false)));
     });
 
 
@@ -24,6 +24,8 @@ extern "C" {
 }
 #endif  // MXNET_USE_CUDA
 
+#include <map>
+#include <utility>
 #include <vector>
 
 namespace mxnet {
@@ -49,6 +51,11 @@ class TorchState {
   template<typename xpu>
   void SetStream(mshadow::Stream<xpu>* s);
 
+  /*! \brief key of a tensor wrapper, the pointer, device and shape of its data */
+  typedef std::pair<std::pair<void*, int>, std::vector<index_t> > TensorKey;
+  /*! \brief the registry references of the tensor wrappers of TBlobs */
+  std::map<TensorKey, int> tensor_refs;
+
   void PrintState() {
     int i;
     int top = lua_gettop(L);
@@ -100,6 +107,9 @@ typedef void* THGeneralStorage;
 
 class TorchTensor {
  public:
+  /*! \brief the tensor wrappers cached by a lua state are dropped beyond this */
+  static const size_t kMaxCachedTensors = 4096;
+
   static const char* TensorType(int dev_mask) {
     switch (dev_mask) {
       case cpu::kDevMask:
@@ -169,6 +179,39 @@ class TorchTensor {
     return tensor;
   }
 
+  /*!
+   * \brief push the tensor wrapper of a TBlob on the lua stack. The wrappers
+   *  are cached by pointer and shape, the data of an executor is the same at
+   *  each iteration, a wrapper resized by torch is created again.
+   * \return the tensor.
+   */
+  static THGeneralTensor PushTBlob(TorchState* torchState, const TBlob& data) {
+    lua_State* L = torchState->L;
+    TorchState::TensorKey key(std::make_pair(data.dptr_, data.dev_mask_),
+                              std::vector<index_t>(data.shape_.begin(), data.shape_.end()));
+    auto it = torchState->tensor_refs.find(key);
+    if (it != torchState->tensor_refs.end()) {
+      lua_rawgeti(L, LUA_REGISTRYINDEX, it->second);
+      THGeneralTensor tensor = luaT_toudata(L, -1, TensorType(data));
+      if (tensor != NULL && Wraps(tensor, data)) return tensor;
+      lua_pop(L, 1);
+      luaL_unref(L, LUA_REGISTRYINDEX, it->second);
+      torchState->tensor_refs.erase(it);
+    }
+    // the data of imperative calls changes at each call
+    if (torchState->tensor_refs.size() >= kMaxCachedTensors) {
+      for (const auto& kv : torchState->tensor_refs) {
+        luaL_unref(L, LUA_REGISTRYINDEX, kv.second);
+      }
+      torchState->tensor_refs.clear();
+    }
+    THGeneralTensor tensor = TBlobToTHTensor(torchState, data);
+    luaT_pushudata(L, tensor, TensorType(data));
+    lua_pushvalue(L, -1);
+    torchState->tensor_refs[key] = luaL_ref(L, LUA_REGISTRYINDEX);
+    return tensor;
+  }
+
   static void FreeInternal(TorchState* torchState, THGeneralTensor tensor, int dev_mask) {
     switch (dev_mask) {
       case cpu::kDevMask: {
@@ -193,6 +236,12 @@ class TorchTensor {
     size_t size = blob.Size();
     switch (blob.dev_mask_) {
       case cpu::kDevMask: {
+        // the parameters of an executor are the same at each iteration
+        THFloatStorage* current = static_cast<THFloatTensor*>(tensor)->storage;
+        if (current != NULL && current->data == blob.dptr_ &&
+            static_cast<size_t>(current->size) == size) {
+          break;
+        }
         THFloatStorage* storage = THFloatStorage_newWithData(static_cast<real_t*>(blob.dptr_),
                                                              size);
         THFloatStorage_clearFlag(storage, TH_STORAGE_FREEMEM);
@@ -203,6 +252,11 @@ class TorchTensor {
       }
 #if MXNET_USE_CUDA
       case gpu::kDevMask: {
+        THCudaStorage* current = static_cast<THCudaTensor*>(tensor)->storage;
+        if (current != NULL && current->data == blob.dptr_ &&
+            static_cast<size_t>(current->size) == size) {
+          break;
+        }
         THCState* state = torchState->CudaState();
         THCudaStorage* storage = THCudaStorage_newWithData(state,
                                                            static_cast<real_t*>(blob.dptr_),
@@ -231,17 +285,13 @@ class TorchTensor {
       lua_createtable(L, num, 0);
       int index = 1;
       for (std::vector<TBlob>::const_iterator it = begin; it != end; ++it) {
-        THGeneralTensor th = TorchTensor::TBlobToTHTensor(torchState, *it);
-        res.push_back(th);
-        luaT_pushudata(L, th, TorchTensor::TensorType(*it));
+        res.push_back(TorchTensor::PushTBlob(torchState, *it));
         lua_rawseti(L, -2, index++);
       }
     } else if (num == 0) {
       lua_pushnil(L);
     } else {
-      THGeneralTensor th = TorchTensor::TBlobToTHTensor(torchState, *begin);
-      res.push_back(th);
-      luaT_pushudata(L, th, TorchTensor::TensorType(*begin));
+      res.push_back(TorchTensor::PushTBlob(torchState, *begin));
     }
     return res;
   }
@@ -269,6 +319,34 @@ class TorchTensor {
     }
   }
 
+  /*! \brief whether a tensor is a contiguous wrapper of the data of a TBlob */
+  static bool Wraps(THGeneralTensor tensor, const TBlob& data) {
+    switch (data.dev_mask_) {
+      case cpu::kDevMask:
+        return WrapsData(static_cast<THFloatTensor*>(tensor), data);
+#if MXNET_USE_CUDA
+      case gpu::kDevMask:
+        return WrapsData(static_cast<THCudaTensor*>(tensor), data);
+#endif  // MXNET_USE_CUDA
+      default:
+        return false;
+    }
+  }
+
+  template<typename THTensor>
+  static bool WrapsData(const THTensor* tensor, const TBlob& data) {
+    if (tensor->storage == NULL || tensor->storage->data != data.dptr_ ||
+        tensor->storageOffset != 0 || tensor->nDimension != static_cast<int>(data.ndim())) {
+      return false;
+    }
+    int64_t stride = 1;
+    for (int i = static_cast<int>(data.ndim()) - 1; i >= 0; --i) {
+      if (tensor->size[i] != data.shape_[i] || tensor->stride[i] != stride) return false;
+      stride *= data.shape_[i];
+    }
+    return true;
+  }
+
   static void CheckOutput(TorchState* torchState,
                           std::vector<TBlob>::const_iterator begin,
                           std::vector<TBlob>::const_iterator end,
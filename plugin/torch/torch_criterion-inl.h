@@ -88,8 +88,7 @@ class TorchCriterionOp : public Operator {
     lua_pushvalue(L, -2);
     // | self | forward | self
     for (index_t i = 0; i < in_data.size(); ++i) {
-      THGeneralTensor th = TorchTensor::TBlobToTHTensor(torchState_, in_data[i]);
-      luaT_pushudata(L, th, TorchTensor::TensorType(in_data[i]));
+      TorchTensor::PushTBlob(torchState_, in_data[i]);
     }
     // | self | forward | self | pred | label
     int err = lua_pcall(L, 3, 1, 0);
@@ -120,16 +119,14 @@ class TorchCriterionOp : public Operator {
     Stream<xpu> *s = ctx.get_stream<xpu>();
     torchState_->SetStream(s);
     lua_rawgeti(L, LUA_REGISTRYINDEX, lua_reference_);
-    THGeneralTensor th = TorchTensor::TBlobToTHTensor(torchState_, in_grad[0]);
-    luaT_pushudata(L, th, TorchTensor::TensorType(in_grad[0]));
+    TorchTensor::PushTBlob(torchState_, in_grad[0]);
     lua_setfield(L, -2, "gradInput");
     lua_getfield(L, -1, "backward");
     // | self | backward
     lua_pushvalue(L, -2);
     // | self | backward | self
     for (index_t i = 0; i < in_data.size(); ++i) {
-      th = TorchTensor::TBlobToTHTensor(torchState_, in_data[i]);
-      luaT_pushudata(L, th, TorchTensor::TensorType(in_data[i]));
+      TorchTensor::PushTBlob(torchState_, in_data[i]);
     }
     // | self | forward | self | pred | label
     int err = lua_pcall(L, 3, 0, 0);
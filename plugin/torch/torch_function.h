@@ -40,9 +40,7 @@ void TorchRunOp(std::vector<NDArray> arr_in,
     switch (format[i]) {
       case 'n': {
         CHECK(idx < arr.size()) << "Too few NDArray arguments for Torch." << OP::fname;
-        luaT_pushudata(L,
-                       TorchTensor::TBlobToTHTensor(torchState, arr[idx].data()),
-                       TorchTensor::TensorType(arr[idx].data()));
+        TorchTensor::PushTBlob(torchState, arr[idx].data());
         idx++;
         break;
       }
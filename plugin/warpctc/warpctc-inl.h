@@ -19,6 +19,7 @@
 #include <utility>
 #include <iostream>
 #include "../../src/operator/operator_common.h"
+#include "../../src/common/cuda_utils.h"
 
 namespace mxnet {
 namespace op {
@@ -26,6 +27,7 @@ namespace op {
 namespace warpctc_enum {
   enum CTCOpInputs {kData, kLabel};
   enum CTCOpOutputs {kOut};
+  enum CTCOpResource {kTempSpace};
 }  // namespace warpctc_enum
 
 struct WarpCTCParam : public dmlc::Parameter<WarpCTCParam> {
@@ -41,6 +43,12 @@ struct WarpCTCParam : public dmlc::Parameter<WarpCTCParam> {
   }
 };
 
+/*!
+ * \brief the ctc loss of warp-ctc, which reads the labels and their lengths on
+ *  the host also when the activations are on the gpu. The labels are copied
+ *  to the host by the forward pass in training, so that the backward pass
+ *  finds them there instead of waiting for the stream in the middle of the graph.
+ */
 template<typename xpu>
 class WarpCTCOp : public Operator {
  private:
@@ -52,6 +60,11 @@ class WarpCTCOp : public Operator {
   }
 
   ~WarpCTCOp() {
+#if MXNET_USE_CUDA
+    // no CUDA_CALL, the driver may be shutting down
+    if (host_labels_ != nullptr) cudaFreeHost(host_labels_);
+    if (labels_ready_ != nullptr) cudaEventDestroy(labels_ready_);
+#endif  // MXNET_USE_CUDA
   }
 
   inline void throw_on_error(ctcStatus_t status, const char* message) {
@@ -78,31 +91,33 @@ class WarpCTCOp : public Operator {
     Tensor<xpu, 2, float> data_tensor = data.FlatTo2D<xpu, float>(s);
     Tensor<xpu, 2, float> out_tensor = out.FlatTo2D<xpu, float>(s);
     Softmax(out_tensor, data_tensor);
+#if MXNET_USE_CUDA
+    if (ctx.is_train && data.dev_mask_ == gpu::kDevMask) {
+      this->CopyLabelsToHost(in_data[warpctc_enum::kLabel], ctx.get_stream<gpu>()->stream_);
+    }
+#endif  // MXNET_USE_CUDA
   }
 
-  std::vector<int> labelLengths(const int * flat_labels, int minibatch,
-                                int size, int blank, int * total_length) {
+  void labelLengths(const int * flat_labels, int minibatch,
+                    int size, int blank, int * total_length) {
     CHECK_EQ(param_.label_length * minibatch, size)
         << "label size should = label_length * minibatch";
-    std::vector<int> ret(minibatch, 0);
+    label_lengths_.assign(minibatch, 0);
     for (int i = 0; i < size; i++) {
       if (flat_labels[i] == blank) {
         continue;
       }
       int b = i / param_.label_length;
-      ret[b]++;
+      label_lengths_[b]++;
       (*total_length)++;
     }
-    return ret;
   }
 
-  void removeBlank(const int * flat_labels, int * cpu_labels,
-                   int size, int blank) {
-    int k = 0;
+  void removeBlank(const int * flat_labels, int size, int blank) {
+    labels_.clear();
     for (int i = 0; i < size; i++) {
       if (flat_labels[i] != blank) {
-        cpu_labels[k] = flat_labels[i];
-        k += 1;
+        labels_.push_back(flat_labels[i]);
       }
     }
   }
@@ -115,10 +130,12 @@ class WarpCTCOp : public Operator {
                         const std::vector<TBlob> &in_grad,
                         const std::vector<TBlob> &aux_args) {
     using namespace mshadow;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
     TBlob data = in_data[warpctc_enum::kData];
     TBlob label = in_data[warpctc_enum::kLabel];
     CHECK_EQ(data.shape_.ndim(), 2) << "input data shape should be 2 (t*n, p)";
     ctcComputeInfo info;
+    const int* host_labels = static_cast<const int*>(label.dptr_);
     if (data.dev_mask_ == cpu::kDevMask) {
       info.loc = CTC_CPU;
       info.num_threads = 1;
@@ -126,7 +143,12 @@ class WarpCTCOp : public Operator {
 #if MXNET_USE_CUDA
       info.loc = CTC_GPU;
       info.stream = ctx.get_stream<gpu>()->stream_;
-#endif
+      // a forward pass not in training did not copy them
+      if (!labels_pending_) this->CopyLabelsToHost(label, info.stream);
+      CUDA_CALL(cudaEventSynchronize(labels_ready_));
+      labels_pending_ = false;
+      host_labels = host_labels_;
+#endif  // MXNET_USE_CUDA
     } else {
       LOG(FATAL) << "Unknown device type " << data.dev_mask_;
     }
@@ -134,81 +156,75 @@ class WarpCTCOp : public Operator {
     int T = param_.input_length;
     int minibatch = data.shape_[0] / T;
     int alphabet_size = data.shape_[1];
-    std::vector<int> input_lengths;
-    for (int i = 0; i < minibatch; i++) {
-      input_lengths.push_back(T);
-    }
+    input_lengths_.assign(minibatch, T);
 
-#if MXNET_USE_CUDA
-    cudaError_t cuda_status;
-#endif
     float* activations = static_cast<float*>(data.dptr_);
-    int* flat_labels = static_cast<int*>(label.dptr_);
-    int* cpu_raw_labels = flat_labels;
     float* grads = static_cast<float*>(in_grad[warpctc_enum::kData].dptr_);
-    if (data.dev_mask_ == gpu::kDevMask) {
-#if MXNET_USE_CUDA
-      cpu_raw_labels = reinterpret_cast<int*>(malloc(sizeof(int) * label.Size()));
-      cuda_status = cudaMemcpyAsync(cpu_raw_labels, flat_labels,
-                                    label.Size()*sizeof(int),
-                                    cudaMemcpyDeviceToHost,
-                                    ctx.get_stream<gpu>()->stream_);
-      CHECK_EQ(cuda_status, cudaSuccess) << "cuda memcpy label error";
-#endif
-    } else {
-      LOG(FATAL) << "Unknown device type " << data.dev_mask_;
-    }
 
     int total_label_length = 0;
-    std::vector<int> label_lengths = labelLengths(cpu_raw_labels,
-                                                  minibatch,
-                                                  label.Size(),
-                                                  0, &total_label_length);
-    int* cpu_labels = reinterpret_cast<int*>(
-        malloc(sizeof(int) * total_label_length));
-    removeBlank(cpu_raw_labels, cpu_labels, label.Size(), 0);
-    free(cpu_raw_labels);
+    labelLengths(host_labels, minibatch, label.Size(), 0, &total_label_length);
+    removeBlank(host_labels, label.Size(), 0);
 
     size_t alloc_bytes;
-    throw_on_error(get_workspace_size(label_lengths.data(),
-                                      input_lengths.data(),
+    throw_on_error(get_workspace_size(label_lengths_.data(),
+                                      input_lengths_.data(),
                                       alphabet_size,
-                                      input_lengths.size(), info,
+                                      input_lengths_.size(), info,
                                       &alloc_bytes),
                    "Error: get_workspace_size in inf_test");
-    void* ctc_workspace;
-
-    if (data.dev_mask_ == cpu::kDevMask) {
-      ctc_workspace = malloc(alloc_bytes);
-    } else if (data.dev_mask_ == gpu::kDevMask) {
-#if MXNET_USE_CUDA
-      cuda_status = cudaMalloc(&ctc_workspace, alloc_bytes);
-      CHECK_EQ(cuda_status, cudaSuccess) << "cuda malloc worksapce fail";
-#endif
-    }
-    std::vector<float> costs(minibatch);
+    // the workspace of warp-ctc is the temp space of the op, in floats
+    Tensor<xpu, 1, float> workspace = ctx.requested[warpctc_enum::kTempSpace]
+        .get_space_typed<xpu, 1, float>(
+            Shape1((alloc_bytes + sizeof(float) - 1) / sizeof(float) + 1), s);
+    costs_.resize(minibatch);
     throw_on_error(compute_ctc_loss(activations,
                                     grads,
-                                    cpu_labels,
-                                    label_lengths.data(),
-                                    input_lengths.data(),
+                                    labels_.data(),
+                                    label_lengths_.data(),
+                                    input_lengths_.data(),
                                     alphabet_size,
                                     minibatch,
-                                    costs.data(),
-                                    ctc_workspace,
+                                    costs_.data(),
+                                    workspace.dptr_,
                                     info),
                    "Error: compute_ctc_loss");
+  }
 
-    if (data.dev_mask_ == cpu::kDevMask) {
-      free(ctc_workspace);
-    } else if (data.dev_mask_ == gpu::kDevMask) {
+ private:
 #if MXNET_USE_CUDA
-      cuda_status = cudaFree(ctc_workspace);
-      CHECK_EQ(cuda_status, cudaSuccess) << "cuda free workspace fail";
-      free(cpu_labels);
-#endif
+  /*! \brief copy the labels to host_labels_ on the stream, labels_ready_ is recorded after */
+  void CopyLabelsToHost(const TBlob &label, cudaStream_t stream) {
+    const size_t size = label.Size();
+    if (size > host_labels_size_) {
+      if (host_labels_ != nullptr) CUDA_CALL(cudaFreeHost(host_labels_));
+      CUDA_CALL(cudaMallocHost(&host_labels_, size * sizeof(int)));
+      host_labels_size_ = size;
+    }
+    if (labels_ready_ == nullptr) {
+      CUDA_CALL(cudaEventCreateWithFlags(&labels_ready_, cudaEventDisableTiming));
     }
+    CUDA_CALL(cudaMemcpyAsync(host_labels_, label.dptr_, size * sizeof(int),
+                              cudaMemcpyDeviceToHost, stream));
+    CUDA_CALL(cudaEventRecord(labels_ready_, stream));
+    labels_pending_ = true;
   }
+  /*! \brief pinned copy of the labels of a gpu op */
+  int* host_labels_{nullptr};
+  /*! \brief capacity of host_labels_ */
+  size_t host_labels_size_{0};
+  /*! \brief recorded after the copy to host_labels_ */
+  cudaEvent_t labels_ready_{nullptr};
+#endif  // MXNET_USE_CUDA
+  /*! \brief whether the forward pass copied the labels for the backward pass */
+  bool labels_pending_{false};
+  /*! \brief the labels without blanks, kept to reuse the buffers */
+  std::vector<int> labels_;
+  /*! \brief the number of labels of each sequence */
+  std::vector<int> label_lengths_;
+  /*! \brief the length of each sequence */
+  std::vector<int> input_lengths_;
+  /*! \brief the loss of each sequence */
+  std::vector<float> costs_;
 };
 
 template<typename xpu>
@@ -283,6 +299,11 @@ class WarpCTCProp : public OperatorProperty {
           out_data[warpctc_enum::kOut]};
   }
 
+  std::vector<ResourceRequest> BackwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace};
+  }
+
   Operator* CreateOperator(Context ctx) const override;
 
  private:
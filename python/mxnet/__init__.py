@@ -47,4 +47,10 @@ from . import torch as th
 from . import module
 from . import module as mod
 
+from . import profiler
+from . import storage
+from . import engine
+from . import amp
+from . import quantization
+
 __version__ = base.__version__
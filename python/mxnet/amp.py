@@ -0,0 +1,86 @@
+# coding: utf-8
+"""Automatic mixed precision: run compute heavy operators in float16."""
+from __future__ import absolute_import
+
+import json
+from . import symbol as sym
+
+# operators that are cast to low precision, they run on cuDNN/cuBLAS in float16.
+TARGET_OPS = ('Convolution', 'FullyConnected', 'Deconvolution')
+
+
+def convert_symbol(symbol, target_dtype='float16', target_ops=TARGET_OPS,
+                   loss_scale=1.0):
+    """Cast the inputs of compute heavy operators to a low precision type,
+    and their outputs back to float32.
+
+    The arguments of the network, including the weights, are kept in float32,
+    so the optimizer updates float32 master weights with float32 gradients.
+
+    Parameters
+    ----------
+    symbol : Symbol
+        The network to convert.
+    target_dtype : str, optional
+        The low precision type.
+    target_ops : tuple of str, optional
+        Type names of the operators to run in low precision.
+    loss_scale : float, optional
+        Gradients are multiplied by loss_scale when they enter a low precision
+        operator in backward, and divided by it when they leave, so that small
+        gradients do not underflow in low precision.
+
+    Returns
+    -------
+    Symbol
+        The converted network, with the same arguments and outputs.
+    """
+    graph = json.loads(symbol.tojson())
+    nodes = []
+    # map from old node id to new node id
+    remap = {}
+    # map from (new source id, index) to the id of its low precision cast
+    low_cache = {}
+    # map from the float32 cast of a converted operator to the operator
+    back_cast = {}
+    inv_scale = str(1.0 / loss_scale)
+
+    def add_cast(name, entry, dtype, grad_scale):
+        nodes.append({'op': 'Cast',
+                      'param': {'dtype': dtype, 'grad_scale': grad_scale},
+                      'name': name,
+                      'inputs': [entry],
+                      'backward_source_id': -1})
+        return len(nodes) - 1
+
+    for nid, node in enumerate(graph['nodes']):
+        node = dict(node)
+        inputs = [[remap[e[0]]] + e[1:] for e in node['inputs']]
+        if node['op'] in target_ops:
+            casted = []
+            for e in inputs:
+                if e[0] in back_cast:
+                    # feed low precision output directly
+                    casted.append([back_cast[e[0]], 0])
+                    continue
+                key = (e[0], e[1])
+                if key not in low_cache:
+                    name = '%s_%d_%s' % (nodes[e[0]]['name'], e[1], target_dtype)
+                    low_cache[key] = add_cast(name, e, target_dtype, inv_scale)
+                casted.append([low_cache[key], 0])
+            node['inputs'] = casted
+            name = node['name']
+            node['name'] = '%s_%s' % (name, target_dtype)
+            nodes.append(node)
+            # consumers read the float32 output, which keeps the original name
+            remap[nid] = add_cast(name, [len(nodes) - 1, 0],
+                                  'float32', str(float(loss_scale)))
+            back_cast[remap[nid]] = remap[nid] - 1
+        else:
+            node['inputs'] = inputs
+            nodes.append(node)
+            remap[nid] = len(nodes) - 1
+    graph['nodes'] = nodes
+    graph['arg_nodes'] = [remap[i] for i in graph['arg_nodes']]
+    graph['heads'] = [[remap[e[0]]] + e[1:] for e in graph['heads']]
+    return sym.load_json(json.dumps(graph))
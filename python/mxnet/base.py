@@ -49,6 +49,7 @@ mx_float_p = ctypes.POINTER(mx_float)
 mx_real_t = np.float32
 NDArrayHandle = ctypes.c_void_p
 FunctionHandle = ctypes.c_void_p
+FunctionParamsHandle = ctypes.c_void_p
 SymbolCreatorHandle = ctypes.c_void_p
 SymbolHandle = ctypes.c_void_p
 ExecutorHandle = ctypes.c_void_p
@@ -58,6 +59,7 @@ KVStoreHandle = ctypes.c_void_p
 RecordIOHandle = ctypes.c_void_p
 RtcHandle = ctypes.c_void_p
 OptimizerHandle = ctypes.c_void_p
+SharedMemHandle = ctypes.c_void_p
 OptimizerCreator = ctypes.c_void_p
 #----------------------------
 # helper function definition
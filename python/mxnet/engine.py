@@ -0,0 +1,161 @@
+# coding: utf-8
+"""Engine properties management."""
+from __future__ import absolute_import
+
+import ctypes
+from .base import _LIB, check_call, py_str, mx_uint
+
+
+def set_bulk_size(size):
+    """Set the size limit on bulk execution of imperative operations.
+
+    Consecutive synchronous operations on the same context pushed by
+    the calling thread are grouped into one engine operation, which
+    reduces the dispatch overhead of many small operations.
+
+    Parameters
+    ----------
+    size : int
+        Maximum number of operations in a bulk, 0 disables bulk execution.
+
+    Returns
+    -------
+    int
+        The previous bulk size.
+    """
+    prev = ctypes.c_int()
+    check_call(_LIB.MXEngineSetBulkSize(
+        ctypes.c_int(size), ctypes.byref(prev)))
+    return prev.value
+
+
+def get_stats():
+    """Get the runtime counters of the engine.
+
+    The counters are cheap to read and can be sampled periodically, the
+    rates are the differences between two samples. Names ending with
+    ``_us`` are microseconds. The threaded engines report
+
+    - ``pushed``, ``completed``: operations pushed and completed.
+    - ``pending``, ``ready``, ``running``: operations not completed, waiting
+      in a queue, and executing.
+    - ``dep_blocked``, ``dep_waits``: operations pushed while a dependency was
+      pending, and the total number of pending dependencies at their pushes.
+    - ``queue_wait_us``: total time the ready operations waited in queues.
+    - ``host_waits``, ``host_wait_us``: calls of ``wait_to_read`` and
+      ``waitall``, and the time they blocked.
+    - ``host_wait_spun``: calls of ``wait_to_read`` that returned while
+      spinning, see ``MXNET_ENGINE_WAIT_SPIN_US``.
+    - ``<queue>/queued``, ``<queue>/executed``, ``<queue>/pending``,
+      ``<queue>/busy_us``, ``<queue>/idle_us``, ``<queue>/threads`` for each
+      worker queue, such as ``cpu(0)/normal`` or ``gpu(0)/copy_from``.
+
+    Returns
+    -------
+    dict of str to int
+        The counters.
+    """
+    size = mx_uint()
+    names = ctypes.POINTER(ctypes.c_char_p)()
+    values = ctypes.POINTER(ctypes.c_uint64)()
+    check_call(_LIB.MXEngineGetStats(
+        ctypes.byref(size), ctypes.byref(names), ctypes.byref(values)))
+    return {py_str(names[i]): values[i] for i in range(size.value)}
+
+
+class _BulkScope(object):
+    """Scope object for bulk execution."""
+    def __init__(self, size):
+        self._size = size
+        self._old_size = None
+
+    def __enter__(self):
+        self._old_size = set_bulk_size(self._size)
+        return self
+
+    def __exit__(self, ptype, value, trace):
+        set_bulk_size(self._old_size)
+
+
+def bulk(size):
+    """Bulk execution scope of imperative operations.
+
+    Example::
+
+        with mx.engine.bulk(10):
+            x = mx.nd.zeros((1,))
+            for _ in range(100):
+                x += 1
+
+    Parameters
+    ----------
+    size : int
+        Maximum number of operations in a bulk.
+    """
+    return _BulkScope(size)
+
+
+class Graph(object):
+    """A graph of engine operations recorded by `capture`.
+
+    The operations read and write the same arrays every time the graph is
+    replayed, so these arrays must be kept alive as long as the graph.
+    """
+    def __init__(self):
+        self.handle = None
+
+    def __del__(self):
+        if self.handle is not None:
+            check_call(_LIB.MXEngineFreeGraph(self.handle))
+
+    def replay(self, priority=0):
+        """Push all the captured operations again.
+
+        Parameters
+        ----------
+        priority : int, optional
+            The priority of the operations.
+        """
+        if self.handle is None:
+            raise RuntimeError('the graph is still being captured')
+        check_call(_LIB.MXEnginePushGraph(self.handle, ctypes.c_int(priority)))
+
+
+class _CaptureScope(object):
+    """Scope object for graph capture."""
+    def __init__(self):
+        self._graph = Graph()
+
+    def __enter__(self):
+        check_call(_LIB.MXEngineBeginCapture())
+        return self._graph
+
+    def __exit__(self, ptype, value, trace):
+        handle = ctypes.c_void_p()
+        check_call(_LIB.MXEngineEndCapture(ctypes.byref(handle)))
+        self._graph.handle = handle
+
+
+def capture():
+    """Capture the operations pushed by the calling thread into a graph.
+
+    The operations are not executed in the scope, and nothing can be waited
+    for. The graph replays them with the dependencies computed once, which
+    saves the dispatch overhead of a loop running the same small operations.
+
+    Example::
+
+        x = mx.nd.zeros((1,))
+        with mx.engine.capture() as graph:
+            for _ in range(100):
+                x += 1
+        for _ in range(10):
+            graph.replay()
+        x.wait_to_read()
+
+    Returns
+    -------
+    Graph
+        The graph, which can be replayed after the scope ends.
+    """
+    return _CaptureScope()
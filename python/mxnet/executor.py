@@ -5,6 +5,7 @@ from __future__ import absolute_import
 
 import ctypes
 import copy
+import json
 import numpy as np
 from .base import _LIB
 from .base import mx_uint, NDArrayHandle, ExecutorHandle
@@ -24,6 +25,13 @@ def _monitor_callback_wrapper(callback):
         callback(name, array)
     return callback_handle
 
+def _grad_ready_callback_wrapper(callback):
+    """ a wrapper for the user-defined gradient handle """
+    def callback_handle(index, _):
+        """ ctypes function """
+        callback(index)
+    return callback_handle
+
 class Executor(object):
     """ Executor is the actual executing object of MXNet."""
     def __init__(self, handle, symbol, ctx, grad_req, group2ctx):
@@ -50,6 +58,7 @@ class Executor(object):
         self._grad_dict = None
         self._aux_dict = None
         self._monitor_callback = None
+        self._grad_ready_callback = None
         self._ctx = copy.deepcopy(ctx)
         self._grad_req = copy.deepcopy(grad_req)
         self._group2ctx = copy.deepcopy(group2ctx)
@@ -158,6 +167,24 @@ class Executor(object):
             self._monitor_callback,
             None))
 
+    def set_grad_ready_callback(self, callback):
+        """Install callback notified during backward, once for each argument with
+        gradient, right after the operator writing the gradient is pushed to the engine.
+        Operations on the gradient issued in the callback, such as a kvstore push,
+        run after it without waiting for the rest of the backward pass.
+
+        Parameters
+        ----------
+        callback : function
+            Takes the index of the argument, in the order of list_arguments.
+        """
+        cb_type = ctypes.CFUNCTYPE(None, mx_uint, ctypes.c_void_p)
+        self._grad_ready_callback = cb_type(_grad_ready_callback_wrapper(callback))
+        check_call(_LIB.MXExecutorSetGradReadyCallback(
+            self.handle,
+            self._grad_ready_callback,
+            None))
+
     @property
     def arg_dict(self):
         """Get dictionary representation of argument arrrays.
@@ -316,13 +343,51 @@ class Executor(object):
                     "with the old one. Please check for error in network." +\
                     "If this is intended, set partial_shaping=True to suppress this warning.")
 
-        return self._symbol.bind(self._ctx,
-                                 args=new_arg_dict,
-                                 args_grad=new_grad_dict,
-                                 grad_req=self._grad_req,
-                                 aux_states=new_aux_dict,
-                                 group2ctx=self._group2ctx,
-                                 shared_exec=self)
+        return self._reshape_from(new_arg_dict, new_grad_dict, new_aux_dict)
+
+    def _reshape_from(self, args, args_grad, aux_states):
+        """Create an executor of the same graph bound to new arrays,
+        which shares memory with self. The graph is reused instead of rebuilt.
+
+        Parameters
+        ----------
+        args : list of NDArray or dict of str to NDArray
+            The arguments, in the new shapes.
+        args_grad : list of NDArray or dict of str to NDArray
+            The gradients of the arguments, for all arguments whose gradient is requested.
+        aux_states : list of NDArray or dict of str to NDArray
+            The auxiliary states.
+
+        Returns
+        -------
+        exec : Executor
+            A new executor that shares memory with self.
+        """
+        listed_arguments = self._symbol.list_arguments()
+        # pylint: disable=protected-access
+        args_handle, args = self._symbol._get_ndarray_inputs(
+            'args', args, listed_arguments, False)
+        if args_grad is None:
+            args_grad_handle = c_array(NDArrayHandle, [None] * len(args))
+        else:
+            args_grad_handle, args_grad = self._symbol._get_ndarray_inputs(
+                'args_grad', args_grad, listed_arguments, True)
+        aux_args_handle, aux_states = self._symbol._get_ndarray_inputs(
+            'aux_states', aux_states, self._symbol.list_auxiliary_states(), False)
+        # pylint: enable=protected-access
+        handle = ExecutorHandle()
+        check_call(_LIB.MXExecutorReshape(self.handle,
+                                          mx_uint(len(args)),
+                                          args_handle,
+                                          args_grad_handle,
+                                          mx_uint(len(aux_states)),
+                                          aux_args_handle,
+                                          ctypes.byref(handle)))
+        executor = Executor(handle, self._symbol, self._ctx, self._grad_req, self._group2ctx)
+        executor.arg_arrays = args
+        executor.grad_arrays = args_grad
+        executor.aux_arrays = aux_states
+        return executor
 
     def debug_str(self):
         """Get a debug string about internal execution plan.
@@ -337,3 +402,69 @@ class Executor(object):
             self.handle, ctypes.byref(debug_str)))
         return py_str(debug_str.value)
 
+    def cost(self):
+        """Get the estimated cost of the nodes of the executor, from their shapes.
+
+        A node with a weight does ``out * weight / channels`` multiply-adds,
+        counted as two flops each, another node a flop per output element, and
+        a backward node twice the flops of its forward node. The workspace is
+        the limit given to the operator.
+
+        Returns
+        -------
+        cost : dict
+            ``nodes`` has the ``name``, ``op``, ``pass``, ``flops``, ``read_bytes``,
+            ``write_bytes``, ``param_bytes`` and ``workspace_bytes`` of each node.
+            ``forward``, ``backward`` and ``total`` have their sums, with the
+            largest workspace, and ``total`` the arithmetic intensity, the flops
+            per byte read or written.
+        """
+        out = ctypes.c_char_p()
+        check_call(_LIB.MXExecutorPrintCost(self.handle, ctypes.byref(out)))
+        return json.loads(py_str(out.value))
+
+    def set_profiling(self, enable=True):
+        """Enable or disable the timing of each node of the executor.
+
+        The nodes, including those run together in bulk segments, are timed by
+        events on their gpu stream, or by the host clock on a cpu. Timing waits
+        for the kernels of each node, so the executor runs slower meanwhile.
+
+        Parameters
+        ----------
+        enable : bool
+            Whether to time the nodes.
+        """
+        check_call(_LIB.MXExecutorSetProfiling(self.handle, ctypes.c_int(int(enable))))
+
+    def profile(self, reset=False):
+        """Get the times of the nodes timed since ``set_profiling``.
+
+        Parameters
+        ----------
+        reset : bool
+            Whether to clear the times.
+
+        Returns
+        -------
+        profile : dict
+            ``nodes`` has the ``name``, ``op``, ``pass``, ``count``, ``total_ms``,
+            ``mean_ms`` and ``max_ms`` of each timed node. ``forward`` and
+            ``backward`` have the ``mean_ms`` of a pass, the sum of those of its nodes.
+        """
+        out = ctypes.c_char_p()
+        check_call(_LIB.MXExecutorPrintProfile(self.handle, ctypes.c_int(int(reset)),
+                                               ctypes.byref(out)))
+        return json.loads(py_str(out.value))
+
+    def warmup(self):
+        """Do the lazy work of the first forward now, so that the next forward runs
+        as fast as the later ones.
+
+        The memory planned for the executor is touched, then an inference forward
+        runs on the bound arrays, which creates the engine workers and streams of the
+        devices, grows the temporary space and selects the algorithms of the
+        operators. Call it right after binding, the outputs are then meaningless
+        until the inputs are set and the next forward runs.
+        """
+        check_call(_LIB.MXExecutorWarmup(self.handle))
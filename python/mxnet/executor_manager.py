@@ -3,7 +3,6 @@
 """Executor manager"""
 from __future__ import absolute_import
 
-from .base import mx_real_t
 from . import ndarray as nd
 from .context import cpu
 
@@ -97,7 +96,7 @@ def _bind_exec(sym, ctx, input_shapes, param_names, need_grad=False,
     arg_shape, _, aux_shape = sym.infer_shape(**input_shapes)
     assert(arg_shape is not None)
     if input_types is None:
-        input_types = {k: mx_real_t for k in input_shapes.keys()}
+        input_types = sym.input_types(input_shapes.keys())
     arg_types, _, aux_types = sym.infer_type(**input_types)
     assert(arg_types is not None)
 
@@ -54,15 +54,13 @@ class Initializer(object):
             self._init_default(name, arr)
     # pylint: disable=no-self-use, missing-docstring, invalid-name
     def _init_bilinear(self, _, arr):
-        weight = np.zeros(np.prod(arr.shape), dtype='float32')
         shape = arr.shape
         f = np.ceil(shape[3] / 2.)
         c = (2 * f - 1 - f % 2) / (2. * f)
-        for i in range(np.prod(shape)):
-            x = i % shape[3]
-            y = (i / shape[3]) % shape[2]
-            weight[i] = (1 - abs(x / f - c)) * (1 - abs(y / f - c))
-        arr[:] = weight.reshape(shape)
+        x = np.arange(shape[3], dtype='float32')
+        y = np.arange(shape[2], dtype='float32')
+        kernel = np.outer(1 - np.abs(y / f - c), 1 - np.abs(x / f - c))
+        arr[:] = np.tile(kernel, shape[:2] + (1, 1))
 
     def _init_loc_bias(self, _, arr):
         shape = arr.shape
@@ -6,16 +6,20 @@ from __future__ import absolute_import
 from collections import OrderedDict
 
 import ctypes
+import json
+import multiprocessing
+import os
 import sys
 import numpy as np
 import logging
 import threading
 from .base import _LIB
 from .base import c_array, c_str, mx_uint, py_str
-from .base import DataIterHandle, NDArrayHandle
+from .base import DataIterHandle, NDArrayHandle, SharedMemHandle
 from .base import check_call, ctypes2docstring
-from .ndarray import NDArray
+from .ndarray import NDArray, _DTYPE_NP_TO_MX
 from .ndarray import array
+from .ndarray import _internal
 
 
 class DataBatch(object):
@@ -288,6 +292,287 @@ class PrefetchingIter(DataIter):
     def getpad(self):
         return self.current_batch.pad
 
+class DeviceImageIter(DataIter):
+    """Normalize the uint8 image batches of a DataIter on a device.
+
+    The batches of ImageRecordIter(dtype='uint8') hold the decoded and augmented
+    raw pixels. They are copied to ctx as uint8, which is 4x fewer bytes than
+    float32, and converted, mean subtracted, mirrored and scaled there, as
+    ImageRecordIter does on cpu otherwise.
+
+    Parameters
+    ----------
+    data_iter : DataIter
+        Internal data iterator whose first data is uint8 of shape (N, C, H, W).
+    ctx : Context
+        The device of the output batches.
+    mean : NDArray or numpy.ndarray or list of float, optional
+        The mean image of shape (C, H, W), or the mean of each channel.
+    scale : float, optional
+        Multiplier of the mean subtracted images.
+    rand_mirror : bool, optional
+        Whether to mirror each image with probability 0.5.
+    seed : int, optional
+        Seed of the random mirroring.
+    """
+    def __init__(self, data_iter, ctx, mean=None, scale=1.0, rand_mirror=False, seed=0):
+        super(DeviceImageIter, self).__init__()
+        self.data_iter = data_iter
+        self.ctx = ctx
+        self.scale = scale
+        self.rand_mirror = rand_mirror
+        self.provide_data = data_iter.provide_data
+        self.provide_label = data_iter.provide_label
+        self.batch_size = data_iter.batch_size
+        shape = self.provide_data[0][1]
+        if mean is None:
+            mean = np.zeros(shape[1:], dtype=np.float32)
+        elif isinstance(mean, NDArray):
+            mean = mean.asnumpy()
+        mean = np.asarray(mean, dtype=np.float32)
+        if mean.ndim == 1:
+            mean = np.tile(mean.reshape((-1, 1, 1)), (1, shape[2], shape[3]))
+        self.mean = array(mean, ctx=ctx)
+        self.rnd = np.random.RandomState(seed)
+        self.current_batch = None
+
+    def reset(self):
+        self.data_iter.reset()
+
+    def iter_next(self):
+        try:
+            batch = self.data_iter.next()
+        except StopIteration:
+            return False
+        flip = np.zeros(self.batch_size, dtype=np.float32)
+        if self.rand_mirror:
+            flip = self.rnd.randint(0, 2, self.batch_size).astype(np.float32)
+        images = batch.data[0].copyto(self.ctx)
+        data = _internal._image_normalize(images, self.mean, array(flip, ctx=self.ctx))
+        if self.scale != 1.0:
+            data *= self.scale
+        self.current_batch = DataBatch([data] + batch.data[1:],
+                                       [l.copyto(self.ctx) for l in batch.label],
+                                       batch.pad, batch.index)
+        return True
+
+    def next(self):
+        if self.iter_next():
+            return self.current_batch
+        else:
+            raise StopIteration
+
+    def getdata(self):
+        return self.current_batch.data
+
+    def getlabel(self):
+        return self.current_batch.label
+
+    def getindex(self):
+        return self.current_batch.index
+
+    def getpad(self):
+        return self.current_batch.pad
+
+class SharedMemoryWriter(object):
+    """The writing end of a SharedMemoryIter, given to the worker processes.
+
+    It is passed to a process as an argument of ``multiprocessing.Process``,
+    and opens the shared memory in the process on first use.
+    """
+    def __init__(self, name, layout, slot_bytes, num_slots, free, ready):
+        self.name = name
+        self.layout = layout
+        self.slot_bytes = slot_bytes
+        self.num_slots = num_slots
+        self.free = free
+        self.ready = ready
+        self.handle = None
+        self.buffer = None
+
+    def __getstate__(self):
+        state = self.__dict__.copy()
+        state['handle'] = None
+        state['buffer'] = None
+        return state
+
+    def _views(self, slot):
+        """numpy arrays over the data and the label of a slot"""
+        if self.handle is None:
+            self.handle = SharedMemHandle()
+            check_call(_LIB.MXSharedMemCreate(
+                c_str(self.name), ctypes.c_size_t(self.slot_bytes * self.num_slots),
+                ctypes.c_int(0), ctypes.byref(self.handle)))
+            data = ctypes.c_void_p()
+            size = ctypes.c_size_t()
+            check_call(_LIB.MXSharedMemGetData(self.handle, ctypes.byref(data),
+                                               ctypes.byref(size)))
+            self.buffer = (ctypes.c_char * size.value).from_address(data.value)
+        return [np.frombuffer(self.buffer, dtype=dtype, count=int(np.prod(shape)),
+                              offset=slot * self.slot_bytes + offset).reshape(shape)
+                for offset, shape, dtype in self.layout]
+
+    def acquire(self):
+        """Take a free slot, waiting for one.
+
+        Returns
+        -------
+        slot : int
+            The slot, to give to commit once written.
+        arrays : list of numpy.ndarray
+            The data then the label of the slot, to write in place.
+        """
+        slot = self.free.get()
+        return slot, self._views(slot)
+
+    def commit(self, slot, pad=0):
+        """Hand a written slot to the iterator."""
+        self.ready.put((slot, pad))
+
+    def put(self, data, label=None, pad=0):
+        """Write a batch, a list of data and a list of label arrays, into a free slot."""
+        slot, views = self.acquire()
+        for dst, src in zip(views, list(data) + list(label or [])):
+            dst[:] = src
+        self.commit(slot, pad)
+
+    def end_epoch(self):
+        """Mark the end of the epoch of this writer."""
+        self.ready.put((-1, 0))
+
+    def __del__(self):
+        if self.handle is not None:
+            check_call(_LIB.MXSharedMemFree(self.handle))
+
+class SharedMemoryIter(DataIter):
+    """Batches written by other processes into a ring of slots in shared memory.
+
+    Python preprocessing runs in worker processes, off the GIL of the training
+    loop, without pickling the arrays. A worker writes a batch in place into a
+    free slot through its ``writer()``, and the iterator returns NDArrays over
+    the slot without copy. A slot is free again once the next batch is taken
+    and the pending reads of the previous one are finished. Only the slot
+    numbers go through the queues.
+
+    An epoch ends once each of the num_writers writers called ``end_epoch``.
+
+    Parameters
+    ----------
+    data_shapes : list of (str, tuple)
+        The names and shapes of the data, the first dimension is the batch size.
+    label_shapes : list of (str, tuple), optional
+        The names and shapes of the label.
+    num_slots : int, optional
+        The number of batches in the ring.
+    num_writers : int, optional
+        The number of writers ending each epoch.
+    dtype : str or numpy.dtype, optional
+        The type of the arrays.
+
+    Examples
+    --------
+    >>> it = mx.io.SharedMemoryIter([('data', (32, 100))], [('softmax_label', (32,))])
+    >>> def work(writer):
+    ...     for data, label in load():
+    ...         writer.put([data], [label])
+    ...     writer.end_epoch()
+    >>> multiprocessing.Process(target=work, args=(it.writer(),)).start()
+    >>> for batch in it:
+    ...     mod.forward_backward(batch)
+    """
+    def __init__(self, data_shapes, label_shapes=None, num_slots=4, num_writers=1,
+                 dtype='float32'):
+        super(SharedMemoryIter, self).__init__()
+        self.provide_data = [(n, tuple(s)) for n, s in data_shapes]
+        self.provide_label = [(n, tuple(s)) for n, s in label_shapes or []]
+        self.batch_size = self.provide_data[0][1][0]
+        self.num_writers = num_writers
+        dtype = np.dtype(dtype)
+        layout = []
+        offset = 0
+        for _, shape in self.provide_data + self.provide_label:
+            layout.append((offset, shape, dtype))
+            offset += (int(np.prod(shape)) * dtype.itemsize + 63) // 64 * 64
+        self.name = '/mxnet_iter_%d_%d' % (os.getpid(), id(self))
+        self.handle = SharedMemHandle()
+        check_call(_LIB.MXSharedMemCreate(c_str(self.name), ctypes.c_size_t(offset * num_slots),
+                                          ctypes.c_int(1), ctypes.byref(self.handle)))
+        self.slots = []
+        for slot in range(num_slots):
+            arrays = []
+            for off, shape, _ in layout:
+                out = NDArrayHandle()
+                check_call(_LIB.MXSharedMemGetNDArray(
+                    self.handle, ctypes.c_size_t(slot * offset + off),
+                    c_array(mx_uint, shape), mx_uint(len(shape)),
+                    ctypes.c_int(_DTYPE_NP_TO_MX[dtype.type]), ctypes.byref(out)))
+                arrays.append(NDArray(out))
+            self.slots.append(arrays)
+        self.free = multiprocessing.Queue()
+        self.ready = multiprocessing.Queue()
+        for slot in range(num_slots):
+            self.free.put(slot)
+        self._writer = SharedMemoryWriter(self.name, layout, offset, num_slots,
+                                          self.free, self.ready)
+        self.num_ended = 0
+        self.current_slot = None
+        self.current_batch = None
+
+    def writer(self):
+        """The writing end, to give to the worker processes."""
+        return self._writer
+
+    def _release(self):
+        """give back the slot of the current batch once its reads are finished"""
+        if self.current_slot is None:
+            return
+        for arr in self.slots[self.current_slot]:
+            arr.wait_to_write()
+        self.free.put(self.current_slot)
+        self.current_slot = None
+
+    def reset(self):
+        self._release()
+        self.num_ended = 0
+
+    def iter_next(self):
+        self._release()
+        while True:
+            slot, pad = self.ready.get()
+            if slot >= 0:
+                break
+            self.num_ended += 1
+            if self.num_ended == self.num_writers:
+                self.num_ended = 0
+                return False
+        self.current_slot = slot
+        arrays = self.slots[slot]
+        num_data = len(self.provide_data)
+        self.current_batch = DataBatch(arrays[:num_data], arrays[num_data:], pad)
+        return True
+
+    def next(self):
+        if self.iter_next():
+            return self.current_batch
+        else:
+            raise StopIteration
+
+    def getdata(self):
+        return self.current_batch.data
+
+    def getlabel(self):
+        return self.current_batch.label
+
+    def getindex(self):
+        return None
+
+    def getpad(self):
+        return self.current_batch.pad
+
+    def __del__(self):
+        self.slots = []
+        check_call(_LIB.MXSharedMemFree(self.handle))
+
 def _init_data(data, allow_empty, default_name):
     """Convert data into canonical form."""
     assert (data is not None) or allow_empty
@@ -438,9 +723,11 @@ class MXDataIter(DataIter):
     handle : DataIterHandle
         the handle to the underlying C++ Data Iterator
     """
-    def __init__(self, handle, data_name='data', label_name='softmax_label', **_):
+    def __init__(self, handle, data_name='data', label_name='softmax_label', **kwargs):
         super(MXDataIter, self).__init__()
         self.handle = handle
+        self._data_name = data_name
+        self._label_name = label_name
         # debug option, used to test the speed with io effect eliminated
         self._debug_skip_load = False
 
@@ -455,6 +742,20 @@ class MXDataIter(DataIter):
         self.provide_data = [(data_name, data.shape)]
         self.provide_label = [(label_name, label.shape)]
         self.batch_size = data.shape[0]
+        if len(self.first_batch.data) > 1:
+            # the values of a batch in compressed sparse row format, then the column
+            # indices and the row pointers
+            indices, indptr = self.first_batch.data[1:]
+            self.provide_data += [(data_name + '_indices', indices.shape),
+                                  (data_name + '_indptr', indptr.shape)]
+            self.batch_size = label.shape[0]
+        if self.first_batch.bucket_key is not None:
+            # the shapes of the largest bucket, as BucketingModule binds it first
+            buckets = str(kwargs['buckets']).strip('()[] ').split(',')
+            self.default_bucket_key = max(int(k) for k in buckets if k.strip())
+            seq_shape = lambda s: (s[0], self.default_bucket_key) + tuple(s[2:])
+            self.provide_data = [(n, seq_shape(s)) for n, s in self.provide_data]
+            self.provide_label = [(n, seq_shape(s)) for n, s in self.provide_label]
 
 
     def __del__(self):
@@ -470,14 +771,34 @@ class MXDataIter(DataIter):
         self._debug_skip_load = True
         logging.info('Set debug_skip_load to be true, will simply return first batch')
 
-    def reset(self):
+    def reset(self, **kwargs):
+        """Reset the iterator, with new values of some of its parameters if given.
+
+        Parameters
+        ----------
+        **kwargs
+            new values of the parameters, such as data_shape and the crop sizes of
+            ImageRecordIter between the epochs of a progressive resizing. The
+            iterator keeps its threads and reallocates its buffers.
+        """
         self._debug_at_begin = True
         self.first_batch = None
-        check_call(_LIB.MXDataIterBeforeFirst(self.handle))
+        if not kwargs:
+            check_call(_LIB.MXDataIterBeforeFirst(self.handle))
+            return
+        keys = c_array(ctypes.c_char_p, [c_str(k) for k in kwargs])
+        vals = c_array(ctypes.c_char_p, [c_str(str(v)) for v in kwargs.values()])
+        check_call(_LIB.MXDataIterReset(self.handle, mx_uint(len(kwargs)), keys, vals))
+        # the shapes of the batches may change
+        self.first_batch = self.next()
+        self.provide_data = [(self._data_name, self.first_batch.data[0].shape)] + \
+                            self.provide_data[1:]
+        self.provide_label = [(self._label_name, self.first_batch.label[0].shape)]
 
     def next(self):
         if self._debug_skip_load and not self._debug_at_begin:
-            return  DataBatch(data=[self.getdata()], label=[self.getlabel()], pad=self.getpad(),
+            return  DataBatch(data=[self.getdata()] + self.getextradata(),
+                              label=[self.getlabel()], pad=self.getpad(),
                               index=self.getindex())
         if self.first_batch is not None:
             batch = self.first_batch
@@ -487,8 +808,15 @@ class MXDataIter(DataIter):
         next_res = ctypes.c_int(0)
         check_call(_LIB.MXDataIterNext(self.handle, ctypes.byref(next_res)))
         if next_res.value:
-            return DataBatch(data=[self.getdata()], label=[self.getlabel()], pad=self.getpad(),
-                             index=self.getindex())
+            batch = DataBatch(data=[self.getdata()] + self.getextradata(),
+                              label=[self.getlabel()], pad=self.getpad(),
+                              index=self.getindex())
+            bucket_key = self.getbucketkey()
+            if bucket_key >= 0:
+                batch.bucket_key = bucket_key
+                batch.provide_data = [(self._data_name, batch.data[0].shape)]
+                batch.provide_label = [(self._label_name, batch.label[0].shape)]
+            return batch
         else:
             raise StopIteration
 
@@ -504,6 +832,15 @@ class MXDataIter(DataIter):
         check_call(_LIB.MXDataIterGetData(self.handle, ctypes.byref(hdl)))
         return NDArray(hdl, False)
 
+    def getextradata(self):
+        """The arrays of the batch after the data and the label, the column indices and
+        the row pointers of a batch in compressed sparse row format."""
+        size = mx_uint()
+        handles = ctypes.POINTER(NDArrayHandle)()
+        check_call(_LIB.MXDataIterGetExtraData(self.handle, ctypes.byref(size),
+                                               ctypes.byref(handles)))
+        return [NDArray(NDArrayHandle(handles[i]), False) for i in range(size.value)]
+
     def getlabel(self):
         hdl = NDArrayHandle()
         check_call(_LIB.MXDataIterGetLabel(self.handle, ctypes.byref(hdl)))
@@ -525,6 +862,36 @@ class MXDataIter(DataIter):
         check_call(_LIB.MXDataIterGetPadNum(self.handle, ctypes.byref(pad)))
         return pad.value
 
+    def get_stats(self, reset=False):
+        """Get the counters of the stages of the io pipelines, summed over
+        all the iterators of the process.
+
+        Parameters
+        ----------
+        reset : bool
+            whether to reset the counters after
+
+        Returns
+        -------
+        stats : dict
+            elapsed_s, the seconds since the last reset, and stages, a list of
+            dict with the name, items, items_per_s, busy_s and utilization of
+            each stage, and for a stage feeding a queue, its average occupancy
+            queue and its queue_capacity.
+        """
+        out = ctypes.c_char_p()
+        check_call(_LIB.MXDataIterGetStats(ctypes.c_int(reset), ctypes.byref(out)))
+        return json.loads(py_str(out.value))
+
+    def getbucketkey(self):
+        """The bucket key of the batch, -1 if the iterator has no buckets."""
+        bucket_key = ctypes.c_int(-1)
+        check_call(_LIB.MXDataIterGetBucketKey(self.handle, ctypes.byref(bucket_key)))
+        return bucket_key.value
+
+# parameters of the iterators which are those of the ImageNormalize operator
+_NORMALIZE_PARAMS = ('mean_r', 'mean_g', 'mean_b', 'mean_a', 'scale', 'mirror', 'rand_mirror')
+
 def _make_io_iterator(handle):
     """Create an io iterator by handle."""
     name = ctypes.c_char_p()
@@ -584,7 +951,12 @@ def _make_io_iterator(handle):
         if len(args):
             raise TypeError('%s can only accept keyword arguments' % iter_name)
 
-        return MXDataIter(iter_handle, **kwargs)
+        dataiter = MXDataIter(iter_handle, **kwargs)
+        if str(kwargs.get('dtype')) == 'uint8':
+            # the normalization left to the ImageNormalize operator
+            dataiter.normalize_params = dict((k, kwargs[k]) for k in _NORMALIZE_PARAMS
+                                             if k in kwargs)
+        return dataiter
 
     creator.__name__ = iter_name
     creator.__doc__ = doc_str
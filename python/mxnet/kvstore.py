@@ -3,8 +3,10 @@
 from __future__ import absolute_import
 
 import ctypes
+import json
 import pickle
-from .ndarray import NDArray
+import numpy as np
+from .ndarray import NDArray, RowSparseNDArray, _DTYPE_NP_TO_MX
 from .base import _LIB
 from .base import check_call, c_array, c_str, string_types, mx_uint, py_str
 from .base import NDArrayHandle, KVStoreHandle
@@ -36,6 +38,39 @@ def _ctype_key_value(keys, vals):
         return (c_array(ctypes.c_int, c_keys), c_array(NDArrayHandle, c_vals))
 
 
+def _is_row_sparse(vals):
+    """Whether the values are RowSparseNDArray"""
+    while isinstance(vals, (list, tuple)) and len(vals) > 0:
+        vals = vals[0]
+    return isinstance(vals, RowSparseNDArray)
+
+
+def _ctype_key_row_sparse(keys, vals):
+    """
+    Return ctype arrays for the key, row indices and rows of row sparse values
+    """
+    if isinstance(keys, int):
+        if isinstance(vals, RowSparseNDArray):
+            vals = [vals]
+        for value in vals:
+            assert(isinstance(value, RowSparseNDArray))
+        return (c_array(ctypes.c_int, [keys] * len(vals)),
+                c_array(NDArrayHandle, [value.indices.handle for value in vals]),
+                c_array(NDArrayHandle, [value.values.handle for value in vals]))
+    else:
+        assert(len(keys) == len(vals))
+        c_keys = []
+        c_ids = []
+        c_vals = []
+        for i in range(len(keys)):
+            c_key_i, c_ids_i, c_val_i = _ctype_key_row_sparse(keys[i], vals[i])
+            c_keys += c_key_i
+            c_ids += c_ids_i
+            c_vals += c_val_i
+        return (c_array(ctypes.c_int, c_keys), c_array(NDArrayHandle, c_ids),
+                c_array(NDArrayHandle, c_vals))
+
+
 def _updater_wrapper(updater):
     """ a wrapper for the user-defined handle """
     def updater_handle(key, lhs_handle, rhs_handle, _):
@@ -118,7 +153,10 @@ class KVStore(object):
             Keys
 
         value : NDArray or list of NDArray or list of list of NDArray
-            According values
+            According values. They can also be RowSparseNDArray, then only the
+            stored rows are pushed, and the updater is only applied to the rows
+            pushed, which requires an optimizer without state such as sgd without
+            momentum.
 
         priority : int, optional
             The priority of the push operation.
@@ -160,6 +198,12 @@ class KVStore(object):
         [[ 4.  4.  4.]
         [ 4.  4.  4.]]
         """
+        if _is_row_sparse(value):
+            ckeys, cids, cvals = _ctype_key_row_sparse(key, value)
+            check_call(_LIB.MXKVStorePushRowSparse(
+                self.handle, mx_uint(len(ckeys)), ckeys, cids, cvals,
+                ctypes.c_int(priority)))
+            return
         ckeys, cvals = _ctype_key_value(key, value)
         check_call(_LIB.MXKVStorePush(
             self.handle, mx_uint(len(ckeys)), ckeys, cvals,
@@ -184,7 +228,8 @@ class KVStore(object):
             Keys
 
         out: NDArray or list of NDArray or list of list of NDArray
-            According values
+            According values. They can also be RowSparseNDArray, then only the rows
+            of their indices are pulled into their values.
 
         priority : int, optional
             The priority of the push operation.
@@ -223,6 +268,12 @@ class KVStore(object):
         [ 2.  2.  2.]]
         """
         assert(out is not None)
+        if _is_row_sparse(out):
+            ckeys, cids, cvals = _ctype_key_row_sparse(key, out)
+            check_call(_LIB.MXKVStorePullRowSparse(
+                self.handle, mx_uint(len(ckeys)), ckeys, cids, cvals,
+                ctypes.c_int(priority)))
+            return
         ckeys, cvals = _ctype_key_value(key, out)
         check_call(_LIB.MXKVStorePull(
             self.handle, mx_uint(len(ckeys)), ckeys, cvals,
@@ -233,7 +284,9 @@ class KVStore(object):
 
         If there are multiple machines, this process (should be a worker node)
         will pack this optimizer and send it to all servers. It returns after
-        this action is done.
+        this action is done. A ccSGD optimizer with the same learning rate and
+        weight decay for all keys runs in C++ on the servers, without calling
+        back to python.
 
         Parameters
         ----------
@@ -244,7 +297,14 @@ class KVStore(object):
         check_call(_LIB.MXKVStoreIsWorkerNode(ctypes.byref(is_worker)))
 
         # pylint: disable=invalid-name
-        if 'dist' in self.type and is_worker.value:
+        params = _server_optimizer_params(optimizer)
+        if 'dist' in self.type and is_worker.value and params is not None:
+            keys = [c_str(k) for k, _ in params]
+            vals = [c_str(str(v)) for _, v in params]
+            check_call(_LIB.MXKVStoreSetServerOptimizer(
+                self.handle, c_str('ccsgd'), mx_uint(len(keys)),
+                c_array(ctypes.c_char_p, keys), c_array(ctypes.c_char_p, vals)))
+        elif 'dist' in self.type and is_worker.value:
             # send the optimizer to server
             try:
                 # use ASCII protocol 0, might be slower, but not a big ideal
@@ -255,6 +315,46 @@ class KVStore(object):
         else:
             self._set_updater(opt.get_updater(optimizer))
 
+    def set_gradient_compression(self, compression_params):
+        """Set the compression of gradients pushed to servers
+
+        Only the distributed kvstore compresses gradients. With type '2bit',
+        each gradient value is sent in 2 bits as -threshold, 0 or threshold,
+        and what is not sent is accumulated locally and added to the next push.
+        It must be called on all workers before init.
+
+        Parameters
+        ----------
+        compression_params : dict
+            for example {'type': '2bit', 'threshold': 0.5}
+        """
+        keys = [c_str(k) for k, _ in compression_params.items()]
+        vals = [c_str(str(v)) for _, v in compression_params.items()]
+        check_call(_LIB.MXKVStoreSetGradientCompression(
+            self.handle, mx_uint(len(keys)),
+            c_array(ctypes.c_char_p, keys), c_array(ctypes.c_char_p, vals)))
+
+    def set_wire_dtype(self, key, dtype):
+        """Set the type the values of keys are sent in between workers and servers
+
+        Only the distributed kvstore sends values. The pushes and pulls of float16
+        keys carry half of the bytes, the servers still store and merge the values
+        in float32. Keys which need the precision, such as the moving statistics
+        of batch normalization, are better left in float32. The initialization is
+        always sent in float32.
+
+        Parameters
+        ----------
+        key : int or sequence of int
+            The keys.
+        dtype : str or numpy.dtype
+            'float16', or 'float32' which is the default.
+        """
+        keys = key if isinstance(key, (list, tuple)) else [key]
+        check_call(_LIB.MXKVStoreSetWireDType(
+            self.handle, mx_uint(len(keys)), c_array(ctypes.c_int, keys),
+            ctypes.c_int(_DTYPE_NP_TO_MX[np.dtype(dtype).type])))
+
     @property
     def type(self):
         """Get the type of this kvstore
@@ -294,6 +394,31 @@ class KVStore(object):
         check_call(_LIB.MXKVStoreGetGroupSize(self.handle, ctypes.byref(size)))
         return size.value
 
+    def get_stats(self, reset=False):
+        """Get the counters of the communication of this worker and of the servers.
+
+        The worker counts the bytes pushed to and pulled from each server, and
+        histograms of the times until its pushes are answered and its pulls
+        arrive, and of the times waited for them. Each server counts the bytes
+        of each worker, the delays of the workers in the sync rounds and how
+        often each arrived last, and histograms of the round skews and of the
+        update times. A histogram bucket ``[b, n]`` counts the ``n`` durations
+        below ``b`` microseconds and above the previous bound.
+
+        Parameters
+        ----------
+        reset : bool
+            Whether to reset the counters after.
+
+        Returns
+        -------
+        stats : dict
+            The counters, empty for a local kvstore.
+        """
+        out = ctypes.c_char_p()
+        check_call(_LIB.MXKVStoreGetStats(self.handle, ctypes.c_int(reset), ctypes.byref(out)))
+        return json.loads(py_str(out.value))
+
     def _set_updater(self, updater):
         """Set a push updater into the store.
 
@@ -357,6 +482,21 @@ class KVStore(object):
         check_call(_LIB.MXKVStoreSendCommmandToServers(
             self.handle, mx_uint(head), c_str(body)))
 
+def _server_optimizer_params(optimizer):
+    """The parameters of the native optimizer run by the servers instead of
+    optimizer, or None if it needs python."""
+    if not isinstance(optimizer, opt.ccSGD) or optimizer.lr_scheduler is not None:
+        return None
+    if any(v != 1.0 for v in optimizer.lr_mult.values()):
+        return None
+    if optimizer.wd != 0 and any(v != 1.0 for v in optimizer.wd_mult.values()):
+        return None
+    return [('momentum', optimizer.momentum),
+            ('rescale_grad', optimizer.rescale_grad),
+            ('clip_gradient', optimizer.clip_gradient),
+            ('learning_rate', optimizer.lr),
+            ('wd', optimizer.wd)]
+
 def create(name='local'):
     """Create a new KVStore.
 
@@ -19,11 +19,17 @@ def check_label_shapes(labels, preds, shape=0):
                          "predictions {}".format(label_shape, pred_shape))
 
 class EvalMetric(object):
-    """Base class of all evaluation metrics."""
+    """Base class of all evaluation metrics.
+
+    Metrics computed with NDArray operators add their per batch results with
+    `_accumulate`, the sums stay on the devices of the predictions and are read
+    back by `get`, so `update` does not wait for the batch to finish.
+    """
 
     def __init__(self, name, num=None):
         self.name = name
         self.num = num
+        self._device_sum = {}
         self.reset()
 
     def update(self, label, pred):
@@ -47,6 +53,21 @@ class EvalMetric(object):
         else:
             self.num_inst = [0] * self.num
             self.sum_metric = [0.0] * self.num
+        self._device_sum = {}
+
+    def _accumulate(self, value):
+        """Add an NDArray of shape (1,) to the running sum on its device."""
+        ctx = value.context
+        if ctx in self._device_sum:
+            self._device_sum[ctx] += value
+        else:
+            self._device_sum[ctx] = value
+
+    def _sync(self):
+        """Move the sums on the devices to sum_metric, waiting for them."""
+        for value in self._device_sum.values():
+            self.sum_metric += float(value.asscalar())
+        self._device_sum = {}
 
     def get(self):
         """Get the current evaluation result.
@@ -59,6 +80,7 @@ class EvalMetric(object):
            Value of the evaluation.
         """
         if self.num == None:
+            self._sync()
             if self.num_inst == 0:
                 return (self.name, float('nan'))
             else:
@@ -134,13 +156,15 @@ class Accuracy(EvalMetric):
         check_label_shapes(labels, preds)
 
         for i in range(len(labels)):
-            pred_label = ndarray.argmax_channel(preds[i]).asnumpy().astype('int32')
-            label = labels[i].asnumpy().astype('int32')
+            pred_label = ndarray.argmax_channel(preds[i])
+            label = labels[i].as_in_context(pred_label.context)
 
-            check_label_shapes(label, pred_label)
+            check_label_shapes(label, pred_label, shape=1)
 
-            self.sum_metric += (pred_label.flat == label.flat).sum()
-            self.num_inst += len(pred_label.flat)
+            # the labels are integers, a hit is a zero difference
+            hits = 1 - ndarray.sign(ndarray.abs(pred_label - label))
+            self._accumulate(ndarray.sum(hits))
+            self.num_inst += pred_label.size
 
 class TopKAccuracy(EvalMetric):
     """Calculate top k predictions accuracy"""
@@ -158,19 +182,16 @@ class TopKAccuracy(EvalMetric):
         check_label_shapes(labels, preds)
 
         for i in range(len(labels)):
-            assert(len(preds[i].shape) <= 2), 'Predictions should be no more than 2 dims'
-            pred_label = numpy.argsort(preds[i].asnumpy().astype('float32'), axis=1)
-            label = labels[i].asnumpy().astype('int32')
-            check_label_shapes(label, pred_label)
-            num_samples = pred_label.shape[0]
-            num_dims = len(pred_label.shape)
-            if num_dims == 1:
-                self.sum_metric += (pred_label.flat == label.flat).sum()
-            elif num_dims == 2:
-                num_classes = pred_label.shape[1]
-                top_k = min(num_classes, self.top_k)
-                for j in range(top_k):
-                    self.sum_metric += (pred_label[:, num_classes - 1 - j].flat == label.flat).sum()
+            assert(len(preds[i].shape) == 2), 'Predictions should be 2 dims'
+            num_samples, num_classes = preds[i].shape
+            top_k = min(num_classes, self.top_k)
+            if labels[i].size != num_samples:
+                raise ValueError("Size of labels {} does not match number of "
+                                 "predictions {}".format(labels[i].size, num_samples))
+            label = labels[i].as_in_context(preds[i].context).reshape((num_samples,))
+            # the mask of the top k classes of each sample, picked at the label
+            mask = ndarray.topk(preds[i], axis=1, k=top_k, ret_typ='mask')
+            self._accumulate(ndarray.sum(ndarray.choose_element_0index(mask, label)))
             self.num_inst += num_samples
 
 class F1(EvalMetric):
@@ -287,14 +308,11 @@ class CrossEntropy(EvalMetric):
         check_label_shapes(labels, preds)
 
         for label, pred in zip(labels, preds):
-            label = label.asnumpy()
-            pred = pred.asnumpy()
-
-            label = label.ravel()
+            label = label.as_in_context(pred.context).reshape((label.size,))
             assert label.shape[0] == pred.shape[0]
 
-            prob = pred[numpy.arange(label.shape[0]), numpy.int64(label)]
-            self.sum_metric += (-numpy.log(prob)).sum()
+            prob = ndarray.choose_element_0index(pred, label)
+            self._accumulate(-ndarray.sum(ndarray.log(prob)))
             self.num_inst += label.shape[0]
 
 class Torch(EvalMetric):
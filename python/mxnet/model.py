@@ -3,6 +3,7 @@
 """MXNet model module"""
 from __future__ import absolute_import
 
+import json
 import numpy as np
 import time
 import logging
@@ -79,34 +80,195 @@ def _create_kvstore(kvstore, num_device, arg_params):
 def _initialize_kvstore(kvstore, param_arrays, arg_params, param_names,
                         update_on_kvstore):
     """ Initialize kvstore"""
-    for idx in range(len(param_arrays)):
-        param_on_devs = param_arrays[idx]
-        kvstore.init(idx, arg_params[param_names[idx]])
+    if not param_arrays:
+        return
+    # a single init of all the parameters, so the workers synchronize once
+    kvstore.init(list(range(len(param_arrays))),
+                 [arg_params[name] for name in param_names])
+    if update_on_kvstore:
+        for idx in range(len(param_arrays)):
+            kvstore.pull(idx, param_arrays[idx], priority=-idx)
 
-        if update_on_kvstore:
-            kvstore.pull(idx, param_on_devs, priority=-idx)
+class _GradPusher(object):
+    """Push the gradient of each parameter to kvstore during backward.
+
+    The gradient of a parameter is pushed as soon as the operators writing it
+    have been issued on all the devices, so the communication of the top layers
+    overlaps with the backward of the layers below. The priority is the negative
+    parameter index, the layers close to the data are needed first by the next
+    forward. The pull is left to the update, after the whole backward is issued.
+
+    Parameters
+    ----------
+    kvstore : KVStore
+        The kvstore to push to.
+    skip : container of int, optional
+        The parameters not pushed, such as the ones with row sparse gradients.
+    """
+    def __init__(self, kvstore, skip=()):
+        self.kvstore = kvstore
+        self.skip = skip
+        self.pushed = set()
+        self._execs = None
+        self._grad_arrays = None
+        self._param_of_arg = {}
+        self._count = {}
+        self._num_passes = 1
+
+    def install(self, execs, param_idx, grad_arrays, num_passes=1):
+        """Install the callbacks on the executors, nothing is done if already installed.
+
+        Parameters
+        ----------
+        execs : list of Executor
+            The executor of each device.
+        param_idx : list of int
+            The argument index of each parameter.
+        grad_arrays : list of list of NDArray
+            The gradient of each parameter on each device.
+        num_passes : int
+            The number of backward passes of the executors adding to the gradients of
+            a batch, the gradients are pushed during the last one.
+        """
+        self._num_passes = num_passes
+        if self._execs == execs and self._grad_arrays is grad_arrays:
+            return
+        self._execs = list(execs)
+        self._grad_arrays = grad_arrays
+        self._param_of_arg = {arg: index for index, arg in enumerate(param_idx)}
+        self._count = {}
+        for exec_ in self._execs:
+            exec_.set_grad_ready_callback(self._ready)
+
+    def _ready(self, arg_index):
+        """Count the devices that issued the gradient, push when all did."""
+        index = self._param_of_arg.get(arg_index)
+        if index is None or index in self.pushed or index in self.skip:
+            return
+        grad_list = self._grad_arrays[index]
+        if grad_list[0] is None:
+            return
+        self._count[index] = self._count.get(index, 0) + 1
+        if self._count[index] == len(self._execs) * self._num_passes:
+            self.kvstore.push(index, grad_list, priority=-index)
+            self.pushed.add(index)
+
+    def reset(self):
+        """Return the indices pushed since the last reset, and start a new batch."""
+        pushed = self.pushed
+        self.pushed = set()
+        self._count = {}
+        return pushed
+
+# the operators with row sparse weight gradients, to the positions of their input
+# of row indices and of their weight
+_SPARSE_GRAD_OPS = {'Embedding': (0, 1), 'SparseFullyConnected': (1, 3)}
+
+def _sparse_grad_params(symbol, param_names):
+    """Find the parameters with row sparse gradients, the weights of Embedding and of
+    SparseFullyConnected with sparse_grad=True. Their rows are given by the data of the
+    Embedding or the indices of the SparseFullyConnected, which must be an input of
+    the network.
 
-def _update_params_on_kvstore(param_arrays, grad_arrays, kvstore):
-    """ Perform update of param_arrays from grad_arrays on kvstore."""
+    Returns
+    -------
+    dict of int to str
+        The index of each of these parameters to the name of their row indices input.
+    """
+    nodes = json.loads(symbol.tojson())['nodes']
+    index = {name: i for i, name in enumerate(param_names)}
+    num_uses = {}
+    for node in nodes:
+        for entry in node['inputs']:
+            num_uses[entry[0]] = num_uses.get(entry[0], 0) + 1
+    sparse = {}
+    for node in nodes:
+        if node['op'] not in _SPARSE_GRAD_OPS:
+            continue
+        if node.get('param', {}).get('sparse_grad', 'False') not in ('True', 'true', '1'):
+            continue
+        rows, weight = _SPARSE_GRAD_OPS[node['op']]
+        data, weight = node['inputs'][rows][0], node['inputs'][weight][0]
+        if nodes[weight]['name'] not in index:
+            continue
+        if nodes[data]['op'] != 'null' or num_uses[weight] != 1:
+            raise ValueError('%s %s with sparse_grad needs its row indices to be an input '
+                             'and its weight to be used only by it'
+                             % (node['op'], node['name']))
+        sparse[index[nodes[weight]['name']]] = nodes[data]['name']
+    return sparse
+
+def _sparse_grad_rows(execs, sparse_params):
+    """The row indices inputs of the row sparse gradients of each device."""
+    return {index: [exec_.arg_dict[name] for exec_ in execs]
+            for index, name in sparse_params.items()}
+
+def _push_row_sparse(kvstore, index, grad_list, data_list):
+    """Push the rows of the row sparse gradients, the rows of each device are the unique
+    values of its data. Returns the union of the rows."""
+    ids = [np.unique(data.asnumpy()) for data in data_list]
+    kvstore.push(index, [nd.row_sparse(g, i) for g, i in zip(grad_list, ids)],
+                 priority=-index)
+    return np.unique(np.concatenate(ids))
+
+def _pull_row_sparse(kvstore, index, arr_list, rows):
+    """Pull some rows to the arrays of each device, as RowSparseNDArray."""
+    indices = nd.array(rows)
+    outs = [nd.RowSparseNDArray(indices, nd.empty((len(rows),) + arr.shape[1:], arr.context),
+                                arr.shape) for arr in arr_list]
+    kvstore.pull(index, outs, priority=-index)
+    return outs
+
+def _update_params_on_kvstore(param_arrays, grad_arrays, kvstore, pushed=(), sparse=None):
+    """ Perform update of param_arrays from grad_arrays on kvstore.
+    The gradients in pushed are already pushed during backward, the gradients in
+    sparse are row sparse, with their row indices inputs on each device."""
+    sparse = sparse or {}
     for index, pair in enumerate(zip(param_arrays, grad_arrays)):
         arg_list, grad_list = pair
         if grad_list[0] is None:
             continue
-        # push gradient, priority is negative index
-        kvstore.push(index, grad_list, priority=-index)
+        if index in sparse:
+            # only the touched rows are pushed, updated and pulled
+            rows = _push_row_sparse(kvstore, index, grad_list, sparse[index])
+            for out, arg in zip(_pull_row_sparse(kvstore, index, arg_list, rows), arg_list):
+                out.copy_rows_to(arg)
+            continue
+        if index not in pushed:
+            # push gradient, priority is negative index
+            kvstore.push(index, grad_list, priority=-index)
         # pull back the weights
         kvstore.pull(index, arg_list, priority=-index)
 
 def _update_params(param_arrays, grad_arrays, updater, num_device,
-                   kvstore=None):
-    """ Perform update of param_arrays from grad_arrays not on kvstore."""
+                   kvstore=None, pushed=(), sparse=None):
+    """ Perform update of param_arrays from grad_arrays not on kvstore.
+    The gradients in pushed are already pushed during backward, the gradients in
+    sparse are row sparse, with their row indices inputs on each device. They are
+    made dense for the updater."""
+    sparse = sparse or {}
+    # the updaters of the optimizers in C++ update all of the weights at once
+    multi = getattr(updater, 'multi', None)
+    updates = []
     for index, pair in enumerate(zip(param_arrays, grad_arrays)):
         arg_list, grad_list = pair
         if grad_list[0] is None:
             continue
-        if kvstore:
-            # push gradient, priority is negative index
-            kvstore.push(index, grad_list, priority=-index)
+        if index in sparse:
+            if kvstore:
+                # only the touched rows are summed over devices
+                rows = _push_row_sparse(kvstore, index, grad_list, sparse[index])
+                outs = _pull_row_sparse(kvstore, index, grad_list, rows)
+            else:
+                outs = [nd.row_sparse(g, np.unique(data.asnumpy()))
+                        for g, data in zip(grad_list, sparse[index])]
+            for out, grad in zip(outs, grad_list):
+                grad[:] = 0
+                out.copy_rows_to(grad)
+        elif kvstore:
+            if index not in pushed:
+                # push gradient, priority is negative index
+                kvstore.push(index, grad_list, priority=-index)
             # pull back the sum gradients, to the same locations.
             kvstore.pull(index, grad_list, priority=-index)
         for k, p in enumerate(zip(arg_list, grad_list)):
@@ -114,7 +276,13 @@ def _update_params(param_arrays, grad_arrays, updater, num_device,
             # state for the same index but on diff devs, TODO(mli)
             # use a better solution latter
             w, g = p
-            updater(index*num_device+k, g, w)
+            if multi is not None:
+                updates.append((index*num_device+k, g, w))
+            else:
+                updater(index*num_device+k, g, w)
+    if updates:
+        indices, grads, weights = zip(*updates)
+        multi(list(indices), list(grads), list(weights))
 
 def _train_multi_device(symbol, ctx, arg_names, param_names, aux_names,
                         arg_params, aux_params,
@@ -208,6 +376,9 @@ def _train_multi_device(symbol, ctx, arg_names, param_names, aux_names,
     if update_on_kvstore:
         kvstore.set_optimizer(optimizer)
 
+    sparse_params = _sparse_grad_params(symbol, executor_manager.param_names)
+    grad_pusher = _GradPusher(kvstore, skip=sparse_params) if kvstore else None
+
     # Now start training
     train_data.reset()
     for epoch in range(begin_epoch, end_epoch):
@@ -225,18 +396,27 @@ def _train_multi_device(symbol, ctx, arg_names, param_names, aux_names,
                     monitor.tic()
 
                 executor_manager.forward(is_train=True)
+                if grad_pusher is not None:
+                    execgrp = executor_manager.curr_execgrp
+                    grad_pusher.install(execgrp.train_execs, execgrp.param_idx,
+                                        executor_manager.grad_arrays)
                 executor_manager.backward()
+                pushed = grad_pusher.reset() if grad_pusher is not None else ()
+                sparse = _sparse_grad_rows(executor_manager.curr_execgrp.train_execs,
+                                           sparse_params)
 
                 if update_on_kvstore:
                     _update_params_on_kvstore(executor_manager.param_arrays,
                                               executor_manager.grad_arrays,
-                                              kvstore)
+                                              kvstore, pushed, sparse)
                 else:
                     _update_params(executor_manager.param_arrays,
                                    executor_manager.grad_arrays,
                                    updater=updater,
                                    num_device=len(ctx),
-                                   kvstore=kvstore)
+                                   kvstore=kvstore,
+                                   pushed=pushed,
+                                   sparse=sparse)
 
                 if monitor is not None:
                     monitor.toc_print()
@@ -309,7 +489,7 @@ def _train_multi_device(symbol, ctx, arg_names, param_names, aux_names,
     return
 
 
-def save_checkpoint(prefix, epoch, symbol, arg_params, aux_params):
+def save_checkpoint(prefix, epoch, symbol, arg_params, aux_params, background=False):
     """Checkpoint the model data into file.
 
     Parameters
@@ -324,6 +504,9 @@ def save_checkpoint(prefix, epoch, symbol, arg_params, aux_params):
         Model parameter, dict of name to NDArray of net's weights.
     aux_params : dict of str to NDArray
         Model parameter, dict of name to NDArray of net's auxiliary states.
+    background : bool, optional
+        Whether to write the parameters in the background while the training
+        continues, see `ndarray.save`.
     Notes
     -----
     - ``prefix-symbol.json`` will be saved for symbol.
@@ -333,7 +516,7 @@ def save_checkpoint(prefix, epoch, symbol, arg_params, aux_params):
     save_dict = {('arg:%s' % k) : v for k, v in arg_params.items()}
     save_dict.update({('aux:%s' % k) : v for k, v in aux_params.items()})
     param_name = '%s-%04d.params' % (prefix, epoch)
-    nd.save(param_name, save_dict)
+    nd.save(param_name, save_dict, background=background)
     logging.info('Saved checkpoint to \"%s\"', param_name)
 
 
@@ -349,12 +349,24 @@ class BaseModule(object):
         for epoch in range(begin_epoch, num_epoch):
             tic = time.time()
             eval_metric.reset()
-            for nbatch, data_batch in enumerate(train_data):
+            nbatch = 0
+            data_iter = iter(train_data)
+            next_data_batch = next(data_iter, None)
+            end_of_batch = next_data_batch is None
+            while not end_of_batch:
+                data_batch = next_data_batch
                 if monitor is not None:
                     monitor.tic()
                 self.forward_backward(data_batch)
                 self.update()
                 self.update_metric(eval_metric, data_batch.label)
+                # fetch the next batch and start copying it while this one computes,
+                # after the last use of this one since iterators may reuse its arrays
+                next_data_batch = next(data_iter, None)
+                if next_data_batch is None:
+                    end_of_batch = True
+                else:
+                    self.prepare(next_data_batch)
 
                 if monitor is not None:
                     monitor.toc_print()
@@ -365,6 +377,7 @@ class BaseModule(object):
                                                      locals=locals())
                     for callback in _as_list(batch_end_callback):
                         callback(batch_end_params)
+                nbatch += 1
 
             # one epoch of training is finished
             for name, val in eval_metric.get_name_value():
@@ -518,6 +531,18 @@ class BaseModule(object):
     ################################################################################
     # Computations
     ################################################################################
+    def prepare(self, data_batch):
+        """Prepare the module for processing `data_batch`, ahead of `forward`.
+        Usually this starts copying the inputs to the devices. The default
+        does nothing.
+
+        Parameters
+        ----------
+        data_batch : DataBatch
+            The batch to be passed to the next call of `forward`.
+        """
+        pass
+
     def forward(self, data_batch, is_train=None):
         """Forward computation.
 
@@ -16,6 +16,10 @@ from .module import Module
 class BucketingModule(BaseModule):
     """A bucketing module is a module that support bucketing.
 
+    The executors of all the buckets share the executor of the default bucket,
+    their internal memory is carved from one pool that grows to the largest
+    bucket, so bind the default bucket with the largest shapes when possible.
+
     Parameters
     ----------
     sym_gen : function
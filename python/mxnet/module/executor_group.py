@@ -4,11 +4,13 @@
 
 import numpy as np
 import logging
+import threading
+import time
 
 from .. import context as ctx
 from .. import ndarray as nd
+from .. import storage
 
-from ..base import mx_real_t
 from ..executor_manager import _split_input_slice, _load_data, _load_label
 
 def _merge_multi_context(outputs):
@@ -18,6 +20,22 @@ def _merge_multi_context(outputs):
     outputs = [nd.concatenate(x, always_copy=False) for x in outputs]
     return outputs
 
+def _broadcast(block):
+    """Copy the first array of `block` to the others. The number of arrays holding the
+    value doubles at each step, so that the copies between the devices run together.
+    """
+    done = 1
+    while done < len(block):
+        for i in range(min(done, len(block) - done)):
+            block[i].copyto(block[done + i])
+        done *= 2
+
+def _copy_staged(staged, targets):
+    """Copy the staging buffers of `prepare` to the arrays of the executors."""
+    for d_staged, d_targets in zip(staged, targets):
+        for (_, d_src), (_, d_dst) in zip(d_staged, d_targets):
+            d_src.copyto(d_dst)
+
 class DataParallelExecutorGroup(object):
     """DataParallelExecutorGroup is a group of executors that lives on a group of devices.
     This is a helper class used to implement data parallelization. Each mini-batch will
@@ -29,9 +47,11 @@ class DataParallelExecutorGroup(object):
         The common symbolic computation graph for all executors.
     contexts : list
         A list of contexts.
-    workload : list
+    workload : list or str
         If not `None`, could be a list of numbers that specify the workload to be assigned
-        to different context. Larger number indicate heavier workload.
+        to different context. Larger number indicate heavier workload. `'adaptive'` starts
+        from a uniform workload, then measures the forward and backward time of each device
+        every `rebalance_interval` training steps and moves samples to the faster devices.
     data_shapes : list
         Should be a list of (name, shape) tuples, for the shapes of data. Note the order is
         important and should be the same as the order that the `DataIter` provide the data.
@@ -57,17 +77,54 @@ class DataParallelExecutorGroup(object):
         of the data/label inputs.
     logger : Logger
         Default is `logging`.
+    rebalance_interval : int
+        Number of training steps between two measures of the adaptive workload.
+    group2ctx : dict of str to Context
+        Default is `None`. The devices of the `ctx_group` attributes, for model parallelism.
+    num_micro_batches : int
+        Default is 1. With more, each batch is split into micro-batches, which run on
+        executors sharing the parameters of a single context and its `group2ctx`. The
+        engine then runs a stage on micro-batch i+1 while the next stage runs on
+        micro-batch i. The gradients are accumulated over the micro-batches.
+    fixed_param_names : list of str
+        Default is `None`. The parameters whose gradients are not computed, their
+        gradient arrays are `None`.
+    num_accumulation_steps : int
+        Default is 1. With more, the executors are bound for a batch this many times
+        smaller, and each batch is split into micro-batches which run one after the
+        other on the same executors, reusing their memory. A training `forward` runs
+        the first micro-batch and `backward` runs the others, adding up the gradients
+        of the parameters, so that the gradient arrays hold those of the whole batch.
     """
     def __init__(self, symbol, contexts, workload, data_shapes, label_shapes, param_names,
                  for_training, inputs_need_grad, shared_group=None, input_types=None,
-                 logger=logging):
+                 logger=logging, rebalance_interval=50, group2ctx=None, num_micro_batches=1,
+                 fixed_param_names=None, num_accumulation_steps=1):
         self.param_names = param_names
+        self.fixed_param_names = set(fixed_param_names or [])
         self.arg_names = symbol.list_arguments()
+        self.param_idx = [i for i, name in enumerate(self.arg_names) if name in param_names]
         self.aux_names = symbol.list_auxiliary_states()
 
         self.symbol = symbol
+        self.group2ctx = group2ctx
+        self.num_micro_batches = num_micro_batches
+        if num_micro_batches > 1:
+            assert len(contexts) == 1, 'micro-batches are pipelined on a single context'
+            assert workload != 'adaptive', 'micro-batches have a uniform workload'
+            contexts = contexts * num_micro_batches
+            workload = [1] * num_micro_batches
+        self.num_accumulation_steps = num_accumulation_steps
+        if num_accumulation_steps > 1:
+            assert num_micro_batches == 1, 'micro-batches are either pipelined or accumulated'
+            assert workload != 'adaptive', 'accumulated micro-batches have a fixed workload'
+            assert not inputs_need_grad, 'the input gradients are those of a micro-batch'
         self.contexts = contexts
+        self.adaptive_workload = workload == 'adaptive'
+        if self.adaptive_workload:
+            workload = [1] * len(contexts)
         self.workload = workload
+        self.rebalance_interval = rebalance_interval
 
         self.for_training = for_training
         self.inputs_need_grad = inputs_need_grad
@@ -89,6 +146,22 @@ class DataParallelExecutorGroup(object):
         self.param_arrays = None
         self.grad_arrays = None
         self.aux_arrays = None
+        self.staged_arrays = None
+        self._prepared = None
+        self.data_shapes = None
+        self.label_shapes = None
+        self._monitor = None
+        # the batch and the is_train of the last forward, while its micro-batches run,
+        # and copies of the outputs of all the micro-batches but the last
+        self._accum_batch = None
+        self._accum_train = None
+        self._accum_outputs = None
+
+        # the state of the adaptive workload, samples per second of each device
+        self._num_train_steps = 0
+        self._step_start = None
+        self._rates = None
+        self._pending_slices = None
 
         # calculate workload and bind executors
         self.decide_slices(data_shapes)
@@ -106,8 +179,12 @@ class DataParallelExecutorGroup(object):
         self.batch_size = data_shapes[0][1][0]
         for shape in data_shapes:
             assert shape[1][0] == self.batch_size, "all the data must have the same batch size"
+        assert self.batch_size % self.num_accumulation_steps == 0, \
+            'the batch size must be a multiple of the number of accumulation steps'
 
-        self.slices = _split_input_slice(self.batch_size, self.workload)
+        # the slices of a micro-batch, the whole batch without accumulation
+        self.slices = _split_input_slice(self.batch_size // self.num_accumulation_steps,
+                                         self.workload)
 
     def bind_exec(self, data_shapes, label_shapes, shared_group):
         """Bind executors on their respective devices.
@@ -118,31 +195,42 @@ class DataParallelExecutorGroup(object):
         label_shapes : list
         shared_group : DataParallelExecutorGroup
         """
+        self.data_shapes = data_shapes
+        self.label_shapes = label_shapes
         self.execs = []
         for i in range(len(self.contexts)):
             self.execs.append(self._bind_ith_exec(i, data_shapes, label_shapes, shared_group))
 
         # convenient data structures
-        self.data_arrays = [[(self.slices[i], e.arg_dict[name]) for i, e in enumerate(self.execs)]
-                            for name, _ in data_shapes]
-        if label_shapes is not None:
-            self.label_arrays = [[(self.slices[i], e.arg_dict[name])
-                                  for i, e in enumerate(self.execs)]
-                                 for name, _ in label_shapes]
-        else:
-            self.label_arrays = None
+        self._collect_input_arrays()
 
-        self.param_arrays = [[exec_.arg_arrays[i] for exec_ in self.execs]
+        # the micro-batches share the parameters of the first executor
+        param_execs = self.execs[:1] if self.num_micro_batches > 1 else self.execs
+        self.param_arrays = [[exec_.arg_arrays[i] for exec_ in param_execs]
                              for i, name in enumerate(self.arg_names)
                              if name in self.param_names]
         if self.for_training:
-            self.grad_arrays = [[exec_.grad_arrays[i] for exec_ in self.execs]
+            self.grad_arrays = [[exec_.grad_arrays[i] for exec_ in param_execs]
                                 for i, name in enumerate(self.arg_names)
                                 if name in self.param_names]
         else:
             self.grad_arrays = None
 
-        data_names = [x[0] for x in data_shapes]
+        self.aux_arrays = [[exec_.aux_arrays[i] for exec_ in param_execs]
+                           for i in range(len(self.aux_names))]
+
+    def _collect_input_arrays(self):
+        """Collect the sliced input arrays of the executors, after binding or reshaping."""
+        self.data_arrays = [[(self.slices[i], e.arg_dict[name]) for i, e in enumerate(self.execs)]
+                            for name, _ in self.data_shapes]
+        if self.label_shapes is not None:
+            self.label_arrays = [[(self.slices[i], e.arg_dict[name])
+                                  for i, e in enumerate(self.execs)]
+                                 for name, _ in self.label_shapes]
+        else:
+            self.label_arrays = None
+
+        data_names = [x[0] for x in self.data_shapes]
         if self.inputs_need_grad:
             self.input_grad_arrays = [[exec_.grad_arrays[i] for exec_ in self.execs]
                                       for i, name in enumerate(self.arg_names)
@@ -150,8 +238,61 @@ class DataParallelExecutorGroup(object):
         else:
             self.input_grad_arrays = None
 
-        self.aux_arrays = [[exec_.aux_arrays[i] for exec_ in self.execs]
-                           for i in range(len(self.aux_names))]
+        # the staging buffers of prepare are allocated on first use
+        self.staged_arrays = None
+        self._prepared = None
+
+    def _measure_step(self):
+        """Wait for each device in its own thread, then update the rates of the devices
+        and plan new slices if they shorten the step by more than 5%."""
+        finish = [None] * len(self.execs)
+        def _wait(i):
+            """Wait for the outputs and the gradients of executor i."""
+            exec_ = self.execs[i]
+            for arr in exec_.outputs + [g for g in exec_.grad_arrays or [] if g is not None]:
+                arr.wait_to_read()
+            finish[i] = time.time()
+        threads = [threading.Thread(target=_wait, args=(i,)) for i in range(len(self.execs))]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        sizes = [islice.stop - islice.start for islice in self.slices]
+        rates = [n / max(t - self._step_start, 1e-6) for n, t in zip(sizes, finish)]
+        if self._rates is None:
+            self._rates = rates
+        else:
+            self._rates = [0.5 * (old + new) for old, new in zip(self._rates, rates)]
+
+        def _step_time(slices):
+            """The time of a step, that of the slowest device."""
+            return max((islice.stop - islice.start) / rate
+                       for islice, rate in zip(slices, self._rates))
+        try:
+            slices = _split_input_slice(self.batch_size, self._rates)
+        except ValueError:
+            # a device would get no sample
+            return
+        if _step_time(slices) < 0.95 * _step_time(self.slices):
+            self._pending_slices = slices
+
+    def _apply_rebalance(self):
+        """Reshape the executors to the planned slices, the parameters stay shared."""
+        if self._pending_slices is None:
+            return
+        self.slices = self._pending_slices
+        self._pending_slices = None
+        self.workload = list(self._rates)
+        for i, exec_ in enumerate(self.execs):
+            input_shapes = dict(self._sliced_shape(self.data_shapes, i))
+            if self.label_shapes is not None:
+                input_shapes.update(dict(self._sliced_shape(self.label_shapes, i)))
+            self.execs[i] = exec_.reshape(allow_up_sizing=True, **input_shapes)
+            if self._monitor is not None:
+                self._monitor.install(self.execs[i])
+        self._collect_input_arrays()
+        self.logger.info('Rebalanced the batch over the devices: %s',
+                         [islice.stop - islice.start for islice in self.slices])
 
     def set_params(self, arg_params, aux_params):
         """Assign, i.e. copy parameters to all the executors.
@@ -163,9 +304,38 @@ class DataParallelExecutorGroup(object):
         aux_params : dict
             A dictionary of name to `NDArray` auxiliary variable mapping.
         """
-        for exec_ in self.execs:
+        param_execs = self.execs[:1] if self.num_micro_batches > 1 else self.execs
+        for exec_ in param_execs:
             exec_.copy_params_from(arg_params, aux_params)
 
+    def init_params(self, initializer, arg_params, aux_params):
+        """Initialize the parameters on the device of the first executor and broadcast
+        them to the others, instead of initializing them on the host and copying them to
+        every device. The initialized values are copied back to `arg_params` and
+        `aux_params`.
+
+        Parameters
+        ----------
+        initializer : callable
+            Called as `initializer(name, arr)` to initialize `arr`.
+        arg_params : dict
+            A dictionary of name to `NDArray` parameter mapping.
+        aux_params : dict
+            A dictionary of name to `NDArray` auxiliary variable mapping.
+        """
+        for names, blocks, params in [(self.param_names, self.param_arrays, arg_params),
+                                      (self.aux_names, self.aux_arrays, aux_params)]:
+            for name, block in zip(names, blocks):
+                host = params[name]
+                if block[0].dtype == host.dtype:
+                    initializer(name, block[0])
+                    block[0].copyto(host)
+                else:
+                    # the initializers work in the type of the host arrays
+                    initializer(name, host)
+                    host.astype(block[0].dtype).copyto(block[0])
+                _broadcast(block)
+
     def get_params(self, arg_params, aux_params):
         """ Copy data from each executor to `arg_params` and `aux_params`.
 
@@ -187,6 +357,40 @@ class DataParallelExecutorGroup(object):
             weight = sum(w.copyto(ctx.cpu()) for w in block) / len(block)
             weight.astype(aux_params[name].dtype).copyto(aux_params[name])
 
+    def _stage_inputs(self, arrays):
+        """Staging buffers with the slices and shapes of `arrays` on the same devices."""
+        if arrays is None:
+            return None
+        return [[(islice, nd.empty(dst.shape, dst.context, dtype=dst.dtype))
+                 for islice, dst in targets] for targets in arrays]
+
+    def prepare(self, data_batch):
+        """Start copying the slices of `data_batch` to the devices, ahead of `forward`.
+
+        The copies go to one of two staging buffers rather than to the arguments
+        of the executors, so they do not wait for the computation still using the
+        previous batch. `forward` on the same batch then only copies on each device.
+
+        Parameters
+        ----------
+        data_batch : DataBatch
+            The batch to be passed to the next call of `forward`.
+        """
+        if self.num_accumulation_steps > 1:
+            # the micro-batches are copied in turn to the same arrays
+            return
+        self._apply_rebalance()
+        if self.staged_arrays is None:
+            self.staged_arrays = [(self._stage_inputs(self.data_arrays),
+                                   self._stage_inputs(self.label_arrays))
+                                  for _ in range(2)]
+        stage = 0 if self._prepared is None else 1 - self._prepared[1]
+        staged_data, staged_label = self.staged_arrays[stage]
+        _load_data(data_batch, staged_data)
+        if staged_label is not None and data_batch.label:
+            _load_label(data_batch, staged_label)
+        self._prepared = (data_batch, stage)
+
     def forward(self, data_batch, is_train=None):
         """Split `data_batch` according to workload and run forward on each devices.
 
@@ -201,9 +405,34 @@ class DataParallelExecutorGroup(object):
         -------
 
         """
-        _load_data(data_batch, self.data_arrays)
+        self._apply_rebalance()
         if is_train is None:
             is_train = self.for_training
+        if self.num_accumulation_steps > 1:
+            self._accum_batch = data_batch
+            self._accum_train = is_train
+            self._forward_micro_batch(0)
+            if not is_train:
+                # nothing to keep for a backward
+                for step in range(1, self.num_accumulation_steps):
+                    self._forward_micro_batch(step)
+                self._accum_batch = None
+            return
+        if is_train and self.adaptive_workload and len(self.execs) > 1:
+            self._num_train_steps += 1
+            if self._num_train_steps % self.rebalance_interval == 0:
+                # time this step from idle devices
+                nd.waitall()
+                self._step_start = time.time()
+
+        prepared = self._prepared is not None and self._prepared[0] is data_batch
+        if prepared:
+            staged_data, staged_label = self.staged_arrays[self._prepared[1]]
+            _copy_staged(staged_data, self.data_arrays)
+        else:
+            _load_data(data_batch, self.data_arrays)
+            # the next prepare may reuse either buffer
+            self._prepared = None
 
         if is_train:
             # It could be the case that even though we are binded for training, we
@@ -212,11 +441,55 @@ class DataParallelExecutorGroup(object):
             # loss and gradients using some other ways), and we do not need the label
             # here.
             if self.label_arrays is not None:
-                _load_label(data_batch, self.label_arrays)
+                if prepared and data_batch.label:
+                    _copy_staged(staged_label, self.label_arrays)
+                else:
+                    _load_label(data_batch, self.label_arrays)
 
         for exec_ in self.execs:
             exec_.forward(is_train=is_train)
 
+    def _micro_batch_arrays(self, arrays, step):
+        """The input `arrays` with their slices moved to micro-batch `step`."""
+        offset = step * (self.batch_size // self.num_accumulation_steps)
+        return [[(slice(islice.start + offset, islice.stop + offset), arr)
+                 for islice, arr in targets] for targets in arrays]
+
+    def _forward_micro_batch(self, step):
+        """Load micro-batch `step` of the batch of the last forward and run forward on it.
+        The outputs of the micro-batches before the last are copied, the next one
+        overwrites them."""
+        data_batch = self._accum_batch
+        _load_data(data_batch, self._micro_batch_arrays(self.data_arrays, step))
+        if self._accum_train and self.label_arrays is not None:
+            _load_label(data_batch, self._micro_batch_arrays(self.label_arrays, step))
+        for exec_ in self.execs:
+            exec_.forward(is_train=self._accum_train)
+        if step + 1 < self.num_accumulation_steps:
+            if self._accum_outputs is None:
+                self._accum_outputs = [[[nd.empty(out.shape, out.context, dtype=out.dtype)
+                                         for out in exec_.outputs] for exec_ in self.execs]
+                                       for _ in range(self.num_accumulation_steps - 1)]
+            for exec_, copies in zip(self.execs, self._accum_outputs[step]):
+                for out, copy in zip(exec_.outputs, copies):
+                    out.copyto(copy)
+
+    def _micro_batch_outputs(self):
+        """The outputs of each micro-batch, as a list of (slice of the batch, outputs)
+        for each executor, in the order of the batch."""
+        assert self._accum_batch is None, 'backward runs the rest of the micro-batches'
+        size = self.batch_size // self.num_accumulation_steps
+        pieces = []
+        for step in range(self.num_accumulation_steps):
+            if step + 1 < self.num_accumulation_steps:
+                outputs = self._accum_outputs[step]
+            else:
+                outputs = [exec_.outputs for exec_ in self.execs]
+            for islice, outs in zip(self.slices, outputs):
+                pieces.append((slice(islice.start + step * size, islice.stop + step * size),
+                               outs))
+        return pieces
+
     def get_output_shapes(self):
         """Get the shapes of the outputs."""
         outputs = self.execs[0].outputs
@@ -239,10 +512,17 @@ class DataParallelExecutorGroup(object):
         -------
         If `merge_multi_context` is `True`, it is like `[out1, out2]`. Otherwise, it
         is like `[[out1_dev1, out1_dev2], [out2_dev1, out2_dev2]]`. All the output
-        elements are `NDArray`.
+        elements are `NDArray`. With accumulation steps, the outputs of each device
+        are repeated for each micro-batch, like `[[out1_step1_dev1, out1_step1_dev2,
+        out1_step2_dev1, ...], ...]`.
         """
-        outputs = [[exec_.outputs[i] for exec_ in self.execs]
-                   for i in range(len(self.execs[0].outputs))]
+        if self.num_accumulation_steps > 1:
+            pieces = self._micro_batch_outputs()
+            outputs = [[outs[i] for _, outs in pieces]
+                       for i in range(len(self.execs[0].outputs))]
+        else:
+            outputs = [[exec_.outputs[i] for exec_ in self.execs]
+                       for i in range(len(self.execs[0].outputs))]
         if merge_multi_context:
             outputs = _merge_multi_context(outputs)
         return outputs
@@ -284,12 +564,40 @@ class DataParallelExecutorGroup(object):
         assert self.for_training, 're-bind with for_training=True to run backward'
         if out_grads is None:
             out_grads = []
+        if self.num_accumulation_steps > 1:
+            self._backward_micro_batches(out_grads)
+            return
 
-        for i, (exec_, islice) in enumerate(zip(self.execs, self.slices)):
-            out_grads_slice = [grad[islice].as_in_context(self.contexts[i])
-                               for grad in out_grads]
+        for exec_, islice in zip(self.execs, self.slices):
+            out_grads_slice = [grad[islice].as_in_context(out.context)
+                               for grad, out in zip(out_grads, exec_.outputs)]
             exec_.backward(out_grads=out_grads_slice)
 
+        if self._step_start is not None:
+            self._measure_step()
+            self._step_start = None
+
+    def _backward_micro_batches(self, out_grads):
+        """Run backward on the micro-batch of the last forward, then forward and backward
+        on each of the others. The gradients of the parameters are zeroed first, then
+        added to by each micro-batch."""
+        assert self._accum_batch is not None and self._accum_train, \
+            'backward must follow a forward with is_train'
+        for grads in self.grad_arrays:
+            for grad in grads:
+                if grad is not None:
+                    grad[:] = 0
+        size = self.batch_size // self.num_accumulation_steps
+        for step in range(self.num_accumulation_steps):
+            if step > 0:
+                self._forward_micro_batch(step)
+            for exec_, islice in zip(self.execs, self.slices):
+                islice = slice(islice.start + step * size, islice.stop + step * size)
+                out_grads_slice = [grad[islice].as_in_context(out.context)
+                                   for grad, out in zip(out_grads, exec_.outputs)]
+                exec_.backward(out_grads=out_grads_slice)
+        self._accum_batch = None
+
     def update_metric(self, eval_metric, labels):
         """Accumulate the performance according to `eval_metric` on all devices.
 
@@ -300,9 +608,13 @@ class DataParallelExecutorGroup(object):
         labels : list of NDArray
             Typically comes from `label` of a `DataBatch`.
         """
-        for texec, islice in zip(self.execs, self.slices):
+        if self.num_accumulation_steps > 1:
+            pieces = self._micro_batch_outputs()
+        else:
+            pieces = [(islice, texec.outputs) for texec, islice in zip(self.execs, self.slices)]
+        for islice, outputs in pieces:
             labels_slice = [label[islice] for label in labels]
-            eval_metric.update(labels_slice, texec.outputs)
+            eval_metric.update(labels_slice, outputs)
 
     def _bind_ith_exec(self, i, data_shapes, label_shapes, shared_group):
         """Internal utility function to bind the i-th executor.
@@ -313,6 +625,21 @@ class DataParallelExecutorGroup(object):
         shared_exec = None if shared_group is None else shared_group.execs[i]
         context = self.contexts[i]
         shared_data_arrays = self.shared_data_arrays[i]
+        # the executor owning the parameters, the micro-batches after the first add
+        # their gradients to those of the first one
+        param_exec = shared_exec
+        accumulate = self.num_micro_batches > 1 and i > 0
+        if accumulate:
+            param_exec = self.execs[0]
+        if self.group2ctx is not None:
+            attrs = self.symbol.list_attr(recursive=True)
+            arg_ctx = [self.group2ctx.get(attrs.get(name + '_ctx_group'), context)
+                       for name in self.arg_names]
+            aux_ctx = [self.group2ctx.get(attrs.get(name + '_ctx_group'), context)
+                       for name in self.aux_names]
+        else:
+            arg_ctx = [context] * len(self.arg_names)
+            aux_ctx = [context] * len(self.aux_names)
 
         input_shapes = dict(data_shapes)
         if label_shapes is not None:
@@ -322,7 +649,7 @@ class DataParallelExecutorGroup(object):
         assert arg_shapes is not None, "shape inference failed"
 
         if self.input_types is None:
-            input_types = {k: mx_real_t for k in input_shapes.keys()}
+            input_types = self.symbol.input_types(input_shapes.keys())
         else:
             input_types = self.input_types
         arg_types, _, aux_types = self.symbol.infer_type(**input_types)
@@ -335,8 +662,11 @@ class DataParallelExecutorGroup(object):
         grad_req = {}
         for name in self.arg_names:
             if self.for_training:
-                if name in self.param_names:
-                    grad_req[name] = 'write'
+                if name in self.fixed_param_names:
+                    grad_req[name] = 'null'
+                elif name in self.param_names:
+                    grad_req[name] = 'add' if accumulate or self.num_accumulation_steps > 1 \
+                        else 'write'
                 elif name in data_names:
                     grad_req[name] = 'write' if self.inputs_need_grad else 'null'
                 else:
@@ -375,41 +705,52 @@ class DataParallelExecutorGroup(object):
         for j in range(len(self.arg_names)):
             name = self.arg_names[j]
             if name in self.param_names: # model parameter
-                if shared_exec is None:
-                    arg_arr = nd.zeros(arg_shapes[j], context, dtype=arg_types[j])
+                if param_exec is None:
+                    with storage.alloc_origin('weights'):
+                        arg_arr = nd.zeros(arg_shapes[j], arg_ctx[j], dtype=arg_types[j])
                     if grad_req[name] != 'null':
-                        grad_arr = nd.zeros(arg_shapes[j], context, dtype=arg_types[j])
+                        with storage.alloc_origin('gradients'):
+                            grad_arr = nd.zeros(arg_shapes[j], arg_ctx[j], dtype=arg_types[j])
                         grad_arrays[name] = grad_arr
                 else:
-                    arg_arr = shared_exec.arg_dict[name]
+                    arg_arr = param_exec.arg_dict[name]
                     assert arg_arr.shape == arg_shapes[j]
                     assert arg_arr.dtype == arg_types[j]
                     if grad_req[name] != 'null':
-                        grad_arrays[name] = shared_exec.grad_dict[name]
+                        grad_arrays[name] = param_exec.grad_dict[name]
             else: # data or label
                 arg_arr = _get_or_reshape(name, shared_data_arrays, arg_shapes[j], arg_types[j],
-                                          context, self.logger)
+                                          arg_ctx[j], self.logger)
 
                 # data might also need grad if inputs_need_grad is True
                 if grad_req[name] != 'null':
                     grad_arrays[name] = _get_or_reshape('grad of ' + name, shared_data_arrays,
-                                                        arg_shapes[j], arg_types[j], context,
+                                                        arg_shapes[j], arg_types[j], arg_ctx[j],
                                                         self.logger)
 
             arg_arrays.append(arg_arr)
 
         # create or borrow aux variables
-        if shared_exec is None:
-            aux_arrays = [nd.zeros(s, context, dtype=t) for s, t in zip(aux_shapes, aux_types)]
+        if param_exec is None:
+            with storage.alloc_origin('aux_states'):
+                aux_arrays = [nd.zeros(s, c, dtype=t)
+                              for s, c, t in zip(aux_shapes, aux_ctx, aux_types)]
         else:
-            for j, arr in enumerate(shared_exec.aux_arrays):
+            for j, arr in enumerate(param_exec.aux_arrays):
                 assert aux_shapes[j] == arr.shape
                 assert aux_types[j] == arr.dtype
-            aux_arrays = shared_exec.aux_arrays[:]
-
+            aux_arrays = param_exec.aux_arrays[:]
+
+        # pylint: disable=protected-access
+        if shared_exec is not None and shared_exec._grad_req == grad_req and \
+                shared_exec._symbol.tojson() == self.symbol.tojson():
+            # same graph, only the shapes change
+            return shared_exec._reshape_from(arg_arrays, grad_arrays, aux_arrays)
+        # pylint: enable=protected-access
         executor = self.symbol.bind(ctx=context, args=arg_arrays,
                                     args_grad=grad_arrays, aux_states=aux_arrays,
-                                    grad_req=grad_req, shared_exec=shared_exec)
+                                    grad_req=grad_req, shared_exec=shared_exec,
+                                    group2ctx=self.group2ctx)
         return executor
 
     def _sliced_shape(self, shapes, i):
@@ -427,5 +768,6 @@ class DataParallelExecutorGroup(object):
 
     def install_monitor(self, mon):
         """Install monitor on all executors"""
+        self._monitor = mon
         for exe in self.execs:
             mon.install(exe)
@@ -11,6 +11,7 @@ from .. import optimizer as opt
 
 from .executor_group import DataParallelExecutorGroup
 from ..model import _create_kvstore, _initialize_kvstore, _update_params, _update_params_on_kvstore
+from ..model import _GradPusher, _sparse_grad_params, _sparse_grad_rows
 from ..initializer import Uniform
 
 from .base_module import BaseModule
@@ -31,11 +32,32 @@ class Module(BaseModule):
         Default is `logging`.
     context : Context or list of Context
         Default is `cpu()`.
-    work_load_list : list of number
-        Default `None`, indicating uniform workload.
+    work_load_list : list of number or str
+        Default `None`, indicating uniform workload. `'adaptive'` balances the
+        workload by the measured speed of the devices.
+    group2ctx : dict of str to Context
+        Default `None`. The devices of the `ctx_group` attributes of the symbol, to
+        place its layers on several devices.
+    num_micro_batches : int
+        Default 1. With a single `context` and `group2ctx`, split each batch into this
+        many micro-batches, so that the devices of the successive groups run on
+        different micro-batches at the same time. Gradients are accumulated over
+        the micro-batches before the update.
+    fixed_param_names : list of str
+        Default `None`. The parameters that are not updated. Their gradients are not
+        computed, nor the backward of the layers that only lead to them, so that
+        fine-tuning the top layers costs little more than their forward.
+    num_accumulation_steps : int
+        Default 1. Split each batch into this many micro-batches, which run forward and
+        backward one after the other on the same executors, bound for the size of a
+        micro-batch. Their gradients are added up, and `update` pushes and applies them
+        once for the whole batch, so a batch too large for the memory of the devices
+        trains as one step. The batch size must be a multiple of it.
     """
     def __init__(self, symbol, data_names=('data',), label_names=('softmax_label',),
-                 logger=logging, context=ctx.cpu(), work_load_list=None):
+                 logger=logging, context=ctx.cpu(), work_load_list=None,
+                 group2ctx=None, num_micro_batches=1, fixed_param_names=None,
+                 num_accumulation_steps=1):
         super(Module, self).__init__(logger=logger)
 
         if isinstance(context, ctx.Context):
@@ -43,8 +65,11 @@ class Module(BaseModule):
         self._context = context
         if work_load_list is None:
             work_load_list = [1] * len(self._context)
-        assert len(work_load_list) == len(self._context)
+        assert work_load_list == 'adaptive' or len(work_load_list) == len(self._context)
         self._work_load_list = work_load_list
+        self._group2ctx = group2ctx
+        self._num_micro_batches = num_micro_batches
+        self._num_accumulation_steps = num_accumulation_steps
 
         self._symbol = symbol
 
@@ -54,10 +79,14 @@ class Module(BaseModule):
         arg_names = symbol.list_arguments()
         input_names = data_names + label_names
         self._param_names = [x for x in arg_names if x not in input_names]
+        self._fixed_param_names = list(fixed_param_names or [])
+        for name in self._fixed_param_names:
+            assert name in self._param_names, 'unknown fixed parameter %s' % name
         self._aux_names = symbol.list_auxiliary_states()
         self._data_names = data_names
         self._label_names = label_names
         self._output_names = symbol.list_outputs()
+        self._sparse_params = _sparse_grad_params(symbol, self._param_names)
 
         self._arg_params = None
         self._aux_params = None
@@ -67,6 +96,7 @@ class Module(BaseModule):
         self._kvstore = None
         self._update_on_kvstore = None
         self._updater = None
+        self._grad_pusher = None
 
         self._exec_group = None
         self._data_shapes = None
@@ -174,6 +204,8 @@ class Module(BaseModule):
 
                     # just in case the cached array is just the target itself
                     if cache_arr is not arr:
+                        if cache_arr.dtype != arr.dtype:
+                            cache_arr = cache_arr.astype(arr.dtype)
                         cache_arr.copyto(arr)
                 else:
                     if not allow_missing:
@@ -183,18 +215,15 @@ class Module(BaseModule):
             else:
                 initializer(name, arr)
 
-        for name, arr in self._arg_params.items():
-            _impl(name, arr, arg_params)
+        def _init(name, arr):
+            """Initialize a parameter on the devices, then copied to the host"""
+            _impl(name, arr, arg_params if name in self._arg_params else aux_params)
 
-        for name, arr in self._aux_params.items():
-            _impl(name, arr, aux_params)
+        self._exec_group.init_params(_init, self._arg_params, self._aux_params)
 
         self.params_initialized = True
         self._params_dirty = False
 
-        # copy the initialized parameters to devices
-        self._exec_group.set_params(self._arg_params, self._aux_params)
-
     def bind(self, data_shapes, label_shapes=None, for_training=True,
              inputs_need_grad=False, force_rebind=False, shared_module=None):
         """Bind the symbols to construct executors. This is necessary before one
@@ -251,11 +280,16 @@ class Module(BaseModule):
         else:
             shared_group = None
 
+        num_accum = self._num_accumulation_steps if for_training else 1
         self._exec_group = DataParallelExecutorGroup(self._symbol, self._context,
                                                      self._work_load_list, data_shapes,
                                                      label_shapes, self._param_names,
                                                      for_training, inputs_need_grad,
-                                                     shared_group, logger=self.logger)
+                                                     shared_group, logger=self.logger,
+                                                     group2ctx=self._group2ctx,
+                                                     num_micro_batches=self._num_micro_batches,
+                                                     fixed_param_names=self._fixed_param_names,
+                                                     num_accumulation_steps=num_accum)
         if shared_module is not None:
             self.params_initialized = True
             self._arg_params = shared_module._arg_params
@@ -330,6 +364,7 @@ class Module(BaseModule):
                                 update_on_kvstore=update_on_kvstore)
         if update_on_kvstore:
             kvstore.set_optimizer(self._optimizer)
+        self._grad_pusher = _GradPusher(kvstore, skip=self._sparse_params) if kvstore else None
 
         self.optimizer_initialized = True
 
@@ -346,8 +381,21 @@ class Module(BaseModule):
         self._kvstore = shared_module._kvstore
         self._update_on_kvstore = shared_module._update_on_kvstore
         self._updater = shared_module._updater
+        self._grad_pusher = _GradPusher(self._kvstore, skip=self._sparse_params) \
+            if self._kvstore else None
         self.optimizer_initialized = True
 
+    def prepare(self, data_batch):
+        """Start copying the inputs of `data_batch` to the devices, ahead of `forward`.
+
+        Parameters
+        ----------
+        data_batch : DataBatch
+            The batch to be passed to the next call of `forward`.
+        """
+        assert self.binded
+        self._exec_group.prepare(data_batch)
+
     def forward(self, data_batch, is_train=None):
         """Forward computation.
 
@@ -372,6 +420,11 @@ class Module(BaseModule):
             on outputs that are not a loss function.
         """
         assert self.binded and self.params_initialized
+        if self._grad_pusher is not None:
+            # push the gradients to kvstore as backward issues them
+            self._grad_pusher.install(self._exec_group.execs, self._exec_group.param_idx,
+                                      self._exec_group.grad_arrays,
+                                      self._exec_group.num_accumulation_steps)
         self._exec_group.backward(out_grads=out_grads)
 
     def update(self):
@@ -381,16 +434,24 @@ class Module(BaseModule):
         assert self.binded and self.params_initialized and self.optimizer_initialized
 
         self._params_dirty = True
+        pushed = self._grad_pusher.reset() if self._grad_pusher is not None else ()
+        if self._exec_group.num_accumulation_steps > 1:
+            # the row indices are those of the last micro-batch only, push the whole gradients
+            sparse = None
+        else:
+            sparse = _sparse_grad_rows(self._exec_group.execs, self._sparse_params)
         if self._update_on_kvstore:
             _update_params_on_kvstore(self._exec_group.param_arrays,
                                       self._exec_group.grad_arrays,
-                                      self._kvstore)
+                                      self._kvstore, pushed, sparse)
         else:
             _update_params(self._exec_group.param_arrays,
                            self._exec_group.grad_arrays,
                            updater=self._updater,
                            num_device=len(self._context),
-                           kvstore=self._kvstore)
+                           kvstore=self._kvstore,
+                           pushed=pushed,
+                           sparse=sparse)
 
     def get_outputs(self, merge_multi_context=True):
         """Get outputs of the previous forward computation.
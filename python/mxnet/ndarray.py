@@ -8,14 +8,16 @@ import ctypes
 import warnings
 import sys
 import functools
+import itertools
 import operator
+import weakref
 import numpy as np
 from .base import _LIB, string_types, numeric_types
 from .base import c_array, py_str, c_str, mx_real_t
-from .base import mx_uint, mx_float, NDArrayHandle, FunctionHandle
+from .base import mx_uint, mx_float, NDArrayHandle, FunctionHandle, FunctionParamsHandle
 from .base import ctypes2buffer
 from .base import check_call, ctypes2docstring
-from .context import Context
+from .context import Context, cpu
 from . import _ndarray_internal as _internal
 
 # pylint: disable= no-member
@@ -69,6 +71,44 @@ def _new_alloc_handle(shape, ctx, delay_alloc, dtype=mx_real_t):
         ctypes.byref(hdl)))
     return hdl
 
+# the numpy arrays wrapped by NDArrays, released by the engine after the last use
+_EXTERNAL_DATA = {}
+_EXTERNAL_KEYS = itertools.count(1)
+
+def _release_external_data(_, key):
+    """Drop the reference to the wrapped array, called by the engine."""
+    _EXTERNAL_DATA.pop(key, None)
+
+_NDARRAY_DELETER = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_void_p)
+_release_external_data_cb = _NDARRAY_DELETER(_release_external_data)
+
+def _new_from_numpy_handle(source_array):
+    """Return a new CPU handle that shares the memory of a contiguous numpy array.
+
+    The array is kept alive until the NDArray and its copies are freed and the
+    operations on them are finished.
+
+    Returns
+    -------
+    a new ndarray handle
+    """
+    key = next(_EXTERNAL_KEYS)
+    _EXTERNAL_DATA[key] = source_array
+    hdl = NDArrayHandle()
+    try:
+        check_call(_LIB.MXNDArrayCreateFromCPUData(
+            source_array.ctypes.data_as(ctypes.c_void_p),
+            c_array(mx_uint, source_array.shape),
+            mx_uint(source_array.ndim),
+            ctypes.c_int(int(_DTYPE_NP_TO_MX[source_array.dtype.type])),
+            _release_external_data_cb,
+            ctypes.c_void_p(key),
+            ctypes.byref(hdl)))
+    except:
+        _EXTERNAL_DATA.pop(key, None)
+        raise
+    return hdl
+
 def waitall():
     """Wait all async operation to finish in MXNet
 
@@ -103,6 +143,8 @@ class NDArray(object):
     def __iadd__(self, other):
         if not self.writable:
             raise ValueError('trying to add to a readonly NDArray')
+        if _assign_lazy(self, '+', other) is not None:
+            return self
         if isinstance(other, NDArray):
             return _internal._plus(self, other, out=self)
         elif isinstance(other, numeric_types):
@@ -119,6 +161,8 @@ class NDArray(object):
     def __isub__(self, other):
         if not self.writable:
             raise ValueError('trying to subtract from a readonly NDArray')
+        if _assign_lazy(self, '-', other) is not None:
+            return self
         if isinstance(other, NDArray):
             return _internal._minus(self, other, out=self)
         elif isinstance(other, numeric_types):
@@ -133,11 +177,13 @@ class NDArray(object):
         return multiply(self, other)
 
     def __neg__(self):
-        return _internal._mul_scalar(self, -1.0)
+        return negative(self)
 
     def __imul__(self, other):
         if not self.writable:
             raise ValueError('trying to multiply to a readonly NDArray')
+        if _assign_lazy(self, '*', other) is not None:
+            return self
         if isinstance(other, NDArray):
             return _internal._mul(self, other, out=self)
         elif isinstance(other, numeric_types):
@@ -157,6 +203,8 @@ class NDArray(object):
     def __idiv__(self, other):
         if not self.writable:
             raise ValueError('trying to divide from a readonly NDArray')
+        if _assign_lazy(self, '/', other) is not None:
+            return self
         if isinstance(other, NDArray):
             return _internal._div(self, other, out=self)
         elif isinstance(other, numeric_types):
@@ -216,6 +264,8 @@ class NDArray(object):
             sliced_arr = self._slice(in_slice.start, in_slice.stop)
             sliced_arr[:] = value
             return
+        if _assign_lazy(self, None, value) is not None:
+            return
         if isinstance(value, NDArray):
             if value.handle is not self.handle:
                 value.copyto(self)
@@ -254,6 +304,7 @@ class NDArray(object):
         source_array = np.ascontiguousarray(source_array, dtype=self.dtype)
         if source_array.shape != self.shape:
             raise ValueError('array shape do not match the shape of NDArray')
+        _flush_readers((self,))
         check_call(_LIB.MXNDArraySyncCopyFromCPU(
             self.handle,
             source_array.ctypes.data_as(ctypes.c_void_p),
@@ -290,6 +341,35 @@ class NDArray(object):
             self.handle, idx, ctypes.byref(handle)))
         return NDArray(handle=handle, writable=self.writable)
 
+    def slice_view(self, axis, begin, end):
+        """Return a NDArray sliced along any axis that shares memory with current one.
+
+        It is a strided view unless the dimensions before `axis` are 1, which needs
+        a single index (`end == begin + 1`) or the last axis, e.g. a time step of
+        (batch, time, feature) data. The elementwise operators read and write
+        strided views directly, the others are given contiguous copies.
+
+        Parameters
+        ----------
+        axis : int
+            The axis to slice.
+        begin : int
+            Starting index of slice.
+        end : int
+            Finishing index of slice.
+        """
+        handle = NDArrayHandle()
+        check_call(_LIB.MXNDArraySliceAxis(
+            self.handle, mx_uint(axis), mx_uint(begin), mx_uint(end), ctypes.byref(handle)))
+        return NDArray(handle=handle, writable=self.writable)
+
+    @property
+    def is_contiguous(self):
+        """Whether the elements are contiguous, false for the strided views of `slice_view`."""
+        out = ctypes.c_int()
+        check_call(_LIB.MXNDArrayIsContiguous(self.handle, ctypes.byref(out)))
+        return out.value != 0
+
     def reshape(self, new_shape):
         """Return a reshaped NDArray that shares memory with current one.
 
@@ -401,6 +481,33 @@ class NDArray(object):
         return transpose(self)
     # pylint: enable= invalid-name, undefined-variable
 
+    @property
+    def __array_interface__(self):
+        """The numpy array interface of a contiguous CPU NDArray, so that
+        `np.asarray(arr)` shares its memory instead of copying it.
+
+        It waits for the pending operations on the array, the later writes on
+        either side are seen by the other one after `wait_to_read`. Other
+        NDArrays are converted by `__array__`.
+        """
+        if self.context.device_type != 'cpu' or not self.is_contiguous:
+            raise AttributeError('only a contiguous CPU NDArray shares its memory')
+        if self.writable:
+            check_call(_LIB.MXNDArrayWaitToWrite(self.handle))
+        else:
+            self.wait_to_read()
+        pdata = ctypes.c_void_p()
+        check_call(_LIB.MXNDArrayGetRawData(self.handle, ctypes.byref(pdata)))
+        return {'version': 3,
+                'shape': self.shape,
+                'typestr': np.dtype(self.dtype).str,
+                'data': (pdata.value or 0, not self.writable)}
+
+    def __array__(self, dtype=None):
+        """Return a copy for numpy, used when the memory can not be shared."""
+        data = self.asnumpy()
+        return data if dtype is None else data.astype(dtype, copy=False)
+
     def asnumpy(self):
         """Return a copied numpy array of current array.
 
@@ -507,6 +614,221 @@ class NDArray(object):
         return self.copyto(context)
 
 
+# depth of the lazy scopes entered, and the lazy expressions not evaluated yet
+_LAZY_DEPTH = [0]
+_PENDING = weakref.WeakSet()
+# the limits of a fused program, as FusedProgram in src/ndarray/ndarray_function.h
+_FUSED_MAX_INSTR = 64
+_FUSED_MAX_INPUTS = 16
+_FUSED_MAX_STACK = 16
+
+class _LazyNDArray(NDArray):
+    """An elementwise arithmetic expression of NDArrays and scalars, created in the
+    scope of `lazy`. It is evaluated in one pass on its first use, or directly into
+    the NDArray it is assigned to.
+    """
+    # pylint: disable= super-init-not-called
+    def __init__(self, op, args, shape, ctx):
+        self._op = op
+        self._args = args
+        self._shape = shape
+        self._ctx = ctx
+        self._value = None
+        self.writable = True
+        _PENDING.add(self)
+    # pylint: enable= super-init-not-called
+
+    def __del__(self):
+        pass
+
+    def __reduce__(self):
+        return self._materialize().__reduce_ex__(2)
+
+    @property
+    def handle(self):
+        """The handle of the value, which is evaluated on the first access."""
+        return self._materialize().handle
+
+    @property
+    def shape(self):
+        return self._shape
+
+    @property
+    def context(self):
+        return self._ctx
+
+    @property
+    def dtype(self):
+        return mx_real_t
+
+    def _materialize(self):
+        """Evaluate the expression into a new NDArray, once."""
+        if self._value is None:
+            value = empty(self._shape, self._ctx)
+            self._evaluate(value, flush=False)
+            self._value = value
+            self._args = None
+            _PENDING.discard(self)
+        return self._value
+
+    def _reads(self, arrays):
+        """Whether the expression reads any of arrays."""
+        for arg in self._args:
+            if any(arg is x for x in arrays):
+                return True
+            if isinstance(arg, _LazyNDArray) and arg._value is None and arg._reads(arrays):
+                return True
+        return False
+
+    def _nodes(self):
+        """The expressions of the tree not evaluated yet."""
+        nodes = [self]
+        for node in nodes:
+            nodes.extend(arg for arg in node._args
+                         if isinstance(arg, _LazyNDArray) and arg._value is None)
+        return nodes
+
+    def _compile(self):
+        """Return the postfix program, the inputs and the scalars of the fused
+        evaluation, or None if the program exceeds the limits of the kernel."""
+        tokens, inputs, scalars = [], [], []
+        def visit(arg, level):
+            """Append the program of arg with level values below it on the stack."""
+            if isinstance(arg, _LazyNDArray) and arg._value is None:
+                if not (visit(arg._args[0], level) and visit(arg._args[1], level + 1)):
+                    return False
+                tokens.append(arg._op)
+                return True
+            if level + 1 > _FUSED_MAX_STACK:
+                return False
+            if isinstance(arg, numeric_types):
+                tokens.append('s%d' % len(scalars))
+                scalars.append(float(arg))
+                return True
+            for i, x in enumerate(inputs):
+                if x is arg:
+                    tokens.append('i%d' % i)
+                    return True
+            tokens.append('i%d' % len(inputs))
+            inputs.append(arg)
+            return True
+        if not visit(self, 0) or len(tokens) > _FUSED_MAX_INSTR \
+                or len(inputs) > _FUSED_MAX_INPUTS:
+            return None
+        return ' '.join(tokens), inputs, scalars
+
+    def _evaluate(self, out, flush=True):
+        """Evaluate the expression into out in one pass."""
+        out_handle = out.handle
+        if flush:
+            # the other expressions reading out see its current value
+            _flush_readers((out,), exclude=self._nodes())
+        compiled = self._compile()
+        if compiled is None:
+            # the operands are evaluated first, each in one pass
+            for arg in self._args:
+                if isinstance(arg, _LazyNDArray):
+                    arg._materialize()
+            compiled = self._compile()
+        program, inputs, scalars = compiled
+        check_call(_LIB.MXNDArrayEvalFused(
+            c_str(program),
+            mx_uint(len(inputs)),
+            c_array(NDArrayHandle, [x.handle for x in inputs]),
+            mx_uint(len(scalars)),
+            c_array(mx_float, scalars),
+            out_handle))
+        return out
+
+def _lazy_node(op, lhs, rhs):
+    """Return the lazy expression of lhs op rhs, or None if it can not be fused,
+    i.e. the NDArrays are not contiguous float32 arrays of the same shape and context."""
+    shape, ctx = None, None
+    for arg in (lhs, rhs):
+        if isinstance(arg, numeric_types):
+            continue
+        if not isinstance(arg, NDArray):
+            return None
+        if isinstance(arg, _LazyNDArray) and arg._value is None:
+            arg_shape, arg_ctx = arg._shape, arg._ctx
+        else:
+            if arg.dtype != mx_real_t or not arg.is_contiguous:
+                return None
+            arg_shape, arg_ctx = arg.shape, arg.context
+        if shape is None:
+            shape, ctx = arg_shape, arg_ctx
+        elif shape != arg_shape or ctx != arg_ctx:
+            return None
+    if shape is None:
+        return None
+    return _LazyNDArray(op, (lhs, rhs), shape, ctx)
+
+def _assign_lazy(out, op, value):
+    """Evaluate out op value into out in one pass if value is a pending expression,
+    return None if it can not be fused."""
+    if not isinstance(value, _LazyNDArray) or value._value is not None:
+        return None
+    node = value if op is None else _lazy_node(op, out, value)
+    if node is None or node.shape != out.shape or node.context != out.context \
+            or out.dtype != mx_real_t or not out.is_contiguous:
+        return None
+    node._evaluate(out)
+    if node is not value:
+        _PENDING.discard(node)
+    return out
+
+def _materialize_pending(predicate):
+    """Evaluate the pending expressions satisfying predicate, the outermost first so
+    that the inner ones are fused into them."""
+    while True:
+        nodes = [node for node in _PENDING if node._value is None and predicate(node)]
+        if not nodes:
+            return
+        inner = set(id(arg) for node in nodes for arg in node._args)
+        roots = [node for node in nodes if id(node) not in inner]
+        nodes = inner = None
+        for node in roots:
+            node._materialize()
+        roots = None
+
+def _flush_readers(arrays, exclude=()):
+    """Evaluate the pending expressions reading arrays before they are modified."""
+    if _PENDING:
+        exclude = set(id(node) for node in exclude)
+        _materialize_pending(lambda node: id(node) not in exclude and node._reads(arrays))
+
+class _LazyScope(object):
+    """Scope object for lazy evaluation."""
+    def __enter__(self):
+        _LAZY_DEPTH[0] += 1
+        return self
+
+    def __exit__(self, ptype, value, trace):
+        _LAZY_DEPTH[0] -= 1
+        if _LAZY_DEPTH[0] == 0:
+            _materialize_pending(lambda node: True)
+
+
+def lazy():
+    """Lazy evaluation scope of the elementwise arithmetic of NDArrays.
+
+    In the scope, `+ - * /` between contiguous float32 NDArrays of the same shape and
+    context, and scalars, build an expression instead of computing it. The expression
+    is evaluated in one kernel without temporary arrays when it is assigned, e.g. by
+    `w -= ...` or `w[:] = ...`, or when it is used otherwise. It is evaluated before
+    an NDArray it reads is modified, unless it is a part of the expression assigned to
+    that NDArray, and the pending expressions are evaluated when the scope exits.
+    The writes by executors, kvstores and views of the arrays are not tracked.
+
+    Example::
+
+        with mx.nd.lazy():
+            for w, g in zip(weights, grads):
+                w -= lr * (g + wd * w)
+    """
+    return _LazyScope()
+
+
 def onehot_encode(indices, out):
     """One hot encoding indices into matrix out.
 
@@ -528,6 +850,148 @@ def onehot_encode(indices, out):
     # pylint: enable= no-member, protected-access
 
 
+class RowSparseNDArray(object):
+    """A matrix of which only some rows are stored, the other rows are zero.
+
+    It is the row sparse gradient of an Embedding weight with ``sparse_grad=True``,
+    for the row sparse push and pull of KVStore.
+
+    Parameters
+    ----------
+    indices : NDArray
+        The sorted unique 0-based indices of the stored rows, on cpu.
+    values : NDArray
+        The stored rows, of shape ``(len(indices), shape[1])``.
+    shape : tuple of int
+        The shape of the dense matrix.
+    """
+    def __init__(self, indices, values, shape):
+        assert len(shape) == 2, "only row sparse matrices are supported"
+        assert indices.shape == (values.shape[0],)
+        assert values.shape[1:] == tuple(shape[1:])
+        self.indices = indices
+        self.values = values
+        self.shape = tuple(shape)
+
+    @property
+    def context(self):
+        """The context of the stored rows."""
+        return self.values.context
+
+    def copy_rows_to(self, dense):
+        """Write the stored rows into the dense matrix, the other rows are unchanged.
+
+        Parameters
+        ----------
+        dense : NDArray
+            The matrix to write to, of shape `shape`.
+        """
+        assert dense.shape == self.shape
+        # pylint: disable= no-member, protected-access
+        indices = self.indices.as_in_context(dense.context)
+        values = self.values.as_in_context(dense.context)
+        _internal._fill_rows(dense, values, indices, out=dense)
+        # pylint: enable= no-member, protected-access
+        return dense
+
+    def todense(self):
+        """Return the dense matrix, in the context of the stored rows."""
+        dense = zeros(self.shape, self.context)
+        return self.copy_rows_to(dense)
+
+
+def row_sparse(dense, indices):
+    """Take some rows of a dense matrix as a RowSparseNDArray.
+
+    Parameters
+    ----------
+    dense : NDArray
+        The matrix.
+    indices : NDArray or list of int
+        The sorted unique 0-based indices of the rows to take.
+
+    Returns
+    -------
+    RowSparseNDArray
+        The rows, in the context of `dense`.
+    """
+    if not isinstance(indices, NDArray):
+        indices = array(indices)
+    indices = indices.as_in_context(cpu())
+    # pylint: disable= no-member, protected-access
+    values = _internal._take_rows(dense, indices.as_in_context(dense.context))
+    # pylint: enable= no-member, protected-access
+    return RowSparseNDArray(indices, values, dense.shape)
+
+
+class CSRNDArray(object):
+    """A matrix in compressed sparse row format, as the batches of ``io.LibSVMIter``
+    and the input of ``SparseFullyConnected``.
+
+    Parameters
+    ----------
+    data : NDArray
+        The values of the non-zeros, row by row. It may be longer than the number
+        of non-zeros ``indptr[-1]``, the tail is ignored.
+    indices : NDArray
+        The 0-based column indices of the non-zeros, of the shape of `data`.
+    indptr : NDArray
+        The ``shape[0] + 1`` row pointers, the non-zeros of row ``i`` are
+        ``data[indptr[i]:indptr[i + 1]]``.
+    shape : tuple of int
+        The shape of the dense matrix.
+    """
+    def __init__(self, data, indices, indptr, shape):
+        assert len(shape) == 2, "only csr matrices are supported"
+        assert data.shape == indices.shape and len(data.shape) == 1
+        assert indptr.shape == (shape[0] + 1,)
+        self.data = data
+        self.indices = indices
+        self.indptr = indptr
+        self.shape = tuple(shape)
+
+    @property
+    def context(self):
+        """The context of the non-zeros."""
+        return self.data.context
+
+    def todense(self):
+        """Return the dense matrix, in the context of the non-zeros."""
+        indptr = self.indptr.asnumpy().astype(np.int64)
+        nnz = indptr[-1]
+        rows = np.repeat(np.arange(self.shape[0]), np.diff(indptr))
+        dense = np.zeros(self.shape, dtype=self.data.dtype)
+        np.add.at(dense, (rows, self.indices.asnumpy()[:nnz].astype(np.int64)),
+                  self.data.asnumpy()[:nnz])
+        return array(dense, self.context)
+
+
+def csr_matrix(dense, ctx=None):
+    """Take the non-zeros of a dense matrix as a CSRNDArray.
+
+    Parameters
+    ----------
+    dense : NDArray or numpy.ndarray
+        The matrix.
+    ctx : Context, optional
+        The context of the result, the context of `dense` by default.
+
+    Returns
+    -------
+    CSRNDArray
+        The non-zeros.
+    """
+    if isinstance(dense, NDArray):
+        ctx = dense.context if ctx is None else ctx
+        dense = dense.asnumpy()
+    dense = np.asarray(dense, dtype=mx_real_t)
+    assert dense.ndim == 2, "only csr matrices are supported"
+    rows, cols = np.nonzero(dense)
+    indptr = np.concatenate([[0], np.cumsum(np.bincount(rows, minlength=dense.shape[0]))])
+    return CSRNDArray(array(dense[rows, cols], ctx), array(cols, ctx),
+                      array(indptr, ctx), dense.shape)
+
+
 def empty(shape, ctx=None, dtype=mx_real_t):
     """Create an empty uninitialized new NDArray, with specified shape.
 
@@ -551,7 +1015,7 @@ def empty(shape, ctx=None, dtype=mx_real_t):
     return NDArray(handle=_new_alloc_handle(shape, ctx, False, dtype))
 
 #pylint: disable= too-many-arguments, no-member, protected-access
-def _ufunc_helper(lhs, rhs, fn_array, fn_scalar, lfn_scalar, rfn_scalar=None):
+def _ufunc_helper(lhs, rhs, fn_array, fn_scalar, lfn_scalar, rfn_scalar=None, lazy_op=None):
     """ Helper function for element-wise operation
     The function will perform numpy-like broadcasting if needed and call different functions
 
@@ -576,11 +1040,18 @@ def _ufunc_helper(lhs, rhs, fn_array, fn_scalar, lfn_scalar, rfn_scalar=None):
         function to be called if lhs is numeric value while rhs is NDArray;
         if none is provided, then the function is commutative, so rfn_scalar is equal to lfn_scalar
 
+    lazy_op : str, optional
+        the operator of the expression built in the scope of `lazy`
+
     Returns
     -------
     out: NDArray
         result array
     """
+    if lazy_op is not None and _LAZY_DEPTH[0] > 0:
+        node = _lazy_node(lazy_op, lhs, rhs)
+        if node is not None:
+            return node
     if isinstance(lhs, numeric_types):
         if isinstance(rhs, numeric_types):
             return fn_scalar(lhs, rhs)
@@ -628,7 +1099,8 @@ def add(lhs, rhs):
         _internal._plus,
         operator.add,
         _internal._plus_scalar,
-        None)
+        None,
+        '+')
     # pylint: enable= no-member, protected-access
 
 def subtract(lhs, rhs):
@@ -654,7 +1126,8 @@ def subtract(lhs, rhs):
         _internal._minus,
         operator.sub,
         _internal._minus_scalar,
-        _internal._rminus_scalar)
+        _internal._rminus_scalar,
+        '-')
     # pylint: enable= no-member, protected-access
 
 def multiply(lhs, rhs):
@@ -680,7 +1153,8 @@ def multiply(lhs, rhs):
         _internal._mul,
         operator.mul,
         _internal._mul_scalar,
-        None)
+        None,
+        '*')
     # pylint: enable= no-member, protected-access
 
 def divide(lhs, rhs):
@@ -706,7 +1180,8 @@ def divide(lhs, rhs):
         _internal._div,
         operator.truediv,
         _internal._div_scalar,
-        _internal._rdiv_scalar)
+        _internal._rdiv_scalar,
+        '/')
     # pylint: enable= no-member, protected-access
 
 def power(lhs, rhs):
@@ -856,7 +1331,7 @@ def full(shape, val, ctx=None):
     arr[:] = val
     return arr
 
-def array(source_array, ctx=None, dtype=mx_real_t):
+def array(source_array, ctx=None, dtype=mx_real_t, copy=True):
     """Create a new NDArray that copies content from source_array.
 
     Parameters
@@ -867,6 +1342,10 @@ def array(source_array, ctx=None, dtype=mx_real_t):
     ctx : Context, optional
         The context of the NDArray, default to current default context.
 
+    copy : bool, optional
+        When False, a contiguous numpy array of dtype is shared instead of copied
+        if ctx is a CPU, and the writes on either side are seen by the other one.
+
     Returns
     -------
     out: Array
@@ -878,6 +1357,12 @@ def array(source_array, ctx=None, dtype=mx_real_t):
             source_array = np.array(source_array, dtype=dtype)
         except:
             raise TypeError('source_array must be array like object')
+    if ctx is None:
+        ctx = Context.default_ctx
+    if not copy and ctx.device_type == 'cpu' and source_array.dtype == np.dtype(dtype) \
+            and source_array.flags['C_CONTIGUOUS'] and source_array.flags['ALIGNED']:
+        return NDArray(handle=_new_from_numpy_handle(source_array),
+                       writable=source_array.flags['WRITEABLE'])
     arr = empty(source_array.shape, ctx, dtype)
     arr[:] = source_array
     return arr
@@ -962,7 +1447,7 @@ def load(fname):
             (py_str(names[i]), NDArray(NDArrayHandle(handles[i]))) for i in range(out_size.value))
 
 
-def save(fname, data):
+def save(fname, data, aligned=False, background=False):
     """Save list of NDArray or dict of str->NDArray to binary file.
 
     You can also use pickle to do the job if you only work on python.
@@ -982,6 +1467,17 @@ def save(fname, data):
 
     data : list of NDArray or dict of str to NDArray
         The data to be saved.
+
+    aligned : bool, optional
+        Whether to align the data of the arrays in the file, so that a predictor
+        created from the file memory maps it instead of reading it.
+        It can still be loaded by `load`.
+
+    background : bool, optional
+        Whether to write the file in the background, in the aligned format. It
+        returns once the arrays are snapshotted, so that they can be updated
+        while the file is written. `waitall` waits for the file, errors are
+        logged instead of raised.
     """
     handles = []
     if isinstance(data, dict):
@@ -1000,10 +1496,16 @@ def save(fname, data):
                 raise TypeError('save only accept dict str->NDArray or list of NDArray')
             handles.append(val.handle)
         keys = None
-    check_call(_LIB.MXNDArraySave(c_str(fname),
-                                  mx_uint(len(handles)),
-                                  c_array(NDArrayHandle, handles),
-                                  keys))
+    if background:
+        save_fn = _LIB.MXNDArraySaveAsync
+    elif aligned:
+        save_fn = _LIB.MXNDArraySaveAligned
+    else:
+        save_fn = _LIB.MXNDArraySave
+    check_call(save_fn(c_str(fname),
+                       mx_uint(len(handles)),
+                       c_array(NDArrayHandle, handles),
+                       keys))
 
 def imdecode(str_img, clip_rect=(0, 0, 0, 0), out=None, index=0, channels=3, mean=None):
     """Decode an image from string. Requires OpenCV to work.
@@ -1116,6 +1618,7 @@ def _make_ndarray_function(handle):
             if not accept_empty_mutate:
                 raise TypeError('argument out is required to call %s' % func_name)
             out = NDArray(_new_empty_handle())
+        _flush_readers((out,))
         check_call(_LIB.MXFuncInvokeEx( \
                 handle, \
                 c_array(NDArrayHandle, (lhs.handle, rhs.handle)), \
@@ -1137,6 +1640,7 @@ def _make_ndarray_function(handle):
             if not accept_empty_mutate:
                 raise TypeError('argument out is required to call %s' % func_name)
             out = NDArray(_new_empty_handle())
+        _flush_readers((out,))
         check_call(_LIB.MXFuncInvokeEx( \
                 handle, \
                 c_array(NDArrayHandle, (src.handle,)), \
@@ -1175,6 +1679,7 @@ def _make_ndarray_function(handle):
                     NDArray(_new_empty_handle()) for i in range(n_mutate_vars))
             else:
                 raise TypeError('argument out is required to call %s' % func_name)
+        _flush_readers(mutate_vars)
         check_call(_LIB.MXFuncInvokeEx( \
                 handle, \
                 c_array(NDArrayHandle, [args[i].handle for i in use_vars_range]), \
@@ -1196,10 +1701,87 @@ def _make_ndarray_function(handle):
         ret_function = generic_ndarray_function
     ret_function.__name__ = func_name
     ret_function.__doc__ = doc_str
+    # used by invoke_batch
+    ret_function.handle = handle
+    ret_function.use_vars_range = use_vars_range
+    ret_function.scalar_range = scalar_range
+    ret_function.n_mutate_vars = n_mutate_vars
     return ret_function
 
 
 
+# pylint: enable=too-many-locals, invalid-name
+
+class FunctionParams(object):
+    """Keyword parameters of an NDArray function, which are converted once and
+    reused by the calls of `invoke_batch`.
+
+    Parameters
+    ----------
+    function : function
+        The NDArray function, e.g. `mx.nd.clip`.
+    **kwargs
+        The keyword parameters of the function.
+    """
+    def __init__(self, function, **kwargs):
+        self.function = function
+        self.handle = FunctionParamsHandle()
+        check_call(_LIB.MXFuncCreateParams(
+            function.handle,
+            ctypes.c_int(len(kwargs)),
+            c_array(ctypes.c_char_p, [key.encode('ascii') for key in kwargs.keys()]),
+            c_array(ctypes.c_char_p, [str(i).encode('ascii') for i in kwargs.values()]),
+            ctypes.byref(self.handle)))
+
+    def __del__(self):
+        check_call(_LIB.MXFuncFreeParams(self.handle))
+
+def invoke_batch(calls):
+    """Invoke a list of NDArray functions in one call of the library, which are
+    pushed to the engine as a bulk. It saves the overhead of calling many small
+    functions one by one, e.g. the updates of the parameters in an optimizer.
+
+    Example::
+
+        params = mx.nd.FunctionParams(mx.nd.clip)
+        mx.nd.invoke_batch([(mx.nd.clip, (g, -1.0, 1.0), g, params) for g in grads])
+
+    Parameters
+    ----------
+    calls : list of tuple
+        Each call is `(function, args, out)` or `(function, args, out, params)`.
+        args are the positional NDArrays and scalars of the function, out is the
+        NDArray or the tuple of NDArrays holding the results, and params are the
+        `FunctionParams` of the function or None.
+    """
+    funs, use_vars, scalars, mutate_vars, params, outs = [], [], [], [], [], []
+    for call in calls:
+        function, args, out = call[:3]
+        param = call[3] if len(call) > 3 else None
+        if isinstance(out, NDArray):
+            out = (out,)
+        if len(out) != function.n_mutate_vars:
+            raise TypeError('expect %d out in %s' % (function.n_mutate_vars, function.__name__))
+        if any(not v.writable for v in out):
+            raise TypeError('out must be writable')
+        if param is not None and param.function is not function:
+            raise TypeError('the params are created for %s instead of %s' % (
+                param.function.__name__, function.__name__))
+        funs.append(function.handle)
+        use_vars.extend(args[i].handle for i in function.use_vars_range)
+        scalars.extend(args[i] for i in function.scalar_range)
+        mutate_vars.extend(v.handle for v in out)
+        outs.extend(out)
+        params.append(param.handle if param is not None else None)
+    _flush_readers(outs)
+    check_call(_LIB.MXFuncInvokeBatch(
+        mx_uint(len(funs)),
+        c_array(FunctionHandle, funs),
+        c_array(NDArrayHandle, use_vars),
+        c_array(mx_float, scalars),
+        c_array(NDArrayHandle, mutate_vars),
+        c_array(FunctionParamsHandle, params)))
+
 # pylint: enable=too-many-locals, invalid-name
 
 def _init_ndarray_module():
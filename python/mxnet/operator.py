@@ -125,6 +125,9 @@ class NumpyOp(PythonOp):
     is intended for quickly hacking out a solution for non performance
     critical parts. Please consider write a c++ implementation if it becomes
     a bottleneck.
+    On cpu the numpy arrays share the memory of the operator's inputs and
+    outputs, on gpu they are copied to and from the host. Use NDArrayOp to
+    avoid the copies on gpu.
     Note that if your operator contains internal states (like arrays),
     it cannot be used for multi-gpu training.
     """
@@ -4,7 +4,7 @@ import math
 import ctypes
 from .base import _LIB, check_call
 from .base import c_array, mx_uint, mx_float, c_str
-from .base import OptimizerHandle, OptimizerCreator
+from .base import OptimizerHandle, OptimizerCreator, NDArrayHandle
 from .ndarray import NDArray, zeros, clip, sqrt, square
 from .random import normal
 
@@ -422,53 +422,33 @@ class SGLD(Optimizer):
                                                             weight.shape, weight.context)
 
 
-@register
-class ccSGD(Optimizer):
-    """A very simple SGD optimizer with momentum and weight regularization.
-    Implemented in C++.
-
-    Parameters
-    ----------
-    learning_rate : float, optional
-        learning_rate of SGD
-
-    momentum : float, optional
-       momentum value
-
-    wd : float, optional
-        L2 regularization coefficient add to all the weights
-
-    rescale_grad : float, optional
-        rescaling factor of gradient.
+class CCOptimizer(Optimizer):
+    """Base class of the optimizers implemented in C++.
 
-    clip_gradient : float, optional
-        clip gradient in range [-clip_gradient, clip_gradient]
+    Subclasses set the name of the C++ optimizer and the names of the
+    attributes passed to its Init(kwargs), then call `_init_handle`.
     """
-    def __init__(self, momentum=0.0, rescale_grad=1., clip_gradient=-1., **kwargs):
-        super(ccSGD, self).__init__(rescale_grad=rescale_grad,
-                                    clip_gradient=clip_gradient,
-                                    **kwargs)
-        self.momentum = momentum
+    cc_name = None
+    cc_params = []
 
+    def _init_handle(self):
+        """Create the C++ optimizer from the attributes."""
         self.handle = Optimizer._init_cc_optimizer(
-            'ccsgd',
-            ['momentum', 'rescale_grad', 'clip_gradient'],
-            [momentum, rescale_grad, clip_gradient])
+            self.cc_name, self.cc_params,
+            [getattr(self, name) for name in self.cc_params])
 
     def __getstate__(self):
         this = self.__dict__.copy()
-        if this.get('handle', None) is not None:
-            this['handle'] = True
-        else:
-            this['handle'] = False
+        this['handle'] = this.get('handle', None) is not None
+        return this
 
     def __setstate__(self, state):
-        if state.get('handle', False):
-            state['handle'] = Optimizer._init_cc_optimizer(
-                'ccsgd',
-                ['momentum', 'rescale_grad', 'clip_gradient'],
-                [state['momentum'], state['rescale_grad'], state['clip_gradient']])
+        has_handle = state.get('handle', False)
         self.__dict__.update(state)
+        if has_handle:
+            self._init_handle()
+        else:
+            self.handle = None
 
     def create_state(self, index, weight):
         return None
@@ -502,6 +482,175 @@ class ccSGD(Optimizer):
                                           mx_float(lr),
                                           mx_float(wd)))
 
+    def update_row_sparse(self, index, weight, row_ids, grad):
+        """Update the rows of a parameter given by a row sparse gradient.
+
+        Parameters
+        ----------
+        index : int
+            An unique integer key used to index the parameters
+
+        weight : NDArray
+            weight ndarray of shape (num_rows, ...)
+
+        row_ids : NDArray
+            the sorted unique row indices of the gradient, on cpu
+
+        grad : NDArray
+            the gradient of the rows, of shape (len(row_ids), ...)
+        """
+        lr = self._get_lr(index)
+        wd = self._get_wd(index)
+        self._update_count(index)
+        check_call(_LIB.MXOptimizerUpdateRowSparse(self.handle,
+                                                   ctypes.c_int(index),
+                                                   weight.handle,
+                                                   row_ids.handle,
+                                                   grad.handle,
+                                                   mx_float(lr),
+                                                   mx_float(wd)))
+
+    def update_multi(self, indices, weights, grads):
+        """Update a list of parameters at once, the updates of the parameters
+        on the same device are fused.
+
+        Parameters
+        ----------
+        indices : list of int
+            The unique integer key of each parameter
+
+        weights : list of NDArray
+            The weights
+
+        grads : list of NDArray
+            The gradients
+        """
+        assert len(indices) == len(weights) == len(grads)
+        if len(indices) == 0:
+            return
+        lrs = [self._get_lr(index) for index in indices]
+        wds = [self._get_wd(index) for index in indices]
+        for index in indices:
+            self._update_count(index)
+        check_call(_LIB.MXOptimizerUpdateMulti(
+            self.handle, mx_uint(len(indices)),
+            c_array(ctypes.c_int, indices),
+            c_array(NDArrayHandle, [w.handle for w in weights]),
+            c_array(NDArrayHandle, [g.handle for g in grads]),
+            c_array(mx_float, lrs),
+            c_array(mx_float, wds)))
+
+
+@register
+class ccSGD(CCOptimizer):
+    """A very simple SGD optimizer with momentum and weight regularization.
+    Implemented in C++.
+
+    Parameters
+    ----------
+    learning_rate : float, optional
+        learning_rate of SGD
+
+    momentum : float, optional
+       momentum value
+
+    wd : float, optional
+        L2 regularization coefficient add to all the weights
+
+    rescale_grad : float, optional
+        rescaling factor of gradient.
+
+    clip_gradient : float, optional
+        clip gradient in range [-clip_gradient, clip_gradient]
+    """
+    cc_name = 'ccsgd'
+    cc_params = ['momentum', 'rescale_grad', 'clip_gradient']
+
+    def __init__(self, momentum=0.0, rescale_grad=1., clip_gradient=-1., **kwargs):
+        super(ccSGD, self).__init__(rescale_grad=rescale_grad,
+                                    clip_gradient=clip_gradient,
+                                    **kwargs)
+        self.momentum = momentum
+        self._init_handle()
+
+
+@register
+class ccAdam(CCOptimizer):
+    """The Adam optimizer implemented in C++, the same as `Adam`.
+
+    Parameters
+    ----------
+    learning_rate : float, optional
+        Step size.
+
+    beta1 : float, optional
+        Exponential decay rate for the first moment estimates.
+
+    beta2 : float, optional
+        Exponential decay rate for the second moment estimates.
+
+    epsilon : float, optional
+
+    wd : float, optional
+        L2 regularization coefficient add to all the weights
+
+    rescale_grad : float, optional
+        rescaling factor of gradient.
+
+    clip_gradient : float, optional
+        clip gradient in range [-clip_gradient, clip_gradient]
+    """
+    cc_name = 'ccadam'
+    cc_params = ['beta1', 'beta2', 'epsilon', 'rescale_grad', 'clip_gradient']
+
+    def __init__(self, learning_rate=0.001, beta1=0.9, beta2=0.999, epsilon=1e-8,
+                 rescale_grad=1., clip_gradient=-1., **kwargs):
+        super(ccAdam, self).__init__(learning_rate=learning_rate,
+                                     rescale_grad=rescale_grad,
+                                     clip_gradient=clip_gradient,
+                                     **kwargs)
+        self.beta1 = beta1
+        self.beta2 = beta2
+        self.epsilon = epsilon
+        self._init_handle()
+
+
+@register
+class ccRMSProp(CCOptimizer):
+    """The RMSProp optimizer of Graves implemented in C++, the same as `RMSProp`.
+
+    Parameters
+    ----------
+    learning_rate : float, optional
+        Step size.
+
+    gamma1: float, optional
+        decay factor of moving average for gradient, gradient^2.
+
+    gamma2: float, optional
+        "momentum" factor.
+
+    wd : float, optional
+        L2 regularization coefficient add to all the weights
+
+    rescale_grad : float, optional
+        rescaling factor of gradient.
+
+    clip_gradient : float, optional
+        clip gradient in range [-clip_gradient, clip_gradient]
+    """
+    cc_name = 'ccrmsprop'
+    cc_params = ['gamma1', 'gamma2', 'rescale_grad', 'clip_gradient']
+
+    def __init__(self, gamma1=0.95, gamma2=0.9, rescale_grad=1., clip_gradient=-1.,
+                 **kwargs):
+        super(ccRMSProp, self).__init__(rescale_grad=rescale_grad,
+                                        clip_gradient=clip_gradient,
+                                        **kwargs)
+        self.gamma1 = gamma1
+        self.gamma2 = gamma2
+        self._init_handle()
+
 
 @register
 class Adam(Optimizer):
@@ -821,4 +970,9 @@ def get_updater(optimizer):
         if index not in states:
             states[index] = optimizer.create_state(index, weight)
         optimizer.update(index, weight, grad, states[index])
+    if hasattr(optimizer, 'update_multi'):
+        def multi(indices, grads, weights):
+            """updater of a list of weights, the updates are fused"""
+            optimizer.update_multi(indices, weights, grads)
+        updater.multi = multi
     return updater
@@ -0,0 +1,44 @@
+# coding: utf-8
+"""Profiler of engine operations, outputs chrome://tracing json."""
+from __future__ import absolute_import
+
+import ctypes
+from .base import _LIB, check_call, c_str
+
+def profiler_set_config(mode='symbolic', filename='profile.json'):
+    """Set up the configuration of profiler.
+
+    Parameters
+    ----------
+    mode : string, optional
+        Indicates whether to record only symbolic operators ('symbolic'),
+        or all operators pushed to the engine ('all').
+    filename : string, optional
+        The name of the output trace file.
+    """
+    mode2int = {'symbolic': 0, 'all': 1}
+    if mode not in mode2int:
+        raise ValueError('mode must be one of %s' % str(list(mode2int.keys())))
+    check_call(_LIB.MXSetProfilerConfig(
+        ctypes.c_int(mode2int[mode]),
+        c_str(filename)))
+
+def profiler_set_state(state='stop'):
+    """Set up the profiler state to record operators.
+
+    Parameters
+    ----------
+    state : string, optional
+        Indicates whether to run the profiler, can be 'stop' or 'run'.
+    """
+    state2int = {'stop': 0, 'run': 1}
+    if state not in state2int:
+        raise ValueError('state must be one of %s' % str(list(state2int.keys())))
+    check_call(_LIB.MXSetProfilerState(ctypes.c_int(state2int[state])))
+
+def dump_profile():
+    """Stop the profiler and write the records into the trace file.
+
+    Call ``mx.nd.waitall()`` before dumping so that all operations are finished.
+    """
+    check_call(_LIB.MXDumpProfile())
@@ -0,0 +1,211 @@
+# coding: utf-8
+# pylint: disable=too-many-locals, too-many-branches
+"""Int8 quantization of networks for cpu inference.
+
+A quantized tensor holds int8 values q of the real values q * range / 127, where
+range is the maximum absolute value of the tensor found by calibration.
+The int8 values are stored in uint8 arrays.
+"""
+from __future__ import absolute_import
+
+import ctypes
+import json
+import numpy as np
+from .base import NDArrayHandle, py_str
+from .context import cpu
+from . import ndarray as nd
+from . import symbol as sym
+
+# operators replaced by their quantized versions
+TARGET_OPS = ('Convolution', 'FullyConnected', 'Pooling')
+
+
+def _entry_names(symbol):
+    """Name of each output entry (node id, index) of the graph, as reported by
+    the monitor callback, or the variable name."""
+    graph = json.loads(symbol.tojson())
+    internals = symbol.get_internals().list_outputs()
+    names = {}
+    for nid, node in enumerate(graph['nodes']):
+        if node['op'] == 'null':
+            names[(nid, 0)] = node['name']
+            continue
+        prefix = node['name'] + '_'
+        outputs = [n for n in internals
+                   if n.startswith(prefix) and '_' not in n[len(prefix):]]
+        for index, name in enumerate(outputs):
+            names[(nid, index)] = name
+    return graph, names
+
+
+def calibrate(symbol, arg_params, aux_params, data_iter, num_batches=None, ctx=cpu()):
+    """Collect the ranges of the activations on calibration data.
+
+    The network is run in inference mode, and the maximum absolute value of each
+    operator output is recorded with the executor monitor callback.
+
+    Parameters
+    ----------
+    symbol : Symbol
+        The float32 network.
+    arg_params : dict of str to NDArray
+        Parameters of the arguments.
+    aux_params : dict of str to NDArray
+        Auxiliary states.
+    data_iter : DataIter
+        Calibration data, labels are not used.
+    num_batches : int, optional
+        Number of batches to run, all batches by default.
+    ctx : Context, optional
+        The context to run on.
+
+    Returns
+    -------
+    dict of str to float
+        The range of each output, and of each data input, by name.
+    """
+    data_names = [x[0] for x in data_iter.provide_data]
+    shapes = dict(data_iter.provide_data)
+    arg_names = symbol.list_arguments()
+    shapes.update({name: arr.shape for name, arr in arg_params.items() if name in arg_names})
+    exe = symbol.simple_bind(ctx, grad_req='null', **shapes)
+    exe.copy_params_from(arg_params, aux_params, allow_extra_params=True)
+    stats = []
+    def callback(name, array):
+        """record the maximum absolute value, computed when the output is ready"""
+        array = nd.NDArray(ctypes.cast(array, NDArrayHandle), writable=False)
+        stats.append((py_str(name), nd.max(nd.abs(array))))
+    exe.set_monitor_callback(callback)
+    ranges = {}
+    def update(name, value):
+        """keep the maximum over the batches"""
+        ranges[name] = max(ranges.get(name, 0.0), float(value.asnumpy().max()))
+    data_iter.reset()
+    for nbatch, batch in enumerate(data_iter):
+        if num_batches is not None and nbatch >= num_batches:
+            break
+        for name, arr in zip(data_names, batch.data):
+            arr.copyto(exe.arg_dict[name])
+            update(name, nd.max(nd.abs(arr)))
+        exe.forward(is_train=False)
+        for name, value in stats:
+            update(name, value)
+        stats[:] = []
+    return ranges
+
+
+def _quantize_array(arr):
+    """Quantize a float array, returns the uint8 array of int8 values and its range."""
+    value = arr.asnumpy()
+    rng = float(np.abs(value).max())
+    if rng == 0.0:
+        rng = 1.0
+    q = np.clip(np.round(value * (127.0 / rng)), -127, 127).astype(np.int8)
+    return nd.array(q.view(np.uint8), ctx=arr.context, dtype=np.uint8), rng
+
+
+def _is_2d(param, key):
+    """whether the shape parameter key has two dimensions"""
+    return param.get(key, '(1, 1)').count(',') == 1
+
+
+def quantize_model(symbol, arg_params, aux_params, ranges, target_ops=TARGET_OPS):
+    """Rewrite a float32 network to int8 operators for cpu inference.
+
+    Convolution and FullyConnected with a calibrated data range, whose weight is a
+    parameter used by no other operator, are replaced by QuantizedConvolution and
+    QuantizedFullyConnected on int8 weights. Max and avg Pooling are replaced by
+    QuantizedPooling. Quantize is inserted on the inputs, Dequantize on the outputs
+    of QuantizedPooling, quantized operators following a QuantizedPooling read its
+    int8 output directly.
+
+    Parameters
+    ----------
+    symbol : Symbol
+        The float32 network.
+    arg_params : dict of str to NDArray
+        Parameters of the arguments.
+    aux_params : dict of str to NDArray
+        Auxiliary states, returned unchanged.
+    ranges : dict of str to float
+        Ranges returned by calibrate.
+    target_ops : tuple of str, optional
+        Type names of the operators to quantize.
+
+    Returns
+    -------
+    (Symbol, dict of str to NDArray, dict of str to NDArray)
+        The quantized network with the same arguments and outputs, and its parameters.
+    """
+    graph, names = _entry_names(symbol)
+    qarg_params = dict(arg_params)
+    num_uses = {}
+    for node in graph['nodes']:
+        for e in node['inputs']:
+            num_uses[e[0]] = num_uses.get(e[0], 0) + 1
+    nodes = []
+    # map from old node id to new node id
+    remap = {}
+    # map from (new source id, index) to its Quantize node
+    quantized = {}
+    # map from the Dequantize of a QuantizedPooling to the pooling and its range
+    back_dequantize = {}
+
+    def add_node(op, name, param, inputs):
+        nodes.append({'op': op, 'param': param, 'name': name,
+                      'inputs': inputs, 'backward_source_id': -1})
+        return len(nodes) - 1
+
+    def quantize_input(entry, rng):
+        """the quantized version and range of a new entry"""
+        if entry[0] in back_dequantize:
+            return [back_dequantize[entry[0]][0], 0], back_dequantize[entry[0]][1]
+        key = (entry[0], entry[1])
+        if key not in quantized:
+            name = '%s_%d_quantize' % (nodes[entry[0]]['name'], entry[1])
+            quantized[key] = add_node('Quantize', name, {'range': str(rng)}, [entry])
+        return [quantized[key], 0], rng
+
+    for nid, node in enumerate(graph['nodes']):
+        node = dict(node)
+        node['param'] = dict(node.get('param', {}))
+        inputs = [[remap[e[0]]] + e[1:] for e in node['inputs']]
+        node['inputs'] = inputs
+        param = node['param']
+        old_inputs = graph['nodes'][nid]['inputs']
+        data_name = names.get(tuple(old_inputs[0][:2])) if old_inputs else None
+        target = node['op'] in target_ops and data_name in ranges
+        if target and node['op'] == 'Pooling':
+            target = param.get('pool_type') in ('max', 'avg') and _is_2d(param, 'kernel')
+        weight = None
+        if target and node['op'] != 'Pooling':
+            wnode = graph['nodes'][old_inputs[1][0]]
+            weight = wnode['name']
+            target = (wnode['op'] == 'null' and weight in arg_params and
+                      num_uses[old_inputs[1][0]] == 1 and
+                      (node['op'] != 'Convolution' or _is_2d(param, 'kernel')))
+        if not target:
+            nodes.append(node)
+            remap[nid] = len(nodes) - 1
+            continue
+        qdata, rng = quantize_input(inputs[0], ranges[data_name])
+        param['data_range'] = str(rng)
+        if weight is not None:
+            qarg_params[weight], wrng = _quantize_array(arg_params[weight])
+            param['weight_range'] = str(wrng)
+        node['inputs'] = [qdata] + inputs[1:]
+        node['op'] = 'Quantized' + node['op']
+        if node['op'] != 'QuantizedPooling':
+            nodes.append(node)
+            remap[nid] = len(nodes) - 1
+            continue
+        # the float32 output keeps the original name
+        name = node['name']
+        node['name'] = name + '_quantized'
+        nodes.append(node)
+        remap[nid] = add_node('Dequantize', name, {'range': str(rng)}, [[len(nodes) - 1, 0]])
+        back_dequantize[remap[nid]] = (remap[nid] - 1, rng)
+    graph['nodes'] = nodes
+    graph['arg_nodes'] = [remap[i] for i in graph['arg_nodes']]
+    graph['heads'] = [[remap[e[0]]] + e[1:] for e in graph['heads']]
+    return sym.load_json(json.dumps(graph)), qarg_params, aux_params
@@ -8,7 +8,7 @@ from collections import namedtuple
 import ctypes
 from .base import _LIB
 from .base import RecordIOHandle
-from .base import check_call
+from .base import check_call, c_str
 import struct
 import numpy as np
 try:
@@ -28,7 +28,7 @@ class MXRecordIO(object):
         "r" for reading or "w" writing.
     """
     def __init__(self, uri, flag):
-        self.uri = ctypes.c_char_p(uri)
+        self.uri = c_str(uri)
         self.handle = RecordIOHandle()
         self.flag = flag
         self.is_open = False
@@ -57,6 +57,7 @@ class MXRecordIO(object):
             check_call(_LIB.MXRecordIOWriterFree(self.handle))
         else:
             check_call(_LIB.MXRecordIOReaderFree(self.handle))
+        self.is_open = False
 
     def reset(self):
         """Reset pointer to first item. If record is opened with 'w',
@@ -97,6 +98,100 @@ class MXRecordIO(object):
         else:
             return None
 
+    def tell(self):
+        """Current position of a writer, where the next record is written
+
+        Returns
+        ----------
+        pos : int
+            position in the file.
+        """
+        assert self.writable
+        pos = ctypes.c_size_t()
+        check_call(_LIB.MXRecordIOWriterTell(self.handle, ctypes.byref(pos)))
+        return pos.value
+
+    def seek(self, pos):
+        """Set the position of a reader, the next record is read from there
+
+        Parameters
+        ----------
+        pos : int
+            position of a record returned by tell.
+        """
+        assert not self.writable
+        check_call(_LIB.MXRecordIOReaderSeek(self.handle, ctypes.c_size_t(pos)))
+
+class MXIndexedRecordIO(MXRecordIO):
+    """Python interface for read/write RecordIO data formmat with index.
+    The index file has one line "key\toffset" per record, ImageRecordIter reads
+    it with path_imgidx to shuffle the records over the whole file.
+
+    Parameters
+    ----------
+    idx_path : string
+        path to the index file.
+    uri : string
+        path to the local recordIO file.
+    flag : string
+        "r" for reading or "w" writing.
+    key_type : type
+        type of the keys.
+    """
+    def __init__(self, idx_path, uri, flag, key_type=int):
+        self.idx_path = idx_path
+        self.idx = {}
+        self.keys = []
+        self.key_type = key_type
+        self.fidx = None
+        super(MXIndexedRecordIO, self).__init__(uri, flag)
+
+    def open(self):
+        super(MXIndexedRecordIO, self).open()
+        self.idx = {}
+        self.keys = []
+        self.fidx = open(self.idx_path, self.flag)
+        if not self.writable:
+            for line in iter(self.fidx.readline, ''):
+                line = line.strip().split('\t')
+                key = self.key_type(line[0])
+                self.idx[key] = int(line[1])
+                self.keys.append(key)
+
+    def close(self):
+        if not self.is_open:
+            return
+        super(MXIndexedRecordIO, self).close()
+        self.fidx.close()
+
+    def read_idx(self, idx):
+        """Read the record of a key
+
+        Parameters
+        ----------
+        idx : key_type
+            key of the record.
+        """
+        self.seek(self.idx[idx])
+        return self.read()
+
+    def write_idx(self, idx, buf):
+        """Write a record with a key
+
+        Parameters
+        ----------
+        idx : key_type
+            key of the record.
+        buf : string
+            buffer to write.
+        """
+        key = self.key_type(idx)
+        pos = self.tell()
+        self.write(buf)
+        self.fidx.write('%s\t%d\n' % (str(key), pos))
+        self.idx[key] = pos
+        self.keys.append(key)
+
 IRHeader = namedtuple('HEADER', ['flag', 'label', 'id', 'id2'])
 _IRFormat = 'IfQQ'
 _IRSize = struct.calcsize(_IRFormat)
@@ -107,13 +202,39 @@ def pack(header, s):
     Parameters
     ----------
     header : IRHeader
-        header of the image record
+        header of the image record. A label of several values, such as
+        the objects of ImageDetRecordIter, is stored before s, its size in
+        the flag of the header.
     s : str
         string to pack
     """
     header = IRHeader(*header)
-    s = struct.pack(_IRFormat, *header) + s
-    return s
+    if isinstance(header.label, (int, float)):
+        return struct.pack(_IRFormat, *header) + s
+    label = np.asarray(header.label, dtype=np.float32).reshape(-1)
+    header = header._replace(flag=label.size, label=0)
+    return struct.pack(_IRFormat, *header) + label.tostring() + s
+
+def pack_sequence(data, label):
+    """pack a sequence into a record of SequenceRecordIter
+
+    Parameters
+    ----------
+    data : numpy.ndarray
+        the steps of the sequence, (length,) of token ids or (length, dim) of features
+    label : numpy.ndarray
+        the labels of the steps, (length,)
+
+    Returns
+    -------
+    s : str
+        The packed string
+    """
+    data = np.asarray(data, dtype=np.float32)
+    label = np.asarray(label, dtype=np.float32).reshape(-1)
+    assert data.shape[0] == label.shape[0], 'one label per step'
+    dim = data.shape[1] if data.ndim == 2 else 0
+    return struct.pack('II', data.shape[0], dim) + data.tostring() + label.tostring()
 
 def unpack(s):
     """unpack a MXImageRecord to string
@@ -131,7 +252,12 @@ def unpack(s):
         unpacked string
     """
     header = IRHeader(*struct.unpack(_IRFormat, s[:_IRSize]))
-    return header, s[_IRSize:]
+    s = s[_IRSize:]
+    if header.flag > 0:
+        label = np.frombuffer(s[:header.flag * 4], dtype=np.float32)
+        header = header._replace(label=label)
+        s = s[header.flag * 4:]
+    return header, s
 
 def unpack_img(s, iscolor=-1):
     """unpack a MXImageRecord to image
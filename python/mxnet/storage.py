@@ -0,0 +1,154 @@
+# coding: utf-8
+"""Host memory pinning for asynchronous copies to and from the gpu, the
+allocation trace and the statistics of the memory pools and of the gpu arena."""
+from __future__ import absolute_import
+
+import contextlib
+import ctypes
+import threading
+from .base import _LIB, check_call, c_str
+from .context import Context
+
+
+def _host_buffer(arr):
+    """Pointer and size in bytes of a contiguous numpy array."""
+    if not arr.flags['C_CONTIGUOUS']:
+        raise ValueError('the array must be contiguous')
+    return ctypes.c_void_p(arr.ctypes.data), ctypes.c_size_t(arr.nbytes)
+
+
+def register_host_memory(arr):
+    """Pin the memory of a numpy array, so that the copies between it and gpu
+    arrays, such as ``gpu_array[:] = arr``, use it directly without a
+    staging copy. Pinning is expensive, it pays off for buffers reused by
+    many copies, such as the batches of a data iterator.
+
+    The array must be unpinned by `unregister_host_memory` before its
+    memory is freed.
+
+    Parameters
+    ----------
+    arr : numpy.ndarray
+        A contiguous array.
+    """
+    ptr, size = _host_buffer(arr)
+    check_call(_LIB.MXStorageRegisterHostMemory(ptr, size))
+
+
+def unregister_host_memory(arr):
+    """Unpin the memory of a numpy array pinned by `register_host_memory`.
+
+    Parameters
+    ----------
+    arr : numpy.ndarray
+        The pinned array.
+    """
+    ptr, _ = _host_buffer(arr)
+    check_call(_LIB.MXStorageUnregisterHostMemory(ptr))
+
+
+_ORIGINS = threading.local()
+
+
+@contextlib.contextmanager
+def alloc_origin(origin):
+    """Attribute the memory allocated by the arrays created in the scope, on
+    the calling thread, to an origin such as ``'weights'`` in the allocation
+    trace recorded when the environment variable ``MXNET_STORAGE_TRACE`` is set.
+
+    Parameters
+    ----------
+    origin : str
+        The origin.
+
+    Examples
+    --------
+    >>> with mx.storage.alloc_origin('weights'):
+    ...     w = mx.nd.zeros((1024, 1024), mx.gpu())
+    """
+    stack = getattr(_ORIGINS, 'stack', None)
+    if stack is None:
+        stack = _ORIGINS.stack = []
+    stack.append(origin)
+    check_call(_LIB.MXStorageSetAllocOrigin(c_str(origin)))
+    try:
+        yield
+    finally:
+        stack.pop()
+        prev = c_str(stack[-1]) if stack else None
+        check_call(_LIB.MXStorageSetAllocOrigin(prev))
+
+
+def dump_trace(fname):
+    """Write the allocation trace recorded when the environment variable
+    ``MXNET_STORAGE_TRACE`` is set, as JSON. For each context it has the bytes
+    allocated now and at the peak by each origin, and the timeline of the peak
+    as pairs of microseconds and bytes.
+
+    Parameters
+    ----------
+    fname : str
+        The file name.
+    """
+    check_call(_LIB.MXStorageDumpTrace(c_str(fname)))
+
+
+def stats(ctx):
+    """Statistics of the memory pool of a device.
+
+    Parameters
+    ----------
+    ctx : Context
+        The device.
+
+    Returns
+    -------
+    dict
+        ``used`` bytes allocated by the arrays, ``cached`` bytes held by the
+        pool but free, and ``wasted`` bytes lost to the rounding of the sizes.
+    """
+    if not isinstance(ctx, Context):
+        raise TypeError('ctx must be a Context')
+    used = ctypes.c_size_t()
+    cached = ctypes.c_size_t()
+    wasted = ctypes.c_size_t()
+    check_call(_LIB.MXStorageGetStats(
+        ctx.device_typeid, ctx.device_id, ctypes.byref(used), ctypes.byref(cached),
+        ctypes.byref(wasted)))
+    return {'used': used.value, 'cached': cached.value, 'wasted': wasted.value}
+
+
+def arena_stats(ctx):
+    """Statistics of the memory arena of a device, the region of gpu memory
+    reserved up front when the environment variable
+    ``MXNET_GPU_MEM_ARENA_FRACTION`` is set, from which all the arrays of the
+    device are allocated.
+
+    Parameters
+    ----------
+    ctx : Context
+        The device.
+
+    Returns
+    -------
+    dict
+        ``capacity``, ``free`` and ``largest_free`` bytes of the arena, all 0
+        when the device has no arena, ``overflow`` bytes allocated outside of
+        it once it was full, and ``fragmentation``, the part of the free bytes
+        out of the largest free block.
+    """
+    if not isinstance(ctx, Context):
+        raise TypeError('ctx must be a Context')
+    capacity = ctypes.c_size_t()
+    free_bytes = ctypes.c_size_t()
+    largest_free = ctypes.c_size_t()
+    overflow = ctypes.c_size_t()
+    check_call(_LIB.MXStorageGetArenaStats(
+        ctx.device_typeid, ctx.device_id, ctypes.byref(capacity), ctypes.byref(free_bytes),
+        ctypes.byref(largest_free), ctypes.byref(overflow)))
+    frag = 1.0 - float(largest_free.value) / free_bytes.value if free_bytes.value else 0.0
+    return {'capacity': capacity.value,
+            'free': free_bytes.value,
+            'largest_free': largest_free.value,
+            'overflow': overflow.value,
+            'fragmentation': frag}
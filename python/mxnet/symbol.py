@@ -265,6 +265,22 @@ class Symbol(object):
         check_call(f_handle(self.handle, ctypes.byref(size), ctypes.byref(pairs)))
         return {py_str(pairs[i*2]): py_str(pairs[i*2+1]) for i in range(size.value)}
 
+    def input_types(self, names):
+        """Get the default types of some inputs, the dtype given to Variable or float32.
+
+        Parameters
+        ----------
+        names : list of str
+            Names of the inputs.
+
+        Returns
+        -------
+        types : dict of str to numpy.dtype
+            The type of each input.
+        """
+        attrs = self.list_attr(recursive=True)
+        return {k: numpy.dtype(attrs.get(k + '___dtype__', mx_real_t)).type for k in names}
+
     def _set_attr(self, **kwargs):
         """Set the attribute of the symbol.
 
@@ -536,7 +552,7 @@ class Symbol(object):
             self.handle, ctypes.byref(debug_str)))
         return py_str(debug_str.value)
 
-    def save(self, fname):
+    def save(self, fname, binary=False):
         """Save symbol into file.
 
         You can also use pickle to do the job if you only work on python.
@@ -551,6 +567,9 @@ class Symbol(object):
             - s3://my-bucket/path/my-s3-symbol
             - hdfs://my-bucket/path/my-hdfs-symbol
             - /path-to/my-local-symbol
+        binary : bool, optional
+            Save in the binary format instead of JSON. It loads much faster, especially
+            for unrolled networks, but is only meant for the same version of mxnet.
 
         See Also
         --------
@@ -558,7 +577,10 @@ class Symbol(object):
         """
         if not isinstance(fname, string_types):
             raise TypeError('fname need to be string')
-        check_call(_LIB.MXSymbolSaveToFile(self.handle, c_str(fname)))
+        if binary:
+            check_call(_LIB.MXSymbolSaveToBinaryFile(self.handle, c_str(fname)))
+        else:
+            check_call(_LIB.MXSymbolSaveToFile(self.handle, c_str(fname)))
 
     def tojson(self):
         """Save symbol into a JSON string.
@@ -631,6 +653,10 @@ class Symbol(object):
                     grad_req='write',
                     type_dict=None,
                     group2ctx=None,
+                    amp=False,
+                    loss_scale=1.0,
+                    mem_budget=0,
+                    warmup=False,
                     **kwargs):
         """Bind current symbol to get an executor, allocate all the ndarrays needed.
         Allows specifying data types.
@@ -657,6 +683,19 @@ class Symbol(object):
         group2ctx : dict of string to mx.Context
             The dict mapping the ``ctx_group`` attribute to the context assignment.
 
+        amp : bool, optional
+            Whether to run compute heavy operators in float16, see ``bind``.
+
+        loss_scale : float, optional
+            Gradient scale of the float16 operators, see ``bind``.
+
+        mem_budget : int, optional
+            Memory budget of each context in MB, see ``bind``.
+
+        warmup : bool, optional
+            Whether to do the lazy work of the first forward during the bind, see
+            ``Executor.warmup``.
+
         kwargs : dict of str->shape
             Input shape dictionary, name->shape
 
@@ -667,7 +706,7 @@ class Symbol(object):
         """
         # pylint: disable=too-many-locals
         if type_dict is None:
-            type_dict = {k: mx_real_t for k in self.list_arguments()}
+            type_dict = self.input_types(self.list_arguments())
         arg_shapes, _, aux_shapes = self.infer_shape(**kwargs)
         arg_types, _, aux_types = self.infer_type(**type_dict)
 
@@ -705,11 +744,15 @@ class Symbol(object):
                         for shape, dev, dtype in zip(aux_shapes, aux_ctx, aux_types)]
         executor = self.bind(ctx, arg_ndarrays,
                              grad_ndarrays, grad_req, aux_ndarrays,
-                             group2ctx=group2ctx)
+                             group2ctx=group2ctx, amp=amp, loss_scale=loss_scale,
+                             mem_budget=mem_budget)
+        if warmup:
+            executor.warmup()
         return executor
 
     def bind(self, ctx, args, args_grad=None, grad_req='write',
-             aux_states=None, group2ctx=None, shared_exec=None):
+             aux_states=None, group2ctx=None, shared_exec=None,
+             amp=False, loss_scale=1.0, mem_budget=0):
         """Bind current symbol to get an executor.
 
         Parameters
@@ -760,6 +803,21 @@ class Symbol(object):
             sequences, etc. The returned executor shares state with shared_exec, and should not be
             used in parallel with it.
 
+        amp : bool, optional
+            Whether to run Convolution, FullyConnected and Deconvolution in float16
+            on GPU. Their inputs are cast to float16 and their outputs back to float32,
+            so that arguments and gradients stay in float32. Ignored on CPU.
+
+        loss_scale : float, optional
+            Gradients are scaled by loss_scale inside the float16 operators
+            to avoid underflow, and unscaled when they leave. Only used with amp.
+
+        mem_budget : int, optional
+            Memory budget of each context in MB. When it is not 0, the outputs of
+            some forward operators are dropped after forward and recomputed in
+            backward, chosen by their size and recompute cost, so that the memory
+            fits in the budget. 0 means no budget.
+
         Returns
         -------
         executor : mxnet.Executor
@@ -778,6 +836,11 @@ class Symbol(object):
         # pylint: disable=too-many-locals, too-many-branches
         if not isinstance(ctx, Context):
             raise TypeError("Context type error")
+        if amp and ctx.device_type == 'gpu':
+            from . import amp as _amp
+            return _amp.convert_symbol(self, loss_scale=loss_scale).bind(
+                ctx, args, args_grad, grad_req, aux_states, group2ctx, shared_exec,
+                mem_budget=mem_budget)
 
         listed_arguments = self.list_arguments()
         args_handle, args = self._get_ndarray_inputs('args', args, listed_arguments, False)
@@ -822,21 +885,22 @@ class Symbol(object):
 
         handle = ExecutorHandle()
         shared_handle = shared_exec.handle if shared_exec is not None else ExecutorHandle()
-        check_call(_LIB.MXExecutorBindEX(self.handle,
-                                         ctypes.c_int(ctx.device_typeid),
-                                         ctypes.c_int(ctx.device_id),
-                                         mx_uint(len(ctx_map_keys)),
-                                         c_array(ctypes.c_char_p, ctx_map_keys),
-                                         c_array(ctypes.c_int, ctx_map_dev_types),
-                                         c_array(ctypes.c_int, ctx_map_dev_ids),
-                                         mx_uint(len(args)),
-                                         args_handle,
-                                         args_grad_handle,
-                                         reqs_array,
-                                         mx_uint(len(aux_states)),
-                                         aux_args_handle,
-                                         shared_handle,
-                                         ctypes.byref(handle)))
+        check_call(_LIB.MXExecutorBindWithBudget(self.handle,
+                                                 ctypes.c_int(ctx.device_typeid),
+                                                 ctypes.c_int(ctx.device_id),
+                                                 mx_uint(len(ctx_map_keys)),
+                                                 c_array(ctypes.c_char_p, ctx_map_keys),
+                                                 c_array(ctypes.c_int, ctx_map_dev_types),
+                                                 c_array(ctypes.c_int, ctx_map_dev_ids),
+                                                 mx_uint(len(args)),
+                                                 args_handle,
+                                                 args_grad_handle,
+                                                 reqs_array,
+                                                 mx_uint(len(aux_states)),
+                                                 aux_args_handle,
+                                                 shared_handle,
+                                                 mx_uint(mem_budget),
+                                                 ctypes.byref(handle)))
         executor = Executor(handle, self, ctx, grad_req, group2ctx)
         executor.arg_arrays = args
         executor.grad_arrays = args_grad
@@ -868,7 +932,7 @@ class Symbol(object):
     # pylint: enable= no-member
 
 
-def Variable(name, attr=None, shape=None):
+def Variable(name, attr=None, shape=None, dtype=None):
     """Create a symbolic variable with specified name.
 
     Parameters
@@ -881,6 +945,9 @@ def Variable(name, attr=None, shape=None):
         Optionally, one can specify the shape of a variable. This will be used during
         shape inference. If user specified a different shape for this variable using
         keyword argument when calling shape inference, this shape information will be ignored.
+    dtype : str or numpy.dtype
+        Optionally, the default type of the variable when binding, float32 by default,
+        e.g. uint8 for the input of ImageNormalize.
 
     Returns
     -------
@@ -896,6 +963,9 @@ def Variable(name, attr=None, shape=None):
     if shape is not None:
         attr = {} if attr is None else attr
         attr['__shape__'] = str(shape)
+    if dtype is not None:
+        attr = {} if attr is None else attr
+        attr['__dtype__'] = numpy.dtype(dtype).name
     if attr:
         ret._set_attr(**attr)
     return ret
@@ -927,7 +997,7 @@ def Group(symbols):
 
 
 def load(fname):
-    """Load symbol from a JSON file.
+    """Load symbol from a JSON or binary file.
 
     You can also use pickle to do the job if you only work on python.
     The advantage of load/save is the file is language agnostic.
@@ -150,3 +150,81 @@ def plot_network(symbol, title="plot", shape=None, node_attrs={}):
     return dot
 
 
+def print_cost(executor, line_length=100):
+    """Print the estimated cost of each node of a bound executor, and the
+    totals of its forward and backward passes, see ``Executor.cost``.
+
+    Parameters
+    ----------
+    executor : Executor
+        The bound executor.
+    line_length : int
+        The width of the table.
+    """
+    cost = executor.cost()
+    positions = [.35, .5, .6, .7, .8, .9, 1.]
+    fields = ['Node', 'Op', 'Pass', 'GFLOPs', 'Read MB', 'Write MB', 'Param MB']
+    positions = [int(line_length * p) for p in positions]
+
+    def print_row(values):
+        line = ''
+        for value, pos in zip(values, positions):
+            line += str(value)
+            line = line[:pos - 1] + ' ' * (pos - len(line))
+        print(line)
+
+    def row(name, op, pass_, c):
+        return [name, op, pass_, '%.3f' % (c['flops'] / 1e9),
+                '%.2f' % (c['read_bytes'] / 2.**20), '%.2f' % (c['write_bytes'] / 2.**20),
+                '%.2f' % (c['param_bytes'] / 2.**20)]
+
+    print('_' * line_length)
+    print_row(fields)
+    print('=' * line_length)
+    for node in cost['nodes']:
+        print_row(row(node['name'], node['op'], node['pass'], node))
+    print('=' * line_length)
+    for pass_ in ['forward', 'backward', 'total']:
+        print_row(row('', '', pass_, cost[pass_]))
+    print('Arithmetic intensity: %.2f flops/byte, largest workspace %.2f MB' % (
+        cost['total']['intensity'], cost['total']['workspace_bytes'] / 2.**20))
+    print('_' * line_length)
+
+
+def print_profile(executor, reset=False, line_length=100):
+    """Print the times of each node of an executor timed since
+    ``Executor.set_profiling``, and the mean times of its passes.
+
+    Parameters
+    ----------
+    executor : Executor
+        The bound executor.
+    reset : bool
+        Whether to clear the times.
+    line_length : int
+        The width of the table.
+    """
+    profile = executor.profile(reset)
+    positions = [.35, .5, .6, .7, .8, .9, 1.]
+    fields = ['Node', 'Op', 'Pass', 'Count', 'Mean ms', 'Max ms', 'Percent']
+    positions = [int(line_length * p) for p in positions]
+    total_ms = profile['forward']['mean_ms'] + profile['backward']['mean_ms']
+
+    def print_row(values):
+        line = ''
+        for value, pos in zip(values, positions):
+            line += str(value)
+            line = line[:pos - 1] + ' ' * (pos - len(line))
+        print(line)
+
+    print('_' * line_length)
+    print_row(fields)
+    print('=' * line_length)
+    for node in profile['nodes']:
+        percent = 100. * node['mean_ms'] / total_ms if total_ms > 0 else 0.
+        print_row([node['name'], node['op'], node['pass'], node['count'],
+                   '%.3f' % node['mean_ms'], '%.3f' % node['max_ms'], '%.1f' % percent])
+    print('=' * line_length)
+    for pass_ in ['forward', 'backward']:
+        print_row(['', '', pass_, '', '%.3f' % profile[pass_]['mean_ms'], '', ''])
+    print('_' * line_length)
@@ -12,6 +12,7 @@ class LibInfo {
   @native def nativeLibInit(): Int
   // NDArray
   @native def mxNDArrayFree(handle: NDArrayHandle): Int
+  @native def mxNDArrayFreeAll(handles: Array[NDArrayHandle]): Int
   @native def mxGetLastError(): String
   @native def mxNDArrayCreateNone(out: NDArrayHandleRef): Int
   @native def mxNDArrayCreate(shape: Array[Int],
@@ -63,6 +64,10 @@ class LibInfo {
   @native def mxNDArraySyncCopyFromCPU(handle: NDArrayHandle,
                                        source: Array[MXFloat],
                                        size: Int): Int
+  @native def mxNDArraySyncCopyFromBuffer(handle: NDArrayHandle,
+                                          source: java.nio.ByteBuffer,
+                                          offset: Int,
+                                          size: Int): Int
   @native def mxNDArrayLoad(fname: String,
                             outSize: MXUintRef,
                             handles: ArrayBuffer[NDArrayHandle],
@@ -1,5 +1,7 @@
 package ml.dmlc.mxnet
 
+import java.nio.{ByteBuffer, ByteOrder}
+
 import ml.dmlc.mxnet.Base._
 import org.slf4j.LoggerFactory
 
@@ -513,6 +515,20 @@ object NDArray {
      arr
   }
 
+  /**
+   * Create a new NDArray that copies content from a direct buffer,
+   * without going through a java array.
+   * @param source Direct buffer of native-order floats, read from its position.
+   * @param shape shape of the NDArray
+   * @param ctx The context of the NDArray, default to current default context.
+   * @return The created NDArray.
+   */
+  def array(source: ByteBuffer, shape: Shape, ctx: Context): NDArray = {
+     val arr = empty(shape, ctx)
+     arr.set(source)
+     arr
+  }
+
   /**
    * Join a sequence of arrays at axis-0
    * TODO: shall we make it native?
@@ -620,7 +636,8 @@ object NDArray {
  * NDArray object in mxnet.
  * NDArray is basic ndarray/Tensor like data structure in mxnet. <br />
  * <b>
- * WARNING: it is your responsibility to clear this object through dispose().
+ * WARNING: it is your responsibility to clear this object through dispose(),
+ * or to create it in a NDArrayScope.
  * NEVER rely on the GC strategy
  * </b>
  */
@@ -632,6 +649,7 @@ class NDArray private[mxnet](private[mxnet] val handle: NDArrayHandle,
   private[mxnet] val dependencies = mutable.HashMap.empty[Long, WeakReference[NDArray]]
   private var disposed = false
   def isDisposed: Boolean = disposed
+  NDArrayScope.register(this)
   override protected def finalize(): Unit = {
     dispose()
   }
@@ -650,11 +668,16 @@ class NDArray private[mxnet](private[mxnet] val handle: NDArrayHandle,
   def dispose(): Unit = {
     if (!disposed) {
       _LIB.mxNDArrayFree(handle)
-      dependencies.clear()
-      disposed = true
+      markDisposed()
     }
   }
 
+  // the native memory is released by the caller, see NDArrayScope
+  private[mxnet] def markDisposed(): Unit = {
+    dependencies.clear()
+    disposed = true
+  }
+
   /**
    * Dispose all NDArrays who help to construct this array. <br />
    * e.g. (a * b + c).disposeDeps() will dispose a, b, c (including their deps) and a * b
@@ -702,6 +725,18 @@ class NDArray private[mxnet](private[mxnet] val handle: NDArrayHandle,
     checkCall(_LIB.mxNDArraySyncCopyFromCPU(handle, source, source.length))
   }
 
+  /**
+   * Peform an synchronize copy from an off-heap buffer.
+   * The floats are read from the buffer's position, its position is not changed.
+   * @param source Direct buffer of floats in native byte order.
+   */
+  private def syncCopyfrom(source: ByteBuffer): Unit = {
+    require(source.isDirect, "the buffer must be direct")
+    require(source.order == ByteOrder.nativeOrder, "the buffer must be in native byte order")
+    require(source.remaining >= size * 4, "buffer size do not match the size of NDArray")
+    checkCall(_LIB.mxNDArraySyncCopyFromBuffer(handle, source, source.position, size))
+  }
+
   /**
    * Return a sliced NDArray that shares memory with current one.
    * NDArray only support continuous slicing on axis 0
@@ -787,6 +822,12 @@ class NDArray private[mxnet](private[mxnet] val handle: NDArrayHandle,
     this
   }
 
+  def set(other: ByteBuffer): NDArray = {
+    require(writable, "trying to assign to a readonly NDArray")
+    syncCopyfrom(other)
+    this
+  }
+
   def +(other: NDArray): NDArray = {
     NDArray.invokeBinaryFunc("_plus", this, other)
   }
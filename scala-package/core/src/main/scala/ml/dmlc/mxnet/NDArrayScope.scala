@@ -0,0 +1,100 @@
+package ml.dmlc.mxnet
+
+import ml.dmlc.mxnet.Base._
+
+import scala.collection.mutable.ArrayBuffer
+
+/**
+ * Scope that disposes the NDArrays created in it when it ends. <br />
+ * The native memory of the arrays goes back to the storage pool as soon as the block
+ * completes, to be reused by the arrays of the next one, instead of waiting for the
+ * GC to finalize them: the JVM sees little of the native memory and collects it late
+ * and in bursts. The arrays reachable from the value returned by the block, and those
+ * passed to keep(), are not disposed and belong to the enclosing scope, if any. <br />
+ * Scopes are per thread.
+ * e.g.
+ * {{{
+ *   for (batch <- dataIter) {
+ *     NDArrayScope().withScope {
+ *       val out = (batch.data.head * 2 + 1).toArray
+ *       ...
+ *     }
+ *   }
+ * }}}
+ */
+class NDArrayScope private {
+  private var arrays = ArrayBuffer.empty[NDArray]
+  private var parent: NDArrayScope = null
+
+  /**
+   * Do not dispose these arrays when the scope ends.
+   * @return the first array
+   */
+  def keep(arrs: NDArray*): NDArray = {
+    val handles = arrs.map(_.handle).toSet
+    val (kept, rest) = arrays.partition(arr => handles.contains(arr.handle))
+    arrays = rest
+    // the arrays of an enclosing scope are already in it
+    if (parent != null) kept.foreach(parent.add)
+    arrs.headOption.orNull
+  }
+
+  def withScope[T](body: => T): T = {
+    parent = NDArrayScope._current.get
+    NDArrayScope._current.set(this)
+    try {
+      val ret = body
+      keepReachable(ret)
+      ret
+    } finally {
+      NDArrayScope._current.set(parent)
+      dispose()
+    }
+  }
+
+  private[mxnet] def add(arr: NDArray): Unit = {
+    arrays += arr
+  }
+
+  private def keepReachable(value: Any): Unit = {
+    value match {
+      case arr: NDArray => keep(arr)
+      case arrs: Traversable[_] => arrs.foreach(keepReachable)
+      case arrs: Array[_] if !arrs.getClass.getComponentType.isPrimitive =>
+        arrs.foreach(keepReachable)
+      case tuple: Product => tuple.productIterator.foreach(keepReachable)
+      case _ =>
+    }
+  }
+
+  // free the arrays in one native call
+  private def dispose(): Unit = {
+    val handles = arrays.filter(!_.isDisposed).map { arr =>
+      arr.markDisposed()
+      arr.handle
+    }
+    arrays.clear()
+    if (handles.nonEmpty) {
+      checkCall(_LIB.mxNDArrayFreeAll(handles.toArray))
+    }
+  }
+}
+
+object NDArrayScope {
+  private val _current = new ThreadLocal[NDArrayScope]
+
+  /**
+   * The scope of the calling thread, null out of any scope.
+   */
+  def current: NDArrayScope = _current.get
+
+  def apply(): NDArrayScope = new NDArrayScope()
+
+  /**
+   * Add a new array to the scope of the calling thread.
+   */
+  private[mxnet] def register(arr: NDArray): Unit = {
+    val scope = _current.get
+    if (scope != null) scope.add(arr)
+  }
+}
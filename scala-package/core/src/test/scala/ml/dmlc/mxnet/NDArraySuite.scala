@@ -43,6 +43,15 @@ class NDArraySuite extends FunSuite with BeforeAndAfterAll with Matchers {
     assert(ndarray.toArray === Array(1f, 2f, 3f, 4f))
   }
 
+  test("copy from direct buffer") {
+    val buf = java.nio.ByteBuffer.allocateDirect(5 * 4).order(java.nio.ByteOrder.nativeOrder)
+    Array(9f, 1f, 2f, 3f, 4f).foreach(buf.putFloat)
+    buf.position(4)
+    val ndarray = NDArray.array(buf, Shape(2, 2), Context.cpu())
+    assert(ndarray.toArray === Array(1f, 2f, 3f, 4f))
+    assert(buf.position === 4)
+  }
+
   test("plus") {
     val ndzeros = NDArray.zeros(2, 1)
     val ndones = ndzeros + 1f
@@ -371,6 +380,32 @@ class NDArraySuite extends FunSuite with BeforeAndAfterAll with Matchers {
     assert(arr3.isDisposed)
   }
 
+  test("dispose the arrays of a scope") {
+    val outside = NDArray.ones(2)
+    var inside: NDArray = null
+    var kept: NDArray = null
+    var nested: NDArray = null
+    val (ret, others) = NDArrayScope().withScope {
+      inside = outside * 2
+      NDArrayScope().withScope {
+        nested = inside + 1
+        nested
+      }
+      kept = NDArrayScope.current.keep(inside + outside)
+      (inside * 3, Seq(kept))
+    }
+    assert(!outside.isDisposed)
+    assert(inside.isDisposed)
+    assert(nested.isDisposed)
+    assert(!kept.isDisposed)
+    assert(!ret.isDisposed)
+    assert(ret.toArray === Array(6f, 6f))
+    assert(others.head.toArray === Array(3f, 3f))
+    ret.dispose()
+    kept.dispose()
+    outside.dispose()
+  }
+
   test("serialize and deserialize") {
     val arr = NDArray.ones(1, 2) * 3
     val bytes = arr.serialize()
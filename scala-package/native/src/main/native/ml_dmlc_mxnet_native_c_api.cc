@@ -284,6 +284,16 @@ JNIEXPORT jint JNICALL Java_ml_dmlc_mxnet_LibInfo_mxNDArraySyncCopyFromCPU
   return ret;
 }
 
+JNIEXPORT jint JNICALL Java_ml_dmlc_mxnet_LibInfo_mxNDArraySyncCopyFromBuffer
+  (JNIEnv *env, jobject obj, jlong arrayPtr, jobject sourceBuf, jint offset, jint arrSize) {
+  // a direct buffer is read in place, no java array is pinned or copied
+  char *sourcePtr = static_cast<char *>(env->GetDirectBufferAddress(sourceBuf));
+  if (sourcePtr == nullptr) return -1;
+  return MXNDArraySyncCopyFromCPU(reinterpret_cast<NDArrayHandle>(arrayPtr),
+                                  reinterpret_cast<const mx_float *>(sourcePtr + offset),
+                                  arrSize);
+}
+
 JNIEXPORT jint JNICALL Java_ml_dmlc_mxnet_LibInfo_mxNDArrayGetContext
   (JNIEnv *env, jobject obj, jlong arrayPtr, jobject devTypeId, jobject devId) {
   int outDevType;
@@ -301,6 +311,19 @@ JNIEXPORT jint JNICALL Java_ml_dmlc_mxnet_LibInfo_mxNDArrayFree
   return MXNDArrayFree(reinterpret_cast<NDArrayHandle>(ndArrayHandle));
 }
 
+JNIEXPORT jint JNICALL Java_ml_dmlc_mxnet_LibInfo_mxNDArrayFreeAll
+  (JNIEnv * env, jobject obj, jlongArray ndArrayHandles) {
+  int numArrays = env->GetArrayLength(ndArrayHandles);
+  jlong *handles = env->GetLongArrayElements(ndArrayHandles, NULL);
+  int ret = 0;
+  for (int i = 0; i < numArrays; ++i) {
+    // free all of them even if one fails
+    if (MXNDArrayFree(reinterpret_cast<NDArrayHandle>(handles[i])) != 0) ret = -1;
+  }
+  env->ReleaseLongArrayElements(ndArrayHandles, handles, 0);
+  return ret;
+}
+
 JNIEXPORT jint JNICALL Java_ml_dmlc_mxnet_LibInfo_mxNDArrayLoad
   (JNIEnv * env, jobject obj, jstring jfname, jobject joutSize,
     jobject jhandles, jobject joutNameSize, jobject jnames) {
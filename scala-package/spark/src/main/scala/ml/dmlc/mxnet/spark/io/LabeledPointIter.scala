@@ -1,5 +1,7 @@
 package ml.dmlc.mxnet.spark.io
 
+import java.nio.{ByteBuffer, ByteOrder}
+
 import ml.dmlc.mxnet.{DataBatch, NDArray, Shape, DataIter}
 import org.apache.spark.mllib.regression.LabeledPoint
 
@@ -19,6 +21,11 @@ class LabeledPointIter private[mxnet](
   private val cache: ArrayBuffer[DataBatch] = ArrayBuffer.empty[DataBatch]
   private var index: Int = -1
   private val dataShape = Shape(_batchSize) ++ dimension
+  // off-heap staging of one batch, copied into the NDArrays with a single call each
+  private val dataBuffer = ByteBuffer.allocateDirect(dataShape.product * 4)
+    .order(ByteOrder.nativeOrder)
+  private val labelBuffer = ByteBuffer.allocateDirect(_batchSize * 4)
+    .order(ByteOrder.nativeOrder)
 
   def dispose(): Unit = {
     cache.foreach(_.dispose())
@@ -40,19 +47,29 @@ class LabeledPointIter private[mxnet](
     if (index >= 0 && index < cache.size) {
       cache(index)
     } else {
-      val dataBuilder = NDArray.empty(dataShape)
-      val labelBuilder = NDArray.empty(_batchSize)
+      dataBuffer.clear()
+      labelBuffer.clear()
       var instNum = 0
       while (instNum < batchSize && points.hasNext) {
         val point = points.next()
-        val features = point.features.toArray.map(_.toFloat)
-        require(features.length == dimension.product,
-          s"Dimension mismatch: ${features.length} != $dimension")
-        dataBuilder.slice(instNum).set(features)
-        labelBuilder.slice(instNum).set(Array(point.label.toFloat))
+        require(point.features.size == dimension.product,
+          s"Dimension mismatch: ${point.features.size} != $dimension")
+        val rowOffset = instNum * dimension.product
+        var i = 0
+        while (i < dimension.product) {
+          dataBuffer.putFloat((rowOffset + i) * 4, 0f)
+          i += 1
+        }
+        point.features.foreachActive { (i, v) =>
+          dataBuffer.putFloat((rowOffset + i) * 4, v.toFloat)
+        }
+        labelBuffer.putFloat(instNum * 4, point.label.toFloat)
         instNum += 1
       }
       val pad = batchSize - instNum
+      // the padding rows keep the values of the previous batch, as unset NDArray rows did
+      val dataBuilder = NDArray.empty(dataShape).set(dataBuffer)
+      val labelBuilder = NDArray.empty(_batchSize).set(labelBuffer)
       val dataBatch = new LongLivingDataBatch(
         IndexedSeq(dataBuilder), IndexedSeq(labelBuilder), null, pad)
       cache += dataBatch
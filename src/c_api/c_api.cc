@@ -10,6 +10,8 @@
 #include <dmlc/recordio.h>
 #include <mxnet/base.h>
 #include <mxnet/ndarray.h>
+#include <mxnet/resource.h>
+#include <mxnet/storage.h>
 #include <mxnet/symbolic.h>
 #include <mxnet/operator.h>
 #include <mxnet/optimizer.h>
@@ -18,14 +20,21 @@
 #include <mxnet/kvstore.h>
 #include <mxnet/mxrtc.h>
 #include <vector>
+#include <fstream>
 #include <sstream>
 #include <string>
 #include <mutex>
 #include <memory>
 #include <functional>
+#include <unordered_set>
 #include <utility>
 #include "./c_api_error.h"
 #include "../common/thread_local.h"
+#include "../engine/profiler.h"
+#include "../io/io_stats.h"
+#if !defined(_WIN32)
+#include "../kvstore/kvstore_shm.h"
+#endif
 #include "../operator/custom-inl.h"
 
 using namespace mxnet;
@@ -40,6 +49,8 @@ struct MXAPIThreadLocalEntry {
   std::vector<const char *> ret_vec_charp;
   /*! \brief result holder for returning handles */
   std::vector<void *> ret_handles;
+  /*! \brief result holder for returning counters */
+  std::vector<uint64_t> ret_vec_uint64;
   /*! \brief result holder for returning shapes */
   std::vector<TShape> arg_shapes, out_shapes, aux_shapes;
   /*! \brief result holder for returning type flags */
@@ -113,6 +124,164 @@ int MXNotifyShutdown() {
   API_END();
 }
 
+int MXStorageGetStats(int dev_type,
+                      int dev_id,
+                      size_t *used,
+                      size_t *cached,
+                      size_t *wasted) {
+  API_BEGIN();
+  Storage::Get()->GetStats(
+      Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id),
+      used, cached, wasted);
+  API_END();
+}
+
+int MXStorageGetArenaStats(int dev_type,
+                           int dev_id,
+                           size_t *capacity,
+                           size_t *free,
+                           size_t *largest_free,
+                           size_t *overflow) {
+  API_BEGIN();
+  Storage::Get()->GetArenaStats(
+      Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id),
+      capacity, free, largest_free, overflow);
+  API_END();
+}
+
+int MXStorageRegisterHostMemory(void *ptr, size_t size) {
+  API_BEGIN();
+  Storage::Get()->RegisterHostMemory(ptr, size);
+  API_END();
+}
+
+int MXStorageUnregisterHostMemory(void *ptr) {
+  API_BEGIN();
+  Storage::Get()->UnregisterHostMemory(ptr);
+  API_END();
+}
+
+int MXStorageSetAllocOrigin(const char *origin) {
+  // the strings outlive the arrays that keep a pointer to them, there are few of them
+  static std::mutex mutex;
+  static std::unordered_set<std::string> origins;
+  API_BEGIN();
+  if (origin == nullptr) {
+    Storage::SetAllocOrigin(nullptr);
+  } else {
+    std::lock_guard<std::mutex> lock(mutex);
+    Storage::SetAllocOrigin(origins.insert(origin).first->c_str());
+  }
+  API_END();
+}
+
+int MXStorageDumpTrace(const char *fname) {
+  API_BEGIN();
+  std::ofstream os(fname);
+  CHECK(os.is_open()) << "cannot open " << fname;
+  Storage::Get()->DumpTrace(&os);
+  API_END();
+}
+
+int MXResourceGetTempSpaceStats(int dev_type,
+                                int dev_id,
+                                size_t *bytes,
+                                int *num_bound) {
+  API_BEGIN();
+  ResourceManager::Get()->GetTempSpaceStats(
+      Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id),
+      bytes, num_bound);
+  API_END();
+}
+
+int MXResourceReleaseTempSpace(int dev_type, int dev_id) {
+  API_BEGIN();
+  ResourceManager::Get()->ReleaseTempSpace(
+      Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id));
+  API_END();
+}
+
+int MXSetProfilerConfig(int mode, const char* filename) {
+  API_BEGIN();
+  CHECK(mode == engine::Profiler::kOnlySymbolic ||
+        mode == engine::Profiler::kAllOperator)
+      << "invalid profiler mode " << mode;
+  engine::Profiler::Get()->SetConfig(
+      static_cast<engine::Profiler::ProfilerMode>(mode), std::string(filename));
+  API_END();
+}
+
+int MXSetProfilerState(int state) {
+  API_BEGIN();
+  CHECK(state == engine::Profiler::kNotRunning ||
+        state == engine::Profiler::kRunning)
+      << "invalid profiler state " << state;
+  engine::Profiler::Get()->SetState(
+      static_cast<engine::Profiler::ProfilerState>(state));
+  API_END();
+}
+
+int MXDumpProfile() {
+  API_BEGIN();
+  engine::Profiler* profiler = engine::Profiler::Get();
+  profiler->SetState(engine::Profiler::kNotRunning);
+  profiler->DumpProfile();
+  API_END();
+}
+
+int MXEngineSetBulkSize(int bulk_size, int* prev_bulk_size) {
+  API_BEGIN();
+  *prev_bulk_size = Engine::Get()->set_bulk_size(bulk_size);
+  API_END();
+}
+
+int MXEngineGetStats(mx_uint *out_size,
+                     const char ***out_names,
+                     uint64_t **out_values) {
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  std::vector<std::pair<std::string, uint64_t> > stats;
+  Engine::Get()->GetStats(&stats);
+  ret->ret_vec_str.clear();
+  ret->ret_vec_uint64.clear();
+  for (auto& kv : stats) {
+    ret->ret_vec_str.push_back(kv.first);
+    ret->ret_vec_uint64.push_back(kv.second);
+  }
+  ret->ret_vec_charp.clear();
+  for (const std::string& name : ret->ret_vec_str) {
+    ret->ret_vec_charp.push_back(name.c_str());
+  }
+  *out_size = static_cast<mx_uint>(stats.size());
+  *out_names = dmlc::BeginPtr(ret->ret_vec_charp);
+  *out_values = dmlc::BeginPtr(ret->ret_vec_uint64);
+  API_END();
+}
+
+int MXEngineBeginCapture() {
+  API_BEGIN();
+  Engine::Get()->BeginCapture();
+  API_END();
+}
+
+int MXEngineEndCapture(EngineGraphHandle *out) {
+  API_BEGIN();
+  *out = Engine::Get()->EndCapture();
+  API_END();
+}
+
+int MXEnginePushGraph(EngineGraphHandle handle, int priority) {
+  API_BEGIN();
+  Engine::Get()->PushGraph(static_cast<Engine::GraphHandle>(handle), priority);
+  API_END();
+}
+
+int MXEngineFreeGraph(EngineGraphHandle handle) {
+  API_BEGIN();
+  Engine::Get()->DeleteGraph(static_cast<Engine::GraphHandle>(handle));
+  API_END();
+}
+
 int MXNDArrayCreateNone(NDArrayHandle *out) {
   API_BEGIN();
   *out = new NDArray();
@@ -149,6 +318,129 @@ int MXNDArrayCreateEx(const mx_uint *shape,
   API_END();
 }
 
+int MXNDArrayCreateFromCPUData(void *data,
+                               const mx_uint *shape,
+                               mx_uint ndim,
+                               int dtype,
+                               NDArrayDeleter deleter,
+                               void *deleter_arg,
+                               NDArrayHandle *out) {
+  API_BEGIN();
+  CHECK(data != nullptr || TShape(shape, shape + ndim).Size() == 0)
+      << "MXNDArrayCreateFromCPUData needs the data";
+  std::shared_ptr<void> holder;
+  if (deleter != nullptr) {
+    holder = std::shared_ptr<void>(data, [deleter, deleter_arg](void *p) {
+        deleter(p, deleter_arg);
+      });
+  }
+  TBlob blob(data, TShape(shape, shape + ndim), cpu::kDevMask, dtype);
+  *out = new NDArray(blob, 0, holder);
+  API_END();
+}
+
+#if !defined(_WIN32)
+// a handle to a shared memory region is the pointer to its shared pointer,
+// which is also held by the NDArrays over it
+typedef std::shared_ptr<kvstore::SharedRegion> SharedRegionPtr;
+
+int MXSharedMemCreate(const char *name,
+                      size_t bytes,
+                      int create,
+                      SharedMemHandle *out) {
+  API_BEGIN();
+  kvstore::SharedRegion *region = create != 0 ?
+      kvstore::SharedRegion::Create(name, bytes) : kvstore::SharedRegion::Open(name, bytes);
+  CHECK(region != nullptr) << "no shared memory region " << name << " of " << bytes << " bytes";
+  *out = new SharedRegionPtr(region);
+  API_END();
+}
+
+int MXSharedMemGetData(SharedMemHandle handle,
+                       void **out_data,
+                       size_t *out_bytes) {
+  API_BEGIN();
+  const SharedRegionPtr &region = *static_cast<SharedRegionPtr*>(handle);
+  *out_data = region->data();
+  *out_bytes = region->bytes();
+  API_END();
+}
+
+int MXSharedMemGetNDArray(SharedMemHandle handle,
+                          size_t offset,
+                          const mx_uint *shape,
+                          mx_uint ndim,
+                          int dtype,
+                          NDArrayHandle *out) {
+  API_BEGIN();
+  const SharedRegionPtr &region = *static_cast<SharedRegionPtr*>(handle);
+  TShape tshape(shape, shape + ndim);
+  size_t type_size = 0;
+  MSHADOW_TYPE_SWITCH(dtype, DType, { type_size = sizeof(DType); });
+  CHECK_EQ(offset % type_size, 0U) << "the offset is not aligned for the type";
+  CHECK_LE(offset + tshape.Size() * type_size, region->bytes())
+      << "the array does not fit in the shared memory region";
+  TBlob blob(static_cast<char*>(region->data()) + offset, tshape, cpu::kDevMask, dtype);
+  *out = new NDArray(blob, 0, region);
+  API_END();
+}
+
+int MXSharedMemFree(SharedMemHandle handle) {
+  API_BEGIN();
+  delete static_cast<SharedRegionPtr*>(handle);
+  API_END();
+}
+#else
+int MXSharedMemCreate(const char *name,
+                      size_t bytes,
+                      int create,
+                      SharedMemHandle *out) {
+  API_BEGIN();
+  LOG(FATAL) << "shared memory regions are not supported on windows";
+  API_END();
+}
+
+int MXSharedMemGetData(SharedMemHandle handle,
+                       void **out_data,
+                       size_t *out_bytes) {
+  API_BEGIN();
+  LOG(FATAL) << "shared memory regions are not supported on windows";
+  API_END();
+}
+
+int MXSharedMemGetNDArray(SharedMemHandle handle,
+                          size_t offset,
+                          const mx_uint *shape,
+                          mx_uint ndim,
+                          int dtype,
+                          NDArrayHandle *out) {
+  API_BEGIN();
+  LOG(FATAL) << "shared memory regions are not supported on windows";
+  API_END();
+}
+
+int MXSharedMemFree(SharedMemHandle handle) {
+  API_BEGIN();
+  API_END();
+}
+#endif
+
+int MXNDArrayEvalFused(const char *program,
+                       mx_uint num_inputs,
+                       NDArrayHandle *inputs,
+                       mx_uint num_scalars,
+                       const mx_float *scalars,
+                       NDArrayHandle out) {
+  API_BEGIN();
+  std::vector<NDArray> in(num_inputs);
+  for (mx_uint i = 0; i < num_inputs; ++i) {
+    in[i] = *static_cast<NDArray*>(inputs[i]);
+  }
+  FusedElemwise(program, in, std::vector<real_t>(scalars, scalars + num_scalars),
+                static_cast<NDArray*>(out));
+  API_END();
+}
+
 int MXNDArrayLoadFromRawBytes(const void *buf,
                               size_t size,
                               NDArrayHandle *out) {
@@ -233,6 +525,49 @@ int MXNDArraySave(const char* fname,
   API_END();
 }
 
+int MXNDArraySaveAligned(const char* fname,
+                         mx_uint num_args,
+                         NDArrayHandle* args,
+                         const char** keys) {
+  API_BEGIN();
+  std::vector<NDArray> data(num_args);
+  std::vector<std::string> names;
+  for (mx_uint i = 0; i < num_args; ++i) {
+    data[i] = *static_cast<NDArray*>(args[i]);
+  }
+  if (keys != nullptr) {
+    names.resize(num_args);
+    for (mx_uint i = 0; i < num_args; ++i) {
+      names[i] = keys[i];
+    }
+  }
+  {
+    std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(fname, "w"));
+    mxnet::NDArray::SaveAligned(fo.get(), data, names);
+  }
+  API_END();
+}
+
+int MXNDArraySaveAsync(const char* fname,
+                       mx_uint num_args,
+                       NDArrayHandle* args,
+                       const char** keys) {
+  API_BEGIN();
+  std::vector<NDArray> data(num_args);
+  std::vector<std::string> names;
+  for (mx_uint i = 0; i < num_args; ++i) {
+    data[i] = *static_cast<NDArray*>(args[i]);
+  }
+  if (keys != nullptr) {
+    names.resize(num_args);
+    for (mx_uint i = 0; i < num_args; ++i) {
+      names[i] = keys[i];
+    }
+  }
+  mxnet::NDArray::SaveAsync(fname, data, names);
+  API_END();
+}
+
 int MXNDArrayLoad(const char* fname,
                   mx_uint *out_size,
                   NDArrayHandle** out_arr,
@@ -243,10 +578,7 @@ int MXNDArrayLoad(const char* fname,
   API_BEGIN();
   std::vector<NDArray> data;
   std::vector<std::string> &names = ret->ret_vec_str;
-  {
-    std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(fname, "r"));
-    mxnet::NDArray::Load(fi.get(), &data, &names);
-  }
+  mxnet::NDArray::LoadParallel(fname, &data, &names);
   ret->ret_handles.resize(data.size());
   for (size_t i = 0; i < data.size(); ++i) {
     NDArray *ptr = new NDArray();
@@ -282,6 +614,25 @@ int MXNDArraySlice(NDArrayHandle handle,
   API_END_HANDLE_ERROR(delete ptr);
 }
 
+int MXNDArraySliceAxis(NDArrayHandle handle,
+                       mx_uint axis,
+                       mx_uint slice_begin,
+                       mx_uint slice_end,
+                       NDArrayHandle *out) {
+  NDArray *ptr = new NDArray();
+  API_BEGIN();
+  *ptr = static_cast<NDArray*>(handle)->SliceAxis(
+      axis, slice_begin, slice_end);
+  *out = ptr;
+  API_END_HANDLE_ERROR(delete ptr);
+}
+
+int MXNDArrayIsContiguous(NDArrayHandle handle, int *out) {
+  API_BEGIN();
+  *out = static_cast<NDArray*>(handle)->is_contiguous();
+  API_END();
+}
+
 int MXNDArrayAt(NDArrayHandle handle,
                 mx_uint idx,
                 NDArrayHandle *out) {
@@ -335,6 +686,22 @@ int MXNDArrayGetData(NDArrayHandle handle,
   API_END();
 }
 
+int MXNDArrayGetRawData(NDArrayHandle handle,
+                        void **out_pdata) {
+  API_BEGIN();
+  NDArray *arr = static_cast<NDArray*>(handle);
+  if (!arr->is_none()) {
+    CHECK(arr->ctx().dev_mask() == cpu::kDevMask)
+        << "MXNDArrayGetRawData can only be called for NDArray on CPU";
+    CHECK(arr->is_contiguous())
+        << "MXNDArrayGetRawData can only be called for a contiguous NDArray";
+    *out_pdata = arr->data().dptr_;
+  } else {
+    *out_pdata = nullptr;
+  }
+  API_END();
+}
+
 int MXNDArrayGetDType(NDArrayHandle handle,
                      int *out_dtype) {
   API_BEGIN();
@@ -407,18 +774,61 @@ int MXFuncDescribe(FunctionHandle fun,
   API_END();
 }
 
+// invoke a function, the strided views are given as contiguous copies to the
+// functions not accepting them, and the copies of the mutated ones are copied back
+inline void InvokeFunction(const NDArrayFunctionReg *f,
+                           NDArray **use_vars,
+                           real_t *scalar_args,
+                           NDArray **mutate_vars,
+                           int num_params,
+                           char **param_keys,
+                           char **param_vals) {
+  auto strided = [](NDArray *arr) {
+    return arr != nullptr && !arr->is_none() && !arr->is_contiguous();
+  };
+  bool has_strided = false;
+  for (unsigned i = 0; i < f->num_use_vars; ++i) has_strided |= strided(use_vars[i]);
+  for (unsigned i = 0; i < f->num_mutate_vars; ++i) has_strided |= strided(mutate_vars[i]);
+  if ((f->type_mask & kAcceptStridedArgs) || !has_strided) {
+    f->body(use_vars, scalar_args, mutate_vars, num_params, param_keys, param_vals);
+    return;
+  }
+  std::vector<NDArray> use_copy(f->num_use_vars), mutate_copy(f->num_mutate_vars);
+  std::vector<NDArray*> use_ptr(f->num_use_vars), mutate_ptr(f->num_mutate_vars);
+  for (unsigned i = 0; i < f->num_use_vars; ++i) {
+    use_ptr[i] = use_vars[i];
+    if (strided(use_vars[i])) {
+      use_copy[i] = use_vars[i]->Contiguous();
+      use_ptr[i] = &use_copy[i];
+    }
+  }
+  for (unsigned i = 0; i < f->num_mutate_vars; ++i) {
+    mutate_ptr[i] = mutate_vars[i];
+    if (strided(mutate_vars[i])) {
+      mutate_copy[i] = mutate_vars[i]->Contiguous();
+      mutate_ptr[i] = &mutate_copy[i];
+    }
+  }
+  f->body(dmlc::BeginPtr(use_ptr), scalar_args, dmlc::BeginPtr(mutate_ptr),
+          num_params, param_keys, param_vals);
+  for (unsigned i = 0; i < f->num_mutate_vars; ++i) {
+    if (mutate_ptr[i] != mutate_vars[i]) CopyFromTo(mutate_copy[i], mutate_vars[i]);
+  }
+}
+
 int MXFuncInvoke(FunctionHandle fun,
                  NDArrayHandle *use_vars,
                  mx_float *scalar_args,
                  NDArrayHandle *mutate_vars) {
   API_BEGIN();
   auto *f = static_cast<const NDArrayFunctionReg*>(fun);
-  f->body((NDArray**)(use_vars),  //  NOLINT(*)
-          scalar_args,
-          (NDArray**)(mutate_vars),  //  NOLINT(*)
-          0,
-          NULL,
-          NULL);
+  InvokeFunction(f,
+                 (NDArray**)(use_vars),  //  NOLINT(*)
+                 scalar_args,
+                 (NDArray**)(mutate_vars),  //  NOLINT(*)
+                 0,
+                 NULL,
+                 NULL);
   API_END();
 }
 
@@ -431,12 +841,86 @@ int MXFuncInvokeEx(FunctionHandle fun,
                  char **param_vals) {
   API_BEGIN();
   auto *f = static_cast<const NDArrayFunctionReg*>(fun);
-  f->body((NDArray**)(use_vars),  //  NOLINT(*)
-          scalar_args,
-          (NDArray**)(mutate_vars),  //  NOLINT(*)
-          num_params,
-          param_keys,
-          param_vals);
+  InvokeFunction(f,
+                 (NDArray**)(use_vars),  //  NOLINT(*)
+                 scalar_args,
+                 (NDArray**)(mutate_vars),  //  NOLINT(*)
+                 num_params,
+                 param_keys,
+                 param_vals);
+  API_END();
+}
+
+/*! \brief keyword parameters of a function, kept as the arguments of its body */
+struct MXFuncParams {
+  /*! \brief the function they are created for */
+  const NDArrayFunctionReg *fun;
+  /*! \brief the keys and values */
+  std::vector<std::string> keys, vals;
+  /*! \brief the pointers given to the body */
+  std::vector<char*> pkeys, pvals;
+};
+
+int MXFuncCreateParams(FunctionHandle fun,
+                       int num_params,
+                       const char **param_keys,
+                       const char **param_vals,
+                       FunctionParamsHandle *out) {
+  API_BEGIN();
+  CHECK_GE(num_params, 0);
+  MXFuncParams *p = new MXFuncParams();
+  p->fun = static_cast<const NDArrayFunctionReg*>(fun);
+  p->keys.assign(param_keys, param_keys + num_params);
+  p->vals.assign(param_vals, param_vals + num_params);
+  for (int i = 0; i < num_params; ++i) {
+    p->pkeys.push_back(const_cast<char*>(p->keys[i].c_str()));
+    p->pvals.push_back(const_cast<char*>(p->vals[i].c_str()));
+  }
+  *out = p;
+  API_END();
+}
+
+int MXFuncFreeParams(FunctionParamsHandle handle) {
+  API_BEGIN();
+  delete static_cast<MXFuncParams*>(handle);
+  API_END();
+}
+
+int MXFuncInvokeBatch(mx_uint num_calls,
+                      FunctionHandle *funs,
+                      NDArrayHandle *use_vars,
+                      mx_float *scalar_args,
+                      NDArrayHandle *mutate_vars,
+                      FunctionParamsHandle *params) {
+  API_BEGIN();
+  // the calls are grouped into engine operations, restored on errors as well
+  struct BulkScope {
+    int prev;
+    explicit BulkScope(int size) {
+      prev = Engine::Get()->set_bulk_size(size);
+    }
+    ~BulkScope() {
+      Engine::Get()->set_bulk_size(prev);
+    }
+  } bulk(static_cast<int>(num_calls));
+  NDArray **use = reinterpret_cast<NDArray**>(use_vars);
+  NDArray **mutate = reinterpret_cast<NDArray**>(mutate_vars);
+  for (mx_uint i = 0; i < num_calls; ++i) {
+    auto *f = static_cast<const NDArrayFunctionReg*>(funs[i]);
+    const MXFuncParams *p = params != nullptr ? static_cast<MXFuncParams*>(params[i]) : nullptr;
+    if (p != nullptr) {
+      CHECK_EQ(p->fun, f) << "the parameters of call " << i << " are created for "
+                          << p->fun->name << " instead of " << f->name;
+      InvokeFunction(f, use, scalar_args, mutate, static_cast<int>(p->keys.size()),
+                     const_cast<char**>(dmlc::BeginPtr(p->pkeys)),
+                     const_cast<char**>(dmlc::BeginPtr(p->pvals)));
+    } else {
+      InvokeFunction(f, use, scalar_args, mutate, 0, NULL, NULL);
+    }
+    use += f->num_use_vars;
+    scalar_args += f->num_scalars;
+    mutate += f->num_mutate_vars;
+  }
   API_END();
 }
 
@@ -543,12 +1027,7 @@ int MXSymbolGetInternals(SymbolHandle symbol,
 int MXSymbolCreateFromFile(const char *fname, SymbolHandle *out) {
   Symbol *s = new Symbol();
   API_BEGIN();
-  std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(fname, "r"));
-  dmlc::istream is(fi.get());
-  dmlc::JSONReader reader(&is);
-  s->Load(&reader);
-  // reset file pointer
-  is.set_stream(nullptr);
+  s->LoadFile(fname);
   *out = s;
   API_END_HANDLE_ERROR(delete s);
 }
@@ -576,6 +1055,14 @@ int MXSymbolSaveToFile(SymbolHandle symbol, const char *fname) {
   API_END();
 }
 
+int MXSymbolSaveToBinaryFile(SymbolHandle symbol, const char *fname) {
+  Symbol *s = static_cast<Symbol*>(symbol);
+  API_BEGIN();
+  std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(fname, "w"));
+  s->Save(fo.get());
+  API_END();
+}
+
 int MXSymbolSaveToJSON(SymbolHandle symbol, const char **out_json) {
   Symbol *s = static_cast<Symbol*>(symbol);
   MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
@@ -947,6 +1434,40 @@ int MXExecutorPrint(ExecutorHandle handle, const char **out_str) {
   API_END();
 }
 
+int MXExecutorPrintCost(ExecutorHandle handle, const char **out_json) {
+  Executor *exec = static_cast<Executor*>(handle);
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  std::ostringstream os;
+  exec->PrintCost(os);
+  ret->ret_str = os.str();
+  *out_json = (ret->ret_str).c_str();
+  API_END();
+}
+
+int MXExecutorSetProfiling(ExecutorHandle handle, int enable) {
+  API_BEGIN();
+  static_cast<Executor*>(handle)->SetProfiling(enable != 0);
+  API_END();
+}
+
+int MXExecutorWarmup(ExecutorHandle handle) {
+  API_BEGIN();
+  static_cast<Executor*>(handle)->Warmup();
+  API_END();
+}
+
+int MXExecutorPrintProfile(ExecutorHandle handle, int reset, const char **out_json) {
+  Executor *exec = static_cast<Executor*>(handle);
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  std::ostringstream os;
+  exec->PrintProfile(os, reset != 0);
+  ret->ret_str = os.str();
+  *out_json = (ret->ret_str).c_str();
+  API_END();
+}
+
 int MXExecutorFree(ExecutorHandle handle) {
   API_BEGIN();
   delete static_cast<Executor*>(handle);
@@ -1046,6 +1567,28 @@ int MXExecutorBindEX(SymbolHandle symbol_handle,
                      NDArrayHandle *aux_states,
                      ExecutorHandle shared_exec,
                      ExecutorHandle *out) {
+  return MXExecutorBindWithBudget(symbol_handle, dev_type, dev_id,
+                                  num_map_keys, map_keys, map_dev_types, map_dev_ids,
+                                  len, in_args, arg_grad_store, grad_req_type,
+                                  aux_states_len, aux_states, shared_exec, 0, out);
+}
+
+int MXExecutorBindWithBudget(SymbolHandle symbol_handle,
+                             int dev_type,
+                             int dev_id,
+                             mx_uint num_map_keys,
+                             const char** map_keys,
+                             const int* map_dev_types,
+                             const int* map_dev_ids,
+                             mx_uint len,
+                             NDArrayHandle *in_args,
+                             NDArrayHandle *arg_grad_store,
+                             mx_uint *grad_req_type,
+                             mx_uint aux_states_len,
+                             NDArrayHandle *aux_states,
+                             ExecutorHandle shared_exec,
+                             mx_uint mem_budget_mb,
+                             ExecutorHandle *out) {
   API_BEGIN();
   Symbol *symb = static_cast<Symbol*>(symbol_handle);
   Context ctx = Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id);
@@ -1062,21 +1605,55 @@ int MXExecutorBindEX(SymbolHandle symbol_handle,
   std::vector<OpReqType> grad_req_vec;
   std::vector<NDArray> aux_states_vec;
   for (mx_uint i = 0; i < len; ++i) {
+    CHECK(in_args_ptr[i]->is_contiguous()) << "cannot bind a strided view";
     in_args_vec.push_back(*(in_args_ptr[i]));
     if (arg_grad_ptr[i] == nullptr) {
       arg_grad_vec.push_back(NDArray());
       grad_req_vec.push_back(kNullOp);
     } else {
+      CHECK(arg_grad_ptr[i]->is_contiguous()) << "cannot bind a strided view";
       arg_grad_vec.push_back(*(arg_grad_ptr[i]));
       grad_req_vec.push_back(static_cast<OpReqType>(grad_req_type[i]));
     }
   }
   for (mx_uint i = 0; i < aux_states_len; ++i) {
+    CHECK(aux_states_ptr[i]->is_contiguous()) << "cannot bind a strided view";
     aux_states_vec.push_back(*(aux_states_ptr[i]));
   }
   *out = Executor::Bind(*symb, ctx, ctx_map, in_args_vec,
                         arg_grad_vec, grad_req_vec, aux_states_vec,
-                        reinterpret_cast<Executor*>(shared_exec));
+                        reinterpret_cast<Executor*>(shared_exec),
+                        static_cast<size_t>(mem_budget_mb) << 20);
+  API_END();
+}
+
+int MXExecutorReshape(ExecutorHandle handle,
+                      mx_uint len,
+                      NDArrayHandle *in_args,
+                      NDArrayHandle *arg_grad_store,
+                      mx_uint aux_states_len,
+                      NDArrayHandle *aux_states,
+                      ExecutorHandle *out) {
+  API_BEGIN();
+  Executor *exec = static_cast<Executor*>(handle);
+  NDArray **in_args_ptr = reinterpret_cast<NDArray**>(in_args);
+  NDArray **arg_grad_ptr = reinterpret_cast<NDArray**>(arg_grad_store);
+  NDArray **aux_states_ptr = reinterpret_cast<NDArray**>(aux_states);
+  std::vector<NDArray> in_args_vec;
+  std::vector<NDArray> arg_grad_vec;
+  std::vector<NDArray> aux_states_vec;
+  for (mx_uint i = 0; i < len; ++i) {
+    in_args_vec.push_back(*(in_args_ptr[i]));
+    if (arg_grad_ptr[i] == nullptr) {
+      arg_grad_vec.push_back(NDArray());
+    } else {
+      arg_grad_vec.push_back(*(arg_grad_ptr[i]));
+    }
+  }
+  for (mx_uint i = 0; i < aux_states_len; ++i) {
+    aux_states_vec.push_back(*(aux_states_ptr[i]));
+  }
+  *out = exec->Reshape(in_args_vec, arg_grad_vec, aux_states_vec);
   API_END();
 }
 
@@ -1095,6 +1672,21 @@ int MXExecutorSetMonitorCallback(ExecutorHandle handle,
   API_END();
 }
 
+int MXExecutorSetGradReadyCallback(ExecutorHandle handle,
+                                   ExecutorGradReadyCallback callback,
+                                   void* callback_handle) {
+  API_BEGIN();
+  ExecutorGradReadyCallback callback_temp = callback;
+  void* callback_handle_temp = callback_handle;
+  std::function<void(uint32_t)> clbk
+  = [callback_temp, callback_handle_temp](uint32_t index) {
+    callback_temp(index, callback_handle_temp);
+  };
+  Executor *exec = static_cast<Executor*>(handle);
+  exec->SetGradReadyCallback(clbk);
+  API_END();
+}
+
 //--------------------------------------------
 // Part 5: IO Interface
 //--------------------------------------------
@@ -1150,6 +1742,19 @@ int MXDataIterBeforeFirst(DataIterHandle handle) {
   API_END();
 }
 
+int MXDataIterReset(DataIterHandle handle,
+                    mx_uint num_param,
+                    const char **keys,
+                    const char **vals) {
+  API_BEGIN();
+  std::vector<std::pair<std::string, std::string> > kwargs;
+  for (mx_uint i = 0; i < num_param; ++i) {
+    kwargs.push_back({std::string(keys[i]), std::string(vals[i])});
+  }
+  static_cast<IIterator<DataBatch>* >(handle)->Reset(kwargs);
+  API_END();
+}
+
 int MXDataIterNext(DataIterHandle handle, int *out) {
   API_BEGIN();
   *out = static_cast<IIterator<DataBatch>* >(handle)->Next();
@@ -1189,6 +1794,21 @@ int MXDataIterGetData(DataIterHandle handle, NDArrayHandle *out) {
   API_END();
 }
 
+int MXDataIterGetExtraData(DataIterHandle handle, mx_uint *out_size, NDArrayHandle **out) {
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  const DataBatch& db = static_cast<IIterator<DataBatch>* >(handle)->Value();
+  ret->ret_handles.clear();
+  for (size_t i = 2; i < db.data.size(); ++i) {
+    NDArray* pndarray = new NDArray();
+    *pndarray = db.data[i];
+    ret->ret_handles.push_back(pndarray);
+  }
+  *out_size = static_cast<mx_uint>(ret->ret_handles.size());
+  *out = dmlc::BeginPtr(ret->ret_handles);
+  API_END();
+}
+
 int MXDataIterGetPadNum(DataIterHandle handle, int *pad) {
   API_BEGIN();
   const DataBatch& db = static_cast<IIterator<DataBatch>* >(handle)->Value();
@@ -1196,6 +1816,23 @@ int MXDataIterGetPadNum(DataIterHandle handle, int *pad) {
   API_END();
 }
 
+int MXDataIterGetBucketKey(DataIterHandle handle, int *bucket_key) {
+  API_BEGIN();
+  const DataBatch& db = static_cast<IIterator<DataBatch>* >(handle)->Value();
+  *bucket_key = db.bucket_key;
+  API_END();
+}
+
+int MXDataIterGetStats(int reset, const char **out_json) {
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  std::ostringstream os;
+  io::IOStats::Get()->Dump(&os, reset != 0);
+  ret->ret_str = os.str();
+  *out_json = ret->ret_str.c_str();
+  API_END();
+}
+
 int MXKVStoreCreate(const char *type,
                     KVStoreHandle *out) {
   API_BEGIN();
@@ -1256,6 +1893,44 @@ int MXKVStorePull(KVStoreHandle handle,
   API_END();
 }
 
+int MXKVStorePushRowSparse(KVStoreHandle handle,
+                           mx_uint num,
+                           const int* keys,
+                           NDArrayHandle* row_ids,
+                           NDArrayHandle* vals,
+                           int priority) {
+  API_BEGIN();
+  std::vector<int> v_keys(num);
+  std::vector<NDArray> v_row_ids(num);
+  std::vector<NDArray> v_vals(num);
+  for (mx_uint i = 0; i < num; ++i) {
+    v_keys[i] = keys[i];
+    v_row_ids[i] = *static_cast<NDArray*>(row_ids[i]);
+    v_vals[i] = *static_cast<NDArray*>(vals[i]);
+  }
+  static_cast<KVStore*>(handle)->PushRowSparse(v_keys, v_row_ids, v_vals, priority);
+  API_END();
+}
+
+int MXKVStorePullRowSparse(KVStoreHandle handle,
+                           mx_uint num,
+                           const int* keys,
+                           NDArrayHandle* row_ids,
+                           NDArrayHandle* vals,
+                           int priority) {
+  API_BEGIN();
+  std::vector<int> v_keys(num);
+  std::vector<NDArray> v_row_ids(num);
+  std::vector<NDArray*> v_vals(num);
+  for (mx_uint i = 0; i < num; ++i) {
+    v_keys[i] = keys[i];
+    v_row_ids[i] = *static_cast<NDArray*>(row_ids[i]);
+    v_vals[i] = static_cast<NDArray*>(vals[i]);
+  }
+  static_cast<KVStore*>(handle)->PullRowSparse(v_keys, v_row_ids, v_vals, priority);
+  API_END();
+}
+
 int MXKVStoreSetUpdater(KVStoreHandle handle,
                         MXKVStoreUpdater updater,
                         void* updater_handle) {
@@ -1335,6 +2010,43 @@ int MXKVStoreRunServer(KVStoreHandle handle,
   API_END();
 }
 
+int MXKVStoreSetGradientCompression(KVStoreHandle handle,
+                                    mx_uint num_params,
+                                    const char** keys,
+                                    const char** vals) {
+  API_BEGIN();
+  std::vector<std::pair<std::string, std::string> > kwargs;
+  for (mx_uint i = 0; i < num_params; ++i) {
+    kwargs.push_back(std::make_pair(std::string(keys[i]), std::string(vals[i])));
+  }
+  static_cast<KVStore*>(handle)->SetGradientCompression(kwargs);
+  API_END();
+}
+
+int MXKVStoreSetWireDType(KVStoreHandle handle,
+                          mx_uint num,
+                          const int* keys,
+                          int dtype) {
+  API_BEGIN();
+  std::vector<int> v_keys(keys, keys + num);
+  static_cast<KVStore*>(handle)->SetWireDType(v_keys, dtype);
+  API_END();
+}
+
+int MXKVStoreSetServerOptimizer(KVStoreHandle handle,
+                                const char* name,
+                                mx_uint num_params,
+                                const char** keys,
+                                const char** vals) {
+  API_BEGIN();
+  std::vector<std::pair<std::string, std::string> > kwargs;
+  for (mx_uint i = 0; i < num_params; ++i) {
+    kwargs.push_back(std::make_pair(std::string(keys[i]), std::string(vals[i])));
+  }
+  static_cast<KVStore*>(handle)->SetServerOptimizer(name, kwargs);
+  API_END();
+}
+
 int MXKVStoreSendCommmandToServers(KVStoreHandle handle,
                                    int cmd_id,
                                    const char* cmd_body) {
@@ -1351,6 +2063,16 @@ int MXKVStoreGetType(KVStoreHandle handle,
   API_END();
 }
 
+int MXKVStoreGetStats(KVStoreHandle handle,
+                      int reset,
+                      const char** out_json) {
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  ret->ret_str = static_cast<KVStore*>(handle)->GetStats(reset != 0);
+  *out_json = ret->ret_str.c_str();
+  API_END();
+}
+
 struct MXRecordIOContext {
   dmlc::RecordIOWriter *writer;
   dmlc::RecordIOReader *reader;
@@ -1427,6 +2149,29 @@ int MXRecordIOReaderReadRecord(RecordIOHandle *handle,
   API_END();
 }
 
+int MXRecordIOWriterTell(RecordIOHandle handle, size_t *pos) {
+  API_BEGIN();
+  MXRecordIOContext *context =
+    reinterpret_cast<MXRecordIOContext*>(handle);
+  dmlc::SeekStream *stream = dynamic_cast<dmlc::SeekStream*>(context->stream);
+  CHECK(stream != NULL) << "RecordIO writer is not seekable";
+  *pos = stream->Tell();
+  API_END();
+}
+
+int MXRecordIOReaderSeek(RecordIOHandle handle, size_t pos) {
+  API_BEGIN();
+  MXRecordIOContext *context =
+    reinterpret_cast<MXRecordIOContext*>(handle);
+  dmlc::SeekStream *stream = dynamic_cast<dmlc::SeekStream*>(context->stream);
+  CHECK(stream != NULL) << "RecordIO reader is not seekable";
+  stream->Seek(pos);
+  // restart the reader, which may have reached the end of the stream
+  delete context->reader;
+  context->reader = new dmlc::RecordIOReader(stream);
+  API_END();
+}
+
 int MXRtcCreate(char* name, mx_uint num_input, mx_uint num_output,
                 char** input_names, char** output_names,
                 NDArrayHandle* inputs, NDArrayHandle* outputs,
@@ -1536,6 +2281,43 @@ int MXOptimizerUpdate(OptimizerHandle handle,
   API_END();
 }
 
+int MXOptimizerUpdateMulti(OptimizerHandle handle,
+                           mx_uint num,
+                           const int *indices,
+                           NDArrayHandle *weights,
+                           NDArrayHandle *grads,
+                           const mx_float *lrs,
+                           const mx_float *wds) {
+  API_BEGIN();
+  Optimizer *opt = static_cast<Optimizer*>(handle);
+  std::vector<NDArray*> weight_vec(num);
+  std::vector<const NDArray*> grad_vec(num);
+  for (mx_uint i = 0; i < num; ++i) {
+    weight_vec[i] = static_cast<NDArray*>(weights[i]);
+    grad_vec[i] = static_cast<NDArray*>(grads[i]);
+  }
+  opt->UpdateMulti(std::vector<int>(indices, indices + num), weight_vec, grad_vec,
+                   std::vector<float>(lrs, lrs + num), std::vector<float>(wds, wds + num));
+  API_END();
+}
+
+int MXOptimizerUpdateRowSparse(OptimizerHandle handle,
+                               int index,
+                               NDArrayHandle weight,
+                               NDArrayHandle row_ids,
+                               NDArrayHandle grad,
+                               mx_float lr,
+                               mx_float wd) {
+  API_BEGIN();
+  Optimizer *opt = static_cast<Optimizer*>(handle);
+  opt->UpdateRowSparse(index,
+                       static_cast<NDArray*>(weight),
+                       *static_cast<NDArray*>(row_ids),
+                       static_cast<NDArray*>(grad),
+                       lr, wd);
+  API_END();
+}
+
 int MXCustomOpRegister(const char* op_type, CustomOpPropCreator creator) {
   API_BEGIN();
   mxnet::op::CustomOpProp::Register(op_type, creator);
@@ -8,13 +8,28 @@
 #include <mxnet/c_predict_api.h>
 #include <mxnet/symbolic.h>
 #include <mxnet/ndarray.h>
+#include <mxnet/storage.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_set>
 #include <unordered_map>
+#include <vector>
 #include "./c_api_error.h"
+#include "../symbol/inference_optimizer.h"
 
 using namespace mxnet;
 
+struct MXAPIPredHost;
+
 // predictor interface
 struct MXAPIPredictor {
   // output arrays
@@ -27,8 +42,84 @@ struct MXAPIPredictor {
   std::unordered_map<std::string, size_t> key2arg;
   // executor
   std::unique_ptr<Executor> exec;
+  // the symbol, after the inference optimizations
+  Symbol sym;
+  // the context of the arrays
+  Context ctx;
+  // auxiliary state arrays
+  std::vector<NDArray> aux_arrays;
+  // whether each argument is a loaded parameter, shared by MXPredCreateShared
+  std::vector<bool> arg_is_param;
+  // the host of the predictor, NULL for none
+  MXAPIPredHost* host = nullptr;
+  // the name of its model in the host, the origin of its allocations
+  std::string name;
+  // whether it shares the memory of the intermediate results in the host
+  bool shared_activations = false;
+  // the priority of its operations
+  int priority = 0;
+};
+
+// a host of several models, see MXPredHostCreatePredictor
+struct MXAPIPredHost {
+  std::mutex mu;
+  // the number of predictors of each model
+  std::unordered_map<std::string, int> models;
+  // the predictors sharing the memory of their intermediate results
+  std::vector<MXAPIPredictor*> shared;
+  // add a predictor of a model, the first one of a new model if new_model
+  void Join(MXAPIPredictor* p, bool new_model) {
+    std::lock_guard<std::mutex> lock(mu);
+    CHECK(!new_model || models.count(p->name) == 0)
+        << "model " << p->name << " is already in the host";
+    ++models[p->name];
+    if (p->shared_activations) shared.push_back(p);
+    p->host = this;
+  }
+  // remove a predictor, and the quota of its model with the last one
+  void Leave(MXAPIPredictor* p) {
+    std::lock_guard<std::mutex> lock(mu);
+    shared.erase(std::remove(shared.begin(), shared.end(), p), shared.end());
+    if (--models[p->name] == 0) {
+      models.erase(p->name);
+      Storage::Get()->SetOriginQuota(p->name, 0);
+    }
+  }
 };
 
+// bind the executor of a predictor to its arrays
+void BindPredictor(MXAPIPredictor* p) {
+  std::map<std::string, Context> ctx_map;
+  std::vector<NDArray> grad_store(p->arg_arrays.size());
+  std::vector<OpReqType> grad_req(p->arg_arrays.size(), kNullOp);
+  // the executors bound with another one share its memory pool, which grows to fit
+  Executor* shared_exec = nullptr;
+  std::unique_lock<std::mutex> lock;
+  if (p->host != nullptr && p->shared_activations) {
+    lock = std::unique_lock<std::mutex>(p->host->mu);
+    for (MXAPIPredictor* q : p->host->shared) {
+      if (q != p && q->ctx == p->ctx && q->exec != nullptr) {
+        shared_exec = q->exec.get();
+        break;
+      }
+    }
+  }
+  p->exec.reset(Executor::Bind(p->sym, p->ctx, ctx_map,
+                               p->arg_arrays,
+                               grad_store, grad_req,
+                               p->aux_arrays, shared_exec));
+  p->exec->SetPriority(p->priority);
+  p->out_arrays = p->exec->outputs();
+  // a shared memory pool is already warm, and may hold the results of another model
+  if (shared_exec == nullptr && dmlc::GetEnv("MXNET_PREDICT_WARMUP", false)) {
+    // the inputs are not set yet, zeros are valid for every operator, e.g. as indices
+    for (size_t i = 0; i < p->arg_arrays.size(); ++i) {
+      if (!p->arg_is_param[i]) p->arg_arrays[i] = 0.0f;
+    }
+    p->exec->Warmup();
+  }
+}
+
 struct MXAPINDList {
   std::vector<std::string> keys;
   std::vector<TShape> shapes;
@@ -60,27 +151,18 @@ int MXPredCreate(const char* symbol_json_str,
       out);
 }
 
-int MXPredCreatePartialOut(const char* symbol_json_str,
-                           const void* param_bytes,
-                           int param_size,
-                           int dev_type, int dev_id,
-                           mx_uint num_input_nodes,
-                           const char** input_keys,
-                           const mx_uint* input_shape_indptr,
-                           const mx_uint* input_shape_data,
-                           mx_uint num_output_nodes,
-                           const char** output_keys,
-                           PredictorHandle* out) {
-  MXAPIPredictor* ret = new MXAPIPredictor();
-  API_BEGIN();
-  Symbol sym;
-  // load in the symbol.
-  {
-    std::string json = symbol_json_str;
-    std::istringstream is(json);
-    dmlc::JSONReader reader(&is);
-    sym.Load(&reader);
-  }
+// create a predictor from the loaded parameter file
+void InitPredictor(MXAPIPredictor* ret,
+                   Symbol sym,
+                   std::vector<NDArray> data,
+                   std::vector<std::string> names,
+                   int dev_type, int dev_id,
+                   mx_uint num_input_nodes,
+                   const char** input_keys,
+                   const mx_uint* input_shape_indptr,
+                   const mx_uint* input_shape_data,
+                   mx_uint num_output_nodes,
+                   const char** output_keys) {
   // looks likely to output the internal results
   if (num_output_nodes != 0) {
     Symbol internal = sym.GetInternals();
@@ -112,10 +194,6 @@ int MXPredCreatePartialOut(const char* symbol_json_str,
     for (size_t i = 0; i < aux_names_vec.size(); ++i) {
       aux_names.insert(aux_names_vec[i]);
     }
-    std::vector<NDArray> data;
-    std::vector<std::string> names;
-    dmlc::MemoryFixedSizeStream fi((void*)param_bytes, param_size);  // NOLINT(*)
-    NDArray::Load(&fi, &data, &names);
     CHECK_EQ(names.size(), data.size())
         << "Invalid param file format";
     for (size_t i = 0; i < names.size(); ++i) {
@@ -134,6 +212,11 @@ int MXPredCreatePartialOut(const char* symbol_json_str,
     }
   }
 
+  // fold BatchNorm and parameter only subgraphs into the parameters
+  if (dmlc::GetEnv("MXNET_PREDICT_OPTIMIZE", true)) {
+    OptimizeForInference(&sym, &arg_params, &aux_params);
+  }
+
   // shape inference and bind
   std::unordered_map<std::string, TShape> known_shape;
   for (mx_uint i = 0; i < num_input_nodes; ++i) {
@@ -158,39 +241,648 @@ int MXPredCreatePartialOut(const char* symbol_json_str,
   CHECK(sym.InferShape(&arg_shapes, &out_shapes, &aux_shapes))
       << "The shape information of is not enough to get the shapes";
   ret->out_shapes = out_shapes;
+  // inputs are float32, the parameters keep their types, e.g. quantized weights
+  std::vector<int> arg_types(arg_names.size(), -1);
+  std::vector<int> out_types, aux_types(aux_names.size(), -1);
+  for (size_t i = 0; i < arg_names.size(); ++i) {
+    if (arg_params.count(arg_names[i]) != 0) {
+      arg_types[i] = arg_params[arg_names[i]].dtype();
+    } else if (known_shape.count(arg_names[i]) != 0) {
+      arg_types[i] = mshadow::kFloat32;
+    }
+  }
+  sym.InferType(&arg_types, &out_types, &aux_types);
   Context ctx = Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id);
 
-  std::vector<NDArray> arg_arrays, aux_arrays;
   for (size_t i = 0; i < arg_shapes.size(); ++i) {
-    NDArray nd = NDArray(arg_shapes[i], ctx);
+    int dtype = arg_types[i] == -1 ? mshadow::kFloat32 : arg_types[i];
+    const bool is_param = arg_params.count(arg_names[i]) != 0 &&
+        known_shape.count(arg_names[i]) == 0;
+    if (is_param) {
+      // the loaded parameters of the context are bound without copy, e.g. a mapped file
+      const NDArray& param = arg_params[arg_names[i]];
+      if (param.ctx() == ctx && param.dtype() == dtype && param.shape() == arg_shapes[i]) {
+        ret->arg_arrays.push_back(param);
+        ret->arg_is_param.push_back(true);
+        continue;
+      }
+    }
+    NDArray nd = NDArray(arg_shapes[i], ctx, false, dtype);
     if (arg_params.count(arg_names[i]) != 0) {
       CopyFromTo(arg_params[arg_names[i]], &nd);
     }
-    arg_arrays.push_back(nd);
+    ret->arg_arrays.push_back(nd);
+    ret->arg_is_param.push_back(is_param);
   }
   for (size_t i = 0; i < aux_shapes.size(); ++i) {
     NDArray nd = NDArray(aux_shapes[i], ctx);
     if (aux_params.count(aux_names[i]) != 0) {
       CopyFromTo(aux_params[aux_names[i]], &nd);
     }
-    aux_arrays.push_back(nd);
+    ret->aux_arrays.push_back(nd);
   }
-  ret->arg_arrays = arg_arrays;
-  // bind
+  ret->sym = sym;
+  ret->ctx = ctx;
+  BindPredictor(ret);
+}
+
+int MXPredCreatePartialOut(const char* symbol_json_str,
+                           const void* param_bytes,
+                           int param_size,
+                           int dev_type, int dev_id,
+                           mx_uint num_input_nodes,
+                           const char** input_keys,
+                           const mx_uint* input_shape_indptr,
+                           const mx_uint* input_shape_data,
+                           mx_uint num_output_nodes,
+                           const char** output_keys,
+                           PredictorHandle* out) {
+  MXAPIPredictor* ret = new MXAPIPredictor();
+  API_BEGIN();
+  std::vector<NDArray> data;
+  std::vector<std::string> names;
+  dmlc::MemoryFixedSizeStream fi((void*)param_bytes, param_size);  // NOLINT(*)
+  NDArray::Load(&fi, &data, &names);
+  Symbol sym;
+  sym.LoadBuffer(symbol_json_str, strlen(symbol_json_str));
+  InitPredictor(ret, sym, data, names, dev_type, dev_id,
+                num_input_nodes, input_keys, input_shape_indptr, input_shape_data,
+                num_output_nodes, output_keys);
+  *out = ret;
+  API_END_HANDLE_ERROR(delete ret);
+}
+
+int MXPredCreateFromFile(const char* symbol_json_str,
+                         const char* param_file,
+                         int dev_type, int dev_id,
+                         mx_uint num_input_nodes,
+                         const char** input_keys,
+                         const mx_uint* input_shape_indptr,
+                         const mx_uint* input_shape_data,
+                         mx_uint num_output_nodes,
+                         const char** output_keys,
+                         PredictorHandle* out) {
+  MXAPIPredictor* ret = new MXAPIPredictor();
+  API_BEGIN();
+  std::vector<NDArray> data;
+  std::vector<std::string> names;
+  NDArray::LoadMapped(param_file, &data, &names);
+  Symbol sym;
+  sym.LoadBuffer(symbol_json_str, strlen(symbol_json_str));
+  InitPredictor(ret, sym, data, names, dev_type, dev_id,
+                num_input_nodes, input_keys, input_shape_indptr, input_shape_data,
+                num_output_nodes, output_keys);
+  *out = ret;
+  API_END_HANDLE_ERROR(delete ret);
+}
+
+int MXPredCreateFromSymbolFile(const char* symbol_file,
+                               const char* param_file,
+                               int dev_type, int dev_id,
+                               mx_uint num_input_nodes,
+                               const char** input_keys,
+                               const mx_uint* input_shape_indptr,
+                               const mx_uint* input_shape_data,
+                               mx_uint num_output_nodes,
+                               const char** output_keys,
+                               PredictorHandle* out) {
+  MXAPIPredictor* ret = new MXAPIPredictor();
+  API_BEGIN();
+  Symbol sym;
+  sym.LoadFile(symbol_file);
+  std::vector<NDArray> data;
+  std::vector<std::string> names;
+  NDArray::LoadMapped(param_file, &data, &names);
+  InitPredictor(ret, sym, data, names, dev_type, dev_id,
+                num_input_nodes, input_keys, input_shape_indptr, input_shape_data,
+                num_output_nodes, output_keys);
+  *out = ret;
+  API_END_HANDLE_ERROR(delete ret);
+}
+
+int MXPredCreateShared(PredictorHandle handle, PredictorHandle* out) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  MXAPIPredictor* ret = new MXAPIPredictor();
+  API_BEGIN();
+  // a predictor of the same model in the host
+  if (p->host != nullptr) {
+    ret->name = p->name;
+    ret->shared_activations = p->shared_activations;
+    ret->priority = p->priority;
+    p->host->Join(ret, false);
+  }
+  Storage::AllocOriginScope scope(ret->host != nullptr ? ret->name.c_str() : nullptr);
+  ret->out_shapes = p->out_shapes;
+  ret->key2arg = p->key2arg;
+  ret->sym = p->sym;
+  ret->ctx = p->ctx;
+  ret->arg_is_param = p->arg_is_param;
+  // the parameters are only read by the forward, the inputs are private
+  for (size_t i = 0; i < p->arg_arrays.size(); ++i) {
+    const NDArray& arr = p->arg_arrays[i];
+    if (p->arg_is_param[i]) {
+      ret->arg_arrays.push_back(arr);
+    } else {
+      ret->arg_arrays.push_back(NDArray(arr.shape(), arr.ctx(), false, arr.dtype()));
+    }
+  }
+  // the auxiliary states are written by the operators, which would serialize
+  // the instances, they are small and copied
+  for (const NDArray& arr : p->aux_arrays) {
+    NDArray nd(arr.shape(), arr.ctx(), false, arr.dtype());
+    CopyFromTo(arr, &nd);
+    ret->aux_arrays.push_back(nd);
+  }
+  BindPredictor(ret);
+  *out = ret;
+  API_END_HANDLE_ERROR(MXPredFree(ret));
+}
+
+int MXPredHostCreate(PredHostHandle* out) {
+  API_BEGIN();
+  *out = new MXAPIPredHost();
+  API_END();
+}
+
+int MXPredHostCreatePredictor(PredHostHandle host,
+                              const char* name,
+                              mx_uint memory_quota_mb,
+                              int shared_activations,
+                              int priority,
+                              const char* symbol_json_str,
+                              const void* param_bytes,
+                              int param_size,
+                              int dev_type, int dev_id,
+                              mx_uint num_input_nodes,
+                              const char** input_keys,
+                              const mx_uint* input_shape_indptr,
+                              const mx_uint* input_shape_data,
+                              PredictorHandle* out) {
+  MXAPIPredHost* h = static_cast<MXAPIPredHost*>(host);
+  MXAPIPredictor* ret = new MXAPIPredictor();
+  API_BEGIN();
+  ret->name = name;
+  ret->shared_activations = shared_activations != 0;
+  ret->priority = priority;
+  h->Join(ret, true);
+  Storage::Get()->SetOriginQuota(ret->name, static_cast<size_t>(memory_quota_mb) << 20);
+  // the parameters and the memory of the executor are allocated for the model
+  Storage::AllocOriginScope scope(ret->name.c_str());
+  std::vector<NDArray> data;
+  std::vector<std::string> names;
+  dmlc::MemoryFixedSizeStream fi((void*)param_bytes, param_size);  // NOLINT(*)
+  NDArray::Load(&fi, &data, &names);
+  Symbol sym;
+  sym.LoadBuffer(symbol_json_str, strlen(symbol_json_str));
+  InitPredictor(ret, sym, data, names, dev_type, dev_id,
+                num_input_nodes, input_keys, input_shape_indptr, input_shape_data,
+                0, NULL);
+  *out = ret;
+  API_END_HANDLE_ERROR(MXPredFree(ret));
+}
+
+int MXPredHostFree(PredHostHandle host) {
+  MXAPIPredHost* h = static_cast<MXAPIPredHost*>(host);
+  API_BEGIN();
   {
-    std::map<std::string, Context> ctx_map;
-    std::vector<NDArray> grad_store(arg_arrays.size());
-    std::vector<OpReqType> grad_req(arg_arrays.size(), kNullOp);
-    ret->exec.reset(Executor::Bind(sym, ctx, ctx_map,
-                                   arg_arrays,
-                                   grad_store, grad_req,
-                                   aux_arrays));
-    ret->out_arrays = ret->exec->outputs();
+    std::lock_guard<std::mutex> lock(h->mu);
+    CHECK_EQ(h->models.size(), 0U) << "the predictors of the host must be freed first";
+  }
+  delete h;
+  API_END();
+}
+
+// batching front-end of a predictor, see MXPredBatcherCreate
+struct MXAPIPredBatcher {
+  struct Request {
+    // the data of each batched input, empty for zeros
+    std::vector<std::vector<mx_float> > inputs;
+    PredBatchCallback callback;
+    void* callback_arg;
+    std::chrono::steady_clock::time_point time;
+  };
+  // the executor of a batch smaller than max_batch
+  struct Batch {
+    std::unique_ptr<Executor> exec;
+    std::vector<NDArray> inputs;
+  };
+  MXAPIPredictor* pred;
+  size_t max_batch;
+  std::chrono::microseconds timeout;
+  // the arguments given by the requests, by their position in the batch inputs
+  std::vector<size_t> input_args;
+  std::unordered_map<std::string, size_t> key2input;
+  // the number of elements of a sample of each input
+  std::vector<size_t> sample_size;
+  // executors by batch size, reshaped from the one of pred, used by the worker only
+  std::map<size_t, Batch> batches;
+  std::mutex mu;
+  std::condition_variable cv;
+  std::deque<Request> queue;
+  bool stop = false;
+  std::thread worker;
+
+  void Run() {
+    while (true) {
+      std::vector<Request> reqs;
+      {
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock, [this]() { return stop || !queue.empty(); });
+        if (queue.empty()) return;
+        auto deadline = queue.front().time + timeout;
+        cv.wait_until(lock, deadline, [this]() {
+            return stop || queue.size() >= max_batch;
+          });
+        const size_t n = std::min(max_batch, queue.size());
+        for (size_t i = 0; i < n; ++i) {
+          reqs.push_back(std::move(queue.front()));
+          queue.pop_front();
+        }
+      }
+      std::string error;
+      std::vector<std::vector<mx_float> > outputs;
+      try {
+        Forward(reqs, &outputs);
+      } catch (const dmlc::Error& e) {
+        error = e.what();
+      }
+      // scatter the outputs to the requests
+      const size_t nout = outputs.size();
+      std::vector<const mx_float*> ptrs(nout);
+      std::vector<mx_uint> sizes(nout);
+      for (size_t k = 0; k < nout; ++k) sizes[k] = outputs[k].size() / reqs.size();
+      for (size_t i = 0; i < reqs.size(); ++i) {
+        if (error.size() != 0) {
+          reqs[i].callback(error.c_str(), 0, NULL, NULL, reqs[i].callback_arg);
+          continue;
+        }
+        for (size_t k = 0; k < nout; ++k) ptrs[k] = outputs[k].data() + i * sizes[k];
+        reqs[i].callback(NULL, static_cast<mx_uint>(nout), ptrs.data(), sizes.data(),
+                         reqs[i].callback_arg);
+      }
+    }
+  }
+
+  // run the forward of a batch, partial batches use the executor reshaped to their size
+  void Forward(const std::vector<Request>& reqs, std::vector<std::vector<mx_float> >* outputs) {
+    const size_t n = reqs.size();
+    Executor* exec = pred->exec.get();
+    std::vector<NDArray> inputs;
+    for (size_t arg : input_args) inputs.push_back(pred->arg_arrays[arg]);
+    if (n != max_batch) {
+      Batch& b = batches[n];
+      if (b.exec == nullptr) {
+        std::vector<NDArray> args = pred->arg_arrays;
+        for (size_t k = 0; k < input_args.size(); ++k) {
+          TShape shape = args[input_args[k]].shape();
+          shape[0] = n;
+          args[input_args[k]] = NDArray(shape, pred->ctx, false, args[input_args[k]].dtype());
+          b.inputs.push_back(args[input_args[k]]);
+        }
+        b.exec.reset(exec->Reshape(args, std::vector<NDArray>(args.size()),
+                                   pred->aux_arrays));
+      }
+      exec = b.exec.get();
+      inputs = b.inputs;
+    }
+    std::vector<mx_float> buf;
+    for (size_t k = 0; k < inputs.size(); ++k) {
+      buf.assign(n * sample_size[k], 0.0f);
+      for (size_t i = 0; i < n; ++i) {
+        const std::vector<mx_float>& data = reqs[i].inputs[k];
+        std::copy(data.begin(), data.end(), buf.begin() + i * sample_size[k]);
+      }
+      inputs[k].SyncCopyFromCPU(buf.data(), buf.size());
+    }
+    exec->Forward(false);
+    const std::vector<NDArray>& outs = exec->outputs();
+    outputs->resize(outs.size());
+    for (size_t k = 0; k < outs.size(); ++k) {
+      (*outputs)[k].resize(outs[k].shape().Size());
+      outs[k].SyncCopyToCPU((*outputs)[k].data(), (*outputs)[k].size());
+    }
+  }
+};
+
+int MXPredBatcherCreate(PredictorHandle handle,
+                        mx_uint max_batch,
+                        mx_uint timeout_us,
+                        PredBatcherHandle* out) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  MXAPIPredBatcher* ret = new MXAPIPredBatcher();
+  API_BEGIN();
+  CHECK_GT(max_batch, 0) << "max_batch must be positive";
+  ret->pred = p;
+  ret->max_batch = max_batch;
+  ret->timeout = std::chrono::microseconds(timeout_us);
+  for (const auto& kv : p->key2arg) {
+    if (p->arg_is_param[kv.second]) continue;
+    const TShape& shape = p->arg_arrays[kv.second].shape();
+    CHECK(shape.ndim() != 0 && shape[0] == max_batch)
+        << "the first dimension of input " << kv.first << " must be max_batch=" << max_batch;
+    ret->key2input[kv.first] = ret->input_args.size();
+    ret->input_args.push_back(kv.second);
+    ret->sample_size.push_back(shape.Size() / max_batch);
+  }
+  ret->worker = std::thread([ret]() { ret->Run(); });
+  *out = ret;
+  API_END_HANDLE_ERROR(delete ret);
+}
+
+int MXPredBatcherSubmit(PredBatcherHandle handle,
+                        mx_uint num_inputs,
+                        const char** input_keys,
+                        const mx_float** input_data,
+                        PredBatchCallback callback,
+                        void* callback_arg) {
+  MXAPIPredBatcher* b = static_cast<MXAPIPredBatcher*>(handle);
+  API_BEGIN();
+  MXAPIPredBatcher::Request req;
+  req.inputs.resize(b->input_args.size());
+  for (mx_uint i = 0; i < num_inputs; ++i) {
+    auto it = b->key2input.find(input_keys[i]);
+    CHECK(it != b->key2input.end()) << "cannot find input key " << input_keys[i];
+    req.inputs[it->second].assign(input_data[i], input_data[i] + b->sample_size[it->second]);
+  }
+  req.callback = callback;
+  req.callback_arg = callback_arg;
+  req.time = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(b->mu);
+    CHECK(!b->stop) << "the batcher is freed";
+    b->queue.push_back(std::move(req));
+  }
+  b->cv.notify_all();
+  API_END();
+}
+
+int MXPredBatcherFree(PredBatcherHandle handle) {
+  MXAPIPredBatcher* b = static_cast<MXAPIPredBatcher*>(handle);
+  API_BEGIN();
+  {
+    std::lock_guard<std::mutex> lock(b->mu);
+    b->stop = true;
+  }
+  b->cv.notify_all();
+  if (b->worker.joinable()) b->worker.join();
+  delete b;
+  API_END();
+}
+
+// data parallel predictor over several devices, see MXPredMultiCreate
+struct MXAPIPredMulti {
+  // the executor of a device for a number of samples
+  struct Slot {
+    std::unique_ptr<Executor> exec;
+    std::vector<NDArray> inputs;
+  };
+  struct Device {
+    std::unique_ptr<MXAPIPredictor> pred;
+    // executors reshaped from the one of pred, by number of samples
+    std::map<size_t, Slot> reshaped;
+    // the number of samples of the batch run by the device
+    size_t size;
+    // moving average of the seconds per sample, 0 before the first measure
+    double sec_per_sample = 0.0;
+  };
+  std::vector<Device> devices;
+  size_t batch;
+  // the arguments of the inputs, and the number of elements of a sample of each one
+  std::vector<size_t> input_args;
+  std::vector<size_t> sample_size;
+  std::unordered_map<std::string, size_t> key2input;
+  // the batch of the inputs and the outputs in the host
+  std::vector<std::vector<mx_float> > inputs, outputs;
+  std::vector<size_t> out_sample_size;
+  std::vector<TShape> out_shapes;
+
+  // the executor of a device for its current number of samples and its inputs,
+  // fresh if it is just created
+  Executor* GetExecutor(Device* dev, std::vector<NDArray>* args_in, bool* fresh) {
+    MXAPIPredictor* p = dev->pred.get();
+    *fresh = false;
+    if (dev->size == p->arg_arrays[input_args[0]].shape()[0]) {
+      for (size_t arg : input_args) args_in->push_back(p->arg_arrays[arg]);
+      return p->exec.get();
+    }
+    Slot& slot = dev->reshaped[dev->size];
+    if (slot.exec == nullptr) {
+      std::vector<NDArray> args = p->arg_arrays;
+      for (size_t arg : input_args) {
+        TShape shape = args[arg].shape();
+        shape[0] = dev->size;
+        args[arg] = NDArray(shape, p->ctx, false, args[arg].dtype());
+        slot.inputs.push_back(args[arg]);
+      }
+      slot.exec.reset(p->exec->Reshape(args, std::vector<NDArray>(args.size()),
+                                       p->aux_arrays));
+      *fresh = true;
+    }
+    *args_in = slot.inputs;
+    return slot.exec.get();
+  }
+
+  // split the batch in proportion to the rates, at least one sample for each device
+  static std::vector<size_t> Split(size_t batch, const std::vector<double>& rates) {
+    const size_t n = rates.size();
+    double total = 0.0;
+    for (double r : rates) total += r;
+    std::vector<size_t> sizes(n);
+    std::vector<std::pair<double, size_t> > rest(n);
+    size_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+      const double share = (batch - n) * rates[i] / total;
+      sizes[i] = 1 + static_cast<size_t>(share);
+      rest[i] = std::make_pair(share - static_cast<size_t>(share), i);
+      sum += sizes[i];
+    }
+    std::sort(rest.begin(), rest.end(), std::greater<std::pair<double, size_t> >());
+    for (size_t i = 0; sum < batch; ++i, ++sum) ++sizes[rest[i % n].second];
+    return sizes;
+  }
+
+  void Forward() {
+    const size_t ndev = devices.size();
+    std::vector<std::string> errors(ndev);
+    std::vector<double> seconds(ndev);
+    std::vector<int> fresh(ndev);
+    std::vector<std::thread> threads;
+    size_t offset = 0;
+    for (size_t d = 0; d < ndev; ++d) {
+      threads.emplace_back([this, d, offset, &errors, &seconds, &fresh]() {
+          Device& dev = devices[d];
+          try {
+            auto start = std::chrono::steady_clock::now();
+            bool is_fresh;
+            std::vector<NDArray> args_in;
+            Executor* exec = GetExecutor(&dev, &args_in, &is_fresh);
+            fresh[d] = is_fresh ? 1 : 0;
+            for (size_t k = 0; k < args_in.size(); ++k) {
+              args_in[k].SyncCopyFromCPU(inputs[k].data() + offset * sample_size[k],
+                                             dev.size * sample_size[k]);
+            }
+            exec->Forward(false);
+            const std::vector<NDArray>& outs = exec->outputs();
+            for (size_t k = 0; k < outs.size(); ++k) {
+              outs[k].SyncCopyToCPU(outputs[k].data() + offset * out_sample_size[k],
+                                    dev.size * out_sample_size[k]);
+            }
+            seconds[d] = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+          } catch (const dmlc::Error& e) {
+            errors[d] = e.what();
+          }
+        });
+      offset += devices[d].size;
+    }
+    for (std::thread& t : threads) t.join();
+    for (size_t d = 0; d < ndev; ++d) {
+      CHECK_EQ(errors[d].size(), 0U) << errors[d];
+    }
+    // the first forward of an executor allocates its memory and is not measured
+    std::vector<double> rates(ndev);
+    for (size_t d = 0; d < ndev; ++d) {
+      Device& dev = devices[d];
+      if (!fresh[d]) {
+        const double t = seconds[d] / dev.size;
+        dev.sec_per_sample = dev.sec_per_sample == 0.0 ? t : 0.5 * (dev.sec_per_sample + t);
+      }
+      if (dev.sec_per_sample == 0.0) return;
+      rates[d] = 1.0 / dev.sec_per_sample;
+    }
+    // move the samples when a device is off by more than 1/32 of the batch,
+    // not to reshape on the noise of the measures
+    std::vector<size_t> sizes = Split(batch, rates);
+    const size_t tolerance = std::max<size_t>(batch / 32, 1);
+    bool moved = false;
+    for (size_t d = 0; d < ndev; ++d) {
+      const size_t diff = sizes[d] > devices[d].size ?
+          sizes[d] - devices[d].size : devices[d].size - sizes[d];
+      moved = moved || diff > tolerance;
+    }
+    if (!moved) return;
+    for (size_t d = 0; d < ndev; ++d) devices[d].size = sizes[d];
+  }
+};
+
+int MXPredMultiCreate(const char* symbol_json_str,
+                      const void* param_bytes,
+                      int param_size,
+                      int dev_type,
+                      mx_uint num_devices,
+                      const int* dev_ids,
+                      mx_uint num_input_nodes,
+                      const char** input_keys,
+                      const mx_uint* input_shape_indptr,
+                      const mx_uint* input_shape_data,
+                      PredMultiHandle* out) {
+  MXAPIPredMulti* ret = new MXAPIPredMulti();
+  API_BEGIN();
+  CHECK_GT(num_devices, 0U) << "no device is given";
+  CHECK_GT(num_input_nodes, 0U) << "no input is given";
+  // the parameters are loaded once in the host, and copied to each device
+  std::vector<NDArray> data;
+  std::vector<std::string> names;
+  dmlc::MemoryFixedSizeStream fi((void*)param_bytes, param_size);  // NOLINT(*)
+  NDArray::Load(&fi, &data, &names);
+  Symbol sym;
+  sym.LoadBuffer(symbol_json_str, strlen(symbol_json_str));
+  const mx_uint batch = input_shape_data[input_shape_indptr[0]];
+  for (mx_uint i = 0; i < num_input_nodes; ++i) {
+    CHECK(input_shape_indptr[i + 1] > input_shape_indptr[i] &&
+          input_shape_data[input_shape_indptr[i]] == batch)
+        << "the first dimension of every input must be the batch size";
+  }
+  CHECK_GE(batch, num_devices) << "the batch is smaller than the number of devices";
+  ret->batch = batch;
+  // an equal split until the devices are measured
+  std::vector<mx_uint> shape_data(input_shape_data,
+                                  input_shape_data + input_shape_indptr[num_input_nodes]);
+  ret->devices.resize(num_devices);
+  for (mx_uint d = 0; d < num_devices; ++d) {
+    MXAPIPredMulti::Device& dev = ret->devices[d];
+    dev.size = batch / num_devices + (d < batch % num_devices ? 1 : 0);
+    for (mx_uint i = 0; i < num_input_nodes; ++i) {
+      shape_data[input_shape_indptr[i]] = static_cast<mx_uint>(dev.size);
+    }
+    dev.pred.reset(new MXAPIPredictor());
+    InitPredictor(dev.pred.get(), sym, data, names, dev_type, dev_ids[d],
+                  num_input_nodes, input_keys, input_shape_indptr, shape_data.data(),
+                  0, NULL);
+  }
+  MXAPIPredictor* p = ret->devices[0].pred.get();
+  for (mx_uint i = 0; i < num_input_nodes; ++i) {
+    const size_t arg = p->key2arg.at(input_keys[i]);
+    const TShape& shape = p->arg_arrays[arg].shape();
+    ret->key2input[input_keys[i]] = ret->input_args.size();
+    ret->input_args.push_back(arg);
+    ret->sample_size.push_back(shape.Size() / shape[0]);
+    ret->inputs.emplace_back(batch * ret->sample_size.back(), 0.0f);
+  }
+  for (const TShape& shape : p->out_shapes) {
+    CHECK(shape.ndim() != 0 && shape[0] == ret->devices[0].size)
+        << "the first dimension of every output must be the batch size";
+    TShape full = shape;
+    full[0] = batch;
+    ret->out_shapes.push_back(full);
+    ret->out_sample_size.push_back(shape.Size() / shape[0]);
+    ret->outputs.emplace_back(full.Size(), 0.0f);
   }
   *out = ret;
   API_END_HANDLE_ERROR(delete ret);
 }
 
+int MXPredMultiSetInput(PredMultiHandle handle,
+                        const char* key,
+                        const mx_float* data,
+                        mx_uint size) {
+  MXAPIPredMulti* m = static_cast<MXAPIPredMulti*>(handle);
+  API_BEGIN();
+  auto it = m->key2input.find(key);
+  CHECK(it != m->key2input.end()) << "cannot find input key " << key;
+  std::vector<mx_float>& buf = m->inputs[it->second];
+  CHECK_EQ(size, buf.size()) << "input " << key << " must have " << buf.size() << " elements";
+  std::copy(data, data + size, buf.begin());
+  API_END();
+}
+
+int MXPredMultiForward(PredMultiHandle handle) {
+  API_BEGIN();
+  static_cast<MXAPIPredMulti*>(handle)->Forward();
+  API_END();
+}
+
+int MXPredMultiGetOutputShape(PredMultiHandle handle,
+                              mx_uint index,
+                              mx_uint** shape_data,
+                              mx_uint* shape_ndim) {
+  MXAPIPredMulti* m = static_cast<MXAPIPredMulti*>(handle);
+  API_BEGIN();
+  CHECK_LT(index, m->out_shapes.size()) << "Output index out of range";
+  *shape_data = m->out_shapes[index].data();
+  *shape_ndim = m->out_shapes[index].ndim();
+  API_END();
+}
+
+int MXPredMultiGetOutput(PredMultiHandle handle,
+                         mx_uint index,
+                         mx_float* data,
+                         mx_uint size) {
+  MXAPIPredMulti* m = static_cast<MXAPIPredMulti*>(handle);
+  API_BEGIN();
+  CHECK_LT(index, m->outputs.size()) << "Output index out of range";
+  const std::vector<mx_float>& buf = m->outputs[index];
+  CHECK_EQ(size, buf.size()) << "output " << index << " has " << buf.size() << " elements";
+  std::copy(buf.begin(), buf.end(), data);
+  API_END();
+}
+
+int MXPredMultiFree(PredMultiHandle handle) {
+  API_BEGIN();
+  delete static_cast<MXAPIPredMulti*>(handle);
+  API_END();
+}
+
 int MXPredGetOutputShape(PredictorHandle handle,
                          mx_uint out_index,
                          mx_uint** shape_data,
@@ -219,9 +911,31 @@ int MXPredSetInput(PredictorHandle handle,
   API_END();
 }
 
+int MXPredGetInputPtr(PredictorHandle handle,
+                      const char* key,
+                      mx_float** data,
+                      mx_uint* size) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  API_BEGIN();
+  auto it = p->key2arg.find(key);
+  if (it == p->key2arg.end()) {
+    LOG(FATAL) << "cannot find input key " << key;
+  }
+  NDArray& nd = p->arg_arrays[it->second];
+  CHECK_EQ(nd.ctx().dev_mask(), cpu::kDevMask)
+      << "MXPredGetInputPtr needs a cpu predictor";
+  CHECK_EQ(nd.dtype(), mshadow::kFloat32) << "input " << key << " is not float32";
+  // the previous forward may still read it
+  nd.WaitToWrite();
+  *data = static_cast<mx_float*>(nd.data().dptr_);
+  *size = static_cast<mx_uint>(nd.shape().Size());
+  API_END();
+}
+
 int MXPredForward(PredictorHandle handle) {
   MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
   API_BEGIN();
+  Storage::AllocOriginScope scope(p->host != nullptr ? p->name.c_str() : nullptr);
   p->exec->Forward(false);
   API_END();
 }
@@ -246,9 +960,29 @@ int MXPredGetOutput(PredictorHandle handle,
   API_END();
 }
 
+int MXPredGetOutputPtr(PredictorHandle handle,
+                       mx_uint index,
+                       const mx_float** data,
+                       mx_uint* size) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  API_BEGIN();
+  CHECK_LT(index, p->out_arrays.size())
+      << "Output index out of range";
+  const NDArray& nd = p->out_arrays[index];
+  CHECK_EQ(nd.ctx().dev_mask(), cpu::kDevMask)
+      << "MXPredGetOutputPtr needs a cpu predictor";
+  CHECK_EQ(nd.dtype(), mshadow::kFloat32) << "output " << index << " is not float32";
+  nd.WaitToRead();
+  *data = static_cast<const mx_float*>(nd.data().dptr_);
+  *size = static_cast<mx_uint>(nd.shape().Size());
+  API_END();
+}
+
 int MXPredFree(PredictorHandle handle) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
   API_BEGIN();
-  delete static_cast<MXAPIPredictor*>(handle);
+  if (p->host != nullptr) p->host->Leave(p);
+  delete p;
   API_END();
 }
 
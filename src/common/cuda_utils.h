@@ -13,6 +13,10 @@
 #include <cuda_runtime.h>
 #include <cublas_v2.h>
 #include <curand.h>
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <utility>
 
 namespace mxnet {
 namespace common {
@@ -139,6 +143,43 @@ inline const char* CurandGetErrorString(curandStatus_t status) {
         << "cuRAND: " << common::cuda::CurandGetErrorString(e); \
   }
 
+namespace mxnet {
+namespace common {
+namespace cuda {
+/*!
+ * \brief Let the copies between two devices go over the peer to peer link when
+ *  the topology allows, otherwise the driver stages them through the host.
+ *  Each pair of devices is only checked once.
+ * \param dev The first device.
+ * \param peer The second device.
+ */
+inline void EnablePeerAccess(int dev, int peer) {
+  static std::mutex mutex;
+  static std::set<std::pair<int, int> > checked;
+  if (dev == peer) return;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!checked.insert(std::make_pair(std::min(dev, peer), std::max(dev, peer))).second) return;
+  int current, can_access = 0;
+  CUDA_CALL(cudaGetDevice(&current));
+  for (int k = 0; k < 2; ++k) {
+    CUDA_CALL(cudaDeviceCanAccessPeer(&can_access, dev, peer));
+    if (can_access) {
+      CUDA_CALL(cudaSetDevice(dev));
+      cudaError_t err = cudaDeviceEnablePeerAccess(peer, 0);
+      if (err == cudaErrorPeerAccessAlreadyEnabled) {
+        cudaGetLastError();
+      } else {
+        CUDA_CALL(err);
+      }
+    }
+    std::swap(dev, peer);
+  }
+  CUDA_CALL(cudaSetDevice(current));
+}
+}  // namespace cuda
+}  // namespace common
+}  // namespace mxnet
+
 #endif  // MXNET_USE_CUDA
 
 #if MXNET_USE_CUDNN
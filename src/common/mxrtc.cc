@@ -9,6 +9,7 @@
 namespace mxnet {
 const char MXRtc::str_type[] = "float";
 std::unordered_map<std::string, char*> MXRtc::kernel_registry;
+static std::mutex kernel_registry_mutex;
 
 MXRtc::MXRtc(const std::string& name,
              std::vector<std::pair<std::string, NDArray> > const& input,
@@ -18,13 +19,47 @@ MXRtc::MXRtc(const std::string& name,
     num_input_ = input.size();
     num_output_ = output.size();
     code_ = decorate(name, input, output, kernel);
+    std::lock_guard<std::mutex> lock(kernel_registry_mutex);
     if (MXRtc::kernel_registry.find(code_) != MXRtc::kernel_registry.end()) {
         ptx_ = MXRtc::kernel_registry[code_];
     } else {
         ptx_ = compile(name, code_);
+        MXRtc::kernel_registry[code_] = ptx_;
     }
 }
 
+CUfunction MXRtc::get_function(int dev_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (func_.find(dev_id) != func_.end()) return func_[dev_id];
+    cudaError_enum err;
+    CUfunction func;
+    CUmodule module;
+    CHECK_EQ(err = cuModuleLoadDataEx(&module, ptx_, 0, 0, 0), CUDA_SUCCESS)
+        << "CudaError: " << err;
+    CHECK_EQ(err = cuModuleGetFunction(&func, module, name_.c_str()), CUDA_SUCCESS)
+        << "CudaError: " << err;
+    module_[dev_id] = module;
+    func_[dev_id] = func;
+    return func;
+}
+
+void MXRtc::launch(std::vector<float*> args,
+                   int dev_id,
+                   mshadow::Stream<mshadow::gpu> *stream,
+                   unsigned int grid_dim_X,
+                   unsigned int block_dim_X) {
+    CHECK_EQ(num_input_ + num_output_, args.size());
+    CUfunction func = get_function(dev_id);
+    std::vector<void*> ptrs;
+    for (auto& i : args) ptrs.push_back(&i);
+    cudaError_enum err;
+    CHECK_EQ(err = cuLaunchKernel(func,
+                                  grid_dim_X, 1, 1,
+                                  block_dim_X, 1, 1,
+                                  0, stream->stream_,
+                                  ptrs.data(), 0), CUDA_SUCCESS) << "CudaError: " << err;
+}
+
 void MXRtc::push(std::vector<NDArray> const& input,
                  std::vector<NDArray> const& output,
                  unsigned int grid_dim_X,
@@ -36,20 +71,7 @@ void MXRtc::push(std::vector<NDArray> const& input,
     CHECK_EQ(num_input_, input.size());
     CHECK_EQ(num_output_, output.size());
     CHECK(output.size());
-    cudaError_enum err;
-    CUfunction func;
-    int dev_id = output[0].ctx().dev_id;
-    if (func_.find(dev_id) != func_.end()) {
-        func = func_[dev_id];
-    } else {
-        CUmodule module;
-        CHECK_EQ(err = cuModuleLoadDataEx(&module, ptx_, 0, 0, 0), CUDA_SUCCESS)
-            << "CudaError: " << err;
-        CHECK_EQ(err = cuModuleGetFunction(&func, module, name_.c_str()), CUDA_SUCCESS)
-            << "CudaError: " << err;
-        module_[dev_id] = module;
-        func_[dev_id] = func;
-    }
+    CUfunction func = get_function(output[0].ctx().dev_id);
     auto op = [this, func, input, output,
                grid_dim_X, grid_dim_Y, grid_dim_Z,
                block_dim_X, block_dim_Y, block_dim_Z](RunContext rctx) {
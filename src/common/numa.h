@@ -0,0 +1,136 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file numa.h
+ * \brief NUMA placement of CPU worker threads and host memory.
+ *  Only implemented on Linux, where the topology is read from sysfs.
+ */
+#ifndef MXNET_COMMON_NUMA_H_
+#define MXNET_COMMON_NUMA_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif  // defined(__linux__)
+
+namespace mxnet {
+namespace common {
+
+/*! \brief CPU topology per NUMA node of the host */
+class NUMATopology {
+ public:
+  /*! \return number of NUMA nodes, at least 1 */
+  inline int num_nodes() const {
+    return node_cpus_.size() == 0 ? 1 : static_cast<int>(node_cpus_.size());
+  }
+  /*! \return CPUs of a node, empty when the topology is unknown */
+  inline const std::vector<int>& cpus(int node) const {
+    static const std::vector<int> empty;
+    if (node < 0 || node >= static_cast<int>(node_cpus_.size())) return empty;
+    return node_cpus_[node];
+  }
+  /*! \return the topology singleton */
+  static const NUMATopology* Get() {
+    static NUMATopology inst;
+    return &inst;
+  }
+
+ private:
+  NUMATopology() {
+#if defined(__linux__)
+    for (int node = 0; ; ++node) {
+      std::ifstream is("/sys/devices/system/node/node" +
+                       std::to_string(node) + "/cpulist");
+      if (!is.is_open()) break;
+      std::string line;
+      std::getline(is, line);
+      node_cpus_.push_back(ParseCPUList(line));
+    }
+#endif  // defined(__linux__)
+  }
+  /*! \brief parse cpulist such as "0-5,12-17" */
+  static std::vector<int> ParseCPUList(const std::string& str) {
+    std::vector<int> ret;
+    std::istringstream is(str);
+    std::string range;
+    while (std::getline(is, range, ',')) {
+      if (range.size() == 0) continue;
+      size_t pos = range.find('-');
+      int begin = std::stoi(range.substr(0, pos));
+      int end = pos == std::string::npos ? begin : std::stoi(range.substr(pos + 1));
+      for (int i = begin; i <= end; ++i) ret.push_back(i);
+    }
+    return ret;
+  }
+  /*! \brief CPUs of each node */
+  std::vector<std::vector<int> > node_cpus_;
+};
+
+/*!
+ * \brief NUMA node of a CPU context.
+ *  Enabled by MXNET_CPU_NUMA_BIND, Context::CPU(dev_id) maps to
+ *  node dev_id % number of nodes.
+ * \param dev_id device id of the CPU context.
+ * \return the node, -1 when NUMA placement is disabled.
+ */
+inline int CPUContextNUMANode(int dev_id) {
+  static bool enabled = dmlc::GetEnv("MXNET_CPU_NUMA_BIND", false);
+  if (!enabled) return -1;
+  return dev_id % NUMATopology::Get()->num_nodes();
+}
+
+/*!
+ * \brief pin the calling thread to the CPUs of a NUMA node.
+ *  Threads created afterwards by the calling thread, e.g. OpenMP workers,
+ *  inherit the affinity.
+ * \param node the node, nothing is done when it is -1.
+ */
+inline void BindThreadToNUMANode(int node) {
+  if (node < 0) return;
+#if defined(__linux__)
+  const std::vector<int>& cpus = NUMATopology::Get()->cpus(node);
+  if (cpus.size() == 0) return;
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (int cpu : cpus) CPU_SET(cpu, &cpuset);
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+  if (ret != 0) {
+    LOG(WARNING) << "Failed to bind thread to NUMA node " << node;
+  }
+#endif  // defined(__linux__)
+}
+
+/*!
+ * \brief prefer a NUMA node for the pages of a memory region
+ *  that are not touched yet. Pages partially covered by the region are skipped.
+ * \param ptr start of the region.
+ * \param size size of the region.
+ * \param node the node, nothing is done when it is -1.
+ */
+inline void BindMemoryToNUMANode(void* ptr, size_t size, int node) {
+  if (node < 0) return;
+#if defined(__linux__) && defined(SYS_mbind)
+  // MPOL_PREFERRED in linux/mempolicy.h, falls back to other nodes when full.
+  const int kMPolPreferred = 1;
+  const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  uintptr_t begin = (reinterpret_cast<uintptr_t>(ptr) + page - 1) / page * page;
+  uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + size) / page * page;
+  if (end <= begin || node >= 64) return;
+  unsigned long nodemask = 1UL << node;  // NOLINT(*)
+  syscall(SYS_mbind, begin, end - begin, kMPolPreferred,
+          &nodemask, sizeof(nodemask) * 8, 0);
+#endif  // defined(__linux__) && defined(SYS_mbind)
+}
+
+}  // namespace common
+}  // namespace mxnet
+#endif  // MXNET_COMMON_NUMA_H_
@@ -0,0 +1,149 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file philox.h
+ * \brief counter based random numbers of ResourceRequest::kParallelRandom.
+ *
+ *  The numbers are given by the Philox4x32-10 function of (key, counter),
+ *  so that every element is generated independently, in parallel on cpu and
+ *  gpu. The key is the seed of the device and the counter is the offset of
+ *  the element in the sequence of its copy of the resource.
+ */
+#ifndef MXNET_COMMON_PHILOX_H_
+#define MXNET_COMMON_PHILOX_H_
+
+#include <dmlc/logging.h>
+#include <mshadow/tensor.h>
+#include <mxnet/base.h>
+#include <mxnet/resource.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+
+namespace mxnet {
+namespace common {
+namespace random {
+/*! \brief the number of values of one evaluation of the function */
+const uint32_t kPhiloxWidth = 4;
+
+/*!
+ * \brief out = Philox4x32-10(key, (counter, stream, 0))
+ */
+MSHADOW_XINLINE void Philox(uint32_t key0, uint32_t key1, uint64_t counter,
+                            uint32_t stream, uint32_t out[4]) {
+  uint32_t c0 = static_cast<uint32_t>(counter);
+  uint32_t c1 = static_cast<uint32_t>(counter >> 32);
+  uint32_t c2 = stream, c3 = 0;
+  for (int r = 0; r < 10; ++r) {
+    const uint64_t p0 = static_cast<uint64_t>(0xD2511F53U) * c0;
+    const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57U) * c2;
+    const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ key0;
+    const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ key1;
+    c1 = static_cast<uint32_t>(p1);
+    c3 = static_cast<uint32_t>(p0);
+    c0 = n0;
+    c2 = n2;
+    key0 += 0x9E3779B9U;
+    key1 += 0xBB67AE85U;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+/*! \brief uniform in (0, 1] from 24 random bits */
+MSHADOW_XINLINE float ToUniform(uint32_t x) {
+  return ((x >> 8) + 1.0f) * (1.0f / 16777216.0f);
+}
+
+/*!
+ * \brief fill the elements [4 * i, 4 * i + 4) of dst
+ * \param gaussian whether to sample N(a, b) instead of U(a, b)
+ */
+MSHADOW_XINLINE void SampleBlock(float *dst, size_t size, size_t i,
+                                 const ParallelRandomState &state, bool gaussian,
+                                 float a, float b) {
+  uint32_t bits[4];
+  Philox(state.key[0], state.key[1], state.counter + i, state.stream, bits);
+  float val[4];
+  if (gaussian) {
+    // Box-Muller of two pairs of uniforms
+    for (int k = 0; k < 4; k += 2) {
+      const float radius = sqrtf(-2.0f * logf(ToUniform(bits[k])));
+      const float theta = 6.2831853071795864f * ToUniform(bits[k + 1]);
+      val[k] = a + b * radius * cosf(theta);
+      val[k + 1] = a + b * radius * sinf(theta);
+    }
+  } else {
+    for (int k = 0; k < 4; ++k) val[k] = a + (b - a) * (1.0f - ToUniform(bits[k]));
+  }
+  const size_t begin = i * kPhiloxWidth;
+  for (size_t k = 0; k < kPhiloxWidth && begin + k < size; ++k) dst[begin + k] = val[k];
+}
+
+inline void Sample(mshadow::Stream<mshadow::cpu> *s, float *dst, size_t size,
+                   const ParallelRandomState &state, bool gaussian, float a, float b) {
+  const int nblock = static_cast<int>((size + kPhiloxWidth - 1) / kPhiloxWidth);
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < nblock; ++i) {
+    SampleBlock(dst, size, i, state, gaussian, a, b);
+  }
+}
+
+#ifdef __CUDACC__
+template<int kGaussian>
+__global__ void SampleKernel(float *dst, size_t size, size_t nblock,
+                             ParallelRandomState state, float a, float b) {
+  for (size_t i = blockIdx.x * blockDim.x + threadIdx.x; i < nblock;
+       i += blockDim.x * gridDim.x) {
+    SampleBlock(dst, size, i, state, kGaussian != 0, a, b);
+  }
+}
+
+inline void Sample(mshadow::Stream<mshadow::gpu> *s, float *dst, size_t size,
+                   const ParallelRandomState &state, bool gaussian, float a, float b) {
+  using namespace mshadow::cuda;
+  const size_t nblock = (size + kPhiloxWidth - 1) / kPhiloxWidth;
+  if (nblock == 0) return;
+  const int grid = static_cast<int>(std::min<size_t>(
+      kMaxGridNum, (nblock + kBaseThreadNum - 1) / kBaseThreadNum));
+  cudaStream_t stream = mshadow::Stream<mshadow::gpu>::GetStream(s);
+  if (gaussian) {
+    SampleKernel<1><<<grid, kBaseThreadNum, 0, stream>>>(dst, size, nblock, state, a, b);
+  } else {
+    SampleKernel<0><<<grid, kBaseThreadNum, 0, stream>>>(dst, size, nblock, state, a, b);
+  }
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+
+/*!
+ * \brief fill dst with U(low, high), and advance the counter of the resource
+ * \param state the state given by Resource::get_parallel_random
+ */
+template<typename xpu, int dim>
+inline void SampleUniform(ParallelRandomState *state, mshadow::Tensor<xpu, dim, float> *dst,
+                          float low, float high) {
+  CHECK(dst->CheckContiguous()) << "random numbers are only sampled into contiguous tensors";
+  const size_t size = dst->shape_.Size();
+  Sample(dst->stream_, dst->dptr_, size, *state, false, low, high);
+  state->counter += (size + kPhiloxWidth - 1) / kPhiloxWidth;
+}
+
+/*!
+ * \brief fill dst with N(mu, sigma), and advance the counter of the resource
+ * \param state the state given by Resource::get_parallel_random
+ */
+template<typename xpu, int dim>
+inline void SampleGaussian(ParallelRandomState *state, mshadow::Tensor<xpu, dim, float> *dst,
+                           float mu, float sigma) {
+  CHECK(dst->CheckContiguous()) << "random numbers are only sampled into contiguous tensors";
+  const size_t size = dst->shape_.Size();
+  Sample(dst->stream_, dst->dptr_, size, *state, true, mu, sigma);
+  state->counter += (size + kPhiloxWidth - 1) / kPhiloxWidth;
+}
+}  // namespace random
+}  // namespace common
+}  // namespace mxnet
+#endif  // MXNET_COMMON_PHILOX_H_
@@ -0,0 +1,94 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file thread_budget.h
+ * \brief the CPU threads shared by the engine workers, the OpenMP teams of the
+ *  operators and the decoding threads of the data iterators.
+ */
+#ifndef MXNET_COMMON_THREAD_BUDGET_H_
+#define MXNET_COMMON_THREAD_BUDGET_H_
+
+#include <dmlc/omp.h>
+#include <dmlc/parameter.h>
+#include <algorithm>
+#include <atomic>
+
+namespace mxnet {
+namespace common {
+
+/*!
+ * \brief Budget of CPU threads, MXNET_CPU_THREAD_BUDGET, by default the cores.
+ *
+ *  Long running work, such as the decoding of a data iterator, reserves its threads
+ *  for its lifetime. The operations running on the CPU at the same time share the
+ *  rest: an operation sets the size of the OpenMP teams of its thread to its share
+ *  when it starts, so that one operation alone takes all of them and eight concurrent
+ *  ones take an eighth each. A budget of 0 leaves the OpenMP teams alone.
+ */
+class CPUThreadBudget {
+ public:
+  /*! \return the number of threads, 0 when disabled */
+  inline int total() const {
+    return total_;
+  }
+  /*!
+   * \brief reserve up to n threads, leaving at least one to the operations
+   * \return the threads granted, at least 1, to be given back by Unreserve
+   */
+  inline int Reserve(int n) {
+    if (total_ == 0) return n;
+    int reserved = reserved_.load();
+    int granted;
+    do {
+      granted = std::max(1, std::min(n, total_ - 1 - reserved));
+    } while (!reserved_.compare_exchange_weak(reserved, reserved + granted));
+    return granted;
+  }
+  /*! \brief give back threads of Reserve */
+  inline void Unreserve(int n) {
+    if (total_ == 0) return;
+    reserved_.fetch_sub(n);
+  }
+  /*! \brief an operation starts on the calling thread, set its OpenMP teams to its share */
+  inline void Enter() {
+    if (total_ == 0) return;
+    const int running = running_.fetch_add(1) + 1;
+    const int avail = std::max(1, total_ - std::max(reserved_.load(), 0));
+    omp_set_num_threads(std::max(1, avail / running));
+  }
+  /*! \brief the operation started by Enter completed */
+  inline void Leave() {
+    if (total_ == 0) return;
+    running_.fetch_sub(1);
+  }
+  /*! \brief an operation for the lifetime of the scope */
+  class Scope {
+   public:
+    Scope() {
+      CPUThreadBudget::Get()->Enter();
+    }
+    ~Scope() {
+      CPUThreadBudget::Get()->Leave();
+    }
+  };
+  /*! \return the budget singleton */
+  static CPUThreadBudget* Get() {
+    static CPUThreadBudget inst;
+    return &inst;
+  }
+
+ private:
+  CPUThreadBudget() {
+    const int cores = std::max(omp_get_num_procs(), 1);
+    total_ = std::max(dmlc::GetEnv("MXNET_CPU_THREAD_BUDGET", cores), 0);
+  }
+  /*! \brief number of threads */
+  int total_;
+  /*! \brief threads reserved by long running work */
+  std::atomic<int> reserved_{0};
+  /*! \brief operations running */
+  std::atomic<int> running_{0};
+};
+
+}  // namespace common
+}  // namespace mxnet
+#endif  // MXNET_COMMON_THREAD_BUDGET_H_
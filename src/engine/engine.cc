@@ -13,10 +13,17 @@ namespace engine {
 inline Engine* CreateEngine() {
   const char *type = getenv("MXNET_ENGINE_TYPE");
   const bool default_engine = (type == nullptr);
+  #if MXNET_PREDICT_ONLY == 0
   if (type == nullptr) type = "ThreadedEnginePerDevice";
+  #else
+  if (type == nullptr) type = "InlineEngine";
+  #endif
   std::string stype = type;
 
   Engine *ret = nullptr;
+  if (stype == "InlineEngine") {
+    ret = CreateInlineEngine();
+  }
   #if MXNET_PREDICT_ONLY == 0
   if (stype == "NaiveEngine") {
     ret = CreateNaiveEngine();
@@ -24,9 +31,9 @@ inline Engine* CreateEngine() {
     ret = CreateThreadedEnginePooled();
   } else if (stype == "ThreadedEnginePerDevice") {
     ret = CreateThreadedEnginePerDevice();
+  } else if (stype == "ThreadedEngineWorkStealing") {
+    ret = CreateThreadedEngineWorkStealing();
   }
-  #else
-  ret = CreateNaiveEngine();
   #endif
 
   if (ret ==nullptr) {
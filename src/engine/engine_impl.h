@@ -42,6 +42,17 @@ struct Opr {
   inline T* Cast();
 };  // struct Opr
 
+/*! \brief base class of engine graphs, used for type checking */
+struct Graph {
+  /*!
+   * \brief cast graph to derived type T
+   * \tparam T the type we want to cast into.
+   * \return A casted graph.
+   */
+  template <typename T>
+  inline T* Cast();
+};  // struct Graph
+
 // implementation of the inline functions
 template <typename T>
 inline T* Var::Cast() {
@@ -65,17 +76,28 @@ inline T* Opr::Cast() {
 #endif
 }
 
+template <typename T>
+inline T* Graph::Cast() {
+  static_assert(std::is_base_of<Graph, T>::value,
+                "must inherit `mxnet::engine::Graph`");
+  return static_cast<T*>(this);
+}
+
 /*! \brief Maximum number of GPUs */
 static constexpr std::size_t kMaxNumGPUs = 16;
 
 // predeclare factory function for each type of engine
+/*! \return InlineEngine instance */
+Engine *CreateInlineEngine();
+#if MXNET_PREDICT_ONLY == 0
 /*! \return NaiveEngine instance */
 Engine *CreateNaiveEngine();
-#if MXNET_PREDICT_ONLY == 0
 /*! \return ThreadedEnginePooled instance */
 Engine *CreateThreadedEnginePooled();
 /*! \return ThreadedEnginePerDevie instance */
 Engine *CreateThreadedEnginePerDevice();
+/*! \return ThreadedEnginePerDevice instance with work stealing CPU workers */
+Engine *CreateThreadedEngineWorkStealing();
 #endif
 }  // namespace engine
 }  // namespace mxnet
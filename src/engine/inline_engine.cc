@@ -0,0 +1,128 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file inline_engine.cc
+ * \brief Implementation of InlineEngine, which runs each operation on the
+ *  calling thread as soon as it is pushed. It keeps no dependency state and
+ *  is the default engine of the predict-only builds.
+ */
+#include <atomic>
+#include <vector>
+#include "./engine_impl.h"
+
+namespace mxnet {
+namespace engine {
+
+class InlineEngine final : public Engine {
+ public:
+  struct InlineOpr : public Opr {
+    AsyncFn fn;
+  };
+
+  InlineEngine() {
+  }
+  ~InlineEngine() {
+#if MXNET_USE_CUDA
+    for (size_t i = 0; i < streams_.size(); ++i) {
+      if (streams_[i] != nullptr) {
+        // Catch exception for CUDA driver shutdown
+        MSHADOW_CATCH_ERROR(mshadow::DeleteStream(streams_[i]));
+        streams_[i] = nullptr;
+      }
+    }
+#endif
+  }
+  // the variables only tell the arrays apart, nothing waits for them
+  VarHandle NewVariable() override {
+    size_t v = ++counter_;
+    return reinterpret_cast<VarHandle>(v);
+  }
+  OprHandle NewOperator(AsyncFn fn,
+                        std::vector<VarHandle> const& const_vars,
+                        std::vector<VarHandle> const& mutable_vars,
+                        FnProperty prop,
+                        const char* opr_name) override {
+    InlineOpr *opr = new InlineOpr();
+    opr->fn = fn;
+    return opr;
+  }
+  void DeleteOperator(OprHandle op) override {
+    delete op->Cast<InlineOpr>();
+  }
+  void Push(OprHandle op, Context exec_ctx, int priority) override {
+    this->RunAsync(op->Cast<InlineOpr>()->fn, exec_ctx);
+  }
+  void PushAsync(AsyncFn exec_fun,
+                 Context exec_ctx,
+                 std::vector<VarHandle> const& const_vars,
+                 std::vector<VarHandle> const& mutable_vars,
+                 FnProperty prop,
+                 int priority = 0,
+                 const char* opr_name = nullptr) override {
+    this->RunAsync(exec_fun, exec_ctx);
+  }
+  // run directly, without wrapping it into an asynchronous function
+  void PushSync(SyncFn exec_fn, Context exec_ctx,
+                std::vector<VarHandle> const& const_vars,
+                std::vector<VarHandle> const& mutable_vars,
+                FnProperty prop = FnProperty::kNormal,
+                int priority = 0,
+                const char* opr_name = nullptr) override {
+    exec_fn(this->GetRunContext(exec_ctx));
+  }
+  void DeleteVariable(SyncFn delete_fn, Context exec_ctx, VarHandle var) override {
+    delete_fn(this->GetRunContext(exec_ctx));
+  }
+  void WaitForVar(VarHandle var) override {
+  }
+  void WaitForAll() override {
+  }
+  void NotifyShutdown() override {
+  }
+  bool SupportAsyncComplete() const override {
+    return false;
+  }
+
+ private:
+  // callback to oncomplete
+  static void OnComplete(Engine *engine, void *param) {
+    *static_cast<bool*>(param) = true;
+  }
+  inline void RunAsync(const AsyncFn &fn, Context exec_ctx) {
+    bool completed = false;
+    fn(this->GetRunContext(exec_ctx), CreateCallback(InlineEngine::OnComplete, &completed));
+    CHECK(completed) << "InlineEngine only support synchronize Push so far";
+  }
+  inline RunContext GetRunContext(Context exec_ctx) {
+    RunContext ctx;
+    if (exec_ctx.dev_mask() == gpu::kDevMask) {
+#if MXNET_USE_CUDA
+      size_t dev_id = static_cast<size_t>(exec_ctx.dev_id);
+      MSHADOW_CATCH_ERROR(mshadow::SetDevice<gpu>(exec_ctx.dev_id));
+      if (streams_.size() <= dev_id) {
+        streams_.resize(dev_id + 1, nullptr);
+      }
+      if (streams_[dev_id] == nullptr) {
+        streams_[dev_id] = mshadow::NewStream<gpu>(true, MXNET_USE_CUDNN != 0);
+      }
+      ctx.stream = streams_[dev_id];
+#else
+      LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+#endif
+    } else {
+      ctx.stream = &cpu_stream_;
+    }
+    return ctx;
+  }
+  // counter
+  std::atomic<size_t> counter_{0};
+  // CPU stream
+  mshadow::Stream<cpu> cpu_stream_;
+  // GPU streams
+  std::vector<mshadow::Stream<gpu>*> streams_;
+};  // class InlineEngine
+
+Engine *CreateInlineEngine() {
+  return new InlineEngine();
+}
+}  // namespace engine
+}  // namespace mxnet
@@ -3,9 +3,11 @@
  * \file naive_engine.cc
  * \brief Implementation of NaiveEngine
  */
+#include <cstring>
 #include <vector>
 #include <atomic>
 #include "./engine_impl.h"
+#include "./profiler.h"
 
 namespace mxnet {
 namespace engine {
@@ -18,6 +20,7 @@ class NaiveEngine final : public Engine {
     std::vector<VarHandle> const_vars;
     std::vector<VarHandle> mutable_vars;
     FnProperty prop;
+    const char* opr_name;
   };
 
   NaiveEngine() {
@@ -44,12 +47,14 @@ class NaiveEngine final : public Engine {
   OprHandle NewOperator(AsyncFn fn,
                         std::vector<VarHandle> const& const_vars,
                         std::vector<VarHandle> const& mutable_vars,
-                        FnProperty prop) override {
+                        FnProperty prop,
+                        const char* opr_name) override {
     NaiveOpr *opr = new NaiveOpr();
     opr->fn = fn;
     opr->const_vars = const_vars;
     opr->mutable_vars = mutable_vars;
     opr->prop = prop;
+    opr->opr_name = opr_name;
     return opr;
   }
   void DeleteOperator(OprHandle op) override {
@@ -62,17 +67,36 @@ class NaiveEngine final : public Engine {
                     exec_ctx,
                     opr->const_vars,
                     opr->mutable_vars,
-                    opr->prop);
+                    opr->prop,
+                    priority,
+                    opr->opr_name);
   }
+  bool SupportAsyncComplete() const override {
+    return false;
+  }
+
   void PushAsync(AsyncFn exec_fun,
                  Context exec_ctx,
                  std::vector<VarHandle> const& const_vars,
                  std::vector<VarHandle> const& mutable_vars,
                  FnProperty prop,
-                 int priority = 0) override {
+                 int priority = 0,
+                 const char* opr_name = nullptr) override {
     CallbackOnComplete callback = CreateCallback(
         NaiveEngine::OnComplete, nullptr);
     this->req_completed_ = false;
+    Profiler* profiler = Profiler::Get();
+    OprExecStat* opr_stat = nullptr;
+    if (profiler->IsProfiling(opr_name)) {
+      opr_stat = profiler->AddOprStat(exec_ctx.dev_type, exec_ctx.dev_id);
+      if (opr_name != nullptr) {
+        strncpy(opr_stat->opr_name, opr_name, sizeof(opr_stat->opr_name) - 1);
+        opr_stat->opr_name[sizeof(opr_stat->opr_name) - 1] = '\0';
+      }
+      opr_stat->thread_id = Profiler::GetThreadId();
+      opr_stat->opr_start_rel_micros = Profiler::GetTimeInMicros();
+      opr_stat->opr_ready_rel_micros = opr_stat->opr_start_rel_micros;
+    }
 
     if (exec_ctx.dev_mask() == gpu::kDevMask) {
 #if MXNET_USE_CUDA
@@ -95,6 +119,9 @@ class NaiveEngine final : public Engine {
     }
     CHECK(this->req_completed_)
         << "NaiveEngine only support synchronize Push so far";
+    if (opr_stat != nullptr) {
+      opr_stat->opr_end_rel_micros = Profiler::GetTimeInMicros();
+    }
   }
   void DeleteVariable(SyncFn delete_fn, Context exec_ctx, VarHandle var) override {
     this->PushSync(delete_fn, exec_ctx, {}, {var}, FnProperty::kNormal);
@@ -0,0 +1,126 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file profiler.cc
+ * \brief implements profiler of engine operations.
+ */
+#include <dmlc/base.h>
+#include <dmlc/logging.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include "./profiler.h"
+#include "../common/thread_local.h"
+
+namespace mxnet {
+namespace engine {
+
+namespace {
+/*! \brief number of device slots of the profiler */
+constexpr size_t kNumDevSlots = (Context::kMaxDevType + 1) * Context::kMaxDevID;
+/*! \return name of a device for display */
+inline std::string DevName(size_t index) {
+  int dev_type = static_cast<int>(index / Context::kMaxDevID);
+  int dev_id = static_cast<int>(index % Context::kMaxDevID);
+  std::string type;
+  switch (dev_type) {
+    case Context::kCPU: type = "cpu"; break;
+    case Context::kGPU: type = "gpu"; break;
+    case Context::kCPUPinned: type = "cpu_pinned"; break;
+    default: type = "unknown";
+  }
+  return type + "/" + std::to_string(dev_id);
+}
+}  // namespace
+
+Profiler::Profiler() : dev_stats_(new DevStat[kNumDevSlots]) {
+  for (size_t i = 0; i < kNumDevSlots; ++i) {
+    dev_stats_[i].dev_name = DevName(i);
+  }
+}
+
+Profiler* Profiler::Get() {
+  static Profiler inst;
+  return &inst;
+}
+
+uint32_t Profiler::GetThreadId() {
+  static std::atomic<uint32_t> counter{0};
+  static MX_TREAD_LOCAL uint32_t tid = 0;
+  if (tid == 0) tid = ++counter;
+  return tid;
+}
+
+void Profiler::SetState(ProfilerState state) {
+  std::lock_guard<std::mutex> lock(m_);
+  if (state == kRunning && init_time_ == 0) {
+    init_time_ = GetTimeInMicros();
+  }
+  state_.store(state);
+}
+
+void Profiler::SetConfig(ProfilerMode mode, std::string output_filename) {
+  std::lock_guard<std::mutex> lock(m_);
+  mode_ = mode;
+  filename_ = output_filename;
+}
+
+OprExecStat* Profiler::AddOprStat(int dev_type, uint32_t dev_id) {
+  CHECK_LT(dev_id, static_cast<uint32_t>(Context::kMaxDevID));
+  OprExecStat* stat = new OprExecStat();
+  stat->dev_type = dev_type;
+  stat->dev_id = dev_id;
+  stat->opr_name[0] = '\0';
+  stat->opr_end_rel_micros = 0;
+  DevStat& dev = dev_stats_[DevIndex(dev_type, dev_id)];
+  std::lock_guard<std::mutex> lock(dev.m_);
+  dev.opr_exec_stats.push_back(stat);
+  return stat;
+}
+
+void Profiler::DumpProfile() {
+  std::lock_guard<std::mutex> lock(m_);
+  std::ofstream file(filename_);
+  CHECK(file.is_open()) << "Cannot open profile output " << filename_;
+  file << "{\n    \"traceEvents\": [\n";
+  bool first = true;
+  auto sep = [&file, &first]() {
+    if (!first) file << ",\n";
+    first = false;
+  };
+  for (size_t i = 0; i < kNumDevSlots; ++i) {
+    DevStat& dev = dev_stats_[i];
+    std::lock_guard<std::mutex> dev_lock(dev.m_);
+    if (dev.opr_exec_stats.size() == 0) continue;
+    // each device is shown as a process
+    sep();
+    file << "        {\"ph\": \"M\", \"name\": \"process_name\", \"pid\": " << i
+         << ", \"args\": {\"name\": \"" << dev.dev_name << "\"}}";
+    std::vector<OprExecStat*> unfinished;
+    for (OprExecStat* stat : dev.opr_exec_stats) {
+      // keep records that did not finish for the next dump
+      if (stat->opr_end_rel_micros == 0) {
+        unfinished.push_back(stat);
+        continue;
+      }
+      const char* name = stat->opr_name[0] != '\0' ? stat->opr_name : "unnamed";
+      uint64_t start = stat->opr_start_rel_micros - std::min(stat->opr_start_rel_micros, init_time_);
+      uint64_t end = stat->opr_end_rel_micros - std::min(stat->opr_end_rel_micros, init_time_);
+      uint64_t wait = stat->opr_start_rel_micros -
+          std::min(stat->opr_start_rel_micros, stat->opr_ready_rel_micros);
+      sep();
+      file << "        {\"name\": \"" << name << "\", \"cat\": \"operator\", \"ph\": \"B\""
+           << ", \"ts\": " << start << ", \"pid\": " << i << ", \"tid\": " << stat->thread_id
+           << ", \"args\": {\"queue_wait_us\": " << wait << "}}";
+      sep();
+      file << "        {\"name\": \"" << name << "\", \"cat\": \"operator\", \"ph\": \"E\""
+           << ", \"ts\": " << end << ", \"pid\": " << i << ", \"tid\": " << stat->thread_id
+           << "}";
+      delete stat;
+    }
+    dev.opr_exec_stats.swap(unfinished);
+  }
+  file << "\n    ],\n    \"displayTimeUnit\": \"ms\"\n}\n";
+}
+
+}  // namespace engine
+}  // namespace mxnet
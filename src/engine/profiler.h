@@ -0,0 +1,133 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file profiler.h
+ * \brief implements profiler of engine operations,
+ *  the records can be dumped in chrome://tracing format.
+ */
+#ifndef MXNET_ENGINE_PROFILER_H_
+#define MXNET_ENGINE_PROFILER_H_
+
+#include <mxnet/base.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mxnet {
+namespace engine {
+
+/*! \brief execution record of one operation */
+struct OprExecStat {
+  /*! \brief operation name */
+  char opr_name[32];
+  /*! \brief time when the operation became ready to run, in micro seconds */
+  uint64_t opr_ready_rel_micros;
+  /*! \brief start time of the operation, in micro seconds */
+  uint64_t opr_start_rel_micros;
+  /*! \brief end time of the operation, in micro seconds */
+  uint64_t opr_end_rel_micros;
+  /*! \brief id of the thread that executed the operation */
+  uint32_t thread_id;
+  /*! \brief device type the operation ran on */
+  uint32_t dev_type;
+  /*! \brief device id the operation ran on */
+  uint32_t dev_id;
+};
+
+/*! \brief records of all operations on one device */
+struct DevStat {
+  /*! \brief device name */
+  std::string dev_name;
+  /*! \brief operation execution records */
+  std::vector<OprExecStat*> opr_exec_stats;
+  /*! \brief internal mutex of the records */
+  std::mutex m_;
+};
+
+/*!
+ * \brief profiler that records the execution of engine operations.
+ *  Only an atomic load is paid per operation when it is not running.
+ */
+class Profiler {
+ public:
+  /*! \brief which operations to record */
+  enum ProfilerMode {
+    /*! \brief only operations with a name, e.g. symbolic executor nodes */
+    kOnlySymbolic = 0,
+    /*! \brief all operations */
+    kAllOperator = 1
+  };
+  /*! \brief state of the profiler */
+  enum ProfilerState {
+    kNotRunning = 0,
+    kRunning = 1
+  };
+  /*! \brief set state of profiler */
+  void SetState(ProfilerState state);
+  /*! \return state of profiler */
+  inline ProfilerState GetState() const {
+    return static_cast<ProfilerState>(state_.load(std::memory_order_relaxed));
+  }
+  /*!
+   * \brief set configuration of profiler
+   * \param mode mode of profiler.
+   * \param output_filename file the profile is dumped into.
+   */
+  void SetConfig(ProfilerMode mode, std::string output_filename);
+  /*!
+   * \brief whether an operation should be recorded now.
+   * \param opr_name name of the operation, can be nullptr.
+   */
+  inline bool IsProfiling(const char* opr_name) const {
+    return GetState() == kRunning &&
+        (mode_ == kAllOperator || opr_name != nullptr);
+  }
+  /*!
+   * \brief create a new record of an operation
+   * \param dev_type device type of the operation.
+   * \param dev_id device id of the operation.
+   * \return the record, owned by the profiler.
+   */
+  OprExecStat* AddOprStat(int dev_type, uint32_t dev_id);
+  /*!
+   * \brief dump finished records into the output file as chrome trace json,
+   *  the dumped records are released. Usually called after WaitForAll.
+   */
+  void DumpProfile();
+  /*! \return current time in micro seconds */
+  inline static uint64_t GetTimeInMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+  }
+  /*! \return id of current thread, small integers given in the order of first use */
+  static uint32_t GetThreadId();
+  /*! \return the profiler singleton */
+  static Profiler* Get();
+
+ private:
+  /*! \brief constructor */
+  Profiler();
+  /*! \return index of device in dev_stats_ */
+  inline static size_t DevIndex(int dev_type, uint32_t dev_id) {
+    return static_cast<size_t>(dev_type) * Context::kMaxDevID + dev_id;
+  }
+  /*! \brief state of profiler */
+  std::atomic<int> state_{kNotRunning};
+  /*! \brief mode of profiler */
+  ProfilerMode mode_{kOnlySymbolic};
+  /*! \brief output file */
+  std::string filename_{"profile.json"};
+  /*! \brief records of each device */
+  std::unique_ptr<DevStat[]> dev_stats_;
+  /*! \brief time when profiler is first started */
+  uint64_t init_time_{0};
+  /*! \brief internal mutex of profiler */
+  std::mutex m_;
+};
+
+}  // namespace engine
+}  // namespace mxnet
+#endif  // MXNET_ENGINE_PROFILER_H_
@@ -0,0 +1,101 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file stream_event_pool.h
+ * \brief events recorded after the kernels of stream ordered gpu operations.
+ */
+#ifndef MXNET_ENGINE_STREAM_EVENT_POOL_H_
+#define MXNET_ENGINE_STREAM_EVENT_POOL_H_
+
+#include <mxnet/base.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "../common/cuda_utils.h"
+#include "../common/thread_local.h"
+
+namespace mxnet {
+namespace engine {
+/*!
+ * \brief An event recorded on the stream of a gpu operation after its kernels.
+ *  It is shared by the variables the operation used.
+ */
+struct StreamEvent {
+#if MXNET_USE_CUDA
+  /*! \brief the event */
+  cudaEvent_t event;
+  /*! \brief the stream it is recorded on */
+  cudaStream_t stream;
+#endif
+  /*! \brief the device of the stream */
+  int dev_id;
+};
+/*! \brief shared pointer to an event, the event goes back to its pool with the last one */
+typedef std::shared_ptr<StreamEvent> StreamEventPtr;
+
+/*!
+ * \brief The stream ordered state of the operation the calling thread
+ *  executes, set by the engine for the gpu memory pool.
+ */
+struct StreamUse {
+#if MXNET_USE_CUDA
+  /*! \brief stream of the operation, nullptr for a host function */
+  cudaStream_t stream{nullptr};
+#endif
+  /*! \brief last uses of the variables it deletes, the memory it frees is reused after them */
+  std::vector<StreamEventPtr> free_after;
+  /*! \brief whether the memory pool took free_after */
+  bool freed{false};
+};
+/*! \brief thread local store of stream use */
+typedef common::ThreadLocalStore<StreamUse> StreamUseStore;
+
+#if MXNET_USE_CUDA
+/*! \brief pool of the events of each device, so that an event is created once */
+class StreamEventPool : public std::enable_shared_from_this<StreamEventPool> {
+ public:
+  ~StreamEventPool() {
+    // no CUDA_CALL, the driver may be shutting down
+    for (auto& kv : free_) {
+      for (cudaEvent_t event : kv.second) cudaEventDestroy(event);
+    }
+  }
+  /*!
+   * \brief record an event on a stream of the current device.
+   * \param dev_id the current device.
+   * \param stream the stream.
+   */
+  StreamEventPtr Record(int dev_id, cudaStream_t stream) {
+    cudaEvent_t event;
+    bool found = false;
+    {
+      std::lock_guard<std::mutex> lock{m_};
+      std::vector<cudaEvent_t>& free = free_[dev_id];
+      if (!free.empty()) {
+        event = free.back();
+        free.pop_back();
+        found = true;
+      }
+    }
+    if (!found) CUDA_CALL(cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+    CUDA_CALL(cudaEventRecord(event, stream));
+    std::shared_ptr<StreamEventPool> self = shared_from_this();
+    return StreamEventPtr(new StreamEvent{event, stream, dev_id}, [self](StreamEvent* e) {
+        {
+          std::lock_guard<std::mutex> lock{self->m_};
+          self->free_[e->dev_id].push_back(e->event);
+        }
+        delete e;
+      });
+  }
+
+ private:
+  /*! \brief mutex of free_ */
+  std::mutex m_;
+  /*! \brief events not referred to, by device */
+  std::map<int, std::vector<cudaEvent_t> > free_;
+};
+#endif  // MXNET_USE_CUDA
+}  // namespace engine
+}  // namespace mxnet
+#endif  // MXNET_ENGINE_STREAM_EVENT_POOL_H_
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <condition_variable>
 #include <mutex>
+#include <unordered_map>
 #include <utility>
 #include "./threaded_engine.h"
 #include "../common/cuda_utils.h"
@@ -177,6 +178,31 @@ inline bool ThreadedVar::ready_to_read() {
   return this->is_ready_to_read();
 }
 
+inline void ThreadedVar::AddEvent(const StreamEventPtr& event, bool write) {
+  std::lock_guard<std::mutex> lock{m_};
+  if (write) {
+    write_event_ = event;
+    read_events_.clear();
+    return;
+  }
+#if MXNET_USE_CUDA
+  // a later event on the same stream is after the earlier one
+  for (StreamEventPtr& e : read_events_) {
+    if (e->stream == event->stream) {
+      e = event;
+      return;
+    }
+  }
+#endif
+  read_events_.push_back(event);
+}
+
+inline void ThreadedVar::GetEvents(bool write, std::vector<StreamEventPtr>* events) {
+  std::lock_guard<std::mutex> lock{m_};
+  if (write_event_ != nullptr) events->push_back(write_event_);
+  if (write) events->insert(events->end(), read_events_.begin(), read_events_.end());
+}
+
 // implementation of threaded engine
 ThreadedVar* ThreadedEngine::NewVariable() {
   return ThreadedVar::New(VersionedVarBlock::New());
@@ -186,10 +212,12 @@ ThreadedOpr* ThreadedEngine::NewOperator(
     ThreadedEngine::AsyncFn fn,
     std::vector<VarHandle> const& const_vars,
     std::vector<VarHandle> const& mutable_vars,
-    FnProperty prop) {
+    FnProperty prop,
+    const char* opr_name) {
   auto ret = ThreadedOpr::New();
   ret->fn = fn;
   ret->prop = prop;
+  ret->opr_name = opr_name;
   ret->const_vars.resize(const_vars.size());
   ret->mutable_vars.resize(mutable_vars.size());
   std::transform(const_vars.begin(), const_vars.end(),
@@ -247,12 +275,19 @@ void ThreadedEngine::DeleteOperator(OprHandle op) {
   deps.insert(deps.end(),
               threaded_opr->mutable_vars.begin(),
               threaded_opr->mutable_vars.end());
-  this->PushSync([threaded_opr](RunContext) {
+  this->PushSyncNow([threaded_opr](RunContext) {
       ThreadedOpr::Delete(threaded_opr);
-    }, Context::CPU(), {}, deps, FnProperty::kAsync);
+    }, Context::CPU(), {}, deps, FnProperty::kAsync, nullptr);
 }
 
 void ThreadedEngine::Push(OprHandle op, Context exec_ctx, int priority) {
+  if (Capture(ThreadedOpr::CastFromBase(op), exec_ctx, priority, false)) return;
+  PushNow(op, exec_ctx, priority);
+}
+
+void ThreadedEngine::PushNow(OprHandle op, Context exec_ctx, int priority) {
+  // keep the push order of the calling thread
+  BulkFlush();
   ThreadedOpr* threaded_opr = ThreadedOpr::CastFromBase(op);
   OprBlock* opr_block = OprBlock::New();
   opr_block->opr = threaded_opr;
@@ -262,7 +297,9 @@ void ThreadedEngine::Push(OprHandle op, Context exec_ctx, int priority) {
       threaded_opr->mutable_vars.size() + 1));
   opr_block->ctx = exec_ctx;
   opr_block->priority = priority;
+  opr_block->profiling = Profiler::Get()->IsProfiling(threaded_opr->opr_name);
   ++pending_;
+  counters_.pushed.fetch_add(1, std::memory_order_relaxed);
   // Add read dependencies.
   for (auto&& i : threaded_opr->const_vars) {
     i->AppendReadDependency(opr_block);
@@ -271,73 +308,297 @@ void ThreadedEngine::Push(OprHandle op, Context exec_ctx, int priority) {
   for (auto&& i : threaded_opr->mutable_vars) {
     i->AppendWriteDependency(opr_block);
   }
-  if (opr_block->decr_wait() == 0) {
-    this->PushToExecute(opr_block, true);
+  // the block may be executed by another thread once its count drops
+  int num_waits = opr_block->decr_wait();
+  if (num_waits == 0) {
+    this->PushReady(opr_block, true);
+  } else {
+    counters_.dep_blocked.fetch_add(1, std::memory_order_relaxed);
+    counters_.dep_waits.fetch_add(num_waits, std::memory_order_relaxed);
   }
 }
 
 void ThreadedEngine::PushAsync(AsyncFn fn, Context exec_ctx,
                                std::vector<VarHandle> const& const_vars,
                                std::vector<VarHandle> const& mutable_vars,
-                               FnProperty prop, int priority) {
-  ThreadedOpr *opr = NewOperator(fn, const_vars, mutable_vars, prop);
+                               FnProperty prop, int priority,
+                               const char* opr_name) {
+  ThreadedOpr *opr = NewOperator(fn, const_vars, mutable_vars, prop, opr_name);
+  if (Capture(opr, exec_ctx, priority, true)) return;
   opr->temporary = true;
-  Push(opr, exec_ctx, priority);
+  PushNow(opr, exec_ctx, priority);
+}
+
+void ThreadedEngine::PushSyncNow(SyncFn exec_fn, Context exec_ctx,
+                                 std::vector<VarHandle> const& const_vars,
+                                 std::vector<VarHandle> const& mutable_vars,
+                                 FnProperty prop, const char* opr_name) {
+  ThreadedOpr *opr = NewOperator([exec_fn](RunContext ctx, CallbackOnComplete on_complete) {
+      exec_fn(ctx);
+      on_complete();
+    }, const_vars, mutable_vars, prop, opr_name);
+  opr->temporary = true;
+  PushNow(opr, exec_ctx, 0);
+}
+
+void ThreadedEngine::PushSync(SyncFn exec_fn, Context exec_ctx,
+                              std::vector<VarHandle> const& const_vars,
+                              std::vector<VarHandle> const& mutable_vars,
+                              FnProperty prop, int priority,
+                              const char* opr_name) {
+  BulkStatus& bulk = *BulkStatusStore::Get();
+  if (bulk.bulk_size == 0 || prop != FnProperty::kNormal || priority != 0 ||
+      CaptureStatusStore::Get()->capturing) {
+    Engine::PushSync(exec_fn, exec_ctx, const_vars, mutable_vars,
+                     prop, priority, opr_name);
+    return;
+  }
+  if (bulk.fns.size() != 0 && bulk.ctx != exec_ctx) {
+    BulkFlush();
+  }
+  bulk.ctx = exec_ctx;
+  bulk.fns.push_back(exec_fn);
+  bulk.const_vars.insert(bulk.const_vars.end(), const_vars.begin(), const_vars.end());
+  bulk.mutable_vars.insert(bulk.mutable_vars.end(), mutable_vars.begin(), mutable_vars.end());
+  if (bulk.fns.size() >= static_cast<size_t>(bulk.bulk_size)) {
+    BulkFlush();
+  }
+}
+
+void ThreadedEngine::BulkFlush() {
+  BulkStatus& bulk = *BulkStatusStore::Get();
+  if (bulk.fns.size() == 0) return;
+  std::vector<SyncFn> fns;
+  std::vector<VarHandle> const_vars, mutable_vars;
+  fns.swap(bulk.fns);
+  const_vars.swap(bulk.const_vars);
+  mutable_vars.swap(bulk.mutable_vars);
+  // an operation cannot depend on the same variable twice,
+  // and a variable written by the bulk is not read by it.
+  std::sort(mutable_vars.begin(), mutable_vars.end());
+  mutable_vars.erase(std::unique(mutable_vars.begin(), mutable_vars.end()),
+                     mutable_vars.end());
+  std::sort(const_vars.begin(), const_vars.end());
+  const_vars.erase(std::unique(const_vars.begin(), const_vars.end()),
+                   const_vars.end());
+  const_vars.erase(std::remove_if(const_vars.begin(), const_vars.end(),
+                                  [&mutable_vars](VarHandle v) {
+                                    return std::binary_search(
+                                        mutable_vars.begin(), mutable_vars.end(), v);
+                                  }),
+                   const_vars.end());
+  if (fns.size() == 1) {
+    Engine::PushSync(fns[0], bulk.ctx, const_vars, mutable_vars,
+                     FnProperty::kNormal, 0, "ImperativeBulk");
+    return;
+  }
+  Engine::PushSync([fns](RunContext ctx) {
+      for (const SyncFn& fn : fns) fn(ctx);
+    }, bulk.ctx, const_vars, mutable_vars, FnProperty::kNormal, 0, "ImperativeBulk");
+}
+
+int ThreadedEngine::set_bulk_size(int bulk_size) {
+  CHECK_GE(bulk_size, 0);
+  BulkStatus& bulk = *BulkStatusStore::Get();
+  int prev = bulk.bulk_size;
+  bulk.bulk_size = bulk_size;
+  if (bulk.fns.size() >= static_cast<size_t>(bulk_size)) {
+    BulkFlush();
+  }
+  return prev;
 }
 
 void ThreadedEngine::DeleteVariable(SyncFn delete_fn,
                                     Context exec_ctx,
                                     VarHandle var) {
   ThreadedVar* threaded_var = ThreadedVar::CastFromBase(var);
-  this->PushSync([delete_fn, threaded_var](RunContext ctx) {
+  ThreadedOpr* opr = NewOperator([delete_fn, threaded_var](RunContext ctx,
+                                                           CallbackOnComplete on_complete) {
       // Mark variable as orphan,
       // so during `ThreadedEngine::OnComplete` it could be recycled.
       threaded_var->SetToDelete();
       delete_fn(ctx);
-    }, exec_ctx, {}, {var}, FnProperty::kAsync);
+      on_complete();
+    }, {}, {var}, FnProperty::kAsync, nullptr);
+  opr->temporary = true;
+  opr->deletes_var = true;
+  PushNow(opr, exec_ctx, 0);
 }
 
 void ThreadedEngine::WaitForVar(VarHandle var) {
+  CHECK(!CaptureStatusStore::Get()->capturing) << "cannot wait during a graph capture";
+  BulkFlush();
+  counters_.host_waits.fetch_add(1, std::memory_order_relaxed);
   ThreadedVar* threaded_var = ThreadedVar::CastFromBase(var);
-  if (threaded_var->ready_to_read()) return;
+  if (threaded_var->ready_to_read()) {
+#if MXNET_USE_CUDA
+    if (stream_ordered_) {
+      std::vector<StreamEventPtr> events;
+      threaded_var->GetEvents(false, &events);
+      for (const StreamEventPtr& e : events) CUDA_CALL(cudaEventSynchronize(e->event));
+    }
+#endif
+    return;
+  }
   if (engine_info_) {
     LOG(INFO) << "Wait for " << threaded_var;
     debug_wait_var_ = threaded_var;
   }
   std::atomic<bool> done{false};
-  this->PushSync([this, &done](RunContext) {
+  ThreadedOpr* opr = NewOperator([this, &done](RunContext, CallbackOnComplete on_complete) {
       if (engine_info_) {
         LOG(INFO) << "Sync is executed";
       }
+      // a spinning waiter may return as soon as done is set, done is not used after
       {
         std::unique_lock<std::mutex> lock{finished_m_};
-        done.store(true);
+        done.store(true, std::memory_order_release);
       }
       finished_cv_.notify_all();
       if (engine_info_) {
         LOG(INFO) << "Sync is notified";
       }
-    }, Context::CPU(), {var}, {}, FnProperty::kNormal);
+      on_complete();
+    }, {var}, {}, FnProperty::kNormal, nullptr);
+  opr->temporary = true;
+  // completed by the thread completing the last write, the host waits on the
+  // events of stream ordered writes from a worker otherwise
+  opr->run_inline = !stream_ordered_;
+  const uint64_t start_micros = Profiler::GetTimeInMicros();
+  // bypass bulk execution, the operation must be pushed before waiting.
+  PushNow(opr, Context::CPU(), 0);
+  if (wait_spin_us_ > 0 && SpinWait(done)) {
+    counters_.host_wait_spun.fetch_add(1, std::memory_order_relaxed);
+    counters_.host_wait_us.fetch_add(Profiler::GetTimeInMicros() - start_micros,
+                                     std::memory_order_relaxed);
+    return;
+  }
   {
     std::unique_lock<std::mutex> lock{finished_m_};
     finished_cv_.wait(lock, [this, &done]() {
         return done.load() || kill_.load();
       });
   }
+  counters_.host_wait_us.fetch_add(Profiler::GetTimeInMicros() - start_micros,
+                                   std::memory_order_relaxed);
 }
 
 void ThreadedEngine::WaitForAll() {
-  std::unique_lock<std::mutex> lock{finished_m_};
-  finished_cv_.wait(lock, [this]() {
-      return pending_.load() == 0 || kill_.load();
-    });
+  CHECK(!CaptureStatusStore::Get()->capturing) << "cannot wait during a graph capture";
+  BulkFlush();
+  counters_.host_waits.fetch_add(1, std::memory_order_relaxed);
+  const uint64_t start_micros = Profiler::GetTimeInMicros();
+  {
+    std::unique_lock<std::mutex> lock{finished_m_};
+    finished_cv_.wait(lock, [this]() {
+        return pending_.load() == 0 || kill_.load();
+      });
+  }
+#if MXNET_USE_CUDA
+  if (stream_ordered_) {
+    std::vector<StreamEventPtr> events;
+    {
+      std::lock_guard<std::mutex> lock{last_events_m_};
+      for (auto& kv : last_events_) events.push_back(kv.second);
+    }
+    for (const StreamEventPtr& e : events) CUDA_CALL(cudaEventSynchronize(e->event));
+  }
+#endif
+  counters_.host_wait_us.fetch_add(Profiler::GetTimeInMicros() - start_micros,
+                                   std::memory_order_relaxed);
+}
+
+void ThreadedEngine::GetStats(std::vector<std::pair<std::string, uint64_t> >* stats) {
+  // gauges read while operations move between states may be transiently off by a few
+  auto gauge = [](const std::atomic<int64_t>& v) {
+    return static_cast<uint64_t>(std::max<int64_t>(v.load(std::memory_order_relaxed), 0));
+  };
+  stats->clear();
+  stats->emplace_back("pushed", counters_.pushed.load(std::memory_order_relaxed));
+  stats->emplace_back("completed", counters_.completed.load(std::memory_order_relaxed));
+  stats->emplace_back("pending", static_cast<uint64_t>(std::max(pending_.load(), 0)));
+  stats->emplace_back("ready", gauge(counters_.ready));
+  stats->emplace_back("running", gauge(counters_.running));
+  stats->emplace_back("dep_blocked", counters_.dep_blocked.load(std::memory_order_relaxed));
+  stats->emplace_back("dep_waits", counters_.dep_waits.load(std::memory_order_relaxed));
+  stats->emplace_back("queue_wait_us", counters_.queue_wait_us.load(std::memory_order_relaxed));
+  stats->emplace_back("host_waits", counters_.host_waits.load(std::memory_order_relaxed));
+  stats->emplace_back("host_wait_us", counters_.host_wait_us.load(std::memory_order_relaxed));
+  stats->emplace_back("host_wait_spun", counters_.host_wait_spun.load(std::memory_order_relaxed));
 }
 
-inline void ThreadedEngine::OnComplete(ThreadedOpr* threaded_opr) {
+void ThreadedEngine::WaitForEvents(RunContext run_ctx, OprBlock* opr_block, StreamUse* use) {
+#if MXNET_USE_CUDA
+  const bool on_gpu = opr_block->ctx.dev_mask() == gpu::kDevMask;
+  if (run_ctx.stream != nullptr && on_gpu) {
+    use->stream = mshadow::Stream<gpu>::GetStream(run_ctx.get_stream<gpu>());
+  }
+  std::vector<StreamEventPtr> events;
+  for (ThreadedVar* v : opr_block->opr->const_vars) v->GetEvents(false, &events);
+  for (ThreadedVar* v : opr_block->opr->mutable_vars) v->GetEvents(true, &events);
+  if (events.empty()) return;
+  if (opr_block->opr->deletes_var && on_gpu) {
+    use->free_after = std::move(events);
+    return;
+  }
+  // host functions, including the deletions of host variables, wait on the host
+  if (run_ctx.stream == nullptr || opr_block->ctx.dev_mask() != gpu::kDevMask) {
+    for (const StreamEventPtr& e : events) CUDA_CALL(cudaEventSynchronize(e->event));
+    return;
+  }
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(run_ctx.get_stream<gpu>());
+  for (const StreamEventPtr& e : events) {
+    if (e->stream != stream) CUDA_CALL(cudaStreamWaitEvent(stream, e->event, 0));
+  }
+#endif
+}
+
+void ThreadedEngine::EndStreamUse(StreamUse* use) {
+  std::swap(*use, *StreamUseStore::Get());
+#if MXNET_USE_CUDA
+  // the deleted variable did not own pool memory, e.g. an external buffer
+  if (!use->freed) {
+    for (const StreamEventPtr& e : use->free_after) CUDA_CALL(cudaEventSynchronize(e->event));
+  }
+#endif
+}
+
+void ThreadedEngine::RecordEvent(OprBlock* opr_block) {
+#if MXNET_USE_CUDA
+  // only a completion by the function itself is ordered on its stream, the
+  // operations completing later on another thread already waited for their work
+  ExecStatus* status = ExecStatusStore::Get();
+  if (status->opr_block != opr_block || status->stream == nullptr ||
+      opr_block->ctx.dev_mask() != gpu::kDevMask) return;
+  mshadow::Stream<gpu>* s = static_cast<mshadow::Stream<gpu>*>(status->stream);
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  StreamEventPtr event = event_pool_->Record(opr_block->ctx.dev_id, stream);
+  for (ThreadedVar* v : opr_block->opr->const_vars) v->AddEvent(event, false);
+  for (ThreadedVar* v : opr_block->opr->mutable_vars) v->AddEvent(event, true);
+  {
+    std::lock_guard<std::mutex> lock{last_events_m_};
+    last_events_[stream] = event;
+  }
+#endif
+}
+
+inline void ThreadedEngine::OnComplete(OprBlock* opr_block) {
+  counters_.running.fetch_sub(1, std::memory_order_relaxed);
+  counters_.completed.fetch_add(1, std::memory_order_relaxed);
+  if (stream_ordered_) this->RecordEvent(opr_block);
+  if (opr_block->graph_run != nullptr) {
+    OnGraphNodeComplete(opr_block);
+    return;
+  }
+  ThreadedOpr* threaded_opr = opr_block->opr;
+  if (opr_block->opr_stat != nullptr) {
+    opr_block->opr_stat->opr_end_rel_micros = Profiler::GetTimeInMicros();
+  }
+  OprBlock::Delete(opr_block);
   // Mark complete for read variables
   for (auto&& i : threaded_opr->const_vars) {
     i->CompleteReadDependency([this](OprBlock* opr) {
-        this->PushToExecute(opr, false);
+        this->PushReady(opr, false);
       });
   }
   // Mark complete for write variables.
@@ -352,7 +613,7 @@ inline void ThreadedEngine::OnComplete(ThreadedOpr* threaded_opr) {
             LOG(INFO) << "PushToExecute " << opr;
             debug_push_opr_ = opr;
           }
-          this->PushToExecute(opr, false);
+          this->PushReady(opr, false);
           if (debug_info) {
             LOG(INFO) << "Fin PushToExecute " << opr;
           }
@@ -378,10 +639,149 @@ inline void ThreadedEngine::OnComplete(ThreadedOpr* threaded_opr) {
   }
 }
 
+bool ThreadedEngine::Capture(ThreadedOpr* opr, Context exec_ctx, int priority, bool owned) {
+  CaptureStatus& capture = *CaptureStatusStore::Get();
+  if (!capture.capturing) return false;
+  ThreadedGraph::Node node;
+  node.opr = opr;
+  node.ctx = exec_ctx;
+  node.priority = priority;
+  node.owned = owned;
+  node.num_inputs = 0;
+  capture.nodes.push_back(node);
+  return true;
+}
+
+void ThreadedEngine::BeginCapture() {
+  CaptureStatus& capture = *CaptureStatusStore::Get();
+  CHECK(!capture.capturing) << "the calling thread is already capturing a graph";
+  // the pending bulk is not a part of the graph
+  BulkFlush();
+  capture.capturing = true;
+  capture.nodes.clear();
+}
+
+Engine::GraphHandle ThreadedEngine::EndCapture() {
+  CaptureStatus& capture = *CaptureStatusStore::Get();
+  CHECK(capture.capturing) << "the calling thread is not capturing a graph";
+  capture.capturing = false;
+  ThreadedGraph* graph = new ThreadedGraph();
+  graph->nodes.swap(capture.nodes);
+  // the dependencies between the nodes, in the order they were pushed
+  struct VarState {
+    int last_write{-1};
+    std::vector<int> reads;
+  };
+  std::unordered_map<ThreadedVar*, VarState> state;
+  std::vector<ThreadedVar*> order;
+  for (size_t i = 0; i < graph->nodes.size(); ++i) {
+    ThreadedOpr* opr = graph->nodes[i].opr;
+    std::vector<int> inputs;
+    for (ThreadedVar* v : opr->const_vars) {
+      if (state.count(v) == 0) order.push_back(v);
+      VarState& st = state[v];
+      if (st.last_write >= 0) inputs.push_back(st.last_write);
+      st.reads.push_back(static_cast<int>(i));
+    }
+    for (ThreadedVar* v : opr->mutable_vars) {
+      if (state.count(v) == 0) order.push_back(v);
+      VarState& st = state[v];
+      if (st.last_write >= 0) inputs.push_back(st.last_write);
+      inputs.insert(inputs.end(), st.reads.begin(), st.reads.end());
+      st.reads.clear();
+      st.last_write = static_cast<int>(i);
+    }
+    std::sort(inputs.begin(), inputs.end());
+    inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+    graph->nodes[i].num_inputs = static_cast<int>(inputs.size());
+    for (int j : inputs) graph->nodes[j].outputs.push_back(static_cast<int>(i));
+    if (inputs.size() == 0) graph->roots.push_back(static_cast<int>(i));
+  }
+  // a replay waits for the previous operations on the variables of the graph
+  graph->var = NewVariable();
+  std::vector<VarHandle> const_vars, mutable_vars{graph->var};
+  for (ThreadedVar* v : order) {
+    if (state[v].last_write >= 0) {
+      mutable_vars.push_back(v);
+    } else {
+      const_vars.push_back(v);
+    }
+  }
+  graph->launcher = NewOperator([this, graph](RunContext, CallbackOnComplete on_complete) {
+      if (graph->nodes.size() == 0) {
+        on_complete();
+        return;
+      }
+      GraphRun* run = new GraphRun();
+      run->graph = graph;
+      run->wait.reset(new std::atomic<int>[graph->nodes.size()]);
+      for (size_t i = 0; i < graph->nodes.size(); ++i) {
+        run->wait[i].store(graph->nodes[i].num_inputs);
+      }
+      run->remaining.store(static_cast<int>(graph->nodes.size()));
+      run->on_complete = on_complete;
+      for (int i : graph->roots) this->PushGraphNode(run, i);
+    }, const_vars, mutable_vars, FnProperty::kAsync, "GraphReplay");
+  return graph;
+}
+
+void ThreadedEngine::PushGraph(GraphHandle graph, int priority) {
+  ThreadedGraph* threaded_graph = ThreadedGraph::CastFromBase(graph);
+  Push(threaded_graph->launcher, Context::CPU(), priority);
+}
+
+void ThreadedEngine::DeleteGraph(GraphHandle graph) {
+  ThreadedGraph* threaded_graph = ThreadedGraph::CastFromBase(graph);
+  ThreadedOpr* launcher = threaded_graph->launcher;
+  std::vector<VarHandle> deps(launcher->const_vars.begin(), launcher->const_vars.end());
+  deps.insert(deps.end(), launcher->mutable_vars.begin(), launcher->mutable_vars.end());
+  // after the pushed replays, which are all completed once the graph variable is written
+  PushSyncNow([threaded_graph](RunContext) {
+      for (const ThreadedGraph::Node& node : threaded_graph->nodes) {
+        if (node.owned) ThreadedOpr::Delete(node.opr);
+      }
+      ThreadedOpr::Delete(threaded_graph->launcher);
+    }, Context::CPU(), {}, deps, FnProperty::kAsync, nullptr);
+  ThreadedVar* var = threaded_graph->var;
+  DeleteVariable([threaded_graph](RunContext) {
+      delete threaded_graph;
+    }, Context::CPU(), var);
+}
+
+void ThreadedEngine::PushGraphNode(GraphRun* run, int node) {
+  const ThreadedGraph::Node& n = run->graph->nodes[node];
+  OprBlock* opr_block = OprBlock::New();
+  opr_block->opr = n.opr;
+  opr_block->ctx = n.ctx;
+  opr_block->priority = n.priority;
+  opr_block->profiling = Profiler::Get()->IsProfiling(n.opr->opr_name);
+  opr_block->graph_run = run;
+  opr_block->graph_node = node;
+  counters_.pushed.fetch_add(1, std::memory_order_relaxed);
+  this->PushReady(opr_block, false);
+}
+
+void ThreadedEngine::OnGraphNodeComplete(OprBlock* opr_block) {
+  GraphRun* run = opr_block->graph_run;
+  const ThreadedGraph::Node& n = run->graph->nodes[opr_block->graph_node];
+  if (opr_block->opr_stat != nullptr) {
+    opr_block->opr_stat->opr_end_rel_micros = Profiler::GetTimeInMicros();
+  }
+  OprBlock::Delete(opr_block);
+  for (int i : n.outputs) {
+    if (--run->wait[i] == 0) PushGraphNode(run, i);
+  }
+  if (--run->remaining == 0) {
+    CallbackOnComplete on_complete = run->on_complete;
+    delete run;
+    on_complete();
+  }
+}
+
 void ThreadedEngine::OnCompleteStatic(
-    Engine *engine, void *threaded_opr) {
+    Engine *engine, void *opr_block) {
   static_cast<ThreadedEngine*>(engine)->OnComplete(
-      static_cast<ThreadedOpr*>(threaded_opr));
+      static_cast<OprBlock*>(opr_block));
 }
 
 }  // namespace engine
@@ -10,14 +10,23 @@
 
 #include <dmlc/base.h>
 #include <dmlc/logging.h>
+#include <mxnet/storage.h>
 #include <vector>
 #include <functional>
 #include <condition_variable>
 #include <atomic>
+#include <memory>
 #include <mutex>
+#include <cstring>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include "./engine_impl.h"
+#include "./profiler.h"
+#include "./stream_event_pool.h"
 #include "../common/object_pool.h"
+#include "../common/thread_local.h"
 
 namespace mxnet {
 namespace engine {
@@ -34,6 +43,7 @@ namespace engine {
 
 // Forward declarations
 struct ThreadedOpr;
+struct GraphRun;
 
 /*!
  * \brief Operation block in the scheduler.
@@ -50,6 +60,16 @@ struct OprBlock : public common::ObjectPoolAllocatable<OprBlock> {
   Context ctx;
   /*! \brief priority of the function */
   int priority;
+  /*! \brief whether the execution of this block is recorded by profiler */
+  bool profiling{false};
+  /*! \brief time when all dependencies of the block are satisfied */
+  uint64_t ready_micros{0};
+  /*! \brief profiler record of this block, valid during execution */
+  OprExecStat* opr_stat{nullptr};
+  /*! \brief the replay of a graph this block is a node of, or nullptr */
+  GraphRun* graph_run{nullptr};
+  /*! \brief the index of the node in the graph */
+  int graph_node{-1};
   // define possible debug information
   DEFINE_ENGINE_DEBUG_INFO(OprBlock);
   /*!
@@ -134,6 +154,21 @@ class ThreadedVar final : public Var,
   inline void SetToDelete();
   /*! \return whether this variable is ready to read. */
   inline bool ready_to_read();
+  /*!
+   * \brief Attach the event of a stream ordered operation that completed on
+   *  this variable. The event of a write replaces all the previous ones, the
+   *  event of a read replaces the previous read on the same stream.
+   * \param event the event recorded after the kernels of the operation.
+   * \param write whether the operation wrote this variable.
+   */
+  inline void AddEvent(const StreamEventPtr& event, bool write);
+  /*!
+   * \brief The events an operation has to wait for before using this variable.
+   * \param write whether the operation writes this variable, then the
+   *  reads since the last write are waited for too.
+   * \param events the events are appended to it.
+   */
+  inline void GetEvents(bool write, std::vector<StreamEventPtr>* events);
   /*!
    * \brief Cast a Var pointer to ThreadedVar pointer
    * \param ptr pointer from base.
@@ -177,6 +212,10 @@ class ThreadedVar final : public Var,
    * \brief If true, delete after operation completes.
    */
   bool to_delete_{false};
+  /*! \brief event of the last stream ordered write, or nullptr */
+  StreamEventPtr write_event_;
+  /*! \brief events of the stream ordered reads since the last write */
+  std::vector<StreamEventPtr> read_events_;
   /*! \brief special const on num_pending_reads_ to mark write being triggered */
   static constexpr int kWriteTriggered = -1;
   /*!
@@ -201,11 +240,20 @@ struct ThreadedOpr final : public Opr,
   std::vector<ThreadedVar*> mutable_vars;
   /*! \brief the property of the operator */
   FnProperty prop;
+  /*! \brief the name of the operator, can be nullptr */
+  const char* opr_name{nullptr};
   /*!
    * \brief Whether this is an temporary operator
    *        that can be deleted right after the operation completed.
    */
   bool temporary{false};
+  /*! \brief Whether this is the deletion of its mutable variable */
+  bool deletes_var{false};
+  /*!
+   * \brief Whether the trivial function is executed by the thread completing
+   *  its last dependency instead of being queued to a worker.
+   */
+  bool run_inline{false};
   /*!
    * \brief Cast a Opr pointer to ThreadedOpr pointer
    * \param ptr pointer from base.
@@ -218,6 +266,59 @@ struct ThreadedOpr final : public Opr,
   DEFINE_ENGINE_DEBUG_INFO(ThreadedOpr);
 };  // struct ThreadedOpr
 
+/*!
+ * \brief Graph of operations captured by ThreadedEngine.
+ *
+ *  The nodes only depend on each other, by the counts computed when the
+ *  capture ends. A replay is a single engine operation, the launcher, on
+ *  the variables of the graph, which pushes the nodes having no inputs.
+ */
+struct ThreadedGraph final : public Graph {
+  /*! \brief a captured operation */
+  struct Node {
+    /*! \brief the operation */
+    ThreadedOpr* opr;
+    /*! \brief the execution context */
+    Context ctx;
+    /*! \brief the priority it was pushed with */
+    int priority;
+    /*! \brief whether the operation was created by the capture */
+    bool owned;
+    /*! \brief number of nodes it waits for */
+    int num_inputs;
+    /*! \brief the nodes waiting for it */
+    std::vector<int> outputs;
+  };
+  /*! \brief the nodes in push order */
+  std::vector<Node> nodes;
+  /*! \brief the nodes without inputs */
+  std::vector<int> roots;
+  /*! \brief the operation of a replay */
+  ThreadedOpr* launcher{nullptr};
+  /*! \brief variable written by every replay so that the replays are serialized */
+  ThreadedVar* var{nullptr};
+  /*!
+   * \brief Cast a Graph pointer to ThreadedGraph pointer
+   * \param ptr pointer from base.
+   * \return a casted pointer.
+   */
+  inline static ThreadedGraph* CastFromBase(Graph* ptr) {
+    return ptr->Cast<ThreadedGraph>();
+  }
+};  // struct ThreadedGraph
+
+/*! \brief state of a replay of a graph */
+struct GraphRun {
+  /*! \brief the graph */
+  ThreadedGraph* graph;
+  /*! \brief number of inputs each node still waits for */
+  std::unique_ptr<std::atomic<int>[]> wait;
+  /*! \brief number of nodes not completed */
+  std::atomic<int> remaining;
+  /*! \brief completes the launcher of the replay */
+  CallbackOnComplete on_complete;
+};  // struct GraphRun
+
 /*!
  * \brief Base class of all ThreadedEngine.
  *  This class implements a thread safe version of engine.
@@ -234,23 +335,45 @@ class ThreadedEngine : public Engine {
   ThreadedOpr* NewOperator(AsyncFn fn,
                            std::vector<VarHandle> const& const_vars,
                            std::vector<VarHandle> const& mutable_vars,
-                           FnProperty prop) override;
+                           FnProperty prop,
+                           const char* opr_name) override;
   void DeleteOperator(OprHandle op) override;
   void Push(OprHandle op, Context exec_ctx, int priority) override;
   void PushAsync(AsyncFn exec_fun, Context exec_ctx,
                  std::vector<VarHandle> const& const_vars,
                  std::vector<VarHandle> const& mutable_vars,
                  FnProperty prop,
-                 int priority) override;
+                 int priority,
+                 const char* opr_name) override;
+  void PushSync(SyncFn exec_fn, Context exec_ctx,
+                std::vector<VarHandle> const& const_vars,
+                std::vector<VarHandle> const& mutable_vars,
+                FnProperty prop = FnProperty::kNormal,
+                int priority = 0,
+                const char* opr_name = nullptr) override;
   void DeleteVariable(SyncFn delete_fn, Context exec_ctx, VarHandle var) override;
   void WaitForVar(VarHandle var) override;
   void WaitForAll() override;
+  int set_bulk_size(int bulk_size) override;
+  void BeginCapture() override;
+  GraphHandle EndCapture() override;
+  void PushGraph(GraphHandle graph, int priority) override;
+  void DeleteGraph(GraphHandle graph) override;
   void NotifyShutdown() override {
     shutdown_phase_.store(true);
   }
+  bool SupportStreamOrderedComplete() const override {
+    return stream_ordered_;
+  }
+  void GetStats(std::vector<std::pair<std::string, uint64_t> >* stats) override;
 
   ThreadedEngine() {
     engine_info_ = dmlc::GetEnv("MXNET_ENGINE_INFO", false);
+    wait_spin_us_ = dmlc::GetEnv("MXNET_ENGINE_WAIT_SPIN_US", 0);
+#if MXNET_USE_CUDA
+    stream_ordered_ = dmlc::GetEnv("MXNET_GPU_STREAM_ORDERED", false);
+    event_pool_ = std::make_shared<StreamEventPool>();
+#endif
 
     objpool_opr_ref_    = common::ObjectPool<ThreadedOpr>::_GetSharedRef();
     objpool_blk_ref_    = common::ObjectPool<OprBlock>::_GetSharedRef();
@@ -277,29 +400,60 @@ class ThreadedEngine : public Engine {
   virtual void PushToExecute(OprBlock* opr_block, bool pusher_thread) = 0;
   /*!
    * \brief Call this function to actually execute an opr_block
-   *  This function also deletes the opr_block after execution.
+   *  The opr_block is deleted when the operation completes.
    * \param run_ctx runtime context used to execute the function.
    * \param opr_block the opr_block to be executed and deleted.
    */
   void ExecuteOprBlock(RunContext run_ctx, OprBlock *opr_block) {
     ThreadedOpr* threaded_opr = opr_block->opr;
+    const uint64_t start_micros = Profiler::GetTimeInMicros();
+    counters_.ready.fetch_sub(1, std::memory_order_relaxed);
+    counters_.running.fetch_add(1, std::memory_order_relaxed);
+    counters_.queue_wait_us.fetch_add(start_micros - opr_block->ready_micros,
+                                      std::memory_order_relaxed);
+    if (opr_block->profiling) {
+      OprExecStat* opr_stat = Profiler::Get()->AddOprStat(
+          opr_block->ctx.dev_type, opr_block->ctx.dev_id);
+      if (threaded_opr->opr_name != nullptr) {
+        strncpy(opr_stat->opr_name, threaded_opr->opr_name, sizeof(opr_stat->opr_name) - 1);
+        opr_stat->opr_name[sizeof(opr_stat->opr_name) - 1] = '\0';
+      }
+      opr_stat->thread_id = Profiler::GetThreadId();
+      opr_stat->opr_ready_rel_micros = opr_block->ready_micros;
+      opr_stat->opr_start_rel_micros = start_micros;
+      opr_block->opr_stat = opr_stat;
+    }
     CallbackOnComplete callback = this->CreateCallback(
-        ThreadedEngine::OnCompleteStatic, threaded_opr);
+        ThreadedEngine::OnCompleteStatic, opr_block);
     bool debug_info = (engine_info_ && debug_push_opr_ == opr_block);
     if (debug_info) {
       LOG(INFO) << "ExecuteOprBlock " << opr_block
                 << "shutdown_phase=" << shutdown_phase_;
     }
     if (!shutdown_phase_) {
+      // the operations executed by the function itself restore the outer one
+      ExecStatus* status = ExecStatusStore::Get();
+      const ExecStatus outer = *status;
+      StreamUse use;
       try {
+        if (stream_ordered_) {
+          this->WaitForEvents(run_ctx, opr_block, &use);
+          status->opr_block = opr_block;
+          status->stream = run_ctx.stream;
+          std::swap(use, *StreamUseStore::Get());
+        }
         if (debug_info) {
           LOG(INFO) << "ExecuteOprFn ";
         }
+        Storage::AllocOriginScope origin(threaded_opr->opr_name);
         threaded_opr->fn(run_ctx, callback);
         if (debug_info) {
           LOG(INFO) << "Fin ExecuteOprFn ";
         }
+        if (stream_ordered_) this->EndStreamUse(&use);
+        *status = outer;
       } catch(dmlc::Error &e) {
+        *status = outer;
         std::string what = e.what();
         if (what.find("driver shutting down") == std::string::npos &&
             !shutdown_phase_) {
@@ -317,11 +471,79 @@ class ThreadedEngine : public Engine {
     } else {
       callback();
     }
-
-    OprBlock::Delete(opr_block);
   }
 
  private:
+  /*! \brief the operation the calling thread is executing */
+  struct ExecStatus {
+    /*! \brief the operation, nullptr outside of its function */
+    OprBlock* opr_block{nullptr};
+    /*! \brief the stream it runs on */
+    void* stream{nullptr};
+  };
+  /*! \brief thread local store of exec status */
+  typedef common::ThreadLocalStore<ExecStatus> ExecStatusStore;
+  /*!
+   * \brief make an operation wait for the events of its variables, on its
+   *  stream if it has one, on the host otherwise. The deletion of a gpu
+   *  variable does not wait, the memory pool reuses the memory it frees
+   *  after the events instead.
+   * \param use the stream use of the operation, set while its function runs.
+   */
+  void WaitForEvents(RunContext run_ctx, OprBlock* opr_block, StreamUse* use);
+  /*!
+   * \brief restore the stream use of the caller after the function of an
+   *  operation, wait on the host if its deletion did not free gpu memory.
+   * \param use the stream use of the operation, the one of the caller on return.
+   */
+  void EndStreamUse(StreamUse* use);
+  /*!
+   * \brief attach an event to the variables of a gpu operation completed by
+   *  its function on its own stream, before its dependents are triggered.
+   */
+  void RecordEvent(OprBlock* opr_block);
+  /*! \brief synchronous operations of the calling thread waiting to be pushed as one */
+  struct BulkStatus {
+    /*! \brief maximum number of operations in a bulk, 0 means disabled */
+    int bulk_size{0};
+    /*! \brief context of the bulk */
+    Context ctx;
+    /*! \brief functions in the bulk */
+    std::vector<SyncFn> fns;
+    /*! \brief variables read by the bulk */
+    std::vector<VarHandle> const_vars;
+    /*! \brief variables written by the bulk */
+    std::vector<VarHandle> mutable_vars;
+  };
+  /*! \brief thread local store of bulk status */
+  typedef common::ThreadLocalStore<BulkStatus> BulkStatusStore;
+  /*! \brief push the pending bulk of the calling thread, if any */
+  void BulkFlush();
+  /*! \brief the graph being captured by the calling thread */
+  struct CaptureStatus {
+    /*! \brief whether the pushes are captured */
+    bool capturing{false};
+    /*! \brief the captured nodes */
+    std::vector<ThreadedGraph::Node> nodes;
+  };
+  /*! \brief thread local store of capture status */
+  typedef common::ThreadLocalStore<CaptureStatus> CaptureStatusStore;
+  /*!
+   * \brief record a push of the calling thread if it is capturing.
+   * \return whether the push was captured.
+   */
+  bool Capture(ThreadedOpr* opr, Context exec_ctx, int priority, bool owned);
+  /*! \brief push an operation, bypassing the capture */
+  void PushNow(OprHandle op, Context exec_ctx, int priority);
+  /*! \brief push a synchronous temporary operation, bypassing the capture and the bulk */
+  void PushSyncNow(SyncFn exec_fn, Context exec_ctx,
+                   std::vector<VarHandle> const& const_vars,
+                   std::vector<VarHandle> const& mutable_vars,
+                   FnProperty prop, const char* opr_name);
+  /*! \brief push a node of a replay whose inputs are completed */
+  void PushGraphNode(GraphRun* run, int node);
+  /*! \brief complete a node of a replay, push the nodes waiting for it */
+  void OnGraphNodeComplete(OprBlock* opr_block);
   /*!
    * \brief check if thee is duplication in const_vars and mutable_vars.
    * \param const_vars the variables to read from.
@@ -329,24 +551,108 @@ class ThreadedEngine : public Engine {
    */
   void CheckDuplicate(std::vector<VarHandle> const& const_vars,
                       std::vector<VarHandle> const& mutable_vars);
+  /*!
+   * \brief Push an opr_block whose dependencies are all satisfied.
+   * \param opr_block The operator block.
+   * \param pusher_thread whether the caller is the thread that calls push
+   */
+  inline void PushReady(OprBlock* opr_block, bool pusher_thread) {
+    opr_block->ready_micros = Profiler::GetTimeInMicros();
+    counters_.ready.fetch_add(1, std::memory_order_relaxed);
+    if (opr_block->opr->run_inline) {
+      RunContext run_ctx;
+      run_ctx.stream = nullptr;
+      this->ExecuteOprBlock(run_ctx, opr_block);
+      return;
+    }
+    this->PushToExecute(opr_block, pusher_thread);
+  }
+  /*!
+   * \brief Spin with backoff until done is set or wait_spin_us_ elapse.
+   * \return whether done was set.
+   */
+  inline bool SpinWait(const std::atomic<bool>& done) const {
+    const uint64_t deadline = Profiler::GetTimeInMicros() + wait_spin_us_;
+    int backoff = 1;
+    while (!done.load(std::memory_order_acquire)) {
+      if (Profiler::GetTimeInMicros() >= deadline) return false;
+      if (backoff <= kMaxSpinBackoff) {
+        for (int i = 0; i < backoff; ++i) SpinPause();
+        backoff *= 2;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    return true;
+  }
+  /*! \brief hint to the cpu that the thread is spinning */
+  static inline void SpinPause() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#else
+    std::this_thread::yield();
+#endif
+  }
+  /*! \brief maximum number of pauses between two checks before yielding instead */
+  static constexpr int kMaxSpinBackoff = 64;
   /*!
    * \brief Callback on operation completion.
    *
    * On operation completion, this will trigger subsequent operations.
+   * The opr_block is deleted here.
    */
-  inline void OnComplete(ThreadedOpr* threaded_opr);
+  inline void OnComplete(OprBlock* opr_block);
   // callback to the threaded engine
-  static void OnCompleteStatic(Engine *engine, void *threaded_opr);
+  static void OnCompleteStatic(Engine *engine, void *opr_block);
   /*!
    * \brief Number of pending operations.
    */
   std::atomic<int> pending_{0};
+  /*! \brief always on counters of the engine, updated with relaxed atomics */
+  struct Counters {
+    /*! \brief operations pushed */
+    std::atomic<uint64_t> pushed{0};
+    /*! \brief operations completed */
+    std::atomic<uint64_t> completed{0};
+    /*! \brief operations pushed while a variable dependency was pending */
+    std::atomic<uint64_t> dep_blocked{0};
+    /*! \brief sum over the pushes of the variable dependencies not yet satisfied */
+    std::atomic<uint64_t> dep_waits{0};
+    /*! \brief operations in the queues of the workers */
+    std::atomic<int64_t> ready{0};
+    /*! \brief operations started and not completed */
+    std::atomic<int64_t> running{0};
+    /*! \brief total time the operations spent in the queues */
+    std::atomic<uint64_t> queue_wait_us{0};
+    /*! \brief calls of WaitForVar and WaitForAll */
+    std::atomic<uint64_t> host_waits{0};
+    /*! \brief total time the host threads were blocked in them */
+    std::atomic<uint64_t> host_wait_us{0};
+    /*! \brief calls of WaitForVar that returned while spinning */
+    std::atomic<uint64_t> host_wait_spun{0};
+  };
+  /*! \brief the counters reported by GetStats */
+  Counters counters_;
   /*! \brief whether we want to kill the waiters */
   std::atomic<bool> kill_{false};
   /*! \brief whether it is during shutdown phase*/
   std::atomic<bool> shutdown_phase_{false};
   /*!\brief show more information from engine actions */
   bool engine_info_{false};
+  /*! \brief microseconds WaitForVar spins before blocking, 0 blocks at once */
+  int wait_spin_us_{0};
+  /*! \brief whether gpu operations complete once their kernels are queued */
+  bool stream_ordered_{false};
+#if MXNET_USE_CUDA
+  /*! \brief the events of stream ordered completion */
+  std::shared_ptr<StreamEventPool> event_pool_;
+  /*! \brief mutex of last_events_ */
+  std::mutex last_events_m_;
+  /*! \brief the last event of each stream, waited for by WaitForAll */
+  std::unordered_map<cudaStream_t, StreamEventPtr> last_events_;
+#endif
   /*! \brief debug information about wait for var. */
   std::atomic<ThreadedVar*> debug_wait_var_{nullptr};
   /*! \brief debug information about wait for var. */
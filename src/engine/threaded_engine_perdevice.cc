@@ -8,9 +8,17 @@
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
 #include <dmlc/concurrency.h>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
 #include "./threaded_engine.h"
 #include "./thread_pool.h"
+#include "./work_stealing_pool.h"
+#include "../common/cuda_utils.h"
 #include "../common/lazy_alloc_array.h"
+#include "../common/numa.h"
+#include "../common/thread_budget.h"
 #include "../common/utils.h"
 
 namespace mxnet {
@@ -20,8 +28,21 @@ namespace engine {
  * The policy of this Engine:
  *  - Execute Async operation immediately if pushed from Pusher.
  *  - Use fixed amount of threads for each device.
- *  - Use special threads for copy operations.
+ *  - Use special threads for copy operations, with separate queues and streams for the
+ *    copies to a GPU and those from it, so that both DMA engines are busy. The copies
+ *    from a GPU have the higher stream priority by default.
  *  - Each stream is allocated and bound to each of the thread.
+ *  - The ready GPU operations are taken by priority. The latency critical ones,
+ *    of at least kHighPriority, run on their own workers whose streams have the
+ *    highest priority of the device, so that their kernels preempt the others.
+ *  - The prioritized GPU operations, the reductions of the kvstores, run on their own
+ *    workers too, with streams above those of the computation, so that the gradients
+ *    of the first layers are reduced while the backward of the others still runs.
+ *  - Optionally, normal CPU jobs are scheduled by a work stealing pool,
+ *    where each worker owns a lock-free deque.
+ *  - Each queue counts its operations and the busy time of its workers.
+ *  - The CPU operations running at the same time share the CPU thread budget
+ *    for their OpenMP teams, see common::CPUThreadBudget.
  */
 class ThreadedEnginePerDevice : public ThreadedEngine {
  public:
@@ -30,14 +51,28 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
   static auto constexpr kCopyQueue = kPriority;
   static auto constexpr kPriorityQueue = kPriority;
   static auto constexpr kWorkerQueue = kFIFO;
+  static auto constexpr kGPUWorkerQueue = kPriority;
 
-  ThreadedEnginePerDevice() noexcept(false) {
+  /*!
+   * \brief constructor
+   * \param work_stealing whether to schedule normal CPU jobs by work stealing.
+   */
+  explicit ThreadedEnginePerDevice(bool work_stealing = false) noexcept(false)
+      : work_stealing_(work_stealing) {
     gpu_worker_nthreads_ = common::GetNumThreadPerGPU();
     gpu_copy_nthreads_ = dmlc::GetEnv("MXNET_GPU_COPY_NTHREADS", 1);
-    cpu_worker_nthreads_ = dmlc::GetEnv("MXNET_CPU_WORKER_NTHREADS", 1);
+    gpu_copy_to_priority_ = dmlc::GetEnv("MXNET_GPU_COPY_TO_PRIORITY", 0);
+    gpu_copy_from_priority_ = dmlc::GetEnv("MXNET_GPU_COPY_FROM_PRIORITY", 1);
+    gpu_priority_nthreads_ = dmlc::GetEnv("MXNET_GPU_PRIORITY_NTHREADS", 1);
+    gpu_comm_nthreads_ = dmlc::GetEnv("MXNET_GPU_COMM_NTHREADS", 1);
+    gpu_comm_priority_ = dmlc::GetEnv("MXNET_GPU_COMM_PRIORITY", 1);
+    // work stealing only pays off with several workers
+    cpu_worker_nthreads_ = dmlc::GetEnv("MXNET_CPU_WORKER_NTHREADS",
+                                        work_stealing ? 4 : 1);
     // create CPU task
     int cpu_priority_nthreads = dmlc::GetEnv("MXNET_CPU_PRIORITY_NTHREADS", 4);
     cpu_priority_worker_.reset(new ThreadWorkerBlock<kPriorityQueue>());
+    cpu_priority_worker_->stats.nthreads = cpu_priority_nthreads;
     cpu_priority_worker_->pool.reset(new ThreadPool(
         cpu_priority_nthreads, [this] {
           this->CPUWorker(cpu_priority_worker_.get());
@@ -46,10 +81,41 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
   }
   ~ThreadedEnginePerDevice() noexcept(false) {
     gpu_normal_workers_.Clear();
-    gpu_copy_workers_.Clear();
+    gpu_priority_workers_.Clear();
+    gpu_comm_workers_.Clear();
+    gpu_copy_to_workers_.Clear();
+    gpu_copy_from_workers_.Clear();
     cpu_normal_workers_.Clear();
+    cpu_steal_workers_.Clear();
     cpu_priority_worker_.reset(nullptr);
   }
+  void GetStats(std::vector<std::pair<std::string, uint64_t> >* stats) override {
+    ThreadedEngine::GetStats(stats);
+    const uint64_t now = Profiler::GetTimeInMicros();
+    pusher_stats_.Append("async", now, stats);
+    cpu_priority_worker_->stats.Append("cpu/priority", now, stats);
+    cpu_normal_workers_.ForEach([&](size_t i, ThreadWorkerBlock<kWorkerQueue>* blk) {
+        blk->stats.Append("cpu(" + std::to_string(i) + ")/normal", now, stats);
+      });
+    cpu_steal_stats_.ForEach([&](size_t i, QueueStats* s) {
+        s->Append("cpu(" + std::to_string(i) + ")/normal", now, stats);
+      });
+    gpu_normal_workers_.ForEach([&](size_t i, ThreadWorkerBlock<kGPUWorkerQueue>* blk) {
+        blk->stats.Append("gpu(" + std::to_string(i) + ")/normal", now, stats);
+      });
+    gpu_priority_workers_.ForEach([&](size_t i, ThreadWorkerBlock<kGPUWorkerQueue>* blk) {
+        blk->stats.Append("gpu(" + std::to_string(i) + ")/priority", now, stats);
+      });
+    gpu_comm_workers_.ForEach([&](size_t i, ThreadWorkerBlock<kGPUWorkerQueue>* blk) {
+        blk->stats.Append("gpu(" + std::to_string(i) + ")/comm", now, stats);
+      });
+    gpu_copy_to_workers_.ForEach([&](size_t i, ThreadWorkerBlock<kCopyQueue>* blk) {
+        blk->stats.Append("gpu(" + std::to_string(i) + ")/copy_to", now, stats);
+      });
+    gpu_copy_from_workers_.ForEach([&](size_t i, ThreadWorkerBlock<kCopyQueue>* blk) {
+        blk->stats.Append("gpu(" + std::to_string(i) + ")/copy_from", now, stats);
+      });
+  }
 
  protected:
   void PushToExecute(OprBlock *opr_block, bool pusher_thread) override {
@@ -62,21 +128,42 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
       }
       RunContext run_ctx;
       run_ctx.stream = nullptr;
-      this->ExecuteOprBlock(run_ctx, opr_block);
+      pusher_stats_.queued.fetch_add(1, std::memory_order_relaxed);
+      this->Execute(run_ctx, opr_block, &pusher_stats_);
     } else {
       if (ctx.dev_mask() == cpu::kDevMask) {
         if (opr_block->opr->prop == FnProperty::kCPUPrioritized) {
-          cpu_priority_worker_->task_queue.Push(opr_block, opr_block->priority);
+          cpu_priority_worker_->Push(opr_block);
+        } else if (work_stealing_) {
+          int dev_id = ctx.dev_id;
+          int nthread = cpu_worker_nthreads_;
+          QueueStats* qstats = cpu_steal_stats_.Get(dev_id, [nthread]() {
+              QueueStats* s = new QueueStats();
+              s->nthreads = nthread;
+              return s;
+            });
+          qstats->queued.fetch_add(1, std::memory_order_relaxed);
+          cpu_steal_workers_.Get(dev_id, [this, dev_id, nthread, qstats]() {
+              return new WorkStealingPool<OprBlock*>(nthread, [this, qstats](OprBlock* blk) {
+                  RunContext run_ctx;
+                  run_ctx.stream = nullptr;
+                  this->Execute(run_ctx, blk, qstats);
+                }, [dev_id]() {
+                  common::BindThreadToNUMANode(common::CPUContextNUMANode(dev_id));
+                });
+            })->Push(opr_block, opr_block->priority);
         } else {
           int dev_id = ctx.dev_id;
           int nthread = cpu_worker_nthreads_;
           cpu_normal_workers_.Get(dev_id, [this, dev_id, nthread]() {
               auto blk = new ThreadWorkerBlock<kWorkerQueue>();
-              blk->pool.reset(new ThreadPool(nthread, [this, blk] () {
+              blk->stats.nthreads = nthread;
+              blk->pool.reset(new ThreadPool(nthread, [this, blk, dev_id] () {
+                    common::BindThreadToNUMANode(common::CPUContextNUMANode(dev_id));
                     this->CPUWorker(blk);
                   }));
               return blk;
-            })->task_queue.Push(opr_block, opr_block->priority);
+            })->Push(opr_block);
         }
       } else {
         CHECK_EQ(ctx.dev_mask(), gpu::kDevMask);
@@ -84,30 +171,88 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
         FnProperty prop = opr_block->opr->prop;
         bool is_copy = (prop == FnProperty::kCopyFromGPU ||
                         prop == FnProperty::kCopyToGPU);
-        int nthread = gpu_worker_nthreads_;
+        int nthread = is_copy ? gpu_copy_nthreads_ : gpu_worker_nthreads_;
         int dev_id = ctx.dev_id;
         if (is_copy) {
-          gpu_copy_workers_.Get(dev_id, [this, dev_id, is_copy, nthread]() {
+          // the copies to the gpu and those from it, including to another gpu, each on
+          // their own queue and stream
+          const bool to_gpu = prop == FnProperty::kCopyToGPU;
+          const int level = to_gpu ? gpu_copy_to_priority_ : gpu_copy_from_priority_;
+          auto& workers = to_gpu ? gpu_copy_to_workers_ : gpu_copy_from_workers_;
+          workers.Get(dev_id, [this, dev_id, is_copy, nthread, level]() {
               auto blk = new ThreadWorkerBlock<kCopyQueue>();
-              blk->pool.reset(new ThreadPool(nthread, [this, dev_id, is_copy, blk] () {
-                    this->GPUWorker(dev_id, is_copy, blk);
+              blk->stats.nthreads = nthread;
+              blk->pool.reset(new ThreadPool(nthread, [this, dev_id, is_copy, blk, level] () {
+                    this->GPUWorker(dev_id, is_copy, blk, level);
                   }));
               return blk;
-            })->task_queue.Push(opr_block, opr_block->priority);
+            })->Push(opr_block);
+        } else if (opr_block->priority >= kHighPriority) {
+          const int nprio = gpu_priority_nthreads_;
+          gpu_priority_workers_.Get(dev_id, [this, dev_id, nprio]() {
+              auto blk = new ThreadWorkerBlock<kGPUWorkerQueue>();
+              blk->stats.nthreads = nprio;
+              blk->pool.reset(new ThreadPool(nprio, [this, dev_id, blk] () {
+                    this->GPUWorker(dev_id, false, blk, kMaxStreamPriority);
+                  }));
+              return blk;
+            })->Push(opr_block);
+        } else if (prop == FnProperty::kGPUPrioritized) {
+          // taken by priority, the reductions of the first layers come first
+          const int ncomm = gpu_comm_nthreads_;
+          const int level = gpu_comm_priority_;
+          gpu_comm_workers_.Get(dev_id, [this, dev_id, ncomm, level]() {
+              auto blk = new ThreadWorkerBlock<kGPUWorkerQueue>();
+              blk->stats.nthreads = ncomm;
+              blk->pool.reset(new ThreadPool(ncomm, [this, dev_id, blk, level] () {
+                    this->GPUWorker(dev_id, false, blk, level);
+                  }));
+              return blk;
+            })->Push(opr_block);
         } else {
           gpu_normal_workers_.Get(dev_id, [this, dev_id, is_copy, nthread]() {
-              auto blk = new ThreadWorkerBlock<kWorkerQueue>();
+              auto blk = new ThreadWorkerBlock<kGPUWorkerQueue>();
+              blk->stats.nthreads = nthread;
               blk->pool.reset(new ThreadPool(nthread, [this, dev_id, is_copy, blk] () {
                     this->GPUWorker(dev_id, is_copy, blk);
                   }));
               return blk;
-            })->task_queue.Push(opr_block, opr_block->priority);
+            })->Push(opr_block);
         }
       }
     }
   }
 
  private:
+  // counters of a queue and of the workers taking from it
+  struct QueueStats {
+    // operations pushed
+    std::atomic<uint64_t> queued{0};
+    // operations executed
+    std::atomic<uint64_t> executed{0};
+    // total time the workers spent executing
+    std::atomic<uint64_t> busy_us{0};
+    // number of workers, 0 for the pusher threads
+    int nthreads{0};
+    // creation time
+    uint64_t start_us{Profiler::GetTimeInMicros()};
+    // append the counters of the queue to stats
+    inline void Append(const std::string& name, uint64_t now,
+                       std::vector<std::pair<std::string, uint64_t> >* stats) const {
+      const uint64_t q = queued.load(std::memory_order_relaxed);
+      const uint64_t e = executed.load(std::memory_order_relaxed);
+      const uint64_t busy = busy_us.load(std::memory_order_relaxed);
+      stats->emplace_back(name + "/queued", q);
+      stats->emplace_back(name + "/executed", e);
+      stats->emplace_back(name + "/pending", q > e ? q - e : 0);
+      stats->emplace_back(name + "/busy_us", busy);
+      if (nthreads != 0) {
+        const uint64_t total = nthreads * (now - start_us);
+        stats->emplace_back(name + "/threads", nthreads);
+        stats->emplace_back(name + "/idle_us", total > busy ? total - busy : 0);
+      }
+    }
+  };
   // working unit for each of the task.
   template<dmlc::ConcurrentQueueType type>
   struct ThreadWorkerBlock {
@@ -115,51 +260,116 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     dmlc::ConcurrentBlockingQueue<OprBlock*, type>  task_queue;
     // thread pool that works on this task
     std::unique_ptr<ThreadPool> pool;
+    // counters of the queue
+    QueueStats stats;
+    // push a ready operation
+    inline void Push(OprBlock* opr_block) {
+      stats.queued.fetch_add(1, std::memory_order_relaxed);
+      task_queue.Push(opr_block, opr_block->priority);
+    }
     // destructor
     ~ThreadWorkerBlock() noexcept(false) {
       task_queue.SignalForKill();
     }
   };
+  /*! \brief whether normal CPU jobs are scheduled by work stealing */
+  bool work_stealing_;
   /*! \brief number of concurrent thread cpu worker uses */
   int cpu_worker_nthreads_;
   /*! \brief number of concurrent thread each gpu worker uses */
   int gpu_worker_nthreads_;
   /*! \brief number of concurrent thread each gpu copy worker uses */
   int gpu_copy_nthreads_;
+  /*! \brief number of concurrent thread each gpu latency critical worker uses */
+  int gpu_priority_nthreads_;
+  /*! \brief number of concurrent thread each gpu prioritized worker uses */
+  int gpu_comm_nthreads_;
+  /*! \brief stream priority levels of the copies to and from each gpu */
+  int gpu_copy_to_priority_;
+  int gpu_copy_from_priority_;
+  /*! \brief stream priority level of the prioritized operations of each gpu */
+  int gpu_comm_priority_;
+  /*! \brief a stream priority level above all those of a device */
+  static constexpr int kMaxStreamPriority = 1 << 16;
   // cpu worker
   common::LazyAllocArray<ThreadWorkerBlock<kWorkerQueue> > cpu_normal_workers_;
+  // cpu worker with work stealing
+  common::LazyAllocArray<WorkStealingPool<OprBlock*> > cpu_steal_workers_;
+  // counters of the work stealing pools
+  common::LazyAllocArray<QueueStats> cpu_steal_stats_;
+  // counters of the async operations executed by the pusher threads
+  QueueStats pusher_stats_;
   // cpu priority worker
   std::unique_ptr<ThreadWorkerBlock<kPriorityQueue> > cpu_priority_worker_;
-  // workers doing normal works on GPU
-  common::LazyAllocArray<ThreadWorkerBlock<kWorkerQueue> > gpu_normal_workers_;
-  // workers doing copy works from/to GPU
-  common::LazyAllocArray<ThreadWorkerBlock<kCopyQueue> > gpu_copy_workers_;
+  // workers doing normal works on GPU, the ready operations on the critical path
+  // of an executor run first
+  common::LazyAllocArray<ThreadWorkerBlock<kGPUWorkerQueue> > gpu_normal_workers_;
+  // workers doing the latency critical works on GPU, on high priority streams
+  common::LazyAllocArray<ThreadWorkerBlock<kGPUWorkerQueue> > gpu_priority_workers_;
+  // workers doing the prioritized works on GPU, the reductions of the kvstores
+  common::LazyAllocArray<ThreadWorkerBlock<kGPUWorkerQueue> > gpu_comm_workers_;
+  // workers doing copy works to GPU
+  common::LazyAllocArray<ThreadWorkerBlock<kCopyQueue> > gpu_copy_to_workers_;
+  // workers doing copy works from GPU, to the host or another GPU
+  common::LazyAllocArray<ThreadWorkerBlock<kCopyQueue> > gpu_copy_from_workers_;
+  /*!
+   * \brief execute an operation taken from a queue, counting the busy time.
+   * \param run_ctx runtime context used to execute the function.
+   * \param opr_block the operation.
+   * \param stats the counters of the queue.
+   */
+  inline void Execute(RunContext run_ctx, OprBlock* opr_block, QueueStats* stats) {
+    const uint64_t start = Profiler::GetTimeInMicros();
+    if (opr_block->ctx.dev_mask() == cpu::kDevMask) {
+      common::CPUThreadBudget::Scope budget;
+      this->ExecuteOprBlock(run_ctx, opr_block);
+    } else {
+      this->ExecuteOprBlock(run_ctx, opr_block);
+    }
+    stats->busy_us.fetch_add(Profiler::GetTimeInMicros() - start, std::memory_order_relaxed);
+    stats->executed.fetch_add(1, std::memory_order_relaxed);
+  }
   /*!
    * \brief GPU worker that performs operations on a certain device.
    * \param dev_id The device id of the worker.
    * \param is_copy_worker whether the worker only do copy job
    * \param block The task block of the worker.
+   * \param priority how many levels its stream is above the lowest priority of the device,
+   *  at most the highest one.
    */
   template<dmlc::ConcurrentQueueType type>
   inline void GPUWorker(int dev_id,
                         bool is_copy_worker,
-                        ThreadWorkerBlock<type> *block) {
+                        ThreadWorkerBlock<type> *block,
+                        int priority = 0) {
     #if MXNET_USE_CUDA
     // allocate stream
     mshadow::SetDevice<gpu>(dev_id);
     RunContext run_ctx;
     mshadow::Stream<gpu> *stream;
-    if (is_copy_worker) {
-      stream = mshadow::NewStream<gpu>(false, false);
+    if (priority <= 0) {
+      stream = mshadow::NewStream<gpu>(!is_copy_worker,
+                                       !is_copy_worker && MXNET_USE_CUDNN != 0);
     } else {
-      stream = mshadow::NewStream<gpu>(true, MXNET_USE_CUDNN != 0);
+      // as mshadow::NewStream, with a priority, a smaller number is a higher priority
+      int least, greatest;
+      CUDA_CALL(cudaDeviceGetStreamPriorityRange(&least, &greatest));
+      const int value = least - std::min(priority, least - greatest);
+      stream = new mshadow::Stream<gpu>();
+      CUDA_CALL(cudaStreamCreateWithPriority(&stream->stream_, cudaStreamDefault, value));
+      if (!is_copy_worker) {
+        stream->CreateBlasHandle();
+#if MXNET_USE_CUDNN == 1
+        stream->CreateDnnHandle();
+#endif  // MXNET_USE_CUDNN
+      }
     }
     run_ctx.stream = stream;
     // execute task
     OprBlock* opr_block;
     auto* task_queue = &(block->task_queue);
     while (task_queue->Pop(&opr_block)) {
-      this->ExecuteOprBlock(run_ctx, opr_block);
+      this->Execute(run_ctx, opr_block, &block->stats);
     }
     // Catch exception for CUDA driver shutdown
     MSHADOW_CATCH_ERROR(mshadow::DeleteStream<gpu>(stream));
@@ -177,7 +387,7 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     // execute task
     OprBlock* opr_block;
     while (task_queue->Pop(&opr_block)) {
-      this->ExecuteOprBlock(run_ctx, opr_block);
+      this->Execute(run_ctx, opr_block, &block->stats);
     }
   }
 };
@@ -185,5 +395,9 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
 Engine *CreateThreadedEnginePerDevice() {
   return new ThreadedEnginePerDevice();
 }
+
+Engine *CreateThreadedEngineWorkStealing() {
+  return new ThreadedEnginePerDevice(true);
+}
 }  // namespace engine
 }  // namespace mxnet
@@ -0,0 +1,356 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file work_stealing_pool.h
+ * \brief Thread pool where each worker owns a lock-free deque,
+ *  and idle workers steal tasks from busy ones.
+ */
+#ifndef MXNET_ENGINE_WORK_STEALING_POOL_H_
+#define MXNET_ENGINE_WORK_STEALING_POOL_H_
+
+#include <dmlc/base.h>
+#include <dmlc/logging.h>
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "mxnet/base.h"
+#include "../common/thread_local.h"
+
+namespace mxnet {
+namespace engine {
+
+/*!
+ * \brief Chase-Lev work stealing deque.
+ *  The owner thread pushes and pops at the bottom,
+ *  other threads steal from the top.
+ *  Retired buffers are kept until destruction so that a concurrent
+ *  thief never reads from freed memory.
+ * \tparam T element type, must be trivially copyable (e.g. a pointer).
+ */
+template<typename T>
+class WorkStealingDeque {
+ public:
+  /*!
+   * \brief constructor
+   * \param log_capacity log2 of the initial capacity.
+   */
+  explicit WorkStealingDeque(size_t log_capacity = 8) {
+    array_.store(new Array(log_capacity), std::memory_order_relaxed);
+  }
+  ~WorkStealingDeque() {
+    delete array_.load(std::memory_order_relaxed);
+    for (Array* a : retired_) delete a;
+  }
+  /*!
+   * \brief push an element to the bottom, only called by the owner.
+   * \param value the element.
+   */
+  inline void Push(T value) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    Array* a = array_.load(std::memory_order_relaxed);
+    if (b - t > static_cast<int64_t>(a->size()) - 1) {
+      a = Grow(a, b, t);
+    }
+    a->put(b, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+  /*!
+   * \brief pop an element from the bottom, only called by the owner.
+   * \param out the output element.
+   * \return whether an element is popped.
+   */
+  inline bool Pop(T* out) {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Array* a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    bool ret = false;
+    if (t <= b) {
+      *out = a->get(b);
+      ret = true;
+      if (t == b) {
+        // last element, race against thieves.
+        if (!top_.compare_exchange_strong(t, t + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+          ret = false;
+        }
+        bottom_.store(b + 1, std::memory_order_relaxed);
+      }
+    } else {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return ret;
+  }
+  /*!
+   * \brief steal an element from the top, can be called by any thread.
+   * \param out the output element.
+   * \return whether an element is stolen.
+   */
+  inline bool Steal(T* out) {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t < b) {
+      Array* a = array_.load(std::memory_order_acquire);
+      T value = a->get(t);
+      if (!top_.compare_exchange_strong(t, t + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        return false;
+      }
+      *out = value;
+      return true;
+    }
+    return false;
+  }
+  /*! \return whether the deque looks empty, only a hint under concurrency */
+  inline bool Empty() const {
+    return bottom_.load(std::memory_order_relaxed) <=
+        top_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /*! \brief circular array of elements */
+  struct Array {
+    size_t log_size;
+    std::unique_ptr<std::atomic<T>[]> data;
+    explicit Array(size_t log_size)
+        : log_size(log_size), data(new std::atomic<T>[size_t(1) << log_size]) {}
+    inline size_t size() const {
+      return size_t(1) << log_size;
+    }
+    inline T get(int64_t i) const {
+      return data[static_cast<size_t>(i) & (size() - 1)].load(std::memory_order_relaxed);
+    }
+    inline void put(int64_t i, T value) {
+      data[static_cast<size_t>(i) & (size() - 1)].store(value, std::memory_order_relaxed);
+    }
+  };
+  /*! \brief double the capacity, called by owner only */
+  inline Array* Grow(Array* a, int64_t b, int64_t t) {
+    Array* grown = new Array(a->log_size + 1);
+    for (int64_t i = t; i < b; ++i) {
+      grown->put(i, a->get(i));
+    }
+    retired_.push_back(a);
+    array_.store(grown, std::memory_order_release);
+    return grown;
+  }
+  /*! \brief index of the top element, stolen from here */
+  std::atomic<int64_t> top_{0};
+  /*! \brief index past the bottom element, owned by the owner */
+  std::atomic<int64_t> bottom_{0};
+  /*! \brief current array */
+  std::atomic<Array*> array_;
+  /*! \brief retired arrays, only touched by owner */
+  std::vector<Array*> retired_;
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingDeque);
+};
+
+/*!
+ * \brief A thread pool that schedules tasks with work stealing.
+ *
+ *  - Tasks pushed by a worker of this pool go to its own deque.
+ *  - Tasks pushed by other threads are spread round-robin into
+ *    per-worker inboxes, so pushers do not contend on a single lock.
+ *  - Tasks with non-zero priority go to a shared priority queue.
+ *    Positive priority tasks are taken before the deques and negative
+ *    ones only after no priority zero task can be found.
+ *  - Idle workers steal from others, spin shortly, then park.
+ *
+ * \tparam T the task type, usually OprBlock*.
+ */
+template<typename T>
+class WorkStealingPool {
+ public:
+  /*!
+   * \brief constructor
+   * \param size number of worker threads.
+   * \param exec function that executes one task.
+   * \param on_start function called by each worker thread when it starts, can be empty.
+   */
+  WorkStealingPool(size_t size, std::function<void(T)> exec,
+                   std::function<void()> on_start = nullptr)
+      : exec_(exec), on_start_(on_start) {
+    CHECK_GT(size, 0U);
+    workers_.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      workers_.emplace_back(new Worker());
+    }
+    threads_.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      threads_.emplace_back([this, i]() { this->WorkerLoop(i); });
+    }
+  }
+  ~WorkStealingPool() noexcept(false) {
+    {
+      std::lock_guard<std::mutex> lock(park_mutex_);
+      kill_.store(true);
+    }
+    park_cv_.notify_all();
+    for (auto& t : threads_) t.join();
+  }
+  /*!
+   * \brief push a task into the pool.
+   * \param task the task.
+   * \param priority priority of the task, larger runs first.
+   */
+  inline void Push(T task, int priority) {
+    if (priority != 0) {
+      std::lock_guard<std::mutex> lock(prio_mutex_);
+      prio_queue_.push(PrioEntry{priority, prio_seq_++, task});
+      prio_size_.fetch_add(1);
+    } else if (tls_pool_ == this) {
+      workers_[tls_index_]->deque.Push(task);
+    } else {
+      size_t i = next_inbox_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+      Worker* w = workers_[i].get();
+      std::lock_guard<std::mutex> lock(w->inbox_mutex);
+      w->inbox.push_back(task);
+    }
+    queued_.fetch_add(1);
+    if (num_parked_.load() != 0) {
+      std::lock_guard<std::mutex> lock(park_mutex_);
+      park_cv_.notify_one();
+    }
+  }
+
+ private:
+  /*! \brief entry in the shared priority queue */
+  struct PrioEntry {
+    int priority;
+    uint64_t seq;
+    T task;
+    inline bool operator<(const PrioEntry& other) const {
+      // FIFO among same priority
+      return priority < other.priority ||
+          (priority == other.priority && seq > other.seq);
+    }
+  };
+  /*! \brief per worker state */
+  struct Worker {
+    WorkStealingDeque<T> deque;
+    std::mutex inbox_mutex;
+    std::deque<T> inbox;
+  };
+  /*! \brief number of spin rounds before a worker parks */
+  static constexpr int kSpinRounds = 64;
+  /*!
+   * \brief try to take a task from the priority queue
+   * \param positive_only only take the task if its priority is positive.
+   * \param out the output task.
+   */
+  inline bool TryPopPriority(bool positive_only, T* out) {
+    if (prio_size_.load() == 0) return false;
+    std::lock_guard<std::mutex> lock(prio_mutex_);
+    if (prio_queue_.empty()) return false;
+    if (positive_only && prio_queue_.top().priority <= 0) return false;
+    *out = prio_queue_.top().task;
+    prio_queue_.pop();
+    prio_size_.fetch_sub(1);
+    return true;
+  }
+  /*! \brief try to take a task from an inbox */
+  inline bool TryPopInbox(Worker* w, bool block, T* out) {
+    std::unique_lock<std::mutex> lock(w->inbox_mutex, std::defer_lock);
+    if (block) {
+      lock.lock();
+    } else if (!lock.try_lock()) {
+      return false;
+    }
+    if (w->inbox.empty()) return false;
+    *out = w->inbox.front();
+    w->inbox.pop_front();
+    return true;
+  }
+  /*! \brief find a task for worker i */
+  inline bool TryGet(size_t i, T* out) {
+    if (TryPopPriority(true, out)) return true;
+    Worker* self = workers_[i].get();
+    if (self->deque.Pop(out)) return true;
+    if (TryPopInbox(self, true, out)) return true;
+    const size_t n = workers_.size();
+    for (size_t k = 1; k < n; ++k) {
+      Worker* victim = workers_[(i + k) % n].get();
+      if (victim->deque.Steal(out)) return true;
+      if (TryPopInbox(victim, false, out)) return true;
+    }
+    return TryPopPriority(false, out);
+  }
+  /*! \brief main loop of worker i */
+  inline void WorkerLoop(size_t i) {
+    if (on_start_) on_start_();
+    tls_pool_ = this;
+    tls_index_ = i;
+    T task;
+    while (!kill_.load()) {
+      bool found = false;
+      for (int spin = 0; spin < kSpinRounds && !found; ++spin) {
+        found = TryGet(i, &task);
+        if (!found) {
+          if (queued_.load() == 0) break;
+          std::this_thread::yield();
+        }
+      }
+      if (found) {
+        queued_.fetch_sub(1);
+        exec_(task);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(park_mutex_);
+      num_parked_.fetch_add(1);
+      park_cv_.wait(lock, [this]() {
+          return queued_.load() != 0 || kill_.load();
+        });
+      num_parked_.fetch_sub(1);
+    }
+    tls_pool_ = nullptr;
+  }
+  /*! \brief the pool the current thread works for */
+  static MX_TREAD_LOCAL WorkStealingPool<T>* tls_pool_;
+  /*! \brief index of current thread in the pool */
+  static MX_TREAD_LOCAL size_t tls_index_;
+  /*! \brief execution function */
+  std::function<void(T)> exec_;
+  /*! \brief start function of workers */
+  std::function<void()> on_start_;
+  /*! \brief workers */
+  std::vector<std::unique_ptr<Worker> > workers_;
+  /*! \brief threads */
+  std::vector<std::thread> threads_;
+  /*! \brief number of tasks pushed but not yet taken */
+  std::atomic<int64_t> queued_{0};
+  /*! \brief round-robin counter for external pushes */
+  std::atomic<size_t> next_inbox_{0};
+  /*! \brief prioritized tasks */
+  std::mutex prio_mutex_;
+  std::priority_queue<PrioEntry> prio_queue_;
+  uint64_t prio_seq_{0};
+  std::atomic<size_t> prio_size_{0};
+  /*! \brief parking of idle workers */
+  std::mutex park_mutex_;
+  std::condition_variable park_cv_;
+  std::atomic<int> num_parked_{0};
+  std::atomic<bool> kill_{false};
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingPool);
+};
+
+template<typename T>
+MX_TREAD_LOCAL WorkStealingPool<T>* WorkStealingPool<T>::tls_pool_ = nullptr;
+template<typename T>
+MX_TREAD_LOCAL size_t WorkStealingPool<T>::tls_index_ = 0;
+
+}  // namespace engine
+}  // namespace mxnet
+#endif  // MXNET_ENGINE_WORK_STEALING_POOL_H_
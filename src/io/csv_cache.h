@@ -0,0 +1,243 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file csv_cache.h
+ * \brief binary cache of the parsed rows of CSVIter.
+ *
+ *  The rows are stored in groups of group_rows rows. A group holds the data
+ *  values of its rows, then their label values, each column aligned, and all
+ *  groups have the same size so that a group is found from its index. The
+ *  file starts with a header of kHeaderBytes, whose magic is written last, so
+ *  that a cache whose writing was interrupted is never read.
+ */
+#ifndef MXNET_IO_CSV_CACHE_H_
+#define MXNET_IO_CSV_CACHE_H_
+
+#include <dmlc/base.h>
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <mxnet/base.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+namespace csvcache {
+/*! \brief magic of a complete cache file */
+const uint64_t kMagic = 0x3168636163767363ULL;
+/*! \brief bytes of the header, the groups start at a page boundary */
+const size_t kHeaderBytes = 4096;
+/*! \brief alignment of the columns of a group */
+const size_t kAlign = 64;
+
+/*! \brief round up to multiple of kAlign */
+inline size_t RoundUp(size_t size) {
+  return (size + kAlign - 1) / kAlign * kAlign;
+}
+
+/*! \brief header of a cache file */
+struct Header {
+  uint64_t magic;
+  /*! \brief the number of rows */
+  uint64_t num_rows;
+  /*! \brief the number of data and label values of a row, 0 without label */
+  uint64_t data_size, label_size;
+  /*! \brief the number of rows of a group */
+  uint64_t group_rows;
+  /*! \brief the part of the csv files cached */
+  uint64_t part_index, num_parts;
+  /*! \return the bytes of the data column of a group */
+  inline size_t DataBytes() const {
+    return RoundUp(group_rows * data_size * sizeof(real_t));
+  }
+  /*! \return the bytes of a group */
+  inline size_t GroupBytes() const {
+    return DataBytes() + RoundUp(group_rows * label_size * sizeof(real_t));
+  }
+  /*! \return the number of groups */
+  inline size_t NumGroups() const {
+    return (num_rows + group_rows - 1) / group_rows;
+  }
+  /*! \return whether the cache is of the same rows */
+  inline bool Matches(const Header &other) const {
+    return data_size == other.data_size && label_size == other.label_size &&
+        group_rows == other.group_rows && part_index == other.part_index &&
+        num_parts == other.num_parts;
+  }
+};
+
+/*!
+ * \brief writer of a cache file. The rows go to a temporary file, renamed to
+ *  the cache file by Finish, and removed if the writer is destroyed before.
+ */
+class Writer {
+ public:
+  /*! \param header the layout of the cache, num_rows is counted by Append */
+  Writer(const std::string &path, const Header &header)
+      : path_(path), tmp_path_(path + ".tmp"), header_(header) {
+    header_.magic = 0;
+    header_.num_rows = 0;
+    fp_ = std::fopen(tmp_path_.c_str(), "wb");
+    CHECK(fp_ != nullptr) << "cannot write the csv cache " << tmp_path_;
+    std::vector<char> zeros(kHeaderBytes, 0);
+    this->Write(dmlc::BeginPtr(zeros), zeros.size());
+    group_.resize(header_.GroupBytes());
+  }
+  ~Writer() {
+    if (fp_ != nullptr) {
+      std::fclose(fp_);
+      std::remove(tmp_path_.c_str());
+    }
+  }
+  /*! \brief append a row, label is ignored without label values */
+  inline void Append(const real_t *data, const real_t *label) {
+    const size_t row = header_.num_rows++ % header_.group_rows;
+    std::memcpy(&group_[row * header_.data_size * sizeof(real_t)], data,
+                header_.data_size * sizeof(real_t));
+    if (header_.label_size != 0) {
+      std::memcpy(&group_[header_.DataBytes() + row * header_.label_size * sizeof(real_t)],
+                  label, header_.label_size * sizeof(real_t));
+    }
+    if (row + 1 == header_.group_rows) this->FlushGroup();
+  }
+  /*! \brief write the last group and the header, and rename to the cache file */
+  inline void Finish() {
+    if (header_.num_rows % header_.group_rows != 0) this->FlushGroup();
+    header_.magic = kMagic;
+    CHECK_EQ(std::fseek(fp_, 0, SEEK_SET), 0) << "cannot write the csv cache " << tmp_path_;
+    this->Write(&header_, sizeof(header_));
+    CHECK_EQ(std::fclose(fp_), 0) << "cannot write the csv cache " << tmp_path_;
+    fp_ = nullptr;
+    CHECK_EQ(std::rename(tmp_path_.c_str(), path_.c_str()), 0)
+        << "cannot rename " << tmp_path_ << " to " << path_;
+    LOG(INFO) << "cached " << header_.num_rows << " csv rows in " << path_;
+  }
+
+ private:
+  std::string path_, tmp_path_;
+  Header header_;
+  std::FILE *fp_;
+  /*! \brief the group being filled */
+  std::vector<char> group_;
+
+  inline void Write(const void *ptr, size_t size) {
+    CHECK_EQ(std::fwrite(ptr, 1, size, fp_), size)
+        << "cannot write the csv cache " << tmp_path_;
+  }
+  inline void FlushGroup() {
+    this->Write(dmlc::BeginPtr(group_), group_.size());
+    std::fill(group_.begin(), group_.end(), 0);
+  }
+};
+
+/*! \brief reader of a memory mapped cache file */
+class Reader {
+ public:
+  /*!
+   * \brief open a complete cache file of the same layout as expected
+   * \return nullptr if there is none
+   */
+  static Reader *Open(const std::string &path, const Header &expected) {
+    std::unique_ptr<Reader> reader(new Reader());
+    if (!reader->Map(path)) return nullptr;
+    if (reader->size_ < kHeaderBytes) return nullptr;
+    std::memcpy(&reader->header_, reader->data_, sizeof(Header));
+    const Header &h = reader->header_;
+    if (h.magic != kMagic || !h.Matches(expected)) {
+      LOG(INFO) << "ignore the csv cache " << path << " of other rows";
+      return nullptr;
+    }
+    CHECK_EQ(reader->size_, kHeaderBytes + h.NumGroups() * h.GroupBytes())
+        << "truncated csv cache " << path;
+    return reader.release();
+  }
+  ~Reader() {
+#if !defined(_WIN32)
+    if (data_ != nullptr) munmap(data_, size_);
+#endif
+  }
+  /*! \return the header */
+  inline const Header &header() const {
+    return header_;
+  }
+  /*! \return the number of rows of a group */
+  inline size_t GroupSize(size_t group) const {
+    return std::min<size_t>(header_.group_rows, header_.num_rows - group * header_.group_rows);
+  }
+  /*! \return the data values of a row of a group */
+  inline real_t *Data(size_t group, size_t row) const {
+    return reinterpret_cast<real_t*>(this->Group(group)) + row * header_.data_size;
+  }
+  /*! \return the label values of a row of a group */
+  inline real_t *Label(size_t group, size_t row) const {
+    return reinterpret_cast<real_t*>(this->Group(group) + header_.DataBytes()) +
+        row * header_.label_size;
+  }
+  /*! \brief ask the os to read the pages of a group */
+  inline void Prefetch(size_t group) const {
+#if !defined(_WIN32)
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const size_t begin = this->Group(group) - data_, start = begin / page * page;
+    madvise(data_ + start, begin + header_.GroupBytes() - start, MADV_WILLNEED);
+#endif
+  }
+
+ private:
+  Header header_;
+  /*! \brief the file */
+  char *data_{nullptr};
+  size_t size_{0};
+  /*! \brief the file content when mmap is not available */
+  std::string content_;
+
+  inline char *Group(size_t group) const {
+    return data_ + kHeaderBytes + group * header_.GroupBytes();
+  }
+  // map the file, return false if it cannot be opened
+  inline bool Map(const std::string &path) {
+#if !defined(_WIN32)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+    struct stat st;
+    CHECK_EQ(fstat(fd, &st), 0) << "cannot stat " << path;
+    size_ = st.st_size;
+    if (size_ == 0) {
+      close(fd);
+      return true;
+    }
+    void *addr = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    CHECK(addr != MAP_FAILED) << "cannot mmap " << path;
+    data_ = static_cast<char*>(addr);
+#else
+    std::FILE *fp = std::fopen(path.c_str(), "rb");
+    if (fp == nullptr) return false;
+    const size_t kBufferSize = 1 << 20UL;
+    size_t nread;
+    do {
+      const size_t begin = content_.size();
+      content_.resize(begin + kBufferSize);
+      nread = std::fread(&content_[begin], 1, kBufferSize, fp);
+      content_.resize(begin + nread);
+    } while (nread != 0);
+    std::fclose(fp);
+    data_ = &content_[0];
+    size_ = content_.size();
+#endif
+    return true;
+  }
+};
+}  // namespace csvcache
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_CSV_CACHE_H_
@@ -7,6 +7,7 @@
 #include <utility>
 #include <string>
 #include <algorithm>
+#include <cfloat>
 #include <vector>
 #include "./image_augmenter.h"
 #include "../common/utils.h"
@@ -289,7 +290,7 @@ class DefaultImageAugmenter : public ImageAugmenter {
     return res;
   }
 
- private:
+ protected:
   // temporal space
   cv::Mat temp_;
   // rotation param
@@ -300,6 +301,250 @@ class DefaultImageAugmenter : public ImageAugmenter {
   std::vector<int> rotate_list_;
 };
 
+/*!
+ * \brief augmenter doing the affine transform, the padding, the crop and the resize
+ *  of aug_default in a single pass over the output image, with the HSL jitter in
+ *  the same loop. It draws the same random numbers as aug_default, only the nearest
+ *  and the bilinear interpolations are supported.
+ */
+class FusedImageAugmenter : public DefaultImageAugmenter {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    DefaultImageAugmenter::Init(kwargs);
+    CHECK(param_.inter_method == 0 || param_.inter_method == 1)
+        << "aug_fused supports inter_method 0 (nearest) and 1 (bilinear)";
+  }
+  cv::Mat Process(const cv::Mat &src,
+                  common::RANDOM_ENGINE *prnd) override {
+    using mshadow::index_t;
+    CHECK(src.type() == CV_8UC3 || src.type() == CV_8UC1)
+        << "aug_fused supports 8-bit images of 1 or 3 channels";
+    std::uniform_real_distribution<float> rand_uniform(0, 1);
+    // the map from the output pixels to the source pixels, src(T * (x, y, 1))
+    float T[2][3] = {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}};
+    int width = src.cols, height = src.rows;
+    if (param_.max_rotate_angle > 0 || param_.max_shear_ratio > 0.0f
+        || param_.rotate > 0 || rotate_list_.size() > 0 || param_.max_random_scale != 1.0
+        || param_.min_random_scale != 1.0 || param_.max_aspect_ratio != 0.0f
+        || param_.max_img_size != 1e10f || param_.min_img_size != 0.0f) {
+      float s = rand_uniform(*prnd) * param_.max_shear_ratio * 2 - param_.max_shear_ratio;
+      int angle = std::uniform_int_distribution<int>(
+          -param_.max_rotate_angle, param_.max_rotate_angle)(*prnd);
+      if (param_.rotate > 0) angle = param_.rotate;
+      if (rotate_list_.size() > 0) {
+        angle = rotate_list_[std::uniform_int_distribution<int>(0, rotate_list_.size() - 1)(*prnd)];
+      }
+      float a = cos(angle / 180.0 * M_PI);
+      float b = sin(angle / 180.0 * M_PI);
+      float scale = rand_uniform(*prnd) *
+          (param_.max_random_scale - param_.min_random_scale) + param_.min_random_scale;
+      float ratio = rand_uniform(*prnd) *
+          param_.max_aspect_ratio * 2 - param_.max_aspect_ratio + 1;
+      float hs = 2 * scale / (1 + ratio);
+      float ws = ratio * hs;
+      float new_width = std::max(param_.min_img_size,
+                                 std::min(param_.max_img_size, scale * src.cols));
+      float new_height = std::max(param_.min_img_size,
+                                  std::min(param_.max_img_size, scale * src.rows));
+      // the transform of warpAffine in aug_default
+      float m00 = hs * a - s * b * ws, m01 = hs * b + s * a * ws;
+      float m10 = -b * ws, m11 = a * ws;
+      float m02 = (new_width - (m00 * src.cols + m01 * src.rows)) / 2;
+      float m12 = (new_height - (m10 * src.cols + m11 * src.rows)) / 2;
+      float det = m00 * m11 - m01 * m10;
+      CHECK_NE(det, 0.0f) << "singular affine transform";
+      T[0][0] = m11 / det;
+      T[0][1] = -m01 / det;
+      T[0][2] = (m01 * m12 - m11 * m02) / det;
+      T[1][0] = -m10 / det;
+      T[1][1] = m00 / det;
+      T[1][2] = (m10 * m02 - m00 * m12) / det;
+      width = static_cast<int>(new_width);
+      height = static_cast<int>(new_height);
+    }
+    // the padding shifts the image
+    const int pad = std::max(param_.pad, 0);
+    const int canvas_width = width, canvas_height = height;
+    for (int i = 0; i < 2; ++i) T[i][2] -= pad * (T[i][0] + T[i][1]);
+    width += 2 * pad;
+    height += 2 * pad;
+    // the crop, resized to the output shape with a crop size
+    const int out_width = param_.data_shape[2], out_height = param_.data_shape[1];
+    float kx = 1.0f, ky = 1.0f, ox, oy;
+    if (param_.max_crop_size != -1 || param_.min_crop_size != -1) {
+      CHECK(width >= param_.max_crop_size && height >= param_.max_crop_size &&
+            param_.max_crop_size >= param_.min_crop_size)
+          << "input image size smaller than max_crop_size";
+      index_t crop_size =
+          std::uniform_int_distribution<index_t>(param_.min_crop_size, param_.max_crop_size)(*prnd);
+      index_t y = height - crop_size;
+      index_t x = width - crop_size;
+      if (param_.rand_crop != 0) {
+        y = std::uniform_int_distribution<index_t>(0, y)(*prnd);
+        x = std::uniform_int_distribution<index_t>(0, x)(*prnd);
+      } else {
+        y /= 2; x /= 2;
+      }
+      // pixel centers are aligned, as cv::resize
+      kx = static_cast<float>(crop_size) / out_width;
+      ky = static_cast<float>(crop_size) / out_height;
+      ox = x + 0.5f * kx - 0.5f;
+      oy = y + 0.5f * ky - 0.5f;
+    } else {
+      CHECK(height >= out_height && width >= out_width)
+          << "input image size smaller than input shape";
+      index_t y = height - out_height;
+      index_t x = width - out_width;
+      if (param_.rand_crop != 0) {
+        y = std::uniform_int_distribution<index_t>(0, y)(*prnd);
+        x = std::uniform_int_distribution<index_t>(0, x)(*prnd);
+      } else {
+        y /= 2; x /= 2;
+      }
+      ox = x;
+      oy = y;
+    }
+    // the output pixels in the padding are filled
+    Range(pad, canvas_width, kx, ox, out_width, &x_begin_, &x_end_);
+    Range(pad, canvas_height, ky, oy, out_height, &y_begin_, &y_end_);
+    for (int i = 0; i < 2; ++i) {
+      T[i][2] += T[i][0] * ox + T[i][1] * oy;
+      T[i][0] *= kx;
+      T[i][1] *= ky;
+    }
+    // color space augmentation
+    float jitter[3] = {0.0f, 0.0f, 0.0f};
+    const bool color = src.channels() == 3 &&
+        (param_.random_h != 0 || param_.random_s != 0 || param_.random_l != 0);
+    if (param_.random_h != 0 || param_.random_s != 0 || param_.random_l != 0) {
+      int h = rand_uniform(*prnd) * param_.random_h * 2 - param_.random_h;
+      int s = rand_uniform(*prnd) * param_.random_s * 2 - param_.random_s;
+      int l = rand_uniform(*prnd) * param_.random_l * 2 - param_.random_l;
+      // in degrees and in [0, 1], h of 8-bit images is in half degrees
+      jitter[0] = h * 2.0f;
+      jitter[1] = l / 255.0f;
+      jitter[2] = s / 255.0f;
+    }
+    out_.create(out_height, out_width, src.type());
+    const int nchannel = src.channels();
+    for (int y = 0; y < out_height; ++y) {
+      float sx = T[0][1] * y + T[0][2];
+      float sy = T[1][1] * y + T[1][2];
+      uint8_t *dst = out_.ptr<uint8_t>(y);
+      for (int x = 0; x < out_width; ++x, sx += T[0][0], sy += T[1][0], dst += nchannel) {
+        if (y < y_begin_ || y >= y_end_ || x < x_begin_ || x >= x_end_) {
+          for (int k = 0; k < nchannel; ++k) dst[k] = param_.fill_value;
+        } else if (param_.inter_method == 0) {
+          this->Nearest(src, sx, sy, dst);
+        } else {
+          this->Bilinear(src, sx, sy, dst);
+        }
+        if (color) JitterHLS(dst, jitter);
+      }
+    }
+    return out_;
+  }
+
+ private:
+  // the output image
+  cv::Mat out_;
+  // the output pixels [begin, end) of the image before padding, in each dimension
+  int x_begin_, x_end_, y_begin_, y_end_;
+
+  // the output pixels i in the padded image at k * i + o, not in the padding
+  static inline void Range(int pad, int size, float k, float o, int out_size,
+                           int *begin, int *end) {
+    *begin = std::max(0, static_cast<int>(std::ceil((pad - 0.5f - o) / k)));
+    *end = std::min(out_size, static_cast<int>(std::ceil((pad + size - 0.5f - o) / k)));
+  }
+
+  // the fill value of a source pixel out of the image
+  inline const uint8_t *Pixel(const cv::Mat &src, int x, int y, const uint8_t *fill) const {
+    if (x < 0 || y < 0 || x >= src.cols || y >= src.rows) return fill;
+    return src.ptr<uint8_t>(y) + x * src.channels();
+  }
+  inline void Nearest(const cv::Mat &src, float sx, float sy, uint8_t *dst) const {
+    const uint8_t fill[3] = {static_cast<uint8_t>(param_.fill_value),
+                             static_cast<uint8_t>(param_.fill_value),
+                             static_cast<uint8_t>(param_.fill_value)};
+    const uint8_t *p = this->Pixel(src, static_cast<int>(std::floor(sx + 0.5f)),
+                                   static_cast<int>(std::floor(sy + 0.5f)), fill);
+    for (int k = 0; k < src.channels(); ++k) dst[k] = p[k];
+  }
+  inline void Bilinear(const cv::Mat &src, float sx, float sy, uint8_t *dst) const {
+    const int nchannel = src.channels();
+    const int x0 = static_cast<int>(std::floor(sx)), y0 = static_cast<int>(std::floor(sy));
+    const float fx = sx - x0, fy = sy - y0;
+    const float w00 = (1 - fx) * (1 - fy), w01 = fx * (1 - fy);
+    const float w10 = (1 - fx) * fy, w11 = fx * fy;
+    const uint8_t *p00, *p01, *p10, *p11;
+    if (x0 >= 0 && y0 >= 0 && x0 + 1 < src.cols && y0 + 1 < src.rows) {
+      p00 = src.ptr<uint8_t>(y0) + x0 * nchannel;
+      p01 = p00 + nchannel;
+      p10 = src.ptr<uint8_t>(y0 + 1) + x0 * nchannel;
+      p11 = p10 + nchannel;
+      for (int k = 0; k < nchannel; ++k) {
+        dst[k] = cv::saturate_cast<uint8_t>(
+            w00 * p00[k] + w01 * p01[k] + w10 * p10[k] + w11 * p11[k]);
+      }
+      return;
+    }
+    const uint8_t fill[3] = {static_cast<uint8_t>(param_.fill_value),
+                             static_cast<uint8_t>(param_.fill_value),
+                             static_cast<uint8_t>(param_.fill_value)};
+    p00 = this->Pixel(src, x0, y0, fill);
+    p01 = this->Pixel(src, x0 + 1, y0, fill);
+    p10 = this->Pixel(src, x0, y0 + 1, fill);
+    p11 = this->Pixel(src, x0 + 1, y0 + 1, fill);
+    for (int k = 0; k < nchannel; ++k) {
+      dst[k] = cv::saturate_cast<uint8_t>(
+          w00 * p00[k] + w01 * p01[k] + w10 * p10[k] + w11 * p11[k]);
+    }
+  }
+  // component of the rgb color of hue t, in [0, 1)
+  static inline float HueToRGB(float p, float q, float t) {
+    if (t < 0.0f) t += 1.0f;
+    if (t >= 1.0f) t -= 1.0f;
+    if (t < 1.0f / 6) return p + (q - p) * 6 * t;
+    if (t < 0.5f) return q;
+    if (t < 2.0f / 3) return p + (q - p) * (2.0f / 3 - t) * 6;
+    return p;
+  }
+  // add (h, l, s) to the color of a bgr pixel, clipped as aug_default
+  static inline void JitterHLS(uint8_t *bgr, const float jitter[3]) {
+    const float b = bgr[0] / 255.0f, g = bgr[1] / 255.0f, r = bgr[2] / 255.0f;
+    const float vmax = std::max(r, std::max(g, b)), vmin = std::min(r, std::min(g, b));
+    const float diff = vmax - vmin;
+    float h = 0.0f, l = (vmax + vmin) / 2, s = 0.0f;
+    if (diff > FLT_EPSILON) {
+      s = l < 0.5f ? diff / (vmax + vmin) : diff / (2 - vmax - vmin);
+      if (vmax == r) {
+        h = (g - b) * 60 / diff;
+      } else if (vmax == g) {
+        h = (b - r) * 60 / diff + 120;
+      } else {
+        h = (r - g) * 60 / diff + 240;
+      }
+      if (h < 0) h += 360;
+    }
+    h = std::max(0.0f, std::min(360.0f, h + jitter[0]));
+    l = std::max(0.0f, std::min(1.0f, l + jitter[1]));
+    s = std::max(0.0f, std::min(1.0f, s + jitter[2]));
+    float rgb[3] = {l, l, l};
+    if (s != 0.0f) {
+      const float q = l < 0.5f ? l * (1 + s) : l + s - l * s;
+      const float p = 2 * l - q;
+      const float t = h / 360;
+      rgb[0] = HueToRGB(p, q, t + 1.0f / 3);
+      rgb[1] = HueToRGB(p, q, t);
+      rgb[2] = HueToRGB(p, q, t - 1.0f / 3);
+    }
+    bgr[0] = cv::saturate_cast<uint8_t>(rgb[2] * 255.0f);
+    bgr[1] = cv::saturate_cast<uint8_t>(rgb[1] * 255.0f);
+    bgr[2] = cv::saturate_cast<uint8_t>(rgb[0] * 255.0f);
+  }
+};
+
 ImageAugmenter* ImageAugmenter::Create(const std::string& name) {
   return dmlc::Registry<ImageAugmenterReg>::Find(name)->body();
 }
@@ -309,6 +554,12 @@ MXNET_REGISTER_IMAGE_AUGMENTER(aug_default)
 .set_body([]() {
     return new DefaultImageAugmenter();
   });
+
+MXNET_REGISTER_IMAGE_AUGMENTER(aug_fused)
+.describe("single pass version of aug_default, with nearest or bilinear interpolation")
+.set_body([]() {
+    return new FusedImageAugmenter();
+  });
 #endif  // MXNET_USE_OPENCV
 }  // namespace io
 }  // namespace mxnet
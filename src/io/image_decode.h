@@ -0,0 +1,86 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file image_decode.h
+ * \brief decoding of the images of the records at a reduced size.
+ *
+ *  libjpeg decodes a JPEG at 1/2, 1/4 or 1/8 of its size in the DCT domain,
+ *  for a fraction of the cost of the full decode, which OpenCV exposes by the
+ *  IMREAD_REDUCED flags of imdecode. The size of the image is read from its
+ *  frame header to choose the largest reduction keeping the shorter edge.
+ */
+#ifndef MXNET_IO_IMAGE_DECODE_H_
+#define MXNET_IO_IMAGE_DECODE_H_
+
+#if MXNET_USE_OPENCV
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+
+namespace mxnet {
+namespace io {
+/*!
+ * \brief read the size and the number of components of a JPEG from its frame header
+ * \return false if it is not a JPEG or has no frame header
+ */
+inline bool JpegInfo(const unsigned char *p, size_t size, int *rows, int *cols,
+                     int *components) {
+  if (size < 4 || p[0] != 0xFF || p[1] != 0xD8) return false;
+  size_t pos = 2;
+  while (pos + 4 <= size) {
+    if (p[pos] != 0xFF) return false;
+    const int marker = p[pos + 1];
+    if (marker == 0xFF) {  // fill byte
+      ++pos;
+      continue;
+    }
+    const size_t len = (p[pos + 2] << 8) | p[pos + 3];
+    // SOF0 to SOF15, except DHT, JPG and DAC
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+        marker != 0xCC) {
+      if (pos + 10 > size) return false;
+      *rows = (p[pos + 5] << 8) | p[pos + 6];
+      *cols = (p[pos + 7] << 8) | p[pos + 8];
+      *components = p[pos + 9];
+      return *rows > 0 && *cols > 0;
+    }
+    // the scan data comes after the frame header
+    if (marker == 0xDA || marker == 0xD9) return false;
+    pos += 2 + len;
+  }
+  return false;
+}
+
+/*!
+ * \brief decode an encoded image, keeping its number of channels as imdecode(buf, -1).
+ *  A JPEG whose shorter edge is at least min_edge is decoded at the largest
+ *  reduction of libjpeg whose shorter edge is still at least min_edge.
+ * \param min_edge the shorter edge to keep, no reduction if <= 0
+ */
+inline cv::Mat DecodeImage(const cv::Mat &buf, int min_edge) {
+#if CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 1)
+  int rows, cols, components;
+  if (min_edge > 0 && JpegInfo(buf.ptr<unsigned char>(), buf.total(), &rows, &cols,
+                               &components) && (components == 1 || components == 3)) {
+    const int edge = std::min(rows, cols);
+    for (int scale = 8; scale > 1; scale /= 2) {
+      // libjpeg rounds the reduced size up
+      if ((edge + scale - 1) / scale < min_edge) continue;
+      int flag;
+      if (scale == 8) {
+        flag = components == 1 ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+      } else if (scale == 4) {
+        flag = components == 1 ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+      } else {
+        flag = components == 1 ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+      }
+      cv::Mat res = cv::imdecode(buf, flag);
+      if (!res.empty()) return res;
+      break;
+    }
+  }
+#endif
+  return cv::imdecode(buf, -1);
+}
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_USE_OPENCV
+#endif  // MXNET_IO_IMAGE_DECODE_H_
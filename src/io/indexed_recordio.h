@@ -0,0 +1,212 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file indexed_recordio.h
+ * \brief random access reader of a recordio file given its index file.
+ *
+ *  The index file has one line "key\toffset" per record, offset is the
+ *  position of the record in the recordio file. It is written by im2rec with
+ *  index=1 and by mxnet.recordio.MXIndexedRecordIO.
+ */
+#ifndef MXNET_IO_INDEXED_RECORDIO_H_
+#define MXNET_IO_INDEXED_RECORDIO_H_
+
+#include <dmlc/base.h>
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/recordio.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../common/utils.h"
+
+namespace mxnet {
+namespace io {
+/*!
+ * \brief reader of the records of a recordio file in any order.
+ *
+ *  The file is memory mapped, records are returned without copy unless they
+ *  were split by the writer. The pages of the next chunk are prefetched while
+ *  the current one is parsed.
+ */
+class IndexedRecordIOReader {
+ public:
+  /*!
+   * \param path_rec path of the local recordio file
+   * \param path_idx path of its index file
+   * \param part_index the part to read, the records are split by index order
+   * \param num_parts the number of parts
+   * \param chunk_size the approximate number of bytes of a chunk
+   */
+  IndexedRecordIOReader(const std::string &path_rec, const std::string &path_idx,
+                        int part_index, int num_parts, size_t chunk_size)
+      : chunk_size_(chunk_size), ptr_(0), data_(nullptr), size_(0) {
+    this->LoadIndex(path_idx, part_index, num_parts);
+    this->Map(path_rec);
+  }
+
+  ~IndexedRecordIOReader() {
+#if !defined(_WIN32)
+    if (data_ != nullptr) munmap(data_, size_);
+#endif
+  }
+  /*! \return the number of records of this part */
+  inline size_t NumRecords() const {
+    return records_.size();
+  }
+  /*!
+   * \brief restart from the first record
+   * \param prnd random permutation of the records if not NULL, otherwise the file order
+   */
+  inline void BeforeFirst(common::RANDOM_ENGINE *prnd) {
+    order_.resize(records_.size());
+    for (size_t i = 0; i < order_.size(); ++i) order_[i] = i;
+    if (prnd != nullptr) std::shuffle(order_.begin(), order_.end(), *prnd);
+    ptr_ = 0;
+    this->Prefetch(ptr_);
+  }
+  /*!
+   * \brief get the records of the next chunk
+   * \param out the ids of the records, to give to Record
+   * \return false if all the records were read
+   */
+  inline bool NextChunk(std::vector<size_t> *out) {
+    out->clear();
+    size_t nbytes = 0;
+    while (ptr_ < order_.size() && (out->size() == 0 || nbytes < chunk_size_)) {
+      out->push_back(order_[ptr_]);
+      nbytes += records_[order_[ptr_]].second;
+      ++ptr_;
+    }
+    this->Prefetch(ptr_);
+    return out->size() != 0;
+  }
+  /*!
+   * \brief get the content of a record, thread safe.
+   * \param id the record id
+   * \param out the content
+   * \param buf space to assemble a record split by the writer
+   */
+  inline void Record(size_t id, dmlc::InputSplit::Blob *out, std::string *buf) const {
+    const char *p = data_ + records_[id].first;
+    const char *end = p + records_[id].second;
+    buf->clear();
+    while (true) {
+      CHECK(p + 2 * sizeof(uint32_t) <= end) << "invalid recordio index";
+      uint32_t header[2];
+      std::memcpy(header, p, sizeof(header));
+      CHECK_EQ(header[0], dmlc::RecordIOWriter::kMagic) << "invalid recordio index";
+      const uint32_t cflag = dmlc::RecordIOWriter::DecodeFlag(header[1]);
+      const uint32_t len = dmlc::RecordIOWriter::DecodeLength(header[1]);
+      const char *content = p + sizeof(header);
+      CHECK(content + len <= end) << "invalid recordio index";
+      if (cflag == 0) {
+        out->dptr = const_cast<char*>(content);
+        out->size = len;
+        return;
+      }
+      // the parts are separated by the magic number which they contained
+      if (cflag != 1) {
+        const uint32_t magic = dmlc::RecordIOWriter::kMagic;
+        buf->append(reinterpret_cast<const char*>(&magic), sizeof(magic));
+      }
+      buf->append(content, len);
+      if (cflag == 3) break;
+      p = content + ((len + 3U) & ~3U);
+    }
+    out->dptr = &(*buf)[0];
+    out->size = buf->size();
+  }
+
+ private:
+  /*! \brief approximate number of bytes of a chunk */
+  size_t chunk_size_;
+  /*! \brief (offset, maximum size) of each record of this part */
+  std::vector<std::pair<size_t, size_t> > records_;
+  /*! \brief order of the records in this pass */
+  std::vector<size_t> order_;
+  /*! \brief position in order_ */
+  size_t ptr_;
+  /*! \brief the mapped file */
+  char *data_;
+  /*! \brief size of the file */
+  size_t size_;
+  /*! \brief the file content when mmap is not available */
+  std::string content_;
+
+  inline void LoadIndex(const std::string &path_idx, int part_index, int num_parts) {
+    std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(path_idx.c_str(), "r"));
+    dmlc::istream is(fi.get());
+    std::vector<size_t> offsets;
+    size_t key, offset;
+    while (is >> key >> offset) offsets.push_back(offset);
+    CHECK_NE(offsets.size(), 0) << "empty recordio index " << path_idx;
+    const size_t begin = offsets.size() * part_index / num_parts;
+    const size_t end = offsets.size() * (part_index + 1) / num_parts;
+    for (size_t i = begin; i < end; ++i) {
+      records_.push_back(std::make_pair(offsets[i], size_t(0)));
+    }
+    // a record ends at most at the next offset in the file
+    std::sort(offsets.begin(), offsets.end());
+    for (auto &r : records_) {
+      auto next = std::upper_bound(offsets.begin(), offsets.end(), r.first);
+      r.second = next == offsets.end() ? 0 : *next - r.first;
+    }
+  }
+
+  inline void Map(const std::string &path_rec) {
+#if !defined(_WIN32)
+    int fd = open(path_rec.c_str(), O_RDONLY);
+    CHECK_NE(fd, -1) << "cannot open " << path_rec;
+    struct stat st;
+    CHECK_EQ(fstat(fd, &st), 0) << "cannot stat " << path_rec;
+    size_ = st.st_size;
+    void *addr = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    CHECK(addr != MAP_FAILED) << "cannot mmap " << path_rec;
+    data_ = static_cast<char*>(addr);
+    madvise(data_, size_, MADV_RANDOM);
+#else
+    std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(path_rec.c_str(), "r"));
+    const size_t kBufferSize = 1 << 20UL;
+    size_t nread;
+    do {
+      const size_t begin = content_.size();
+      content_.resize(begin + kBufferSize);
+      nread = fi->Read(&content_[begin], kBufferSize);
+      content_.resize(begin + nread);
+    } while (nread != 0);
+    data_ = &content_[0];
+    size_ = content_.size();
+#endif
+    for (auto &r : records_) {
+      CHECK_LT(r.first, size_) << "recordio index does not match " << path_rec;
+      if (r.second == 0) r.second = size_ - r.first;
+    }
+  }
+
+  // ask the os to read the pages of the chunk starting at order_[begin]
+  inline void Prefetch(size_t begin) {
+#if !defined(_WIN32)
+    const size_t page = sysconf(_SC_PAGESIZE);
+    size_t nbytes = 0;
+    for (size_t i = begin; i < order_.size() && nbytes < chunk_size_; ++i) {
+      const std::pair<size_t, size_t> &r = records_[order_[i]];
+      const size_t start = r.first / page * page;
+      madvise(data_ + start, r.first + r.second - start, MADV_WILLNEED);
+      nbytes += r.second;
+    }
+#endif
+  }
+};
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_INDEXED_RECORDIO_H_
@@ -138,6 +138,8 @@ struct TBlobBatch {
   /*! \brief number of padding elements in this batch,
        this is used to indicate the last elements in the batch are only padded up to match the batch, and should be discarded */
   mshadow::index_t num_batch_padd;
+  /*! \brief bucket of a batch of variable shape, -1 if none */
+  int bucket_key;
   /*! \brief content of dense data */
   std::vector<TBlob> data;
   /*! \brief extra data to be fed to the network */
@@ -145,13 +147,46 @@ struct TBlobBatch {
   /*! \brief constructor */
   TBlobBatch(void) {
     inst_index = NULL;
-    batch_size = 0; num_batch_padd = 0;
+    batch_size = 0; num_batch_padd = 0; bucket_key = -1;
   }
   /*! \brief destructor */
   ~TBlobBatch() {
     delete inst_index;
   }
 };  // struct TBlobBatch
+
+/*!
+ * \brief an instance iterator which can write the next instance into the
+ *  buffers of its consumer, instead of returning its own buffers to be copied
+ */
+class IInstWriter {
+ public:
+  /*! \brief virtual destructor */
+  virtual ~IInstWriter() {}
+  /*!
+   * \brief write the next instance
+   * \param out the buffers of the data of the instance, of the sizes of Value().data
+   * \param index the index of the instance
+   * \return false at the end
+   */
+  virtual bool NextInto(const std::vector<TBlob> &out, unsigned *index) = 0;
+};
+
+/*!
+ * \brief a batch iterator which can write the next batches into the buffers
+ *  of its consumer
+ */
+class IBatchWriter {
+ public:
+  /*! \brief virtual destructor */
+  virtual ~IBatchWriter() {}
+  /*!
+   * \brief set the buffers of the next batches, Value().data refers to them
+   * \param out the real_t buffers of the shapes of Value().data, or empty to
+   *  use the internal buffers again
+   */
+  virtual void SetOutput(const std::vector<TBlob> &out) = 0;
+};
 }  // namespace io
 }  // namespace mxnet
 #endif  // MXNET_IO_INST_VECTOR_H_
@@ -1,7 +1,12 @@
 // Copyright (c) 2015 by Contributors
 
 #include <mxnet/io.h>
+#include <dmlc/parameter.h>
 #include <dmlc/registry.h>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include "./io_stats.h"
 #include "./image_augmenter.h"
 #include "./iter_normalize.h"
 #include "./iter_batchloader.h"
@@ -18,5 +23,65 @@ namespace io {
 DMLC_REGISTER_PARAMETER(BatchParam);
 DMLC_REGISTER_PARAMETER(PrefetcherParam);
 DMLC_REGISTER_PARAMETER(ImageNormalizeParam);
+
+IOStats::IOStats()
+    : start_(std::chrono::steady_clock::now()),
+      log_interval_(dmlc::GetEnv("MXNET_IO_STATS_INTERVAL", 0.0)),
+      last_log_ns_(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          start_.time_since_epoch()).count()) {}
+
+IOStats* IOStats::Get() {
+  static IOStats inst;
+  return &inst;
+}
+
+IOStats::Stage* IOStats::GetStage(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& kv : stages_) {
+    if (kv.first == name) return kv.second.get();
+  }
+  stages_.emplace_back(name, std::unique_ptr<Stage>(new Stage()));
+  return stages_.back().second.get();
+}
+
+void IOStats::Dump(std::ostream* os, bool reset) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto now = std::chrono::steady_clock::now();
+  const double elapsed = std::max(1e-9, std::chrono::duration<double>(now - start_).count());
+  *os << std::fixed << std::setprecision(3)
+      << "{\"elapsed_s\": " << elapsed << ", \"stages\": [";
+  for (size_t i = 0; i < stages_.size(); ++i) {
+    Stage* s = stages_[i].second.get();
+    const uint64_t items = reset ? s->items.exchange(0) : s->items.load();
+    const double busy = (reset ? s->busy_ns.exchange(0) : s->busy_ns.load()) * 1e-9;
+    const uint64_t qsum = reset ? s->queue_sum.exchange(0) : s->queue_sum.load();
+    const uint64_t qn = reset ? s->queue_samples.exchange(0) : s->queue_samples.load();
+    *os << (i == 0 ? "" : ", ") << "{\"name\": \"" << stages_[i].first << "\""
+        << ", \"items\": " << items
+        << ", \"items_per_s\": " << items / elapsed
+        << ", \"busy_s\": " << busy
+        << ", \"utilization\": " << busy / elapsed;
+    if (s->queue_capacity != 0) {
+      *os << ", \"queue\": " << (qn == 0 ? 0.0 : static_cast<double>(qsum) / qn)
+          << ", \"queue_capacity\": " << s->queue_capacity;
+    }
+    *os << '}';
+  }
+  *os << "]}";
+  if (reset) start_ = now;
+}
+
+void IOStats::MaybeLog() {
+  if (log_interval_ <= 0) return;
+  const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  int64_t last = last_log_ns_;
+  if (now - last < static_cast<int64_t>(log_interval_ * 1e9)) return;
+  // a single thread logs each interval
+  if (!last_log_ns_.compare_exchange_strong(last, now)) return;
+  std::ostringstream os;
+  this->Dump(&os, true);
+  LOG(INFO) << "IO stats: " << os.str();
+}
 }  // namespace io
 }  // namespace mxnet
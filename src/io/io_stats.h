@@ -0,0 +1,98 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file io_stats.h
+ * \brief counters of the stages of the io pipelines
+ *
+ *  A stage counts its items, the time spent on them summed over its threads,
+ *  and for a stage feeding a dmlc::ThreadedIter, the items waiting in it
+ *  sampled at each read. The counters are process wide, summed over all the
+ *  iterators, and reset together.
+ */
+#ifndef MXNET_IO_IO_STATS_H_
+#define MXNET_IO_IO_STATS_H_
+
+#include <dmlc/base.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+/*! \brief counters of the stages of the io pipelines */
+class IOStats {
+ public:
+  /*! \brief counters of a stage */
+  struct Stage {
+    /*! \brief items processed */
+    std::atomic<uint64_t> items{0};
+    /*! \brief nanoseconds spent, summed over the threads */
+    std::atomic<uint64_t> busy_ns{0};
+    /*! \brief sum of the sampled numbers of items waiting in the queue after the stage */
+    std::atomic<uint64_t> queue_sum{0};
+    /*! \brief number of samples of the queue */
+    std::atomic<uint64_t> queue_samples{0};
+    /*! \brief capacity of the queue after the stage, 0 if none */
+    std::atomic<int> queue_capacity{0};
+    /*! \brief record a sample of the number of items waiting in the queue */
+    inline void SampleQueue(int64_t waiting) {
+      queue_sum += static_cast<uint64_t>(waiting > 0 ? waiting : 0);
+      ++queue_samples;
+    }
+  };
+  /*! \return the process wide counters */
+  static IOStats* Get();
+  /*!
+   * \return the counters of a stage, created on first use, they live as long as the process.
+   *  The stages are listed in the order of their first use.
+   */
+  Stage* GetStage(const std::string& name);
+  /*!
+   * \brief write the counters as json, the rates over the time since the last reset
+   * \param reset whether to reset the counters after
+   */
+  void Dump(std::ostream* os, bool reset);
+  /*! \brief log the counters every MXNET_IO_STATS_INTERVAL seconds, if set */
+  void MaybeLog();
+
+ private:
+  IOStats();
+  /*! \brief mutex of stages_ and start_ */
+  std::mutex mutex_;
+  /*! \brief the stages, in the order of their first use */
+  std::vector<std::pair<std::string, std::unique_ptr<Stage> > > stages_;
+  /*! \brief time of the last reset */
+  std::chrono::steady_clock::time_point start_;
+  /*! \brief seconds between the log lines, 0 for none */
+  double log_interval_;
+  /*! \brief time of the last log line, in nanoseconds of steady_clock */
+  std::atomic<int64_t> last_log_ns_;
+};
+
+/*! \brief account the time of a scope and its items to a stage */
+class IOStageScope {
+ public:
+  explicit IOStageScope(IOStats::Stage* stage, uint64_t items = 1)
+      : stage_(stage), items_(items), start_(std::chrono::steady_clock::now()) {}
+  ~IOStageScope() {
+    stage_->busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count();
+    stage_->items += items_;
+  }
+  /*! \brief set the number of items of the scope, such as 0 when it reached the end */
+  inline void set_items(uint64_t items) {
+    items_ = items;
+  }
+
+ private:
+  IOStats::Stage* stage_;
+  uint64_t items_;
+  std::chrono::steady_clock::time_point start_;
+};
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_IO_STATS_H_
@@ -14,6 +14,7 @@
 #include <vector>
 #include <string>
 #include "./inst_vector.h"
+#include "./io_stats.h"
 
 namespace mxnet {
 namespace io {
@@ -32,11 +33,17 @@ struct BatchParam : public dmlc::Parameter<BatchParam> {
   }
 };
 
-/*! \brief create a batch iterator from single instance iterator */
-class BatchLoader : public IIterator<TBlobBatch> {
+/*!
+ * \brief create a batch iterator from single instance iterator
+ *
+ *  When the base iterator is an IInstWriter, the instances are written directly
+ *  into their slot of the batch.
+ */
+class BatchLoader : public IIterator<TBlobBatch>, public IBatchWriter {
  public:
   explicit BatchLoader(IIterator<DataInst> *base):
-      base_(base), head_(1), num_overflow_(0) {
+      base_(base), writer_(dynamic_cast<IInstWriter*>(base)),
+      head_(1), num_overflow_(0), stats_(IOStats::Get()->GetStage("batch")) {
   }
 
   virtual ~BatchLoader(void) {
@@ -64,6 +71,17 @@ class BatchLoader : public IIterator<TBlobBatch> {
     }
     head_ = 1;
   }
+  virtual void Reset(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    // the buffers are allocated again by the first instance, of the new shape
+    shape_.clear();
+    data_.clear();
+    unit_size_.clear();
+    slots_.clear();
+    out_.data.clear();
+    num_overflow_ = 0;
+    base_->Reset(kwargs);
+    head_ = 1;
+  }
   virtual bool Next(void) {
     out_.num_batch_padd = 0;
     out_.batch_size = param_.batch_size;
@@ -73,18 +91,9 @@ class BatchLoader : public IIterator<TBlobBatch> {
     if (num_overflow_ != 0) return false;
     index_t top = 0;
 
-    while (base_->Next()) {
-      const DataInst& d = base_->Value();
-      out_.inst_index[top] = d.index;
-      if (data_.size() == 0) {
-        this->InitData(d);
-      }
-      for (size_t i = 0; i < d.data.size(); ++i) {
-        CHECK_EQ(unit_size_[i], d.data[i].Size());
-        mshadow::Copy(data_[i].Slice(top * unit_size_[i], (top + 1) * unit_size_[i]),
-                      d.data[i].get_with_shape<cpu, 1, real_t>(mshadow::Shape1(unit_size_[i])));
-      }
+    while (this->NextInst(top)) {
       if (++top >= param_.batch_size) {
+        ++stats_->items;
         return true;
       }
     }
@@ -93,20 +102,13 @@ class BatchLoader : public IIterator<TBlobBatch> {
         num_overflow_ = 0;
         base_->BeforeFirst();
         for (; top < param_.batch_size; ++top, ++num_overflow_) {
-          CHECK(base_->Next()) << "number of input must be bigger than batch size";
-          const DataInst& d = base_->Value();
-          out_.inst_index[top] = d.index;
-          // copy data
-          for (size_t i = 0; i < d.data.size(); ++i) {
-            CHECK_EQ(unit_size_[i], d.data[i].Size());
-            mshadow::Copy(data_[i].Slice(top * unit_size_[i], (top + 1) * unit_size_[i]),
-                          d.data[i].get_with_shape<cpu, 1, real_t>(mshadow::Shape1(unit_size_[i])));
-          }
+          CHECK(this->NextInst(top)) << "number of input must be bigger than batch size";
         }
         out_.num_batch_padd = num_overflow_;
       } else {
         out_.num_batch_padd = param_.batch_size - top;
       }
+      ++stats_->items;
       return true;
     }
     return false;
@@ -114,6 +116,18 @@ class BatchLoader : public IIterator<TBlobBatch> {
   virtual const TBlobBatch &Value(void) const {
     return out_;
   }
+  virtual void SetOutput(const std::vector<TBlob> &out) {
+    CHECK(out.size() == 0 || out.size() == data_.size())
+        << "the output shapes are known after the first batch";
+    for (size_t i = 0; i < data_.size(); ++i) {
+      if (out.size() == 0) {
+        out_.data[i] = TBlob(data_[i].dptr_, shape_[i], cpu::kDevMask);
+      } else {
+        CHECK_EQ(out[i].shape_.Size(), shape_[i].Size());
+        out_.data[i] = TBlob(static_cast<real_t*>(out[i].dptr_), shape_[i], cpu::kDevMask);
+      }
+    }
+  }
 
  private:
   /*! \brief batch parameters */
@@ -122,6 +136,8 @@ class BatchLoader : public IIterator<TBlobBatch> {
   TBlobBatch out_;
   /*! \brief base iterator */
   IIterator<DataInst> *base_;
+  /*! \brief base iterator writing into the batch, or NULL */
+  IInstWriter *writer_;
   /*! \brief on first */
   int head_;
   /*! \brief number of overflow instances that readed in round_batch mode */
@@ -132,11 +148,41 @@ class BatchLoader : public IIterator<TBlobBatch> {
   std::vector<size_t> unit_size_;
   /*! \brief tensor to hold data */
   std::vector<mshadow::TensorContainer<mshadow::cpu, 1, real_t> > data_;
+  /*! \brief the slots of an instance in the batch */
+  std::vector<TBlob> slots_;
+  /*! \brief counters of the stage, the copies into the batch */
+  IOStats::Stage* stats_;
+  // read the next instance into the slot top of the batch
+  inline bool NextInst(index_t top) {
+    if (writer_ != nullptr && data_.size() != 0) {
+      for (size_t i = 0; i < data_.size(); ++i) {
+        real_t *dptr = static_cast<real_t*>(out_.data[i].dptr_) + top * unit_size_[i];
+        slots_[i] = TBlob(dptr, mshadow::Shape1(unit_size_[i]), cpu::kDevMask);
+      }
+      return writer_->NextInto(slots_, &out_.inst_index[top]);
+    }
+    if (!base_->Next()) return false;
+    IOStageScope scope(stats_, 0);
+    const DataInst& d = base_->Value();
+    out_.inst_index[top] = d.index;
+    if (data_.size() == 0) {
+      this->InitData(d);
+    }
+    for (size_t i = 0; i < d.data.size(); ++i) {
+      CHECK_EQ(unit_size_[i], d.data[i].Size());
+      mshadow::Tensor<cpu, 1, real_t> dst(static_cast<real_t*>(out_.data[i].dptr_),
+                                          mshadow::Shape1(out_.data[i].shape_.Size()));
+      mshadow::Copy(dst.Slice(top * unit_size_[i], (top + 1) * unit_size_[i]),
+                    d.data[i].get_with_shape<cpu, 1, real_t>(mshadow::Shape1(unit_size_[i])));
+    }
+    return true;
+  }
   // initialize the data holder by using from the first batch.
   inline void InitData(const DataInst& first_batch) {
     shape_.resize(first_batch.data.size());
     data_.resize(first_batch.data.size());
     unit_size_.resize(first_batch.data.size());
+    slots_.resize(first_batch.data.size());
     for (size_t i = 0; i < first_batch.data.size(); ++i) {
       TShape src_shape = first_batch.data[i].shape_;
       // init object attributes
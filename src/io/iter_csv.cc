@@ -7,7 +7,16 @@
 #include <dmlc/base.h>
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
-#include <dmlc/data.h>
+#include <dmlc/io.h>
+#include <dmlc/omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../common/utils.h"
+#include "./csv_cache.h"
 #include "./iter_prefetcher.h"
 #include "./iter_batchloader.h"
 
@@ -23,6 +32,20 @@ struct CSVIterParam : public dmlc::Parameter<CSVIterParam> {
   std::string label_csv;
   /*! \brief label shape */
   TShape label_shape;
+  /*! \brief number of threads to parse a chunk */
+  int preprocess_threads;
+  /*! \brief partition the data into multiple parts */
+  int num_parts;
+  /*! \brief the index of the part will read */
+  int part_index;
+  /*! \brief path of the binary cache of the parsed rows */
+  std::string cache_file;
+  /*! \brief the number of rows of a group of the cache */
+  int cache_group_rows;
+  /*! \brief whether to shuffle the cached rows */
+  bool shuffle;
+  /*! \brief random seed of the shuffle */
+  int seed;
   // declare parameters
   DMLC_DECLARE_PARAMETER(CSVIterParam) {
     DMLC_DECLARE_FIELD(data_csv)
@@ -34,6 +57,262 @@ struct CSVIterParam : public dmlc::Parameter<CSVIterParam> {
     index_t shape1[] = {1};
     DMLC_DECLARE_FIELD(label_shape).set_default(TShape(shape1, shape1 + 1))
         .describe("Dataset Param: Shape of the label.");
+    DMLC_DECLARE_FIELD(preprocess_threads).set_lower_bound(1).set_default(4)
+        .describe("Backend Param: Number of threads to parse the chunks of the files, "
+                  "at most the number of cores.");
+    DMLC_DECLARE_FIELD(num_parts).set_default(1)
+        .describe("partition the data into multiple parts");
+    DMLC_DECLARE_FIELD(part_index).set_default(0)
+        .describe("the index of the part will read");
+    DMLC_DECLARE_FIELD(cache_file).set_default("")
+        .describe("Dataset Param: Local path of a binary cache of the parsed rows. The first "
+                  "full pass over the csv files writes it, the later passes and iterators "
+                  "read it memory mapped without parsing. It must be removed when the csv "
+                  "files change, each part needs its own.");
+    DMLC_DECLARE_FIELD(cache_group_rows).set_lower_bound(1).set_default(1024)
+        .describe("Dataset Param: Number of rows of a group of the cache, the unit "
+                  "of the shuffle.");
+    DMLC_DECLARE_FIELD(shuffle).set_default(false)
+        .describe("Dataset Param: Whether to shuffle the rows once they are read from "
+                  "the cache, the groups of rows are visited in a random order and the "
+                  "rows of a group in a random order.");
+    DMLC_DECLARE_FIELD(seed).set_default(0)
+        .describe("Dataset Param: Random seed of the shuffle.");
+  }
+};
+
+inline bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+inline bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/*!
+ * \brief parse a real number, without the locale and the checks of strtod
+ * \return the end of the number
+ */
+inline const char *ParseReal(const char *p, const char *end, real_t *out) {
+  static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char *begin = p;
+  const bool neg = p != end && *p == '-';
+  if (p != end && (*p == '-' || *p == '+')) ++p;
+  uint64_t mantissa = 0;
+  int exp10 = 0, ndigit = 0, nsig = 0;
+  for (; p != end && IsDigit(*p); ++p, ++ndigit) {
+    if (nsig < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa != 0) ++nsig;
+    } else {
+      ++exp10;
+    }
+  }
+  if (p != end && *p == '.') {
+    for (++p; p != end && IsDigit(*p); ++p, ++ndigit) {
+      if (nsig < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa != 0) ++nsig;
+        --exp10;
+      }
+    }
+  }
+  if (ndigit == 0) {
+    // nan, inf, hexadecimal...
+    const char *q = p;
+    while (q != end && *q != ',' && *q != '\n' && *q != '\r') ++q;
+    std::string field(begin, q);
+    char *last;
+    *out = static_cast<real_t>(strtod(field.c_str(), &last));
+    CHECK(last != field.c_str()) << "invalid csv value \"" << field << "\"";
+    return begin + (last - field.c_str());
+  }
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    const bool eneg = q != end && *q == '-';
+    if (q != end && (*q == '-' || *q == '+')) ++q;
+    if (q != end && IsDigit(*q)) {
+      int e = 0;
+      for (; q != end && IsDigit(*q); ++q) {
+        if (e < 10000) e = e * 10 + (*q - '0');
+      }
+      exp10 += eneg ? -e : e;
+      p = q;
+    }
+  }
+  double value = static_cast<double>(mantissa);
+  if (exp10 < 0) {
+    value = -exp10 <= 22 ? value / kPow10[-exp10] : value * std::pow(10.0, exp10);
+  } else if (exp10 > 0) {
+    value = exp10 <= 22 ? value * kPow10[exp10] : value * std::pow(10.0, exp10);
+  }
+  *out = static_cast<real_t>(neg ? -value : value);
+  return p;
+}
+
+/*!
+ * \brief read the rows of a csv file chunk by chunk, each chunk is split at
+ *  line boundaries and parsed by several threads.
+ *
+ *  The rows are returned in the file order. Lines are assigned to the parts
+ *  either by the byte ranges of the file, or one line out of num_parts.
+ */
+class CSVChunkReader {
+ public:
+  /*!
+   * \param path the csv file
+   * \param row_size the number of values of a row
+   * \param part_index the part to read
+   * \param num_parts the number of parts
+   * \param interleave whether a part is one line out of num_parts instead of a byte range,
+   *  the same as the parts of another file with the same number of lines
+   * \param nthread the number of parsing threads
+   */
+  CSVChunkReader(const std::string &path, size_t row_size, int part_index, int num_parts,
+                 bool interleave, int nthread)
+      : row_size_(row_size), nthread_(nthread),
+        stride_(interleave ? num_parts : 1), offset_(interleave ? part_index : 0) {
+    if (interleave) {
+      split_.reset(dmlc::InputSplit::Create(path.c_str(), 0, 1, "text"));
+    } else {
+      split_.reset(dmlc::InputSplit::Create(path.c_str(), part_index, num_parts, "text"));
+    }
+    this->BeforeFirst();
+  }
+  /*! \brief restart from the first row */
+  inline void BeforeFirst() {
+    split_->BeforeFirst();
+    line_counter_ = 0;
+    ptr_ = nrow_ = 0;
+  }
+  /*!
+   * \brief go to the next row
+   * \return false at the end of the part
+   */
+  inline bool Next() {
+    if (++ptr_ < nrow_) return true;
+    while (this->ParseChunk()) {
+      if (nrow_ != 0) return true;
+    }
+    return false;
+  }
+  /*! \return the values of the current row */
+  inline real_t *Value() {
+    return &values_[ptr_ * row_size_];
+  }
+
+ private:
+  /*! \brief the number of values of a row */
+  size_t row_size_;
+  /*! \brief the number of parsing threads */
+  int nthread_;
+  /*! \brief keep the lines i with i % stride_ == offset_ */
+  size_t stride_, offset_;
+  /*! \brief the number of lines before the current chunk */
+  size_t line_counter_;
+  /*! \brief the current row and the number of rows of the chunk */
+  size_t ptr_, nrow_;
+  /*! \brief the rows of the chunk */
+  std::vector<real_t> values_;
+  /*! \brief begin of the range of each thread, and the last end */
+  std::vector<const char*> bounds_;
+  /*! \brief first line of the range of each thread, and the number of lines */
+  std::vector<size_t> line_begin_;
+  /*! \brief the input */
+  std::unique_ptr<dmlc::InputSplit> split_;
+
+  // the end of the line starting at p
+  static inline const char *LineEnd(const char *p, const char *end) {
+    const void *q = memchr(p, '\n', end - p);
+    return q == nullptr ? end : static_cast<const char*>(q);
+  }
+  // whether the line has no value
+  static inline bool IsEmpty(const char *p, const char *end) {
+    for (; p != end; ++p) {
+      if (!IsSpace(*p)) return false;
+    }
+    return true;
+  }
+  // the number of kept rows among the lines [0, nline) of the chunk
+  inline size_t NumKept(size_t nline) const {
+    const size_t first = line_counter_, last = line_counter_ + nline;
+    auto count = [this](size_t n) {  // #lines i < n with i % stride == offset
+      return n / stride_ + (n % stride_ > offset_ ? 1 : 0);
+    };
+    return count(last) - count(first);
+  }
+  // read and parse the next chunk, return false at the end
+  inline bool ParseChunk() {
+    dmlc::InputSplit::Blob chunk;
+    if (!split_->NextChunk(&chunk)) return false;
+    const char *begin = static_cast<const char*>(chunk.dptr);
+    const char *end = begin + chunk.size;
+    const int nthread = nthread_;
+    bounds_.resize(nthread + 1);
+    line_begin_.resize(nthread + 1);
+    bounds_[0] = begin;
+    bounds_[nthread] = end;
+    for (int t = 1; t < nthread; ++t) {
+      const char *p = std::max(bounds_[t - 1], begin + chunk.size * t / nthread);
+      if (p != begin && p != end && p[-1] != '\n') p = std::min(LineEnd(p, end) + 1, end);
+      bounds_[t] = p;
+    }
+    // count the non empty lines of each range
+    #pragma omp parallel for num_threads(nthread)
+    for (int t = 0; t < nthread; ++t) {
+      size_t nline = 0;
+      for (const char *p = bounds_[t]; p < bounds_[t + 1];) {
+        const char *q = LineEnd(p, bounds_[t + 1]);
+        if (!IsEmpty(p, q)) ++nline;
+        p = q + 1;
+      }
+      line_begin_[t + 1] = nline;
+    }
+    line_begin_[0] = 0;
+    for (int t = 0; t < nthread; ++t) line_begin_[t + 1] += line_begin_[t];
+    nrow_ = this->NumKept(line_begin_[nthread]);
+    values_.resize(nrow_ * row_size_);
+    // parse the kept lines into their rows
+    #pragma omp parallel for num_threads(nthread)
+    for (int t = 0; t < nthread; ++t) {
+      size_t line = line_begin_[t];
+      real_t *out = dmlc::BeginPtr(values_) + this->NumKept(line) * row_size_;
+      for (const char *p = bounds_[t]; p < bounds_[t + 1];) {
+        const char *q = LineEnd(p, bounds_[t + 1]);
+        if (IsEmpty(p, q)) {
+          p = q + 1;
+          continue;
+        }
+        if ((line_counter_ + line++) % stride_ == offset_) {
+          this->ParseLine(p, q, out);
+          out += row_size_;
+        }
+        p = q + 1;
+      }
+    }
+    line_counter_ += line_begin_[nthread];
+    ptr_ = 0;
+    return true;
+  }
+  // parse the values of a line
+  inline void ParseLine(const char *p, const char *end, real_t *out) const {
+    size_t n = 0;
+    while (true) {
+      while (p != end && (*p == ' ' || *p == '\t')) ++p;
+      CHECK_LT(n, row_size_)
+          << "The data size in CSV do not match size of shape: "
+          << "specified shape size=" << row_size_ << ", the csv row-length > " << n;
+      p = ParseReal(p, end, out + n++);
+      while (p != end && IsSpace(*p)) ++p;
+      if (p == end) break;
+      CHECK_EQ(*p, ',') << "invalid csv line \"" << std::string(p, end) << "\"";
+      ++p;
+    }
+    CHECK_EQ(n, row_size_)
+        << "The data size in CSV do not match size of shape: "
+        << "specified shape size=" << row_size_ << ", the csv row-length=" << n;
   }
 };
 
@@ -47,52 +326,91 @@ class CSVIter: public IIterator<DataInst> {
   // intialize iterator loads data in
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
     param_.InitAllowUnknown(kwargs);
-    data_parser_.reset(dmlc::Parser<uint32_t>::Create(param_.data_csv.c_str(), 0, 1, "csv"));
-    if (param_.label_csv != "NULL") {
-      label_parser_.reset(dmlc::Parser<uint32_t>::Create(param_.label_csv.c_str(), 0, 1, "csv"));
-    } else {
+    CHECK(param_.part_index >= 0 && param_.part_index < param_.num_parts)
+        << "invalid part_index " << param_.part_index << " of " << param_.num_parts << " parts";
+    if (param_.label_csv == "NULL") {
       dummy_label.set_pad(false);
       dummy_label.Resize(mshadow::Shape1(1));
       dummy_label = 0.0f;
     }
+    if (param_.cache_file.length() != 0) {
+      cache_header_.magic = cache_header_.num_rows = 0;
+      cache_header_.data_size = param_.data_shape.Size();
+      cache_header_.label_size = param_.label_csv != "NULL" ? param_.label_shape.Size() : 0;
+      cache_header_.group_rows = param_.cache_group_rows;
+      cache_header_.part_index = param_.part_index;
+      cache_header_.num_parts = param_.num_parts;
+      cache_reader_.reset(csvcache::Reader::Open(param_.cache_file, cache_header_));
+      rnd_.seed(kRandMagic + param_.seed);
+      // the csv files are not read once cached
+      if (cache_reader_.get() != nullptr) return;
+    }
+    int nthread = std::min(std::max(omp_get_num_procs(), 1), param_.preprocess_threads);
+    // the lines of the data and of the label are matched by their position, so they
+    // are split one line out of num_parts instead of by byte ranges
+    const bool interleave = param_.label_csv != "NULL" && param_.num_parts > 1;
+    data_reader_.reset(new CSVChunkReader(param_.data_csv, param_.data_shape.Size(),
+                                          param_.part_index, param_.num_parts,
+                                          interleave, nthread));
+    if (param_.label_csv != "NULL") {
+      label_reader_.reset(new CSVChunkReader(param_.label_csv, param_.label_shape.Size(),
+                                             param_.part_index, param_.num_parts,
+                                             interleave, nthread));
+    }
   }
 
   virtual void BeforeFirst() {
-    data_parser_->BeforeFirst();
-    if (label_parser_.get() != nullptr) {
-      label_parser_->BeforeFirst();
-    }
-    data_ptr_ = label_ptr_ = 0;
-    data_size_ = label_size_ = 0;
     inst_counter_ = 0;
     end_ = false;
+    if (cache_reader_.get() != nullptr) {
+      const size_t ngroup = cache_reader_->header().NumGroups();
+      group_order_.resize(ngroup);
+      for (size_t i = 0; i < ngroup; ++i) group_order_[i] = i;
+      if (param_.shuffle) std::shuffle(group_order_.begin(), group_order_.end(), rnd_);
+      group_ptr_ = 0;
+      row_order_.clear();
+      row_ptr_ = 0;
+      if (ngroup != 0) cache_reader_->Prefetch(group_order_[0]);
+      return;
+    }
+    // only a pass from the first row to the end writes the cache
+    cache_writer_.reset();
+    if (param_.cache_file.length() != 0) {
+      cache_writer_.reset(new csvcache::Writer(param_.cache_file, cache_header_));
+    }
+    data_reader_->BeforeFirst();
+    if (label_reader_.get() != nullptr) {
+      label_reader_->BeforeFirst();
+    }
   }
 
   virtual bool Next() {
     if (end_) return false;
-    while (data_ptr_ >= data_size_) {
-      if (!data_parser_->Next()) {
-        end_ = true; return false;
+    if (cache_reader_.get() != nullptr) return this->NextCached();
+    if (!data_reader_->Next()) {
+      end_ = true;
+      if (cache_writer_.get() != nullptr) {
+        cache_writer_->Finish();
+        cache_writer_.reset();
+        cache_reader_.reset(csvcache::Reader::Open(param_.cache_file, cache_header_));
+        CHECK(cache_reader_.get() != nullptr) << "cannot read the csv cache "
+                                              << param_.cache_file;
       }
-      data_ptr_ = 0;
-      data_size_ = data_parser_->Value().size;
+      return false;
     }
     out_.index = inst_counter_++;
-    CHECK_LT(data_ptr_, data_size_);
-    out_.data[0] = AsTBlob(data_parser_->Value()[data_ptr_++], param_.data_shape);
-
-    if (label_parser_.get() != nullptr) {
-      while (label_ptr_ >= label_size_) {
-        CHECK(label_parser_->Next())
-            << "Data CSV's row is smaller than the number of rows in label_csv";
-        label_ptr_ = 0;
-        label_size_ = label_parser_->Value().size;
-      }
-      CHECK_LT(label_ptr_, label_size_);
-      out_.data[1] = AsTBlob(label_parser_->Value()[label_ptr_++], param_.label_shape);
+    out_.data[0] = TBlob(data_reader_->Value(), param_.data_shape, cpu::kDevMask);
+
+    if (label_reader_.get() != nullptr) {
+      CHECK(label_reader_->Next())
+          << "Data CSV's row is smaller than the number of rows in label_csv";
+      out_.data[1] = TBlob(label_reader_->Value(), param_.label_shape, cpu::kDevMask);
     } else {
       out_.data[1] = dummy_label;
     }
+    if (cache_writer_.get() != nullptr) {
+      cache_writer_->Append(data_reader_->Value(), out_.data[1].dptr<real_t>());
+    }
     return true;
   }
 
@@ -101,12 +419,33 @@ class CSVIter: public IIterator<DataInst> {
   }
 
  private:
-  inline TBlob AsTBlob(const dmlc::Row<uint32_t>& row, const TShape& shape) {
-    CHECK_EQ(row.length, shape.Size())
-        << "The data size in CSV do not match size of shape: "
-        << "specified shape=" << shape << ", the csv row-length=" << row.length;
-    const real_t* ptr = row.value;
-    return TBlob((real_t*)ptr, shape, cpu::kDevMask);  // NOLINT(*)
+  static const int kRandMagic = 111;
+  // the next row of the cache, by the order of the groups and of their rows
+  inline bool NextCached() {
+    if (row_ptr_ == row_order_.size()) {
+      if (group_ptr_ == group_order_.size()) {
+        end_ = true;
+        return false;
+      }
+      const size_t group = group_order_[group_ptr_++];
+      row_order_.resize(cache_reader_->GroupSize(group));
+      for (size_t i = 0; i < row_order_.size(); ++i) row_order_[i] = i;
+      if (param_.shuffle) std::shuffle(row_order_.begin(), row_order_.end(), rnd_);
+      row_ptr_ = 0;
+      if (group_ptr_ < group_order_.size()) {
+        cache_reader_->Prefetch(group_order_[group_ptr_]);
+      }
+    }
+    const size_t group = group_order_[group_ptr_ - 1], row = row_order_[row_ptr_++];
+    out_.index = inst_counter_++;
+    out_.data[0] = TBlob(cache_reader_->Data(group, row), param_.data_shape, cpu::kDevMask);
+    if (cache_header_.label_size != 0) {
+      out_.data[1] = TBlob(cache_reader_->Label(group, row), param_.label_shape,
+                           cpu::kDevMask);
+    } else {
+      out_.data[1] = dummy_label;
+    }
+    return true;
   }
 
   CSVIterParam param_;
@@ -118,11 +457,19 @@ class CSVIter: public IIterator<DataInst> {
   bool end_{false};
   // dummy label
   mshadow::TensorContainer<cpu, 1, real_t> dummy_label;
-  // label parser
-  size_t label_ptr_{0}, label_size_{0};
-  size_t data_ptr_{0}, data_size_{0};
-  std::unique_ptr<dmlc::Parser<uint32_t> > label_parser_;
-  std::unique_ptr<dmlc::Parser<uint32_t> > data_parser_;
+  // the readers of the data and of the label
+  std::unique_ptr<CSVChunkReader> label_reader_;
+  std::unique_ptr<CSVChunkReader> data_reader_;
+  // the layout of the cache
+  csvcache::Header cache_header_;
+  // the cache once it is complete, and its writer during the first pass
+  std::unique_ptr<csvcache::Reader> cache_reader_;
+  std::unique_ptr<csvcache::Writer> cache_writer_;
+  // the order of the groups of the cache and of the rows of the current group
+  std::vector<size_t> group_order_, row_order_;
+  size_t group_ptr_{0}, row_ptr_{0};
+  // random engine of the shuffle
+  common::RANDOM_ENGINE rnd_;
 };
 
 
@@ -0,0 +1,412 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file iter_image_det_recordio.cc
+ * \brief iterator over image recordio with object detection labels
+ *
+ *  The header flag of a record is the number of floats of its label, stored
+ *  after the header and before the image. The label is the width of an object
+ *  followed by the objects, each an id and the box xmin, ymin, xmax, ymax in
+ *  coordinates normalized to [0, 1], then any extra values. The crop, mirror
+ *  and resize of the images apply to their boxes too, in the decoding threads.
+ */
+#include <mxnet/io.h>
+#include <dmlc/base.h>
+#include <dmlc/io.h>
+#include <dmlc/omp.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <dmlc/recordio.h>
+#include <dmlc/threadediter.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./inst_vector.h"
+#include "./image_recordio.h"
+#include "./image_augmenter.h"
+#include "../common/thread_budget.h"
+#include "./iter_prefetcher.h"
+#include "./iter_normalize.h"
+#include "./iter_batchloader.h"
+#include "../common/utils.h"
+
+namespace mxnet {
+namespace io {
+// parameters of the detection record parser and its augmentation
+struct ImageDetRecParserParam : public dmlc::Parameter<ImageDetRecParserParam> {
+  /*! \brief path to image recordio */
+  std::string path_imgrec;
+  /*! \brief output shape of the images */
+  TShape data_shape;
+  /*! \brief width of the padded labels */
+  int label_pad_width;
+  /*! \brief value of the padding of the labels */
+  float label_pad_value;
+  /*! \brief number of threads */
+  int preprocess_threads;
+  /*! \brief probability of a random crop */
+  float rand_crop_prob;
+  /*! \brief range of the area of the crop, relative to the image */
+  float min_crop_scale, max_crop_scale;
+  /*! \brief range of the aspect ratio of the crop */
+  float min_crop_aspect_ratio, max_crop_aspect_ratio;
+  /*! \brief minimum fraction of a box kept by a crop */
+  float min_object_covered;
+  /*! \brief number of trials of a crop keeping an object */
+  int max_crop_trials;
+  /*! \brief probability of a horizontal flip */
+  float rand_mirror_prob;
+  /*! \brief whether to remain silent */
+  bool verbose;
+  /*! \brief partition the data into multiple parts */
+  int num_parts;
+  /*! \brief the index of the part will read */
+  int part_index;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(ImageDetRecParserParam) {
+    DMLC_DECLARE_FIELD(path_imgrec).set_default("./data/imgrec.rec")
+        .describe("Dataset Param: Path to image record file.");
+    DMLC_DECLARE_FIELD(data_shape)
+        .enforce_nonzero()
+        .describe("Dataset Param: Shape of each instance generated by the DataIter, "
+                  "the images are resized to it.");
+    DMLC_DECLARE_FIELD(label_pad_width).set_lower_bound(1)
+        .describe("Dataset Param: Width of the labels, the objects of an image padded "
+                  "with label_pad_value. It must hold the objects of every image.");
+    DMLC_DECLARE_FIELD(label_pad_value).set_default(-1.0f)
+        .describe("Dataset Param: Value of the padding of the labels.");
+    DMLC_DECLARE_FIELD(preprocess_threads).set_lower_bound(1).set_default(4)
+        .describe("Backend Param: Number of thread to do preprocessing, "
+                  "at most the number of cores.");
+    DMLC_DECLARE_FIELD(rand_crop_prob).set_default(0.0f).set_range(0.0f, 1.0f)
+        .describe("Augmentation Param: Probability of a random crop.");
+    DMLC_DECLARE_FIELD(min_crop_scale).set_default(0.3f).set_range(0.0f, 1.0f)
+        .describe("Augmentation Param: Minimum area of a crop, relative to the image.");
+    DMLC_DECLARE_FIELD(max_crop_scale).set_default(1.0f).set_range(0.0f, 1.0f)
+        .describe("Augmentation Param: Maximum area of a crop, relative to the image.");
+    DMLC_DECLARE_FIELD(min_crop_aspect_ratio).set_default(0.5f).set_lower_bound(0.0f)
+        .describe("Augmentation Param: Minimum aspect ratio of a crop.");
+    DMLC_DECLARE_FIELD(max_crop_aspect_ratio).set_default(2.0f).set_lower_bound(0.0f)
+        .describe("Augmentation Param: Maximum aspect ratio of a crop.");
+    DMLC_DECLARE_FIELD(min_object_covered).set_default(0.5f).set_range(0.0f, 1.0f)
+        .describe("Augmentation Param: Minimum fraction of a box inside a crop for the "
+                  "object to be kept, a crop keeps at least one object.");
+    DMLC_DECLARE_FIELD(max_crop_trials).set_default(25).set_lower_bound(1)
+        .describe("Augmentation Param: Number of trials of a random crop, the image is "
+                  "not cropped if none keeps an object.");
+    DMLC_DECLARE_FIELD(rand_mirror_prob).set_default(0.0f).set_range(0.0f, 1.0f)
+        .describe("Augmentation Param: Probability of a horizontal flip.");
+    DMLC_DECLARE_FIELD(verbose).set_default(true)
+        .describe("Auxiliary Param: Whether to output parser information.");
+    DMLC_DECLARE_FIELD(num_parts).set_default(1)
+        .describe("partition the data into multiple parts");
+    DMLC_DECLARE_FIELD(part_index).set_default(0)
+        .describe("the index of the part will read");
+  }
+};
+
+// parameters of the detection record iterator
+struct ImageDetRecordParam : public dmlc::Parameter<ImageDetRecordParam> {
+  /*! \brief whether to do shuffle */
+  bool shuffle;
+  /*! \brief random seed */
+  int seed;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(ImageDetRecordParam) {
+    DMLC_DECLARE_FIELD(shuffle).set_default(false)
+        .describe("Augmentation Param: Whether to shuffle data.");
+    DMLC_DECLARE_FIELD(seed).set_default(0)
+        .describe("Augmentation Param: Random Seed.");
+  }
+};
+
+// parser of image recordio with detection labels
+class ImageDetRecordIOParser {
+ public:
+  // give back the decoding threads to the cpu thread budget
+  ~ImageDetRecordIOParser() {
+    common::CPUThreadBudget::Get()->Unreserve(reserved_threads_);
+  }
+  inline void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+#if MXNET_USE_OPENCV
+    param_.InitAllowUnknown(kwargs);
+    CHECK_EQ(param_.data_shape.ndim(), 3)
+        << "data_shape must be (channels, height, width)";
+    CHECK_LE(param_.min_crop_scale, param_.max_crop_scale);
+    CHECK_LE(param_.min_crop_aspect_ratio, param_.max_crop_aspect_ratio);
+    int maxthread, threadget;
+    #pragma omp parallel
+    {
+      maxthread = std::max(omp_get_num_procs(), 1);
+    }
+    param_.preprocess_threads = std::min(maxthread, param_.preprocess_threads);
+    common::CPUThreadBudget::Get()->Unreserve(reserved_threads_);
+    reserved_threads_ = common::CPUThreadBudget::Get()->Reserve(param_.preprocess_threads);
+    param_.preprocess_threads = reserved_threads_;
+    #pragma omp parallel num_threads(param_.preprocess_threads)
+    {
+      threadget = omp_get_num_threads();
+    }
+    param_.preprocess_threads = threadget;
+    prnds_.clear();
+    for (int i = 0; i < threadget; ++i) {
+      prnds_.emplace_back(new common::RANDOM_ENGINE((i + 1) * kRandMagic));
+    }
+    if (param_.verbose) {
+      LOG(INFO) << "ImageDetRecordIOParser: " << param_.path_imgrec
+                << ", use " << threadget << " threads for decoding..";
+    }
+    source_.reset(dmlc::InputSplit::Create(
+        param_.path_imgrec.c_str(), param_.part_index,
+        param_.num_parts, "recordio"));
+    source_->HintChunkSize(8 << 20UL);
+#else
+    LOG(FATAL) << "ImageDetRec need opencv to process";
+#endif
+  }
+
+  inline void BeforeFirst(void) {
+    source_->BeforeFirst();
+  }
+
+  // parse the records of the next chunk, one instance vector per thread
+  inline bool ParseNext(std::vector<InstVector> *out_vec) {
+    dmlc::InputSplit::Blob chunk;
+    if (!source_->NextChunk(&chunk)) return false;
+#if MXNET_USE_OPENCV
+    out_vec->resize(param_.preprocess_threads);
+    #pragma omp parallel num_threads(param_.preprocess_threads)
+    {
+      CHECK(omp_get_num_threads() == param_.preprocess_threads);
+      const int tid = omp_get_thread_num();
+      InstVector &out = (*out_vec)[tid];
+      out.Clear();
+      dmlc::InputSplit::Blob blob;
+      dmlc::RecordIOChunkReader reader(chunk, tid, param_.preprocess_threads);
+      while (reader.NextRecord(&blob)) {
+        this->ParseRecord(blob, tid, &out);
+      }
+    }
+#endif
+    return true;
+  }
+
+ private:
+  // magic number to seed prng
+  static const int kRandMagic = 111;
+#if MXNET_USE_OPENCV
+  // decode a record, augment the image and its boxes and push them to out
+  inline void ParseRecord(const dmlc::InputSplit::Blob &blob, int tid, InstVector *out) {
+    ImageRecordIO rec;
+    rec.Load(blob.dptr, blob.size);
+    const size_t label_size = rec.header.flag * sizeof(float);
+    CHECK(rec.header.flag >= 1 && rec.content_size >= label_size)
+        << "a detection record must start with its label, its header flag the label size";
+    std::vector<float> label(rec.header.flag);
+    std::memcpy(label.data(), rec.content, label_size);
+    const int width = static_cast<int>(label[0]);
+    CHECK_GE(width, 5) << "an object is at least an id and a box";
+    CHECK_EQ((label.size() - 1) % width, 0) << "invalid detection label";
+    std::vector<float> objects(label.begin() + 1, label.end());
+    cv::Mat buf(1, rec.content_size - label_size, CV_8U, rec.content + label_size);
+    const int channels = param_.data_shape[0];
+    cv::Mat res = cv::imdecode(buf, channels == 1 ? 0 : 1);
+    CHECK(!res.empty()) << "cannot decode image " << rec.image_index();
+    common::RANDOM_ENGINE *prnd = prnds_[tid].get();
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    if (uniform(*prnd) < param_.rand_crop_prob) {
+      res = this->RandomCrop(res, width, &objects, prnd);
+    }
+    if (uniform(*prnd) < param_.rand_mirror_prob) {
+      cv::flip(res, res, 1);
+      for (size_t i = 0; i < objects.size(); i += width) {
+        const float xmin = objects[i + 1];
+        objects[i + 1] = 1.0f - objects[i + 3];
+        objects[i + 3] = 1.0f - xmin;
+      }
+    }
+    // the normalized boxes do not change with the resize
+    const int h = param_.data_shape[1], w = param_.data_shape[2];
+    if (res.rows != h || res.cols != w) {
+      cv::resize(res, res, cv::Size(w, h), 0, 0, cv::INTER_LINEAR);
+    }
+    CHECK_LE(objects.size(), static_cast<size_t>(param_.label_pad_width))
+        << "label_pad_width " << param_.label_pad_width << " is too small for the "
+        << objects.size() / width << " objects of image " << rec.image_index();
+    out->Push(static_cast<unsigned>(rec.image_index()),
+              mshadow::Shape3(channels, h, w),
+              mshadow::Shape1(param_.label_pad_width));
+    mshadow::Tensor<cpu, 3> data = out->data().Back();
+    // opencv stores BGR, the output is RGB
+    for (int i = 0; i < h; ++i) {
+      const uchar *im_data = res.ptr<uchar>(i);
+      for (int j = 0; j < w; ++j) {
+        for (int k = 0; k < channels; ++k) {
+          data[k][i][j] = im_data[channels == 3 ? 2 - k : k];
+        }
+        im_data += channels;
+      }
+    }
+    mshadow::Tensor<cpu, 1> out_label = out->label().Back();
+    std::copy(objects.begin(), objects.end(), out_label.dptr_);
+    std::fill(out_label.dptr_ + objects.size(), out_label.dptr_ + param_.label_pad_width,
+              param_.label_pad_value);
+  }
+  /*!
+   * \brief crop a random region keeping at least one object, the kept boxes
+   *  are clipped to the region and renormalized, the others are removed
+   */
+  inline cv::Mat RandomCrop(const cv::Mat &src, int width, std::vector<float> *objects,
+                            common::RANDOM_ENGINE *prnd) {
+    std::uniform_real_distribution<float> scale(param_.min_crop_scale, param_.max_crop_scale);
+    std::uniform_real_distribution<float> ratio(param_.min_crop_aspect_ratio,
+                                                param_.max_crop_aspect_ratio);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    for (int trial = 0; trial < param_.max_crop_trials; ++trial) {
+      const float area = scale(*prnd), aspect = ratio(*prnd);
+      const float cw = std::sqrt(area * aspect), ch = std::sqrt(area / aspect);
+      if (cw > 1.0f || ch > 1.0f) continue;
+      const float x0 = uniform(*prnd) * (1.0f - cw), y0 = uniform(*prnd) * (1.0f - ch);
+      std::vector<float> kept;
+      for (size_t i = 0; i < objects->size(); i += width) {
+        const float *obj = &(*objects)[i];
+        const float bw = obj[3] - obj[1], bh = obj[4] - obj[2];
+        const float ix0 = std::max(obj[1], x0), iy0 = std::max(obj[2], y0);
+        const float ix1 = std::min(obj[3], x0 + cw), iy1 = std::min(obj[4], y0 + ch);
+        if (ix1 <= ix0 || iy1 <= iy0 || bw <= 0.0f || bh <= 0.0f) continue;
+        if ((ix1 - ix0) * (iy1 - iy0) < param_.min_object_covered * bw * bh) continue;
+        kept.push_back(obj[0]);
+        kept.push_back((ix0 - x0) / cw);
+        kept.push_back((iy0 - y0) / ch);
+        kept.push_back((ix1 - x0) / cw);
+        kept.push_back((iy1 - y0) / ch);
+        kept.insert(kept.end(), obj + 5, obj + width);
+      }
+      if (kept.empty()) continue;
+      const cv::Rect roi(static_cast<int>(x0 * src.cols), static_cast<int>(y0 * src.rows),
+                         std::max(1, static_cast<int>(cw * src.cols)),
+                         std::max(1, static_cast<int>(ch * src.rows)));
+      if (roi.x + roi.width > src.cols || roi.y + roi.height > src.rows) continue;
+      objects->swap(kept);
+      return src(roi);
+    }
+    return src;
+  }
+#endif
+  /*! \brief parameters */
+  ImageDetRecParserParam param_;
+  /*! \brief random engine of each thread */
+  std::vector<std::unique_ptr<common::RANDOM_ENGINE> > prnds_;
+  /*! \brief data source */
+  std::unique_ptr<dmlc::InputSplit> source_;
+  /*! \brief decoding threads reserved from the cpu thread budget */
+  int reserved_threads_ = 0;
+};
+
+// iterator over the instances of the chunks parsed in a background thread
+class ImageDetRecordIter : public IIterator<DataInst> {
+ public:
+  ImageDetRecordIter() : data_(nullptr) {}
+
+  virtual ~ImageDetRecordIter(void) {
+    iter_.Destroy();
+    delete data_;
+  }
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    // a mirror after the parser would not flip the boxes
+    ImageNormalizeParam normalize;
+    normalize.InitAllowUnknown(kwargs);
+    CHECK(!normalize.mirror && !normalize.rand_mirror)
+        << "use rand_mirror_prob, it flips the boxes with the images";
+    parser_.Init(kwargs);
+    iter_.set_max_capacity(4);
+    iter_.Init([this](std::vector<InstVector> **dptr) {
+        if (*dptr == nullptr) {
+          *dptr = new std::vector<InstVector>();
+        }
+        return parser_.ParseNext(*dptr);
+      },
+      [this]() { parser_.BeforeFirst(); });
+    inst_ptr_ = 0;
+    rnd_.seed(kRandMagic + param_.seed);
+  }
+
+  virtual void BeforeFirst(void) {
+    iter_.BeforeFirst();
+    inst_order_.clear();
+    inst_ptr_ = 0;
+  }
+
+  virtual bool Next(void) {
+    while (true) {
+      if (inst_ptr_ < inst_order_.size()) {
+        std::pair<unsigned, unsigned> p = inst_order_[inst_ptr_];
+        out_ = (*data_)[p.first][p.second];
+        ++inst_ptr_;
+        return true;
+      }
+      if (data_ != nullptr) iter_.Recycle(&data_);
+      if (!iter_.Next(&data_)) return false;
+      inst_order_.clear();
+      for (unsigned i = 0; i < data_->size(); ++i) {
+        for (unsigned j = 0; j < (*data_)[i].Size(); ++j) {
+          inst_order_.push_back(std::make_pair(i, j));
+        }
+      }
+      if (param_.shuffle) {
+        std::shuffle(inst_order_.begin(), inst_order_.end(), rnd_);
+      }
+      inst_ptr_ = 0;
+    }
+  }
+
+  virtual const DataInst &Value(void) const {
+    return out_;
+  }
+
+ private:
+  // random magic
+  static const int kRandMagic = 111;
+  // output instance
+  DataInst out_;
+  // next instance of inst_order_
+  size_t inst_ptr_;
+  // instance order of the current chunk
+  std::vector<std::pair<unsigned, unsigned> > inst_order_;
+  // current chunk
+  std::vector<InstVector> *data_;
+  // internal parser
+  ImageDetRecordIOParser parser_;
+  // backend thread
+  dmlc::ThreadedIter<std::vector<InstVector> > iter_;
+  // parameters
+  ImageDetRecordParam param_;
+  // random number generator of the shuffle
+  common::RANDOM_ENGINE rnd_;
+};
+
+DMLC_REGISTER_PARAMETER(ImageDetRecParserParam);
+DMLC_REGISTER_PARAMETER(ImageDetRecordParam);
+
+MXNET_REGISTER_IO_ITER(ImageDetRecordIter)
+.describe("Create iterator for object detection datasets packed in recordio. "
+          "The label of each image is its objects padded to label_pad_width.")
+.add_arguments(ImageDetRecParserParam::__FIELDS__())
+.add_arguments(ImageDetRecordParam::__FIELDS__())
+.add_arguments(BatchParam::__FIELDS__())
+.add_arguments(PrefetcherParam::__FIELDS__())
+.add_arguments(ImageNormalizeParam::__FIELDS__())
+.set_body([]() {
+    return new PrefetcherIter(
+        new BatchLoader(
+            new ImageNormalizeIter(
+                new ImageDetRecordIter())));
+  });
+}  // namespace io
+}  // namespace mxnet
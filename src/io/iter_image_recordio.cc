@@ -4,6 +4,7 @@
  * \brief recordio data iterator
  */
 #include <mxnet/io.h>
+#include <mxnet/kvstore.h>
 #include <dmlc/base.h>
 #include <dmlc/io.h>
 #include <dmlc/omp.h>
@@ -12,15 +13,24 @@
 #include <dmlc/parameter.h>
 #include <dmlc/recordio.h>
 #include <dmlc/threadediter.h>
+#include <atomic>
 #include <unordered_map>
 #include <vector>
+#include <string>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include "./inst_vector.h"
 #include "./image_recordio.h"
+#include "./indexed_recordio.h"
 #include "./image_augmenter.h"
+#include "./image_decode.h"
 #include "./iter_prefetcher.h"
 #include "./iter_normalize.h"
 #include "./iter_batchloader.h"
+#include "./io_stats.h"
+#include "./range_read_ahead.h"
+#include "../common/thread_budget.h"
 
 namespace mxnet {
 namespace io {
@@ -88,12 +98,33 @@ class ImageLabelMap {
   std::unordered_map<size_t, real_t*> idx2label_;
 };
 
+// Define image record parameters
+struct ImageRecordParam: public dmlc::Parameter<ImageRecordParam> {
+  /*! \brief whether to do shuffle */
+  bool shuffle;
+  /*! \brief random seed */
+  int seed;
+  /*! \brief whether to remain silent */
+  bool verbose;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(ImageRecordParam) {
+    DMLC_DECLARE_FIELD(shuffle).set_default(false)
+        .describe("Augmentation Param: Whether to shuffle data.");
+    DMLC_DECLARE_FIELD(seed).set_default(0)
+        .describe("Augmentation Param: Random Seed.");
+    DMLC_DECLARE_FIELD(verbose).set_default(true)
+        .describe("Auxiliary Param: Whether to output information.");
+  }
+};
+
 // Define image record parser parameters
 struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
   /*! \brief path to image list */
   std::string path_imglist;
   /*! \brief path to image recordio */
   std::string path_imgrec;
+  /*! \brief path to the index of the image recordio */
+  std::string path_imgidx;
   /*! \brief a sequence of names of image augmenters, seperated by , */
   std::string aug_seq;
   /*! \brief label-width */
@@ -108,6 +139,22 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
   int num_parts;
   /*! \brief the index of the part will read*/
   int part_index;
+  /*! \brief number of parts taken dynamically by the workers, static parts if 0 */
+  int dynamic_parts;
+  /*! \brief whether to cache the decoded images after the first pass */
+  bool cache_decoded;
+  /*! \brief file of the cache, the cache is in memory if empty */
+  std::string cache_file;
+  /*! \brief shorter edge of the cached images, no resize if <= 0 */
+  int cache_resize;
+  /*! \brief shorter edge the JPEGs are decoded at least at, full size if <= 0 */
+  int decode_min_edge;
+  /*! \brief number of concurrent range reads of the record file, 0 for a single stream */
+  int read_ahead_threads;
+  /*! \brief bytes of a range read, in MB */
+  int read_ahead_range;
+  /*! \brief bytes of the ranges read ahead at most, in MB */
+  int read_ahead_bytes;
 
   // declare parameters
   DMLC_DECLARE_PARAMETER(ImageRecParserParam) {
@@ -115,6 +162,9 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
         .describe("Dataset Param: Path to image list.");
     DMLC_DECLARE_FIELD(path_imgrec).set_default("./data/imgrec.rec")
         .describe("Dataset Param: Path to image record file.");
+    DMLC_DECLARE_FIELD(path_imgidx).set_default("")
+        .describe("Dataset Param: Path to the index of the local image record file, "
+                  "the records are then shuffled over the whole file.");
     DMLC_DECLARE_FIELD(aug_seq).set_default("aug_default")
         .describe("Augmentation Param: the augmenter names to represent"\
                   " sequence of augmenters to be applied, seperated by comma." \
@@ -125,35 +175,107 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
         .enforce_nonzero()
         .describe("Dataset Param: Shape of each instance generated by the DataIter.");
     DMLC_DECLARE_FIELD(preprocess_threads).set_lower_bound(1).set_default(4)
-        .describe("Backend Param: Number of thread to do preprocessing.");
+        .describe("Backend Param: Number of thread to do preprocessing, "
+                  "at most the number of cores.");
     DMLC_DECLARE_FIELD(verbose).set_default(true)
         .describe("Auxiliary Param: Whether to output parser information.");
     DMLC_DECLARE_FIELD(num_parts).set_default(1)
         .describe("partition the data into multiple parts");
     DMLC_DECLARE_FIELD(part_index).set_default(0)
         .describe("the index of the part will read");
+    DMLC_DECLARE_FIELD(dynamic_parts).set_default(0).set_lower_bound(0)
+        .describe("Split the data into so many parts, taken by the workers from the "
+                  "distributed kvstore as they need them, instead of num_parts static "
+                  "parts. The faster workers read more parts, an epoch over all workers "
+                  "still reads every record once.");
+    DMLC_DECLARE_FIELD(cache_decoded).set_default(false)
+        .describe("Backend Param: Keep the decoded images of the first pass, "
+                  "the later passes only run the augmenters.");
+    DMLC_DECLARE_FIELD(cache_file).set_default("")
+        .describe("Backend Param: File of the decoded image cache, "
+                  "the cache is kept in memory if empty.");
+    DMLC_DECLARE_FIELD(cache_resize).set_default(-1)
+        .describe("Backend Param: Resize the shorter edge of the images to this "
+                  "size before caching them, no resize if <= 0.");
+    DMLC_DECLARE_FIELD(decode_min_edge).set_default(0)
+        .describe("Backend Param: Decode the JPEGs at 1/2, 1/4 or 1/8 of their size, the "
+                  "largest reduction whose shorter edge is still at least this size, "
+                  "such as the resize of the augmenter, or the shorter edge of the "
+                  "crops plus their margin. Full size if <= 0.");
+    DMLC_DECLARE_FIELD(read_ahead_threads).set_default(0).set_lower_bound(0)
+        .describe("Backend Param: Read the record file with so many concurrent range "
+                  "reads ahead of the decoding, for remote files such as on s3 or hdfs. "
+                  "A single stream if 0. The parts then take every num_parts-th range.");
+    DMLC_DECLARE_FIELD(read_ahead_range).set_default(8).set_lower_bound(1)
+        .describe("Backend Param: Size of a range read, in MB.");
+    DMLC_DECLARE_FIELD(read_ahead_bytes).set_default(256).set_lower_bound(1)
+        .describe("Backend Param: Memory budget of the ranges read ahead, in MB.");
   }
 };
 
 // parser to parse image recordio
 class ImageRecordIOParser {
  public:
+  // give back the decoding threads to the cpu thread budget
+  ~ImageRecordIOParser() {
+    common::CPUThreadBudget::Get()->Unreserve(reserved_threads_);
+  }
   // initialize the parser
   inline void Init(const std::vector<std::pair<std::string, std::string> >& kwargs);
 
   // set record to the head
   inline void BeforeFirst(void) {
+    if (cache_ready_) {
+      cache_ptr_ = 0;
+      if (param_.cache_file.length() != 0) {
+        cache_stream_.reset(dmlc::Stream::Create(param_.cache_file.c_str(), "r"));
+      }
+      return;
+    }
+    // the cache is only complete after a full pass
+    if (param_.cache_decoded) this->ResetCache();
+    if (param_.dynamic_parts != 0) {
+      ++epoch_;
+      next_part_ = 0;
+      source_.reset(nullptr);
+      return;
+    }
+    if (index_ != nullptr) {
+      return index_->BeforeFirst(record_param_.shuffle ? &index_rnd_ : nullptr);
+    }
+    if (range_source_ != nullptr) return range_source_->BeforeFirst();
     return source_->BeforeFirst();
   }
+  // set record to the head with new data shape and augmenter parameters
+  inline void Reset(const std::vector<std::pair<std::string, std::string> >& kwargs);
   // parse next set of records, return an array of
   // instance vector to the user
   inline bool ParseNext(std::vector<InstVector> *out);
 
  private:
+#if MXNET_USE_OPENCV
+  // decode a record, cache it if needed, augment it and push it to out
+  inline void ParseRecord(const dmlc::InputSplit::Blob &blob, int tid,
+                          InstVector *out, std::string *cache_buf);
+  // augment a decoded image and push it to out
+  inline void PushImage(const ImageRecordIO::Header &header,
+                        cv::Mat res, int tid, InstVector *out);
+  // append a decoded image to a cache buffer
+  inline void AppendCache(const ImageRecordIO::Header &header,
+                          const cv::Mat &res, std::string *buf);
+#endif
+  // parse the next chunk of the cache
+  inline bool ParseCached(std::vector<InstVector> *out);
+  // start a new cache
+  inline void ResetCache(void);
+  // open the next dynamic part, return false at the end of the epoch
+  inline bool NextPart(void);
   // magic nyumber to see prng
   static const int kRandMagic = 111;
   /*! \brief parameters */
   ImageRecParserParam param_;
+  /*! \brief parameters of the iterator */
+  ImageRecordParam record_param_;
   #if MXNET_USE_OPENCV
   /*! \brief augmenters */
   std::vector<std::vector<std::unique_ptr<ImageAugmenter> > > augmenters_;
@@ -162,10 +284,43 @@ class ImageRecordIOParser {
   std::vector<std::unique_ptr<common::RANDOM_ENGINE> > prnds_;
   /*! \brief data source */
   std::unique_ptr<dmlc::InputSplit> source_;
+  /*! \brief data source in random order, used instead of source_ if there is an index */
+  std::unique_ptr<IndexedRecordIOReader> index_;
+  /*! \brief data source by concurrent range reads, used instead of source_ if read_ahead_threads */
+  std::unique_ptr<RangeReadAheadReader> range_source_;
+  /*! \brief records of the chunk of index_ */
+  std::vector<size_t> index_chunk_;
+  /*! \brief random engine of the order of index_ */
+  common::RANDOM_ENGINE index_rnd_;
   /*! \brief label information, if any */
   std::unique_ptr<ImageLabelMap> label_map_;
+  /*! \brief counters of the reads of the chunks, their decode and their augmentation */
+  IOStats::Stage* read_stats_ = IOStats::Get()->GetStage("read");
+  IOStats::Stage* decode_stats_ = IOStats::Get()->GetStage("decode");
+  IOStats::Stage* augment_stats_ = IOStats::Get()->GetStage("augment");
   /*! \brief temp space */
   mshadow::TensorContainer<cpu, 3> img_;
+  /*!
+   * \brief decoded images in memory, the records of each thread per chunk,
+   *  each record is the header, the rows, cols and channels, then the pixels
+   */
+  std::vector<std::vector<std::string> > cache_;
+  /*! \brief a chunk read from the cache file */
+  std::vector<std::string> cache_chunk_;
+  /*! \brief stream of the cache file, written by the first pass */
+  std::unique_ptr<dmlc::Stream> cache_stream_;
+  /*! \brief decoding threads reserved from the cpu thread budget */
+  int reserved_threads_ = 0;
+  /*! \brief whether the cache holds all of the records */
+  bool cache_ready_ = false;
+  /*! \brief the next chunk of the cache in memory */
+  size_t cache_ptr_ = 0;
+  /*! \brief number of bytes in the cache */
+  size_t cache_bytes_ = 0;
+  /*! \brief the epoch of the dynamic parts */
+  int epoch_ = 0;
+  /*! \brief the next dynamic part without a distributed kvstore */
+  int next_part_ = 0;
 };
 
 inline void ImageRecordIOParser::Init(
@@ -177,10 +332,14 @@ inline void ImageRecordIOParser::Init(
   int maxthread, threadget;
   #pragma omp parallel
   {
-    // be conservative, set number of real cores
-    maxthread = std::max(omp_get_num_procs() / 2 - 1, 1);
+    // decoding is the bottleneck of the input, allow all the cores
+    maxthread = std::max(omp_get_num_procs(), 1);
   }
   param_.preprocess_threads = std::min(maxthread, param_.preprocess_threads);
+  // the decoding threads are drawn from the cpu thread budget, shared with the operators
+  common::CPUThreadBudget::Get()->Unreserve(reserved_threads_);
+  reserved_threads_ = common::CPUThreadBudget::Get()->Reserve(param_.preprocess_threads);
+  param_.preprocess_threads = reserved_threads_;
   #pragma omp parallel num_threads(param_.preprocess_threads)
   {
     threadget = omp_get_num_threads();
@@ -211,75 +370,274 @@ inline void ImageRecordIOParser::Init(
     LOG(INFO) << "ImageRecordIOParser: " << param_.path_imgrec
               << ", use " << threadget << " threads for decoding..";
   }
-  source_.reset(dmlc::InputSplit::Create(
-      param_.path_imgrec.c_str(), param_.part_index,
-      param_.num_parts, "recordio"));
   // use 64 MB chunk when possible
-  source_->HintChunkSize(8 << 20UL);
+  const size_t chunk_size = 8 << 20UL;
+  if (param_.path_imgidx.length() != 0) {
+    record_param_.InitAllowUnknown(kwargs);
+    index_.reset(new IndexedRecordIOReader(param_.path_imgrec, param_.path_imgidx,
+                                           param_.part_index, param_.num_parts, chunk_size));
+    index_rnd_.seed(kRandMagic + record_param_.seed);
+    index_->BeforeFirst(record_param_.shuffle ? &index_rnd_ : nullptr);
+    if (param_.verbose) {
+      LOG(INFO) << "ImageRecordIOParser: " << index_->NumRecords()
+                << " records indexed by " << param_.path_imgidx;
+    }
+  } else if (param_.dynamic_parts != 0) {
+    CHECK_EQ(param_.num_parts, 1) << "num_parts cannot be used with dynamic_parts";
+    CHECK(!param_.cache_decoded)
+        << "cache_decoded cannot be used with dynamic_parts, the parts change over the epochs";
+    if (param_.verbose && KVStore::DataPartServer() == nullptr) {
+      LOG(INFO) << "ImageRecordIOParser: no distributed kvstore, "
+                << "all of the dynamic parts are read";
+    }
+  } else if (param_.read_ahead_threads != 0) {
+    range_source_.reset(new RangeReadAheadReader(
+        param_.path_imgrec, param_.part_index, param_.num_parts,
+        param_.read_ahead_threads, static_cast<size_t>(param_.read_ahead_range) << 20UL,
+        static_cast<size_t>(param_.read_ahead_bytes) << 20UL));
+  } else {
+    source_.reset(dmlc::InputSplit::Create(
+        param_.path_imgrec.c_str(), param_.part_index,
+        param_.num_parts, "recordio"));
+    source_->HintChunkSize(chunk_size);
+  }
+  if (param_.cache_decoded) this->ResetCache();
 #else
   LOG(FATAL) << "ImageRec need opencv to process";
 #endif
 }
 
+inline void ImageRecordIOParser::Reset(
+    const std::vector<std::pair<std::string, std::string> >& kwargs) {
+#if MXNET_USE_OPENCV
+  // only the data shape and the augmenters change, the sources and the threads are kept
+  ImageRecParserParam param;
+  param.InitAllowUnknown(kwargs);
+  param_.data_shape = param.data_shape;
+  std::vector<std::string> aug_names = dmlc::Split(param.aug_seq, ',');
+  for (int i = 0; i < param_.preprocess_threads; ++i) {
+    augmenters_[i].clear();
+    for (const auto& aug_name : aug_names) {
+      augmenters_[i].emplace_back(ImageAugmenter::Create(aug_name));
+      augmenters_[i].back()->Init(kwargs);
+    }
+  }
+#endif
+  this->BeforeFirst();
+}
+
+inline bool ImageRecordIOParser::NextPart(void) {
+  KVStore *kv = KVStore::DataPartServer();
+  int part;
+  if (kv != nullptr) {
+    part = kv->TakeDataPart(param_.path_imgrec, epoch_, param_.dynamic_parts);
+  } else {
+    part = next_part_ < param_.dynamic_parts ? next_part_++ : -1;
+  }
+  if (part < 0) return false;
+  source_.reset(dmlc::InputSplit::Create(
+      param_.path_imgrec.c_str(), part, param_.dynamic_parts, "recordio"));
+  source_->HintChunkSize(8 << 20UL);
+  return true;
+}
+
+inline void ImageRecordIOParser::ResetCache(void) {
+  cache_.clear();
+  cache_bytes_ = 0;
+  if (param_.cache_file.length() != 0) {
+    cache_stream_.reset(dmlc::Stream::Create(param_.cache_file.c_str(), "w"));
+  }
+}
+
+#if MXNET_USE_OPENCV
+inline void ImageRecordIOParser::
+ParseRecord(const dmlc::InputSplit::Blob &blob, int tid,
+            InstVector *out, std::string *cache_buf) {
+  // Opencv decode and augments
+  ImageRecordIO rec;
+  rec.Load(blob.dptr, blob.size);
+  cv::Mat buf(1, rec.content_size, CV_8U, rec.content);
+  // keep the number of channels of the encoded image, and not force gray or color.
+  cv::Mat res;
+  {
+    IOStageScope scope(decode_stats_);
+    res = DecodeImage(buf, param_.decode_min_edge);
+  }
+  if (cache_buf != nullptr) {
+    const int min_edge = std::min(res.rows, res.cols);
+    if (param_.cache_resize > 0 && min_edge != param_.cache_resize) {
+      const double s = static_cast<double>(param_.cache_resize) / min_edge;
+      cv::resize(res, res, cv::Size(std::max(1, static_cast<int>(res.cols * s + 0.5)),
+                                    std::max(1, static_cast<int>(res.rows * s + 0.5))),
+                 0, 0, s < 1.0 ? cv::INTER_AREA : cv::INTER_CUBIC);
+    }
+    this->AppendCache(rec.header, res, cache_buf);
+  }
+  this->PushImage(rec.header, res, tid, out);
+}
+
+inline void ImageRecordIOParser::
+PushImage(const ImageRecordIO::Header &header, cv::Mat res, int tid, InstVector *out) {
+  const int n_channels = res.channels();
+  {
+    IOStageScope scope(augment_stats_);
+    for (auto& aug : augmenters_[tid]) {
+      res = aug->Process(res, prnds_[tid].get());
+    }
+  }
+  out->Push(static_cast<unsigned>(header.image_id[0]),
+            mshadow::Shape3(n_channels, res.rows, res.cols),
+            mshadow::Shape1(param_.label_width));
+
+  mshadow::Tensor<cpu, 3> data = out->data().Back();
+
+  // For RGB or RGBA data, swap the B and R channel:
+  // OpenCV store as BGR (or BGRA) and we want RGB (or RGBA)
+  std::vector<int> swap_indices;
+  if (n_channels == 1) swap_indices = {0};
+  if (n_channels == 3) swap_indices = {2, 1, 0};
+  if (n_channels == 4) swap_indices = {2, 1, 0, 3};
+
+  for (int i = 0; i < res.rows; ++i) {
+    const uchar* im_data = res.ptr<uchar>(i);
+    for (int j = 0; j < res.cols; ++j) {
+      for (int k = 0; k < n_channels; ++k) {
+          data[k][i][j] = im_data[swap_indices[k]];
+      }
+      im_data += n_channels;
+    }
+  }
+
+  mshadow::Tensor<cpu, 1> label = out->label().Back();
+  if (label_map_ != nullptr) {
+    mshadow::Copy(label, label_map_->Find(header.image_id[0]));
+  } else {
+    label[0] = header.label;
+  }
+}
+
+inline void ImageRecordIOParser::
+AppendCache(const ImageRecordIO::Header &header, const cv::Mat &res, std::string *buf) {
+  const int32_t shape[3] = {res.rows, res.cols, res.channels()};
+  const size_t row_size = res.cols * res.elemSize();
+  const size_t begin = buf->size();
+  buf->resize(begin + sizeof(header) + sizeof(shape) + res.rows * row_size);
+  char *p = &(*buf)[begin];
+  std::memcpy(p, &header, sizeof(header));
+  p += sizeof(header);
+  std::memcpy(p, shape, sizeof(shape));
+  p += sizeof(shape);
+  for (int i = 0; i < res.rows; ++i, p += row_size) {
+    std::memcpy(p, res.ptr<uchar>(i), row_size);
+  }
+}
+#endif
+
+inline bool ImageRecordIOParser::ParseCached(std::vector<InstVector> *out_vec) {
+  const std::vector<std::string> *chunk;
+  if (param_.cache_file.length() != 0) {
+    CHECK(cache_stream_ != nullptr);
+    if (!cache_stream_->Read(&cache_chunk_)) return false;
+    chunk = &cache_chunk_;
+  } else {
+    if (cache_ptr_ >= cache_.size()) return false;
+    chunk = &cache_[cache_ptr_++];
+  }
+  CHECK_EQ(chunk->size(), static_cast<size_t>(param_.preprocess_threads))
+      << "invalid decoded image cache " << param_.cache_file;
+#if MXNET_USE_OPENCV
+  out_vec->resize(param_.preprocess_threads);
+  #pragma omp parallel num_threads(param_.preprocess_threads)
+  {
+    CHECK(omp_get_num_threads() == param_.preprocess_threads);
+    int tid = omp_get_thread_num();
+    InstVector &out = (*out_vec)[tid];
+    out.Clear();
+    const std::string &buf = (*chunk)[tid];
+    const char *p = buf.data(), *end = buf.data() + buf.size();
+    ImageRecordIO::Header header;
+    int32_t shape[3];
+    while (p != end) {
+      std::memcpy(&header, p, sizeof(header));
+      p += sizeof(header);
+      std::memcpy(shape, p, sizeof(shape));
+      p += sizeof(shape);
+      // the augmenters do not write to their input
+      cv::Mat res(shape[0], shape[1], CV_8UC(shape[2]), const_cast<char*>(p));
+      p += res.total() * res.elemSize();
+      this->PushImage(header, res, tid, &out);
+    }
+  }
+#endif
+  return true;
+}
+
 inline bool ImageRecordIOParser::
 ParseNext(std::vector<InstVector> *out_vec) {
-  CHECK(source_ != nullptr);
+  if (cache_ready_) return this->ParseCached(out_vec);
   dmlc::InputSplit::Blob chunk;
-  if (!source_->NextChunk(&chunk)) return false;
+  bool has_chunk;
+  {
+    IOStageScope scope(read_stats_);
+    if (index_ != nullptr) {
+      has_chunk = index_->NextChunk(&index_chunk_);
+    } else if (param_.dynamic_parts != 0) {
+      has_chunk = source_ != nullptr && source_->NextChunk(&chunk);
+      while (!has_chunk && this->NextPart()) {
+        has_chunk = source_->NextChunk(&chunk);
+      }
+    } else if (range_source_ != nullptr) {
+      has_chunk = range_source_->NextChunk(&chunk);
+    } else {
+      CHECK(source_ != nullptr);
+      has_chunk = source_->NextChunk(&chunk);
+    }
+    scope.set_items(has_chunk ? 1 : 0);
+  }
+  if (!has_chunk) {
+    if (param_.cache_decoded) {
+      cache_stream_.reset(nullptr);
+      cache_ready_ = true;
+      if (param_.verbose) {
+        LOG(INFO) << "ImageRecordIOParser: cached " << (cache_bytes_ >> 20UL)
+                  << " MB of decoded images"
+                  << (param_.cache_file.length() != 0 ? " in " + param_.cache_file : "");
+      }
+    }
+    return false;
+  }
 #if MXNET_USE_OPENCV
   // save opencv out
   out_vec->resize(param_.preprocess_threads);
+  std::vector<std::string> cache_chunk(param_.cache_decoded ? param_.preprocess_threads : 0);
   #pragma omp parallel num_threads(param_.preprocess_threads)
   {
     CHECK(omp_get_num_threads() == param_.preprocess_threads);
     int tid = omp_get_thread_num();
-    dmlc::RecordIOChunkReader reader(chunk, tid, param_.preprocess_threads);
-    ImageRecordIO rec;
     dmlc::InputSplit::Blob blob;
     // image data
     InstVector &out = (*out_vec)[tid];
     out.Clear();
-    while (reader.NextRecord(&blob)) {
-      // Opencv decode and augments
-      cv::Mat res;
-      rec.Load(blob.dptr, blob.size);
-      cv::Mat buf(1, rec.content_size, CV_8U, rec.content);
-      // -1 to keep the number of channel of the encoded image, and not force gray or color.
-      res = cv::imdecode(buf, -1);
-      const int n_channels = res.channels();
-      for (auto& aug : augmenters_[tid]) {
-        res = aug->Process(res, prnds_[tid].get());
+    std::string *cache_buf = param_.cache_decoded ? &cache_chunk[tid] : nullptr;
+    if (index_ != nullptr) {
+      std::string buf;
+      for (size_t i = tid; i < index_chunk_.size(); i += param_.preprocess_threads) {
+        index_->Record(index_chunk_[i], &blob, &buf);
+        this->ParseRecord(blob, tid, &out, cache_buf);
       }
-      out.Push(static_cast<unsigned>(rec.image_index()),
-               mshadow::Shape3(n_channels, res.rows, res.cols),
-               mshadow::Shape1(param_.label_width));
-
-      mshadow::Tensor<cpu, 3> data = out.data().Back();
-
-      // For RGB or RGBA data, swap the B and R channel:
-      // OpenCV store as BGR (or BGRA) and we want RGB (or RGBA)
-      std::vector<int> swap_indices;
-      if (n_channels == 1) swap_indices = {0};
-      if (n_channels == 3) swap_indices = {2, 1, 0};
-      if (n_channels == 4) swap_indices = {2, 1, 0, 3};
-
-      for (int i = 0; i < res.rows; ++i) {
-        uchar* im_data = res.ptr<uchar>(i);
-        for (int j = 0; j < res.cols; ++j) {
-          for (int k = 0; k < n_channels; ++k) {
-              data[k][i][j] = im_data[swap_indices[k]];
-          }
-          im_data += n_channels;
-        }
-      }
-
-      mshadow::Tensor<cpu, 1> label = out.label().Back();
-      if (label_map_ != nullptr) {
-        mshadow::Copy(label, label_map_->Find(rec.image_index()));
-      } else {
-        label[0] = rec.header.label;
+    } else {
+      dmlc::RecordIOChunkReader reader(chunk, tid, param_.preprocess_threads);
+      while (reader.NextRecord(&blob)) {
+        this->ParseRecord(blob, tid, &out, cache_buf);
       }
-      res.release();
+    }
+  }
+  if (param_.cache_decoded) {
+    for (const std::string &buf : cache_chunk) cache_bytes_ += buf.size();
+    if (cache_stream_ != nullptr) {
+      cache_stream_->Write(cache_chunk);
+    } else {
+      cache_.emplace_back(std::move(cache_chunk));
     }
   }
 #else
@@ -288,25 +646,6 @@ ParseNext(std::vector<InstVector> *out_vec) {
   return true;
 }
 
-// Define image record parameters
-struct ImageRecordParam: public dmlc::Parameter<ImageRecordParam> {
-  /*! \brief whether to do shuffle */
-  bool shuffle;
-  /*! \brief random seed */
-  int seed;
-  /*! \brief whether to remain silent */
-  bool verbose;
-  // declare parameters
-  DMLC_DECLARE_PARAMETER(ImageRecordParam) {
-    DMLC_DECLARE_FIELD(shuffle).set_default(false)
-        .describe("Augmentation Param: Whether to shuffle data.");
-    DMLC_DECLARE_FIELD(seed).set_default(0)
-        .describe("Augmentation Param: Random Seed.");
-    DMLC_DECLARE_FIELD(verbose).set_default(true)
-        .describe("Auxiliary Param: Whether to output information.");
-  }
-};
-
 // iterator on image recordio
 class ImageRecordIter : public IIterator<DataInst> {
  public:
@@ -324,13 +663,25 @@ class ImageRecordIter : public IIterator<DataInst> {
     // prefetch at most 4 minbatches
     iter_.set_max_capacity(4);
     // init thread iter
+    stats_->queue_capacity = 4;
     iter_.Init([this](std::vector<InstVector> **dptr) {
         if (*dptr == nullptr) {
           *dptr = new std::vector<InstVector>();
         }
-        return parser_.ParseNext(*dptr);
+        IOStageScope scope(stats_, 0);
+        if (!parser_.ParseNext(*dptr)) return false;
+        scope.set_items(1);
+        ++produced_;
+        return true;
       },
-      [this]() { parser_.BeforeFirst(); });
+      [this]() {
+        if (reset_) {
+          parser_.Reset(kwargs_);
+          reset_ = false;
+        } else {
+          parser_.BeforeFirst();
+        }
+      });
     inst_ptr_ = 0;
     rnd_.seed(kRandMagic + param_.seed);
   }
@@ -339,6 +690,14 @@ class ImageRecordIter : public IIterator<DataInst> {
     iter_.BeforeFirst();
     inst_order_.clear();
     inst_ptr_ = 0;
+    produced_ = consumed_ = 0;
+  }
+  // before first, with new parameters of the parser
+  virtual void Reset(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    // the parser is reset by the parse thread, stopped by BeforeFirst
+    kwargs_ = kwargs;
+    reset_ = true;
+    this->BeforeFirst();
   }
 
   virtual bool Next(void) {
@@ -350,7 +709,9 @@ class ImageRecordIter : public IIterator<DataInst> {
         return true;
       } else {
         if (data_ != nullptr) iter_.Recycle(&data_);
+        stats_->SampleQueue(produced_ - consumed_);
         if (!iter_.Next(&data_)) return false;
+        ++consumed_;
         inst_order_.clear();
         for (unsigned i = 0; i < data_->size(); ++i) {
           const InstVector& tmp = (*data_)[i];
@@ -387,8 +748,16 @@ class ImageRecordIter : public IIterator<DataInst> {
   ImageRecordIOParser parser_;
   // backend thread
   dmlc::ThreadedIter<std::vector<InstVector> > iter_;
+  // chunks parsed and read, their difference is the occupancy of iter_
+  std::atomic<int64_t> produced_{0}, consumed_{0};
+  // counters of the parsed chunks waiting in iter_
+  IOStats::Stage* stats_ = IOStats::Get()->GetStage("parse");
   // parameters
   ImageRecordParam param_;
+  // parameters of the next reset of the parser
+  std::vector<std::pair<std::string, std::string> > kwargs_;
+  // whether the next BeforeFirst of iter_ resets the parser with kwargs_
+  bool reset_ = false;
   // random number generator
   common::RANDOM_ENGINE rnd_;
 };
@@ -0,0 +1,163 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file iter_libsvm.cc
+ * \brief define a LibSVM Reader to read in sparse batches
+ */
+#include <mxnet/io.h>
+#include <dmlc/base.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <dmlc/data.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "./inst_vector.h"
+#include "./iter_prefetcher.h"
+
+namespace mxnet {
+namespace io {
+// LibSVM parameters
+struct LibSVMIterParam : public dmlc::Parameter<LibSVMIterParam> {
+  /*! \brief path to the libsvm file */
+  std::string data_libsvm;
+  /*! \brief number of features */
+  TShape data_shape;
+  /*! \brief batch size */
+  index_t batch_size;
+  /*! \brief maximum number of non-zeros of a batch */
+  index_t max_nnz;
+  /*! \brief partition the data into multiple parts */
+  int num_parts;
+  /*! \brief the index of the part will read */
+  int part_index;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(LibSVMIterParam) {
+    DMLC_DECLARE_FIELD(data_libsvm)
+        .describe("Dataset Param: Data libsvm path.");
+    DMLC_DECLARE_FIELD(data_shape)
+        .describe("Dataset Param: Shape of the data, the number of features. "
+                  "The feature indices of the file are 0-based column indices.");
+    DMLC_DECLARE_FIELD(batch_size)
+        .describe("Batch Param: Batch size.");
+    DMLC_DECLARE_FIELD(max_nnz)
+        .describe("Batch Param: Maximum number of non-zeros of a batch, the size of the "
+                  "values and of the indices of each batch.");
+    DMLC_DECLARE_FIELD(num_parts).set_default(1)
+        .describe("partition the data into multiple parts");
+    DMLC_DECLARE_FIELD(part_index).set_default(0)
+        .describe("the index of the part will read");
+  }
+};
+
+/*!
+ * \brief batches of a libsvm file in compressed sparse row format. The data of a batch
+ *  are the values of the non-zeros, the label, the column indices of the non-zeros and
+ *  the batch_size + 1 row pointers. The values and the indices have max_nnz elements,
+ *  their tail after the non-zeros has the value zero and repeats the last index, so
+ *  that the unique indices are the columns of the batch. The padding rows of the last
+ *  batch are empty.
+ */
+class LibSVMIter: public IIterator<TBlobBatch> {
+ public:
+  LibSVMIter() {}
+  virtual ~LibSVMIter() {}
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    CHECK_EQ(param_.data_shape.ndim(), 1) << "LibSVMIter: data_shape is the number of features";
+    // the indices are stored as float32, as the data of Embedding
+    CHECK_LE(param_.data_shape[0], 1U << 24) << "LibSVMIter: at most 2^24 features";
+    CHECK(param_.part_index >= 0 && param_.part_index < param_.num_parts)
+        << "invalid part_index " << param_.part_index << " of " << param_.num_parts << " parts";
+    parser_.reset(dmlc::Parser<uint32_t>::Create(param_.data_libsvm.c_str(),
+                                                 param_.part_index, param_.num_parts,
+                                                 "libsvm"));
+    const index_t batch = param_.batch_size;
+    value_.resize(param_.max_nnz);
+    index_.resize(param_.max_nnz);
+    indptr_.resize(batch + 1);
+    label_.resize(batch);
+    out_.batch_size = batch;
+    out_.data.clear();
+    out_.data.push_back(TBlob(dmlc::BeginPtr(value_), mshadow::Shape1(param_.max_nnz),
+                              cpu::kDevMask));
+    out_.data.push_back(TBlob(dmlc::BeginPtr(label_), mshadow::Shape2(batch, 1),
+                              cpu::kDevMask));
+    out_.data.push_back(TBlob(dmlc::BeginPtr(index_), mshadow::Shape1(param_.max_nnz),
+                              cpu::kDevMask));
+    out_.data.push_back(TBlob(dmlc::BeginPtr(indptr_), mshadow::Shape1(batch + 1),
+                              cpu::kDevMask));
+    this->BeforeFirst();
+  }
+
+  virtual void BeforeFirst() {
+    parser_->BeforeFirst();
+    block_.size = 0;
+    row_ = 0;
+  }
+
+  virtual bool Next() {
+    const index_t batch = param_.batch_size, dim = param_.data_shape[0];
+    index_t n = 0, nnz = 0;
+    indptr_[0] = 0.0f;
+    while (n < batch) {
+      if (row_ == block_.size) {
+        if (!parser_->Next()) break;
+        block_ = parser_->Value();
+        row_ = 0;
+        continue;
+      }
+      const size_t begin = block_.offset[row_], end = block_.offset[row_ + 1];
+      CHECK_LE(nnz + (end - begin), param_.max_nnz)
+          << "LibSVMIter: a batch has more than max_nnz=" << param_.max_nnz << " non-zeros";
+      for (size_t k = begin; k < end; ++k, ++nnz) {
+        CHECK_LT(block_.index[k], dim) << "LibSVMIter: feature index out of data_shape";
+        index_[nnz] = static_cast<real_t>(block_.index[k]);
+        value_[nnz] = block_.value == NULL ? 1.0f : block_.value[k];
+      }
+      label_[n] = block_.label[row_++];
+      indptr_[++n] = static_cast<real_t>(nnz);
+    }
+    if (n == 0) return false;
+    out_.num_batch_padd = batch - n;
+    for (; n < batch; ++n) {
+      label_[n] = 0.0f;
+      indptr_[n + 1] = static_cast<real_t>(nnz);
+    }
+    std::fill(value_.begin() + nnz, value_.end(), 0.0f);
+    std::fill(index_.begin() + nnz, index_.end(), nnz == 0 ? 0.0f : index_[nnz - 1]);
+    return true;
+  }
+
+  virtual const TBlobBatch &Value(void) const {
+    return out_;
+  }
+
+ private:
+  LibSVMIterParam param_;
+  // output batch
+  TBlobBatch out_;
+  // the buffers of the batch
+  std::vector<real_t> value_, label_, index_, indptr_;
+  // the parser of the file, its current block and the next row of the block
+  std::unique_ptr<dmlc::Parser<uint32_t> > parser_;
+  dmlc::RowBlock<uint32_t> block_;
+  size_t row_;
+};
+
+
+DMLC_REGISTER_PARAMETER(LibSVMIterParam);
+
+MXNET_REGISTER_IO_ITER(LibSVMIter)
+.describe("Create iterator for sparse dataset in libsvm format. The data of a batch "
+          "is in compressed sparse row format: the values, the indices and the row "
+          "pointers, as the inputs of SparseFullyConnected.")
+.add_arguments(LibSVMIterParam::__FIELDS__())
+.set_body([]() {
+    return new PrefetcherIter(
+        new LibSVMIter());
+  });
+
+}  // namespace io
+}  // namespace mxnet
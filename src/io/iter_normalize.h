@@ -14,9 +14,12 @@
 #include <dmlc/timer.h>
 #include <mshadow/tensor.h>
 #include <utility>
+#include <sstream>
 #include <string>
 #include <vector>
 #include "../common/utils.h"
+#include "./inst_vector.h"
+#include "./io_stats.h"
 
 namespace mxnet {
 namespace io {
@@ -79,16 +82,29 @@ struct ImageNormalizeParam :  public dmlc::Parameter<ImageNormalizeParam> {
 /*!
  * \brief Iterator that normalize a image.
  *  It also applies a few augmention before normalization.
+ *  As an IInstWriter, the normalized image is written into the batch directly.
  */
-class ImageNormalizeIter : public IIterator<DataInst> {
+class ImageNormalizeIter : public IIterator<DataInst>, public IInstWriter {
  public:
   explicit ImageNormalizeIter(IIterator<DataInst> *base)
-      : base_(base), meanfile_ready_(false) {
+      : base_(base), meanfile_ready_(false), raw_(false),
+        stats_(IOStats::Get()->GetStage("normalize")) {
   }
 
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
     param_.InitAllowUnknown(kwargs);
     base_->Init(kwargs);
+    // uint8 output of the prefetcher, the images are normalized by the ImageNormalize operator
+    for (const auto& kv : kwargs) {
+      if (kv.first == "dtype" && kv.second == "uint8") raw_ = true;
+    }
+    if (raw_) {
+      CHECK_EQ(param_.mean_img.length(), 0)
+          << "mean_img is not supported with dtype uint8, use mean_r, mean_g and mean_b";
+      CHECK(param_.max_random_contrast == 0.0f && param_.max_random_illumination == 0.0f)
+          << "random contrast and illumination are not supported with dtype uint8";
+      return;
+    }
     rnd_.seed(kRandMagic + param_.seed);
     outimg_.set_pad(false);
     meanimg_.set_pad(false);
@@ -124,6 +140,18 @@ class ImageNormalizeIter : public IIterator<DataInst> {
     base_->BeforeFirst();
   }
 
+  virtual void Reset(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    for (const auto& kv : kwargs) {
+      if (kv.first != "data_shape" || !meanfile_ready_) continue;
+      TShape shape;
+      std::istringstream is(kv.second);
+      is >> shape;
+      CHECK(shape == TShape(meanimg_.shape_))
+          << "mean_img cannot be used when data_shape changes, use mean_r, mean_g and mean_b";
+    }
+    base_->Reset(kwargs);
+  }
+
   virtual const DataInst& Value(void) const {
     return out_;
   }
@@ -133,11 +161,32 @@ class ImageNormalizeIter : public IIterator<DataInst> {
     return true;
   }
 
+  virtual bool NextInto(const std::vector<TBlob> &out, unsigned *index) {
+    if (!base_->Next()) return false;
+    IOStageScope scope(stats_);
+    const DataInst &src = base_->Value();
+    CHECK_EQ(out.size(), 2);
+    CHECK_EQ(out[0].shape_.Size(), src.data[0].shape_.Size());
+    CHECK_EQ(out[1].shape_.Size(), src.data[1].shape_.Size());
+    mshadow::Tensor<cpu, 3> data = src.data[0].get<cpu, 3, real_t>();
+    mshadow::Tensor<cpu, 3> dst(static_cast<real_t*>(out[0].dptr_), data.shape_);
+    if (raw_) {
+      mshadow::Copy(dst, data);
+    } else {
+      this->SetOutImg(src, dst);
+    }
+    mshadow::Copy(out[1].FlatTo2D<cpu, real_t>(), src.data[1].FlatTo2D<cpu, real_t>());
+    *index = src.index;
+    return true;
+  }
+
  private:
   /*! \brief base iterator */
   std::unique_ptr<IIterator<DataInst> > base_;
   // whether mean image is ready.
   bool meanfile_ready_;
+  // whether to output the images without normalization
+  bool raw_;
   /*! \brief output data */
   DataInst out_;
   // normalize parameter.
@@ -150,14 +199,22 @@ class ImageNormalizeIter : public IIterator<DataInst> {
   common::RANDOM_ENGINE rnd_;
   // random magic number of this iterator
   static const int kRandMagic = 0;
+  /*! \brief counters of the stage */
+  IOStats::Stage* stats_;
 
   /*! \brief internal next function, inlined for fater processing. */
   inline bool Next_(void) {
     if (!base_->Next()) return false;
+    IOStageScope scope(stats_);
     const DataInst &src = base_->Value();
-    this->SetOutImg(src);
     out_.data.resize(2);
-    out_.data[0] = outimg_;
+    if (raw_) {
+      out_.data[0] = src.data[0];
+    } else {
+      outimg_.Resize(src.data[0].shape_.get<3>());
+      this->SetOutImg(src, outimg_);
+      out_.data[0] = outimg_;
+    }
     out_.data[1] = src.data[1];
     out_.index = src.index;
     out_.extra_data = src.extra_data;
@@ -166,15 +223,15 @@ class ImageNormalizeIter : public IIterator<DataInst> {
   /*!
    * \brief Set the output image, after augmentation and normalization.
    * \param src The source image.
+   * \param outimg The output image, of the shape of the source.
    */
-  inline void SetOutImg(const DataInst &src) {
+  inline void SetOutImg(const DataInst &src, mshadow::Tensor<cpu, 3> outimg) {
     using namespace mshadow::expr;  // NOLINT(*)
 
     std::uniform_real_distribution<float> rand_uniform(0, 1);
     std::bernoulli_distribution coin_flip(0.5);
     mshadow::Tensor<cpu, 3> data = src.data[0].get<cpu, 3, real_t>();
 
-    outimg_.Resize(data.shape_);
     float contrast =
         rand_uniform(rnd_) * param_.max_random_contrast * 2 - param_.max_random_contrast + 1;
     float illumination =
@@ -192,23 +249,23 @@ class ImageNormalizeIter : public IIterator<DataInst> {
         data[3] -= param_.mean_a;
       }
       if ((param_.rand_mirror && coin_flip(rnd_)) || param_.mirror) {
-        outimg_ = mirror(data * contrast + illumination) * param_.scale;
+        outimg = mirror(data * contrast + illumination) * param_.scale;
       } else {
-        outimg_ = (data * contrast + illumination) * param_.scale;
+        outimg = (data * contrast + illumination) * param_.scale;
       }
     } else if (!meanfile_ready_ || param_.mean_img.length() == 0) {
       // do not substract anything
       if ((param_.rand_mirror && coin_flip(rnd_)) || param_.mirror) {
-        outimg_ = mirror(data) * param_.scale;
+        outimg = mirror(data) * param_.scale;
       } else {
-        outimg_ = F<mshadow::op::identity>(data) * param_.scale;
+        outimg = F<mshadow::op::identity>(data) * param_.scale;
       }
     } else {
       CHECK(meanfile_ready_);
       if ((param_.rand_mirror && coin_flip(rnd_)) || param_.mirror) {
-        outimg_ = mirror((data - meanimg_) * contrast + illumination) * param_.scale;
+        outimg = mirror((data - meanimg_) * contrast + illumination) * param_.scale;
       } else {
-        outimg_ = ((data - meanimg_) * contrast + illumination) * param_.scale;
+        outimg = ((data - meanimg_) * contrast + illumination) * param_.scale;
       }
     }
   }
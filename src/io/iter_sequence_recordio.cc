@@ -0,0 +1,236 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file iter_sequence_recordio.cc
+ * \brief iterator over variable length sequences in recordio, batched by length buckets
+ *
+ *  A record is a uint32 length and a uint32 feature dimension, the length x
+ *  dimension float32 features, then the length float32 labels. A dimension of
+ *  0 means token ids, one float per step. Each sequence goes to the shortest
+ *  bucket it fits in, the sequences longer than the largest bucket are dropped.
+ *  A batch holds the sequences of a single bucket padded to its length, its
+ *  bucket_key is that length.
+ */
+#include <mxnet/io.h>
+#include <dmlc/base.h>
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./inst_vector.h"
+#include "./iter_prefetcher.h"
+#include "../common/utils.h"
+
+namespace mxnet {
+namespace io {
+// parameters of the sequence iterator
+struct SequenceRecordParam : public dmlc::Parameter<SequenceRecordParam> {
+  /*! \brief path to the recordio */
+  std::string path_seqrec;
+  /*! \brief lengths of the buckets */
+  TShape buckets;
+  /*! \brief batch size */
+  index_t batch_size;
+  /*! \brief value of the padded steps of the data */
+  float data_pad;
+  /*! \brief value of the padded steps of the label */
+  float label_pad;
+  /*! \brief whether to shuffle the sequences and the batches at each epoch */
+  bool shuffle;
+  /*! \brief random seed of the shuffle */
+  int seed;
+  /*! \brief partition the data into multiple parts */
+  int num_parts;
+  /*! \brief the index of the part will read */
+  int part_index;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(SequenceRecordParam) {
+    DMLC_DECLARE_FIELD(path_seqrec)
+        .describe("Dataset Param: Path to the sequence recordio.");
+    DMLC_DECLARE_FIELD(buckets)
+        .describe("Dataset Param: Lengths of the buckets, the padded lengths of the "
+                  "batches. Longer sequences are dropped.");
+    DMLC_DECLARE_FIELD(batch_size)
+        .describe("Batch Param: Batch size.");
+    DMLC_DECLARE_FIELD(data_pad).set_default(0.0f)
+        .describe("Dataset Param: Value of the padded steps of the data.");
+    DMLC_DECLARE_FIELD(label_pad).set_default(0.0f)
+        .describe("Dataset Param: Value of the padded steps of the label.");
+    DMLC_DECLARE_FIELD(shuffle).set_default(false)
+        .describe("Augmentation Param: Whether to shuffle the sequences of the buckets "
+                  "and the order of the batches at each epoch.");
+    DMLC_DECLARE_FIELD(seed).set_default(0)
+        .describe("Augmentation Param: Random seed of the shuffle.");
+    DMLC_DECLARE_FIELD(num_parts).set_default(1)
+        .describe("partition the data into multiple parts");
+    DMLC_DECLARE_FIELD(part_index).set_default(0)
+        .describe("the index of the part will read");
+  }
+};
+
+/*!
+ * \brief batches of the sequences of a recordio, held in memory.
+ *
+ *  The last batch of a bucket is padded with its first sequences, its
+ *  num_batch_padd tells how many.
+ */
+class SequenceRecordIter : public IIterator<TBlobBatch> {
+ public:
+  virtual ~SequenceRecordIter() {}
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    CHECK_GT(param_.buckets.ndim(), 0) << "buckets must not be empty";
+    CHECK_GT(param_.batch_size, 0);
+    buckets_.assign(param_.buckets.begin(), param_.buckets.end());
+    std::sort(buckets_.begin(), buckets_.end());
+    this->Load();
+    rnd_.seed(kRandMagic + param_.seed);
+    out_.inst_index = new unsigned[param_.batch_size];
+    out_.batch_size = param_.batch_size;
+    this->BeforeFirst();
+  }
+
+  virtual void BeforeFirst() {
+    if (param_.shuffle) {
+      for (std::vector<unsigned>& seqs : bucket_seqs_) {
+        std::shuffle(seqs.begin(), seqs.end(), rnd_);
+      }
+    }
+    // a batch is a bucket and its first sequence in the bucket
+    batches_.clear();
+    for (size_t b = 0; b < bucket_seqs_.size(); ++b) {
+      for (size_t i = 0; i < bucket_seqs_[b].size(); i += param_.batch_size) {
+        batches_.push_back(std::make_pair(static_cast<unsigned>(b), static_cast<unsigned>(i)));
+      }
+    }
+    if (param_.shuffle) std::shuffle(batches_.begin(), batches_.end(), rnd_);
+    batch_ptr_ = 0;
+  }
+
+  virtual bool Next() {
+    if (batch_ptr_ >= batches_.size()) return false;
+    const unsigned b = batches_[batch_ptr_].first;
+    const unsigned begin = batches_[batch_ptr_].second;
+    ++batch_ptr_;
+    const std::vector<unsigned>& seqs = bucket_seqs_[b];
+    const index_t len = buckets_[b];
+    const index_t bs = param_.batch_size;
+    const index_t step = std::max<index_t>(dim_, 1);
+    data_.assign(bs * len * step, param_.data_pad);
+    label_.assign(bs * len, param_.label_pad);
+    real_t *data = data_.data(), *label = label_.data();
+    const index_t count = std::min<index_t>(bs, seqs.size() - begin);
+    for (index_t i = 0; i < bs; ++i) {
+      // the padded instances repeat the first ones of the bucket
+      const unsigned s = seqs[(begin + i) % seqs.size()];
+      const index_t n = lengths_[s];
+      std::memcpy(data + i * len * step, &features_[offsets_[s] * step],
+                  n * step * sizeof(real_t));
+      std::memcpy(label + i * len, &labels_[offsets_[s]], n * sizeof(real_t));
+      out_.inst_index[i] = s;
+    }
+    out_.num_batch_padd = bs - count;
+    out_.bucket_key = len;
+    out_.data.clear();
+    if (dim_ == 0) {
+      out_.data.push_back(TBlob(mshadow::Tensor<cpu, 2>(data, mshadow::Shape2(bs, len))));
+    } else {
+      out_.data.push_back(TBlob(mshadow::Tensor<cpu, 3>(data,
+                                                        mshadow::Shape3(bs, len, dim_))));
+    }
+    out_.data.push_back(TBlob(mshadow::Tensor<cpu, 2>(label, mshadow::Shape2(bs, len))));
+    return true;
+  }
+
+  virtual const TBlobBatch &Value() const {
+    return out_;
+  }
+
+ private:
+  // magic number to seed prng
+  static const int kRandMagic = 233;
+  /*! \brief read all the sequences of the part */
+  inline void Load() {
+    std::unique_ptr<dmlc::InputSplit> source(dmlc::InputSplit::Create(
+        param_.path_seqrec.c_str(), param_.part_index, param_.num_parts, "recordio"));
+    bucket_seqs_.assign(buckets_.size(), std::vector<unsigned>());
+    dmlc::InputSplit::Blob rec;
+    size_t dropped = 0;
+    bool first = true;
+    offsets_.clear();
+    lengths_.clear();
+    while (source->NextRecord(&rec)) {
+      uint32_t head[2];
+      CHECK_GE(rec.size, sizeof(head)) << "invalid sequence record";
+      std::memcpy(head, rec.dptr, sizeof(head));
+      if (first) {
+        dim_ = head[1];
+        first = false;
+      }
+      CHECK_EQ(head[1], dim_) << "all the sequences must have the same feature dimension";
+      const size_t step = std::max<size_t>(dim_, 1);
+      CHECK_EQ(rec.size, sizeof(head) + head[0] * (step + 1) * sizeof(float))
+          << "invalid sequence record";
+      auto bucket = std::lower_bound(buckets_.begin(), buckets_.end(), head[0]);
+      if (bucket == buckets_.end()) {
+        ++dropped;
+        continue;
+      }
+      const float *p = reinterpret_cast<const float*>(
+          static_cast<const char*>(rec.dptr) + sizeof(head));
+      bucket_seqs_[bucket - buckets_.begin()].push_back(lengths_.size());
+      offsets_.push_back(labels_.size());
+      lengths_.push_back(head[0]);
+      features_.insert(features_.end(), p, p + head[0] * step);
+      labels_.insert(labels_.end(), p + head[0] * step, p + head[0] * (step + 1));
+    }
+    LOG(INFO) << "SequenceRecordIter: " << param_.path_seqrec << ", "
+              << lengths_.size() << " sequences, " << dropped
+              << " dropped longer than " << buckets_.back();
+  }
+  /*! \brief parameters */
+  SequenceRecordParam param_;
+  /*! \brief bucket lengths, sorted */
+  std::vector<index_t> buckets_;
+  /*! \brief feature dimension, 0 for token ids */
+  index_t dim_ = 0;
+  /*! \brief features of all the sequences */
+  std::vector<real_t> features_;
+  /*! \brief labels of all the sequences */
+  std::vector<real_t> labels_;
+  /*! \brief first step of each sequence */
+  std::vector<size_t> offsets_;
+  /*! \brief length of each sequence */
+  std::vector<index_t> lengths_;
+  /*! \brief sequences of each bucket */
+  std::vector<std::vector<unsigned> > bucket_seqs_;
+  /*! \brief batches of the epoch, a bucket and the first sequence in it */
+  std::vector<std::pair<unsigned, unsigned> > batches_;
+  /*! \brief next batch */
+  size_t batch_ptr_ = 0;
+  /*! \brief output buffers */
+  std::vector<real_t> data_, label_;
+  /*! \brief output batch */
+  TBlobBatch out_;
+  /*! \brief random engine of the shuffle */
+  common::RANDOM_ENGINE rnd_;
+};
+
+DMLC_REGISTER_PARAMETER(SequenceRecordParam);
+
+MXNET_REGISTER_IO_ITER(SequenceRecordIter)
+.describe("Create iterator for variable length sequences packed in recordio, "
+          "batched by length buckets. Each batch has the bucket length as bucket_key.")
+.add_arguments(SequenceRecordParam::__FIELDS__())
+.add_arguments(PrefetcherParam::__FIELDS__())
+.set_body([]() {
+    return new PrefetcherIter(
+        new SequenceRecordIter());
+  });
+}  // namespace io
+}  // namespace mxnet
@@ -0,0 +1,232 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file range_read_ahead.h
+ * \brief reader of the chunks of a recordio file by concurrent range reads.
+ *
+ *  A single stream of a remote file, such as on s3 or hdfs, is bounded by the
+ *  latency of its requests. The file is cut in ranges of a fixed size, read by
+ *  several threads each with its own stream, ahead of the parser and within a
+ *  memory budget. The chunks are handed out in the file order.
+ */
+#ifndef MXNET_IO_RANGE_READ_AHEAD_H_
+#define MXNET_IO_RANGE_READ_AHEAD_H_
+
+#include <dmlc/base.h>
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/recordio.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+/*!
+ * \brief reader of the chunks of a recordio file by concurrent range reads.
+ *
+ *  The ranges of part p of n are p, p + n, p + 2n, ... A record belongs to the
+ *  range where its head is, the writer escapes the magic number in the records
+ *  so that it only occurs at the heads. The chunk of a range starts at its
+ *  first record head and ends after its last record, the end of which is read
+ *  from the next bytes of the file.
+ */
+class RangeReadAheadReader {
+ public:
+  /*!
+   * \param uri the recordio file
+   * \param part_index the part to read
+   * \param num_parts the number of parts
+   * \param num_threads the number of concurrent reads
+   * \param range_size the bytes of a range
+   * \param max_bytes the bytes of the ranges read ahead at most
+   */
+  RangeReadAheadReader(const std::string &uri, int part_index, int num_parts,
+                       int num_threads, size_t range_size, size_t max_bytes)
+      : uri_(uri), part_index_(part_index), num_parts_(num_parts),
+        num_threads_(num_threads), range_size_((range_size + 3UL) & ~3UL),
+        max_ahead_(std::max<size_t>(1, max_bytes / range_size_)) {
+    CHECK_GT(num_threads_, 0);
+    this->Start();
+  }
+  ~RangeReadAheadReader() {
+    this->Stop();
+  }
+  /*! \brief restart from the first chunk */
+  inline void BeforeFirst() {
+    this->Stop();
+    this->Start();
+  }
+  /*!
+   * \brief get the next chunk, valid until the next call
+   * \return false at the end of the part
+   */
+  inline bool NextChunk(dmlc::InputSplit::Blob *out) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this]() {
+          return !error_.empty() || next_out_ >= end_ || ready_.count(next_out_) != 0;
+        });
+      if (!error_.empty()) LOG(FATAL) << error_;
+      if (next_out_ >= end_) return false;
+      current_ = std::move(ready_[next_out_]);
+      ready_.erase(next_out_);
+      ++next_out_;
+      cv_.notify_all();
+      // a range within a record of the previous one has no chunk
+      if (current_.empty()) continue;
+      out->dptr = &current_[0];
+      out->size = current_.size();
+      return true;
+    }
+  }
+
+ private:
+  /*! \brief the file */
+  std::string uri_;
+  /*! \brief the part read */
+  int part_index_, num_parts_;
+  /*! \brief number of reading threads */
+  int num_threads_;
+  /*! \brief bytes of a range, a multiple of 4 */
+  size_t range_size_;
+  /*! \brief number of ranges read ahead at most */
+  size_t max_ahead_;
+  /*! \brief mutex of the following */
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  /*! \brief whether the threads must exit */
+  bool stop_ = false;
+  /*! \brief index in the part of the next range to read and to hand out */
+  size_t next_read_ = 0, next_out_ = 0;
+  /*! \brief index of the first range past the end of the file */
+  size_t end_ = SIZE_MAX;
+  /*! \brief chunks read, by index in the part */
+  std::map<size_t, std::string> ready_;
+  /*! \brief chunk handed out */
+  std::string current_;
+  /*! \brief error of a reading thread */
+  std::string error_;
+  /*! \brief reading threads */
+  std::vector<std::thread> threads_;
+
+  inline void Start() {
+    stop_ = false;
+    next_read_ = next_out_ = 0;
+    end_ = SIZE_MAX;
+    ready_.clear();
+    error_.clear();
+    for (int i = 0; i < num_threads_; ++i) {
+      threads_.emplace_back([this]() { this->Run(); });
+    }
+  }
+  inline void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread &t : threads_) t.join();
+    threads_.clear();
+  }
+  // read ranges ahead of the consumer
+  inline void Run() {
+    std::unique_ptr<dmlc::SeekStream> fi;
+    try {
+      fi.reset(dmlc::SeekStream::CreateForRead(uri_.c_str()));
+    } catch (const dmlc::Error &e) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      error_ = e.what();
+      cv_.notify_all();
+      return;
+    }
+    while (true) {
+      size_t k;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() {
+            return stop_ || (next_read_ < end_ && next_read_ < next_out_ + max_ahead_);
+          });
+        if (stop_) return;
+        k = next_read_++;
+      }
+      std::string chunk;
+      bool eof = false;
+      try {
+        eof = !this->ReadRange(fi.get(), (k * num_parts_ + part_index_) * range_size_, &chunk);
+      } catch (const dmlc::Error &e) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = e.what();
+        cv_.notify_all();
+        return;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (eof) {
+        end_ = std::min(end_, k);
+      } else {
+        ready_[k] = std::move(chunk);
+      }
+      cv_.notify_all();
+    }
+  }
+  // read the bytes of the file up to size bytes in buf unless the file ends,
+  // return whether buf has them
+  static bool Ensure(dmlc::SeekStream *fi, size_t size, std::string *buf) {
+    size_t nread = buf->size();
+    if (nread >= size) return true;
+    buf->resize(size);
+    while (nread < size) {
+      const size_t n = fi->Read(&(*buf)[nread], size - nread);
+      if (n == 0) break;
+      nread += n;
+    }
+    buf->resize(nread);
+    return nread == size;
+  }
+  // whether a record starts at position pos of buf
+  static bool IsHead(const std::string &buf, size_t pos) {
+    if (pos + 2 * sizeof(uint32_t) > buf.size()) return false;
+    uint32_t header[2];
+    std::memcpy(header, buf.data() + pos, sizeof(header));
+    const uint32_t cflag = dmlc::RecordIOWriter::DecodeFlag(header[1]);
+    return header[0] == dmlc::RecordIOWriter::kMagic && (cflag == 0 || cflag == 1);
+  }
+  /*!
+   * \brief read the records whose heads are in the range at offset
+   * \return false if the range is past the end of the file
+   */
+  inline bool ReadRange(dmlc::SeekStream *fi, size_t offset, std::string *out) {
+    std::string buf;
+    fi->Seek(offset);
+    Ensure(fi, range_size_, &buf);
+    if (buf.empty()) return false;
+    size_t begin = 0;
+    while (begin < buf.size() && !IsHead(buf, begin)) begin += sizeof(uint32_t);
+    size_t pos = begin;
+    while (pos < range_size_ && pos < buf.size()) {
+      // a record is its head, then the parts of a record split by the writer
+      uint32_t cflag;
+      do {
+        CHECK(Ensure(fi, pos + 2 * sizeof(uint32_t), &buf)) << "truncated recordio " << uri_;
+        uint32_t header[2];
+        std::memcpy(header, buf.data() + pos, sizeof(header));
+        CHECK_EQ(header[0], dmlc::RecordIOWriter::kMagic) << "invalid recordio " << uri_;
+        cflag = dmlc::RecordIOWriter::DecodeFlag(header[1]);
+        const uint32_t len = dmlc::RecordIOWriter::DecodeLength(header[1]);
+        pos += 2 * sizeof(uint32_t) + ((len + 3U) & ~3U);
+        CHECK(Ensure(fi, pos, &buf)) << "truncated recordio " << uri_;
+      } while (cflag == 1 || cflag == 2);
+    }
+    out->assign(buf, begin, pos - begin);
+    return true;
+  }
+};
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_RANGE_READ_AHEAD_H_
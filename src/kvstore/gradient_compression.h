@@ -0,0 +1,146 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file gradient_compression.h
+ * \brief 2-bit quantization of gradients pushed to the distributed kvstore.
+ */
+#ifndef MXNET_KVSTORE_GRADIENT_COMPRESSION_H_
+#define MXNET_KVSTORE_GRADIENT_COMPRESSION_H_
+
+#include <dmlc/logging.h>
+#include <mxnet/base.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace kvstore {
+
+/*!
+ * \brief gradient compression of the pushes from worker to server.
+ *
+ *  With type "2bit", every value is sent as one of {-threshold, 0, threshold}
+ *  in 2 bits, 16 values are packed into the bits of one real_t. What is not
+ *  sent is kept in a residual by the worker and added to the next push of
+ *  the same key (error feedback), so no gradient is lost over time.
+ */
+class GradientCompression {
+ public:
+  /*! \brief compression types */
+  enum Type {
+    kNone = 0,
+    kTwoBit = 1
+  };
+  /*! \brief number of values packed into one real_t */
+  static const size_t kValuesPerWord = 16;
+
+  /*!
+   * \brief set the parameters
+   * \param kwargs key value pairs, "type" is "none" or "2bit",
+   *  "threshold" is the quantization threshold of "2bit", 0.5 by default.
+   */
+  inline void SetParams(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    type_ = kNone;
+    threshold_ = 0.5f;
+    for (const auto& kv : kwargs) {
+      if (kv.first == "type") {
+        if (kv.second == "2bit") {
+          type_ = kTwoBit;
+        } else {
+          CHECK(kv.second == "none") << "Unknown gradient compression type " << kv.second;
+        }
+      } else if (kv.first == "threshold") {
+        threshold_ = std::stof(kv.second);
+      } else {
+        LOG(FATAL) << "Unknown gradient compression parameter " << kv.first;
+      }
+    }
+    CHECK_GT(threshold_, 0.0f) << "threshold of gradient compression must be positive";
+  }
+  /*! \return whether compression is enabled */
+  inline bool enabled() const {
+    return type_ != kNone;
+  }
+  /*! \return the parameters as a string, the body of a server command */
+  inline std::string Encode() const {
+    std::ostringstream os;
+    os << static_cast<int>(type_) << ' ' << threshold_;
+    return os.str();
+  }
+  /*! \brief load the parameters from a string produced by Encode */
+  inline void Decode(const std::string& str) {
+    std::istringstream is(str);
+    int type;
+    is >> type >> threshold_;
+    CHECK(!is.fail()) << "invalid gradient compression parameters " << str;
+    type_ = static_cast<Type>(type);
+  }
+  /*! \return number of real_t sent for size values */
+  inline static size_t CompressedSize(size_t size) {
+    return (size + kValuesPerWord - 1) / kValuesPerWord;
+  }
+  /*!
+   * \brief quantize grad + residual into out, and update the residual.
+   * \param grad input of size values.
+   * \param residual the residual of size values, updated inplace.
+   * \param out output of CompressedSize(size) values.
+   * \param size number of values.
+   */
+  inline void Quantize(const real_t* grad, real_t* residual,
+                       real_t* out, size_t size) const {
+    const real_t pos = threshold_, neg = -threshold_;
+    size_t nword = CompressedSize(size);
+    for (size_t w = 0; w < nword; ++w) {
+      uint32_t bits = 0;
+      size_t begin = w * kValuesPerWord;
+      size_t end = std::min(begin + kValuesPerWord, size);
+      for (size_t i = begin; i < end; ++i) {
+        real_t v = residual[i] + grad[i];
+        uint32_t code = 0;
+        if (v >= pos) {
+          code = 1;
+          v -= pos;
+        } else if (v <= neg) {
+          code = 2;
+          v -= neg;
+        }
+        residual[i] = v;
+        bits |= code << ((i - begin) * 2);
+      }
+      std::memcpy(out + w, &bits, sizeof(bits));
+    }
+  }
+  /*!
+   * \brief recover the values from the output of Quantize.
+   * \param in input of CompressedSize(size) values.
+   * \param out output of size values.
+   * \param size number of values.
+   */
+  inline void Dequantize(const real_t* in, real_t* out, size_t size) const {
+    const real_t value[] = {0.0f, threshold_, -threshold_, 0.0f};
+    size_t nword = CompressedSize(size);
+    for (size_t w = 0; w < nword; ++w) {
+      uint32_t bits;
+      std::memcpy(&bits, in + w, sizeof(bits));
+      size_t begin = w * kValuesPerWord;
+      size_t end = std::min(begin + kValuesPerWord, size);
+      for (size_t i = begin; i < end; ++i) {
+        out[i] = value[(bits >> ((i - begin) * 2)) & 3];
+      }
+    }
+  }
+
+ private:
+  static_assert(sizeof(real_t) == sizeof(uint32_t), "2bit packing needs 32 bit real_t");
+  /*! \brief compression type */
+  Type type_{kNone};
+  /*! \brief quantization threshold */
+  real_t threshold_{0.5f};
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_GRADIENT_COMPRESSION_H_
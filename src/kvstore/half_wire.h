@@ -0,0 +1,38 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file half_wire.h
+ * \brief float16 values of the pushes and pulls of the distributed kvstore.
+ */
+#ifndef MXNET_KVSTORE_HALF_WIRE_H_
+#define MXNET_KVSTORE_HALF_WIRE_H_
+
+#include <mshadow/half.h>
+#include <mxnet/base.h>
+
+namespace mxnet {
+namespace kvstore {
+namespace halfwire {
+/*!
+ * \brief the number of real_t of n values sent in float16, two values are
+ *  packed into the bits of one real_t, the last one padded
+ */
+inline size_t PackedSize(size_t n) {
+  return (n + 1) / 2;
+}
+
+/*! \brief pack n values of src in float16 into PackedSize(n) values of dst */
+inline void Pack(const real_t* src, size_t n, real_t* dst) {
+  mshadow::half::half_t* out = reinterpret_cast<mshadow::half::half_t*>(dst);
+  for (size_t i = 0; i < n; ++i) out[i] = mshadow::half::half_t(src[i]);
+  if (n % 2 != 0) out[n] = mshadow::half::half_t(0.0f);
+}
+
+/*! \brief unpack n values packed by Pack in src into dst */
+inline void Unpack(const real_t* src, size_t n, real_t* dst) {
+  const mshadow::half::half_t* in = reinterpret_cast<const mshadow::half::half_t*>(src);
+  for (size_t i = 0; i < n; ++i) dst[i] = static_cast<real_t>(in[i]);
+}
+}  // namespace halfwire
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_HALF_WIRE_H_
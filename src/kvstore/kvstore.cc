@@ -6,6 +6,8 @@
 #include <mxnet/kvstore.h>
 #include <stdlib.h>
 #include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <atomic>
 #include "./kvstore_local.h"
 #include "./kvstore_device.h"
 #if MXNET_USE_DIST_KVSTORE
@@ -14,6 +16,18 @@
 
 namespace mxnet {
 
+namespace {
+std::atomic<KVStore*> data_part_server(nullptr);
+}  // namespace
+
+KVStore* KVStore::DataPartServer() {
+  return data_part_server.load();
+}
+
+void KVStore::SetDataPartServer(KVStore* kv) {
+  data_part_server.store(kv);
+}
+
 KVStore* KVStore::Create(const char *type_name) {
   std::string tname = type_name;
   std::transform(tname.begin(), tname.end(), tname.begin(), ::tolower);
@@ -39,6 +53,12 @@ KVStore* KVStore::Create(const char *type_name) {
       // configure the server to be the sync mode
       kv->SendCommandToServers(kvstore::kSyncMode, "");
     }
+    int staleness = dmlc::GetEnv("MXNET_KVSTORE_STALENESS", -1);
+    if (tname == "dist_async" && staleness >= 0 &&
+        kv->IsWorkerNode() && kv->get_rank() == 0) {
+      // bound the staleness of the async mode
+      kv->SendCommandToServers(kvstore::kSetStaleness, std::to_string(staleness));
+    }
 #else
     LOG(FATAL) << "compile with USE_DIST_KVSTORE=1 to use " << tname;
     return nullptr;
@@ -12,8 +12,10 @@
 #include <utility>
 #include <algorithm>
 #include <limits>
+#include <set>
 #include "./kvstore_local.h"
 #include "../common/utils.h"
+#include "../common/cuda_utils.h"
 
 namespace mxnet {
 namespace kvstore {
@@ -23,7 +25,9 @@ namespace kvstore {
 class KVStoreDevice : public KVStoreLocal {
  public:
   explicit KVStoreDevice(bool device_mode)
-      : device_mode_(device_mode) {}
+      : device_mode_(device_mode) {
+    ring_ = dmlc::GetEnv("MXNET_KVSTORE_DEVICE_RING", 0) != 0;
+  }
 
  protected:
   using KeyShape = std::pair<int, TShape>;
@@ -61,6 +65,7 @@ class KVStoreDevice : public KVStoreLocal {
         }
       }
 
+      Storage::AllocOriginScope origin("kvstore");
       tm_buf.merged = NDArray(s, Context::CPUPinned(tm_buf.ctx.dev_id));
       tm_buf.merged_device = NDArray(s, tm_buf.ctx);
       ctx_info[tm_buf.ctx.dev_id].second += s.Size();
@@ -78,6 +83,28 @@ class KVStoreDevice : public KVStoreLocal {
     }
 
     auto& buf = merge_buf_[key];
+    std::vector<Context> ctxs;
+    for (const auto& v : val) ctxs.push_back(v.ctx());
+    if (UseRing(ctxs, val[0].shape().Size())) {
+      RingAllReduce(key, val, priority);
+      // every device has the sum, take the one on the merge device if any
+      RingBuf& ring = ring_buf_[key];
+      size_t src = 0;
+      for (size_t i = 0; i < ctxs.size(); ++i) {
+        if (ctxs[i] == buf.ctx) src = i;
+      }
+      NDArray flat = FlatView(buf.merged_device);
+      for (size_t c = 0; c < ring.work[src].size(); ++c) {
+        NDArray dst = flat.Slice(ring.begin[c], ring.begin[c + 1]);
+        CopyFromTo(ring.work[src][c], &dst, priority);
+      }
+      if (updater_ != nullptr) {
+        CopyFromTo(buf.merged_device, &(buf.merged), priority);
+        return buf.merged;
+      } else {
+        return buf.merged_device;
+      }
+    }
     std::vector<NDArray> reduce(val.size());
     CHECK(!buf.merged_device.is_none());
     CopyFromTo(val[0], &(buf.merged_device), priority);
@@ -89,10 +116,10 @@ class KVStoreDevice : public KVStoreLocal {
       CopyFromTo(val[i], copy_buf, priority);
       reduce[i] = *copy_buf;
     }
-    ElementwiseSum(reduce, &buf.merged_device);
+    ElementwiseSum(reduce, &buf.merged_device, priority);
 
     if (updater_ != nullptr) {
-      CopyFromTo(buf.merged_device, &(buf.merged));
+      CopyFromTo(buf.merged_device, &(buf.merged), priority);
       return buf.merged;
     } else {
       return buf.merged_device;
@@ -108,6 +135,12 @@ class KVStoreDevice : public KVStoreLocal {
       KVStoreLocal::ScatterPullValue(key, src, vals, priority);
       return;
     }
+    std::vector<Context> ctxs;
+    for (auto* vptr : vals) ctxs.push_back(vptr->ctx());
+    if (UseRing(ctxs, src.shape().Size())) {
+      RingBroadcast(key, src, vals, priority);
+      return;
+    }
     auto it = merge_buf_.find(key);
     if (it != merge_buf_.end() && it->first == key) {
       auto& buf = it->second;
@@ -125,8 +158,128 @@ class KVStoreDevice : public KVStoreLocal {
     }
   }
 
- private:
+  /*! \return a 1-D view of an array */
+  inline static NDArray FlatView(const NDArray& arr) {
+    size_t ds[] = {arr.shape().Size()};
+    return arr.Reshape(TShape(ds, ds + 1));
+  }
+
+  /*! \brief whether to reduce on devices */
   bool device_mode_;
+
+ private:
+  /*!
+   * \brief buffers of a key reduced over a ring of devices. The value is cut
+   *  in one chunk per device, every chunk on every device is an array on its
+   *  own so that the copies and sums of different chunks overlap.
+   */
+  struct RingBuf {
+    /*! \brief the devices of the ring, in order */
+    std::vector<Context> ctxs;
+    /*! \brief the offset of each chunk, and the size of the value at the end */
+    std::vector<size_t> begin;
+    /*! \brief the chunks on each device, and the chunks received from the previous one */
+    std::vector<std::vector<NDArray> > work, recv;
+  };
+
+  /*! \return whether a value on some devices is reduced over a ring */
+  bool UseRing(const std::vector<Context>& ctxs, size_t size) {
+    if (!ring_ || ctxs.size() < 2 || size < bigarray_bound_) return false;
+    std::set<int> devs;
+    for (const Context& ctx : ctxs) {
+      if (ctx.dev_mask() != gpu::kDevMask) return false;
+      devs.insert(ctx.dev_id);
+    }
+    return devs.size() == ctxs.size();
+  }
+
+  /*! \return the ring buffers of a key, allocated for the devices on first use */
+  RingBuf& InitRing(int key, const std::vector<Context>& ctxs, size_t size) {
+    RingBuf& ring = ring_buf_[key];
+    if (ring.ctxs == ctxs) return ring;
+    const size_t n = ctxs.size();
+    ring.ctxs = ctxs;
+    ring.begin.resize(n + 1);
+    for (size_t c = 0; c <= n; ++c) ring.begin[c] = size * c / n;
+    ring.work.assign(n, std::vector<NDArray>());
+    ring.recv.assign(n, std::vector<NDArray>());
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t c = 0; c < n; ++c) {
+        TShape shape = mshadow::Shape1(ring.begin[c + 1] - ring.begin[c]);
+        ring.work[i].push_back(NDArray(shape, ctxs[i]));
+        ring.recv[i].push_back(NDArray(shape, ctxs[i]));
+      }
+#if MXNET_USE_CUDA
+      // the neighbours of the ring copy over the peer to peer link when they can
+      common::cuda::EnablePeerAccess(ctxs[i].dev_id, ctxs[(i + 1) % n].dev_id);
+#endif  // MXNET_USE_CUDA
+    }
+    return ring;
+  }
+
+  /*!
+   * \brief sum the values of all devices into every device by a ring
+   *  reduce-scatter followed by a ring all-gather, every device sends and
+   *  receives 2 (n - 1) / n of the value in chunks going around the ring
+   */
+  void RingAllReduce(int key, const std::vector<NDArray>& val, int priority) {
+    std::vector<Context> ctxs;
+    for (const auto& v : val) ctxs.push_back(v.ctx());
+    const size_t n = ctxs.size();
+    RingBuf& ring = InitRing(key, ctxs, val[0].shape().Size());
+    for (size_t i = 0; i < n; ++i) {
+      NDArray flat = FlatView(val[i]);
+      for (size_t c = 0; c < n; ++c) {
+        CopyFromTo(flat.Slice(ring.begin[c], ring.begin[c + 1]), &ring.work[i][c], priority);
+      }
+    }
+    // after step s, device i has the sum of chunk (i - s - 1) over s + 2 devices
+    for (size_t s = 0; s + 1 < n; ++s) {
+      for (size_t i = 0; i < n; ++i) {
+        const size_t c = (i + n - s) % n, next = (i + 1) % n;
+        CopyFromTo(ring.work[i][c], &ring.recv[next][c], priority);
+        ElementwiseSum({ring.work[next][c], ring.recv[next][c]}, &ring.work[next][c], priority);
+      }
+    }
+    // device i has the sum of chunk (i + 1), pass the sums around
+    for (size_t s = 0; s + 1 < n; ++s) {
+      for (size_t i = 0; i < n; ++i) {
+        const size_t c = (i + 1 + n - s) % n, next = (i + 1) % n;
+        CopyFromTo(ring.work[i][c], &ring.work[next][c], priority);
+      }
+    }
+  }
+
+  /*!
+   * \brief copy a value to all devices, down the ring chunk by chunk, so
+   *  that every link carries the value once and the copies of a chunk
+   *  overlap the ones of the chunks before it
+   */
+  void RingBroadcast(int key, const NDArray& src, const std::vector<NDArray*>& vals,
+                     int priority) {
+    std::vector<Context> ctxs;
+    for (auto* vptr : vals) ctxs.push_back(vptr->ctx());
+    const size_t n = ctxs.size();
+    RingBuf& ring = InitRing(key, ctxs, src.shape().Size());
+    NDArray flat = FlatView(src);
+    for (size_t c = 0; c < n; ++c) {
+      CopyFromTo(flat.Slice(ring.begin[c], ring.begin[c + 1]), &ring.work[0][c], priority);
+      for (size_t i = 1; i < n; ++i) {
+        CopyFromTo(ring.work[i - 1][c], &ring.work[i][c], priority);
+      }
+    }
+    for (size_t i = 0; i < n; ++i) {
+      NDArray out = FlatView(*vals[i]);
+      for (size_t c = 0; c < n; ++c) {
+        NDArray dst = out.Slice(ring.begin[c], ring.begin[c + 1]);
+        CopyFromTo(ring.work[i][c], &dst, priority);
+      }
+    }
+  }
+
+  /*! \brief whether the big values on several gpus are reduced over a ring */
+  bool ring_;
+  std::unordered_map<int, RingBuf> ring_buf_;
   bool buf_initialized_{false};
   std::vector<KeyShape> sorted_key_shape_;
 };
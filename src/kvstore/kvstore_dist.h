@@ -5,9 +5,24 @@
  */
 #ifndef MXNET_KVSTORE_KVSTORE_DIST_H_
 #define MXNET_KVSTORE_KVSTORE_DIST_H_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 #include "./kvstore_device.h"
+#include "./gradient_compression.h"
+#include "./half_wire.h"
+#include "./kvstore_stats.h"
+#include "./kvstore_shm.h"
 #include "mxnet/engine.h"
 #include "ps/ps.h"
 #include "./kvstore_dist_server.h"
@@ -32,13 +47,42 @@ class KVStoreDist : public KVStoreDevice {
         ps_worker_(nullptr), server_(nullptr) {
     if (IsWorkerNode()) {
       ps_worker_ = new ps::KVWorker<real_t>(0);
+      ps_worker_->set_response_handle(
+          [this](const ps::SimpleData& recved, ps::SimpleApp* app) {
+            // only the responses to TakeDataPart have a body
+            if (recved.body.empty()) return;
+            std::lock_guard<std::mutex> lock(response_mu_);
+            responses_[recved.timestamp] = recved.body;
+          });
+      // the values of the initialization relayed by the other workers
+      ps_worker_->set_request_handle(
+          [this](const ps::SimpleData& recved, ps::SimpleApp* app) {
+            CHECK_EQ(recved.head, kInitRelay) << "unknown request to a worker";
+            {
+              std::lock_guard<std::mutex> lock(relay_mu_);
+              relay_inbox_.push_back(recved.body);
+            }
+            relay_cv_.notify_all();
+            app->Response(recved);
+          });
       ps::Start("mxnet\0");
+      SetDataPartServer(this);
     }
+    partition_ = dmlc::GetEnv("MXNET_KVSTORE_PARTITION", std::string("hash"));
+    CHECK(partition_ == "hash" || partition_ == "size" || partition_ == "latency")
+        << "unknown MXNET_KVSTORE_PARTITION " << partition_;
+    fusion_bound_ = dmlc::GetEnv("MXNET_KVSTORE_FUSION_BOUND", 64 * 1024);
+    // the servers answer the fused pulls without waiting for the slowest workers
+    fuse_pull_ = dmlc::GetEnv("MXNET_KVSTORE_STALENESS", -1) < 0;
+    pull_ahead_ = dmlc::GetEnv("MXNET_KVSTORE_PULL_AHEAD", false);
+    tree_init_ = dmlc::GetEnv("MXNET_KVSTORE_TREE_INIT", true);
+    shm_ = dmlc::GetEnv("MXNET_KVSTORE_SHM", false);
   }
 
   virtual ~KVStoreDist() {
     Engine::Get()->WaitForAll();
     if (IsWorkerNode()) {
+      if (DataPartServer() == this) SetDataPartServer(nullptr);
       ps::Postoffice::Get()->Barrier(ps::kWorkerGroup);
       if (get_rank() == 0) {
         // stop the executor at servers
@@ -52,50 +96,35 @@ class KVStoreDist : public KVStoreDevice {
   void Init(const std::vector<int>& keys,
             const std::vector<NDArray>& values) override {
     CheckUnique(keys);
+    if (partition_ == "latency" && server_cost_.empty()) MeasureServerCost();
+    if (shm_ && shm_local_.empty()) AttachShm();
+    for (size_t i = 0; i < keys.size(); ++i) {
+      // the placement by size depends on all of the keys placed before
+      CHECK(partition_ == "hash" || !values[i].is_none())
+          << "all workers must give the values to init with MXNET_KVSTORE_PARTITION="
+          << partition_;
+      // the partition of the rows is needed by row sparse push and pull on all workers
+      if (!values[i].is_none()) {
+        EncodeKey(keys[i], values[i].shape().Size(), RowLength(values[i].shape()));
+      }
+      // the initialization is the first version of a key on the servers
+      push_version_[keys[i]] = 1;
+    }
     if (get_rank() == 0) {
-      Push(keys, values, 0);
+      PushImpl(keys, values, 0, true);
       // wait until the push is finished
       Wait(keys);
     } else {
       // do nothing
     }
+    if (tree_init_) BroadcastInit(keys, values);
     Barrier();
   }
 
   void Push(const std::vector<int>& keys,
             const std::vector<NDArray>& values,
-              int priority) override {
-    // first aggregate the values over keys
-    std::vector<int> uniq_keys;
-    std::vector<std::vector<NDArray> > grouped_vals;
-    GroupKVPairs(keys, values, &uniq_keys, &grouped_vals);
-
-    for (size_t i = 0; i < uniq_keys.size(); ++i) {
-      // merge over devcies
-      int key = uniq_keys[i];
-      const NDArray& merged = MergePushValue(key, grouped_vals[i], priority);
-
-      // push to servers
-      auto push_to_servers =
-          [this, key, merged](RunContext rctx, Engine::CallbackOnComplete cb) {
-         // convert to ps keys
-        size_t size = merged.shape().Size();
-        PSKV& pskv = EncodeKey(key, size);
-
-        // do push
-        real_t* data = static_cast<real_t*>(merged.data().dptr_);
-        // false means no delete
-        ps::SArray<real_t> vals(data, size, false);
-        CHECK_NOTNULL(ps_worker_)->ZPush(
-        pskv.keys, vals, pskv.lens, 0, [cb]() { cb(); });
-      };
-      Engine::Get()->PushAsync(
-          push_to_servers,
-          pinned_ctx_,
-          {merged.var()},
-          {},
-          FnProperty::kNormal, priority);
-    }
+            int priority) override {
+    PushImpl(keys, values, priority, false);
   }
 
   void Pull(const std::vector<int>& keys,
@@ -104,10 +133,23 @@ class KVStoreDist : public KVStoreDevice {
     std::vector<int> uniq_keys;
     std::vector<std::vector<NDArray*> > grouped_vals;
     GroupKVPairs(keys, values, &uniq_keys, &grouped_vals);
+    std::vector<size_t> fused;
 
     for (size_t i = 0; i < uniq_keys.size(); ++i) {
       int key = uniq_keys[i];
       const auto& vals = grouped_vals[i];
+      auto ahead = ahead_version_.find(key);
+      if (ahead != ahead_version_.end() && ahead->second == push_version_[key]) {
+        // the value of the last push or of the initialization is already here
+        NDArray src = ahead_buf_[key];
+        if (src.shape() != vals[0]->shape()) src = src.Reshape(vals[0]->shape());
+        ScatterPullValue(key, src, vals, priority);
+        continue;
+      }
+      if (UsePipeline(key, vals[0]->shape().Size())) {
+        PullPipelined(key, vals, priority);
+        continue;
+      }
 
       // first pull to a buffer. we reuse the merge buf so that all pushes and
       // pulls on the same key on the local machine are always sequentials
@@ -115,29 +157,117 @@ class KVStoreDist : public KVStoreDevice {
       if (buf.is_none()) {
         buf = NDArray(vals[0]->shape(), pinned_ctx_);
       }
+      if (fuse_pull_ && UseFusion(key, buf.shape().Size())) {
+        fused.push_back(i);
+        continue;
+      }
 
-      auto pull_from_servers = [this, key, buf] (
+      const bool half = UseHalf(key);
+      auto pull_from_servers = [this, key, buf, half] (
           RunContext rctx, Engine::CallbackOnComplete cb) {
         real_t* data = static_cast<real_t*>(buf.data().dptr_);
         size_t size = buf.shape().Size();
         // convert to ps keys
         PSKV& pskv = EncodeKey(key, size);
+        if (half) {
+          PullHalf(pskv.keys, pskv.lens, data, cb);
+          return;
+        }
 
         // issue pull, false means no delete
         auto vals = new ps::SArray<real_t>(data, size, false);
-        CHECK_NOTNULL(ps_worker_)->ZPull(
+        ZPull(
         pskv.keys, vals, &pskv.lens, 0, [vals, cb](){ delete vals; cb(); });
       };
 
+      std::vector<Engine::VarHandle> mutate_vars = RowSparseVars(key);
+      mutate_vars.push_back(buf.var());
       CHECK_NOTNULL(Engine::Get())->PushAsync(
           pull_from_servers,
           pinned_ctx_,
           {},
-          {buf.var()},
+          mutate_vars,
           FnProperty::kNormal, priority);
 
       ScatterPullValue(key, buf, vals, priority);
     }
+    if (fused.size() == 0) return;
+    std::vector<std::pair<int, NDArray> > bufs;
+    for (size_t i : fused) bufs.push_back({uniq_keys[i], merge_buf_[uniq_keys[i]].merged});
+    PullFused(bufs, priority);
+    for (size_t i : fused) {
+      ScatterPullValue(uniq_keys[i], merge_buf_[uniq_keys[i]].merged, grouped_vals[i], priority);
+    }
+  }
+
+  void PushRowSparse(const std::vector<int>& keys,
+                     const std::vector<NDArray>& row_ids,
+                     const std::vector<NDArray>& values,
+                     int priority) override {
+    CHECK_EQ(keys.size(), row_ids.size());
+    std::vector<RowSparse> pairs;
+    for (size_t i = 0; i < keys.size(); ++i) pairs.push_back({row_ids[i], values[i]});
+    std::vector<int> uniq_keys;
+    std::vector<std::vector<RowSparse> > grouped_vals;
+    GroupKVPairs(keys, pairs, &uniq_keys, &grouped_vals);
+
+    for (size_t i = 0; i < uniq_keys.size(); ++i) {
+      int key = uniq_keys[i];
+      std::shared_ptr<std::vector<uint32_t> > rows;
+      NDArray merged = MergeRowSparse(grouped_vals[i], NumRows(key), &rows, priority);
+      if (merged.is_none()) continue;
+      // only the merged rows are sent, to the servers holding them
+      auto push_to_servers = [this, key, merged, rows](
+          RunContext rctx, Engine::CallbackOnComplete cb) {
+        ps::SArray<ps::Key> ps_keys;
+        ps::SArray<int> lens;
+        EncodeRowSparseKeys(key, *rows, &ps_keys, &lens);
+        real_t* data = static_cast<real_t*>(merged.data().dptr_);
+        ps::SArray<real_t> vals(data, merged.shape().Size(), false);
+        ZPush(ps_keys, vals, lens, 0, [cb]() { cb(); });
+      };
+      Engine::Get()->PushAsync(
+          push_to_servers,
+          pinned_ctx_,
+          {merged.var()},
+          RowSparseVars(key, true),
+          FnProperty::kNormal, priority);
+    }
+  }
+
+  void PullRowSparse(const std::vector<int>& keys,
+                     const std::vector<NDArray>& row_ids,
+                     const std::vector<NDArray*>& values,
+                     int priority) override {
+    CHECK_EQ(keys.size(), row_ids.size());
+    CHECK_EQ(keys.size(), values.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      int key = keys[i];
+      auto rows = std::make_shared<std::vector<uint32_t> >(
+          ReadRowIds(row_ids[i], NumRows(key)));
+      CHECK_EQ(values[i]->shape()[0], rows->size()) << "wrong number of rows to pull";
+      if (rows->empty()) continue;
+      NDArray buf(values[i]->shape(), pinned_ctx_);
+      auto pull_from_servers = [this, key, buf, rows](
+          RunContext rctx, Engine::CallbackOnComplete cb) {
+        ps::SArray<ps::Key> ps_keys;
+        ps::SArray<int> lens;
+        EncodeRowSparseKeys(key, *rows, &ps_keys, &lens);
+        real_t* data = static_cast<real_t*>(buf.data().dptr_);
+        auto vals = new ps::SArray<real_t>(data, buf.shape().Size(), false);
+        ZPull(
+            ps_keys, vals, nullptr, 0, [vals, cb]() { delete vals; cb(); });
+      };
+      std::vector<Engine::VarHandle> mutate_vars = RowSparseVars(key, true);
+      mutate_vars.push_back(buf.var());
+      Engine::Get()->PushAsync(
+          pull_from_servers,
+          pinned_ctx_,
+          {},
+          mutate_vars,
+          FnProperty::kNormal, priority);
+      CopyFromTo(buf, values[i], priority);
+    }
   }
 
   void set_updater(const Updater& updater) override {
@@ -149,10 +279,54 @@ class KVStoreDist : public KVStoreDevice {
     }
   }
 
+  void SetGradientCompression(
+      const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    compression_.SetParams(kwargs);
+    if (IsWorkerNode() && get_rank() == 0) {
+      SendCommandToServers(kSetGradientCompression, compression_.Encode());
+    }
+  }
+
+  void SetWireDType(const std::vector<int>& keys, int dtype) override {
+    CHECK(dtype == mshadow::kFloat32 || dtype == mshadow::kFloat16)
+        << "the values are sent in float32 or float16";
+    for (int key : keys) {
+      if (dtype == mshadow::kFloat16) {
+        half_keys_.insert(key);
+      } else {
+        half_keys_.erase(key);
+      }
+    }
+  }
+
+  void SetServerOptimizer(
+      const std::string& name,
+      const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    std::ostringstream os;
+    os << name;
+    for (const auto& kv : kwargs) os << '\n' << kv.first << '=' << kv.second;
+    SendCommandToServers(kSetOptimizer, os.str());
+  }
+
   void Barrier() override {
+    const uint64_t start = NowNs();
     ps::Postoffice::Get()->Barrier(ps::kWorkerGroup);
+    std::lock_guard<std::mutex> lock(stats_mu_);
+    barrier_time_.Add(NowNs() - start);
   }
 
+  std::string GetStats(bool reset) override {
+    std::ostringstream os;
+    os << "{\"rank\": " << get_rank() << ", \"worker\": ";
+    DumpWorkerStats(&os, reset);
+    os << ", \"servers\": [";
+    const int num_servers = ps::Postoffice::Get()->GetServerKeyRanges().size();
+    for (int s = 0; s < num_servers; ++s) {
+      os << (s ? ", " : "") << RequestServer(kGetStats, reset ? "reset" : "", s);
+    }
+    os << "]}";
+    return os.str();
+  }
 
   void SendCommandToServers(int cmd_id,
                             const std::string& cmd_body) override {
@@ -160,6 +334,13 @@ class KVStoreDist : public KVStoreDevice {
     ps_worker_->Wait(ps_worker_->Request(cmd_id, cmd_body, ps::kServerGroup));
   }
 
+  int TakeDataPart(const std::string& dataset, int epoch, int num_parts) override {
+    CHECK_NOTNULL(ps_worker_);
+    std::ostringstream os;
+    os << epoch << ' ' << num_parts << ' ' << dataset;
+    return std::stoi(RequestServer(kTakeDataPart, os.str(), 0));
+  }
+
   int get_group_size() const override { return ps::NumWorkers(); }
 
   int get_rank() const override { return ps::MyRank(); }
@@ -178,6 +359,561 @@ class KVStoreDist : public KVStoreDevice {
   }
 
  private:
+  /**
+   * \brief write the counters of this worker as json
+   * \param reset whether to reset them after
+   */
+  void DumpWorkerStats(std::ostream* os, bool reset) {
+    std::lock_guard<std::mutex> lock(stats_mu_);
+    *os << "{\"push_bytes\": [";
+    for (size_t s = 0; s < push_bytes_.size(); ++s) *os << (s ? ", " : "") << push_bytes_[s];
+    *os << "], \"pull_bytes\": [";
+    for (size_t s = 0; s < pull_bytes_.size(); ++s) *os << (s ? ", " : "") << pull_bytes_[s];
+    *os << "], \"push_time\": ";
+    push_time_.Dump(os);
+    *os << ", \"pull_time\": ";
+    pull_time_.Dump(os);
+    *os << ", \"wait_time\": ";
+    wait_time_.Dump(os);
+    *os << ", \"barrier_time\": ";
+    barrier_time_.Dump(os);
+    *os << "}";
+    if (reset) {
+      push_bytes_.clear();
+      pull_bytes_.clear();
+      push_time_.Reset();
+      pull_time_.Reset();
+      wait_time_.Reset();
+      barrier_time_.Reset();
+    }
+  }
+
+  /**
+   * \brief send a command to a single server
+   * \return the body of the response, which must not be empty
+   */
+  std::string RequestServer(int cmd_id, const std::string& cmd_body, int server_rank) {
+    int ts = ps_worker_->Request(cmd_id, cmd_body,
+                                 ps::Postoffice::Get()->ServerRankToID(server_rank));
+    ps_worker_->Wait(ts);
+    std::lock_guard<std::mutex> lock(response_mu_);
+    auto it = responses_.find(ts);
+    CHECK(it != responses_.end()) << "no response to the command " << cmd_id;
+    std::string body = it->second;
+    responses_.erase(it);
+    return body;
+  }
+
+  /**
+   * \brief measure the time of each server to receive a message, relative to
+   *  the fastest one. Worker 0 measures it and the others get it from the
+   *  first server, so that all of the workers place the keys the same way.
+   */
+  void MeasureServerCost() {
+    CHECK_NOTNULL(ps_worker_);
+    const int num_servers = ps::NumServers();
+    if (get_rank() == 0) {
+      const int kProbeRounds = 3;
+      const std::string probe(1 << 20, 0);
+      std::vector<double> cost(num_servers);
+      for (int s = 0; s < num_servers; ++s) {
+        int ps_id = ps::Postoffice::Get()->ServerRankToID(s);
+        for (int r = 0; r < kProbeRounds; ++r) {
+          auto start = std::chrono::steady_clock::now();
+          ps_worker_->Wait(ps_worker_->Request(kPartitionProbe, probe, ps_id));
+          double t = std::chrono::duration<double>(
+              std::chrono::steady_clock::now() - start).count();
+          cost[s] = r == 0 ? t : std::min(cost[s], t);
+        }
+      }
+      double fastest = *std::min_element(cost.begin(), cost.end());
+      std::ostringstream os;
+      for (double c : cost) os << std::max(c / std::max(fastest, 1e-9), 1.0) << ' ';
+      RequestServer(kPartitionCost, os.str(), 0);
+    }
+    Barrier();
+    std::istringstream is(RequestServer(kPartitionCost, "", 0));
+    server_cost_.resize(num_servers);
+    for (double& c : server_cost_) CHECK(is >> c) << "invalid server costs";
+  }
+
+  /**
+   * \brief give the values of worker 0 to all the workers over a binomial tree
+   *  of the workers, each relaying them to its children. The values are then
+   *  the pulled ones of version 1, so that the first pulls are local and the
+   *  servers are not pulled by every worker at once.
+   */
+  void BroadcastInit(const std::vector<int>& keys, const std::vector<NDArray>& values) {
+    const int rank = get_rank(), num_workers = get_group_size();
+    std::string body;
+    if (rank == 0) {
+      for (size_t i = 0; i < keys.size(); ++i) {
+        values[i].WaitToRead();
+        const TBlob data = values[i].data();
+        CHECK_EQ(data.type_flag_, mshadow::kFloat32) << "the kvstore holds float32 values";
+        const uint64_t size = data.Size();
+        body.append(reinterpret_cast<const char*>(&keys[i]), sizeof(int));
+        body.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        body.append(static_cast<const char*>(data.dptr_), size * sizeof(real_t));
+      }
+    } else {
+      std::unique_lock<std::mutex> lock(relay_mu_);
+      relay_cv_.wait(lock, [this]() { return !relay_inbox_.empty(); });
+      body = std::move(relay_inbox_.front());
+      relay_inbox_.pop_front();
+    }
+    // the children of a rank are the ranks of an added power of two above it
+    std::vector<int> sent;
+    for (int m = 1; rank + m < num_workers; m <<= 1) {
+      if (m <= rank) continue;
+      sent.push_back(ps_worker_->Request(kInitRelay, body,
+                                         ps::Postoffice::Get()->WorkerRankToID(rank + m)));
+    }
+    size_t offset = 0;
+    while (offset < body.size()) {
+      int key;
+      uint64_t size;
+      std::memcpy(&key, body.data() + offset, sizeof(key));
+      std::memcpy(&size, body.data() + offset + sizeof(key), sizeof(size));
+      offset += sizeof(key) + sizeof(size);
+      NDArray& buf = ahead_buf_[key];
+      if (buf.is_none() || buf.shape().Size() != size) {
+        TShape shape = mshadow::Shape1(size);
+        for (size_t i = 0; i < keys.size(); ++i) {
+          if (keys[i] == key && !values[i].is_none()) shape = values[i].shape();
+        }
+        Storage::AllocOriginScope origin("kvstore");
+        buf = NDArray(shape, pinned_ctx_);
+      }
+      buf.WaitToWrite();
+      std::memcpy(buf.data().dptr_, body.data() + offset, size * sizeof(real_t));
+      offset += size * sizeof(real_t);
+      ahead_version_[key] = push_version_[key];
+    }
+    for (int ts : sent) ps_worker_->Wait(ts);
+  }
+
+  /**
+   * \brief push values to servers
+   * \param init whether it is the initialization, which is never compressed
+   *  or pipelined
+   */
+  void PushImpl(const std::vector<int>& keys,
+                const std::vector<NDArray>& values,
+                int priority, bool init) {
+    // first aggregate the values over keys
+    std::vector<int> uniq_keys;
+    std::vector<std::vector<NDArray> > grouped_vals;
+    GroupKVPairs(keys, values, &uniq_keys, &grouped_vals);
+    std::vector<std::pair<int, NDArray> > fused;
+
+    for (size_t i = 0; i < uniq_keys.size(); ++i) {
+      // merge over devcies
+      int key = uniq_keys[i];
+      if (!init) ++push_version_[key];
+      if (!init && UsePipeline(key, grouped_vals[i][0].shape().Size())) {
+        PushPipelined(key, grouped_vals[i], priority);
+        continue;
+      }
+      const NDArray& merged = MergePushValue(key, grouped_vals[i], priority);
+
+      if (!init && compression_.enabled()) {
+        PushCompressed(key, merged, priority);
+        continue;
+      }
+      if (!init && UseFusion(key, merged.shape().Size())) {
+        fused.push_back({key, merged});
+        continue;
+      }
+      // push to servers
+      const bool half = !init && UseHalf(key);
+      auto push_to_servers =
+          [this, key, merged, init, half](RunContext rctx, Engine::CallbackOnComplete cb) {
+         // convert to ps keys
+        size_t size = merged.shape().Size();
+        PSKV& pskv = EncodeKey(key, size);
+
+        // do push
+        real_t* data = static_cast<real_t*>(merged.data().dptr_);
+        if (!init && UseShm(pskv)) {
+          PushShm(pskv, data, cb);
+          return;
+        }
+        if (half) {
+          PushHalf(pskv.keys, pskv.lens, data, cb);
+          return;
+        }
+        // false means no delete
+        ps::SArray<real_t> vals(data, size, false);
+        // the initialization tells the servers the row length, for row sparse push and pull
+        ZPush(
+        pskv.keys, vals, pskv.lens, init ? pskv.row_len : 0, [cb]() { cb(); });
+      };
+      std::vector<Engine::VarHandle> const_vars = RowSparseVars(key);
+      const_vars.push_back(merged.var());
+      Engine::Get()->PushAsync(
+          push_to_servers,
+          pinned_ctx_,
+          const_vars,
+          {},
+          FnProperty::kNormal, priority);
+      if (!init && pull_ahead_ && type_ == "dist_sync" && RowSparseVars(key).empty()) {
+        PullAhead(key, merged.shape(), priority);
+      }
+    }
+    if (fused.size() != 0) PushFused(fused, priority);
+  }
+
+  /**
+   * \brief find the servers on the same host, which can open the shared memory
+   *  regions of this worker, by a probe region holding a token
+   */
+  void AttachShm() {
+    std::ostringstream prefix;
+    prefix << "/mxnet_kvstore_" << getpid() << "_" << get_rank();
+    shm_prefix_ = prefix.str();
+    const uint64_t token = NowNs() ^ (static_cast<uint64_t>(getpid()) << 32);
+    std::unique_ptr<SharedRegion> probe(SharedRegion::Create(shm_prefix_ + "_probe",
+                                                             sizeof(token)));
+    *static_cast<uint64_t*>(probe->data()) = token;
+    const int num_servers = ps::NumServers();
+    shm_local_.resize(num_servers);
+    int num_local = 0;
+    for (int s = 0; s < num_servers; ++s) {
+      shm_local_[s] = RequestServer(kShmAttach, shm_prefix_ + " " + std::to_string(token), s)
+          == "1";
+      num_local += shm_local_[s];
+    }
+    LOG(INFO) << "worker " << get_rank() << " pushes to " << num_local
+              << " servers on the same host through shared memory";
+  }
+
+  /**
+   * \return whether some slices of a key are on servers on the same host
+   */
+  inline bool UseShm(const PSKV& pskv) {
+    if (!shm_) return false;
+    for (ps::Key k : pskv.keys) {
+      if (shm_local_[ServerRank(k)]) return true;
+    }
+    return false;
+  }
+
+  /**
+   * \brief push the slices of a value, those of the servers on the same host
+   *  are written to the shared memory regions of their ps keys, which the
+   *  servers merge in place. A region is written again only once its last
+   *  push is answered, by the engine dependency on the pushed value.
+   */
+  void PushShm(const PSKV& pskv, const real_t* data, Engine::CallbackOnComplete cb) {
+    ps::SArray<ps::Key> shm_keys, keys;
+    ps::SArray<int> lens;
+    auto buf = std::make_shared<std::vector<real_t> >();
+    size_t offset = 0;
+    for (size_t i = 0; i < pskv.keys.size(); ++i) {
+      const ps::Key k = pskv.keys[i];
+      const size_t len = pskv.lens[i];
+      if (shm_local_[ServerRank(k)]) {
+        std::memcpy(ShmRegion(k, len)->data(), data + offset, len * sizeof(real_t));
+        shm_keys.push_back(k);
+      } else {
+        buf->insert(buf->end(), data + offset, data + offset + len);
+        keys.push_back(k);
+        lens.push_back(len);
+      }
+      offset += len;
+    }
+    auto pending = std::make_shared<std::atomic<int> >(keys.empty() ? 1 : 2);
+    auto done = [cb, pending, buf]() {
+      if (--*pending == 0) cb();
+    };
+    // the values are in the regions, the message has a placeholder value per key
+    ps::SArray<real_t> placeholder(shm_keys.size(), 0);
+    ZPush(shm_keys, placeholder, ps::SArray<int>(), kPushShm, done);
+    if (!keys.empty()) {
+      ps::SArray<real_t> vals(buf->data(), buf->size(), false);
+      ZPush(keys, vals, lens, 0, done);
+    }
+  }
+
+  /**
+   * \return the shared memory region of a ps key, created on first use
+   */
+  SharedRegion* ShmRegion(ps::Key key, size_t len) {
+    std::lock_guard<std::mutex> lock(shm_mu_);
+    std::unique_ptr<SharedRegion>& region = shm_regions_[key];
+    if (region == nullptr) {
+      region.reset(SharedRegion::Create(shm_prefix_ + "_" + std::to_string(key),
+                                        len * sizeof(real_t)));
+    }
+    CHECK_EQ(region->bytes(), len * sizeof(real_t));
+    return region.get();
+  }
+
+  /**
+   * \return the rank of the server of a ps key
+   */
+  inline int ServerRank(ps::Key key) {
+    const auto& krs = ps::Postoffice::Get()->GetServerKeyRanges();
+    int s = 0;
+    while (s + 1 < static_cast<int>(krs.size()) && key >= krs[s].end()) ++s;
+    return s;
+  }
+
+  /**
+   * \brief pull the value of a key updated by the push just issued, without
+   *  waiting for the push to finish. The server answers once it publishes the
+   *  version of the update, the pulls of the key are then local copies.
+   */
+  void PullAhead(int key, const TShape& shape, int priority) {
+    const uint64_t version = push_version_[key];
+    NDArray& buf = ahead_buf_[key];
+    if (buf.is_none()) {
+      Storage::AllocOriginScope origin("kvstore");
+      buf = NDArray(shape, pinned_ctx_);
+    }
+    ahead_version_[key] = version;
+    NDArray dst = buf;
+    auto pull_from_servers = [this, key, dst, version](
+        RunContext rctx, Engine::CallbackOnComplete cb) {
+      real_t* data = static_cast<real_t*>(dst.data().dptr_);
+      size_t size = dst.shape().Size();
+      PSKV& pskv = EncodeKey(key, size);
+      auto vals = new ps::SArray<real_t>(data, size, false);
+      ZPull(
+          pskv.keys, vals, nullptr, static_cast<int>(version), [vals, cb]() {
+            delete vals; cb();
+          });
+    };
+    Engine::Get()->PushAsync(
+        pull_from_servers,
+        pinned_ctx_,
+        {},
+        {dst.var()},
+        FnProperty::kNormal, priority);
+  }
+
+  /**
+   * \brief whether the push and pull of a key are fused with those of other
+   *  small keys, which is the case for the keys on a single server smaller than
+   *  MXNET_KVSTORE_FUSION_BOUND, unless compressed or sent in float16
+   */
+  inline bool UseFusion(int key, size_t size) {
+    return size < fusion_bound_ && !compression_.enabled() && !UseHalf(key) &&
+        EncodeKey(key, size).keys.size() == 1;
+  }
+
+  /**
+   * \brief cut small keys, sorted by ps key, into groups of at most
+   *  fusion_bound_ values. A group is one request, of one message per server.
+   */
+  std::vector<std::vector<std::pair<int, NDArray> > > FusionGroups(
+      std::vector<std::pair<int, NDArray> > vals) {
+    std::vector<ps::Key> ps_keys(vals.size());
+    std::vector<size_t> order(vals.size());
+    for (size_t i = 0; i < vals.size(); ++i) {
+      ps_keys[i] = EncodeKey(vals[i].first, vals[i].second.shape().Size()).keys[0];
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(),
+              [&ps_keys](size_t a, size_t b) { return ps_keys[a] < ps_keys[b]; });
+    std::vector<std::vector<std::pair<int, NDArray> > > groups;
+    size_t group_size = 0;
+    for (size_t i : order) {
+      size_t size = vals[i].second.shape().Size();
+      if (groups.empty() || group_size + size > fusion_bound_) {
+        groups.emplace_back();
+        group_size = 0;
+      }
+      groups.back().push_back(vals[i]);
+      group_size += size;
+    }
+    return groups;
+  }
+
+  /**
+   * \brief push the merged values of small keys, the values of a group are
+   *  copied into a single buffer and sent in one request
+   */
+  void PushFused(const std::vector<std::pair<int, NDArray> >& vals, int priority) {
+    for (const auto& group : FusionGroups(vals)) {
+      ps::SArray<ps::Key> keys;
+      ps::SArray<int> lens;
+      std::vector<NDArray> arrays;
+      std::vector<Engine::VarHandle> const_vars;
+      size_t total = 0;
+      for (const auto& kv : group) {
+        size_t size = kv.second.shape().Size();
+        keys.push_back(EncodeKey(kv.first, size).keys[0]);
+        lens.push_back(static_cast<int>(size));
+        arrays.push_back(kv.second);
+        for (auto var : RowSparseVars(kv.first)) const_vars.push_back(var);
+        const_vars.push_back(kv.second.var());
+        total += size;
+      }
+      auto push_to_servers = [this, keys, lens, arrays, total](
+          RunContext rctx, Engine::CallbackOnComplete cb) {
+        // the buffer must live until the push is finished
+        auto buf = std::make_shared<std::vector<real_t> >(total);
+        size_t offset = 0;
+        for (const NDArray& arr : arrays) {
+          const real_t* data = static_cast<const real_t*>(arr.data().dptr_);
+          std::copy(data, data + arr.shape().Size(), buf->data() + offset);
+          offset += arr.shape().Size();
+        }
+        ps::SArray<real_t> vals(buf->data(), total, false);
+        ZPush(keys, vals, lens, 0, [cb, buf]() { cb(); });
+      };
+      Engine::Get()->PushAsync(
+          push_to_servers,
+          pinned_ctx_,
+          const_vars,
+          {},
+          FnProperty::kNormal, priority);
+    }
+  }
+
+  /**
+   * \brief pull small keys into their buffers, a group in one request whose
+   *  answer is split over the buffers
+   */
+  void PullFused(const std::vector<std::pair<int, NDArray> >& bufs, int priority) {
+    for (const auto& group : FusionGroups(bufs)) {
+      ps::SArray<ps::Key> keys;
+      std::vector<NDArray> arrays;
+      std::vector<Engine::VarHandle> mutate_vars;
+      for (const auto& kv : group) {
+        keys.push_back(EncodeKey(kv.first, kv.second.shape().Size()).keys[0]);
+        arrays.push_back(kv.second);
+        for (auto var : RowSparseVars(kv.first)) mutate_vars.push_back(var);
+        mutate_vars.push_back(kv.second.var());
+      }
+      auto pull_from_servers = [this, keys, arrays](
+          RunContext rctx, Engine::CallbackOnComplete cb) {
+        auto vals = new ps::SArray<real_t>();
+        auto lens = new ps::SArray<int>();
+        ZPull(keys, vals, lens, 0, [vals, lens, arrays, cb]() {
+            size_t offset = 0;
+            for (const NDArray& arr : arrays) {
+              real_t* data = static_cast<real_t*>(arr.data().dptr_);
+              CHECK_LE(offset + arr.shape().Size(), vals->size());
+              std::copy(vals->data() + offset, vals->data() + offset + arr.shape().Size(), data);
+              offset += arr.shape().Size();
+            }
+            delete vals;
+            delete lens;
+            cb();
+          });
+      };
+      Engine::Get()->PushAsync(
+          pull_from_servers,
+          pinned_ctx_,
+          {},
+          mutate_vars,
+          FnProperty::kNormal, priority);
+    }
+  }
+
+  /**
+   * \brief quantize a merged value with the residual of its key and push it,
+   *  every server part is quantized separately so that it can be recovered
+   *  by the server alone.
+   */
+  void PushCompressed(int key, const NDArray& merged, int priority) {
+    NDArray& residual = residual_[key];
+    if (residual.is_none()) {
+      residual = NDArray(merged.shape(), pinned_ctx_);
+      residual = 0.0f;
+    }
+    auto push_to_servers = [this, key, merged, residual](
+        RunContext rctx, Engine::CallbackOnComplete cb) {
+      size_t size = merged.shape().Size();
+      PSKV& pskv = EncodeKey(key, size);
+      const real_t* data = static_cast<real_t*>(merged.data().dptr_);
+      real_t* res = static_cast<real_t*>(residual.data().dptr_);
+
+      ps::SArray<int> lens;
+      size_t total = 0;
+      for (int len : pskv.lens) {
+        lens.push_back(GradientCompression::CompressedSize(len));
+        total += lens.back();
+      }
+      // the buffer must live until the push is finished
+      auto buf = std::make_shared<std::vector<real_t> >(total);
+      size_t offset = 0, coffset = 0;
+      for (size_t j = 0; j < lens.size(); ++j) {
+        compression_.Quantize(data + offset, res + offset,
+                              buf->data() + coffset, pskv.lens[j]);
+        offset += pskv.lens[j];
+        coffset += lens[j];
+      }
+      ps::SArray<real_t> vals(buf->data(), total, false);
+      ZPush(
+          pskv.keys, vals, lens, 0, [cb, buf]() { cb(); });
+    };
+    std::vector<Engine::VarHandle> const_vars = RowSparseVars(key);
+    const_vars.push_back(merged.var());
+    Engine::Get()->PushAsync(
+        push_to_servers,
+        pinned_ctx_,
+        const_vars,
+        {residual.var()},
+        FnProperty::kNormal, priority);
+  }
+
+  /**
+   * \return whether the pushes and pulls of a key after its initialization
+   *  are sent in float16, by SetWireDType, unless compressed
+   */
+  inline bool UseHalf(int key) {
+    return !compression_.enabled() && half_keys_.count(key) != 0;
+  }
+
+  /**
+   * \brief push the values of the ps keys packed in float16, every server part
+   *  on its own. The server unpacks them to merge in float32.
+   */
+  void PushHalf(const ps::SArray<ps::Key>& keys, const ps::SArray<int>& lens,
+                const real_t* data, Engine::CallbackOnComplete cb) {
+    ps::SArray<int> packed_lens;
+    size_t total = 0;
+    for (int len : lens) {
+      packed_lens.push_back(static_cast<int>(halfwire::PackedSize(len)));
+      total += packed_lens.back();
+    }
+    // the buffer must live until the push is finished
+    auto buf = std::make_shared<std::vector<real_t> >(total);
+    size_t offset = 0, poffset = 0;
+    for (size_t j = 0; j < lens.size(); ++j) {
+      halfwire::Pack(data + offset, lens[j], buf->data() + poffset);
+      offset += lens[j];
+      poffset += packed_lens[j];
+    }
+    ps::SArray<real_t> vals(buf->data(), total, false);
+    ZPush(keys, vals, packed_lens, kPushHalf, [cb, buf]() { cb(); });
+  }
+
+  /**
+   * \brief pull the values of the ps keys in float16 and unpack them into data
+   */
+  void PullHalf(const ps::SArray<ps::Key>& keys, const ps::SArray<int>& lens,
+                real_t* data, Engine::CallbackOnComplete cb) {
+    auto vals = new ps::SArray<real_t>();
+    auto packed_lens = new ps::SArray<int>();
+    ZPull(keys, vals, packed_lens, kPullHalf, [vals, packed_lens, lens, data, cb]() {
+        size_t offset = 0, poffset = 0;
+        for (size_t j = 0; j < lens.size(); ++j) {
+          CHECK_EQ((*packed_lens)[j], static_cast<int>(halfwire::PackedSize(lens[j])));
+          halfwire::Unpack(vals->data() + poffset, lens[j], data + offset);
+          offset += lens[j];
+          poffset += (*packed_lens)[j];
+        }
+        delete vals;
+        delete packed_lens;
+        cb();
+      });
+  }
+
   /**
    * \brief Wait until all pushes and pulls issued on each key have been
    * finished
@@ -185,6 +921,7 @@ class KVStoreDist : public KVStoreDevice {
    * \param keys a list of keys
    */
   void Wait(const std::vector<int>& keys) {
+    const uint64_t start = NowNs();
     for (int key : keys) {
       auto it = merge_buf_.find(key);
       CHECK(it != merge_buf_.end())
@@ -193,6 +930,64 @@ class KVStoreDist : public KVStoreDevice {
           << "there is no push/pull on key " << key << " before";
       it->second.merged.WaitToWrite();
     }
+    {
+      std::lock_guard<std::mutex> lock(stats_mu_);
+      wait_time_.Add(NowNs() - start);
+    }
+    if (StatsLogDue(&stats_log_ns_)) {
+      std::ostringstream os;
+      DumpWorkerStats(&os, false);
+      LOG(INFO) << "worker " << get_rank() << " stats " << os.str();
+    }
+  }
+
+  /**
+   * \brief ZPush of ps-lite, counting the bytes sent to each server and the
+   *  time until the servers answer
+   */
+  inline int ZPush(const ps::SArray<ps::Key>& keys, const ps::SArray<real_t>& vals,
+                   const ps::SArray<int>& lens, int cmd, const std::function<void()>& cb) {
+    CountBytes(keys, lens, vals.size(), &push_bytes_);
+    const uint64_t start = NowNs();
+    return CHECK_NOTNULL(ps_worker_)->ZPush(keys, vals, lens, cmd, [this, start, cb]() {
+        {
+          std::lock_guard<std::mutex> lock(stats_mu_);
+          push_time_.Add(NowNs() - start);
+        }
+        cb();
+      });
+  }
+
+  /**
+   * \brief ZPull of ps-lite, counting the bytes received from each server and
+   *  the time until they arrive
+   */
+  inline int ZPull(const ps::SArray<ps::Key>& keys, ps::SArray<real_t>* vals,
+                   ps::SArray<int>* lens, int cmd, const std::function<void()>& cb) {
+    const uint64_t start = NowNs();
+    return CHECK_NOTNULL(ps_worker_)->ZPull(keys, vals, lens, cmd,
+                                            [this, keys, vals, lens, start, cb]() {
+        CountBytes(keys, lens != nullptr ? *lens : ps::SArray<int>(), vals->size(), &pull_bytes_);
+        {
+          std::lock_guard<std::mutex> lock(stats_mu_);
+          pull_time_.Add(NowNs() - start);
+        }
+        cb();
+      });
+  }
+
+  /**
+   * \brief add the bytes of the values of some ps keys to the counters of their
+   *  servers, the values are split evenly over the keys without lens
+   */
+  void CountBytes(const ps::SArray<ps::Key>& keys, const ps::SArray<int>& lens,
+                  size_t total, std::vector<uint64_t>* bytes) {
+    std::lock_guard<std::mutex> lock(stats_mu_);
+    bytes->resize(ps::Postoffice::Get()->GetServerKeyRanges().size(), 0);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const size_t len = lens.size() == keys.size() ? lens[i] : total / keys.size();
+      (*bytes)[ServerRank(keys[i])] += len * sizeof(real_t);
+    }
   }
 
   /**
@@ -212,6 +1007,7 @@ class KVStoreDist : public KVStoreDevice {
     ps::SArray<ps::Key> keys;  // n keys
     ps::SArray<int> lens;  // the length of the i-th value
     int size;
+    int row_len;  // the length of a row, the parts are made of whole rows
   };
 
   /**
@@ -227,7 +1023,7 @@ class KVStoreDist : public KVStoreDevice {
   /**
    * \brief convert to keys in ps
    */
-  inline PSKV& EncodeKey(int key, size_t size) {
+  inline PSKV& EncodeKey(int key, size_t size, size_t row_len = 1) {
     mu_.lock();
     PSKV& pskv = ps_kv_[key];
     mu_.unlock();
@@ -238,9 +1034,12 @@ class KVStoreDist : public KVStoreDevice {
       auto krs = ps::Postoffice::Get()->GetServerKeyRanges();
       int num_servers = krs.size();
       CHECK_GT(num_servers, 0);
+      pskv.row_len = row_len;
 
-      // a simple heuristic for load balance
-      if (size < bigarray_bound_) {
+      // a simple heuristic for load balance, unless placed by size
+      if (partition_ != "hash") {
+        PartitionBySize(key, size, row_len, &pskv);
+      } else if (size < bigarray_bound_) {
         // send it to a single random picked server
         int server = (key * 9973) % num_servers;
         ps::Key ps_key = krs[server].begin() + key;
@@ -249,12 +1048,13 @@ class KVStoreDist : public KVStoreDevice {
         pskv.lens.push_back(size);
         pskv.size = size;
       } else {
-        // parition it to all servers
+        // parition it to all servers, by whole rows
+        size_t nrow = size / row_len;
         pskv.size = 0;
         for (int i = 0; i < num_servers; ++i) {
-          size_t part_size =
-              static_cast<size_t>(static_cast<double>(size)/num_servers*(i+1)) -
-              static_cast<size_t>(static_cast<double>(size)/num_servers*i);
+          size_t part_size = row_len * (
+              static_cast<size_t>(static_cast<double>(nrow)/num_servers*(i+1)) -
+              static_cast<size_t>(static_cast<double>(nrow)/num_servers*i));
           ps::Key ps_key = krs[i].begin() + key;
           CHECK_LT(ps_key, krs[i].end());
           pskv.keys.push_back(ps_key);
@@ -267,8 +1067,354 @@ class KVStoreDist : public KVStoreDevice {
     return pskv;
   }
 
-  // whether use device distributed local sync.
-  bool device_mode_;
+  /**
+   * \brief place a key on the servers with the least bytes, weighted by the
+   *  measured costs of the servers when there are. A small array goes to a
+   *  single server, a big array is sliced by rows such that the servers it is
+   *  placed on end with the same weighted bytes.
+   */
+  void PartitionBySize(int key, size_t size, size_t row_len, PSKV* pskv) {
+    std::lock_guard<std::mutex> lock(partition_mu_);
+    auto krs = ps::Postoffice::Get()->GetServerKeyRanges();
+    const int num_servers = krs.size();
+    server_load_.resize(num_servers, 0.0);
+    if (server_cost_.empty()) server_cost_.resize(num_servers, 1.0);
+    auto weighted = [this](int s, double bytes) {
+      return (server_load_[s] + bytes) * server_cost_[s];
+    };
+    if (size < bigarray_bound_) {
+      int best = 0;
+      for (int s = 1; s < num_servers; ++s) {
+        if (weighted(s, size) < weighted(best, size)) best = s;
+      }
+      ps::Key ps_key = krs[best].begin() + key;
+      CHECK_LT(ps_key, krs[best].end());
+      pskv->keys.push_back(ps_key);
+      pskv->lens.push_back(size);
+      pskv->size = size;
+      server_load_[best] += size;
+      return;
+    }
+    const size_t nrow = size / row_len;
+    std::vector<size_t> rows(num_servers, 0);
+    // the weighted level at which the servers below it hold the array
+    auto fill = [this, num_servers](double level) {
+      double bytes = 0;
+      for (int s = 0; s < num_servers; ++s) {
+        bytes += std::max(0.0, level / server_cost_[s] - server_load_[s]);
+      }
+      return bytes;
+    };
+    double lo = 0, hi = 1;
+    while (fill(hi) < size) hi *= 2;
+    for (int i = 0; i < 64; ++i) {
+      double mid = (lo + hi) / 2;
+      if (fill(mid) < size) lo = mid; else hi = mid;
+    }
+    size_t assigned = 0;
+    for (int s = 0; s < num_servers; ++s) {
+      double part = std::max(0.0, lo / server_cost_[s] - server_load_[s]);
+      rows[s] = std::min(static_cast<size_t>(part / row_len), nrow - assigned);
+      assigned += rows[s];
+    }
+    // the rows left by the rounding down go one by one to the least loaded
+    for (; assigned < nrow; ++assigned) {
+      int best = 0;
+      for (int s = 1; s < num_servers; ++s) {
+        if (weighted(s, (rows[s] + 1) * row_len) <
+            weighted(best, (rows[best] + 1) * row_len)) best = s;
+      }
+      ++rows[best];
+    }
+    pskv->size = 0;
+    for (int s = 0; s < num_servers; ++s) {
+      if (rows[s] == 0) continue;
+      ps::Key ps_key = krs[s].begin() + key;
+      CHECK_LT(ps_key, krs[s].end());
+      pskv->keys.push_back(ps_key);
+      pskv->lens.push_back(rows[s] * row_len);
+      pskv->size += rows[s] * row_len;
+      server_load_[s] += rows[s] * row_len;
+    }
+    CHECK_EQ(static_cast<size_t>(pskv->size), size);
+  }
+
+  /*! \return the length of a row of a value of shape, the size of its last dimensions */
+  inline static size_t RowLength(const TShape& shape) {
+    return shape.ndim() < 2 || shape[0] == 0 ? 1 : shape.Size() / shape[0];
+  }
+
+  /*! \return the number of rows of an initialized key */
+  inline size_t NumRows(int key) {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = ps_kv_.find(key);
+    CHECK(it != ps_kv_.end() && !it->second.keys.empty())
+        << "key " << key << " has not been inited";
+    return it->second.size / it->second.row_len;
+  }
+
+  /**
+   * \brief the ps keys of some rows of a key, one key per row.
+   *
+   *  The key of row r of the server part starting at row begin is
+   *  ((key + 1) << 32) + r - begin in the key range of the server, dense keys are
+   *  below 1 << 32.
+   */
+  inline void EncodeRowSparseKeys(int key, const std::vector<uint32_t>& rows,
+                                  ps::SArray<ps::Key>* keys, ps::SArray<int>* lens) {
+    mu_.lock();
+    const PSKV& pskv = ps_kv_[key];
+    mu_.unlock();
+    size_t part = 0, begin = 0;
+    for (uint32_t r : rows) {
+      while (r >= begin + pskv.lens[part] / pskv.row_len) {
+        begin += pskv.lens[part] / pskv.row_len;
+        ++part;
+      }
+      ps::Key base = pskv.keys[part] - key;
+      keys->push_back(base + ((static_cast<ps::Key>(key) + 1) << 32) + (r - begin));
+      lens->push_back(pskv.row_len);
+    }
+  }
+
+  /**
+   * \brief the variable ordering the row sparse push and pull of a key with
+   *  its other push and pull
+   * \param create whether to create it, only keys with row sparse push or pull have one
+   */
+  inline std::vector<Engine::VarHandle> RowSparseVars(int key, bool create = false) {
+    auto it = row_sparse_var_.find(key);
+    if (it == row_sparse_var_.end()) {
+      if (!create) return {};
+      it = row_sparse_var_.emplace(key, NDArray(mshadow::Shape1(1), pinned_ctx_)).first;
+    }
+    return {it->second.var()};
+  }
+
+  /**
+   * \brief whether the push and pull of a key are pipelined over its server
+   *  parts, which is the case for big arrays in device mode.
+   */
+  inline bool UsePipeline(int key, size_t size) {
+    return device_mode_ && !compression_.enabled() &&
+        EncodeKey(key, size).keys.size() > 1;
+  }
+
+  /**
+   * \brief reduce and push every server part of a big array on its own, so
+   *  the reduce over devices of a part overlaps the network push of the
+   *  parts before it. The reduce of the parts is spread over the devices.
+   */
+  void PushPipelined(int key, const std::vector<NDArray>& vals, int priority) {
+    size_t size = vals[0].shape().Size();
+    PSKV& pskv = EncodeKey(key, size);
+    std::vector<PipelineChunk>& chunks = InitPipelineChunks(key, pskv, vals);
+    std::vector<NDArray> flat(vals.size());
+    for (size_t i = 0; i < vals.size(); ++i) flat[i] = FlatView(vals[i]);
+    size_t offset = 0;
+    for (size_t j = 0; j < chunks.size(); ++j) {
+      PipelineChunk& chunk = chunks[j];
+      size_t len = pskv.lens[j];
+      std::vector<NDArray> reduce(vals.size());
+      for (size_t i = 0; i < vals.size(); ++i) {
+        CopyFromTo(flat[i].Slice(offset, offset + len), &chunk.copy_buf[i], priority);
+        reduce[i] = chunk.copy_buf[i];
+      }
+      if (reduce.size() == 1) {
+        CopyFromTo(reduce[0], &chunk.merged, priority);
+      } else {
+        ElementwiseSum(reduce, &chunk.merged_device, priority);
+        CopyFromTo(chunk.merged_device, &chunk.merged, priority);
+      }
+      NDArray merged = chunk.merged;
+      ps::SArray<ps::Key> keys(1, pskv.keys[j]);
+      ps::SArray<int> lens(1, static_cast<int>(len));
+      const bool half = UseHalf(key);
+      auto push_to_server = [this, merged, keys, lens, half](
+          RunContext rctx, Engine::CallbackOnComplete cb) {
+        real_t* data = static_cast<real_t*>(merged.data().dptr_);
+        if (half) {
+          PushHalf(keys, lens, data, cb);
+          return;
+        }
+        ps::SArray<real_t> vals(data, merged.shape().Size(), false);
+        ZPush(keys, vals, lens, 0, [cb]() { cb(); });
+      };
+      std::vector<Engine::VarHandle> const_vars = RowSparseVars(key);
+      const_vars.push_back(merged.var());
+      Engine::Get()->PushAsync(
+          push_to_server,
+          pinned_ctx_,
+          const_vars,
+          {},
+          FnProperty::kNormal, priority);
+      offset += len;
+    }
+  }
+
+  /**
+   * \brief pull every server part of a big array on its own, each part is
+   *  copied to the device copies as soon as it arrives.
+   */
+  void PullPipelined(int key, const std::vector<NDArray*>& vals, int priority) {
+    size_t size = vals[0]->shape().Size();
+    PSKV& pskv = EncodeKey(key, size);
+    std::vector<NDArray> dev_vals(vals.size());
+    for (size_t i = 0; i < vals.size(); ++i) dev_vals[i] = *vals[i];
+    std::vector<PipelineChunk>& chunks = InitPipelineChunks(key, pskv, dev_vals);
+    std::vector<NDArray> flat(vals.size());
+    for (size_t i = 0; i < vals.size(); ++i) flat[i] = FlatView(*vals[i]);
+    size_t offset = 0;
+    for (size_t j = 0; j < chunks.size(); ++j) {
+      NDArray buf = chunks[j].merged;
+      size_t len = pskv.lens[j];
+      ps::SArray<ps::Key> keys(1, pskv.keys[j]);
+      const bool half = UseHalf(key);
+      auto pull_from_server = [this, buf, keys, half](
+          RunContext rctx, Engine::CallbackOnComplete cb) {
+        real_t* data = static_cast<real_t*>(buf.data().dptr_);
+        if (half) {
+          PullHalf(keys, ps::SArray<int>(1, static_cast<int>(buf.shape().Size())), data, cb);
+          return;
+        }
+        auto vals = new ps::SArray<real_t>(data, buf.shape().Size(), false);
+        ZPull(
+            keys, vals, nullptr, 0, [vals, cb]() { delete vals; cb(); });
+      };
+      std::vector<Engine::VarHandle> mutate_vars = RowSparseVars(key);
+      mutate_vars.push_back(buf.var());
+      Engine::Get()->PushAsync(
+          pull_from_server,
+          pinned_ctx_,
+          {},
+          mutate_vars,
+          FnProperty::kNormal, priority);
+      for (size_t i = 0; i < vals.size(); ++i) {
+        NDArray dst = flat[i].Slice(offset, offset + len);
+        CopyFromTo(buf, &dst, priority);
+      }
+      offset += len;
+    }
+  }
+
+  /*! \brief buffers of one server part of a pipelined key */
+  struct PipelineChunk {
+    /*! \brief the part of each device value, on the reducing device */
+    std::vector<NDArray> copy_buf;
+    /*! \brief the reduced part on the reducing device */
+    NDArray merged_device;
+    /*! \brief the reduced part in pinned memory, sent to the server */
+    NDArray merged;
+  };
+
+  /*! \return the buffers of a pipelined key, allocated on first use */
+  std::vector<PipelineChunk>& InitPipelineChunks(
+      int key, const PSKV& pskv, const std::vector<NDArray>& vals) {
+    std::vector<PipelineChunk>& chunks = pipeline_buf_[key];
+    if (chunks.size() != 0) return chunks;
+    chunks.resize(pskv.keys.size());
+    for (size_t j = 0; j < chunks.size(); ++j) {
+      size_t ds[] = {static_cast<size_t>(pskv.lens[j])};
+      TShape dshape(ds, ds + 1);
+      // reduce the parts on different devices in turn
+      Context ctx = vals[j % vals.size()].ctx();
+      PipelineChunk& chunk = chunks[j];
+      Storage::AllocOriginScope origin("kvstore");
+      for (size_t i = 0; i < vals.size(); ++i) {
+        chunk.copy_buf.push_back(NDArray(dshape, ctx));
+      }
+      chunk.merged_device = NDArray(dshape, ctx);
+      chunk.merged = NDArray(dshape, pinned_ctx_);
+    }
+    return chunks;
+  }
+
+  /**
+   * \brief compression of pushed gradients
+   */
+  GradientCompression compression_;
+  /**
+   * \brief the residual of compressed pushes of each key
+   */
+  std::unordered_map<int, NDArray> residual_;
+  /**
+   * \brief the keys whose pushes and pulls are sent in float16
+   */
+  std::unordered_set<int> half_keys_;
+  /**
+   * \brief the ordering variable of the keys with row sparse push or pull
+   */
+  std::unordered_map<int, NDArray> row_sparse_var_;
+  /**
+   * \brief buffers of the pipelined keys
+   */
+  std::unordered_map<int, std::vector<PipelineChunk> > pipeline_buf_;
+  /**
+   * \brief the keys smaller than it are fused, and their requests hold at most
+   *  so many values, given by MXNET_KVSTORE_FUSION_BOUND
+   */
+  size_t fusion_bound_;
+  /**
+   * \brief whether the pulls are fused too, which they are not with a staleness bound
+   */
+  bool fuse_pull_;
+  /**
+   * \brief whether the initialization is broadcast over the workers, given by
+   *  MXNET_KVSTORE_TREE_INIT, and the relayed values waiting
+   */
+  bool tree_init_;
+  std::deque<std::string> relay_inbox_;
+  std::mutex relay_mu_;
+  std::condition_variable relay_cv_;
+  /**
+   * \brief whether the pushes of dist_sync pull the updated values ahead, given by
+   *  MXNET_KVSTORE_PULL_AHEAD
+   */
+  bool pull_ahead_;
+  /**
+   * \brief the version of each key on the servers after the pushes issued, and
+   *  the version pulled ahead into the buffer of the key
+   */
+  std::unordered_map<int, uint64_t> push_version_, ahead_version_;
+  std::unordered_map<int, NDArray> ahead_buf_;
+  /**
+   * \brief the placement of the keys on the servers, "hash", "size" or
+   *  "latency", given by MXNET_KVSTORE_PARTITION
+   */
+  std::string partition_;
+  /**
+   * \brief the bytes placed on each server and the cost of a byte on each
+   *  server, relative to the fastest one
+   */
+  std::vector<double> server_load_, server_cost_;
+  std::mutex partition_mu_;
+  /**
+   * \brief the bytes pushed to and pulled from each server, the times until
+   *  the pushes are answered and the pulls arrive, the times waited in Wait
+   *  and in Barrier
+   */
+  std::vector<uint64_t> push_bytes_, pull_bytes_;
+  DurationHistogram push_time_, pull_time_, wait_time_, barrier_time_;
+  /**
+   * \brief the time of the last log of the counters
+   */
+  uint64_t stats_log_ns_ = 0;
+  std::mutex stats_mu_;
+  /**
+   * \brief whether the pushes to the servers on the same host go through shared
+   *  memory, which servers are, the name prefix of the regions of this worker and
+   *  the region of each ps key
+   */
+  bool shm_;
+  std::vector<bool> shm_local_;
+  std::string shm_prefix_;
+  std::unordered_map<ps::Key, std::unique_ptr<SharedRegion> > shm_regions_;
+  std::mutex shm_mu_;
+  /**
+   * \brief the bodies of the responses to the commands, by timestamp
+   */
+  std::unordered_map<int, std::string> responses_;
+  std::mutex response_mu_;
   /**
    * \brief for worker to push and pull data
    */
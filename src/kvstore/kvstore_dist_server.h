@@ -5,22 +5,52 @@
  */
 #ifndef MXNET_KVSTORE_KVSTORE_DIST_SERVER_H_
 #define MXNET_KVSTORE_KVSTORE_DIST_SERVER_H_
+#include <algorithm>
 #include <queue>
 #include <string>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
+#include <sstream>
 #include <functional>
+#include <map>
 #include <future>
+#include <unordered_map>
 #include <vector>
 #include "ps/ps.h"
+#include "mxnet/engine.h"
 #include "mxnet/kvstore.h"
+#include "mxnet/optimizer.h"
+#include "./gradient_compression.h"
+#include "./half_wire.h"
+#include "./kvstore_stats.h"
+#include "./kvstore_shm.h"
 
 namespace mxnet {
 namespace kvstore {
 
 static const int kStopServer = -1;
 static const int kSyncMode = -2;
+static const int kSetGradientCompression = -3;
+static const int kTakeDataPart = -4;
+static const int kSetOptimizer = -5;
+static const int kPartitionProbe = -6;
+static const int kPartitionCost = -7;
+static const int kSetStaleness = -8;
+static const int kInitRelay = -9;
+static const int kGetStats = -10;
+static const int kShmAttach = -11;
+/**
+ * \brief the cmd of a push whose values are in the shared memory region of
+ *  the worker and the key, see KVStoreDistServer::ShmPush
+ */
+static const int kPushShm = -1;
+/**
+ * \brief the cmd of a push, and of a pull, whose values are sent in float16,
+ *  see halfwire::Pack. The servers store and merge them in float32.
+ */
+static const int kPushHalf = -2;
+static const int kPullHalf = -1;
 
 /**
  * \brief executor runs a function using the thread called \ref Start
@@ -94,9 +124,13 @@ class KVStoreDistServer {
     ps_server_->set_request_handle(
         std::bind(&KVStoreDistServer::DataHandle, this, _1, _2, _3));
     sync_mode_ = false;
+    staleness_ = -1;
+    lr_ = wd_ = 0.0f;
   }
 
   ~KVStoreDistServer() {
+    // the engine operations answer the requests by the server
+    Engine::Get()->WaitForAll();
     delete ps_server_;
   }
 
@@ -123,6 +157,28 @@ class KVStoreDistServer {
       exec_.Stop();
     } else if (recved.head == kSyncMode) {
       sync_mode_ = true;
+    } else if (recved.head == kSetStaleness) {
+      staleness_ = std::stoi(recved.body);
+    } else if (recved.head == kSetGradientCompression) {
+      compression_.Decode(recved.body);
+    } else if (recved.head == kSetOptimizer) {
+      SetOptimizer(recved.body);
+    } else if (recved.head == kPartitionCost) {
+      // set by worker 0, read by all workers
+      if (!recved.body.empty()) partition_cost_ = recved.body;
+      app->Response(recved, partition_cost_);
+      return;
+    } else if (recved.head == kPartitionProbe) {
+      // only timed by the worker
+    } else if (recved.head == kTakeDataPart) {
+      app->Response(recved, TakeDataPart(recved.body));
+      return;
+    } else if (recved.head == kGetStats) {
+      app->Response(recved, GetStats(recved.body == "reset"));
+      return;
+    } else if (recved.head == kShmAttach) {
+      app->Response(recved, ShmAttach(recved.sender, recved.body) ? "1" : "0");
+      return;
     } else {
       // let the main thread to execute ctrl, which is necessary for python
       exec_.Exec([this, recved]() {
@@ -133,9 +189,99 @@ class KVStoreDistServer {
     app->Response(recved);
   }
 
+  /**
+   * \brief give the next part of a dataset epoch, see KVStore::TakeDataPart
+   * \param body "epoch num_parts dataset"
+   * \return the part index, -1 when all parts are taken
+   */
+  std::string TakeDataPart(const std::string& body) {
+    std::istringstream is(body);
+    int epoch, num_parts;
+    CHECK(is >> epoch >> num_parts) << "invalid data part request " << body;
+    std::string dataset;
+    std::getline(is, dataset);
+    std::lock_guard<std::mutex> lock(part_mu_);
+    int& next = next_part_[dataset];
+    auto& epoch_of = part_epoch_[dataset];
+    if (epoch > epoch_of) {
+      // the first request of a new epoch
+      epoch_of = epoch;
+      next = 0;
+    }
+    int part = -1;
+    if (epoch == epoch_of && next < num_parts) part = next++;
+    return std::to_string(part);
+  }
+
+  /**
+   * \brief create the native optimizer run on the engine instead of the
+   *  updater, see KVStoreDist::SetServerOptimizer
+   * \param body "name\nkey=value\n..." sent by every worker, only the
+   *  first one is used so that the optimizer states are kept
+   */
+  void SetOptimizer(const std::string& body) {
+    if (optimizer_ != nullptr) {
+      CHECK_EQ(body, optimizer_body_) << "the workers set different server optimizers";
+      return;
+    }
+    std::istringstream is(body);
+    std::string name, line;
+    std::getline(is, name);
+    std::vector<std::pair<std::string, std::string> > kwargs;
+    while (std::getline(is, line)) {
+      size_t pos = line.find('=');
+      CHECK_NE(pos, std::string::npos) << "invalid server optimizer " << body;
+      std::string k = line.substr(0, pos), v = line.substr(pos + 1);
+      // the learning rate and the weight decay are arguments of Update
+      if (k == "learning_rate") {
+        lr_ = std::stof(v);
+      } else if (k == "wd") {
+        wd_ = std::stof(v);
+      } else {
+        kwargs.push_back(std::make_pair(k, v));
+      }
+    }
+    optimizer_.reset(Optimizer::Create(name.c_str()));
+    optimizer_->Init(kwargs);
+    optimizer_body_ = body;
+  }
+
+  /**
+   * \brief update a stored value, by the native optimizer pushed to the
+   *  engine without waiting if there is one, otherwise by the updater run on
+   *  the main thread
+   */
+  void ApplyUpdate(int key, const NDArray& recved, NDArray* stored) {
+    if (optimizer_ != nullptr) {
+      optimizer_->Update(key, stored, &recved, lr_, wd_);
+      return;
+    }
+    // let the main thread to execute updater_, which is necessary for python
+    exec_.Exec([this, key, &recved, stored]() {
+        CHECK(updater_);
+        updater_(key, recved, stored);
+      });
+  }
+
   void DataHandle(const ps::KVMeta& req_meta,
                   const ps::KVPairs<real_t>& req_data,
                   ps::KVServer<real_t>* server) {
+    CountBytes(req_meta, req_data.vals.size(), true);
+    if (StatsLogDue(&stats_log_ns_)) LOG(INFO) << "server stats " << GetStats(false);
+    int sparse_key;
+    uint32_t row;
+    if (req_data.keys.size() != 0 && DecodeRowSparseKey(req_data.keys[0], &sparse_key, &row)) {
+      RowSparseHandle(req_meta, req_data, server);
+      return;
+    }
+    if (req_meta.push && req_meta.cmd == kPushShm) {
+      ShmPush(req_meta, req_data, server);
+      return;
+    }
+    if (req_data.keys.size() > 1) {
+      FusedHandle(req_meta, req_data, server);
+      return;
+    }
     // do some check
     CHECK_EQ(req_data.keys.size(), (size_t)1);
     if (req_meta.push) {
@@ -144,72 +290,527 @@ class KVStoreDistServer {
     }
 
     int key = DecodeKey(req_data.keys[0]);
-    auto& stored = store_[key];
 
-    // there used several WaitToRead, this is because \a recved's memory
-    // could be deallocated when this function returns. so we need to make sure
-    // the operators with \a NDArray are actually finished
-    if (req_meta.push) {
-      size_t ds[] = {(size_t)req_data.lens[0]};
-      TShape dshape(ds, ds + 1);
-      TBlob recv_blob((real_t*)req_data.vals.data(), // NOLINT(*)
-                      dshape, cpu::kDevMask);
-      NDArray recved = NDArray(recv_blob, 0);
-      if (stored.is_none()) {
-        // initialization
-        stored = NDArray(dshape, Context());
-        CopyFromTo(recved, &stored, 0);
-        server->Response(req_meta);
-        stored.WaitToRead();
-      } else if (sync_mode_) {
-        // synced push
-        auto& merged = merge_buf_[key];
-        if (merged.array.is_none()) {
-          merged.array = NDArray(dshape, Context());
+    if (!req_meta.push) {
+      // pull, answered by the last published value without waiting for the
+      // pending updates, which are answered after their publication
+      if (staleness_ >= 0 && !sync_mode_) {
+        std::lock_guard<std::mutex> lock(clock_mu_);
+        if (TooStale(key, ps::Postoffice::Get()->IDtoRank(req_meta.sender))) {
+          blocked_pulls_[key].push_back(std::make_pair(req_meta, req_data.keys));
+          return;
+        }
+      }
+      if (req_meta.cmd > 0) {
+        // a pull ahead of the update, the command is the version to answer with
+        std::lock_guard<std::mutex> lock(snapshot_mu_);
+        if (snapshots_[key].version < static_cast<uint64_t>(req_meta.cmd)) {
+          ahead_pulls_[key].push_back(std::make_pair(req_meta, req_data.keys));
+          return;
         }
+      }
+      ps::KVPairs<real_t> response;
+      response.keys = req_data.keys;
+      {
+        std::lock_guard<std::mutex> lock(snapshot_mu_);
+        auto it = snapshots_.find(key);
+        CHECK(it != snapshots_.end()) << "init " << key << " first";
+        response.vals = it->second.vals;
+      }
+      if (req_meta.cmd == kPullHalf) response.vals = PackHalf(response.vals);
+      response.lens = {static_cast<int>(response.vals.size())};
+      CountBytes(req_meta, response.vals.size(), false);
+      server->Response(req_meta, response);
+      return;
+    }
 
-        if (merged.request.size() == 0) {
-          CopyFromTo(recved, &merged.array, 0);
-        } else {
-          merged.array += recved;
+    PushKey(req_meta, key, req_data.vals, 0, req_data.lens[0], server);
+  }
+
+  /**
+   * \brief push or pull of several small keys in one request, with their values
+   *  concatenated in the order of the keys. A push is answered once all of its
+   *  keys are published.
+   */
+  void FusedHandle(const ps::KVMeta& req_meta,
+                   const ps::KVPairs<real_t>& req_data,
+                   ps::KVServer<real_t>* server) {
+    const size_t n = req_data.keys.size();
+    if (!req_meta.push) {
+      CHECK(staleness_ < 0 || sync_mode_)
+          << "fused pulls cannot wait for the staleness bound";
+      std::vector<ps::SArray<real_t> > vals(n);
+      {
+        std::lock_guard<std::mutex> lock(snapshot_mu_);
+        for (size_t i = 0; i < n; ++i) {
+          int key = DecodeKey(req_data.keys[i]);
+          auto it = snapshots_.find(key);
+          CHECK(it != snapshots_.end()) << "init " << key << " first";
+          vals[i] = it->second.vals;
         }
+      }
+      ps::KVPairs<real_t> response;
+      response.keys = req_data.keys;
+      size_t total = 0;
+      for (const auto& v : vals) total += v.size();
+      response.vals.resize(total);
+      size_t offset = 0;
+      for (const auto& v : vals) {
+        std::copy(v.begin(), v.end(), response.vals.begin() + offset);
+        offset += v.size();
+        response.lens.push_back(static_cast<int>(v.size()));
+      }
+      CountBytes(req_meta, response.vals.size(), false);
+      server->Response(req_meta, response);
+      return;
+    }
+    CHECK_EQ(req_data.lens.size(), n);
+    {
+      std::lock_guard<std::mutex> lock(fused_mu_);
+      fused_pending_[std::make_pair(req_meta.sender, req_meta.timestamp)] = n;
+    }
+    size_t offset = 0;
+    for (size_t i = 0; i < n; ++i) {
+      PushKey(req_meta, DecodeKey(req_data.keys[i]), req_data.vals, offset,
+              req_data.lens[i], server);
+      offset += req_data.lens[i];
+    }
+    CHECK_EQ(offset, req_data.vals.size());
+  }
+
+  /**
+   * \brief whether the shared memory regions of a worker can be opened, the
+   *  body is the prefix of their names and the token written in its probe region
+   */
+  bool ShmAttach(int sender, const std::string& body) {
+    std::istringstream is(body);
+    std::string prefix;
+    uint64_t token;
+    CHECK(is >> prefix >> token) << "invalid shm attach " << body;
+    std::unique_ptr<SharedRegion> probe(SharedRegion::Open(prefix + "_probe", sizeof(token)));
+    if (probe == nullptr || *static_cast<uint64_t*>(probe->data()) != token) return false;
+    std::lock_guard<std::mutex> lock(shm_mu_);
+    shm_prefix_[sender] = prefix;
+    return true;
+  }
+
+  /**
+   * \brief push of a worker on the same host, whose values are in its shared
+   *  memory region of the ps key instead of the message. The server reads the
+   *  region in place, the worker writes it again only after the push is answered.
+   */
+  void ShmPush(const ps::KVMeta& req_meta, const ps::KVPairs<real_t>& req_data,
+               ps::KVServer<real_t>* server) {
+    CHECK_EQ(req_data.keys.size(), (size_t)1);
+    CHECK(!compression_.enabled()) << "compressed pushes are not in shared memory";
+    const ps::Key ps_key = req_data.keys[0];
+    const int key = DecodeKey(ps_key);
+    const NDArray& stored = store_[key];
+    CHECK(!stored.is_none()) << "init " << key << " first";
+    NDArray& shared = shm_arrays_[std::make_pair(req_meta.sender, ps_key)];
+    if (shared.is_none()) {
+      std::string name;
+      {
+        std::lock_guard<std::mutex> lock(shm_mu_);
+        CHECK_NE(shm_prefix_.count(req_meta.sender), 0U) << "shm push before attach";
+        name = shm_prefix_[req_meta.sender] + "_" + std::to_string(ps_key);
+      }
+      const size_t size = stored.shape().Size();
+      std::shared_ptr<SharedRegion> region(SharedRegion::Open(name, size * sizeof(real_t)));
+      CHECK(region != nullptr) << "cannot open the shared memory region " << name;
+      shared = NDArray(TBlob(static_cast<real_t*>(region->data()), stored.shape(),
+                             cpu::kDevMask), 0, region);
+    }
+    PushKey(req_meta, key, ps::SArray<real_t>(), 0, stored.shape().Size(), server, &shared);
+  }
 
-        merged.request.push_back(req_meta);
-
-        if (merged.request.size() == (size_t)ps::NumWorkers()) {
-          // let the main thread to execute updater_, which is necessary for
-          // python
-          exec_.Exec([this, key, &merged, &stored](){
-              CHECK(updater_);
-              updater_(key, merged.array, &stored);
-            });
-          for (const auto& req : merged.request) {
-            server->Response(req);
+  /**
+   * \brief answer a push request, a fused one after the publication of its last key
+   */
+  void RespondPush(const ps::KVMeta& req, ps::KVServer<real_t>* server) {
+    {
+      std::lock_guard<std::mutex> lock(fused_mu_);
+      auto it = fused_pending_.find(std::make_pair(req.sender, req.timestamp));
+      if (it != fused_pending_.end()) {
+        if (--it->second > 0) return;
+        fused_pending_.erase(it);
+      }
+    }
+    server->Response(req);
+  }
+
+  /**
+   * \brief push of the value of a key, the len received values at offset of vals
+   * \param shared the values in shared memory instead of vals, or nullptr
+   */
+  void PushKey(const ps::KVMeta& req_meta, int key, const ps::SArray<real_t>& vals,
+               size_t offset, size_t len, ps::KVServer<real_t>* server,
+               const NDArray* shared = nullptr) {
+    auto& stored = store_[key];
+    size_t recv_size = len;
+    const bool half = req_meta.cmd == kPushHalf && !stored.is_none();
+    const bool compressed = compression_.enabled() && !stored.is_none() && !half;
+    if (compressed) {
+      // pushes after the initialization are compressed
+      recv_size = stored.shape()[0];
+      CHECK_EQ(len, GradientCompression::CompressedSize(recv_size));
+    } else if (half) {
+      recv_size = stored.shape()[0];
+      CHECK_EQ(len, halfwire::PackedSize(recv_size));
+    }
+    size_t ds[] = {recv_size};
+    TShape dshape(ds, ds + 1);
+    // the receive buffer of the key is reused over the pushes. The pushed values
+    // are copied into it by an engine operation, ordered after the reads of the
+    // previous values, which holds the received message until then. Nothing
+    // here waits for the engine. The values in shared memory are merged or
+    // updated in place instead.
+    NDArray recved;
+    if (shared != nullptr) {
+      CHECK(!stored.is_none() && shared->shape() == dshape);
+      recved = *shared;
+    } else {
+      NDArray& buf = recv_buf_[key];
+      if (buf.is_none() || buf.shape() != dshape) {
+        buf = NDArray(dshape, Context());
+      }
+      recved = buf;
+      Engine::Get()->PushSync([this, vals, offset, compressed, half, recved](RunContext ctx) {
+          real_t* recv_data = static_cast<real_t*>(recved.data().dptr_);
+          const size_t size = recved.shape().Size();
+          if (compressed) {
+            compression_.Dequantize(vals.data() + offset, recv_data, size);
+          } else if (half) {
+            halfwire::Unpack(vals.data() + offset, size, recv_data);
+          } else {
+            std::copy(vals.data() + offset, vals.data() + offset + size, recv_data);
           }
-          merged.request.clear();
-          stored.WaitToRead();
-        } else {
-          merged.array.WaitToRead();
-        }
+        }, recved.ctx(), {}, {recved.var()}, FnProperty::kNormal);
+    }
+
+    if (stored.is_none()) {
+      // initialization, the command is the row length
+      row_len_[key] = req_meta.cmd > 0 ? req_meta.cmd : 1;
+      stored = NDArray(dshape, Context());
+      CopyFromTo(recved, &stored);
+      Publish(key, stored, {req_meta}, server);
+    } else if (sync_mode_) {
+      // synced push, merged into a buffer also reused over the rounds
+      auto& merged = merge_buf_[key];
+      if (merged.request.size() == 0) {
+        if (merged.array.is_none()) merged.array = NDArray(dshape, Context());
+        CopyFromTo(recved, &merged.array);
       } else {
-        // async push
-        exec_.Exec([this, key, &recved, &stored](){
-            CHECK(updater_);
-            updater_(key, recved, &stored);
-          });
-        server->Response(req_meta);
-        stored.WaitToRead();
+        merged.array += recved;
+      }
+
+      merged.request.push_back(req_meta);
+      CountArrival(key, req_meta.sender, merged.request.size());
+
+      if (merged.request.size() == (size_t)ps::NumWorkers()) {
+        const uint64_t start = NowNs();
+        ApplyUpdate(key, merged.array, &stored);
+        Publish(key, stored, merged.request, server, -1, start);
+        merged.request.clear();
       }
     } else {
-      // pull
+      // async push, which is a tick of the clock of its worker on the key
+      const uint64_t start = NowNs();
+      ApplyUpdate(key, recved, &stored);
+      Publish(key, stored, {req_meta}, server,
+              staleness_ >= 0 ? ps::Postoffice::Get()->IDtoRank(req_meta.sender) : -1, start);
+    }
+  }
+
+  /**
+   * \brief copy a stored value to a new snapshot for the pulls, and answer
+   *  the push requests, by an engine operation run once the pending updates
+   *  of the value are finished
+   * \param worker the rank of the worker whose clock on the key ticks after
+   *  the publication, which may answer the pulls blocked by the staleness
+   *  bound, or -1
+   * \param update_start the time the update of the value was issued, counted
+   *  in the update times, or 0
+   */
+  void Publish(int key, const NDArray& stored, const std::vector<ps::KVMeta>& requests,
+               ps::KVServer<real_t>* server, int worker = -1, uint64_t update_start = 0) {
+    const uint64_t version = ++version_[key];
+    NDArray value = stored;
+    Engine::Get()->PushSync([this, key, value, version, requests, server, worker,
+                             update_start](RunContext ctx) {
+        if (update_start != 0) {
+          std::lock_guard<std::mutex> lock(stats_mu_);
+          update_time_.Add(NowNs() - update_start);
+        }
+        ps::SArray<real_t> vals;
+        vals.CopyFrom(static_cast<const real_t*>(value.data().dptr_), value.shape().Size());
+        std::vector<std::pair<ps::KVMeta, ps::SArray<ps::Key> > > ahead;
+        ps::SArray<real_t> latest;
+        {
+          std::lock_guard<std::mutex> lock(snapshot_mu_);
+          auto& snapshot = snapshots_[key];
+          if (version > snapshot.version) {
+            snapshot.vals = vals;
+            snapshot.version = version;
+          }
+          latest = snapshot.vals;
+          auto it = ahead_pulls_.find(key);
+          for (size_t i = 0; it != ahead_pulls_.end() && i < it->second.size();) {
+            if (static_cast<uint64_t>(it->second[i].first.cmd) > snapshot.version) {
+              ++i;
+            } else {
+              ahead.push_back(it->second[i]);
+              it->second[i] = it->second.back();
+              it->second.pop_back();
+            }
+          }
+        }
+        for (const auto& req : requests) {
+          RespondPush(req, server);
+        }
+        for (const auto& pull : ahead) {
+          ps::KVPairs<real_t> response;
+          response.keys = pull.second;
+          response.vals = latest;
+          response.lens = {static_cast<int>(latest.size())};
+          CountBytes(pull.first, latest.size(), false);
+          server->Response(pull.first, response);
+        }
+        if (worker >= 0) Tick(key, worker, vals, server);
+      }, value.ctx(), {value.var()}, {}, FnProperty::kNormal);
+  }
+
+  /**
+   * \brief count the values of a request or of its response by worker
+   */
+  void CountBytes(const ps::KVMeta& req, size_t nvals, bool push) {
+    if (nvals == 0) return;
+    const int rank = ps::Postoffice::Get()->IDtoRank(req.sender);
+    std::lock_guard<std::mutex> lock(stats_mu_);
+    WorkerStats& w = worker_stats_[rank];
+    (push ? w.push_bytes : w.pull_bytes) += nvals * sizeof(real_t);
+  }
+
+  /**
+   * \brief count the arrival of a push of a sync round of a key, the arrival
+   *  delay of a worker is the time since the first push of the round, the skew
+   *  of the round that of the last one
+   * \param arrived the number of pushes of the round arrived so far
+   */
+  void CountArrival(int key, int sender, size_t arrived) {
+    const uint64_t now = NowNs();
+    const int rank = ps::Postoffice::Get()->IDtoRank(sender);
+    std::lock_guard<std::mutex> lock(stats_mu_);
+    if (arrived == 1) round_start_[key] = now;
+    const uint64_t delay = now - round_start_[key];
+    worker_stats_[rank].delay_ns += delay;
+    if (arrived == (size_t)ps::NumWorkers()) {
+      round_skew_.Add(delay);
+      ++worker_stats_[rank].last_arrivals;
+    }
+  }
+
+  /**
+   * \return the counters as json, the bytes and the arrivals of each worker,
+   *  the histograms of the skew of the sync rounds and of the update times
+   * \param reset whether to reset the counters after
+   */
+  std::string GetStats(bool reset) {
+    std::ostringstream os;
+    std::lock_guard<std::mutex> lock(stats_mu_);
+    os << "{\"rank\": " << ps::MyRank() << ", \"workers\": [";
+    for (auto it = worker_stats_.begin(); it != worker_stats_.end(); ++it) {
+      os << (it == worker_stats_.begin() ? "" : ", ")
+         << "{\"rank\": " << it->first
+         << ", \"push_bytes\": " << it->second.push_bytes
+         << ", \"pull_bytes\": " << it->second.pull_bytes
+         << ", \"delay_s\": " << it->second.delay_ns * 1e-9
+         << ", \"last_arrivals\": " << it->second.last_arrivals << "}";
+    }
+    os << "], \"round_skew\": ";
+    round_skew_.Dump(&os);
+    os << ", \"update_time\": ";
+    update_time_.Dump(&os);
+    os << "}";
+    if (reset) {
+      worker_stats_.clear();
+      round_skew_.Reset();
+      update_time_.Reset();
+    }
+    return os.str();
+  }
+
+  /**
+   * \return whether a worker is more than staleness_ pushes of a key ahead
+   *  of the slowest worker, called with clock_mu_ locked
+   */
+  bool TooStale(int key, int worker) {
+    std::vector<int>& clock = clocks_[key];
+    clock.resize(ps::NumWorkers(), 0);
+    return clock[worker] - *std::min_element(clock.begin(), clock.end()) > staleness_;
+  }
+
+  /**
+   * \return the values packed in float16 for a pull of kPullHalf
+   */
+  static ps::SArray<real_t> PackHalf(const ps::SArray<real_t>& vals) {
+    ps::SArray<real_t> packed(halfwire::PackedSize(vals.size()));
+    halfwire::Pack(vals.data(), vals.size(), packed.data());
+    return packed;
+  }
+
+  /**
+   * \brief advance the clock of a worker on a key, and answer the pulls of
+   *  the key which are no longer too stale by the published value
+   */
+  void Tick(int key, int worker, const ps::SArray<real_t>& vals,
+            ps::KVServer<real_t>* server) {
+    std::vector<std::pair<ps::KVMeta, ps::SArray<ps::Key> > > ready;
+    {
+      std::lock_guard<std::mutex> lock(clock_mu_);
+      std::vector<int>& clock = clocks_[key];
+      clock.resize(ps::NumWorkers(), 0);
+      ++clock[worker];
+      auto& blocked = blocked_pulls_[key];
+      for (size_t i = 0; i < blocked.size();) {
+        if (TooStale(key, ps::Postoffice::Get()->IDtoRank(blocked[i].first.sender))) {
+          ++i;
+        } else {
+          ready.push_back(blocked[i]);
+          blocked[i] = blocked.back();
+          blocked.pop_back();
+        }
+      }
+    }
+    for (const auto& pull : ready) {
+      ps::KVPairs<real_t> response;
+      response.keys = pull.second;
+      response.vals = pull.first.cmd == kPullHalf ? PackHalf(vals) : vals;
+      response.lens = {static_cast<int>(response.vals.size())};
+      CountBytes(pull.first, response.vals.size(), false);
+      server->Response(pull.first, response);
+    }
+  }
+
+  /**
+   * \brief push and pull of some rows of a key, one ps key per row. A push
+   *  applies the updater to the pushed rows only, merged over the workers in
+   *  sync mode.
+   */
+  void RowSparseHandle(const ps::KVMeta& req_meta,
+                       const ps::KVPairs<real_t>& req_data,
+                       ps::KVServer<real_t>* server) {
+    int key = 0;
+    std::vector<uint32_t> rows(req_data.keys.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+      int k;
+      CHECK(DecodeRowSparseKey(req_data.keys[i], &k, &rows[i]));
+      CHECK(i == 0 || k == key) << "row sparse request of several keys";
+      key = k;
+    }
+    auto& stored = store_[key];
+    CHECK(!stored.is_none()) << "init " << key << " first";
+    const size_t row_len = row_len_[key];
+    const size_t nrow = stored.shape()[0] / row_len;
+    for (uint32_t r : rows) CHECK_LT(r, nrow) << "row out of range";
+
+    if (!req_meta.push) {
       ps::KVPairs<real_t> response;
-      CHECK(!stored.is_none()) << "init " << key << " first";
-      int len = stored.shape()[0];
       response.keys = req_data.keys;
-      response.lens = {len};
-      response.vals.CopyFrom(static_cast<const float*>(stored.data().dptr_), len);
+      for (size_t i = 0; i < rows.size(); ++i) response.lens.push_back(row_len);
+      response.vals.resize(rows.size() * row_len);
+      ps::SArray<real_t> snapshot;
+      {
+        std::lock_guard<std::mutex> lock(snapshot_mu_);
+        snapshot = snapshots_[key].vals;
+      }
+      const real_t* src = snapshot.data();
+      for (size_t i = 0; i < rows.size(); ++i) {
+        std::copy(src + rows[i] * row_len, src + (rows[i] + 1) * row_len,
+                  response.vals.data() + i * row_len);
+      }
+      CountBytes(req_meta, response.vals.size(), false);
       server->Response(req_meta, response);
+      return;
+    }
+    CHECK_EQ(req_data.vals.size(), rows.size() * row_len);
+    const real_t* recved = req_data.vals.data();
+    if (!sync_mode_) {
+      UpdateRows(key, rows, recved, row_len, &stored);
+      Publish(key, stored, {req_meta}, server);
+      return;
+    }
+    // synced push, sum the rows over the workers
+    auto& merged = sparse_merge_buf_[key];
+    if (merged.array.is_none()) {
+      merged.array = NDArray(stored.shape(), Context());
+      merged.touched.resize(nrow, false);
+    }
+    real_t* acc = static_cast<real_t*>(merged.array.data().dptr_);
+    for (size_t i = 0; i < rows.size(); ++i) {
+      real_t* dst = acc + rows[i] * row_len;
+      const real_t* src = recved + i * row_len;
+      if (merged.touched[rows[i]]) {
+        for (size_t j = 0; j < row_len; ++j) dst[j] += src[j];
+      } else {
+        std::copy(src, src + row_len, dst);
+        merged.touched[rows[i]] = true;
+        merged.rows.push_back(rows[i]);
+      }
+    }
+    merged.request.push_back(req_meta);
+    CountArrival(key, req_meta.sender, merged.request.size());
+    if (merged.request.size() == (size_t)ps::NumWorkers()) {
+      std::sort(merged.rows.begin(), merged.rows.end());
+      std::vector<real_t> grad(merged.rows.size() * row_len);
+      for (size_t i = 0; i < merged.rows.size(); ++i) {
+        std::copy(acc + merged.rows[i] * row_len, acc + (merged.rows[i] + 1) * row_len,
+                  grad.data() + i * row_len);
+        merged.touched[merged.rows[i]] = false;
+      }
+      UpdateRows(key, merged.rows, grad.data(), row_len, &stored);
+      Publish(key, stored, merged.request, server);
+      merged.request.clear();
+      merged.rows.clear();
+    }
+  }
+
+  /**
+   * \brief apply the updater to some rows of a stored value, the rows are
+   *  gathered and scattered back by engine operations. The native optimizer
+   *  updates the rows of the stored value in place, with its states.
+   * \param grad the gradient of the rows
+   */
+  void UpdateRows(int key, const std::vector<uint32_t>& rows, const real_t* grad,
+                  size_t row_len, NDArray* stored) {
+    if (rows.empty()) return;
+    TShape shape = mshadow::Shape2(rows.size(), row_len);
+    NDArray recved(shape, Context());
+    std::copy(grad, grad + rows.size() * row_len, static_cast<real_t*>(recved.data().dptr_));
+    NDArray value = *stored;
+    if (optimizer_ != nullptr) {
+      NDArray row_ids(mshadow::Shape1(rows.size()), Context());
+      std::copy(rows.begin(), rows.end(), static_cast<real_t*>(row_ids.data().dptr_));
+      NDArray matrix = value.Reshape(mshadow::Shape2(value.shape().Size() / row_len, row_len));
+      optimizer_->UpdateRowSparse(key, &matrix, row_ids, &recved, lr_, wd_);
+      return;
     }
+    NDArray weight(shape, Context());
+    Engine::Get()->PushSync([value, weight, rows, row_len](RunContext ctx) {
+        const real_t* src = static_cast<const real_t*>(value.data().dptr_);
+        real_t* w = static_cast<real_t*>(weight.data().dptr_);
+        for (size_t i = 0; i < rows.size(); ++i) {
+          std::copy(src + rows[i] * row_len, src + (rows[i] + 1) * row_len, w + i * row_len);
+        }
+      }, value.ctx(), {value.var()}, {weight.var()}, FnProperty::kNormal);
+    ApplyUpdate(key, recved, &weight);
+    Engine::Get()->PushSync([value, weight, rows, row_len](RunContext ctx) {
+        const real_t* w = static_cast<const real_t*>(weight.data().dptr_);
+        real_t* dst = static_cast<real_t*>(value.data().dptr_);
+        for (size_t i = 0; i < rows.size(); ++i) {
+          std::copy(w + i * row_len, w + (i + 1) * row_len, dst + rows[i] * row_len);
+        }
+      }, value.ctx(), {weight.var()}, {value.var()}, FnProperty::kNormal);
   }
 
   int DecodeKey(ps::Key key) {
@@ -217,20 +818,137 @@ class KVStoreDistServer {
     return key - kr.begin();
   }
 
+  /**
+   * \brief decode the ps key of a row, see KVStoreDist::EncodeRowSparseKeys
+   * \return false if it is the key of a dense value
+   */
+  bool DecodeRowSparseKey(ps::Key ps_key, int* key, uint32_t* row) {
+    auto kr = ps::Postoffice::Get()->GetServerKeyRanges()[ps::MyRank()];
+    ps::Key k = ps_key - kr.begin();
+    if ((k >> 32) == 0) return false;
+    *key = static_cast<int>((k >> 32) - 1);
+    *row = static_cast<uint32_t>(k & 0xffffffff);
+    return true;
+  }
+
   /**
    * \brief user defined
    */
   bool sync_mode_;
+  GradientCompression compression_;
   KVStore::Controller controller_;
   KVStore::Updater updater_;
+  /**
+   * \brief the native optimizer, its body, learning rate and weight decay
+   */
+  std::unique_ptr<Optimizer> optimizer_;
+  std::string optimizer_body_;
+  float lr_, wd_;
 
   std::unordered_map<int, NDArray> store_;
 
+  /**
+   * \brief the value of a key given to the pulls, replaced but never
+   *  modified by the engine operations of \ref Publish
+   */
+  struct Snapshot {
+    ps::SArray<real_t> vals;
+    uint64_t version = 0;
+  };
+  std::unordered_map<int, Snapshot> snapshots_;
+  /**
+   * \brief the pulls ahead of the update waiting for the publication of their
+   *  version, guarded by snapshot_mu_
+   */
+  std::unordered_map<int, std::vector<std::pair<ps::KVMeta, ps::SArray<ps::Key> > > >
+      ahead_pulls_;
+  std::mutex snapshot_mu_;
+  /**
+   * \brief the staleness bound of the async mode, -1 if unbounded
+   */
+  int staleness_;
+  /**
+   * \brief the number of published pushes of each worker on each key, and
+   *  the pulls waiting for the slowest workers
+   */
+  std::unordered_map<int, std::vector<int> > clocks_;
+  std::unordered_map<int, std::vector<std::pair<ps::KVMeta, ps::SArray<ps::Key> > > >
+      blocked_pulls_;
+  std::mutex clock_mu_;
+  /**
+   * \brief the number of publications of each key
+   */
+  std::unordered_map<int, uint64_t> version_;
+
   struct MergeBuf {
     std::vector<ps::KVMeta> request;
     NDArray array;
   };
   std::unordered_map<int, MergeBuf> merge_buf_;
+  /**
+   * \brief the buffer receiving the pushes of each key
+   */
+  std::unordered_map<int, NDArray> recv_buf_;
+  /**
+   * \brief the keys left to publish of the fused push requests, by sender and timestamp
+   */
+  std::map<std::pair<int, int>, size_t> fused_pending_;
+  std::mutex fused_mu_;
+
+  /**
+   * \brief the rows merged over the workers of a key in sync mode
+   */
+  struct SparseMergeBuf {
+    std::vector<ps::KVMeta> request;
+    NDArray array;
+    std::vector<bool> touched;
+    std::vector<uint32_t> rows;
+  };
+  std::unordered_map<int, SparseMergeBuf> sparse_merge_buf_;
+  /**
+   * \brief the row length of each key, given by its initialization
+   */
+  std::unordered_map<int, size_t> row_len_;
+  /**
+   * \brief the next part and the current epoch of each dataset read with
+   *  dynamic parts
+   */
+  std::unordered_map<std::string, int> next_part_, part_epoch_;
+  std::mutex part_mu_;
+  /**
+   * \brief the costs of the servers measured by worker 0, see
+   *  KVStoreDist::MeasureServerCost
+   */
+  std::string partition_cost_;
+  /**
+   * \brief the name prefixes of the shared memory regions of the workers on
+   *  this host by sender, and the regions of their pushes by sender and ps key
+   */
+  std::unordered_map<int, std::string> shm_prefix_;
+  std::mutex shm_mu_;
+  std::map<std::pair<int, ps::Key>, NDArray> shm_arrays_;
+  /**
+   * \brief the counters of a worker, the bytes of its requests and responses,
+   *  the sum of its arrival delays in the sync rounds, and the number of the
+   *  rounds it arrived last in
+   */
+  struct WorkerStats {
+    uint64_t push_bytes = 0;
+    uint64_t pull_bytes = 0;
+    uint64_t delay_ns = 0;
+    uint64_t last_arrivals = 0;
+  };
+  std::map<int, WorkerStats> worker_stats_;
+  /**
+   * \brief the time of the first push of the current sync round of each key
+   */
+  std::unordered_map<int, uint64_t> round_start_;
+  DurationHistogram round_skew_, update_time_;
+  /**
+   * \brief the time of the last log of the counters
+   */
+  uint64_t stats_log_ns_ = 0;
+  std::mutex stats_mu_;
 
   Executor exec_;
 
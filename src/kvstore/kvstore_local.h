@@ -9,9 +9,11 @@
 #include <mxnet/kvstore.h>
 #include <unordered_map>
 #include <bitset>
+#include <memory>
 #include <vector>
 #include <utility>
 #include <algorithm>
+#include "./reduce_sum.h"
 
 namespace mxnet {
 namespace kvstore {
@@ -77,7 +79,63 @@ class KVStoreLocal : public KVStore {
     }
   }
 
+  void PushRowSparse(const std::vector<int>& keys,
+                     const std::vector<NDArray>& row_ids,
+                     const std::vector<NDArray>& values,
+                     int priority) override {
+    CHECK_EQ(keys.size(), row_ids.size());
+    std::vector<RowSparse> pairs;
+    for (size_t i = 0; i < keys.size(); ++i) pairs.push_back({row_ids[i], values[i]});
+    std::vector<int> uniq_keys;
+    std::vector<std::vector<RowSparse> > grouped_vals;
+    GroupKVPairs(keys, pairs, &uniq_keys, &grouped_vals);
+
+    for (size_t i = 0; i < uniq_keys.size(); ++i) {
+      int key = uniq_keys[i];
+      auto it = local_.find(key);
+      CHECK(it != local_.end()) << "key " << key << " has not been inited";
+      NDArray& stored = it->second;
+      std::shared_ptr<std::vector<uint32_t> > rows;
+      NDArray merged = MergeRowSparse(grouped_vals[i], stored.shape()[0], &rows, priority);
+      if (merged.is_none()) continue;
+      if (updater_ != nullptr) {
+        // update the touched rows only
+        NDArray weight(merged.shape(), pinned_ctx_);
+        GatherRows(stored, rows, weight, priority);
+        updater_(key, merged, &weight);
+        ScatterRows(weight, rows, stored, priority);
+      } else {
+        ScatterRows(merged, rows, stored, priority);
+      }
+    }
+  }
+
+  void PullRowSparse(const std::vector<int>& keys,
+                     const std::vector<NDArray>& row_ids,
+                     const std::vector<NDArray*>& values,
+                     int priority) override {
+    CHECK_EQ(keys.size(), row_ids.size());
+    CHECK_EQ(keys.size(), values.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      auto it = local_.find(keys[i]);
+      CHECK(it != local_.end()) << "key " << keys[i] << " has not been inited";
+      const NDArray& stored = it->second;
+      auto rows = std::make_shared<std::vector<uint32_t> >(
+          ReadRowIds(row_ids[i], stored.shape()[0]));
+      CHECK_EQ(values[i]->shape()[0], rows->size()) << "wrong number of rows to pull";
+      if (values[i]->ctx().dev_mask() == cpu::kDevMask) {
+        GatherRows(stored, rows, *values[i], priority);
+      } else {
+        NDArray buf(values[i]->shape(), pinned_ctx_);
+        GatherRows(stored, rows, buf, priority);
+        CopyFromTo(buf, values[i], priority);
+      }
+    }
+  }
+
  protected:
+  /*! \brief row indices and rows of a row sparse value */
+  using RowSparse = std::pair<NDArray, NDArray>;
   /// \brief temperal space for pushing and pull
   struct BufferEntry {
     // Context of merged
@@ -92,6 +150,7 @@ class KVStoreLocal : public KVStore {
     inline NDArray *AllocCopyBuf(size_t index, Context ctx, const TShape& shape) {
       if (index >= copy_buf.size()) copy_buf.resize(index + 1);
       if (copy_buf[index].is_none()) {
+        Storage::AllocOriginScope origin("kvstore");
         copy_buf[index] = NDArray(shape, ctx);
       }
       return &copy_buf[index];
@@ -140,6 +199,7 @@ class KVStoreLocal : public KVStore {
     if (buf.merged.is_none()) {
       buf.ctx = Context::CPUPinned(val[0].ctx().dev_id);
       if (MXNET_USE_CUDA == 0) buf.ctx = Context::CPU();
+      Storage::AllocOriginScope origin("kvstore");
       buf.merged = NDArray(val[0].shape(), buf.ctx);
     }
 
@@ -177,6 +237,108 @@ class KVStoreLocal : public KVStore {
     }
   }
 
+  /*!
+   * \brief read the row indices of a row sparse value, waiting for them
+   * \param nrow the number of rows of the key
+   */
+  static std::vector<uint32_t> ReadRowIds(const NDArray& row_ids, size_t nrow) {
+    CHECK_EQ(row_ids.ctx().dev_mask(), cpu::kDevMask) << "row ids must be on cpu";
+    CHECK_EQ(row_ids.dtype(), mshadow::default_type_flag) << "row ids must be float32";
+    CHECK_EQ(row_ids.shape().ndim(), 1) << "row ids must be one-dimensional";
+    row_ids.WaitToRead();
+    const real_t* ids = static_cast<const real_t*>(row_ids.data().dptr_);
+    std::vector<uint32_t> rows(row_ids.shape()[0]);
+    for (size_t i = 0; i < rows.size(); ++i) {
+      CHECK(ids[i] >= 0 && ids[i] < nrow) << "row id " << ids[i] << " out of range";
+      rows[i] = static_cast<uint32_t>(ids[i]);
+      CHECK(i == 0 || rows[i] > rows[i - 1]) << "row ids must be sorted and unique";
+    }
+    return rows;
+  }
+  /*!
+   * \brief sum row sparse values over devices, into the rows of their union
+   * \param nrow the number of rows of the key
+   * \param rows set to the sorted union of the row indices
+   * \return the summed rows in pinned memory, none if there is no row
+   */
+  NDArray MergeRowSparse(const std::vector<RowSparse>& vals, size_t nrow,
+                         std::shared_ptr<std::vector<uint32_t> >* rows, int priority) {
+    std::vector<std::vector<uint32_t> > ids(vals.size());
+    *rows = std::make_shared<std::vector<uint32_t> >();
+    for (size_t i = 0; i < vals.size(); ++i) {
+      ids[i] = ReadRowIds(vals[i].first, nrow);
+      CHECK_EQ(vals[i].second.shape()[0], ids[i].size()) << "wrong number of pushed rows";
+      CHECK_EQ(vals[i].second.dtype(), mshadow::default_type_flag);
+      (*rows)->insert((*rows)->end(), ids[i].begin(), ids[i].end());
+    }
+    std::sort((*rows)->begin(), (*rows)->end());
+    (*rows)->erase(std::unique((*rows)->begin(), (*rows)->end()), (*rows)->end());
+    if ((*rows)->empty()) return NDArray();
+    // position of the rows of each value in the union
+    auto pos = std::make_shared<std::vector<std::vector<uint32_t> > >(vals.size());
+    std::vector<NDArray> src(vals.size());
+    std::vector<Engine::VarHandle> const_vars(vals.size());
+    for (size_t i = 0; i < vals.size(); ++i) {
+      for (uint32_t r : ids[i]) {
+        (*pos)[i].push_back(std::lower_bound((*rows)->begin(), (*rows)->end(), r) -
+                            (*rows)->begin());
+      }
+      src[i] = vals[i].second;
+      if (src[i].ctx().dev_mask() != cpu::kDevMask) {
+        src[i] = NDArray(vals[i].second.shape(), pinned_ctx_);
+        CopyFromTo(vals[i].second, &src[i], priority);
+      }
+      const_vars[i] = src[i].var();
+    }
+    TShape shape = vals[0].second.shape();
+    shape[0] = (*rows)->size();
+    NDArray merged(shape, pinned_ctx_);
+    Engine::Get()->PushSync([merged, src, pos](RunContext rctx) {
+        real_t* dst = static_cast<real_t*>(merged.data().dptr_);
+        const size_t row_len = merged.shape().Size() / merged.shape()[0];
+        std::fill(dst, dst + merged.shape().Size(), 0.0f);
+        for (size_t i = 0; i < src.size(); ++i) {
+          const real_t* val = static_cast<const real_t*>(src[i].data().dptr_);
+          for (size_t j = 0; j < (*pos)[i].size(); ++j) {
+            real_t* out = dst + (*pos)[i][j] * row_len;
+            for (size_t k = 0; k < row_len; ++k) out[k] += val[j * row_len + k];
+          }
+        }
+      }, Context::CPU(), const_vars, {merged.var()},
+      FnProperty::kCPUPrioritized, priority);
+    return merged;
+  }
+  /*! \brief out = dense[rows], both on cpu */
+  static void GatherRows(const NDArray& dense,
+                         const std::shared_ptr<std::vector<uint32_t> >& rows,
+                         NDArray out, int priority) {
+    Engine::Get()->PushSync([dense, rows, out](RunContext rctx) {
+        const real_t* src = static_cast<const real_t*>(dense.data().dptr_);
+        real_t* dst = static_cast<real_t*>(out.data().dptr_);
+        const size_t row_len = dense.shape().Size() / dense.shape()[0];
+        for (size_t j = 0; j < rows->size(); ++j) {
+          std::copy(src + (*rows)[j] * row_len, src + ((*rows)[j] + 1) * row_len,
+                    dst + j * row_len);
+        }
+      }, Context::CPU(), {dense.var()}, {out.var()},
+      FnProperty::kCPUPrioritized, priority);
+  }
+  /*! \brief dense[rows] = src, both on cpu */
+  static void ScatterRows(const NDArray& src,
+                          const std::shared_ptr<std::vector<uint32_t> >& rows,
+                          NDArray dense, int priority) {
+    Engine::Get()->PushSync([src, rows, dense](RunContext rctx) {
+        const real_t* val = static_cast<const real_t*>(src.data().dptr_);
+        real_t* dst = static_cast<real_t*>(dense.data().dptr_);
+        const size_t row_len = dense.shape().Size() / dense.shape()[0];
+        for (size_t j = 0; j < rows->size(); ++j) {
+          std::copy(val + j * row_len, val + (j + 1) * row_len,
+                    dst + (*rows)[j] * row_len);
+        }
+      }, Context::CPU(), {src.var()}, {dense.var()},
+      FnProperty::kCPUPrioritized, priority);
+  }
+
   /// \brief buffer for merging push value
   std::unordered_map<int, BufferEntry> merge_buf_;
   // pinned context
@@ -185,37 +347,6 @@ class KVStoreLocal : public KVStore {
   size_t bigarray_bound_;
 
  private:
-  inline static void ReduceSumCPU(const std::vector<real_t*> &dptr,
-                                  size_t offset, index_t size) {
-    using namespace mshadow;  // NOLINT(*)
-    Tensor<cpu, 1> in_0(dptr[0] + offset, Shape1(size));
-    switch (dptr.size()) {
-      case 2: {
-        Tensor<cpu, 1> in_1(dptr[1] + offset, Shape1(size));
-        in_0 += in_1;
-        break;
-      }
-      case 3: {
-        Tensor<cpu, 1> in_1(dptr[1] + offset, Shape1(size));
-        Tensor<cpu, 1> in_2(dptr[2] + offset, Shape1(size));
-        in_0 += in_1 + in_2;
-        break;
-      }
-      case 4: {
-        Tensor<cpu, 1> in_1(dptr[1] + offset, Shape1(size));
-        Tensor<cpu, 1> in_2(dptr[2] + offset, Shape1(size));
-        Tensor<cpu, 1> in_3(dptr[3] + offset, Shape1(size));
-        in_0 += in_1 + in_2 + in_3;
-        break;
-      }
-      default: {
-        for (size_t i = 1; i < dptr.size(); ++i) {
-          Tensor<cpu, 1> in_k(dptr[i] + offset, Shape1(size));
-          in_0 += in_k;
-        }
-      }
-    }
-  }
   // reduce sum into val[0]
   // this is performance critical
   inline void ReduceSumCPU(const std::vector<NDArray> &in_data) {
@@ -229,8 +360,9 @@ class KVStoreLocal : public KVStore {
     }
     size_t total = in_data[0].shape().Size();
     long ntask = (total + step - 1) / step; // NOLINT(*)
+    const bool stream = total * sizeof(real_t) >= reduce::kStreamBytes;
     if (total < bigarray_bound_ || nthread_reduction_ <= 1) {
-      ReduceSumCPU(dptr, 0, total);
+      reduce::Sum(dptr, 0, total, stream);
     } else {
       #pragma omp parallel for schedule(static) num_threads(nthread_reduction_)
       for (long j = 0; j < ntask; ++j) { // NOLINT(*)
@@ -238,7 +370,7 @@ class KVStoreLocal : public KVStore {
         size_t begin = std::min(k * step, total);
         size_t end = std::min((k + 1) * step, total);
         if (j == ntask - 1) CHECK_EQ(end, total);
-        ReduceSumCPU(dptr, begin, static_cast<index_t>(end - begin));
+        reduce::Sum(dptr, begin, end - begin, stream);
       }
     }
   }
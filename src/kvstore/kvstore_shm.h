@@ -0,0 +1,87 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file kvstore_shm.h
+ * \brief named shared memory regions of the host, for the pushes between a worker
+ *  and a server on the same host and the arrays handed between processes
+ */
+#ifndef MXNET_KVSTORE_KVSTORE_SHM_H_
+#define MXNET_KVSTORE_KVSTORE_SHM_H_
+#include <dmlc/logging.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+namespace mxnet {
+namespace kvstore {
+
+/*!
+ * \brief a named POSIX shared memory region, mapped as long as the object
+ *  lives. The creator unlinks the name when destroyed, the region itself is
+ *  freed once unmapped by all the processes.
+ */
+class SharedRegion {
+ public:
+  /*!
+   * \brief create a region, replacing any region of the same name
+   * \param name the name, starting with a slash
+   * \param bytes the size
+   */
+  static SharedRegion* Create(const std::string& name, size_t bytes) {
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    CHECK_GE(fd, 0) << "shm_open " << name << ": " << strerror(errno);
+    if (ftruncate(fd, bytes) != 0) {
+      close(fd);
+      shm_unlink(name.c_str());
+      LOG(FATAL) << "ftruncate " << name << ": " << strerror(errno);
+    }
+    return new SharedRegion(name, fd, bytes, true);
+  }
+  /*!
+   * \brief open a region created by another process
+   * \return nullptr if there is no region of the name and size
+   */
+  static SharedRegion* Open(const std::string& name, size_t bytes) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != bytes) {
+      close(fd);
+      return nullptr;
+    }
+    return new SharedRegion(name, fd, bytes, false);
+  }
+  ~SharedRegion() {
+    munmap(data_, bytes_);
+    if (owner_) shm_unlink(name_.c_str());
+  }
+  inline void* data() const {
+    return data_;
+  }
+  inline size_t bytes() const {
+    return bytes_;
+  }
+
+ private:
+  SharedRegion(const std::string& name, int fd, size_t bytes, bool owner)
+      : name_(name), bytes_(bytes), owner_(owner) {
+    data_ = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data_ == MAP_FAILED) {
+      if (owner_) shm_unlink(name_.c_str());
+      LOG(FATAL) << "mmap " << name_ << ": " << strerror(errno);
+    }
+  }
+  std::string name_;
+  void* data_;
+  size_t bytes_;
+  bool owner_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_KVSTORE_SHM_H_
@@ -0,0 +1,81 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file kvstore_stats.h
+ * \brief counters of the communication of the distributed kvstore
+ */
+#ifndef MXNET_KVSTORE_KVSTORE_STATS_H_
+#define MXNET_KVSTORE_KVSTORE_STATS_H_
+#include <dmlc/parameter.h>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace mxnet {
+namespace kvstore {
+
+/*!
+ * \brief histogram of durations, bucket i counts the durations of [2^(i-1), 2^i)
+ *  microseconds, bucket 0 those below 1 microsecond
+ */
+class DurationHistogram {
+ public:
+  static const int kNumBuckets = 32;
+  DurationHistogram() : counts_(kNumBuckets, 0) {}
+  /*! \brief add a duration in nanoseconds */
+  inline void Add(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    int b = 0;
+    while (us != 0 && b < kNumBuckets - 1) {
+      us >>= 1;
+      ++b;
+    }
+    ++counts_[b];
+    ++count_;
+    total_ns_ += ns;
+  }
+  inline void Reset() {
+    counts_.assign(kNumBuckets, 0);
+    count_ = total_ns_ = 0;
+  }
+  /*!
+   * \brief write as json, the count, the total in seconds, and the counts of the
+   *  buckets by their upper bound in microseconds, without the trailing empty ones
+   */
+  inline void Dump(std::ostream* os) const {
+    int last = kNumBuckets - 1;
+    while (last > 0 && counts_[last] == 0) --last;
+    *os << "{\"count\": " << count_ << ", \"total_s\": " << total_ns_ * 1e-9
+        << ", \"buckets_us\": [";
+    for (int b = 0; b <= last; ++b) {
+      *os << (b == 0 ? "" : ", ") << "[" << (1ULL << b) << ", " << counts_[b] << "]";
+    }
+    *os << "]}";
+  }
+
+ private:
+  std::vector<uint64_t> counts_;
+  uint64_t count_ = 0;
+  uint64_t total_ns_ = 0;
+};
+
+/*! \return the nanoseconds of a steady clock */
+inline uint64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*! \brief whether to log the counters now, every MXNET_KVSTORE_STATS_INTERVAL seconds */
+inline bool StatsLogDue(uint64_t* last_log_ns) {
+  static const double interval = dmlc::GetEnv("MXNET_KVSTORE_STATS_INTERVAL", 0.0);
+  if (interval <= 0) return false;
+  const uint64_t now = NowNs();
+  if (*last_log_ns == 0) *last_log_ns = now;
+  if (now - *last_log_ns < interval * 1e9) return false;
+  *last_log_ns = now;
+  return true;
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_KVSTORE_STATS_H_
@@ -0,0 +1,126 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file reduce_sum.h
+ * \brief vectorized sum of several arrays into the first one on cpu.
+ *
+ *  The vector width is chosen at compile time, AVX-512 with -mavx512f, AVX
+ *  with -mavx or -mavx2, SSE otherwise, e.g. build with ADD_CFLAGS=-march=native.
+ */
+#ifndef MXNET_KVSTORE_REDUCE_SUM_H_
+#define MXNET_KVSTORE_REDUCE_SUM_H_
+
+#include <mxnet/base.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace mxnet {
+namespace kvstore {
+namespace reduce {
+/*! \brief the number of sources added to the destination in one pass */
+const size_t kMaxSources = 7;
+/*! \brief the minimum number of bytes of an array to store its sum past the caches */
+const size_t kStreamBytes = 16 << 20;
+
+#if defined(__AVX512F__)
+const size_t kWidth = 16;
+typedef __m512 Packet;
+inline Packet Load(const float *p) { return _mm512_loadu_ps(p); }
+inline Packet Add(Packet a, Packet b) { return _mm512_add_ps(a, b); }
+inline void Store(float *p, Packet a) { _mm512_storeu_ps(p, a); }
+inline void Stream(float *p, Packet a) { _mm512_stream_ps(p, a); }
+#elif defined(__AVX__)
+const size_t kWidth = 8;
+typedef __m256 Packet;
+inline Packet Load(const float *p) { return _mm256_loadu_ps(p); }
+inline Packet Add(Packet a, Packet b) { return _mm256_add_ps(a, b); }
+inline void Store(float *p, Packet a) { _mm256_storeu_ps(p, a); }
+inline void Stream(float *p, Packet a) { _mm256_stream_ps(p, a); }
+#elif defined(__SSE2__)
+const size_t kWidth = 4;
+typedef __m128 Packet;
+inline Packet Load(const float *p) { return _mm_loadu_ps(p); }
+inline Packet Add(Packet a, Packet b) { return _mm_add_ps(a, b); }
+inline void Store(float *p, Packet a) { _mm_storeu_ps(p, a); }
+inline void Stream(float *p, Packet a) { _mm_stream_ps(p, a); }
+#else
+const size_t kWidth = 0;
+#endif
+
+/*!
+ * \brief dst[i] += src[0][i] + ... + src[K - 1][i], the sources are kept in
+ *  registers so that dst is read and written once
+ * \param stream whether to write dst with non temporal stores
+ */
+template<int K, typename DType>
+inline void AddSources(DType *dst, const DType *const *src, size_t size, bool stream) {
+  for (size_t i = 0; i < size; ++i) {
+    DType acc = dst[i];
+    for (int j = 0; j < K; ++j) acc += src[j][i];
+    dst[i] = acc;
+  }
+}
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+template<int K>
+inline void AddSources(float *dst, const float *const *src, size_t size, bool stream) {
+  size_t i = 0;
+  if (stream) {
+    // the non temporal stores need dst aligned to the vector width
+    for (; i < size && reinterpret_cast<uintptr_t>(dst + i) % (kWidth * sizeof(float)) != 0;
+         ++i) {
+      for (int j = 0; j < K; ++j) dst[i] += src[j][i];
+    }
+    for (; i + kWidth <= size; i += kWidth) {
+      Packet acc = Load(dst + i);
+      for (int j = 0; j < K; ++j) acc = Add(acc, Load(src[j] + i));
+      Stream(dst + i, acc);
+    }
+    _mm_sfence();
+  } else {
+    for (; i + kWidth <= size; i += kWidth) {
+      Packet acc = Load(dst + i);
+      for (int j = 0; j < K; ++j) acc = Add(acc, Load(src[j] + i));
+      Store(dst + i, acc);
+    }
+  }
+  for (; i < size; ++i) {
+    float acc = dst[i];
+    for (int j = 0; j < K; ++j) acc += src[j][i];
+    dst[i] = acc;
+  }
+}
+#endif
+
+/*!
+ * \brief dptr[0][offset, offset + size) += the same range of dptr[1], ...
+ *  in passes of up to kMaxSources sources
+ * \param stream whether the last pass writes with non temporal stores, for
+ *  arrays much bigger than the caches
+ */
+inline void Sum(const std::vector<real_t*> &dptr, size_t offset, size_t size, bool stream) {
+  real_t *dst = dptr[0] + offset;
+  const real_t *src[kMaxSources];
+  for (size_t first = 1; first < dptr.size(); first += kMaxSources) {
+    const size_t k = std::min(kMaxSources, dptr.size() - first);
+    for (size_t j = 0; j < k; ++j) src[j] = dptr[first + j] + offset;
+    // the other passes are read back by the next one
+    const bool last = stream && first + k == dptr.size();
+    switch (k) {
+      case 1: AddSources<1>(dst, src, size, last); break;
+      case 2: AddSources<2>(dst, src, size, last); break;
+      case 3: AddSources<3>(dst, src, size, last); break;
+      case 4: AddSources<4>(dst, src, size, last); break;
+      case 5: AddSources<5>(dst, src, size, last); break;
+      case 6: AddSources<6>(dst, src, size, last); break;
+      default: AddSources<7>(dst, src, size, last); break;
+    }
+  }
+}
+}  // namespace reduce
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_REDUCE_SUM_H_
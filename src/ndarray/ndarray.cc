@@ -5,12 +5,29 @@
  */
 #include <dmlc/io.h>
 #include <dmlc/logging.h>
+#include <dmlc/memory_io.h>
 #include <dmlc/registry.h>
 #include <mxnet/base.h>
 #include <mxnet/ndarray.h>
 #include <mxnet/resource.h>
 #include <mshadow/tensor.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
 #include "./ndarray_function.h"
+#include "../common/cuda_utils.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #if MXNET_USE_OPENCV
 #include <opencv2/opencv.hpp>
@@ -75,8 +92,8 @@ void TernaryOp(const NDArray &lhs,
       ret.CheckAndAlloc();
       TBlob tmp = ret.data();
       ndarray::Eval<gpu, OP>(lhs.data(), mhs.data(), rhs.data(), &tmp, ctx);
-      // Wait GPU kernel to complete
-      ctx.get_stream<gpu>()->Wait();
+      // Wait GPU kernel to complete, or order the dependents after it
+      Engine::Get()->WaitForStream(ctx);
     }, lhs.ctx(), const_vars, { ret.var() });
     break;
   }
@@ -135,8 +152,8 @@ void BinaryOp(const NDArray &lhs,
           ret.CheckAndAlloc();
           TBlob tmp = ret.data();
           ndarray::Eval<gpu, OP>(lhs.data(), rhs.data(), &tmp, ctx);
-          // Wait GPU kernel to complete
-          ctx.get_stream<gpu>()->Wait();
+          // Wait GPU kernel to complete, or order the dependents after it
+          Engine::Get()->WaitForStream(ctx);
         }, lhs.ctx(), const_vars, {ret.var()});
       break;
     }
@@ -164,8 +181,8 @@ void SetValueOp(const real_t &rhs, NDArray *out) {
           ret.CheckAndAlloc();
           TBlob tmp = ret.data();
           ndarray::Eval<gpu>(rhs, &tmp, ctx);
-          // Wait GPU kernel to complete
-          ctx.get_stream<gpu>()->Wait();
+          // Wait GPU kernel to complete, or order the dependents after it
+          Engine::Get()->WaitForStream(ctx);
         }, ret.ctx(), {}, {ret.var()});
       break;
     }
@@ -213,8 +230,8 @@ void ScalarOp(const NDArray &lhs,
           ret.CheckAndAlloc();
           TBlob tmp = ret.data();
           ndarray::Eval<gpu, OP, reverse>(lhs.data(), rhs, &tmp, ctx);
-          // Wait GPU kernel to complete
-          ctx.get_stream<gpu>()->Wait();
+          // Wait GPU kernel to complete, or order the dependents after it
+          Engine::Get()->WaitForStream(ctx);
         }, lhs.ctx(), const_vars, {ret.var()});
       break;
     }
@@ -223,6 +240,71 @@ void ScalarOp(const NDArray &lhs,
   }
 }
 
+NDArray NDArray::GrowStorage(size_t size) const {
+  CHECK(!is_none());
+  CHECK(!ptr_->static_data) << "GrowStorage: the storage is not owned by the array";
+  NDArray ret = *this;
+  ret.shape_ = mshadow::Shape1(size);
+  ret.offset_ = 0;
+  ret.stride_ = 0;
+  const size_t nbytes = size * mshadow::mshadow_sizeof(dtype_);
+  if (nbytes <= ptr_->shandle.size) return ret;
+  // the pending operations on the old storage complete before it is freed,
+  // the later ones are ordered after this by the variable.
+  this->WaitToWrite();
+  if (!ptr_->delay_alloc) Storage::Get()->Free(ptr_->shandle);
+  ptr_->shandle.size = nbytes;
+  ptr_->delay_alloc = true;
+  ptr_->CheckAndAlloc();
+  return ret;
+}
+
+#if MXNET_USE_CUDA
+/*!
+ * \brief completes the copies between gpus once their events are reached, so
+ *  that the copy workers issue the next copies while the previous are in flight
+ */
+class CopyEventWaiter {
+ public:
+  static CopyEventWaiter* Get() {
+    // never deleted, the engine may complete copies while shutting down
+    static CopyEventWaiter *inst = new CopyEventWaiter();
+    return inst;
+  }
+  /*!
+   * \brief call on_complete once the work recorded by event is done, then destroy event
+   */
+  void Push(cudaEvent_t event, Engine::CallbackOnComplete on_complete) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::make_pair(event, on_complete));
+    }
+    cond_.notify_one();
+  }
+
+ private:
+  CopyEventWaiter() {
+    std::thread([this]() {
+        while (true) {
+          std::pair<cudaEvent_t, Engine::CallbackOnComplete> item;
+          {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this]() { return !queue_.empty(); });
+            item = queue_.front();
+            queue_.pop_front();
+          }
+          CUDA_CALL(cudaEventSynchronize(item.first));
+          CUDA_CALL(cudaEventDestroy(item.first));
+          item.second();
+        }
+      }).detach();
+  }
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::pair<cudaEvent_t, Engine::CallbackOnComplete> > queue_;
+};
+#endif  // MXNET_USE_CUDA
+
 void CopyFromTo(const NDArray &from, NDArray *to, int priority) {
   CHECK(from.shape() == to->shape())
       << "operands shape mismatch";
@@ -266,6 +348,25 @@ void CopyFromTo(const NDArray &from, NDArray *to, int priority) {
           ctx.get_stream<gpu>()->Wait();
         }, from.ctx(), const_vars, {ret.var()},
         FnProperty::kCopyFromGPU, priority);
+    } else if (a == gpu::kDevMask && b == gpu::kDevMask &&
+               from.ctx().dev_id != ret.ctx().dev_id &&
+               Engine::Get()->SupportAsyncComplete()) {
+      // between gpus: over the peer to peer link when the topology allows, and the
+      // copy completes from an event instead of blocking the copy worker
+      common::cuda::EnablePeerAccess(from.ctx().dev_id, ret.ctx().dev_id);
+      Engine::Get()->PushAsync([from, ret](RunContext ctx,
+                                           Engine::CallbackOnComplete on_complete) {
+          ret.CheckAndAlloc();
+          TBlob tmp = ret.data();
+          ndarray::Copy<gpu, gpu>(from.data(), &tmp,
+                                  from.ctx(), ret.ctx(), ctx);
+          cudaEvent_t event;
+          CUDA_CALL(cudaEventCreateWithFlags(
+              &event, cudaEventDisableTiming | cudaEventBlockingSync));
+          CUDA_CALL(cudaEventRecord(event, ctx.get_stream<gpu>()->stream_));
+          CopyEventWaiter::Get()->Push(event, on_complete);
+        }, from.ctx(), const_vars, {ret.var()},
+        FnProperty::kCopyFromGPU, priority);
     } else if (a == gpu::kDevMask && b == gpu::kDevMask) {
       Engine::Get()->PushSync([from, ret](RunContext ctx) {
           ret.CheckAndAlloc();
@@ -329,10 +430,111 @@ void ElementwiseSum(const std::vector<NDArray> &source, NDArray *out, int priori
           ret.CheckAndAlloc();
           TBlob tmp = ret.data();
           ndarray::ElementwiseSum<gpu>(source_tblob, &tmp, ctx);
-          // Wait GPU kernel to complete
-          ctx.get_stream<gpu>()->Wait();
+          // Wait GPU kernel to complete, or order the dependents after it
+          Engine::Get()->WaitForStream(ctx);
         }, out->ctx(), const_vars, {ret.var()},
-        FnProperty::kNormal, priority);
+        FnProperty::kGPUPrioritized, priority);
+      break;
+    }
+#endif
+    default: LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+  }
+}
+
+// compile the postfix program of FusedElemwise
+ndarray::FusedProgram ParseFused(const std::string &program, size_t num_inputs,
+                                 const std::vector<real_t> &scalars) {
+  using ndarray::FusedProgram;
+  FusedProgram prog;
+  prog.size = 0;
+  std::istringstream is(program);
+  std::string token;
+  int depth = 0;
+  while (is >> token) {
+    CHECK_LT(prog.size, FusedProgram::kMaxInstr) << "fused program too long: " << program;
+    int8_t code, arg = 0;
+    if (token == "+") {
+      code = FusedProgram::kAdd;
+    } else if (token == "-") {
+      code = FusedProgram::kSub;
+    } else if (token == "*") {
+      code = FusedProgram::kMul;
+    } else if (token == "/") {
+      code = FusedProgram::kDiv;
+    } else {
+      CHECK(token.size() > 1 && (token[0] == 'i' || token[0] == 's'))
+          << "invalid token " << token << " in fused program " << program;
+      size_t index = std::stoul(token.substr(1));
+      if (token[0] == 'i') {
+        CHECK_LT(index, num_inputs) << "fused program " << program << " reads missing inputs";
+        code = FusedProgram::kInput;
+        arg = static_cast<int8_t>(index);
+      } else {
+        CHECK_LT(index, scalars.size()) << "fused program " << program << " reads missing scalars";
+        code = FusedProgram::kScalar;
+        arg = static_cast<int8_t>(prog.size);
+        prog.scalars[prog.size] = scalars[index];
+      }
+    }
+    if (code == FusedProgram::kInput || code == FusedProgram::kScalar) {
+      ++depth;
+      CHECK_LE(depth, FusedProgram::kMaxStack) << "fused program too deep: " << program;
+    } else {
+      CHECK_GE(depth, 2) << "missing operands in fused program " << program;
+      --depth;
+    }
+    prog.code[prog.size] = code;
+    prog.arg[prog.size] = arg;
+    ++prog.size;
+  }
+  CHECK_EQ(depth, 1) << "fused program " << program << " does not give one value";
+  return prog;
+}
+
+void FusedElemwise(const std::string &program,
+                   const std::vector<NDArray> &inputs,
+                   const std::vector<real_t> &scalars,
+                   NDArray *out) {
+  CHECK_LE(inputs.size(), static_cast<size_t>(ndarray::FusedProgram::kMaxInputs))
+      << "too many inputs of a fused program";
+  ndarray::FusedProgram prog = ParseFused(program, inputs.size(), scalars);
+  CHECK(!out->is_none() && out->is_contiguous() && out->dtype() == mshadow::kFloat32)
+      << "fused programs write contiguous float32 arrays";
+  std::vector<Engine::VarHandle> const_vars;
+  for (const NDArray &in : inputs) {
+    CHECK(in.is_contiguous() && in.dtype() == mshadow::kFloat32)
+        << "fused programs read contiguous float32 arrays";
+    CHECK_EQ(in.shape(), out->shape()) << "operands shape mismatch";
+    CHECK(in.ctx() == out->ctx()) << "operands context mismatch";
+    if (in.var() != out->var() &&
+        std::find(const_vars.begin(), const_vars.end(), in.var()) == const_vars.end()) {
+      const_vars.push_back(in.var());
+    }
+  }
+  // important: callback must always capture by value
+  NDArray ret = *out;
+  switch (out->ctx().dev_mask()) {
+    case cpu::kDevMask: {
+      Engine::Get()->PushSync([inputs, prog, ret](RunContext ctx) {
+          std::vector<TBlob> blobs(inputs.size());
+          for (size_t i = 0; i < inputs.size(); ++i) blobs[i] = inputs[i].data();
+          ret.CheckAndAlloc();
+          TBlob tmp = ret.data();
+          ndarray::EvalFused<cpu>(prog, blobs, &tmp, ctx);
+        }, out->ctx(), const_vars, {ret.var()}, FnProperty::kNormal, 0, "FusedElemwise");
+      break;
+    }
+#if MXNET_USE_CUDA
+    case gpu::kDevMask: {
+      Engine::Get()->PushSync([inputs, prog, ret](RunContext ctx) {
+          std::vector<TBlob> blobs(inputs.size());
+          for (size_t i = 0; i < inputs.size(); ++i) blobs[i] = inputs[i].data();
+          ret.CheckAndAlloc();
+          TBlob tmp = ret.data();
+          ndarray::EvalFused<gpu>(prog, blobs, &tmp, ctx);
+          // Wait GPU kernel to complete, or order the dependents after it
+          Engine::Get()->WaitForStream(ctx);
+        }, out->ctx(), const_vars, {ret.var()}, FnProperty::kNormal, 0, "FusedElemwise");
       break;
     }
 #endif
@@ -404,8 +606,8 @@ void SampleOP(const real_t &a,
           ret.CheckAndAlloc();
           TBlob tmp = ret.data();
           ndarray::EvalRandom<gpu, Distribution>(a, b, resource, &tmp, ctx);
-          // Wait GPU kernel to complete
-          ctx.get_stream<gpu>()->Wait();
+          // Wait GPU kernel to complete, or order the dependents after it
+          Engine::Get()->WaitForStream(ctx);
         }, out->ctx(), {}, {ret.var(), resource.var});
       break;
     }
@@ -560,8 +762,8 @@ void Broadcast(const NDArray& src, int dim, int size, NDArray *out) {
           NDArray inter_out = ret.Reshape(mshadow::Shape3(before, size, after));
           TBlob tmp = inter_out.data();
           ndarray::EvalBroadcast<gpu>(inter_in.data(), &tmp, size, ctx);
-          // Wait GPU kernel to complete
-          ctx.get_stream<gpu>()->Wait();
+          // Wait GPU kernel to complete, or order the dependents after it
+          Engine::Get()->WaitForStream(ctx);
       }, src.ctx(), const_vars, {ret.var()});
       break;
     }
@@ -579,7 +781,7 @@ void NDArray::Save(dmlc::Stream *strm) const {
   ctx.Save(strm);
   TBlob save_data;
   NDArray temp;
-  if (ctx.dev_mask() != cpu::kDevMask) {
+  if (ctx.dev_mask() != cpu::kDevMask || !is_contiguous()) {
     temp = this->Copy(Context::CPU());
     temp.WaitToRead();
     save_data = temp.data();
@@ -635,12 +837,188 @@ void NDArray::Save(dmlc::Stream* fo,
   fo->Write(names);
 }
 
+/*!
+ * \brief the aligned format: the magic, the number of bytes of the index, the
+ *  index, then the content of each array at its offset in the file
+ */
+const uint64_t kMXAPINDArrayListAlignedMagic = 0x113;
+/*! \brief the alignment of the arrays in the aligned format */
+const uint64_t kNDArrayFileAlign = 64;
+
+/*! \brief the index of an aligned file */
+struct AlignedNDArrayIndex {
+  std::vector<TShape> shapes;
+  std::vector<Context> ctxs;
+  std::vector<int32_t> dtypes;
+  /*! \brief the offset of each array from the beginning of the file */
+  std::vector<uint64_t> offsets;
+  std::vector<std::string> names;
+
+  inline size_t Bytes(size_t i) const {
+    return shapes[i].Size() * mshadow::mshadow_sizeof(dtypes[i]);
+  }
+  inline void Save(dmlc::Stream* fo) const {
+    uint64_t num = shapes.size();
+    fo->Write(&num, sizeof(num));
+    for (size_t i = 0; i < shapes.size(); ++i) {
+      shapes[i].Save(fo);
+      ctxs[i].Save(fo);
+      fo->Write(&dtypes[i], sizeof(dtypes[i]));
+      fo->Write(&offsets[i], sizeof(offsets[i]));
+    }
+    fo->Write(names);
+  }
+  inline bool Load(dmlc::Stream* fi) {
+    uint64_t num;
+    if (fi->Read(&num, sizeof(num)) != sizeof(num)) return false;
+    shapes.resize(num);
+    ctxs.resize(num);
+    dtypes.resize(num);
+    offsets.resize(num);
+    for (size_t i = 0; i < num; ++i) {
+      if (!shapes[i].Load(fi) || !ctxs[i].Load(fi)) return false;
+      if (fi->Read(&dtypes[i], sizeof(dtypes[i])) != sizeof(dtypes[i])) return false;
+      if (fi->Read(&offsets[i], sizeof(offsets[i])) != sizeof(offsets[i])) return false;
+      if (i != 0 && offsets[i] < offsets[i - 1] + Bytes(i - 1)) return false;
+    }
+    return fi->Read(&names);
+  }
+};
+
+// write the arrays in the aligned format, the cpu arrays must be ready to read
+// and ctxs are the contexts recorded in the file
+inline void WriteAligned(dmlc::Stream* fo,
+                         const std::vector<NDArray>& cpu_data,
+                         const std::vector<Context>& ctxs,
+                         const std::vector<std::string>& names) {
+  AlignedNDArrayIndex index;
+  for (const NDArray& arr : cpu_data) {
+    index.shapes.push_back(arr.shape());
+    index.dtypes.push_back(arr.dtype());
+  }
+  index.ctxs = ctxs;
+  index.names = names;
+  // the offsets do not change the size of the index
+  index.offsets.assign(cpu_data.size(), 0);
+  std::string buf;
+  {
+    dmlc::MemoryStringStream strm(&buf);
+    index.Save(&strm);
+  }
+  uint64_t pos = 2 * sizeof(uint64_t) + buf.size();
+  for (size_t i = 0; i < cpu_data.size(); ++i) {
+    pos = (pos + kNDArrayFileAlign - 1) / kNDArrayFileAlign * kNDArrayFileAlign;
+    index.offsets[i] = pos;
+    pos += index.Bytes(i);
+  }
+  buf.clear();
+  {
+    dmlc::MemoryStringStream strm(&buf);
+    index.Save(&strm);
+  }
+  uint64_t header = kMXAPINDArrayListAlignedMagic, index_size = buf.size();
+  fo->Write(&header, sizeof(header));
+  fo->Write(&index_size, sizeof(index_size));
+  fo->Write(buf.data(), buf.size());
+  pos = 2 * sizeof(uint64_t) + buf.size();
+  const std::vector<char> padding(kNDArrayFileAlign, 0);
+  for (size_t i = 0; i < cpu_data.size(); ++i) {
+    fo->Write(padding.data(), index.offsets[i] - pos);
+    TBlob blob = cpu_data[i].data();
+    CHECK(blob.CheckContiguous());
+    fo->Write(blob.dptr_, index.Bytes(i));
+    pos = index.offsets[i] + index.Bytes(i);
+  }
+}
+
+void NDArray::SaveAligned(dmlc::Stream* fo,
+                          const std::vector<NDArray>& data,
+                          const std::vector<std::string>& names) {
+  std::vector<NDArray> cpu_data;
+  std::vector<Context> ctxs;
+  for (const NDArray& arr : data) {
+    CHECK(!arr.is_none()) << "cannot save an empty NDArray in the aligned format";
+    cpu_data.push_back(arr.ctx().dev_mask() == cpu::kDevMask && arr.is_contiguous() ?
+                       arr : arr.Copy(Context::CPU()));
+    ctxs.push_back(arr.ctx());
+  }
+  for (const NDArray& arr : cpu_data) arr.WaitToRead();
+  WriteAligned(fo, cpu_data, ctxs, names);
+}
+
+void NDArray::SaveAsync(const std::string& fname,
+                        const std::vector<NDArray>& data,
+                        const std::vector<std::string>& names) {
+  // snapshot the arrays, the gpu ones into pinned memory
+  std::vector<NDArray> snapshot;
+  std::vector<Context> ctxs;
+  std::vector<Engine::VarHandle> const_vars;
+  for (const NDArray& arr : data) {
+    CHECK(!arr.is_none()) << "cannot save an empty NDArray in the aligned format";
+    Context ctx = arr.ctx().dev_mask() == cpu::kDevMask ?
+        Context::CPU() : Context::CPUPinned(arr.ctx().dev_id);
+    NDArray copy(arr.shape(), ctx, true, arr.dtype());
+    CopyFromTo(arr, &copy);
+    snapshot.push_back(copy);
+    ctxs.push_back(arr.ctx());
+    const_vars.push_back(copy.var());
+  }
+  // the file is written by its own thread so that no engine worker blocks on
+  // the disk, the push completes when the file is closed
+  Engine::Get()->PushAsync(
+    [fname, snapshot, ctxs, names](RunContext rctx, Engine::CallbackOnComplete on_complete) {
+      std::thread([fname, snapshot, ctxs, names, on_complete]() {
+          try {
+            std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(fname.c_str(), "w"));
+            WriteAligned(fo.get(), snapshot, ctxs, names);
+          } catch (const dmlc::Error& e) {
+            LOG(ERROR) << "failed to save " << fname << ": " << e.what();
+          }
+          on_complete();
+        }).detach();
+    }, Context::CPU(), const_vars, {}, FnProperty::kNormal, 0, "SaveAsync");
+}
+
+// read the index of an aligned file after the magic, return the offset after it
+inline uint64_t LoadAlignedIndex(dmlc::Stream* fi, AlignedNDArrayIndex* index) {
+  uint64_t index_size;
+  CHECK(fi->Read(&index_size)) << "Invalid NDArray file format";
+  std::string buf(index_size, '\0');
+  CHECK_EQ(fi->Read(&buf[0], index_size), index_size) << "Invalid NDArray file format";
+  dmlc::MemoryFixedSizeStream strm(&buf[0], buf.size());
+  CHECK(index->Load(&strm)) << "Invalid NDArray file format";
+  CHECK(index->names.size() == 0 || index->names.size() == index->shapes.size())
+      << "Invalid NDArray file format";
+  return 2 * sizeof(uint64_t) + index_size;
+}
+
 void NDArray::Load(dmlc::Stream* fi,
                    std::vector<NDArray>* data,
                    std::vector<std::string>* keys) {
   uint64_t header, reserved;
   CHECK(fi->Read(&header))
       << "Invalid NDArray file format";
+  if (header == kMXAPINDArrayListAlignedMagic) {
+    AlignedNDArrayIndex index;
+    // the arrays are read in order, skipping the padding
+    uint64_t pos = LoadAlignedIndex(fi, &index);
+    std::vector<char> padding(kNDArrayFileAlign);
+    data->clear();
+    for (size_t i = 0; i < index.shapes.size(); ++i) {
+      CHECK_GE(index.offsets[i], pos) << "Invalid NDArray file format";
+      const size_t skip = index.offsets[i] - pos;
+      CHECK(skip <= padding.size() && fi->Read(padding.data(), skip) == skip)
+          << "Invalid NDArray file format";
+      NDArray temp(index.shapes[i], Context::CPU(), false, index.dtypes[i]);
+      CHECK_EQ(fi->Read(temp.data().dptr_, index.Bytes(i)), index.Bytes(i))
+          << "Invalid NDArray file format";
+      pos = index.offsets[i] + index.Bytes(i);
+      data->push_back(index.ctxs[i].dev_mask() == cpu::kDevMask ?
+                      temp : temp.Copy(index.ctxs[i]));
+    }
+    *keys = index.names;
+    return;
+  }
   CHECK(fi->Read(&reserved))
       << "Invalid NDArray file format";
   CHECK(header == kMXAPINDArrayListMagic)
@@ -653,6 +1031,78 @@ void NDArray::Load(dmlc::Stream* fi,
       << "Invalid NDArray file format";
 }
 
+// map a local file in the aligned format, return false for the other files
+inline bool MapAligned(const std::string& fname,
+                       std::vector<NDArray>* data,
+                       std::vector<Context>* ctxs,
+                       std::vector<std::string>* keys) {
+#if !defined(_WIN32)
+  const bool local = fname.find("://") == std::string::npos ||
+      fname.compare(0, 7, "file://") == 0;
+  if (!local) return false;
+  const std::string path = fname.compare(0, 7, "file://") == 0 ? fname.substr(7) : fname;
+  int fd = open(path.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "cannot open " << path;
+  uint64_t header;
+  if (read(fd, &header, sizeof(header)) != sizeof(header) ||
+      header != kMXAPINDArrayListAlignedMagic) {
+    close(fd);
+    return false;
+  }
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "cannot stat " << path;
+  const size_t size = st.st_size;
+  // the pages are shared until they are written
+  void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CHECK(addr != MAP_FAILED) << "cannot mmap " << path;
+  std::shared_ptr<void> holder(addr, [size](void* p) { munmap(p, size); });
+  dmlc::MemoryFixedSizeStream strm(addr, size);
+  strm.Seek(sizeof(header));
+  AlignedNDArrayIndex index;
+  LoadAlignedIndex(&strm, &index);
+  data->clear();
+  for (size_t i = 0; i < index.shapes.size(); ++i) {
+    CHECK_LE(index.offsets[i] + index.Bytes(i), size) << "Invalid NDArray file format";
+    TBlob blob(static_cast<char*>(addr) + index.offsets[i], index.shapes[i],
+               cpu::kDevMask, index.dtypes[i]);
+    data->push_back(NDArray(blob, 0, holder));
+  }
+  *ctxs = index.ctxs;
+  *keys = index.names;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void NDArray::LoadMapped(const std::string& fname,
+                         std::vector<NDArray>* data,
+                         std::vector<std::string>* keys) {
+  std::vector<Context> ctxs;
+  if (MapAligned(fname, data, &ctxs, keys)) return;
+  std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(fname.c_str(), "r"));
+  Load(fi.get(), data, keys);
+}
+
+void NDArray::LoadParallel(const std::string& fname,
+                           std::vector<NDArray>* data,
+                           std::vector<std::string>* keys) {
+  std::vector<NDArray> mapped;
+  std::vector<Context> ctxs;
+  if (!MapAligned(fname, &mapped, &ctxs, keys)) {
+    std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(fname.c_str(), "r"));
+    Load(fi.get(), data, keys);
+    return;
+  }
+  // the copies run concurrently on the engine, each reads its pages from the disk
+  data->clear();
+  for (size_t i = 0; i < mapped.size(); ++i) {
+    data->push_back(mapped[i].Copy(ctxs[i].dev_mask() == cpu::kDevMask ?
+                                   Context::CPU() : ctxs[i]));
+  }
+}
+
 NDArray NDArray::Copy(Context ctx) const {
   NDArray ret(shape(), ctx, true, dtype_);
   CopyFromTo(*this, &ret);
@@ -716,7 +1166,8 @@ void NDArray::SyncCopyToCPU(void *data, size_t size) const {
 #if MXNET_PREDICT_ONLY == 0
 // register API function
 // those with underscore will be registered at NDArray
-MXNET_REGISTER_NDARRAY_FUN(_set_value).set_function(SetValueOp);
+MXNET_REGISTER_NDARRAY_FUN(_set_value).set_function(SetValueOp)
+.set_type_mask(kAcceptStridedArgs);
 
 
 MXNET_REGISTER_NDARRAY_FUN(_onehot_encode).set_function(BinaryOp<ndarray::OneHotEncode>);
@@ -733,6 +1184,20 @@ MXNET_REGISTER_NDARRAY_FUN(fill_element_0index)
 " in lhs according to index indicated by rhs and values indicated by mhs."
 " This function assume rhs uses 0-based index.");
 
+MXNET_REGISTER_NDARRAY_FUN(_take_rows)
+.set_function(BinaryOp<ndarray::TakeRows>)
+.describe("Take the rows of matrix lhs indicated by the 0-based index rhs.");
+
+MXNET_REGISTER_NDARRAY_FUN(_fill_rows)
+.set_function(TernaryOp<ndarray::FillRows>)
+.describe("Fill the rows of matrix lhs indicated by the 0-based index rhs"
+" with the rows of mhs.");
+
+MXNET_REGISTER_NDARRAY_FUN(_image_normalize)
+.set_function(TernaryOp<ndarray::ImageNormalize>)
+.describe("Convert the uint8 images lhs of shape (N, C, H, W) to float32 and"
+" subtract the mean image mhs, the images n with rhs[n] != 0 are mirrored.");
+
 // register API function
 // those with underscore will be registered at NDArray
 
@@ -741,7 +1206,7 @@ MXNET_REGISTER_NDARRAY_FUN(fill_element_0index)
 // that we need to remove kAcceptEmptyMutateTarget from it
 MXNET_REGISTER_NDARRAY_FUN(_copyto)
 .set_function(CopyFromToSimple)
-.set_type_mask(kNDArrayArgBeforeScalar);
+.set_type_mask(kNDArrayArgBeforeScalar | kAcceptStridedArgs);
 
 // register random number generators
 MXNET_REGISTER_NDARRAY_FUN(_random_uniform)
@@ -761,7 +1226,7 @@ MXNET_REGISTER_NDARRAY_FUN(_random_gaussian)
 .set_num_mutate_vars(1);
 
 MXNET_REGISTER_NDARRAY_FUN(clip)
-.set_type_mask(kNDArrayArgBeforeScalar | kAcceptEmptyMutateTarget)
+.set_type_mask(kNDArrayArgBeforeScalar | kAcceptEmptyMutateTarget | kAcceptStridedArgs)
 .set_body([](NDArray **u, real_t *s, NDArray **out,
              int num_params, char **param_keys, char **param_vals) {
     ClipOp(*u[0], s[0], s[1], out[0]);
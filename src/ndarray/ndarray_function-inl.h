@@ -6,8 +6,11 @@
 #ifndef MXNET_NDARRAY_NDARRAY_FUNCTION_INL_H_
 #define MXNET_NDARRAY_NDARRAY_FUNCTION_INL_H_
 
+#include <algorithm>
 #include <vector>
 #include "./ndarray_function.h"
+#include "../operator/row_sparse-inl.h"
+#include "../operator/image_normalize-inl.h"
 // this file will be included twice by CPU and GPU
 // macro to help specialize evaluation function
 
@@ -107,6 +110,55 @@ inline void EvalMatFillRowElem_(const TBlob &lhs, const TBlob &mhs, const TBlob
                                  rhs.get<xpu, 1, real_t>(s));
 }
 
+template<typename xpu, typename OP>
+inline void EvalTakeRows_(const TBlob &lhs, const TBlob &rhs,
+                          TBlob *ret, RunContext ctx) {
+  using namespace mshadow::expr;
+  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+  CHECK_EQ(ret->type_flag_, mshadow::default_type_flag)
+    << "take_rows only support float32 as input/output";
+  CHECK_EQ(rhs.type_flag_, mshadow::default_type_flag)
+    << "take_rows only support float32 as input/output";
+  CHECK_EQ(lhs.type_flag_, mshadow::default_type_flag)
+    << "take_rows only support float32 as input/output";
+  ret->get<xpu, 2, real_t>(s) = take(rhs.get<xpu, 1, real_t>(s),
+                                     lhs.get<xpu, 2, real_t>(s));
+}
+
+template<typename xpu, typename OP>
+inline void EvalFillRows_(const TBlob &lhs, const TBlob &mhs, const TBlob &rhs,
+                          TBlob *ret, RunContext ctx) {
+  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+  CHECK_EQ(ret->type_flag_, mshadow::default_type_flag)
+    << "fill_rows only support float32 as input/output";
+  CHECK_EQ(mhs.type_flag_, mshadow::default_type_flag)
+    << "fill_rows only support float32 as input/output";
+  CHECK_EQ(rhs.type_flag_, mshadow::default_type_flag)
+    << "fill_rows only support float32 as input/output";
+  mshadow::Tensor<xpu, 2, real_t> out = ret->get<xpu, 2, real_t>(s);
+  if (ret->dptr_ != lhs.dptr_) {
+    mshadow::Copy(out, lhs.get<xpu, 2, real_t>(s), s);
+  }
+  op::rowsparse::FillRows(out, rhs.get<xpu, 1, real_t>(s),
+                          static_cast<const real_t*>(mhs.dptr_));
+}
+
+template<typename xpu, typename OP>
+inline void EvalImageNormalize_(const TBlob &lhs, const TBlob &mhs, const TBlob &rhs,
+                                TBlob *ret, RunContext ctx) {
+  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+  CHECK_EQ(lhs.type_flag_, mshadow::kUint8)
+    << "image_normalize only support uint8 images";
+  CHECK_EQ(ret->type_flag_, mshadow::default_type_flag)
+    << "image_normalize only support float32 as output";
+  CHECK_EQ(mhs.type_flag_, mshadow::default_type_flag)
+    << "image_normalize only support float32 mean";
+  CHECK_EQ(rhs.type_flag_, mshadow::default_type_flag)
+    << "image_normalize only support float32 flip";
+  op::image::Normalize(ret->get<xpu, 4, real_t>(s), lhs.get<xpu, 4, uint8_t>(s),
+                       mhs.get<xpu, 3, real_t>(s), rhs.get<xpu, 1, real_t>(s));
+}
+
 template<typename xpu, typename OP, bool reverse>
 inline void EvalScalar_(const TBlob &lhs, const real_t &rhs,
                         TBlob *ret, RunContext ctx) {
@@ -258,6 +310,66 @@ void ElementwiseSum<DEVICE>(const std::vector<TBlob> source,
   });
 }
 
+/*! \brief the heads of the inputs of a fused program, passed by value to the kernels */
+struct FusedInputs {
+  const real_t *dptr[FusedProgram::kMaxInputs];
+};
+
+MSHADOW_XINLINE real_t RunFused(const FusedProgram &prog, const FusedInputs &in, index_t i) {
+  real_t stack[FusedProgram::kMaxStack];
+  int top = 0;
+  for (int k = 0; k < prog.size; ++k) {
+    switch (prog.code[k]) {
+      case FusedProgram::kInput: stack[top++] = in.dptr[prog.arg[k]][i]; break;
+      case FusedProgram::kScalar: stack[top++] = prog.scalars[prog.arg[k]]; break;
+      case FusedProgram::kAdd: --top; stack[top - 1] += stack[top]; break;
+      case FusedProgram::kSub: --top; stack[top - 1] -= stack[top]; break;
+      case FusedProgram::kMul: --top; stack[top - 1] *= stack[top]; break;
+      case FusedProgram::kDiv: --top; stack[top - 1] /= stack[top]; break;
+    }
+  }
+  return stack[0];
+}
+
+#if defined(__CUDACC__)
+__global__ void EvalFusedKernel(FusedProgram prog, FusedInputs in, real_t *out, index_t size) {
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += gridDim.x * blockDim.x) {
+    out[i] = RunFused(prog, in, i);
+  }
+}
+#endif
+
+template<>
+void EvalFused<DEVICE>(const FusedProgram &prog, const std::vector<TBlob> &inputs,
+                       TBlob *ret, RunContext ctx) {
+  CHECK_LE(inputs.size(), static_cast<size_t>(FusedProgram::kMaxInputs));
+  FusedInputs in;
+  for (size_t k = 0; k < inputs.size(); ++k) {
+    CHECK(inputs[k].CheckContiguous());
+    in.dptr[k] = inputs[k].dptr<real_t>();
+  }
+  CHECK(ret->CheckContiguous());
+  real_t *out = ret->dptr<real_t>();
+  const index_t size = ret->Size();
+  if (size == 0) return;
+#if defined(__CUDACC__)
+  using namespace mshadow::cuda;
+  const int blocks = static_cast<int>(std::min<index_t>(
+      (size + kBaseThreadNum - 1) / kBaseThreadNum, kMaxGridNum));
+  EvalFusedKernel<<<blocks, kBaseThreadNum, 0,
+                    mshadow::Stream<gpu>::GetStream(ctx.get_stream<gpu>())>>>(
+      prog, in, out, size);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+#else
+  #pragma omp parallel for schedule(static)
+  for (index_t i = 0; i < size; ++i) {
+    out[i] = RunFused(prog, in, i);
+  }
+#endif
+}
+
 template <>
 void EvalBroadcast<DEVICE>(TBlob const& src, TBlob* ret, int size, RunContext ctx) {
   typedef DEVICE xpu;
@@ -271,6 +383,9 @@ void EvalBroadcast<DEVICE>(TBlob const& src, TBlob* ret, int size, RunContext ct
 DECL_BINARY(DEVICE, MatChooseRowElem, EvalMatChooseRowElem_)
 DECL_TERNARY(DEVICE, MatFillRowElem, EvalMatFillRowElem_)
 DECL_BINARY(DEVICE, OneHotEncode, EvalOneHot_)
+DECL_BINARY(DEVICE, TakeRows, EvalTakeRows_)
+DECL_TERNARY(DEVICE, FillRows, EvalFillRows_)
+DECL_TERNARY(DEVICE, ImageNormalize, EvalImageNormalize_)
 DECL_BINARY(DEVICE, Plus, EvalBinary_)
 DECL_BINARY(DEVICE, Minus, EvalBinary_)
 DECL_BINARY(DEVICE, Mul, EvalBinary_)
@@ -95,6 +95,53 @@ struct MatFillRowElem {
   }
 };
 
+struct TakeRows {
+  inline static TShape GetShape(const TShape &lshape, const TShape &rshape) {
+    CHECK(lshape.ndim() == 2 && rshape.ndim() == 1)
+        << "take_rows only support 2D Matrix and 1D index";
+    return mshadow::Shape2(rshape[0], lshape[1]);
+  }
+};
+
+struct FillRows {
+  inline static TShape GetShape(const TShape &lshape, const TShape &mshape, const TShape &rshape) {
+    CHECK(lshape.ndim() == 2 && mshape.ndim() == 2 && rshape.ndim() == 1)
+        << "fill_rows only support 2D Matrix, 2D rows and 1D index";
+    CHECK(lshape[1] == mshape[1] && mshape[0] == rshape[0])
+        << "fill_rows index, rows and matrix shape mismatch";
+    return lshape;
+  }
+};
+
+struct ImageNormalize {
+  inline static TShape GetShape(const TShape &lshape, const TShape &mshape, const TShape &rshape) {
+    CHECK(lshape.ndim() == 4 && mshape.ndim() == 3 && rshape.ndim() == 1)
+        << "image_normalize only support 4D images, 3D mean and 1D flip";
+    CHECK(lshape[1] == mshape[0] && lshape[2] == mshape[1] && lshape[3] == mshape[2] &&
+          lshape[0] == rshape[0])
+        << "image_normalize images, mean and flip shape mismatch";
+    return lshape;
+  }
+};
+
+/*!
+ * \brief a postfix program of elementwise arithmetic over inputs and scalars of the
+ *  same shape, evaluated in one pass by EvalFused. It is passed by value to the kernels.
+ */
+struct FusedProgram {
+  static const int kMaxInstr = 64;
+  static const int kMaxInputs = 16;
+  static const int kMaxStack = 16;
+  /*! \brief push input arg, push scalar arg, or pop the operands and push the result */
+  enum Opcode {kInput, kScalar, kAdd, kSub, kMul, kDiv};
+  /*! \brief number of instructions */
+  int size;
+  int8_t code[kMaxInstr];
+  /*! \brief index of the input or the scalar pushed */
+  int8_t arg[kMaxInstr];
+  real_t scalars[kMaxInstr];
+};
+
 // type holder for random number generators
 struct UniformDistribution {};
 
@@ -136,6 +183,11 @@ void ElementwiseSum(const std::vector<TBlob> source,
                     TBlob *out,
                     RunContext ctx);
 
+// one pass of a fused program over contiguous float inputs
+template<typename Device>
+void EvalFused(const FusedProgram &prog, const std::vector<TBlob> &inputs,
+               TBlob *ret, RunContext ctx);
+
 // broadcasting
 template <typename Device>
 void EvalBroadcast(TBlob const& src, TBlob* ret, int size, RunContext ctx);
@@ -16,6 +16,7 @@
 #include <vector>
 #include <utility>
 #include "./operator_common.h"
+#include "./mshadow_op_simd.h"
 
 namespace mxnet {
 namespace op {
@@ -57,9 +58,18 @@ class ActivationOp : public Operator {
     CHECK_EQ(in_data.size(), 1);
     CHECK_EQ(out_data.size(), 1);
     Stream<xpu> *s = ctx.get_stream<xpu>();
-    Tensor<xpu, 2, DType> data = in_data[activation::kData].FlatTo2D<xpu, DType>(s);
     Tensor<xpu, 2, DType> out = out_data[activation::kOut].FlatTo2D<xpu, DType>(s);
-    Assign(out, req[activation::kOut], F<ForwardOp>(data));
+    if (in_data[activation::kData].type_flag_ != mshadow::DataType<DType>::kFlag) {
+      // the output of a skipped Cast, converted on load
+      MSHADOW_REAL_TYPE_SWITCH(in_data[activation::kData].type_flag_, SrcDType, {
+        Tensor<xpu, 2, SrcDType> data =
+            in_data[activation::kData].FlatTo2D<xpu, SrcDType>(s);
+        Assign(out, req[activation::kOut], F<ForwardOp>(tcast<DType>(data)));
+      });
+      return;
+    }
+    Tensor<xpu, 2, DType> data = in_data[activation::kData].FlatTo2D<xpu, DType>(s);
+    mshadow_op::simd::MapExp<ForwardOp>(out, req[activation::kOut], data);
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -165,6 +175,20 @@ class ActivationProp : public OperatorProperty {
     return {{in_data[activation::kData], out_data[activation::kOut]}};
   }
 
+  std::vector<int> ListCPULayouts(const std::vector<TShape> &in_shape) const override {
+    return {kLayoutAny};
+  }
+
+  std::vector<int> CastOnLoadInputs(const Context &ctx) const override {
+#if MXNET_USE_CUDNN == 1
+    // cudnn reads the input in the type of the output
+    if (ctx.dev_mask() == gpu::kDevMask && param_.act_type != activation::kSoftReLU) {
+      return {};
+    }
+#endif  // MXNET_USE_CUDNN
+    return {activation::kData};
+  }
+
   Operator* CreateOperator(Context ctx) const override {
     LOG(FATAL) << "Not Implemented.";
     return NULL;
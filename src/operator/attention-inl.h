@@ -0,0 +1,559 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file attention-inl.h
+ * \brief scaled dot product attention, softmax(Q K^T / sqrt(d)) V with masks, computed
+ *  over tiles of the keys so that the scores of all the keys are never stored.
+ *
+ *  Forward takes, for each tile of kTile keys, the scores of the tile with a batched
+ *  gemm, updates the running max and sum of the softmax of each query and rescales
+ *  its output accumulated so far (the online softmax), then adds the probabilities
+ *  of the tile times its values with another gemm. The log-sum-exp of each query is
+ *  kept for backward, which recomputes the probabilities of each tile from it and
+ *  accumulates the gradients of the queries, and writes those of the keys and values
+ *  of the tile. The workspace is a few (B, Tq, kTile) tiles instead of (B, Tq, Tk)
+ *  scores.
+ */
+#ifndef MXNET_OPERATOR_ATTENTION_INL_H_
+#define MXNET_OPERATOR_ATTENTION_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <vector>
+#include <string>
+#include <utility>
+#include "./operator_common.h"
+#include "./batch_gemm-inl.h"
+#include "./broadcast_reduce_kernel-inl.h"
+
+namespace mxnet {
+namespace op {
+
+namespace attention {
+enum AttentionOpInputs {kQuery, kKey, kValue, kLength};
+enum AttentionOpOutputs {kOut, kLse};
+enum AttentionOpResource {kTempSpace};
+/*! \brief number of keys of a tile */
+const int kTile = 256;
+
+/*! \brief the shape of an attention and of its current tile of keys */
+struct TileShape {
+  /*! \brief batch, queries, keys, dim of the queries and keys, dim of the values */
+  int B, Tq, Tk, D, Dv;
+  /*! \brief the first key of the tile and the number of its keys */
+  int t0, n;
+  /*! \brief the number of valid keys of each instance, or nullptr */
+  const real_t *length;
+  /*! \brief whether query i only attends to the keys up to i + Tk - Tq */
+  bool causal;
+  /*! \brief whether key j of the tile is masked for query i of instance b */
+  MSHADOW_XINLINE bool Masked(int b, int i, int j) const {
+    const int key = t0 + j;
+    return (length != nullptr && key >= static_cast<int>(length[b])) ||
+        (causal && key > i + Tk - Tq);
+  }
+};
+
+/*!
+ * \brief online softmax update of the scores S (B * Tq, n) of a tile, replaced by their
+ *  exp(S - max). The running max m and sum l of each query are updated, and its output
+ *  O (B * Tq, Dv) accumulated over the previous tiles is rescaled to the new max.
+ * \param first whether this is the first tile, m, l and O are then not read
+ */
+inline void SoftmaxTile(mshadow::Stream<cpu> *s, const TileShape &p, bool first,
+                        real_t *S, real_t *m, real_t *l, real_t *O) {
+  const real_t kNegInf = -std::numeric_limits<real_t>::infinity();
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < p.B * p.Tq; ++r) {
+    const int b = r / p.Tq, i = r % p.Tq;
+    real_t *row = S + static_cast<size_t>(r) * p.n;
+    real_t mx = first ? kNegInf : m[r];
+    for (int j = 0; j < p.n; ++j) {
+      if (!p.Masked(b, i, j)) mx = std::max(mx, row[j]);
+    }
+    if (mx == kNegInf) {
+      // every key so far is masked
+      std::fill(row, row + p.n, real_t(0));
+      if (first) {
+        m[r] = kNegInf;
+        l[r] = 0;
+      }
+      continue;
+    }
+    real_t sum = 0;
+    for (int j = 0; j < p.n; ++j) {
+      row[j] = p.Masked(b, i, j) ? 0 : std::exp(row[j] - mx);
+      sum += row[j];
+    }
+    if (first) {
+      l[r] = sum;
+    } else {
+      const real_t alpha = std::exp(m[r] - mx);
+      l[r] = l[r] * alpha + sum;
+      real_t *o = O + static_cast<size_t>(r) * p.Dv;
+      for (int k = 0; k < p.Dv; ++k) o[k] *= alpha;
+    }
+    m[r] = mx;
+  }
+}
+
+/*!
+ * \brief divide each output row by its sum, and write its log-sum-exp, +inf for a
+ *  query whose keys are all masked so that its probabilities recomputed in backward are 0
+ */
+inline void FinishOutput(mshadow::Stream<cpu> *s, int rows, int Dv, const real_t *m,
+                         const real_t *l, real_t *O, real_t *lse) {
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < rows; ++r) {
+    real_t *o = O + static_cast<size_t>(r) * Dv;
+    if (l[r] > 0) {
+      const real_t scale = 1 / l[r];
+      for (int k = 0; k < Dv; ++k) o[k] *= scale;
+      lse[r] = m[r] + std::log(l[r]);
+    } else {
+      std::fill(o, o + Dv, real_t(0));
+      lse[r] = std::numeric_limits<real_t>::infinity();
+    }
+  }
+}
+
+/*! \brief out[r] = sum of dO * O of row r */
+inline void RowDot(mshadow::Stream<cpu> *s, int rows, int Dv, const real_t *dO,
+                   const real_t *O, real_t *out) {
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < rows; ++r) {
+    const real_t *a = dO + static_cast<size_t>(r) * Dv, *b = O + static_cast<size_t>(r) * Dv;
+    real_t sum = 0;
+    for (int k = 0; k < Dv; ++k) sum += a[k] * b[k];
+    out[r] = sum;
+  }
+}
+
+/*! \brief the probabilities exp(S - lse) of a tile in place, 0 where masked */
+inline void ProbTile(mshadow::Stream<cpu> *s, const TileShape &p, const real_t *lse,
+                     real_t *S) {
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < p.B * p.Tq; ++r) {
+    const int b = r / p.Tq, i = r % p.Tq;
+    real_t *row = S + static_cast<size_t>(r) * p.n;
+    for (int j = 0; j < p.n; ++j) {
+      row[j] = p.Masked(b, i, j) ? 0 : std::exp(row[j] - lse[r]);
+    }
+  }
+}
+
+/*! \brief the score gradients dS = P * (dP - dot) * scale of a tile, in place of dP */
+inline void GradTile(mshadow::Stream<cpu> *s, const TileShape &p, const real_t *P,
+                     const real_t *dot, real_t scale, real_t *dP) {
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < p.B * p.Tq; ++r) {
+    const size_t offset = static_cast<size_t>(r) * p.n;
+    for (int j = 0; j < p.n; ++j) {
+      dP[offset + j] = P[offset + j] * (dP[offset + j] - dot[r]) * scale;
+    }
+  }
+}
+
+#ifdef __CUDACC__
+template<typename Reducer>
+__device__ real_t WarpAllReduce(real_t val) {
+  for (int offset = broadcast::kWarpSize / 2; offset > 0; offset >>= 1) {
+#if CUDA_VERSION >= 9000
+    Reducer::Reduce(val, __shfl_xor_sync(0xffffffff, val, offset));
+#else
+    Reducer::Reduce(val, __shfl_xor(val, offset));
+#endif
+  }
+  return val;
+}
+
+/*! \brief one warp per query */
+__global__ void SoftmaxTileKernel(TileShape p, bool first, real_t *S, real_t *m, real_t *l,
+                                  real_t *O) {
+  const int lane = threadIdx.x % broadcast::kWarpSize;
+  const int warps = blockDim.x / broadcast::kWarpSize;
+  for (int r = blockIdx.x * warps + threadIdx.x / broadcast::kWarpSize; r < p.B * p.Tq;
+       r += gridDim.x * warps) {
+    const int b = r / p.Tq, i = r % p.Tq;
+    real_t *row = S + static_cast<size_t>(r) * p.n;
+    real_t mx = -INFINITY;
+    for (int j = lane; j < p.n; j += broadcast::kWarpSize) {
+      if (!p.Masked(b, i, j)) mx = max(mx, row[j]);
+    }
+    mx = WarpAllReduce<mshadow::red::maximum>(mx);
+    if (!first) mx = max(mx, m[r]);
+    if (mx == -INFINITY) {
+      for (int j = lane; j < p.n; j += broadcast::kWarpSize) row[j] = 0;
+      if (first && lane == 0) {
+        m[r] = -INFINITY;
+        l[r] = 0;
+      }
+      continue;
+    }
+    real_t sum = 0;
+    for (int j = lane; j < p.n; j += broadcast::kWarpSize) {
+      row[j] = p.Masked(b, i, j) ? 0 : expf(row[j] - mx);
+      sum += row[j];
+    }
+    sum = WarpAllReduce<mshadow::red::sum>(sum);
+    if (first) {
+      if (lane == 0) l[r] = sum;
+    } else {
+      const real_t alpha = expf(m[r] - mx);
+      real_t *o = O + static_cast<size_t>(r) * p.Dv;
+      for (int k = lane; k < p.Dv; k += broadcast::kWarpSize) o[k] *= alpha;
+      if (lane == 0) l[r] = l[r] * alpha + sum;
+    }
+    if (lane == 0) m[r] = mx;
+  }
+}
+
+__global__ void FinishOutputKernel(int rows, int Dv, const real_t *m, const real_t *l,
+                                   real_t *O, real_t *lse) {
+  const size_t size = static_cast<size_t>(rows) * Dv;
+  for (size_t e = blockIdx.x * blockDim.x + threadIdx.x; e < size;
+       e += gridDim.x * blockDim.x) {
+    const int r = e / Dv;
+    O[e] = l[r] > 0 ? O[e] / l[r] : 0;
+    if (e % Dv == 0) lse[r] = l[r] > 0 ? m[r] + logf(l[r]) : INFINITY;
+  }
+}
+
+/*! \brief one warp per row */
+__global__ void RowDotKernel(int rows, int Dv, const real_t *dO, const real_t *O,
+                             real_t *out) {
+  const int lane = threadIdx.x % broadcast::kWarpSize;
+  const int warps = blockDim.x / broadcast::kWarpSize;
+  for (int r = blockIdx.x * warps + threadIdx.x / broadcast::kWarpSize; r < rows;
+       r += gridDim.x * warps) {
+    const size_t offset = static_cast<size_t>(r) * Dv;
+    real_t sum = 0;
+    for (int k = lane; k < Dv; k += broadcast::kWarpSize) sum += dO[offset + k] * O[offset + k];
+    sum = WarpAllReduce<mshadow::red::sum>(sum);
+    if (lane == 0) out[r] = sum;
+  }
+}
+
+__global__ void ProbTileKernel(TileShape p, const real_t *lse, real_t *S) {
+  const size_t size = static_cast<size_t>(p.B) * p.Tq * p.n;
+  for (size_t e = blockIdx.x * blockDim.x + threadIdx.x; e < size;
+       e += gridDim.x * blockDim.x) {
+    const int r = e / p.n, j = e % p.n;
+    S[e] = p.Masked(r / p.Tq, r % p.Tq, j) ? 0 : expf(S[e] - lse[r]);
+  }
+}
+
+__global__ void GradTileKernel(TileShape p, const real_t *P, const real_t *dot, real_t scale,
+                               real_t *dP) {
+  const size_t size = static_cast<size_t>(p.B) * p.Tq * p.n;
+  for (size_t e = blockIdx.x * blockDim.x + threadIdx.x; e < size;
+       e += gridDim.x * blockDim.x) {
+    dP[e] = P[e] * (dP[e] - dot[e / p.n]) * scale;
+  }
+}
+
+inline int NumBlocks(size_t threads) {
+  using namespace mshadow::cuda;
+  return static_cast<int>(std::min<size_t>((threads + kBaseThreadNum - 1) / kBaseThreadNum,
+                                           kMaxGridNum));
+}
+
+inline void CheckLaunch() {
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+inline void SoftmaxTile(mshadow::Stream<gpu> *s, const TileShape &p, bool first,
+                        real_t *S, real_t *m, real_t *l, real_t *O) {
+  SoftmaxTileKernel<<<NumBlocks(static_cast<size_t>(p.B) * p.Tq * broadcast::kWarpSize),
+                      mshadow::cuda::kBaseThreadNum, 0,
+                      mshadow::Stream<gpu>::GetStream(s)>>>(p, first, S, m, l, O);
+  CheckLaunch();
+}
+
+inline void FinishOutput(mshadow::Stream<gpu> *s, int rows, int Dv, const real_t *m,
+                         const real_t *l, real_t *O, real_t *lse) {
+  FinishOutputKernel<<<NumBlocks(static_cast<size_t>(rows) * Dv),
+                       mshadow::cuda::kBaseThreadNum, 0,
+                       mshadow::Stream<gpu>::GetStream(s)>>>(rows, Dv, m, l, O, lse);
+  CheckLaunch();
+}
+
+inline void RowDot(mshadow::Stream<gpu> *s, int rows, int Dv, const real_t *dO,
+                   const real_t *O, real_t *out) {
+  RowDotKernel<<<NumBlocks(static_cast<size_t>(rows) * broadcast::kWarpSize),
+                 mshadow::cuda::kBaseThreadNum, 0,
+                 mshadow::Stream<gpu>::GetStream(s)>>>(rows, Dv, dO, O, out);
+  CheckLaunch();
+}
+
+inline void ProbTile(mshadow::Stream<gpu> *s, const TileShape &p, const real_t *lse,
+                     real_t *S) {
+  ProbTileKernel<<<NumBlocks(static_cast<size_t>(p.B) * p.Tq * p.n),
+                   mshadow::cuda::kBaseThreadNum, 0,
+                   mshadow::Stream<gpu>::GetStream(s)>>>(p, lse, S);
+  CheckLaunch();
+}
+
+inline void GradTile(mshadow::Stream<gpu> *s, const TileShape &p, const real_t *P,
+                     const real_t *dot, real_t scale, real_t *dP) {
+  GradTileKernel<<<NumBlocks(static_cast<size_t>(p.B) * p.Tq * p.n),
+                   mshadow::cuda::kBaseThreadNum, 0,
+                   mshadow::Stream<gpu>::GetStream(s)>>>(p, P, dot, scale, dP);
+  CheckLaunch();
+}
+#endif  // __CUDACC__
+}  // namespace attention
+
+struct AttentionParam : public dmlc::Parameter<AttentionParam> {
+  bool causal;
+  bool use_length;
+  DMLC_DECLARE_PARAMETER(AttentionParam) {
+    DMLC_DECLARE_FIELD(causal).set_default(false)
+    .describe("Whether each query only attends to the keys up to its own position, "
+              "the last query attending to the last key.");
+    DMLC_DECLARE_FIELD(use_length).set_default(false)
+    .describe("Whether the input length gives the number of valid keys of each instance, "
+              "the keys after them are masked.");
+  }
+};
+
+/**
+ * \brief scaled dot product attention of query (B, Tq, D), key (B, Tk, D) and
+ *  value (B, Tk, Dv).
+ * \tparam xpu The device that the op will be executed on.
+ */
+template<typename xpu>
+class AttentionOp : public Operator {
+ public:
+  explicit AttentionOp(AttentionParam param) : param_(param) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace attention;
+    if (req[kOut] == kNullOp) return;
+    CHECK_EQ(req[kOut], kWriteTo);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    TileShape p = this->GetShape(in_data);
+    const real_t *Q = in_data[kQuery].dptr<real_t>();
+    const real_t *K = in_data[kKey].dptr<real_t>();
+    const real_t *V = in_data[kValue].dptr<real_t>();
+    real_t *O = out_data[kOut].dptr<real_t>();
+    real_t *lse = out_data[kLse].dptr<real_t>();
+    const int rows = p.B * p.Tq, tile = std::min(kTile, p.Tk);
+    Tensor<xpu, 1> workspace = ctx.requested[kTempSpace].get_space<xpu>(
+        Shape1(static_cast<index_t>(rows) * tile + 2 * rows), s);
+    real_t *S = workspace.dptr_, *m = S + static_cast<size_t>(rows) * tile, *l = m + rows;
+    const real_t scale = 1 / std::sqrt(static_cast<real_t>(p.D));
+    for (p.t0 = 0; p.t0 < p.Tk; p.t0 += tile) {
+      p.n = std::min(tile, p.Tk - p.t0);
+      const bool first = p.t0 == 0;
+      // S = Q K_tile^T / sqrt(d)
+      gemm::StridedBatchGemm(s, false, true, p.B, p.Tq, p.n, p.D, scale,
+                             Q, p.D, static_cast<size_t>(p.Tq) * p.D,
+                             K + static_cast<size_t>(p.t0) * p.D, p.D,
+                             static_cast<size_t>(p.Tk) * p.D,
+                             real_t(0), S, p.n, static_cast<size_t>(p.Tq) * p.n);
+      SoftmaxTile(s, p, first, S, m, l, O);
+      // O = O * alpha + P V_tile
+      gemm::StridedBatchGemm(s, false, false, p.B, p.Tq, p.Dv, p.n, real_t(1),
+                             S, p.n, static_cast<size_t>(p.Tq) * p.n,
+                             V + static_cast<size_t>(p.t0) * p.Dv, p.Dv,
+                             static_cast<size_t>(p.Tk) * p.Dv,
+                             real_t(first ? 0 : 1), O, p.Dv, static_cast<size_t>(p.Tq) * p.Dv);
+    }
+    FinishOutput(s, rows, p.Dv, m, l, O, lse);
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    using namespace attention;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    TileShape p = this->GetShape(in_data);
+    if (param_.use_length && req[kLength] != kNullOp) {
+      Tensor<xpu, 1> glen = in_grad[kLength].get<xpu, 1, real_t>(s);
+      Assign(glen, req[kLength], 0);
+    }
+    const bool need_q = req[kQuery] != kNullOp, need_k = req[kKey] != kNullOp;
+    const bool need_v = req[kValue] != kNullOp;
+    if (!need_q && !need_k && !need_v) return;
+    const real_t *Q = in_data[kQuery].dptr<real_t>();
+    const real_t *K = in_data[kKey].dptr<real_t>();
+    const real_t *V = in_data[kValue].dptr<real_t>();
+    const real_t *O = out_data[kOut].dptr<real_t>();
+    const real_t *lse = out_data[kLse].dptr<real_t>();
+    const real_t *dO = out_grad[kOut].dptr<real_t>();
+    real_t *dQ = in_grad[kQuery].dptr<real_t>();
+    real_t *dK = in_grad[kKey].dptr<real_t>();
+    real_t *dV = in_grad[kValue].dptr<real_t>();
+    const int rows = p.B * p.Tq, tile = std::min(kTile, p.Tk);
+    const size_t tile_size = static_cast<size_t>(rows) * tile;
+    Tensor<xpu, 1> workspace = ctx.requested[kTempSpace].get_space<xpu>(
+        Shape1(2 * tile_size + rows), s);
+    real_t *P = workspace.dptr_, *dP = P + tile_size, *dot = dP + tile_size;
+    const real_t scale = 1 / std::sqrt(static_cast<real_t>(p.D));
+    const size_t sq = static_cast<size_t>(p.Tq) * p.D, sk = static_cast<size_t>(p.Tk) * p.D;
+    const size_t so = static_cast<size_t>(p.Tq) * p.Dv, sv = static_cast<size_t>(p.Tk) * p.Dv;
+    // the sum of dO * O of each query, the softmax gradient subtracts it from dP
+    if (need_q || need_k) RowDot(s, rows, p.Dv, dO, O, dot);
+    for (p.t0 = 0; p.t0 < p.Tk; p.t0 += tile) {
+      p.n = std::min(tile, p.Tk - p.t0);
+      const size_t st = static_cast<size_t>(p.Tq) * p.n;
+      const real_t *Kt = K + static_cast<size_t>(p.t0) * p.D;
+      gemm::StridedBatchGemm(s, false, true, p.B, p.Tq, p.n, p.D, scale,
+                             Q, p.D, sq, Kt, p.D, sk, real_t(0), P, p.n, st);
+      ProbTile(s, p, lse, P);
+      if (need_v) {
+        // dV_tile = P^T dO
+        gemm::StridedBatchGemm(s, true, false, p.B, p.n, p.Dv, p.Tq, real_t(1),
+                               P, p.n, st, dO, p.Dv, so,
+                               real_t(req[kValue] == kAddTo ? 1 : 0),
+                               dV + static_cast<size_t>(p.t0) * p.Dv, p.Dv, sv);
+      }
+      if (!need_q && !need_k) continue;
+      // dP = dO V_tile^T, then dS
+      gemm::StridedBatchGemm(s, false, true, p.B, p.Tq, p.n, p.Dv, real_t(1),
+                             dO, p.Dv, so, V + static_cast<size_t>(p.t0) * p.Dv, p.Dv, sv,
+                             real_t(0), dP, p.n, st);
+      GradTile(s, p, P, dot, scale, dP);
+      if (need_q) {
+        // dQ += dS K_tile
+        const bool accumulate = p.t0 != 0 || req[kQuery] == kAddTo;
+        gemm::StridedBatchGemm(s, false, false, p.B, p.Tq, p.D, p.n, real_t(1),
+                               dP, p.n, st, Kt, p.D, sk,
+                               real_t(accumulate ? 1 : 0), dQ, p.D, sq);
+      }
+      if (need_k) {
+        // dK_tile = dS^T Q
+        gemm::StridedBatchGemm(s, true, false, p.B, p.n, p.D, p.Tq, real_t(1),
+                               dP, p.n, st, Q, p.D, sq,
+                               real_t(req[kKey] == kAddTo ? 1 : 0),
+                               dK + static_cast<size_t>(p.t0) * p.D, p.D, sk);
+      }
+    }
+  }
+
+ private:
+  inline attention::TileShape GetShape(const std::vector<TBlob> &in_data) const {
+    using namespace attention;
+    const TShape &qshape = in_data[kQuery].shape_, &vshape = in_data[kValue].shape_;
+    TileShape p;
+    p.B = qshape[0];
+    p.Tq = qshape[1];
+    p.D = qshape[2];
+    p.Tk = vshape[1];
+    p.Dv = vshape[2];
+    p.t0 = p.n = 0;
+    p.length = param_.use_length ? in_data[kLength].dptr<real_t>() : nullptr;
+    p.causal = param_.causal;
+    return p;
+  }
+  AttentionParam param_;
+};  // class AttentionOp
+
+template<typename xpu>
+Operator *CreateOp(AttentionParam param);
+
+#if DMLC_USE_CXX11
+class AttentionProp : public OperatorProperty {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  std::vector<std::string> ListArguments() const override {
+    if (param_.use_length) return {"query", "key", "value", "length"};
+    return {"query", "key", "value"};
+  }
+
+  std::vector<std::string> ListOutputs() const override {
+    return {"output", "lse"};
+  }
+
+  int NumVisibleOutputs() const override {
+    return 1;
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    using namespace mshadow;
+    using namespace attention;
+    CHECK_EQ(in_shape->size(), param_.use_length ? 4U : 3U);
+    const TShape &qshape = in_shape->at(kQuery);
+    const TShape &kshape = in_shape->at(kKey);
+    const TShape &vshape = in_shape->at(kValue);
+    if (qshape.ndim() == 0 || kshape.ndim() == 0 || vshape.ndim() == 0) return false;
+    CHECK_EQ(qshape.ndim(), 3U) << "query must be (batch, queries, dim)";
+    CHECK_EQ(kshape.ndim(), 3U) << "key must be (batch, keys, dim)";
+    CHECK_EQ(vshape.ndim(), 3U) << "value must be (batch, keys, value dim)";
+    CHECK(kshape[0] == qshape[0] && kshape[2] == qshape[2])
+        << "key " << kshape << " does not match query " << qshape;
+    CHECK(vshape[0] == kshape[0] && vshape[1] == kshape[1])
+        << "value " << vshape << " does not match key " << kshape;
+    if (param_.use_length) SHAPE_ASSIGN_CHECK(*in_shape, kLength, Shape1(qshape[0]));
+    out_shape->clear();
+    out_shape->push_back(Shape3(qshape[0], qshape[1], vshape[2]));
+    out_shape->push_back(Shape2(qshape[0], qshape[1]));
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new AttentionProp();
+    ptr->param_ = param_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "DotProductAttention";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    std::vector<int> dep = {out_grad[attention::kOut], out_data[attention::kOut],
+                            out_data[attention::kLse], in_data[attention::kQuery],
+                            in_data[attention::kKey], in_data[attention::kValue]};
+    if (param_.use_length) dep.push_back(in_data[attention::kLength]);
+    return dep;
+  }
+
+  std::vector<ResourceRequest> ForwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace};
+  }
+
+  std::vector<ResourceRequest> BackwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace};
+  }
+
+  Operator* CreateOperator(Context ctx) const override;
+
+ private:
+  AttentionParam param_;
+};  // class AttentionProp
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_ATTENTION_INL_H_
@@ -0,0 +1,29 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file attention.cc
+ * \brief scaled dot product attention operator
+*/
+#include "./attention-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<cpu>(AttentionParam param) {
+  return new AttentionOp<cpu>(param);
+}
+
+Operator *AttentionProp::CreateOperator(Context ctx) const {
+  DO_BIND_DISPATCH(CreateOp, param_);
+}
+
+DMLC_REGISTER_PARAMETER(AttentionParam);
+
+MXNET_REGISTER_OP_PROPERTY(DotProductAttention, AttentionProp)
+.describe("Scaled dot product attention, softmax(query key^T / sqrt(dim)) value per instance, "
+          "computed over tiles of the keys without storing all the scores. Only float32.")
+.add_argument("query", "Symbol", "Queries of shape (batch, queries, dim)")
+.add_argument("key", "Symbol", "Keys of shape (batch, keys, dim)")
+.add_argument("value", "Symbol", "Values of shape (batch, keys, value dim)")
+.add_argument("length", "Symbol", "Number of valid keys of each instance, with use_length")
+.add_arguments(AttentionParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
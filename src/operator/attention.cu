@@ -0,0 +1,14 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file attention.cu
+ * \brief scaled dot product attention operator
+*/
+#include "./attention-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<gpu>(AttentionParam param) {
+  return new AttentionOp<gpu>(param);
+}
+}  // namespace op
+}  // namespace mxnet
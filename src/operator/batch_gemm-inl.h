@@ -0,0 +1,207 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file batch_gemm-inl.h
+ * \brief batched matrix product of row-major matrices, used by dot, batch_dot and
+ *  the tiles of DotProductAttention.
+ *
+ *  On gpu the whole batch is one strided batched cuBLAS call, with half precision
+ *  matrices accumulated in float. On cpu a batch of small products runs one product per
+ *  OpenMP thread, larger products leave the threads to BLAS. BLAS has no half precision
+ *  product on cpu, it is computed with float accumulators.
+ */
+#ifndef MXNET_OPERATOR_BATCH_GEMM_INL_H_
+#define MXNET_OPERATOR_BATCH_GEMM_INL_H_
+
+#include <dmlc/logging.h>
+#include <mshadow/tensor.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <vector>
+#if MXNET_USE_CUDA
+#include "../common/cuda_utils.h"
+#endif  // MXNET_USE_CUDA
+
+namespace mxnet {
+namespace op {
+namespace gemm {
+/*! \brief a product of fewer multiply-adds than this does not use the threads of BLAS */
+const index_t kSmallWork = 1 << 18;
+
+/*!
+ * \brief C = alpha * op(A) * op(B) + beta * C for row-major C of (M, N) and the inner
+ *  dim K, op(A) is the transpose of A when ta, so that A is (M, K) or (K, M).
+ */
+template<typename DType>
+inline void Gemm(mshadow::Stream<cpu> *s, bool ta, bool tb, int M, int N, int K,
+                 DType alpha, const DType *A, const DType *B, DType beta, DType *C) {
+  // row-major C = op(A) op(B) is column-major C^T = op(B)^T op(A)^T
+  mshadow::BLASEngine<cpu, DType>::gemm(s, tb, ta, N, M, K, alpha, B, tb ? K : N,
+                                        A, ta ? M : K, beta, C, N);
+}
+
+template<>
+inline void Gemm<mshadow::half::half_t>(mshadow::Stream<cpu> *s, bool ta, bool tb,
+                                        int M, int N, int K, mshadow::half::half_t alpha,
+                                        const mshadow::half::half_t *A,
+                                        const mshadow::half::half_t *B,
+                                        mshadow::half::half_t beta,
+                                        mshadow::half::half_t *C) {
+  const float a = alpha, b = beta;
+  std::vector<float> row(N);
+  for (int i = 0; i < M; ++i) {
+    std::fill(row.begin(), row.end(), 0.0f);
+    for (int k = 0; k < K; ++k) {
+      const float x = A[ta ? k * M + i : i * K + k];
+      if (tb) {
+        for (int j = 0; j < N; ++j) row[j] += x * static_cast<float>(B[j * K + k]);
+      } else {
+        const mshadow::half::half_t *r = B + k * N;
+        for (int j = 0; j < N; ++j) row[j] += x * static_cast<float>(r[j]);
+      }
+    }
+    mshadow::half::half_t *c = C + i * N;
+    for (int j = 0; j < N; ++j) {
+      const float prev = b == 0.0f ? 0.0f : b * static_cast<float>(c[j]);
+      c[j] = mshadow::half::half_t(a * row[j] + prev);
+    }
+  }
+}
+
+/*! \brief C[i] = alpha * op(A[i]) * op(B[i]) + beta * C[i] for i < batch */
+template<typename DType>
+inline void BatchGemm(mshadow::Stream<cpu> *s, bool ta, bool tb, int batch,
+                      int M, int N, int K, DType alpha, const DType *A, const DType *B,
+                      DType beta, DType *C) {
+  const size_t sa = static_cast<size_t>(M) * K, sb = static_cast<size_t>(K) * N;
+  const size_t sc = static_cast<size_t>(M) * N;
+  if (batch > 1 && static_cast<index_t>(M) * N * K < kSmallWork) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < batch; ++i) {
+      Gemm(s, ta, tb, M, N, K, alpha, A + i * sa, B + i * sb, beta, C + i * sc);
+    }
+  } else {
+    for (int i = 0; i < batch; ++i) {
+      Gemm(s, ta, tb, M, N, K, alpha, A + i * sa, B + i * sb, beta, C + i * sc);
+    }
+  }
+}
+
+/*!
+ * \brief BatchGemm of matrices with explicit leading dims and batch strides, such as
+ *  tiles of rows of larger matrices. lda, ldb and ldc are the row lengths of the
+ *  matrices as stored. There is no half precision version.
+ */
+template<typename DType>
+inline void StridedBatchGemm(mshadow::Stream<cpu> *s, bool ta, bool tb, int batch,
+                             int M, int N, int K, DType alpha,
+                             const DType *A, int lda, size_t stride_a,
+                             const DType *B, int ldb, size_t stride_b,
+                             DType beta, DType *C, int ldc, size_t stride_c) {
+  auto gemm = [=](int i) {
+    mshadow::BLASEngine<cpu, DType>::gemm(s, tb, ta, N, M, K, alpha, B + i * stride_b, ldb,
+                                          A + i * stride_a, lda, beta, C + i * stride_c, ldc);
+  };
+  if (batch > 1 && static_cast<index_t>(M) * N * K < kSmallWork) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < batch; ++i) gemm(i);
+  } else {
+    for (int i = 0; i < batch; ++i) gemm(i);
+  }
+}
+
+#ifdef __CUDACC__
+inline void StridedBatchGemm(mshadow::Stream<gpu> *s, bool ta, bool tb, int batch,
+                             int M, int N, int K, float alpha,
+                             const float *A, int lda, size_t stride_a,
+                             const float *B, int ldb, size_t stride_b,
+                             float beta, float *C, int ldc, size_t stride_c) {
+  cublasHandle_t handle = mshadow::Stream<gpu>::GetBlasHandle(s);
+  const cublasOperation_t opa = ta ? CUBLAS_OP_T : CUBLAS_OP_N;
+  const cublasOperation_t opb = tb ? CUBLAS_OP_T : CUBLAS_OP_N;
+#if CUDA_VERSION >= 8000
+  CUBLAS_CALL(cublasSgemmStridedBatched(handle, opb, opa, N, M, K, &alpha,
+                                        B, ldb, static_cast<int64_t>(stride_b),
+                                        A, lda, static_cast<int64_t>(stride_a),
+                                        &beta, C, ldc, static_cast<int64_t>(stride_c), batch));
+#else
+  for (int i = 0; i < batch; ++i) {
+    CUBLAS_CALL(cublasSgemm(handle, opb, opa, N, M, K, &alpha, B + i * stride_b, ldb,
+                            A + i * stride_a, lda, &beta, C + i * stride_c, ldc));
+  }
+#endif  // CUDA_VERSION >= 8000
+}
+
+inline void BatchGemm(mshadow::Stream<gpu> *s, bool ta, bool tb, int batch,
+                      int M, int N, int K, float alpha, const float *A, const float *B,
+                      float beta, float *C) {
+  cublasHandle_t handle = mshadow::Stream<gpu>::GetBlasHandle(s);
+  const cublasOperation_t opa = ta ? CUBLAS_OP_T : CUBLAS_OP_N;
+  const cublasOperation_t opb = tb ? CUBLAS_OP_T : CUBLAS_OP_N;
+#if CUDA_VERSION >= 8000
+  CUBLAS_CALL(cublasSgemmStridedBatched(handle, opb, opa, N, M, K, &alpha,
+                                        B, tb ? K : N, static_cast<int64_t>(K) * N,
+                                        A, ta ? M : K, static_cast<int64_t>(M) * K,
+                                        &beta, C, N, static_cast<int64_t>(M) * N, batch));
+#else
+  for (int i = 0; i < batch; ++i) {
+    CUBLAS_CALL(cublasSgemm(handle, opb, opa, N, M, K, &alpha,
+                            B + static_cast<size_t>(i) * K * N, tb ? K : N,
+                            A + static_cast<size_t>(i) * M * K, ta ? M : K,
+                            &beta, C + static_cast<size_t>(i) * M * N, N));
+  }
+#endif  // CUDA_VERSION >= 8000
+}
+
+inline void BatchGemm(mshadow::Stream<gpu> *s, bool ta, bool tb, int batch,
+                      int M, int N, int K, double alpha, const double *A, const double *B,
+                      double beta, double *C) {
+  cublasHandle_t handle = mshadow::Stream<gpu>::GetBlasHandle(s);
+  const cublasOperation_t opa = ta ? CUBLAS_OP_T : CUBLAS_OP_N;
+  const cublasOperation_t opb = tb ? CUBLAS_OP_T : CUBLAS_OP_N;
+#if CUDA_VERSION >= 8000
+  CUBLAS_CALL(cublasDgemmStridedBatched(handle, opb, opa, N, M, K, &alpha,
+                                        B, tb ? K : N, static_cast<int64_t>(K) * N,
+                                        A, ta ? M : K, static_cast<int64_t>(M) * K,
+                                        &beta, C, N, static_cast<int64_t>(M) * N, batch));
+#else
+  for (int i = 0; i < batch; ++i) {
+    CUBLAS_CALL(cublasDgemm(handle, opb, opa, N, M, K, &alpha,
+                            B + static_cast<size_t>(i) * K * N, tb ? K : N,
+                            A + static_cast<size_t>(i) * M * K, ta ? M : K,
+                            &beta, C + static_cast<size_t>(i) * M * N, N));
+  }
+#endif  // CUDA_VERSION >= 8000
+}
+
+inline void BatchGemm(mshadow::Stream<gpu> *s, bool ta, bool tb, int batch,
+                      int M, int N, int K, mshadow::half::half_t alpha,
+                      const mshadow::half::half_t *A, const mshadow::half::half_t *B,
+                      mshadow::half::half_t beta, mshadow::half::half_t *C) {
+  cublasHandle_t handle = mshadow::Stream<gpu>::GetBlasHandle(s);
+  const cublasOperation_t opa = ta ? CUBLAS_OP_T : CUBLAS_OP_N;
+  const cublasOperation_t opb = tb ? CUBLAS_OP_T : CUBLAS_OP_N;
+  // the products are accumulated in float
+  const float a = alpha, b = beta;
+#if CUDA_VERSION >= 9000
+  CUBLAS_CALL(cublasGemmStridedBatchedEx(handle, opb, opa, N, M, K, &a,
+                                         B, CUDA_R_16F, tb ? K : N,
+                                         static_cast<int64_t>(K) * N,
+                                         A, CUDA_R_16F, ta ? M : K,
+                                         static_cast<int64_t>(M) * K,
+                                         &b, C, CUDA_R_16F, N,
+                                         static_cast<int64_t>(M) * N, batch,
+                                         CUDA_R_32F, CUBLAS_GEMM_DFALT));
+#else
+  for (int i = 0; i < batch; ++i) {
+    CUBLAS_CALL(cublasSgemmEx(handle, opb, opa, N, M, K, &a,
+                              B + static_cast<size_t>(i) * K * N, CUDA_R_16F, tb ? K : N,
+                              A + static_cast<size_t>(i) * M * K, CUDA_R_16F, ta ? M : K,
+                              &b, C + static_cast<size_t>(i) * M * N, CUDA_R_16F, N));
+  }
+#endif  // CUDA_VERSION >= 9000
+}
+#endif  // __CUDACC__
+}  // namespace gemm
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_BATCH_GEMM_INL_H_
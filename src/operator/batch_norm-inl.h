@@ -10,7 +10,11 @@
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
 #include <mxnet/operator.h>
+#include <algorithm>
+#include <condition_variable>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <utility>
@@ -32,6 +36,8 @@ struct BatchNormParam : public dmlc::Parameter<BatchNormParam> {
   float momentum;
   bool fix_gamma;
   bool use_global_stats;
+  int ndev;
+  std::string key;
   DMLC_DECLARE_PARAMETER(BatchNormParam) {
     DMLC_DECLARE_FIELD(eps).set_default(1e-3f)
     .describe("Epsilon to prevent div 0");
@@ -42,9 +48,195 @@ struct BatchNormParam : public dmlc::Parameter<BatchNormParam> {
     DMLC_DECLARE_FIELD(use_global_stats).set_default(false)
     .describe("Whether use global moving statistics instead of local batch-norm. "
               "This will force change batch-norm into a scale shift operator.");
+    DMLC_DECLARE_FIELD(ndev).set_default(1).set_lower_bound(1)
+    .describe("Number of devices of the data parallel group whose batch statistics are "
+              "reduced together when training. The executors of all the devices must run "
+              "concurrently, which needs the threaded engine.");
+    DMLC_DECLARE_FIELD(key).set_default("")
+    .describe("Key shared by the BatchNorm of all the devices of a group, unique for each "
+              "layer, required when ndev > 1.");
   }
 };
 
+namespace batchnorm {
+/*! \brief number of elements whose mean is taken before merging into the running statistics */
+const int kStatBlock = 512;
+
+/*!
+ * \brief merge (count, mean, m2) of a part into the statistics of another,
+ *  m2 is the sum of the squared deviations from the mean.
+ */
+MSHADOW_XINLINE void WelfordMerge(real_t *count, real_t *mean, real_t *m2,
+                                  real_t count_b, real_t mean_b, real_t m2_b) {
+  const real_t n = *count + count_b;
+  if (n == 0) return;
+  const real_t delta = mean_b - *mean;
+  *mean += delta * count_b / n;
+  *m2 += m2_b + delta * delta * *count * count_b / n;
+  *count = n;
+}
+
+/*!
+ * \brief mean and biased variance of each channel of data (N, C, HW) in one pass,
+ *  parallel over the channels. Each block of the plane is summed while it is in cache
+ *  and merged into the running statistics.
+ */
+inline void ChannelStats(mshadow::Stream<cpu> *s, const real_t *data, int N, int C, int HW,
+                         real_t *mean, real_t *var) {
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < C; ++c) {
+    real_t count = 0, m = 0, m2 = 0;
+    for (int n = 0; n < N; ++n) {
+      const real_t *x = data + (static_cast<size_t>(n) * C + c) * HW;
+      for (int begin = 0; begin < HW; begin += kStatBlock) {
+        const int len = std::min(kStatBlock, HW - begin);
+        real_t sum = 0, sq = 0;
+        for (int i = 0; i < len; ++i) sum += x[begin + i];
+        const real_t mb = sum / len;
+        for (int i = 0; i < len; ++i) sq += (x[begin + i] - mb) * (x[begin + i] - mb);
+        WelfordMerge(&count, &m, &m2, len, mb, sq);
+      }
+    }
+    mean[c] = m;
+    var[c] = count > 0 ? m2 / count : 0;
+  }
+}
+
+/*! \brief sum of grad and of grad * (data - mean) of each channel in one pass */
+inline void ChannelGradSums(mshadow::Stream<cpu> *s, const real_t *grad, const real_t *data,
+                            const real_t *mean, int N, int C, int HW,
+                            real_t *sum_g, real_t *sum_gx) {
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < C; ++c) {
+    real_t sg = 0, sgx = 0;
+    const real_t m = mean[c];
+    for (int n = 0; n < N; ++n) {
+      const size_t offset = (static_cast<size_t>(n) * C + c) * HW;
+      const real_t *g = grad + offset, *x = data + offset;
+      for (int i = 0; i < HW; ++i) {
+        sg += g[i];
+        sgx += g[i] * (x[i] - m);
+      }
+    }
+    sum_g[c] = sg;
+    sum_gx[c] = sgx;
+  }
+}
+
+#ifdef __CUDACC__
+/*! \brief one block per channel, the threads merge their Welford statistics */
+__global__ void ChannelStatsKernel(const real_t *data, int N, int C, int HW,
+                                   real_t *mean, real_t *var) {
+  __shared__ real_t scount[mshadow::cuda::kBaseThreadNum];
+  __shared__ real_t smean[mshadow::cuda::kBaseThreadNum];
+  __shared__ real_t sm2[mshadow::cuda::kBaseThreadNum];
+  for (int c = blockIdx.x; c < C; c += gridDim.x) {
+    real_t count = 0, m = 0, m2 = 0;
+    for (int j = threadIdx.x; j < N * HW; j += blockDim.x) {
+      const real_t x = data[(static_cast<size_t>(j / HW) * C + c) * HW + j % HW];
+      count += 1;
+      const real_t delta = x - m;
+      m += delta / count;
+      m2 += delta * (x - m);
+    }
+    scount[threadIdx.x] = count;
+    smean[threadIdx.x] = m;
+    sm2[threadIdx.x] = m2;
+    __syncthreads();
+    for (int offset = blockDim.x / 2; offset > 0; offset >>= 1) {
+      if (threadIdx.x < offset) {
+        WelfordMerge(&scount[threadIdx.x], &smean[threadIdx.x], &sm2[threadIdx.x],
+                     scount[threadIdx.x + offset], smean[threadIdx.x + offset],
+                     sm2[threadIdx.x + offset]);
+      }
+      __syncthreads();
+    }
+    if (threadIdx.x == 0) {
+      mean[c] = smean[0];
+      var[c] = scount[0] > 0 ? sm2[0] / scount[0] : 0;
+    }
+    __syncthreads();
+  }
+}
+
+__global__ void ChannelGradSumsKernel(const real_t *grad, const real_t *data, const real_t *mean,
+                                      int N, int C, int HW, real_t *sum_g, real_t *sum_gx) {
+  __shared__ real_t sg[mshadow::cuda::kBaseThreadNum];
+  __shared__ real_t sgx[mshadow::cuda::kBaseThreadNum];
+  for (int c = blockIdx.x; c < C; c += gridDim.x) {
+    real_t g_acc = 0, gx_acc = 0;
+    const real_t m = mean[c];
+    for (int j = threadIdx.x; j < N * HW; j += blockDim.x) {
+      const size_t i = (static_cast<size_t>(j / HW) * C + c) * HW + j % HW;
+      g_acc += grad[i];
+      gx_acc += grad[i] * (data[i] - m);
+    }
+    sg[threadIdx.x] = g_acc;
+    sgx[threadIdx.x] = gx_acc;
+    __syncthreads();
+    for (int offset = blockDim.x / 2; offset > 0; offset >>= 1) {
+      if (threadIdx.x < offset) {
+        sg[threadIdx.x] += sg[threadIdx.x + offset];
+        sgx[threadIdx.x] += sgx[threadIdx.x + offset];
+      }
+      __syncthreads();
+    }
+    if (threadIdx.x == 0) {
+      sum_g[c] = sg[0];
+      sum_gx[c] = sgx[0];
+    }
+    __syncthreads();
+  }
+}
+
+inline void ChannelStats(mshadow::Stream<gpu> *s, const real_t *data, int N, int C, int HW,
+                         real_t *mean, real_t *var) {
+  using namespace mshadow::cuda;
+  ChannelStatsKernel<<<std::min(C, kMaxGridNum), kBaseThreadNum, 0,
+                       mshadow::Stream<gpu>::GetStream(s)>>>(data, N, C, HW, mean, var);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+inline void ChannelGradSums(mshadow::Stream<gpu> *s, const real_t *grad, const real_t *data,
+                            const real_t *mean, int N, int C, int HW,
+                            real_t *sum_g, real_t *sum_gx) {
+  using namespace mshadow::cuda;
+  ChannelGradSumsKernel<<<std::min(C, kMaxGridNum), kBaseThreadNum, 0,
+                          mshadow::Stream<gpu>::GetStream(s)>>>(
+      grad, data, mean, N, C, HW, sum_g, sum_gx);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace batchnorm
+
+/*!
+ * \brief the BatchNorm of the devices of a data parallel group, which reduce their
+ *  statistics together. Each device calls AllReduce and blocks until all have.
+ */
+class BatchNormSyncGroup {
+ public:
+  /*! \brief get the group of key, created by the first device */
+  static std::shared_ptr<BatchNormSyncGroup> Get(const std::string &key, int ndev);
+  /*!
+   * \brief reduce data of all the devices.
+   * \param data the vector to reduce, replaced by the result.
+   * \param welford whether data is (count, mean[C], m2[C]) merged as statistics,
+   *  or summed otherwise.
+   */
+  void AllReduce(std::vector<real_t> *data, bool welford);
+
+ private:
+  explicit BatchNormSyncGroup(int ndev) : ndev_(ndev), arrived_(0), generation_(0) {}
+  int ndev_;
+  int arrived_;
+  uint64_t generation_;
+  std::vector<real_t> acc_, result_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
 template<typename xpu>
 class BatchNormOp : public Operator {
  public:
@@ -71,8 +263,6 @@ class BatchNormOp : public Operator {
     }
 
     Stream<xpu> *s = ctx.get_stream<xpu>();
-    const real_t scale = static_cast<real_t>(in_data[batchnorm::kData].shape_[1]) /
-                         static_cast<real_t>(in_data[batchnorm::kData].shape_.Size());
     Tensor<xpu, 4> data;
     Tensor<xpu, 4> out;
     if (in_data[batchnorm::kData].ndim() == 2) {
@@ -97,14 +287,21 @@ class BatchNormOp : public Operator {
       Tensor<xpu, 1> var = out_data[batchnorm::kVar].get<xpu, 1, real_t>(s);
       CHECK(req[batchnorm::kMean] == kNullOp || req[batchnorm::kMean] == kWriteTo);
       CHECK(req[batchnorm::kVar] == kNullOp || req[batchnorm::kVar] == kWriteTo);
-      // The first three steps must be enforced.
-      mean = scale * sumall_except_dim<1>(data);
-      var = scale * sumall_except_dim<1>(F<mshadow_op::square>(
-          data - broadcast<1>(mean, data.shape_)));
-      Assign(out, req[batchnorm::kOut], broadcast<1>(slope, out.shape_) *
-             (data - broadcast<1>(mean, data.shape_)) /
-             F<mshadow_op::square_root>(broadcast<1>(var + param_.eps, data.shape_)) +
-             broadcast<1>(bias, out.shape_));
+      const int C = data.size(1), HW = data.size(2) * data.size(3);
+      batchnorm::ChannelStats(s, data.dptr_, data.size(0), C, HW, mean.dptr_, var.dptr_);
+      if (param_.ndev > 1) {
+        real_t count = static_cast<real_t>(data.size(0)) * HW;
+        this->AllReduce(s, mean, var, &count, true);
+      }
+      // out = a * data + b in the second and last pass over data
+      Tensor<xpu, 2> workspace = ctx.requested[batchnorm::kTempSpace].get_space<xpu>(
+          mshadow::Shape2(2, C), s);
+      Tensor<xpu, 1> a = workspace[0];
+      Tensor<xpu, 1> b = workspace[1];
+      a = slope / F<mshadow_op::square_root>(var + param_.eps);
+      b = bias - mean * a;
+      Assign(out, req[batchnorm::kOut],
+             broadcast<1>(a, data.shape_) * data + broadcast<1>(b, data.shape_));
     } else {
       Assign(out, req[batchnorm::kOut], broadcast<1>(slope /
                                           F<mshadow_op::square_root>(moving_var + param_.eps),
@@ -129,8 +326,6 @@ class BatchNormOp : public Operator {
     CHECK_EQ(in_grad.size(), 3);
     Stream<xpu> *s = ctx.get_stream<xpu>();
     Tensor<xpu, 4> data, grad, grad_in;
-    const real_t scale = static_cast<real_t>(out_grad[batchnorm::kOut].shape_[1]) /
-                         static_cast<real_t>(out_grad[batchnorm::kOut].shape_.Size());
     if (in_data[batchnorm::kData].ndim() == 2) {
       Shape<4> dshape = Shape4(out_grad[batchnorm::kOut].shape_[0],
                                out_grad[batchnorm::kOut].shape_[1], 1, 1);
@@ -155,41 +350,41 @@ class BatchNormOp : public Operator {
 
     if (ctx.is_train && !param_.use_global_stats) {
       // get requested temp space
+      const int C = data.size(1), HW = data.size(2) * data.size(3);
       Tensor<xpu, 2> workspace = ctx.requested[batchnorm::kTempSpace].get_space<xpu>(
-          mshadow::Shape2(3, mean.shape_[0]), s);
-      Tensor<xpu, 1> gmean = workspace[0];
-      Tensor<xpu, 1> gvar = workspace[1];
-      Tensor<xpu, 1> tmp = workspace[2];
+          mshadow::Shape2(6, C), s);
+      Tensor<xpu, 1> sum_g = workspace[0];
+      Tensor<xpu, 1> sum_gx = workspace[1];
+      Tensor<xpu, 1> invstd = workspace[2];
+      Tensor<xpu, 1> k_grad = workspace[3];
+      Tensor<xpu, 1> k_data = workspace[4];
+      Tensor<xpu, 1> k_bias = workspace[5];
 
       moving_mean = moving_mean * param_.momentum + mean * (1 - param_.momentum);
       moving_var = moving_var * param_.momentum + var * (1 - param_.momentum);
-      // cal
-      gvar = sumall_except_dim<1>((grad * broadcast<1>(slope, data.shape_)) *
-                                  (data - broadcast<1>(mean, data.shape_)) *
-                                  -0.5f *
-                                  F<mshadow_op::power>(broadcast<1>(var + param_.eps, data.shape_),
-                                                       -1.5f));
-      gmean = sumall_except_dim<1>(grad * broadcast<1>(slope, data.shape_));
-      gmean *= -1.0f / F<mshadow_op::square_root>(var + param_.eps);
-      tmp = scale * sumall_except_dim<1>(-2.0f * (data - broadcast<1>(mean, data.shape_)));
-      tmp *= gvar;
-      gmean += tmp;
-      // assign
+      // the first pass sums grad and grad * (data - mean) of each channel
+      batchnorm::ChannelGradSums(s, grad.dptr_, data.dptr_, mean.dptr_,
+                                 data.size(0), C, HW, sum_g.dptr_, sum_gx.dptr_);
+      invstd = 1.0f / F<mshadow_op::square_root>(var + param_.eps);
       if (!param_.fix_gamma) {
-        Assign(gslope, req[batchnorm::kGamma],
-               sumall_except_dim<1>(
-                   grad * (data - broadcast<1>(mean, data.shape_)) /
-                   F<mshadow_op::square_root>(broadcast<1>(var + param_.eps, data.shape_))));
+        Assign(gslope, req[batchnorm::kGamma], sum_gx * invstd);
       } else {
         Assign(gslope, req[batchnorm::kGamma], 0.0f);
       }
+      Assign(gbias, req[batchnorm::kBeta], F<mshadow_op::identity>(sum_g));
+      real_t count = static_cast<real_t>(data.size(0)) * HW;
+      if (param_.ndev > 1) {
+        // the data gradient depends on the sums over all the devices
+        this->AllReduce(s, sum_g, sum_gx, &count, false);
+      }
+      // the second pass: grad_in = k_grad * grad + k_data * data + k_bias
+      k_grad = slope * invstd;
+      k_data = k_grad * invstd * invstd * sum_gx * (-1.0f / count);
+      k_bias = k_grad * sum_g * (-1.0f / count) - k_data * mean;
       Assign(grad_in, req[batchnorm::kData],
-             (grad * broadcast<1>(slope, data.shape_)) *
-             broadcast<1>(1.0f / F<mshadow_op::square_root>(var + param_.eps), data.shape_) +
-             broadcast<1>(gvar, data.shape_) * scale * 2.0f * (data - broadcast<1>(mean,
-                                                                                   data.shape_)) +
-             broadcast<1>(gmean, data.shape_) * scale);
-      Assign(gbias, req[batchnorm::kBeta], sumall_except_dim<1>(grad));
+             broadcast<1>(k_grad, data.shape_) * grad +
+             broadcast<1>(k_data, data.shape_) * data +
+             broadcast<1>(k_bias, data.shape_));
     } else {
       // use global statistics with freeze moving mean and var.
       if (!param_.fix_gamma) {
@@ -207,7 +402,40 @@ class BatchNormOp : public Operator {
   }
 
  private:
+  /*!
+   * \brief reduce the statistics, or the sums, of all the devices of the group.
+   * \param first mean, or the first sums.
+   * \param second biased variance, or the second sums.
+   * \param count the local number of elements per channel, replaced by the total.
+   * \param welford whether to merge statistics, or sum otherwise.
+   */
+  inline void AllReduce(mshadow::Stream<xpu> *s, mshadow::Tensor<xpu, 1> first,
+                        mshadow::Tensor<xpu, 1> second, real_t *count, bool welford) {
+    using namespace mshadow;
+    const index_t C = first.size(0);
+    std::vector<real_t> data(1 + 2 * C);
+    data[0] = *count;
+    Tensor<cpu, 1> host_first(data.data() + 1, Shape1(C));
+    Tensor<cpu, 1> host_second(data.data() + 1 + C, Shape1(C));
+    Copy(host_first, first, s);
+    Copy(host_second, second, s);
+    s->Wait();
+    // variance to the sum of squared deviations
+    if (welford) host_second *= *count;
+    if (group_ == nullptr) {
+      CHECK_NE(param_.key, "") << "BatchNorm with ndev > 1 requires a key";
+      group_ = BatchNormSyncGroup::Get(param_.key, param_.ndev);
+    }
+    group_->AllReduce(&data, welford);
+    *count = data[0];
+    if (welford) host_second /= *count;
+    Copy(first, host_first, s);
+    Copy(second, host_second, s);
+    s->Wait();
+  }
+
   BatchNormParam param_;
+  std::shared_ptr<BatchNormSyncGroup> group_;
 };  // class BatchNormOp
 
 template<typename xpu>
@@ -268,6 +496,11 @@ class BatchNormProp : public OperatorProperty {
            };
   }
 
+  std::vector<ResourceRequest> ForwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace};
+  }
+
   std::vector<ResourceRequest> BackwardResource(
       const std::vector<TShape> &in_shape) const override {
     return {ResourceRequest::kTempSpace};
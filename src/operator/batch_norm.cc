@@ -14,6 +14,48 @@ Operator *CreateOp<cpu>(BatchNormParam param) {
   return new BatchNormOp<cpu>(param);
 }
 
+std::shared_ptr<BatchNormSyncGroup> BatchNormSyncGroup::Get(const std::string &key, int ndev) {
+  static std::mutex mutex;
+  static std::map<std::string, std::shared_ptr<BatchNormSyncGroup> > groups;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<BatchNormSyncGroup> &group = groups[key];
+  if (group == nullptr) {
+    group.reset(new BatchNormSyncGroup(ndev));
+  }
+  CHECK_EQ(group->ndev_, ndev) << "BatchNorm key " << key << " used with different ndev";
+  return group;
+}
+
+void BatchNormSyncGroup::AllReduce(std::vector<real_t> *data, bool welford) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (arrived_ == 0) {
+    acc_ = *data;
+  } else if (welford) {
+    CHECK_EQ(acc_.size(), data->size());
+    const size_t C = (data->size() - 1) / 2;
+    for (size_t c = 0; c < C; ++c) {
+      real_t count = acc_[0];
+      batchnorm::WelfordMerge(&count, &acc_[1 + c], &acc_[1 + C + c],
+                              (*data)[0], (*data)[1 + c], (*data)[1 + C + c]);
+    }
+    acc_[0] += (*data)[0];
+  } else {
+    CHECK_EQ(acc_.size(), data->size());
+    for (size_t i = 0; i < acc_.size(); ++i) acc_[i] += (*data)[i];
+  }
+  if (++arrived_ == ndev_) {
+    // the waiting devices of this round read result_ before the next round can complete
+    result_ = acc_;
+    arrived_ = 0;
+    ++generation_;
+    cv_.notify_all();
+  } else {
+    const uint64_t generation = generation_;
+    cv_.wait(lock, [this, generation] { return generation_ != generation; });
+  }
+  *data = result_;
+}
+
 Operator *BatchNormProp::CreateOperator(Context ctx) const {
   DO_BIND_DISPATCH(CreateOp, param_);
 }
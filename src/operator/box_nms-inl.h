@@ -0,0 +1,269 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file box_nms-inl.h
+ * \brief non-maximum suppression of the detections of each image of a batch.
+ *
+ *  The input is (..., N, K), the last two axes the N detections of an image,
+ *  each row holds the 4 corners at coord_start, the score at score_index and
+ *  optionally a class id at id_index. The output has the same shape, for each
+ *  image the kept rows by decreasing score, then rows of -1.
+ */
+#ifndef MXNET_OPERATOR_BOX_NMS_INL_H_
+#define MXNET_OPERATOR_BOX_NMS_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./operator_common.h"
+#include "./nms-inl.h"
+
+namespace mxnet {
+namespace op {
+
+namespace box_nms {
+enum BoxNMSOpInputs {kData};
+enum BoxNMSOpOutputs {kOut};
+enum BoxNMSForwardResource {kTempSpace};
+
+/*! \brief the box i of the rows of an image in the layout of nms */
+MSHADOW_XINLINE void PackBox(int i, const float *data, int K, int coord_start,
+                             int score_index, int id_index, float *boxes, float *keys,
+                             int *order) {
+  const float *row = data + i * K;
+  float *box = boxes + i * nms::kBoxSize;
+  for (int k = 0; k < 4; ++k) box[k] = row[coord_start + k];
+  box[4] = row[score_index];
+  box[5] = id_index >= 0 ? row[id_index] : 0.0f;
+  keys[i] = box[4];
+  order[i] = i;
+}
+
+/*!
+ * \brief the element i of the output rows of an image. The boxes under
+ *  valid_thresh are sorted last, they end the valid kept ones
+ */
+MSHADOW_XINLINE void OutputRow(int i, const float *data, int K, const float *sorted,
+                               const int *order, const int *keep, int num_keep,
+                               float valid_thresh, float *out) {
+  const int j = i / K;
+  if (j < num_keep && sorted[keep[j] * nms::kBoxSize + 4] >= valid_thresh) {
+    out[i] = data[order[keep[j]] * K + i % K];
+  } else {
+    out[i] = -1.0f;
+  }
+}
+
+inline void Pack(mshadow::Stream<cpu> *s, const float *data, int N, int K, int coord_start,
+                 int score_index, int id_index, float *boxes, float *keys, int *order) {
+  for (int i = 0; i < N; ++i) {
+    PackBox(i, data, K, coord_start, score_index, id_index, boxes, keys, order);
+  }
+}
+
+inline void Output(mshadow::Stream<cpu> *s, const float *data, int N, int K,
+                   const float *sorted, const int *order, const int *keep,
+                   const int *num_keep, float valid_thresh, float *out) {
+  for (int i = 0; i < N * K; ++i) {
+    OutputRow(i, data, K, sorted, order, keep, *num_keep, valid_thresh, out);
+  }
+}
+
+#ifdef __CUDACC__
+__global__ void PackKernel(const float *data, int N, int K, int coord_start, int score_index,
+                           int id_index, float *boxes, float *keys, int *order) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < N; i += blockDim.x * gridDim.x) {
+    PackBox(i, data, K, coord_start, score_index, id_index, boxes, keys, order);
+  }
+}
+
+__global__ void OutputKernel(const float *data, int N, int K, const float *sorted,
+                             const int *order, const int *keep, const int *num_keep,
+                             float valid_thresh, float *out) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < N * K;
+       i += blockDim.x * gridDim.x) {
+    OutputRow(i, data, K, sorted, order, keep, *num_keep, valid_thresh, out);
+  }
+}
+
+inline void Pack(mshadow::Stream<gpu> *s, const float *data, int N, int K, int coord_start,
+                 int score_index, int id_index, float *boxes, float *keys, int *order) {
+  PackKernel<<<nms::NumBlocks(N), mshadow::cuda::kBaseThreadNum, 0,
+               mshadow::Stream<gpu>::GetStream(s)>>>(
+      data, N, K, coord_start, score_index, id_index, boxes, keys, order);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+inline void Output(mshadow::Stream<gpu> *s, const float *data, int N, int K,
+                   const float *sorted, const int *order, const int *keep,
+                   const int *num_keep, float valid_thresh, float *out) {
+  OutputKernel<<<nms::NumBlocks(N * K), mshadow::cuda::kBaseThreadNum, 0,
+                 mshadow::Stream<gpu>::GetStream(s)>>>(
+      data, N, K, sorted, order, keep, num_keep, valid_thresh, out);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace box_nms
+
+struct BoxNMSParam : public dmlc::Parameter<BoxNMSParam> {
+  float overlap_thresh;
+  float valid_thresh;
+  int topk;
+  int coord_start;
+  int score_index;
+  int id_index;
+  bool pixel_coord;
+  DMLC_DECLARE_PARAMETER(BoxNMSParam) {
+    DMLC_DECLARE_FIELD(overlap_thresh).set_default(0.5f).set_range(0.0f, 1.0f)
+    .describe("Intersection over union above which a box is suppressed.");
+    DMLC_DECLARE_FIELD(valid_thresh).set_default(0.0f)
+    .describe("Boxes scored under valid_thresh are removed.");
+    DMLC_DECLARE_FIELD(topk).set_default(-1)
+    .describe("Number of the best scored boxes that go through NMS, <= 0 for all of them.");
+    DMLC_DECLARE_FIELD(coord_start).set_default(0).set_lower_bound(0)
+    .describe("Index of x1 in a row, the corners are x1, y1, x2, y2.");
+    DMLC_DECLARE_FIELD(score_index).set_default(4).set_lower_bound(0)
+    .describe("Index of the score in a row.");
+    DMLC_DECLARE_FIELD(id_index).set_default(-1)
+    .describe("Index of the class id in a row, only boxes of the same class suppress "
+              "each other. -1 to suppress regardless of the class.");
+    DMLC_DECLARE_FIELD(pixel_coord).set_default(false)
+    .describe("Whether the corners are pixels, a box then spans x2 - x1 + 1 pixels, "
+              "or normalized coordinates.");
+  }
+};
+
+template<typename xpu>
+class BoxNMSOp : public Operator {
+ public:
+  explicit BoxNMSOp(BoxNMSParam param) : param_(param) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    CHECK_EQ(in_data.size(), 1);
+    CHECK_EQ(out_data.size(), 1);
+    CHECK_EQ(req[box_nms::kOut], kWriteTo);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    const TShape &dshape = in_data[box_nms::kData].shape_;
+    const int K = dshape[dshape.ndim() - 1];
+    const int N = dshape[dshape.ndim() - 2];
+    const index_t batch = dshape.Size() / (N * K);
+    Tensor<xpu, 3> data = in_data[box_nms::kData].get_with_shape<xpu, 3, real_t>(
+        Shape3(batch, N, K), s);
+    Tensor<xpu, 3> out = out_data[box_nms::kOut].get_with_shape<xpu, 3, real_t>(
+        Shape3(batch, N, K), s);
+    const int pre = param_.topk > 0 ? std::min(param_.topk, N) : N;
+    const index_t mask_size = nms::MaskSize<xpu>(pre);
+    const index_t size = mask_size + (nms::kBoxSize + 2) * N + nms::kBoxSize * pre + pre + 1;
+    Tensor<xpu, 1> workspace = ctx.requested[box_nms::kTempSpace].get_space<xpu>(
+        Shape1(size), s);
+    float *mask = workspace.dptr_;
+    float *boxes = mask + mask_size;
+    float *keys = boxes + nms::kBoxSize * N;
+    int *order = reinterpret_cast<int*>(keys + N);
+    float *sorted = keys + 2 * N;
+    int *keep = reinterpret_cast<int*>(sorted + nms::kBoxSize * pre);
+    for (index_t b = 0; b < batch; ++b) {
+      box_nms::Pack(s, data[b].dptr_, N, K, param_.coord_start, param_.score_index,
+                    param_.id_index, boxes, keys, order);
+      nms::SortByScore(s, keys, order, N, pre);
+      nms::Gather(s, boxes, order, pre, sorted);
+      nms::Nms(s, sorted, pre, param_.overlap_thresh, param_.pixel_coord ? 1.0f : 0.0f,
+               pre, mask, keep, keep + pre);
+      box_nms::Output(s, data[b].dptr_, N, K, sorted, order, keep, keep + pre,
+                      param_.valid_thresh, out[b].dptr_);
+    }
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    CHECK_EQ(in_grad.size(), 1);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    // the detections are not differentiated
+    if (req[box_nms::kData] == kWriteTo) {
+      Tensor<xpu, 1> g = in_grad[box_nms::kData].FlatTo1D<xpu, real_t>(s);
+      g = 0.0f;
+    }
+  }
+
+ private:
+  BoxNMSParam param_;
+};  // class BoxNMSOp
+
+template<typename xpu>
+Operator *CreateOp(BoxNMSParam param);
+
+#if DMLC_USE_CXX11
+class BoxNMSProp : public OperatorProperty {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    CHECK_EQ(in_shape->size(), 1) << "Input:[data]";
+    const TShape &dshape = in_shape->at(box_nms::kData);
+    if (dshape.ndim() == 0) return false;
+    CHECK_GE(dshape.ndim(), 2) << "BoxNMS: data should be (..., num_boxes, row_size)";
+    const int K = dshape[dshape.ndim() - 1];
+    CHECK_LE(param_.coord_start + 4, K) << "BoxNMS: coord_start out of the rows";
+    CHECK_LT(param_.score_index, K) << "BoxNMS: score_index out of the rows";
+    CHECK_LT(param_.id_index, K) << "BoxNMS: id_index out of the rows";
+    out_shape->clear();
+    out_shape->push_back(dshape);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new BoxNMSProp();
+    ptr->param_ = param_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "BoxNMS";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    return {};
+  }
+
+  std::vector<ResourceRequest> ForwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace};
+  }
+
+  Operator* CreateOperator(Context ctx) const override;
+
+ private:
+  BoxNMSParam param_;
+};  // class BoxNMSProp
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_BOX_NMS_INL_H_
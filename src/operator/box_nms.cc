@@ -0,0 +1,29 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file box_nms.cc
+ * \brief non-maximum suppression of detections
+*/
+#include "./box_nms-inl.h"
+
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<cpu>(BoxNMSParam param) {
+  return new BoxNMSOp<cpu>(param);
+}
+
+Operator* BoxNMSProp::CreateOperator(Context ctx) const {
+  DO_BIND_DISPATCH(CreateOp, param_);
+}
+
+DMLC_REGISTER_PARAMETER(BoxNMSParam);
+
+MXNET_REGISTER_OP_PROPERTY(BoxNMS, BoxNMSProp)
+.describe("Apply non-maximum suppression to the detections of each image. The input is "
+"(..., num_boxes, row_size), each row holds the corners x1, y1, x2, y2 from coord_start, the "
+"score at score_index and optionally a class id at id_index. The output has the same shape, "
+"the rows kept sorted by decreasing score, then rows of -1.")
+.add_argument("data", "Symbol", "Detections, (..., num_boxes, row_size)")
+.add_arguments(BoxNMSParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
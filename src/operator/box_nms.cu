@@ -0,0 +1,15 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file box_nms.cu
+ * \brief non-maximum suppression of detections
+*/
+#include "./box_nms-inl.h"
+
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<gpu>(BoxNMSParam param) {
+  return new BoxNMSOp<gpu>(param);
+}
+}  // namespace op
+}  // namespace mxnet
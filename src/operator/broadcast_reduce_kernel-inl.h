@@ -0,0 +1,471 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file broadcast_reduce_kernel-inl.h
+ * \brief kernels of the broadcast and the reduce over arbitrary axes of N-d tensors.
+ *
+ *  The shapes are first collapsed: the dims of size 1 are dropped, and the neighbouring
+ *  dims along which every operand either broadcasts or not are merged, e.g. the reduce
+ *  of (2, 3, 4, 5) to (2, 1, 1, 5) is the reduce of (2, 12, 5) to (2, 1, 5). The kernels
+ *  then walk the collapsed shapes with precomputed strides, with one warp per output
+ *  and a shuffle tree reduce on gpu when the innermost dim is reduced.
+ */
+#ifndef MXNET_OPERATOR_BROADCAST_REDUCE_KERNEL_INL_H_
+#define MXNET_OPERATOR_BROADCAST_REDUCE_KERNEL_INL_H_
+
+#include <dmlc/logging.h>
+#include <mshadow/tensor.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+namespace broadcast {
+/*! \brief maximum number of dims of the collapsed shapes */
+const int kMaxDim = 16;
+/*! \brief number of independent accumulators of an output on cpu */
+const int kNumLanes = 4;
+/*! \brief number of outputs accumulated together on cpu when the innermost dim is kept */
+const int kChunk = 64;
+
+/*! \brief collapsed shape of the output and the strides of the two inputs in it */
+struct BroadcastStrides {
+  int ndim;
+  index_t shape[kMaxDim];
+  index_t lstride[kMaxDim];
+  index_t rstride[kMaxDim];
+};
+
+/*!
+ * \brief collapsed shapes of the kept and the reduced dims of a reduce, and the strides
+ *  of the data and of the operand broadcast to it along them
+ */
+struct ReduceStrides {
+  /*! \brief number of outputs and shape of the kept dims */
+  index_t N;
+  int ndim;
+  index_t shape[kMaxDim];
+  index_t lstride[kMaxDim];
+  index_t rstride[kMaxDim];
+  /*! \brief number of reduced elements per output and shape of the reduced dims */
+  index_t M;
+  int rdim;
+  index_t rshape[kMaxDim];
+  index_t lrstride[kMaxDim];
+  index_t rrstride[kMaxDim];
+  /*! \brief whether the innermost dim of the data is kept */
+  bool inner_kept;
+};
+
+/*! \brief operator taking the first operand, for the kernels of one input */
+struct first {
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return a;
+  }
+};
+
+/*! \brief unary operator on the first operand, for the kernels of one input */
+template<typename OP>
+struct unary_first {
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return OP::Map(a);
+  }
+};
+
+/*! \brief offsets in the two inputs of the element idx of the row-major shape */
+MSHADOW_XINLINE void Unravel(index_t idx, int ndim, const index_t *shape,
+                             const index_t *lstride, const index_t *rstride,
+                             index_t *loff, index_t *roff) {
+  *loff = 0;
+  *roff = 0;
+  for (int i = ndim - 1; i >= 0; --i) {
+    const index_t j = idx % shape[i];
+    idx /= shape[i];
+    *loff += j * lstride[i];
+    *roff += j * rstride[i];
+  }
+}
+
+template<typename DType>
+MSHADOW_XINLINE void Assign(DType *out, bool addto, DType val) {
+  *out = addto ? *out + val : val;
+}
+
+/*!
+ * \brief collapse the shapes of a broadcast or a reduce
+ * \param big the shape of the output of a broadcast, or of the data of a reduce
+ * \param small the shapes of the other operands, of the ndim of big and of dims
+ *  equal to the ones of big or 1, collapsed in place
+ * \return the collapsed shape of big
+ */
+inline std::vector<index_t> CollapseShapes(const TShape &big,
+                                           std::vector<std::vector<index_t> > *small) {
+  std::vector<std::vector<index_t> > &s = *small;
+  std::vector<std::vector<index_t> > ret(s.size());
+  std::vector<index_t> b;
+  for (index_t i = 0; i < big.ndim(); ++i) {
+    for (size_t k = 0; k < s.size(); ++k) {
+      CHECK_EQ(s[k].size(), big.ndim());
+      CHECK(s[k][i] == big[i] || s[k][i] == 1)
+          << "shapes cannot be broadcast to " << big;
+    }
+    if (big[i] == 1) continue;
+    bool merge = !b.empty();
+    for (size_t k = 0; k < s.size() && merge; ++k) {
+      merge = (s[k][i] == 1) == (ret[k].back() == 1);
+    }
+    if (merge) {
+      b.back() *= big[i];
+      for (size_t k = 0; k < s.size(); ++k) ret[k].back() *= s[k][i];
+    } else {
+      b.push_back(big[i]);
+      for (size_t k = 0; k < s.size(); ++k) ret[k].push_back(s[k][i]);
+    }
+  }
+  if (b.empty()) {
+    b.push_back(1);
+    for (size_t k = 0; k < s.size(); ++k) ret[k].push_back(1);
+  }
+  CHECK_LE(b.size(), static_cast<size_t>(kMaxDim))
+      << "broadcast or reduce of " << big << " has too many dims after collapsing";
+  s.swap(ret);
+  return b;
+}
+
+/*! \brief row-major strides of the shape, 0 along the dims of size 1 */
+inline void GetStrides(const std::vector<index_t> &shape, index_t *stride) {
+  index_t s = 1;
+  for (int i = static_cast<int>(shape.size()) - 1; i >= 0; --i) {
+    stride[i] = shape[i] == 1 ? 0 : s;
+    s *= shape[i];
+  }
+}
+
+inline std::vector<index_t> ToVector(const TShape &shape) {
+  return std::vector<index_t>(shape.begin(), shape.end());
+}
+
+inline BroadcastStrides GetBroadcastStrides(const TShape &out, const TShape &lhs,
+                                            const TShape &rhs) {
+  std::vector<std::vector<index_t> > small = {ToVector(lhs), ToVector(rhs)};
+  std::vector<index_t> shape = CollapseShapes(out, &small);
+  BroadcastStrides st;
+  st.ndim = static_cast<int>(shape.size());
+  std::copy(shape.begin(), shape.end(), st.shape);
+  GetStrides(small[0], st.lstride);
+  GetStrides(small[1], st.rstride);
+  return st;
+}
+
+/*!
+ * \param src shape of the data
+ * \param dst shape of the output, of the ndim of src and of size 1 along the reduced dims
+ * \param rhs shape of the operand broadcast to src
+ */
+inline ReduceStrides GetReduceStrides(const TShape &src, const TShape &dst,
+                                      const TShape &rhs) {
+  std::vector<std::vector<index_t> > small = {ToVector(dst), ToVector(rhs)};
+  std::vector<index_t> shape = CollapseShapes(src, &small);
+  index_t lstride[kMaxDim], rstride[kMaxDim];
+  GetStrides(shape, lstride);
+  GetStrides(small[1], rstride);
+  ReduceStrides st;
+  st.N = st.M = 1;
+  st.ndim = st.rdim = 0;
+  for (size_t i = 0; i < shape.size(); ++i) {
+    if (small[0][i] == 1 && shape[i] != 1) {
+      st.rshape[st.rdim] = shape[i];
+      st.lrstride[st.rdim] = lstride[i];
+      st.rrstride[st.rdim] = rstride[i];
+      st.M *= shape[i];
+      ++st.rdim;
+    } else {
+      st.shape[st.ndim] = shape[i];
+      st.lstride[st.ndim] = lstride[i];
+      st.rstride[st.ndim] = rstride[i];
+      st.N *= shape[i];
+      ++st.ndim;
+    }
+  }
+  st.inner_kept = st.ndim != 0 && st.lstride[st.ndim - 1] == 1;
+  if (st.ndim == 0) {
+    st.shape[0] = 1;
+    st.lstride[0] = st.rstride[0] = 0;
+    st.ndim = 1;
+  }
+  if (st.rdim == 0) {
+    st.rshape[0] = 1;
+    st.lrstride[0] = st.rrstride[0] = 0;
+    st.rdim = 1;
+  }
+  return st;
+}
+
+/*! \brief out = req(out, OP(lhs, rhs)) */
+template<typename OP, typename DType>
+inline void BroadcastLaunch(mshadow::Stream<cpu> *s, DType *out, bool addto,
+                            const DType *lhs, const DType *rhs,
+                            const BroadcastStrides &st, index_t size) {
+  const index_t inner = st.shape[st.ndim - 1];
+  const index_t lis = st.lstride[st.ndim - 1], ris = st.rstride[st.ndim - 1];
+  const int nouter = static_cast<int>(size / inner);
+  #pragma omp parallel for schedule(static)
+  for (int j = 0; j < nouter; ++j) {
+    index_t loff, roff;
+    Unravel(j, st.ndim - 1, st.shape, st.lstride, st.rstride, &loff, &roff);
+    DType *o = out + j * inner;
+    const DType *l = lhs + loff, *r = rhs + roff;
+    for (index_t i = 0; i < inner; ++i) {
+      Assign(o + i, addto, OP::Map(l[i * lis], r[i * ris]));
+    }
+  }
+}
+
+/*! \brief out = req(out, reduce(OP(lhs, rhs))) */
+template<typename Reducer, typename OP, typename DType>
+inline void ReduceLaunch(mshadow::Stream<cpu> *s, DType *out, bool addto,
+                         const DType *lhs, const DType *rhs, const ReduceStrides &st) {
+  if (st.inner_kept) {
+    // accumulate a chunk of neighbouring outputs together, reading the data in order
+    const index_t inner = st.shape[st.ndim - 1];
+    const index_t ris = st.rstride[st.ndim - 1];
+    const index_t nchunk = (inner + kChunk - 1) / kChunk;
+    const int ntask = static_cast<int>(st.N / inner * nchunk);
+    #pragma omp parallel for schedule(static)
+    for (int t = 0; t < ntask; ++t) {
+      const index_t j = t / nchunk * inner + t % nchunk * kChunk;
+      const index_t len = std::min<index_t>(kChunk, inner - t % nchunk * kChunk);
+      index_t lbase, rbase;
+      Unravel(j, st.ndim, st.shape, st.lstride, st.rstride, &lbase, &rbase);
+      DType acc[kChunk];
+      for (index_t i = 0; i < len; ++i) Reducer::SetInitValue(acc[i]);
+      for (index_t k = 0; k < st.M; ++k) {
+        index_t loff, roff;
+        Unravel(k, st.rdim, st.rshape, st.lrstride, st.rrstride, &loff, &roff);
+        const DType *l = lhs + lbase + loff, *r = rhs + rbase + roff;
+        for (index_t i = 0; i < len; ++i) {
+          Reducer::Reduce(acc[i], OP::Map(l[i], r[i * ris]));
+        }
+      }
+      for (index_t i = 0; i < len; ++i) Assign(out + j + i, addto, acc[i]);
+    }
+    return;
+  }
+  // the innermost dim is reduced: several accumulators per output along it
+  const index_t inner = st.rshape[st.rdim - 1];
+  const index_t lis = st.lrstride[st.rdim - 1], ris = st.rrstride[st.rdim - 1];
+  const index_t nouter = st.M / inner;
+  #pragma omp parallel for schedule(static)
+  for (int j = 0; j < static_cast<int>(st.N); ++j) {
+    index_t lbase, rbase;
+    Unravel(j, st.ndim, st.shape, st.lstride, st.rstride, &lbase, &rbase);
+    DType acc[kNumLanes];
+    for (int q = 0; q < kNumLanes; ++q) Reducer::SetInitValue(acc[q]);
+    for (index_t k = 0; k < nouter; ++k) {
+      index_t loff, roff;
+      Unravel(k, st.rdim - 1, st.rshape, st.lrstride, st.rrstride, &loff, &roff);
+      const DType *l = lhs + lbase + loff, *r = rhs + rbase + roff;
+      index_t i = 0;
+      for (; i + kNumLanes <= inner; i += kNumLanes) {
+        for (int q = 0; q < kNumLanes; ++q) {
+          Reducer::Reduce(acc[q], OP::Map(l[(i + q) * lis], r[(i + q) * ris]));
+        }
+      }
+      for (; i < inner; ++i) {
+        Reducer::Reduce(acc[0], OP::Map(l[i * lis], r[i * ris]));
+      }
+    }
+    for (int q = 1; q < kNumLanes; ++q) Reducer::Reduce(acc[0], acc[q]);
+    Assign(out + j, addto, acc[0]);
+  }
+}
+
+#ifdef __CUDACC__
+/*! \brief number of threads of a warp */
+const int kWarpSize = 32;
+
+template<typename DType>
+__device__ DType WarpShflDown(DType val, int offset) {
+#if CUDA_VERSION >= 9000
+  return __shfl_down_sync(0xffffffff, val, offset);
+#else
+  return __shfl_down(val, offset);
+#endif
+}
+
+template<>
+inline __device__ mshadow::half::half_t WarpShflDown(mshadow::half::half_t val, int offset) {
+  return mshadow::half::half_t(WarpShflDown(static_cast<float>(val), offset));
+}
+
+template<typename OP, typename DType>
+__global__ void BroadcastKernel(DType *out, bool addto, const DType *lhs, const DType *rhs,
+                                BroadcastStrides st, index_t size) {
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    index_t loff, roff;
+    Unravel(i, st.ndim, st.shape, st.lstride, st.rstride, &loff, &roff);
+    Assign(out + i, addto, OP::Map(lhs[loff], rhs[roff]));
+  }
+}
+
+/*! \brief one warp per output, for the reduce along the innermost dim */
+template<typename Reducer, typename OP, typename DType>
+__global__ void ReduceWarpKernel(DType *out, bool addto, const DType *lhs, const DType *rhs,
+                                 ReduceStrides st) {
+  const int lane = threadIdx.x % kWarpSize;
+  const index_t nwarp = blockDim.x / kWarpSize * gridDim.x;
+  for (index_t j = (blockIdx.x * blockDim.x + threadIdx.x) / kWarpSize; j < st.N;
+       j += nwarp) {
+    index_t lbase, rbase;
+    Unravel(j, st.ndim, st.shape, st.lstride, st.rstride, &lbase, &rbase);
+    DType acc;
+    Reducer::SetInitValue(acc);
+    for (index_t k = lane; k < st.M; k += kWarpSize) {
+      index_t loff, roff;
+      Unravel(k, st.rdim, st.rshape, st.lrstride, st.rrstride, &loff, &roff);
+      Reducer::Reduce(acc, OP::Map(lhs[lbase + loff], rhs[rbase + roff]));
+    }
+    for (int offset = kWarpSize / 2; offset > 0; offset /= 2) {
+      Reducer::Reduce(acc, WarpShflDown(acc, offset));
+    }
+    if (lane == 0) Assign(out + j, addto, acc);
+  }
+}
+
+/*! \brief one thread per output, the neighbouring threads read neighbouring data */
+template<typename Reducer, typename OP, typename DType>
+__global__ void ReduceThreadKernel(DType *out, bool addto, const DType *lhs, const DType *rhs,
+                                   ReduceStrides st) {
+  for (index_t j = blockIdx.x * blockDim.x + threadIdx.x; j < st.N;
+       j += blockDim.x * gridDim.x) {
+    index_t lbase, rbase;
+    Unravel(j, st.ndim, st.shape, st.lstride, st.rstride, &lbase, &rbase);
+    DType acc;
+    Reducer::SetInitValue(acc);
+    for (index_t k = 0; k < st.M; ++k) {
+      index_t loff, roff;
+      Unravel(k, st.rdim, st.rshape, st.lrstride, st.rrstride, &loff, &roff);
+      Reducer::Reduce(acc, OP::Map(lhs[lbase + loff], rhs[rbase + roff]));
+    }
+    Assign(out + j, addto, acc);
+  }
+}
+
+template<typename OP, typename DType>
+inline void BroadcastLaunch(mshadow::Stream<gpu> *s, DType *out, bool addto,
+                            const DType *lhs, const DType *rhs,
+                            const BroadcastStrides &st, index_t size) {
+  using namespace mshadow::cuda;
+  const int grid = static_cast<int>(std::min<index_t>(
+      kMaxGridNum, (size + kBaseThreadNum - 1) / kBaseThreadNum));
+  BroadcastKernel<OP><<<grid, kBaseThreadNum, 0, mshadow::Stream<gpu>::GetStream(s)>>>(
+      out, addto, lhs, rhs, st, size);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+template<typename Reducer, typename OP, typename DType>
+inline void ReduceLaunch(mshadow::Stream<gpu> *s, DType *out, bool addto,
+                         const DType *lhs, const DType *rhs, const ReduceStrides &st) {
+  using namespace mshadow::cuda;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  if (!st.inner_kept && st.M >= kWarpSize) {
+    const index_t nwarp = kBaseThreadNum / kWarpSize;
+    const int grid = static_cast<int>(std::min<index_t>(
+        kMaxGridNum, (st.N + nwarp - 1) / nwarp));
+    ReduceWarpKernel<Reducer, OP><<<grid, kBaseThreadNum, 0, stream>>>(
+        out, addto, lhs, rhs, st);
+  } else {
+    const int grid = static_cast<int>(std::min<index_t>(
+        kMaxGridNum, (st.N + kBaseThreadNum - 1) / kBaseThreadNum));
+    ReduceThreadKernel<Reducer, OP><<<grid, kBaseThreadNum, 0, stream>>>(
+        out, addto, lhs, rhs, st);
+  }
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+
+/*!
+ * \brief out = req(out, OP(lhs, rhs)), with lhs and rhs of the given shapes broadcast
+ *  to the shape of out
+ */
+template<typename xpu, typename OP>
+inline void BinaryBroadcastCompute(mshadow::Stream<xpu> *s, const TBlob &lhs,
+                                   const TShape &lhs_shape, const TBlob &rhs,
+                                   const TShape &rhs_shape, const TBlob &out, OpReqType req) {
+  if (req == kNullOp || out.Size() == 0) return;
+  CHECK_EQ(lhs.type_flag_, out.type_flag_);
+  CHECK_EQ(rhs.type_flag_, out.type_flag_);
+  CHECK_EQ(lhs_shape.Size(), lhs.Size());
+  CHECK_EQ(rhs_shape.Size(), rhs.Size());
+  BroadcastStrides st = GetBroadcastStrides(out.shape_, lhs_shape, rhs_shape);
+  MSHADOW_TYPE_SWITCH(out.type_flag_, DType, {
+    BroadcastLaunch<OP>(s, static_cast<DType*>(out.dptr_), req == kAddTo,
+                        static_cast<const DType*>(lhs.dptr_),
+                        static_cast<const DType*>(rhs.dptr_), st, out.Size());
+  });
+}
+
+/*! \brief out = req(out, OP(lhs, rhs)), with lhs and rhs broadcast to the shape of out */
+template<typename xpu, typename OP>
+inline void BinaryBroadcastCompute(mshadow::Stream<xpu> *s, const TBlob &lhs,
+                                   const TBlob &rhs, const TBlob &out, OpReqType req) {
+  BinaryBroadcastCompute<xpu, OP>(s, lhs, lhs.shape_, rhs, rhs.shape_, out, req);
+}
+
+/*!
+ * \brief out = req(out, src), with src broadcast to the shape of out
+ * \param src_shape shape of src of the ndim of out, the one of src itself may drop
+ *  the broadcast dims as the output of a reduce with keepdims=False
+ */
+template<typename xpu>
+inline void BroadcastCompute(mshadow::Stream<xpu> *s, const TBlob &src,
+                             const TShape &src_shape, const TBlob &out, OpReqType req) {
+  BinaryBroadcastCompute<xpu, first>(s, src, src_shape, src, src_shape, out, req);
+}
+
+/*!
+ * \brief out = req(out, reduce(OP(src, rhs))), reducing the dims of src along which out
+ *  has size 1, with rhs broadcast to the shape of src.
+ * \param dst_shape shape of out, of the ndim of src and of size 1 along the reduced dims,
+ *  the one of out itself may drop them as it is with keepdims=False
+ */
+template<typename xpu, typename Reducer, typename OP>
+inline void BinaryReduceCompute(mshadow::Stream<xpu> *s, const TBlob &src, const TBlob &rhs,
+                                const TShape &dst_shape, const TBlob &out, OpReqType req) {
+  if (req == kNullOp || out.Size() == 0) return;
+  CHECK_EQ(src.type_flag_, out.type_flag_);
+  CHECK_EQ(rhs.type_flag_, out.type_flag_);
+  CHECK_EQ(dst_shape.Size(), out.Size());
+  ReduceStrides st = GetReduceStrides(src.shape_, dst_shape, rhs.shape_);
+  MSHADOW_REAL_TYPE_SWITCH(out.type_flag_, DType, {
+    ReduceLaunch<Reducer, OP>(s, static_cast<DType*>(out.dptr_), req == kAddTo,
+                              static_cast<const DType*>(src.dptr_),
+                              static_cast<const DType*>(rhs.dptr_), st);
+  });
+}
+
+/*! \brief out = req(out, reduce(OP(src))), see BinaryReduceCompute */
+template<typename xpu, typename Reducer, typename OP>
+inline void ReduceCompute(mshadow::Stream<xpu> *s, const TBlob &src,
+                          const TShape &dst_shape, const TBlob &out, OpReqType req) {
+  BinaryReduceCompute<xpu, Reducer, unary_first<OP> >(s, src, src, dst_shape, out, req);
+}
+
+/*! \brief the shape with size 1 along the axes, i.e. the reduced shape with keepdims */
+inline TShape ReducedShape(const TShape &shape, const TShape &axes) {
+  TShape ret = shape;
+  for (index_t i = 0; i < axes.ndim(); ++i) {
+    CHECK_LT(axes[i], shape.ndim());
+    ret[axes[i]] = 1;
+  }
+  return ret;
+}
+}  // namespace broadcast
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_BROADCAST_REDUCE_KERNEL_INL_H_
@@ -10,6 +10,7 @@
 #include <vector>
 #include "./mshadow_op.h"
 #include "./broadcast_reduce_op_common.h"
+#include "./broadcast_reduce_kernel-inl.h"
 
 #if defined(__CUDACC__)
 #define XPU gpu
@@ -191,29 +192,8 @@ void ReduceAxisImpl_(const TBlob &src,
     });
     return;
   }
-  bool is_contiguous_axes;
-  index_t reducing_size;
-  CheckContiguousAxes_(&is_contiguous_axes, &reducing_size, axes, src.shape_);
-  if (is_contiguous_axes) {
-    MSHADOW_REAL_TYPE_SWITCH(src.type_flag_, DType, {
-      Tensor<xpu, 3, DType> in = src.FlatTo3D<xpu, DType>(axes[0], axes[axes.ndim() - 1], s);
-      Tensor<xpu, 1, DType> out =
-        ret->get_with_shape<xpu, 1, DType>(mshadow::Shape1(ret->Size()), s);
-      ReduceAxesAssign<Reducer>(out, req, TShape(1), in);
-    });
-  } else {
-    Shape<MXNET_SPECIAL_MAX_NDIM> padded_shape_;
-    for (index_t i = 0; i < MXNET_SPECIAL_MAX_NDIM; ++i) {
-      padded_shape_[i] = (i < src.ndim()) ? src.shape_[i] : 1;
-    }
-    MSHADOW_REAL_TYPE_SWITCH(src.type_flag_, DType, {
-      Tensor<xpu, MXNET_SPECIAL_MAX_NDIM, DType> in =
-        src.get_with_shape<xpu, MXNET_SPECIAL_MAX_NDIM, DType>(padded_shape_, s);
-      Tensor<xpu, 1, DType> out =
-        ret->get_with_shape<xpu, 1, DType>(mshadow::Shape1(ret->Size()), s);
-      ReduceAxesAssign<Reducer>(out, req, axes, in);
-    });
-  }
+  broadcast::ReduceCompute<xpu, Reducer, mshadow_op::identity>(
+      s, src, broadcast::ReducedShape(src.shape_, axes), *ret, req);
 }
 
 // Broadcast the given axis to the given broadcasting size
@@ -238,36 +218,8 @@ void BroadcastAxisImpl_(const TBlob &src,
     });
     return;
   }
-  bool is_contiguous_axes;
-  index_t broadcasting_size;
-  CheckContiguousAxes_(&is_contiguous_axes, &broadcasting_size, axes, ret->shape_);
-  if (is_contiguous_axes) {
-    MSHADOW_REAL_TYPE_SWITCH(src.type_flag_, DType, {
-      Tensor<xpu, 3, DType> out = ret->FlatTo3D<xpu, DType>(axes[0], axes[axes.ndim() - 1], s);
-      Tensor<xpu, 3, DType> in =
-        src.get_with_shape<xpu, 3, DType>(Shape3(out.shape_[0], 1, out.shape_[2]), s);
-      ASSIGN_DISPATCH(out, req, broadcast_keepdim(in, 1, broadcasting_size));
-    });
-  } else {
-    CHECK(ret->ndim() <= MXNET_SPECIAL_MAX_NDIM) << "non-contiguous axis supports ndim up to "
-                                                 << MXNET_SPECIAL_MAX_NDIM;
-    Shape<MXNET_SPECIAL_MAX_NDIM> padded_src_shape_;
-    Shape<MXNET_SPECIAL_MAX_NDIM> padded_ret_shape_;
-    for (index_t i = 0; i < MXNET_SPECIAL_MAX_NDIM; ++i) {
-      padded_ret_shape_[i] = (i < ret->ndim()) ? ret->shape_[i] : 1;
-    }
-    padded_src_shape_ = padded_ret_shape_;
-    for (index_t i = 0; i < axes.ndim(); ++i) {
-      padded_src_shape_[axes[i]] = 1;
-    }
-    MSHADOW_REAL_TYPE_SWITCH(src.type_flag_, DType, {
-      Tensor<xpu, MXNET_SPECIAL_MAX_NDIM, DType> in =
-        src.get_with_shape<xpu, MXNET_SPECIAL_MAX_NDIM, DType>(padded_src_shape_, s);
-      Tensor<xpu, MXNET_SPECIAL_MAX_NDIM, DType> out =
-        ret->get_with_shape<xpu, MXNET_SPECIAL_MAX_NDIM, DType>(padded_ret_shape_, s);
-      ASSIGN_DISPATCH(out, req, broadcast_multi_axes(in, axes, bsizes));
-    });
-  }
+  broadcast::BroadcastCompute<xpu>(
+      s, src, broadcast::ReducedShape(ret->shape_, axes), *ret, req);
 }
 
 // Forward pass of reduce over the given axis
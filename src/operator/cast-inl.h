@@ -29,6 +29,7 @@ enum CastOpOutputs {kOut};
 struct CastParam : public dmlc::Parameter<CastParam> {
   // use int for enumeration
   int dtype;
+  float grad_scale;
   DMLC_DECLARE_PARAMETER(CastParam) {
     DMLC_DECLARE_FIELD(dtype)
     .add_enum("float32", mshadow::kFloat32)
@@ -37,6 +38,9 @@ struct CastParam : public dmlc::Parameter<CastParam> {
     .add_enum("uint8", mshadow::kUint8)
     .add_enum("int32", mshadow::kInt32)
     .describe("Target data type.");
+    DMLC_DECLARE_FIELD(grad_scale).set_default(1.0f)
+    .describe("Scale of the gradient in backward, e.g. for loss scaling "
+              "of low precision regions.");
   }
 };
 
@@ -47,6 +51,8 @@ struct CastParam : public dmlc::Parameter<CastParam> {
 template<typename xpu, typename SrcDType, typename DstDType>
 class CastOp : public Operator {
  public:
+  explicit CastOp(CastParam param) : param_(param) {}
+
   virtual void Forward(const OpContext &ctx,
                        const std::vector<TBlob> &in_data,
                        const std::vector<OpReqType> &req,
@@ -77,8 +83,20 @@ class CastOp : public Operator {
     Stream<xpu> *s = ctx.get_stream<xpu>();
     Tensor<xpu, 2, DstDType> m_out_grad = out_grad[cast::kOut].FlatTo2D<xpu, DstDType>(s);
     Tensor<xpu, 2, SrcDType> m_in_grad = in_grad[cast::kData].FlatTo2D<xpu, SrcDType>(s);
-    Assign(m_in_grad, req[cast::kData], tcast<SrcDType>(m_out_grad));
+    if (param_.grad_scale == 1.0f) {
+      Assign(m_in_grad, req[cast::kData], tcast<SrcDType>(m_out_grad));
+    } else if (sizeof(SrcDType) >= sizeof(DstDType)) {
+      // scale in the wider type to avoid underflow
+      Assign(m_in_grad, req[cast::kData],
+             tcast<SrcDType>(m_out_grad) * scalar<SrcDType>(SrcDType(param_.grad_scale)));
+    } else {
+      Assign(m_in_grad, req[cast::kData],
+             tcast<SrcDType>(m_out_grad * scalar<DstDType>(DstDType(param_.grad_scale))));
+    }
   }
+
+ private:
+  CastParam param_;
 };  // class CastOp
 
 // Decalre Factory function, used for dispatch specialization
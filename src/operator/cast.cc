@@ -14,7 +14,7 @@ Operator *CreateOp<cpu>(CastParam param, std::vector<int> *in_type) {
   Operator *op = NULL;
   MSHADOW_TYPE_SWITCH((*in_type)[0], SrcDType, {
     MSHADOW_TYPE_SWITCH(param.dtype, DstDType, {
-        op = new CastOp<cpu, SrcDType, DstDType>();
+        op = new CastOp<cpu, SrcDType, DstDType>(param);
     })
   })
   return op;
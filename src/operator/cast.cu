@@ -16,7 +16,7 @@ Operator *CreateOp<gpu>(CastParam param, std::vector<int> *in_type) {
   Operator *op = NULL;
   MSHADOW_TYPE_SWITCH((*in_type)[0], SrcDType, {
     MSHADOW_TYPE_SWITCH(param.dtype, DstDType, {
-        op = new CastOp<gpu, SrcDType, DstDType>();
+        op = new CastOp<gpu, SrcDType, DstDType>(param);
     })
   })
   return op;
@@ -16,7 +16,8 @@
 #include <string>
 #include <utility>
 #include "./operator_common.h"
-
+#include "./mshadow_op.h"
+#include "./vol2col-inl.h"
 
 namespace mxnet {
 namespace op {
@@ -25,7 +26,8 @@ namespace conv {
 enum ConvolutionOpInputs {kData, kWeight, kBias};
 enum ConvolutionOpOutputs {kOut};
 enum ConvolutionOpResource {kTempSpace};
-enum ConvolutionOpCudnnTune {kOff, kLimited, kFastest};
+enum ConvolutionOpCudnnTune {kOff, kLimited, kFastest, kAuto};
+enum ConvolutionOpActType {kActNone, kActReLU, kActSigmoid, kActTanh, kActSoftReLU};
 }
 
 struct ConvolutionParam : public dmlc::Parameter<ConvolutionParam> {
@@ -38,6 +40,7 @@ struct ConvolutionParam : public dmlc::Parameter<ConvolutionParam> {
   uint64_t workspace;
   bool no_bias;
   int cudnn_tune;
+  int act_type;
   DMLC_DECLARE_PARAMETER(ConvolutionParam) {
     int shape[] = {1, 1};
     DMLC_DECLARE_FIELD(kernel).describe("convolution kernel size: (y, x) or (d, y, x)");
@@ -62,12 +65,47 @@ struct ConvolutionParam : public dmlc::Parameter<ConvolutionParam> {
     .add_enum("off", conv::kOff)
     .add_enum("limited_workspace", conv::kLimited)
     .add_enum("fastest", conv::kFastest)
+    .add_enum("auto", conv::kAuto)
     .set_default(conv::kLimited)
     .describe("Whether to find convolution algo by running performance test."
-              "Leads to higher startup time but may give better speed");
+              "Leads to higher startup time but may give better speed. "
+              "auto ignores workspace and takes the fastest algo whose workspace fits "
+              "the memory of the gpu left after the memory plan of the executor.");
+    DMLC_DECLARE_FIELD(act_type)
+    .add_enum("none", conv::kActNone)
+    .add_enum("relu", conv::kActReLU)
+    .add_enum("sigmoid", conv::kActSigmoid)
+    .add_enum("tanh", conv::kActTanh)
+    .add_enum("softrelu", conv::kActSoftReLU)
+    .set_default(conv::kActNone)
+    .describe("Activation applied to the output after the bias, inference only. "
+              "It is set when the inference optimizer fuses an Activation into the "
+              "Convolution.");
   }
 };
 
+/*! \brief out = act(out), the activation fused into the convolution */
+template<typename xpu, typename DType>
+inline void FusedActivation(mshadow::Tensor<xpu, 1, DType> out, int act_type) {
+  using namespace mshadow::expr;
+  switch (act_type) {
+    case conv::kActReLU:
+      out = F<mshadow_op::relu>(out);
+      break;
+    case conv::kActSigmoid:
+      out = F<mshadow_op::sigmoid>(out);
+      break;
+    case conv::kActTanh:
+      out = F<mshadow_op::tanh>(out);
+      break;
+    case conv::kActSoftReLU:
+      out = F<mshadow_op::softrelu>(out);
+      break;
+    default:
+      break;
+  }
+}
+
 template<typename xpu, typename DType>
 class ConvolutionOp : public Operator {
  public:
@@ -89,8 +127,9 @@ class ConvolutionOp : public Operator {
     CHECK_EQ(in_data.size(), expected);
     CHECK_EQ(out_data.size(), 1);
     Stream<xpu> *s = ctx.get_stream<xpu>();
-    if (param_.kernel.ndim() > 2) {
-      LOG(FATAL) << "Volume convolution is not implmented in mshadow";
+    if (param_.kernel.ndim() == 3) {
+      this->Forward3D(ctx, in_data, out_data);
+      return;
     }
     Tensor<xpu, 4, DType> data = in_data[conv::kData].get<xpu, 4, DType>(s);
     Shape<3> wmat_shape =
@@ -154,6 +193,10 @@ class ConvolutionOp : public Operator {
       Tensor<xpu, 1, DType> bias = in_data[conv::kBias].get<xpu, 1, DType>(s);
       out += broadcast<1>(bias, out.shape_);
     }
+    if (param_.act_type != conv::kActNone) {
+      FusedActivation(Tensor<xpu, 1, DType>(out.dptr_, Shape1(out.shape_.Size()), s),
+                      param_.act_type);
+    }
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -166,14 +209,17 @@ class ConvolutionOp : public Operator {
     using namespace mshadow;
     using namespace mshadow::expr;
     // TODO(bing): check the BLAS Handle, be careful
-    if (param_.kernel.ndim() > 2) {
-      LOG(FATAL) << "Volume convolution is not implmented in mshadow";
-    }
+    CHECK_EQ(param_.act_type, conv::kActNone)
+        << "Convolution with a fused activation is inference only";
     CHECK_EQ(out_grad.size(), 1);
     size_t expected = param_.no_bias == 0 ? 3 : 2;
     CHECK(in_data.size() == expected && in_grad.size() == expected);
     CHECK_EQ(req.size(), expected);
     CHECK_EQ(in_data[conv::kWeight].CheckContiguous(), true);
+    if (param_.kernel.ndim() == 3) {
+      this->Backward3D(ctx, out_grad, in_data, req, in_grad);
+      return;
+    }
     // get data
     Stream<xpu> *s = ctx.get_stream<xpu>();
     Tensor<xpu, 4, DType> data = in_data[conv::kData].get<xpu, 4, DType>(s);
@@ -266,7 +312,123 @@ class ConvolutionOp : public Operator {
     }
   }
 
- private:
+ protected:
+  /*!
+   * \brief the 3D convolution, one sample at a time: vol2col unfolds the windows of
+   *  the sample and each group is a GEMM of its weight and its rows of the columns
+   */
+  inline void Forward3D(const OpContext &ctx,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 5, DType> data = in_data[conv::kData].get<xpu, 5, DType>(s);
+    Tensor<xpu, 5, DType> out = out_data[conv::kOut].get<xpu, 5, DType>(s);
+    const vol2col::VolShape p = this->GetVolShape(data.shape_, out.shape_);
+    const index_t grows = p.rows() / param_.num_group;
+    const index_t gfilter = param_.num_filter / param_.num_group;
+    Tensor<xpu, 3, DType> wmat = in_data[conv::kWeight].get_with_shape<xpu, 3, DType>(
+        Shape3(param_.num_group, gfilter, grows), s);
+    Tensor<xpu, 2, DType> col = this->GetColSpace(ctx, p);
+    for (index_t n = 0; n < data.size(0); ++n) {
+      vol2col::Vol2Col(s, data[n].dptr_, p, col.dptr_);
+      Tensor<xpu, 3, DType> dst(out[n].dptr_, Shape3(param_.num_group, gfilter, p.cols()), s);
+      for (uint32_t gid = 0; gid < param_.num_group; ++gid) {
+        dst[gid] = dot(wmat[gid], col.Slice(grows * gid, grows * (gid + 1)));
+      }
+    }
+    Tensor<xpu, 3, DType> out3 = out_data[conv::kOut].get_with_shape<xpu, 3, DType>(
+        Shape3(out.size(0), out.size(1), p.cols()), s);
+    if (!param_.no_bias) {
+      Tensor<xpu, 1, DType> bias = in_data[conv::kBias].get<xpu, 1, DType>(s);
+      out3 += broadcast<1>(bias, out3.shape_);
+    }
+    if (param_.act_type != conv::kActNone) {
+      FusedActivation(Tensor<xpu, 1, DType>(out3.dptr_, Shape1(out3.shape_.Size()), s),
+                      param_.act_type);
+    }
+  }
+
+  inline void Backward3D(const OpContext &ctx,
+                         const std::vector<TBlob> &out_grad,
+                         const std::vector<TBlob> &in_data,
+                         const std::vector<OpReqType> &req,
+                         const std::vector<TBlob> &in_grad) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 5, DType> data = in_data[conv::kData].get<xpu, 5, DType>(s);
+    Tensor<xpu, 5, DType> grad = out_grad[conv::kOut].get<xpu, 5, DType>(s);
+    Tensor<xpu, 5, DType> gdata = in_grad[conv::kData].get<xpu, 5, DType>(s);
+    const vol2col::VolShape p = this->GetVolShape(data.shape_, grad.shape_);
+    const index_t grows = p.rows() / param_.num_group;
+    const index_t gfilter = param_.num_filter / param_.num_group;
+    const Shape<3> wmat_shape = Shape3(param_.num_group, gfilter, grows);
+    Tensor<xpu, 3, DType> wmat =
+        in_data[conv::kWeight].get_with_shape<xpu, 3, DType>(wmat_shape, s);
+    Tensor<xpu, 3, DType> gwmat =
+        in_grad[conv::kWeight].get_with_shape<xpu, 3, DType>(wmat_shape, s);
+    Tensor<xpu, 2, DType> col = this->GetColSpace(ctx, p);
+    for (index_t n = 0; n < data.size(0); ++n) {
+      Tensor<xpu, 3, DType> gout(grad[n].dptr_, Shape3(param_.num_group, gfilter, p.cols()), s);
+      vol2col::Vol2Col(s, data[n].dptr_, p, col.dptr_);
+      for (uint32_t gid = 0; gid < param_.num_group; ++gid) {
+        Tensor<xpu, 2, DType> tmpc = col.Slice(grows * gid, grows * (gid + 1));
+        if (n == 0) {
+          Tensor<xpu, 2, DType> tmp_gwmat = gwmat[gid];
+          Assign(tmp_gwmat, req[conv::kWeight], dot(gout[gid], tmpc.T()));
+        } else {
+          gwmat[gid] += dot(gout[gid], tmpc.T());
+        }
+      }
+      if (req[conv::kData] == kNullOp) continue;
+      for (uint32_t gid = 0; gid < param_.num_group; ++gid) {
+        Tensor<xpu, 2, DType> tmpc = col.Slice(grows * gid, grows * (gid + 1));
+        tmpc = dot(wmat[gid].T(), gout[gid]);
+      }
+      vol2col::Col2Vol(s, col.dptr_, p, req[conv::kData] == kAddTo, gdata[n].dptr_);
+    }
+    if (!param_.no_bias) {
+      Tensor<xpu, 3, DType> grad3 = out_grad[conv::kOut].get_with_shape<xpu, 3, DType>(
+          Shape3(grad.size(0), grad.size(1), p.cols()), s);
+      Tensor<xpu, 1, DType> gbias = in_grad[conv::kBias].get<xpu, 1, DType>(s);
+      Assign(gbias, req[conv::kBias], sumall_except_dim<1>(grad3));
+    }
+  }
+
+  inline vol2col::VolShape GetVolShape(const mshadow::Shape<5> &ishape,
+                                       const mshadow::Shape<5> &oshape) const {
+    vol2col::VolShape p;
+    p.C = ishape[1];
+    p.D = ishape[2];
+    p.H = ishape[3];
+    p.W = ishape[4];
+    p.Do = oshape[2];
+    p.Ho = oshape[3];
+    p.Wo = oshape[4];
+    p.kd = param_.kernel[0];
+    p.kh = param_.kernel[1];
+    p.kw = param_.kernel[2];
+    p.sd = param_.stride[0];
+    p.sh = param_.stride[1];
+    p.sw = param_.stride[2];
+    p.pd = param_.pad[0];
+    p.ph = param_.pad[1];
+    p.pw = param_.pad[2];
+    return p;
+  }
+  /*! \brief the columns of one sample in the temp space */
+  inline mshadow::Tensor<xpu, 2, DType> GetColSpace(const OpContext &ctx,
+                                                     const vol2col::VolShape &p) const {
+    const index_t required_size = p.rows() * p.cols();
+    CHECK_GE(param_.workspace, required_size)
+      << "\nMinimum workspace size: " << required_size * sizeof(DType) << " Bytes\n"
+      << "Given: " << param_.workspace * sizeof(DType) << " Bytes";
+    return ctx.requested[conv::kTempSpace].get_space_typed<xpu, 2, DType>(
+        mshadow::Shape2(p.rows(), p.cols()), ctx.get_stream<xpu>());
+  }
+
   inline index_t InitTemp(const mshadow::Shape<4> &ishape,
                           const mshadow::Shape<4> &oshape) {
     const int ksize_y = param_.kernel[0];
@@ -6,6 +6,8 @@
 */
 
 #include "./convolution-inl.h"
+#include "./cpu_convolution-inl.h"
+#include "./group_convolution-inl.h"
 
 namespace mxnet {
 namespace op {
@@ -15,6 +17,17 @@ Operator* CreateOp<cpu>(ConvolutionParam param, int dtype,
                         std::vector<TShape> *out_shape,
                         Context ctx) {
   Operator *op = NULL;
+  if (UseGroupConvolution(param, (*in_shape)[conv::kData])) {
+    MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
+      op = new GroupConvolutionOp<cpu, DType>(param);
+    })
+    return op;
+  }
+  if (dtype == mshadow::kFloat32 && param.kernel.ndim() == 2 &&
+      dmlc::GetEnv("MXNET_CPU_CONV_OPT", true)) {
+    return new CPUConvolutionOp(param,
+                                dmlc::GetEnv("MXNET_CPU_SPARSE_WEIGHT_DENSITY", 0.25f));
+  }
   MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
     op = new ConvolutionOp<cpu, DType>(param);
   })
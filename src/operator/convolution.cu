@@ -7,6 +7,7 @@
 
 #include "./convolution-inl.h"
 #include <vector>
+#include "./group_convolution-inl.h"
 #if MXNET_USE_CUDNN == 1
 #include "./cudnn_convolution-inl.h"
 #endif  // MXNET_USE_CUDNN
@@ -19,6 +20,12 @@ Operator* CreateOp<gpu>(ConvolutionParam param, int dtype,
                         std::vector<TShape> *out_shape,
                         Context ctx) {
   Operator *op = NULL;
+  if (UseGroupConvolution(param, (*in_shape)[conv::kData])) {
+    MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
+      op = new GroupConvolutionOp<gpu, DType>(param);
+    })
+    return op;
+  }
 #if MXNET_USE_CUDNN == 1
   if (param.dilate[0] == 1 && param.dilate[1] == 1) {
     MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
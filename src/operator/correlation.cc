@@ -1,144 +1,198 @@
-/*!
- * Copyright (c) 2015 by Contributors
- * \file correlation.cc
- * \brief correlation op
- * \author Xu Dong
-*/
-#include "./correlation-inl.h"
-#include "./mshadow_op.h"
-
-namespace mshadow {
-template<typename Dtype>
-void AddPad(const Tensor<cpu, 4, Dtype> &original,
-            const Tensor<cpu, 4, Dtype> &out,
-            int pad_size)
-{ for (index_t nbatch = 0 ; nbatch < original.size(0) ; nbatch++)
-  for (index_t channel = 0 ; channel < original.size(1) ; channel++)
-    for (index_t h = 0 ; h < original.size(2) ; h++)
-      for (index_t w = 0 ; w < original.size(3) ; w++)
-         out[nbatch][h+pad_size][w+pad_size][channel] = original[nbatch][channel][h][w];
-}
-template<typename Dtype>
-inline void CorrelationForward(const Tensor<cpu, 4, Dtype> &out,
-                               const Tensor<cpu, 4, Dtype> &data1,
-                               const Tensor<cpu, 4, Dtype> &data2,
-                               const Tensor<cpu, 4, Dtype> &tmp1,
-                               const Tensor<cpu, 4, Dtype> &tmp2,
-                               int top_channels_, int top_height_, int top_width_,
-                               int pad_size_, bool is_multiply,
-                               int max_displacement_, int kernel_size_,
-                               int neighborhood_grid_radius_, int neighborhood_grid_width_,
-                               int  kernel_radius_, int stride1_, int stride2_) {
-  const int bnum = data1.size(0);
-  const int bchannels = data1.size(1);
-  const int sumelems = kernel_size_ * kernel_size_ * bchannels;
-  AddPad<Dtype>(data1, tmp1, pad_size_);
-  AddPad<Dtype>(data2, tmp2, pad_size_);
-  for (index_t i = 0 ; i < top_height_ ; i++)
-      for (index_t j = 0 ; j < top_width_; j++)
-        for (index_t nbatch = 0 ; nbatch < bnum ; nbatch++) {
-            int x1 = j*stride1_+max_displacement_;
-            int y1 = i*stride1_+max_displacement_;
-            for (index_t top_channel = 0 ; top_channel < top_channels_ ; top_channel++) {
-              int s2o = (top_channel % neighborhood_grid_width_ -\
-                         neighborhood_grid_radius_) * stride2_;
-              int s2p = (top_channel / neighborhood_grid_width_ -\
-                         neighborhood_grid_radius_) * stride2_;
-              int x2 = x1 + s2o;
-              int y2 = y1 + s2p;
-              for (index_t h = 0; h < kernel_size_; h++)
-                for (index_t w = 0; w < kernel_size_; w++)
-                  for (index_t channel = 0; channel < bchannels; channel++) {
-                    if (is_multiply == true)
-                        out[nbatch][top_channel][i][j] += \
-                        tmp1[nbatch][y1+h][x1+w][channel]*tmp2[nbatch][y2+h][x2+w][channel];
-                    else
-                        out[nbatch][top_channel][i][j] += \
-                        fabsf(tmp1[nbatch][y1+h][x1+w][channel]-tmp2[nbatch][y2+h][x2+w][channel]);
-                  }
-              out[nbatch][top_channel][i][j] /= sumelems;
-            }
-        }
-}
-template<typename Dtype>
-inline void CorrelationBackward(const Tensor<cpu, 4, Dtype> &out_grad,
-                                const Tensor<cpu, 4, Dtype> &in_grad1,
-                                const Tensor<cpu, 4, Dtype> &in_grad2,
-                                const Tensor<cpu, 4, Dtype> &tmp1,
-                                const Tensor<cpu, 4, Dtype> &tmp2,
-                                int top_channels_, int top_height_,
-                                int top_width_, int pad_size_,
-                                bool is_multiply, int max_displacement_,
-                                int kernel_size_, int neighborhood_grid_radius_,
-                                int neighborhood_grid_width_,
-                                int  kernel_radius_, int stride1_,
-                                int stride2_, int num,
-                                int channels, int height, int width
-                            ) {
-  const float sumelems = kernel_size_ * kernel_size_ * channels;
-  for (int i = 0 ; i < top_height_ ; i++)
-     for (int j = 0 ; j < top_width_; j++)
-        for (int nbatch = 0 ; nbatch < num ; nbatch++) {
-            int x1 = j*stride1_+max_displacement_;
-            int y1 = i*stride1_+max_displacement_;
-            for (int top_channel = 0 ; top_channel < top_channels_ ; top_channel++) {
-              int s2o = (top_channel % neighborhood_grid_width_ - \
-              neighborhood_grid_radius_) * stride2_;
-              int s2p = (top_channel / neighborhood_grid_width_ - \
-              neighborhood_grid_radius_) * stride2_;
-              int x2 = x1 + s2o;
-              int y2 = y1 + s2p;
-              for (int h = 0; h < kernel_size_; h++)
-                for (int w = 0; w < kernel_size_; w++)
-                  for (int channel = 0 ; channel < channels; channel++) {
-                    if (is_multiply == true) {
-                      if ((y1 +  h - pad_size_ >= 0) && (x1 + w - pad_size_ >= 0) && \
-                      (y1 + h < height +pad_size_) && (x1 + w < width + pad_size_)) {
-                        in_grad1[nbatch][channel][y1+h-pad_size_][x1+w-pad_size_] += \
-                        out_grad[nbatch][top_channel][i][j] * \
-                        tmp2[nbatch][y2+h][x2+w][channel]/sumelems;
-                       }
-                       if ((y2 +  h - pad_size_ >= 0) && (x2 + w -pad_size_ >=0) && \
-                       (y2 + h < height +pad_size_) && (x2 + w < width + pad_size_)) {
-                       in_grad2[nbatch][channel][y2+h-pad_size_][x2+w-pad_size_] += \
-                       out_grad[nbatch][top_channel][i][j] * \
-                       tmp1[nbatch][y1+h][x1+w][channel]/sumelems;
-                       }
-                    } else {
-                      if ((y1 +  h - pad_size_ >= 0) && (x1 + w -pad_size_ >=0) && \
-                      (y1 + h < height + pad_size_) && (x1 + w < width + pad_size_)) {
-                        Dtype sign  = (tmp1[nbatch][y1+h][x1+w][channel] >= \
-                        tmp2[nbatch][y2+h][x2+w][channel])? Dtype(1.0) : Dtype(-1.0);
-                        in_grad1[nbatch][channel][y1+h-pad_size_][x1+w-pad_size_] +=\
-                        out_grad[nbatch][top_channel][i][j]*sign/sumelems;
-                      }
-                      if ((y2 +  h - pad_size_ >= 0) && (x2 + w - pad_size_ >=0) && \
-                      (y2 + h < height + pad_size_) && (x2 + w < width + pad_size_)) {
-                        Dtype sign  = (tmp1[nbatch][y1+h][x1+w][channel] >= \
-                        tmp2[nbatch][y2+h][x2+w][channel])? Dtype(-1.0) : Dtype(1.0);
-                        in_grad2[nbatch][channel][y2+h-pad_size_][x2+w-pad_size_] +=\
-                        out_grad[nbatch][top_channel][i][j]*sign/sumelems;
-                       }
-                    }
-                  }
-               }
-         }
-}
-}  // namespace mshadow
-namespace mxnet {
-namespace op {
-template<>
-Operator *CreateOp<cpu>(CorrelationParam param) {
-  return new CorrelationOp<cpu>(param);
-}
-Operator* CorrelationProp::CreateOperator(Context ctx) const {
-  DO_BIND_DISPATCH(CreateOp, param_);
-}
-DMLC_REGISTER_PARAMETER(CorrelationParam);
-MXNET_REGISTER_OP_PROPERTY(Correlation, CorrelationProp)
-.describe("Apply correlation to inputs")
-.add_argument("data1", "Symbol", "Input data1 to the correlation.")
-.add_argument("data2", "Symbol", "Input data2 to the correlation.")
-.add_arguments(CorrelationParam::__FIELDS__());
-}  // namespace op
-}  // namespace mxnet
+/*!
+ * Copyright (c) 2015 by Contributors
+ * \file correlation.cc
+ * \brief correlation op
+ * \author Xu Dong
+*/
+#include "./correlation-inl.h"
+#include <algorithm>
+#include <vector>
+#include "./mshadow_op.h"
+
+namespace mshadow {
+/*! \brief out = pad(original) in (n, h, w, c) layout, parallel over the rows */
+template<typename Dtype>
+void AddPad(const Tensor<cpu, 4, Dtype> &original,
+            const Tensor<cpu, 4, Dtype> &out,
+            int pad_size) {
+  const int channels = original.size(1), height = original.size(2), width = original.size(3);
+  const int nrow = original.size(0) * height;
+  #pragma omp parallel for schedule(static)
+  for (int nh = 0; nh < nrow; ++nh) {
+    const int nbatch = nh / height, h = nh % height;
+    Dtype *dst = out[nbatch][h + pad_size][pad_size].dptr_;
+    for (int channel = 0; channel < channels; ++channel) {
+      const Dtype *src = original[nbatch][channel][h].dptr_;
+      for (int w = 0; w < width; ++w) dst[w * channels + channel] = src[w];
+    }
+  }
+}
+
+/*!
+ * \brief the correlation of the patches of tmp1 and tmp2, in (n, h, w, c) layout,
+ *  at (y1, x1) and (y2, x2) summed over the channels, which are contiguous.
+ */
+template<typename Dtype>
+inline Dtype CorrelationPatch(const Tensor<cpu, 4, Dtype> &tmp1,
+                              const Tensor<cpu, 4, Dtype> &tmp2,
+                              int nbatch, int y1, int x1, int y2, int x2,
+                              int kernel_size, bool is_multiply) {
+  const int channels = tmp1.size(3);
+  Dtype sum = 0;
+  for (int h = 0; h < kernel_size; ++h) {
+    const Dtype *a = tmp1[nbatch][y1 + h][x1].dptr_;
+    const Dtype *b = tmp2[nbatch][y2 + h][x2].dptr_;
+    if (is_multiply) {
+      for (int k = 0; k < kernel_size * channels; ++k) sum += a[k] * b[k];
+    } else {
+      for (int k = 0; k < kernel_size * channels; ++k) sum += fabsf(a[k] - b[k]);
+    }
+  }
+  return sum;
+}
+
+template<typename Dtype>
+inline void CorrelationForward(const Tensor<cpu, 4, Dtype> &out,
+                               const Tensor<cpu, 4, Dtype> &data1,
+                               const Tensor<cpu, 4, Dtype> &data2,
+                               const Tensor<cpu, 4, Dtype> &tmp1,
+                               const Tensor<cpu, 4, Dtype> &tmp2,
+                               int top_channels_, int top_height_, int top_width_,
+                               int pad_size_, bool is_multiply,
+                               int max_displacement_, int kernel_size_,
+                               int neighborhood_grid_radius_, int neighborhood_grid_width_,
+                               int  kernel_radius_, int stride1_, int stride2_) {
+  const int bnum = data1.size(0);
+  const int bchannels = data1.size(1);
+  const int sumelems = kernel_size_ * kernel_size_ * bchannels;
+  AddPad<Dtype>(data1, tmp1, pad_size_);
+  AddPad<Dtype>(data2, tmp2, pad_size_);
+  // parallel over the output rows of each image
+  #pragma omp parallel for schedule(static)
+  for (int ni = 0; ni < bnum * top_height_; ++ni) {
+    const int nbatch = ni / top_height_, i = ni % top_height_;
+    const int y1 = i * stride1_ + max_displacement_;
+    for (int j = 0; j < top_width_; ++j) {
+      const int x1 = j * stride1_ + max_displacement_;
+      for (int top_channel = 0; top_channel < top_channels_; ++top_channel) {
+        const int s2o = (top_channel % neighborhood_grid_width_ -
+                         neighborhood_grid_radius_) * stride2_;
+        const int s2p = (top_channel / neighborhood_grid_width_ -
+                         neighborhood_grid_radius_) * stride2_;
+        out[nbatch][top_channel][i][j] =
+            CorrelationPatch(tmp1, tmp2, nbatch, y1, x1, y1 + s2p, x1 + s2o,
+                             kernel_size_, is_multiply) / sumelems;
+      }
+    }
+  }
+}
+
+/*!
+ * \brief the gradients are gathered for each input position, parallel over
+ *  the input rows, so that each thread only writes its own rows.
+ */
+template<typename Dtype>
+inline void CorrelationBackward(const Tensor<cpu, 4, Dtype> &out_grad,
+                                const Tensor<cpu, 4, Dtype> &in_grad1,
+                                const Tensor<cpu, 4, Dtype> &in_grad2,
+                                const Tensor<cpu, 4, Dtype> &tmp1,
+                                const Tensor<cpu, 4, Dtype> &tmp2,
+                                int top_channels_, int top_height_,
+                                int top_width_, int pad_size_,
+                                bool is_multiply, int max_displacement_,
+                                int kernel_size_, int neighborhood_grid_radius_,
+                                int neighborhood_grid_width_,
+                                int  kernel_radius_, int stride1_,
+                                int stride2_, int num,
+                                int channels, int height, int width
+                            ) {
+  const Dtype sumelems = kernel_size_ * kernel_size_ * channels;
+  // the output position (i, j) whose patch at (y1, x1) starts there, -1 if none
+  auto top_index = [&](int y1, int x1, int *i, int *j) {
+    const int ti = y1 - max_displacement_, tj = x1 - max_displacement_;
+    if (ti < 0 || tj < 0 || ti % stride1_ != 0 || tj % stride1_ != 0) return false;
+    *i = ti / stride1_;
+    *j = tj / stride1_;
+    return *i < top_height_ && *j < top_width_;
+  };
+  #pragma omp parallel for schedule(static)
+  for (int ny = 0; ny < num * height; ++ny) {
+    const int nbatch = ny / height, y = ny % height, py = y + pad_size_;
+    std::vector<Dtype> acc1(channels), acc2(channels);
+    for (int x = 0; x < width; ++x) {
+      const int px = x + pad_size_;
+      const Dtype *a1 = tmp1[nbatch][py][px].dptr_;
+      const Dtype *a2 = tmp2[nbatch][py][px].dptr_;
+      std::fill(acc1.begin(), acc1.end(), Dtype(0));
+      std::fill(acc2.begin(), acc2.end(), Dtype(0));
+      for (int top_channel = 0; top_channel < top_channels_; ++top_channel) {
+        const int s2o = (top_channel % neighborhood_grid_width_ -
+                         neighborhood_grid_radius_) * stride2_;
+        const int s2p = (top_channel / neighborhood_grid_width_ -
+                         neighborhood_grid_radius_) * stride2_;
+        for (int h = 0; h < kernel_size_; ++h) {
+          for (int w = 0; w < kernel_size_; ++w) {
+            int i, j;
+            // (py, px) in the patch of data1 at (py - h, px - w)
+            if (top_index(py - h, px - w, &i, &j)) {
+              const Dtype g = out_grad[nbatch][top_channel][i][j] / sumelems;
+              const Dtype *b = tmp2[nbatch][py + s2p][px + s2o].dptr_;
+              for (int c = 0; c < channels; ++c) {
+                acc1[c] += is_multiply ? g * b[c] : (a1[c] >= b[c] ? g : -g);
+              }
+            }
+            // (py, px) in the patch of data2 at (py - h, px - w), displaced by (s2p, s2o)
+            if (top_index(py - s2p - h, px - s2o - w, &i, &j)) {
+              const Dtype g = out_grad[nbatch][top_channel][i][j] / sumelems;
+              const Dtype *b = tmp1[nbatch][py - s2p][px - s2o].dptr_;
+              for (int c = 0; c < channels; ++c) {
+                acc2[c] += is_multiply ? g * b[c] : (b[c] >= a2[c] ? -g : g);
+              }
+            }
+          }
+        }
+      }
+      for (int c = 0; c < channels; ++c) {
+        in_grad1[nbatch][c][y][x] = acc1[c];
+        in_grad2[nbatch][c][y][x] = acc2[c];
+      }
+    }
+  }
+}
+}  // namespace mshadow
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<cpu>(CorrelationParam param, int dtype) {
+  Operator *op = NULL;
+  switch (dtype) {
+  case mshadow::kFloat32:
+    op = new CorrelationOp<cpu, float>(param);
+    break;
+  case mshadow::kFloat64:
+    op = new CorrelationOp<cpu, double>(param);
+    break;
+  case mshadow::kFloat16:
+    LOG(FATAL) << "float16 correlation layer is only supported on gpu.";
+    break;
+  default:
+    LOG(FATAL) << "Unsupported type " << dtype;
+  }
+  return op;
+}
+Operator* CorrelationProp::CreateOperatorEx(Context ctx, std::vector<TShape> *in_shape,
+                                            std::vector<int> *in_type) const {
+  std::vector<TShape> out_shape, aux_shape;
+  std::vector<int> out_type, aux_type;
+  CHECK(InferType(in_type, &out_type, &aux_type));
+  CHECK(InferShape(in_shape, &out_shape, &aux_shape));
+  DO_BIND_DISPATCH(CreateOp, param_, (*in_type)[0]);
+}
+DMLC_REGISTER_PARAMETER(CorrelationParam);
+MXNET_REGISTER_OP_PROPERTY(Correlation, CorrelationProp)
+.describe("Apply correlation to inputs")
+.add_argument("data1", "Symbol", "Input data1 to the correlation.")
+.add_argument("data2", "Symbol", "Input data2 to the correlation.")
+.add_arguments(CorrelationParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
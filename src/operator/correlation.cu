@@ -1,7 +1,8 @@
 /*!
  * Copyright [2016] <Contributors>
  * \file Correation.cu
- * \brief  Correlation operator
+ * \brief  Correlation operator. The multiplicative correlation runs on tiles of
+ *  the inputs staged in shared memory, for float and float16 storage.
  * \author Xu Dong
 */
 #include "./correlation-inl.h"
@@ -13,6 +14,16 @@
 #define ROUND_OFF 50000
 #define WARPS_PER_BLOCK 1
 #define THREADS_PER_WARP 32
+//  output positions along each side of the tile of a block of the tiled forward
+#define CORR_TILE 8
+//  threads of a block of the tiled forward, and (position, displacement) pairs of each
+#define CORR_THREADS 256
+#define CORR_MAX_PAIRS 8
+//  channels and positions of a block of the tiled backward
+#define CORR_BACK_CHANNELS 32
+#define CORR_BACK_POS 8
+//  floats of shared memory used by a block of the tiled kernels
+#define CORR_SHARED_FLOATS 8192
 #define CORRELATION_CUDA_CHECK(condition) \
   /* Code block avoids redefinition of cudaError_t error */ \
   do { \
@@ -54,7 +65,7 @@ __global__ void CorrelateData(const int nthreads, int num, int topwidth,
     }
   }
   __syncthreads();
-  __shared__ Dtype sum[THREADS_PER_WARP * WARPS_PER_BLOCK];
+  __shared__ float sum[THREADS_PER_WARP * WARPS_PER_BLOCK];
   //  Compute correlation
   for (int top_channel = 0; top_channel < topchannels; top_channel++) {
     sum[ch_off] = 0;
@@ -69,19 +80,20 @@ __global__ void CorrelateData(const int nthreads, int num, int topwidth,
           int y2 = y1 + s2p;
           int idxPatchData = ji_off + ch;
           int idx2 = ((item * bottomheight + y2 + j) * bottomwidth + x2 + i) * bottomchannels + ch;
-          sum[ch_off] += patch_data[idxPatchData] * bottom1[idx2];
+          sum[ch_off] += static_cast<float>(patch_data[idxPatchData]) *
+                         static_cast<float>(bottom1[idx2]);
         }
       }
     }
     __syncthreads();
     if (ch_off == 0) {
-        Dtype total_sum = 0;
+        float total_sum = 0;
         for (int idx = 0; idx < THREADS_PER_WARP * WARPS_PER_BLOCK; idx++) {
             total_sum += sum[idx];
         }
         const int sumelems = kernel_size * kernel_size * bottomchannels;
         const int index = ((top_channel * topheight + blockIdx.y) * topwidth) + blockIdx.x;
-        top[index + item*topcount] = total_sum / static_cast<float>(sumelems);
+        top[index + item*topcount] = static_cast<Dtype>(total_sum / static_cast<float>(sumelems));
     }  //  Aggregate result of  different threads
   }
 }
@@ -114,7 +126,7 @@ __global__ void CorrelateDataBackward0(const int nthreads, int num, int item,
     //  floor (l - max_displacement) / stride1
     int ymax = (m - max_displacement + round_off_s1) / stride1 - round_off;
     //  floor (m - max_displacement) / stride1
-    Dtype sum = 0;
+    float sum = 0;
     if (xmax >= 0 && ymax >= 0 && (xmin <= topwidth-1) && (ymin <= topheight-1)) {
         xmin = max(0, xmin);
         xmax = min(topwidth-1, xmax);
@@ -127,7 +139,7 @@ __global__ void CorrelateDataBackward0(const int nthreads, int num, int item,
             int s2p = stride2 * p;
             int idxbot1 = ((item * pbottomheight + (m + s2p)) * pbottomwidth + (l + s2o))\
              * bottomchannels + n;
-            Dtype bot1tmp = bottom1[idxbot1];  // bottom1[l+s2o,m+s2p,n]
+            float bot1tmp = bottom1[idxbot1];  // bottom1[l+s2o,m+s2p,n]
             //  Index offset for topdiff in following loops:
             int op = (p+neighborhood_grid_radius) * neighborhood_grid_width\
              + (o + neighborhood_grid_radius);  //  index [o,p]
@@ -135,7 +147,7 @@ __global__ void CorrelateDataBackward0(const int nthreads, int num, int item,
             for (int y = ymin; y <= ymax; y++) {
               for (int x = xmin; x <= xmax; x++) {
                 int idxtopdiff = (idxopoffset * topheight + y) * topwidth + x;  //  topdiff[x,y,o,p]
-                sum += topdiff[idxtopdiff] * bot1tmp;
+                sum += static_cast<float>(topdiff[idxtopdiff]) * bot1tmp;
               }
             }
           }
@@ -143,7 +155,8 @@ __global__ void CorrelateDataBackward0(const int nthreads, int num, int item,
     }
     const int sumelems = (kernel_radius * 2 + 1) * (kernel_radius * 2+1) * bottomchannels;
     const int bot0index = ((n * bottomheight) + (m-pad_size)) * bottomwidth + (l-pad_size);
-    bottom0diff[bot0index + item * bottomcount] = sum / static_cast<float>(sumelems);
+    bottom0diff[bot0index + item * bottomcount] =
+        static_cast<Dtype>(sum / static_cast<float>(sumelems));
   }
 }
 // == Correlation Backward Pass Kernel (For Blob 1)
@@ -166,7 +179,7 @@ __global__ void CorrelateDataBackward1(const int nthreads,
     //  We use a large offset, for the inner part not to become negative.
     const int round_off = ROUND_OFF;
     const int round_off_s1 = stride1 * round_off;
-    Dtype sum = 0;
+    float sum = 0;
     for (int p = -neighborhood_grid_radius; p <= neighborhood_grid_radius; p++) {
       for (int o = -neighborhood_grid_radius; o <= neighborhood_grid_radius; o++) {
         int s2o = stride2 * o;
@@ -193,7 +206,7 @@ __global__ void CorrelateDataBackward1(const int nthreads,
             //  Get bottom0 data:
             int idxbot0 = ((item * pbottomheight + (m - s2p)) \
             * pbottomwidth + (l - s2o)) * bottomchannels + n;
-            Dtype bot0tmp = bottom0[idxbot0];  //  bottom1[l+s2o,m+s2p,n]
+            float bot0tmp = bottom0[idxbot0];  //  bottom1[l+s2o,m+s2p,n]
             //  Index offset for topdiff in following loops:
             int op = (p+neighborhood_grid_radius) * \
             neighborhood_grid_width + (o+neighborhood_grid_radius);  //  index [o,p]
@@ -202,7 +215,7 @@ __global__ void CorrelateDataBackward1(const int nthreads,
               for (int x = xmin; x <= xmax; x++) {
                 int idxtopdiff = (idxOpOffset * topheight + y)\
                  * topwidth + x;  //  topdiff[x,y,o,p]
-                sum += topdiff[idxtopdiff] * bot0tmp;
+                sum += static_cast<float>(topdiff[idxtopdiff]) * bot0tmp;
               }
             }
         }
@@ -210,7 +223,8 @@ __global__ void CorrelateDataBackward1(const int nthreads,
     }
     const int sumelems = (kernel_radius*2+1)*(kernel_radius*2+1)*bottomchannels;
     const int bot1index = ((n * bottomheight) + (m - pad_size)) * bottomwidth + (l - pad_size);
-    bottom1diff[bot1index + item * bottomcount] = sum / static_cast<float>(sumelems);
+    bottom1diff[bot1index + item * bottomcount] =
+        static_cast<Dtype>(sum / static_cast<float>(sumelems));
   }
 }
 // == Correlation Kernel Subtraction
@@ -232,7 +246,7 @@ __global__ void CorrelateDataSubtract(const int nthreads, int num, int item,
     int x1 = x*stride1 + kernel_radius + max_displacement;
     int y1 = y*stride1 + kernel_radius + max_displacement;
     //  Iterate through 3D patch
-    Dtype sum = 0;
+    float sum = 0;
     for (int j = -kernel_radius; j <= kernel_radius; j++) {  //  HEIGHT
       for (int i = -kernel_radius; i <= kernel_radius; i++) {  //  WIDTH
         for (int l = 0; l < bottomchannels; l++) {  //  CHANNELS
@@ -245,12 +259,12 @@ __global__ void CorrelateDataSubtract(const int nthreads, int num, int item,
           int idx2 = ((item * bottomheight + y2 + j) * bottomwidth + x2 + i) \
           * bottomchannels + l;
           //  Do the correlation:
-          sum += fabsf(bottom0[idx1] - bottom1[idx2]);
+          sum += fabsf(static_cast<float>(bottom0[idx1]) - static_cast<float>(bottom1[idx2]));
         }
       }
     }
     const int sumelems = (kernel_radius * 2 + 1) * (kernel_radius * 2 + 1) * bottomchannels;
-    top[index + item * topcount] = sum / static_cast<float>(sumelems);
+    top[index + item * topcount] = static_cast<Dtype>(sum / static_cast<float>(sumelems));
   }
 }
 //  == Correlation Backward Pass Kernel (For Blob 0)
@@ -285,7 +299,7 @@ __global__ void CorrelateDataBackward0Subtract(const int nthreads, int num,
     //  floor (l - max_displacement) / stride1
     int ymax = (m - max_displacement + round_off_s1) / stride1 - round_off;
     //  floor (m - max_displacement) / stride1
-    Dtype sum = 0;
+    float sum = 0;
     if (xmax >= 0 && ymax >= 0 && (xmin <= topwidth-1) && (ymin <= topheight-1)) {
         xmin = max(0, xmin);
         xmax = min(topwidth-1, xmax);
@@ -300,7 +314,7 @@ __global__ void CorrelateDataBackward0Subtract(const int nthreads, int num,
              + (l+s2o)) * bottomchannels + n;
             Dtype bot0tmp = bottom0[idxbot0];
             Dtype bot1tmp = bottom1[idxbot1];
-            Dtype sign = (bot0tmp >= bot1tmp) ? Dtype(1.0) : Dtype(-1.0);
+            float sign = (bot0tmp >= bot1tmp) ? 1.0f : -1.0f;
             //  Index offset for topdiff in following loops:
             int op = (p+neighborhood_grid_radius) * neighborhood_grid_width\
              + (o + neighborhood_grid_radius);  //  index [o,p]
@@ -308,7 +322,7 @@ __global__ void CorrelateDataBackward0Subtract(const int nthreads, int num,
             for (int y = ymin; y <= ymax; y++) {
               for (int x = xmin; x <= xmax; x++) {
                 int idxtopdiff = (idxopoffset * topheight + y) * topwidth + x;  //  topdiff[x,y,o,p]
-                sum += topdiff[idxtopdiff] * sign;
+                sum += static_cast<float>(topdiff[idxtopdiff]) * sign;
               }
             }
           }
@@ -316,7 +330,8 @@ __global__ void CorrelateDataBackward0Subtract(const int nthreads, int num,
     }
     const int sumelems = (kernel_radius * 2 + 1) * (kernel_radius * 2+1) * bottomchannels;
     const int bot0index = ((n * bottomheight) + (m-pad_size)) * bottomwidth + (l-pad_size);
-    bottom0diff[bot0index + item * bottomcount] = sum / static_cast<float>(sumelems);
+    bottom0diff[bot0index + item * bottomcount] =
+        static_cast<Dtype>(sum / static_cast<float>(sumelems));
   }
 }
 //  == Correlation Backward Pass Kernel (For Blob 1)
@@ -340,7 +355,7 @@ __global__ void CorrelateDataBackward1Subtract(const int nthreads, int num,
     //  We use a large offset, for the inner part not to become negative.
     const int round_off = ROUND_OFF;
     const int round_off_s1 = stride1 * round_off;
-    Dtype sum = 0;
+    float sum = 0;
     int idxbot1 = ((item * pbottomheight + m) * pbottomwidth + l)\
              * bottomchannels + n;
     for (int p = -neighborhood_grid_radius; p <= neighborhood_grid_radius; p++) {
@@ -372,7 +387,7 @@ __global__ void CorrelateDataBackward1Subtract(const int nthreads, int num,
             //  bottom0[l+s2o,m+s2p,n]
             Dtype bot0tmp = bottom0[idxbot0];
             Dtype bot1tmp = bottom1[idxbot1];
-            Dtype sign = (bot0tmp >= bot1tmp) ? Dtype(-1.0) : Dtype(1.0);
+            float sign = (bot0tmp >= bot1tmp) ? -1.0f : 1.0f;
             //  Index offset for topdiff in following loops:
             int op = (p+neighborhood_grid_radius) * \
             neighborhood_grid_width + (o+neighborhood_grid_radius);  //  index [o,p]
@@ -381,7 +396,7 @@ __global__ void CorrelateDataBackward1Subtract(const int nthreads, int num,
               for (int x = xmin; x <= xmax; x++) {
                 int idxtopdiff = (idxOpOffset * topheight + y)\
                  * topwidth + x;  //  topdiff[x,y,o,p]
-                sum += topdiff[idxtopdiff] * sign;
+                sum += static_cast<float>(topdiff[idxtopdiff]) * sign;
               }
             }
         }
@@ -389,7 +404,8 @@ __global__ void CorrelateDataBackward1Subtract(const int nthreads, int num,
     }
     const int sumelems = (kernel_radius*2+1)*(kernel_radius*2+1)*bottomchannels;
     const int bot1index = ((n * bottomheight) + (m - pad_size)) * bottomwidth + (l - pad_size);
-    bottom1diff[bot1index + item * bottomcount] = sum / static_cast<float>(sumelems);
+    bottom1diff[bot1index + item * bottomcount] =
+        static_cast<Dtype>(sum / static_cast<float>(sumelems));
   }
 }
 //  == Forward
@@ -410,6 +426,161 @@ int channels, int width, int height, int widthheight, int padding, int pwidthhei
     int xypad = ypad * (width + 2 * padding) + xpad;
     out[(n * pwidthheight + xypad) * channels + ch] = value;
 }
+//  == Tiled Correlation Kernels
+//  ceil (a / b) and floor (a / b), even for negative a, see ROUND_OFF above
+__device__ inline int CeilDivR(int a, int b) {
+  return (a + ROUND_OFF * b - 1) / b + 1 - ROUND_OFF;
+}
+__device__ inline int FloorDivR(int a, int b) {
+  return (a + ROUND_OFF * b) / b - ROUND_OFF;
+}
+//  A block computes a CORR_TILE x CORR_TILE tile of output positions for one row p of
+//  displacements. Each chunk of channels of the image 1 patch under the tile, and of the
+//  image 2 patch under all its displacements of row p, is loaded once into shared memory
+//  as float, from which the threads accumulate their (position, displacement) pairs.
+template <typename Dtype>
+__global__ void CorrelateDataTiled(int topwidth, int topheight, int topchannels,
+  int max_displacement, int neighborhood_grid_radius, int neighborhood_grid_width,
+  int kernel_size, int stride1, int stride2,
+  int bottomwidth, int bottomheight, int bottomchannels, int chunk,
+  const Dtype *bottom0, const Dtype *bottom1, Dtype *top) {
+  extern __shared__ float tile_data[];
+  const int item = blockIdx.z / neighborhood_grid_width;
+  const int prow = blockIdx.z % neighborhood_grid_width;
+  const int tx0 = blockIdx.x * CORR_TILE;
+  const int ty0 = blockIdx.y * CORR_TILE;
+  //  patch of image 1 under the tile, and of image 2 under all its displacements of row p
+  const int disp = neighborhood_grid_radius * stride2;
+  const int ph = (CORR_TILE - 1) * stride1 + kernel_size;
+  const int pw = ph;
+  const int pw2 = pw + 2 * disp;
+  const int x1 = tx0 * stride1 + max_displacement;
+  const int y1 = ty0 * stride1 + max_displacement;
+  const int x2 = x1 - disp;
+  const int y2 = y1 + (prow - neighborhood_grid_radius) * stride2;
+  const int npairs = CORR_TILE * CORR_TILE * neighborhood_grid_width;
+  float acc[CORR_MAX_PAIRS];
+  #pragma unroll
+  for (int k = 0; k < CORR_MAX_PAIRS; ++k) acc[k] = 0.0f;
+  for (int c0 = 0; c0 < bottomchannels; c0 += chunk) {
+    const int nc = min(chunk, bottomchannels - c0);
+    float *patch1 = tile_data;
+    float *patch2 = tile_data + ph * pw * nc;
+    __syncthreads();
+    for (int e = threadIdx.x; e < ph * pw * nc; e += blockDim.x) {
+      const int c = e % nc, x = (e / nc) % pw, y = e / nc / pw;
+      patch1[e] = (y1 + y < bottomheight && x1 + x < bottomwidth) ? static_cast<float>(
+          bottom0[((item * bottomheight + y1 + y) * bottomwidth + x1 + x) * bottomchannels
+                  + c0 + c]) : 0.0f;
+    }
+    for (int e = threadIdx.x; e < ph * pw2 * nc; e += blockDim.x) {
+      const int c = e % nc, x = (e / nc) % pw2, y = e / nc / pw2;
+      patch2[e] = (y2 + y < bottomheight && x2 + x < bottomwidth) ? static_cast<float>(
+          bottom1[((item * bottomheight + y2 + y) * bottomwidth + x2 + x) * bottomchannels
+                  + c0 + c]) : 0.0f;
+    }
+    __syncthreads();
+    #pragma unroll
+    for (int k = 0; k < CORR_MAX_PAIRS; ++k) {
+      const int idx = threadIdx.x + k * blockDim.x;
+      if (idx >= npairs) break;
+      const int o = idx % neighborhood_grid_width;
+      const int px = (idx / neighborhood_grid_width) % CORR_TILE;
+      const int py = idx / neighborhood_grid_width / CORR_TILE;
+      float sum = 0.0f;
+      for (int j = 0; j < kernel_size; ++j) {
+        for (int i = 0; i < kernel_size; ++i) {
+          const float *a = patch1 + ((py * stride1 + j) * pw + px * stride1 + i) * nc;
+          const float *b = patch2 + ((py * stride1 + j) * pw2 + px * stride1 + i
+                                     + o * stride2) * nc;
+          for (int c = 0; c < nc; ++c) sum += a[c] * b[c];
+        }
+      }
+      acc[k] += sum;
+    }
+  }
+  const float sumelems = kernel_size * kernel_size * bottomchannels;
+  #pragma unroll
+  for (int k = 0; k < CORR_MAX_PAIRS; ++k) {
+    const int idx = threadIdx.x + k * blockDim.x;
+    if (idx >= npairs) break;
+    const int o = idx % neighborhood_grid_width;
+    const int x = tx0 + (idx / neighborhood_grid_width) % CORR_TILE;
+    const int y = ty0 + idx / neighborhood_grid_width / CORR_TILE;
+    if (x >= topwidth || y >= topheight) continue;
+    const int top_channel = prow * neighborhood_grid_width + o;
+    top[((item * topchannels + top_channel) * topheight + y) * topwidth + x] =
+        static_cast<Dtype>(acc[k] / sumelems);
+  }
+}
+//  The gradient of image 1 (kSecond = false) or image 2 (kSecond = true). A block of
+//  CORR_BACK_CHANNELS x CORR_BACK_POS threads computes a chunk of channels of a row
+//  segment of positions. For each chunk of displacements, the boxes of topdiff that the
+//  windows of the segment cover are loaded once into shared memory, and the threads add
+//  them up times the other image, read coalesced over the channels.
+template <typename Dtype, bool kSecond>
+__global__ void CorrelateDataBackwardTiled(int topwidth, int topheight, int topchannels,
+  int max_displacement, int neighborhood_grid_radius, int neighborhood_grid_width,
+  int kernel_radius, int stride1, int stride2,
+  int bottomwidth, int bottomheight, int pbottomwidth, int pbottomheight,
+  int bottomchannels, int pad_size, int box_h, int box_w, int op_chunk,
+  const Dtype *other, const Dtype *topdiff, Dtype *bottomdiff) {
+  extern __shared__ float box_data[];
+  const int cchunks = (bottomchannels + CORR_BACK_CHANNELS - 1) / CORR_BACK_CHANNELS;
+  const int item = blockIdx.z / cchunks;
+  const int c = (blockIdx.z % cchunks) * CORR_BACK_CHANNELS + threadIdx.x;
+  const int l0 = blockIdx.x * CORR_BACK_POS + pad_size;
+  const int l = l0 + threadIdx.y;
+  const int m = blockIdx.y + pad_size;
+  const bool active = c < bottomchannels && l < bottomwidth + pad_size;
+  const int tid = threadIdx.y * blockDim.x + threadIdx.x;
+  const int nthreads = blockDim.x * blockDim.y;
+  float sum = 0.0f;
+  for (int op0 = 0; op0 < topchannels; op0 += op_chunk) {
+    const int nops = min(op_chunk, topchannels - op0);
+    __syncthreads();
+    for (int e = tid; e < nops * box_h * box_w; e += nthreads) {
+      const int op = op0 + e / (box_h * box_w);
+      const int s2o = (op % neighborhood_grid_width - neighborhood_grid_radius) * stride2;
+      const int s2p = (op / neighborhood_grid_width - neighborhood_grid_radius) * stride2;
+      const int x = CeilDivR(l0 - 2 * kernel_radius - max_displacement - (kSecond ? s2o : 0),
+                             stride1) + e % box_w;
+      const int y = CeilDivR(m - 2 * kernel_radius - max_displacement - (kSecond ? s2p : 0),
+                             stride1) + (e / box_w) % box_h;
+      box_data[e] = (x >= 0 && x < topwidth && y >= 0 && y < topheight) ? static_cast<float>(
+          topdiff[((item * topchannels + op) * topheight + y) * topwidth + x]) : 0.0f;
+    }
+    __syncthreads();
+    if (!active) continue;
+    for (int k = 0; k < nops; ++k) {
+      const int op = op0 + k;
+      const int s2o = (op % neighborhood_grid_width - neighborhood_grid_radius) * stride2;
+      const int s2p = (op / neighborhood_grid_width - neighborhood_grid_radius) * stride2;
+      const int so = kSecond ? s2o : 0, sp = kSecond ? s2p : 0;
+      const int xmin = CeilDivR(l - 2 * kernel_radius - max_displacement - so, stride1);
+      const int xmax = FloorDivR(l - max_displacement - so, stride1);
+      const int ymin = CeilDivR(m - 2 * kernel_radius - max_displacement - sp, stride1);
+      const int ymax = FloorDivR(m - max_displacement - sp, stride1);
+      if (xmax < 0 || ymax < 0 || xmin > topwidth - 1 || ymin > topheight - 1) continue;
+      //  the box starts at the windows of l0, those outside of the output are zero
+      const int bx0 = CeilDivR(l0 - 2 * kernel_radius - max_displacement - so, stride1);
+      const int by0 = ymin;
+      const float *box = box_data + k * box_h * box_w;
+      float g = 0.0f;
+      for (int y = ymin; y <= ymax; ++y) {
+        for (int x = xmin; x <= xmax; ++x) g += box[(y - by0) * box_w + x - bx0];
+      }
+      const int ly = kSecond ? m - s2p : m + s2p;
+      const int lx = kSecond ? l - s2o : l + s2o;
+      sum += g * static_cast<float>(
+          other[((item * pbottomheight + ly) * pbottomwidth + lx) * bottomchannels + c]);
+    }
+  }
+  if (!active) return;
+  const float sumelems = (kernel_radius * 2 + 1) * (kernel_radius * 2 + 1) * bottomchannels;
+  bottomdiff[((item * bottomchannels + c) * bottomheight + m - pad_size) * bottomwidth
+             + l - pad_size] = static_cast<Dtype>(sum / sumelems);
+}
 template <typename Dtype>
 void Forward_gpu(
       const Tensor<gpu, 4, Dtype> &out,
@@ -446,7 +617,27 @@ void Forward_gpu(
     const int height = bheight + 2 * pad_size_;
     const int width = bwidth + 2 * pad_size_;
     const int shared_memory_per_block = (kernel_size_ * kernel_size_) * bchannels;
-    if (is_multiply == true) {
+    //  the tiled kernel, when the pairs of a tile fit its threads and one channel of its
+    //  patches fits in shared memory
+    const int patch_h = (CORR_TILE - 1) * stride1_ + kernel_size_;
+    const int patch_floats = patch_h * patch_h +
+        patch_h * (patch_h + 2 * neighborhood_grid_radius_ * stride2_);
+    const bool tiled = CORR_TILE * CORR_TILE * neighborhood_grid_width_ <=
+        CORR_THREADS * CORR_MAX_PAIRS && patch_floats <= CORR_SHARED_FLOATS;
+    if (is_multiply == true && tiled) {
+        const int chunk = std::min(channels, CORR_SHARED_FLOATS / patch_floats);
+        dim3 totalBlocksCorr((top_width_ + CORR_TILE - 1) / CORR_TILE,
+                             (top_height_ + CORR_TILE - 1) / CORR_TILE,
+                             num * neighborhood_grid_width_);
+        CorrelateDataTiled<Dtype><<<totalBlocksCorr, CORR_THREADS,
+        chunk * patch_floats * sizeof(float), stream>>>(
+            top_width_, top_height_, top_channels_,
+            max_displacement_, neighborhood_grid_radius_, neighborhood_grid_width_,
+            kernel_size_, stride1_, stride2_,
+            width, height, channels, chunk,
+            rbot1, rbot2, top);
+        CORRELATION_CUDA_CHECK(cudaPeekAtLastError());
+    } else if (is_multiply == true) {
         //  CorrelationLayer
         int topThreadCount = topcount;
         dim3 totalBlocksCorr(top_width_, top_height_, num);
@@ -501,8 +692,33 @@ void Backward_gpu(
     const int bottomcount = channels * height * width;
     int botThreadCount = bottomcount;
     const int gridSize = (botThreadCount + kMaxThreadsPerBlock - 1) / kMaxThreadsPerBlock;
+    //  the tiled kernels, when the topdiff box of a displacement fits in shared memory
+    const int box_h = 2 * kernel_radius_ / stride1_ + 1;
+    const int box_w = (CORR_BACK_POS - 1 + 2 * kernel_radius_) / stride1_ + 1;
+    const int op_chunk = std::min(top_channels_, CORR_SHARED_FLOATS / (box_h * box_w));
     //  CorrelationLayerBackward
-    if (is_multiply == true) {
+    if (is_multiply == true && op_chunk > 0) {
+        dim3 threadsBackward(CORR_BACK_CHANNELS, CORR_BACK_POS);
+        dim3 totalBlocksBackward((width + CORR_BACK_POS - 1) / CORR_BACK_POS, height,
+            num * ((channels + CORR_BACK_CHANNELS - 1) / CORR_BACK_CHANNELS));
+        const size_t shared_bytes = op_chunk * box_h * box_w * sizeof(float);
+        CorrelateDataBackwardTiled<Dtype, false><<<totalBlocksBackward, threadsBackward,
+        shared_bytes, stream0>>>(
+            top_width_, top_height_, top_channels_,
+            max_displacement_, neighborhood_grid_radius_, neighborhood_grid_width_,
+            kernel_radius_, stride1_, stride2_,
+            width, height, paddedwidth, paddedheight, channels, pad_size_,
+            box_h, box_w, op_chunk, rbot2, top_diff, bottom0_diff);
+        CORRELATION_CUDA_CHECK(cudaPeekAtLastError());
+        CorrelateDataBackwardTiled<Dtype, true><<<totalBlocksBackward, threadsBackward,
+        shared_bytes, stream1>>>(
+            top_width_, top_height_, top_channels_,
+            max_displacement_, neighborhood_grid_radius_, neighborhood_grid_width_,
+            kernel_radius_, stride1_, stride2_,
+            width, height, paddedwidth, paddedheight, channels, pad_size_,
+            box_h, box_w, op_chunk, rbot1, top_diff, bottom1_diff);
+        CORRELATION_CUDA_CHECK(cudaPeekAtLastError());
+    } else if (is_multiply == true) {
         //  == Run kernel Backward 0
         dim3 totalBlocksBackward0(width, height, channels * num);  //  First dim is fastest
         const int buffer_size_backw0 = \
@@ -602,8 +818,12 @@ inline void CorrelationBackward(const Tensor<gpu, 4, Dtype> &out_grad,
 namespace mxnet {
 namespace op {
 template<>
-Operator* CreateOp<gpu>(CorrelationParam param) {
-  return new CorrelationOp<gpu>(param);
+Operator* CreateOp<gpu>(CorrelationParam param, int dtype) {
+  Operator *op = NULL;
+  MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
+    op = new CorrelationOp<gpu, DType>(param);
+  })
+  return op;
 }
 }  // namespace op
 }  // namespace mxnet
@@ -0,0 +1,423 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file cpu_convolution-inl.h
+ * \brief convolution forward tuned for cpu inference.
+ *
+ *  - 1x1 convolutions of stride 1 are one GEMM on the input, without unpacking patches.
+ *  - 3x3 convolutions of stride 1 use Winograd F(2x2, 3x3), which needs 16 multiplies
+ *    for each 2x2 output tile instead of 36.
+ *  - The others unpack patches of one image at a time, parallel over the rows,
+ *    and write the GEMM result directly to the output.
+ *  - A pruned weight is kept in CSR for inference, see sparse_weight-inl.h, and
+ *    multiplies the unpacked patches, or the image itself for the 1x1 convolutions.
+ *  The bias and the fused activation are applied to each image right after its GEMMs,
+ *  while the output is still in cache. Backward is the im2col implementation of
+ *  ConvolutionOp.
+ */
+#ifndef MXNET_OPERATOR_CPU_CONVOLUTION_INL_H_
+#define MXNET_OPERATOR_CPU_CONVOLUTION_INL_H_
+
+#include <algorithm>
+#include <vector>
+#include "./convolution-inl.h"
+#include "./mshadow_op_simd.h"
+#include "./sparse_weight-inl.h"
+
+namespace mxnet {
+namespace op {
+namespace cpuconv {
+/*!
+ * \brief unpack the patches of one image, col is (c, ky, kx) x (oy, ox).
+ */
+template<typename DType>
+inline void Im2col(const DType *x, int C, int H, int W, int Ho, int Wo,
+                   int kh, int kw, int sy, int sx, int py, int px, int dy, int dx,
+                   DType *col) {
+  const int nrow = C * kh * kw;
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < nrow; ++r) {
+    const int kx = r % kw, ky = (r / kw) % kh, c = r / (kw * kh);
+    const DType *src = x + static_cast<size_t>(c) * H * W;
+    DType *dst = col + static_cast<size_t>(r) * Ho * Wo;
+    for (int oy = 0; oy < Ho; ++oy, dst += Wo) {
+      const int iy = oy * sy - py + ky * dy;
+      if (iy < 0 || iy >= H) {
+        std::fill(dst, dst + Wo, DType(0));
+        continue;
+      }
+      const DType *row = src + iy * W;
+      for (int ox = 0; ox < Wo; ++ox) {
+        const int ix = ox * sx - px + kx * dx;
+        dst[ox] = (ix >= 0 && ix < W) ? row[ix] : DType(0);
+      }
+    }
+  }
+}
+
+/*! \brief u = G g G^T of a 3x3 kernel g */
+inline void WinogradKernel(const float *g, float *u) {
+  float t[12];
+  for (int j = 0; j < 3; ++j) {
+    t[j] = g[j];
+    t[3 + j] = 0.5f * (g[j] + g[3 + j] + g[6 + j]);
+    t[6 + j] = 0.5f * (g[j] - g[3 + j] + g[6 + j]);
+    t[9 + j] = g[6 + j];
+  }
+  for (int i = 0; i < 4; ++i) {
+    const float *r = t + i * 3;
+    u[i * 4] = r[0];
+    u[i * 4 + 1] = 0.5f * (r[0] + r[1] + r[2]);
+    u[i * 4 + 2] = 0.5f * (r[0] - r[1] + r[2]);
+    u[i * 4 + 3] = r[2];
+  }
+}
+
+/*! \brief v = B^T d B of a 4x4 input tile d */
+inline void WinogradInput(const float *d, float *v) {
+  float t[16];
+  for (int j = 0; j < 4; ++j) {
+    t[j] = d[j] - d[8 + j];
+    t[4 + j] = d[4 + j] + d[8 + j];
+    t[8 + j] = d[8 + j] - d[4 + j];
+    t[12 + j] = d[4 + j] - d[12 + j];
+  }
+  for (int i = 0; i < 4; ++i) {
+    const float *r = t + i * 4;
+    v[i * 4] = r[0] - r[2];
+    v[i * 4 + 1] = r[1] + r[2];
+    v[i * 4 + 2] = r[2] - r[1];
+    v[i * 4 + 3] = r[1] - r[3];
+  }
+}
+
+/*! \brief y = A^T m A, the 2x2 output tile of a transformed 4x4 tile m */
+inline void WinogradOutput(const float *m, float *y) {
+  float t[8];
+  for (int j = 0; j < 4; ++j) {
+    t[j] = m[j] + m[4 + j] + m[8 + j];
+    t[4 + j] = m[4 + j] - m[8 + j] - m[12 + j];
+  }
+  for (int i = 0; i < 2; ++i) {
+    const float *r = t + i * 4;
+    y[i * 2] = r[0] + r[1] + r[2];
+    y[i * 2 + 1] = r[1] - r[2] - r[3];
+  }
+}
+
+/*!
+ * \brief transform the input tiles of one image, v is 16 matrices of C x (th * tw).
+ */
+inline void WinogradInputTiles(const float *x, int C, int H, int W, int th, int tw,
+                               int py, int px, float *v) {
+  const int ntile = th * tw;
+  #pragma omp parallel for schedule(static)
+  for (int ct = 0; ct < C * th; ++ct) {
+    const int c = ct / th, ty = ct % th;
+    const float *src = x + static_cast<size_t>(c) * H * W;
+    float d[16], u[16];
+    for (int tx = 0; tx < tw; ++tx) {
+      for (int i = 0; i < 4; ++i) {
+        const int iy = ty * 2 + i - py;
+        for (int j = 0; j < 4; ++j) {
+          const int ix = tx * 2 + j - px;
+          d[i * 4 + j] = (iy >= 0 && iy < H && ix >= 0 && ix < W) ? src[iy * W + ix] : 0.0f;
+        }
+      }
+      WinogradInput(d, u);
+      const size_t p = static_cast<size_t>(c) * ntile + ty * tw + tx;
+      for (int xi = 0; xi < 16; ++xi) {
+        v[xi * static_cast<size_t>(C) * ntile + p] = u[xi];
+      }
+    }
+  }
+}
+
+/*!
+ * \brief transform the products back to the output of one image,
+ *  m is 16 matrices of K x (th * tw), y is K x Ho x Wo.
+ */
+inline void WinogradOutputTiles(const float *m, int K, int Ho, int Wo, int th, int tw,
+                                float *y) {
+  const int ntile = th * tw;
+  #pragma omp parallel for schedule(static)
+  for (int kt = 0; kt < K * th; ++kt) {
+    const int k = kt / th, ty = kt % th;
+    float *dst = y + static_cast<size_t>(k) * Ho * Wo;
+    float u[16], r[4];
+    for (int tx = 0; tx < tw; ++tx) {
+      const size_t p = static_cast<size_t>(k) * ntile + ty * tw + tx;
+      for (int xi = 0; xi < 16; ++xi) {
+        u[xi] = m[xi * static_cast<size_t>(K) * ntile + p];
+      }
+      WinogradOutput(u, r);
+      for (int i = 0; i < 2 && ty * 2 + i < Ho; ++i) {
+        for (int j = 0; j < 2 && tx * 2 + j < Wo; ++j) {
+          dst[(ty * 2 + i) * Wo + tx * 2 + j] = r[i * 2 + j];
+        }
+      }
+    }
+  }
+}
+
+template<typename OP>
+inline void BiasActivation(float *y, const float *bias, int K, int hw) {
+  #pragma omp parallel for schedule(static)
+  for (int k = 0; k < K; ++k) {
+    float *row = y + static_cast<size_t>(k) * hw;
+    const float b = bias != NULL ? bias[k] : 0.0f;
+    if (mshadow_op::simd::Kernel<OP>::kEnabled && mshadow_op::simd::Enabled()) {
+      if (bias != NULL) {
+        for (int i = 0; i < hw; ++i) row[i] += b;
+      }
+      mshadow_op::simd::Map<OP>(row, row, hw);
+    } else {
+      for (int i = 0; i < hw; ++i) row[i] = OP::Map(row[i] + b);
+    }
+  }
+}
+
+/*! \brief y = act(y + bias) over the K channels of one image */
+inline void BiasActivation(float *y, const float *bias, int K, int hw, int act_type) {
+  switch (act_type) {
+    case conv::kActReLU:
+      BiasActivation<mshadow_op::relu>(y, bias, K, hw);
+      break;
+    case conv::kActSigmoid:
+      BiasActivation<mshadow_op::sigmoid>(y, bias, K, hw);
+      break;
+    case conv::kActTanh:
+      BiasActivation<mshadow_op::tanh>(y, bias, K, hw);
+      break;
+    case conv::kActSoftReLU:
+      BiasActivation<mshadow_op::softrelu>(y, bias, K, hw);
+      break;
+    default:
+      if (bias != NULL) BiasActivation<mshadow_op::identity>(y, bias, K, hw);
+      break;
+  }
+}
+}  // namespace cpuconv
+
+class CPUConvolutionOp : public ConvolutionOp<cpu, float> {
+ public:
+  /*!
+   * \brief constructor
+   * \param p the parameters
+   * \param sparse_density largest fraction of non zeros of a weight kept in CSR for
+   *  inference, 0 to never keep it.
+   */
+  CPUConvolutionOp(ConvolutionParam p, float sparse_density)
+      : ConvolutionOp<cpu, float>(p), bias_(NULL), sparse_density_(sparse_density) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    CHECK_EQ(req[conv::kOut], kWriteTo);
+    size_t expected = param_.no_bias ? 2 : 3;
+    CHECK_EQ(in_data.size(), expected);
+    CHECK_EQ(out_data.size(), 1);
+    CHECK_EQ(in_data[conv::kWeight].CheckContiguous(), true);
+    Stream<cpu> *s = ctx.get_stream<cpu>();
+    Tensor<cpu, 4, float> data = in_data[conv::kData].get<cpu, 4, float>(s);
+    Tensor<cpu, 4, float> out = out_data[conv::kOut].get<cpu, 4, float>(s);
+    const float *weight = static_cast<const float*>(in_data[conv::kWeight].dptr_);
+    bias_ = param_.no_bias ? NULL : static_cast<const float*>(in_data[conv::kBias].dptr_);
+    if (sparse_density_ > 0.0f && !ctx.is_train) {
+      const int rows = static_cast<int>(param_.num_filter);
+      const int cols = static_cast<int>(in_data[conv::kWeight].shape_.Size() / rows);
+      if (watcher_.Changed(weight, static_cast<size_t>(rows) * cols)) {
+        csr_ = sparsew::CSRWeight();
+        csr_.Convert(weight, rows, cols, sparse_density_);
+      }
+      if (!csr_.empty()) {
+        ForwardSparse(ctx, data, out);
+        return;
+      }
+    }
+    if (IsPointwise()) {
+      ForwardPointwise(data, weight, out);
+    } else if (param_.kernel[0] == 3 && param_.kernel[1] == 3 &&
+               param_.stride[0] == 1 && param_.stride[1] == 1 &&
+               param_.dilate[0] == 1 && param_.dilate[1] == 1) {
+      ForwardWinograd(ctx, data, weight, out);
+    } else {
+      ForwardIm2col(ctx, data, weight, out);
+    }
+  }
+
+ private:
+  // whether the kernel is 1x1 of stride 1 without padding, the image is its own patches
+  inline bool IsPointwise() const {
+    return param_.kernel[0] == 1 && param_.kernel[1] == 1 &&
+        param_.stride[0] == 1 && param_.stride[1] == 1 &&
+        param_.pad[0] == 0 && param_.pad[1] == 0;
+  }
+
+  // the epilogue of image n
+  inline void Epilogue(const mshadow::Tensor<cpu, 4, float> &out, index_t n) {
+    const int hw = static_cast<int>(out.size(2) * out.size(3));
+    cpuconv::BiasActivation(out.dptr_ + n * out.size(1) * hw, bias_,
+                            static_cast<int>(out.size(1)), hw, param_.act_type);
+  }
+
+  // out[n][g] = weight[g] * data[n][g], the image is already the column matrix
+  inline void ForwardPointwise(const mshadow::Tensor<cpu, 4, float> &data,
+                               const float *weight,
+                               const mshadow::Tensor<cpu, 4, float> &out) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    const index_t ngroup = param_.num_group;
+    const index_t C = data.size(1) / ngroup, K = param_.num_filter / ngroup;
+    const index_t hw = data.size(2) * data.size(3);
+    for (index_t n = 0; n < data.size(0); ++n) {
+      for (index_t g = 0; g < ngroup; ++g) {
+        Tensor<cpu, 2, float> x(data.dptr_ + (n * data.size(1) + g * C) * hw,
+                                Shape2(C, hw), data.stream_);
+        Tensor<cpu, 2, float> w(const_cast<float*>(weight) + g * K * C,
+                                Shape2(K, C), data.stream_);
+        Tensor<cpu, 2, float> y(out.dptr_ + (n * out.size(1) + g * K) * hw,
+                                Shape2(K, hw), data.stream_);
+        y = dot(w, x);
+      }
+      Epilogue(out, n);
+    }
+  }
+
+  inline void ForwardIm2col(const OpContext &ctx,
+                            const mshadow::Tensor<cpu, 4, float> &data,
+                            const float *weight,
+                            const mshadow::Tensor<cpu, 4, float> &out) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    const index_t ngroup = param_.num_group;
+    const index_t C = data.size(1) / ngroup, K = param_.num_filter / ngroup;
+    const index_t ksize = param_.kernel[0] * param_.kernel[1];
+    const index_t ohw = out.size(2) * out.size(3);
+    const index_t required_size = data.size(1) * ksize * ohw;
+    CHECK_GE(param_.workspace, required_size)
+      << "\nMinimum workspace size: " << required_size * sizeof(float) << " Bytes\n"
+      << "Given: " << param_.workspace * sizeof(float) << " Bytes";
+    Tensor<cpu, 1, float> workspace =
+        ctx.requested[conv::kTempSpace].get_space_typed<cpu, 1, float>(
+            Shape1(required_size), data.stream_);
+    for (index_t n = 0; n < data.size(0); ++n) {
+      cpuconv::Im2col(data[n].dptr_, data.size(1), data.size(2), data.size(3),
+                      out.size(2), out.size(3), param_.kernel[0], param_.kernel[1],
+                      param_.stride[0], param_.stride[1], param_.pad[0], param_.pad[1],
+                      param_.dilate[0], param_.dilate[1], workspace.dptr_);
+      for (index_t g = 0; g < ngroup; ++g) {
+        Tensor<cpu, 2, float> col(workspace.dptr_ + g * C * ksize * ohw,
+                                  Shape2(C * ksize, ohw), data.stream_);
+        Tensor<cpu, 2, float> w(const_cast<float*>(weight) + g * K * C * ksize,
+                                Shape2(K, C * ksize), data.stream_);
+        Tensor<cpu, 2, float> y(out.dptr_ + (n * out.size(1) + g * K) * ohw,
+                                Shape2(K, ohw), data.stream_);
+        y = dot(w, col);
+      }
+      Epilogue(out, n);
+    }
+  }
+
+  // out[n][g] = csr weight[g] * the patches of data[n][g]
+  inline void ForwardSparse(const OpContext &ctx,
+                            const mshadow::Tensor<cpu, 4, float> &data,
+                            const mshadow::Tensor<cpu, 4, float> &out) {
+    using namespace mshadow;
+    const index_t ngroup = param_.num_group;
+    const index_t C = data.size(1) / ngroup, K = param_.num_filter / ngroup;
+    const index_t ksize = param_.kernel[0] * param_.kernel[1];
+    const index_t ohw = out.size(2) * out.size(3);
+    const bool pointwise = IsPointwise();
+    float *col = NULL;
+    if (!pointwise) {
+      const index_t required_size = data.size(1) * ksize * ohw;
+      CHECK_GE(param_.workspace, required_size)
+        << "\nMinimum workspace size: " << required_size * sizeof(float) << " Bytes\n"
+        << "Given: " << param_.workspace * sizeof(float) << " Bytes";
+      col = ctx.requested[conv::kTempSpace].get_space_typed<cpu, 1, float>(
+          Shape1(required_size), data.stream_).dptr_;
+    }
+    for (index_t n = 0; n < data.size(0); ++n) {
+      if (!pointwise) {
+        cpuconv::Im2col(data[n].dptr_, data.size(1), data.size(2), data.size(3),
+                        out.size(2), out.size(3), param_.kernel[0], param_.kernel[1],
+                        param_.stride[0], param_.stride[1], param_.pad[0], param_.pad[1],
+                        param_.dilate[0], param_.dilate[1], col);
+      }
+      const float *x = pointwise ? data[n].dptr_ : col;
+      for (index_t g = 0; g < ngroup; ++g) {
+        sparsew::MatMul(csr_, static_cast<int>(g * K), static_cast<int>((g + 1) * K),
+                        x + g * C * ksize * ohw, static_cast<int>(ohw),
+                        out.dptr_ + (n * out.size(1) + g * K) * ohw);
+      }
+      Epilogue(out, n);
+    }
+  }
+
+  // the product of each of the 16 transformed positions is a GEMM over the channels
+  inline void ForwardWinograd(const OpContext &ctx,
+                              const mshadow::Tensor<cpu, 4, float> &data,
+                              const float *weight,
+                              const mshadow::Tensor<cpu, 4, float> &out) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    const index_t ngroup = param_.num_group;
+    const index_t C = data.size(1) / ngroup, K = param_.num_filter / ngroup;
+    const index_t Ho = out.size(2), Wo = out.size(3);
+    const index_t th = (Ho + 1) / 2, tw = (Wo + 1) / 2, ntile = th * tw;
+    const index_t usize = 16 * param_.num_filter * C;
+    const index_t required_size = usize + 16 * C * ntile + 16 * K * ntile;
+    CHECK_GE(param_.workspace, required_size)
+      << "\nMinimum workspace size: " << required_size * sizeof(float) << " Bytes\n"
+      << "Given: " << param_.workspace * sizeof(float) << " Bytes";
+    Tensor<cpu, 1, float> workspace =
+        ctx.requested[conv::kTempSpace].get_space_typed<cpu, 1, float>(
+            Shape1(required_size), data.stream_);
+    // u[g][xi] is the K x C matrix of transformed kernels of group g at position xi
+    float *u = workspace.dptr_;
+    float *v = u + usize;
+    float *m = v + 16 * C * ntile;
+    const int nkernel = static_cast<int>(param_.num_filter * C);
+    #pragma omp parallel for schedule(static)
+    for (int kc = 0; kc < nkernel; ++kc) {
+      const index_t g = kc / (K * C), k = (kc / C) % K, c = kc % C;
+      float t[16];
+      cpuconv::WinogradKernel(weight + static_cast<size_t>(kc) * 9, t);
+      for (int xi = 0; xi < 16; ++xi) {
+        u[((g * 16 + xi) * K + k) * C + c] = t[xi];
+      }
+    }
+    for (index_t n = 0; n < data.size(0); ++n) {
+      for (index_t g = 0; g < ngroup; ++g) {
+        cpuconv::WinogradInputTiles(data[n].dptr_ + g * C * data.size(2) * data.size(3),
+                                    C, data.size(2), data.size(3), th, tw,
+                                    param_.pad[0], param_.pad[1], v);
+        for (index_t xi = 0; xi < 16; ++xi) {
+          Tensor<cpu, 2, float> uxi(u + (g * 16 + xi) * K * C, Shape2(K, C), data.stream_);
+          Tensor<cpu, 2, float> vxi(v + xi * C * ntile, Shape2(C, ntile), data.stream_);
+          Tensor<cpu, 2, float> mxi(m + xi * K * ntile, Shape2(K, ntile), data.stream_);
+          mxi = dot(uxi, vxi);
+        }
+        cpuconv::WinogradOutputTiles(m, K, Ho, Wo, th, tw,
+                                     out.dptr_ + (n * out.size(1) + g * K) * Ho * Wo);
+      }
+      Epilogue(out, n);
+    }
+  }
+
+  // bias of the current forward, NULL without bias
+  const float *bias_;
+  // largest fraction of non zeros of the weight kept in CSR
+  float sparse_density_;
+  // the CSR weight, empty when it is dense
+  sparsew::CSRWeight csr_;
+  // the changes of the weight
+  sparsew::WeightWatcher watcher_;
+};  // class CPUConvolutionOp
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CPU_CONVOLUTION_INL_H_
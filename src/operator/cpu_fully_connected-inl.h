@@ -0,0 +1,147 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file cpu_fully_connected-inl.h
+ * \brief fully connected forward on prepacked weights for cpu inference of small batches.
+ *
+ *  The (N, K) weight is packed once into panels of 8 output rows interleaved by column,
+ *  so that the kernel reads each panel contiguously and keeps the 4 x 8 outputs of a
+ *  block of the batch in registers, instead of the BLAS packing the weight on each call.
+ *  The panels run in parallel. The weight is packed again when it changes, which is
+ *  found by its address and a sample of its values. A pruned weight is kept in CSR
+ *  instead, see sparse_weight-inl.h.
+ */
+#ifndef MXNET_OPERATOR_CPU_FULLY_CONNECTED_INL_H_
+#define MXNET_OPERATOR_CPU_FULLY_CONNECTED_INL_H_
+
+#include <algorithm>
+#include <vector>
+#include "./fully_connected-inl.h"
+#include "./sparse_weight-inl.h"
+
+namespace mxnet {
+namespace op {
+namespace cpufc {
+/*! \brief output rows of a panel of the packed weight */
+const int kPanel = 8;
+/*! \brief rows of the batch computed together */
+const int kRows = 4;
+
+/*! \brief pack the (N, K) weight w into panels of kPanel rows, the last one zero padded */
+inline void PackWeight(const float *w, int N, int K, float *packed) {
+  const int npanel = (N + kPanel - 1) / kPanel;
+  #pragma omp parallel for schedule(static)
+  for (int p = 0; p < npanel; ++p) {
+    float *dst = packed + static_cast<size_t>(p) * K * kPanel;
+    for (int j = 0; j < kPanel; ++j) {
+      const int n = p * kPanel + j;
+      const float *src = w + static_cast<size_t>(n) * K;
+      for (int k = 0; k < K; ++k) dst[k * kPanel + j] = n < N ? src[k] : 0.0f;
+    }
+  }
+}
+
+/*! \brief acc = the kR rows of x times the panel, acc is kR x kPanel */
+template<int kR>
+inline void PanelKernel(const float *x, int K, const float *panel, float *acc) {
+  float sum[kR][kPanel] = {};
+  for (int k = 0; k < K; ++k) {
+    const float *w = panel + k * kPanel;
+    for (int r = 0; r < kR; ++r) {
+      const float v = x[static_cast<size_t>(r) * K + k];
+      for (int j = 0; j < kPanel; ++j) sum[r][j] += v * w[j];
+    }
+  }
+  for (int r = 0; r < kR; ++r) std::copy(sum[r], sum[r] + kPanel, acc + r * kPanel);
+}
+
+/*! \brief y = x * w^T + bias, x is (B, K), y is (B, N), w packed by PackWeight */
+inline void PackedGemm(const float *x, int B, int K, const float *packed, const float *bias,
+                       int N, float *y) {
+  const int npanel = (N + kPanel - 1) / kPanel;
+  #pragma omp parallel for schedule(static)
+  for (int p = 0; p < npanel; ++p) {
+    const float *panel = packed + static_cast<size_t>(p) * K * kPanel;
+    const int n0 = p * kPanel, nn = std::min(kPanel, N - n0);
+    float acc[kRows * kPanel];
+    for (int b = 0; b < B; b += kRows) {
+      const float *xb = x + static_cast<size_t>(b) * K;
+      const int rows = std::min(kRows, B - b);
+      switch (rows) {
+        case 4: PanelKernel<4>(xb, K, panel, acc); break;
+        case 3: PanelKernel<3>(xb, K, panel, acc); break;
+        case 2: PanelKernel<2>(xb, K, panel, acc); break;
+        default: PanelKernel<1>(xb, K, panel, acc); break;
+      }
+      for (int r = 0; r < rows; ++r) {
+        float *dst = y + static_cast<size_t>(b + r) * N + n0;
+        for (int j = 0; j < nn; ++j) {
+          dst[j] = acc[r * kPanel + j] + (bias != NULL ? bias[n0 + j] : 0.0f);
+        }
+      }
+    }
+  }
+}
+}  // namespace cpufc
+
+/*!
+ * \brief FullyConnectedOp whose inference forward of batches up to max_batch runs on the
+ *  prepacked weight, and of any batch on the CSR weight when its fraction of non zeros
+ *  is at most sparse_density. Training and the other batches use the BLAS.
+ */
+class CPUFullyConnectedOp : public FullyConnectedOp<cpu, float> {
+ public:
+  CPUFullyConnectedOp(FullyConnectedParam p, int max_batch, float sparse_density)
+      : FullyConnectedOp<cpu, float>(p), max_batch_(max_batch),
+        sparse_density_(sparse_density) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    const TBlob &data = in_data[fullc::kData];
+    const int B = data.shape_[0];
+    if (ctx.is_train || req[fullc::kOut] != kWriteTo ||
+        data.type_flag_ != mshadow::kFloat32 || (B > max_batch_ && sparse_density_ <= 0.0f)) {
+      FullyConnectedOp<cpu, float>::Forward(ctx, in_data, req, out_data, aux_args);
+      return;
+    }
+    const TBlob &weight = in_data[fullc::kWeight];
+    const int N = weight.shape_[0], K = weight.shape_[1];
+    const float *w = weight.dptr<float>();
+    if (watcher_.Changed(w, static_cast<size_t>(N) * K)) {
+      packed_.clear();
+      csr_ = sparsew::CSRWeight();
+      const bool sparse = sparse_density_ > 0.0f && csr_.Convert(w, N, K, sparse_density_);
+      if (!sparse && max_batch_ > 0) {
+        packed_.resize(static_cast<size_t>((N + cpufc::kPanel - 1) / cpufc::kPanel) *
+                       cpufc::kPanel * K);
+        cpufc::PackWeight(w, N, K, dmlc::BeginPtr(packed_));
+      }
+    }
+    const float *bias = param_.no_bias ? NULL : in_data[fullc::kBias].dptr<float>();
+    float *out = out_data[fullc::kOut].dptr<float>();
+    if (!csr_.empty()) {
+      sparsew::MatMulT(csr_, data.dptr<float>(), B, K, bias, out);
+    } else if (B <= max_batch_) {
+      cpufc::PackedGemm(data.dptr<float>(), B, K, dmlc::BeginPtr(packed_), bias, N, out);
+    } else {
+      FullyConnectedOp<cpu, float>::Forward(ctx, in_data, req, out_data, aux_args);
+    }
+  }
+
+ private:
+  // largest batch running on the packed weight
+  int max_batch_;
+  // largest fraction of non zeros of the weight kept in CSR
+  float sparse_density_;
+  // the packed weight
+  std::vector<float> packed_;
+  // the CSR weight, empty when it is packed
+  sparsew::CSRWeight csr_;
+  // the changes of the weight
+  sparsew::WeightWatcher watcher_;
+};  // class CPUFullyConnectedOp
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CPU_FULLY_CONNECTED_INL_H_
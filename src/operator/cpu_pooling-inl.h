@@ -0,0 +1,482 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file cpu_pooling-inl.h
+ * \brief pooling and local response normalization tuned for cpu.
+ *
+ *  Both run one (image, channel) plane per OpenMP iteration, with the inner loops over
+ *  the contiguous x axis so that they vectorize. Pooling also runs on the NCHW8c layout,
+ *  with the inner loops over the 8 channels of a block.
+ *  - Pooling reduces the rows of a window first and then the columns of the reduced row,
+ *    kh + kw operations for each output instead of kh * kw. The padding counts as zero,
+ *    as in PoolingOp. The common windows of 3 stride 1, 2 stride 2 and 3 stride 2 have
+ *    their own instantiations, with the window width and stride known at compile time.
+ *  - 3D pooling reduces the planes of a window in depth into one plane first, that is then
+ *    pooled as a 2D plane, kd + kh + kw operations for each output.
+ *  - LRN sums the squares of the neighbouring channels plane by plane, and computes
+ *    the power of -0.75 with two square roots.
+ */
+#ifndef MXNET_OPERATOR_CPU_POOLING_INL_H_
+#define MXNET_OPERATOR_CPU_POOLING_INL_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "./pooling-inl.h"
+#include "./lrn-inl.h"
+
+namespace mxnet {
+namespace op {
+namespace cpupool {
+/*! \brief geometry of the pooling of one plane, and of the depth of a volume in 3D */
+struct PoolShape {
+  int H, W, Ho, Wo, kh, kw, sy, sx, py, px;
+  int D, Do, kd, sd, pd;
+};
+
+/*!
+ * \brief pool one plane, each of its elements is kLanes contiguous values: one channel
+ *  in NCHW, a block of 8 channels in NCHW8c. row is a buffer of (W + 2 * px) * kLanes
+ *  whose padding is zero. A kKW and kSX other than 0 fix the kernel width and the
+ *  stride at compile time, the reduction of a window is then unrolled and the loop
+ *  over the outputs vectorized.
+ */
+template<int kLanes, int kKW = 0, int kSX = 0>
+inline void PoolPlane(const real_t *x, const PoolShape &p, bool is_max, real_t scale,
+                      OpReqType req, real_t *row, real_t *y) {
+  const int kw = kKW != 0 ? kKW : p.kw;
+  const int sx = kSX != 0 ? kSX : p.sx;
+  const int len = p.W * kLanes;
+  real_t *r = row + p.px * kLanes;
+  for (int oy = 0; oy < p.Ho; ++oy) {
+    const int y0 = oy * p.sy - p.py;
+    const int ys = std::max(y0, 0), ye = std::min(y0 + p.kh, p.H);
+    if (ys >= ye) {
+      std::fill(r, r + len, real_t(0));
+    } else if (is_max) {
+      std::copy(x + ys * len, x + (ys + 1) * len, r);
+      for (int iy = ys + 1; iy < ye; ++iy) {
+        const real_t *src = x + iy * len;
+        for (int i = 0; i < len; ++i) r[i] = std::max(r[i], src[i]);
+      }
+      if (ye - ys < p.kh) {
+        for (int i = 0; i < len; ++i) r[i] = std::max(r[i], real_t(0));
+      }
+    } else {
+      std::copy(x + ys * len, x + (ys + 1) * len, r);
+      for (int iy = ys + 1; iy < ye; ++iy) {
+        const real_t *src = x + iy * len;
+        for (int i = 0; i < len; ++i) r[i] += src[i];
+      }
+    }
+    real_t *dst = y + oy * p.Wo * kLanes;
+    for (int ox = 0; ox < p.Wo; ++ox, dst += kLanes) {
+      const real_t *win = row + ox * sx * kLanes;
+      real_t acc[kLanes];
+      std::copy(win, win + kLanes, acc);
+      for (int kx = 1; kx < kw; ++kx) {
+        const real_t *v = win + kx * kLanes;
+        if (is_max) {
+          for (int l = 0; l < kLanes; ++l) acc[l] = std::max(acc[l], v[l]);
+        } else {
+          for (int l = 0; l < kLanes; ++l) acc[l] += v[l];
+        }
+      }
+      for (int l = 0; l < kLanes; ++l) {
+        dst[l] = (req == kAddTo ? dst[l] : real_t(0)) + acc[l] * scale;
+      }
+    }
+  }
+}
+
+/*! \brief signature of the instantiations of PoolPlane */
+typedef void (*PoolPlaneFn)(const real_t *x, const PoolShape &p, bool is_max, real_t scale,
+                            OpReqType req, real_t *row, real_t *y);
+
+/*!
+ * \brief the instantiation of PoolPlane for a kernel width and a stride, specialized for
+ *  the windows of 3 stride 1 and 2 stride 2 of most networks, generic otherwise.
+ */
+template<int kLanes>
+inline PoolPlaneFn SelectPoolPlane(int kw, int sx) {
+  if (kw == 3 && sx == 1) return PoolPlane<kLanes, 3, 1>;
+  if (kw == 2 && sx == 2) return PoolPlane<kLanes, 2, 2>;
+  if (kw == 3 && sx == 2) return PoolPlane<kLanes, 3, 2>;
+  return PoolPlane<kLanes>;
+}
+
+/*!
+ * \brief add the gradient of one pooled plane to gx, with elements of kLanes values as
+ *  in PoolPlane. Max pooling passes the gradient to every input of the window equal to
+ *  the output, like unpool.
+ */
+template<int kLanes>
+inline void UnpoolPlane(const real_t *x, const real_t *y, const real_t *gy,
+                        const PoolShape &p, bool is_max, real_t scale, real_t *gx) {
+  for (int oy = 0; oy < p.Ho; ++oy) {
+    const int y0 = oy * p.sy - p.py;
+    const int ys = std::max(y0, 0), ye = std::min(y0 + p.kh, p.H);
+    for (int ox = 0; ox < p.Wo; ++ox) {
+      const int x0 = ox * p.sx - p.px;
+      const int xs = std::max(x0, 0), xe = std::min(x0 + p.kw, p.W);
+      const size_t o = (static_cast<size_t>(oy) * p.Wo + ox) * kLanes;
+      for (int iy = ys; iy < ye; ++iy) {
+        for (int ix = xs; ix < xe; ++ix) {
+          const size_t i = (static_cast<size_t>(iy) * p.W + ix) * kLanes;
+          if (is_max) {
+            for (int l = 0; l < kLanes; ++l) {
+              gx[i + l] += x[i + l] == y[o + l] ? gy[o + l] * scale : real_t(0);
+            }
+          } else {
+            for (int l = 0; l < kLanes; ++l) gx[i + l] += gy[o + l] * scale;
+          }
+        }
+      }
+    }
+  }
+}
+
+/*!
+ * \brief pool the output plane od of one (D, H, W) volume: the planes of the depth window
+ *  are reduced into plane, H * W, which is pooled by PoolPlane
+ */
+inline void PoolDepth(const real_t *x, const PoolShape &p, int od, bool is_max, real_t scale,
+                      OpReqType req, real_t *plane, real_t *row, real_t *y) {
+  const size_t len = static_cast<size_t>(p.H) * p.W;
+  const int z0 = od * p.sd - p.pd;
+  const int zs = std::max(z0, 0), ze = std::min(z0 + p.kd, p.D);
+  if (zs >= ze) {
+    std::fill(plane, plane + len, real_t(0));
+  } else {
+    std::copy(x + zs * len, x + (zs + 1) * len, plane);
+    for (int iz = zs + 1; iz < ze; ++iz) {
+      const real_t *src = x + iz * len;
+      if (is_max) {
+        for (size_t i = 0; i < len; ++i) plane[i] = std::max(plane[i], src[i]);
+      } else {
+        for (size_t i = 0; i < len; ++i) plane[i] += src[i];
+      }
+    }
+    if (is_max && ze - zs < p.kd) {
+      for (size_t i = 0; i < len; ++i) plane[i] = std::max(plane[i], real_t(0));
+    }
+  }
+  PoolPlane<1>(plane, p, is_max, scale, req, row, y + static_cast<size_t>(od) * p.Ho * p.Wo);
+}
+
+/*! \brief dst = t^-beta, with two square roots for the usual beta of 0.75 */
+inline void PowNegBeta(const real_t *t, int n, real_t beta, real_t *dst) {
+  if (beta == 0.75f) {
+    for (int i = 0; i < n; ++i) {
+      const real_t s = std::sqrt(t[i]);
+      dst[i] = 1.0f / (s * std::sqrt(s));
+    }
+  } else {
+    for (int i = 0; i < n; ++i) dst[i] = std::pow(t[i], -beta);
+  }
+}
+}  // namespace cpupool
+
+/*!
+ * \brief 2D and 3D pooling on cpu, parallel over the planes. In the NCHW8c layout a plane
+ *  holds 8 channels and the innermost loops run over them.
+ */
+class CPUPoolingOp : public Operator {
+ public:
+  explicit CPUPoolingOp(PoolingParam p) {
+    this->param_ = p;
+    // the global windows take the size of the input, only known in Forward
+    const bool fixed = !p.global_pool && p.kernel.ndim() == 2;
+    const int kw = fixed ? p.kernel[1] : 0, sx = fixed ? p.stride[1] : 0;
+    plane_fn_ = p.layout == kLayoutNCHW8c ? cpupool::SelectPoolPlane<8>(kw, sx) :
+        cpupool::SelectPoolPlane<1>(kw, sx);
+  }
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    CHECK_EQ(in_data.size(), 1);
+    CHECK_EQ(out_data.size(), 1);
+    if (req[pool_enum::kOut] == kNullOp) return;
+    if (param_.kernel.ndim() == 3) {
+      this->Forward3D(in_data[pool_enum::kData], req[pool_enum::kOut],
+                      out_data[pool_enum::kOut]);
+      return;
+    }
+    Stream<cpu> *s = ctx.get_stream<cpu>();
+    Tensor<cpu, 4> data = in_data[pool_enum::kData].get<cpu, 4, real_t>(s);
+    Tensor<cpu, 4> out = out_data[pool_enum::kOut].get<cpu, 4, real_t>(s);
+    const cpupool::PoolShape p = this->GetShape(data.shape_, out.shape_);
+    const bool is_max = param_.pool_type == pool_enum::kMaxPooling;
+    const real_t scale = this->Scale(p);
+    const int lanes = param_.layout == kLayoutNCHW8c ? 8 : 1;
+    const int nplane = static_cast<int>(data.shape_[0] * data.shape_[1]) / lanes;
+    const OpReqType oreq = req[pool_enum::kOut];
+    #pragma omp parallel
+    {
+      std::vector<real_t> row((p.W + 2 * p.px) * lanes, real_t(0));
+      #pragma omp for schedule(static)
+      for (int i = 0; i < nplane; ++i) {
+        const real_t *x = data.dptr_ + static_cast<size_t>(i) * p.H * p.W * lanes;
+        real_t *y = out.dptr_ + static_cast<size_t>(i) * p.Ho * p.Wo * lanes;
+        plane_fn_(x, p, is_max, scale, oreq, dmlc::BeginPtr(row), y);
+      }
+    }
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    CHECK_EQ(out_grad.size(), 1);
+    CHECK_EQ(in_data.size(), 1);
+    CHECK_EQ(out_data.size(), 1);
+    CHECK_EQ(req.size(), 1);
+    CHECK_EQ(in_grad.size(), 1);
+    if (req[pool_enum::kData] == kNullOp) return;
+    if (param_.kernel.ndim() == 3) {
+      this->Backward3D(out_grad[pool_enum::kOut], in_data[pool_enum::kData],
+                       out_data[pool_enum::kOut], req[pool_enum::kData],
+                       in_grad[pool_enum::kData]);
+      return;
+    }
+    Stream<cpu> *s = ctx.get_stream<cpu>();
+    Tensor<cpu, 4> grad = out_grad[pool_enum::kOut].get<cpu, 4, real_t>(s);
+    Tensor<cpu, 4> data = in_data[pool_enum::kData].get<cpu, 4, real_t>(s);
+    Tensor<cpu, 4> output_data = out_data[pool_enum::kOut].get<cpu, 4, real_t>(s);
+    Tensor<cpu, 4> input_grad = in_grad[pool_enum::kData].get<cpu, 4, real_t>(s);
+    const cpupool::PoolShape p = this->GetShape(data.shape_, grad.shape_);
+    const bool is_max = param_.pool_type == pool_enum::kMaxPooling;
+    const real_t scale = this->Scale(p);
+    const bool add = req[pool_enum::kData] == kAddTo;
+    const int lanes = param_.layout == kLayoutNCHW8c ? 8 : 1;
+    const int nplane = static_cast<int>(data.shape_[0] * data.shape_[1]) / lanes;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < nplane; ++i) {
+      const size_t in_off = static_cast<size_t>(i) * p.H * p.W * lanes;
+      const size_t out_off = static_cast<size_t>(i) * p.Ho * p.Wo * lanes;
+      real_t *gx = input_grad.dptr_ + in_off;
+      if (!add) std::fill(gx, gx + p.H * p.W * lanes, real_t(0));
+      if (lanes == 8) {
+        cpupool::UnpoolPlane<8>(data.dptr_ + in_off, output_data.dptr_ + out_off,
+                                grad.dptr_ + out_off, p, is_max, scale, gx);
+      } else {
+        cpupool::UnpoolPlane<1>(data.dptr_ + in_off, output_data.dptr_ + out_off,
+                                grad.dptr_ + out_off, p, is_max, scale, gx);
+      }
+    }
+  }
+
+ private:
+  /*! \brief parallel over the output planes of all the volumes */
+  inline void Forward3D(const TBlob &in, OpReqType req, const TBlob &out) {
+    const cpupool::PoolShape p = this->GetShape3D(in.shape_, out.shape_);
+    const bool is_max = param_.pool_type == pool_enum::kMaxPooling;
+    const real_t scale = this->Scale(p);
+    const int nvol = static_cast<int>(in.shape_[0] * in.shape_[1]);
+    const int nplane = nvol * p.Do;
+    const real_t *x = in.dptr<real_t>();
+    real_t *y = out.dptr<real_t>();
+    #pragma omp parallel
+    {
+      std::vector<real_t> plane(static_cast<size_t>(p.H) * p.W);
+      std::vector<real_t> row(p.W + 2 * p.px, real_t(0));
+      #pragma omp for schedule(static)
+      for (int i = 0; i < nplane; ++i) {
+        const int v = i / p.Do, od = i % p.Do;
+        cpupool::PoolDepth(x + static_cast<size_t>(v) * p.D * p.H * p.W, p, od, is_max, scale,
+                           req, dmlc::BeginPtr(plane), dmlc::BeginPtr(row),
+                           y + static_cast<size_t>(v) * p.Do * p.Ho * p.Wo);
+      }
+    }
+  }
+  /*! \brief parallel over the volumes, as the depth windows of a volume overlap */
+  inline void Backward3D(const TBlob &grad, const TBlob &in, const TBlob &out, OpReqType req,
+                         const TBlob &in_grad) {
+    const cpupool::PoolShape p = this->GetShape3D(in.shape_, grad.shape_);
+    const bool is_max = param_.pool_type == pool_enum::kMaxPooling;
+    const real_t scale = this->Scale(p);
+    const int nvol = static_cast<int>(in.shape_[0] * in.shape_[1]);
+    const size_t ilen = static_cast<size_t>(p.H) * p.W, olen = static_cast<size_t>(p.Ho) * p.Wo;
+    #pragma omp parallel for schedule(static)
+    for (int v = 0; v < nvol; ++v) {
+      const real_t *x = in.dptr<real_t>() + v * p.D * ilen;
+      const real_t *y = out.dptr<real_t>() + v * p.Do * olen;
+      const real_t *gy = grad.dptr<real_t>() + v * p.Do * olen;
+      real_t *gx = in_grad.dptr<real_t>() + v * p.D * ilen;
+      if (req != kAddTo) std::fill(gx, gx + p.D * ilen, real_t(0));
+      for (int od = 0; od < p.Do; ++od) {
+        const int z0 = od * p.sd - p.pd;
+        for (int iz = std::max(z0, 0); iz < std::min(z0 + p.kd, p.D); ++iz) {
+          cpupool::UnpoolPlane<1>(x + iz * ilen, y + od * olen, gy + od * olen, p, is_max,
+                                  scale, gx + iz * ilen);
+        }
+      }
+    }
+  }
+  inline cpupool::PoolShape GetShape3D(const TShape &dshape, const TShape &oshape) const {
+    const bool global = param_.global_pool;
+    cpupool::PoolShape p;
+    p.D = dshape[2];
+    p.H = dshape[3];
+    p.W = dshape[4];
+    p.Do = oshape[2];
+    p.Ho = oshape[3];
+    p.Wo = oshape[4];
+    p.kd = global ? p.D : param_.kernel[0];
+    p.kh = global ? p.H : param_.kernel[1];
+    p.kw = global ? p.W : param_.kernel[2];
+    p.sd = global ? 1 : param_.stride[0];
+    p.sy = global ? 1 : param_.stride[1];
+    p.sx = global ? 1 : param_.stride[2];
+    p.pd = global ? 0 : param_.pad[0];
+    p.py = global ? 0 : param_.pad[1];
+    p.px = global ? 0 : param_.pad[2];
+    return p;
+  }
+  inline cpupool::PoolShape GetShape(const mshadow::Shape<4> &dshape,
+                                     const mshadow::Shape<4> &oshape) const {
+    cpupool::PoolShape p;
+    p.H = dshape[2];
+    p.W = dshape[3];
+    p.Ho = oshape[2];
+    p.Wo = oshape[3];
+    p.kh = param_.global_pool ? p.H : param_.kernel[0];
+    p.kw = param_.global_pool ? p.W : param_.kernel[1];
+    p.sy = param_.global_pool ? 1 : param_.stride[0];
+    p.sx = param_.global_pool ? 1 : param_.stride[1];
+    p.py = param_.pad[0];
+    p.px = param_.pad[1];
+    p.D = p.Do = p.kd = p.sd = 1;
+    p.pd = 0;
+    return p;
+  }
+  /*! \brief the average pooling divides by the window size, padding included */
+  inline real_t Scale(const cpupool::PoolShape &p) const {
+    return param_.pool_type == pool_enum::kAvgPooling ? 1.0f / (p.kd * p.kh * p.kw) : 1.0f;
+  }
+
+  PoolingParam param_;
+  // the pooling of a plane in Forward, selected by the kernel width and stride
+  cpupool::PoolPlaneFn plane_fn_;
+};  // class CPUPoolingOp
+
+/*! \brief local response normalization on cpu, parallel over the planes */
+class CPULocalResponseNormOp : public Operator {
+ public:
+  explicit CPULocalResponseNormOp(LRNParam param) {
+    param_ = param;
+  }
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_states) {
+    using namespace mshadow;
+    CHECK_EQ(in_data.size(), 1);
+    CHECK_EQ(out_data.size(), 2);
+    CHECK_EQ(param_.nsize % 2, 1) << "LRN only supports odd values for local_size";
+    Stream<cpu> *s = ctx.get_stream<cpu>();
+    Tensor<cpu, 4> data = in_data[lrn_enum::kData].get<cpu, 4, real_t>(s);
+    Tensor<cpu, 4> out = out_data[lrn_enum::kOut].get<cpu, 4, real_t>(s);
+    Tensor<cpu, 4> tmp_norm = out_data[lrn_enum::kTmpNorm].get<cpu, 4, real_t>(s);
+    const real_t salpha = param_.alpha / param_.nsize;
+    const int C = data.shape_[1];
+    const int plane = data.shape_[2] * data.shape_[3];
+    const int half = param_.nsize / 2;
+    const int nplane = static_cast<int>(data.shape_[0]) * C;
+    const bool add = req[lrn_enum::kOut] == kAddTo;
+    #pragma omp parallel
+    {
+      std::vector<real_t> scale(plane);
+      #pragma omp for schedule(static)
+      for (int i = 0; i < nplane; ++i) {
+        const int c = i % C;
+        const real_t *x = data.dptr_ + static_cast<size_t>(i) * plane;
+        real_t *t = tmp_norm.dptr_ + static_cast<size_t>(i) * plane;
+        real_t *y = out.dptr_ + static_cast<size_t>(i) * plane;
+        std::fill(t, t + plane, real_t(0));
+        for (int k = std::max(c - half, 0); k <= std::min(c + half, C - 1); ++k) {
+          const real_t *xk = x + static_cast<ptrdiff_t>(k - c) * plane;
+          for (int j = 0; j < plane; ++j) t[j] += xk[j] * xk[j];
+        }
+        for (int j = 0; j < plane; ++j) t[j] = t[j] * salpha + param_.knorm;
+        cpupool::PowNegBeta(t, plane, param_.beta, dmlc::BeginPtr(scale));
+        for (int j = 0; j < plane; ++j) {
+          y[j] = (add ? y[j] : real_t(0)) + x[j] * scale[j];
+        }
+      }
+    }
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_states) {
+    using namespace mshadow;
+    CHECK_EQ(out_grad.size(), 1);
+    CHECK_EQ(in_data.size(), 1);
+    CHECK_EQ(out_data.size(), 2);
+    Stream<cpu> *s = ctx.get_stream<cpu>();
+    Tensor<cpu, 4> grad = out_grad[lrn_enum::kOut].get<cpu, 4, real_t>(s);
+    Tensor<cpu, 4> tmp_norm = out_data[lrn_enum::kTmpNorm].get<cpu, 4, real_t>(s);
+    Tensor<cpu, 4> data = in_data[lrn_enum::kData].get<cpu, 4, real_t>(s);
+    Tensor<cpu, 4> grad_in = in_grad[lrn_enum::kData].get<cpu, 4, real_t>(s);
+    // grad_in may share memory with grad, so the weighted gradients of all the
+    // channels are stored before any plane of grad_in is written.
+    Tensor<cpu, 1> wgrad = ctx.requested[lrn_enum::kTempSpace]
+        .get_space<cpu>(Shape1(data.shape_.Size()), s);
+    const real_t salpha = param_.alpha / param_.nsize;
+    const real_t coef = -2.0f * param_.beta * salpha;
+    const int C = data.shape_[1];
+    const int plane = data.shape_[2] * data.shape_[3];
+    const int half = param_.nsize / 2;
+    const int nplane = static_cast<int>(data.shape_[0]) * C;
+    #pragma omp parallel
+    {
+      std::vector<real_t> scale(plane);
+      #pragma omp for schedule(static)
+      for (int i = 0; i < nplane; ++i) {
+        const size_t off = static_cast<size_t>(i) * plane;
+        const real_t *t = tmp_norm.dptr_ + off;
+        const real_t *x = data.dptr_ + off;
+        const real_t *g = grad.dptr_ + off;
+        real_t *w = wgrad.dptr_ + off;
+        cpupool::PowNegBeta(t, plane, param_.beta, dmlc::BeginPtr(scale));
+        for (int j = 0; j < plane; ++j) w[j] = g[j] * x[j] * scale[j] / t[j];
+      }
+      #pragma omp for schedule(static)
+      for (int i = 0; i < nplane; ++i) {
+        const int c = i % C;
+        const size_t off = static_cast<size_t>(i) * plane;
+        const real_t *x = data.dptr_ + off;
+        const real_t *g = grad.dptr_ + off;
+        real_t *gx = grad_in.dptr_ + off;
+        cpupool::PowNegBeta(tmp_norm.dptr_ + off, plane, param_.beta, dmlc::BeginPtr(scale));
+        for (int j = 0; j < plane; ++j) scale[j] *= g[j];
+        for (int k = std::max(c - half, 0); k <= std::min(c + half, C - 1); ++k) {
+          const real_t *wk = wgrad.dptr_ + off + static_cast<ptrdiff_t>(k - c) * plane;
+          for (int j = 0; j < plane; ++j) scale[j] += coef * wk[j] * x[j];
+        }
+        std::copy(scale.begin(), scale.end(), gx);
+      }
+    }
+  }
+
+ private:
+  LRNParam param_;
+};  // class CPULocalResponseNormOp
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CPU_POOLING_INL_H_
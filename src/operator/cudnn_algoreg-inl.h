@@ -0,0 +1,104 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file cudnn_algoreg-inl.h
+ * \brief process wide registry of the cudnn convolution algorithms found by tuning.
+ */
+#ifndef MXNET_OPERATOR_CUDNN_ALGOREG_INL_H_
+#define MXNET_OPERATOR_CUDNN_ALGOREG_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include "../common/cuda_utils.h"
+
+namespace mxnet {
+namespace op {
+#if MXNET_USE_CUDNN == 1
+/*!
+ * \brief registry of the algorithms chosen by cudnnFind*Algorithm.
+ *
+ *  The key describes everything the choice depends on: device, cudnn version, dtype,
+ *  shapes, stride, pad, dilate, workspace limit and tuning mode.
+ *  Executors of the same shapes, e.g. bucketing, share one tuning.
+ *  When MXNET_CUDNN_AUTOTUNE_CACHE is set, entries are loaded from and appended to that file,
+ *  so the tuning is also shared across processes.
+ */
+class CuDNNAlgoReg {
+ public:
+  /*! \brief algorithms and workspace sizes of forward, backward data and backward filter */
+  struct Entry {
+    cudnnConvolutionFwdAlgo_t fwd;
+    cudnnConvolutionBwdDataAlgo_t bwd_data;
+    cudnnConvolutionBwdFilterAlgo_t bwd_filter;
+    size_t forward_workspace_byte;
+    size_t backward_workspace_byte;
+  };
+  /*!
+   * \brief look up the algorithms of key.
+   * \return whether key is registered.
+   */
+  inline bool Find(const std::string &key, Entry *entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = reg_.find(key);
+    if (it == reg_.end()) return false;
+    *entry = it->second;
+    return true;
+  }
+  /*! \brief register the algorithms of key, and append them to the cache file */
+  inline void Register(const std::string &key, const Entry &entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reg_[key] = entry;
+    if (path_.length() == 0) return;
+    std::ofstream os(path_.c_str(), std::ios::app);
+    if (!os) {
+      LOG(WARNING) << "Cannot write cudnn autotune cache " << path_;
+      return;
+    }
+    os << key << '\t' << static_cast<int>(entry.fwd) << ' '
+       << static_cast<int>(entry.bwd_data) << ' '
+       << static_cast<int>(entry.bwd_filter) << ' '
+       << entry.forward_workspace_byte << ' '
+       << entry.backward_workspace_byte << '\n';
+  }
+  /*! \return the process wide registry */
+  static CuDNNAlgoReg *Get() {
+    static CuDNNAlgoReg inst;
+    return &inst;
+  }
+
+ private:
+  CuDNNAlgoReg() {
+    path_ = dmlc::GetEnv("MXNET_CUDNN_AUTOTUNE_CACHE", std::string());
+    if (path_.length() == 0) return;
+    std::ifstream is(path_.c_str());
+    std::string line;
+    while (std::getline(is, line)) {
+      size_t pos = line.rfind('\t');
+      if (pos == std::string::npos) continue;
+      std::istringstream value(line.substr(pos + 1));
+      int fwd, bwd_data, bwd_filter;
+      Entry entry;
+      if (!(value >> fwd >> bwd_data >> bwd_filter
+            >> entry.forward_workspace_byte >> entry.backward_workspace_byte)) continue;
+      entry.fwd = static_cast<cudnnConvolutionFwdAlgo_t>(fwd);
+      entry.bwd_data = static_cast<cudnnConvolutionBwdDataAlgo_t>(bwd_data);
+      entry.bwd_filter = static_cast<cudnnConvolutionBwdFilterAlgo_t>(bwd_filter);
+      // later lines win, they are the most recent tuning
+      reg_[line.substr(0, pos)] = entry;
+    }
+  }
+  /*! \brief path of the cache file, empty when not persisted */
+  std::string path_;
+  /*! \brief mutex of reg_ and the file */
+  std::mutex mutex_;
+  /*! \brief the registered algorithms */
+  std::unordered_map<std::string, Entry> reg_;
+};
+#endif  // MXNET_USE_CUDNN
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CUDNN_ALGOREG_INL_H_
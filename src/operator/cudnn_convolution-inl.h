@@ -38,9 +38,12 @@ class CuDNNConvolutionOp : public Operator {
     // convert MB to words
     param_.workspace = (param_.workspace << 20) / sizeof(DType);
     init_cudnn_ = false;
+    fused_bias_act_ = false;
     dtype_ = mshadow::DataType<DType>::kCudnnFlag;
+    ctx_ = ctx;
 
-    if (param.cudnn_tune != conv::kOff) {
+    // auto selects at the first forward, once the memory of the executor is allocated
+    if (param.cudnn_tune != conv::kOff && param.cudnn_tune != conv::kAuto) {
       TuneCudnnConvolution(param, in_shape, out_shape, ctx, dtype_,
                            &algo_, &back_algo_, &back_algo_w_,
                            &forward_workspace_byte_, &backward_workspace_byte_);
@@ -54,6 +57,11 @@ class CuDNNConvolutionOp : public Operator {
       CHECK_EQ(cudnnDestroyTensorDescriptor(bias_desc_), CUDNN_STATUS_SUCCESS);
       CHECK_EQ(cudnnDestroyFilterDescriptor(filter_desc_), CUDNN_STATUS_SUCCESS);
       CHECK_EQ(cudnnDestroyConvolutionDescriptor(conv_desc_), CUDNN_STATUS_SUCCESS);
+      #if CUDNN_MAJOR >= 6
+      if (fused_bias_act_) {
+        CHECK_EQ(cudnnDestroyActivationDescriptor(act_desc_), CUDNN_STATUS_SUCCESS);
+      }
+      #endif
     }
   }
 
@@ -101,6 +109,32 @@ class CuDNNConvolutionOp : public Operator {
     for (uint32_t g = 0; g < param_.num_group; ++g) {
       typename DataType<DType>::ScaleType alpha = 1.0f;
       typename DataType<DType>::ScaleType beta = 0.0f;
+      #if CUDNN_MAJOR >= 6
+      if (fused_bias_act_) {
+        // z is the output itself, scaled by beta = 0
+        Tensor<gpu, 1, DType> bias = in_data[conv::kBias].get<gpu, 1, DType>(s);
+        CHECK_EQ(cudnnConvolutionBiasActivationForward(s->dnn_handle_,
+                                                       &alpha,
+                                                       in_desc_,
+                                                       data_ptr + data_offset_ * g,
+                                                       filter_desc_,
+                                                       wmat_ptr + weight_offset_ * g,
+                                                       conv_desc_,
+                                                       algo_,
+                                                       workspace.dptr_,
+                                                       forward_workspace_byte_,
+                                                       &beta,
+                                                       out_desc_,
+                                                       out_ptr + out_offset_ * g,
+                                                       bias_desc_,
+                                                       bias.dptr_ + bias_offset_ * g,
+                                                       act_desc_,
+                                                       out_desc_,
+                                                       out_ptr + out_offset_ * g),
+                 CUDNN_STATUS_SUCCESS);
+        continue;
+      }
+      #endif
       CHECK_EQ(cudnnConvolutionForward(s->dnn_handle_,
                                        &alpha,
                                        in_desc_,
@@ -138,6 +172,10 @@ class CuDNNConvolutionOp : public Operator {
         #endif
       }
     }
+    if (param_.act_type != conv::kActNone && !fused_bias_act_) {
+      FusedActivation(Tensor<gpu, 1, DType>(out_ptr, Shape1(out_data[conv::kOut].Size()), s),
+                      param_.act_type);
+    }
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -149,6 +187,8 @@ class CuDNNConvolutionOp : public Operator {
                         const std::vector<TBlob> &aux_args) {
     using namespace mshadow;
     using namespace mshadow::expr;
+    CHECK_EQ(param_.act_type, conv::kActNone)
+        << "Convolution with a fused activation is inference only";
     size_t expected = param_.no_bias == 0 ? 3 : 2;
     DType *grad_ptr = NULL;
     DType *wmat_ptr = NULL;
@@ -430,7 +470,10 @@ class CuDNNConvolutionOp : public Operator {
                                             &bias_stride[0]), CUDNN_STATUS_SUCCESS);
       }
 
-      if (!param_.cudnn_tune) {
+      if (param_.cudnn_tune == conv::kAuto) {
+        CHECK_EQ(s->dnn_handle_ownership_, mshadow::Stream<gpu>::OwnHandle);
+        this->SelectAlgoByMemory(s);
+      } else if (!param_.cudnn_tune) {
         CHECK_EQ(s->dnn_handle_ownership_, mshadow::Stream<gpu>::OwnHandle);
         CHECK_EQ(cudnnGetConvolutionForwardAlgorithm(s->dnn_handle_,
                  in_desc_,
@@ -479,6 +522,17 @@ class CuDNNConvolutionOp : public Operator {
                  algo_,
                  &forward_workspace_byte_), CUDNN_STATUS_SUCCESS);
       }
+      #if CUDNN_MAJOR >= 6
+      // cudnnConvolutionBiasActivationForward only supports relu with this algo
+      fused_bias_act_ = param_.act_type == conv::kActReLU && !param_.no_bias &&
+          algo_ == CUDNN_CONVOLUTION_FWD_ALGO_IMPLICIT_PRECOMP_GEMM;
+      if (fused_bias_act_) {
+        CHECK_EQ(cudnnCreateActivationDescriptor(&act_desc_), CUDNN_STATUS_SUCCESS);
+        CHECK_EQ(cudnnSetActivationDescriptor(act_desc_, CUDNN_ACTIVATION_RELU,
+                                              CUDNN_NOT_PROPAGATE_NAN, 0),
+                 CUDNN_STATUS_SUCCESS);
+      }
+      #endif
       forward_workspace_ = forward_workspace_byte_ / sizeof(DType) + 1;
       backward_workspace_ = backward_workspace_byte_ / sizeof(DType) + 1;
       // ugly fix CUDNN algorithm selection
@@ -489,7 +543,57 @@ class CuDNNConvolutionOp : public Operator {
     }
   }
 
+  /*!
+   * \brief select the fastest algorithms whose workspace fits the free memory of the
+   *  device, and the temp space already held, which the workspace reuses as it is shared
+   *  by the operators of the device. MXNET_CUDNN_AUTO_WORKSPACE_RESERVE MB are kept free.
+   */
+  inline void SelectAlgoByMemory(mshadow::Stream<gpu> *s) {
+    size_t free_byte = 0, total_byte = 0;
+    CUDA_CALL(cudaMemGetInfo(&free_byte, &total_byte));
+    size_t held = 0;
+    int num_bound = 0;
+    ResourceManager::Get()->GetTempSpaceStats(ctx_, &held, &num_bound);
+    const size_t reserve =
+        static_cast<size_t>(dmlc::GetEnv("MXNET_CUDNN_AUTO_WORKSPACE_RESERVE", 256)) << 20;
+    const size_t limit = free_byte + held > reserve ? free_byte + held - reserve : 0;
+    const int kMaxAlgos = 10;
+    int nalgo = kMaxAlgos;
+    cudnnConvolutionFwdAlgoPerf_t fwd_algo[kMaxAlgos];
+    CHECK_EQ(cudnnFindConvolutionForwardAlgorithm(s->dnn_handle_,
+             in_desc_, filter_desc_, conv_desc_, out_desc_,
+             kMaxAlgos, &nalgo, fwd_algo), CUDNN_STATUS_SUCCESS);
+    int i = FirstFitting(fwd_algo, nalgo, limit);
+    algo_ = fwd_algo[i].algo;
+    forward_workspace_byte_ = fwd_algo[i].memory;
+    cudnnConvolutionBwdFilterAlgoPerf_t bwd_filter_algo[kMaxAlgos];
+    CHECK_EQ(cudnnFindConvolutionBackwardFilterAlgorithm(s->dnn_handle_,
+             in_desc_, out_desc_, conv_desc_, filter_desc_,
+             kMaxAlgos, &nalgo, bwd_filter_algo), CUDNN_STATUS_SUCCESS);
+    i = FirstFitting(bwd_filter_algo, nalgo, limit);
+    back_algo_w_ = bwd_filter_algo[i].algo;
+    backward_workspace_byte_ = bwd_filter_algo[i].memory;
+    cudnnConvolutionBwdDataAlgoPerf_t bwd_data_algo[kMaxAlgos];
+    CHECK_EQ(cudnnFindConvolutionBackwardDataAlgorithm(s->dnn_handle_,
+             filter_desc_, out_desc_, conv_desc_, in_desc_,
+             kMaxAlgos, &nalgo, bwd_data_algo), CUDNN_STATUS_SUCCESS);
+    i = FirstFitting(bwd_data_algo, nalgo, limit);
+    back_algo_ = bwd_data_algo[i].algo;
+    backward_workspace_byte_ = std::max(backward_workspace_byte_, bwd_data_algo[i].memory);
+  }
+  /*! \return the first, that is fastest, of the found algorithms fitting in limit bytes */
+  template<typename Perf>
+  static int FirstFitting(const Perf *perf, int nalgo, size_t limit) {
+    for (int i = 0; i < nalgo; ++i) {
+      if (perf[i].status == CUDNN_STATUS_SUCCESS && perf[i].memory <= limit) return i;
+    }
+    LOG(FATAL) << "Failed to find an convolution algorithm within " << limit << " bytes.";
+    return 0;
+  }
+
   bool init_cudnn_;
+  // whether bias and activation run in the convolution kernel
+  bool fused_bias_act_;
   size_t forward_workspace_;
   size_t backward_workspace_;
   size_t forward_workspace_byte_;
@@ -507,10 +611,15 @@ class CuDNNConvolutionOp : public Operator {
   cudnnConvolutionFwdAlgo_t algo_;
   cudnnConvolutionBwdDataAlgo_t back_algo_;
   cudnnConvolutionBwdFilterAlgo_t back_algo_w_;
+  #if CUDNN_MAJOR >= 6
+  cudnnActivationDescriptor_t act_desc_;
+  #endif
   #if CUDNN_MAJOR == 5
   cudnnTensorFormat_t format_;
   #endif
   ConvolutionParam param_;
+  // the device of the operator
+  Context ctx_;
 };
 #endif  // __CUDACC__ && CUDNN
 }  // namespace op
@@ -7,6 +7,9 @@
 #include "./cudnn_convolution-inl.h"
 #include <mxnet/base.h>
 #include <mxnet/ndarray.h>
+#include <sstream>
+#include <string>
+#include "./cudnn_algoreg-inl.h"
 
 namespace mxnet {
 namespace op {
@@ -36,6 +39,28 @@ void TuneCudnnConvolution(ConvolutionParam param,
 
 
   size_t workspace_byte = param.workspace << 20;
+  // the choice only depends on these, reuse the tuning of the same configuration.
+  cudaDeviceProp prop;
+  CUDA_CALL(cudaGetDeviceProperties(&prop, ctx.dev_id));
+  std::ostringstream os;
+  os << "conv dev=" << ctx.dev_id << ' ' << prop.name
+     << " cudnn=" << CUDNN_VERSION << " dtype=" << static_cast<int>(dtype)
+     << " data=" << x_shape << " out=" << y_shape
+     << " kernel=" << param.kernel << " stride=" << param.stride
+     << " pad=" << param.pad << " dilate=" << param.dilate
+     << " num_group=" << param.num_group
+     << " workspace=" << workspace_byte << " tune=" << param.cudnn_tune;
+  const std::string key = os.str();
+  CuDNNAlgoReg::Entry entry;
+  if (CuDNNAlgoReg::Get()->Find(key, &entry)) {
+    *algo = entry.fwd;
+    *back_algo = entry.bwd_data;
+    *back_algo_w = entry.bwd_filter;
+    *forward_workspace_byte = entry.forward_workspace_byte;
+    *backward_workspace_byte = entry.backward_workspace_byte;
+    return;
+  }
+
   cudnnTensorDescriptor_t in_desc;
   cudnnTensorDescriptor_t out_desc;
   cudnnTensorDescriptor_t bias_desc;
@@ -262,6 +287,13 @@ void TuneCudnnConvolution(ConvolutionParam param,
   CHECK_EQ(cudnnDestroyTensorDescriptor(bias_desc), CUDNN_STATUS_SUCCESS);
   CHECK_EQ(cudnnDestroyFilterDescriptor(filter_desc), CUDNN_STATUS_SUCCESS);
   CHECK_EQ(cudnnDestroyConvolutionDescriptor(conv_desc), CUDNN_STATUS_SUCCESS);
+
+  entry.fwd = *algo;
+  entry.bwd_data = *back_algo;
+  entry.bwd_filter = *back_algo_w;
+  entry.forward_workspace_byte = *forward_workspace_byte;
+  entry.backward_workspace_byte = *backward_workspace_byte;
+  CuDNNAlgoReg::Get()->Register(key, entry);
 }
 #endif  // CUDNN
 }  // namespace op
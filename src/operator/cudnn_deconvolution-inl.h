@@ -46,13 +46,13 @@ class CuDNNDeconvolutionOp : public Operator {
     CHECK_EQ(in_data.size(), expected);
     CHECK_EQ(out_data.size(), 1);
     Stream<gpu> *s = ctx.get_stream<gpu>();
-    Tensor<gpu, 4, DType> data = in_data[deconv::kData].get<gpu, 4, DType>(s);
-    Tensor<gpu, 4, DType> wmat = in_data[deconv::kWeight].get<gpu, 4, DType>(s);
-    Tensor<gpu, 4, DType> out = out_data[deconv::kOut].get<gpu, 4, DType>(s);
-
-    CHECK_EQ(data.CheckContiguous(), true);
-    CHECK_EQ(wmat.CheckContiguous(), true);
-    CHECK_EQ(out.CheckContiguous(), true);
+    // 4D or 5D, the descriptors hold the shapes
+    CHECK_EQ(in_data[deconv::kData].CheckContiguous(), true);
+    CHECK_EQ(in_data[deconv::kWeight].CheckContiguous(), true);
+    CHECK_EQ(out_data[deconv::kOut].CheckContiguous(), true);
+    const DType *data_ptr = in_data[deconv::kData].dptr<DType>();
+    const DType *wmat_ptr = in_data[deconv::kWeight].dptr<DType>();
+    DType *out_ptr = out_data[deconv::kOut].dptr<DType>();
     if (!init_cudnn_) {
       Init(s, in_data, out_data);
     }
@@ -66,30 +66,30 @@ class CuDNNDeconvolutionOp : public Operator {
       CHECK_EQ(cudnnConvolutionBackwardData_v3(s->dnn_handle_,
                &alpha,
                filter_desc_,
-               wmat.dptr_ + weight_offset_ * g,
+               wmat_ptr + weight_offset_ * g,
                in_desc_,
-               data.dptr_ + data_offset_ * g,
+               data_ptr + data_offset_ * g,
                conv_desc_,
                back_algo_,
                workspace.dptr_,
                backward_workspace_byte_,
                &beta,
                out_desc_,
-               out.dptr_ + out_offset_ * g), CUDNN_STATUS_SUCCESS);
+               out_ptr + out_offset_ * g), CUDNN_STATUS_SUCCESS);
       #elif CUDNN_MAJOR == 5
       CHECK_EQ(cudnnConvolutionBackwardData(s->dnn_handle_,
                &alpha,
                filter_desc_,
-               wmat.dptr_ + weight_offset_ * g,
+               wmat_ptr + weight_offset_ * g,
                in_desc_,
-               data.dptr_ + data_offset_ * g,
+               data_ptr + data_offset_ * g,
                conv_desc_,
                back_algo_,
                workspace.dptr_,
                backward_workspace_byte_,
                &beta,
                out_desc_,
-               out.dptr_ + out_offset_ * g), CUDNN_STATUS_SUCCESS);
+               out_ptr + out_offset_ * g), CUDNN_STATUS_SUCCESS);
       #endif
       if (!param_.no_bias) {
         beta = 1.0f;
@@ -101,7 +101,7 @@ class CuDNNDeconvolutionOp : public Operator {
                                 bias.dptr_ + bias_offset_ * g,
                                 &beta,
                                 out_desc_,
-                                out.dptr_ + out_offset_ * g), CUDNN_STATUS_SUCCESS);
+                                out_ptr + out_offset_ * g), CUDNN_STATUS_SUCCESS);
 #endif
 #if CUDNN_MAJOR == 3
         CHECK_EQ(cudnnAddTensor(s->dnn_handle_,
@@ -111,7 +111,7 @@ class CuDNNDeconvolutionOp : public Operator {
                                 bias.dptr_ + bias_offset_ * g,
                                 &beta,
                                 out_desc_,
-                                out.dptr_ + out_offset_ * g), CUDNN_STATUS_SUCCESS);
+                                out_ptr + out_offset_ * g), CUDNN_STATUS_SUCCESS);
 #endif
       }
     }
@@ -132,11 +132,11 @@ class CuDNNDeconvolutionOp : public Operator {
     // TODO(bing): think about how to support add to
     CHECK_EQ(req[deconv::kWeight], kWriteTo);
     Stream<gpu> *s = ctx.get_stream<gpu>();
-    Tensor<gpu, 4, DType> grad = out_grad[deconv::kOut].get<gpu, 4, DType>(s);
-    Tensor<gpu, 4, DType> wmat = in_data[deconv::kWeight].get<gpu, 4, DType>(s);
-    Tensor<gpu, 4, DType> gwmat = in_grad[deconv::kWeight].get<gpu, 4, DType>(s);
-    Tensor<gpu, 4, DType> data = in_data[deconv::kData].get<gpu, 4, DType>(s);
-    Tensor<gpu, 4, DType> gdata = in_grad[deconv::kData].get<gpu, 4, DType>(s);
+    const DType *grad_ptr = out_grad[deconv::kOut].dptr<DType>();
+    const DType *wmat_ptr = in_data[deconv::kWeight].dptr<DType>();
+    DType *gwmat_ptr = in_grad[deconv::kWeight].dptr<DType>();
+    const DType *data_ptr = in_data[deconv::kData].dptr<DType>();
+    DType *gdata_ptr = in_grad[deconv::kData].dptr<DType>();
     Tensor<gpu, 1, DType> workspace =
         ctx.requested[deconv::kTempSpace].get_space_typed<gpu, 1, DType>(
                                  mshadow::Shape1(backward_workspace_), s);
@@ -148,7 +148,7 @@ class CuDNNDeconvolutionOp : public Operator {
         CHECK_EQ(cudnnConvolutionBackwardBias(s->dnn_handle_,
                                               &alpha,
                                               out_desc_,
-                                              grad.dptr_ + out_offset_ * g,
+                                              grad_ptr + out_offset_ * g,
                                               &beta,
                                               bias_desc_,
                                               gbias.dptr_ + bias_offset_ * g),
@@ -158,44 +158,44 @@ class CuDNNDeconvolutionOp : public Operator {
       CHECK_EQ(cudnnConvolutionBackwardFilter_v3(s->dnn_handle_,
                &alpha,
                out_desc_,
-               grad.dptr_ + out_offset_ * g,
+               grad_ptr + out_offset_ * g,
                in_desc_,
-               data.dptr_ + data_offset_ * g,
+               data_ptr + data_offset_ * g,
                conv_desc_,
                back_algo_w_,
                workspace.dptr_,
                backward_workspace_byte_,
                &beta,
                filter_desc_,
-               gwmat.dptr_ + weight_offset_ * g), CUDNN_STATUS_SUCCESS);
+               gwmat_ptr + weight_offset_ * g), CUDNN_STATUS_SUCCESS);
       #elif CUDNN_MAJOR == 5
       CHECK_EQ(cudnnConvolutionBackwardFilter(s->dnn_handle_,
                &alpha,
                out_desc_,
-               grad.dptr_ + out_offset_ * g,
+               grad_ptr + out_offset_ * g,
                in_desc_,
-               data.dptr_ + data_offset_ * g,
+               data_ptr + data_offset_ * g,
                conv_desc_,
                back_algo_w_,
                workspace.dptr_,
                backward_workspace_byte_,
                &beta,
                filter_desc_,
-               gwmat.dptr_ + weight_offset_ * g), CUDNN_STATUS_SUCCESS);
+               gwmat_ptr + weight_offset_ * g), CUDNN_STATUS_SUCCESS);
       #endif
       CHECK_EQ(cudnnConvolutionForward(s->dnn_handle_,
                                        &alpha,
                                        out_desc_,
-                                       grad.dptr_ + out_offset_ * g,
+                                       grad_ptr + out_offset_ * g,
                                        filter_desc_,
-                                       wmat.dptr_ + weight_offset_ * g,
+                                       wmat_ptr + weight_offset_ * g,
                                        conv_desc_,
                                        algo_,
                                        workspace.dptr_,
                                        forward_workspace_byte_,
                                        &beta,
                                        in_desc_,
-                                       gdata.dptr_ + data_offset_ * g), CUDNN_STATUS_SUCCESS);
+                                       gdata_ptr + data_offset_ * g), CUDNN_STATUS_SUCCESS);
     }
   }
 
@@ -215,73 +215,137 @@ class CuDNNDeconvolutionOp : public Operator {
       size_t workspace_byte = static_cast<size_t>(param_.workspace * sizeof(DType));
       size_t back_size = 0;
       size_t back_size_w = 0;
-      Tensor<gpu, 4, DType> data = in_data[deconv::kData].get<gpu, 4, DType>(s);
-      Tensor<gpu, 4, DType> out = out_data[deconv::kOut].get<gpu, 4, DType>(s);
-      index_t pad_y, pad_x, adj_y, adj_x;
-      param_.InferPad(data.size(2), data.size(3), &pad_y, &pad_x, &adj_y, &adj_x);
-      data_offset_ = data.shape_[1] / param_.num_group * data.shape_[2] * data.shape_[3];
-      out_offset_ = out.shape_[1] /param_.num_group * out.shape_[2] * out.shape_[3];
-      weight_offset_ = data.shape_[1] / param_.num_group * param_.num_filter / param_.num_group
-                       * param_.kernel[0] * param_.kernel[1];
       CHECK_EQ(cudnnCreateTensorDescriptor(&in_desc_), CUDNN_STATUS_SUCCESS);
       CHECK_EQ(cudnnCreateTensorDescriptor(&out_desc_), CUDNN_STATUS_SUCCESS);
       CHECK_EQ(cudnnCreateTensorDescriptor(&bias_desc_), CUDNN_STATUS_SUCCESS);
       CHECK_EQ(cudnnCreateFilterDescriptor(&filter_desc_), CUDNN_STATUS_SUCCESS);
       CHECK_EQ(cudnnCreateConvolutionDescriptor(&conv_desc_), CUDNN_STATUS_SUCCESS);
-      #if CUDNN_MAJOR <=4
-      CHECK_EQ(cudnnSetFilter4dDescriptor(filter_desc_,
-                                          dtype_,
-                                          data.shape_[1] / param_.num_group,
-                                          param_.num_filter / param_.num_group,
-                                          param_.kernel[0],
-                                          param_.kernel[1]), CUDNN_STATUS_SUCCESS);
-      #elif CUDNN_MAJOR ==5
-      CHECK_EQ(cudnnSetFilter4dDescriptor(filter_desc_,
-                                          dtype_,
-                                          format_,
-                                          data.shape_[1] / param_.num_group,
-                                          param_.num_filter / param_.num_group,
-                                          param_.kernel[0],
-                                          param_.kernel[1]), CUDNN_STATUS_SUCCESS);
-      #endif
-      CHECK_EQ(cudnnSetConvolution2dDescriptor(conv_desc_,
-                                               pad_y,
-                                               pad_x,
-                                               param_.stride[0],
-                                               param_.stride[1],
-                                               1,
-                                               1,
-                                               CUDNN_CROSS_CORRELATION), CUDNN_STATUS_SUCCESS);
-      CHECK_EQ(cudnnSetTensor4dDescriptorEx(in_desc_,
+      if (param_.kernel.ndim() == 2) {
+        Tensor<gpu, 4, DType> data = in_data[deconv::kData].get<gpu, 4, DType>(s);
+        Tensor<gpu, 4, DType> out = out_data[deconv::kOut].get<gpu, 4, DType>(s);
+        index_t pad_y, pad_x, adj_y, adj_x;
+        param_.InferPad(data.size(2), data.size(3), &pad_y, &pad_x, &adj_y, &adj_x);
+        data_offset_ = data.shape_[1] / param_.num_group * data.shape_[2] * data.shape_[3];
+        out_offset_ = out.shape_[1] /param_.num_group * out.shape_[2] * out.shape_[3];
+        weight_offset_ = data.shape_[1] / param_.num_group * param_.num_filter / param_.num_group
+                         * param_.kernel[0] * param_.kernel[1];
+        #if CUDNN_MAJOR <=4
+        CHECK_EQ(cudnnSetFilter4dDescriptor(filter_desc_,
+                                            dtype_,
+                                            data.shape_[1] / param_.num_group,
+                                            param_.num_filter / param_.num_group,
+                                            param_.kernel[0],
+                                            param_.kernel[1]), CUDNN_STATUS_SUCCESS);
+        #elif CUDNN_MAJOR ==5
+        CHECK_EQ(cudnnSetFilter4dDescriptor(filter_desc_,
                                             dtype_,
-                                            data.shape_[0],
+                                            format_,
                                             data.shape_[1] / param_.num_group,
-                                            data.shape_[2],
-                                            data.shape_[3],
-                                            data.shape_[1] * data.shape_[2] * data.shape_[3],
-                                            data.shape_[2] * data.shape_[3],
-                                            data.shape_[3],
-                                            1), CUDNN_STATUS_SUCCESS);
-      CHECK_EQ(cudnnSetTensor4dDescriptorEx(out_desc_,
+                                            param_.num_filter / param_.num_group,
+                                            param_.kernel[0],
+                                            param_.kernel[1]), CUDNN_STATUS_SUCCESS);
+        #endif
+        CHECK_EQ(cudnnSetConvolution2dDescriptor(conv_desc_,
+                                                 pad_y,
+                                                 pad_x,
+                                                 param_.stride[0],
+                                                 param_.stride[1],
+                                                 1,
+                                                 1,
+                                                 CUDNN_CROSS_CORRELATION), CUDNN_STATUS_SUCCESS);
+        CHECK_EQ(cudnnSetTensor4dDescriptorEx(in_desc_,
+                                              dtype_,
+                                              data.shape_[0],
+                                              data.shape_[1] / param_.num_group,
+                                              data.shape_[2],
+                                              data.shape_[3],
+                                              data.shape_[1] * data.shape_[2] * data.shape_[3],
+                                              data.shape_[2] * data.shape_[3],
+                                              data.shape_[3],
+                                              1), CUDNN_STATUS_SUCCESS);
+        CHECK_EQ(cudnnSetTensor4dDescriptorEx(out_desc_,
+                                              dtype_,
+                                              out.shape_[0],
+                                              out.shape_[1] / param_.num_group,
+                                              out.shape_[2],
+                                              out.shape_[3],
+                                              out.shape_[1] * out.shape_[2] * out.shape_[3],
+                                              out.shape_[2] * out.shape_[3],
+                                              out.shape_[3],
+                                              1), CUDNN_STATUS_SUCCESS);
+      } else {
+        // 3d deconv, with the Nd descriptors
+        const TShape &dshape = in_data[deconv::kData].shape_;
+        const TShape &oshape = out_data[deconv::kOut].shape_;
+        TShape pad, adj;
+        param_.InferPad(dshape, &pad, &adj);
+        data_offset_ = dshape[1] / param_.num_group * dshape.ProdShape(2, 5);
+        out_offset_ = oshape[1] / param_.num_group * oshape.ProdShape(2, 5);
+        weight_offset_ = dshape[1] / param_.num_group * param_.num_filter / param_.num_group
+                         * param_.kernel.Size();
+        std::vector<int> filter_vec = {static_cast<int>(dshape[1] / param_.num_group),
+                                       static_cast<int>(param_.num_filter / param_.num_group),
+                                       static_cast<int>(param_.kernel[0]),
+                                       static_cast<int>(param_.kernel[1]),
+                                       static_cast<int>(param_.kernel[2])};
+        std::vector<int> pad_vec = {static_cast<int>(pad[0]),
+                                    static_cast<int>(pad[1]),
+                                    static_cast<int>(pad[2])};
+        std::vector<int> stride_vec = {static_cast<int>(param_.stride[0]),
+                                       static_cast<int>(param_.stride[1]),
+                                       static_cast<int>(param_.stride[2])};
+        std::vector<int> upscale_vec = {1, 1, 1};
+        // a group of the channels, in the strides of all of them
+        std::vector<int> ishape(5), istride(5), ovec(5), ostride(5);
+        for (int k = 4; k >= 0; --k) {
+          ishape[k] = static_cast<int>(k == 1 ? dshape[1] / param_.num_group : dshape[k]);
+          ovec[k] = static_cast<int>(k == 1 ? oshape[1] / param_.num_group : oshape[k]);
+          istride[k] = k == 4 ? 1 : istride[k + 1] * static_cast<int>(dshape[k + 1]);
+          ostride[k] = k == 4 ? 1 : ostride[k + 1] * static_cast<int>(oshape[k + 1]);
+        }
+        #if CUDNN_MAJOR == 5
+        CHECK_EQ(cudnnSetFilterNdDescriptor(filter_desc_,
                                             dtype_,
-                                            out.shape_[0],
-                                            out.shape_[1] / param_.num_group,
-                                            out.shape_[2],
-                                            out.shape_[3],
-                                            out.shape_[1] * out.shape_[2] * out.shape_[3],
-                                            out.shape_[2] * out.shape_[3],
-                                            out.shape_[3],
-                                            1), CUDNN_STATUS_SUCCESS);
+                                            format_,
+                                            static_cast<int>(filter_vec.size()),
+                                            &filter_vec[0]), CUDNN_STATUS_SUCCESS);
+        #else
+        LOG(FATAL) << "Only support CUDNN V5 for 3D deconvolution";
+        #endif
+        CHECK_EQ(cudnnSetConvolutionNdDescriptor(conv_desc_,
+                                                 3,
+                                                 &pad_vec[0],
+                                                 &stride_vec[0],
+                                                 &upscale_vec[0],
+                                                 CUDNN_CROSS_CORRELATION,
+                                                 dtype_), CUDNN_STATUS_SUCCESS);
+        CHECK_EQ(cudnnSetTensorNdDescriptor(in_desc_,
+                                            dtype_,
+                                            static_cast<int>(ishape.size()),
+                                            &ishape[0],
+                                            &istride[0]), CUDNN_STATUS_SUCCESS);
+        CHECK_EQ(cudnnSetTensorNdDescriptor(out_desc_,
+                                            dtype_,
+                                            static_cast<int>(ovec.size()),
+                                            &ovec[0],
+                                            &ostride[0]), CUDNN_STATUS_SUCCESS);
+      }
       if (!param_.no_bias) {
         Tensor<gpu, 1, DType> bias = in_data[deconv::kBias].get<gpu, 1, DType>(s);
         bias_offset_ = bias.shape_[0] / param_.num_group;
-        CHECK_EQ(cudnnSetTensor4dDescriptor(bias_desc_,
-                                            CUDNN_TENSOR_NCHW,
+        std::vector<int> bias_shape = {1,
+                                       static_cast<int>(bias.shape_[0] / param_.num_group),
+                                       1, 1};
+        std::vector<int> bias_stride = {static_cast<int>(bias_offset_), 1, 1, 1};
+        if (param_.kernel.ndim() == 3) {
+          bias_shape.push_back(1);
+          bias_stride.push_back(1);
+        }
+        CHECK_EQ(cudnnSetTensorNdDescriptor(bias_desc_,
                                             dtype_,
-                                            1,
-                                            bias.shape_[0] / param_.num_group,
-                                            1,
-                                            1), CUDNN_STATUS_SUCCESS);
+                                            static_cast<int>(bias_shape.size()),
+                                            &bias_shape[0],
+                                            &bias_stride[0]), CUDNN_STATUS_SUCCESS);
       }
       CHECK_EQ(s->dnn_handle_ownership_, mshadow::Stream<gpu>::OwnHandle);
       CHECK_EQ(cudnnGetConvolutionForwardAlgorithm(s->dnn_handle_,
@@ -0,0 +1,433 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file cudnn_rnn-inl.h
+ * \brief the fused recurrent layers of cuDNN v5 and later
+*/
+#ifndef MXNET_OPERATOR_CUDNN_RNN_INL_H_
+#define MXNET_OPERATOR_CUDNN_RNN_INL_H_
+
+#include <mxnet/storage.h>
+#include <algorithm>
+#include <vector>
+#include "./rnn-inl.h"
+
+namespace mxnet {
+namespace op {
+#if defined(__CUDACC__) && MXNET_USE_CUDNN == 1 && CUDNN_MAJOR >= 5
+/*!
+ * \brief the parameters are copied from the layout of RNNParam to the one of
+ *  cuDNN before each forward, and the gradients back, unless both layouts are
+ *  the same. The reserve space of the training forward is kept by the op until
+ *  the backward, so it is allocated from the storage instead of the temp space.
+ *
+ *  With the lengths of the sequences, the batch must be sorted by decreasing
+ *  length. The rows of the running sequences of each step, the first ones, are
+ *  packed for cuDNN, whose steps then have decreasing batch sizes, so that the
+ *  padding is neither computed nor stored in the reserve space.
+ */
+template<typename DType>
+class CuDNNRNNOp : public Operator {
+ public:
+  explicit CuDNNRNNOp(RNNParam param) : param_(param), init_cudnn_(false) {
+    dtype_ = mshadow::DataType<DType>::kCudnnFlag;
+  }
+
+  ~CuDNNRNNOp() {
+    if (init_cudnn_) {
+      for (size_t i = 0; i < x_desc_.size(); ++i) {
+        CHECK_EQ(cudnnDestroyTensorDescriptor(x_desc_[i]), CUDNN_STATUS_SUCCESS);
+        CHECK_EQ(cudnnDestroyTensorDescriptor(y_desc_[i]), CUDNN_STATUS_SUCCESS);
+      }
+      CHECK_EQ(cudnnDestroyTensorDescriptor(h_desc_), CUDNN_STATUS_SUCCESS);
+      CHECK_EQ(cudnnDestroyFilterDescriptor(w_desc_), CUDNN_STATUS_SUCCESS);
+      CHECK_EQ(cudnnDestroyRNNDescriptor(rnn_desc_), CUDNN_STATUS_SUCCESS);
+      CHECK_EQ(cudnnDestroyDropoutDescriptor(dropout_desc_), CUDNN_STATUS_SUCCESS);
+      Storage::Get()->Free(dropout_states_);
+      if (!identity_layout_) {
+        Storage::Get()->Free(w_);
+        Storage::Get()->Free(dw_);
+      }
+      if (reserve_.size != 0) Storage::Get()->Free(reserve_);
+    }
+  }
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    if (req[rnn_enum::kOut] == kNullOp) return;
+    CHECK_EQ(req[rnn_enum::kOut], kWriteTo);
+    Stream<gpu> *s = ctx.get_stream<gpu>();
+    const bool lstm = param_.mode == rnn_enum::kLstm;
+    if (!init_cudnn_) {
+      this->Init(s, in_data);
+    }
+    CHECK_EQ(s->dnn_handle_ownership_, mshadow::Stream<gpu>::OwnHandle);
+    if (param_.use_sequence_length) this->SetLengths(s, in_data);
+    const DType *w = in_data[rnn_enum::kParams].dptr<DType>();
+    if (!identity_layout_) {
+      this->CopyParams(s, const_cast<DType*>(w), static_cast<DType*>(w_.dptr), false);
+      w = static_cast<DType*>(w_.dptr);
+    }
+    const int I = in_data[rnn_enum::kData].shape_[2];
+    const int DH = out_data[rnn_enum::kOut].shape_[2];
+    const size_t packed = param_.use_sequence_length ? packed_rows_ * (I + DH) : 0;
+    Tensor<gpu, 1, DType> workspace =
+        ctx.requested[rnn_enum::kTempSpace].get_space_typed<gpu, 1, DType>(
+            mshadow::Shape1(workspace_size_ / sizeof(DType) + 1 + packed), s);
+    const void *x = in_data[rnn_enum::kData].dptr_;
+    void *y = out_data[rnn_enum::kOut].dptr_;
+    if (param_.use_sequence_length) {
+      DType *px = workspace.dptr_ + workspace_size_ / sizeof(DType) + 1;
+      this->Pack(s, in_data[rnn_enum::kData].dptr<DType>(), px, I, false);
+      x = px;
+      y = px + packed_rows_ * I;
+    }
+    void *hy = param_.state_outputs ? out_data[rnn_enum::kStateOut].dptr_ : NULL;
+    void *cy = param_.state_outputs && lstm ? out_data[rnn_enum::kStateCellOut].dptr_ : NULL;
+    const void *cx = lstm ? in_data[rnn_enum::kStateCell].dptr_ : NULL;
+    if (ctx.is_train) {
+      CHECK_EQ(cudnnRNNForwardTraining(s->dnn_handle_, rnn_desc_, seq_length_,
+                                       x_desc_.data(), x,
+                                       h_desc_, in_data[rnn_enum::kState].dptr_,
+                                       h_desc_, cx,
+                                       w_desc_, w,
+                                       y_desc_.data(), y,
+                                       h_desc_, hy,
+                                       h_desc_, cy,
+                                       workspace.dptr_, workspace_size_,
+                                       reserve_.dptr, reserve_.size), CUDNN_STATUS_SUCCESS);
+    } else {
+      CHECK_EQ(cudnnRNNForwardInference(s->dnn_handle_, rnn_desc_, seq_length_,
+                                        x_desc_.data(), x,
+                                        h_desc_, in_data[rnn_enum::kState].dptr_,
+                                        h_desc_, cx,
+                                        w_desc_, w,
+                                        y_desc_.data(), y,
+                                        h_desc_, hy,
+                                        h_desc_, cy,
+                                        workspace.dptr_, workspace_size_), CUDNN_STATUS_SUCCESS);
+    }
+    if (param_.use_sequence_length) {
+      this->Pack(s, out_data[rnn_enum::kOut].dptr<DType>(), static_cast<DType*>(y), DH, true);
+    }
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    for (size_t i = 0; i < req.size(); ++i) {
+      CHECK(req[i] == kWriteTo || req[i] == kNullOp)
+          << "RNN only supports write to the gradients";
+    }
+    Stream<gpu> *s = ctx.get_stream<gpu>();
+    const bool lstm = param_.mode == rnn_enum::kLstm;
+    CHECK(init_cudnn_);
+    const DType *w = identity_layout_ ? in_data[rnn_enum::kParams].dptr<DType>() :
+        static_cast<DType*>(w_.dptr);
+    DType *dw = identity_layout_ ? in_grad[rnn_enum::kParams].dptr<DType>() :
+        static_cast<DType*>(dw_.dptr);
+    // the lengths and descriptors are the ones of the forward
+    const int I = in_data[rnn_enum::kData].shape_[2];
+    const int DH = out_data[rnn_enum::kOut].shape_[2];
+    const size_t packed = param_.use_sequence_length ? packed_rows_ * 2 * (I + DH) : 0;
+    Tensor<gpu, 1, DType> workspace =
+        ctx.requested[rnn_enum::kTempSpace].get_space_typed<gpu, 1, DType>(
+            mshadow::Shape1(workspace_size_ / sizeof(DType) + 1 + packed), s);
+    const void *x = in_data[rnn_enum::kData].dptr_, *y = out_data[rnn_enum::kOut].dptr_;
+    const void *dy = out_grad[rnn_enum::kOut].dptr_;
+    void *dx = in_grad[rnn_enum::kData].dptr_;
+    if (param_.use_sequence_length) {
+      DType *px = workspace.dptr_ + workspace_size_ / sizeof(DType) + 1;
+      DType *py = px + packed_rows_ * I, *pdy = py + packed_rows_ * DH;
+      this->Pack(s, in_data[rnn_enum::kData].dptr<DType>(), px, I, false);
+      this->Pack(s, out_data[rnn_enum::kOut].dptr<DType>(), py, DH, false);
+      this->Pack(s, out_grad[rnn_enum::kOut].dptr<DType>(), pdy, DH, false);
+      x = px;
+      y = py;
+      dy = pdy;
+      dx = pdy + packed_rows_ * DH;
+    }
+    const void *dhy = param_.state_outputs ? out_grad[rnn_enum::kStateOut].dptr_ : NULL;
+    const void *dcy = param_.state_outputs && lstm ?
+        out_grad[rnn_enum::kStateCellOut].dptr_ : NULL;
+    const void *cx = lstm ? in_data[rnn_enum::kStateCell].dptr_ : NULL;
+    void *dcx = lstm ? in_grad[rnn_enum::kStateCell].dptr_ : NULL;
+    CHECK_EQ(cudnnRNNBackwardData(s->dnn_handle_, rnn_desc_, seq_length_,
+                                  y_desc_.data(), y,
+                                  y_desc_.data(), dy,
+                                  h_desc_, dhy,
+                                  h_desc_, dcy,
+                                  w_desc_, w,
+                                  h_desc_, in_data[rnn_enum::kState].dptr_,
+                                  h_desc_, cx,
+                                  x_desc_.data(), dx,
+                                  h_desc_, in_grad[rnn_enum::kState].dptr_,
+                                  h_desc_, dcx,
+                                  workspace.dptr_, workspace_size_,
+                                  reserve_.dptr, reserve_.size), CUDNN_STATUS_SUCCESS);
+    // the weight gradients are accumulated by cuDNN
+    CHECK_EQ(cudaMemsetAsync(dw, 0, param_size_ * sizeof(DType),
+                             Stream<gpu>::GetStream(s)), cudaSuccess);
+    CHECK_EQ(cudnnRNNBackwardWeights(s->dnn_handle_, rnn_desc_, seq_length_,
+                                     x_desc_.data(), x,
+                                     h_desc_, in_data[rnn_enum::kState].dptr_,
+                                     y_desc_.data(), y,
+                                     workspace.dptr_, workspace_size_,
+                                     w_desc_, dw,
+                                     reserve_.dptr, reserve_.size), CUDNN_STATUS_SUCCESS);
+    if (!identity_layout_) {
+      this->CopyParams(s, in_grad[rnn_enum::kParams].dptr<DType>(), dw, true);
+    }
+    if (param_.use_sequence_length && req[rnn_enum::kData] != kNullOp) {
+      this->Pack(s, in_grad[rnn_enum::kData].dptr<DType>(), static_cast<DType*>(dx), I, true);
+    }
+  }
+
+ private:
+  /*! \brief a matrix or bias of a gate, by offsets in both layouts */
+  struct ParamBlock {
+    index_t canonical, cudnn, size;
+  };
+
+  inline void Init(mshadow::Stream<gpu> *s, const std::vector<TBlob> &in_data) {
+    using namespace mshadow;
+    const TShape &dshape = in_data[rnn_enum::kData].shape_;
+    const int T = dshape[0], N = dshape[1], I = dshape[2];
+    const int H = param_.state_size, D = param_.bidirectional ? 2 : 1;
+    const int L = param_.num_layers;
+    init_cudnn_ = true;
+    cudnnHandle_t handle = s->dnn_handle_;
+
+    CHECK_EQ(cudnnCreateDropoutDescriptor(&dropout_desc_), CUDNN_STATUS_SUCCESS);
+    size_t dropout_size;
+    CHECK_EQ(cudnnDropoutGetStatesSize(handle, &dropout_size), CUDNN_STATUS_SUCCESS);
+    int dev_id;
+    CHECK_EQ(cudaGetDevice(&dev_id), cudaSuccess);
+    const Context gpu_ctx = Context::GPU(dev_id);
+    ctx_ = gpu_ctx;
+    dropout_states_ = Storage::Get()->Alloc(dropout_size, gpu_ctx);
+    CHECK_EQ(cudnnSetDropoutDescriptor(dropout_desc_, handle, 0.0f, dropout_states_.dptr,
+                                       dropout_size, 0), CUDNN_STATUS_SUCCESS);
+
+    cudnnRNNMode_t mode;
+    switch (param_.mode) {
+      case rnn_enum::kRnnRelu: mode = CUDNN_RNN_RELU; break;
+      case rnn_enum::kRnnTanh: mode = CUDNN_RNN_TANH; break;
+      case rnn_enum::kLstm: mode = CUDNN_LSTM; break;
+      default: mode = CUDNN_GRU; break;
+    }
+    const cudnnDirectionMode_t direction = param_.bidirectional ?
+        CUDNN_BIDIRECTIONAL : CUDNN_UNIDIRECTIONAL;
+    CHECK_EQ(cudnnCreateRNNDescriptor(&rnn_desc_), CUDNN_STATUS_SUCCESS);
+#if CUDNN_MAJOR >= 6
+    CHECK_EQ(cudnnSetRNNDescriptor_v6(handle, rnn_desc_, H, L, dropout_desc_,
+                                      CUDNN_LINEAR_INPUT, direction, mode,
+                                      CUDNN_RNN_ALGO_STANDARD, dtype_),
+             CUDNN_STATUS_SUCCESS);
+#else
+    CHECK_EQ(cudnnSetRNNDescriptor(rnn_desc_, H, L, dropout_desc_,
+                                   CUDNN_LINEAR_INPUT, direction, mode, dtype_),
+             CUDNN_STATUS_SUCCESS);
+#endif  // CUDNN_MAJOR >= 6
+
+    reserve_.size = 0;
+    in_seq_length_ = T;
+    batch_size_ = N;
+    input_size_ = I;
+    this->SetSequence(handle, std::vector<int>(T, N));
+    int hdim[3] = {L * D, N, H}, hstride[3] = {N * H, H, 1};
+    CHECK_EQ(cudnnCreateTensorDescriptor(&h_desc_), CUDNN_STATUS_SUCCESS);
+    CHECK_EQ(cudnnSetTensorNdDescriptor(h_desc_, dtype_, 3, hdim, hstride),
+             CUDNN_STATUS_SUCCESS);
+
+    size_t param_bytes;
+    CHECK_EQ(cudnnGetRNNParamsSize(handle, rnn_desc_, x_desc_[0], &param_bytes, dtype_),
+             CUDNN_STATUS_SUCCESS);
+    param_size_ = in_data[rnn_enum::kParams].Size();
+    CHECK_EQ(param_bytes, param_size_ * sizeof(DType))
+        << "the parameters of cuDNN differ from the ones of RNNParam";
+    int wdim[3] = {static_cast<int>(param_size_), 1, 1};
+    CHECK_EQ(cudnnCreateFilterDescriptor(&w_desc_), CUDNN_STATUS_SUCCESS);
+    CHECK_EQ(cudnnSetFilterNdDescriptor(w_desc_, dtype_, CUDNN_TENSOR_NCHW, 3, wdim),
+             CUDNN_STATUS_SUCCESS);
+
+    // locate the matrices and biases of cuDNN by a null parameter pointer
+    const int G = NumGates(param_.mode);
+    std::vector<RNNParamOffset> offsets = GetRNNParamOffsets(param_, I);
+    cudnnFilterDescriptor_t lin_desc;
+    CHECK_EQ(cudnnCreateFilterDescriptor(&lin_desc), CUDNN_STATUS_SUCCESS);
+    DType *base = NULL;
+    identity_layout_ = true;
+    blocks_.clear();
+    for (int l = 0; l < L; ++l) {
+      const index_t in = l == 0 ? I : D * H;
+      for (int d = 0; d < D; ++d) {
+        const RNNParamOffset &off = offsets[l * D + d];
+        for (int k = 0; k < 2 * G; ++k) {
+          void *mat, *bias;
+          CHECK_EQ(cudnnGetRNNLinLayerMatrixParams(handle, rnn_desc_, l * D + d, x_desc_[0],
+                                                   w_desc_, base, k, lin_desc, &mat),
+                   CUDNN_STATUS_SUCCESS);
+          CHECK_EQ(cudnnGetRNNLinLayerBiasParams(handle, rnn_desc_, l * D + d, x_desc_[0],
+                                                 w_desc_, base, k, lin_desc, &bias),
+                   CUDNN_STATUS_SUCCESS);
+          ParamBlock wblock, bblock;
+          if (k < G) {
+            wblock.canonical = off.wx + k * H * in;
+            wblock.size = H * in;
+            bblock.canonical = off.bx + k * H;
+          } else {
+            wblock.canonical = off.wh + (k - G) * H * H;
+            wblock.size = H * H;
+            bblock.canonical = off.bh + (k - G) * H;
+          }
+          wblock.cudnn = static_cast<DType*>(mat) - base;
+          bblock.cudnn = static_cast<DType*>(bias) - base;
+          bblock.size = H;
+          identity_layout_ = identity_layout_ && wblock.cudnn == wblock.canonical &&
+              bblock.cudnn == bblock.canonical;
+          blocks_.push_back(wblock);
+          blocks_.push_back(bblock);
+        }
+      }
+    }
+    CHECK_EQ(cudnnDestroyFilterDescriptor(lin_desc), CUDNN_STATUS_SUCCESS);
+    if (!identity_layout_) {
+      w_ = Storage::Get()->Alloc(param_bytes, gpu_ctx);
+      dw_ = Storage::Get()->Alloc(param_bytes, gpu_ctx);
+    }
+  }
+
+  /*!
+   * \brief set the descriptors of the steps to their batch sizes, and the sizes of
+   *  the workspace and of the reserve space
+   */
+  inline void SetSequence(cudnnHandle_t handle, const std::vector<int> &batches) {
+    if (batches == batches_) return;
+    batches_ = batches;
+    seq_length_ = batches.size();
+    const int I = input_size_;
+    const int DH = param_.state_size * (param_.bidirectional ? 2 : 1);
+    while (x_desc_.size() > batches.size()) {
+      CHECK_EQ(cudnnDestroyTensorDescriptor(x_desc_.back()), CUDNN_STATUS_SUCCESS);
+      CHECK_EQ(cudnnDestroyTensorDescriptor(y_desc_.back()), CUDNN_STATUS_SUCCESS);
+      x_desc_.pop_back();
+      y_desc_.pop_back();
+    }
+    while (x_desc_.size() < batches.size()) {
+      cudnnTensorDescriptor_t xd, yd;
+      CHECK_EQ(cudnnCreateTensorDescriptor(&xd), CUDNN_STATUS_SUCCESS);
+      CHECK_EQ(cudnnCreateTensorDescriptor(&yd), CUDNN_STATUS_SUCCESS);
+      x_desc_.push_back(xd);
+      y_desc_.push_back(yd);
+    }
+    packed_rows_ = 0;
+    for (int t = 0; t < seq_length_; ++t) {
+      int xdim[3] = {batches[t], I, 1}, xstride[3] = {I, 1, 1};
+      int ydim[3] = {batches[t], DH, 1}, ystride[3] = {DH, 1, 1};
+      CHECK_EQ(cudnnSetTensorNdDescriptor(x_desc_[t], dtype_, 3, xdim, xstride),
+               CUDNN_STATUS_SUCCESS);
+      CHECK_EQ(cudnnSetTensorNdDescriptor(y_desc_[t], dtype_, 3, ydim, ystride),
+               CUDNN_STATUS_SUCCESS);
+      packed_rows_ += batches[t];
+    }
+    CHECK_EQ(cudnnGetRNNWorkspaceSize(handle, rnn_desc_, seq_length_, x_desc_.data(),
+                                      &workspace_size_), CUDNN_STATUS_SUCCESS);
+    size_t reserve_size;
+    CHECK_EQ(cudnnGetRNNTrainingReserveSize(handle, rnn_desc_, seq_length_, x_desc_.data(),
+                                            &reserve_size), CUDNN_STATUS_SUCCESS);
+    if (reserve_size > reserve_.size) {
+      if (reserve_.size != 0) Storage::Get()->Free(reserve_);
+      reserve_ = Storage::Get()->Alloc(reserve_size, ctx_);
+    }
+  }
+
+  /*! \brief the steps up to the longest sequence, of the running sequences */
+  inline void SetLengths(mshadow::Stream<gpu> *s, const std::vector<TBlob> &in_data) {
+    const TBlob &len = in_data[RNNSequenceLengthInput(param_)];
+    const int T = in_data[rnn_enum::kData].shape_[0], N = len.shape_[0];
+    std::vector<DType> host(N);
+    cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+    CHECK_EQ(cudaMemcpyAsync(host.data(), len.dptr_, N * sizeof(DType),
+                             cudaMemcpyDeviceToHost, stream), cudaSuccess);
+    CHECK_EQ(cudaStreamSynchronize(stream), cudaSuccess);
+    std::vector<int> batches;
+    for (int n = 0; n < N; ++n) {
+      const int l = std::min(static_cast<int>(static_cast<float>(host[n])), T);
+      CHECK_GE(l, 1) << "the sequences must not be empty";
+      CHECK(n == 0 || l <= static_cast<int>(static_cast<float>(host[n - 1])))
+          << "the batch must be sorted by decreasing sequence length on gpu";
+      if (static_cast<int>(batches.size()) < l) batches.resize(l, 0);
+      for (int t = 0; t < l; ++t) ++batches[t];
+    }
+    this->SetSequence(s->dnn_handle_, batches);
+  }
+
+  /*!
+   * \brief copy the running rows of each step from a padded (T, N, width) array to
+   *  the packed one, or back if unpack, after clearing the padded one
+   */
+  inline void Pack(mshadow::Stream<gpu> *s, DType *padded, DType *packed, int width,
+                   bool unpack) {
+    cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+    const size_t step = static_cast<size_t>(batch_size_) * width;
+    if (unpack) {
+      const size_t size = step * in_seq_length_ * sizeof(DType);
+      CHECK_EQ(cudaMemsetAsync(padded, 0, size, stream), cudaSuccess);
+    }
+    size_t pos = 0;
+    for (int t = 0; t < seq_length_; ++t) {
+      const size_t size = static_cast<size_t>(batches_[t]) * width;
+      DType *dst = unpack ? padded + t * step : packed + pos;
+      const DType *src = unpack ? packed + pos : padded + t * step;
+      CHECK_EQ(cudaMemcpyAsync(dst, src, size * sizeof(DType), cudaMemcpyDeviceToDevice,
+                               stream), cudaSuccess);
+      pos += size;
+    }
+  }
+
+  /*! \brief copy the parameters between the layouts, to_canonical from the cuDNN one */
+  inline void CopyParams(mshadow::Stream<gpu> *s, DType *canonical, DType *cudnn,
+                         bool to_canonical) {
+    cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+    for (const ParamBlock &b : blocks_) {
+      DType *dst = to_canonical ? canonical + b.canonical : cudnn + b.cudnn;
+      const DType *src = to_canonical ? cudnn + b.cudnn : canonical + b.canonical;
+      CHECK_EQ(cudaMemcpyAsync(dst, src, b.size * sizeof(DType),
+                               cudaMemcpyDeviceToDevice, stream), cudaSuccess);
+    }
+  }
+
+  RNNParam param_;
+  bool init_cudnn_;
+  bool identity_layout_;
+  cudnnDataType_t dtype_;
+  int seq_length_;
+  /*! \brief the shape of the padded input, and the batch of each step */
+  int in_seq_length_, batch_size_, input_size_;
+  std::vector<int> batches_;
+  /*! \brief the rows of the packed steps */
+  size_t packed_rows_;
+  Context ctx_;
+  index_t param_size_;
+  size_t workspace_size_;
+  cudnnRNNDescriptor_t rnn_desc_;
+  cudnnDropoutDescriptor_t dropout_desc_;
+  std::vector<cudnnTensorDescriptor_t> x_desc_, y_desc_;
+  cudnnTensorDescriptor_t h_desc_;
+  cudnnFilterDescriptor_t w_desc_;
+  std::vector<ParamBlock> blocks_;
+  Storage::Handle dropout_states_, reserve_, w_, dw_;
+};  // class CuDNNRNNOp
+#endif  // __CUDACC__ && CUDNN
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CUDNN_RNN_INL_H_
@@ -11,7 +11,14 @@
 #include <dmlc/parameter.h>
 #include <mxnet/operator.h>
 #include <mxnet/c_api.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 #include <utility>
@@ -20,6 +27,62 @@
 
 namespace mxnet {
 namespace op {
+/*!
+ * \brief the threads running the frontend callbacks of custom operators, so
+ *  that the engine workers are not blocked by the frontend, e.g. its GIL.
+ *  A thread takes all of the ready callbacks at once and runs them one
+ *  after another. The number of threads is MXNET_CUSTOM_OP_NUM_THREADS.
+ */
+class CustomOpWorker {
+ public:
+  /*! \brief the singleton */
+  static CustomOpWorker* Get() {
+    static CustomOpWorker inst;
+    return &inst;
+  }
+  /*! \brief run fn on one of the threads */
+  void Push(std::function<void()> fn) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(fn));
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  CustomOpWorker() : stop_(false) {
+    const int nthreads = std::max(dmlc::GetEnv("MXNET_CUSTOM_OP_NUM_THREADS", 1), 1);
+    for (int i = 0; i < nthreads; ++i) {
+      threads_.emplace_back([this]() { this->Run(); });
+    }
+  }
+  ~CustomOpWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread &t : threads_) t.join();
+  }
+  void Run() {
+    std::deque<std::function<void()> > batch;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty()) return;
+        batch.swap(tasks_);
+      }
+      for (std::function<void()> &fn : batch) fn();
+      batch.clear();
+    }
+  }
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()> > tasks_;
+  std::vector<std::thread> threads_;
+  bool stop_;
+};
 
 struct CustomOpParam {
   std::string op_type;
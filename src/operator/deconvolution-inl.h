@@ -16,6 +16,7 @@
 #include <string>
 #include <utility>
 #include "./operator_common.h"
+#include "./vol2col-inl.h"
 
 
 namespace mxnet {
@@ -39,19 +40,19 @@ struct DeconvolutionParam : public dmlc::Parameter<DeconvolutionParam> {
   bool no_bias;
   DMLC_DECLARE_PARAMETER(DeconvolutionParam) {
     int shape[] = {1, 1};
-    DMLC_DECLARE_FIELD(kernel).describe("deconvolution kernel size: (y, x)");
+    DMLC_DECLARE_FIELD(kernel).describe("deconvolution kernel size: (y, x) or (d, y, x)");
     DMLC_DECLARE_FIELD(stride).set_default(TShape(shape, shape + 2))
-        .describe("deconvolution stride: (y, x)");
+        .describe("deconvolution stride: (y, x) or (d, y, x)");
     shape[0] = shape[1] = 0;
     DMLC_DECLARE_FIELD(pad).set_default(TShape(shape, shape + 2))
-        .describe("pad for deconvolution: (y, x), a good number is : (kernel-1)/2, "
+        .describe("pad for deconvolution: (y, x) or (d, y, x), a good number is : (kernel-1)/2, "
                   "if target_shape set, pad will be ignored and will be computed "
                   "automatically");
     DMLC_DECLARE_FIELD(adj).set_default(TShape(shape, shape + 2))
-        .describe("adjustment for output shape: (y, x), if target_shape set, adj "
+        .describe("adjustment for output shape: (y, x) or (d, y, x), if target_shape set, adj "
                   "will be ignored and will be computed automatically");
     DMLC_DECLARE_FIELD(target_shape).set_default(TShape(shape, shape + 2))
-        .describe("output shape with targe shape : (y, x)");
+        .describe("output shape with targe shape : (y, x) or (d, y, x)");
     DMLC_DECLARE_FIELD(num_filter).set_range(1, 100000)
         .describe("deconvolution filter(channel) number");
     DMLC_DECLARE_FIELD(num_group).set_default(1)
@@ -87,6 +88,34 @@ struct DeconvolutionParam : public dmlc::Parameter<DeconvolutionParam> {
       adj_x = adj[1];
     }
   }
+  /*!
+   * \brief the pad and adj of each spatial dimension of the input dshape, for any
+   *  number of them. The dimensions missing in pad, adj or target_shape are 0.
+   */
+  inline void InferPad(const TShape &dshape, TShape *o_pad, TShape *o_adj) const {
+    const index_t ndim = kernel.ndim();
+    TShape &p = *o_pad;
+    TShape &a = *o_adj;
+    p = TShape(ndim);
+    a = TShape(ndim);
+    bool has_target = false;
+    for (index_t i = 0; i < target_shape.ndim(); ++i) {
+      if (target_shape[i] != 0) has_target = true;
+    }
+    for (index_t i = 0; i < ndim; ++i) {
+      if (has_target) {
+        const index_t target = i < target_shape.ndim() ? target_shape[i] : 0;
+        index_t total = stride[i] * (dshape[i + 2] - 1) + kernel[i];
+        CHECK_GE(total, target) << "too big target shape";
+        total -= target;
+        a[i] = total % 2;
+        p[i] = (total + 1) / 2;
+      } else {
+        p[i] = i < pad.ndim() ? pad[i] : 0;
+        a[i] = i < adj.ndim() ? adj[i] : 0;
+      }
+    }
+  }
 };
 
 template<typename xpu, typename DType>
@@ -110,6 +139,10 @@ class DeconvolutionOp : public Operator {
     CHECK_EQ(in_data.size(), expected);
     CHECK_EQ(out_data.size(), 1);
     Stream<xpu> *s = ctx.get_stream<xpu>();
+    if (param_.kernel.ndim() == 3) {
+      this->Forward3D(ctx, in_data, out_data);
+      return;
+    }
     Tensor<xpu, 4, DType> data = in_data[deconv::kData].get<xpu, 4, DType>(s);
     Tensor<xpu, 4, DType> out = out_data[deconv::kOut].get<xpu, 4, DType>(s);
 
@@ -206,6 +239,10 @@ class DeconvolutionOp : public Operator {
     CHECK(in_data.size() == expected && in_grad.size() == expected);
     CHECK_EQ(req.size(), expected);
     CHECK_EQ(in_data[deconv::kWeight].CheckContiguous(), true);
+    if (param_.kernel.ndim() == 3) {
+      this->Backward3D(ctx, out_grad, in_data, req, in_grad);
+      return;
+    }
     // get data
     Stream<xpu> *s = ctx.get_stream<xpu>();
     Tensor<xpu, 4, DType> data = in_data[deconv::kData].get<xpu, 4, DType>(s);
@@ -286,6 +323,121 @@ class DeconvolutionOp : public Operator {
   }
 
  private:
+  /*!
+   * \brief the 3D deconvolution, the backward of the data of a convolution from the
+   *  output to the input: each group of the columns is a GEMM of the transposed weight
+   *  and the sample, and col2vol folds them into the output
+   */
+  inline void Forward3D(const OpContext &ctx,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 5, DType> data = in_data[deconv::kData].get<xpu, 5, DType>(s);
+    Tensor<xpu, 5, DType> out = out_data[deconv::kOut].get<xpu, 5, DType>(s);
+    const vol2col::VolShape p = this->GetVolShape(out.shape_, data.shape_);
+    const index_t grows = p.rows() / param_.num_group;
+    const index_t gchannel = data.size(1) / param_.num_group;
+    Tensor<xpu, 3, DType> wmat = in_data[deconv::kWeight].get_with_shape<xpu, 3, DType>(
+        Shape3(param_.num_group, gchannel, grows), s);
+    Tensor<xpu, 2, DType> col = this->GetColSpace(ctx, p);
+    for (index_t n = 0; n < data.size(0); ++n) {
+      Tensor<xpu, 3, DType> src(data[n].dptr_, Shape3(param_.num_group, gchannel, p.cols()), s);
+      for (uint32_t gid = 0; gid < param_.num_group; ++gid) {
+        Tensor<xpu, 2, DType> tmpc = col.Slice(grows * gid, grows * (gid + 1));
+        tmpc = dot(wmat[gid].T(), src[gid]);
+      }
+      vol2col::Col2Vol(s, col.dptr_, p, false, out[n].dptr_);
+    }
+    if (!param_.no_bias) {
+      Tensor<xpu, 3, DType> out3 = out_data[deconv::kOut].get_with_shape<xpu, 3, DType>(
+          Shape3(out.size(0), out.size(1), out.shape_.ProdShape(2, 5)), s);
+      Tensor<xpu, 1, DType> bias = in_data[deconv::kBias].get<xpu, 1, DType>(s);
+      out3 += broadcast<1>(bias, out3.shape_);
+    }
+  }
+
+  inline void Backward3D(const OpContext &ctx,
+                         const std::vector<TBlob> &out_grad,
+                         const std::vector<TBlob> &in_data,
+                         const std::vector<OpReqType> &req,
+                         const std::vector<TBlob> &in_grad) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 5, DType> data = in_data[deconv::kData].get<xpu, 5, DType>(s);
+    Tensor<xpu, 5, DType> grad = out_grad[deconv::kOut].get<xpu, 5, DType>(s);
+    Tensor<xpu, 5, DType> gdata = in_grad[deconv::kData].get<xpu, 5, DType>(s);
+    const vol2col::VolShape p = this->GetVolShape(grad.shape_, data.shape_);
+    const index_t grows = p.rows() / param_.num_group;
+    const index_t gchannel = data.size(1) / param_.num_group;
+    const Shape<3> wmat_shape = Shape3(param_.num_group, gchannel, grows);
+    Tensor<xpu, 3, DType> wmat =
+        in_data[deconv::kWeight].get_with_shape<xpu, 3, DType>(wmat_shape, s);
+    Tensor<xpu, 3, DType> gwmat =
+        in_grad[deconv::kWeight].get_with_shape<xpu, 3, DType>(wmat_shape, s);
+    Tensor<xpu, 2, DType> col = this->GetColSpace(ctx, p);
+    const Shape<3> dshape = Shape3(param_.num_group, gchannel, p.cols());
+    for (index_t n = 0; n < data.size(0); ++n) {
+      Tensor<xpu, 3, DType> src(data[n].dptr_, dshape, s);
+      Tensor<xpu, 3, DType> gsrc(gdata[n].dptr_, dshape, s);
+      vol2col::Vol2Col(s, grad[n].dptr_, p, col.dptr_);
+      for (uint32_t gid = 0; gid < param_.num_group; ++gid) {
+        Tensor<xpu, 2, DType> tmpc = col.Slice(grows * gid, grows * (gid + 1));
+        if (n == 0) {
+          Tensor<xpu, 2, DType> tmp_gwmat = gwmat[gid];
+          Assign(tmp_gwmat, req[deconv::kWeight], dot(src[gid], tmpc.T()));
+        } else {
+          gwmat[gid] += dot(src[gid], tmpc.T());
+        }
+        Tensor<xpu, 2, DType> tmp_gsrc = gsrc[gid];
+        Assign(tmp_gsrc, req[deconv::kData], dot(wmat[gid], tmpc));
+      }
+    }
+    if (!param_.no_bias) {
+      Tensor<xpu, 3, DType> grad3 = out_grad[deconv::kOut].get_with_shape<xpu, 3, DType>(
+          Shape3(grad.size(0), grad.size(1), grad.shape_.ProdShape(2, 5)), s);
+      Tensor<xpu, 1, DType> gbias = in_grad[deconv::kBias].get<xpu, 1, DType>(s);
+      Assign(gbias, req[deconv::kBias], sumall_except_dim<1>(grad3));
+    }
+  }
+
+  /*! \brief the convolution from the output oshape to the input ishape */
+  inline vol2col::VolShape GetVolShape(const mshadow::Shape<5> &oshape,
+                                       const mshadow::Shape<5> &ishape) const {
+    TShape pad, adj;
+    param_.InferPad(TShape(ishape.shape_, ishape.shape_ + 5), &pad, &adj);
+    vol2col::VolShape p;
+    p.C = oshape[1];
+    p.D = oshape[2];
+    p.H = oshape[3];
+    p.W = oshape[4];
+    p.Do = ishape[2];
+    p.Ho = ishape[3];
+    p.Wo = ishape[4];
+    p.kd = param_.kernel[0];
+    p.kh = param_.kernel[1];
+    p.kw = param_.kernel[2];
+    p.sd = param_.stride[0];
+    p.sh = param_.stride[1];
+    p.sw = param_.stride[2];
+    p.pd = pad[0];
+    p.ph = pad[1];
+    p.pw = pad[2];
+    return p;
+  }
+  /*! \brief the columns of one sample in the temp space */
+  inline mshadow::Tensor<xpu, 2, DType> GetColSpace(const OpContext &ctx,
+                                                     const vol2col::VolShape &p) const {
+    const index_t required_size = p.rows() * p.cols();
+    CHECK_GE(param_.workspace, required_size)
+      << "\nMinimum workspace size: " << required_size * sizeof(DType) << " Bytes\n"
+      << "Given: " << param_.workspace * sizeof(DType);
+    return ctx.requested[deconv::kTempSpace].get_space_typed<xpu, 2, DType>(
+        mshadow::Shape2(p.rows(), p.cols()), ctx.get_stream<xpu>());
+  }
+
   inline index_t InitTemp(const mshadow::Shape<4> &ishape,
                           const mshadow::Shape<4> &oshape) {
     const int ksize_y = param_.kernel[0];
@@ -354,6 +506,40 @@ class DeconvolutionProp : public OperatorProperty {
     }
     const TShape &dshape = (*in_shape)[deconv::kData];
     if (dshape.ndim() ==  0) return false;
+    CHECK_EQ(dshape[1] % param_.num_group, 0) \
+        << "input num_filter must divide group size";
+    CHECK_EQ(param_.num_filter % param_.num_group, 0) \
+        << "output num_filter must divide group size";
+    if (param_.kernel.ndim() == 3) {
+      // 3d deconv
+      CHECK_EQ(dshape.ndim(), 5) \
+          << "Input data should be 5D in batch-num_filter-depth-y-x";
+      SHAPE_ASSIGN_CHECK(*in_shape,
+                         deconv::kWeight,
+                         Shape5(dshape[1], param_.num_filter / param_.num_group,
+                                param_.kernel[0], param_.kernel[1], param_.kernel[2]));
+      if (!param_.no_bias) {
+        SHAPE_ASSIGN_CHECK(*in_shape, deconv::kBias, Shape1(param_.num_filter));
+      }
+      CHECK_EQ(param_.stride.ndim(), 3) << "incorrect stride size: " << param_.stride;
+      TShape pad, adj;
+      param_.InferPad(dshape, &pad, &adj);
+      TShape oshape = dshape;
+      oshape[1] = param_.num_filter;
+      for (index_t i = 0; i < 3; ++i) {
+        CHECK_GE(param_.kernel[i] - 1, adj[i]) << "adj must be samller than kernel";
+        // osize = stride * (isize - 1) + ksize - 2 * pad + adj
+        oshape[i + 2] = param_.stride[i] * (dshape[i + 2] - 1) +
+            param_.kernel[i] - 2 * pad[i] + adj[i];
+        if (i < param_.target_shape.ndim() && param_.target_shape[i] > 0) {
+          CHECK_EQ(param_.target_shape[i], oshape[i + 2]) \
+              << "param_.target_shape was not reasonable, pelase set it carefully";
+        }
+      }
+      out_shape->clear();
+      out_shape->push_back(oshape);
+      return true;
+    }
     CHECK_EQ(dshape.ndim(), 4) \
         << "Input data should be 4D in batch-num_filter-y-x";
     SHAPE_ASSIGN_CHECK(*in_shape,
@@ -370,10 +556,6 @@ class DeconvolutionProp : public OperatorProperty {
     const index_t ksize_x = static_cast<index_t>(param_.kernel[1]);
     index_t pad_y, pad_x, adj_y, adj_x;
     param_.InferPad(dshape[2], dshape[3], &pad_y, &pad_x, &adj_y, &adj_x);
-    CHECK_EQ(dshape[1] % param_.num_group, 0) \
-        << "input num_filter must divide group size";
-    CHECK_EQ(param_.num_filter % param_.num_group, 0) \
-        << "output num_filter must divide group size";
     CHECK_GT(param_.kernel.Size(), 0) \
         << "incorrect kernel size: " << param_.kernel;
     CHECK_GT(param_.stride.Size(), 0) \
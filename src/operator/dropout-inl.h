@@ -10,12 +10,14 @@
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
 #include <mxnet/operator.h>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <string>
 #include <utility>
 #include "./operator_common.h"
 #include "./mshadow_op.h"
+#include "../common/philox.h"
 
 namespace dropout {
 enum DropoutOpInputs {kData};
@@ -28,18 +30,96 @@ namespace op {
 
 struct DropoutParam : public dmlc::Parameter<DropoutParam> {
   float p;
+  bool regenerate_mask;
   DMLC_DECLARE_PARAMETER(DropoutParam) {
     DMLC_DECLARE_FIELD(p).set_default(0.5)
     .set_range(0, 1)
     .describe("Fraction of the input that gets dropped out at training time");
+    DMLC_DECLARE_FIELD(regenerate_mask).set_default(true)
+    .describe("Whether to keep only the random state of the mask and generate "
+              "the mask again in the backward, instead of keeping the whole mask.");
   }
 };  // struct DropoutParam
 
+/*! \brief number of elements of the mask output holding the random state */
+const index_t kDropoutStateSize =
+    (sizeof(ParallelRandomState) + sizeof(real_t) - 1) / sizeof(real_t);
+
+/*!
+ * \brief the elements [4 * i, 4 * i + 4) of the output, scaled by the mask
+ *  generated from the counter of the block. The mask is also written if not NULL.
+ */
+MSHADOW_XINLINE void DropoutBlock(real_t *out, real_t *mask, const real_t *data,
+                                  index_t size, index_t i, const ParallelRandomState &state,
+                                  real_t pkeep, bool addto) {
+  using common::random::kPhiloxWidth;
+  uint32_t bits[kPhiloxWidth];
+  common::random::Philox(state.key[0], state.key[1], state.counter + i, state.stream, bits);
+  const index_t begin = i * kPhiloxWidth;
+  for (index_t k = 0; k < kPhiloxWidth && begin + k < size; ++k) {
+    // the same mask as thresholding common::random::SampleUniform(0, 1)
+    const real_t keep = 1.0f - common::random::ToUniform(bits[k]) < pkeep ? 1.0f / pkeep : 0.0f;
+    if (mask != NULL) mask[begin + k] = keep;
+    out[begin + k] = (addto ? out[begin + k] : 0.0f) + data[begin + k] * keep;
+  }
+}
+
+/*!
+ * \brief out = req(out, data * mask) in a single pass
+ * \param state the random state of the mask, or the one at load if not NULL
+ * \param store where to also keep the random state, or NULL
+ */
+inline void DropoutLaunch(mshadow::Stream<cpu> *s, real_t *out, real_t *mask,
+                          const real_t *data, index_t size, const ParallelRandomState &state,
+                          const ParallelRandomState *load, ParallelRandomState *store,
+                          real_t pkeep, bool addto) {
+  const ParallelRandomState st = load != NULL ? *load : state;
+  if (store != NULL) *store = st;
+  const int nblock = static_cast<int>(
+      (size + common::random::kPhiloxWidth - 1) / common::random::kPhiloxWidth);
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < nblock; ++i) {
+    DropoutBlock(out, mask, data, size, i, st, pkeep, addto);
+  }
+}
+
+#ifdef __CUDACC__
+__global__ void DropoutKernel(real_t *out, real_t *mask, const real_t *data, index_t size,
+                              index_t nblock, ParallelRandomState state,
+                              const ParallelRandomState *load, ParallelRandomState *store,
+                              real_t pkeep, bool addto) {
+  const ParallelRandomState st = load != NULL ? *load : state;
+  if (store != NULL && blockIdx.x == 0 && threadIdx.x == 0) *store = st;
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < nblock;
+       i += blockDim.x * gridDim.x) {
+    DropoutBlock(out, mask, data, size, i, st, pkeep, addto);
+  }
+}
+
+/*! \brief the gpu version, load and store point to the device */
+inline void DropoutLaunch(mshadow::Stream<gpu> *s, real_t *out, real_t *mask,
+                          const real_t *data, index_t size, const ParallelRandomState &state,
+                          const ParallelRandomState *load, ParallelRandomState *store,
+                          real_t pkeep, bool addto) {
+  using namespace mshadow::cuda;
+  const index_t nblock = (size + common::random::kPhiloxWidth - 1) /
+      common::random::kPhiloxWidth;
+  if (nblock == 0) return;
+  const int grid = static_cast<int>(std::min<index_t>(
+      kMaxGridNum, (nblock + kBaseThreadNum - 1) / kBaseThreadNum));
+  DropoutKernel<<<grid, kBaseThreadNum, 0, mshadow::Stream<gpu>::GetStream(s)>>>(
+      out, mask, data, size, nblock, state, load, store, pkeep, addto);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+
 template<typename xpu>
 class DropoutOp : public Operator {
  public:
   explicit DropoutOp(DropoutParam param) {
     this->pkeep_ = 1.0f - param.p;
+    this->regenerate_mask_ = param.regenerate_mask;
   }
 
   virtual void Forward(const OpContext &ctx,
@@ -57,10 +137,15 @@ class DropoutOp : public Operator {
     Tensor<xpu, 2> data = in_data[dropout::kData].FlatTo2D<xpu, real_t>(s);
     Tensor<xpu, 2> out = out_data[dropout::kOut].FlatTo2D<xpu, real_t>(s);
     if (ctx.is_train) {
-      Tensor<xpu, 2> mask = out_data[dropout::kMask].FlatTo2D<xpu, real_t>(s);
-      Random<xpu> *prnd = ctx.requested[dropout::kRandom].get_random<xpu, real_t>(s);
-      mask = F<mshadow_op::threshold>(prnd->uniform(mask.shape_), pkeep_) * (1.0f / pkeep_);
-      Assign(out, req[dropout::kOut], data * mask);
+      if (req[dropout::kOut] == kNullOp) return;
+      real_t *mask = out_data[dropout::kMask].dptr<real_t>();
+      ParallelRandomState *prnd = ctx.requested[dropout::kRandom].get_parallel_random();
+      const index_t size = data.shape_.Size();
+      DropoutLaunch(s, out.dptr_, regenerate_mask_ ? NULL : mask, data.dptr_, size,
+                    *prnd, NULL,
+                    regenerate_mask_ ? reinterpret_cast<ParallelRandomState*>(mask) : NULL,
+                    pkeep_, req[dropout::kOut] == kAddTo);
+      prnd->counter += (size + common::random::kPhiloxWidth - 1) / common::random::kPhiloxWidth;
     } else {
       Assign(out, req[dropout::kOut], F<mshadow_op::identity>(data));
     }
@@ -79,13 +164,24 @@ class DropoutOp : public Operator {
     CHECK_EQ(in_grad.size(), 1);
     Stream<xpu> *s = ctx.get_stream<xpu>();
     Tensor<xpu, 2> grad = out_grad[dropout::kOut].FlatTo2D<xpu, real_t>(s);
-    Tensor<xpu, 2> mask = out_data[dropout::kMask].FlatTo2D<xpu, real_t>(s);
     Tensor<xpu, 2> gdata = in_grad[dropout::kData].FlatTo2D<xpu, real_t>(s);
-    Assign(gdata, req[dropout::kData], grad * mask);
+    if (regenerate_mask_) {
+      if (req[dropout::kData] == kNullOp) return;
+      const ParallelRandomState *state = reinterpret_cast<const ParallelRandomState*>(
+          out_data[dropout::kMask].dptr<real_t>());
+      DropoutLaunch(s, gdata.dptr_, NULL, grad.dptr_, grad.shape_.Size(),
+                    ParallelRandomState(), state, NULL,
+                    pkeep_, req[dropout::kData] == kAddTo);
+    } else {
+      Tensor<xpu, 2> mask = out_data[dropout::kMask].FlatTo2D<xpu, real_t>(s);
+      Assign(gdata, req[dropout::kData], grad * mask);
+    }
   }
 
  private:
   real_t pkeep_;
+  /*! \brief whether the mask output only keeps the random state */
+  bool regenerate_mask_;
 };  // class DropoutOp
 
 
@@ -112,7 +208,11 @@ class DropoutProp : public OperatorProperty {
     if (dshape.ndim() == 0) return false;
     out_shape->clear();
     out_shape->push_back(dshape);
-    out_shape->push_back(dshape);
+    if (param_.regenerate_mask) {
+      out_shape->push_back(Shape1(kDropoutStateSize));
+    } else {
+      out_shape->push_back(dshape);
+    }
     return true;
   }
 
@@ -149,7 +249,7 @@ class DropoutProp : public OperatorProperty {
 
   std::vector<ResourceRequest> ForwardResource(
     const std::vector<TShape> &in_shape) const override {
-    return {ResourceRequest::kRandom};
+    return {ResourceRequest::kParallelRandom};
   }
 
   int NumVisibleOutputs() const override {
@@ -42,6 +42,7 @@
 #include <vector>
 #include "./mshadow_op.h"
 #include "./broadcast_reduce_op_common.h"
+#include "./broadcast_reduce_kernel-inl.h"
 
 #if defined(__CUDACC__)
 #define XPU gpu
@@ -156,40 +157,7 @@ void BinaryBroadcastForward_(const TBlob& lhs,
     });
     return;
   }
-  bool do_opt;
-  TShape lhs_new_shape_, rhs_new_shape_, out_new_shape_;
-  InferBroadcastNewShapes_(&do_opt, &lhs_new_shape_, &rhs_new_shape_, &out_new_shape_,
-    lhs.shape_, rhs.shape_, ret->shape_);
-  MSHADOW_TYPE_SWITCH(ret->type_flag_, DType, {
-    if (do_opt) {
-      Shape<3> lhs_new_shape, rhs_new_shape, out_new_shape;
-      for (index_t i = 0; i < 3; i++) {
-        lhs_new_shape[i] = lhs_new_shape_[i];
-        rhs_new_shape[i] = rhs_new_shape_[i];
-        out_new_shape[i] = out_new_shape_[i];
-      }
-      Tensor<xpu, 3, DType> out = ret->get_with_shape<xpu, 3, DType>(out_new_shape, s);
-      Tensor<xpu, 3, DType> mlhs = lhs.get_with_shape<xpu, 3, DType>(lhs_new_shape, s);
-      Tensor<xpu, 3, DType> mrhs = rhs.get_with_shape<xpu, 3, DType>(rhs_new_shape, s);
-      ASSIGN_DISPATCH(out, req,
-        F<OP>(broadcast_to(mlhs, out_new_shape_), broadcast_to(mrhs, out_new_shape_)));
-    } else {
-      Shape<MXNET_SPECIAL_MAX_NDIM> lhs_new_shape, rhs_new_shape, out_new_shape;
-      for (index_t i = 0; i < MXNET_SPECIAL_MAX_NDIM; i++) {
-        lhs_new_shape[i] = lhs_new_shape_[i];
-        rhs_new_shape[i] = rhs_new_shape_[i];
-        out_new_shape[i] = out_new_shape_[i];
-      }
-      Tensor<xpu, MXNET_SPECIAL_MAX_NDIM, DType> out =
-        ret->get_with_shape<xpu, MXNET_SPECIAL_MAX_NDIM, DType>(out_new_shape, s);
-      Tensor<xpu, MXNET_SPECIAL_MAX_NDIM, DType> mlhs =
-        lhs.get_with_shape<xpu, MXNET_SPECIAL_MAX_NDIM, DType>(lhs_new_shape, s);
-      Tensor<xpu, MXNET_SPECIAL_MAX_NDIM, DType> mrhs =
-        rhs.get_with_shape<xpu, MXNET_SPECIAL_MAX_NDIM, DType>(rhs_new_shape, s);
-      ASSIGN_DISPATCH(out, req,
-        F<OP>(broadcast_to(mlhs, out_new_shape_), broadcast_to(mrhs, out_new_shape_)));
-    }
-  });
+  broadcast::BinaryBroadcastCompute<xpu, OP>(s, lhs, rhs, *ret, req);
 }
 
 template<typename xpu, typename LHS_OP, typename RHS_OP>
@@ -221,39 +189,10 @@ void BinaryBroadcastBackward_(const OutputGrad& out_grad,
       });
     return;
   }
-  bool do_opt;
-  TShape lhs_new_shape_, rhs_new_shape_, out_new_shape_;
-  InferBroadcastNewShapes_(&do_opt, &lhs_new_shape_, &rhs_new_shape_, &out_new_shape_,
-    lhs_grad->shape_, rhs_grad->shape_, out_grad.data.shape_);
-  MSHADOW_REAL_TYPE_SWITCH(lhs_grad->type_flag_, DType, {
-    if (do_opt) {
-      Shape<3> out_new_shape;
-      for (index_t i = 0; i < 3; i++) {
-        out_new_shape[i] = out_new_shape_[i];
-      }
-      Tensor<xpu, 3, DType> mout_grad =
-        out_grad.data.get_with_shape<xpu, 3, DType>(out_new_shape, s);
-      Tensor<xpu, 1, DType> mlhs_grad =
-        lhs_grad->get_with_shape<xpu, 1, DType>(Shape1(lhs_grad->Size()), s);
-      Tensor<xpu, 1, DType> mrhs_grad =
-        rhs_grad->get_with_shape<xpu, 1, DType>(Shape1(rhs_grad->Size()), s);
-      ReduceToAssign<red::sum>(mlhs_grad, req_lhs_grad, lhs_new_shape_, F<LHS_OP>(mout_grad));
-      ReduceToAssign<red::sum>(mrhs_grad, req_rhs_grad, rhs_new_shape_, F<RHS_OP>(mout_grad));
-    } else {
-      Shape<MXNET_SPECIAL_MAX_NDIM> out_new_shape;
-      for (index_t i = 0; i < MXNET_SPECIAL_MAX_NDIM; i++) {
-        out_new_shape[i] = out_new_shape_[i];
-      }
-      Tensor<xpu, MXNET_SPECIAL_MAX_NDIM, DType> mout_grad =
-        out_grad.data.get_with_shape<xpu, MXNET_SPECIAL_MAX_NDIM, DType>(out_new_shape, s);
-      Tensor<xpu, 1, DType> mlhs_grad =
-        lhs_grad->get_with_shape<xpu, 1, DType>(Shape1(lhs_grad->Size()), s);
-      Tensor<xpu, 1, DType> mrhs_grad =
-        rhs_grad->get_with_shape<xpu, 1, DType>(Shape1(rhs_grad->Size()), s);
-      ReduceToAssign<red::sum>(mlhs_grad, req_lhs_grad, lhs_new_shape_, F<LHS_OP>(mout_grad));
-      ReduceToAssign<red::sum>(mrhs_grad, req_rhs_grad, rhs_new_shape_, F<RHS_OP>(mout_grad));
-    }
-  });
+  broadcast::ReduceCompute<xpu, red::sum, LHS_OP>(
+      s, out_grad.data, lhs_grad->shape_, *lhs_grad, req_lhs_grad);
+  broadcast::ReduceCompute<xpu, red::sum, RHS_OP>(
+      s, out_grad.data, rhs_grad->shape_, *rhs_grad, req_rhs_grad);
 }
 
 template<typename xpu>
@@ -282,55 +221,10 @@ void BroadcastMulBackward_(const OutputGrad& out_grad,
     });
     return;
   }
-  bool do_opt;
-  TShape lhs_new_shape_, rhs_new_shape_, out_new_shape_;
-  InferBroadcastNewShapes_(&do_opt, &lhs_new_shape_, &rhs_new_shape_, &out_new_shape_,
-    lhs_grad->shape_, rhs_grad->shape_, out_grad.data.shape_);
-  MSHADOW_REAL_TYPE_SWITCH(lhs_grad->type_flag_, DType, {
-    if (do_opt) {
-      Shape<3> lhs_new_shape, rhs_new_shape, out_new_shape;
-      for (index_t i = 0; i < 3; i++) {
-        lhs_new_shape[i] = lhs_new_shape_[i];
-        rhs_new_shape[i] = rhs_new_shape_[i];
-        out_new_shape[i] = out_new_shape_[i];
-      }
-      mshadow::Tensor<xpu, 3, DType> mout_grad =
-        out_grad.data.get_with_shape<xpu, 3, DType>(out_new_shape, s);
-      mshadow::Tensor<xpu, 3, DType> mlhs_data =
-        lhs.data.get_with_shape<xpu, 3, DType>(lhs_new_shape, s);
-      mshadow::Tensor<xpu, 3, DType> mrhs_data =
-        rhs.data.get_with_shape<xpu, 3, DType>(rhs_new_shape, s);
-      mshadow::Tensor<xpu, 1, DType> mlhs_grad =
-        lhs_grad->get_with_shape<xpu, 1, DType>(Shape1(lhs_grad->Size()), s);
-      mshadow::Tensor<xpu, 1, DType> mrhs_grad =
-        rhs_grad->get_with_shape<xpu, 1, DType>(Shape1(rhs_grad->Size()), s);
-      ReduceToAssign<red::sum>(mrhs_grad, req_rhs_grad, rhs_new_shape_,
-        broadcast_to(mlhs_data, out_new_shape_) * mout_grad);
-      ReduceToAssign<red::sum>(mlhs_grad, req_lhs_grad, lhs_new_shape_,
-        broadcast_to(mrhs_data, out_new_shape_) * mout_grad);
-    } else {
-      Shape<MXNET_SPECIAL_MAX_NDIM> lhs_new_shape, rhs_new_shape, out_new_shape;
-      for (index_t i = 0; i < MXNET_SPECIAL_MAX_NDIM; i++) {
-        lhs_new_shape[i] = lhs_new_shape_[i];
-        rhs_new_shape[i] = rhs_new_shape_[i];
-        out_new_shape[i] = out_new_shape_[i];
-      }
-      mshadow::Tensor<xpu, MXNET_SPECIAL_MAX_NDIM, DType> mout_grad =
-        out_grad.data.get_with_shape<xpu, MXNET_SPECIAL_MAX_NDIM, DType>(out_new_shape, s);
-      mshadow::Tensor<xpu, MXNET_SPECIAL_MAX_NDIM, DType> mlhs_data =
-        lhs.data.get_with_shape<xpu, MXNET_SPECIAL_MAX_NDIM, DType>(lhs_new_shape, s);
-      mshadow::Tensor<xpu, MXNET_SPECIAL_MAX_NDIM, DType> mrhs_data =
-        rhs.data.get_with_shape<xpu, MXNET_SPECIAL_MAX_NDIM, DType>(rhs_new_shape, s);
-      mshadow::Tensor<xpu, 1, DType> mlhs_grad =
-        lhs_grad->get_with_shape<xpu, 1, DType>(Shape1(lhs_grad->Size()), s);
-      mshadow::Tensor<xpu, 1, DType> mrhs_grad =
-        rhs_grad->get_with_shape<xpu, 1, DType>(Shape1(rhs_grad->Size()), s);
-      ReduceToAssign<red::sum>(mrhs_grad, req_rhs_grad, rhs_new_shape_,
-        broadcast_to(mlhs_data, out_new_shape_) * mout_grad);
-      ReduceToAssign<red::sum>(mlhs_grad, req_lhs_grad, lhs_new_shape_,
-        broadcast_to(mrhs_data, out_new_shape_) * mout_grad);
-    }
-  });
+  broadcast::BinaryReduceCompute<xpu, red::sum, mshadow::op::mul>(
+      s, out_grad.data, lhs.data, rhs_grad->shape_, *rhs_grad, req_rhs_grad);
+  broadcast::BinaryReduceCompute<xpu, red::sum, mshadow::op::mul>(
+      s, out_grad.data, rhs.data, lhs_grad->shape_, *lhs_grad, req_lhs_grad);
 }
 
 template<typename xpu>
@@ -183,6 +183,7 @@ MXNET_REGISTER_SIMPLE_OP(_plus_scalar, XPU)
 .set_enable_scalar(true, kArrayBeforeScalar)
 .set_function(XPU::kDevMask,
               BinaryScalarLForward_<XPU, mshadow::op::plus>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask,
               BinaryScalarBackwardT0_<XPU, mshadow_op::identity>, kInplaceOutIn);
 
@@ -191,6 +192,7 @@ MXNET_REGISTER_SIMPLE_OP(_minus_scalar, XPU)
 .set_enable_scalar(true, kArrayBeforeScalar)
 .set_function(XPU::kDevMask,
               BinaryScalarLForward_<XPU, mshadow::op::minus>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask,
               BinaryScalarBackwardT0_<XPU, mshadow_op::identity>, kInplaceOutIn);
 
@@ -199,6 +201,7 @@ MXNET_REGISTER_SIMPLE_OP(_rminus_scalar, XPU)
 .set_enable_scalar(true, kArrayBeforeScalar)
 .set_function(XPU::kDevMask,
               BinaryScalarRForward_<XPU, mshadow::op::minus>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask,
               BinaryScalarBackwardT0_<XPU, mshadow_op::negation>, kInplaceOutIn);
 
@@ -207,6 +210,7 @@ MXNET_REGISTER_SIMPLE_OP(_mul_scalar, XPU)
 .set_enable_scalar(true, kArrayBeforeScalar)
 .set_function(XPU::kDevMask,
               BinaryScalarLForward_<XPU, mshadow::op::mul>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask,
               BinaryScalarBackwardT1_<XPU, mshadow::op::mul>, kInplaceOutIn);
 
@@ -215,6 +219,7 @@ MXNET_REGISTER_SIMPLE_OP(_div_scalar, XPU)
 .set_enable_scalar(true, kArrayBeforeScalar)
 .set_function(XPU::kDevMask,
               BinaryScalarLForward_<XPU, mshadow::op::div>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask,
               BinaryScalarBackwardT1_<XPU, mshadow::op::div>, kInplaceOutIn);
 
@@ -223,6 +228,7 @@ MXNET_REGISTER_SIMPLE_OP(_rdiv_scalar, XPU)
 .set_enable_scalar(true, kArrayBeforeScalar)
 .set_function(XPU::kDevMask,
               BinaryScalarRForward_<XPU, mshadow::op::div>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask, DivRBackward_<XPU>, kInplaceOutIn);
 
 
@@ -231,6 +237,7 @@ MXNET_REGISTER_SIMPLE_OP(_maximum_scalar, XPU)
 .set_enable_scalar(true, kArrayBeforeScalar)
 .set_function(XPU::kDevMask,
               BinaryScalarLForward_<XPU, mshadow_op::maximum>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask,
               BinaryScalarBackwardT2_<XPU, mshadow_op::maximum_grad>, kInplaceOutIn);
 
@@ -239,6 +246,7 @@ MXNET_REGISTER_SIMPLE_OP(_minimum_scalar, XPU)
 .set_enable_scalar(true, kArrayBeforeScalar)
 .set_function(XPU::kDevMask,
               BinaryScalarLForward_<XPU, mshadow_op::minimum>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask,
               BinaryScalarBackwardT2_<XPU, mshadow_op::minimum_grad>, kInplaceOutIn);
 
@@ -247,6 +255,7 @@ MXNET_REGISTER_SIMPLE_OP(_power_scalar, XPU)
 .set_enable_scalar(true, kArrayBeforeScalar)
 .set_function(XPU::kDevMask,
               BinaryScalarLForward_<XPU, mshadow_op::power>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask,
               PowerLBackward_<XPU>, kInplaceOutIn);
 
@@ -255,6 +264,7 @@ MXNET_REGISTER_SIMPLE_OP(_rpower_scalar, XPU)
 .set_enable_scalar(true, kArrayBeforeScalar)
 .set_function(XPU::kDevMask,
               BinaryScalarRForward_<XPU, mshadow_op::power>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask,
               PowerRBackward_<XPU>, kInplaceOutIn);
 }  // namespace op
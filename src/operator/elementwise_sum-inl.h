@@ -10,6 +10,8 @@
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
 #include <mxnet/operator.h>
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <map>
 #include <string>
@@ -34,6 +36,124 @@ struct ElementWiseSumParam : public dmlc::Parameter<ElementWiseSumParam> {
   }
 };
 
+/*! \brief number of elements summed together by a cpu thread */
+const index_t kSumBlock = 1024;
+/*! \brief maximum number of inputs summed by one gpu kernel */
+const int kMaxSumInputs = 32;
+
+/*! \brief type of the accumulator of the sum, fp16 is summed in float */
+template<typename DType>
+struct SumAccType {
+  typedef DType type;
+};
+template<>
+struct SumAccType<mshadow::half::half_t> {
+  typedef float type;
+};
+
+/*!
+ * \brief out = req(out, sum(in)) in one read pass of the inputs,
+ *  out may be the first input when inplace
+ */
+template<typename DType>
+inline void ElementWiseSumLaunch(mshadow::Stream<cpu> *s, DType *out,
+                                 const std::vector<const DType*> &in,
+                                 index_t size, bool addto) {
+  typedef typename SumAccType<DType>::type AType;
+  const int nblock = static_cast<int>((size + kSumBlock - 1) / kSumBlock);
+  #pragma omp parallel for schedule(static)
+  for (int b = 0; b < nblock; ++b) {
+    const index_t begin = b * kSumBlock;
+    const index_t len = std::min(kSumBlock, size - begin);
+    AType acc[kSumBlock];
+    for (index_t i = 0; i < len; ++i) {
+      acc[i] = addto ? static_cast<AType>(out[begin + i]) : AType(0);
+    }
+    for (size_t k = 0; k < in.size(); ++k) {
+      const DType *x = in[k] + begin;
+      for (index_t i = 0; i < len; ++i) acc[i] += static_cast<AType>(x[i]);
+    }
+    for (index_t i = 0; i < len; ++i) out[begin + i] = DType(acc[i]);
+  }
+}
+
+#ifdef __CUDACC__
+/*! \brief the input pointers of a kernel, passed by value */
+template<typename DType>
+struct ElementWiseSumInputs {
+  int n;
+  const DType *ptr[kMaxSumInputs];
+};
+
+/*! \brief kVec elements loaded and stored in one vector access */
+template<typename DType, int kVec>
+struct __align__(sizeof(DType) * kVec) ElementWiseSumPack {
+  DType v[kVec];
+};
+
+template<typename DType, int kVec>
+__global__ void ElementWiseSumKernel(DType *out, ElementWiseSumInputs<DType> in,
+                                     index_t size, bool addto) {
+  typedef typename SumAccType<DType>::type AType;
+  typedef ElementWiseSumPack<DType, kVec> Pack;
+  const index_t nvec = size / kVec;
+  const index_t step = blockDim.x * gridDim.x;
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < nvec; i += step) {
+    AType acc[kVec];
+    Pack p;
+    if (addto) p = reinterpret_cast<const Pack*>(out)[i];
+    #pragma unroll
+    for (int j = 0; j < kVec; ++j) acc[j] = addto ? static_cast<AType>(p.v[j]) : AType(0);
+    for (int k = 0; k < in.n; ++k) {
+      const Pack x = reinterpret_cast<const Pack*>(in.ptr[k])[i];
+      #pragma unroll
+      for (int j = 0; j < kVec; ++j) acc[j] += static_cast<AType>(x.v[j]);
+    }
+    #pragma unroll
+    for (int j = 0; j < kVec; ++j) p.v[j] = DType(acc[j]);
+    reinterpret_cast<Pack*>(out)[i] = p;
+  }
+  for (index_t i = nvec * kVec + blockIdx.x * blockDim.x + threadIdx.x; i < size; i += step) {
+    AType acc = addto ? static_cast<AType>(out[i]) : AType(0);
+    for (int k = 0; k < in.n; ++k) acc += static_cast<AType>(in.ptr[k][i]);
+    out[i] = DType(acc);
+  }
+}
+
+/*! \brief the gpu version, vector accesses of 16 bytes when all the pointers are aligned */
+template<typename DType>
+inline void ElementWiseSumLaunch(mshadow::Stream<gpu> *s, DType *out,
+                                 const std::vector<const DType*> &in,
+                                 index_t size, bool addto) {
+  using namespace mshadow::cuda;
+  const int kVec = 16 / sizeof(DType);
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  for (size_t begin = 0; begin < in.size(); begin += kMaxSumInputs) {
+    ElementWiseSumInputs<DType> chunk;
+    chunk.n = static_cast<int>(std::min(in.size() - begin, static_cast<size_t>(kMaxSumInputs)));
+    bool aligned = reinterpret_cast<uintptr_t>(out) % 16 == 0;
+    for (int k = 0; k < chunk.n; ++k) {
+      chunk.ptr[k] = in[begin + k];
+      aligned = aligned && reinterpret_cast<uintptr_t>(chunk.ptr[k]) % 16 == 0;
+    }
+    // the following chunks add to the sum of the previous ones
+    const bool chunk_addto = addto || begin != 0;
+    const index_t nthread = aligned ? (size + kVec - 1) / kVec : size;
+    const int grid = static_cast<int>(std::min<index_t>(
+        kMaxGridNum, (nthread + kBaseThreadNum - 1) / kBaseThreadNum));
+    if (aligned) {
+      ElementWiseSumKernel<DType, kVec><<<grid, kBaseThreadNum, 0, stream>>>(
+          out, chunk, size, chunk_addto);
+    } else {
+      ElementWiseSumKernel<DType, 1><<<grid, kBaseThreadNum, 0, stream>>>(
+          out, chunk, size, chunk_addto);
+    }
+    cudaError_t err = cudaPeekAtLastError();
+    CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+  }
+}
+#endif  // __CUDACC__
+
 template<typename xpu, typename DType>
 class ElementWiseSumOp : public Operator {
  public:
@@ -52,38 +172,15 @@ class ElementWiseSumOp : public Operator {
     if (req[elemsum::kOut] == kNullOp) return;
 
     Stream<xpu> *s = ctx.get_stream<xpu>();
-    Tensor<xpu, 2, DType> out = out_data[elemsum::kOut].FlatTo2D<xpu, DType>(s);
-    switch (size_) {
-      case 2: {
-        Tensor<xpu, 2, DType> in_0 = in_data[elemsum::kData0].FlatTo2D<xpu, DType>(s);
-        Tensor<xpu, 2, DType> in_1 = in_data[elemsum::kData1].FlatTo2D<xpu, DType>(s);
-        Assign(out, req[elemsum::kOut], in_0 + in_1);
-        break;
-      }
-      case 3: {
-        Tensor<xpu, 2, DType> in_0 = in_data[elemsum::kData0].FlatTo2D<xpu, DType>(s);
-        Tensor<xpu, 2, DType> in_1 = in_data[elemsum::kData1].FlatTo2D<xpu, DType>(s);
-        Tensor<xpu, 2, DType> in_2 = in_data[elemsum::kData2].FlatTo2D<xpu, DType>(s);
-        Assign(out, req[elemsum::kOut], in_0 + in_1 + in_2);
-        break;
-      }
-      case 4: {
-        Tensor<xpu, 2, DType> in_0 = in_data[elemsum::kData0].FlatTo2D<xpu, DType>(s);
-        Tensor<xpu, 2, DType> in_1 = in_data[elemsum::kData1].FlatTo2D<xpu, DType>(s);
-        Tensor<xpu, 2, DType> in_2 = in_data[elemsum::kData2].FlatTo2D<xpu, DType>(s);
-        Tensor<xpu, 2, DType> in_3 = in_data[elemsum::kData3].FlatTo2D<xpu, DType>(s);
-        Assign(out, req[elemsum::kOut], in_0 + in_1 + in_2 + in_3);
-        break;
-      }
-      default: {
-        Tensor<xpu, 2, DType> in_0 = in_data[elemsum::kData0].FlatTo2D<xpu, DType>(s);
-        Assign(out, req[elemsum::kOut], F<mshadow_op::identity>(in_0));
-        for (int i = 1; i < size_; ++i) {
-          out += in_data[i].FlatTo2D<xpu, DType>(s);
-        }
-        break;
-      }
+    const TBlob &out = out_data[elemsum::kOut];
+    std::vector<const DType*> in(size_);
+    for (int i = 0; i < size_; ++i) {
+      CHECK_EQ(in_data[i].Size(), out.Size());
+      in[i] = static_cast<const DType*>(in_data[i].dptr_);
     }
+    if (out.Size() == 0) return;
+    ElementWiseSumLaunch(s, static_cast<DType*>(out.dptr_), in, out.Size(),
+                         req[elemsum::kOut] == kAddTo);
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -224,6 +321,10 @@ class ElementWiseSumProp : public OperatorProperty {
     return {{in_data[0], out_data[0]}};
   }
 
+  std::vector<int> ListCPULayouts(const std::vector<TShape> &in_shape) const override {
+    return {kLayoutAny};
+  }
+
   Operator* CreateOperator(Context ctx) const override {
     LOG(FATAL) << "Not Implemented";
     return NULL;
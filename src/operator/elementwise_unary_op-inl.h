@@ -8,6 +8,7 @@
 
 #include <mxnet/operator_util.h>
 #include "./mshadow_op.h"
+#include "./mshadow_op_simd.h"
 
 #if defined(__CUDACC__)
 #define XPU gpu
@@ -31,7 +32,7 @@ void UnaryForward_(const TBlob& src,
     << "Unary function only support input/output with the same type";
   MSHADOW_TYPE_SWITCH(ret->type_flag_, DType, {
     mshadow::Tensor<xpu, 2, DType> out = ret->FlatTo2D<xpu, DType>(s);
-    ASSIGN_DISPATCH(out, req, F<OP>(src.FlatTo2D<xpu, DType>(s)));
+    mshadow_op::simd::MapExp<OP>(out, req, src.FlatTo2D<xpu, DType>(s));
   });
 }
 
@@ -83,59 +84,71 @@ void UnaryBackwardUseOut_(const OutputGrad& out_grad,
 
 MXNET_REGISTER_SIMPLE_OP(abs, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::abs>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask, UnaryBackwardUseIn_<XPU, mshadow_op::sign>, kInplaceOutIn)
 .describe("Take absolute value of the src");
 // sign
 MXNET_REGISTER_SIMPLE_OP(sign, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::sign>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask, UnaryBackwardUseIn_<XPU, mshadow_op::sign_grad>, kInplaceOutIn)
 .describe("Take sign value of the src");
 // round
 MXNET_REGISTER_SIMPLE_OP(round, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::round>, kInplaceInOut)
+.set_accept_strided(true)
 .describe("Take round value of the src");
 // ceil
 MXNET_REGISTER_SIMPLE_OP(ceil, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::ceil>, kInplaceInOut)
+.set_accept_strided(true)
 .describe("Take ceil value of the src");
 // floor
 MXNET_REGISTER_SIMPLE_OP(floor, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::floor>, kInplaceInOut)
+.set_accept_strided(true)
 .describe("Take floor value of the src");
 // square
 MXNET_REGISTER_SIMPLE_OP(square, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::square>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask, UnaryBackwardUseIn_<XPU, mshadow_op::square_grad>, kInplaceOutIn)
 .describe("Take square of the src");
 // sqrt
 MXNET_REGISTER_SIMPLE_OP(sqrt, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::square_root>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask, UnaryBackwardUseOut_<XPU, mshadow_op::square_root_grad>, kInplaceOutIn)
 .describe("Take sqrt of the src");
 // rsqrt
 MXNET_REGISTER_SIMPLE_OP(rsqrt, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::reciprocal_square_root>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask,
               UnaryBackwardUseIn_<XPU, mshadow_op::reciprocal_square_root_grad>, kInplaceOutIn)
 .describe("Take rsqrt of the src");
 // exp
 MXNET_REGISTER_SIMPLE_OP(exp, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::exp>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask, UnaryBackwardUseOut_<XPU, mshadow_op::identity>, kInplaceOutIn)
 .describe("Take exp of the src");
 // log
 MXNET_REGISTER_SIMPLE_OP(log, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::log>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask, UnaryBackwardUseIn_<XPU, mshadow_op::log_grad>, kInplaceOutIn)
 .describe("Take log of the src");
 // cos
 MXNET_REGISTER_SIMPLE_OP(cos, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::cos>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask, UnaryBackwardUseIn_<XPU, mshadow_op::cos_grad>, kInplaceOutIn)
 .describe("Take cos of the src");
 // sin
 MXNET_REGISTER_SIMPLE_OP(sin, XPU)
 .set_function(XPU::kDevMask, UnaryForward_<XPU, mshadow_op::sin>, kInplaceInOut)
+.set_accept_strided(true)
 .set_gradient(XPU::kDevMask, UnaryBackwardUseIn_<XPU, mshadow_op::sin_grad>, kInplaceOutIn)
 .describe("Take sin of the src");
 
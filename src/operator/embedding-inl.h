@@ -15,6 +15,7 @@
 #include <string>
 #include <utility>
 #include "./operator_common.h"
+#include "./row_sparse-inl.h"
 
 namespace mxnet {
 namespace op {
@@ -28,11 +29,16 @@ enum EmbeddingOpResource {kTempSpace};
 struct EmbeddingParam: public dmlc::Parameter<EmbeddingParam> {
   int input_dim;
   int output_dim;
+  bool sparse_grad;
   DMLC_DECLARE_PARAMETER(EmbeddingParam) {
     DMLC_DECLARE_FIELD(input_dim).set_lower_bound(1)
     .describe("input dim of one-hot encoding");
     DMLC_DECLARE_FIELD(output_dim).set_lower_bound(1)
     .describe("output dim of embedding");
+    DMLC_DECLARE_FIELD(sparse_grad).set_default(false)
+    .describe("Whether the weight gradient is row sparse: only the rows of the indices "
+              "in data are written, the other rows are left unspecified. "
+              "The training loop then updates only these rows.");
   }
 };
 
@@ -96,7 +102,10 @@ class EmbeddingOp : public Operator {
          Shape2(oshape.ProdShape(0, oshape.ndim()-1), oshape[oshape.ndim()-1]), s);
     Tensor<xpu, 2, DType> grad_in = in_grad[embedding::kWeight].get<xpu, 2, DType>(s);
     if (req[embedding::kWeight] == kWriteTo || req[embedding::kWeight] == kAddTo) {
-      if (req[embedding::kWeight] == kWriteTo) {
+      if (req[embedding::kWeight] == kWriteTo && param_.sparse_grad) {
+        // only the rows of data are read by the row sparse update
+        rowsparse::FillRows(grad_in, data, static_cast<const DType*>(NULL));
+      } else if (req[embedding::kWeight] == kWriteTo) {
 #ifdef __CUDACC__
         cudaMemsetAsync(grad_in.dptr_, 0, grad_in.MSize() * sizeof(DType),
                         Stream<gpu>::GetStream(s));
@@ -24,6 +24,7 @@ namespace op {
 namespace fullc {
 enum FullyConnectedOpInputs {kData, kWeight, kBias};
 enum FullyConnectedOpOutputs {kOut};
+enum FullyConnectedResource {kTempSpace};
 }  // fullc
 
 struct FullyConnectedParam : public dmlc::Parameter<FullyConnectedParam> {
@@ -72,8 +73,17 @@ class FullyConnectedOp : public Operator {
     const TShape& ishape = in_data[fullc::kData].shape_;
     const TShape& oshape = out_data[fullc::kOut].shape_;
 
-    Tensor<xpu, 2, DType> data = in_data[fullc::kData].get_with_shape<xpu, 2, DType>(
-        Shape2(ishape[0], ishape.ProdShape(1, ishape.ndim())), s);
+    const Shape<2> dshape = Shape2(ishape[0], ishape.ProdShape(1, ishape.ndim()));
+    Tensor<xpu, 2, DType> data;
+    if (in_data[fullc::kData].type_flag_ == mshadow::DataType<DType>::kFlag) {
+      data = in_data[fullc::kData].get_with_shape<xpu, 2, DType>(dshape, s);
+    } else {
+      // the output of a skipped Cast, converted into the temp space
+      data = ctx.requested[fullc::kTempSpace].get_space_typed<xpu, 2, DType>(dshape, s);
+      MSHADOW_REAL_TYPE_SWITCH(in_data[fullc::kData].type_flag_, SrcDType, {
+        data = tcast<DType>(in_data[fullc::kData].get_with_shape<xpu, 2, SrcDType>(dshape, s));
+      });
+    }
     Tensor<xpu, 2, DType> wmat = in_data[fullc::kWeight].get<xpu, 2, DType>(s);
     Tensor<xpu, 2, DType> out = out_data[fullc::kOut].get_with_shape<xpu, 2, DType>(
         Shape2(oshape[0], oshape.ProdShape(1, oshape.ndim())), s);
@@ -129,7 +139,7 @@ class FullyConnectedOp : public Operator {
     Assign(gdata, req[fullc::kData], dot(grad, wmat));
   }
 
- private:
+ protected:
   FullyConnectedParam param_;
 };  // class FullyConnectedOp
 
@@ -217,6 +227,16 @@ class FullyConnectedProp : public OperatorProperty {
     return {out_grad[fullc::kOut], in_data[fullc::kData], in_data[fullc::kWeight]};
   }
 
+  std::vector<ResourceRequest> ForwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace};
+  }
+
+  std::vector<int> CastOnLoadInputs(const Context &ctx) const override {
+    // the backward reads the data, so the Cast is only skipped for inference
+    return {fullc::kData};
+  }
+
   std::vector<std::pair<int, void*> > BackwardInplaceOption(
     const std::vector<int> &out_grad,
     const std::vector<int> &in_data,
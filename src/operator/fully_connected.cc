@@ -4,15 +4,23 @@
  * \brief fully connect operator
 */
 #include "./fully_connected-inl.h"
+#include "./cpu_fully_connected-inl.h"
 namespace mxnet {
 namespace op {
 template<>
 Operator* CreateOp<cpu>(FullyConnectedParam param, int dtype) {
   Operator *op = NULL;
   switch (dtype) {
-  case mshadow::kFloat32:
-    op = new FullyConnectedOp<cpu, float>(param);
+  case mshadow::kFloat32: {
+    const int pack_batch = dmlc::GetEnv("MXNET_CPU_FC_PACK_BATCH", 0);
+    const float sparse_density = dmlc::GetEnv("MXNET_CPU_SPARSE_WEIGHT_DENSITY", 0.25f);
+    if (pack_batch > 0 || sparse_density > 0.0f) {
+      op = new CPUFullyConnectedOp(param, pack_batch, sparse_density);
+    } else {
+      op = new FullyConnectedOp<cpu, float>(param);
+    }
     break;
+  }
   case mshadow::kFloat64:
     op = new FullyConnectedOp<cpu, double>(param);
     break;
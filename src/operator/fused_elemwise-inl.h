@@ -0,0 +1,366 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file fused_elemwise-inl.h
+ * \brief a chain of elementwise operators fused into one operator,
+ *  created by StaticGraph::FuseElemwise.
+*/
+#ifndef MXNET_OPERATOR_FUSED_ELEMWISE_INL_H_
+#define MXNET_OPERATOR_FUSED_ELEMWISE_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <utility>
+#include "./operator_common.h"
+
+namespace mxnet {
+namespace op {
+
+namespace fused {
+/*! \brief operations of a fused program */
+enum OpCode {
+  kPlus, kMinus, kMul, kDiv, kPower, kMaximum, kMinimum,
+  kPlusScalar, kMinusScalar, kRMinusScalar, kMulScalar, kDivScalar, kRDivScalar,
+  kMaximumScalar, kMinimumScalar, kPowerScalar, kRPowerScalar,
+  kAbs, kSign, kSquare, kSqrt, kRsqrt, kExp, kLog, kCos, kSin,
+  kReLU, kSigmoid, kTanh, kSoftReLU,
+  kNumOpCodes
+};
+/*!
+ * \brief names of the op codes, the type string of the operator they come from,
+ *  or the act_type of Activation.
+ */
+const char* const kOpNames[] = {
+  "_Plus", "_Minus", "_Mul", "_Div", "_Power", "_Maximum", "_Minimum",
+  "_PlusScalar", "_MinusScalar", "_RMinusScalar", "_MulScalar", "_DivScalar", "_RDivScalar",
+  "_MaximumScalar", "_MinimumScalar", "_PowerScalar", "_RPowerScalar",
+  "abs", "sign", "square", "sqrt", "rsqrt", "exp", "log", "cos", "sin",
+  "relu", "sigmoid", "tanh", "softrelu"
+};
+/*! \return number of array operands of an op code */
+inline int NumOperands(int op) {
+  return op <= kMinimum ? 2 : 1;
+}
+/*! \return whether an op code takes a scalar */
+inline bool HasScalar(int op) {
+  return op >= kPlusScalar && op <= kRPowerScalar;
+}
+/*! \return the op code of a name, -1 if not found */
+inline int FindOpCode(const std::string& name) {
+  for (int i = 0; i < kNumOpCodes; ++i) {
+    if (name == kOpNames[i]) return i;
+  }
+  return -1;
+}
+/*!
+ * \return the op code of a graph node that can be fused, -1 otherwise.
+ *  Operators without gradient, such as round, are not fused.
+ */
+inline int NodeOpCode(const OperatorProperty& prop) {
+  std::string type = prop.TypeString();
+  if (type == "Activation") {
+    return FindOpCode(prop.GetParams()["act_type"]);
+  }
+  int op = FindOpCode(type);
+  return op >= kReLU ? -1 : op;
+}
+
+/*!
+ * \brief one instruction of a fused program.
+ *  Operands refer to registers, register i < num_args is input i,
+ *  register num_args + k is the result of instruction k.
+ *  The result of the last instruction is the output.
+ */
+struct Instr {
+  /*! \brief op code */
+  int op;
+  /*! \brief first operand */
+  int lhs;
+  /*! \brief second operand, -1 for single operand op codes */
+  int rhs;
+  /*! \brief scalar of the scalar op codes */
+  float scalar;
+};
+
+/*! \brief print a program as "op,lhs,rhs,scalar;..." */
+inline std::string PrintProgram(const std::vector<Instr>& prog) {
+  std::ostringstream os;
+  os << std::setprecision(9);
+  for (size_t i = 0; i < prog.size(); ++i) {
+    if (i != 0) os << ';';
+    os << kOpNames[prog[i].op] << ',' << prog[i].lhs << ','
+       << prog[i].rhs << ',' << prog[i].scalar;
+  }
+  return os.str();
+}
+/*! \brief parse a program printed by PrintProgram and check the operands */
+inline std::vector<Instr> ParseProgram(const std::string& str, int num_args) {
+  std::vector<Instr> prog;
+  std::istringstream is(str);
+  std::string item;
+  while (std::getline(is, item, ';')) {
+    std::istringstream fs(item);
+    std::string name, lhs, rhs, scalar;
+    std::getline(fs, name, ',');
+    std::getline(fs, lhs, ',');
+    std::getline(fs, rhs, ',');
+    std::getline(fs, scalar, ',');
+    Instr ins;
+    ins.op = FindOpCode(name);
+    CHECK_NE(ins.op, -1) << "Unknown operation " << name << " in fused program";
+    ins.lhs = std::stoi(lhs);
+    ins.rhs = std::stoi(rhs);
+    ins.scalar = std::stof(scalar);
+    int nreg = num_args + static_cast<int>(prog.size());
+    CHECK(ins.lhs >= 0 && ins.lhs < nreg) << "Invalid operand in fused program " << str;
+    if (NumOperands(ins.op) == 2) {
+      CHECK(ins.rhs >= 0 && ins.rhs < nreg) << "Invalid operand in fused program " << str;
+    }
+    prog.push_back(ins);
+  }
+  CHECK_NE(prog.size(), 0) << "Empty fused program";
+  return prog;
+}
+/*! \brief evaluate an instruction on operands a and b */
+inline float Eval(const Instr& ins, float a, float b) {
+  const float s = ins.scalar;
+  switch (ins.op) {
+    case kPlus: return a + b;
+    case kMinus: return a - b;
+    case kMul: return a * b;
+    case kDiv: return a / b;
+    case kPower: return powf(a, b);
+    case kMaximum: return a > b ? a : b;
+    case kMinimum: return a < b ? a : b;
+    case kPlusScalar: return a + s;
+    case kMinusScalar: return a - s;
+    case kRMinusScalar: return s - a;
+    case kMulScalar: return a * s;
+    case kDivScalar: return a / s;
+    case kRDivScalar: return s / a;
+    case kMaximumScalar: return a > s ? a : s;
+    case kMinimumScalar: return a < s ? a : s;
+    case kPowerScalar: return powf(a, s);
+    case kRPowerScalar: return powf(s, a);
+    case kAbs: return fabsf(a);
+    case kSign: return a < 0.0f ? -1.0f : (a > 0.0f ? 1.0f : 0.0f);
+    case kSquare: return a * a;
+    case kSqrt: return sqrtf(a);
+    case kRsqrt: return 1.0f / sqrtf(a);
+    case kExp: return expf(a);
+    case kLog: return logf(a);
+    case kCos: return cosf(a);
+    case kSin: return sinf(a);
+    case kReLU: return a > 0.0f ? a : 0.0f;
+    case kSigmoid: return 1.0f / (1.0f + expf(-a));
+    case kTanh: return tanhf(a);
+    case kSoftReLU: return log1pf(expf(a));
+    default: LOG(FATAL) << "Unknown op code " << ins.op; return 0.0f;
+  }
+}
+/*!
+ * \brief gradient of an instruction, the same as the unfused operators.
+ * \param ins the instruction.
+ * \param a first operand.
+ * \param b second operand.
+ * \param y result of the instruction.
+ * \param g gradient of the result.
+ * \param ga gradient of the first operand.
+ * \param gb gradient of the second operand.
+ */
+inline void Grad(const Instr& ins, float a, float b, float y, float g,
+                 float *ga, float *gb) {
+  const float s = ins.scalar;
+  *gb = 0.0f;
+  switch (ins.op) {
+    case kPlus: *ga = g; *gb = g; break;
+    case kMinus: *ga = g; *gb = -g; break;
+    case kMul: *ga = g * b; *gb = g * a; break;
+    case kDiv: *ga = g / b; *gb = -g * a / (b * b); break;
+    case kPower: *ga = g * b * powf(a, b - 1.0f); *gb = g * y * logf(a); break;
+    case kMaximum: *ga = a > b ? g : 0.0f; *gb = b > a ? g : 0.0f; break;
+    case kMinimum: *ga = a < b ? g : 0.0f; *gb = b < a ? g : 0.0f; break;
+    case kPlusScalar: *ga = g; break;
+    case kMinusScalar: *ga = g; break;
+    case kRMinusScalar: *ga = -g; break;
+    case kMulScalar: *ga = g * s; break;
+    case kDivScalar: *ga = g / s; break;
+    case kRDivScalar: *ga = -s / (a * a) * g; break;
+    case kMaximumScalar: *ga = a > s ? g : 0.0f; break;
+    case kMinimumScalar: *ga = a < s ? g : 0.0f; break;
+    case kPowerScalar: *ga = powf(a, s - 1.0f) * s * g; break;
+    case kRPowerScalar: *ga = logf(s) * y * g; break;
+    case kAbs: *ga = a < 0.0f ? -g : (a > 0.0f ? g : 0.0f); break;
+    case kSign: *ga = 0.0f; break;
+    case kSquare: *ga = 2.0f * a * g; break;
+    case kSqrt: *ga = 0.5f / y * g; break;
+    case kRsqrt: *ga = -(1.0f / (2.0f * a * sqrtf(a))) * g; break;
+    case kExp: *ga = y * g; break;
+    case kLog: *ga = 1.0f / a * g; break;
+    case kCos: *ga = -sinf(a) * g; break;
+    case kSin: *ga = cosf(a) * g; break;
+    case kReLU: *ga = y > 0.0f ? g : 0.0f; break;
+    case kSigmoid: *ga = y * (1.0f - y) * g; break;
+    case kTanh: *ga = (1.0f - y * y) * g; break;
+    case kSoftReLU: *ga = (1.0f - expf(-y)) * g; break;
+    default: LOG(FATAL) << "Unknown op code " << ins.op;
+  }
+}
+}  // namespace fused
+
+struct FusedElemwiseParam : public dmlc::Parameter<FusedElemwiseParam> {
+  int num_args;
+  std::string program;
+  DMLC_DECLARE_PARAMETER(FusedElemwiseParam) {
+    DMLC_DECLARE_FIELD(num_args).set_lower_bound(1)
+    .describe("Number of inputs.");
+    DMLC_DECLARE_FIELD(program)
+    .describe("Instructions \"op,lhs,rhs,scalar\" separated by ';'.");
+  }
+};
+
+/*!
+ * \brief forward of a fused program.
+ *  Implemented by an interpreter on cpu, and by a kernel generated with MXRtc on gpu.
+ */
+void FusedForward(mshadow::Stream<cpu> *s, const std::vector<fused::Instr>& prog,
+                  const std::vector<TBlob> &in_data, OpReqType req, const TBlob &out);
+void FusedForward(mshadow::Stream<gpu> *s, const std::vector<fused::Instr>& prog,
+                  const std::vector<TBlob> &in_data, OpReqType req, const TBlob &out);
+/*!
+ * \brief backward of a fused program,
+ *  the intermediate results are recomputed from the inputs.
+ */
+void FusedBackward(mshadow::Stream<cpu> *s, const std::vector<fused::Instr>& prog,
+                   const TBlob &out_grad, const std::vector<TBlob> &in_data,
+                   const std::vector<OpReqType> &req, const std::vector<TBlob> &in_grad);
+void FusedBackward(mshadow::Stream<gpu> *s, const std::vector<fused::Instr>& prog,
+                   const TBlob &out_grad, const std::vector<TBlob> &in_data,
+                   const std::vector<OpReqType> &req, const std::vector<TBlob> &in_grad);
+
+template<typename xpu>
+class FusedElemwiseOp : public Operator {
+ public:
+  explicit FusedElemwiseOp(FusedElemwiseParam param)
+    : prog_(fused::ParseProgram(param.program, param.num_args)) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    CHECK_EQ(out_data.size(), 1);
+    if (req[0] == kNullOp) return;
+    FusedForward(ctx.get_stream<xpu>(), prog_, in_data, req[0], out_data[0]);
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    CHECK_EQ(in_grad.size(), in_data.size());
+    FusedBackward(ctx.get_stream<xpu>(), prog_, out_grad[0], in_data, req, in_grad);
+  }
+
+ private:
+  std::vector<fused::Instr> prog_;
+};  // class FusedElemwiseOp
+
+template<typename xpu>
+Operator* CreateOp(FusedElemwiseParam param);
+
+#if DMLC_USE_CXX11
+class FusedElemwiseProp : public OperatorProperty {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+    fused::ParseProgram(param_.program, param_.num_args);
+  }
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    CHECK_EQ(in_shape->size(), static_cast<size_t>(param_.num_args));
+    int sidx = -1;
+    for (int i = 0; i < param_.num_args; ++i) {
+      if (in_shape->at(i).ndim() != 0) {
+        sidx = i;
+        break;
+      }
+    }
+    if (sidx == -1) return false;
+    for (int i = 0; i < param_.num_args; ++i) {
+      if (i != sidx) {
+        SHAPE_ASSIGN_CHECK(*in_shape, i, in_shape->at(sidx));
+      }
+    }
+    out_shape->clear();
+    out_shape->push_back(in_shape->at(sidx));
+    return true;
+  }
+
+  bool InferType(std::vector<int> *in_type,
+                 std::vector<int> *out_type,
+                 std::vector<int> *aux_type) const override {
+    CHECK_EQ(in_type->size(), static_cast<size_t>(param_.num_args));
+    for (size_t i = 0; i < in_type->size(); ++i) {
+      CHECK(in_type->at(i) == mshadow::kFloat32 || in_type->at(i) == -1)
+          << "Fused elementwise operators only support float32, "
+          << "set MXNET_EXEC_FUSE_ELEMWISE=0 for other types";
+    }
+    in_type->assign(param_.num_args, mshadow::kFloat32);
+    out_type->clear();
+    out_type->push_back(mshadow::kFloat32);
+    return true;
+  }
+
+  std::vector<std::string> ListArguments() const override {
+    std::vector<std::string> ret;
+    for (int i = 0; i < param_.num_args; ++i) {
+      ret.push_back("data" + std::to_string(i));
+    }
+    return ret;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new FusedElemwiseProp();
+    ptr->param_ = param_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "_FusedElemwise";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    std::vector<int> ret(in_data);
+    ret.push_back(out_grad[0]);
+    return ret;
+  }
+
+  Operator* CreateOperator(Context ctx) const override;
+
+ private:
+  FusedElemwiseParam param_;
+};  // class FusedElemwiseProp
+#endif  // DMLC_USE_CXX11
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_FUSED_ELEMWISE_INL_H_
@@ -0,0 +1,123 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file fused_elemwise.cc
+ * \brief fused elementwise operator
+*/
+#include <algorithm>
+#include "./fused_elemwise-inl.h"
+
+namespace mxnet {
+namespace op {
+namespace {
+/*! \brief number of elements the cpu interpreter runs each instruction on at a time */
+const index_t kBlockSize = 256;
+
+/*! \brief run the instructions on [begin, begin + n), regs points to each register */
+inline void RunBlock(const std::vector<fused::Instr>& prog, int num_args,
+                     std::vector<float*>* regs, index_t n) {
+  for (size_t k = 0; k < prog.size(); ++k) {
+    const fused::Instr& ins = prog[k];
+    const float *a = (*regs)[ins.lhs];
+    const float *b = ins.rhs >= 0 ? (*regs)[ins.rhs] : a;
+    float *y = (*regs)[num_args + k];
+    for (index_t i = 0; i < n; ++i) {
+      y[i] = fused::Eval(ins, a[i], b[i]);
+    }
+  }
+}
+}  // namespace
+
+void FusedForward(mshadow::Stream<cpu> *s, const std::vector<fused::Instr>& prog,
+                  const std::vector<TBlob> &in_data, OpReqType req, const TBlob &out) {
+  const int num_args = static_cast<int>(in_data.size());
+  const index_t size = out.shape_.Size();
+  std::vector<float> buf(prog.size() * kBlockSize);
+  std::vector<float*> regs(num_args + prog.size());
+  for (size_t k = 0; k < prog.size(); ++k) {
+    regs[num_args + k] = buf.data() + k * kBlockSize;
+  }
+  float *dst = static_cast<float*>(out.dptr_);
+  for (index_t begin = 0; begin < size; begin += kBlockSize) {
+    index_t n = std::min(kBlockSize, size - begin);
+    for (int j = 0; j < num_args; ++j) {
+      regs[j] = static_cast<float*>(in_data[j].dptr_) + begin;
+    }
+    RunBlock(prog, num_args, &regs, n);
+    const float *res = regs.back();
+    if (req == kAddTo) {
+      for (index_t i = 0; i < n; ++i) dst[begin + i] += res[i];
+    } else {
+      std::copy(res, res + n, dst + begin);
+    }
+  }
+}
+
+void FusedBackward(mshadow::Stream<cpu> *s, const std::vector<fused::Instr>& prog,
+                   const TBlob &out_grad, const std::vector<TBlob> &in_data,
+                   const std::vector<OpReqType> &req, const std::vector<TBlob> &in_grad) {
+  const int num_args = static_cast<int>(in_data.size());
+  const size_t nreg = num_args + prog.size();
+  const index_t size = out_grad.shape_.Size();
+  std::vector<float> buf(prog.size() * kBlockSize);
+  std::vector<float> adj(nreg * kBlockSize);
+  std::vector<float*> regs(nreg);
+  for (size_t k = 0; k < prog.size(); ++k) {
+    regs[num_args + k] = buf.data() + k * kBlockSize;
+  }
+  const float *ograd = static_cast<const float*>(out_grad.dptr_);
+  for (index_t begin = 0; begin < size; begin += kBlockSize) {
+    index_t n = std::min(kBlockSize, size - begin);
+    for (int j = 0; j < num_args; ++j) {
+      regs[j] = static_cast<float*>(in_data[j].dptr_) + begin;
+    }
+    RunBlock(prog, num_args, &regs, n);
+    // reverse mode over the instructions, adj holds the gradient of each register.
+    std::fill(adj.begin(), adj.end(), 0.0f);
+    std::copy(ograd + begin, ograd + begin + n, adj.data() + (nreg - 1) * kBlockSize);
+    for (size_t k = prog.size(); k-- > 0;) {
+      const fused::Instr& ins = prog[k];
+      const float *a = regs[ins.lhs];
+      const float *b = ins.rhs >= 0 ? regs[ins.rhs] : a;
+      const float *y = regs[num_args + k];
+      const float *g = adj.data() + (num_args + k) * kBlockSize;
+      float *ga = adj.data() + ins.lhs * kBlockSize;
+      float *gb = ins.rhs >= 0 ? adj.data() + ins.rhs * kBlockSize : nullptr;
+      for (index_t i = 0; i < n; ++i) {
+        float da, db;
+        fused::Grad(ins, a[i], b[i], y[i], g[i], &da, &db);
+        ga[i] += da;
+        if (gb != nullptr) gb[i] += db;
+      }
+    }
+    for (int j = 0; j < num_args; ++j) {
+      if (req[j] == kNullOp) continue;
+      float *dst = static_cast<float*>(in_grad[j].dptr_) + begin;
+      const float *src = adj.data() + j * kBlockSize;
+      if (req[j] == kAddTo) {
+        for (index_t i = 0; i < n; ++i) dst[i] += src[i];
+      } else {
+        std::copy(src, src + n, dst);
+      }
+    }
+  }
+}
+
+template<>
+Operator* CreateOp<cpu>(FusedElemwiseParam param) {
+  return new FusedElemwiseOp<cpu>(param);
+}
+
+Operator* FusedElemwiseProp::CreateOperator(Context ctx) const {
+  DO_BIND_DISPATCH(CreateOp, param_);
+}
+
+DMLC_REGISTER_PARAMETER(FusedElemwiseParam);
+
+MXNET_REGISTER_OP_PROPERTY(_FusedElemwise, FusedElemwiseProp)
+.describe("Elementwise operators fused into one by the executor, "
+          "see MXNET_EXEC_FUSE_ELEMWISE.")
+.add_arguments(FusedElemwiseParam::__FIELDS__())
+.set_key_var_num_args("num_args");
+
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,256 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file fused_elemwise.cu
+ * \brief fused elementwise operator, kernels are generated and compiled with MXRtc.
+*/
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "./fused_elemwise-inl.h"
+#if MXNET_USE_NVRTC
+#include <mxnet/mxrtc.h>
+#endif  // MXNET_USE_NVRTC
+
+namespace mxnet {
+namespace op {
+#if MXNET_USE_NVRTC
+namespace {
+/*! \brief threads per block of the generated kernels */
+const unsigned kBlockDim = 256;
+/*! \brief maximum blocks of the generated kernels, the kernels loop over the rest */
+const unsigned kMaxGridDim = 4096;
+
+/*! \return a float literal that keeps the value of a scalar */
+inline std::string Literal(float v) {
+  std::ostringstream os;
+  os << std::scientific << std::setprecision(9) << v << 'f';
+  return os.str();
+}
+/*! \return name of register i */
+inline std::string Reg(int i) {
+  return "r" + std::to_string(i);
+}
+/*! \return name of the gradient of register i */
+inline std::string Adj(int i) {
+  return "d" + std::to_string(i);
+}
+/*! \return cuda expression of an instruction, matches fused::Eval */
+std::string EvalCode(const fused::Instr& ins) {
+  const std::string a = Reg(ins.lhs);
+  const std::string b = ins.rhs >= 0 ? Reg(ins.rhs) : a;
+  const std::string s = Literal(ins.scalar);
+  switch (ins.op) {
+    case fused::kPlus: return a + " + " + b;
+    case fused::kMinus: return a + " - " + b;
+    case fused::kMul: return a + " * " + b;
+    case fused::kDiv: return a + " / " + b;
+    case fused::kPower: return "powf(" + a + ", " + b + ")";
+    case fused::kMaximum: return a + " > " + b + " ? " + a + " : " + b;
+    case fused::kMinimum: return a + " < " + b + " ? " + a + " : " + b;
+    case fused::kPlusScalar: return a + " + " + s;
+    case fused::kMinusScalar: return a + " - " + s;
+    case fused::kRMinusScalar: return s + " - " + a;
+    case fused::kMulScalar: return a + " * " + s;
+    case fused::kDivScalar: return a + " / " + s;
+    case fused::kRDivScalar: return s + " / " + a;
+    case fused::kMaximumScalar: return a + " > " + s + " ? " + a + " : " + s;
+    case fused::kMinimumScalar: return a + " < " + s + " ? " + a + " : " + s;
+    case fused::kPowerScalar: return "powf(" + a + ", " + s + ")";
+    case fused::kRPowerScalar: return "powf(" + s + ", " + a + ")";
+    case fused::kAbs: return "fabsf(" + a + ")";
+    case fused::kSign: return a + " < 0.0f ? -1.0f : (" + a + " > 0.0f ? 1.0f : 0.0f)";
+    case fused::kSquare: return a + " * " + a;
+    case fused::kSqrt: return "sqrtf(" + a + ")";
+    case fused::kRsqrt: return "1.0f / sqrtf(" + a + ")";
+    case fused::kExp: return "expf(" + a + ")";
+    case fused::kLog: return "logf(" + a + ")";
+    case fused::kCos: return "cosf(" + a + ")";
+    case fused::kSin: return "sinf(" + a + ")";
+    case fused::kReLU: return a + " > 0.0f ? " + a + " : 0.0f";
+    case fused::kSigmoid: return "1.0f / (1.0f + expf(-" + a + "))";
+    case fused::kTanh: return "tanhf(" + a + ")";
+    case fused::kSoftReLU: return "log1pf(expf(" + a + "))";
+    default: LOG(FATAL) << "Unknown op code " << ins.op; return "";
+  }
+}
+/*!
+ * \return cuda statements that add the gradients of instruction k to its operands,
+ *  matches fused::Grad
+ */
+std::string GradCode(const fused::Instr& ins, int k) {
+  const std::string a = Reg(ins.lhs);
+  const std::string b = ins.rhs >= 0 ? Reg(ins.rhs) : a;
+  const std::string y = Reg(k);
+  const std::string g = Adj(k);
+  const std::string s = Literal(ins.scalar);
+  std::string ga, gb;
+  switch (ins.op) {
+    case fused::kPlus: ga = g; gb = g; break;
+    case fused::kMinus: ga = g; gb = "-" + g; break;
+    case fused::kMul: ga = g + " * " + b; gb = g + " * " + a; break;
+    case fused::kDiv: ga = g + " / " + b; gb = "-" + g + " * " + a + " / (" + b + " * " + b + ")";
+      break;
+    case fused::kPower:
+      ga = g + " * " + b + " * powf(" + a + ", " + b + " - 1.0f)";
+      gb = g + " * " + y + " * logf(" + a + ")";
+      break;
+    case fused::kMaximum:
+      ga = a + " > " + b + " ? " + g + " : 0.0f";
+      gb = b + " > " + a + " ? " + g + " : 0.0f";
+      break;
+    case fused::kMinimum:
+      ga = a + " < " + b + " ? " + g + " : 0.0f";
+      gb = b + " < " + a + " ? " + g + " : 0.0f";
+      break;
+    case fused::kPlusScalar: ga = g; break;
+    case fused::kMinusScalar: ga = g; break;
+    case fused::kRMinusScalar: ga = "-" + g; break;
+    case fused::kMulScalar: ga = g + " * " + s; break;
+    case fused::kDivScalar: ga = g + " / " + s; break;
+    case fused::kRDivScalar: ga = "-" + s + " / (" + a + " * " + a + ") * " + g; break;
+    case fused::kMaximumScalar: ga = a + " > " + s + " ? " + g + " : 0.0f"; break;
+    case fused::kMinimumScalar: ga = a + " < " + s + " ? " + g + " : 0.0f"; break;
+    case fused::kPowerScalar: ga = "powf(" + a + ", " + s + " - 1.0f) * " + s + " * " + g; break;
+    case fused::kRPowerScalar: ga = "logf(" + s + ") * " + y + " * " + g; break;
+    case fused::kAbs: ga = a + " < 0.0f ? -" + g + " : (" + a + " > 0.0f ? " + g + " : 0.0f)";
+      break;
+    case fused::kSign: ga = "0.0f"; break;
+    case fused::kSquare: ga = "2.0f * " + a + " * " + g; break;
+    case fused::kSqrt: ga = "0.5f / " + y + " * " + g; break;
+    case fused::kRsqrt: ga = "-(1.0f / (2.0f * " + a + " * sqrtf(" + a + "))) * " + g; break;
+    case fused::kExp: ga = y + " * " + g; break;
+    case fused::kLog: ga = "1.0f / " + a + " * " + g; break;
+    case fused::kCos: ga = "-sinf(" + a + ") * " + g; break;
+    case fused::kSin: ga = "cosf(" + a + ") * " + g; break;
+    case fused::kReLU: ga = y + " > 0.0f ? " + g + " : 0.0f"; break;
+    case fused::kSigmoid: ga = y + " * (1.0f - " + y + ") * " + g; break;
+    case fused::kTanh: ga = "(1.0f - " + y + " * " + y + ") * " + g; break;
+    case fused::kSoftReLU: ga = "(1.0f - expf(-" + y + ")) * " + g; break;
+    default: LOG(FATAL) << "Unknown op code " << ins.op;
+  }
+  std::string code = Adj(ins.lhs) + " += " + ga + ";\n";
+  if (ins.rhs >= 0) code += Adj(ins.rhs) + " += " + gb + ";\n";
+  return code;
+}
+/*! \return cuda statements that compute all registers at element i */
+std::string ForwardCode(const std::vector<fused::Instr>& prog, int num_args) {
+  std::string code;
+  for (int j = 0; j < num_args; ++j) {
+    code += "const float " + Reg(j) + " = data" + std::to_string(j) + "[i];\n";
+  }
+  for (size_t k = 0; k < prog.size(); ++k) {
+    code += "const float " + Reg(num_args + static_cast<int>(k)) + " = " +
+        EvalCode(prog[k]) + ";\n";
+  }
+  return code;
+}
+/*! \return a grid stride loop over size elements around body */
+std::string LoopCode(index_t size, const std::string& body) {
+  return "for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < " + std::to_string(size) +
+      "; i += blockDim.x * gridDim.x) {\n" + body + "}\n";
+}
+/*! \return assignment of value to dst[i] under req */
+std::string AssignCode(const std::string& dst, OpReqType req, const std::string& value) {
+  if (req == kNullOp) return "";
+  return dst + "[i] " + (req == kAddTo ? "+= " : "= ") + value + ";\n";
+}
+
+/*!
+ * \brief get the kernel of a signature, compile it when first used.
+ *  The cuda code is the signature, it contains the program, the size and the req.
+ */
+MXRtc* GetKernel(const std::vector<std::pair<std::string, NDArray> >& input,
+                 const std::vector<std::pair<std::string, NDArray> >& output,
+                 const std::string& code) {
+  static std::unordered_map<std::string, std::unique_ptr<MXRtc> > kernels;
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::unique_ptr<MXRtc>& kernel = kernels[code];
+  if (kernel.get() == nullptr) {
+    kernel.reset(new MXRtc("fused_elemwise", input, output, code));
+  }
+  return kernel.get();
+}
+/*! \return grid size of a kernel on size elements */
+inline unsigned GridDim(index_t size) {
+  return std::max(1U, std::min(kMaxGridDim,
+      static_cast<unsigned>((size + kBlockDim - 1) / kBlockDim)));
+}
+}  // namespace
+
+void FusedForward(mshadow::Stream<gpu> *s, const std::vector<fused::Instr>& prog,
+                  const std::vector<TBlob> &in_data, OpReqType req, const TBlob &out) {
+  const int num_args = static_cast<int>(in_data.size());
+  const index_t size = out.shape_.Size();
+  int dev_id;
+  CHECK_EQ(cudaGetDevice(&dev_id), cudaSuccess);
+  // arrays are only used by MXRtc for the shape constants, no memory is allocated.
+  std::vector<std::pair<std::string, NDArray> > input, output;
+  for (int j = 0; j < num_args; ++j) {
+    input.emplace_back("data" + std::to_string(j),
+                       NDArray(in_data[j].shape_, Context::GPU(dev_id), true));
+  }
+  output.emplace_back("out", NDArray(out.shape_, Context::GPU(dev_id), true));
+  std::string body = ForwardCode(prog, num_args) +
+      AssignCode("out", req, Reg(num_args + static_cast<int>(prog.size()) - 1));
+  MXRtc* kernel = GetKernel(input, output, LoopCode(size, body));
+  std::vector<float*> args;
+  for (int j = 0; j < num_args; ++j) args.push_back(static_cast<float*>(in_data[j].dptr_));
+  args.push_back(static_cast<float*>(out.dptr_));
+  kernel->launch(args, dev_id, s, GridDim(size), kBlockDim);
+}
+
+void FusedBackward(mshadow::Stream<gpu> *s, const std::vector<fused::Instr>& prog,
+                   const TBlob &out_grad, const std::vector<TBlob> &in_data,
+                   const std::vector<OpReqType> &req, const std::vector<TBlob> &in_grad) {
+  const int num_args = static_cast<int>(in_data.size());
+  const int nreg = num_args + static_cast<int>(prog.size());
+  const index_t size = out_grad.shape_.Size();
+  int dev_id;
+  CHECK_EQ(cudaGetDevice(&dev_id), cudaSuccess);
+  std::vector<std::pair<std::string, NDArray> > input, output;
+  for (int j = 0; j < num_args; ++j) {
+    input.emplace_back("data" + std::to_string(j),
+                       NDArray(in_data[j].shape_, Context::GPU(dev_id), true));
+  }
+  input.emplace_back("ograd", NDArray(out_grad.shape_, Context::GPU(dev_id), true));
+  for (int j = 0; j < num_args; ++j) {
+    output.emplace_back("grad" + std::to_string(j),
+                        NDArray(in_grad[j].shape_, Context::GPU(dev_id), true));
+  }
+  std::string body = ForwardCode(prog, num_args);
+  for (int j = 0; j < nreg - 1; ++j) body += "float " + Adj(j) + " = 0.0f;\n";
+  body += "float " + Adj(nreg - 1) + " = ograd[i];\n";
+  for (int k = static_cast<int>(prog.size()) - 1; k >= 0; --k) {
+    body += GradCode(prog[k], num_args + k);
+  }
+  for (int j = 0; j < num_args; ++j) {
+    body += AssignCode("grad" + std::to_string(j), req[j], Adj(j));
+  }
+  MXRtc* kernel = GetKernel(input, output, LoopCode(size, body));
+  std::vector<float*> args;
+  for (int j = 0; j < num_args; ++j) args.push_back(static_cast<float*>(in_data[j].dptr_));
+  args.push_back(static_cast<float*>(out_grad.dptr_));
+  for (int j = 0; j < num_args; ++j) args.push_back(static_cast<float*>(in_grad[j].dptr_));
+  kernel->launch(args, dev_id, s, GridDim(size), kBlockDim);
+}
+#else
+void FusedForward(mshadow::Stream<gpu> *s, const std::vector<fused::Instr>& prog,
+                  const std::vector<TBlob> &in_data, OpReqType req, const TBlob &out) {
+  LOG(FATAL) << "Fused elementwise operators on gpu need USE_NVRTC=1";
+}
+
+void FusedBackward(mshadow::Stream<gpu> *s, const std::vector<fused::Instr>& prog,
+                   const TBlob &out_grad, const std::vector<TBlob> &in_data,
+                   const std::vector<OpReqType> &req, const std::vector<TBlob> &in_grad) {
+  LOG(FATAL) << "Fused elementwise operators on gpu need USE_NVRTC=1";
+}
+#endif  // MXNET_USE_NVRTC
+
+template<>
+Operator* CreateOp<gpu>(FusedElemwiseParam param) {
+  return new FusedElemwiseOp<gpu>(param);
+}
+}  // namespace op
+}  // namespace mxnet
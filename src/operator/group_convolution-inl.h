@@ -0,0 +1,439 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file group_convolution-inl.h
+ * \brief direct kernels of grouped convolution with few channels per group.
+ *
+ *  ConvolutionOp runs one small GEMM per group, which is mostly overhead when the
+ *  groups have a few channels, and depthwise convolution (one channel per group)
+ *  needs as many GEMMs as channels. Here each output is computed directly:
+ *  - cpu loops are parallel over the planes of the output, or of the input in the
+ *    backward, and the inner loop is an axpy over a row that vectorizes.
+ *  - gpu kernels use one thread per output, or per input in the backward so that no
+ *    atomics are needed, and one block per weight to reduce its gradient.
+ */
+#ifndef MXNET_OPERATOR_GROUP_CONVOLUTION_INL_H_
+#define MXNET_OPERATOR_GROUP_CONVOLUTION_INL_H_
+
+#include <algorithm>
+#include <vector>
+#include "./convolution-inl.h"
+
+namespace mxnet {
+namespace op {
+namespace groupconv {
+/*! \brief maximum number of input channels per group run by the direct kernels */
+const uint32_t kMaxGroupChannels = 8;
+
+/*! \brief type of the accumulator, fp16 is accumulated in float */
+template<typename DType>
+struct AccType {
+  typedef DType type;
+};
+template<>
+struct AccType<mshadow::half::half_t> {
+  typedef float type;
+};
+
+/*! \brief sizes of a 2D grouped convolution, passed by value to the kernels */
+struct GroupConvShape {
+  int N, C, H, W, K, Ho, Wo;
+  /*! \brief input channels and output channels of each group */
+  int cpg, kpg;
+  int kh, kw, sy, sx, py, px, dy, dx;
+};
+
+/*! \brief first output index along one axis whose input index is not below 0 */
+inline int ValidBegin(int off, int stride) {
+  return off >= 0 ? 0 : (-off + stride - 1) / stride;
+}
+
+/*! \brief end of the output indices along one axis whose input index is below size */
+inline int ValidEnd(int off, int stride, int size, int osize) {
+  return off < size ? std::min(osize, (size - 1 - off) / stride + 1) : 0;
+}
+
+/*!
+ * \brief y = conv(x, w) + bias, parallel over the output planes,
+ *  each is accumulated a row at a time for each weight.
+ */
+template<typename DType>
+inline void GroupConvForward(mshadow::Stream<cpu> *s, const GroupConvShape &p,
+                             const DType *x, const DType *w, const DType *bias, DType *y) {
+  const int ohw = p.Ho * p.Wo;
+  #pragma omp parallel for schedule(static)
+  for (int nk = 0; nk < p.N * p.K; ++nk) {
+    const int n = nk / p.K, k = nk % p.K, g = k / p.kpg;
+    DType *dst = y + static_cast<size_t>(nk) * ohw;
+    std::fill(dst, dst + ohw, bias != NULL ? bias[k] : DType(0));
+    for (int c = 0; c < p.cpg; ++c) {
+      const DType *src = x + (static_cast<size_t>(n) * p.C + g * p.cpg + c) * p.H * p.W;
+      const DType *wk = w + (static_cast<size_t>(k) * p.cpg + c) * p.kh * p.kw;
+      for (int ky = 0; ky < p.kh; ++ky) {
+        const int offy = ky * p.dy - p.py;
+        const int oy1 = ValidEnd(offy, p.sy, p.H, p.Ho);
+        for (int kx = 0; kx < p.kw; ++kx) {
+          const DType wv = wk[ky * p.kw + kx];
+          const int offx = kx * p.dx - p.px;
+          const int ox0 = ValidBegin(offx, p.sx), ox1 = ValidEnd(offx, p.sx, p.W, p.Wo);
+          for (int oy = ValidBegin(offy, p.sy); oy < oy1; ++oy) {
+            const DType *row = src + (oy * p.sy + offy) * p.W + offx;
+            DType *out = dst + oy * p.Wo;
+            if (p.sx == 1) {
+              for (int ox = ox0; ox < ox1; ++ox) out[ox] += wv * row[ox];
+            } else {
+              for (int ox = ox0; ox < ox1; ++ox) out[ox] += wv * row[ox * p.sx];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/*! \brief gx = req(gx, conv^T(gy, w)), parallel over the input planes */
+template<typename DType>
+inline void GroupConvBackwardData(mshadow::Stream<cpu> *s, const GroupConvShape &p,
+                                  const DType *gy, const DType *w, DType *gx, bool addto) {
+  const int ihw = p.H * p.W;
+  #pragma omp parallel for schedule(static)
+  for (int nc = 0; nc < p.N * p.C; ++nc) {
+    const int n = nc / p.C, g = (nc % p.C) / p.cpg, c = (nc % p.C) % p.cpg;
+    DType *dst = gx + static_cast<size_t>(nc) * ihw;
+    if (!addto) std::fill(dst, dst + ihw, DType(0));
+    for (int kk = 0; kk < p.kpg; ++kk) {
+      const int k = g * p.kpg + kk;
+      const DType *src = gy + (static_cast<size_t>(n) * p.K + k) * p.Ho * p.Wo;
+      const DType *wk = w + (static_cast<size_t>(k) * p.cpg + c) * p.kh * p.kw;
+      for (int ky = 0; ky < p.kh; ++ky) {
+        const int offy = ky * p.dy - p.py;
+        const int oy1 = ValidEnd(offy, p.sy, p.H, p.Ho);
+        for (int kx = 0; kx < p.kw; ++kx) {
+          const DType wv = wk[ky * p.kw + kx];
+          const int offx = kx * p.dx - p.px;
+          const int ox0 = ValidBegin(offx, p.sx), ox1 = ValidEnd(offx, p.sx, p.W, p.Wo);
+          for (int oy = ValidBegin(offy, p.sy); oy < oy1; ++oy) {
+            DType *row = dst + (oy * p.sy + offy) * p.W + offx;
+            const DType *in = src + oy * p.Wo;
+            if (p.sx == 1) {
+              for (int ox = ox0; ox < ox1; ++ox) row[ox] += wv * in[ox];
+            } else {
+              for (int ox = ox0; ox < ox1; ++ox) row[ox * p.sx] += wv * in[ox];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/*!
+ * \brief gw = req(gw, sum of gy * x over the batch and the positions),
+ *  gbias = req(gbias, sum of gy), parallel over the kernels.
+ */
+template<typename DType>
+inline void GroupConvBackwardWeight(mshadow::Stream<cpu> *s, const GroupConvShape &p,
+                                    const DType *gy, const DType *x,
+                                    DType *gw, OpReqType req_w,
+                                    DType *gbias, OpReqType req_b) {
+  typedef typename AccType<DType>::type AType;
+  const int ksize = p.kh * p.kw;
+  if (req_w != kNullOp) {
+    #pragma omp parallel for schedule(static)
+    for (int kc = 0; kc < p.K * p.cpg; ++kc) {
+      const int k = kc / p.cpg, c = kc % p.cpg, g = k / p.kpg;
+      for (int ky = 0; ky < p.kh; ++ky) {
+        const int offy = ky * p.dy - p.py;
+        const int oy0 = ValidBegin(offy, p.sy), oy1 = ValidEnd(offy, p.sy, p.H, p.Ho);
+        for (int kx = 0; kx < p.kw; ++kx) {
+          const int offx = kx * p.dx - p.px;
+          const int ox0 = ValidBegin(offx, p.sx), ox1 = ValidEnd(offx, p.sx, p.W, p.Wo);
+          AType sum = 0;
+          for (int n = 0; n < p.N; ++n) {
+            const DType *src = x + (static_cast<size_t>(n) * p.C + g * p.cpg + c) * p.H * p.W;
+            const DType *gout = gy + (static_cast<size_t>(n) * p.K + k) * p.Ho * p.Wo;
+            for (int oy = oy0; oy < oy1; ++oy) {
+              const DType *row = src + (oy * p.sy + offy) * p.W + offx;
+              const DType *out = gout + oy * p.Wo;
+              for (int ox = ox0; ox < ox1; ++ox) {
+                sum += static_cast<AType>(out[ox]) * static_cast<AType>(row[ox * p.sx]);
+              }
+            }
+          }
+          DType &dst = gw[static_cast<size_t>(kc) * ksize + ky * p.kw + kx];
+          dst = req_w == kAddTo ? DType(static_cast<AType>(dst) + sum) : DType(sum);
+        }
+      }
+    }
+  }
+  if (gbias != NULL && req_b != kNullOp) {
+    const int ohw = p.Ho * p.Wo;
+    #pragma omp parallel for schedule(static)
+    for (int k = 0; k < p.K; ++k) {
+      AType sum = 0;
+      for (int n = 0; n < p.N; ++n) {
+        const DType *gout = gy + (static_cast<size_t>(n) * p.K + k) * ohw;
+        for (int i = 0; i < ohw; ++i) sum += static_cast<AType>(gout[i]);
+      }
+      gbias[k] = req_b == kAddTo ? DType(static_cast<AType>(gbias[k]) + sum) : DType(sum);
+    }
+  }
+}
+
+#ifdef __CUDACC__
+template<typename DType>
+__global__ void GroupConvForwardKernel(GroupConvShape p, const DType *x, const DType *w,
+                                       const DType *bias, DType *y) {
+  typedef typename AccType<DType>::type AType;
+  const int size = p.N * p.K * p.Ho * p.Wo;
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < size; i += blockDim.x * gridDim.x) {
+    const int ox = i % p.Wo, oy = (i / p.Wo) % p.Ho;
+    const int k = (i / (p.Wo * p.Ho)) % p.K, n = i / (p.Wo * p.Ho * p.K);
+    const int g = k / p.kpg;
+    AType acc = bias != NULL ? static_cast<AType>(bias[k]) : AType(0);
+    for (int c = 0; c < p.cpg; ++c) {
+      const DType *src = x + (static_cast<size_t>(n) * p.C + g * p.cpg + c) * p.H * p.W;
+      const DType *wk = w + (static_cast<size_t>(k) * p.cpg + c) * p.kh * p.kw;
+      for (int ky = 0; ky < p.kh; ++ky) {
+        const int iy = oy * p.sy - p.py + ky * p.dy;
+        if (iy < 0 || iy >= p.H) continue;
+        for (int kx = 0; kx < p.kw; ++kx) {
+          const int ix = ox * p.sx - p.px + kx * p.dx;
+          if (ix < 0 || ix >= p.W) continue;
+          acc += static_cast<AType>(wk[ky * p.kw + kx]) * static_cast<AType>(src[iy * p.W + ix]);
+        }
+      }
+    }
+    y[i] = DType(acc);
+  }
+}
+
+template<typename DType>
+__global__ void GroupConvBackwardDataKernel(GroupConvShape p, const DType *gy, const DType *w,
+                                            DType *gx, bool addto) {
+  typedef typename AccType<DType>::type AType;
+  const int size = p.N * p.C * p.H * p.W;
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < size; i += blockDim.x * gridDim.x) {
+    const int ix = i % p.W, iy = (i / p.W) % p.H;
+    const int ci = (i / (p.W * p.H)) % p.C, n = i / (p.W * p.H * p.C);
+    const int g = ci / p.cpg, c = ci % p.cpg;
+    AType acc = 0;
+    for (int kk = 0; kk < p.kpg; ++kk) {
+      const int k = g * p.kpg + kk;
+      const DType *src = gy + (static_cast<size_t>(n) * p.K + k) * p.Ho * p.Wo;
+      const DType *wk = w + (static_cast<size_t>(k) * p.cpg + c) * p.kh * p.kw;
+      for (int ky = 0; ky < p.kh; ++ky) {
+        const int ty = iy + p.py - ky * p.dy;
+        if (ty < 0 || ty % p.sy != 0 || ty / p.sy >= p.Ho) continue;
+        for (int kx = 0; kx < p.kw; ++kx) {
+          const int tx = ix + p.px - kx * p.dx;
+          if (tx < 0 || tx % p.sx != 0 || tx / p.sx >= p.Wo) continue;
+          acc += static_cast<AType>(wk[ky * p.kw + kx]) *
+                 static_cast<AType>(src[(ty / p.sy) * p.Wo + tx / p.sx]);
+        }
+      }
+    }
+    gx[i] = addto ? DType(static_cast<AType>(gx[i]) + acc) : DType(acc);
+  }
+}
+
+/*! \brief sum of the values of the threads of a block, valid in thread 0 */
+template<typename AType>
+__device__ AType GroupConvBlockSum(AType val) {
+  __shared__ AType buf[mshadow::cuda::kBaseThreadNum];
+  buf[threadIdx.x] = val;
+  __syncthreads();
+  for (int offset = blockDim.x / 2; offset > 0; offset >>= 1) {
+    if (threadIdx.x < offset) buf[threadIdx.x] += buf[threadIdx.x + offset];
+    __syncthreads();
+  }
+  AType sum = buf[0];
+  __syncthreads();
+  return sum;
+}
+
+/*! \brief one block per weight, the threads sum over the batch and the positions */
+template<typename DType>
+__global__ void GroupConvBackwardWeightKernel(GroupConvShape p, const DType *gy, const DType *x,
+                                              DType *gw, bool addto) {
+  typedef typename AccType<DType>::type AType;
+  const int ohw = p.Ho * p.Wo;
+  for (int e = blockIdx.x; e < p.K * p.cpg * p.kh * p.kw; e += gridDim.x) {
+    const int kx = e % p.kw, ky = (e / p.kw) % p.kh;
+    const int c = (e / (p.kw * p.kh)) % p.cpg, k = e / (p.kw * p.kh * p.cpg);
+    const int g = k / p.kpg;
+    AType acc = 0;
+    for (int j = threadIdx.x; j < p.N * ohw; j += blockDim.x) {
+      const int n = j / ohw, oy = (j % ohw) / p.Wo, ox = j % p.Wo;
+      const int iy = oy * p.sy - p.py + ky * p.dy, ix = ox * p.sx - p.px + kx * p.dx;
+      if (iy < 0 || iy >= p.H || ix < 0 || ix >= p.W) continue;
+      acc += static_cast<AType>(gy[(static_cast<size_t>(n) * p.K + k) * ohw + oy * p.Wo + ox]) *
+             static_cast<AType>(x[((static_cast<size_t>(n) * p.C + g * p.cpg + c) * p.H + iy)
+                                  * p.W + ix]);
+    }
+    acc = GroupConvBlockSum(acc);
+    if (threadIdx.x == 0) gw[e] = addto ? DType(static_cast<AType>(gw[e]) + acc) : DType(acc);
+  }
+}
+
+/*! \brief one block per output channel */
+template<typename DType>
+__global__ void GroupConvBackwardBiasKernel(GroupConvShape p, const DType *gy,
+                                            DType *gbias, bool addto) {
+  typedef typename AccType<DType>::type AType;
+  const int ohw = p.Ho * p.Wo;
+  for (int k = blockIdx.x; k < p.K; k += gridDim.x) {
+    AType acc = 0;
+    for (int j = threadIdx.x; j < p.N * ohw; j += blockDim.x) {
+      acc += static_cast<AType>(gy[(static_cast<size_t>(j / ohw) * p.K + k) * ohw + j % ohw]);
+    }
+    acc = GroupConvBlockSum(acc);
+    if (threadIdx.x == 0) gbias[k] = addto ? DType(static_cast<AType>(gbias[k]) + acc) : DType(acc);
+  }
+}
+
+/*! \brief number of blocks of kBaseThreadNum threads for size elements */
+inline int GroupConvGrid(int size) {
+  using namespace mshadow::cuda;
+  return std::max(1, std::min(kMaxGridNum, (size + kBaseThreadNum - 1) / kBaseThreadNum));
+}
+
+template<typename DType>
+inline void GroupConvForward(mshadow::Stream<gpu> *s, const GroupConvShape &p,
+                             const DType *x, const DType *w, const DType *bias, DType *y) {
+  using namespace mshadow::cuda;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  GroupConvForwardKernel<DType>
+      <<<GroupConvGrid(p.N * p.K * p.Ho * p.Wo), kBaseThreadNum, 0, stream>>>(p, x, w, bias, y);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+template<typename DType>
+inline void GroupConvBackwardData(mshadow::Stream<gpu> *s, const GroupConvShape &p,
+                                  const DType *gy, const DType *w, DType *gx, bool addto) {
+  using namespace mshadow::cuda;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  GroupConvBackwardDataKernel<DType>
+      <<<GroupConvGrid(p.N * p.C * p.H * p.W), kBaseThreadNum, 0, stream>>>(p, gy, w, gx, addto);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+template<typename DType>
+inline void GroupConvBackwardWeight(mshadow::Stream<gpu> *s, const GroupConvShape &p,
+                                    const DType *gy, const DType *x,
+                                    DType *gw, OpReqType req_w,
+                                    DType *gbias, OpReqType req_b) {
+  using namespace mshadow::cuda;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  if (req_w != kNullOp) {
+    const int nweight = p.K * p.cpg * p.kh * p.kw;
+    GroupConvBackwardWeightKernel<DType>
+        <<<std::min(nweight, kMaxGridNum), kBaseThreadNum, 0, stream>>>(
+            p, gy, x, gw, req_w == kAddTo);
+  }
+  if (gbias != NULL && req_b != kNullOp) {
+    GroupConvBackwardBiasKernel<DType>
+        <<<std::min(p.K, kMaxGridNum), kBaseThreadNum, 0, stream>>>(
+            p, gy, gbias, req_b == kAddTo);
+  }
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace groupconv
+
+/*!
+ * \brief whether the direct kernels run the convolution: 2D with more than one
+ *  group and at most kMaxGroupChannels input channels per group.
+ */
+inline bool UseGroupConvolution(const ConvolutionParam &param, const TShape &dshape) {
+  return param.kernel.ndim() == 2 && param.num_group > 1 &&
+         dshape[1] / param.num_group <= groupconv::kMaxGroupChannels &&
+         dmlc::GetEnv("MXNET_GROUP_CONV_OPT", true);
+}
+
+template<typename xpu, typename DType>
+class GroupConvolutionOp : public ConvolutionOp<xpu, DType> {
+ public:
+  explicit GroupConvolutionOp(ConvolutionParam p)
+      : ConvolutionOp<xpu, DType>(p) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    const ConvolutionParam &param = this->param_;
+    CHECK_EQ(req[conv::kOut], kWriteTo);
+    size_t expected = param.no_bias ? 2 : 3;
+    CHECK_EQ(in_data.size(), expected);
+    CHECK_EQ(out_data.size(), 1);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 4, DType> data = in_data[conv::kData].get<xpu, 4, DType>(s);
+    Tensor<xpu, 4, DType> out = out_data[conv::kOut].get<xpu, 4, DType>(s);
+    CHECK_EQ(in_data[conv::kWeight].CheckContiguous(), true);
+    const DType *bias = param.no_bias ? NULL :
+        static_cast<const DType*>(in_data[conv::kBias].dptr_);
+    groupconv::GroupConvForward(s, GetShape(data.shape_, out.shape_), data.dptr_,
+                                static_cast<const DType*>(in_data[conv::kWeight].dptr_),
+                                bias, out.dptr_);
+    if (param.act_type != conv::kActNone) {
+      FusedActivation(Tensor<xpu, 1, DType>(out.dptr_, Shape1(out.shape_.Size()), s),
+                      param.act_type);
+    }
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    const ConvolutionParam &param = this->param_;
+    CHECK_EQ(param.act_type, conv::kActNone)
+        << "Convolution with a fused activation is inference only";
+    CHECK_EQ(out_grad.size(), 1);
+    size_t expected = param.no_bias == 0 ? 3 : 2;
+    CHECK(in_data.size() == expected && in_grad.size() == expected);
+    CHECK_EQ(req.size(), expected);
+    CHECK_EQ(in_data[conv::kWeight].CheckContiguous(), true);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 4, DType> data = in_data[conv::kData].get<xpu, 4, DType>(s);
+    Tensor<xpu, 4, DType> grad = out_grad[conv::kOut].get<xpu, 4, DType>(s);
+    const groupconv::GroupConvShape p = GetShape(data.shape_, grad.shape_);
+    if (req[conv::kData] != kNullOp) {
+      Tensor<xpu, 4, DType> gdata = in_grad[conv::kData].get<xpu, 4, DType>(s);
+      groupconv::GroupConvBackwardData(s, p, grad.dptr_,
+                                       static_cast<const DType*>(in_data[conv::kWeight].dptr_),
+                                       gdata.dptr_, req[conv::kData] == kAddTo);
+    }
+    DType *gbias = param.no_bias ? NULL : static_cast<DType*>(in_grad[conv::kBias].dptr_);
+    groupconv::GroupConvBackwardWeight(s, p, grad.dptr_, data.dptr_,
+                                       static_cast<DType*>(in_grad[conv::kWeight].dptr_),
+                                       req[conv::kWeight], gbias,
+                                       param.no_bias ? kNullOp : req[conv::kBias]);
+  }
+
+ private:
+  inline groupconv::GroupConvShape GetShape(const mshadow::Shape<4> &ishape,
+                                            const mshadow::Shape<4> &oshape) const {
+    const ConvolutionParam &param = this->param_;
+    groupconv::GroupConvShape p;
+    p.N = ishape[0]; p.C = ishape[1]; p.H = ishape[2]; p.W = ishape[3];
+    p.K = oshape[1]; p.Ho = oshape[2]; p.Wo = oshape[3];
+    p.cpg = p.C / param.num_group;
+    p.kpg = p.K / param.num_group;
+    p.kh = param.kernel[0]; p.kw = param.kernel[1];
+    p.sy = param.stride[0]; p.sx = param.stride[1];
+    p.py = param.pad[0]; p.px = param.pad[1];
+    p.dy = param.dilate[0]; p.dx = param.dilate[1];
+    return p;
+  }
+};  // class GroupConvolutionOp
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_GROUP_CONVOLUTION_INL_H_
@@ -0,0 +1,78 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file image_normalize-inl.h
+ * \brief normalization of a batch of uint8 images on the device, the same as
+ *  the one of ImageNormalizeIter on cpu.
+ */
+#ifndef MXNET_OPERATOR_IMAGE_NORMALIZE_INL_H_
+#define MXNET_OPERATOR_IMAGE_NORMALIZE_INL_H_
+
+#include <dmlc/logging.h>
+#include <mshadow/tensor.h>
+#include <mxnet/base.h>
+#include <algorithm>
+
+namespace mxnet {
+namespace op {
+namespace image {
+/*!
+ * \brief dst[n] = src[n] - mean, mirrored on the width when flip[n] != 0
+ * \param dst output of shape (N, C, H, W)
+ * \param src the uint8 images of shape (N, C, H, W)
+ * \param mean the mean image of shape (C, H, W)
+ * \param flip whether to mirror each image, of shape (N)
+ */
+inline void Normalize(mshadow::Tensor<mshadow::cpu, 4, real_t> dst,
+                      const mshadow::Tensor<mshadow::cpu, 4, uint8_t> &src,
+                      const mshadow::Tensor<mshadow::cpu, 3, real_t> &mean,
+                      const mshadow::Tensor<mshadow::cpu, 1, real_t> &flip) {
+  const index_t width = dst.size(3);
+  const int nimg = static_cast<int>(dst.size(0));
+  #pragma omp parallel for schedule(static)
+  for (int n = 0; n < nimg; ++n) {
+    const bool mirror = flip[n] != 0.0f;
+    for (index_t c = 0; c < dst.size(1); ++c) {
+      for (index_t h = 0; h < dst.size(2); ++h) {
+        const uint8_t *in = src[n][c][h].dptr_;
+        const real_t *m = mean[c][h].dptr_;
+        real_t *out = dst[n][c][h].dptr_;
+        for (index_t w = 0; w < width; ++w) {
+          const index_t j = mirror ? width - 1 - w : w;
+          out[w] = static_cast<real_t>(in[j]) - m[j];
+        }
+      }
+    }
+  }
+}
+
+#ifdef __CUDACC__
+__global__ void NormalizeKernel(real_t *dst, const uint8_t *src, const real_t *mean,
+                                const real_t *flip, int width, int img_size, int count) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < count;
+       i += blockDim.x * gridDim.x) {
+    const int n = i / img_size, k = i % img_size, w = k % width;
+    const int j = flip[n] != 0.0f ? k - w + width - 1 - w : k;
+    dst[i] = static_cast<real_t>(src[n * img_size + j]) - mean[j];
+  }
+}
+
+inline void Normalize(mshadow::Tensor<mshadow::gpu, 4, real_t> dst,
+                      const mshadow::Tensor<mshadow::gpu, 4, uint8_t> &src,
+                      const mshadow::Tensor<mshadow::gpu, 3, real_t> &mean,
+                      const mshadow::Tensor<mshadow::gpu, 1, real_t> &flip) {
+  using namespace mshadow::cuda;
+  const int count = dst.shape_.Size();
+  if (count == 0) return;
+  const int grid = std::min(kMaxGridNum, (count + kBaseThreadNum - 1) / kBaseThreadNum);
+  cudaStream_t stream = mshadow::Stream<mshadow::gpu>::GetStream(dst.stream_);
+  NormalizeKernel<<<grid, kBaseThreadNum, 0, stream>>>(
+      dst.dptr_, src.dptr_, mean.dptr_, flip.dptr_, dst.size(3),
+      mean.shape_.Size(), count);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace image
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_IMAGE_NORMALIZE_INL_H_
@@ -0,0 +1,189 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file image_normalize_op-inl.h
+ * \brief ImageNormalize operator, normalizes uint8 images as the first node of a network.
+ */
+#ifndef MXNET_OPERATOR_IMAGE_NORMALIZE_OP_INL_H_
+#define MXNET_OPERATOR_IMAGE_NORMALIZE_OP_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./image_normalize-inl.h"
+#include "./mshadow_op.h"
+#include "./operator_common.h"
+
+namespace mxnet {
+namespace op {
+namespace image {
+enum ImageNormalizeOpInputs {kData};
+enum ImageNormalizeOpOutputs {kOut};
+enum ImageNormalizeOpResource {kTempSpace, kRandom};
+}  // namespace image
+
+struct ImageNormalizeOpParam : public dmlc::Parameter<ImageNormalizeOpParam> {
+  float mean_r;
+  float mean_g;
+  float mean_b;
+  float mean_a;
+  float scale;
+  bool mirror;
+  bool rand_mirror;
+  DMLC_DECLARE_PARAMETER(ImageNormalizeOpParam) {
+    DMLC_DECLARE_FIELD(mean_r).set_default(0.0f)
+    .describe("Mean value on R channel.");
+    DMLC_DECLARE_FIELD(mean_g).set_default(0.0f)
+    .describe("Mean value on G channel.");
+    DMLC_DECLARE_FIELD(mean_b).set_default(0.0f)
+    .describe("Mean value on B channel.");
+    DMLC_DECLARE_FIELD(mean_a).set_default(0.0f)
+    .describe("Mean value on Alpha channel.");
+    DMLC_DECLARE_FIELD(scale).set_default(1.0f)
+    .describe("Scale of the mean subtracted images.");
+    DMLC_DECLARE_FIELD(mirror).set_default(false)
+    .describe("Whether to mirror the images.");
+    DMLC_DECLARE_FIELD(rand_mirror).set_default(false)
+    .describe("Whether to mirror each image with probability 0.5 in training.");
+  }
+};
+
+/*!
+ * \brief convert the uint8 images of ImageRecordIter(dtype='uint8') to float32,
+ *  subtract the mean, mirror and scale them, as ImageRecordIter on cpu.
+ */
+template<typename xpu>
+class ImageNormalizeOp : public Operator {
+ public:
+  explicit ImageNormalizeOp(ImageNormalizeOpParam param) : param_(param) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    CHECK_EQ(in_data.size(), 1);
+    CHECK_EQ(out_data.size(), 1);
+    CHECK_EQ(req[image::kOut], kWriteTo);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 4, uint8_t> data = in_data[image::kData].get<xpu, 4, uint8_t>(s);
+    Tensor<xpu, 4, real_t> out = out_data[image::kOut].get<xpu, 4, real_t>(s);
+    const index_t nimg = data.size(0), nchannel = data.size(1);
+    const index_t img_size = data.size(1) * data.size(2) * data.size(3);
+    Tensor<xpu, 1, real_t> workspace = ctx.requested[image::kTempSpace]
+        .get_space_typed<xpu, 1, real_t>(Shape1(img_size + nimg), s);
+    Tensor<xpu, 3, real_t> mean(workspace.dptr_, Shape3(nchannel, data.size(2), data.size(3)), s);
+    Tensor<xpu, 1, real_t> flip(workspace.dptr_ + img_size, Shape1(nimg), s);
+    const float means[4] = {param_.mean_r, param_.mean_g, param_.mean_b, param_.mean_a};
+    for (index_t c = 0; c < nchannel; ++c) {
+      mean[c] = scalar<real_t>(c < 4 ? means[c] : 0.0f);
+    }
+    if (param_.mirror) {
+      flip = scalar<real_t>(1.0f);
+    } else if (param_.rand_mirror && ctx.is_train) {
+      Random<xpu> *prnd = ctx.requested[image::kRandom].get_random<xpu, real_t>(s);
+      prnd->SampleUniform(&flip, 0.0f, 1.0f);
+      flip = F<mshadow_op::threshold>(flip, scalar<real_t>(0.5f));
+    } else {
+      flip = scalar<real_t>(0.0f);
+    }
+    image::Normalize(out, data, mean, flip);
+    if (param_.scale != 1.0f) {
+      out *= scalar<real_t>(param_.scale);
+    }
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    // the images have no gradient
+    CHECK_EQ(in_grad.size(), 1);
+    if (req[image::kData] == kNullOp || req[image::kData] == kAddTo) return;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 2, uint8_t> grad = in_grad[image::kData].FlatTo2D<xpu, uint8_t>(s);
+    grad = scalar<uint8_t>(0);
+  }
+
+ private:
+  ImageNormalizeOpParam param_;
+};  // class ImageNormalizeOp
+
+template<typename xpu>
+Operator* CreateOp(ImageNormalizeOpParam param);
+
+#if DMLC_USE_CXX11
+class ImageNormalizeProp : public OperatorProperty {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    CHECK_EQ(in_shape->size(), 1) << "Input:[data]";
+    const TShape &dshape = in_shape->at(image::kData);
+    if (dshape.ndim() == 0) return false;
+    CHECK_EQ(dshape.ndim(), 4) << "ImageNormalize: data must be (batch, channel, height, width)";
+    out_shape->clear();
+    out_shape->push_back(dshape);
+    return true;
+  }
+
+  bool InferType(std::vector<int> *in_type,
+                 std::vector<int> *out_type,
+                 std::vector<int> *aux_type) const override {
+    CHECK_EQ(in_type->size(), 1);
+    if ((*in_type)[0] == -1) (*in_type)[0] = mshadow::kUint8;
+    CHECK_EQ((*in_type)[0], mshadow::kUint8) << "ImageNormalize: data must be uint8";
+    out_type->clear();
+    out_type->push_back(mshadow::kFloat32);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new ImageNormalizeProp();
+    ptr->param_ = param_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "ImageNormalize";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    return {};
+  }
+
+  std::vector<ResourceRequest> ForwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace, ResourceRequest::kRandom};
+  }
+
+  Operator* CreateOperator(Context ctx) const override;
+
+ private:
+  ImageNormalizeOpParam param_;
+};
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_IMAGE_NORMALIZE_OP_INL_H_
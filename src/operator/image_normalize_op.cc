@@ -0,0 +1,30 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file image_normalize_op.cc
+ * \brief ImageNormalize operator
+*/
+#include "./image_normalize_op-inl.h"
+
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<cpu>(ImageNormalizeOpParam param) {
+  return new ImageNormalizeOp<cpu>(param);
+}
+
+// DO_BIND_DISPATCH comes from operator_common.h
+Operator *ImageNormalizeProp::CreateOperator(Context ctx) const {
+  DO_BIND_DISPATCH(CreateOp, param_);
+}
+
+DMLC_REGISTER_PARAMETER(ImageNormalizeOpParam);
+
+MXNET_REGISTER_OP_PROPERTY(ImageNormalize, ImageNormalizeProp)
+.describe("Convert uint8 images of shape (batch, channel, height, width) to float32, "
+          "subtract the mean of each channel, mirror and scale them. It takes the "
+          "raw pixels of ImageRecordIter(dtype='uint8') on the device.")
+.add_argument("data", "Symbol", "The uint8 images.")
+.add_arguments(ImageNormalizeOpParam::__FIELDS__());
+
+}  // namespace op
+}  // namespace mxnet
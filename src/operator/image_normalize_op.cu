@@ -0,0 +1,15 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file image_normalize_op.cu
+ * \brief ImageNormalize operator
+*/
+#include "./image_normalize_op-inl.h"
+
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<gpu>(ImageNormalizeOpParam param) {
+  return new ImageNormalizeOp<gpu>(param);
+}
+}  // namespace op
+}  // namespace mxnet
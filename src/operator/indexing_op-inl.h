@@ -0,0 +1,481 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file indexing_op-inl.h
+ * \brief gather and scatter operators along an axis: take, batch_take and scatter_add
+ */
+#ifndef MXNET_OPERATOR_INDEXING_OP_INL_H_
+#define MXNET_OPERATOR_INDEXING_OP_INL_H_
+
+#include <dmlc/parameter.h>
+#include <mxnet/operator_util.h>
+#include <algorithm>
+#include "./mshadow_op.h"
+
+#if defined(__CUDACC__)
+#define XPU gpu
+#else
+#define XPU cpu
+#endif
+
+namespace mxnet {
+namespace op {
+
+namespace indexing {
+enum IndexMode {kClip, kWrap};
+
+/*! \brief the position of index v along an axis of n elements */
+template<typename DType>
+MSHADOW_XINLINE int GetIndex(DType v, int n, int mode) {
+  int i = static_cast<int>(v);
+  if (mode == kWrap) {
+    i %= n;
+    return i < 0 ? i + n : i;
+  }
+  return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+/*!
+ * \brief the arrays are viewed as (pre, axis, post), out (pre, nidx, post) takes
+ *  the elements of a (pre, dim, post) at the nidx indices along the axis
+ */
+template<typename DType>
+inline void Take(mshadow::Stream<cpu> *s, int pre, int dim, int nidx, int post, int mode,
+                 const DType *a, const DType *idx, DType *out, OpReqType req) {
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < pre * nidx; ++r) {
+    const int p = r / nidx, j = r % nidx;
+    const DType *src = a + (static_cast<size_t>(p) * dim + GetIndex(idx[j], dim, mode)) * post;
+    DType *dst = out + static_cast<size_t>(r) * post;
+    if (req == kAddTo) {
+      for (int k = 0; k < post; ++k) dst[k] += src[k];
+    } else {
+      std::copy(src, src + post, dst);
+    }
+  }
+}
+
+/*!
+ * \brief out (pre, dim, post) += the rows of data (pre, nidx, post) added at the nidx
+ *  indices along the axis. Each thread adds all the rows to a block of columns, in the
+ *  order of the indices, so the sums do not depend on the number of threads.
+ */
+template<typename DType>
+inline void ScatterAdd(mshadow::Stream<cpu> *s, const Resource &temp, int pre, int dim,
+                       int nidx, int post, int mode, const DType *data, const DType *idx,
+                       DType *out) {
+  const int kBlock = 64;
+  const int nblock = (post + kBlock - 1) / kBlock;
+  #pragma omp parallel for schedule(static)
+  for (int t = 0; t < pre * nblock; ++t) {
+    const int p = t / nblock, k0 = (t % nblock) * kBlock, k1 = std::min(k0 + kBlock, post);
+    for (int j = 0; j < nidx; ++j) {
+      const DType *src = data + (static_cast<size_t>(p) * nidx + j) * post;
+      DType *dst = out + (static_cast<size_t>(p) * dim + GetIndex(idx[j], dim, mode)) * post;
+      for (int k = k0; k < k1; ++k) dst[k] += src[k];
+    }
+  }
+}
+
+/*! \brief out[i] = a[i, idx[i]] of a (n, m) */
+template<typename DType>
+inline void BatchTake(mshadow::Stream<cpu> *s, int n, int m, const DType *a, const DType *idx,
+                      DType *out, OpReqType req) {
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; ++i) {
+    const DType v = a[static_cast<size_t>(i) * m + GetIndex(idx[i], m, kClip)];
+    out[i] = req == kAddTo ? out[i] + v : v;
+  }
+}
+
+/*! \brief grad[i, idx[i]] += out_grad[i] */
+template<typename DType>
+inline void BatchTakeGrad(mshadow::Stream<cpu> *s, int n, int m, const DType *out_grad,
+                          const DType *idx, DType *grad) {
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; ++i) {
+    grad[static_cast<size_t>(i) * m + GetIndex(idx[i], m, kClip)] += out_grad[i];
+  }
+}
+
+#ifdef __CUDACC__
+template<typename DType>
+__global__ void TakeKernel(int pre, int dim, int nidx, int post, int mode, const DType *a,
+                           const DType *idx, DType *out, bool addto) {
+  const size_t size = static_cast<size_t>(pre) * nidx * post;
+  for (size_t e = blockIdx.x * blockDim.x + threadIdx.x; e < size;
+       e += gridDim.x * blockDim.x) {
+    const int k = e % post, j = (e / post) % nidx, p = e / (static_cast<size_t>(post) * nidx);
+    const DType v = a[(static_cast<size_t>(p) * dim + GetIndex(idx[j], dim, mode)) * post + k];
+    out[e] = addto ? out[e] + v : v;
+  }
+}
+
+template<typename DType>
+__global__ void ScatterKeysKernel(int nidx, int dim, int mode, const DType *idx, int *keys,
+                                  int *pos) {
+  for (int j = blockIdx.x * blockDim.x + threadIdx.x; j < nidx; j += gridDim.x * blockDim.x) {
+    keys[j] = GetIndex(idx[j], dim, mode);
+    pos[j] = j;
+  }
+}
+
+/*!
+ * \brief the thread of the first of each run of equal sorted keys sums the rows of the
+ *  run in their original order, so the result is deterministic
+ */
+template<typename DType>
+__global__ void ScatterAddSortedKernel(int pre, int dim, int nidx, int post, const DType *data,
+                                       const int *keys, const int *pos, DType *out) {
+  const size_t size = static_cast<size_t>(pre) * nidx * post;
+  for (size_t e = blockIdx.x * blockDim.x + threadIdx.x; e < size;
+       e += gridDim.x * blockDim.x) {
+    const int k = e % post, i = (e / post) % nidx, p = e / (static_cast<size_t>(post) * nidx);
+    if (i > 0 && keys[i] == keys[i - 1]) continue;
+    const DType *src = data + static_cast<size_t>(p) * nidx * post + k;
+    DType sum = src[static_cast<size_t>(pos[i]) * post];
+    for (int j = i + 1; j < nidx && keys[j] == keys[i]; ++j) {
+      sum += src[static_cast<size_t>(pos[j]) * post];
+    }
+    out[(static_cast<size_t>(p) * dim + keys[i]) * post + k] += sum;
+  }
+}
+
+template<typename DType>
+__global__ void BatchTakeKernel(int n, int m, const DType *a, const DType *idx, DType *out,
+                                bool addto) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < n; i += gridDim.x * blockDim.x) {
+    const DType v = a[static_cast<size_t>(i) * m + GetIndex(idx[i], m, kClip)];
+    out[i] = addto ? out[i] + v : v;
+  }
+}
+
+template<typename DType>
+__global__ void BatchTakeGradKernel(int n, int m, const DType *out_grad, const DType *idx,
+                                    DType *grad) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < n; i += gridDim.x * blockDim.x) {
+    grad[static_cast<size_t>(i) * m + GetIndex(idx[i], m, kClip)] += out_grad[i];
+  }
+}
+
+inline int NumBlocks(size_t threads) {
+  using namespace mshadow::cuda;
+  return static_cast<int>(std::min<size_t>((threads + kBaseThreadNum - 1) / kBaseThreadNum,
+                                           kMaxGridNum));
+}
+
+inline void CheckLaunch() {
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+template<typename DType>
+inline void Take(mshadow::Stream<gpu> *s, int pre, int dim, int nidx, int post, int mode,
+                 const DType *a, const DType *idx, DType *out, OpReqType req) {
+  const size_t size = static_cast<size_t>(pre) * nidx * post;
+  if (size == 0) return;
+  TakeKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0,
+               mshadow::Stream<gpu>::GetStream(s)>>>(pre, dim, nidx, post, mode, a, idx, out,
+                                                     req == kAddTo);
+  CheckLaunch();
+}
+
+/*!
+ * \brief the indices are sorted with SortByKey, as in the gradient of Embedding, and
+ *  the rows of each index summed by one thread instead of with atomic adds
+ */
+template<typename DType>
+inline void ScatterAdd(mshadow::Stream<gpu> *s, const Resource &temp, int pre, int dim,
+                       int nidx, int post, int mode, const DType *data, const DType *idx,
+                       DType *out) {
+  using namespace mshadow;
+  if (static_cast<size_t>(pre) * nidx * post == 0) return;
+  Tensor<gpu, 2, int> workspace =
+      temp.get_space_typed<gpu, 2, int>(Shape2(2, nidx), s);
+  Tensor<gpu, 1, int> keys = workspace[0];
+  Tensor<gpu, 1, int> pos = workspace[1];
+  cudaStream_t stream = Stream<gpu>::GetStream(s);
+  ScatterKeysKernel<<<NumBlocks(nidx), cuda::kBaseThreadNum, 0, stream>>>(
+      nidx, dim, mode, idx, keys.dptr_, pos.dptr_);
+  CheckLaunch();
+  SortByKey(keys, pos, true);
+  ScatterAddSortedKernel<<<NumBlocks(static_cast<size_t>(pre) * nidx * post),
+                           cuda::kBaseThreadNum, 0, stream>>>(
+      pre, dim, nidx, post, data, keys.dptr_, pos.dptr_, out);
+  CheckLaunch();
+}
+
+template<typename DType>
+inline void BatchTake(mshadow::Stream<gpu> *s, int n, int m, const DType *a, const DType *idx,
+                      DType *out, OpReqType req) {
+  if (n == 0) return;
+  BatchTakeKernel<<<NumBlocks(n), mshadow::cuda::kBaseThreadNum, 0,
+                    mshadow::Stream<gpu>::GetStream(s)>>>(n, m, a, idx, out, req == kAddTo);
+  CheckLaunch();
+}
+
+template<typename DType>
+inline void BatchTakeGrad(mshadow::Stream<gpu> *s, int n, int m, const DType *out_grad,
+                          const DType *idx, DType *grad) {
+  if (n == 0) return;
+  BatchTakeGradKernel<<<NumBlocks(n), mshadow::cuda::kBaseThreadNum, 0,
+                        mshadow::Stream<gpu>::GetStream(s)>>>(n, m, out_grad, idx, grad);
+  CheckLaunch();
+}
+#endif  // __CUDACC__
+}  // namespace indexing
+
+struct TakeParam : public dmlc::Parameter<TakeParam> {
+  int axis;
+  int mode;
+  DMLC_DECLARE_PARAMETER(TakeParam) {
+    DMLC_DECLARE_FIELD(axis).set_default(0)
+    .describe("The axis of the elements taken, negative counts from the last axis.");
+    DMLC_DECLARE_FIELD(mode).set_default(indexing::kClip)
+    .add_enum("clip", indexing::kClip)
+    .add_enum("wrap", indexing::kWrap)
+    .describe("How out of range indices are handled, clipped to the axis or wrapped around.");
+  }
+};
+
+struct ScatterAddParam : public dmlc::Parameter<ScatterAddParam> {
+  int axis;
+  int axis_size;
+  int mode;
+  DMLC_DECLARE_PARAMETER(ScatterAddParam) {
+    DMLC_DECLARE_FIELD(axis).set_default(0)
+    .describe("The axis of the output the elements are added along, the axes of the "
+              "indices start there in data.");
+    DMLC_DECLARE_FIELD(axis_size).set_lower_bound(1)
+    .describe("The size of the axis of the output.");
+    DMLC_DECLARE_FIELD(mode).set_default(indexing::kClip)
+    .add_enum("clip", indexing::kClip)
+    .add_enum("wrap", indexing::kWrap)
+    .describe("How out of range indices are handled, clipped to the axis or wrapped around.");
+  }
+};
+
+inline int NormalizeAxis(int axis, int ndim) {
+  CHECK(axis >= -ndim && axis < ndim) << "axis " << axis << " out of range for "
+                                      << ndim << " dims";
+  return axis < 0 ? axis + ndim : axis;
+}
+
+inline TShape TakeShape(const TShape& ashape,
+                        const TShape& ishape,
+                        const EnvArguments& env) {
+  TakeParam param;
+  param.Init(env.kwargs);
+  const int axis = NormalizeAxis(param.axis, ashape.ndim());
+  CHECK_GT(ashape[axis], 0U) << "take from an empty axis";
+  std::vector<index_t> ret(ashape.data(), ashape.data() + axis);
+  ret.insert(ret.end(), ishape.data(), ishape.data() + ishape.ndim());
+  ret.insert(ret.end(), ashape.data() + axis + 1, ashape.data() + ashape.ndim());
+  return TShape(ret.begin(), ret.end());
+}
+
+/*! \brief a TShape as the (pre, axis, post) sizes around len axes from axis */
+inline void SplitShape(const TShape &shape, int axis, int len, int *pre, int *post) {
+  *pre = static_cast<int>(shape.ProdShape(0, axis));
+  *post = static_cast<int>(shape.ProdShape(axis + len, shape.ndim()));
+}
+
+template<typename xpu>
+void TakeForward_(const TBlob& a,
+                  const TBlob& idx,
+                  const EnvArguments& env,
+                  TBlob *ret,
+                  OpReqType req,
+                  RunContext ctx) {
+  if (req == kNullOp) return;
+  TakeParam param;
+  param.Init(env.kwargs);
+  const int axis = NormalizeAxis(param.axis, a.shape_.ndim());
+  int pre, post;
+  SplitShape(a.shape_, axis, 1, &pre, &post);
+  MSHADOW_REAL_TYPE_SWITCH(ret->type_flag_, DType, {
+    indexing::Take(ctx.get_stream<xpu>(), pre, static_cast<int>(a.shape_[axis]),
+                   static_cast<int>(idx.Size()), post, param.mode, a.dptr<DType>(),
+                   idx.dptr<DType>(), ret->dptr<DType>(), req);
+  });
+}
+
+/*! \brief zero a gradient written with kWriteTo, before it is added to */
+template<typename xpu, typename DType>
+inline void ZeroGrad(mshadow::Stream<xpu> *s, TBlob *grad, OpReqType req) {
+  if (req != kWriteTo && req != kWriteInplace) return;
+  mshadow::Tensor<xpu, 1, DType> g = grad->FlatTo1D<xpu, DType>(s);
+  g = DType(0);
+}
+
+template<typename xpu>
+void TakeBackward_(const OutputGrad& out_grad,
+                   const Input0& a,
+                   const Input1& idx,
+                   const EnvArguments& env,
+                   TBlob* a_grad,
+                   TBlob* idx_grad,
+                   OpReqType req_a_grad,
+                   OpReqType req_idx_grad,
+                   RunContext ctx) {
+  TakeParam param;
+  param.Init(env.kwargs);
+  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+  const int axis = NormalizeAxis(param.axis, a.data.shape_.ndim());
+  int pre, post;
+  SplitShape(a.data.shape_, axis, 1, &pre, &post);
+  MSHADOW_REAL_TYPE_SWITCH(a_grad->type_flag_, DType, {
+    // the indices have no gradient
+    if (req_idx_grad != kNullOp) ZeroGrad<xpu, DType>(s, idx_grad, req_idx_grad);
+    if (req_a_grad != kNullOp) {
+      ZeroGrad<xpu, DType>(s, a_grad, req_a_grad);
+      indexing::ScatterAdd(s, env.resource[0], pre, static_cast<int>(a.data.shape_[axis]),
+                           static_cast<int>(idx.data.Size()), post, param.mode,
+                           out_grad.data.dptr<DType>(), idx.data.dptr<DType>(),
+                           a_grad->dptr<DType>());
+    }
+  });
+}
+
+inline TShape ScatterAddShape(const TShape& dshape,
+                              const TShape& ishape,
+                              const EnvArguments& env) {
+  ScatterAddParam param;
+  param.Init(env.kwargs);
+  const int axis = param.axis;
+  CHECK(axis >= 0 && axis + ishape.ndim() <= dshape.ndim())
+      << "scatter_add: the indices " << ishape << " do not fit in data " << dshape
+      << " from axis " << axis;
+  for (index_t i = 0; i < ishape.ndim(); ++i) {
+    CHECK_EQ(dshape[axis + i], ishape[i])
+        << "scatter_add: the indices " << ishape << " do not match data " << dshape
+        << " from axis " << axis;
+  }
+  std::vector<index_t> ret(dshape.data(), dshape.data() + axis);
+  ret.push_back(param.axis_size);
+  ret.insert(ret.end(), dshape.data() + axis + ishape.ndim(), dshape.data() + dshape.ndim());
+  return TShape(ret.begin(), ret.end());
+}
+
+template<typename xpu>
+void ScatterAddForward_(const TBlob& data,
+                        const TBlob& idx,
+                        const EnvArguments& env,
+                        TBlob *ret,
+                        OpReqType req,
+                        RunContext ctx) {
+  if (req == kNullOp) return;
+  ScatterAddParam param;
+  param.Init(env.kwargs);
+  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+  int pre, post;
+  SplitShape(data.shape_, param.axis, idx.shape_.ndim(), &pre, &post);
+  MSHADOW_REAL_TYPE_SWITCH(ret->type_flag_, DType, {
+    ZeroGrad<xpu, DType>(s, ret, req);
+    indexing::ScatterAdd(s, env.resource[0], pre, param.axis_size,
+                         static_cast<int>(idx.Size()), post, param.mode,
+                         data.dptr<DType>(), idx.dptr<DType>(), ret->dptr<DType>());
+  });
+}
+
+template<typename xpu>
+void ScatterAddBackward_(const OutputGrad& out_grad,
+                         const Input0& data,
+                         const Input1& idx,
+                         const EnvArguments& env,
+                         TBlob* data_grad,
+                         TBlob* idx_grad,
+                         OpReqType req_data_grad,
+                         OpReqType req_idx_grad,
+                         RunContext ctx) {
+  ScatterAddParam param;
+  param.Init(env.kwargs);
+  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+  int pre, post;
+  SplitShape(data.data.shape_, param.axis, idx.data.shape_.ndim(), &pre, &post);
+  MSHADOW_REAL_TYPE_SWITCH(data_grad->type_flag_, DType, {
+    if (req_idx_grad != kNullOp) ZeroGrad<xpu, DType>(s, idx_grad, req_idx_grad);
+    if (req_data_grad != kNullOp) {
+      indexing::Take(s, pre, param.axis_size, static_cast<int>(idx.data.Size()), post,
+                     param.mode, out_grad.data.dptr<DType>(), idx.data.dptr<DType>(),
+                     data_grad->dptr<DType>(), req_data_grad);
+    }
+  });
+}
+
+inline TShape BatchTakeShape(const TShape& ashape,
+                             const TShape& ishape,
+                             const EnvArguments& env) {
+  CHECK_EQ(ashape.ndim(), 2U) << "batch_take only accepts 2D data";
+  CHECK_EQ(ishape.ndim(), 1U) << "batch_take only accepts 1D indices";
+  CHECK_EQ(ashape[0], ishape[0]) << "batch_take: data " << ashape << " and indices "
+                                 << ishape << " mismatch";
+  return TShape(ishape);
+}
+
+template<typename xpu>
+void BatchTakeForward_(const TBlob& a,
+                       const TBlob& idx,
+                       const EnvArguments& env,
+                       TBlob *ret,
+                       OpReqType req,
+                       RunContext ctx) {
+  if (req == kNullOp) return;
+  MSHADOW_REAL_TYPE_SWITCH(ret->type_flag_, DType, {
+    indexing::BatchTake(ctx.get_stream<xpu>(), static_cast<int>(a.shape_[0]),
+                        static_cast<int>(a.shape_[1]), a.dptr<DType>(), idx.dptr<DType>(),
+                        ret->dptr<DType>(), req);
+  });
+}
+
+template<typename xpu>
+void BatchTakeBackward_(const OutputGrad& out_grad,
+                        const Input0& a,
+                        const Input1& idx,
+                        const EnvArguments& env,
+                        TBlob* a_grad,
+                        TBlob* idx_grad,
+                        OpReqType req_a_grad,
+                        OpReqType req_idx_grad,
+                        RunContext ctx) {
+  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+  MSHADOW_REAL_TYPE_SWITCH(a_grad->type_flag_, DType, {
+    if (req_idx_grad != kNullOp) ZeroGrad<xpu, DType>(s, idx_grad, req_idx_grad);
+    if (req_a_grad != kNullOp) {
+      ZeroGrad<xpu, DType>(s, a_grad, req_a_grad);
+      indexing::BatchTakeGrad(s, static_cast<int>(a.data.shape_[0]),
+                              static_cast<int>(a.data.shape_[1]), out_grad.data.dptr<DType>(),
+                              idx.data.dptr<DType>(), a_grad->dptr<DType>());
+    }
+  });
+}
+
+MXNET_REGISTER_SIMPLE_OP(take, XPU)
+.set_enable_kwargs(true)
+.set_function(XPU::kDevMask, TakeForward_<XPU>, kNoInplace, kRegisterSymbolic)
+.set_shape_function(TakeShape)
+.set_gradient(XPU::kDevMask, TakeBackward_<XPU>, kNoInplace)
+.set_resource_request(ResourceRequest::kTempSpace)
+.describe("Take the elements of lhs at the indices rhs along an axis, the axis is "
+          "replaced by the axes of the indices. The gradient is added at the indices.")
+.add_arguments(TakeParam::__FIELDS__());
+
+MXNET_REGISTER_SIMPLE_OP(batch_take, XPU)
+.set_function(XPU::kDevMask, BatchTakeForward_<XPU>, kNoInplace, kRegisterSymbolic)
+.set_shape_function(BatchTakeShape)
+.set_gradient(XPU::kDevMask, BatchTakeBackward_<XPU>, kNoInplace)
+.describe("Take one element of each row of the 2D lhs, at the index of the row in the "
+          "1D rhs. The indices are clipped to the rows.");
+
+MXNET_REGISTER_SIMPLE_OP(scatter_add, XPU)
+.set_enable_kwargs(true)
+.set_function(XPU::kDevMask, ScatterAddForward_<XPU>, kNoInplace, kRegisterSymbolic)
+.set_shape_function(ScatterAddShape)
+.set_gradient(XPU::kDevMask, ScatterAddBackward_<XPU>, kNoInplace)
+.set_resource_request(ResourceRequest::kTempSpace)
+.describe("Add the elements of lhs to a zero output at the indices rhs along an axis, "
+          "the reverse of take: the axes of the indices in lhs from axis are replaced by "
+          "one axis of axis_size. The sums are deterministic.")
+.add_arguments(ScatterAddParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_INDEXING_OP_INL_H_
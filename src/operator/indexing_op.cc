@@ -0,0 +1,14 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file indexing_op.cc
+ * \brief CPU Implementation of the gather and scatter operators
+ */
+// this will be invoked by gcc and compile CPU version
+#include "./indexing_op-inl.h"
+
+namespace mxnet {
+namespace op {
+DMLC_REGISTER_PARAMETER(TakeParam);
+DMLC_REGISTER_PARAMETER(ScatterAddParam);
+}  // op
+}  // mxnet
@@ -0,0 +1,7 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file indexing_op.cu
+ * \brief GPU Implementation of the gather and scatter operators
+ */
+// this will be invoked by nvcc and compile GPU version
+#include "./indexing_op-inl.h"
@@ -15,6 +15,7 @@
 #include <utility>
 #include "./operator_common.h"
 #include "./mshadow_op.h"
+#include "./row_norm_kernel-inl.h"
 
 namespace mxnet {
 namespace op {
@@ -24,7 +25,6 @@ namespace op {
 namespace l2_normalization {
 enum L2NormalizationOpInputs {kData};
 enum L2NormalizationOpOutputs {kOut, kNorm};
-enum L2NormalizationBackResource {kTempSpace};
 }  // l2_normalization
 
 struct L2NormalizationParam : public dmlc::Parameter<L2NormalizationParam> {
@@ -36,7 +36,9 @@ struct L2NormalizationParam : public dmlc::Parameter<L2NormalizationParam> {
 };
 
 /**
- * \brief This is the implementation of l2 normalization operator.
+ * \brief This is the implementation of l2 normalization operator. Each instance is
+ *  normalized by one fused kernel, which sums its squares and scales it, and the
+ *  backward by another, see row_norm_kernel-inl.h.
  * \tparam xpu The device that the op will be executed on.
  */
 template<typename xpu>
@@ -61,9 +63,9 @@ class L2NormalizationOp : public Operator {
     Tensor<xpu, 2> data = in_data[l2_normalization::kData].FlatTo2D<xpu, real_t>(s);
     Tensor<xpu, 2> out = out_data[l2_normalization::kOut].FlatTo2D<xpu, real_t>(s);
     Tensor<xpu, 1> norm = out_data[l2_normalization::kNorm].get<xpu, 1, real_t>(s);
-    norm = sumall_except_dim<0>(F<mxnet::op::mshadow_op::square>(data));
-    norm = F<mxnet::op::mshadow_op::square_root>(norm);
-    out = data / broadcast<0>(norm + param_.eps, out.shape_);
+    CHECK(data.CheckContiguous() && out.CheckContiguous());
+    rownorm::L2NormForward(s, data.dptr_, data.size(0), data.size(1), param_.eps,
+                           out.dptr_, norm.dptr_);
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -78,20 +80,17 @@ class L2NormalizationOp : public Operator {
     CHECK_EQ(out_grad.size(), 1);
     CHECK(in_data.size() == 1 && in_grad.size() == 1);
     CHECK_EQ(req.size(), 1);
+    if (req[l2_normalization::kData] == kNullOp) return;
 
     Stream<xpu> *s = ctx.get_stream<xpu>();
     Tensor<xpu, 2> data = out_data[l2_normalization::kOut].FlatTo2D<xpu, real_t>(s);
     Tensor<xpu, 2> grad_in = in_grad[l2_normalization::kData].FlatTo2D<xpu, real_t>(s);
     Tensor<xpu, 2> grad_out = out_grad[l2_normalization::kOut].FlatTo2D<xpu, real_t>(s);
     Tensor<xpu, 1> norm = out_data[l2_normalization::kNorm].get<xpu, 1, real_t>(s);
-
-    Tensor<xpu, 1> temp = ctx.requested[l2_normalization::kTempSpace].get_space<xpu>(
-        mshadow::Shape1(data.shape_[0]), s);
-    temp = sumall_except_dim<0>(grad_out * data);
-
-    Assign(grad_in, req[l2_normalization::kData],
-      (grad_out - data * broadcast<0>(temp, data.shape_)) /
-      broadcast<0>(norm + param_.eps, data.shape_));
+    CHECK(data.CheckContiguous() && grad_in.CheckContiguous() && grad_out.CheckContiguous());
+    rownorm::L2NormBackward(s, grad_out.dptr_, data.dptr_, norm.dptr_,
+                            data.size(0), data.size(1), param_.eps, grad_in.dptr_,
+                            req[l2_normalization::kData] == kAddTo);
   }
 
  private:
@@ -167,11 +166,6 @@ class L2NormalizationProp : public OperatorProperty {
     return {{out_grad[l2_normalization::kOut], in_grad[l2_normalization::kData]}};
   }
 
-  std::vector<ResourceRequest> BackwardResource(
-      const std::vector<TShape> &in_shape) const override {
-    return {ResourceRequest::kTempSpace};
-  }
-
   Operator* CreateOperator(Context ctx) const override;
 
  private:
@@ -0,0 +1,189 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file layer_norm-inl.h
+ * \brief layer normalization over the last axis
+*/
+#ifndef MXNET_OPERATOR_LAYER_NORM_INL_H_
+#define MXNET_OPERATOR_LAYER_NORM_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <map>
+#include <vector>
+#include <string>
+#include <utility>
+#include "./operator_common.h"
+#include "./row_norm_kernel-inl.h"
+
+namespace mxnet {
+namespace op {
+
+namespace layernorm {
+enum LayerNormOpInputs {kData, kGamma, kBeta};
+enum LayerNormOpOutputs {kOut, kMean, kStd};
+}  // namespace layernorm
+
+struct LayerNormParam : public dmlc::Parameter<LayerNormParam> {
+  float eps;
+  DMLC_DECLARE_PARAMETER(LayerNormParam) {
+    DMLC_DECLARE_FIELD(eps).set_default(1e-5f)
+    .describe("Epsilon added to the variance");
+  }
+};
+
+/**
+ * \brief layer normalization, each row of the data along the last axis is normalized
+ *  to zero mean and unit variance, then scaled by gamma and shifted by beta. The
+ *  forward and the data gradient are one fused kernel each, see row_norm_kernel-inl.h.
+ * \tparam xpu The device that the op will be executed on.
+ */
+template<typename xpu>
+class LayerNormOp : public Operator {
+ public:
+  explicit LayerNormOp(LayerNormParam param) : param_(param) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    CHECK_EQ(in_data.size(), 3);
+    CHECK_EQ(out_data.size(), 3);
+    if (req[layernorm::kOut] == kNullOp) return;
+    CHECK_EQ(req[layernorm::kOut], kWriteTo);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    const TBlob &blob = in_data[layernorm::kData];
+    Tensor<xpu, 2> data = blob.get_with_shape<xpu, 2, real_t>(
+        Shape2(blob.shape_.ProdShape(0, blob.ndim() - 1), blob.shape_[blob.ndim() - 1]), s);
+    Tensor<xpu, 2> out = out_data[layernorm::kOut].get_with_shape<xpu, 2, real_t>(data.shape_, s);
+    Tensor<xpu, 1> gamma = in_data[layernorm::kGamma].get<xpu, 1, real_t>(s);
+    Tensor<xpu, 1> beta = in_data[layernorm::kBeta].get<xpu, 1, real_t>(s);
+    Tensor<xpu, 1> mean = out_data[layernorm::kMean].get<xpu, 1, real_t>(s);
+    Tensor<xpu, 1> stdev = out_data[layernorm::kStd].get<xpu, 1, real_t>(s);
+    rownorm::LayerNormForward(s, data.dptr_, gamma.dptr_, beta.dptr_,
+                              data.size(0), data.size(1), param_.eps,
+                              out.dptr_, mean.dptr_, stdev.dptr_);
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    CHECK_EQ(out_grad.size(), 1);
+    CHECK_EQ(in_grad.size(), 3);
+    CHECK_EQ(req.size(), 3);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    const TBlob &blob = in_data[layernorm::kData];
+    const Shape<2> dshape =
+        Shape2(blob.shape_.ProdShape(0, blob.ndim() - 1), blob.shape_[blob.ndim() - 1]);
+    Tensor<xpu, 2> data = blob.get_with_shape<xpu, 2, real_t>(dshape, s);
+    Tensor<xpu, 2> grad = out_grad[layernorm::kOut].get_with_shape<xpu, 2, real_t>(dshape, s);
+    Tensor<xpu, 2> grad_in = in_grad[layernorm::kData].get_with_shape<xpu, 2, real_t>(dshape, s);
+    Tensor<xpu, 1> gamma = in_data[layernorm::kGamma].get<xpu, 1, real_t>(s);
+    Tensor<xpu, 1> mean = out_data[layernorm::kMean].get<xpu, 1, real_t>(s);
+    Tensor<xpu, 1> stdev = out_data[layernorm::kStd].get<xpu, 1, real_t>(s);
+    Tensor<xpu, 1> ggamma = in_grad[layernorm::kGamma].get<xpu, 1, real_t>(s);
+    Tensor<xpu, 1> gbeta = in_grad[layernorm::kBeta].get<xpu, 1, real_t>(s);
+    const int M = dshape[0], N = dshape[1];
+    if (req[layernorm::kGamma] != kNullOp || req[layernorm::kBeta] != kNullOp) {
+      rownorm::LayerNormBackwardParams(
+          s, grad.dptr_, data.dptr_, mean.dptr_, stdev.dptr_, M, N,
+          req[layernorm::kGamma] == kNullOp ? nullptr : ggamma.dptr_,
+          req[layernorm::kGamma] == kAddTo,
+          req[layernorm::kBeta] == kNullOp ? nullptr : gbeta.dptr_,
+          req[layernorm::kBeta] == kAddTo);
+    }
+    if (req[layernorm::kData] != kNullOp) {
+      rownorm::LayerNormBackwardData(s, grad.dptr_, data.dptr_, gamma.dptr_,
+                                     mean.dptr_, stdev.dptr_, M, N, grad_in.dptr_,
+                                     req[layernorm::kData] == kAddTo);
+    }
+  }
+
+ private:
+  LayerNormParam param_;
+};  // class LayerNormOp
+
+template<typename xpu>
+Operator *CreateOp(LayerNormParam param);
+
+#if DMLC_USE_CXX11
+class LayerNormProp : public OperatorProperty {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    using namespace mshadow;
+    CHECK_EQ(in_shape->size(), 3) << "Input:[data, gamma, beta]";
+    const TShape &dshape = in_shape->at(layernorm::kData);
+    if (dshape.ndim() == 0) return false;
+    const index_t rows = dshape.ProdShape(0, dshape.ndim() - 1);
+    SHAPE_ASSIGN_CHECK(*in_shape, layernorm::kGamma, Shape1(dshape[dshape.ndim() - 1]));
+    SHAPE_ASSIGN_CHECK(*in_shape, layernorm::kBeta, Shape1(dshape[dshape.ndim() - 1]));
+    out_shape->clear();
+    out_shape->push_back(dshape);
+    out_shape->push_back(Shape1(rows));
+    out_shape->push_back(Shape1(rows));
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new LayerNormProp();
+    ptr->param_ = param_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "LayerNorm";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    return {out_grad[layernorm::kOut],
+            out_data[layernorm::kMean],
+            out_data[layernorm::kStd],
+            in_data[layernorm::kData],
+            in_data[layernorm::kGamma]};
+  }
+
+  int NumVisibleOutputs() const override {
+    return 1;
+  }
+
+  int NumOutputs() const override {
+    return 3;
+  }
+
+  std::vector<std::string> ListArguments() const override {
+    return {"data", "gamma", "beta"};
+  }
+
+  std::vector<std::string> ListOutputs() const override {
+    return {"output", "mean", "std"};
+  }
+
+  Operator* CreateOperator(Context ctx) const override;
+
+ private:
+  LayerNormParam param_;
+};  // class LayerNormProp
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_LAYER_NORM_INL_H_
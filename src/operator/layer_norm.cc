@@ -0,0 +1,28 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file layer_norm.cc
+ * \brief layer normalization operator
+*/
+#include "./layer_norm-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<cpu>(LayerNormParam param) {
+  return new LayerNormOp<cpu>(param);
+}
+
+Operator *LayerNormProp::CreateOperator(Context ctx) const {
+  DO_BIND_DISPATCH(CreateOp, param_);
+}
+
+DMLC_REGISTER_PARAMETER(LayerNormParam);
+
+MXNET_REGISTER_OP_PROPERTY(LayerNorm, LayerNormProp)
+.describe("Layer normalization, normalize each instance along the last axis to zero "
+          "mean and unit variance, then scale by gamma and shift by beta.")
+.add_argument("data", "Symbol", "Input data to layer normalization")
+.add_argument("gamma", "Symbol", "gamma array, of the size of the last axis")
+.add_argument("beta", "Symbol", "beta array, of the size of the last axis")
+.add_arguments(LayerNormParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
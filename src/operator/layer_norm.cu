@@ -0,0 +1,14 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file layer_norm.cu
+ * \brief layer normalization operator
+*/
+#include "./layer_norm-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<gpu>(LayerNormParam param) {
+  return new LayerNormOp<gpu>(param);
+}
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,157 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file layout_reorder.cc
+ * \brief Special operator that converts 4D cpu data between memory layouts,
+ *  inserted by the graph executor at the boundaries of blocked layout regions.
+*/
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./operator_common.h"
+
+namespace mxnet {
+namespace op {
+
+struct LayoutReorderParam : public dmlc::Parameter<LayoutReorderParam> {
+  int src_layout;
+  int dst_layout;
+  DMLC_DECLARE_PARAMETER(LayoutReorderParam) {
+    DMLC_DECLARE_FIELD(src_layout)
+    .add_enum("NCHW", kLayoutNCHW)
+    .add_enum("NCHW8c", kLayoutNCHW8c)
+    .describe("Layout of the input.");
+    DMLC_DECLARE_FIELD(dst_layout)
+    .add_enum("NCHW", kLayoutNCHW)
+    .add_enum("NCHW8c", kLayoutNCHW8c)
+    .describe("Layout of the output.");
+  }
+};
+
+/*!
+ * \brief copy x in layout src to y in layout dst, shape is the logical (n, c, h, w).
+ *  Each iteration moves one block of 8 channels of one image.
+ */
+inline void ReorderLayout(const real_t *x, int src, int dst, const mshadow::Shape<4> &shape,
+                          real_t *y) {
+  const int kBlock = 8;
+  const int nblock = static_cast<int>(shape[0] * shape[1] / kBlock);
+  const int plane = static_cast<int>(shape[2] * shape[3]);
+  #pragma omp parallel for schedule(static)
+  for (int b = 0; b < nblock; ++b) {
+    const size_t off = static_cast<size_t>(b) * kBlock * plane;
+    if (src == dst) {
+      std::copy(x + off, x + off + kBlock * plane, y + off);
+    } else if (dst == kLayoutNCHW8c) {
+      for (int j = 0; j < plane; ++j) {
+        for (int l = 0; l < kBlock; ++l) y[off + j * kBlock + l] = x[off + l * plane + j];
+      }
+    } else {
+      for (int l = 0; l < kBlock; ++l) {
+        for (int j = 0; j < plane; ++j) y[off + l * plane + j] = x[off + j * kBlock + l];
+      }
+    }
+  }
+}
+
+class LayoutReorderOp : public Operator {
+ public:
+  explicit LayoutReorderOp(LayoutReorderParam param) : param_(param) {}
+
+  void Forward(const OpContext &ctx,
+               const std::vector<TBlob> &in_data,
+               const std::vector<OpReqType> &req,
+               const std::vector<TBlob> &out_data,
+               const std::vector<TBlob> &aux_args) override {
+    using namespace mshadow;
+    CHECK_EQ(in_data.size(), 1);
+    CHECK_EQ(out_data.size(), 1);
+    CHECK_EQ(req[0], kWriteTo);
+    Stream<cpu> *s = ctx.get_stream<cpu>();
+    Tensor<cpu, 4> data = in_data[0].get<cpu, 4, real_t>(s);
+    Tensor<cpu, 4> out = out_data[0].get<cpu, 4, real_t>(s);
+    ReorderLayout(data.dptr_, param_.src_layout, param_.dst_layout, data.shape_, out.dptr_);
+  }
+
+  void Backward(const OpContext &ctx,
+                const std::vector<TBlob> &out_grad,
+                const std::vector<TBlob> &in_data,
+                const std::vector<TBlob> &out_data,
+                const std::vector<OpReqType> &req,
+                const std::vector<TBlob> &in_grad,
+                const std::vector<TBlob> &aux_args) override {
+    using namespace mshadow;
+    CHECK_EQ(out_grad.size(), 1);
+    CHECK_EQ(in_grad.size(), 1);
+    CHECK_EQ(req[0], kWriteTo);
+    Stream<cpu> *s = ctx.get_stream<cpu>();
+    Tensor<cpu, 4> grad = out_grad[0].get<cpu, 4, real_t>(s);
+    Tensor<cpu, 4> grad_in = in_grad[0].get<cpu, 4, real_t>(s);
+    ReorderLayout(grad.dptr_, param_.dst_layout, param_.src_layout, grad.shape_, grad_in.dptr_);
+  }
+
+ private:
+  LayoutReorderParam param_;
+};
+
+class LayoutReorderProp : public OperatorProperty {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    CHECK_EQ(in_shape->size(), 1) << "Input:[data]";
+    const TShape &dshape = in_shape->at(0);
+    if (dshape.ndim() == 0) return false;
+    CHECK_EQ(dshape.ndim(), 4) << "LayoutReorder: data should be 4D in (batch, channel, y, x)";
+    CHECK_EQ(dshape[1] % 8, 0) << "LayoutReorder: channels should be a multiple of 8";
+    out_shape->clear();
+    out_shape->push_back(dshape);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new LayoutReorderProp();
+    ptr->param_ = param_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "_LayoutReorder";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    return {out_grad[0]};
+  }
+
+  Operator* CreateOperator(Context ctx) const override {
+    CHECK_EQ(ctx.dev_mask(), cpu::kDevMask) << "LayoutReorder is only supported on cpu";
+    return new LayoutReorderOp(param_);
+  }
+
+ private:
+  LayoutReorderParam param_;
+};
+
+DMLC_REGISTER_PARAMETER(LayoutReorderParam);
+
+MXNET_REGISTER_OP_PROPERTY(_LayoutReorder, LayoutReorderProp)
+.describe("Special op to convert cpu data between memory layouts")
+.add_argument("data", "Symbol", "Input data.")
+.add_arguments(LayoutReorderParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
@@ -17,6 +17,7 @@
 #include <utility>
 #include "./operator_common.h"
 #include "./mshadow_op.h"
+#include "../common/philox.h"
 
 namespace mxnet {
 namespace op {
@@ -105,9 +106,8 @@ class LeakyReLUOp : public Operator {
       }
       case leakyrelu::kRReLU: {
         if (ctx.is_train) {
-          Random<xpu>* prnd = ctx.requested[leakyrelu::kRandom].get_random<xpu, real_t>(s);
-          mask = prnd->uniform(mask.shape_);
-          mask = mask * (param_.upper_bound - param_.lower_bound) + param_.lower_bound;
+          ParallelRandomState *prnd = ctx.requested[leakyrelu::kRandom].get_parallel_random();
+          common::random::SampleUniform(prnd, &mask, param_.lower_bound, param_.upper_bound);
           Assign(out, req[leakyrelu::kOut], F<mshadow_op::xelu>(data, mask));
         } else {
           const float slope = (param_.lower_bound + param_.upper_bound) / 2.0f;
@@ -309,7 +309,7 @@ class LeakyReLUProp : public OperatorProperty {
   std::vector<ResourceRequest> ForwardResource(
       const std::vector<TShape> &in_shape) const override {
     if (param_.act_type == leakyrelu::kRReLU) {
-      return {ResourceRequest::kRandom};
+      return {ResourceRequest::kParallelRandom};
     } else {
       return std::vector<ResourceRequest>();
     }
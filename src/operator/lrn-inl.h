@@ -22,6 +22,7 @@ namespace op {
 namespace lrn_enum {
 enum LRNInputs {kData};
 enum LRNOutputs {kOut, kTmpNorm};
+enum LRNResource {kTempSpace};
 }  // namespace lrn_enum
 
 struct LRNParam : public dmlc::Parameter<LRNParam> {
@@ -147,6 +148,11 @@ class LocalResponseNormProp : public OperatorProperty {
 #endif
   }
 
+  std::vector<ResourceRequest> BackwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace};
+  }
+
   std::vector<std::pair<int, void*> > BackwardInplaceOption(
     const std::vector<int> &out_grad,
     const std::vector<int> &in_data,
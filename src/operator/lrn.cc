@@ -6,6 +6,7 @@
 */
 
 #include "./lrn-inl.h"
+#include "./cpu_pooling-inl.h"
 #if MXNET_USE_CUDNN == 1
 #include "./cudnn_lrn-inl.h"
 #endif
@@ -14,6 +15,9 @@ namespace mxnet {
 namespace op {
 template<>
 Operator* CreateOp<cpu>(LRNParam param) {
+  if (dmlc::GetEnv("MXNET_CPU_POOL_OPT", true)) {
+    return new CPULocalResponseNormOp(param);
+  }
   return new LocalResponseNormOp<cpu>(param);
 }
 
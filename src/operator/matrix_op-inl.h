@@ -9,6 +9,8 @@
 #include <mxnet/operator_util.h>
 #include <vector>
 #include "./mshadow_op.h"
+#include "./transpose_kernel-inl.h"
+#include "./batch_gemm-inl.h"
 
 #if defined(__CUDACC__)
 #define XPU gpu
@@ -33,53 +35,8 @@ void TransposeImpl(const TBlob &src,
               TBlob *ret,
               RunContext ctx,
               const TShape &axes) {
-  using namespace mshadow;
-  using namespace mshadow::expr;
-  CHECK_EQ(src.type_flag_, ret->type_flag_);
-  Stream<xpu> *s = ctx.get_stream<xpu>();
-  MSHADOW_TYPE_SWITCH(ret->type_flag_, DType, {
-    switch (axes.ndim()) {
-     case 0:
-      break;
-     case 1: {
-      Tensor<xpu, 1, DType> in = src.get<xpu, 1, DType>(s);
-      Tensor<xpu, 1, DType> out = ret->get<xpu, 1, DType>(s);
-      Copy(out, in, s);
-      break;
-     }
-     case 2: {
-      mshadow::Tensor<xpu, 2, DType> in = src.FlatTo2D<xpu, DType>(s);
-      mshadow::Tensor<xpu, 2, DType> out = ret->FlatTo2D<xpu, DType>(s);
-      if (axes[0] == 1 && axes[1] == 0) {
-        out = in.T();
-      } else {
-        Copy(out, in, s);
-      }
-      break;
-     }
-     case 3: {
-      Tensor<xpu, 3, DType> in = src.get<xpu, 3, DType>(s);
-      Tensor<xpu, 3, DType> out = ret->get<xpu, 3, DType>(s);
-      out = transpose(in, axes.get<3>());
-      break;
-     }
-     case 4: {
-      Tensor<xpu, 4, DType> in = src.get<xpu, 4, DType>(s);
-      Tensor<xpu, 4, DType> out = ret->get<xpu, 4, DType>(s);
-      out = transpose(in, axes.get<4>());
-      break;
-     }
-     case 5: {
-      Tensor<xpu, 5, DType> in = src.get<xpu, 5, DType>(s);
-      Tensor<xpu, 5, DType> out = ret->get<xpu, 5, DType>(s);
-      out = transpose(in, axes.get<5>());
-      break;
-     }
-     default:
-      LOG(FATAL) << "Transpose support at most 5 dimensions";
-      break;
-    }
-  });
+  if (axes.ndim() == 0) return;
+  TransposeCompute<xpu>(ctx.get_stream<xpu>(), src, axes, *ret);
 }
 
 // matrix transpose
@@ -125,7 +82,8 @@ inline TShape TransposeShape(const TShape& shp,
                              const EnvArguments& env) {
   TransposeParam param;
   param.Init(env.kwargs);
-  CHECK(shp.ndim() <= 5) << "Transpose support at most 5 dimensions";
+  CHECK_LE(shp.ndim(), static_cast<index_t>(transpose::kMaxDim))
+      << "Transpose supports at most " << transpose::kMaxDim << " dimensions";
   TShape ret(shp.ndim());
   if (param.axes.ndim() == 0) {
     for (index_t i = 0; i < shp.ndim(); ++i) {
@@ -194,6 +152,77 @@ void ReshapeGrad_(const OutputGrad& out_grad,
 }
 
 
+struct DotParam : public dmlc::Parameter<DotParam> {
+  bool transpose_a;
+  bool transpose_b;
+  DMLC_DECLARE_PARAMETER(DotParam) {
+    DMLC_DECLARE_FIELD(transpose_a).set_default(false)
+    .describe("Whether to transpose the (last two dims of the) lhs before the product.");
+    DMLC_DECLARE_FIELD(transpose_b).set_default(false)
+    .describe("Whether to transpose the (last two dims of the) rhs before the product.");
+  }
+};
+
+/*!
+ * \brief ret = req(ret, op(lhs) op(rhs)) for each of the batch matrices, with the shapes
+ *  (batch, rows, cols) of lhs and rhs. A vector dot is the product of (1, K) and (K, 1).
+ */
+template<typename xpu>
+inline void BatchDotImpl(mshadow::Stream<xpu> *s, const TBlob &lhs, const TShape &lshape,
+                         bool ta, const TBlob &rhs, const TShape &rshape, bool tb,
+                         const TBlob &ret, OpReqType req) {
+  if (req == kNullOp) return;
+  CHECK_NE(req, kWriteInplace);
+  CHECK_EQ(ret.type_flag_, lhs.type_flag_)
+      << "Binary function only support input/output with the same type";
+  CHECK_EQ(ret.type_flag_, rhs.type_flag_)
+      << "Binary function only support input/output with the same type";
+  const int batch = static_cast<int>(lshape[0]);
+  const int M = static_cast<int>(ta ? lshape[2] : lshape[1]);
+  const int K = static_cast<int>(ta ? lshape[1] : lshape[2]);
+  const int N = static_cast<int>(tb ? rshape[1] : rshape[2]);
+  MSHADOW_REAL_TYPE_SWITCH(ret.type_flag_, DType, {
+    gemm::BatchGemm(s, ta, tb, batch, M, N, K, DType(1.0f),
+                    static_cast<const DType*>(lhs.dptr_), static_cast<const DType*>(rhs.dptr_),
+                    DType(req == kAddTo ? 1.0f : 0.0f), static_cast<DType*>(ret.dptr_));
+  });
+}
+
+/*!
+ * \brief gradients of out = op(lhs) op(rhs), the products are batched as in BatchDotImpl.
+ *  The gradient of op(lhs) is out_grad op(rhs)^T, and the one of op(rhs) is
+ *  op(lhs)^T out_grad, transposed again when the operand is transposed.
+ */
+template<typename xpu>
+inline void BatchDotGradImpl(mshadow::Stream<xpu> *s, const TBlob &out_grad,
+                             const TShape &oshape, const TBlob &lhs, const TShape &lshape,
+                             bool ta, const TBlob &rhs, const TShape &rshape, bool tb,
+                             const TBlob &lhs_grad, OpReqType req_lhs_grad,
+                             const TBlob &rhs_grad, OpReqType req_rhs_grad) {
+  if (ta) {
+    BatchDotImpl<xpu>(s, rhs, rshape, tb, out_grad, oshape, true, lhs_grad, req_lhs_grad);
+  } else {
+    BatchDotImpl<xpu>(s, out_grad, oshape, false, rhs, rshape, !tb, lhs_grad, req_lhs_grad);
+  }
+  if (tb) {
+    BatchDotImpl<xpu>(s, out_grad, oshape, true, lhs, lshape, ta, rhs_grad, req_rhs_grad);
+  } else {
+    BatchDotImpl<xpu>(s, lhs, lshape, !ta, out_grad, oshape, false, rhs_grad, req_rhs_grad);
+  }
+}
+
+/*! \brief shape of a matrix of dot as (1, rows, cols), a vector is a row of lhs or a col of rhs */
+inline TShape DotMatrixShape(const TShape &shape, bool is_lhs) {
+  index_t ret[] = {1, 1, 1};
+  if (shape.ndim() == 2) {
+    ret[1] = shape[0];
+    ret[2] = shape[1];
+  } else {
+    ret[is_lhs ? 2 : 1] = shape[0];
+  }
+  return TShape(ret, ret + 3);
+}
+
 template<typename xpu>
 void DotForward_(const TBlob& lhs,
                  const TBlob& rhs,
@@ -201,29 +230,13 @@ void DotForward_(const TBlob& lhs,
                  TBlob *ret,
                  OpReqType req,
                  RunContext ctx) {
-  using namespace mshadow::expr;
-  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
-  CHECK_EQ(ret->type_flag_, lhs.type_flag_)
-      << "Binary function only support input/output with the same type";
-  CHECK_EQ(ret->type_flag_, rhs.type_flag_)
-      << "Binary function only support input/output with the same type";
-  CHECK_EQ(ret->type_flag_, mshadow::kFloat32)
-      << "dot only support 32 bit float so far";
-
-  if (lhs.shape_.ndim() == 2 && rhs.shape_.ndim() == 2) {
-    mshadow::Tensor<xpu, 2, real_t> out = ret->FlatTo2D<xpu, real_t>(s);
-    ASSIGN_DISPATCH(out, req,
-                    dot(lhs.get<xpu, 2, real_t>(s),
-                        rhs.get<xpu, 2, real_t>(s)));
-  } else if (lhs.shape_.ndim() == 1 && rhs.shape_.ndim() == 1) {
-    CHECK_NE(req, kAddTo) << "AddTo not yet suported";
-    mshadow::Tensor<xpu, 1, real_t> out = ret->get<xpu, 1, real_t>(s);
-    mshadow::VectorDot(out,
-                       lhs.get<xpu, 1, real_t>(s),
-                       rhs.get<xpu, 1, real_t>(s));
-  } else {
-    LOG(FATAL) << "not reached";
-  }
+  DotParam param;
+  param.Init(env.kwargs);
+  CHECK_EQ(lhs.shape_.ndim(), rhs.shape_.ndim()) << "not reached";
+  const bool vec = lhs.shape_.ndim() == 1;
+  BatchDotImpl<xpu>(ctx.get_stream<xpu>(), lhs, DotMatrixShape(lhs.shape_, true),
+                    param.transpose_a && !vec, rhs, DotMatrixShape(rhs.shape_, false),
+                    param.transpose_b && !vec, *ret, req);
 }
 
 template<typename xpu>
@@ -236,40 +249,34 @@ void DotBackward_(const OutputGrad& out_grad,
                   OpReqType req_lhs_grad,
                   OpReqType req_rhs_grad,
                   RunContext ctx) {
-  using namespace mshadow::expr;
-  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
-  CHECK_NE(req_rhs_grad, kWriteInplace);
-  CHECK_NE(req_lhs_grad, kWriteInplace);
-
-  if (lhs.data.shape_.ndim() == 2 && rhs.data.shape_.ndim() == 2) {
-    mshadow::Tensor<xpu, 2, real_t> mout_grad = out_grad.data.get<xpu, 2, real_t>(s);
-    mshadow::Tensor<xpu, 2, real_t> mlhs_data = lhs.data.get<xpu, 2, real_t>(s);
-    mshadow::Tensor<xpu, 2, real_t> mrhs_data = rhs.data.get<xpu, 2, real_t>(s);
-    mshadow::Tensor<xpu, 2, real_t> mlhs_grad = lhs_grad->get<xpu, 2, real_t>(s);
-    mshadow::Tensor<xpu, 2, real_t> mrhs_grad = rhs_grad->get<xpu, 2, real_t>(s);
-    ASSIGN_DISPATCH(mrhs_grad, req_rhs_grad, dot(mlhs_data.T(), mout_grad));
-    ASSIGN_DISPATCH(mlhs_grad, req_lhs_grad, dot(mout_grad, mrhs_data.T()));
-  } else if (lhs.data.shape_.ndim() == 1 && rhs.data.shape_.ndim() == 1) {
-    mshadow::Tensor<xpu, 1, real_t> mout_grad = out_grad.data.get<xpu, 1, real_t>(s);
-    mshadow::Tensor<xpu, 1, real_t> mlhs_data = lhs.data.get<xpu, 1, real_t>(s);
-    mshadow::Tensor<xpu, 1, real_t> mrhs_data = rhs.data.get<xpu, 1, real_t>(s);
-    mshadow::Tensor<xpu, 1, real_t> mlhs_grad = lhs_grad->get<xpu, 1, real_t>(s);
-    mshadow::Tensor<xpu, 1, real_t> mrhs_grad = rhs_grad->get<xpu, 1, real_t>(s);
-    ASSIGN_DISPATCH(mrhs_grad, req_rhs_grad,
-                    broadcast_scalar(mout_grad, mlhs_data.shape_) * mlhs_data);
-    ASSIGN_DISPATCH(mlhs_grad, req_lhs_grad,
-                    broadcast_scalar(mout_grad, mlhs_data.shape_) * mrhs_data);
-  } else {
-    LOG(FATAL) << "not reached";
+  DotParam param;
+  param.Init(env.kwargs);
+  const bool vec = lhs.data.shape_.ndim() == 1;
+  index_t oshape[] = {1, 1, 1};
+  if (!vec) {
+    oshape[1] = out_grad.data.shape_[0];
+    oshape[2] = out_grad.data.shape_[1];
   }
+  BatchDotGradImpl<xpu>(ctx.get_stream<xpu>(), out_grad.data, TShape(oshape, oshape + 3),
+                        lhs.data, DotMatrixShape(lhs.data.shape_, true),
+                        param.transpose_a && !vec,
+                        rhs.data, DotMatrixShape(rhs.data.shape_, false),
+                        param.transpose_b && !vec,
+                        *lhs_grad, req_lhs_grad, *rhs_grad, req_rhs_grad);
 }
 
 inline TShape DotShape(const TShape& lshape,
                        const TShape& rshape,
                        const EnvArguments& env) {
+  DotParam param;
+  param.Init(env.kwargs);
   if (lshape.ndim() == 2 && rshape.ndim() == 2) {
-    CHECK_EQ(lshape[1], rshape[0]) << "dot shape error: " << lshape << " X " << rshape;
-    size_t target_shape[] = {lshape[0], rshape[1]};
+    const index_t M = param.transpose_a ? lshape[1] : lshape[0];
+    const index_t K = param.transpose_a ? lshape[0] : lshape[1];
+    const index_t rK = param.transpose_b ? rshape[1] : rshape[0];
+    const index_t N = param.transpose_b ? rshape[0] : rshape[1];
+    CHECK_EQ(K, rK) << "dot shape error: " << lshape << " X " << rshape;
+    size_t target_shape[] = {M, N};
     return TShape(target_shape, target_shape + 2);
   } else if (lshape.ndim() == 1 && rshape.ndim() == 1) {
     CHECK_EQ(lshape[0], rshape[0]) << "dot shape error: " << lshape << " X " << rshape;
@@ -289,22 +296,11 @@ void BatchDotForward_(const TBlob& lhs,
                         TBlob *ret,
                         OpReqType req,
                         RunContext ctx) {
-  using namespace mshadow::expr;
-  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
-  CHECK_EQ(ret->type_flag_, lhs.type_flag_)
-      << "Binary function only support input/output with the same type";
-  CHECK_EQ(ret->type_flag_, rhs.type_flag_)
-      << "Binary function only support input/output with the same type";
-  CHECK_EQ(ret->type_flag_, mshadow::kFloat32)
-      << "dot only support 32 bit float so far";
-
-  if (lhs.shape_.ndim() == 3 && rhs.shape_.ndim() == 3) {
-    mshadow::Tensor<xpu, 3, real_t> out = ret->get<xpu, 3, real_t>(s);
-    ASSIGN_DISPATCH(out, req, (batch_dot<false, false>(lhs.get<xpu, 3, real_t>(s),
-                                                       rhs.get<xpu, 3, real_t>(s))));
-  } else {
-    LOG(FATAL) << "not reached";
-  }
+  DotParam param;
+  param.Init(env.kwargs);
+  CHECK(lhs.shape_.ndim() == 3 && rhs.shape_.ndim() == 3) << "not reached";
+  BatchDotImpl<xpu>(ctx.get_stream<xpu>(), lhs, lhs.shape_, param.transpose_a,
+                    rhs, rhs.shape_, param.transpose_b, *ret, req);
 }
 
 template<typename xpu>
@@ -317,31 +313,28 @@ void BatchDotBackward_(const OutputGrad& out_grad,
                          OpReqType req_lhs_grad,
                          OpReqType req_rhs_grad,
                          RunContext ctx) {
-  using namespace mshadow::expr;
-  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
-  CHECK_NE(req_rhs_grad, kWriteInplace);
-  CHECK_NE(req_lhs_grad, kWriteInplace);
-
-  if (lhs.data.shape_.ndim() == 3 && rhs.data.shape_.ndim() == 3) {
-    mshadow::Tensor<xpu, 3, real_t> mout_grad = out_grad.data.get<xpu, 3, real_t>(s);
-    mshadow::Tensor<xpu, 3, real_t> mlhs_data = lhs.data.get<xpu, 3, real_t>(s);
-    mshadow::Tensor<xpu, 3, real_t> mrhs_data = rhs.data.get<xpu, 3, real_t>(s);
-    mshadow::Tensor<xpu, 3, real_t> mlhs_grad = lhs_grad->get<xpu, 3, real_t>(s);
-    mshadow::Tensor<xpu, 3, real_t> mrhs_grad = rhs_grad->get<xpu, 3, real_t>(s);
-    ASSIGN_DISPATCH(mrhs_grad, req_rhs_grad, (batch_dot<true, false>(mlhs_data, mout_grad)));
-    ASSIGN_DISPATCH(mlhs_grad, req_lhs_grad, (batch_dot<false, true>(mout_grad, mrhs_data)));
-  } else {
-    LOG(FATAL) << "not reached";
-  }
+  DotParam param;
+  param.Init(env.kwargs);
+  CHECK(lhs.data.shape_.ndim() == 3 && rhs.data.shape_.ndim() == 3) << "not reached";
+  BatchDotGradImpl<xpu>(ctx.get_stream<xpu>(), out_grad.data, out_grad.data.shape_,
+                        lhs.data, lhs.data.shape_, param.transpose_a,
+                        rhs.data, rhs.data.shape_, param.transpose_b,
+                        *lhs_grad, req_lhs_grad, *rhs_grad, req_rhs_grad);
 }
 
 inline TShape BatchDotShape(const TShape& lshape,
                               const TShape& rshape,
                               const EnvArguments& env) {
+  DotParam param;
+  param.Init(env.kwargs);
   if (lshape.ndim() == 3 && rshape.ndim() == 3) {
-    CHECK(lshape[0] == rshape[0] && lshape[2] == rshape[1])
+    const index_t M = param.transpose_a ? lshape[2] : lshape[1];
+    const index_t K = param.transpose_a ? lshape[1] : lshape[2];
+    const index_t rK = param.transpose_b ? rshape[2] : rshape[1];
+    const index_t N = param.transpose_b ? rshape[1] : rshape[2];
+    CHECK(lshape[0] == rshape[0] && K == rK)
       << "batch_dot shape error: " << lshape << " X " << rshape;
-    size_t target_shape[] = {lshape[0], lshape[1], rshape[2]};
+    size_t target_shape[] = {lshape[0], M, N};
     return TShape(target_shape, target_shape + 3);
   } else {
     LOG(FATAL) << "batch_dot currently only support 3D dot 3D array"
@@ -662,18 +655,22 @@ MXNET_REGISTER_SIMPLE_OP(flip, XPU)
 
 // dot
 MXNET_REGISTER_SIMPLE_OP(dot, XPU)
+.set_enable_kwargs(true)
 .set_function(XPU::kDevMask, DotForward_<XPU>, kNoInplace, kRegisterSymbolic)
 .set_shape_function(DotShape)
 .set_gradient(XPU::kDevMask, DotBackward_<XPU>, kNoInplace)
-.describe("Calculate dot product of two matrices or two vectors");
+.describe("Calculate dot product of two matrices or two vectors")
+.add_arguments(DotParam::__FIELDS__());
 
 // batched_dot
 MXNET_REGISTER_SIMPLE_OP(batch_dot, XPU)
+.set_enable_kwargs(true)
 .set_function(XPU::kDevMask, BatchDotForward_<XPU>, kNoInplace, kRegisterSymbolic)
 .set_shape_function(BatchDotShape)
 .set_gradient(XPU::kDevMask, BatchDotBackward_<XPU>, kNoInplace)
 .describe("Calculate batched dot product of two matrices."
-          " (batch, M, K) batch_dot (batch, K, N) --> (batch, M, N)");
+          " (batch, M, K) batch_dot (batch, K, N) --> (batch, M, N)")
+.add_arguments(DotParam::__FIELDS__());
 }  // namespace op
 }  // namespace mxnet
 
@@ -13,5 +13,6 @@ DMLC_REGISTER_PARAMETER(ExpandDimParam);
 DMLC_REGISTER_PARAMETER(SimpleCropParam);
 DMLC_REGISTER_PARAMETER(SliceParam);
 DMLC_REGISTER_PARAMETER(FlipParam);
+DMLC_REGISTER_PARAMETER(DotParam);
 }  // op
 }  // mxnet
@@ -0,0 +1,431 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file mshadow_op_simd.h
+ * \brief vectorized cpu kernels of the transcendental functors of mshadow_op.
+ *
+ *  exp, log, sigmoid, tanh and softrelu of float32 arrays are computed with
+ *  polynomial approximations instead of one libm call per element:
+ *  - exp and log use the Cephes reductions and polynomials, within 2 ulp,
+ *    exp gives denormals down to e^-104.
+ *  - tanh is a rational approximation of degree 13 / 6, saturated beyond
+ *    |x| = 7.9, within 3 ulp.
+ *  - sigmoid and softrelu are built from exp and log, their relative error is
+ *    below 1e-6 wherever the result is a normal float.
+ *  NaN inputs give NaN, log(0) = -inf and log of a negative number is NaN.
+ *
+ *  The vector width is chosen at compile time, AVX-512 with -mavx512f, AVX2
+ *  with -mavx2 -mfma, NEON on aarch64 and on 32-bit ARM with -mfpu=neon, SSE
+ *  otherwise. 32-bit NEON has no division, it is a reciprocal estimate refined
+ *  by two Newton steps, within 2 more ulp. Set MXNET_CPU_EXACT_MATH=1 to use
+ *  the libm functions of mshadow_op instead.
+ */
+#ifndef MXNET_OPERATOR_MSHADOW_OP_SIMD_H_
+#define MXNET_OPERATOR_MSHADOW_OP_SIMD_H_
+
+#include <dmlc/parameter.h>
+#include <mxnet/base.h>
+#include <mxnet/operator.h>
+#include <stdint.h>
+#include <algorithm>
+#include <limits>
+#include "./mshadow_op.h"
+#include "./operator_common.h"
+#if !defined(__CUDACC__)
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__)) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace mxnet {
+namespace op {
+namespace mshadow_op {
+namespace simd {
+#if defined(__CUDACC__)
+const size_t kWidth = 0;
+#elif defined(__AVX512F__)
+const size_t kWidth = 16;
+typedef __m512 Packet;
+typedef __m512i PacketI;
+typedef __mmask16 Mask;
+inline Packet Set1(float a) { return _mm512_set1_ps(a); }
+inline Packet Load(const float *p) { return _mm512_loadu_ps(p); }
+inline void Store(float *p, Packet a) { _mm512_storeu_ps(p, a); }
+inline Packet Add(Packet a, Packet b) { return _mm512_add_ps(a, b); }
+inline Packet Sub(Packet a, Packet b) { return _mm512_sub_ps(a, b); }
+inline Packet Mul(Packet a, Packet b) { return _mm512_mul_ps(a, b); }
+inline Packet Div(Packet a, Packet b) { return _mm512_div_ps(a, b); }
+inline Packet Fma(Packet a, Packet b, Packet c) { return _mm512_fmadd_ps(a, b, c); }
+inline Packet Min(Packet a, Packet b) { return _mm512_min_ps(a, b); }
+inline Packet Max(Packet a, Packet b) { return _mm512_max_ps(a, b); }
+inline Mask Lt(Packet a, Packet b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+inline Mask Eq(Packet a, Packet b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+inline Mask IsNaN(Packet a) { return _mm512_cmp_ps_mask(a, a, _CMP_UNORD_Q); }
+inline Packet Select(Mask m, Packet a, Packet b) { return _mm512_mask_blend_ps(m, b, a); }
+inline PacketI RoundToInt(Packet a) { return _mm512_cvtps_epi32(a); }
+inline Packet ToFloat(PacketI a) { return _mm512_cvtepi32_ps(a); }
+inline PacketI AsInt(Packet a) { return _mm512_castps_si512(a); }
+inline Packet AsFloat(PacketI a) { return _mm512_castsi512_ps(a); }
+inline PacketI AddI(PacketI a, PacketI b) { return _mm512_add_epi32(a, b); }
+inline PacketI SubI(PacketI a, PacketI b) { return _mm512_sub_epi32(a, b); }
+inline PacketI AndI(PacketI a, int b) { return _mm512_and_si512(a, _mm512_set1_epi32(b)); }
+inline PacketI OrI(PacketI a, int b) { return _mm512_or_si512(a, _mm512_set1_epi32(b)); }
+inline PacketI Half(PacketI a) { return _mm512_srai_epi32(a, 1); }
+inline PacketI ExpField(PacketI a) { return _mm512_srli_epi32(a, 23); }
+inline Packet Pow2(PacketI n) {
+  const __m512i e = _mm512_add_epi32(n, _mm512_set1_epi32(127));
+  return _mm512_castsi512_ps(_mm512_slli_epi32(e, 23));
+}
+#elif defined(__AVX2__) && defined(__FMA__)
+const size_t kWidth = 8;
+typedef __m256 Packet;
+typedef __m256i PacketI;
+typedef __m256 Mask;
+inline Packet Set1(float a) { return _mm256_set1_ps(a); }
+inline Packet Load(const float *p) { return _mm256_loadu_ps(p); }
+inline void Store(float *p, Packet a) { _mm256_storeu_ps(p, a); }
+inline Packet Add(Packet a, Packet b) { return _mm256_add_ps(a, b); }
+inline Packet Sub(Packet a, Packet b) { return _mm256_sub_ps(a, b); }
+inline Packet Mul(Packet a, Packet b) { return _mm256_mul_ps(a, b); }
+inline Packet Div(Packet a, Packet b) { return _mm256_div_ps(a, b); }
+inline Packet Fma(Packet a, Packet b, Packet c) { return _mm256_fmadd_ps(a, b, c); }
+inline Packet Min(Packet a, Packet b) { return _mm256_min_ps(a, b); }
+inline Packet Max(Packet a, Packet b) { return _mm256_max_ps(a, b); }
+inline Mask Lt(Packet a, Packet b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline Mask Eq(Packet a, Packet b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+inline Mask IsNaN(Packet a) { return _mm256_cmp_ps(a, a, _CMP_UNORD_Q); }
+inline Packet Select(Mask m, Packet a, Packet b) { return _mm256_blendv_ps(b, a, m); }
+inline PacketI RoundToInt(Packet a) { return _mm256_cvtps_epi32(a); }
+inline Packet ToFloat(PacketI a) { return _mm256_cvtepi32_ps(a); }
+inline PacketI AsInt(Packet a) { return _mm256_castps_si256(a); }
+inline Packet AsFloat(PacketI a) { return _mm256_castsi256_ps(a); }
+inline PacketI AddI(PacketI a, PacketI b) { return _mm256_add_epi32(a, b); }
+inline PacketI SubI(PacketI a, PacketI b) { return _mm256_sub_epi32(a, b); }
+inline PacketI AndI(PacketI a, int b) { return _mm256_and_si256(a, _mm256_set1_epi32(b)); }
+inline PacketI OrI(PacketI a, int b) { return _mm256_or_si256(a, _mm256_set1_epi32(b)); }
+inline PacketI Half(PacketI a) { return _mm256_srai_epi32(a, 1); }
+inline PacketI ExpField(PacketI a) { return _mm256_srli_epi32(a, 23); }
+inline Packet Pow2(PacketI n) {
+  const __m256i e = _mm256_add_epi32(n, _mm256_set1_epi32(127));
+  return _mm256_castsi256_ps(_mm256_slli_epi32(e, 23));
+}
+#elif defined(__SSE2__)
+const size_t kWidth = 4;
+typedef __m128 Packet;
+typedef __m128i PacketI;
+typedef __m128 Mask;
+inline Packet Set1(float a) { return _mm_set1_ps(a); }
+inline Packet Load(const float *p) { return _mm_loadu_ps(p); }
+inline void Store(float *p, Packet a) { _mm_storeu_ps(p, a); }
+inline Packet Add(Packet a, Packet b) { return _mm_add_ps(a, b); }
+inline Packet Sub(Packet a, Packet b) { return _mm_sub_ps(a, b); }
+inline Packet Mul(Packet a, Packet b) { return _mm_mul_ps(a, b); }
+inline Packet Div(Packet a, Packet b) { return _mm_div_ps(a, b); }
+inline Packet Fma(Packet a, Packet b, Packet c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+inline Packet Min(Packet a, Packet b) { return _mm_min_ps(a, b); }
+inline Packet Max(Packet a, Packet b) { return _mm_max_ps(a, b); }
+inline Mask Lt(Packet a, Packet b) { return _mm_cmplt_ps(a, b); }
+inline Mask Eq(Packet a, Packet b) { return _mm_cmpeq_ps(a, b); }
+inline Mask IsNaN(Packet a) { return _mm_cmpunord_ps(a, a); }
+inline Packet Select(Mask m, Packet a, Packet b) {
+  return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+inline PacketI RoundToInt(Packet a) { return _mm_cvtps_epi32(a); }
+inline Packet ToFloat(PacketI a) { return _mm_cvtepi32_ps(a); }
+inline PacketI AsInt(Packet a) { return _mm_castps_si128(a); }
+inline Packet AsFloat(PacketI a) { return _mm_castsi128_ps(a); }
+inline PacketI AddI(PacketI a, PacketI b) { return _mm_add_epi32(a, b); }
+inline PacketI SubI(PacketI a, PacketI b) { return _mm_sub_epi32(a, b); }
+inline PacketI AndI(PacketI a, int b) { return _mm_and_si128(a, _mm_set1_epi32(b)); }
+inline PacketI OrI(PacketI a, int b) { return _mm_or_si128(a, _mm_set1_epi32(b)); }
+inline PacketI Half(PacketI a) { return _mm_srai_epi32(a, 1); }
+inline PacketI ExpField(PacketI a) { return _mm_srli_epi32(a, 23); }
+inline Packet Pow2(PacketI n) {
+  return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+const size_t kWidth = 4;
+typedef float32x4_t Packet;
+typedef int32x4_t PacketI;
+typedef uint32x4_t Mask;
+inline Packet Set1(float a) { return vdupq_n_f32(a); }
+inline Packet Load(const float *p) { return vld1q_f32(p); }
+inline void Store(float *p, Packet a) { vst1q_f32(p, a); }
+inline Packet Add(Packet a, Packet b) { return vaddq_f32(a, b); }
+inline Packet Sub(Packet a, Packet b) { return vsubq_f32(a, b); }
+inline Packet Mul(Packet a, Packet b) { return vmulq_f32(a, b); }
+#if defined(__aarch64__)
+inline Packet Div(Packet a, Packet b) { return vdivq_f32(a, b); }
+inline Packet Fma(Packet a, Packet b, Packet c) { return vfmaq_f32(c, a, b); }
+#else
+inline Packet Div(Packet a, Packet b) {
+  Packet r = vrecpeq_f32(b);
+  r = vmulq_f32(vrecpsq_f32(b, r), r);
+  r = vmulq_f32(vrecpsq_f32(b, r), r);
+  return vmulq_f32(a, r);
+}
+inline Packet Fma(Packet a, Packet b, Packet c) { return vmlaq_f32(c, a, b); }
+#endif
+inline Packet Min(Packet a, Packet b) { return vminq_f32(a, b); }
+inline Packet Max(Packet a, Packet b) { return vmaxq_f32(a, b); }
+inline Mask Lt(Packet a, Packet b) { return vcltq_f32(a, b); }
+inline Mask Eq(Packet a, Packet b) { return vceqq_f32(a, b); }
+inline Mask IsNaN(Packet a) { return vmvnq_u32(vceqq_f32(a, a)); }
+inline Packet Select(Mask m, Packet a, Packet b) { return vbslq_f32(m, a, b); }
+#if defined(__aarch64__)
+inline PacketI RoundToInt(Packet a) { return vcvtnq_s32_f32(a); }
+#else
+// vcvtq truncates, half away from zero is added first
+inline PacketI RoundToInt(Packet a) {
+  const uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(a), vdupq_n_u32(0x80000000u));
+  const uint32x4_t half = vorrq_u32(sign, vreinterpretq_u32_f32(vdupq_n_f32(0.5f)));
+  return vcvtq_s32_f32(vaddq_f32(a, vreinterpretq_f32_u32(half)));
+}
+#endif
+inline Packet ToFloat(PacketI a) { return vcvtq_f32_s32(a); }
+inline PacketI AsInt(Packet a) { return vreinterpretq_s32_f32(a); }
+inline Packet AsFloat(PacketI a) { return vreinterpretq_f32_s32(a); }
+inline PacketI AddI(PacketI a, PacketI b) { return vaddq_s32(a, b); }
+inline PacketI SubI(PacketI a, PacketI b) { return vsubq_s32(a, b); }
+inline PacketI AndI(PacketI a, int b) { return vandq_s32(a, vdupq_n_s32(b)); }
+inline PacketI OrI(PacketI a, int b) { return vorrq_s32(a, vdupq_n_s32(b)); }
+inline PacketI Half(PacketI a) { return vshrq_n_s32(a, 1); }
+inline PacketI ExpField(PacketI a) {
+  return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a), 23));
+}
+inline Packet Pow2(PacketI n) {
+  return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(n, vdupq_n_s32(127)), 23));
+}
+#else
+const size_t kWidth = 0;
+#endif
+
+/*! \brief the number of elements of a chunk mapped by one thread */
+const size_t kChunk = 8192;
+
+/*! \brief whether the vectorized kernels are compiled and not disabled */
+inline bool Enabled() {
+  static const bool enabled = kWidth > 0 && !dmlc::GetEnv("MXNET_CPU_EXACT_MATH", false);
+  return enabled;
+}
+
+/*! \brief the vectorized version of a functor, kEnabled is false if there is none */
+template<typename OP>
+struct Kernel {
+  static const bool kEnabled = false;
+};
+
+#if !defined(__CUDACC__) && (defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__)) || \
+                             defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__))
+/*! \brief e^x, x = n ln2 + r with |r| <= ln2 / 2 and e^r a polynomial of degree 7 */
+inline Packet Exp(Packet x) {
+  // Max(lo, x) keeps NaN, the result of NaN is fixed at the end
+  const Packet a = Min(Max(Set1(-104.0f), x), Set1(88.7228394f));
+  const PacketI n = RoundToInt(Mul(a, Set1(1.44269504088896341f)));
+  const Packet fn = ToFloat(n);
+  Packet r = Fma(fn, Set1(-0.693359375f), a);
+  r = Fma(fn, Set1(2.12194440e-4f), r);
+  Packet p = Set1(1.9875691500e-4f);
+  p = Fma(p, r, Set1(1.3981999507e-3f));
+  p = Fma(p, r, Set1(8.3334519073e-3f));
+  p = Fma(p, r, Set1(4.1665795894e-2f));
+  p = Fma(p, r, Set1(1.6666665459e-1f));
+  p = Fma(p, r, Set1(5.0000001201e-1f));
+  const Packet y = Fma(Mul(p, r), r, Add(r, Set1(1.0f)));
+  // 2^n in two factors, n = 128 and the denormal 2^n do not fit the exponent field
+  const PacketI n1 = Half(n);
+  const Packet e = Mul(Mul(y, Pow2(n1)), Pow2(SubI(n, n1)));
+  return Select(IsNaN(x), x, e);
+}
+
+/*! \brief ln x, x = 2^e m with sqrt(1/2) <= m < sqrt(2) and ln m a polynomial of degree 9 */
+inline Packet Log(Packet x) {
+  // scale the denormals up to normal floats
+  const Mask denormal = Lt(x, Set1(1.17549435e-38f));
+  const Packet a = Select(denormal, Mul(x, Set1(8388608.0f)), x);
+  const PacketI bits = AsInt(a);
+  Packet e = Sub(ToFloat(ExpField(bits)), Select(denormal, Set1(149.0f), Set1(126.0f)));
+  Packet m = AsFloat(OrI(AndI(bits, 0x007fffff), 0x3f000000));
+  // m is in [0.5, 1), move it to [sqrt(1/2), sqrt(2))
+  const Mask small = Lt(m, Set1(0.707106781186547524f));
+  e = Sub(e, Select(small, Set1(1.0f), Set1(0.0f)));
+  m = Add(Sub(m, Set1(1.0f)), Select(small, m, Set1(0.0f)));
+  const Packet z = Mul(m, m);
+  Packet p = Set1(7.0376836292e-2f);
+  p = Fma(p, m, Set1(-1.1514610310e-1f));
+  p = Fma(p, m, Set1(1.1676998740e-1f));
+  p = Fma(p, m, Set1(-1.2420140846e-1f));
+  p = Fma(p, m, Set1(1.4249322787e-1f));
+  p = Fma(p, m, Set1(-1.6668057665e-1f));
+  p = Fma(p, m, Set1(2.0000714765e-1f));
+  p = Fma(p, m, Set1(-2.4999993993e-1f));
+  p = Fma(p, m, Set1(3.3333331174e-1f));
+  Packet y = Mul(Mul(p, m), z);
+  y = Fma(e, Set1(-2.12194440e-4f), y);
+  y = Fma(z, Set1(-0.5f), y);
+  Packet r = Fma(e, Set1(0.693359375f), Add(m, y));
+  const Packet inf = Set1(std::numeric_limits<float>::infinity());
+  r = Select(Eq(x, inf), inf, r);
+  r = Select(Eq(x, Set1(0.0f)), Set1(-std::numeric_limits<float>::infinity()), r);
+  return Select(Lt(x, Set1(0.0f)), Set1(std::numeric_limits<float>::quiet_NaN()),
+                Select(IsNaN(x), x, r));
+}
+
+/*! \brief ln(1 + u) for u >= 0, exact for the u that round 1 + u to 1 */
+inline Packet Log1p(Packet u) {
+  const Packet w = Add(u, Set1(1.0f));
+  const Packet r = Div(Mul(Log(w), u), Sub(w, Set1(1.0f)));
+  return Select(Eq(w, Set1(1.0f)), u, r);
+}
+
+/*! \brief tanh x, odd rational function of x, +-1 beyond |x| = 7.9 */
+inline Packet Tanh(Packet x) {
+  const Packet a = Min(Max(Set1(-7.90531110763549805f), x), Set1(7.90531110763549805f));
+  const Packet a2 = Mul(a, a);
+  Packet p = Set1(-2.76076847742355e-16f);
+  p = Fma(p, a2, Set1(2.00018790482477e-13f));
+  p = Fma(p, a2, Set1(-8.60467152213735e-11f));
+  p = Fma(p, a2, Set1(5.12229709037114e-08f));
+  p = Fma(p, a2, Set1(1.48572235717979e-05f));
+  p = Fma(p, a2, Set1(6.37261928875436e-04f));
+  p = Fma(p, a2, Set1(4.89352455891786e-03f));
+  p = Mul(p, a);
+  Packet q = Set1(1.19825839466702e-06f);
+  q = Fma(q, a2, Set1(1.18534705686654e-04f));
+  q = Fma(q, a2, Set1(2.26843463243900e-03f));
+  q = Fma(q, a2, Set1(4.89352518554385e-03f));
+  return Select(IsNaN(x), x, Div(p, q));
+}
+
+template<>
+struct Kernel<mshadow_op::exp> {
+  static const bool kEnabled = true;
+  static Packet Map(Packet x) { return Exp(x); }
+};
+
+template<>
+struct Kernel<mshadow_op::log> {
+  static const bool kEnabled = true;
+  static Packet Map(Packet x) { return Log(x); }
+};
+
+template<>
+struct Kernel<mshadow_op::tanh> {
+  static const bool kEnabled = true;
+  static Packet Map(Packet x) { return Tanh(x); }
+};
+
+template<>
+struct Kernel<mshadow_op::sigmoid> {
+  static const bool kEnabled = true;
+  static Packet Map(Packet x) {
+    const Packet one = Set1(1.0f);
+    return Div(one, Add(one, Exp(Sub(Set1(0.0f), x))));
+  }
+};
+
+template<>
+struct Kernel<mshadow_op::softrelu> {
+  static const bool kEnabled = true;
+  // max(x, 0) + ln(1 + e^-|x|), which neither overflows nor cancels
+  static Packet Map(Packet x) {
+    const Packet u = Exp(Min(x, Sub(Set1(0.0f), x)));
+    return Add(Max(x, Set1(0.0f)), Log1p(u));
+  }
+};
+
+/*! \brief out = OP(in) or out += OP(in) over one contiguous range */
+template<typename OP>
+inline void MapRange(const float *in, float *out, size_t size, bool add) {
+  size_t i = 0;
+  for (; i + kWidth <= size; i += kWidth) {
+    Packet y = Kernel<OP>::Map(Load(in + i));
+    if (add) y = Add(Load(out + i), y);
+    Store(out + i, y);
+  }
+  if (i < size) {
+    // the tail goes through a padded packet, so that each element has the same result
+    // wherever it is in the array
+    float buf[kWidth];
+    std::fill(buf, buf + kWidth, 0.0f);
+    std::copy(in + i, in + size, buf);
+    Packet y = Kernel<OP>::Map(Load(buf));
+    if (add) {
+      std::copy(out + i, out + size, buf);
+      y = Add(Load(buf), y);
+    }
+    Store(buf, y);
+    std::copy(buf, buf + size - i, out + i);
+  }
+}
+
+template<typename OP, bool enabled = Kernel<OP>::kEnabled>
+struct Mapper {
+  static bool Map(const float *in, float *out, size_t size, bool add) {
+    return false;
+  }
+};
+
+template<typename OP>
+struct Mapper<OP, true> {
+  static bool Map(const float *in, float *out, size_t size, bool add) {
+    if (!Enabled()) return false;
+    const int nchunk = static_cast<int>((size + kChunk - 1) / kChunk);
+    #pragma omp parallel for schedule(static) if (nchunk > 1)
+    for (int c = 0; c < nchunk; ++c) {
+      const size_t begin = static_cast<size_t>(c) * kChunk;
+      MapRange<OP>(in + begin, out + begin, std::min(kChunk, size - begin), add);
+    }
+    return true;
+  }
+};
+#else
+template<typename OP>
+struct Mapper {
+  static bool Map(const float *in, float *out, size_t size, bool add) {
+    return false;
+  }
+};
+#endif
+
+/*!
+ * \brief out[i] = OP(in[i]), or += with add, in may be out.
+ * \return false if OP has no vectorized kernel or MXNET_CPU_EXACT_MATH is set,
+ *  then nothing is written.
+ */
+template<typename OP>
+inline bool Map(const float *in, float *out, size_t size, bool add = false) {
+  return Mapper<OP>::Map(in, out, size, add);
+}
+
+/*! \brief Assign(out, req, F<OP>(in)), vectorized for float on cpu */
+template<typename OP, typename xpu, typename DType>
+inline void MapExp(mshadow::Tensor<xpu, 2, DType> out, OpReqType req,
+                   const mshadow::Tensor<xpu, 2, DType> &in) {
+  using mshadow::expr::F;
+  Assign(out, req, F<OP>(in));
+}
+
+template<typename OP>
+inline void MapExp(mshadow::Tensor<cpu, 2, float> out, OpReqType req,
+                   const mshadow::Tensor<cpu, 2, float> &in) {
+  using mshadow::expr::F;
+  if (req != kNullOp && Kernel<OP>::kEnabled && Enabled()) {
+    const bool add = req == kAddTo;
+    if (out.CheckContiguous() && in.CheckContiguous()) {
+      Map<OP>(in.dptr_, out.dptr_, out.shape_.Size(), add);
+    } else {
+      for (index_t i = 0; i < out.size(0); ++i) {
+        Map<OP>(in[i].dptr_, out[i].dptr_, out.size(1), add);
+      }
+    }
+    return;
+  }
+  Assign(out, req, F<OP>(in));
+}
+}  // namespace simd
+}  // namespace mshadow_op
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_MSHADOW_OP_SIMD_H_
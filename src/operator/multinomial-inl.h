@@ -0,0 +1,317 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file multinomial-inl.h
+ * \brief sampling of categorical distributions, given by the probabilities along the last
+ *  axis of the data, by inverting their cumulative sums with counter based random numbers.
+ *  The imperative version is sample_multinomial in sample_op-inl.h.
+ */
+#ifndef MXNET_OPERATOR_MULTINOMIAL_INL_H_
+#define MXNET_OPERATOR_MULTINOMIAL_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <cmath>
+#include <map>
+#include <vector>
+#include <string>
+#include <utility>
+#include "./operator_common.h"
+#include "../common/philox.h"
+
+namespace mxnet {
+namespace op {
+
+namespace multinomial {
+enum MultinomialOpInputs {kData};
+enum MultinomialOpOutputs {kOut, kLogProb};
+enum MultinomialOpResource {kRandom};
+
+/*! \brief uniform number n in [0, 1) of the generator, the element n % 4 of block n / 4 */
+MSHADOW_XINLINE float Uniform(const ParallelRandomState &state, size_t n) {
+  using namespace common::random;
+  uint32_t bits[kPhiloxWidth];
+  Philox(state.key[0], state.key[1], state.counter + n / kPhiloxWidth, state.stream, bits);
+  return 1.0f - ToUniform(bits[n % kPhiloxWidth]);
+}
+
+/*!
+ * \brief the first class of the row p whose cumulative probability exceeds u, or the
+ *  last class of positive probability when rounding leaves u above the total
+ */
+MSHADOW_XINLINE int InverseCDF(const float *p, int K, float u) {
+  float cum = 0;
+  int last = 0;
+  for (int k = 0; k < K; ++k) {
+    if (p[k] <= 0) continue;
+    cum += p[k];
+    last = k;
+    if (u < cum) return k;
+  }
+  return last;
+}
+
+/*!
+ * \brief draw S samples of each of the rows of prob (rows, K), out[r * S + j] is
+ *  sample j of row r and logp its log probability when not nullptr.
+ *  The counter of state is not advanced.
+ */
+inline void Sample(mshadow::Stream<cpu> *s, const ParallelRandomState &state, int rows,
+                   int K, int S, const float *prob, float *out, float *logp) {
+  const int size = rows * S;
+  #pragma omp parallel for schedule(static)
+  for (int n = 0; n < size; ++n) {
+    const float *p = prob + static_cast<size_t>(n / S) * K;
+    const int k = InverseCDF(p, K, Uniform(state, n));
+    out[n] = static_cast<float>(k);
+    if (logp != nullptr) logp[n] = std::log(p[k]);
+  }
+}
+
+/*! \brief grad += the gradient of the log probabilities of the samples, 1 / p */
+inline void LogProbGrad(mshadow::Stream<cpu> *s, int rows, int K, int S, const float *prob,
+                        const float *out, const float *glogp, float *grad) {
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < rows; ++r) {
+    for (int j = 0; j < S; ++j) {
+      const size_t n = static_cast<size_t>(r) * S + j;
+      const size_t e = static_cast<size_t>(r) * K + static_cast<int>(out[n]);
+      grad[e] += glogp[n] / prob[e];
+    }
+  }
+}
+
+#ifdef __CUDACC__
+/*!
+ * \brief one warp per sample, which scans the row 32 classes at a time and stops at the
+ *  first chunk where the cumulative probability exceeds the uniform number
+ */
+__global__ void SampleKernel(ParallelRandomState state, int rows, int K, int S,
+                             const float *prob, float *out, float *logp) {
+  const int kWarp = 32;
+  const int lane = threadIdx.x % kWarp, warps = blockDim.x / kWarp;
+  for (int n = blockIdx.x * warps + threadIdx.x / kWarp; n < rows * S;
+       n += gridDim.x * warps) {
+    const float *p = prob + static_cast<size_t>(n / S) * K;
+    const float u = Uniform(state, n);
+    float base = 0;
+    int found = -1, last = 0;
+    for (int c = 0; c < K; c += kWarp) {
+      const float v = c + lane < K ? p[c + lane] : 0.0f;
+      float cum = v > 0 ? v : 0.0f;
+      for (int offset = 1; offset < kWarp; offset <<= 1) {
+#if CUDA_VERSION >= 9000
+        const float prev = __shfl_up_sync(0xffffffff, cum, offset);
+#else
+        const float prev = __shfl_up(cum, offset);
+#endif
+        if (lane >= offset) cum += prev;
+      }
+      cum += base;
+#if CUDA_VERSION >= 9000
+      const unsigned hit = __ballot_sync(0xffffffff, v > 0 && u < cum);
+      const unsigned positive = __ballot_sync(0xffffffff, v > 0);
+      base = __shfl_sync(0xffffffff, cum, kWarp - 1);
+#else
+      const unsigned hit = __ballot(v > 0 && u < cum);
+      const unsigned positive = __ballot(v > 0);
+      base = __shfl(cum, kWarp - 1);
+#endif
+      if (hit != 0) {
+        found = c + __ffs(hit) - 1;
+        break;
+      }
+      if (positive != 0) last = c + kWarp - 1 - __clz(positive);
+    }
+    if (lane == 0) {
+      const int k = found >= 0 ? found : last;
+      out[n] = static_cast<float>(k);
+      if (logp != nullptr) logp[n] = logf(p[k]);
+    }
+  }
+}
+
+__global__ void LogProbGradKernel(int rows, int K, int S, const float *prob, const float *out,
+                                  const float *glogp, float *grad) {
+  for (int r = blockIdx.x * blockDim.x + threadIdx.x; r < rows; r += gridDim.x * blockDim.x) {
+    for (int j = 0; j < S; ++j) {
+      const size_t n = static_cast<size_t>(r) * S + j;
+      const size_t e = static_cast<size_t>(r) * K + static_cast<int>(out[n]);
+      grad[e] += glogp[n] / prob[e];
+    }
+  }
+}
+
+inline void Sample(mshadow::Stream<gpu> *s, const ParallelRandomState &state, int rows,
+                   int K, int S, const float *prob, float *out, float *logp) {
+  using namespace mshadow::cuda;
+  const size_t threads = static_cast<size_t>(rows) * S * 32;
+  if (threads == 0) return;
+  const int grid = static_cast<int>(std::min<size_t>(
+      kMaxGridNum, (threads + kBaseThreadNum - 1) / kBaseThreadNum));
+  SampleKernel<<<grid, kBaseThreadNum, 0, mshadow::Stream<gpu>::GetStream(s)>>>(
+      state, rows, K, S, prob, out, logp);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+inline void LogProbGrad(mshadow::Stream<gpu> *s, int rows, int K, int S, const float *prob,
+                        const float *out, const float *glogp, float *grad) {
+  using namespace mshadow::cuda;
+  if (rows == 0) return;
+  const int grid = std::min(kMaxGridNum, (rows + kBaseThreadNum - 1) / kBaseThreadNum);
+  LogProbGradKernel<<<grid, kBaseThreadNum, 0, mshadow::Stream<gpu>::GetStream(s)>>>(
+      rows, K, S, prob, out, glogp, grad);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace multinomial
+
+struct MultinomialParam : public dmlc::Parameter<MultinomialParam> {
+  TShape shape;
+  bool get_prob;
+  DMLC_DECLARE_PARAMETER(MultinomialParam) {
+    DMLC_DECLARE_FIELD(shape).set_default(TShape())
+    .describe("The shape of the samples of each distribution, one sample by default.");
+    DMLC_DECLARE_FIELD(get_prob).set_default(false)
+    .describe("Whether to also output the log probabilities of the samples, whose "
+              "gradient is propagated to the probabilities, e.g. for REINFORCE.");
+  }
+};
+
+/*! \brief the shape of the samples, the data shape without its last axis, then shape */
+inline TShape MultinomialShape(const TShape &dshape, const MultinomialParam &param) {
+  CHECK_GE(dshape.ndim(), 1U) << "sample_multinomial needs the probabilities on the last axis";
+  std::vector<index_t> ret(dshape.data(), dshape.data() + dshape.ndim() - 1);
+  ret.insert(ret.end(), param.shape.data(), param.shape.data() + param.shape.ndim());
+  if (ret.empty()) ret.push_back(1);
+  return TShape(ret.begin(), ret.end());
+}
+
+/**
+ * \brief samples of the categorical distributions on the last axis of the data,
+ *  as float class indices.
+ * \tparam xpu The device that the op will be executed on.
+ */
+template<typename xpu>
+class MultinomialOp : public Operator {
+ public:
+  explicit MultinomialOp(MultinomialParam param) : param_(param) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace multinomial;
+    if (req[kOut] == kNullOp) return;
+    CHECK_EQ(req[kOut], kWriteTo);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    const TShape &dshape = in_data[kData].shape_;
+    const int K = static_cast<int>(dshape[dshape.ndim() - 1]);
+    const int rows = static_cast<int>(dshape.Size() / K);
+    const int S = static_cast<int>(out_data[kOut].Size() / rows);
+    ParallelRandomState *prnd = ctx.requested[kRandom].get_parallel_random();
+    Sample(s, *prnd, rows, K, S, in_data[kData].dptr<real_t>(), out_data[kOut].dptr<real_t>(),
+           req[kLogProb] == kNullOp ? nullptr : out_data[kLogProb].dptr<real_t>());
+    prnd->counter += (static_cast<size_t>(rows) * S + common::random::kPhiloxWidth - 1) /
+        common::random::kPhiloxWidth;
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace multinomial;
+    if (req[kData] == kNullOp) return;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 1> grad = in_grad[kData].FlatTo1D<xpu, real_t>(s);
+    if (req[kData] != kAddTo) grad = 0.0f;
+    // the samples have no gradient, only their log probabilities
+    if (!param_.get_prob) return;
+    const TShape &dshape = in_data[kData].shape_;
+    const int K = static_cast<int>(dshape[dshape.ndim() - 1]);
+    const int rows = static_cast<int>(dshape.Size() / K);
+    const int S = static_cast<int>(out_data[kOut].Size() / rows);
+    LogProbGrad(s, rows, K, S, in_data[kData].dptr<real_t>(), out_data[kOut].dptr<real_t>(),
+                out_grad[kLogProb].dptr<real_t>(), grad.dptr_);
+  }
+
+ private:
+  MultinomialParam param_;
+};  // class MultinomialOp
+
+template<typename xpu>
+Operator *CreateOp(MultinomialParam param);
+
+#if DMLC_USE_CXX11
+class MultinomialProp : public OperatorProperty {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  std::vector<std::string> ListOutputs() const override {
+    return {"output", "log_prob"};
+  }
+
+  int NumVisibleOutputs() const override {
+    return param_.get_prob ? 2 : 1;
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    CHECK_EQ(in_shape->size(), 1U) << "Input:[data]";
+    const TShape &dshape = in_shape->at(multinomial::kData);
+    if (dshape.ndim() == 0) return false;
+    const TShape oshape = MultinomialShape(dshape, param_);
+    out_shape->clear();
+    out_shape->push_back(oshape);
+    out_shape->push_back(oshape);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new MultinomialProp();
+    ptr->param_ = param_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "sample_multinomial";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    if (!param_.get_prob) return {};
+    return {out_grad[multinomial::kLogProb], in_data[multinomial::kData],
+            out_data[multinomial::kOut]};
+  }
+
+  std::vector<ResourceRequest> ForwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kParallelRandom};
+  }
+
+  Operator* CreateOperator(Context ctx) const override;
+
+ private:
+  MultinomialParam param_;
+};  // class MultinomialProp
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_MULTINOMIAL_INL_H_
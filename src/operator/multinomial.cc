@@ -0,0 +1,27 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file multinomial.cc
+ * \brief sampling of categorical distributions
+*/
+#include "./multinomial-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<cpu>(MultinomialParam param) {
+  return new MultinomialOp<cpu>(param);
+}
+
+Operator *MultinomialProp::CreateOperator(Context ctx) const {
+  DO_BIND_DISPATCH(CreateOp, param_);
+}
+
+DMLC_REGISTER_PARAMETER(MultinomialParam);
+
+MXNET_REGISTER_OP_PROPERTY(sample_multinomial, MultinomialProp)
+.describe("Sample the categorical distributions given by the probabilities on the last "
+          "axis of data, the output is the float class indices of shape data.shape[:-1] "
+          "+ shape. The probabilities of each distribution should sum to 1. Only float32.")
+.add_argument("data", "Symbol", "Probabilities, e.g. softmax outputs")
+.add_arguments(MultinomialParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
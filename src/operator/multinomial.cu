@@ -0,0 +1,14 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file multinomial.cu
+ * \brief sampling of categorical distributions
+*/
+#include "./multinomial-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<gpu>(MultinomialParam param) {
+  return new MultinomialOp<gpu>(param);
+}
+}  // namespace op
+}  // namespace mxnet
@@ -53,14 +53,14 @@ class NativeOp : public Operator {
     ndims.clear();
     shapes.clear();
     tags.clear();
-    SyncVec(in_data, "in_data", s, 0);
-    SyncVec(out_data, "out_data", s, 1);
+    SyncVec(in_data, "in_data", s, 0, nullptr);
+    SyncVec(out_data, "out_data", s, 1, &req);
     s->Wait();
     param_.pinfo->forward(ptrs.size(), ptrs.data(), ndims.data(), shapes.data(),
         tags.data(), param_.pinfo->p_forward);
     for (index_t i = 0; i < out_data.size(); ++i) {
       CHECK_NE(req[i], kAddTo) << "NativeOp doesn't support AddTo for output";
-      if (req[i] != kNullOp) {
+      if (req[i] != kNullOp && !kDirect) {
         std::stringstream ss;
         ss << std::string("out_data") << i;
         Copy(out_data[i].FlatTo2D<xpu, real_t>(s),
@@ -83,18 +83,18 @@ class NativeOp : public Operator {
     ndims.clear();
     shapes.clear();
     tags.clear();
-    SyncVec(in_data, "in_data", s, 0);
-    SyncVec(out_data, "out_data", s, 1);
-    SyncVec(in_grad, "in_grad", s, 2);
+    SyncVec(in_data, "in_data", s, 0, nullptr);
+    SyncVec(out_data, "out_data", s, 1, nullptr);
+    SyncVec(in_grad, "in_grad", s, 2, &req);
     if (param_.need_top_grad) {
-      SyncVec(out_grad, "out_grad", s, 3);
+      SyncVec(out_grad, "out_grad", s, 3, nullptr);
     }
     s->Wait();
     param_.pinfo->backward(ptrs.size(), ptrs.data(), ndims.data(), shapes.data(),
         tags.data(), param_.pinfo->p_backward);
     for (index_t i = 0; i < in_grad.size(); ++i) {
       CHECK_NE(req[i], kAddTo) << "NativeOp doesn't support AddTo for output";
-      if (req[i] != kNullOp) {
+      if (req[i] != kNullOp && !kDirect) {
         std::stringstream ss;
         ss << std::string("in_grad") << i;
         Copy(in_grad[i].FlatTo2D<xpu, real_t>(s),
@@ -105,6 +105,13 @@ class NativeOp : public Operator {
   }
 
  private:
+  /*!
+   * \brief whether the callback works on the blobs in place. The blobs of a
+   *  cpu context are contiguous host memory the callback can wrap as is, the
+   *  ones of a gpu context are staged through host buffers, NDArrayOp runs on
+   *  the device memory without this copy.
+   */
+  static constexpr bool kDirect = xpu::kDevMask == mshadow::cpu::kDevMask;
   NativeOpParam param_;
   std::vector<real_t*> ptrs;
   std::vector<int> ndims;
@@ -112,9 +119,14 @@ class NativeOp : public Operator {
   std::vector<int> tags;
   std::map<std::string, std::pair<TShape, mshadow::Tensor<cpu, 2> > > buffer_map;
 
+  /*!
+   * \brief get the host buffer of a blob
+   * \param copy whether to copy the content of the blob into it
+   */
   virtual void SyncBuffer(const TBlob &tblob,
                           const std::string &name,
-                          mshadow::Stream<xpu> *stream) {
+                          mshadow::Stream<xpu> *stream,
+                          bool copy) {
     using namespace mshadow;
     std::map<std::string, std::pair<TShape, mshadow::Tensor<cpu, 2> > >::iterator buffer =
       buffer_map.find(name);
@@ -130,18 +142,31 @@ class NativeOp : public Operator {
                                                         false));
       buffer = buffer_map.find(name);
     }
-    Copy(buffer->second.second, tblob.FlatTo2D<xpu, real_t>(stream), stream);
+    if (copy) {
+      Copy(buffer->second.second, tblob.FlatTo2D<xpu, real_t>(stream), stream);
+    }
   }
 
+  /*!
+   * \brief pass the blobs of vec to the callback
+   * \param req the requests of vec when the callback writes it, nullptr when it reads it.
+   *  An output not requested goes to a host buffer, not to the blob.
+   */
   virtual void SyncVec(const std::vector<TBlob> &vec,
                        const std::string &prefix,
                        mshadow::Stream<xpu> *stream,
-                       int tag) {
+                       int tag,
+                       const std::vector<OpReqType> *req) {
     for (size_t i = 0; i < vec.size(); ++i) {
-      std::stringstream name;
-      name << prefix << i;
-      SyncBuffer(vec[i], name.str(), stream);
-      ptrs.push_back(buffer_map[name.str()].second.dptr_);
+      const bool skipped = req != nullptr && (*req)[i] == kNullOp;
+      if (kDirect && !skipped) {
+        ptrs.push_back(static_cast<real_t*>(vec[i].dptr_));
+      } else {
+        std::stringstream name;
+        name << prefix << i;
+        SyncBuffer(vec[i], name.str(), stream, !kDirect && !skipped);
+        ptrs.push_back(buffer_map[name.str()].second.dptr_);
+      }
       ndims.push_back(vec[i].ndim());
       shapes.push_back(const_cast<index_t*>(vec[i].shape_.data()));
       tags.push_back(tag);
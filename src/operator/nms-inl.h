@@ -0,0 +1,202 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file nms-inl.h
+ * \brief greedy non-maximum suppression of boxes sorted by decreasing score.
+ *
+ *  A box is kBoxSize floats, [x1, y1, x2, y2, score, id]. Box j is suppressed
+ *  by a kept box i < j of the same id whose intersection over union with j is
+ *  above the threshold. The pixel coordinates of Faster R-CNN use offset 1,
+ *  a box then spans x2 - x1 + 1 pixels, normalized coordinates use offset 0.
+ *  - On cpu the boxes are scanned once, each kept box tests the rest.
+ *  - On gpu blocks of 64 x 64 boxes compute the bit masks of the suppressed
+ *    boxes in parallel, then a single block walks the boxes in order and ORs
+ *    the masks of the kept ones. The kept indices never leave the device.
+ */
+#ifndef MXNET_OPERATOR_NMS_INL_H_
+#define MXNET_OPERATOR_NMS_INL_H_
+
+#include <mxnet/base.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#ifdef __CUDACC__
+#include <thrust/device_ptr.h>
+#include <thrust/functional.h>
+#include <thrust/sort.h>
+#include <thrust/system/cuda/execution_policy.h>
+#endif
+
+namespace mxnet {
+namespace op {
+namespace nms {
+/*! \brief floats of a box, x1, y1, x2, y2, score, id */
+const int kBoxSize = 6;
+/*! \brief boxes of a block of the gpu masks, the bits of one mask word */
+const int kBlock = 64;
+
+/*! \brief whether a suppresses b */
+MSHADOW_XINLINE bool Suppress(const float *a, const float *b, float thresh, float offset) {
+  if (a[5] != b[5]) return false;
+  const float w = fminf(a[2], b[2]) - fmaxf(a[0], b[0]) + offset;
+  const float h = fminf(a[3], b[3]) - fmaxf(a[1], b[1]) + offset;
+  if (w <= 0.0f || h <= 0.0f) return false;
+  const float inter = w * h;
+  const float area_a = (a[2] - a[0] + offset) * (a[3] - a[1] + offset);
+  const float area_b = (b[2] - b[0] + offset) * (b[3] - b[1] + offset);
+  return inter > thresh * (area_a + area_b - inter);
+}
+
+/*! \brief the number of floats of the gpu masks of n boxes, 0 on cpu */
+template<typename xpu>
+inline index_t MaskSize(index_t n) {
+  return 0;
+}
+
+/*!
+ * \brief keep[0, *num_keep) are the indices of the boxes kept, in order, at most max_keep
+ * \param mask the workspace of MaskSize<xpu>(n) floats
+ */
+inline void Nms(mshadow::Stream<cpu> *s, const float *boxes, int n, float thresh, float offset,
+                int max_keep, float *mask, int *keep, int *num_keep) {
+  std::vector<char> removed(n, 0);
+  int count = 0;
+  for (int i = 0; i < n && count < max_keep; ++i) {
+    if (removed[i]) continue;
+    keep[count++] = i;
+    const float *a = boxes + i * kBoxSize;
+    for (int j = i + 1; j < n; ++j) {
+      if (!removed[j] && Suppress(a, boxes + j * kBoxSize, thresh, offset)) removed[j] = 1;
+    }
+  }
+  *num_keep = count;
+}
+
+/*!
+ * \brief order[0, top) are the indices of the top keys, equal keys by index
+ * \param order 0, 1, ..., count - 1 on entry
+ */
+inline void SortByScore(mshadow::Stream<cpu> *s, float *keys, int *order, int count, int top) {
+  std::partial_sort(order, order + top, order + count, [keys](int a, int b) {
+    return keys[a] > keys[b] || (keys[a] == keys[b] && a < b);
+  });
+}
+
+/*! \brief sorted[j] is the box order[j] */
+inline void Gather(mshadow::Stream<cpu> *s, const float *boxes, const int *order, int top,
+                   float *sorted) {
+  for (int j = 0; j < top; ++j) {
+    std::copy(boxes + order[j] * kBoxSize, boxes + (order[j] + 1) * kBoxSize,
+              sorted + j * kBoxSize);
+  }
+}
+
+#ifdef __CUDACC__
+template<>
+inline index_t MaskSize<gpu>(index_t n) {
+  const index_t nblock = (n + kBlock - 1) / kBlock;
+  return n * nblock * sizeof(uint64_t) / sizeof(float);
+}
+
+/*! \brief number of blocks of the grid stride loops over size elements */
+inline int NumBlocks(index_t size) {
+  using namespace mshadow::cuda;
+  return static_cast<int>(std::max<index_t>(1, std::min<index_t>(
+      kMaxGridNum, (size + kBaseThreadNum - 1) / kBaseThreadNum)));
+}
+
+/*!
+ * \brief the block (by, bx) sets bit j of mask[i][bx] when box i of block by
+ *  suppresses box j of block bx, the blocks below the diagonal are skipped
+ */
+__global__ void NmsMaskKernel(const float *boxes, int n, float thresh, float offset,
+                              uint64_t *mask) {
+  const int row = blockIdx.y, col = blockIdx.x;
+  if (row > col) return;
+  const int nblock = (n + kBlock - 1) / kBlock;
+  const int row_size = min(n - row * kBlock, kBlock);
+  const int col_size = min(n - col * kBlock, kBlock);
+  __shared__ float block_boxes[kBlock * kBoxSize];
+  if (threadIdx.x < col_size) {
+    for (int k = 0; k < kBoxSize; ++k) {
+      block_boxes[threadIdx.x * kBoxSize + k] =
+          boxes[(col * kBlock + threadIdx.x) * kBoxSize + k];
+    }
+  }
+  __syncthreads();
+  if (threadIdx.x < row_size) {
+    const int i = row * kBlock + threadIdx.x;
+    const float *a = boxes + i * kBoxSize;
+    uint64_t bits = 0;
+    for (int j = row == col ? threadIdx.x + 1 : 0; j < col_size; ++j) {
+      if (Suppress(a, block_boxes + j * kBoxSize, thresh, offset)) bits |= 1ULL << j;
+    }
+    mask[static_cast<size_t>(i) * nblock + col] = bits;
+  }
+}
+
+/*! \brief one block walks the boxes, removed is the OR of the masks of the kept boxes */
+__global__ void NmsReduceKernel(const uint64_t *mask, int n, int max_keep, int *keep,
+                                int *num_keep) {
+  extern __shared__ uint64_t removed[];
+  const int nblock = (n + kBlock - 1) / kBlock;
+  for (int j = threadIdx.x; j < nblock; j += blockDim.x) removed[j] = 0;
+  __syncthreads();
+  // the branches depend on shared memory only, all threads take the same ones
+  int count = 0;
+  for (int i = 0; i < n && count < max_keep; ++i) {
+    const int word = i / kBlock;
+    if ((removed[word] >> (i % kBlock)) & 1ULL) continue;
+    if (threadIdx.x == 0) keep[count] = i;
+    ++count;
+    __syncthreads();
+    const uint64_t *m = mask + static_cast<size_t>(i) * nblock;
+    for (int j = word + threadIdx.x; j < nblock; j += blockDim.x) removed[j] |= m[j];
+    __syncthreads();
+  }
+  if (threadIdx.x == 0) *num_keep = count;
+}
+
+/*! \brief the same as the cpu version, num_keep is on the device */
+inline void Nms(mshadow::Stream<gpu> *s, const float *boxes, int n, float thresh, float offset,
+                int max_keep, float *mask, int *keep, int *num_keep) {
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  const int nblock = (n + kBlock - 1) / kBlock;
+  uint64_t *bits = reinterpret_cast<uint64_t*>(mask);
+  if (n > 0) {
+    NmsMaskKernel<<<dim3(nblock, nblock), kBlock, 0, stream>>>(boxes, n, thresh, offset, bits);
+  }
+  NmsReduceKernel<<<1, mshadow::cuda::kBaseThreadNum, nblock * sizeof(uint64_t), stream>>>(
+      bits, n, max_keep, keep, num_keep);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+__global__ void GatherKernel(const float *boxes, const int *order, int top, float *sorted) {
+  const int size = top * kBoxSize;
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < size; i += blockDim.x * gridDim.x) {
+    sorted[i] = boxes[order[i / kBoxSize] * kBoxSize + i % kBoxSize];
+  }
+}
+
+/*! \brief a stable radix sort of all the scores, keys are sorted in place */
+inline void SortByScore(mshadow::Stream<gpu> *s, float *keys, int *order, int count, int top) {
+  thrust::device_ptr<float> kptr(keys);
+  thrust::device_ptr<int> optr(order);
+  thrust::stable_sort_by_key(thrust::cuda::par.on(mshadow::Stream<gpu>::GetStream(s)),
+                             kptr, kptr + count, optr, thrust::greater<float>());
+}
+
+inline void Gather(mshadow::Stream<gpu> *s, const float *boxes, const int *order, int top,
+                   float *sorted) {
+  GatherKernel<<<NumBlocks(top * kBoxSize), mshadow::cuda::kBaseThreadNum, 0,
+                 mshadow::Stream<gpu>::GetStream(s)>>>(boxes, order, top, sorted);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+#endif  // __CUDACC__
+}  // namespace nms
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_NMS_INL_H_
@@ -177,6 +177,15 @@ class SimpleOpRegEntryImpl : public SimpleOpRegEntry {
     return *this;
   }
 
+  TSelf& set_accept_strided(bool accept_strided) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reg_counter_ != 1) return *this;
+    NDArrayFunctionReg &reg = NDArrayReg();
+    reg.set_type_mask(accept_strided ? (reg.type_mask | kAcceptStridedArgs) :
+                      (reg.type_mask & ~kAcceptStridedArgs));
+    return *this;
+  }
+
   TSelf& describe(const std::string &description) override {
     std::lock_guard<std::mutex> lock(mutex_);
     if (reg_counter_ != 1) return *this;
@@ -484,7 +493,7 @@ void SimpleOpRegEntryImpl::RegisterSourceImperative() {
         (*fun)(env, &tmp, req, ctx);
 #if MXNET_USE_CUDA
         if (dev_mask == gpu::kDevMask) {
-          ctx.get_stream<gpu>()->Wait();
+          Engine::Get()->WaitForStream(ctx);
         }
 #endif
       }, ret.ctx(), {}, write_vars);
@@ -668,7 +677,7 @@ void SimpleOpRegEntryImpl::RegisterUnaryImperative() {
         (*fun)(src.data(), env, &tmp, req, ctx);
 #if MXNET_USE_CUDA
         if (dev_mask == gpu::kDevMask) {
-          ctx.get_stream<gpu>()->Wait();
+          Engine::Get()->WaitForStream(ctx);
         }
 #endif
       }, src.ctx(), const_vars, write_vars);
@@ -942,7 +951,7 @@ void SimpleOpRegEntryImpl::RegisterBinaryImperative() {
         (*fun)(lhs.data(), rhs.data(), env, &tmp, req, ctx);
         #if MXNET_USE_CUDA
         if (dev_mask == gpu::kDevMask) {
-          ctx.get_stream<gpu>()->Wait();
+          Engine::Get()->WaitForStream(ctx);
         }
         #endif
       }, lhs.ctx(), const_vars, write_vars);
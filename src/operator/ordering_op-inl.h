@@ -0,0 +1,465 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file ordering_op-inl.h
+ * \brief topk, sort and argsort along one axis.
+ *
+ *  The input is viewed as (M, L, N) with L the length of the axis, each of the
+ *  M * N segments of stride N is ordered on its own.
+ *  - On cpu the segments run in parallel with OpenMP, topk is a partial sort
+ *    that takes O(L log k) per segment.
+ *  - On gpu all the segments are ordered at once by two stable radix sorts of
+ *    thrust, first by value, then by segment, so that the values are never
+ *    copied to the host.
+ *  Equal values keep the order of their positions. The indices are returned in
+ *  the type of the input.
+ */
+#ifndef MXNET_OPERATOR_ORDERING_OP_INL_H_
+#define MXNET_OPERATOR_ORDERING_OP_INL_H_
+
+#include <dmlc/parameter.h>
+#include <mxnet/operator_util.h>
+#include <algorithm>
+#include <vector>
+#include "./operator_common.h"
+#ifdef __CUDACC__
+#include <thrust/device_ptr.h>
+#include <thrust/functional.h>
+#include <thrust/sort.h>
+#include <thrust/system/cuda/execution_policy.h>
+#endif
+
+#if defined(__CUDACC__)
+#define XPU gpu
+#else
+#define XPU cpu
+#endif
+
+namespace mxnet {
+namespace op {
+namespace topk_enum {
+enum TopKReturnType {kReturnValue, kReturnIndices, kReturnMask};
+}  // namespace topk_enum
+
+struct TopKParam : public dmlc::Parameter<TopKParam> {
+  int axis;
+  int k;
+  int ret_typ;
+  bool is_ascend;
+  DMLC_DECLARE_PARAMETER(TopKParam) {
+    DMLC_DECLARE_FIELD(axis).set_default(-1)
+    .describe("Axis along which to choose the top k elements, negative counts from the end.");
+    DMLC_DECLARE_FIELD(k).set_default(1)
+    .describe("Number of elements to return, k <= 0 returns the whole axis in order.");
+    DMLC_DECLARE_FIELD(ret_typ).set_default(topk_enum::kReturnIndices)
+    .add_enum("value", topk_enum::kReturnValue)
+    .add_enum("indices", topk_enum::kReturnIndices)
+    .add_enum("mask", topk_enum::kReturnMask)
+    .describe("The return type. value: the top k elements in order, indices: their "
+              "positions along the axis, mask: an array of the input shape that is 1 at "
+              "the top k elements and 0 elsewhere.");
+    DMLC_DECLARE_FIELD(is_ascend).set_default(false)
+    .describe("Whether to choose the k smallest elements instead of the k largest.");
+  }
+};
+
+struct SortParam : public dmlc::Parameter<SortParam> {
+  int axis;
+  bool is_ascend;
+  DMLC_DECLARE_PARAMETER(SortParam) {
+    DMLC_DECLARE_FIELD(axis).set_default(-1)
+    .describe("Axis along which to sort, negative counts from the end.");
+    DMLC_DECLARE_FIELD(is_ascend).set_default(true)
+    .describe("Whether to sort in ascending order.");
+  }
+};
+
+namespace topk {
+/*! \brief the (M, L, N) view of a shape along an axis */
+struct Segments {
+  index_t M, L, N;
+};
+
+inline int NormalizeAxis(int axis, const TShape &shape) {
+  const int ndim = static_cast<int>(shape.ndim());
+  CHECK(axis >= -ndim && axis < ndim)
+      << "axis " << axis << " out of range for an input of shape " << shape;
+  return axis < 0 ? axis + ndim : axis;
+}
+
+inline Segments GetSegments(const TShape &shape, int axis) {
+  Segments seg;
+  seg.M = 1;
+  seg.N = 1;
+  seg.L = shape[axis];
+  for (int i = 0; i < axis; ++i) seg.M *= shape[i];
+  for (index_t i = axis + 1; i < shape.ndim(); ++i) seg.N *= shape[i];
+  return seg;
+}
+
+/*! \brief the number of elements returned along the axis */
+inline index_t NumReturned(int k, index_t L) {
+  CHECK_LE(k, static_cast<int>(L)) << "topk: k is larger than the length of the axis";
+  return k <= 0 ? L : static_cast<index_t>(k);
+}
+
+/*!
+ * \brief the order of the positions of one segment, first the k smallest or
+ *  largest, equal values by position
+ */
+template<typename DType>
+inline void OrderSegment(const DType *in, index_t L, index_t N, index_t k, bool ascend,
+                         std::vector<index_t> *pos) {
+  pos->resize(L);
+  for (index_t l = 0; l < L; ++l) (*pos)[l] = l;
+  auto less = [in, N](index_t a, index_t b) {
+    return in[a * N] < in[b * N] || (in[a * N] == in[b * N] && a < b);
+  };
+  auto greater = [in, N](index_t a, index_t b) {
+    return in[a * N] > in[b * N] || (in[a * N] == in[b * N] && a < b);
+  };
+  if (ascend) {
+    std::partial_sort(pos->begin(), pos->begin() + k, pos->end(), less);
+  } else {
+    std::partial_sort(pos->begin(), pos->begin() + k, pos->end(), greater);
+  }
+}
+
+template<typename DType>
+inline void Write(DType *out, DType v, OpReqType req) {
+  *out = req == kAddTo ? *out + v : v;
+}
+
+/*!
+ * \brief the first k of each ordered segment, out is (M, k, N) for values and
+ *  indices, (M, L, N) for the mask
+ */
+template<typename DType>
+inline void TopK(mshadow::Stream<cpu> *s, const Resource &rsc, const DType *in,
+                 const Segments &seg, index_t k, bool ascend, int ret_typ, OpReqType req,
+                 DType *out) {
+  const index_t M = seg.M, L = seg.L, N = seg.N;
+  const int nseg = static_cast<int>(M * N);
+  #pragma omp parallel
+  {
+    std::vector<index_t> pos;
+    #pragma omp for schedule(static)
+    for (int i = 0; i < nseg; ++i) {
+      const index_t m = i / N, n = i % N;
+      const DType *x = in + m * L * N + n;
+      OrderSegment(x, L, N, k, ascend, &pos);
+      if (ret_typ == topk_enum::kReturnMask) {
+        DType *y = out + m * L * N + n;
+        if (req == kWriteTo) {
+          for (index_t l = 0; l < L; ++l) y[l * N] = DType(0);
+        }
+        for (index_t j = 0; j < k; ++j) y[pos[j] * N] += DType(1);
+      } else {
+        DType *y = out + m * k * N + n;
+        for (index_t j = 0; j < k; ++j) {
+          const DType v = ret_typ == topk_enum::kReturnValue ? x[pos[j] * N] : DType(pos[j]);
+          Write(y + j * N, v, req);
+        }
+      }
+    }
+  }
+}
+
+/*! \brief igrad[m, pos[j], n] = ograd[m, j, n], 0 at the other positions */
+template<typename DType>
+inline void TopKGrad(mshadow::Stream<cpu> *s, const Resource &rsc, const DType *in,
+                     const DType *ograd, const Segments &seg, index_t k, bool ascend,
+                     OpReqType req, DType *igrad) {
+  const index_t M = seg.M, L = seg.L, N = seg.N;
+  const int nseg = static_cast<int>(M * N);
+  #pragma omp parallel
+  {
+    std::vector<index_t> pos;
+    #pragma omp for schedule(static)
+    for (int i = 0; i < nseg; ++i) {
+      const index_t m = i / N, n = i % N;
+      OrderSegment(in + m * L * N + n, L, N, k, ascend, &pos);
+      DType *g = igrad + m * L * N + n;
+      if (req == kWriteTo) {
+        for (index_t l = 0; l < L; ++l) g[l * N] = DType(0);
+      }
+      const DType *og = ograd + m * k * N + n;
+      for (index_t j = 0; j < k; ++j) g[pos[j] * N] += og[j * N];
+    }
+  }
+}
+
+#ifdef __CUDACC__
+/*! \brief the type the values are sorted as, half is sorted as float */
+template<typename DType>
+struct SortKey {
+  typedef DType type;
+};
+template<>
+struct SortKey<mshadow::half::half_t> {
+  typedef float type;
+};
+
+/*! \brief the segment major copy of the input, keys[i] is position i % L of segment i / L */
+template<typename DType, typename KType>
+__global__ void GatherKeysKernel(const DType *in, index_t L, index_t N, index_t size,
+                                 KType *keys, int *perm) {
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    const index_t seg = i / L, l = i % L;
+    const index_t m = seg / N, n = seg % N;
+    keys[i] = static_cast<KType>(in[(m * L + l) * N + n]);
+    perm[i] = static_cast<int>(i);
+  }
+}
+
+__global__ void SegmentOfKernel(const int *perm, index_t L, index_t size, int *segs) {
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    segs[i] = static_cast<int>(perm[i] / L);
+  }
+}
+
+/*! \brief one thread per returned element (seg, j) */
+template<typename DType>
+__global__ void TopKKernel(const DType *in, const int *perm, index_t L, index_t N, index_t k,
+                           int ret_typ, bool add, index_t size, DType *out) {
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    const index_t seg = i / k, j = i % k;
+    const index_t m = seg / N, n = seg % N;
+    const index_t l = perm[seg * L + j] % L;
+    if (ret_typ == topk_enum::kReturnMask) {
+      // the positions of a segment are distinct, no two threads write the same element
+      DType *y = out + (m * L + l) * N + n;
+      *y = *y + DType(1);
+    } else {
+      const DType v = ret_typ == topk_enum::kReturnValue ?
+          in[(m * L + l) * N + n] : DType(static_cast<float>(l));
+      DType *y = out + (m * k + j) * N + n;
+      *y = add ? *y + v : v;
+    }
+  }
+}
+
+template<typename DType>
+__global__ void TopKGradKernel(const DType *ograd, const int *perm, index_t L, index_t N,
+                               index_t k, index_t size, DType *igrad) {
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    const index_t seg = i / k, j = i % k;
+    const index_t m = seg / N, n = seg % N;
+    const index_t l = perm[seg * L + j] % L;
+    DType *g = igrad + (m * L + l) * N + n;
+    *g = *g + ograd[(m * k + j) * N + n];
+  }
+}
+
+/*! \brief number of blocks of the grid stride loops over size elements */
+inline int NumBlocks(index_t size) {
+  using namespace mshadow::cuda;
+  return static_cast<int>(std::max<index_t>(1, std::min<index_t>(
+      kMaxGridNum, (size + kBaseThreadNum - 1) / kBaseThreadNum)));
+}
+
+/*!
+ * \brief perm[seg * L + j] % L is the position of the j-th element of segment seg,
+ *  perm is taken from the temp space
+ */
+template<typename DType>
+inline int *OrderSegments(mshadow::Stream<gpu> *s, const Resource &rsc, const DType *in,
+                          const Segments &seg, bool ascend) {
+  typedef typename SortKey<DType>::type KType;
+  const index_t size = seg.M * seg.L * seg.N;
+  CHECK_LT(size, static_cast<index_t>(1) << 31) << "topk: the input is too large for gpu";
+  const index_t nkey = (size * sizeof(KType) + sizeof(int) - 1) / sizeof(int);
+  mshadow::Tensor<gpu, 1, int> space =
+      rsc.get_space_typed<gpu, 1, int>(mshadow::Shape1(nkey + 2 * size), s);
+  KType *keys = reinterpret_cast<KType*>(space.dptr_);
+  int *perm = space.dptr_ + nkey;
+  int *segs = perm + size;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  GatherKeysKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0, stream>>>(
+      in, seg.L, seg.N, size, keys, perm);
+  thrust::device_ptr<KType> kptr(keys);
+  thrust::device_ptr<int> pptr(perm), sptr(segs);
+  if (ascend) {
+    thrust::stable_sort_by_key(thrust::cuda::par.on(stream), kptr, kptr + size, pptr);
+  } else {
+    thrust::stable_sort_by_key(thrust::cuda::par.on(stream), kptr, kptr + size, pptr,
+                               thrust::greater<KType>());
+  }
+  SegmentOfKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0, stream>>>(
+      perm, seg.L, size, segs);
+  // stable, the order by value is kept within each segment
+  thrust::stable_sort_by_key(thrust::cuda::par.on(stream), sptr, sptr + size, pptr);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+  return perm;
+}
+
+template<typename DType>
+inline void TopK(mshadow::Stream<gpu> *s, const Resource &rsc, const DType *in,
+                 const Segments &seg, index_t k, bool ascend, int ret_typ, OpReqType req,
+                 DType *out) {
+  const int *perm = OrderSegments(s, rsc, in, seg, ascend);
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  if (ret_typ == topk_enum::kReturnMask && req == kWriteTo) {
+    cudaMemsetAsync(out, 0, seg.M * seg.L * seg.N * sizeof(DType), stream);
+  }
+  const index_t size = seg.M * seg.N * k;
+  TopKKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0, stream>>>(
+      in, perm, seg.L, seg.N, k, ret_typ, req == kAddTo, size, out);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+template<typename DType>
+inline void TopKGrad(mshadow::Stream<gpu> *s, const Resource &rsc, const DType *in,
+                     const DType *ograd, const Segments &seg, index_t k, bool ascend,
+                     OpReqType req, DType *igrad) {
+  const int *perm = OrderSegments(s, rsc, in, seg, ascend);
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  if (req == kWriteTo) {
+    cudaMemsetAsync(igrad, 0, seg.M * seg.L * seg.N * sizeof(DType), stream);
+  }
+  const index_t size = seg.M * seg.N * k;
+  TopKGradKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0, stream>>>(
+      ograd, perm, seg.L, seg.N, k, size, igrad);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace topk
+
+inline TShape TopKShape(const TShape &ishape, const EnvArguments &env) {
+  TopKParam param;
+  param.Init(env.kwargs);
+  const int axis = topk::NormalizeAxis(param.axis, ishape);
+  TShape ret = ishape;
+  if (param.ret_typ != topk_enum::kReturnMask) {
+    ret[axis] = topk::NumReturned(param.k, ishape[axis]);
+  }
+  return ret;
+}
+
+inline TShape SortShape(const TShape &ishape, const EnvArguments &env) {
+  SortParam param;
+  param.Init(env.kwargs);
+  topk::NormalizeAxis(param.axis, ishape);
+  return ishape;
+}
+
+template<typename xpu>
+void TopKImpl(const TBlob &src, const EnvArguments &env, TBlob *ret, OpReqType req,
+              RunContext ctx, int axis, int k, int ret_typ, bool ascend) {
+  if (req == kNullOp) return;
+  CHECK_NE(req, kWriteInplace) << "topk: the output cannot be the input";
+  CHECK_EQ(ret->type_flag_, src.type_flag_)
+    << "topk only supports input/output with the same type";
+  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+  axis = topk::NormalizeAxis(axis, src.shape_);
+  const topk::Segments seg = topk::GetSegments(src.shape_, axis);
+  if (seg.M * seg.L * seg.N == 0) return;
+  const index_t nret = topk::NumReturned(k, seg.L);
+  MSHADOW_REAL_TYPE_SWITCH(src.type_flag_, DType, {
+    topk::TopK(s, env.resource[0], src.FlatTo1D<xpu, DType>(s).dptr_, seg, nret, ascend,
+               ret_typ, req, ret->FlatTo1D<xpu, DType>(s).dptr_);
+  });
+}
+
+template<typename xpu>
+void TopKGradImpl(const OutputGrad &out_grad, const Input0 &in_data0, const EnvArguments &env,
+                  TBlob *in_grad, OpReqType req, RunContext ctx, int axis, int k,
+                  int ret_typ, bool ascend) {
+  if (req == kNullOp) return;
+  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+  const TBlob &src = in_data0.data;
+  MSHADOW_REAL_TYPE_SWITCH(in_grad->type_flag_, DType, {
+    mshadow::Tensor<xpu, 1, DType> igrad = in_grad->FlatTo1D<xpu, DType>(s);
+    if (ret_typ != topk_enum::kReturnValue) {
+      // the indices and the mask are piecewise constant
+      if (req != kAddTo) igrad = DType(0);
+      return;
+    }
+    axis = topk::NormalizeAxis(axis, src.shape_);
+    const topk::Segments seg = topk::GetSegments(src.shape_, axis);
+    if (seg.M * seg.L * seg.N == 0) return;
+    topk::TopKGrad(s, env.resource[0], src.FlatTo1D<xpu, DType>(s).dptr_,
+                   out_grad.data.FlatTo1D<xpu, DType>(s).dptr_, seg,
+                   topk::NumReturned(k, seg.L), ascend, req, igrad.dptr_);
+  });
+}
+
+template<typename xpu>
+void TopK_(const TBlob &src, const EnvArguments &env, TBlob *ret, OpReqType req,
+           RunContext ctx) {
+  TopKParam param;
+  param.Init(env.kwargs);
+  TopKImpl<xpu>(src, env, ret, req, ctx, param.axis, param.k, param.ret_typ, param.is_ascend);
+}
+
+template<typename xpu>
+void TopKGrad_(const OutputGrad &out_grad, const Input0 &in_data0, const EnvArguments &env,
+               TBlob *in_grad, OpReqType req, RunContext ctx) {
+  TopKParam param;
+  param.Init(env.kwargs);
+  TopKGradImpl<xpu>(out_grad, in_data0, env, in_grad, req, ctx, param.axis, param.k,
+                    param.ret_typ, param.is_ascend);
+}
+
+template<typename xpu>
+void Sort_(const TBlob &src, const EnvArguments &env, TBlob *ret, OpReqType req,
+           RunContext ctx) {
+  SortParam param;
+  param.Init(env.kwargs);
+  TopKImpl<xpu>(src, env, ret, req, ctx, param.axis, 0, topk_enum::kReturnValue,
+                param.is_ascend);
+}
+
+template<typename xpu>
+void SortGrad_(const OutputGrad &out_grad, const Input0 &in_data0, const EnvArguments &env,
+               TBlob *in_grad, OpReqType req, RunContext ctx) {
+  SortParam param;
+  param.Init(env.kwargs);
+  TopKGradImpl<xpu>(out_grad, in_data0, env, in_grad, req, ctx, param.axis, 0,
+                    topk_enum::kReturnValue, param.is_ascend);
+}
+
+template<typename xpu>
+void ArgSort_(const TBlob &src, const EnvArguments &env, TBlob *ret, OpReqType req,
+              RunContext ctx) {
+  SortParam param;
+  param.Init(env.kwargs);
+  TopKImpl<xpu>(src, env, ret, req, ctx, param.axis, 0, topk_enum::kReturnIndices,
+                param.is_ascend);
+}
+
+MXNET_REGISTER_SIMPLE_OP(topk, XPU)
+.set_enable_kwargs(true)
+.set_function(XPU::kDevMask, TopK_<XPU>, kNoInplace, kRegisterSymbolic)
+.set_shape_function(TopKShape)
+.set_gradient(XPU::kDevMask, TopKGrad_<XPU>, kNoInplace)
+.set_resource_request(ResourceRequest::kTempSpace)
+.describe("Return the top k elements of the src along an axis, as values, indices "
+          "or a mask. The elements are computed on the device of the src.")
+.add_arguments(TopKParam::__FIELDS__());
+
+MXNET_REGISTER_SIMPLE_OP(sort, XPU)
+.set_enable_kwargs(true)
+.set_function(XPU::kDevMask, Sort_<XPU>, kNoInplace, kRegisterSymbolic)
+.set_shape_function(SortShape)
+.set_gradient(XPU::kDevMask, SortGrad_<XPU>, kNoInplace)
+.set_resource_request(ResourceRequest::kTempSpace)
+.describe("Sort the src along an axis.")
+.add_arguments(SortParam::__FIELDS__());
+
+MXNET_REGISTER_SIMPLE_OP(argsort, XPU)
+.set_enable_kwargs(true)
+.set_function(XPU::kDevMask, ArgSort_<XPU>, kNoInplace, kRegisterSymbolic)
+.set_shape_function(SortShape)
+.set_resource_request(ResourceRequest::kTempSpace)
+.describe("Return the positions along an axis that sort the src.")
+.add_arguments(SortParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_ORDERING_OP_INL_H_
@@ -0,0 +1,15 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file ordering_op.cc
+ * \brief CPU Implementation of topk, sort and argsort
+ */
+// this will be invoked by gcc and compile CPU version
+#include "./ordering_op-inl.h"
+namespace mxnet {
+namespace op {
+
+DMLC_REGISTER_PARAMETER(TopKParam);
+DMLC_REGISTER_PARAMETER(SortParam);
+
+}  // namespace op
+}  // namespace mxnet
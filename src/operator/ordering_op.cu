@@ -0,0 +1,7 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file ordering_op.cu
+ * \brief GPU Implementation of topk, sort and argsort
+ */
+// this will be invoked by nvcc and compile GPU version
+#include "./ordering_op-inl.h"
@@ -33,6 +33,7 @@ struct PoolingParam : public dmlc::Parameter<PoolingParam> {
   TShape pad;
   int pool_type;
   bool global_pool;
+  int layout;
   DMLC_DECLARE_PARAMETER(PoolingParam) {
     DMLC_DECLARE_FIELD(global_pool).set_default(false)
     .describe("Ignore kernel size, do global pooling based on current input feature map. "
@@ -56,6 +57,13 @@ struct PoolingParam : public dmlc::Parameter<PoolingParam> {
     int pad_shape[] = {0, 0};
     DMLC_DECLARE_FIELD(pad).set_default(TShape(pad_shape, pad_shape + 2))
     .describe("pad for pooling: (y, x) or (d, y, x)");
+
+    DMLC_DECLARE_FIELD(layout)
+    .add_enum("NCHW", kLayoutNCHW)
+    .add_enum("NCHW8c", kLayoutNCHW8c)
+    .set_default(kLayoutNCHW)
+    .describe("Memory layout of data and output, NCHW8c is only supported on cpu "
+              "and set by the executor.");
   }
 };
 
@@ -190,6 +198,8 @@ class PoolingProp : public OperatorProperty {
     if (dshape.ndim() ==  0) return false;
     if (param_.kernel.ndim() == 2) {
       CHECK_EQ(dshape.ndim(), 4) << "Pooling: Input data should be 4D in (batch, channel, y, x)";
+      CHECK(param_.layout == kLayoutNCHW || dshape[1] % 8 == 0)
+          << "Pooling: NCHW8c layout needs a multiple of 8 channels";
       if (param_.global_pool) {
         oshape[2] = 1;
         oshape[3] = 1;
@@ -202,6 +212,7 @@ class PoolingProp : public OperatorProperty {
       out_shape->push_back(oshape);
     } else if (param_.kernel.ndim() == 3) {
       CHECK_EQ(dshape.ndim(), 5) << "Pooling: Input data should be 5D in (batch, channel, d, y, x)";
+      CHECK_EQ(param_.layout, kLayoutNCHW) << "Pooling: 3D pooling only supports the NCHW layout";
       if (param_.global_pool) {
         oshape[2] = 1;
         oshape[3] = 1;
@@ -247,6 +258,11 @@ class PoolingProp : public OperatorProperty {
 #endif
   }
 
+  std::vector<int> ListCPULayouts(const std::vector<TShape> &in_shape) const override {
+    if (param_.kernel.ndim() == 2) return {kLayoutNCHW8c, kLayoutNCHW};
+    return {kLayoutNCHW};
+  }
+
   Operator* CreateOperator(Context ctx) const override;
 
  private:
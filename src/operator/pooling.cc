@@ -5,11 +5,17 @@
  * \author Bing Xu
 */
 #include "./pooling-inl.h"
+#include "./cpu_pooling-inl.h"
 
 namespace mxnet {
 namespace op {
 template<>
 Operator *CreateOp<cpu>(PoolingParam param) {
+  // 3D pooling only runs in CPUPoolingOp
+  if (param.layout != kLayoutNCHW || param.kernel.ndim() == 3 ||
+      dmlc::GetEnv("MXNET_CPU_POOL_OPT", true)) {
+    return new CPUPoolingOp(param);
+  }
   switch (param.pool_type) {
     case pool_enum::kMaxPooling:
       return new PoolingOp<cpu, mshadow::red::maximum>(param);
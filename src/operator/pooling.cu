@@ -14,6 +14,7 @@ namespace mxnet {
 namespace op {
 template<>
 Operator *CreateOp<gpu>(PoolingParam param) {
+  CHECK_EQ(param.layout, kLayoutNCHW) << "Pooling: only the NCHW layout is supported on gpu";
 #if MXNET_USE_CUDNN == 1
   switch (param.pool_type) {
     case pool_enum::kMaxPooling:
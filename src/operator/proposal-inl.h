@@ -0,0 +1,377 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file proposal-inl.h
+ * \brief the region proposals of Faster R-CNN from the outputs of the RPN.
+ *
+ *  For each image, the anchors of every position of the score map are moved by
+ *  the predicted deltas and clipped to the image, the boxes smaller than
+ *  rpn_min_size get the score -1. The rpn_pre_nms_top_n best boxes go through
+ *  non-maximum suppression, the first rpn_post_nms_top_n kept ones are returned,
+ *  repeated in order if fewer are kept. The boxes are ordered by (y, x, anchor)
+ *  as in example/rcnn, and a batch of images is processed image by image, all on
+ *  the device of the inputs.
+ */
+#ifndef MXNET_OPERATOR_PROPOSAL_INL_H_
+#define MXNET_OPERATOR_PROPOSAL_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./operator_common.h"
+#include "./nms-inl.h"
+
+namespace mxnet {
+namespace op {
+
+namespace proposal {
+enum ProposalOpInputs {kClsProb, kBBoxPred, kImInfo};
+enum ProposalOpOutputs {kOut, kScore};
+enum ProposalForwardResource {kTempSpace};
+
+/*! \brief the numbers of a tuple such as "(0.5, 1, 2)" */
+inline std::vector<float> ParseFloats(const std::string &str) {
+  std::string s = str;
+  for (char &c : s) {
+    if (c == '(' || c == ')' || c == '[' || c == ']' || c == ',') c = ' ';
+  }
+  std::istringstream is(s);
+  std::vector<float> ret;
+  float v;
+  while (is >> v) ret.push_back(v);
+  CHECK(!ret.empty() && is.eof()) << "Proposal: cannot parse the tuple " << str;
+  return ret;
+}
+
+/*!
+ * \brief the anchors centered on the first cell, for each ratio the scales,
+ *  as generate_anchors of example/rcnn. Sizes are rounded half to even like numpy.
+ */
+inline std::vector<float> GenerateAnchors(float base_size, const std::vector<float> &ratios,
+                                          const std::vector<float> &scales) {
+  std::vector<float> anchors;
+  const float ctr = 0.5f * (base_size - 1.0f);
+  for (float ratio : ratios) {
+    const float ws = std::nearbyint(std::sqrt(base_size * base_size / ratio));
+    const float hs = std::nearbyint(ws * ratio);
+    for (float scale : scales) {
+      const float w = ws * scale, h = hs * scale;
+      anchors.push_back(ctr - 0.5f * (w - 1.0f));
+      anchors.push_back(ctr - 0.5f * (h - 1.0f));
+      anchors.push_back(ctr + 0.5f * (w - 1.0f));
+      anchors.push_back(ctr + 0.5f * (h - 1.0f));
+    }
+  }
+  return anchors;
+}
+
+/*!
+ * \brief the box i of the positions (h, w, a) of an image, the anchor moved by
+ *  the deltas and clipped, score is the foreground (A, H, W) maps, delta (4A, H, W)
+ */
+MSHADOW_XINLINE void DecodeBox(int i, const float *score, const float *delta,
+                               const float *im_info, const float *anchors, int A, int H, int W,
+                               float stride, float min_size, float *boxes, float *keys,
+                               int *order) {
+  const int a = i % A, w = (i / A) % W, h = i / (A * W);
+  const int plane = H * W, hw = h * W + w;
+  const float *anchor = anchors + a * 4;
+  const float x1 = anchor[0] + w * stride, y1 = anchor[1] + h * stride;
+  const float x2 = anchor[2] + w * stride, y2 = anchor[3] + h * stride;
+  const float width = x2 - x1 + 1.0f, height = y2 - y1 + 1.0f;
+  const float cx = x1 + 0.5f * (width - 1.0f), cy = y1 + 0.5f * (height - 1.0f);
+  const float *d = delta + 4 * a * plane + hw;
+  const float pcx = d[0] * width + cx, pcy = d[plane] * height + cy;
+  const float pw = expf(d[2 * plane]) * width, ph = expf(d[3 * plane]) * height;
+  const float im_h = im_info[0], im_w = im_info[1], min = min_size * im_info[2];
+  float *box = boxes + i * nms::kBoxSize;
+  box[0] = fmaxf(fminf(pcx - 0.5f * (pw - 1.0f), im_w - 1.0f), 0.0f);
+  box[1] = fmaxf(fminf(pcy - 0.5f * (ph - 1.0f), im_h - 1.0f), 0.0f);
+  box[2] = fmaxf(fminf(pcx + 0.5f * (pw - 1.0f), im_w - 1.0f), 0.0f);
+  box[3] = fmaxf(fminf(pcy + 0.5f * (ph - 1.0f), im_h - 1.0f), 0.0f);
+  const bool small = box[2] - box[0] + 1.0f < min || box[3] - box[1] + 1.0f < min;
+  box[4] = small ? -1.0f : score[a * plane + hw];
+  box[5] = 0.0f;
+  keys[i] = box[4];
+  order[i] = i;
+}
+
+/*! \brief the roi j of the output, the kept box j, or j modulo the number kept */
+MSHADOW_XINLINE void OutputBox(int j, const float *sorted, const int *keep, int num_keep,
+                               float batch_index, float *rois, float *scores) {
+  const float *box = sorted + keep[num_keep > 0 ? j % num_keep : 0] * nms::kBoxSize;
+  rois[j * 5] = batch_index;
+  for (int k = 0; k < 4; ++k) rois[j * 5 + 1 + k] = box[k];
+  scores[j] = box[4];
+}
+
+inline void CopyAnchors(mshadow::Stream<cpu> *s, const std::vector<float> &anchors,
+                        float *dst) {
+  std::copy(anchors.begin(), anchors.end(), dst);
+}
+
+inline void Decode(mshadow::Stream<cpu> *s, const float *score, const float *delta,
+                   const float *im_info, const float *anchors, int A, int H, int W,
+                   float stride, float min_size, float *boxes, float *keys, int *order) {
+  const int count = A * H * W;
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < count; ++i) {
+    DecodeBox(i, score, delta, im_info, anchors, A, H, W, stride, min_size, boxes, keys, order);
+  }
+}
+
+inline void Output(mshadow::Stream<cpu> *s, const float *sorted, const int *keep,
+                   const int *num_keep, int post, int batch_index, float *rois,
+                   float *scores) {
+  for (int j = 0; j < post; ++j) {
+    OutputBox(j, sorted, keep, *num_keep, batch_index, rois, scores);
+  }
+}
+
+#ifdef __CUDACC__
+__global__ void DecodeKernel(const float *score, const float *delta, const float *im_info,
+                             const float *anchors, int A, int H, int W, float stride,
+                             float min_size, float *boxes, float *keys, int *order) {
+  const int count = A * H * W;
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < count; i += blockDim.x * gridDim.x) {
+    DecodeBox(i, score, delta, im_info, anchors, A, H, W, stride, min_size, boxes, keys, order);
+  }
+}
+
+__global__ void OutputKernel(const float *sorted, const int *keep, const int *num_keep,
+                             int post, float batch_index, float *rois, float *scores) {
+  for (int j = blockIdx.x * blockDim.x + threadIdx.x; j < post; j += blockDim.x * gridDim.x) {
+    OutputBox(j, sorted, keep, *num_keep, batch_index, rois, scores);
+  }
+}
+
+inline void CopyAnchors(mshadow::Stream<gpu> *s, const std::vector<float> &anchors,
+                        float *dst) {
+  cudaMemcpyAsync(dst, anchors.data(), anchors.size() * sizeof(float), cudaMemcpyHostToDevice,
+                  mshadow::Stream<gpu>::GetStream(s));
+}
+
+inline void Decode(mshadow::Stream<gpu> *s, const float *score, const float *delta,
+                   const float *im_info, const float *anchors, int A, int H, int W,
+                   float stride, float min_size, float *boxes, float *keys, int *order) {
+  DecodeKernel<<<nms::NumBlocks(A * H * W), mshadow::cuda::kBaseThreadNum, 0,
+                 mshadow::Stream<gpu>::GetStream(s)>>>(
+      score, delta, im_info, anchors, A, H, W, stride, min_size, boxes, keys, order);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+inline void Output(mshadow::Stream<gpu> *s, const float *sorted, const int *keep,
+                   const int *num_keep, int post, int batch_index, float *rois,
+                   float *scores) {
+  OutputKernel<<<nms::NumBlocks(post), mshadow::cuda::kBaseThreadNum, 0,
+                 mshadow::Stream<gpu>::GetStream(s)>>>(
+      sorted, keep, num_keep, post, batch_index, rois, scores);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace proposal
+
+struct ProposalParam : public dmlc::Parameter<ProposalParam> {
+  int rpn_pre_nms_top_n;
+  int rpn_post_nms_top_n;
+  float threshold;
+  float rpn_min_size;
+  std::string scales;
+  std::string ratios;
+  float feature_stride;
+  bool output_score;
+  DMLC_DECLARE_PARAMETER(ProposalParam) {
+    DMLC_DECLARE_FIELD(rpn_pre_nms_top_n).set_default(6000)
+    .describe("Number of the best scored boxes that go through NMS, <= 0 for all of them.");
+    DMLC_DECLARE_FIELD(rpn_post_nms_top_n).set_default(300).set_lower_bound(1)
+    .describe("Number of boxes returned for each image after NMS.");
+    DMLC_DECLARE_FIELD(threshold).set_default(0.7f).set_range(0.0f, 1.0f)
+    .describe("Intersection over union above which NMS suppresses a box.");
+    DMLC_DECLARE_FIELD(rpn_min_size).set_default(16.0f)
+    .describe("Minimum height and width of a box, in pixels of the original image.");
+    DMLC_DECLARE_FIELD(scales).set_default("(8, 16, 32)")
+    .describe("Scales of the anchors, relative to feature_stride.");
+    DMLC_DECLARE_FIELD(ratios).set_default("(0.5, 1, 2)")
+    .describe("Aspect ratios, height / width, of the anchors.");
+    DMLC_DECLARE_FIELD(feature_stride).set_default(16.0f)
+    .describe("Stride of the score map in the image, the size of the base anchor.");
+    DMLC_DECLARE_FIELD(output_score).set_default(false)
+    .describe("Whether to also return the score of each box.");
+  }
+};
+
+template<typename xpu>
+class ProposalOp : public Operator {
+ public:
+  explicit ProposalOp(ProposalParam param) : param_(param) {
+    anchors_ = proposal::GenerateAnchors(param_.feature_stride,
+                                         proposal::ParseFloats(param_.ratios),
+                                         proposal::ParseFloats(param_.scales));
+  }
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    CHECK_EQ(in_data.size(), 3);
+    CHECK_EQ(out_data.size(), 2);
+    CHECK_EQ(req[proposal::kOut], kWriteTo);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 4> cls_prob = in_data[proposal::kClsProb].get<xpu, 4, real_t>(s);
+    Tensor<xpu, 4> bbox_pred = in_data[proposal::kBBoxPred].get<xpu, 4, real_t>(s);
+    Tensor<xpu, 2> im_info = in_data[proposal::kImInfo].get<xpu, 2, real_t>(s);
+    Tensor<xpu, 2> rois = out_data[proposal::kOut].get<xpu, 2, real_t>(s);
+    Tensor<xpu, 2> scores = out_data[proposal::kScore].get<xpu, 2, real_t>(s);
+    const int A = static_cast<int>(anchors_.size() / 4);
+    const int H = cls_prob.size(2), W = cls_prob.size(3);
+    const int count = A * H * W;
+    const int pre = param_.rpn_pre_nms_top_n > 0 ?
+        std::min(param_.rpn_pre_nms_top_n, count) : count;
+    const int post = param_.rpn_post_nms_top_n;
+    // the masks of NMS first, they are read as 64 bit words
+    const index_t mask_size = nms::MaskSize<xpu>(pre);
+    const index_t size = mask_size + anchors_.size() + (nms::kBoxSize + 2) * count +
+        nms::kBoxSize * pre + post + 1;
+    Tensor<xpu, 1> workspace = ctx.requested[proposal::kTempSpace].get_space<xpu>(
+        Shape1(size), s);
+    float *mask = workspace.dptr_;
+    float *anchors = mask + mask_size;
+    float *boxes = anchors + anchors_.size();
+    float *keys = boxes + nms::kBoxSize * count;
+    int *order = reinterpret_cast<int*>(keys + count);
+    float *sorted = keys + 2 * count;
+    int *keep = reinterpret_cast<int*>(sorted + nms::kBoxSize * pre);
+    proposal::CopyAnchors(s, anchors_, anchors);
+    for (index_t b = 0; b < cls_prob.size(0); ++b) {
+      // the second A maps are the foreground probabilities
+      proposal::Decode(s, cls_prob[b].dptr_ + count, bbox_pred[b].dptr_, im_info[b].dptr_,
+                       anchors, A, H, W, param_.feature_stride, param_.rpn_min_size,
+                       boxes, keys, order);
+      nms::SortByScore(s, keys, order, count, pre);
+      nms::Gather(s, boxes, order, pre, sorted);
+      nms::Nms(s, sorted, pre, param_.threshold, 1.0f, post, mask, keep, keep + post);
+      proposal::Output(s, sorted, keep, keep + post, post, b, rois.dptr_ + b * post * 5,
+                       scores.dptr_ + b * post);
+    }
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    CHECK_EQ(in_grad.size(), 3);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    // the proposals are not differentiated, as in example/rcnn
+    for (size_t i = 0; i < in_grad.size(); ++i) {
+      if (req[i] == kWriteTo) {
+        Tensor<xpu, 1> g = in_grad[i].FlatTo1D<xpu, real_t>(s);
+        g = 0.0f;
+      }
+    }
+  }
+
+ private:
+  ProposalParam param_;
+  std::vector<float> anchors_;
+};  // class ProposalOp
+
+template<typename xpu>
+Operator *CreateOp(ProposalParam param);
+
+#if DMLC_USE_CXX11
+class ProposalProp : public OperatorProperty {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+    num_anchors_ = proposal::ParseFloats(param_.scales).size() *
+        proposal::ParseFloats(param_.ratios).size();
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    using namespace mshadow;
+    CHECK_EQ(in_shape->size(), 3) << "Input:[cls_prob, bbox_pred, im_info]";
+    const TShape &dshape = in_shape->at(proposal::kClsProb);
+    if (dshape.ndim() == 0) return false;
+    CHECK_EQ(dshape.ndim(), 4) << "Proposal: cls_prob should be (batch, 2 * A, H, W)";
+    CHECK_EQ(dshape[1], 2 * num_anchors_)
+        << "Proposal: cls_prob should have 2 channels for each of the "
+        << num_anchors_ << " anchors";
+    const index_t batch = dshape[0];
+    SHAPE_ASSIGN_CHECK(*in_shape, proposal::kBBoxPred,
+                       Shape4(batch, 4 * num_anchors_, dshape[2], dshape[3]));
+    SHAPE_ASSIGN_CHECK(*in_shape, proposal::kImInfo, Shape2(batch, 3));
+    out_shape->clear();
+    out_shape->push_back(Shape2(batch * param_.rpn_post_nms_top_n, 5));
+    out_shape->push_back(Shape2(batch * param_.rpn_post_nms_top_n, 1));
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new ProposalProp();
+    ptr->param_ = param_;
+    ptr->num_anchors_ = num_anchors_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "Proposal";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    return {};
+  }
+
+  std::vector<ResourceRequest> ForwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace};
+  }
+
+  int NumVisibleOutputs() const override {
+    return param_.output_score ? 2 : 1;
+  }
+
+  int NumOutputs() const override {
+    return 2;
+  }
+
+  std::vector<std::string> ListArguments() const override {
+    return {"cls_prob", "bbox_pred", "im_info"};
+  }
+
+  std::vector<std::string> ListOutputs() const override {
+    return {"output", "score"};
+  }
+
+  Operator* CreateOperator(Context ctx) const override;
+
+ private:
+  ProposalParam param_;
+  index_t num_anchors_;
+};  // class ProposalProp
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_PROPOSAL_INL_H_
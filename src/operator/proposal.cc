@@ -0,0 +1,33 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file proposal.cc
+ * \brief the region proposals of Faster R-CNN
+*/
+#include "./proposal-inl.h"
+
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<cpu>(ProposalParam param) {
+  return new ProposalOp<cpu>(param);
+}
+
+Operator* ProposalProp::CreateOperator(Context ctx) const {
+  DO_BIND_DISPATCH(CreateOp, param_);
+}
+
+DMLC_REGISTER_PARAMETER(ProposalParam);
+
+MXNET_REGISTER_OP_PROPERTY(Proposal, ProposalProp)
+.describe("Generate the region proposals of Faster R-CNN from the outputs of the region "
+"proposal network. The anchors of each position are moved by the predicted deltas and clipped "
+"to the image, the best scored go through non-maximum suppression. The output is "
+"(batch_size * rpn_post_nms_top_n, 5) rois [[batch_index, x1, y1, x2, y2]], the kept boxes "
+"repeated in order when fewer are kept. Boxes smaller than rpn_min_size have the score -1.")
+.add_argument("cls_prob", "Symbol", "Probabilities of the anchors, (batch_size, 2 * A, H, W), "
+"the background of the A anchors then their foreground")
+.add_argument("bbox_pred", "Symbol", "Deltas of the anchors, (batch_size, 4 * A, H, W)")
+.add_argument("im_info", "Symbol", "Height, width and scale of each image, (batch_size, 3)")
+.add_arguments(ProposalParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,15 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file proposal.cu
+ * \brief the region proposals of Faster R-CNN
+*/
+#include "./proposal-inl.h"
+
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<gpu>(ProposalParam param) {
+  return new ProposalOp<gpu>(param);
+}
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,233 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file quantization-inl.h
+ * \brief quantize and dequantize operators of int8 inference.
+ *
+ *  A quantized tensor holds int8 values q of the real values q * range / 127,
+ *  range is the calibrated maximum absolute value of the tensor.
+ *  mshadow has no int8 type flag, the int8 values are stored in uint8 arrays.
+ */
+#ifndef MXNET_OPERATOR_QUANTIZATION_INL_H_
+#define MXNET_OPERATOR_QUANTIZATION_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./operator_common.h"
+
+namespace mxnet {
+namespace op {
+namespace quant {
+enum QuantizeOpInputs {kData};
+enum QuantizeOpOutputs {kOut};
+/*! \brief largest magnitude of a quantized value, the range is symmetric */
+const float kMaxValue = 127.0f;
+
+/*! \brief quantize x with the multiplier 127 / range */
+inline int8_t Quantize(float x, float inv_scale) {
+  float q = std::round(x * inv_scale);
+  return static_cast<int8_t>(std::max(-kMaxValue, std::min(kMaxValue, q)));
+}
+/*! \brief the int8 view of a quantized TBlob */
+inline int8_t *Int8Ptr(const TBlob &blob) {
+  CHECK_EQ(blob.type_flag_, mshadow::kUint8)
+      << "quantized tensors are stored in uint8 arrays";
+  return static_cast<int8_t*>(blob.dptr_);
+}
+}  // namespace quant
+
+struct QuantizeParam : public dmlc::Parameter<QuantizeParam> {
+  float range;
+  DMLC_DECLARE_PARAMETER(QuantizeParam) {
+    DMLC_DECLARE_FIELD(range).set_lower_bound(0.0f)
+    .describe("Maximum absolute value of the real values, it is mapped to 127.");
+  }
+};
+
+/*! \brief ranges of the inputs of quantized Convolution and FullyConnected */
+struct QuantizedRangeParam : public dmlc::Parameter<QuantizedRangeParam> {
+  float data_range;
+  float weight_range;
+  DMLC_DECLARE_PARAMETER(QuantizedRangeParam) {
+    DMLC_DECLARE_FIELD(data_range).set_default(0.0f).set_lower_bound(0.0f)
+    .describe("Range of the quantized data.");
+    DMLC_DECLARE_FIELD(weight_range).set_default(0.0f).set_lower_bound(0.0f)
+    .describe("Range of the quantized weight.");
+  }
+};
+
+/*! \brief float32 to quantized int8 */
+class QuantizeOp : public Operator {
+ public:
+  explicit QuantizeOp(QuantizeParam param) : param_(param) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    CHECK_EQ(in_data.size(), 1);
+    CHECK_EQ(out_data.size(), 1);
+    CHECK_EQ(req[quant::kOut], kWriteTo);
+    const float *src = static_cast<const float*>(in_data[quant::kData].dptr_);
+    int8_t *dst = quant::Int8Ptr(out_data[quant::kOut]);
+    const float inv_scale = param_.range > 0.0f ? quant::kMaxValue / param_.range : 0.0f;
+    const int size = static_cast<int>(in_data[quant::kData].shape_.Size());
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; ++i) {
+      dst[i] = quant::Quantize(src[i], inv_scale);
+    }
+  }
+
+ private:
+  QuantizeParam param_;
+};  // class QuantizeOp
+
+/*! \brief quantized int8 to float32 */
+class DequantizeOp : public Operator {
+ public:
+  explicit DequantizeOp(QuantizeParam param) : param_(param) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    CHECK_EQ(in_data.size(), 1);
+    CHECK_EQ(out_data.size(), 1);
+    CHECK_EQ(req[quant::kOut], kWriteTo);
+    const int8_t *src = quant::Int8Ptr(in_data[quant::kData]);
+    float *dst = static_cast<float*>(out_data[quant::kOut].dptr_);
+    const float scale = param_.range / quant::kMaxValue;
+    const int size = static_cast<int>(in_data[quant::kData].shape_.Size());
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; ++i) {
+      dst[i] = src[i] * scale;
+    }
+  }
+
+ private:
+  QuantizeParam param_;
+};  // class DequantizeOp
+
+#if DMLC_USE_CXX11
+/*!
+ * \brief property of Quantize and Dequantize.
+ * \tparam kQuantize whether it quantizes, otherwise it dequantizes.
+ */
+template<bool kQuantize>
+class QuantizeProp : public OperatorProperty {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    CHECK_EQ(in_shape->size(), 1) << "Input:[data]";
+    const TShape &dshape = in_shape->at(quant::kData);
+    if (dshape.ndim() == 0) return false;
+    out_shape->clear();
+    out_shape->push_back(dshape);
+    return true;
+  }
+
+  bool InferType(std::vector<int> *in_type,
+                 std::vector<int> *out_type,
+                 std::vector<int> *aux_type) const override {
+    CHECK_EQ(in_type->size(), 1);
+    int itype = kQuantize ? mshadow::kFloat32 : mshadow::kUint8;
+    int otype = kQuantize ? mshadow::kUint8 : mshadow::kFloat32;
+    if ((*in_type)[0] == -1) (*in_type)[0] = itype;
+    CHECK_EQ((*in_type)[0], itype) << TypeString() << " input has the wrong type";
+    out_type->clear();
+    out_type->push_back(otype);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new QuantizeProp<kQuantize>();
+    ptr->param_ = param_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return kQuantize ? "Quantize" : "Dequantize";
+  }
+
+  Operator* CreateOperator(Context ctx) const override {
+    CHECK_EQ(ctx.dev_mask(), cpu::kDevMask) << TypeString() << " only runs on cpu";
+    if (kQuantize) return new QuantizeOp(param_);
+    return new DequantizeOp(param_);
+  }
+
+ private:
+  QuantizeParam param_;
+};
+
+/*!
+ * \brief base of the properties of quantized operators, the shapes and parameters
+ *  are the ones of the float operator BaseProp, plus QuantizedRangeParam.
+ */
+template<typename BaseProp>
+class QuantizedPropBase : public OperatorProperty {
+ public:
+  std::vector<std::string> ListArguments() const override {
+    return base_.ListArguments();
+  }
+
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    std::vector<std::pair<std::string, std::string> > base_kwargs, range_kwargs;
+    for (const auto& kv : kwargs) {
+      if (kv.first == "data_range" || kv.first == "weight_range") {
+        range_kwargs.push_back(kv);
+      } else {
+        base_kwargs.push_back(kv);
+      }
+    }
+    base_.Init(base_kwargs);
+    range_.Init(range_kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    std::map<std::string, std::string> params = base_.GetParams();
+    std::map<std::string, std::string> range = range_.__DICT__();
+    params.insert(range.begin(), range.end());
+    return params;
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    return base_.InferShape(in_shape, out_shape, aux_shape);
+  }
+
+ protected:
+  /*! \brief assign the types of the inputs, data and weight are quantized */
+  inline void AssignInputTypes(std::vector<int> *in_type) const {
+    for (size_t i = 0; i < in_type->size(); ++i) {
+      int type = i < 2 ? mshadow::kUint8 : mshadow::kFloat32;
+      if ((*in_type)[i] == -1) (*in_type)[i] = type;
+      CHECK_EQ((*in_type)[i], type)
+          << TypeString() << ": " << ListArguments()[i] << " has the wrong type";
+    }
+  }
+
+  BaseProp base_;
+  QuantizedRangeParam range_;
+};
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_QUANTIZATION_INL_H_
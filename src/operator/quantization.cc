@@ -0,0 +1,47 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file quantization.cc
+ * \brief int8 inference operators
+*/
+#include "./quantization-inl.h"
+#include "./quantized_ops-inl.h"
+
+namespace mxnet {
+namespace op {
+DMLC_REGISTER_PARAMETER(QuantizeParam);
+DMLC_REGISTER_PARAMETER(QuantizedRangeParam);
+
+MXNET_REGISTER_OP_PROPERTY(Quantize, QuantizeProp<true>)
+.describe("Quantize float32 data to int8, stored in uint8, for cpu inference.")
+.add_argument("data", "Symbol", "Input data to quantize.")
+.add_arguments(QuantizeParam::__FIELDS__());
+
+MXNET_REGISTER_OP_PROPERTY(Dequantize, QuantizeProp<false>)
+.describe("Dequantize int8 data, stored in uint8, to float32.")
+.add_argument("data", "Symbol", "Quantized input data.")
+.add_arguments(QuantizeParam::__FIELDS__());
+
+MXNET_REGISTER_OP_PROPERTY(QuantizedConvolution, QuantizedConvolutionProp)
+.describe("Convolution of quantized data and weight, the output is float32.")
+.add_argument("data", "Symbol", "Quantized input data.")
+.add_argument("weight", "Symbol", "Quantized weight.")
+.add_argument("bias", "Symbol", "Float32 bias.")
+.add_arguments(ConvolutionParam::__FIELDS__())
+.add_arguments(QuantizedRangeParam::__FIELDS__());
+
+MXNET_REGISTER_OP_PROPERTY(QuantizedFullyConnected, QuantizedFullyConnectedProp)
+.describe("FullyConnected of quantized data and weight, the output is float32.")
+.add_argument("data", "Symbol", "Quantized input data.")
+.add_argument("weight", "Symbol", "Quantized weight.")
+.add_argument("bias", "Symbol", "Float32 bias.")
+.add_arguments(FullyConnectedParam::__FIELDS__())
+.add_arguments(QuantizedRangeParam::__FIELDS__());
+
+MXNET_REGISTER_OP_PROPERTY(QuantizedPooling, QuantizedPoolingProp)
+.describe("Max or avg pooling of quantized data, the output has the range of the input.")
+.add_argument("data", "Symbol", "Quantized input data.")
+.add_arguments(PoolingParam::__FIELDS__())
+.add_arguments(QuantizedRangeParam::__FIELDS__());
+
+}  // namespace op
+}  // namespace mxnet
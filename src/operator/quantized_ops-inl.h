@@ -0,0 +1,300 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file quantized_ops-inl.h
+ * \brief int8 Convolution, FullyConnected and Pooling for cpu inference.
+ *
+ *  Convolution and FullyConnected take quantized data and weight, they accumulate in int32
+ *  and output float32 with the bias added. Pooling maps quantized data to quantized data
+ *  of the same range. The parameters and shapes are the ones of the float operators.
+ */
+#ifndef MXNET_OPERATOR_QUANTIZED_OPS_INL_H_
+#define MXNET_OPERATOR_QUANTIZED_OPS_INL_H_
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+#include "./quantization-inl.h"
+#include "./convolution-inl.h"
+#include "./cpu_convolution-inl.h"
+#include "./fully_connected-inl.h"
+#include "./pooling-inl.h"
+
+namespace mxnet {
+namespace op {
+namespace quant {
+/*! \brief c = a * b of row major int8 matrices, a is M x K, b is K x N */
+inline void Int8Gemm(const int8_t *a, const int8_t *b, int M, int K, int N, int32_t *c) {
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < M; ++i) {
+    int32_t *ci = c + static_cast<size_t>(i) * N;
+    std::fill(ci, ci + N, 0);
+    const int8_t *ai = a + static_cast<size_t>(i) * K;
+    for (int k = 0; k < K; ++k) {
+      const int32_t aik = ai[k];
+      if (aik == 0) continue;
+      const int8_t *bk = b + static_cast<size_t>(k) * N;
+      for (int j = 0; j < N; ++j) ci[j] += aik * bk[j];
+    }
+  }
+}
+}  // namespace quant
+
+class QuantizedConvolutionOp : public Operator {
+ public:
+  QuantizedConvolutionOp(ConvolutionParam param, QuantizedRangeParam range)
+      : param_(param), range_(range) {
+    CHECK_EQ(param_.act_type, conv::kActNone)
+        << "QuantizedConvolution does not support a fused activation";
+  }
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    CHECK_EQ(req[conv::kOut], kWriteTo);
+    size_t expected = param_.no_bias ? 2 : 3;
+    CHECK_EQ(in_data.size(), expected);
+    CHECK_EQ(param_.kernel.ndim(), 2) << "QuantizedConvolution only supports 2D";
+    const TShape &dshape = in_data[conv::kData].shape_;
+    const TShape &oshape = out_data[conv::kOut].shape_;
+    const int8_t *data = quant::Int8Ptr(in_data[conv::kData]);
+    const int8_t *weight = quant::Int8Ptr(in_data[conv::kWeight]);
+    const float *bias = param_.no_bias ? nullptr :
+        static_cast<const float*>(in_data[conv::kBias].dptr_);
+    float *out = static_cast<float*>(out_data[conv::kOut].dptr_);
+    const int ngroup = param_.num_group;
+    const int C = dshape[1], K = param_.num_filter;
+    const int ckk = C / ngroup * param_.kernel[0] * param_.kernel[1];
+    const int osize = oshape[2] * oshape[3];
+    // int32 accumulators of one image, followed by its int8 patches
+    const size_t col_words = (static_cast<size_t>(ngroup) * ckk * osize + 3) / 4;
+    Tensor<cpu, 1, int32_t> workspace =
+        ctx.requested[conv::kTempSpace].get_space_typed<cpu, 1, int32_t>(
+            Shape1(static_cast<index_t>(K * osize + col_words)), ctx.get_stream<cpu>());
+    int32_t *acc = workspace.dptr_;
+    int8_t *col = reinterpret_cast<int8_t*>(workspace.dptr_ + K * osize);
+    const float scale = range_.data_range * range_.weight_range /
+        (quant::kMaxValue * quant::kMaxValue);
+    for (index_t n = 0; n < dshape[0]; ++n) {
+      cpuconv::Im2col(data + static_cast<size_t>(n) * C * dshape[2] * dshape[3],
+                      C, dshape[2], dshape[3], oshape[2], oshape[3],
+                      param_.kernel[0], param_.kernel[1], param_.stride[0], param_.stride[1],
+                      param_.pad[0], param_.pad[1], param_.dilate[0], param_.dilate[1], col);
+      const int kg = K / ngroup;
+      for (int g = 0; g < ngroup; ++g) {
+        quant::Int8Gemm(weight + static_cast<size_t>(g) * kg * ckk,
+                        col + static_cast<size_t>(g) * ckk * osize,
+                        kg, ckk, osize, acc + static_cast<size_t>(g) * kg * osize);
+      }
+      float *dst = out + static_cast<size_t>(n) * K * osize;
+      #pragma omp parallel for schedule(static)
+      for (int k = 0; k < K; ++k) {
+        const float b = bias == nullptr ? 0.0f : bias[k];
+        for (int i = 0; i < osize; ++i) {
+          dst[k * osize + i] = acc[k * osize + i] * scale + b;
+        }
+      }
+    }
+  }
+
+ private:
+  ConvolutionParam param_;
+  QuantizedRangeParam range_;
+};  // class QuantizedConvolutionOp
+
+class QuantizedFullyConnectedOp : public Operator {
+ public:
+  QuantizedFullyConnectedOp(FullyConnectedParam param, QuantizedRangeParam range)
+      : param_(param), range_(range) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    CHECK_EQ(req[fullc::kOut], kWriteTo);
+    size_t expected = param_.no_bias ? 2 : 3;
+    CHECK_EQ(in_data.size(), expected);
+    const TShape &dshape = in_data[fullc::kData].shape_;
+    const int8_t *data = quant::Int8Ptr(in_data[fullc::kData]);
+    const int8_t *weight = quant::Int8Ptr(in_data[fullc::kWeight]);
+    const float *bias = param_.no_bias ? nullptr :
+        static_cast<const float*>(in_data[fullc::kBias].dptr_);
+    float *out = static_cast<float*>(out_data[fullc::kOut].dptr_);
+    const int batch = dshape[0];
+    const int dim = static_cast<int>(dshape.Size() / dshape[0]);
+    const int nhidden = param_.num_hidden;
+    const float scale = range_.data_range * range_.weight_range /
+        (quant::kMaxValue * quant::kMaxValue);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < batch * nhidden; ++i) {
+      const int8_t *x = data + static_cast<size_t>(i / nhidden) * dim;
+      const int8_t *w = weight + static_cast<size_t>(i % nhidden) * dim;
+      int32_t sum = 0;
+      for (int j = 0; j < dim; ++j) sum += static_cast<int32_t>(x[j]) * w[j];
+      out[i] = sum * scale + (bias == nullptr ? 0.0f : bias[i % nhidden]);
+    }
+  }
+
+ private:
+  FullyConnectedParam param_;
+  QuantizedRangeParam range_;
+};  // class QuantizedFullyConnectedOp
+
+class QuantizedPoolingOp : public Operator {
+ public:
+  explicit QuantizedPoolingOp(PoolingParam param) : param_(param) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    CHECK_EQ(req[pool_enum::kOut], kWriteTo);
+    CHECK_EQ(param_.kernel.ndim(), 2) << "QuantizedPooling only supports 2D";
+    const TShape &dshape = in_data[pool_enum::kData].shape_;
+    const TShape &oshape = out_data[pool_enum::kOut].shape_;
+    const int8_t *data = quant::Int8Ptr(in_data[pool_enum::kData]);
+    int8_t *out = quant::Int8Ptr(out_data[pool_enum::kOut]);
+    const int H = dshape[2], W = dshape[3], Ho = oshape[2], Wo = oshape[3];
+    const int kh = param_.global_pool ? H : param_.kernel[0];
+    const int kw = param_.global_pool ? W : param_.kernel[1];
+    const int sy = param_.global_pool ? 1 : param_.stride[0];
+    const int sx = param_.global_pool ? 1 : param_.stride[1];
+    const int py = param_.global_pool ? 0 : param_.pad[0];
+    const int px = param_.global_pool ? 0 : param_.pad[1];
+    const bool is_max = param_.pool_type == pool_enum::kMaxPooling;
+    const int nplane = dshape[0] * dshape[1];
+    // same as the float operator, the padding is zero and avg divides by the kernel size
+    #pragma omp parallel for schedule(static)
+    for (int c = 0; c < nplane; ++c) {
+      const int8_t *src = data + static_cast<size_t>(c) * H * W;
+      int8_t *dst = out + static_cast<size_t>(c) * Ho * Wo;
+      for (int oy = 0; oy < Ho; ++oy) {
+        for (int ox = 0; ox < Wo; ++ox) {
+          int32_t res = is_max ? std::numeric_limits<int32_t>::min() : 0;
+          for (int i = 0; i < kh; ++i) {
+            const int iy = oy * sy - py + i;
+            for (int j = 0; j < kw; ++j) {
+              const int ix = ox * sx - px + j;
+              const int32_t v = (iy >= 0 && iy < H && ix >= 0 && ix < W) ? src[iy * W + ix] : 0;
+              res = is_max ? std::max(res, v) : res + v;
+            }
+          }
+          if (!is_max) {
+            res = static_cast<int32_t>(std::round(static_cast<float>(res) / (kh * kw)));
+          }
+          dst[oy * Wo + ox] = static_cast<int8_t>(res);
+        }
+      }
+    }
+  }
+
+ private:
+  PoolingParam param_;
+};  // class QuantizedPoolingOp
+
+#if DMLC_USE_CXX11
+class QuantizedConvolutionProp : public QuantizedPropBase<ConvolutionProp> {
+ public:
+  bool InferType(std::vector<int> *in_type,
+                 std::vector<int> *out_type,
+                 std::vector<int> *aux_type) const override {
+    AssignInputTypes(in_type);
+    out_type->clear();
+    out_type->push_back(mshadow::kFloat32);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new QuantizedConvolutionProp();
+    ptr->base_ = base_;
+    ptr->range_ = range_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "QuantizedConvolution";
+  }
+
+  std::vector<ResourceRequest> ForwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace};
+  }
+
+  Operator* CreateOperator(Context ctx) const override {
+    CHECK_EQ(ctx.dev_mask(), cpu::kDevMask) << TypeString() << " only runs on cpu";
+    ConvolutionParam param;
+    param.Init(base_.GetParams());
+    return new QuantizedConvolutionOp(param, range_);
+  }
+};
+
+class QuantizedFullyConnectedProp : public QuantizedPropBase<FullyConnectedProp> {
+ public:
+  bool InferType(std::vector<int> *in_type,
+                 std::vector<int> *out_type,
+                 std::vector<int> *aux_type) const override {
+    AssignInputTypes(in_type);
+    out_type->clear();
+    out_type->push_back(mshadow::kFloat32);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new QuantizedFullyConnectedProp();
+    ptr->base_ = base_;
+    ptr->range_ = range_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "QuantizedFullyConnected";
+  }
+
+  Operator* CreateOperator(Context ctx) const override {
+    CHECK_EQ(ctx.dev_mask(), cpu::kDevMask) << TypeString() << " only runs on cpu";
+    FullyConnectedParam param;
+    param.Init(base_.GetParams());
+    return new QuantizedFullyConnectedOp(param, range_);
+  }
+};
+
+class QuantizedPoolingProp : public QuantizedPropBase<PoolingProp> {
+ public:
+  bool InferType(std::vector<int> *in_type,
+                 std::vector<int> *out_type,
+                 std::vector<int> *aux_type) const override {
+    AssignInputTypes(in_type);
+    out_type->clear();
+    out_type->push_back(mshadow::kUint8);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new QuantizedPoolingProp();
+    ptr->base_ = base_;
+    ptr->range_ = range_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "QuantizedPooling";
+  }
+
+  Operator* CreateOperator(Context ctx) const override {
+    CHECK_EQ(ctx.dev_mask(), cpu::kDevMask) << TypeString() << " only runs on cpu";
+    PoolingParam param;
+    param.Init(base_.GetParams());
+    CHECK(param.pool_type == pool_enum::kMaxPooling || param.pool_type == pool_enum::kAvgPooling)
+        << "QuantizedPooling supports max and avg pooling";
+    return new QuantizedPoolingOp(param);
+  }
+};
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_QUANTIZED_OPS_INL_H_
@@ -0,0 +1,729 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file rnn-inl.h
+ * \brief fused recurrent layers, vanilla RNN, LSTM and GRU over a whole sequence
+ *
+ *  The parameters are a single vector, the weights of all layers followed by
+ *  their biases. For each layer and direction, the input weight of shape
+ *  (ngates * state_size, input_size) and the recurrent weight of shape
+ *  (ngates * state_size, state_size), then the input and recurrent biases.
+ *  The gates are ordered as [i, f, g, o] for LSTM and [r, z, n] for GRU.
+ *
+ *  With use_sequence_length, the steps after the end of a sequence are not
+ *  computed: its state is carried over them, so that the final states are the
+ *  ones of its last step and the reverse direction starts from it, and its
+ *  outputs there are 0.
+ */
+#ifndef MXNET_OPERATOR_RNN_INL_H_
+#define MXNET_OPERATOR_RNN_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./operator_common.h"
+#include "./mshadow_op_simd.h"
+
+namespace mxnet {
+namespace op {
+
+namespace rnn_enum {
+enum RNNOpInputs {kData, kParams, kState, kStateCell};
+enum RNNOpOutputs {kOut, kStateOut, kStateCellOut};
+enum RNNModeType {kRnnRelu, kRnnTanh, kLstm, kGru};
+enum RNNOpResource {kTempSpace};
+}  // namespace rnn_enum
+
+struct RNNParam : public dmlc::Parameter<RNNParam> {
+  uint32_t state_size;
+  uint32_t num_layers;
+  bool bidirectional;
+  int mode;
+  bool state_outputs;
+  bool use_sequence_length;
+  DMLC_DECLARE_PARAMETER(RNNParam) {
+    DMLC_DECLARE_FIELD(state_size).set_lower_bound(1)
+    .describe("Size of the hidden state of each layer.");
+    DMLC_DECLARE_FIELD(num_layers).set_lower_bound(1)
+    .describe("Number of stacked layers.");
+    DMLC_DECLARE_FIELD(bidirectional).set_default(false)
+    .describe("Whether each layer also runs from the end of the sequence, "
+              "the outputs of the two directions are concatenated.");
+    DMLC_DECLARE_FIELD(mode)
+    .add_enum("rnn_relu", rnn_enum::kRnnRelu)
+    .add_enum("rnn_tanh", rnn_enum::kRnnTanh)
+    .add_enum("lstm", rnn_enum::kLstm)
+    .add_enum("gru", rnn_enum::kGru)
+    .describe("The type of the recurrent cell.");
+    DMLC_DECLARE_FIELD(state_outputs).set_default(false)
+    .describe("Whether to also output the final hidden states, and cells for LSTM.");
+    DMLC_DECLARE_FIELD(use_sequence_length).set_default(false)
+    .describe("Whether the lengths of the sequences of the batch are given by the input "
+              "sequence_length, for a batch padded to seq_length.");
+  }
+};
+
+/*! \brief index of the input sequence_length */
+inline int RNNSequenceLengthInput(const RNNParam &param) {
+  return param.mode == rnn_enum::kLstm ? rnn_enum::kStateCell + 1 : rnn_enum::kStateCell;
+}
+
+/*! \brief number of gates of a cell */
+inline int NumGates(int mode) {
+  switch (mode) {
+    case rnn_enum::kLstm: return 4;
+    case rnn_enum::kGru: return 3;
+    default: return 1;
+  }
+}
+
+/*! \brief number of elements of the parameter vector */
+inline index_t GetRNNParamSize(const RNNParam &param, index_t input_size) {
+  const index_t H = param.state_size, D = param.bidirectional ? 2 : 1;
+  const index_t G = NumGates(param.mode);
+  index_t size = 0;
+  for (index_t l = 0; l < param.num_layers; ++l) {
+    const index_t in = l == 0 ? input_size : D * H;
+    size += D * (G * H * in + G * H * H + 2 * G * H);
+  }
+  return size;
+}
+
+/*! \brief offsets of the weights and biases of a layer and direction in the parameters */
+struct RNNParamOffset {
+  index_t wx, wh, bx, bh;
+};
+
+inline std::vector<RNNParamOffset> GetRNNParamOffsets(const RNNParam &param,
+                                                      index_t input_size) {
+  const index_t H = param.state_size, D = param.bidirectional ? 2 : 1;
+  const index_t G = NumGates(param.mode);
+  std::vector<RNNParamOffset> ret(param.num_layers * D);
+  index_t pos = 0;
+  for (index_t l = 0; l < param.num_layers; ++l) {
+    const index_t in = l == 0 ? input_size : D * H;
+    for (index_t d = 0; d < D; ++d) {
+      ret[l * D + d].wx = pos;
+      pos += G * H * in;
+      ret[l * D + d].wh = pos;
+      pos += G * H * H;
+    }
+  }
+  for (RNNParamOffset &off : ret) {
+    off.bx = pos;
+    off.bh = pos + G * H;
+    pos += 2 * G * H;
+  }
+  return ret;
+}
+
+template<typename DType>
+inline DType RNNSigmoid(DType x) {
+  return DType(1) / (DType(1) + std::exp(-x));
+}
+
+/*! \brief y = sigmoid(x) over n elements, vectorized for float, x may be y */
+template<typename DType>
+inline void RNNSigmoidMap(const DType *x, DType *y, index_t n) {
+  for (index_t j = 0; j < n; ++j) y[j] = RNNSigmoid(x[j]);
+}
+
+inline void RNNSigmoidMap(const float *x, float *y, index_t n) {
+  if (mshadow_op::simd::Map<mshadow_op::sigmoid>(x, y, n)) return;
+  for (index_t j = 0; j < n; ++j) y[j] = RNNSigmoid(x[j]);
+}
+
+/*! \brief y = tanh(x) over n elements, vectorized for float, x may be y */
+template<typename DType>
+inline void RNNTanhMap(const DType *x, DType *y, index_t n) {
+  for (index_t j = 0; j < n; ++j) y[j] = std::tanh(x[j]);
+}
+
+inline void RNNTanhMap(const float *x, float *y, index_t n) {
+  if (mshadow_op::simd::Map<mshadow_op::tanh>(x, y, n)) return;
+  for (index_t j = 0; j < n; ++j) y[j] = std::tanh(x[j]);
+}
+
+/*!
+ * \brief the cpu implementation. The input projection of a layer is a single
+ *  gemm over the whole sequence, then each step only multiplies the state.
+ *  The activations of the steps are kept for the backward. With the lengths of
+ *  the sequences, the steps after the longest one are skipped, and the state gemm
+ *  of a step only covers the sequences still running when the batch is sorted by
+ *  decreasing length.
+ */
+template<typename DType>
+class RNNOp : public Operator {
+ public:
+  explicit RNNOp(RNNParam param) : param_(param) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    Stream<cpu> *s = ctx.get_stream<cpu>();
+    if (req[rnn_enum::kOut] == kNullOp) return;
+    CHECK_EQ(req[rnn_enum::kOut], kWriteTo);
+    Tensor<cpu, 3, DType> x = in_data[rnn_enum::kData].get<cpu, 3, DType>(s);
+    Tensor<cpu, 3, DType> y = out_data[rnn_enum::kOut].get<cpu, 3, DType>(s);
+    this->InitShape(x.shape_);
+    this->InitLengths(in_data);
+    const DType *w = in_data[rnn_enum::kParams].dptr<DType>();
+    const DType *hx = in_data[rnn_enum::kState].dptr<DType>();
+    const DType *cx = param_.mode == rnn_enum::kLstm ?
+        in_data[rnn_enum::kStateCell].dptr<DType>() : nullptr;
+    DType *hy = param_.state_outputs ? out_data[rnn_enum::kStateOut].dptr<DType>() : nullptr;
+    DType *cy = param_.state_outputs && param_.mode == rnn_enum::kLstm ?
+        out_data[rnn_enum::kStateCellOut].dptr<DType>() : nullptr;
+    Tensor<cpu, 1, DType> workspace = ctx.requested[rnn_enum::kTempSpace]
+        .get_space_typed<cpu, 1, DType>(Shape1(T_ * N_ * GH_ + N_ * GH_), s);
+    Tensor<cpu, 2, DType> xproj(workspace.dptr_, Shape2(T_ * N_, GH_), s);
+    Tensor<cpu, 2, DType> hproj(workspace.dptr_ + T_ * N_ * GH_, Shape2(N_, GH_), s);
+
+    // the rows of the steps up to the longest sequence
+    const index_t R = max_len_ * N_;
+    for (index_t l = 0; l < L_; ++l) {
+      const index_t in = l == 0 ? I_ : D_ * H_;
+      Tensor<cpu, 2, DType> layer_in(l == 0 ? x.dptr_ : this->LayerOut(l - 1),
+                                     Shape2(R, in), s);
+      Tensor<cpu, 2, DType> xp(xproj.dptr_, Shape2(R, GH_), s);
+      DType *layer_out = l + 1 == L_ ? y.dptr_ : this->LayerOut(l);
+      for (index_t d = 0; d < D_; ++d) {
+        const RNNParamOffset &off = offsets_[l * D_ + d];
+        Tensor<cpu, 2, DType> wx(const_cast<DType*>(w + off.wx), Shape2(GH_, in), s);
+        Tensor<cpu, 2, DType> wh(const_cast<DType*>(w + off.wh), Shape2(GH_, H_), s);
+        // the biases of the gates other than the new gate of GRU are summed once
+        if (R != 0) xp = dot(layer_in, wx.T());
+        const DType *bx = w + off.bx, *bh = w + off.bh;
+        const bool gru = param_.mode == rnn_enum::kGru;
+        #pragma omp parallel for
+        for (int r = 0; r < static_cast<int>(R); ++r) {
+          DType *row = xproj.dptr_ + r * GH_;
+          for (index_t k = 0; k < GH_; ++k) row[k] += bx[k] + (gru ? DType(0) : bh[k]);
+        }
+        const DType *h_prev = hx + (l * D_ + d) * N_ * H_;
+        index_t h_stride = H_;
+        const DType *c_prev = cx != nullptr ? cx + (l * D_ + d) * N_ * H_ : nullptr;
+        DType *gates = this->Gates(l, d), *extra = this->Extra(l, d);
+        for (index_t step = 0; step < T_; ++step) {
+          const index_t t = d == 0 ? step : T_ - 1 - step;
+          const index_t rows = active_[t];
+          Tensor<cpu, 2, DType> hp(const_cast<DType*>(h_prev), Shape2(rows, H_), h_stride, s);
+          Tensor<cpu, 2, DType> g(gates + t * N_ * GH_, Shape2(rows, GH_), s);
+          Tensor<cpu, 2, DType> hpj(hproj.dptr_, Shape2(rows, GH_), s);
+          if (rows == 0) {
+            // no sequence runs, the state is carried
+          } else if (gru) {
+            hpj = dot(hp, wh.T());
+          } else {
+            g = dot(hp, wh.T());
+          }
+          DType *h_out = layer_out + t * N_ * D_ * H_ + d * H_;
+          DType *c_out = extra != nullptr ? extra + t * N_ * H_ : nullptr;
+          this->ForwardStep(t, xproj.dptr_ + t * N_ * GH_, hproj.dptr_, bh, g.dptr_,
+                            h_prev, h_stride, c_prev, h_out, c_out);
+          h_prev = h_out;
+          h_stride = D_ * H_;
+          if (param_.mode == rnn_enum::kLstm) c_prev = c_out;
+        }
+        if (hy != nullptr) {
+          for (index_t n = 0; n < N_; ++n) {
+            std::copy(h_prev + n * h_stride, h_prev + n * h_stride + H_,
+                      hy + ((l * D_ + d) * N_ + n) * H_);
+          }
+        }
+        if (cy != nullptr) {
+          std::copy(c_prev, c_prev + N_ * H_, cy + (l * D_ + d) * N_ * H_);
+        }
+      }
+    }
+    // the carried states of the last layer are not outputs
+    if (param_.use_sequence_length) {
+      for (index_t t = 0; t < T_; ++t) {
+        for (index_t n = 0; n < N_; ++n) {
+          if (t >= lens_[n]) {
+            std::fill(y.dptr_ + (t * N_ + n) * D_ * H_, y.dptr_ + (t * N_ + n + 1) * D_ * H_,
+                      DType(0));
+          }
+        }
+      }
+    }
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    Stream<cpu> *s = ctx.get_stream<cpu>();
+    for (size_t i = 0; i < req.size(); ++i) {
+      CHECK(req[i] == kWriteTo || req[i] == kNullOp)
+          << "RNN only supports write to the gradients";
+    }
+    const DType *x = in_data[rnn_enum::kData].dptr<DType>();
+    const DType *w = in_data[rnn_enum::kParams].dptr<DType>();
+    const DType *hx = in_data[rnn_enum::kState].dptr<DType>();
+    const DType *cx = param_.mode == rnn_enum::kLstm ?
+        in_data[rnn_enum::kStateCell].dptr<DType>() : nullptr;
+    const DType *y = out_data[rnn_enum::kOut].dptr<DType>();
+    const DType *dy = out_grad[rnn_enum::kOut].dptr<DType>();
+    const DType *dhy = param_.state_outputs ? out_grad[rnn_enum::kStateOut].dptr<DType>() : nullptr;
+    const DType *dcy = param_.state_outputs && param_.mode == rnn_enum::kLstm ?
+        out_grad[rnn_enum::kStateCellOut].dptr<DType>() : nullptr;
+    DType *dx = in_grad[rnn_enum::kData].dptr<DType>();
+    DType *dw = in_grad[rnn_enum::kParams].dptr<DType>();
+    DType *dhx = in_grad[rnn_enum::kState].dptr<DType>();
+    DType *dcx = param_.mode == rnn_enum::kLstm ?
+        in_grad[rnn_enum::kStateCell].dptr<DType>() : nullptr;
+    std::fill(dw, dw + in_grad[rnn_enum::kParams].Size(), DType(0));
+
+    const index_t width = std::max(I_, D_ * H_);
+    Tensor<cpu, 1, DType> workspace = ctx.requested[rnn_enum::kTempSpace]
+        .get_space_typed<cpu, 1, DType>(Shape1(T_ * N_ * GH_ + N_ * GH_ + 4 * N_ * H_ +
+                                               2 * T_ * N_ * width), s);
+    DType *dgates = workspace.dptr_;
+    DType *dgh = dgates + T_ * N_ * GH_;
+    DType *dh = dgh + N_ * GH_;
+    DType *dh_next = dh + N_ * H_;
+    DType *dc_next = dh_next + N_ * H_;
+    DType *h_buf = dc_next + N_ * H_;
+    DType *dlayer[2] = {h_buf + N_ * H_, h_buf + N_ * H_ + T_ * N_ * width};
+    const index_t R = max_len_ * N_;
+
+    const DType *dlayer_out = dy;
+    for (index_t l = L_; l-- > 0;) {
+      const index_t in = l == 0 ? I_ : D_ * H_;
+      const DType *layer_in = l == 0 ? x : this->LayerOut(l - 1);
+      const DType *layer_out = l + 1 == L_ ? y : this->LayerOut(l);
+      DType *dlayer_in = l == 0 ? dx : dlayer[l % 2];
+      std::fill(dlayer_in, dlayer_in + T_ * N_ * in, DType(0));
+      Tensor<cpu, 2, DType> tin(const_cast<DType*>(layer_in), Shape2(R, in), s);
+      Tensor<cpu, 2, DType> tdin(dlayer_in, Shape2(R, in), s);
+      for (index_t d = 0; d < D_; ++d) {
+        const index_t ld = l * D_ + d;
+        const RNNParamOffset &off = offsets_[ld];
+        Tensor<cpu, 2, DType> wx(const_cast<DType*>(w + off.wx), Shape2(GH_, in), s);
+        Tensor<cpu, 2, DType> wh(const_cast<DType*>(w + off.wh), Shape2(GH_, H_), s);
+        Tensor<cpu, 2, DType> dwx(dw + off.wx, Shape2(GH_, in), s);
+        Tensor<cpu, 2, DType> dwh(dw + off.wh, Shape2(GH_, H_), s);
+        DType *dbx = dw + off.bx, *dbh = dw + off.bh;
+        const DType *gates = this->Gates(l, d), *extra = this->Extra(l, d);
+        if (dhy != nullptr) {
+          std::copy(dhy + ld * N_ * H_, dhy + (ld + 1) * N_ * H_, dh_next);
+        } else {
+          std::fill(dh_next, dh_next + N_ * H_, DType(0));
+        }
+        if (dcy != nullptr) {
+          std::copy(dcy + ld * N_ * H_, dcy + (ld + 1) * N_ * H_, dc_next);
+        } else {
+          std::fill(dc_next, dc_next + N_ * H_, DType(0));
+        }
+        for (index_t step = T_; step-- > 0;) {
+          const index_t t = d == 0 ? step : T_ - 1 - step;
+          const index_t rows = active_[t];
+          // the gradients of the carried states pass through
+          if (rows == 0) continue;
+          const bool first = step == 0;
+          const index_t tp = d == 0 ? t - 1 : t + 1;
+          const DType *h_prev = first ? hx + ld * N_ * H_ : layer_out + tp * N_ * D_ * H_ + d * H_;
+          index_t h_stride = first ? H_ : D_ * H_;
+          if (!first && d == 1 && param_.use_sequence_length) {
+            // a sequence ending at t starts from the initial state, not the 0 output at tp
+            for (index_t n = 0; n < N_; ++n) {
+              const DType *src = tp < lens_[n] ? h_prev + n * h_stride : hx + (ld * N_ + n) * H_;
+              std::copy(src, src + H_, h_buf + n * H_);
+            }
+            h_prev = h_buf;
+            h_stride = H_;
+          }
+          const DType *c_prev = param_.mode != rnn_enum::kLstm ? nullptr :
+              (first ? cx + ld * N_ * H_ : extra + tp * N_ * H_);
+          for (index_t n = 0; n < N_; ++n) {
+            const bool active = t < lens_[n];
+            for (index_t j = 0; j < H_; ++j) {
+              dh[n * H_ + j] = dh_next[n * H_ + j] + (active ?
+                  dlayer_out[(t * N_ + n) * D_ * H_ + d * H_ + j] : DType(0));
+            }
+          }
+          DType *dg = dgates + t * N_ * GH_;
+          DType *dgh_t = param_.mode == rnn_enum::kGru ? dgh : dg;
+          this->BackwardStep(t, gates + t * N_ * GH_,
+                             extra != nullptr ? extra + t * N_ * H_ : nullptr,
+                             layer_out + t * N_ * D_ * H_ + d * H_,
+                             h_prev, h_stride, c_prev, dh, dc_next, dg, dgh_t);
+          Tensor<cpu, 2, DType> tdgh(dgh_t, Shape2(rows, GH_), s);
+          Tensor<cpu, 2, DType> hp(const_cast<DType*>(h_prev), Shape2(rows, H_), h_stride, s);
+          Tensor<cpu, 2, DType> tdh_next(dh_next, Shape2(rows, H_), s);
+          tdh_next = dot(tdgh, wh);
+          for (index_t n = 0; n < N_; ++n) {
+            if (t < lens_[n]) {
+              if (param_.mode == rnn_enum::kGru) {
+                // h = (1 - z) * n + z * h_prev
+                const DType *z = gates + t * N_ * GH_ + n * GH_ + H_;
+                for (index_t j = 0; j < H_; ++j) dh_next[n * H_ + j] += dh[n * H_ + j] * z[j];
+              }
+            } else {
+              std::copy(dh + n * H_, dh + (n + 1) * H_, dh_next + n * H_);
+            }
+          }
+          dwh += dot(tdgh.T(), hp);
+          for (index_t n = 0; n < rows; ++n) {
+            for (index_t k = 0; k < GH_; ++k) dbh[k] += dgh_t[n * GH_ + k];
+          }
+        }
+        Tensor<cpu, 2, DType> tdg(dgates, Shape2(R, GH_), s);
+        if (R != 0) {
+          dwx += dot(tdg.T(), tin);
+          tdin += dot(tdg, wx);
+        }
+        for (index_t r = 0; r < R; ++r) {
+          for (index_t k = 0; k < GH_; ++k) dbx[k] += dgates[r * GH_ + k];
+        }
+        std::copy(dh_next, dh_next + N_ * H_, dhx + ld * N_ * H_);
+        if (dcx != nullptr) std::copy(dc_next, dc_next + N_ * H_, dcx + ld * N_ * H_);
+      }
+      dlayer_out = dlayer_in;
+    }
+  }
+
+ private:
+  // compute the sizes and the reserved activations for an input shape
+  inline void InitShape(const TShape &shape) {
+    T_ = shape[0];
+    N_ = shape[1];
+    I_ = shape[2];
+    H_ = param_.state_size;
+    L_ = param_.num_layers;
+    D_ = param_.bidirectional ? 2 : 1;
+    GH_ = NumGates(param_.mode) * H_;
+    offsets_ = GetRNNParamOffsets(param_, I_);
+    extra_size_ = param_.mode == rnn_enum::kLstm || param_.mode == rnn_enum::kGru ?
+        T_ * N_ * H_ : 0;
+    const size_t size = (L_ - 1) * T_ * N_ * D_ * H_ +
+        L_ * D_ * (T_ * N_ * GH_ + extra_size_);
+    reserve_.resize(size);
+  }
+  // the lengths of the sequences, and the sequences running at each step
+  inline void InitLengths(const std::vector<TBlob> &in_data) {
+    lens_.assign(N_, T_);
+    if (param_.use_sequence_length) {
+      const DType *len = in_data[RNNSequenceLengthInput(param_)].dptr<DType>();
+      for (index_t n = 0; n < N_; ++n) {
+        const float v = static_cast<float>(len[n]);
+        lens_[n] = v <= 0.0f ? 0 : std::min(static_cast<index_t>(v), T_);
+      }
+    }
+    max_len_ = N_ == 0 ? 0 : *std::max_element(lens_.begin(), lens_.end());
+    // the running sequences are the first ones of a batch of decreasing lengths
+    const bool sorted = std::is_sorted(lens_.rbegin(), lens_.rend());
+    active_.assign(T_, 0);
+    for (index_t t = 0; t < T_; ++t) {
+      if (!sorted) {
+        active_[t] = t < max_len_ ? N_ : 0;
+      } else {
+        while (active_[t] < N_ && lens_[active_[t]] > t) ++active_[t];
+      }
+    }
+  }
+  // the output of a layer below the top one
+  inline DType *LayerOut(index_t l) {
+    return reserve_.data() + l * T_ * N_ * D_ * H_;
+  }
+  // the activations of the gates of a layer and direction, of shape (T, N, ngates * H)
+  inline DType *Gates(index_t l, index_t d) {
+    return reserve_.data() + (L_ - 1) * T_ * N_ * D_ * H_ +
+        (l * D_ + d) * (T_ * N_ * GH_ + extra_size_);
+  }
+  // the cells of LSTM or the projected states of the new gate of GRU, of shape (T, N, H)
+  inline DType *Extra(index_t l, index_t d) {
+    return extra_size_ == 0 ? nullptr : this->Gates(l, d) + T_ * N_ * GH_;
+  }
+
+  /*!
+   * \brief the activations of step t, g holds the projection of the state
+   *  except for GRU, whose projection is in hproj. The ended sequences carry
+   *  their state and cell.
+   */
+  inline void ForwardStep(index_t t, const DType *xproj, const DType *hproj, const DType *bh,
+                          DType *g, const DType *h_prev, index_t h_stride, const DType *c_prev,
+                          DType *h_out, DType *extra) {
+    const index_t H = H_, GH = GH_, ho = D_ * H_;
+    const int mode = param_.mode;
+    #pragma omp parallel for
+    for (int n = 0; n < static_cast<int>(N_); ++n) {
+      DType *gn = g + n * GH;
+      const DType *xn = xproj + n * GH;
+      DType *hn = h_out + n * ho;
+      const DType *hpn = h_prev + n * h_stride;
+      if (t >= lens_[n]) {
+        std::copy(hpn, hpn + H, hn);
+        if (mode == rnn_enum::kLstm) std::copy(c_prev + n * H, c_prev + (n + 1) * H, extra + n * H);
+        continue;
+      }
+      // the activations of each gate go over the H units at once, so that they vectorize
+      switch (mode) {
+        case rnn_enum::kLstm: {
+          for (index_t k = 0; k < GH; ++k) gn[k] += xn[k];
+          RNNSigmoidMap(gn, gn, 2 * H);
+          RNNTanhMap(gn + 2 * H, gn + 2 * H, H);
+          RNNSigmoidMap(gn + 3 * H, gn + 3 * H, H);
+          DType *cell = extra + n * H;
+          for (index_t j = 0; j < H; ++j) {
+            cell[j] = gn[H + j] * c_prev[n * H + j] + gn[j] * gn[2 * H + j];
+          }
+          RNNTanhMap(cell, hn, H);
+          for (index_t j = 0; j < H; ++j) hn[j] *= gn[3 * H + j];
+          break;
+        }
+        case rnn_enum::kGru: {
+          const DType *hp = hproj + n * GH;
+          for (index_t k = 0; k < 2 * H; ++k) gn[k] = xn[k] + hp[k] + bh[k];
+          RNNSigmoidMap(gn, gn, 2 * H);
+          for (index_t j = 0; j < H; ++j) {
+            const DType hnew = hp[2 * H + j] + bh[2 * H + j];
+            extra[n * H + j] = hnew;
+            gn[2 * H + j] = xn[2 * H + j] + gn[j] * hnew;
+          }
+          RNNTanhMap(gn + 2 * H, gn + 2 * H, H);
+          for (index_t j = 0; j < H; ++j) {
+            const DType z = gn[H + j];
+            hn[j] = (DType(1) - z) * gn[2 * H + j] + z * hpn[j];
+          }
+          break;
+        }
+        case rnn_enum::kRnnTanh:
+          for (index_t j = 0; j < H; ++j) gn[j] += xn[j];
+          RNNTanhMap(gn, gn, H);
+          std::copy(gn, gn + H, hn);
+          break;
+        default:
+          for (index_t j = 0; j < H; ++j) hn[j] = gn[j] = std::max(gn[j] + xn[j], DType(0));
+          break;
+      }
+    }
+  }
+
+  /*!
+   * \brief the gradients of the gates of a step given dh, dc_next is the
+   *  gradient of the cell of the step, updated to the one of the previous cell.
+   *  dg is the gradient of the input projection, dgh of the state projection.
+   */
+  inline void BackwardStep(index_t t, const DType *g, const DType *extra, const DType *h,
+                           const DType *h_prev, index_t h_stride, const DType *c_prev,
+                           const DType *dh, DType *dc_next, DType *dg, DType *dgh) {
+    const index_t H = H_, GH = GH_, ho = D_ * H_;
+    const int mode = param_.mode;
+    #pragma omp parallel for
+    for (int n = 0; n < static_cast<int>(N_); ++n) {
+      const DType *gn = g + n * GH;
+      const DType *dhn = dh + n * H;
+      DType *dgn = dg + n * GH;
+      if (t >= lens_[n]) {
+        // an ended sequence, its cell gradient is carried
+        std::fill(dgn, dgn + GH, DType(0));
+        if (dgh != dg) std::fill(dgh + n * GH, dgh + (n + 1) * GH, DType(0));
+        continue;
+      }
+      switch (mode) {
+        case rnn_enum::kLstm:
+          for (index_t j = 0; j < H; ++j) {
+            const DType i = gn[j], f = gn[H + j], c = gn[2 * H + j], o = gn[3 * H + j];
+            const DType tc = std::tanh(extra[n * H + j]);
+            const DType dc = dc_next[n * H + j] + dhn[j] * o * (DType(1) - tc * tc);
+            dgn[j] = dc * c * i * (DType(1) - i);
+            dgn[H + j] = dc * c_prev[n * H + j] * f * (DType(1) - f);
+            dgn[2 * H + j] = dc * i * (DType(1) - c * c);
+            dgn[3 * H + j] = dhn[j] * tc * o * (DType(1) - o);
+            dc_next[n * H + j] = dc * f;
+          }
+          break;
+        case rnn_enum::kGru:
+          for (index_t j = 0; j < H; ++j) {
+            const DType r = gn[j], z = gn[H + j], nn = gn[2 * H + j];
+            const DType dn = dhn[j] * (DType(1) - z) * (DType(1) - nn * nn);
+            const DType dz = dhn[j] * (h_prev[n * h_stride + j] - nn) * z * (DType(1) - z);
+            const DType dr = dn * extra[n * H + j] * r * (DType(1) - r);
+            dgn[j] = dgh[n * GH + j] = dr;
+            dgn[H + j] = dgh[n * GH + H + j] = dz;
+            dgn[2 * H + j] = dn;
+            dgh[n * GH + 2 * H + j] = dn * r;
+          }
+          break;
+        case rnn_enum::kRnnTanh:
+          for (index_t j = 0; j < H; ++j) {
+            const DType hv = h[n * ho + j];
+            dgn[j] = dhn[j] * (DType(1) - hv * hv);
+          }
+          break;
+        default:
+          for (index_t j = 0; j < H; ++j) {
+            dgn[j] = h[n * ho + j] > DType(0) ? dhn[j] : DType(0);
+          }
+          break;
+      }
+    }
+  }
+
+  RNNParam param_;
+  index_t T_, N_, I_, H_, L_, D_, GH_;
+  index_t extra_size_;
+  std::vector<RNNParamOffset> offsets_;
+  /*! \brief the activations of the last forward */
+  std::vector<DType> reserve_;
+  /*! \brief the lengths of the sequences of the last forward, and the longest one */
+  std::vector<index_t> lens_;
+  index_t max_len_;
+  /*! \brief the number of rows of the state gemm of each step */
+  std::vector<index_t> active_;
+};  // class RNNOp
+
+template<typename xpu>
+Operator *CreateOp(RNNParam param, int dtype);
+
+#if DMLC_USE_CXX11
+class RNNProp : public OperatorProperty {
+ public:
+  std::vector<std::string> ListArguments() const override {
+    std::vector<std::string> args = {"data", "parameters", "state"};
+    if (param_.mode == rnn_enum::kLstm) args.push_back("state_cell");
+    if (param_.use_sequence_length) args.push_back("sequence_length");
+    return args;
+  }
+
+  std::vector<std::string> ListOutputs() const override {
+    if (!param_.state_outputs) return {"output"};
+    if (param_.mode == rnn_enum::kLstm) {
+      return {"output", "state", "state_cell"};
+    } else {
+      return {"output", "state"};
+    }
+  }
+
+  int NumOutputs() const override {
+    return this->ListOutputs().size();
+  }
+
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    using namespace mshadow;
+    CHECK_EQ(in_shape->size(), this->ListArguments().size())
+        << "Input:[data, parameters, state" <<
+        (param_.mode == rnn_enum::kLstm ? ", state_cell" : "") <<
+        (param_.use_sequence_length ? ", sequence_length]" : "]");
+    const TShape &dshape = (*in_shape)[rnn_enum::kData];
+    if (dshape.ndim() == 0) return false;
+    CHECK_EQ(dshape.ndim(), 3) << "data must be of shape (seq_length, batch_size, input_size)";
+    const index_t batch = dshape[1], D = param_.bidirectional ? 2 : 1;
+    const index_t H = param_.state_size;
+    SHAPE_ASSIGN_CHECK(*in_shape, rnn_enum::kParams,
+                       Shape1(GetRNNParamSize(param_, dshape[2])));
+    SHAPE_ASSIGN_CHECK(*in_shape, rnn_enum::kState, Shape3(param_.num_layers * D, batch, H));
+    if (param_.mode == rnn_enum::kLstm) {
+      SHAPE_ASSIGN_CHECK(*in_shape, rnn_enum::kStateCell,
+                         Shape3(param_.num_layers * D, batch, H));
+    }
+    if (param_.use_sequence_length) {
+      SHAPE_ASSIGN_CHECK(*in_shape, RNNSequenceLengthInput(param_), Shape1(batch));
+    }
+    out_shape->clear();
+    out_shape->push_back(Shape3(dshape[0], batch, D * H));
+    if (param_.state_outputs) {
+      out_shape->push_back(Shape3(param_.num_layers * D, batch, H));
+      if (param_.mode == rnn_enum::kLstm) {
+        out_shape->push_back(Shape3(param_.num_layers * D, batch, H));
+      }
+    }
+    return true;
+  }
+
+  bool InferType(std::vector<int> *in_type,
+                 std::vector<int> *out_type,
+                 std::vector<int> *aux_type) const override {
+    CHECK_GE(in_type->size(), 1);
+    int dtype = (*in_type)[0];
+    CHECK_NE(dtype, -1) << "First input must have specified type";
+    for (index_t i = 0; i < in_type->size(); ++i) {
+      if ((*in_type)[i] == -1) {
+        (*in_type)[i] = dtype;
+      } else {
+        CHECK_EQ((*in_type)[i], dtype) << "This layer requires uniform type. "
+                                       << "Expected " << dtype << " v.s. given "
+                                       << (*in_type)[i] << " at " << ListArguments()[i];
+      }
+    }
+    out_type->clear();
+    out_type->resize(this->NumOutputs(), dtype);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new RNNProp();
+    ptr->param_ = param_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "RNN";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    std::vector<int> dep = {in_data[rnn_enum::kData], in_data[rnn_enum::kParams],
+        in_data[rnn_enum::kState], out_data[rnn_enum::kOut], out_grad[rnn_enum::kOut]};
+    if (param_.mode == rnn_enum::kLstm) dep.push_back(in_data[rnn_enum::kStateCell]);
+    if (param_.use_sequence_length) dep.push_back(in_data[RNNSequenceLengthInput(param_)]);
+    if (param_.state_outputs) {
+      dep.push_back(out_grad[rnn_enum::kStateOut]);
+      if (param_.mode == rnn_enum::kLstm) dep.push_back(out_grad[rnn_enum::kStateCellOut]);
+    }
+    return dep;
+  }
+
+  std::vector<ResourceRequest> ForwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace};
+  }
+
+  std::vector<ResourceRequest> BackwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace};
+  }
+
+  Operator* CreateOperator(Context ctx) const override {
+    LOG(FATAL) << "Not Implemented";
+    return NULL;
+  }
+
+  Operator* CreateOperatorEx(Context ctx, std::vector<TShape> *in_shape,
+                             std::vector<int> *in_type) const override;
+
+ private:
+  RNNParam param_;
+};  // class RNNProp
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_RNN_INL_H_
@@ -0,0 +1,51 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file rnn.cc
+ * \brief fused recurrent layers
+*/
+#include "./rnn-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator* CreateOp<cpu>(RNNParam param, int dtype) {
+  Operator *op = NULL;
+  switch (dtype) {
+  case mshadow::kFloat32:
+    op = new RNNOp<float>(param);
+    break;
+  case mshadow::kFloat64:
+    op = new RNNOp<double>(param);
+    break;
+  case mshadow::kFloat16:
+    LOG(FATAL) << "float16 RNN layer is currently "
+                  "only supported by CuDNN version.";
+    break;
+  default:
+    LOG(FATAL) << "Unsupported type " << dtype;
+  }
+  return op;
+}
+
+// DO_BIND_DISPATCH comes from operator_common.h
+Operator *RNNProp::CreateOperatorEx(Context ctx, std::vector<TShape> *in_shape,
+                                    std::vector<int> *in_type) const {
+  std::vector<TShape> out_shape, aux_shape;
+  std::vector<int> out_type, aux_type;
+  CHECK(InferType(in_type, &out_type, &aux_type));
+  CHECK(InferShape(in_shape, &out_shape, &aux_shape));
+  DO_BIND_DISPATCH(CreateOp, param_, (*in_type)[0]);
+}
+
+DMLC_REGISTER_PARAMETER(RNNParam);
+
+MXNET_REGISTER_OP_PROPERTY(RNN, RNNProp)
+.describe("Apply a stack of recurrent layers to a whole sequence, the input "
+          "projections of a layer are computed for all steps at once.")
+.add_argument("data", "Symbol", "Input data of shape (seq_length, batch_size, input_size).")
+.add_argument("parameters", "Symbol", "All of the weights followed by all of the biases.")
+.add_argument("state", "Symbol", "Initial hidden state of shape "
+              "(num_layers * num_directions, batch_size, state_size).")
+.add_argument("state_cell", "Symbol", "Initial cell of LSTM, of the shape of state.")
+.add_arguments(RNNParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
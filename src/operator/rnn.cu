@@ -0,0 +1,28 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file rnn.cu
+ * \brief fused recurrent layers of cuDNN
+*/
+#include "./rnn-inl.h"
+#include <vector>
+#if MXNET_USE_CUDNN == 1
+#include "./cudnn_rnn-inl.h"
+#endif  // MXNET_USE_CUDNN
+
+namespace mxnet {
+namespace op {
+template<>
+Operator* CreateOp<gpu>(RNNParam param, int dtype) {
+  Operator *op = NULL;
+#if MXNET_USE_CUDNN == 1 && CUDNN_MAJOR >= 5
+  MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
+    op = new CuDNNRNNOp<DType>(param);
+  })
+#else
+  LOG(FATAL) << "RNN on gpu is only available with cuDNN v5 or later";
+#endif  // MXNET_USE_CUDNN && CUDNN_MAJOR >= 5
+  return op;
+}
+
+}  // namespace op
+}  // namespace mxnet
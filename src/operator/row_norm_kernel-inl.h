@@ -0,0 +1,402 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file row_norm_kernel-inl.h
+ * \brief fused kernels normalizing each row of a (M, N) matrix, of LayerNorm and
+ *  L2Normalization. Each row is read from memory once per pass: its sums are taken
+ *  and its output written while it is in cache on cpu, and by one block with a
+ *  warp shuffle reduce on gpu.
+ */
+#ifndef MXNET_OPERATOR_ROW_NORM_KERNEL_INL_H_
+#define MXNET_OPERATOR_ROW_NORM_KERNEL_INL_H_
+
+#include <dmlc/logging.h>
+#include <mshadow/tensor.h>
+#include <mxnet/base.h>
+#include <algorithm>
+#include <cmath>
+#include "./broadcast_reduce_kernel-inl.h"
+
+namespace mxnet {
+namespace op {
+namespace rownorm {
+/*! \brief number of independent accumulators of a row sum on cpu, so that it vectorizes */
+const int kNumLanes = 4;
+/*! \brief number of columns whose parameter gradients are summed together on cpu */
+const int kColChunk = 64;
+
+/*! \brief sum of f(j) over j in [0, n) */
+template<typename F>
+inline real_t LaneSum(int n, const F &f) {
+  real_t acc[kNumLanes] = {0};
+  int j = 0;
+  for (; j + kNumLanes <= n; j += kNumLanes) {
+    for (int q = 0; q < kNumLanes; ++q) acc[q] += f(j + q);
+  }
+  for (; j < n; ++j) acc[0] += f(j);
+  return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+/*! \brief sums of a(j) and b(j) over j in [0, n) */
+template<typename FA, typename FB>
+inline void LaneSum2(int n, const FA &a, const FB &b, real_t *sum_a, real_t *sum_b) {
+  real_t acc_a[kNumLanes] = {0}, acc_b[kNumLanes] = {0};
+  int j = 0;
+  for (; j + kNumLanes <= n; j += kNumLanes) {
+    for (int q = 0; q < kNumLanes; ++q) {
+      acc_a[q] += a(j + q);
+      acc_b[q] += b(j + q);
+    }
+  }
+  for (; j < n; ++j) {
+    acc_a[0] += a(j);
+    acc_b[0] += b(j);
+  }
+  *sum_a = (acc_a[0] + acc_a[1]) + (acc_a[2] + acc_a[3]);
+  *sum_b = (acc_b[0] + acc_b[1]) + (acc_b[2] + acc_b[3]);
+}
+
+/*!
+ * \brief y = x / (|x| + eps) of each row, and its norm |x|
+ */
+inline void L2NormForward(mshadow::Stream<cpu> *s, const real_t *x, int M, int N, real_t eps,
+                          real_t *y, real_t *norm) {
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < M; ++i) {
+    const real_t *xi = x + static_cast<size_t>(i) * N;
+    real_t *yi = y + static_cast<size_t>(i) * N;
+    norm[i] = std::sqrt(LaneSum(N, [xi](int j) { return xi[j] * xi[j]; }));
+    const real_t scale = 1 / (norm[i] + eps);
+    for (int j = 0; j < N; ++j) yi[j] = xi[j] * scale;
+  }
+}
+
+/*!
+ * \brief gx = (g - y * sum(g * y)) / (norm + eps) of each row, added to gx if addto.
+ *  gx may be g.
+ */
+inline void L2NormBackward(mshadow::Stream<cpu> *s, const real_t *g, const real_t *y,
+                           const real_t *norm, int M, int N, real_t eps,
+                           real_t *gx, bool addto) {
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < M; ++i) {
+    const size_t offset = static_cast<size_t>(i) * N;
+    const real_t *gi = g + offset, *yi = y + offset;
+    real_t *gxi = gx + offset;
+    const real_t dot = LaneSum(N, [gi, yi](int j) { return gi[j] * yi[j]; });
+    const real_t scale = 1 / (norm[i] + eps);
+    for (int j = 0; j < N; ++j) {
+      const real_t v = (gi[j] - yi[j] * dot) * scale;
+      gxi[j] = addto ? gxi[j] + v : v;
+    }
+  }
+}
+
+/*!
+ * \brief y = (x - mean) / std * gamma + beta of each row, with std = sqrt(var + eps).
+ *  The sums of the row are shifted by its first element, so that the variance
+ *  keeps its precision when the mean is far from zero.
+ */
+inline void LayerNormForward(mshadow::Stream<cpu> *s, const real_t *x, const real_t *gamma,
+                             const real_t *beta, int M, int N, real_t eps,
+                             real_t *y, real_t *mean, real_t *stdev) {
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < M; ++i) {
+    const real_t *xi = x + static_cast<size_t>(i) * N;
+    real_t *yi = y + static_cast<size_t>(i) * N;
+    const real_t shift = xi[0];
+    real_t sum, sq;
+    LaneSum2(N, [xi, shift](int j) { return xi[j] - shift; },
+             [xi, shift](int j) { return (xi[j] - shift) * (xi[j] - shift); }, &sum, &sq);
+    const real_t m = sum / N;
+    const real_t var = std::max(sq / N - m * m, real_t(0));
+    mean[i] = shift + m;
+    stdev[i] = std::sqrt(var + eps);
+    const real_t rstd = 1 / stdev[i];
+    for (int j = 0; j < N; ++j) yi[j] = (xi[j] - mean[i]) * rstd * gamma[j] + beta[j];
+  }
+}
+
+/*!
+ * \brief the data gradient of LayerNorm, of each row
+ *  gx = (gy - mean(gy) - xhat * mean(gy * xhat)) / std with gy = g * gamma,
+ *  added to gx if addto.
+ */
+inline void LayerNormBackwardData(mshadow::Stream<cpu> *s, const real_t *g, const real_t *x,
+                                  const real_t *gamma, const real_t *mean, const real_t *stdev,
+                                  int M, int N, real_t *gx, bool addto) {
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < M; ++i) {
+    const size_t offset = static_cast<size_t>(i) * N;
+    const real_t *gi = g + offset, *xi = x + offset;
+    real_t *gxi = gx + offset;
+    const real_t m = mean[i], rstd = 1 / stdev[i];
+    real_t sum_gy, sum_gyx;
+    LaneSum2(N, [gi, gamma](int j) { return gi[j] * gamma[j]; },
+             [gi, xi, gamma, m, rstd](int j) { return gi[j] * gamma[j] * (xi[j] - m) * rstd; },
+             &sum_gy, &sum_gyx);
+    sum_gy /= N;
+    sum_gyx /= N;
+    for (int j = 0; j < N; ++j) {
+      const real_t v = (gi[j] * gamma[j] - sum_gy - (xi[j] - m) * rstd * sum_gyx) * rstd;
+      gxi[j] = addto ? gxi[j] + v : v;
+    }
+  }
+}
+
+/*!
+ * \brief the gradients of gamma, sum of g * xhat over the rows, and of beta, sum of g,
+ *  parallel over chunks of columns that are read along the rows.
+ */
+inline void LayerNormBackwardParams(mshadow::Stream<cpu> *s, const real_t *g, const real_t *x,
+                                    const real_t *mean, const real_t *stdev, int M, int N,
+                                    real_t *ggamma, bool gamma_addto,
+                                    real_t *gbeta, bool beta_addto) {
+  #pragma omp parallel for schedule(static)
+  for (int begin = 0; begin < N; begin += kColChunk) {
+    const int len = std::min(kColChunk, N - begin);
+    real_t sg[kColChunk] = {0}, sgx[kColChunk] = {0};
+    for (int i = 0; i < M; ++i) {
+      const size_t offset = static_cast<size_t>(i) * N + begin;
+      const real_t *gi = g + offset, *xi = x + offset;
+      const real_t m = mean[i], rstd = 1 / stdev[i];
+      for (int j = 0; j < len; ++j) {
+        sg[j] += gi[j];
+        sgx[j] += gi[j] * (xi[j] - m) * rstd;
+      }
+    }
+    if (ggamma != nullptr) {
+      for (int j = 0; j < len; ++j) {
+        ggamma[begin + j] = gamma_addto ? ggamma[begin + j] + sgx[j] : sgx[j];
+      }
+    }
+    if (gbeta != nullptr) {
+      for (int j = 0; j < len; ++j) {
+        gbeta[begin + j] = beta_addto ? gbeta[begin + j] + sg[j] : sg[j];
+      }
+    }
+  }
+}
+
+#ifdef __CUDACC__
+/*!
+ * \brief sums of a and b over the threads of a block, returned to all of them. The
+ *  warps reduce by shuffles, then the first warp reduces the sums of the warps.
+ */
+__device__ void BlockSum2(real_t *a, real_t *b) {
+  using broadcast::kWarpSize;
+  using broadcast::WarpShflDown;
+  __shared__ real_t warp_a[mshadow::cuda::kBaseThreadNum / kWarpSize];
+  __shared__ real_t warp_b[mshadow::cuda::kBaseThreadNum / kWarpSize];
+  real_t va = *a, vb = *b;
+  for (int offset = kWarpSize / 2; offset > 0; offset >>= 1) {
+    va += WarpShflDown(va, offset);
+    vb += WarpShflDown(vb, offset);
+  }
+  const int lane = threadIdx.x % kWarpSize, warp = threadIdx.x / kWarpSize;
+  if (lane == 0) {
+    warp_a[warp] = va;
+    warp_b[warp] = vb;
+  }
+  __syncthreads();
+  if (warp == 0) {
+    const int nwarp = blockDim.x / kWarpSize;
+    va = lane < nwarp ? warp_a[lane] : 0;
+    vb = lane < nwarp ? warp_b[lane] : 0;
+    for (int offset = kWarpSize / 2; offset > 0; offset >>= 1) {
+      va += WarpShflDown(va, offset);
+      vb += WarpShflDown(vb, offset);
+    }
+    if (lane == 0) {
+      warp_a[0] = va;
+      warp_b[0] = vb;
+    }
+  }
+  __syncthreads();
+  *a = warp_a[0];
+  *b = warp_b[0];
+  __syncthreads();
+}
+
+/*! \brief one block per row */
+__global__ void L2NormForwardKernel(const real_t *x, int M, int N, real_t eps,
+                                    real_t *y, real_t *norm) {
+  for (int i = blockIdx.x; i < M; i += gridDim.x) {
+    const real_t *xi = x + static_cast<size_t>(i) * N;
+    real_t *yi = y + static_cast<size_t>(i) * N;
+    real_t sq = 0, unused = 0;
+    for (int j = threadIdx.x; j < N; j += blockDim.x) sq += xi[j] * xi[j];
+    BlockSum2(&sq, &unused);
+    const real_t nrm = sqrt(sq);
+    if (threadIdx.x == 0) norm[i] = nrm;
+    const real_t scale = 1 / (nrm + eps);
+    for (int j = threadIdx.x; j < N; j += blockDim.x) yi[j] = xi[j] * scale;
+  }
+}
+
+__global__ void L2NormBackwardKernel(const real_t *g, const real_t *y, const real_t *norm,
+                                     int M, int N, real_t eps, real_t *gx, bool addto) {
+  for (int i = blockIdx.x; i < M; i += gridDim.x) {
+    const size_t offset = static_cast<size_t>(i) * N;
+    const real_t *gi = g + offset, *yi = y + offset;
+    real_t *gxi = gx + offset;
+    real_t dot = 0, unused = 0;
+    for (int j = threadIdx.x; j < N; j += blockDim.x) dot += gi[j] * yi[j];
+    BlockSum2(&dot, &unused);
+    const real_t scale = 1 / (norm[i] + eps);
+    for (int j = threadIdx.x; j < N; j += blockDim.x) {
+      const real_t v = (gi[j] - yi[j] * dot) * scale;
+      gxi[j] = addto ? gxi[j] + v : v;
+    }
+  }
+}
+
+__global__ void LayerNormForwardKernel(const real_t *x, const real_t *gamma, const real_t *beta,
+                                       int M, int N, real_t eps,
+                                       real_t *y, real_t *mean, real_t *stdev) {
+  for (int i = blockIdx.x; i < M; i += gridDim.x) {
+    const real_t *xi = x + static_cast<size_t>(i) * N;
+    real_t *yi = y + static_cast<size_t>(i) * N;
+    const real_t shift = xi[0];
+    real_t sum = 0, sq = 0;
+    for (int j = threadIdx.x; j < N; j += blockDim.x) {
+      const real_t d = xi[j] - shift;
+      sum += d;
+      sq += d * d;
+    }
+    BlockSum2(&sum, &sq);
+    const real_t m = sum / N;
+    const real_t mu = shift + m;
+    const real_t sd = sqrt(max(sq / N - m * m, real_t(0)) + eps);
+    if (threadIdx.x == 0) {
+      mean[i] = mu;
+      stdev[i] = sd;
+    }
+    const real_t rstd = 1 / sd;
+    for (int j = threadIdx.x; j < N; j += blockDim.x) {
+      yi[j] = (xi[j] - mu) * rstd * gamma[j] + beta[j];
+    }
+  }
+}
+
+__global__ void LayerNormBackwardDataKernel(const real_t *g, const real_t *x,
+                                            const real_t *gamma, const real_t *mean,
+                                            const real_t *stdev, int M, int N,
+                                            real_t *gx, bool addto) {
+  for (int i = blockIdx.x; i < M; i += gridDim.x) {
+    const size_t offset = static_cast<size_t>(i) * N;
+    const real_t *gi = g + offset, *xi = x + offset;
+    real_t *gxi = gx + offset;
+    const real_t m = mean[i], rstd = 1 / stdev[i];
+    real_t sum_gy = 0, sum_gyx = 0;
+    for (int j = threadIdx.x; j < N; j += blockDim.x) {
+      const real_t gy = gi[j] * gamma[j];
+      sum_gy += gy;
+      sum_gyx += gy * (xi[j] - m) * rstd;
+    }
+    BlockSum2(&sum_gy, &sum_gyx);
+    sum_gy /= N;
+    sum_gyx /= N;
+    for (int j = threadIdx.x; j < N; j += blockDim.x) {
+      const real_t v = (gi[j] * gamma[j] - sum_gy - (xi[j] - m) * rstd * sum_gyx) * rstd;
+      gxi[j] = addto ? gxi[j] + v : v;
+    }
+  }
+}
+
+/*!
+ * \brief a block of kWarpSize columns, its warps read rows kNumRowLanes apart,
+ *  so that each row of the block is one coalesced read, then sum their partial sums
+ */
+__global__ void LayerNormBackwardParamsKernel(const real_t *g, const real_t *x,
+                                              const real_t *mean, const real_t *stdev,
+                                              int M, int N, real_t *ggamma, bool gamma_addto,
+                                              real_t *gbeta, bool beta_addto) {
+  using broadcast::kWarpSize;
+  const int kNumRowLanes = mshadow::cuda::kBaseThreadNum / kWarpSize;
+  __shared__ real_t sg[kNumRowLanes][kWarpSize];
+  __shared__ real_t sgx[kNumRowLanes][kWarpSize];
+  const int lane = threadIdx.x % kWarpSize, row_lane = threadIdx.x / kWarpSize;
+  for (int begin = blockIdx.x * kWarpSize; begin < N; begin += gridDim.x * kWarpSize) {
+    const int j = begin + lane;
+    real_t acc_g = 0, acc_gx = 0;
+    if (j < N) {
+      for (int i = row_lane; i < M; i += kNumRowLanes) {
+        const size_t k = static_cast<size_t>(i) * N + j;
+        acc_g += g[k];
+        acc_gx += g[k] * (x[k] - mean[i]) / stdev[i];
+      }
+    }
+    sg[row_lane][lane] = acc_g;
+    sgx[row_lane][lane] = acc_gx;
+    __syncthreads();
+    if (row_lane == 0 && j < N) {
+      for (int r = 1; r < kNumRowLanes; ++r) {
+        acc_g += sg[r][lane];
+        acc_gx += sgx[r][lane];
+      }
+      if (ggamma != nullptr) ggamma[j] = gamma_addto ? ggamma[j] + acc_gx : acc_gx;
+      if (gbeta != nullptr) gbeta[j] = beta_addto ? gbeta[j] + acc_g : acc_g;
+    }
+    __syncthreads();
+  }
+}
+
+inline void CheckLaunch() {
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+inline void L2NormForward(mshadow::Stream<gpu> *s, const real_t *x, int M, int N, real_t eps,
+                          real_t *y, real_t *norm) {
+  using namespace mshadow::cuda;
+  L2NormForwardKernel<<<std::min(M, kMaxGridNum), kBaseThreadNum, 0,
+                        mshadow::Stream<gpu>::GetStream(s)>>>(x, M, N, eps, y, norm);
+  CheckLaunch();
+}
+
+inline void L2NormBackward(mshadow::Stream<gpu> *s, const real_t *g, const real_t *y,
+                           const real_t *norm, int M, int N, real_t eps,
+                           real_t *gx, bool addto) {
+  using namespace mshadow::cuda;
+  L2NormBackwardKernel<<<std::min(M, kMaxGridNum), kBaseThreadNum, 0,
+                         mshadow::Stream<gpu>::GetStream(s)>>>(
+      g, y, norm, M, N, eps, gx, addto);
+  CheckLaunch();
+}
+
+inline void LayerNormForward(mshadow::Stream<gpu> *s, const real_t *x, const real_t *gamma,
+                             const real_t *beta, int M, int N, real_t eps,
+                             real_t *y, real_t *mean, real_t *stdev) {
+  using namespace mshadow::cuda;
+  LayerNormForwardKernel<<<std::min(M, kMaxGridNum), kBaseThreadNum, 0,
+                           mshadow::Stream<gpu>::GetStream(s)>>>(
+      x, gamma, beta, M, N, eps, y, mean, stdev);
+  CheckLaunch();
+}
+
+inline void LayerNormBackwardData(mshadow::Stream<gpu> *s, const real_t *g, const real_t *x,
+                                  const real_t *gamma, const real_t *mean, const real_t *stdev,
+                                  int M, int N, real_t *gx, bool addto) {
+  using namespace mshadow::cuda;
+  LayerNormBackwardDataKernel<<<std::min(M, kMaxGridNum), kBaseThreadNum, 0,
+                                mshadow::Stream<gpu>::GetStream(s)>>>(
+      g, x, gamma, mean, stdev, M, N, gx, addto);
+  CheckLaunch();
+}
+
+inline void LayerNormBackwardParams(mshadow::Stream<gpu> *s, const real_t *g, const real_t *x,
+                                    const real_t *mean, const real_t *stdev, int M, int N,
+                                    real_t *ggamma, bool gamma_addto,
+                                    real_t *gbeta, bool beta_addto) {
+  using namespace mshadow::cuda;
+  const int nblock = (N + broadcast::kWarpSize - 1) / broadcast::kWarpSize;
+  LayerNormBackwardParamsKernel<<<std::min(nblock, kMaxGridNum), kBaseThreadNum, 0,
+                                  mshadow::Stream<gpu>::GetStream(s)>>>(
+      g, x, mean, stdev, M, N, ggamma, gamma_addto, gbeta, beta_addto);
+  CheckLaunch();
+}
+#endif  // __CUDACC__
+}  // namespace rownorm
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_ROW_NORM_KERNEL_INL_H_
@@ -0,0 +1,71 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file row_sparse-inl.h
+ * \brief row operations of row sparse gradients, shared by operators and ndarray functions.
+ *
+ *  A row sparse gradient of a matrix is given by its row indices and the values of
+ *  these rows, the other rows are zero. The indices are stored in the real type of
+ *  the matrix, as the data of Embedding.
+ */
+#ifndef MXNET_OPERATOR_ROW_SPARSE_INL_H_
+#define MXNET_OPERATOR_ROW_SPARSE_INL_H_
+
+#include <dmlc/logging.h>
+#include <mshadow/tensor.h>
+#include <mxnet/base.h>
+#include <algorithm>
+
+namespace mxnet {
+namespace op {
+namespace rowsparse {
+/*!
+ * \brief dst[index[i]] = src[i], or zero when src is NULL.
+ *  A row given several times is written by any of them.
+ */
+template<typename DType>
+inline void FillRows(mshadow::Tensor<mshadow::cpu, 2, DType> dst,
+                     const mshadow::Tensor<mshadow::cpu, 1, DType> &index,
+                     const DType *src) {
+  const index_t ncol = dst.size(1);
+  for (index_t i = 0; i < index.size(0); ++i) {
+    const index_t row = static_cast<index_t>(static_cast<float>(index[i]));
+    CHECK_LT(row, dst.size(0)) << "row index out of range";
+    DType *out = dst[row].dptr_;
+    for (index_t j = 0; j < ncol; ++j) {
+      out[j] = src == NULL ? DType(0) : src[i * ncol + j];
+    }
+  }
+}
+
+#ifdef __CUDACC__
+template<typename DType>
+__global__ void FillRowsKernel(DType *dst, const DType *index, const DType *src,
+                               int nrow, int ncol, int count) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < count;
+       i += blockDim.x * gridDim.x) {
+    const int row = static_cast<int>(static_cast<float>(index[i / ncol]));
+    // rows out of range are skipped, they are checked on cpu
+    if (row < 0 || row >= nrow) continue;
+    dst[row * ncol + i % ncol] = src == NULL ? DType(0) : src[i];
+  }
+}
+
+template<typename DType>
+inline void FillRows(mshadow::Tensor<mshadow::gpu, 2, DType> dst,
+                     const mshadow::Tensor<mshadow::gpu, 1, DType> &index,
+                     const DType *src) {
+  using namespace mshadow::cuda;
+  const int count = index.size(0) * dst.size(1);
+  if (count == 0) return;
+  const int grid = std::min(kMaxGridNum, (count + kBaseThreadNum - 1) / kBaseThreadNum);
+  cudaStream_t stream = mshadow::Stream<mshadow::gpu>::GetStream(dst.stream_);
+  FillRowsKernel<DType><<<grid, kBaseThreadNum, 0, stream>>>(
+      dst.dptr_, index.dptr_, src, dst.size(0), dst.size(1), count);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace rowsparse
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_ROW_SPARSE_INL_H_
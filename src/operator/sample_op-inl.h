@@ -8,6 +8,8 @@
 
 #include <mxnet/operator_util.h>
 #include "./mshadow_op.h"
+#include "../common/philox.h"
+#include "./multinomial-inl.h"
 
 #if defined(__CUDACC__)
 #define XPU gpu
@@ -58,9 +60,9 @@ void SampleUniform_(const EnvArguments& env,
       << "only support float32 rnd so far";
   SampleUniformParam param;
   param.Init(env.kwargs);
-  mshadow::Random<xpu, float> *prnd = env.resource[0].get_random<xpu, float>(s);
+  ParallelRandomState *prnd = env.resource[0].get_parallel_random();
   mshadow::Tensor<xpu, 2, float> tmp = ret->FlatTo2D<xpu, float>(s);
-  prnd->SampleUniform(&tmp, float(param.low), float(param.high));  // NOLINT(*)
+  common::random::SampleUniform(prnd, &tmp, float(param.low), float(param.high));  // NOLINT(*)
 }
 
 template<typename xpu>
@@ -75,9 +77,37 @@ void SampleNormal_(const EnvArguments& env,
       << "only support float32 rnd so far";
   SampleNormalParam param;
   param.Init(env.kwargs);
-  mshadow::Random<xpu, float> *prnd = env.resource[0].get_random<xpu, float>(s);
+  ParallelRandomState *prnd = env.resource[0].get_parallel_random();
   mshadow::Tensor<xpu, 2, float> tmp = ret->FlatTo2D<xpu, float>(s);
-  prnd->SampleGaussian(&tmp, float(param.loc), float(param.scale));  // NOLINT(*)
+  common::random::SampleGaussian(prnd, &tmp, float(param.loc), float(param.scale));  // NOLINT(*)
+}
+
+template<typename xpu>
+void SampleMultinomial_(const TBlob& src,
+                        const EnvArguments& env,
+                        TBlob *ret,
+                        OpReqType req,
+                        RunContext ctx) {
+  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+  CHECK_EQ(ret->type_flag_, mshadow::kFloat32)
+      << "only support float32 rnd so far";
+  CHECK_EQ(req, kWriteTo);
+  MultinomialParam param;
+  param.Init(env.kwargs);
+  CHECK(!param.get_prob) << "the log probabilities are only output by the symbol";
+  ParallelRandomState *prnd = env.resource[0].get_parallel_random();
+  const int K = static_cast<int>(src.shape_[src.shape_.ndim() - 1]);
+  const int rows = static_cast<int>(src.Size() / K);
+  const int S = static_cast<int>(ret->Size() / rows);
+  multinomial::Sample(s, *prnd, rows, K, S, src.dptr<float>(), ret->dptr<float>(), nullptr);
+  prnd->counter += (static_cast<size_t>(rows) * S + common::random::kPhiloxWidth - 1) /
+      common::random::kPhiloxWidth;
+}
+
+inline TShape SampleMultinomialShape(const TShape& src, const EnvArguments& env) {
+  MultinomialParam param;
+  param.Init(env.kwargs);
+  return MultinomialShape(src, param);
 }
 
 template<typename ParamType>
@@ -91,7 +121,7 @@ inline TShape SampleShape(const EnvArguments& env) {
 MXNET_REGISTER_SIMPLE_OP(_sample_uniform, XPU)
 .set_symbol_op_name("uniform")
 .set_enable_kwargs(true)
-.set_resource_request(ResourceRequest::kRandom)
+.set_resource_request(ResourceRequest::kParallelRandom)
 .set_function(XPU::kDevMask, SampleUniform_<XPU>)
 .set_shape_function(SampleShape<SampleUniformParam>)
 .describe("Sample a uniform distribution")
@@ -101,12 +131,22 @@ MXNET_REGISTER_SIMPLE_OP(_sample_uniform, XPU)
 MXNET_REGISTER_SIMPLE_OP(_sample_normal, XPU)
 .set_symbol_op_name("normal")
 .set_enable_kwargs(true)
-.set_resource_request(ResourceRequest::kRandom)
+.set_resource_request(ResourceRequest::kParallelRandom)
 .set_function(XPU::kDevMask, SampleNormal_<XPU>)
 .set_shape_function(SampleShape<SampleNormalParam>)
 .describe("Sample a normal distribution")
 .add_arguments(SampleNormalParam::__FIELDS__());
 
+// sample multinomial, the symbol is registered by MultinomialProp
+MXNET_REGISTER_SIMPLE_OP(sample_multinomial, XPU)
+.set_enable_kwargs(true)
+.set_resource_request(ResourceRequest::kParallelRandom)
+.set_function(XPU::kDevMask, SampleMultinomial_<XPU>, kNoInplace, kNotRegisterSymbolic)
+.set_shape_function(SampleMultinomialShape)
+.describe("Sample the categorical distributions given by the probabilities on the last "
+          "axis of src, as float class indices of shape src.shape[:-1] + shape.")
+.add_arguments(MultinomialParam::__FIELDS__());
+
 }  // namespace op
 }  // namespace mxnet
 #endif  // MXNET_OPERATOR_SAMPLE_OP_INL_H_
@@ -0,0 +1,241 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file sequence_last-inl.h
+ * \brief the last step of each sequence of a padded batch of (seq_length, batch_size, ...),
+ *  given the length of each sequence.
+ */
+#ifndef MXNET_OPERATOR_SEQUENCE_LAST_INL_H_
+#define MXNET_OPERATOR_SEQUENCE_LAST_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./operator_common.h"
+#include "./mshadow_op.h"
+
+namespace mxnet {
+namespace op {
+
+namespace seq_last {
+enum SequenceLastOpInputs {kData, kSequenceLength};
+enum SequenceLastOpOutputs {kOut};
+}  // namespace seq_last
+
+struct SequenceLastParam : public dmlc::Parameter<SequenceLastParam> {
+  bool use_sequence_length;
+  DMLC_DECLARE_PARAMETER(SequenceLastParam) {
+    DMLC_DECLARE_FIELD(use_sequence_length).set_default(false)
+    .describe("Whether the lengths of the sequences are given by the input "
+              "sequence_length, otherwise the last step of data is taken.");
+  }
+};
+
+/*! \brief the step of the last element of a sequence of length len, in [0, T) */
+MSHADOW_XINLINE int SequenceLastStep(float len, int T) {
+  const int t = static_cast<int>(len) - 1;
+  return t < 0 ? 0 : (t >= T ? T - 1 : t);
+}
+
+/*!
+ * \brief gather the last step of each sequence of (T, N, K) into (N, K), or scatter
+ *  (N, K) into the last steps if backward, adding to them if add. len is NULL for T.
+ */
+template<typename DType>
+inline void SequenceLast(mshadow::Stream<cpu> *s, DType *seq, const DType *len, DType *last,
+                         int T, int N, int K, bool backward, bool add) {
+  #pragma omp parallel for schedule(static)
+  for (int n = 0; n < N; ++n) {
+    const int t = len != NULL ? SequenceLastStep(static_cast<float>(len[n]), T) : T - 1;
+    DType *step = seq + (static_cast<size_t>(t) * N + n) * K;
+    DType *row = last + static_cast<size_t>(n) * K;
+    for (int k = 0; k < K; ++k) {
+      if (!backward) {
+        row[k] = add ? row[k] + step[k] : step[k];
+      } else {
+        step[k] = add ? step[k] + row[k] : row[k];
+      }
+    }
+  }
+}
+
+#ifdef __CUDACC__
+template<typename DType>
+__global__ void SequenceLastKernel(DType *seq, const DType *len, DType *last,
+                                   int T, int N, int K, bool backward, bool add) {
+  const size_t size = static_cast<size_t>(N) * K;
+  for (size_t e = blockIdx.x * blockDim.x + threadIdx.x; e < size;
+       e += gridDim.x * blockDim.x) {
+    const int n = e / K;
+    const int t = len != NULL ? SequenceLastStep(static_cast<float>(len[n]), T) : T - 1;
+    DType *step = seq + (static_cast<size_t>(t) * N + n) * K + e % K;
+    if (!backward) {
+      last[e] = add ? last[e] + *step : *step;
+    } else {
+      *step = add ? *step + last[e] : last[e];
+    }
+  }
+}
+
+template<typename DType>
+inline void SequenceLast(mshadow::Stream<gpu> *s, DType *seq, const DType *len, DType *last,
+                         int T, int N, int K, bool backward, bool add) {
+  using namespace mshadow::cuda;
+  const size_t size = static_cast<size_t>(N) * K;
+  const int blocks = static_cast<int>(std::min<size_t>((size + kBaseThreadNum - 1) /
+                                                       kBaseThreadNum, kMaxGridNum));
+  SequenceLastKernel<DType><<<std::max(blocks, 1), kBaseThreadNum, 0,
+                              mshadow::Stream<gpu>::GetStream(s)>>>(
+      seq, len, last, T, N, K, backward, add);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+
+/*!
+ * \brief only the last steps are read by the forward, and written by the backward
+ *  besides clearing the gradient.
+ */
+template<typename xpu, typename DType>
+class SequenceLastOp : public Operator {
+ public:
+  explicit SequenceLastOp(SequenceLastParam param) : param_(param) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    if (req[seq_last::kOut] == kNullOp) return;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    const TBlob &data = in_data[seq_last::kData];
+    const int T = data.shape_[0], N = data.shape_[1];
+    const DType *len = param_.use_sequence_length ?
+        in_data[seq_last::kSequenceLength].dptr<DType>() : NULL;
+    SequenceLast(s, data.dptr<DType>(), len, out_data[seq_last::kOut].dptr<DType>(),
+                 T, N, static_cast<int>(data.Size() / T / N), false,
+                 req[seq_last::kOut] == kAddTo);
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    if (req[seq_last::kData] == kNullOp) return;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    const TBlob &dx = in_grad[seq_last::kData];
+    const int T = dx.shape_[0], N = dx.shape_[1];
+    if (req[seq_last::kData] != kAddTo) {
+      Tensor<xpu, 1, DType> grad = dx.get_with_shape<xpu, 1, DType>(Shape1(dx.Size()), s);
+      grad = DType(0);
+    }
+    const DType *len = param_.use_sequence_length ?
+        in_data[seq_last::kSequenceLength].dptr<DType>() : NULL;
+    SequenceLast(s, dx.dptr<DType>(), len, out_grad[seq_last::kOut].dptr<DType>(),
+                 T, N, static_cast<int>(dx.Size() / T / N), true,
+                 req[seq_last::kData] == kAddTo);
+  }
+
+ private:
+  SequenceLastParam param_;
+};  // class SequenceLastOp
+
+template<typename xpu>
+Operator *CreateOp(SequenceLastParam param, int dtype);
+
+#if DMLC_USE_CXX11
+class SequenceLastProp : public OperatorProperty {
+ public:
+  std::vector<std::string> ListArguments() const override {
+    if (param_.use_sequence_length) return {"data", "sequence_length"};
+    return {"data"};
+  }
+
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    CHECK_EQ(in_shape->size(), this->ListArguments().size());
+    const TShape &dshape = (*in_shape)[seq_last::kData];
+    if (dshape.ndim() == 0) return false;
+    CHECK_GE(dshape.ndim(), 2) << "data must be of shape (seq_length, batch_size, ...)";
+    if (param_.use_sequence_length) {
+      SHAPE_ASSIGN_CHECK(*in_shape, seq_last::kSequenceLength, mshadow::Shape1(dshape[1]));
+    }
+    out_shape->clear();
+    out_shape->push_back(TShape(dshape.data() + 1, dshape.data() + dshape.ndim()));
+    return true;
+  }
+
+  bool InferType(std::vector<int> *in_type,
+                 std::vector<int> *out_type,
+                 std::vector<int> *aux_type) const override {
+    CHECK_GE(in_type->size(), 1);
+    int dtype = (*in_type)[0];
+    CHECK_NE(dtype, -1) << "First input must have specified type";
+    for (index_t i = 0; i < in_type->size(); ++i) {
+      if ((*in_type)[i] == -1) {
+        (*in_type)[i] = dtype;
+      } else {
+        CHECK_EQ((*in_type)[i], dtype) << "This layer requires uniform type. "
+                                       << "Expected " << dtype << " v.s. given "
+                                       << (*in_type)[i] << " at " << ListArguments()[i];
+      }
+    }
+    out_type->clear();
+    out_type->push_back(dtype);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new SequenceLastProp();
+    ptr->param_ = param_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "SequenceLast";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    if (param_.use_sequence_length) {
+      return {out_grad[seq_last::kOut], in_data[seq_last::kSequenceLength]};
+    }
+    return {out_grad[seq_last::kOut]};
+  }
+
+  Operator* CreateOperator(Context ctx) const override {
+    LOG(FATAL) << "Not Implemented";
+    return NULL;
+  }
+
+  Operator* CreateOperatorEx(Context ctx, std::vector<TShape> *in_shape,
+                             std::vector<int> *in_type) const override;
+
+ private:
+  SequenceLastParam param_;
+};  // class SequenceLastProp
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_SEQUENCE_LAST_INL_H_
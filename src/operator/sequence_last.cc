@@ -0,0 +1,37 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file sequence_last.cc
+ * \brief the last step of sequences
+*/
+#include "./sequence_last-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<cpu>(SequenceLastParam param, int dtype) {
+  Operator *op = NULL;
+  MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
+    op = new SequenceLastOp<cpu, DType>(param);
+  });
+  return op;
+}
+
+Operator *SequenceLastProp::CreateOperatorEx(Context ctx, std::vector<TShape> *in_shape,
+                                             std::vector<int> *in_type) const {
+  std::vector<TShape> out_shape, aux_shape;
+  std::vector<int> out_type, aux_type;
+  CHECK(InferType(in_type, &out_type, &aux_type));
+  CHECK(InferShape(in_shape, &out_shape, &aux_shape));
+  DO_BIND_DISPATCH(CreateOp, param_, (*in_type)[0]);
+}
+
+DMLC_REGISTER_PARAMETER(SequenceLastParam);
+
+MXNET_REGISTER_OP_PROPERTY(SequenceLast, SequenceLastProp)
+.describe("Take the last step of each sequence of a padded batch, of shape "
+          "(batch_size, ...), only reading those steps.")
+.add_argument("data", "Symbol", "Input data of shape (seq_length, batch_size, ...).")
+.add_argument("sequence_length", "Symbol", "The length of each sequence, of shape "
+              "(batch_size,), used with use_sequence_length.")
+.add_arguments(SequenceLastParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
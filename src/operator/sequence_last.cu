@@ -0,0 +1,18 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file sequence_last.cu
+ * \brief the last step of sequences
+*/
+#include "./sequence_last-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<gpu>(SequenceLastParam param, int dtype) {
+  Operator *op = NULL;
+  MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
+    op = new SequenceLastOp<gpu, DType>(param);
+  });
+  return op;
+}
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,264 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file sequence_mask-inl.h
+ * \brief set the padded steps of a batch of sequences of (seq_length, batch_size, ...)
+ *  to a value, given the length of each sequence.
+ */
+#ifndef MXNET_OPERATOR_SEQUENCE_MASK_INL_H_
+#define MXNET_OPERATOR_SEQUENCE_MASK_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./operator_common.h"
+#include "./mshadow_op.h"
+
+namespace mxnet {
+namespace op {
+
+namespace seq_mask {
+enum SequenceMaskOpInputs {kData, kSequenceLength};
+enum SequenceMaskOpOutputs {kOut};
+}  // namespace seq_mask
+
+struct SequenceMaskParam : public dmlc::Parameter<SequenceMaskParam> {
+  bool use_sequence_length;
+  float value;
+  DMLC_DECLARE_PARAMETER(SequenceMaskParam) {
+    DMLC_DECLARE_FIELD(use_sequence_length).set_default(false)
+    .describe("Whether the lengths of the sequences are given by the input "
+              "sequence_length, otherwise all the steps are kept.");
+    DMLC_DECLARE_FIELD(value).set_default(0.0f)
+    .describe("The value of the padded steps.");
+  }
+};
+
+/*!
+ * \brief out = in with the steps t >= len[n] of each sequence n set to value,
+ *  or out += in on the steps t < len[n] if add. in is (T, N, K), out may be in.
+ */
+template<typename DType>
+inline void SequenceMask(mshadow::Stream<cpu> *s, const DType *in, const DType *len,
+                         DType *out, int T, int N, int K, DType value, bool add) {
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < T * N; ++r) {
+    const int t = r / N, n = r % N;
+    const DType *src = in + static_cast<size_t>(r) * K;
+    DType *dst = out + static_cast<size_t>(r) * K;
+    if (t < static_cast<int>(len[n])) {
+      if (add) {
+        for (int k = 0; k < K; ++k) dst[k] += src[k];
+      } else if (dst != src) {
+        std::copy(src, src + K, dst);
+      }
+    } else if (!add) {
+      std::fill(dst, dst + K, value);
+    }
+  }
+}
+
+#ifdef __CUDACC__
+template<typename DType>
+__global__ void SequenceMaskKernel(const DType *in, const DType *len, DType *out,
+                                   int T, int N, int K, DType value, bool add) {
+  const size_t size = static_cast<size_t>(T) * N * K;
+  for (size_t e = blockIdx.x * blockDim.x + threadIdx.x; e < size;
+       e += gridDim.x * blockDim.x) {
+    const int r = e / K, t = r / N, n = r % N;
+    if (t < static_cast<int>(len[n])) {
+      out[e] = add ? out[e] + in[e] : in[e];
+    } else if (!add) {
+      out[e] = value;
+    }
+  }
+}
+
+template<typename DType>
+inline void SequenceMask(mshadow::Stream<gpu> *s, const DType *in, const DType *len,
+                         DType *out, int T, int N, int K, DType value, bool add) {
+  using namespace mshadow::cuda;
+  const size_t size = static_cast<size_t>(T) * N * K;
+  const int blocks = static_cast<int>(std::min<size_t>((size + kBaseThreadNum - 1) /
+                                                       kBaseThreadNum, kMaxGridNum));
+  SequenceMaskKernel<DType><<<std::max(blocks, 1), kBaseThreadNum, 0,
+                              mshadow::Stream<gpu>::GetStream(s)>>>(
+      in, len, out, T, N, K, value, add);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+
+/*!
+ * \brief the padded steps of the output, and of the gradient of the input, are
+ *  set without reading the input. Without use_sequence_length it is the identity.
+ */
+template<typename xpu, typename DType>
+class SequenceMaskOp : public Operator {
+ public:
+  explicit SequenceMaskOp(SequenceMaskParam param) : param_(param) {}
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    if (req[seq_mask::kOut] == kNullOp) return;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 3, DType> data = this->Get3D(in_data[seq_mask::kData], s);
+    Tensor<xpu, 3, DType> out = this->Get3D(out_data[seq_mask::kOut], s);
+    if (!param_.use_sequence_length) {
+      if (req[seq_mask::kOut] == kAddTo || data.dptr_ != out.dptr_) {
+        Assign(out, req[seq_mask::kOut], F<mshadow_op::identity>(data));
+      }
+      return;
+    }
+    SequenceMask(s, data.dptr_, in_data[seq_mask::kSequenceLength].dptr<DType>(), out.dptr_,
+                 data.size(0), data.size(1), data.size(2), DType(param_.value),
+                 req[seq_mask::kOut] == kAddTo);
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    if (req[seq_mask::kData] == kNullOp) return;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 3, DType> grad = this->Get3D(out_grad[seq_mask::kOut], s);
+    Tensor<xpu, 3, DType> dx = this->Get3D(in_grad[seq_mask::kData], s);
+    if (!param_.use_sequence_length) {
+      if (req[seq_mask::kData] == kAddTo || grad.dptr_ != dx.dptr_) {
+        Assign(dx, req[seq_mask::kData], F<mshadow_op::identity>(grad));
+      }
+      return;
+    }
+    SequenceMask(s, grad.dptr_, in_data[seq_mask::kSequenceLength].dptr<DType>(), dx.dptr_,
+                 grad.size(0), grad.size(1), grad.size(2), DType(0),
+                 req[seq_mask::kData] == kAddTo);
+  }
+
+ private:
+  // view of (seq_length, batch_size, rest)
+  inline mshadow::Tensor<xpu, 3, DType> Get3D(const TBlob &blob, mshadow::Stream<xpu> *s) {
+    const TShape &shape = blob.shape_;
+    return blob.get_with_shape<xpu, 3, DType>(
+        mshadow::Shape3(shape[0], shape[1], shape.Size() / shape[0] / shape[1]), s);
+  }
+
+  SequenceMaskParam param_;
+};  // class SequenceMaskOp
+
+template<typename xpu>
+Operator *CreateOp(SequenceMaskParam param, int dtype);
+
+#if DMLC_USE_CXX11
+class SequenceMaskProp : public OperatorProperty {
+ public:
+  std::vector<std::string> ListArguments() const override {
+    if (param_.use_sequence_length) return {"data", "sequence_length"};
+    return {"data"};
+  }
+
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    CHECK_EQ(in_shape->size(), this->ListArguments().size());
+    const TShape &dshape = (*in_shape)[seq_mask::kData];
+    if (dshape.ndim() == 0) return false;
+    CHECK_GE(dshape.ndim(), 2) << "data must be of shape (seq_length, batch_size, ...)";
+    if (param_.use_sequence_length) {
+      SHAPE_ASSIGN_CHECK(*in_shape, seq_mask::kSequenceLength, mshadow::Shape1(dshape[1]));
+    }
+    out_shape->clear();
+    out_shape->push_back(dshape);
+    return true;
+  }
+
+  bool InferType(std::vector<int> *in_type,
+                 std::vector<int> *out_type,
+                 std::vector<int> *aux_type) const override {
+    CHECK_GE(in_type->size(), 1);
+    int dtype = (*in_type)[0];
+    CHECK_NE(dtype, -1) << "First input must have specified type";
+    for (index_t i = 0; i < in_type->size(); ++i) {
+      if ((*in_type)[i] == -1) {
+        (*in_type)[i] = dtype;
+      } else {
+        CHECK_EQ((*in_type)[i], dtype) << "This layer requires uniform type. "
+                                       << "Expected " << dtype << " v.s. given "
+                                       << (*in_type)[i] << " at " << ListArguments()[i];
+      }
+    }
+    out_type->clear();
+    out_type->push_back(dtype);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new SequenceMaskProp();
+    ptr->param_ = param_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "SequenceMask";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    if (param_.use_sequence_length) {
+      return {out_grad[seq_mask::kOut], in_data[seq_mask::kSequenceLength]};
+    }
+    return {out_grad[seq_mask::kOut]};
+  }
+
+  std::vector<std::pair<int, void*> > ForwardInplaceOption(
+    const std::vector<int> &in_data,
+    const std::vector<void*> &out_data) const override {
+    return {{in_data[seq_mask::kData], out_data[seq_mask::kOut]}};
+  }
+
+  std::vector<std::pair<int, void*> > BackwardInplaceOption(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data,
+    const std::vector<void*> &in_grad) const override {
+    return {{out_grad[seq_mask::kOut], in_grad[seq_mask::kData]}};
+  }
+
+  Operator* CreateOperator(Context ctx) const override {
+    LOG(FATAL) << "Not Implemented";
+    return NULL;
+  }
+
+  Operator* CreateOperatorEx(Context ctx, std::vector<TShape> *in_shape,
+                             std::vector<int> *in_type) const override;
+
+ private:
+  SequenceMaskParam param_;
+};  // class SequenceMaskProp
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_SEQUENCE_MASK_INL_H_
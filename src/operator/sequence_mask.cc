@@ -0,0 +1,37 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file sequence_mask.cc
+ * \brief mask of the padded steps of sequences
+*/
+#include "./sequence_mask-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<cpu>(SequenceMaskParam param, int dtype) {
+  Operator *op = NULL;
+  MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
+    op = new SequenceMaskOp<cpu, DType>(param);
+  });
+  return op;
+}
+
+Operator *SequenceMaskProp::CreateOperatorEx(Context ctx, std::vector<TShape> *in_shape,
+                                             std::vector<int> *in_type) const {
+  std::vector<TShape> out_shape, aux_shape;
+  std::vector<int> out_type, aux_type;
+  CHECK(InferType(in_type, &out_type, &aux_type));
+  CHECK(InferShape(in_shape, &out_shape, &aux_shape));
+  DO_BIND_DISPATCH(CreateOp, param_, (*in_type)[0]);
+}
+
+DMLC_REGISTER_PARAMETER(SequenceMaskParam);
+
+MXNET_REGISTER_OP_PROPERTY(SequenceMask, SequenceMaskProp)
+.describe("Set the steps after the end of each sequence of a padded batch to value, "
+          "and their gradient to 0.")
+.add_argument("data", "Symbol", "Input data of shape (seq_length, batch_size, ...).")
+.add_argument("sequence_length", "Symbol", "The length of each sequence, of shape "
+              "(batch_size,), used with use_sequence_length.")
+.add_arguments(SequenceMaskParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,18 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file sequence_mask.cu
+ * \brief mask of the padded steps of sequences
+*/
+#include "./sequence_mask-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator *CreateOp<gpu>(SequenceMaskParam param, int dtype) {
+  Operator *op = NULL;
+  MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
+    op = new SequenceMaskOp<gpu, DType>(param);
+  });
+  return op;
+}
+}  // namespace op
+}  // namespace mxnet
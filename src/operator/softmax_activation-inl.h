@@ -10,12 +10,15 @@
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
 #include <mxnet/operator.h>
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <map>
 #include <string>
 #include <vector>
 #include <utility>
 #include "./operator_common.h"
+#include "./mshadow_op_simd.h"
 
 namespace mxnet {
 namespace op {
@@ -26,6 +29,172 @@ enum SoftmaxActivationOpInputs {kData};
 enum SoftmaxActivationOpOutputs {kOut};
 enum SoftmaxActivationOpType {kInstance, kChannel};
 enum SoftmaxActivationOpResource {kTempSpace};
+
+/*! \brief number of positions of a tile of the channel softmax on cpu */
+const int kTile = 512;
+
+/*!
+ * \brief channel softmax of data (num, channel, size) over the channels, out may be data.
+ *  The positions are taken in tiles, whose max, exp and sum are vectorized over the
+ *  contiguous positions of each channel, with OpenMP over the tiles of all the instances.
+ */
+inline void ChannelSoftmax(mshadow::Stream<cpu> *s, int num, int channel, int size,
+                           const float *data, float *out) {
+  const int ntile = (size + kTile - 1) / kTile;
+  #pragma omp parallel for schedule(static)
+  for (int t = 0; t < num * ntile; ++t) {
+    const int p0 = (t % ntile) * kTile, n = std::min(kTile, size - p0);
+    const size_t offset = static_cast<size_t>(t / ntile) * channel * size + p0;
+    const float *x = data + offset;
+    float *y = out + offset;
+    float mx[kTile], sum[kTile];
+    std::copy(x, x + n, mx);
+    for (int c = 1; c < channel; ++c) {
+      const float *xc = x + static_cast<size_t>(c) * size;
+      for (int p = 0; p < n; ++p) mx[p] = std::max(mx[p], xc[p]);
+    }
+    std::fill(sum, sum + n, 0.0f);
+    for (int c = 0; c < channel; ++c) {
+      const float *xc = x + static_cast<size_t>(c) * size;
+      float *yc = y + static_cast<size_t>(c) * size;
+      for (int p = 0; p < n; ++p) yc[p] = xc[p] - mx[p];
+      if (!mshadow_op::simd::Map<mshadow_op::exp>(yc, yc, n)) {
+        for (int p = 0; p < n; ++p) yc[p] = std::exp(yc[p]);
+      }
+      for (int p = 0; p < n; ++p) sum[p] += yc[p];
+    }
+    for (int p = 0; p < n; ++p) sum[p] = 1.0f / sum[p];
+    for (int c = 0; c < channel; ++c) {
+      float *yc = y + static_cast<size_t>(c) * size;
+      for (int p = 0; p < n; ++p) yc[p] *= sum[p];
+    }
+  }
+}
+
+/*! \brief grad = req(grad, out * (out_grad - sum over the channels of out_grad * out)) */
+inline void ChannelSoftmaxGrad(mshadow::Stream<cpu> *s, int num, int channel, int size,
+                               const float *out, const float *out_grad, float *grad,
+                               bool addto) {
+  const int ntile = (size + kTile - 1) / kTile;
+  #pragma omp parallel for schedule(static)
+  for (int t = 0; t < num * ntile; ++t) {
+    const int p0 = (t % ntile) * kTile, n = std::min(kTile, size - p0);
+    const size_t offset = static_cast<size_t>(t / ntile) * channel * size + p0;
+    float dot[kTile];
+    std::fill(dot, dot + n, 0.0f);
+    for (int c = 0; c < channel; ++c) {
+      const size_t e = offset + static_cast<size_t>(c) * size;
+      for (int p = 0; p < n; ++p) dot[p] += out[e + p] * out_grad[e + p];
+    }
+    for (int c = 0; c < channel; ++c) {
+      const size_t e = offset + static_cast<size_t>(c) * size;
+      for (int p = 0; p < n; ++p) {
+        const float g = out[e + p] * (out_grad[e + p] - dot[p]);
+        grad[e + p] = addto ? grad[e + p] + g : g;
+      }
+    }
+  }
+}
+
+#ifdef __CUDACC__
+/*! \brief number of positions of a block, and of threads of a position */
+const int kBlockPos = 32;
+const int kBlockChannel = 8;
+
+/*!
+ * \brief one block per kBlockPos positions of an instance, whose channels are read once
+ *  into shared memory, then one thread per position takes their max and exp sum
+ */
+__global__ void ChannelSoftmaxKernel(int channel, int size, const float *data, float *out) {
+  extern __shared__ float tile[];
+  float *inv = tile + channel * kBlockPos;
+  const int tx = threadIdx.x, ty = threadIdx.y;
+  const int p = blockIdx.x * kBlockPos + tx;
+  const size_t offset = static_cast<size_t>(blockIdx.y) * channel * size + p;
+  for (int c = ty; c < channel; c += kBlockChannel) {
+    tile[c * kBlockPos + tx] = p < size ? data[offset + static_cast<size_t>(c) * size] : 0.0f;
+  }
+  __syncthreads();
+  if (ty == 0) {
+    float mx = tile[tx];
+    for (int c = 1; c < channel; ++c) mx = max(mx, tile[c * kBlockPos + tx]);
+    float sum = 0.0f;
+    for (int c = 0; c < channel; ++c) {
+      const float e = __expf(tile[c * kBlockPos + tx] - mx);
+      tile[c * kBlockPos + tx] = e;
+      sum += e;
+    }
+    inv[tx] = 1.0f / sum;
+  }
+  __syncthreads();
+  if (p >= size) return;
+  for (int c = ty; c < channel; c += kBlockChannel) {
+    out[offset + static_cast<size_t>(c) * size] = tile[c * kBlockPos + tx] * inv[tx];
+  }
+}
+
+__global__ void ChannelSoftmaxGradKernel(int channel, int size, const float *out,
+                                         const float *out_grad, float *grad, bool addto) {
+  __shared__ float part[kBlockChannel][kBlockPos];
+  const int tx = threadIdx.x, ty = threadIdx.y;
+  const int p = blockIdx.x * kBlockPos + tx;
+  const size_t offset = static_cast<size_t>(blockIdx.y) * channel * size + p;
+  float dot = 0.0f;
+  if (p < size) {
+    for (int c = ty; c < channel; c += kBlockChannel) {
+      const size_t e = offset + static_cast<size_t>(c) * size;
+      dot += out[e] * out_grad[e];
+    }
+  }
+  part[ty][tx] = dot;
+  __syncthreads();
+  if (p >= size) return;
+  dot = 0.0f;
+  for (int k = 0; k < kBlockChannel; ++k) dot += part[k][tx];
+  for (int c = ty; c < channel; c += kBlockChannel) {
+    const size_t e = offset + static_cast<size_t>(c) * size;
+    const float g = out[e] * (out_grad[e] - dot);
+    grad[e] = addto ? grad[e] + g : g;
+  }
+}
+
+/*! \brief the channels of a block must fit in the 48KB of shared memory */
+inline bool ChannelSoftmaxFits(int channel) {
+  return (channel + 1) * kBlockPos * sizeof(float) <= 48 * 1024;
+}
+
+inline void ChannelSoftmax(mshadow::Stream<gpu> *s, int num, int channel, int size,
+                           const float *data, float *out) {
+  dim3 grid((size + kBlockPos - 1) / kBlockPos, num);
+  dim3 block(kBlockPos, kBlockChannel);
+  ChannelSoftmaxKernel<<<grid, block, (channel + 1) * kBlockPos * sizeof(float),
+                         mshadow::Stream<gpu>::GetStream(s)>>>(channel, size, data, out);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+inline void ChannelSoftmaxGrad(mshadow::Stream<gpu> *s, int num, int channel, int size,
+                               const float *out, const float *out_grad, float *grad,
+                               bool addto) {
+  dim3 grid((size + kBlockPos - 1) / kBlockPos, num);
+  dim3 block(kBlockPos, kBlockChannel);
+  ChannelSoftmaxGradKernel<<<grid, block, 0, mshadow::Stream<gpu>::GetStream(s)>>>(
+      channel, size, out, out_grad, grad, addto);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+
+/*! \brief whether the channel softmax of the given channels has a kernel on the device */
+inline bool ChannelSoftmaxFits(mshadow::Stream<cpu> *s, int channel) {
+  return true;
+}
+
+#ifdef __CUDACC__
+inline bool ChannelSoftmaxFits(mshadow::Stream<gpu> *s, int channel) {
+  return ChannelSoftmaxFits(channel);
+}
+#endif  // __CUDACC__
 }  // softmax_activation
 
 struct SoftmaxActivationParam : public dmlc::Parameter<SoftmaxActivationParam> {
@@ -74,6 +243,12 @@ class SoftmaxActivationOp : public Operator {
       TShape src_shape = in_data[softmax_activation::kData].shape_;
       Shape<3> dst_shape = Shape3(src_shape[0], src_shape[1],
                                   src_shape[2] * src_shape[3]);
+      if (softmax_activation::ChannelSoftmaxFits(s, dst_shape[1])) {
+        softmax_activation::ChannelSoftmax(s, dst_shape[0], dst_shape[1], dst_shape[2],
+                                           in_data[softmax_activation::kData].dptr<real_t>(),
+                                           out_data[softmax_activation::kOut].dptr<real_t>());
+        return;
+      }
       Tensor<xpu, 3> data =
         in_data[softmax_activation::kData].get_with_shape<xpu, 3, real_t>(dst_shape, s);
       Tensor<xpu, 3> out =
@@ -108,6 +283,15 @@ class SoftmaxActivationOp : public Operator {
       out_data[softmax_activation::kOut].get_with_shape<xpu, 3, real_t>(data_shape, s);
     Tensor<xpu, 3> m_in_grad =
       in_grad[softmax_activation::kData].get_with_shape<xpu, 3, real_t>(data_shape, s);
+    if (param_.mode == softmax_activation::kChannel &&
+        softmax_activation::ChannelSoftmaxFits(s, channel_num)) {
+      if (req[softmax_activation::kData] == kNullOp) return;
+      softmax_activation::ChannelSoftmaxGrad(s, batch_size, channel_num, rest_size,
+                                             m_out_data.dptr_, m_out_grad.dptr_,
+                                             m_in_grad.dptr_,
+                                             req[softmax_activation::kData] == kAddTo);
+      return;
+    }
     // get requested temp space
     Tensor<xpu, 2> workspace = ctx.requested[softmax_activation::kTempSpace].get_space<xpu>(
         Shape2(batch_size, rest_size), s);
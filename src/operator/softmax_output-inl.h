@@ -10,19 +10,23 @@
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
 #include <mxnet/operator.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 #include <cstring>
 #include <map>
 #include <string>
 #include <vector>
 #include <utility>
 #include "./operator_common.h"
+#include "./mshadow_op.h"
 
 namespace mxnet {
 namespace op {
 
 namespace softmaxout_enum {
 enum SoftmaxOutputOpInputs {kData, kLabel};
-enum SoftmaxOutputOpOutputs {kOut};
+enum SoftmaxOutputOpOutputs {kOut, kLoss};
 enum SoftmaxOutputNormType {kNull, kBatch, kValid};
 enum SoftmaxOutputOpResource {kTempSpace};
 }  // namespace softmaxout_enum
@@ -33,6 +37,8 @@ struct SoftmaxOutputParam : public dmlc::Parameter<SoftmaxOutputParam> {
   bool multi_output;
   bool use_ignore;
   int normalization;
+  bool fused_loss;
+  float smooth_alpha;
   DMLC_DECLARE_PARAMETER(SoftmaxOutputParam) {
     DMLC_DECLARE_FIELD(grad_scale).set_default(1.0f)
     .describe("Scale the gradient by a float factor");
@@ -54,9 +60,156 @@ struct SoftmaxOutputParam : public dmlc::Parameter<SoftmaxOutputParam> {
     .describe("If set to null, op will do nothing on output gradient."
               "If set to batch, op will normalize gradient by divide batch size"
               "If set to valid, op will normalize gradient by divide sample not ignored");
+    DMLC_DECLARE_FIELD(fused_loss).set_default(false)
+    .describe("If set to true, the softmax, the cross entropy loss and its gradient are "
+              "computed in one pass of the forward with an online log-sum-exp. When training, "
+              "output holds the gradient instead of the probabilities, and a second output "
+              "holds the loss of each sample. Label must be class indices, without "
+              "multi_output.");
+    DMLC_DECLARE_FIELD(smooth_alpha).set_default(0.0f).set_range(0.0f, 1.0f)
+    .describe("Label smoothing of the fused loss: the target of the label class is "
+              "1 - smooth_alpha + smooth_alpha / k, and of the other classes smooth_alpha / k.");
   };
 };
 
+/*! \brief arguments of the fused softmax cross entropy, passed by value to the kernels */
+struct SoftmaxCEArgs {
+  /*! \brief whether to write the gradient, or the probabilities */
+  bool grad;
+  bool use_ignore;
+  int ignore_label;
+  /*! \brief scale of the gradient */
+  float scale;
+  float smooth_alpha;
+};
+
+/*! \brief merge the log-sum-exp states (m, s) and (m2, s2), s is the sum of exp(x - m) */
+MSHADOW_XINLINE void SoftmaxCEMerge(float *m, float *s, float m2, float s2) {
+  const float mx = *m > m2 ? *m : m2;
+  *s = *s * expf(*m - mx) + s2 * expf(m2 - mx);
+  *m = mx;
+}
+
+/*! \brief the output and the loss of a row x of k, given its log-sum-exp and the sum of x */
+template<typename DType>
+MSHADOW_XINLINE DType SoftmaxCELoss(const DType *x, int k, int y, float lse, float sum_x,
+                                    const SoftmaxCEArgs &args) {
+  const float a = args.smooth_alpha;
+  return DType(lse - (1.0f - a) * static_cast<float>(x[y]) - a / k * sum_x);
+}
+
+/*!
+ * \brief out = softmax(data) or its cross entropy gradient, and the loss of each row,
+ *  in a read pass for the log-sum-exp and a read and write pass for the output,
+ *  parallel over the rows. out may be data.
+ */
+template<typename DType>
+inline void SoftmaxCrossEntropy(mshadow::Stream<cpu> *s, const DType *data, const DType *label,
+                                DType *out, DType *loss, int n, int k, SoftmaxCEArgs args) {
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; ++i) {
+    const DType *x = data + static_cast<size_t>(i) * k;
+    DType *o = out + static_cast<size_t>(i) * k;
+    const int y = static_cast<int>(label[i]);
+    if (args.grad && args.use_ignore && y == args.ignore_label) {
+      std::fill(o, o + k, DType(0));
+      loss[i] = DType(0);
+      continue;
+    }
+    float m = -FLT_MAX, sum = 0.0f, sum_x = 0.0f;
+    for (int j = 0; j < k; ++j) {
+      const float v = static_cast<float>(x[j]);
+      if (v > m) {
+        sum = sum * expf(m - v) + 1.0f;
+        m = v;
+      } else {
+        sum += expf(v - m);
+      }
+      sum_x += v;
+    }
+    const float lse = m + logf(sum);
+    loss[i] = (y >= 0 && y < k) ? SoftmaxCELoss(x, k, y, lse, sum_x, args) : DType(0);
+    if (args.grad) {
+      const float off = args.smooth_alpha / k;
+      for (int j = 0; j < k; ++j) {
+        const float t = (j == y ? 1.0f - args.smooth_alpha : 0.0f) + off;
+        o[j] = DType((expf(static_cast<float>(x[j]) - lse) - t) * args.scale);
+      }
+    } else {
+      for (int j = 0; j < k; ++j) o[j] = DType(expf(static_cast<float>(x[j]) - lse));
+    }
+  }
+}
+
+#ifdef __CUDACC__
+/*! \brief one block per row, the threads of a block merge their log-sum-exp states */
+template<typename DType>
+__global__ void SoftmaxCrossEntropyKernel(const DType *data, const DType *label,
+                                          DType *out, DType *loss, int n, int k,
+                                          SoftmaxCEArgs args) {
+  __shared__ float sm[mshadow::cuda::kBaseThreadNum];
+  __shared__ float ss[mshadow::cuda::kBaseThreadNum];
+  __shared__ float sx[mshadow::cuda::kBaseThreadNum];
+  for (int i = blockIdx.x; i < n; i += gridDim.x) {
+    const DType *x = data + static_cast<size_t>(i) * k;
+    DType *o = out + static_cast<size_t>(i) * k;
+    const int y = static_cast<int>(label[i]);
+    if (args.grad && args.use_ignore && y == args.ignore_label) {
+      for (int j = threadIdx.x; j < k; j += blockDim.x) o[j] = DType(0);
+      if (threadIdx.x == 0) loss[i] = DType(0);
+      continue;
+    }
+    float m = -FLT_MAX, sum = 0.0f, sum_x = 0.0f;
+    for (int j = threadIdx.x; j < k; j += blockDim.x) {
+      const float v = static_cast<float>(x[j]);
+      SoftmaxCEMerge(&m, &sum, v, 1.0f);
+      sum_x += v;
+    }
+    sm[threadIdx.x] = m;
+    ss[threadIdx.x] = sum;
+    sx[threadIdx.x] = sum_x;
+    __syncthreads();
+    for (int offset = blockDim.x / 2; offset > 0; offset >>= 1) {
+      if (threadIdx.x < offset) {
+        SoftmaxCEMerge(&sm[threadIdx.x], &ss[threadIdx.x],
+                       sm[threadIdx.x + offset], ss[threadIdx.x + offset]);
+        sx[threadIdx.x] += sx[threadIdx.x + offset];
+      }
+      __syncthreads();
+    }
+    const float lse = sm[0] + logf(ss[0]);
+    if (threadIdx.x == 0) {
+      loss[i] = (y >= 0 && y < k) ? SoftmaxCELoss(x, k, y, lse, sx[0], args) : DType(0);
+    }
+    // x[y] is read before the row is overwritten when inplace
+    __syncthreads();
+    if (args.grad) {
+      const float off = args.smooth_alpha / k;
+      for (int j = threadIdx.x; j < k; j += blockDim.x) {
+        const float t = (j == y ? 1.0f - args.smooth_alpha : 0.0f) + off;
+        o[j] = DType((expf(static_cast<float>(x[j]) - lse) - t) * args.scale);
+      }
+    } else {
+      for (int j = threadIdx.x; j < k; j += blockDim.x) {
+        o[j] = DType(expf(static_cast<float>(x[j]) - lse));
+      }
+    }
+    __syncthreads();
+  }
+}
+
+template<typename DType>
+inline void SoftmaxCrossEntropy(mshadow::Stream<gpu> *s, const DType *data, const DType *label,
+                                DType *out, DType *loss, int n, int k, SoftmaxCEArgs args) {
+  using namespace mshadow::cuda;
+  SoftmaxCrossEntropyKernel<DType><<<std::max(1, std::min(n, kMaxGridNum)), kBaseThreadNum, 0,
+                                     mshadow::Stream<gpu>::GetStream(s)>>>(
+      data, label, out, loss, n, k, args);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+
 template<typename xpu, typename DType>
 class SoftmaxOutputOp : public Operator {
  public:
@@ -70,8 +223,13 @@ class SoftmaxOutputOp : public Operator {
     using namespace mshadow;
     using namespace mshadow::expr;
     CHECK_EQ(in_data.size(), 2) << "SoftmaxOutput Input: [data, label]";
-    CHECK_EQ(out_data.size(), 1) << "SoftmaxOutput Output: [output]";
     Stream<xpu> *s = ctx.get_stream<xpu>();
+    if (param_.fused_loss) {
+      CHECK_EQ(out_data.size(), 2) << "SoftmaxOutput Output: [output, loss]";
+      this->FusedForward(ctx, in_data, out_data);
+      return;
+    }
+    CHECK_EQ(out_data.size(), 1) << "SoftmaxOutput Output: [output]";
     if (param_.multi_output) {
       int n = in_data[softmaxout_enum::kData].size(0);
       int k = in_data[softmaxout_enum::kData].size(1);
@@ -108,7 +266,14 @@ class SoftmaxOutputOp : public Operator {
     CHECK_GE(req.size(), 1);
     Stream<xpu> *s = ctx.get_stream<xpu>();
 
-    if (out_data[softmaxout_enum::kOut].shape_ ==
+    if (param_.fused_loss) {
+      // the forward already wrote the gradient, to in_grad when inplace
+      Tensor<xpu, 2, DType> out = out_data[softmaxout_enum::kOut].FlatTo2D<xpu, DType>(s);
+      Tensor<xpu, 2, DType> grad = in_grad[softmaxout_enum::kData].FlatTo2D<xpu, DType>(s);
+      if (grad.dptr_ != out.dptr_) {
+        Assign(grad, req[softmaxout_enum::kData], F<mshadow_op::identity>(out));
+      }
+    } else if (out_data[softmaxout_enum::kOut].shape_ ==
         in_data[softmaxout_enum::kLabel].shape_) {
       // use probability as label
       Tensor<xpu, 2, DType> label = in_data[softmaxout_enum::kLabel].FlatTo2D<xpu, DType>(s);
@@ -192,6 +357,42 @@ class SoftmaxOutputOp : public Operator {
   }
 
  private:
+  inline void FusedForward(const OpContext &ctx,
+                           const std::vector<TBlob> &in_data,
+                           const std::vector<TBlob> &out_data) {
+    using namespace mshadow;
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 2, DType> data = in_data[softmaxout_enum::kData].FlatTo2D<xpu, DType>(s);
+    Tensor<xpu, 1, DType> label = in_data[softmaxout_enum::kLabel].get_with_shape<xpu, 1, DType>(
+        Shape1(in_data[softmaxout_enum::kLabel].Size()), s);
+    Tensor<xpu, 2, DType> out = out_data[softmaxout_enum::kOut].FlatTo2D<xpu, DType>(s);
+    Tensor<xpu, 1, DType> loss = out_data[softmaxout_enum::kLoss].get<xpu, 1, DType>(s);
+    SoftmaxCEArgs args;
+    args.grad = ctx.is_train;
+    args.use_ignore = param_.use_ignore;
+    args.ignore_label = static_cast<int>(param_.ignore_label);
+    args.smooth_alpha = param_.smooth_alpha;
+    index_t valid_cnt = 1;
+    if (param_.normalization == softmaxout_enum::kBatch) {
+      valid_cnt = label.size(0);
+    } else if (param_.normalization == softmaxout_enum::kValid && ctx.is_train) {
+      Tensor<cpu, 1, DType> workspace =
+        ctx.requested[softmaxout_enum::kTempSpace].get_host_space_typed<1, DType>(
+        label.shape_);
+      Copy(workspace, label, label.stream_);
+      valid_cnt = label.size(0);
+      for (index_t i = 0; i < label.size(0); ++i) {
+        if (static_cast<int>(workspace[i]) == args.ignore_label) {
+          valid_cnt--;
+        }
+      }
+      valid_cnt = valid_cnt == 0 ? 1 : valid_cnt;
+    }
+    args.scale = param_.grad_scale / valid_cnt;
+    SoftmaxCrossEntropy(s, data.dptr_, label.dptr_, out.dptr_, loss.dptr_,
+                        static_cast<int>(data.size(0)), static_cast<int>(data.size(1)), args);
+  }
+
   SoftmaxOutputParam param_;
 };  // class SoftmaxOutputOp
 
@@ -214,6 +415,14 @@ class SoftmaxOutputProp : public OperatorProperty {
     return param_.__DICT__();
   }
 
+  std::vector<std::string> ListOutputs() const override {
+    if (param_.fused_loss) {
+      return {"output", "loss"};
+    } else {
+      return {"output"};
+    }
+  }
+
   bool InferShape(std::vector<TShape> *in_shape,
                   std::vector<TShape> *out_shape,
                   std::vector<TShape> *aux_shape) const override {
@@ -221,6 +430,17 @@ class SoftmaxOutputProp : public OperatorProperty {
     CHECK_EQ(in_shape->size(), 2) << "Input:[data, label]";
     const TShape &dshape = in_shape->at(0);
     if (dshape.ndim() == 0) return false;
+    if (param_.fused_loss) {
+      CHECK(!param_.multi_output) << "fused_loss does not support multi_output";
+      TShape label_shape(dshape.ndim() - 1);
+      for (index_t i = 0; i + 1 < dshape.ndim(); ++i)
+        label_shape[i] = dshape[i];
+      SHAPE_ASSIGN_CHECK(*in_shape, softmaxout_enum::kLabel, label_shape);
+      out_shape->clear();
+      out_shape->push_back(dshape);
+      out_shape->push_back(Shape1(label_shape.Size()));
+      return true;
+    }
 
     // label.shape == data.shape: use probability as label
     if (dshape != (*in_shape)[softmaxout_enum::kLabel]) {
@@ -272,6 +492,7 @@ class SoftmaxOutputProp : public OperatorProperty {
     }
     out_type->clear();
     out_type->push_back(dtype);
+    if (param_.fused_loss) out_type->push_back(dtype);
     return true;
   }
 
@@ -289,6 +510,7 @@ class SoftmaxOutputProp : public OperatorProperty {
     const std::vector<int> &out_grad,
     const std::vector<int> &in_data,
     const std::vector<int> &out_data) const override {
+    if (param_.fused_loss) return {out_data[softmaxout_enum::kOut]};
     return {in_data[softmaxout_enum::kLabel], out_data[softmaxout_enum::kOut]};
   }
 
@@ -306,6 +528,12 @@ class SoftmaxOutputProp : public OperatorProperty {
     return {{in_data[softmaxout_enum::kData], out_data[softmaxout_enum::kOut]}};
   }
 
+  std::vector<ResourceRequest> ForwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    if (param_.fused_loss) return {ResourceRequest::kTempSpace};
+    return std::vector<ResourceRequest>();
+  }
+
   std::vector<ResourceRequest> BackwardResource(
       const std::vector<TShape> &in_shape) const override {
     return {ResourceRequest::kTempSpace};
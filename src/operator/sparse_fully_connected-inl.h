@@ -0,0 +1,403 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file sparse_fully_connected-inl.h
+ * \brief fully connected layer of a sparse input in compressed sparse row format.
+ *
+ *  The input is a (batch_size, input_dim) matrix given by three arrays, as a batch of
+ *  LibSVMIter: the values and the column indices of its non-zeros, row by row, and the
+ *  row pointers, the non-zeros of row r are [indptr[r], indptr[r + 1]). The value and
+ *  index arrays may be longer than indptr[batch_size], the tail is ignored.
+ *  The weight is (input_dim, num_hidden) as the weight of Embedding, so that a non-zero
+ *  reads and its gradient writes one contiguous row. Forward and backward take
+ *  O(nnz * num_hidden), the dense input of FullyConnected is never formed.
+ */
+#ifndef MXNET_OPERATOR_SPARSE_FULLY_CONNECTED_INL_H_
+#define MXNET_OPERATOR_SPARSE_FULLY_CONNECTED_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./operator_common.h"
+#include "./row_sparse-inl.h"
+
+namespace mxnet {
+namespace op {
+
+namespace csrfc {
+enum SparseFullyConnectedOpInputs {kData, kIndices, kIndptr, kWeight, kBias};
+enum SparseFullyConnectedOpOutputs {kOut};
+/*! \brief number of hidden units of a block of the weight gradient on cpu */
+const int kHiddenBlock = 64;
+
+/*!
+ * \brief out = x * w, x is the csr matrix (val, idx, ptr) of batch rows whose arrays
+ *  val and idx have nnz elements
+ */
+inline void SpMM(mshadow::Stream<cpu> *s, const real_t *val, const real_t *idx,
+                 const real_t *ptr, const real_t *w, int batch, int nhidden,
+                 index_t nnz, index_t input_dim, real_t *out) {
+  CHECK_LE(static_cast<index_t>(ptr[batch]), nnz)
+      << "SparseFullyConnected: indptr points past the end of the non-zeros";
+  for (index_t j = 0; j < static_cast<index_t>(ptr[batch]); ++j) {
+    CHECK_LT(static_cast<index_t>(idx[j]), input_dim)
+        << "SparseFullyConnected: column index out of range";
+  }
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < batch; ++r) {
+    real_t *y = out + static_cast<index_t>(r) * nhidden;
+    std::fill(y, y + nhidden, 0.0f);
+    const index_t end = static_cast<index_t>(ptr[r + 1]);
+    for (index_t j = static_cast<index_t>(ptr[r]); j < end; ++j) {
+      const real_t v = val[j];
+      const real_t *row = w + static_cast<index_t>(idx[j]) * nhidden;
+      for (int h = 0; h < nhidden; ++h) y[h] += v * row[h];
+    }
+  }
+}
+
+/*! \brief gval[j] = <grad[row of j], w[idx[j]]>, the gradient of the values */
+inline void SpMMGradData(mshadow::Stream<cpu> *s, const real_t *grad, const real_t *idx,
+                         const real_t *ptr, const real_t *w, int batch, int nhidden,
+                         index_t nnz, OpReqType req, real_t *gval) {
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < batch; ++r) {
+    const real_t *g = grad + static_cast<index_t>(r) * nhidden;
+    const index_t end = static_cast<index_t>(ptr[r + 1]);
+    for (index_t j = static_cast<index_t>(ptr[r]); j < end; ++j) {
+      const real_t *row = w + static_cast<index_t>(idx[j]) * nhidden;
+      real_t sum = 0.0f;
+      for (int h = 0; h < nhidden; ++h) sum += g[h] * row[h];
+      gval[j] = req == kAddTo ? gval[j] + sum : sum;
+    }
+  }
+}
+
+/*!
+ * \brief gw[idx[j]] += val[j] * grad[row of j]. The rows of gw are split in blocks of
+ *  hidden units, so that the threads never write the same element.
+ */
+inline void SpMMGradWeight(mshadow::Stream<cpu> *s, const real_t *grad, const real_t *val,
+                           const real_t *idx, const real_t *ptr, int batch, int nhidden,
+                           index_t nnz, real_t *gw) {
+  const int nblock = (nhidden + kHiddenBlock - 1) / kHiddenBlock;
+  #pragma omp parallel for schedule(static)
+  for (int b = 0; b < nblock; ++b) {
+    const int h0 = b * kHiddenBlock, h1 = std::min(h0 + kHiddenBlock, nhidden);
+    for (int r = 0; r < batch; ++r) {
+      const real_t *g = grad + static_cast<index_t>(r) * nhidden;
+      const index_t end = static_cast<index_t>(ptr[r + 1]);
+      for (index_t j = static_cast<index_t>(ptr[r]); j < end; ++j) {
+        real_t *row = gw + static_cast<index_t>(idx[j]) * nhidden;
+        const real_t v = val[j];
+        for (int h = h0; h < h1; ++h) row[h] += v * g[h];
+      }
+    }
+  }
+}
+
+#ifdef __CUDACC__
+/*! \brief the row of the non-zero j, the last r with ptr[r] <= j */
+__device__ inline int RowOf(const real_t *ptr, int batch, index_t j) {
+  int lo = 0, hi = batch;
+  while (hi - lo > 1) {
+    const int mid = (lo + hi) / 2;
+    if (static_cast<index_t>(ptr[mid]) <= j) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+__global__ void SpMMKernel(const real_t *val, const real_t *idx, const real_t *ptr,
+                           const real_t *w, int batch, int nhidden, real_t *out) {
+  const index_t size = static_cast<index_t>(batch) * nhidden;
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    const int r = i / nhidden, h = i % nhidden;
+    const index_t end = static_cast<index_t>(ptr[r + 1]);
+    real_t sum = 0.0f;
+    for (index_t j = static_cast<index_t>(ptr[r]); j < end; ++j) {
+      sum += val[j] * w[static_cast<index_t>(idx[j]) * nhidden + h];
+    }
+    out[i] = sum;
+  }
+}
+
+__global__ void SpMMGradDataKernel(const real_t *grad, const real_t *idx, const real_t *ptr,
+                                   const real_t *w, int batch, int nhidden, bool add,
+                                   real_t *gval) {
+  const index_t nnz = static_cast<index_t>(ptr[batch]);
+  for (index_t j = blockIdx.x * blockDim.x + threadIdx.x; j < nnz;
+       j += blockDim.x * gridDim.x) {
+    const real_t *g = grad + static_cast<index_t>(RowOf(ptr, batch, j)) * nhidden;
+    const real_t *row = w + static_cast<index_t>(idx[j]) * nhidden;
+    real_t sum = 0.0f;
+    for (int h = 0; h < nhidden; ++h) sum += g[h] * row[h];
+    gval[j] = add ? gval[j] + sum : sum;
+  }
+}
+
+/*! \brief one thread per (non-zero, hidden unit) of the non-zeros [0, nnz) */
+__global__ void SpMMGradWeightKernel(const real_t *grad, const real_t *val, const real_t *idx,
+                                     const real_t *ptr, int batch, int nhidden, index_t nnz,
+                                     real_t *gw) {
+  const index_t size = nnz * nhidden;
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    const index_t j = i / nhidden;
+    const int h = i % nhidden;
+    const index_t end = static_cast<index_t>(ptr[batch]);
+    if (j >= end) continue;
+    const int r = RowOf(ptr, batch, j);
+    atomicAdd(gw + static_cast<index_t>(idx[j]) * nhidden + h,
+              val[j] * grad[static_cast<index_t>(r) * nhidden + h]);
+  }
+}
+
+/*! \brief number of blocks of the grid stride loops over size elements */
+inline int NumBlocks(index_t size) {
+  using namespace mshadow::cuda;
+  return static_cast<int>(std::max<index_t>(1, std::min<index_t>(
+      kMaxGridNum, (size + kBaseThreadNum - 1) / kBaseThreadNum)));
+}
+
+/*! \brief the indices are not checked on gpu */
+inline void SpMM(mshadow::Stream<gpu> *s, const real_t *val, const real_t *idx,
+                 const real_t *ptr, const real_t *w, int batch, int nhidden,
+                 index_t nnz, index_t input_dim, real_t *out) {
+  const index_t size = static_cast<index_t>(batch) * nhidden;
+  SpMMKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0,
+               mshadow::Stream<gpu>::GetStream(s)>>>(val, idx, ptr, w, batch, nhidden, out);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+inline void SpMMGradData(mshadow::Stream<gpu> *s, const real_t *grad, const real_t *idx,
+                         const real_t *ptr, const real_t *w, int batch, int nhidden,
+                         index_t nnz, OpReqType req, real_t *gval) {
+  SpMMGradDataKernel<<<NumBlocks(nnz), mshadow::cuda::kBaseThreadNum, 0,
+                       mshadow::Stream<gpu>::GetStream(s)>>>(
+      grad, idx, ptr, w, batch, nhidden, req == kAddTo, gval);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+inline void SpMMGradWeight(mshadow::Stream<gpu> *s, const real_t *grad, const real_t *val,
+                           const real_t *idx, const real_t *ptr, int batch, int nhidden,
+                           index_t nnz, real_t *gw) {
+  const index_t size = nnz * nhidden;
+  SpMMGradWeightKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0,
+                         mshadow::Stream<gpu>::GetStream(s)>>>(
+      grad, val, idx, ptr, batch, nhidden, nnz, gw);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace csrfc
+
+struct SparseFullyConnectedParam : public dmlc::Parameter<SparseFullyConnectedParam> {
+  int num_hidden;
+  int input_dim;
+  bool no_bias;
+  bool sparse_grad;
+  DMLC_DECLARE_PARAMETER(SparseFullyConnectedParam) {
+    DMLC_DECLARE_FIELD(num_hidden).set_lower_bound(1)
+    .describe("Number of hidden nodes of the output.");
+    DMLC_DECLARE_FIELD(input_dim).set_lower_bound(1)
+    .describe("Number of columns of the sparse input.");
+    DMLC_DECLARE_FIELD(no_bias).set_default(false)
+    .describe("Whether to disable bias parameter.");
+    DMLC_DECLARE_FIELD(sparse_grad).set_default(false)
+    .describe("Whether the weight gradient is row sparse: only the rows of the indices "
+              "are written, the other rows are left unspecified. "
+              "The training loop then updates only these rows.");
+  }
+};
+
+template<typename xpu>
+class SparseFullyConnectedOp : public Operator {
+ public:
+  explicit SparseFullyConnectedOp(SparseFullyConnectedParam p) {
+    this->param_ = p;
+  }
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    if (req[csrfc::kOut] == kNullOp) return;
+    CHECK_EQ(req[csrfc::kOut], kWriteTo);
+    size_t expected = param_.no_bias ? 4 : 5;
+    CHECK_EQ(in_data.size(), expected);
+    CHECK_EQ(out_data.size(), 1);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 1> val = in_data[csrfc::kData].FlatTo1D<xpu, real_t>(s);
+    Tensor<xpu, 1> idx = in_data[csrfc::kIndices].FlatTo1D<xpu, real_t>(s);
+    Tensor<xpu, 1> ptr = in_data[csrfc::kIndptr].FlatTo1D<xpu, real_t>(s);
+    Tensor<xpu, 2> wmat = in_data[csrfc::kWeight].get<xpu, 2, real_t>(s);
+    Tensor<xpu, 2> out = out_data[csrfc::kOut].get<xpu, 2, real_t>(s);
+    csrfc::SpMM(s, val.dptr_, idx.dptr_, ptr.dptr_, wmat.dptr_, out.size(0), out.size(1),
+                val.size(0), wmat.size(0), out.dptr_);
+    if (!param_.no_bias) {
+      Tensor<xpu, 1> bias = in_data[csrfc::kBias].get<xpu, 1, real_t>(s);
+      out += repmat(bias, out.size(0));
+    }
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    CHECK_EQ(out_grad.size(), 1);
+    size_t expected = param_.no_bias ? 4 : 5;
+    CHECK(in_data.size() == expected && in_grad.size() == expected);
+    CHECK_EQ(req.size(), expected);
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 1> val = in_data[csrfc::kData].FlatTo1D<xpu, real_t>(s);
+    Tensor<xpu, 1> idx = in_data[csrfc::kIndices].FlatTo1D<xpu, real_t>(s);
+    Tensor<xpu, 1> ptr = in_data[csrfc::kIndptr].FlatTo1D<xpu, real_t>(s);
+    Tensor<xpu, 2> wmat = in_data[csrfc::kWeight].get<xpu, 2, real_t>(s);
+    Tensor<xpu, 2> grad = out_grad[csrfc::kOut].get<xpu, 2, real_t>(s);
+    const int batch = grad.size(0), nhidden = grad.size(1);
+    if (!param_.no_bias) {
+      Tensor<xpu, 1> gbias = in_grad[csrfc::kBias].get<xpu, 1, real_t>(s);
+      Assign(gbias, req[csrfc::kBias], sum_rows(grad));
+    }
+    if (req[csrfc::kWeight] != kNullOp) {
+      Tensor<xpu, 2> gwmat = in_grad[csrfc::kWeight].get<xpu, 2, real_t>(s);
+      if (req[csrfc::kWeight] == kWriteTo && param_.sparse_grad) {
+        // only the rows of the indices are read by the row sparse update
+        rowsparse::FillRows(gwmat, idx, static_cast<const real_t*>(NULL));
+      } else if (req[csrfc::kWeight] == kWriteTo) {
+        gwmat = 0.0f;
+      }
+      csrfc::SpMMGradWeight(s, grad.dptr_, val.dptr_, idx.dptr_, ptr.dptr_, batch, nhidden,
+                            val.size(0), gwmat.dptr_);
+    }
+    if (req[csrfc::kData] != kNullOp) {
+      Tensor<xpu, 1> gval = in_grad[csrfc::kData].FlatTo1D<xpu, real_t>(s);
+      // the tail of the values after the non-zeros is not an input of the output
+      if (req[csrfc::kData] == kWriteTo) gval = 0.0f;
+      csrfc::SpMMGradData(s, grad.dptr_, idx.dptr_, ptr.dptr_, wmat.dptr_, batch, nhidden,
+                          val.size(0), req[csrfc::kData], gval.dptr_);
+    }
+    // the indices and the row pointers are not differentiable
+    for (int i : {csrfc::kIndices, csrfc::kIndptr}) {
+      if (req[i] == kWriteTo) {
+        Tensor<xpu, 1> g = in_grad[i].FlatTo1D<xpu, real_t>(s);
+        g = 0.0f;
+      }
+    }
+  }
+
+ private:
+  SparseFullyConnectedParam param_;
+};  // class SparseFullyConnectedOp
+
+template<typename xpu>
+Operator* CreateOp(SparseFullyConnectedParam param);
+
+#if DMLC_USE_CXX11
+class SparseFullyConnectedProp : public OperatorProperty {
+ public:
+  std::vector<std::string> ListArguments() const override {
+    if (!param_.no_bias) {
+      return {"data", "indices", "indptr", "weight", "bias"};
+    } else {
+      return {"data", "indices", "indptr", "weight"};
+    }
+  }
+
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    using namespace mshadow;
+    if (!param_.no_bias) {
+      CHECK_EQ(in_shape->size(), 5) << "Input:[data, indices, indptr, weight, bias]";
+    } else {
+      CHECK_EQ(in_shape->size(), 4) << "Input:[data, indices, indptr, weight]";
+    }
+    const TShape &dshape = (*in_shape)[csrfc::kData];
+    const TShape &pshape = (*in_shape)[csrfc::kIndptr];
+    SHAPE_ASSIGN_CHECK(*in_shape, csrfc::kWeight, Shape2(param_.input_dim, param_.num_hidden));
+    if (!param_.no_bias) {
+      SHAPE_ASSIGN_CHECK(*in_shape, csrfc::kBias, Shape1(param_.num_hidden));
+    }
+    if (dshape.ndim() == 0) return false;
+    SHAPE_ASSIGN_CHECK(*in_shape, csrfc::kIndices, dshape);
+    if (pshape.ndim() == 0) return false;
+    CHECK_EQ(dshape.ndim(), 1) << "SparseFullyConnected: data should be the 1D non-zeros";
+    CHECK_EQ(pshape.ndim(), 1) << "SparseFullyConnected: indptr should be 1D";
+    CHECK_GE(pshape[0], 1) << "SparseFullyConnected: indptr has batch_size + 1 elements";
+    out_shape->clear();
+    out_shape->push_back(Shape2(pshape[0] - 1, param_.num_hidden));
+    return true;
+  }
+
+  bool InferType(std::vector<int> *in_type,
+                 std::vector<int> *out_type,
+                 std::vector<int> *aux_type) const override {
+    for (index_t i = 0; i < in_type->size(); ++i) {
+      if ((*in_type)[i] == -1) {
+        (*in_type)[i] = mshadow::kFloat32;
+      } else {
+        CHECK_EQ((*in_type)[i], mshadow::kFloat32)
+            << "SparseFullyConnected only supports float32, given " << (*in_type)[i]
+            << " at " << ListArguments()[i];
+      }
+    }
+    out_type->clear();
+    out_type->push_back(mshadow::kFloat32);
+    return true;
+  }
+
+  OperatorProperty* Copy() const override {
+    SparseFullyConnectedProp* fc_sym = new SparseFullyConnectedProp();
+    fc_sym->param_ = this->param_;
+    return fc_sym;
+  }
+
+  std::string TypeString() const override {
+    return "SparseFullyConnected";
+  }
+
+  std::vector<int> DeclareBackwardDependency(
+    const std::vector<int> &out_grad,
+    const std::vector<int> &in_data,
+    const std::vector<int> &out_data) const override {
+    return {out_grad[csrfc::kOut], in_data[csrfc::kData], in_data[csrfc::kIndices],
+            in_data[csrfc::kIndptr], in_data[csrfc::kWeight]};
+  }
+
+  Operator* CreateOperator(Context ctx) const override;
+
+ private:
+  SparseFullyConnectedParam param_;
+};  // class SparseFullyConnectedProp
+#endif  // DMLC_USE_CXX11
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_SPARSE_FULLY_CONNECTED_INL_H_
@@ -0,0 +1,32 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file sparse_fully_connected.cc
+ * \brief fully connected layer of a csr input
+*/
+#include "./sparse_fully_connected-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator* CreateOp<cpu>(SparseFullyConnectedParam param) {
+  return new SparseFullyConnectedOp<cpu>(param);
+}
+
+Operator *SparseFullyConnectedProp::CreateOperator(Context ctx) const {
+  DO_BIND_DISPATCH(CreateOp, param_);
+}
+
+DMLC_REGISTER_PARAMETER(SparseFullyConnectedParam);
+
+MXNET_REGISTER_OP_PROPERTY(SparseFullyConnected, SparseFullyConnectedProp)
+.describe("Apply matrix multiplication to a sparse input in compressed sparse row "
+"format, as the batches of LibSVMIter. The weight is (input_dim, num_hidden), "
+"the time and memory taken by the input scale with its number of non-zeros.")
+.add_argument("data", "Symbol", "The values of the non-zeros of the input, row by row.")
+.add_argument("indices", "Symbol", "The column indices of the non-zeros.")
+.add_argument("indptr", "Symbol", "The row pointers, batch_size + 1 offsets of the rows "
+"in the non-zeros.")
+.add_argument("weight", "Symbol", "Weight matrix.")
+.add_argument("bias", "Symbol", "Bias parameter.")
+.add_arguments(SparseFullyConnectedParam::__FIELDS__());
+}  // namespace op
+}  // namespace mxnet
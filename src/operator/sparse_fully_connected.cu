@@ -0,0 +1,14 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file sparse_fully_connected.cu
+ * \brief fully connected layer of a csr input
+*/
+#include "./sparse_fully_connected-inl.h"
+namespace mxnet {
+namespace op {
+template<>
+Operator* CreateOp<gpu>(SparseFullyConnectedParam param) {
+  return new SparseFullyConnectedOp<gpu>(param);
+}
+}  // namespace op
+}  // namespace mxnet
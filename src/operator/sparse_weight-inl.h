@@ -0,0 +1,129 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file sparse_weight-inl.h
+ * \brief products with pruned weights for cpu inference.
+ *
+ *  A weight whose fraction of non zeros is small enough is kept in CSR, one row for
+ *  each output, and the products only visit its non zeros. The weight is converted
+ *  again when it changes, which is found by its address and a sample of its values.
+ */
+#ifndef MXNET_OPERATOR_SPARSE_WEIGHT_INL_H_
+#define MXNET_OPERATOR_SPARSE_WEIGHT_INL_H_
+
+#include <dmlc/base.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+namespace sparsew {
+/*! \brief number of values of a weight sampled to find its changes */
+const int kSamples = 64;
+
+/*! \brief finds the changes of a weight by its address and a sample of its values */
+class WeightWatcher {
+ public:
+  WeightWatcher() : ptr_(NULL) {}
+  /*! \return whether w changed since the last call, always true on the first one */
+  inline bool Changed(const float *w, size_t size) {
+    const size_t step = std::max<size_t>(size / kSamples, 1);
+    std::vector<float> sample;
+    sample.reserve(kSamples + 1);
+    for (size_t i = 0; i < size; i += step) sample.push_back(w[i]);
+    const bool same = w == ptr_ && sample.size() == sample_.size() &&
+        std::memcmp(dmlc::BeginPtr(sample), dmlc::BeginPtr(sample_),
+                    sample.size() * sizeof(float)) == 0;
+    if (same) return false;
+    ptr_ = w;
+    sample_.swap(sample);
+    return true;
+  }
+
+ private:
+  // address and sampled values of the weight
+  const float *ptr_;
+  std::vector<float> sample_;
+};
+
+/*! \brief a (rows, cols) weight in CSR */
+struct CSRWeight {
+  /*! \brief start of each row in col and val, and the end of the last one */
+  std::vector<int> row_ptr;
+  /*! \brief column of each non zero */
+  std::vector<int> col;
+  /*! \brief value of each non zero */
+  std::vector<float> val;
+  /*!
+   * \brief convert w to CSR if its fraction of non zeros is at most max_density
+   * \return whether it was converted, the CSR is left empty otherwise
+   */
+  inline bool Convert(const float *w, int rows, int cols, float max_density) {
+    const size_t size = static_cast<size_t>(rows) * cols;
+    size_t nnz = 0;
+    for (size_t i = 0; i < size; ++i) nnz += w[i] != 0.0f;
+    row_ptr.clear();
+    col.clear();
+    val.clear();
+    if (size == 0 || nnz > max_density * size) return false;
+    row_ptr.reserve(rows + 1);
+    col.reserve(nnz);
+    val.reserve(nnz);
+    for (int r = 0; r < rows; ++r) {
+      row_ptr.push_back(static_cast<int>(col.size()));
+      const float *src = w + static_cast<size_t>(r) * cols;
+      for (int c = 0; c < cols; ++c) {
+        if (src[c] == 0.0f) continue;
+        col.push_back(c);
+        val.push_back(src[c]);
+      }
+    }
+    row_ptr.push_back(static_cast<int>(col.size()));
+    return true;
+  }
+  /*! \return whether the weight is held */
+  inline bool empty() const {
+    return row_ptr.size() == 0;
+  }
+};
+
+/*!
+ * \brief y = rows [begin, end) of w times x, x is (cols, n), y is (end - begin, n).
+ *  Each non zero adds its row of x to the output row, which stays in cache.
+ */
+inline void MatMul(const CSRWeight &w, int begin, int end, const float *x, int n, float *y) {
+  #pragma omp parallel for schedule(dynamic, 4)
+  for (int r = begin; r < end; ++r) {
+    float *dst = y + static_cast<size_t>(r - begin) * n;
+    std::fill(dst, dst + n, 0.0f);
+    for (int i = w.row_ptr[r]; i < w.row_ptr[r + 1]; ++i) {
+      const float v = w.val[i];
+      const float *src = x + static_cast<size_t>(w.col[i]) * n;
+      for (int j = 0; j < n; ++j) dst[j] += v * src[j];
+    }
+  }
+}
+
+/*!
+ * \brief y = x * w^T + bias, x is (B, cols), y is (B, rows), the layout of a fully
+ *  connected layer. bias may be NULL.
+ */
+inline void MatMulT(const CSRWeight &w, const float *x, int B, int cols, const float *bias,
+                    float *y) {
+  const int rows = static_cast<int>(w.row_ptr.size()) - 1;
+  #pragma omp parallel for schedule(dynamic, 4)
+  for (int r = 0; r < rows; ++r) {
+    const int begin = w.row_ptr[r], end = w.row_ptr[r + 1];
+    const float b = bias != NULL ? bias[r] : 0.0f;
+    for (int k = 0; k < B; ++k) {
+      const float *src = x + static_cast<size_t>(k) * cols;
+      float sum = b;
+      for (int i = begin; i < end; ++i) sum += w.val[i] * src[w.col[i]];
+      y[static_cast<size_t>(k) * rows + r] = sum;
+    }
+  }
+}
+}  // namespace sparsew
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_SPARSE_WEIGHT_INL_H_
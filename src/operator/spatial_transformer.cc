@@ -6,8 +6,26 @@
 */
 
 #include "./spatial_transformer-inl.h"
+#include <algorithm>
+#include <vector>
 
 namespace mshadow {
+/*! \brief top left corner and weights of the bilinear sample of one output position */
+template<typename DType>
+struct BilinearSample {
+  index_t offset;
+  DType top_left_y_w, top_left_x_w;
+  BilinearSample(const DType *grid, index_t grid_index, int o_hw, int i_h, int i_w) {
+    DType y_real = (*(grid + grid_index + o_hw) + 1) * (i_h - 1) / 2;
+    DType x_real = (*(grid + grid_index) + 1) * (i_w - 1) / 2;
+    index_t top_left_y = std::min(i_h, std::max(0, static_cast<int>(floor(y_real))));
+    index_t top_left_x = std::min(i_w, std::max(0, static_cast<int>(floor(x_real))));
+    top_left_y_w = 1.0 - (y_real - top_left_y);
+    top_left_x_w = 1.0 - (x_real - top_left_x);
+    offset = top_left_y * i_w + top_left_x;
+  }
+};
+
 template<typename DType>
 inline void BilinearSamplingForward(const Tensor<cpu, 4, DType> &output,
                                     const Tensor<cpu, 4, DType> &input,
@@ -17,33 +35,36 @@ inline void BilinearSamplingForward(const Tensor<cpu, 4, DType> &output,
   const DType *grid = grid_src.dptr_;
   int o_n = output.size(0), o_c = output.size(1), o_h = output.size(2), o_w = output.size(3);
   int i_c = input.size(1), i_h = input.size(2), i_w = input.size(3);
-  for (index_t n = 0; n < o_n; ++n) {
-    for (index_t c = 0; c < o_c; ++c) {
-      for (index_t h = 0; h < o_h; ++h) {
-        for (index_t w = 0; w < o_w; ++w) {
-          index_t out_index = n * o_c * o_h * o_w + c * o_h * o_w + h * o_w + w;
-          index_t grid_index = n * o_h * o_w * 2 + h * o_w + w;
-          DType y_real = (*(grid + grid_index + o_h * o_w) + 1) * (i_h - 1) / 2;
-          DType x_real = (*(grid + grid_index) + 1) * (i_w - 1) / 2;
-          index_t top_left_y = std::min(i_h, std::max(0, static_cast<int>(floor(y_real))));
-          index_t top_left_x = std::min(i_w, std::max(0, static_cast<int>(floor(x_real))));
-          DType top_left_y_w = 1.0 - (y_real - top_left_y);
-          DType top_left_x_w = 1.0 - (x_real - top_left_x);
-          index_t data_index = n * i_c * i_h * i_w + c * i_h * i_w + top_left_y * i_w + top_left_x;
-          DType top_left_v = *(data + data_index);
-          DType top_right_v = *(data + data_index + 1);
-          DType bottom_left_v = *(data + data_index + i_w);
-          DType bottom_right_v = *(data + data_index + i_w + 1);
-          *(out+out_index) = top_left_v * top_left_y_w * top_left_x_w +
-                             top_right_v * top_left_y_w * (1.0 - top_left_x_w) +
-                             bottom_left_v * (1.0 - top_left_y_w) * top_left_x_w +
-                             bottom_right_v * (1.0 - top_left_y_w) * (1.0 - top_left_x_w);
-        }
+  // parallel over the output rows, the samples of a row are shared by the channels
+  #pragma omp parallel for schedule(static)
+  for (int nh = 0; nh < o_n * o_h; ++nh) {
+    const int n = nh / o_h, h = nh % o_h;
+    std::vector<BilinearSample<DType> > samples;
+    samples.reserve(o_w);
+    for (int w = 0; w < o_w; ++w) {
+      samples.push_back(BilinearSample<DType>(grid, n * o_h * o_w * 2 + h * o_w + w,
+                                              o_h * o_w, i_h, i_w));
+    }
+    for (int c = 0; c < o_c; ++c) {
+      const DType *plane = data + static_cast<size_t>(n * i_c + c) * i_h * i_w;
+      DType *row = out + (static_cast<size_t>(n * o_c + c) * o_h + h) * o_w;
+      for (int w = 0; w < o_w; ++w) {
+        const BilinearSample<DType> &p = samples[w];
+        const DType *v = plane + p.offset;
+        row[w] = v[0] * p.top_left_y_w * p.top_left_x_w +
+                 v[1] * p.top_left_y_w * (1.0 - p.top_left_x_w) +
+                 v[i_w] * (1.0 - p.top_left_y_w) * p.top_left_x_w +
+                 v[i_w + 1] * (1.0 - p.top_left_y_w) * (1.0 - p.top_left_x_w);
       }
     }
   }
 }
 
+/*!
+ * \brief the input gradient is scattered in parallel over the planes, and the grid
+ *  gradient is summed over the channels in parallel over the rows, so that no two
+ *  threads write the same element.
+ */
 template<typename DType>
 inline void BilinearSamplingBackward(const Tensor<cpu, 4, DType> &input_grad,
                                      const Tensor<cpu, 3, DType> &grid_src_data,
@@ -56,51 +77,51 @@ inline void BilinearSamplingBackward(const Tensor<cpu, 4, DType> &input_grad,
   int o_n = output_grad.size(0), o_c = output_grad.size(1),
       o_h = output_grad.size(2), o_w = output_grad.size(3);
   int i_c = input_data.size(1), i_h = input_data.size(2), i_w = input_data.size(3);
-  for (index_t n = 0; n < o_n; ++n) {
-     for (index_t h = 0; h < o_h; ++h) {
-        for (index_t w = 0; w < o_w; ++w) {
-          DType top_left_y_gw = 0.0;
-          DType top_left_x_gw = 0.0;
-          index_t grid_src_index = n * o_h * o_w * 2 + h * o_w + w;
-          DType y_real = (*(grid_src + grid_src_index + o_h * o_w) + 1) * (i_h - 1) / 2;
-          DType x_real = (*(grid_src + grid_src_index) + 1) * (i_w - 1) / 2;
-          index_t top_left_y = std::min(i_h, std::max(0, static_cast<int>(floor(y_real))));
-          index_t top_left_x = std::min(i_w, std::max(0, static_cast<int>(floor(x_real))));
-          DType top_left_y_w = 1.0 - (y_real - top_left_y);
-          DType top_left_x_w = 1.0 - (x_real - top_left_x);
-          for (index_t c = 0; c < o_c; ++c) {
-            index_t grad_index = n * o_c * o_h * o_w + c * o_h * o_w + h * o_w + w;
-            index_t data_index = n * i_c * i_h * i_w + c * i_h * i_w + top_left_y * i_w
-                                 + top_left_x;
-            // calc 4 vertex value in input data
-            DType top_left_v = *(data + data_index);
-            DType top_right_v = *(data + data_index + 1);
-            DType bottom_left_v = *(data + data_index + i_w);
-            DType bottom_right_v = *(data + data_index + i_w + 1);
-            // calc input grad
-            *(g_input + data_index) += *(grad + grad_index) * top_left_y_w * top_left_x_w;
-            *(g_input + data_index + 1) += *(grad + grad_index) * top_left_y_w
-                                           * (1.0 - top_left_x_w);
-            *(g_input + data_index+ i_w) += *(grad + grad_index) * (1.0 - top_left_y_w)
-                                            * top_left_x_w;
-            *(g_input + data_index+ i_w + 1) += *(grad + grad_index) * (1.0 - top_left_y_w)
-                                                * (1.0 - top_left_x_w);
-            // calc weight grad of top_left_w, then multiple -1 is the grad of grid_src
-            top_left_y_gw -= *(grad + grad_index) * (top_right_v - bottom_right_v +
-                             (top_left_v - top_right_v - bottom_left_v + bottom_right_v)
-                             * top_left_x_w);
-            top_left_x_gw -= *(grad + grad_index) * (bottom_left_v - bottom_right_v +
-                             (top_left_v - top_right_v - bottom_left_v + bottom_right_v)
-                             * top_left_y_w);
-          }
-          // calc grid_src grad
-          *(grid_src + grid_src_index + o_h * o_w) = top_left_y_gw * (i_h - 1) / 2;
-          *(grid_src + grid_src_index) = top_left_x_gw * (i_w - 1) / 2;
-        }
+  const int o_hw = o_h * o_w;
+  #pragma omp parallel for schedule(static)
+  for (int nc = 0; nc < o_n * o_c; ++nc) {
+    const int n = nc / o_c, c = nc % o_c;
+    DType *g_plane = g_input + static_cast<size_t>(n * i_c + c) * i_h * i_w;
+    const DType *g_out = grad + static_cast<size_t>(nc) * o_hw;
+    for (int hw = 0; hw < o_hw; ++hw) {
+      const BilinearSample<DType> p(grid_src, n * o_hw * 2 + hw, o_hw, i_h, i_w);
+      DType *g = g_plane + p.offset;
+      g[0] += g_out[hw] * p.top_left_y_w * p.top_left_x_w;
+      g[1] += g_out[hw] * p.top_left_y_w * (1.0 - p.top_left_x_w);
+      g[i_w] += g_out[hw] * (1.0 - p.top_left_y_w) * p.top_left_x_w;
+      g[i_w + 1] += g_out[hw] * (1.0 - p.top_left_y_w) * (1.0 - p.top_left_x_w);
+    }
+  }
+  #pragma omp parallel for schedule(static)
+  for (int nh = 0; nh < o_n * o_h; ++nh) {
+    const int n = nh / o_h, h = nh % o_h;
+    for (int w = 0; w < o_w; ++w) {
+      const index_t grid_src_index = n * o_hw * 2 + h * o_w + w;
+      const BilinearSample<DType> p(grid_src, grid_src_index, o_hw, i_h, i_w);
+      DType top_left_y_gw = 0.0;
+      DType top_left_x_gw = 0.0;
+      for (int c = 0; c < o_c; ++c) {
+        const DType g_out = grad[static_cast<size_t>(n * o_c + c) * o_hw + h * o_w + w];
+        // calc 4 vertex value in input data
+        const DType *v = data + static_cast<size_t>(n * i_c + c) * i_h * i_w + p.offset;
+        DType top_left_v = v[0];
+        DType top_right_v = v[1];
+        DType bottom_left_v = v[i_w];
+        DType bottom_right_v = v[i_w + 1];
+        // calc weight grad of top_left_w, then multiple -1 is the grad of grid_src
+        top_left_y_gw -= g_out * (top_right_v - bottom_right_v +
+                         (top_left_v - top_right_v - bottom_left_v + bottom_right_v)
+                         * p.top_left_x_w);
+        top_left_x_gw -= g_out * (bottom_left_v - bottom_right_v +
+                         (top_left_v - top_right_v - bottom_left_v + bottom_right_v)
+                         * p.top_left_y_w);
       }
+      // calc grid_src grad, after all the samples of this position are computed
+      *(grid_src + grid_src_index + o_hw) = top_left_y_gw * (i_h - 1) / 2;
+      *(grid_src + grid_src_index) = top_left_x_gw * (i_w - 1) / 2;
     }
   }
-
+}
 }  // namespace mshadow
 
 namespace mxnet {
@@ -0,0 +1,139 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file subgraph-inl.h
+ * \brief a subgraph of nodes run by a backend as one operator,
+ *  created by StaticGraph::PartitionSubgraphs.
+*/
+#ifndef MXNET_OPERATOR_SUBGRAPH_INL_H_
+#define MXNET_OPERATOR_SUBGRAPH_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/json.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator.h>
+#include <mxnet/subgraph.h>
+#include <mxnet/symbolic.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <utility>
+#include "./operator_common.h"
+
+namespace mxnet {
+namespace op {
+
+struct SubgraphParam : public dmlc::Parameter<SubgraphParam> {
+  std::string backend;
+  std::string symbol;
+  int num_args;
+  int num_outputs;
+  DMLC_DECLARE_PARAMETER(SubgraphParam) {
+    DMLC_DECLARE_FIELD(backend)
+    .describe("Name of the registered backend running the subgraph.");
+    DMLC_DECLARE_FIELD(symbol)
+    .describe("Json of the symbol of the subgraph, its variables are named arg0, arg1, ...");
+    DMLC_DECLARE_FIELD(num_args).set_lower_bound(1)
+    .describe("Number of inputs.");
+    DMLC_DECLARE_FIELD(num_outputs).set_lower_bound(1)
+    .describe("Number of outputs.");
+  }
+};
+
+#if DMLC_USE_CXX11
+class SubgraphProp : public OperatorProperty {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+    std::istringstream is(param_.symbol);
+    dmlc::JSONReader reader(&is);
+    symbol_.Load(&reader);
+    CHECK_EQ(symbol_.ListOutputs().size(), static_cast<size_t>(param_.num_outputs));
+    CHECK_EQ(symbol_.ListAuxiliaryStates().size(), 0U)
+        << "the nodes with auxiliary states are not in subgraphs";
+    // the input of each variable of the symbol
+    arg_index_.clear();
+    for (const std::string& name : symbol_.ListArguments()) {
+      CHECK_EQ(name.compare(0, 3, "arg"), 0) << "invalid subgraph variable " << name;
+      arg_index_.push_back(std::stoi(name.substr(3)));
+      CHECK_LT(arg_index_.back(), param_.num_args);
+    }
+  }
+  std::map<std::string, std::string> GetParams() const override {
+    return param_.__DICT__();
+  }
+
+  bool InferShape(std::vector<TShape> *in_shape,
+                  std::vector<TShape> *out_shape,
+                  std::vector<TShape> *aux_shape) const override {
+    CHECK_EQ(in_shape->size(), static_cast<size_t>(param_.num_args));
+    std::vector<TShape> arg_shapes;
+    for (int i : arg_index_) arg_shapes.push_back(in_shape->at(i));
+    if (!symbol_.InferShape(&arg_shapes, out_shape, aux_shape)) return false;
+    for (size_t j = 0; j < arg_index_.size(); ++j) {
+      SHAPE_ASSIGN_CHECK(*in_shape, arg_index_[j], arg_shapes[j]);
+    }
+    return true;
+  }
+
+  bool InferType(std::vector<int> *in_type,
+                 std::vector<int> *out_type,
+                 std::vector<int> *aux_type) const override {
+    CHECK_EQ(in_type->size(), static_cast<size_t>(param_.num_args));
+    std::vector<int> arg_types;
+    for (int i : arg_index_) arg_types.push_back(in_type->at(i));
+    if (!symbol_.InferType(&arg_types, out_type, aux_type)) return false;
+    for (size_t j = 0; j < arg_index_.size(); ++j) {
+      TYPE_ASSIGN_CHECK(*in_type, arg_index_[j], arg_types[j]);
+    }
+    return true;
+  }
+
+  std::vector<std::string> ListArguments() const override {
+    std::vector<std::string> ret;
+    for (int i = 0; i < param_.num_args; ++i) {
+      ret.push_back("arg" + std::to_string(i));
+    }
+    return ret;
+  }
+
+  std::vector<std::string> ListOutputs() const override {
+    std::vector<std::string> ret;
+    for (int i = 0; i < param_.num_outputs; ++i) {
+      ret.push_back("output" + std::to_string(i));
+    }
+    return ret;
+  }
+
+  OperatorProperty* Copy() const override {
+    auto ptr = new SubgraphProp();
+    ptr->param_ = param_;
+    ptr->symbol_ = symbol_;
+    ptr->arg_index_ = arg_index_;
+    return ptr;
+  }
+
+  std::string TypeString() const override {
+    return "_Subgraph";
+  }
+
+  Operator* CreateOperator(Context ctx) const override {
+    LOG(FATAL) << "_Subgraph is created with the shapes and types of its inputs";
+    return nullptr;
+  }
+
+  Operator* CreateOperatorEx(Context ctx, std::vector<TShape> *in_shape,
+                             std::vector<int> *in_type) const override;
+
+ private:
+  SubgraphParam param_;
+  /*! \brief the subgraph */
+  Symbol symbol_;
+  /*! \brief the input of each argument of the symbol */
+  std::vector<int> arg_index_;
+};  // class SubgraphProp
+#endif  // DMLC_USE_CXX11
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_SUBGRAPH_INL_H_
@@ -0,0 +1,51 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file subgraph.cc
+ * \brief subgraph operator and the registry of the subgraph backends
+*/
+#include <map>
+#include <memory>
+#include <mutex>
+#include "./subgraph-inl.h"
+
+namespace mxnet {
+DMLC_REGISTRY_ENABLE(::mxnet::SubgraphBackendReg);
+
+SubgraphBackend* SubgraphBackend::Get(const std::string &name) {
+  static std::mutex mutex;
+  static std::map<std::string, std::unique_ptr<SubgraphBackend> > backends;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = backends.find(name);
+  if (it != backends.end()) return it->second.get();
+  auto *reg = dmlc::Registry<SubgraphBackendReg>::Find(name);
+  if (reg == nullptr) return nullptr;
+  SubgraphBackend* backend = reg->body();
+  backends[name].reset(backend);
+  return backend;
+}
+
+namespace op {
+Operator* SubgraphProp::CreateOperatorEx(Context ctx, std::vector<TShape> *in_shape,
+                                         std::vector<int> *in_type) const {
+  std::vector<TShape> out_shape, aux_shape;
+  std::vector<int> out_type, aux_type;
+  CHECK(InferType(in_type, &out_type, &aux_type));
+  CHECK(InferShape(in_shape, &out_shape, &aux_shape));
+  SubgraphBackend* backend = SubgraphBackend::Get(param_.backend);
+  CHECK(backend != nullptr) << "unknown subgraph backend " << param_.backend;
+  Operator* op = backend->CreateOperator(param_.symbol, ctx, *in_shape, *in_type);
+  CHECK(op != nullptr) << "subgraph backend " << param_.backend
+                       << " failed to create the operator of a subgraph";
+  return op;
+}
+
+DMLC_REGISTER_PARAMETER(SubgraphParam);
+
+MXNET_REGISTER_OP_PROPERTY(_Subgraph, SubgraphProp)
+.describe("Nodes run as one operator by a subgraph backend, created by the executor, "
+          "see MXNET_SUBGRAPH_BACKEND.")
+.add_arguments(SubgraphParam::__FIELDS__())
+.set_key_var_num_args("num_args");
+
+}  // namespace op
+}  // namespace mxnet
@@ -16,6 +16,7 @@
 #include <string>
 #include <utility>
 #include "./operator_common.h"
+#include "./transpose_kernel-inl.h"
 
 namespace mxnet {
 namespace op {
@@ -99,14 +100,12 @@ class SwapAxisOp : public Operator {
 
     Reshape2Five(&inter_shape, shape_in, dim1, dim2);
 
-    Tensor<xpu, 5, DType> inter_data_in = data_in.get_with_shape<xpu, 5, DType>(inter_shape, s);
-
-    Shape<5> inter_shape2 = inter_shape;
-    std::swap(inter_shape2[1], inter_shape2[3]);
-
-    Tensor<xpu, 5, DType> inter_data_out = data_out.get_with_shape<xpu, 5, DType>(inter_shape2, s);
-
-    inter_data_out = swapaxis<3, 1>(inter_data_in);
+    // the dims of size 1 collapse away, e.g. the time/batch swap of (T, N, C)
+    // copies contiguous rows of C
+    const index_t axes[] = {0, 3, 2, 1, 4};
+    TBlob inter_data_in(data_in.dptr_, TShape(inter_shape.shape_, inter_shape.shape_ + 5),
+                        data_in.dev_mask_, data_in.type_flag_);
+    TransposeCompute<xpu>(s, inter_data_in, TShape(axes, axes + 5), data_out);
   }
 
   virtual void Forward(const OpContext &ctx,
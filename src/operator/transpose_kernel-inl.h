@@ -0,0 +1,233 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file transpose_kernel-inl.h
+ * \brief kernels of the transpose of N-d tensors, used by transpose and SwapAxis.
+ *
+ *  The permutation is first collapsed: the dims of size 1 are dropped, and the dims that
+ *  stay neighbours in the same order are merged, e.g. transposing (2, 3, 4, 5) with axes
+ *  (2, 3, 0, 1) is transposing (6, 20) with axes (1, 0). When the innermost dim is kept,
+ *  the transpose copies contiguous rows. Otherwise it moves tiles of kTile x kTile between
+ *  the innermost input dim and the innermost output dim, so both the reads and the writes
+ *  are contiguous along one side of the tile: cache blocked loops on cpu, and a shared
+ *  memory tile on gpu.
+ */
+#ifndef MXNET_OPERATOR_TRANSPOSE_KERNEL_INL_H_
+#define MXNET_OPERATOR_TRANSPOSE_KERNEL_INL_H_
+
+#include <dmlc/logging.h>
+#include <mshadow/tensor.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+namespace transpose {
+/*! \brief maximum number of dims of a transpose */
+const int kMaxDim = 8;
+/*! \brief side of the tiles moved between the innermost input and output dims */
+const int kTile = 32;
+/*! \brief number of rows of a tile loaded by one pass of a thread block on gpu */
+const int kTileRows = 8;
+
+/*! \brief collapsed output shape, with the input and output strides of each output dim */
+struct TransposeStrides {
+  int ndim;
+  index_t shape[kMaxDim];
+  index_t istride[kMaxDim];
+  index_t ostride[kMaxDim];
+  /*! \brief the output dim that is innermost in the input, -1 if it is the innermost one */
+  int tdim;
+};
+
+/*!
+ * \brief collapse the transpose of a tensor
+ * \param shape shape of the input
+ * \param axes output dim i is input dim axes[i]
+ */
+inline TransposeStrides GetTransposeStrides(const TShape &shape, const TShape &axes) {
+  CHECK_EQ(shape.ndim(), axes.ndim());
+  CHECK_LE(shape.ndim(), static_cast<index_t>(kMaxDim))
+      << "Transpose supports at most " << kMaxDim << " dimensions";
+  // the output order of the input dims of size > 1
+  std::vector<index_t> perm;
+  for (index_t i = 0; i < axes.ndim(); ++i) {
+    CHECK_LT(axes[i], shape.ndim()) << "invalid transpose axes " << axes;
+    if (shape[axes[i]] != 1) perm.push_back(axes[i]);
+  }
+  // runs of input dims that stay neighbours, up to dims of size 1, in output order
+  std::vector<std::pair<index_t, index_t> > runs;
+  for (size_t k = 0; k < perm.size(); ++k) {
+    bool merge = k != 0 && perm[k] >= runs.back().second;
+    for (index_t i = merge ? runs.back().second : perm[k]; i < perm[k]; ++i) {
+      merge = merge && shape[i] == 1;
+    }
+    if (merge) {
+      runs.back().second = perm[k] + 1;
+    } else {
+      runs.push_back(std::make_pair(perm[k], perm[k] + 1));
+    }
+  }
+  TransposeStrides st;
+  st.ndim = static_cast<int>(runs.size());
+  st.tdim = -1;
+  if (st.ndim == 0) {
+    st.ndim = 1;
+    st.shape[0] = 1;
+    st.istride[0] = st.ostride[0] = 1;
+    return st;
+  }
+  for (int k = 0; k < st.ndim; ++k) {
+    st.shape[k] = 1;
+    for (index_t i = runs[k].first; i < runs[k].second; ++i) st.shape[k] *= shape[i];
+    // the input stride of a run is the size of the input dims after it
+    st.istride[k] = 1;
+    for (index_t i = runs[k].second; i < shape.ndim(); ++i) st.istride[k] *= shape[i];
+  }
+  index_t s = 1;
+  for (int k = st.ndim - 1; k >= 0; --k) {
+    st.ostride[k] = s;
+    s *= st.shape[k];
+    if (st.istride[k] == 1 && k != st.ndim - 1) st.tdim = k;
+  }
+  return st;
+}
+
+/*!
+ * \brief offsets in the input and the output of the j-th combination of the output dims
+ *  before last, skipping the dim skip
+ */
+MSHADOW_XINLINE void Unravel(index_t j, int last, int skip, const TransposeStrides &st,
+                             index_t *ioff, index_t *ooff) {
+  *ioff = *ooff = 0;
+  for (int k = last - 1; k >= 0; --k) {
+    if (k == skip) continue;
+    const index_t c = j % st.shape[k];
+    j /= st.shape[k];
+    *ioff += c * st.istride[k];
+    *ooff += c * st.ostride[k];
+  }
+}
+
+/*! \brief number of tiles along a dim of size n */
+MSHADOW_XINLINE index_t NumTiles(index_t n) {
+  return (n + kTile - 1) / kTile;
+}
+
+/*! \brief out = transpose(in) */
+template<typename DType>
+inline void TransposeLaunch(mshadow::Stream<cpu> *s, DType *out, const DType *in,
+                            const TransposeStrides &st, index_t size) {
+  const int last = st.ndim - 1;
+  const index_t N = st.shape[last];
+  if (st.tdim == -1) {
+    const int nrow = static_cast<int>(size / N);
+    #pragma omp parallel for schedule(static)
+    for (int j = 0; j < nrow; ++j) {
+      index_t ioff, ooff;
+      Unravel(j, last, -1, st, &ioff, &ooff);
+      std::copy(in + ioff, in + ioff + N, out + ooff);
+    }
+    return;
+  }
+  const int t = st.tdim;
+  const index_t M = st.shape[t];
+  const index_t is = st.istride[last], os = st.ostride[t];
+  const index_t mt = NumTiles(M), nt = NumTiles(N);
+  const int ntask = static_cast<int>(size / (M * N) * mt * nt);
+  #pragma omp parallel for schedule(static)
+  for (int task = 0; task < ntask; ++task) {
+    const index_t bn = task % nt, bm = (task / nt) % mt;
+    index_t ioff, ooff;
+    Unravel(task / (nt * mt), last, t, st, &ioff, &ooff);
+    const index_t i0 = bm * kTile, i1 = std::min(i0 + kTile, M);
+    const index_t k0 = bn * kTile, k1 = std::min(k0 + kTile, N);
+    for (index_t i = i0; i < i1; ++i) {
+      const DType *src = in + ioff + i;
+      DType *dst = out + ooff + i * os;
+      for (index_t k = k0; k < k1; ++k) dst[k] = src[k * is];
+    }
+  }
+}
+
+#ifdef __CUDACC__
+template<typename DType>
+__global__ void TransposeRowKernel(DType *out, const DType *in,
+                                   const TransposeStrides st, index_t size) {
+  const int last = st.ndim - 1;
+  const index_t N = st.shape[last];
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    index_t ioff, ooff;
+    Unravel(i / N, last, -1, st, &ioff, &ooff);
+    out[i] = in[ioff + i % N];
+  }
+}
+
+/*! \brief one kTile x kTile tile per block iteration, with kTile x kTileRows threads */
+template<typename DType>
+__global__ void TransposeTileKernel(DType *out, const DType *in,
+                                    const TransposeStrides st, index_t ntask) {
+  __shared__ DType tile[kTile][kTile + 1];
+  const int last = st.ndim - 1, t = st.tdim;
+  const index_t M = st.shape[t], N = st.shape[last];
+  const index_t is = st.istride[last], os = st.ostride[t];
+  const index_t mt = NumTiles(M), nt = NumTiles(N);
+  for (index_t task = blockIdx.x; task < ntask; task += gridDim.x) {
+    const index_t bn = task % nt, bm = (task / nt) % mt;
+    index_t ioff, ooff;
+    Unravel(task / (nt * mt), last, t, st, &ioff, &ooff);
+    const index_t i = bm * kTile + threadIdx.x;
+    for (int r = threadIdx.y; r < kTile; r += kTileRows) {
+      const index_t k = bn * kTile + r;
+      if (i < M && k < N) tile[r][threadIdx.x] = in[ioff + i + k * is];
+    }
+    __syncthreads();
+    const index_t k = bn * kTile + threadIdx.x;
+    for (int r = threadIdx.y; r < kTile; r += kTileRows) {
+      const index_t row = bm * kTile + r;
+      if (row < M && k < N) out[ooff + row * os + k] = tile[threadIdx.x][r];
+    }
+    __syncthreads();
+  }
+}
+
+template<typename DType>
+inline void TransposeLaunch(mshadow::Stream<gpu> *s, DType *out, const DType *in,
+                            const TransposeStrides &st, index_t size) {
+  using namespace mshadow::cuda;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  if (st.tdim == -1) {
+    const int grid = static_cast<int>(std::min<index_t>(
+        kMaxGridNum, (size + kBaseThreadNum - 1) / kBaseThreadNum));
+    TransposeRowKernel<<<grid, kBaseThreadNum, 0, stream>>>(out, in, st, size);
+  } else {
+    const index_t M = st.shape[st.tdim], N = st.shape[st.ndim - 1];
+    const index_t ntask = size / (M * N) * NumTiles(M) * NumTiles(N);
+    const int grid = static_cast<int>(std::min<index_t>(kMaxGridNum, ntask));
+    TransposeTileKernel<<<grid, dim3(kTile, kTileRows), 0, stream>>>(out, in, st, ntask);
+  }
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace transpose
+
+/*!
+ * \brief ret = transpose(src), output dim i is input dim axes[i]
+ */
+template<typename xpu>
+inline void TransposeCompute(mshadow::Stream<xpu> *s, const TBlob &src,
+                             const TShape &axes, const TBlob &ret) {
+  CHECK_EQ(src.type_flag_, ret.type_flag_);
+  if (src.Size() == 0) return;
+  transpose::TransposeStrides st = transpose::GetTransposeStrides(src.shape_, axes);
+  MSHADOW_TYPE_SWITCH(ret.type_flag_, DType, {
+    transpose::TransposeLaunch(s, static_cast<DType*>(ret.dptr_),
+                               static_cast<const DType*>(src.dptr_), st, src.Size());
+  });
+}
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_TRANSPOSE_KERNEL_INL_H_
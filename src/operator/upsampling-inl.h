@@ -16,6 +16,7 @@
 #include <string>
 #include <utility>
 #include "./operator_common.h"
+#include "./upsampling_kernel-inl.h"
 
 namespace mxnet {
 namespace op {
@@ -33,6 +34,7 @@ struct UpSamplingParam : public dmlc::Parameter<UpSamplingParam> {
   int sample_type;
   int num_args;
   int multi_input_mode;
+  bool use_weight;
   uint64_t workspace;
   DMLC_DECLARE_PARAMETER(UpSamplingParam) {
     DMLC_DECLARE_FIELD(scale)
@@ -56,12 +58,30 @@ struct UpSamplingParam : public dmlc::Parameter<UpSamplingParam> {
     .describe("Number of inputs to be upsampled. For nearest neighbor "
     "upsampling, this can be 1-N; the size of output will be"
     "(scale*h_0,scale*w_0) and all other inputs will be upsampled to the"
-    "same size. For bilinear upsampling this must be 2; 1 input and 1 weight.");
+    "same size. For bilinear upsampling this must be 2; 1 input and 1 weight, "
+    "or 1 when use_weight is false.");
+    DMLC_DECLARE_FIELD(use_weight).set_default(true)
+    .describe("Only used by bilinear sample_type. If true the upsampling is a "
+    "deconvolution by the weight input, which init.Bilinear fills. If false there is "
+    "no weight, the input is interpolated directly with the fixed bilinear kernel.");
     DMLC_DECLARE_FIELD(workspace).set_default(512).set_range(0, 8192)
     .describe("Tmp workspace for deconvolution (MB)");
   }
 };  // struct UpSamplingParam
 
+/*! \brief geometry of the up sampling of an input into an output */
+inline upsample::UpShape GetUpShape(const TShape &in, const TShape &out, index_t coff) {
+  upsample::UpShape p;
+  p.N = in[0];
+  p.C = in[1];
+  p.H = in[2];
+  p.W = in[3];
+  p.scale = static_cast<int>(out[2] / in[2]);
+  p.Cout = out[1];
+  p.Coff = coff;
+  return p;
+}
+
 template<typename xpu, typename DType>
 class UpSamplingNearestOp : public Operator {
  public:
@@ -75,7 +95,6 @@ class UpSamplingNearestOp : public Operator {
                        const std::vector<TBlob> &out_data,
                        const std::vector<TBlob> &aux_args) {
     using namespace mshadow;
-    using namespace mshadow::expr;
     CHECK_EQ(in_data.size(), param_.num_args);
     CHECK_EQ(out_data.size(), 1);
     if (req[up_enum::kOut] == kNullOp) {
@@ -83,26 +102,18 @@ class UpSamplingNearestOp : public Operator {
     }
     Stream<xpu> *s = ctx.get_stream<xpu>();
     Tensor<xpu, 4, DType> out = out_data[up_enum::kOut].get<xpu, 4, DType>(s);
-    if (param_.num_args > 1) {
-      int begin = 0;
-      for (int i = 0; i < param_.num_args; ++i) {
-        Tensor<xpu, 4, DType> data = in_data[i].get<xpu, 4, DType>(s);
-        int end = begin + data.size(1);
-        int scale = out_data[up_enum::kOut].size(2)/in_data[i].size(2);
-        if (param_.multi_input_mode == up_enum::kSum) {
-          if (i == 0) {
-            Assign(out, req[up_enum::kOut], upsampling_nearest(data, scale));
-          } else {
-            out += upsampling_nearest(data, scale);
-          }
-        } else {
-          Assign(slice<1>(out, begin, end), req[up_enum::kOut], upsampling_nearest(data, scale));
-        }
-        begin = end;
-      }
-    } else {
-      Tensor<xpu, 4, DType> data = in_data[up_enum::kData].get<xpu, 4, DType>(s);
-      Assign(out, req[up_enum::kOut], upsampling_nearest(data, param_.scale));
+    index_t begin = 0;
+    for (int i = 0; i < param_.num_args; ++i) {
+      Tensor<xpu, 4, DType> data = in_data[i].get<xpu, 4, DType>(s);
+      // the inputs of a sum are added to the first one, a concat writes each input
+      // directly into its channel slice of the output
+      const bool sum = param_.multi_input_mode == up_enum::kSum;
+      const bool add = req[up_enum::kOut] == kAddTo || (sum && i != 0);
+      upsample::NearestForward(s, data.dptr_,
+                               GetUpShape(in_data[i].shape_, out_data[up_enum::kOut].shape_,
+                                          sum ? 0 : begin),
+                               add, out.dptr_);
+      begin += data.size(1);
     }
   }
 
@@ -114,47 +125,21 @@ class UpSamplingNearestOp : public Operator {
                         const std::vector<TBlob> &in_grad,
                         const std::vector<TBlob> &aux_args) {
     using namespace mshadow;
-    using namespace mshadow::expr;
     CHECK_EQ(out_grad.size(), 1);
     CHECK_EQ(in_grad.size(), param_.num_args);
     Stream<xpu> *s = ctx.get_stream<xpu>();
     Tensor<xpu, 4, DType> grad = out_grad[up_enum::kOut].get<xpu, 4, DType>(s);
-    if (param_.num_args > 1) {
-      int begin = 0;
-      for (int i = 0; i < param_.num_args; ++i) {
-        Tensor<xpu, 4, DType> input_grad = in_grad[i].get<xpu, 4, DType>(s);
-        mshadow::Shape<2> in_shape = Shape2(input_grad.shape_[2], input_grad.shape_[3]);
-        int end = begin + input_grad.size(1);
-        int scale = grad.size(2)/in_shape[0];
-        if (param_.multi_input_mode == up_enum::kSum) {
-          Assign(input_grad, req[i],
-                 pool<mshadow::red::sum>(grad,
-                                         in_shape,
-                                         scale,
-                                         scale,
-                                         scale,
-                                         scale));
-        } else {
-          Assign(input_grad, req[i],
-                 pool<mshadow::red::sum>(slice<1>(grad, begin, end),
-                                         in_shape,
-                                         scale,
-                                         scale,
-                                         scale,
-                                         scale));
-        }
-        begin = end;
+    index_t begin = 0;
+    for (int i = 0; i < param_.num_args; ++i) {
+      Tensor<xpu, 4, DType> input_grad = in_grad[i].get<xpu, 4, DType>(s);
+      const bool sum = param_.multi_input_mode == up_enum::kSum;
+      if (req[i] != kNullOp) {
+        upsample::NearestBackward(s, grad.dptr_,
+                                  GetUpShape(in_grad[i].shape_, out_grad[up_enum::kOut].shape_,
+                                             sum ? 0 : begin),
+                                  req[i] == kAddTo, input_grad.dptr_);
       }
-    } else {
-      Tensor<xpu, 4, DType> input_grad = in_grad[up_enum::kData].get<xpu, 4, DType>(s);
-      mshadow::Shape<2> in_shape = Shape2(input_grad.shape_[2], input_grad.shape_[3]);
-      Assign(input_grad, req[up_enum::kData],
-             pool<mshadow::red::sum>(grad,
-                                     in_shape,
-                                     param_.scale,
-                                     param_.scale,
-                                     param_.scale,
-                                     param_.scale));
+      begin += input_grad.size(1);
     }
   }
 
@@ -162,6 +147,63 @@ class UpSamplingNearestOp : public Operator {
   UpSamplingParam param_;
 };  // class UpSamplingNearestOp
 
+/*!
+ * \brief bilinear up sampling without weight, the same as the deconvolution by the fixed
+ *  bilinear kernel that init.Bilinear fills.
+ */
+template<typename xpu, typename DType>
+class UpSamplingBilinearOp : public Operator {
+ public:
+  explicit UpSamplingBilinearOp(UpSamplingParam p) {
+    this->param_ = p;
+  }
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    CHECK_EQ(in_data.size(), 1);
+    CHECK_EQ(out_data.size(), 1);
+    if (req[up_enum::kOut] == kNullOp) {
+      return;
+    }
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 4, DType> data = in_data[up_enum::kData].get<xpu, 4, DType>(s);
+    Tensor<xpu, 4, DType> out = out_data[up_enum::kOut].get<xpu, 4, DType>(s);
+    upsample::BilinearForward(s, data.dptr_,
+                              GetUpShape(in_data[up_enum::kData].shape_,
+                                         out_data[up_enum::kOut].shape_, 0),
+                              req[up_enum::kOut] == kAddTo, out.dptr_);
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mshadow;
+    CHECK_EQ(out_grad.size(), 1);
+    CHECK_EQ(in_grad.size(), 1);
+    if (req[up_enum::kData] == kNullOp) {
+      return;
+    }
+    Stream<xpu> *s = ctx.get_stream<xpu>();
+    Tensor<xpu, 4, DType> grad = out_grad[up_enum::kOut].get<xpu, 4, DType>(s);
+    Tensor<xpu, 4, DType> input_grad = in_grad[up_enum::kData].get<xpu, 4, DType>(s);
+    upsample::BilinearBackward(s, grad.dptr_,
+                               GetUpShape(in_grad[up_enum::kData].shape_,
+                                          out_grad[up_enum::kOut].shape_, 0),
+                               req[up_enum::kData] == kAddTo, input_grad.dptr_);
+  }
+
+ private:
+  UpSamplingParam param_;
+};  // class UpSamplingBilinearOp
+
 template<typename xpu>
 Operator *CreateOp(UpSamplingParam param, int dtype);
 
@@ -184,8 +226,10 @@ class UpSamplingProp : public OperatorProperty {
         ret.push_back(std::string("arg") + static_cast<char>('0' + i));
       }
       return ret;
-    } else {
+    } else if (param_.use_weight) {
       return {"data", "weight"};
+    } else {
+      return {"data"};
     }
   }
 
@@ -214,7 +258,7 @@ class UpSamplingProp : public OperatorProperty {
           oshape[1] += shape[1];
         }
       }
-    } else {
+    } else if (param_.use_weight) {
       CHECK_EQ(in_shape->size(), 2) << "Input:[data, weight]";
       CHECK_EQ(dshape.ndim(), 4) << \
         "UpSamplingNearest: Input data should be 4D in (batch, channel, y, x)";
@@ -224,6 +268,11 @@ class UpSamplingProp : public OperatorProperty {
                          up_enum::kWeight,
                          mshadow::Shape4(dshape[1], 1, kernel, kernel));
       oshape = dshape;
+    } else {
+      CHECK_EQ(in_shape->size(), 1) << "Input:[data]";
+      CHECK_EQ(dshape.ndim(), 4) << \
+        "UpSamplingBilinear: Input data should be 4D in (batch, channel, y, x)";
+      oshape = dshape;
     }
     oshape[2] = dshape[2] * param_.scale;
     oshape[3] = dshape[3] * param_.scale;
@@ -266,7 +315,7 @@ class UpSamplingProp : public OperatorProperty {
     const std::vector<int> &out_grad,
     const std::vector<int> &in_data,
     const std::vector<int> &out_data) const override {
-    if (param_.sample_type == up_enum::kNearest) {
+    if (param_.sample_type == up_enum::kNearest || !param_.use_weight) {
       return {out_grad[up_enum::kOut]};
     } else {
       return {out_grad[up_enum::kOut], in_data[up_enum::kData], in_data[up_enum::kWeight]};
@@ -283,7 +332,7 @@ class UpSamplingProp : public OperatorProperty {
 
   std::vector<ResourceRequest> ForwardResource(
       const std::vector<TShape> &in_shape) const override {
-    if (param_.sample_type == up_enum::kNearest) {
+    if (param_.sample_type == up_enum::kNearest || !param_.use_weight) {
       return {};
     } else {
       return {ResourceRequest::kTempSpace};
@@ -292,7 +341,7 @@ class UpSamplingProp : public OperatorProperty {
 
   std::vector<ResourceRequest> BackwardResource(
       const std::vector<TShape> &in_shape) const override {
-    if (param_.sample_type == up_enum::kNearest) {
+    if (param_.sample_type == up_enum::kNearest || !param_.use_weight) {
       return {};
     } else {
       return {ResourceRequest::kTempSpace};
@@ -16,6 +16,8 @@ Operator *CreateOp<cpu>(UpSamplingParam param, int dtype) {
   MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
     if (param.sample_type == up_enum::kNearest) {
       op = new UpSamplingNearestOp<cpu, DType>(param);
+    } else if (param.sample_type == up_enum::kBilinear && !param.use_weight) {
+      op = new UpSamplingBilinearOp<cpu, DType>(param);
     } else if (param.sample_type == up_enum::kBilinear) {
       DeconvolutionParam p = DeconvolutionParam();
       int kernel = 2 * param.scale - param.scale % 2;
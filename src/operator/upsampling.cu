@@ -16,6 +16,8 @@ Operator *CreateOp<gpu>(UpSamplingParam param, int dtype) {
   MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
     if (param.sample_type == up_enum::kNearest) {
       op = new UpSamplingNearestOp<gpu, DType>(param);
+    } else if (param.sample_type == up_enum::kBilinear && !param.use_weight) {
+      op = new UpSamplingBilinearOp<gpu, DType>(param);
     } else if (param.sample_type == up_enum::kBilinear) {
       DeconvolutionParam p = DeconvolutionParam();
       int kernel = 2 * param.scale - param.scale % 2;
@@ -0,0 +1,283 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file upsampling_kernel-inl.h
+ * \brief kernels of nearest neighbor and bilinear up sampling, used by UpSampling.
+ *
+ *  The input is (n, c, h, w), the output is (n, c_out, h * scale, w * scale) and an input
+ *  lands in the channels [c_off, c_off + c) of the output, so that the inputs of a concat
+ *  are written directly into their slice of the output.
+ *  - Nearest copies each input row once into an output row, and repeats the output row
+ *    scale times. Its backward sums the scale x scale block above each input.
+ *  - Bilinear is the deconvolution with the fixed bilinear kernel of size
+ *    2 * scale - scale % 2, stride scale and pad ceil((scale - 1) / 2) computed directly:
+ *    the kernel is separable and each output has at most two taps along each axis, so
+ *    the forward gathers 2 x 2 inputs for each output. The backward gathers the outputs
+ *    of the window of each input, so that no two threads write the same element.
+ */
+#ifndef MXNET_OPERATOR_UPSAMPLING_KERNEL_INL_H_
+#define MXNET_OPERATOR_UPSAMPLING_KERNEL_INL_H_
+
+#include <dmlc/logging.h>
+#include <mshadow/tensor.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <cmath>
+
+namespace mxnet {
+namespace op {
+namespace upsample {
+/*! \brief geometry of the up sampling of one input */
+struct UpShape {
+  index_t N, C, H, W;
+  int scale;
+  /*! \brief channels of the output and the first output channel of the input */
+  index_t Cout, Coff;
+};
+
+/*! \brief size of the bilinear kernel of a scale */
+MSHADOW_XINLINE int BilinearKernel(int scale) {
+  return 2 * scale - scale % 2;
+}
+
+/*! \brief pad of the bilinear deconvolution of a scale */
+MSHADOW_XINLINE int BilinearPad(int scale) {
+  return scale / 2;
+}
+
+/*! \brief tap j of the 1-d bilinear kernel of a scale, as filled by init.Bilinear */
+MSHADOW_XINLINE float BilinearWeight(int j, int scale) {
+  const float c = (2 * scale - 1 - scale % 2) / (2.0f * scale);
+  return 1.0f - fabsf(j / static_cast<float>(scale) - c);
+}
+
+/*! \brief offset of the output element (n, c, y, x) of an input */
+MSHADOW_XINLINE index_t OutOffset(const UpShape &p, index_t n, index_t c, index_t y,
+                                  index_t x) {
+  return ((n * p.Cout + p.Coff + c) * p.H * p.scale + y) * p.W * p.scale + x;
+}
+
+/*! \brief value of the bilinear up sampling at the output (y, x) of one plane */
+template<typename DType>
+MSHADOW_XINLINE DType BilinearAt(const DType *in, int H, int W, int scale, int y, int x) {
+  const int k = BilinearKernel(scale), p = BilinearPad(scale);
+  DType sum = DType(0);
+  for (int iy = (y + p) / scale; iy >= 0 && y + p - iy * scale < k; --iy) {
+    if (iy >= H) continue;
+    const float wy = BilinearWeight(y + p - iy * scale, scale);
+    for (int ix = (x + p) / scale; ix >= 0 && x + p - ix * scale < k; --ix) {
+      if (ix >= W) continue;
+      sum += DType(wy * BilinearWeight(x + p - ix * scale, scale)) * in[iy * W + ix];
+    }
+  }
+  return sum;
+}
+
+/*! \brief gradient of the input (y, x) of one plane of the bilinear up sampling */
+template<typename DType>
+MSHADOW_XINLINE DType BilinearGradAt(const DType *grad, int H, int W, int scale,
+                                     int y, int x) {
+  const int k = BilinearKernel(scale), p = BilinearPad(scale);
+  const int OH = H * scale, OW = W * scale;
+  const int y0 = y * scale - p, x0 = x * scale - p;
+  const int y1 = y0 + k < OH ? y0 + k : OH, x1 = x0 + k < OW ? x0 + k : OW;
+  DType sum = DType(0);
+  for (int oy = y0 > 0 ? y0 : 0; oy < y1; ++oy) {
+    const float wy = BilinearWeight(oy - y0, scale);
+    for (int ox = x0 > 0 ? x0 : 0; ox < x1; ++ox) {
+      sum += DType(wy * BilinearWeight(ox - x0, scale)) * grad[oy * OW + ox];
+    }
+  }
+  return sum;
+}
+
+/*! \brief out = (add ? out : 0) + nearest(in) */
+template<typename DType>
+inline void NearestForward(mshadow::Stream<cpu> *s, const DType *in, const UpShape &p,
+                           bool add, DType *out) {
+  const int scale = p.scale;
+  const index_t W = p.W, OW = W * scale;
+  const int nrow = static_cast<int>(p.N * p.C * p.H);
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < nrow; ++r) {
+    const index_t y = r % p.H, c = (r / p.H) % p.C, n = r / (p.H * p.C);
+    const DType *src = in + r * W;
+    DType *dst = out + OutOffset(p, n, c, y * scale, 0);
+    if (add) {
+      for (int j = 0; j < scale; ++j) {
+        DType *row = dst + j * OW;
+        for (index_t x = 0; x < OW; ++x) row[x] += src[x / scale];
+      }
+    } else {
+      for (index_t x = 0; x < W; ++x) {
+        std::fill(dst + x * scale, dst + (x + 1) * scale, src[x]);
+      }
+      for (int j = 1; j < scale; ++j) std::copy(dst, dst + OW, dst + j * OW);
+    }
+  }
+}
+
+/*! \brief in_grad = (add ? in_grad : 0) + the sum of grad over the block of each input */
+template<typename DType>
+inline void NearestBackward(mshadow::Stream<cpu> *s, const DType *grad, const UpShape &p,
+                            bool add, DType *in_grad) {
+  const int scale = p.scale;
+  const index_t W = p.W, OW = W * scale;
+  const int nrow = static_cast<int>(p.N * p.C * p.H);
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < nrow; ++r) {
+    const index_t y = r % p.H, c = (r / p.H) % p.C, n = r / (p.H * p.C);
+    const DType *src = grad + OutOffset(p, n, c, y * scale, 0);
+    DType *dst = in_grad + r * W;
+    if (!add) std::fill(dst, dst + W, DType(0));
+    for (int j = 0; j < scale; ++j) {
+      const DType *row = src + j * OW;
+      for (index_t x = 0; x < OW; ++x) dst[x / scale] += row[x];
+    }
+  }
+}
+
+/*! \brief out = (add ? out : 0) + bilinear(in), the input lands in all the output channels */
+template<typename DType>
+inline void BilinearForward(mshadow::Stream<cpu> *s, const DType *in, const UpShape &p,
+                            bool add, DType *out) {
+  const int H = static_cast<int>(p.H), W = static_cast<int>(p.W), scale = p.scale;
+  const int OH = H * scale, OW = W * scale;
+  const int nrow = static_cast<int>(p.N * p.C) * OH;
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < nrow; ++r) {
+    const int y = r % OH;
+    const DType *src = in + static_cast<index_t>(r / OH) * H * W;
+    DType *dst = out + static_cast<index_t>(r) * OW;
+    for (int x = 0; x < OW; ++x) {
+      const DType v = BilinearAt(src, H, W, scale, y, x);
+      dst[x] = add ? dst[x] + v : v;
+    }
+  }
+}
+
+/*! \brief in_grad = (add ? in_grad : 0) + the gradient of bilinear */
+template<typename DType>
+inline void BilinearBackward(mshadow::Stream<cpu> *s, const DType *grad, const UpShape &p,
+                             bool add, DType *in_grad) {
+  const int H = static_cast<int>(p.H), W = static_cast<int>(p.W), scale = p.scale;
+  const int nrow = static_cast<int>(p.N * p.C) * H;
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < nrow; ++r) {
+    const int y = r % H;
+    const DType *src = grad + static_cast<index_t>(r / H) * H * W * scale * scale;
+    DType *dst = in_grad + static_cast<index_t>(r) * W;
+    for (int x = 0; x < W; ++x) {
+      const DType v = BilinearGradAt(src, H, W, scale, y, x);
+      dst[x] = add ? dst[x] + v : v;
+    }
+  }
+}
+
+#ifdef __CUDACC__
+template<typename DType>
+__global__ void NearestForwardKernel(const DType *in, const UpShape p, bool add,
+                                     DType *out, index_t size) {
+  const index_t OH = p.H * p.scale, OW = p.W * p.scale;
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    const index_t x = i % OW, y = (i / OW) % OH, c = (i / (OW * OH)) % p.C;
+    const index_t n = i / (OW * OH * p.C);
+    const DType v = in[((n * p.C + c) * p.H + y / p.scale) * p.W + x / p.scale];
+    const index_t o = OutOffset(p, n, c, y, x);
+    out[o] = add ? out[o] + v : v;
+  }
+}
+
+template<typename DType>
+__global__ void NearestBackwardKernel(const DType *grad, const UpShape p, bool add,
+                                      DType *in_grad, index_t size) {
+  const index_t OW = p.W * p.scale;
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    const index_t x = i % p.W, y = (i / p.W) % p.H, c = (i / (p.W * p.H)) % p.C;
+    const index_t n = i / (p.W * p.H * p.C);
+    const DType *src = grad + OutOffset(p, n, c, y * p.scale, x * p.scale);
+    DType sum = DType(0);
+    for (int j = 0; j < p.scale; ++j) {
+      for (int l = 0; l < p.scale; ++l) sum += src[j * OW + l];
+    }
+    in_grad[i] = add ? in_grad[i] + sum : sum;
+  }
+}
+
+template<typename DType>
+__global__ void BilinearForwardKernel(const DType *in, const UpShape p, bool add,
+                                      DType *out, index_t size) {
+  const int H = p.H, W = p.W, OH = H * p.scale, OW = W * p.scale;
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    const int x = i % OW, y = (i / OW) % OH;
+    const DType v = BilinearAt(in + i / (OW * OH) * H * W, H, W, p.scale, y, x);
+    out[i] = add ? out[i] + v : v;
+  }
+}
+
+template<typename DType>
+__global__ void BilinearBackwardKernel(const DType *grad, const UpShape p, bool add,
+                                       DType *in_grad, index_t size) {
+  const int H = p.H, W = p.W, scale = p.scale;
+  for (index_t i = blockIdx.x * blockDim.x + threadIdx.x; i < size;
+       i += blockDim.x * gridDim.x) {
+    const int x = i % W, y = (i / W) % H;
+    const DType *src = grad + i / (W * H) * H * W * scale * scale;
+    const DType v = BilinearGradAt(src, H, W, scale, y, x);
+    in_grad[i] = add ? in_grad[i] + v : v;
+  }
+}
+
+/*! \brief number of blocks of the grid stride loops over size elements */
+inline int NumBlocks(index_t size) {
+  using namespace mshadow::cuda;
+  return static_cast<int>(std::min<index_t>(
+      kMaxGridNum, (size + kBaseThreadNum - 1) / kBaseThreadNum));
+}
+
+template<typename DType>
+inline void NearestForward(mshadow::Stream<gpu> *s, const DType *in, const UpShape &p,
+                           bool add, DType *out) {
+  const index_t size = p.N * p.C * p.H * p.W * p.scale * p.scale;
+  NearestForwardKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0,
+                         mshadow::Stream<gpu>::GetStream(s)>>>(in, p, add, out, size);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+template<typename DType>
+inline void NearestBackward(mshadow::Stream<gpu> *s, const DType *grad, const UpShape &p,
+                            bool add, DType *in_grad) {
+  const index_t size = p.N * p.C * p.H * p.W;
+  NearestBackwardKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0,
+                          mshadow::Stream<gpu>::GetStream(s)>>>(grad, p, add, in_grad, size);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+template<typename DType>
+inline void BilinearForward(mshadow::Stream<gpu> *s, const DType *in, const UpShape &p,
+                            bool add, DType *out) {
+  const index_t size = p.N * p.C * p.H * p.W * p.scale * p.scale;
+  BilinearForwardKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0,
+                          mshadow::Stream<gpu>::GetStream(s)>>>(in, p, add, out, size);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+template<typename DType>
+inline void BilinearBackward(mshadow::Stream<gpu> *s, const DType *grad, const UpShape &p,
+                             bool add, DType *in_grad) {
+  const index_t size = p.N * p.C * p.H * p.W;
+  BilinearBackwardKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0,
+                           mshadow::Stream<gpu>::GetStream(s)>>>(grad, p, add, in_grad, size);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace upsample
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_UPSAMPLING_KERNEL_INL_H_
@@ -0,0 +1,185 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file vol2col-inl.h
+ * \brief unfold the windows of a volume into columns, for the 3D convolution and
+ *  deconvolution as a GEMM, and fold them back
+ */
+#ifndef MXNET_OPERATOR_VOL2COL_INL_H_
+#define MXNET_OPERATOR_VOL2COL_INL_H_
+
+#include <mxnet/base.h>
+#include <algorithm>
+#include <cstring>
+
+namespace mxnet {
+namespace op {
+namespace vol2col {
+/*!
+ * \brief geometry of a 3D convolution over one (C, D, H, W) volume, with an output of
+ *  (Do, Ho, Wo). The columns are (C * kd * kh * kw, Do * Ho * Wo), in the order of the
+ *  weight (C, kd, kh, kw).
+ */
+struct VolShape {
+  int C, D, H, W;
+  int Do, Ho, Wo;
+  int kd, kh, kw;
+  int sd, sh, sw;
+  int pd, ph, pw;
+  /*! \return the number of rows of the columns */
+  inline index_t rows() const {
+    return static_cast<index_t>(C) * kd * kh * kw;
+  }
+  /*! \return the number of columns, one for each output position */
+  inline index_t cols() const {
+    return static_cast<index_t>(Do) * Ho * Wo;
+  }
+};
+
+/*! \brief col = the windows of vol, zero outside of it */
+template<typename DType>
+inline void Vol2Col(mshadow::Stream<cpu> *s, const DType *vol, const VolShape &p, DType *col) {
+  const int nrow = static_cast<int>(p.rows());
+  const index_t ncol = p.cols();
+  #pragma omp parallel for schedule(static)
+  for (int r = 0; r < nrow; ++r) {
+    const int kx = r % p.kw, ky = (r / p.kw) % p.kh, kz = (r / p.kw / p.kh) % p.kd;
+    const int c = r / p.kw / p.kh / p.kd;
+    const DType *src = vol + static_cast<size_t>(c) * p.D * p.H * p.W;
+    DType *dst = col + static_cast<size_t>(r) * ncol;
+    for (int od = 0; od < p.Do; ++od) {
+      const int id = od * p.sd - p.pd + kz;
+      for (int oh = 0; oh < p.Ho; ++oh, dst += p.Wo) {
+        const int ih = oh * p.sh - p.ph + ky;
+        if (id < 0 || id >= p.D || ih < 0 || ih >= p.H) {
+          std::fill(dst, dst + p.Wo, DType(0));
+          continue;
+        }
+        const DType *row = src + (static_cast<size_t>(id) * p.H + ih) * p.W;
+        for (int ow = 0; ow < p.Wo; ++ow) {
+          const int iw = ow * p.sw - p.pw + kx;
+          dst[ow] = iw >= 0 && iw < p.W ? row[iw] : DType(0);
+        }
+      }
+    }
+  }
+}
+
+/*!
+ * \brief vol = the sum of the columns over the windows, added to vol if add. The
+ *  channels are folded in parallel, as their rows only touch their own volume.
+ */
+template<typename DType>
+inline void Col2Vol(mshadow::Stream<cpu> *s, const DType *col, const VolShape &p, bool add,
+                    DType *vol) {
+  const index_t ncol = p.cols();
+  const int kvol = p.kd * p.kh * p.kw;
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < p.C; ++c) {
+    DType *dst = vol + static_cast<size_t>(c) * p.D * p.H * p.W;
+    if (!add) std::fill(dst, dst + static_cast<size_t>(p.D) * p.H * p.W, DType(0));
+    for (int k = 0; k < kvol; ++k) {
+      const int kx = k % p.kw, ky = (k / p.kw) % p.kh, kz = k / p.kw / p.kh;
+      const DType *src = col + (static_cast<size_t>(c) * kvol + k) * ncol;
+      for (int od = 0; od < p.Do; ++od) {
+        const int id = od * p.sd - p.pd + kz;
+        for (int oh = 0; oh < p.Ho; ++oh, src += p.Wo) {
+          const int ih = oh * p.sh - p.ph + ky;
+          if (id < 0 || id >= p.D || ih < 0 || ih >= p.H) continue;
+          DType *row = dst + (static_cast<size_t>(id) * p.H + ih) * p.W;
+          for (int ow = 0; ow < p.Wo; ++ow) {
+            const int iw = ow * p.sw - p.pw + kx;
+            if (iw >= 0 && iw < p.W) row[iw] += src[ow];
+          }
+        }
+      }
+    }
+  }
+}
+
+#ifdef __CUDACC__
+/*! \brief one thread for each (channel, output position) writes its kd * kh * kw rows */
+template<typename DType>
+__global__ void Vol2ColKernel(const DType *vol, VolShape p, DType *col) {
+  const size_t ncol = p.cols();
+  const size_t size = static_cast<size_t>(p.C) * ncol;
+  for (size_t e = blockIdx.x * blockDim.x + threadIdx.x; e < size;
+       e += gridDim.x * blockDim.x) {
+    const int pos = e % ncol, c = e / ncol;
+    const int ow = pos % p.Wo, oh = (pos / p.Wo) % p.Ho, od = pos / p.Wo / p.Ho;
+    const DType *src = vol + static_cast<size_t>(c) * p.D * p.H * p.W;
+    DType *dst = col + static_cast<size_t>(c) * p.kd * p.kh * p.kw * ncol + pos;
+    for (int kz = 0; kz < p.kd; ++kz) {
+      const int id = od * p.sd - p.pd + kz;
+      for (int ky = 0; ky < p.kh; ++ky) {
+        const int ih = oh * p.sh - p.ph + ky;
+        for (int kx = 0; kx < p.kw; ++kx, dst += ncol) {
+          const int iw = ow * p.sw - p.pw + kx;
+          *dst = id >= 0 && id < p.D && ih >= 0 && ih < p.H && iw >= 0 && iw < p.W ?
+              src[(static_cast<size_t>(id) * p.H + ih) * p.W + iw] : DType(0);
+        }
+      }
+    }
+  }
+}
+
+/*! \brief one thread for each element of the volume gathers the columns of its windows */
+template<typename DType>
+__global__ void Col2VolKernel(const DType *col, VolShape p, bool add, DType *vol) {
+  const size_t ncol = p.cols();
+  const size_t size = static_cast<size_t>(p.C) * p.D * p.H * p.W;
+  for (size_t e = blockIdx.x * blockDim.x + threadIdx.x; e < size;
+       e += gridDim.x * blockDim.x) {
+    const int iw = e % p.W, ih = (e / p.W) % p.H, id = (e / p.W / p.H) % p.D;
+    const int c = e / p.W / p.H / p.D;
+    DType sum = 0;
+    for (int kz = 0; kz < p.kd; ++kz) {
+      const int dz = id + p.pd - kz;
+      if (dz < 0 || dz % p.sd != 0 || dz / p.sd >= p.Do) continue;
+      for (int ky = 0; ky < p.kh; ++ky) {
+        const int dy = ih + p.ph - ky;
+        if (dy < 0 || dy % p.sh != 0 || dy / p.sh >= p.Ho) continue;
+        for (int kx = 0; kx < p.kw; ++kx) {
+          const int dx = iw + p.pw - kx;
+          if (dx < 0 || dx % p.sw != 0 || dx / p.sw >= p.Wo) continue;
+          const size_t row = ((static_cast<size_t>(c) * p.kd + kz) * p.kh + ky) * p.kw + kx;
+          const size_t pos = (static_cast<size_t>(dz / p.sd) * p.Ho + dy / p.sh) * p.Wo +
+              dx / p.sw;
+          sum += col[row * ncol + pos];
+        }
+      }
+    }
+    vol[e] = add ? vol[e] + sum : sum;
+  }
+}
+
+inline int NumBlocks(size_t threads) {
+  using namespace mshadow::cuda;
+  return static_cast<int>(std::min<size_t>((threads + kBaseThreadNum - 1) / kBaseThreadNum,
+                                           kMaxGridNum));
+}
+
+template<typename DType>
+inline void Vol2Col(mshadow::Stream<gpu> *s, const DType *vol, const VolShape &p, DType *col) {
+  const size_t size = static_cast<size_t>(p.C) * p.cols();
+  if (size == 0) return;
+  Vol2ColKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0,
+                  mshadow::Stream<gpu>::GetStream(s)>>>(vol, p, col);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
+template<typename DType>
+inline void Col2Vol(mshadow::Stream<gpu> *s, const DType *col, const VolShape &p, bool add,
+                    DType *vol) {
+  const size_t size = static_cast<size_t>(p.C) * p.D * p.H * p.W;
+  if (size == 0) return;
+  Col2VolKernel<<<NumBlocks(size), mshadow::cuda::kBaseThreadNum, 0,
+                  mshadow::Stream<gpu>::GetStream(s)>>>(col, p, add, vol);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+#endif  // __CUDACC__
+}  // namespace vol2col
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_VOL2COL_INL_H_
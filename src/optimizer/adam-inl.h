@@ -0,0 +1,166 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file adam-inl.h
+ * \brief adam optimizer, the same as mxnet.optimizer.Adam
+ */
+#ifndef MXNET_OPTIMIZER_ADAM_INL_H_
+#define MXNET_OPTIMIZER_ADAM_INL_H_
+
+#include <mshadow/tensor.h>
+#include <mxnet/optimizer.h>
+#include <dmlc/parameter.h>
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./sgd-inl.h"
+#include "./optimizer_common.h"
+#include "../operator/mshadow_op.h"
+
+namespace mxnet {
+namespace opt {
+
+struct AdamParam : public dmlc::Parameter<AdamParam> {
+  float beta1;
+  float beta2;
+  float epsilon;
+  float rescale_grad;
+  float clip_gradient;
+  DMLC_DECLARE_PARAMETER(AdamParam) {
+    DMLC_DECLARE_FIELD(beta1)
+    .set_range(0.0f, 1.0f)
+    .set_default(0.9f)
+    .describe("decay rate of the first moment estimate.");
+    DMLC_DECLARE_FIELD(beta2)
+    .set_range(0.0f, 1.0f)
+    .set_default(0.999f)
+    .describe("decay rate of the second moment estimate.");
+    DMLC_DECLARE_FIELD(epsilon)
+    .set_default(1e-8f)
+    .describe("small value to avoid division by 0.");
+    DMLC_DECLARE_FIELD(rescale_grad)
+    .set_default(1.0f)
+    .describe("rescale gradient as grad = rescale_grad*grad.");
+    DMLC_DECLARE_FIELD(clip_gradient)
+    .set_default(-1.0f)
+    .describe("If not negative, clip the rescaled gradient to "
+              "[-clip_gradient, clip_gradient]. Otherwise turned off.");
+  }
+};
+
+/*!
+ * \brief update a weight with its moment estimates
+ * \param lr the learning rate corrected by the bias of the estimates
+ */
+template<typename xpu>
+void adam_update(RunContext ctx, TBlob weight, const TBlob grad, TBlob mean, TBlob var,
+                 float lr, float wd, const AdamParam& param) {
+  using namespace mshadow;
+  using namespace mshadow::expr;
+  Stream<xpu>* s = ctx.get_stream<xpu>();
+  Tensor<xpu, 2> weight2d = weight.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> grad2d = grad.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> mean2d = mean.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> var2d = var.FlatTo2D<xpu, real_t>(s);
+  if (param.clip_gradient >= 0.0f) {
+    mean2d = param.beta1 * mean2d + (1.0f - param.beta1) *
+        F<sgd_clip>(param.rescale_grad * grad2d, param.clip_gradient);
+    var2d = param.beta2 * var2d + (1.0f - param.beta2) *
+        F<op::mshadow_op::square>(F<sgd_clip>(param.rescale_grad * grad2d,
+                                              param.clip_gradient));
+  } else {
+    mean2d = param.beta1 * mean2d + (1.0f - param.beta1) * param.rescale_grad * grad2d;
+    var2d = param.beta2 * var2d + (1.0f - param.beta2) *
+        F<op::mshadow_op::square>(param.rescale_grad * grad2d);
+  }
+  weight2d -= lr * mean2d / (F<op::mshadow_op::square_root>(var2d) + param.epsilon);
+  if (wd > 0.0f) weight2d -= (lr * wd) * weight2d;
+}
+
+void call_adam_update_cpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob mean,
+                          TBlob var, float lr, float wd, const AdamParam& param);
+#if MXNET_USE_CUDA
+void call_adam_update_gpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob mean,
+                          TBlob var, float lr, float wd, const AdamParam& param);
+#endif  // MXNET_USE_CUDA
+
+#if DMLC_USE_CXX11
+
+class AdamOpt : public Optimizer {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  void CreateState(const int index, const NDArray *weight) override {
+    if (mean_.find(index) == mean_.end()) {
+      mean_[index] = NDArray(weight->shape(), weight->ctx());
+      mean_[index] = 0.0f;
+      var_[index] = NDArray(weight->shape(), weight->ctx());
+      var_[index] = 0.0f;
+      count_[index] = 0;
+    }
+  }
+
+  void Update(const int index, NDArray *weight,
+              const NDArray *grad, const float lr, const float wd) override {
+    UpdateMulti({index}, {weight}, {grad}, {lr}, {wd});
+  }
+
+  void UpdateMulti(const std::vector<int>& indices,
+                   const std::vector<NDArray*>& weights,
+                   const std::vector<const NDArray*>& grads,
+                   const std::vector<float>& lrs,
+                   const std::vector<float>& wds) override {
+    for (const std::vector<size_t>& group : GroupByContext(weights)) {
+      std::vector<NDArray> w, g, mean, var;
+      std::vector<float> lr, wd;
+      std::vector<Engine::VarHandle> const_vars, mutable_vars;
+      for (size_t i : group) {
+        const int index = indices[i];
+        CreateState(index, weights[i]);
+        const int t = ++count_[index];
+        w.push_back(*weights[i]);
+        g.push_back(*grads[i]);
+        mean.push_back(mean_[index]);
+        var.push_back(var_[index]);
+        lr.push_back(lrs[i] * std::sqrt(1.0f - std::pow(param_.beta2, t)) /
+                     (1.0f - std::pow(param_.beta1, t)));
+        wd.push_back(wds[i]);
+        const_vars.push_back(g.back().var());
+        mutable_vars.push_back(w.back().var());
+        mutable_vars.push_back(mean.back().var());
+        mutable_vars.push_back(var.back().var());
+      }
+      const Context ctx = w[0].ctx();
+      Engine::Get()->PushSync([this, w, g, mean, var, lr, wd](RunContext rctx) {
+          for (size_t i = 0; i < w.size(); ++i) {
+            if (w[i].ctx().dev_mask() == cpu::kDevMask) {
+              call_adam_update_cpu(rctx, w[i].data(), g[i].data(), mean[i].data(),
+                                   var[i].data(), lr[i], wd[i], param_);
+            } else {
+#if MXNET_USE_CUDA
+              call_adam_update_gpu(rctx, w[i].data(), g[i].data(), mean[i].data(),
+                                   var[i].data(), lr[i], wd[i], param_);
+#else
+              LOG(FATAL) << "Please compile with CUDA enabled for cuda features";
+#endif  // MXNET_USE_CUDA
+            }
+          }
+        }, ctx, const_vars, mutable_vars, FnProperty::kNormal);
+    }
+  }
+
+ private:
+  AdamParam param_;
+  std::map<int, NDArray> mean_, var_;
+  /*! \brief the number of updates of each weight, for the bias correction */
+  std::map<int, int> count_;
+};
+
+#endif  // DMLC_USE_CXX11
+
+}  // namespace opt
+}  // namespace mxnet
+#endif  // MXNET_OPTIMIZER_ADAM_INL_H_
@@ -8,6 +8,7 @@
 #include <dmlc/registry.h>
 #include <mxnet/optimizer.h>
 #include <mxnet/ndarray.h>
+#include "../operator/row_sparse-inl.h"
 
 namespace dmlc {
 DMLC_REGISTRY_ENABLE(::mxnet::OptimizerReg);
@@ -22,4 +23,29 @@ Optimizer *Optimizer::Create(const char* type_name) {
   }
   return creator->body();
 }
+
+void Optimizer::UpdateRowSparse(const int index, NDArray *weight, const NDArray &row_ids,
+                                const NDArray *grad, const float lr, const float wd) {
+  const TShape& shape = weight->shape();
+  const index_t nrow = shape[0], ncol = shape.Size() / shape[0];
+  NDArray rows = row_ids, g = *grad;
+  if (g.ctx().dev_mask() != cpu::kDevMask) {
+    g = NDArray(grad->shape(), Context());
+    CopyFromTo(*grad, &g);
+  }
+  NDArray dense(shape, Context());
+  Engine::Get()->PushSync([dense, rows, g, nrow, ncol](RunContext ctx) {
+      mshadow::Tensor<cpu, 2> dst =
+          dense.data().get_with_shape<cpu, 2, real_t>(mshadow::Shape2(nrow, ncol));
+      dst = 0.0f;
+      op::rowsparse::FillRows(dst, rows.data().FlatTo1D<cpu, real_t>(),
+                              static_cast<const real_t*>(g.data().dptr_));
+    }, Context(), {rows.var(), g.var()}, {dense.var()}, FnProperty::kNormal);
+  if (weight->ctx() != dense.ctx()) {
+    NDArray copy(shape, weight->ctx());
+    CopyFromTo(dense, &copy);
+    dense = copy;
+  }
+  this->Update(index, weight, &dense, lr, wd);
+}
 }  // namespace mxnet
@@ -0,0 +1,35 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file optimizer_common.h
+ * \brief helpers shared by the fused updates of the optimizers.
+ */
+#ifndef MXNET_OPTIMIZER_OPTIMIZER_COMMON_H_
+#define MXNET_OPTIMIZER_OPTIMIZER_COMMON_H_
+
+#include <mxnet/ndarray.h>
+#include <vector>
+
+namespace mxnet {
+namespace opt {
+/*!
+ * \return the positions of the weights on each context, the contexts in the
+ *  order of their first weight
+ */
+inline std::vector<std::vector<size_t> > GroupByContext(const std::vector<NDArray*>& weights) {
+  std::vector<Context> ctxs;
+  std::vector<std::vector<size_t> > groups;
+  for (size_t i = 0; i < weights.size(); ++i) {
+    const Context ctx = weights[i]->ctx();
+    size_t k = 0;
+    while (k < ctxs.size() && ctxs[k] != ctx) ++k;
+    if (k == ctxs.size()) {
+      ctxs.push_back(ctx);
+      groups.push_back(std::vector<size_t>());
+    }
+    groups[k].push_back(i);
+  }
+  return groups;
+}
+}  // namespace opt
+}  // namespace mxnet
+#endif  // MXNET_OPTIMIZER_OPTIMIZER_COMMON_H_
@@ -0,0 +1,166 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file rmsprop-inl.h
+ * \brief rmsprop optimizer of Graves, the same as mxnet.optimizer.RMSProp
+ */
+#ifndef MXNET_OPTIMIZER_RMSPROP_INL_H_
+#define MXNET_OPTIMIZER_RMSPROP_INL_H_
+
+#include <mshadow/tensor.h>
+#include <mxnet/optimizer.h>
+#include <dmlc/parameter.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./sgd-inl.h"
+#include "./optimizer_common.h"
+#include "../operator/mshadow_op.h"
+
+namespace mxnet {
+namespace opt {
+
+struct RMSPropParam : public dmlc::Parameter<RMSPropParam> {
+  float gamma1;
+  float gamma2;
+  float rescale_grad;
+  float clip_gradient;
+  DMLC_DECLARE_PARAMETER(RMSPropParam) {
+    DMLC_DECLARE_FIELD(gamma1)
+    .set_range(0.0f, 1.0f)
+    .set_default(0.95f)
+    .describe("decay factor of the moving averages of the gradient and its square.");
+    DMLC_DECLARE_FIELD(gamma2)
+    .set_range(0.0f, 1.0f)
+    .set_default(0.9f)
+    .describe("momentum factor of the update.");
+    DMLC_DECLARE_FIELD(rescale_grad)
+    .set_default(1.0f)
+    .describe("rescale gradient as grad = rescale_grad*grad.");
+    DMLC_DECLARE_FIELD(clip_gradient)
+    .set_default(-1.0f)
+    .describe("If not negative, clip the rescaled gradient to "
+              "[-clip_gradient, clip_gradient]. Otherwise turned off.");
+  }
+};
+
+template<typename xpu>
+void rmsprop_update(RunContext ctx, TBlob weight, const TBlob grad, TBlob n, TBlob g,
+                    TBlob delta, float lr, float wd, const RMSPropParam& param) {
+  using namespace mshadow;
+  using namespace mshadow::expr;
+  Stream<xpu>* s = ctx.get_stream<xpu>();
+  Tensor<xpu, 2> weight2d = weight.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> grad2d = grad.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> n2d = n.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> g2d = g.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> delta2d = delta.FlatTo2D<xpu, real_t>(s);
+  if (param.clip_gradient >= 0.0f) {
+    n2d = (1.0f - param.gamma1) * F<op::mshadow_op::square>(
+        F<sgd_clip>(param.rescale_grad * grad2d, param.clip_gradient)) + param.gamma1 * n2d;
+    g2d = (1.0f - param.gamma1) *
+        F<sgd_clip>(param.rescale_grad * grad2d, param.clip_gradient) + param.gamma1 * g2d;
+    delta2d = param.gamma2 * delta2d - lr *
+        (F<sgd_clip>(param.rescale_grad * grad2d, param.clip_gradient) /
+         F<op::mshadow_op::square_root>(n2d - F<op::mshadow_op::square>(g2d) + 1e-4f) +
+         wd * weight2d);
+  } else {
+    n2d = (1.0f - param.gamma1) * F<op::mshadow_op::square>(param.rescale_grad * grad2d) +
+        param.gamma1 * n2d;
+    g2d = (1.0f - param.gamma1) * param.rescale_grad * grad2d + param.gamma1 * g2d;
+    delta2d = param.gamma2 * delta2d - lr *
+        (param.rescale_grad * grad2d /
+         F<op::mshadow_op::square_root>(n2d - F<op::mshadow_op::square>(g2d) + 1e-4f) +
+         wd * weight2d);
+  }
+  weight2d += delta2d;
+}
+
+void call_rmsprop_update_cpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob n,
+                             TBlob g, TBlob delta, float lr, float wd,
+                             const RMSPropParam& param);
+#if MXNET_USE_CUDA
+void call_rmsprop_update_gpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob n,
+                             TBlob g, TBlob delta, float lr, float wd,
+                             const RMSPropParam& param);
+#endif  // MXNET_USE_CUDA
+
+#if DMLC_USE_CXX11
+
+class RMSPropOpt : public Optimizer {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  void CreateState(const int index, const NDArray *weight) override {
+    if (n_.find(index) == n_.end()) {
+      n_[index] = NDArray(weight->shape(), weight->ctx());
+      n_[index] = 0.0f;
+      g_[index] = NDArray(weight->shape(), weight->ctx());
+      g_[index] = 0.0f;
+      delta_[index] = NDArray(weight->shape(), weight->ctx());
+      delta_[index] = 0.0f;
+    }
+  }
+
+  void Update(const int index, NDArray *weight,
+              const NDArray *grad, const float lr, const float wd) override {
+    UpdateMulti({index}, {weight}, {grad}, {lr}, {wd});
+  }
+
+  void UpdateMulti(const std::vector<int>& indices,
+                   const std::vector<NDArray*>& weights,
+                   const std::vector<const NDArray*>& grads,
+                   const std::vector<float>& lrs,
+                   const std::vector<float>& wds) override {
+    for (const std::vector<size_t>& group : GroupByContext(weights)) {
+      std::vector<NDArray> w, grad, n, g, delta;
+      std::vector<float> lr, wd;
+      std::vector<Engine::VarHandle> const_vars, mutable_vars;
+      for (size_t i : group) {
+        const int index = indices[i];
+        CreateState(index, weights[i]);
+        w.push_back(*weights[i]);
+        grad.push_back(*grads[i]);
+        n.push_back(n_[index]);
+        g.push_back(g_[index]);
+        delta.push_back(delta_[index]);
+        lr.push_back(lrs[i]);
+        wd.push_back(wds[i]);
+        const_vars.push_back(grad.back().var());
+        mutable_vars.push_back(w.back().var());
+        mutable_vars.push_back(n.back().var());
+        mutable_vars.push_back(g.back().var());
+        mutable_vars.push_back(delta.back().var());
+      }
+      const Context ctx = w[0].ctx();
+      Engine::Get()->PushSync([this, w, grad, n, g, delta, lr, wd](RunContext rctx) {
+          for (size_t i = 0; i < w.size(); ++i) {
+            if (w[i].ctx().dev_mask() == cpu::kDevMask) {
+              call_rmsprop_update_cpu(rctx, w[i].data(), grad[i].data(), n[i].data(),
+                                      g[i].data(), delta[i].data(), lr[i], wd[i], param_);
+            } else {
+#if MXNET_USE_CUDA
+              call_rmsprop_update_gpu(rctx, w[i].data(), grad[i].data(), n[i].data(),
+                                      g[i].data(), delta[i].data(), lr[i], wd[i], param_);
+#else
+              LOG(FATAL) << "Please compile with CUDA enabled for cuda features";
+#endif  // MXNET_USE_CUDA
+            }
+          }
+        }, ctx, const_vars, mutable_vars, FnProperty::kNormal);
+    }
+  }
+
+ private:
+  RMSPropParam param_;
+  /*! \brief the moving averages of the squared gradient and of the gradient, and the update */
+  std::map<int, NDArray> n_, g_, delta_;
+};
+
+#endif  // DMLC_USE_CXX11
+
+}  // namespace opt
+}  // namespace mxnet
+#endif  // MXNET_OPTIMIZER_RMSPROP_INL_H_
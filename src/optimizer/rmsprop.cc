@@ -0,0 +1,24 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file rmsprop.cc
+ * \brief rmsprop optimizer
+*/
+#include <mxnet/ndarray.h>
+#include "./rmsprop-inl.h"
+
+namespace mxnet {
+namespace opt {
+
+void call_rmsprop_update_cpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob n,
+                             TBlob g, TBlob delta, float lr, float wd,
+                             const RMSPropParam& param) {
+  rmsprop_update<cpu>(ctx, weight, grad, n, g, delta, lr, wd, param);
+}
+
+DMLC_REGISTER_PARAMETER(RMSPropParam);
+
+MXNET_REGISTER_OPTIMIZER(ccrmsprop, RMSPropOpt)
+.describe("RMSProp optimizer of Graves implemented in C++.");
+
+}  // namespace opt
+}  // namespace mxnet
@@ -14,6 +14,7 @@
 #include <vector>
 #include <map>
 #include <utility>
+#include "./optimizer_common.h"
 
 namespace mxnet {
 namespace opt {
@@ -86,15 +87,64 @@ void sgd_update(RunContext ctx, TBlob weight, const TBlob grad,
   }
 }
 
+/*!
+ * \brief the update of an element of a touched row of a row sparse gradient,
+ *  (mom, weight) of the row are first multiplied by the 2x2 matrix of the steps
+ *  skipped since its last update
+ * \param i the position in the (num_touched_rows, ncol) gradient
+ * \param coef for each touched row, its row id followed by the matrix
+ * \param mom NULL without momentum
+ */
+struct sgd_lazy {
+  MSHADOW_XINLINE static void Map(int i, int ncol, real_t *weight, const real_t *grad,
+                                  real_t *mom, const real_t *coef, float lr, float wd,
+                                  float momentum, float rescale_grad, float clip_gradient) {
+    const real_t *c = coef + (i / ncol) * 5;
+    const int k = static_cast<int>(c[0]) * ncol + i % ncol;
+    const real_t m = mom == NULL ? 0.0f : mom[k];
+    const real_t w = c[3] * m + c[4] * weight[k];
+    real_t g = grad[i];
+    if (mom != NULL) {
+      if (clip_gradient > 0.0f) g = sgd_clip::Map(g, clip_gradient);
+      mom[k] = momentum * (c[1] * m + c[2] * weight[k]) - lr * (rescale_grad * g + wd * w);
+      weight[k] = w + mom[k];
+    } else {
+      if (clip_gradient >= 0.0f) g = sgd_clip::Map(g, clip_gradient);
+      weight[k] = w - lr * (rescale_grad * g + wd * w);
+    }
+  }
+};
+
 void call_sgd_mom_update_cpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob mom,
                 float lr, float wd, const SGDParam& param);
 void call_sgd_update_cpu(RunContext ctx, TBlob weight, const TBlob grad,
                 float lr, float wd, const SGDParam& param);
+/*!
+ * \brief update a list of weights of the same device, the momentums are
+ *  empty without momentum
+ */
+void call_sgd_multi_update_cpu(RunContext ctx, const std::vector<TBlob>& weight,
+                               const std::vector<TBlob>& grad, const std::vector<TBlob>& mom,
+                               const std::vector<float>& lr, const std::vector<float>& wd,
+                               const SGDParam& param);
+/*!
+ * \brief update the touched rows of a weight of shape (num_rows, ncol), see sgd_lazy
+ * \param mom the momentum, with a NULL dptr_ without momentum
+ */
+void call_sgd_lazy_update_cpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob mom,
+                              const TBlob coef, float lr, float wd, const SGDParam& param);
 #if MXNET_USE_CUDA
 void call_sgd_mom_update_gpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob mom,
                 float lr, float wd, const SGDParam& param);
 void call_sgd_update_gpu(RunContext ctx, TBlob weight, const TBlob grad,
                 float lr, float wd, const SGDParam& param);
+/*! \brief same as call_sgd_multi_update_cpu, one kernel launch for every few weights */
+void call_sgd_multi_update_gpu(RunContext ctx, const std::vector<TBlob>& weight,
+                               const std::vector<TBlob>& grad, const std::vector<TBlob>& mom,
+                               const std::vector<float>& lr, const std::vector<float>& wd,
+                               const SGDParam& param);
+void call_sgd_lazy_update_gpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob mom,
+                              const TBlob coef, float lr, float wd, const SGDParam& param);
 #endif  // MXNET_USE_CUDA
 
 #if DMLC_USE_CXX11
@@ -149,9 +199,131 @@ class SGDOpt : public Optimizer {
     }
   }
 
+  void UpdateMulti(const std::vector<int>& indices,
+                   const std::vector<NDArray*>& weights,
+                   const std::vector<const NDArray*>& grads,
+                   const std::vector<float>& lrs,
+                   const std::vector<float>& wds) override {
+    for (const std::vector<size_t>& group : GroupByContext(weights)) {
+      std::vector<NDArray> w, g, m;
+      std::vector<float> lr, wd;
+      std::vector<Engine::VarHandle> const_vars, mutable_vars;
+      for (size_t i : group) {
+        CreateState(indices[i], weights[i]);
+        w.push_back(*weights[i]);
+        g.push_back(*grads[i]);
+        lr.push_back(lrs[i]);
+        wd.push_back(wds[i]);
+        const_vars.push_back(g.back().var());
+        mutable_vars.push_back(w.back().var());
+        if (param_.momentum > 0.0f) {
+          m.push_back(mom[indices[i]]);
+          mutable_vars.push_back(m.back().var());
+        }
+      }
+      const Context ctx = w[0].ctx();
+      Engine::Get()->PushSync([this, w, g, m, lr, wd](RunContext rctx) {
+          std::vector<TBlob> wb, gb, mb;
+          for (size_t i = 0; i < w.size(); ++i) {
+            wb.push_back(w[i].data());
+            gb.push_back(g[i].data());
+            if (m.size() != 0) mb.push_back(m[i].data());
+          }
+          if (w[0].ctx().dev_mask() == cpu::kDevMask) {
+            call_sgd_multi_update_cpu(rctx, wb, gb, mb, lr, wd, param_);
+          } else {
+#if MXNET_USE_CUDA
+            call_sgd_multi_update_gpu(rctx, wb, gb, mb, lr, wd, param_);
+#else
+            LOG(FATAL) << "Please compile with CUDA enabled for cuda features";
+#endif  // MXNET_USE_CUDA
+          }
+        }, ctx, const_vars, mutable_vars, FnProperty::kNormal);
+    }
+  }
+
+  /*!
+   * \brief update the touched rows only. The weight decay and the momentum of
+   *  the steps a row is skipped are applied when it is touched again, with the
+   *  learning rate and the weight decay of that step, so that the cost is of
+   *  the number of touched rows. The weight should not be updated by Update too.
+   */
+  void UpdateRowSparse(const int index, NDArray *weight, const NDArray &row_ids,
+                       const NDArray *grad, const float lr, const float wd) override {
+    NDArray w = *weight, g = *grad;
+    CreateState(index, weight);
+    const index_t nrow = w.shape()[0];
+    std::vector<int>& last = last_step_[index];
+    if (last.size() != nrow) last.assign(nrow, 0);
+    const int step = ++num_update_[index];
+    // the row ids and the matrices of their skipped steps
+    row_ids.WaitToRead();
+    const real_t *ids = static_cast<const real_t*>(row_ids.data().dptr_);
+    const size_t n = row_ids.shape().Size();
+    CHECK_EQ(g.shape()[0], n) << "invalid row sparse gradient";
+    NDArray coef(mshadow::Shape2(n, 5), Context());
+    real_t *c = static_cast<real_t*>(coef.data().dptr_);
+    std::map<int, std::vector<double> > powers;
+    for (size_t i = 0; i < n; ++i) {
+      const index_t r = static_cast<index_t>(ids[i]);
+      CHECK_LT(r, nrow) << "row index out of range";
+      const int skipped = step - 1 - last[r];
+      last[r] = step;
+      auto it = powers.find(skipped);
+      if (it == powers.end()) {
+        it = powers.insert(std::make_pair(skipped, SkippedSteps(skipped, lr * wd))).first;
+      }
+      c[i * 5] = static_cast<real_t>(r);
+      for (int j = 0; j < 4; ++j) c[i * 5 + j + 1] = static_cast<real_t>(it->second[j]);
+    }
+    if (w.ctx() != coef.ctx()) {
+      NDArray copy(coef.shape(), w.ctx());
+      CopyFromTo(coef, &copy);
+      coef = copy;
+    }
+    NDArray m = param_.momentum > 0.0f ? mom[index] : NDArray();
+    std::vector<Engine::VarHandle> mutable_vars = {w.var()};
+    if (!m.is_none()) mutable_vars.push_back(m.var());
+    Engine::Get()->PushSync([this, w, g, m, coef, lr, wd](RunContext ctx) {
+        TBlob mb = m.is_none() ? TBlob() : m.data();
+        if (w.ctx().dev_mask() == cpu::kDevMask) {
+          call_sgd_lazy_update_cpu(ctx, w.data(), g.data(), mb, coef.data(), lr, wd, param_);
+        } else {
+#if MXNET_USE_CUDA
+          call_sgd_lazy_update_gpu(ctx, w.data(), g.data(), mb, coef.data(), lr, wd, param_);
+#else
+          LOG(FATAL) << "Please compile with CUDA enabled for cuda features";
+#endif  // MXNET_USE_CUDA
+        }
+      }, w.ctx(), {g.var(), coef.var()}, mutable_vars, FnProperty::kNormal);
+  }
+
  private:
   SGDParam param_;
   std::map<int, NDArray> mom;
+  /*! \brief the number of row sparse updates of each weight */
+  std::map<int, int> num_update_;
+  /*! \brief the last row sparse update of each row of each weight */
+  std::map<int, std::vector<int> > last_step_;
+
+  /*!
+   * \return the matrix A^k, row major, of k steps without gradient, in which
+   *  (mom, weight) = A (mom, weight) with A = [momentum, -a; momentum, 1 - a]
+   *  and a = lr * wd
+   */
+  std::vector<double> SkippedSteps(int k, double a) const {
+    const double mu = param_.momentum;
+    std::vector<double> res = {1, 0, 0, 1}, base = {mu, -a, mu, 1 - a};
+    auto mul = [](const std::vector<double>& x, const std::vector<double>& y) {
+      return std::vector<double>{x[0] * y[0] + x[1] * y[2], x[0] * y[1] + x[1] * y[3],
+                                 x[2] * y[0] + x[3] * y[2], x[2] * y[1] + x[3] * y[3]};
+    };
+    for (; k > 0; k >>= 1) {
+      if (k & 1) res = mul(res, base);
+      base = mul(base, base);
+    }
+    return res;
+  }
 };
 
 #endif  // DMLC_USE_CXX11
@@ -19,6 +19,32 @@ void call_sgd_update_cpu(RunContext ctx, TBlob weight, const TBlob grad,
   sgd_update<cpu>(ctx, weight, grad, lr, wd, param);
 }
 
+void call_sgd_multi_update_cpu(RunContext ctx, const std::vector<TBlob>& weight,
+                               const std::vector<TBlob>& grad, const std::vector<TBlob>& mom,
+                               const std::vector<float>& lr, const std::vector<float>& wd,
+                               const SGDParam& param) {
+  for (size_t i = 0; i < weight.size(); ++i) {
+    if (mom.size() != 0) {
+      sgd_mom_update<cpu>(ctx, weight[i], grad[i], mom[i], lr[i], wd[i], param);
+    } else {
+      sgd_update<cpu>(ctx, weight[i], grad[i], lr[i], wd[i], param);
+    }
+  }
+}
+
+void call_sgd_lazy_update_cpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob mom,
+                              const TBlob coef, float lr, float wd, const SGDParam& param) {
+  const int ncol = static_cast<int>(weight.shape_.Size() / weight.shape_[0]);
+  const int count = static_cast<int>(grad.shape_.Size());
+  real_t *m = static_cast<real_t*>(mom.dptr_);
+  for (int i = 0; i < count; ++i) {
+    sgd_lazy::Map(i, ncol, static_cast<real_t*>(weight.dptr_),
+                  static_cast<const real_t*>(grad.dptr_), m,
+                  static_cast<const real_t*>(coef.dptr_), lr, wd, param.momentum,
+                  param.rescale_grad, param.clip_gradient);
+  }
+}
+
 DMLC_REGISTER_PARAMETER(SGDParam);
 
 MXNET_REGISTER_OPTIMIZER(ccsgd, SGDOpt)
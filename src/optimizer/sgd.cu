@@ -3,6 +3,7 @@
  * \file sgd.cc
  * \brief sgd optimizer
 */
+#include <algorithm>
 #include "./sgd-inl.h"
 
 namespace mxnet {
@@ -17,5 +18,104 @@ void call_sgd_update_gpu(RunContext ctx, TBlob weight, const TBlob grad,
   sgd_update<gpu>(ctx, weight, grad, lr, wd, param);
 }
 
+/*! \brief the weights updated by one kernel launch */
+const int kMultiSGDMaxTensors = 32;
+
+struct MultiSGDParam {
+  real_t *weight[kMultiSGDMaxTensors];
+  const real_t *grad[kMultiSGDMaxTensors];
+  real_t *mom[kMultiSGDMaxTensors];
+  float lr[kMultiSGDMaxTensors];
+  float wd[kMultiSGDMaxTensors];
+  /*! \brief the offset of each weight in the elements of the launch */
+  int begin[kMultiSGDMaxTensors + 1];
+  int num;
+};
+
+// the same as sgd_update and sgd_mom_update, the mom pointers are not used
+// without momentum
+template<bool with_mom>
+__global__ void MultiSGDKernel(MultiSGDParam p, float momentum, float rescale_grad,
+                               float clip_gradient) {
+  for (int idx = blockIdx.x * blockDim.x + threadIdx.x; idx < p.begin[p.num];
+       idx += blockDim.x * gridDim.x) {
+    int t = 0;
+    while (idx >= p.begin[t + 1]) ++t;
+    const int j = idx - p.begin[t];
+    real_t g = p.grad[t][j];
+    real_t w = p.weight[t][j];
+    if (with_mom) {
+      if (clip_gradient > 0.0f) g = sgd_clip::Map(g, clip_gradient);
+      real_t m = momentum * p.mom[t][j] - p.lr[t] * (rescale_grad * g + p.wd[t] * w);
+      p.mom[t][j] = m;
+      p.weight[t][j] = w + m;
+    } else {
+      if (clip_gradient >= 0.0f) g = sgd_clip::Map(g, clip_gradient);
+      p.weight[t][j] = w - p.lr[t] * (rescale_grad * g + p.wd[t] * w);
+    }
+  }
+}
+
+void call_sgd_multi_update_gpu(RunContext ctx, const std::vector<TBlob>& weight,
+                               const std::vector<TBlob>& grad, const std::vector<TBlob>& mom,
+                               const std::vector<float>& lr, const std::vector<float>& wd,
+                               const SGDParam& param) {
+  using namespace mshadow::cuda;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(ctx.get_stream<gpu>());
+  const bool with_mom = mom.size() != 0;
+  for (size_t first = 0; first < weight.size(); first += kMultiSGDMaxTensors) {
+    MultiSGDParam p;
+    p.num = std::min(weight.size() - first, static_cast<size_t>(kMultiSGDMaxTensors));
+    p.begin[0] = 0;
+    for (int t = 0; t < p.num; ++t) {
+      const size_t i = first + t;
+      p.weight[t] = static_cast<real_t*>(weight[i].dptr_);
+      p.grad[t] = static_cast<const real_t*>(grad[i].dptr_);
+      p.mom[t] = with_mom ? static_cast<real_t*>(mom[i].dptr_) : NULL;
+      p.lr[t] = lr[i];
+      p.wd[t] = wd[i];
+      p.begin[t + 1] = p.begin[t] + static_cast<int>(weight[i].shape_.Size());
+    }
+    const int count = p.begin[p.num];
+    if (count == 0) continue;
+    const int grid = std::min(kMaxGridNum, (count + kBaseThreadNum - 1) / kBaseThreadNum);
+    if (with_mom) {
+      MultiSGDKernel<true><<<grid, kBaseThreadNum, 0, stream>>>(
+          p, param.momentum, param.rescale_grad, param.clip_gradient);
+    } else {
+      MultiSGDKernel<false><<<grid, kBaseThreadNum, 0, stream>>>(
+          p, param.momentum, param.rescale_grad, param.clip_gradient);
+    }
+    cudaError_t err = cudaPeekAtLastError();
+    CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+  }
+}
+
+__global__ void LazySGDKernel(int count, int ncol, real_t *weight, const real_t *grad,
+                              real_t *mom, const real_t *coef, float lr, float wd,
+                              float momentum, float rescale_grad, float clip_gradient) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < count;
+       i += blockDim.x * gridDim.x) {
+    sgd_lazy::Map(i, ncol, weight, grad, mom, coef, lr, wd, momentum, rescale_grad,
+                  clip_gradient);
+  }
+}
+
+void call_sgd_lazy_update_gpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob mom,
+                              const TBlob coef, float lr, float wd, const SGDParam& param) {
+  using namespace mshadow::cuda;
+  const int count = static_cast<int>(grad.shape_.Size());
+  if (count == 0) return;
+  const int ncol = static_cast<int>(weight.shape_.Size() / weight.shape_[0]);
+  const int grid = std::min(kMaxGridNum, (count + kBaseThreadNum - 1) / kBaseThreadNum);
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(ctx.get_stream<gpu>());
+  LazySGDKernel<<<grid, kBaseThreadNum, 0, stream>>>(
+      count, ncol, static_cast<real_t*>(weight.dptr_), static_cast<const real_t*>(grad.dptr_),
+      static_cast<real_t*>(mom.dptr_), static_cast<const real_t*>(coef.dptr_), lr, wd,
+      param.momentum, param.rescale_grad, param.clip_gradient);
+  cudaError_t err = cudaPeekAtLastError();
+  CHECK_EQ(err, cudaSuccess) << cudaGetErrorString(err);
+}
+
 }  // namespace opt
 }  // namespace mxnet
@@ -11,6 +11,12 @@
 #include <mxnet/storage.h>
 #include <limits>
 #include <atomic>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "./common/lazy_alloc_array.h"
 
 namespace mxnet {
@@ -20,6 +26,8 @@ namespace resource {
 struct SpaceAllocator {
   // internal context
   Context ctx;
+  // the engine variable the space is bound to
+  engine::VarHandle var{nullptr};
   // internal handle
   Storage::Handle handle;
   // internal CPU handle
@@ -29,6 +37,16 @@ struct SpaceAllocator {
   // This API allows several CUDA calls using
   // temp space to get valid space until all the calls finished.
   std::vector<Storage::Handle> old_handles;
+  // number of requests since the space was last checked for shrinking
+  int num_requests{0};
+  // the largest request since the space was last checked for shrinking
+  size_t max_request{0};
+  // number of requests between two checks, 0 never shrinks
+  int shrink_period{0};
+  // the bytes held by all the spaces of the device, or nullptr
+  std::shared_ptr<std::atomic<size_t> > total_bytes;
+  // called when an allocation fails, to release the other spaces
+  std::function<void()> on_pressure;
 
   SpaceAllocator() {
     handle.dptr = nullptr;
@@ -41,6 +59,7 @@ struct SpaceAllocator {
     for (const Storage::Handle& handle : old_handles) {
       if (handle.size != 0) {
         Storage::Get()->Free(handle);
+        if (total_bytes != nullptr) *total_bytes -= handle.size;
       }
     }
     old_handles.clear();
@@ -55,20 +74,70 @@ struct SpaceAllocator {
   }
 
   inline void* GetSpace(size_t size) {
+    this->Shrink(size);
     if (handle.size >= size) return handle.dptr;
-    old_handles.push_back(handle);
-    handle = Storage::Get()->Alloc(
-        std::max(size, handle.size * 2), ctx);
+    this->Retire(handle);
+    handle = this->Alloc(size, ctx);
     return handle.dptr;
   }
 
   inline void* GetHostSpace(size_t size) {
     if (host_handle.size >= size) return host_handle.dptr;
-    old_handles.push_back(host_handle);
-    host_handle = Storage::Get()->Alloc(
-        std::max(size, handle.size * 2), Context());
+    this->Retire(host_handle);
+    host_handle = this->Alloc(size, Context());
     return host_handle.dptr;
   }
+
+ private:
+  // allocate the exact size, releasing the other spaces of the device on failure
+  inline Storage::Handle Alloc(size_t size, Context alloc_ctx) {
+    Storage::Handle ret;
+    std::string origin;
+    if (Storage::TraceEnabled()) {
+      // the operator requesting the space, when it is known
+      const char* op = Storage::GetAllocOrigin();
+      origin = op != nullptr ? std::string("workspace/") + op : "workspace";
+    }
+    Storage::AllocOriginScope scope(origin.size() != 0 ? origin.c_str() : nullptr);
+    try {
+      ret = Storage::Get()->Alloc(size, alloc_ctx);
+    } catch (const dmlc::Error& e) {
+      if (!on_pressure) throw;
+      LOG(INFO) << "temp space allocation of " << size << " bytes failed, "
+                << "releasing the idle temp spaces of " << ctx;
+      on_pressure();
+      ret = Storage::Get()->Alloc(size, alloc_ctx);
+    }
+    if (total_bytes != nullptr) *total_bytes += ret.size;
+    return ret;
+  }
+  // free a replaced handle once the operation using it completes
+  inline void Retire(const Storage::Handle& old) {
+    if (old.size == 0) return;
+    if (var == nullptr) {
+      old_handles.push_back(old);
+      return;
+    }
+    std::shared_ptr<std::atomic<size_t> > bytes = total_bytes;
+    // freed by the host, after the kernels of a stream ordered engine are done
+    Engine::Get()->PushSync([old, bytes](RunContext) {
+        Storage::Get()->Free(old);
+        if (bytes != nullptr) *bytes -= old.size;
+      }, Context::CPU(), {}, {var}, FnProperty::kNormal, 0, "ReleaseTempSpace");
+  }
+  // drop the space if it is much bigger than the recent requests
+  inline void Shrink(size_t size) {
+    if (shrink_period == 0) return;
+    max_request = std::max(max_request, size);
+    if (++num_requests < shrink_period) return;
+    if (handle.size > 2 * max_request) {
+      this->Retire(handle);
+      handle.dptr = nullptr;
+      handle.size = 0;
+    }
+    num_requests = 0;
+    max_request = 0;
+  }
 };
 
 
@@ -79,20 +148,27 @@ class ResourceManagerImpl : public ResourceManager {
       : global_seed_(0) {
     cpu_temp_space_copy_ = dmlc::GetEnv("MXNET_CPU_TEMP_COPY", 16);
     gpu_temp_space_copy_ = dmlc::GetEnv("MXNET_GPU_TEMP_COPY", 4);
+    temp_space_shrink_period_ = dmlc::GetEnv("MXNET_TEMP_SPACE_SHRINK_PERIOD", 64);
+    cpu_parallel_rand_copy_ = dmlc::GetEnv("MXNET_CPU_PARALLEL_RAND_COPY", 4);
+    gpu_parallel_rand_copy_ = dmlc::GetEnv("MXNET_GPU_PARALLEL_RAND_COPY", 4);
     engine_ref_ = Engine::_GetSharedRef();
     storage_ref_ = Storage::_GetSharedRef();
     cpu_rand_.reset(new ResourceRandom<cpu>(
         Context::CPU(), global_seed_));
     cpu_space_.reset(new ResourceTempSpace(
-        Context::CPU(), cpu_temp_space_copy_));
+        Context::CPU(), cpu_temp_space_copy_, temp_space_shrink_period_));
+    cpu_parallel_rand_.reset(new ResourceParallelRandom(
+        Context::CPU(), cpu_parallel_rand_copy_, global_seed_));
   }
   ~ResourceManagerImpl() {
     // need explicit delete, before engine get killed
     cpu_rand_.reset(nullptr);
     cpu_space_.reset(nullptr);
+    cpu_parallel_rand_.reset(nullptr);
 #if MXNET_USE_CUDA
     gpu_rand_.Clear();
     gpu_space_.Clear();
+    gpu_parallel_rand_.Clear();
 #endif
     if (engine_ref_ != nullptr) {
       engine_ref_ = nullptr;
@@ -108,6 +184,7 @@ class ResourceManagerImpl : public ResourceManager {
       switch (req.type) {
         case ResourceRequest::kRandom: return cpu_rand_->resource;
         case ResourceRequest::kTempSpace: return cpu_space_->GetNext();
+        case ResourceRequest::kParallelRandom: return cpu_parallel_rand_->GetNext();
         default: LOG(FATAL) << "Unknown supported type " << req.type;
       }
     } else {
@@ -121,7 +198,13 @@ class ResourceManagerImpl : public ResourceManager {
         }
         case ResourceRequest::kTempSpace: {
           return gpu_space_.Get(ctx.dev_id, [ctx, this]() {
-              return new ResourceTempSpace(ctx, gpu_temp_space_copy_);
+              return new ResourceTempSpace(ctx, gpu_temp_space_copy_,
+                                           temp_space_shrink_period_);
+            })->GetNext();
+        }
+        case ResourceRequest::kParallelRandom: {
+          return gpu_parallel_rand_.Get(ctx.dev_id, [ctx, this]() {
+              return new ResourceParallelRandom(ctx, gpu_parallel_rand_copy_, global_seed_);
             })->GetNext();
         }
         default: LOG(FATAL) << "Unknown supported type " << req.type;
@@ -137,13 +220,29 @@ class ResourceManagerImpl : public ResourceManager {
   void SeedRandom(uint32_t seed) override {
     global_seed_ = seed;
     cpu_rand_->Seed(global_seed_);
+    cpu_parallel_rand_->Seed(global_seed_);
 #if MXNET_USE_CUDA
     gpu_rand_.ForEach([seed](size_t i, ResourceRandom<gpu> *p) {
         p->Seed(seed);
       });
+    gpu_parallel_rand_.ForEach([seed](size_t i, ResourceParallelRandom *p) {
+        p->Seed(seed);
+      });
 #endif
   }
 
+  void ReleaseTempSpace(Context ctx) override {
+    ResourceTempSpace* space = this->TempSpace(ctx);
+    if (space != nullptr) space->ReleaseIdle(-1);
+  }
+
+  void GetTempSpaceStats(Context ctx, size_t* bytes, int* num_bound) override {
+    ResourceTempSpace* space = this->TempSpace(ctx);
+    *bytes = 0;
+    *num_bound = 0;
+    if (space != nullptr) space->GetStats(bytes, num_bound);
+  }
+
  private:
   /*! \brief Maximum number of GPUs */
   static constexpr std::size_t kMaxNumGPUs = 16;
@@ -185,54 +284,149 @@ class ResourceManagerImpl : public ResourceManager {
     }
   };
 
+  // the counter based random number resources, the copies do not share any state
+  struct ResourceParallelRandom {
+    /*! \brief the context of the device */
+    Context ctx;
+    /*! \brief the state of each copy */
+    std::vector<ParallelRandomState*> state;
+    /*! \brief resource representation */
+    std::vector<Resource> resource;
+    /*! \brief current pointer to the round robin copies */
+    std::atomic<size_t> curr_ptr;
+    /*! \brief constructor */
+    explicit ResourceParallelRandom(Context ctx, size_t ncopy, uint32_t global_seed)
+        : ctx(ctx), state(ncopy), resource(ncopy), curr_ptr(0) {
+      for (size_t i = 0; i < state.size(); ++i) {
+        state[i] = new ParallelRandomState();
+        state[i]->stream = static_cast<uint32_t>(i);
+        SetKey(ctx, global_seed, state[i]);
+        resource[i].var = Engine::Get()->NewVariable();
+        resource[i].id = static_cast<int32_t>(i);
+        resource[i].ptr_ = state[i];
+        resource[i].req = ResourceRequest(ResourceRequest::kParallelRandom);
+      }
+    }
+    ~ResourceParallelRandom() {
+      for (size_t i = 0; i < state.size(); ++i) {
+        ParallelRandomState *r = state[i];
+        Engine::Get()->DeleteVariable([r](RunContext rctx) {
+            delete r;
+          }, ctx, resource[i].var);
+      }
+    }
+    // the numbers of a copy only depend on the seed, the device and the copy
+    inline static void SetKey(Context ctx, uint32_t global_seed, ParallelRandomState *s) {
+      s->key[0] = ctx.dev_id + global_seed * kRandMagic;
+      s->key[1] = static_cast<uint32_t>(ctx.dev_type);
+      s->counter = 0;
+    }
+    // restart every copy at the beginning of the sequence of the seed
+    inline void Seed(uint32_t global_seed) {
+      for (size_t i = 0; i < state.size(); ++i) {
+        ParallelRandomState *r = state[i];
+        Context rctx = ctx;
+        Engine::Get()->PushSync([rctx, r, global_seed](RunContext) {
+            SetKey(rctx, global_seed, r);
+          }, ctx, {}, {resource[i].var});
+      }
+    }
+    // get next resource in round roubin matter
+    inline Resource GetNext() {
+      return resource[curr_ptr++ % resource.size()];
+    }
+  };
+
   // temporal space resource.
   struct ResourceTempSpace {
     /*! \brief the context of the device */
     Context ctx;
-    /*! \brief the underlying space */
-    std::vector<SpaceAllocator> space;
+    /*! \brief the underlying space, shared with the pending releases */
+    std::vector<std::shared_ptr<SpaceAllocator> > space;
     /*! \brief resource representation */
     std::vector<Resource> resource;
-    /*! \brief current pointer to the round roubin alloator */
-    std::atomic<size_t> curr_ptr;
+    /*! \brief number of requests bound to each space */
+    std::vector<int> num_bound;
+    /*! \brief the bytes held by all the spaces */
+    std::shared_ptr<std::atomic<size_t> > total_bytes;
+    /*! \brief mutex of num_bound */
+    std::mutex mutex;
     /*! \brief constructor */
-    explicit ResourceTempSpace(Context ctx, size_t ncopy)
-        : ctx(ctx), space(ncopy), resource(ncopy), curr_ptr(0) {
+    explicit ResourceTempSpace(Context ctx, size_t ncopy, int shrink_period)
+        : ctx(ctx), space(ncopy), resource(ncopy), num_bound(ncopy, 0),
+          total_bytes(std::make_shared<std::atomic<size_t> >(0)) {
       for (size_t i = 0; i < space.size(); ++i) {
+        space[i] = std::make_shared<SpaceAllocator>();
         resource[i].var = Engine::Get()->NewVariable();
         resource[i].id = static_cast<int32_t>(i);
-        resource[i].ptr_ = &space[i];
+        resource[i].ptr_ = space[i].get();
         resource[i].req = ResourceRequest(ResourceRequest::kTempSpace);
-        space[i].ctx = ctx;
-        CHECK_EQ(space[i].handle.size, 0);
+        space[i]->ctx = ctx;
+        space[i]->var = resource[i].var;
+        space[i]->shrink_period = shrink_period;
+        space[i]->total_bytes = total_bytes;
+        space[i]->on_pressure = [this, i]() { this->ReleaseIdle(static_cast<int>(i)); };
+        CHECK_EQ(space[i]->handle.size, 0);
       }
     }
     ~ResourceTempSpace() {
       for (size_t i = 0; i < space.size(); ++i) {
-        SpaceAllocator r = space[i];
+        std::shared_ptr<SpaceAllocator> r = space[i];
         Engine::Get()->DeleteVariable(
             [r](RunContext rctx){
-              SpaceAllocator rcpy = r;
-              MSHADOW_CATCH_ERROR(rcpy.ReleaseAll());
+              MSHADOW_CATCH_ERROR(r->ReleaseAll());
             }, ctx, resource[i].var);
       }
     }
-    // get next resource in round roubin matter
+    // get the space with the fewest requests bound to it, so that the
+    // spaces are only allocated when the earlier ones are all shared
     inline Resource GetNext() {
-      const size_t kMaxDigit = std::numeric_limits<size_t>::max() / 2;
-      size_t ptr = ++curr_ptr;
-      // reset ptr to avoid undefined behavior during overflow
-      // usually this won't happen
-      if (ptr > kMaxDigit) {
-        curr_ptr.store((ptr + 1) % space.size());
+      std::lock_guard<std::mutex> lock(mutex);
+      size_t best = std::min_element(num_bound.begin(), num_bound.end()) - num_bound.begin();
+      ++num_bound[best];
+      return resource[best];
+    }
+    // free all the spaces except the one of index skip, after the operations using them
+    inline void ReleaseIdle(int skip) {
+      for (size_t i = 0; i < space.size(); ++i) {
+        if (static_cast<int>(i) == skip) continue;
+        std::shared_ptr<SpaceAllocator> r = space[i];
+        Engine::Get()->PushSync([r](RunContext) {
+            r->ReleaseAll();
+          }, ctx, {}, {resource[i].var}, FnProperty::kNormal, 0, "ReleaseTempSpace");
       }
-      return resource[ptr % space.size()];
+    }
+    // the bytes held and the number of spaces bound to a request
+    inline void GetStats(size_t* bytes, int* nbound) {
+      std::lock_guard<std::mutex> lock(mutex);
+      *bytes = total_bytes->load();
+      *nbound = static_cast<int>(
+          num_bound.size() - std::count(num_bound.begin(), num_bound.end(), 0));
     }
   };
+  // the temp space resources of a context, or nullptr if none was requested
+  inline ResourceTempSpace* TempSpace(Context ctx) {
+    if (ctx.dev_mask() == cpu::kDevMask) return cpu_space_.get();
+#if MXNET_USE_CUDA
+    ResourceTempSpace* ret = nullptr;
+    gpu_space_.ForEach([ctx, &ret](size_t i, ResourceTempSpace* p) {
+        if (static_cast<int>(i) == ctx.dev_id) ret = p;
+      });
+    return ret;
+#else
+    return nullptr;
+#endif
+  }
   /*! \brief number of copies in CPU temp space */
   int cpu_temp_space_copy_;
   /*! \brief number of copies in GPU temp space */
   int gpu_temp_space_copy_;
+  /*! \brief number of requests of a temp space between two checks for shrinking */
+  int temp_space_shrink_period_;
+  /*! \brief number of copies of the CPU counter based random numbers */
+  int cpu_parallel_rand_copy_;
+  /*! \brief number of copies of the GPU counter based random numbers */
+  int gpu_parallel_rand_copy_;
   /*! \brief Reference to the engine */
   std::shared_ptr<Engine> engine_ref_;
   /*! \brief Reference to the storage */
@@ -243,11 +437,15 @@ class ResourceManagerImpl : public ResourceManager {
   std::unique_ptr<ResourceRandom<cpu> > cpu_rand_;
   /*! \brief CPU temp space resources */
   std::unique_ptr<ResourceTempSpace> cpu_space_;
+  /*! \brief CPU counter based random number resources */
+  std::unique_ptr<ResourceParallelRandom> cpu_parallel_rand_;
 #if MXNET_USE_CUDA
   /*! \brief random number generator for GPU */
   common::LazyAllocArray<ResourceRandom<gpu> > gpu_rand_;
   /*! \brief temp space for GPU */
   common::LazyAllocArray<ResourceTempSpace> gpu_space_;
+  /*! \brief counter based random numbers for GPU */
+  common::LazyAllocArray<ResourceParallelRandom> gpu_parallel_rand_;
 #endif
 };
 }  // namespace resource
@@ -0,0 +1,236 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file arena_storage_manager.h
+ * \brief Storage manager that serves all requests from one region reserved up front.
+ */
+#ifndef MXNET_STORAGE_ARENA_STORAGE_MANAGER_H_
+#define MXNET_STORAGE_ARENA_STORAGE_MANAGER_H_
+
+#include <dmlc/logging.h>
+#include <mxnet/base.h>
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "./storage_manager.h"
+
+namespace mxnet {
+namespace storage {
+
+/*!
+ * \brief Storage manager that reserves one region of the device when it is
+ *  created and sub-allocates all requests from it, so that the steady state
+ *  of training never goes to the device allocator.
+ *
+ *  A request takes the smallest free block that fits, split when bigger, and
+ *  freed blocks are coalesced with their free neighbours. A request that no
+ *  free block fits falls back to the device, with a warning the first time.
+ */
+template <class DeviceStorage>
+class ArenaStorageManager final : public StorageManager {
+ public:
+  /*!
+   * \brief constructor
+   * \param capacity bytes to reserve.
+   */
+  explicit ArenaStorageManager(size_t capacity) {
+    capacity_ = capacity / kAlign * kAlign;
+    CHECK_GT(capacity_, 0U) << "the arena must reserve some memory";
+    base_ = static_cast<char*>(DeviceStorage::Alloc(capacity_));
+    Block* blk = new Block();
+    blk->ptr = base_;
+    blk->size = capacity_;
+    blk->free = true;
+    blk->prev = nullptr;
+    blk->next = nullptr;
+    free_.insert(std::make_pair(blk->size, blk));
+    cached_ = capacity_;
+  }
+  ~ArenaStorageManager() {
+    for (auto&& kv : overflow_) DeviceStorage::Free(kv.first);
+    for (auto&& kv : used_blocks_) delete kv.second;
+    for (auto&& kv : free_) delete kv.second;
+    DeviceStorage::Free(base_);
+  }
+  void* Alloc(size_t size) override;
+  void Free(void* ptr, size_t size) override;
+  void FreeBatch(const std::vector<std::pair<void*, size_t> >& blocks) override;
+  void GetStats(size_t* used, size_t* cached, size_t* wasted) override;
+  void GetArenaStats(size_t* capacity, size_t* free,
+                     size_t* largest_free, size_t* overflow) override;
+
+ private:
+  /*! \brief a block of the arena */
+  struct Block {
+    /*! \brief address of the block */
+    char* ptr;
+    /*! \brief size of the block */
+    size_t size;
+    /*! \brief whether the block is free */
+    bool free;
+    /*! \brief neighbours in the arena */
+    Block* prev;
+    Block* next;
+  };
+  /*! \brief alignment of blocks */
+  static constexpr size_t kAlign = 512;
+  /*! \brief round up to multiple of align */
+  static inline size_t RoundUp(size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+  }
+  /*! \return whether ptr is inside the arena */
+  inline bool InArena(void* ptr) const {
+    return ptr >= base_ && ptr < base_ + capacity_;
+  }
+  void FreeUnlocked(void* ptr, size_t size);
+  // internal mutex
+  std::mutex mutex_;
+  // start of the arena
+  char* base_;
+  // size of the arena
+  size_t capacity_;
+  // bytes handed out, as requested, including the overflow
+  size_t used_ = 0;
+  // bytes free in the arena
+  size_t cached_ = 0;
+  // bytes lost by rounding of handed out blocks
+  size_t wasted_ = 0;
+  // free blocks, ordered by size for best fit
+  std::set<std::pair<size_t, Block*> > free_;
+  // blocks handed out
+  std::unordered_map<void*, Block*> used_blocks_;
+  // blocks allocated from the device once the arena is full, and their size
+  std::unordered_map<void*, size_t> overflow_;
+  // bytes of overflow_
+  size_t overflow_bytes_ = 0;
+  // whether the overflow was reported
+  bool warned_ = false;
+  DISALLOW_COPY_AND_ASSIGN(ArenaStorageManager);
+};  // class ArenaStorageManager
+
+template <class DeviceStorage>
+void* ArenaStorageManager<DeviceStorage>::Alloc(size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t rsize = RoundUp(std::max<size_t>(size, 1), kAlign);
+  auto it = free_.lower_bound(std::make_pair(rsize, static_cast<Block*>(nullptr)));
+  if (it == free_.end()) {
+    if (!warned_) {
+      LOG(WARNING) << "the memory arena of " << capacity_ << " bytes has no free block of "
+                   << rsize << " bytes, " << cached_ << " bytes are free in it, "
+                   << "allocating from the device";
+      warned_ = true;
+    }
+    void* ret = nullptr;
+    try {
+      ret = DeviceStorage::Alloc(size);
+    } catch (const std::bad_alloc& e) {
+      LOG(FATAL) << "Memory allocation failed.";
+    }
+    overflow_[ret] = size;
+    overflow_bytes_ += size;
+    used_ += size;
+    return ret;
+  }
+  Block* blk = it->second;
+  free_.erase(it);
+  cached_ -= blk->size;
+  if (blk->size - rsize >= kAlign) {
+    Block* rest = new Block();
+    rest->ptr = blk->ptr + rsize;
+    rest->size = blk->size - rsize;
+    rest->free = true;
+    rest->prev = blk;
+    rest->next = blk->next;
+    if (blk->next != nullptr) blk->next->prev = rest;
+    blk->next = rest;
+    blk->size = rsize;
+    free_.insert(std::make_pair(rest->size, rest));
+    cached_ += rest->size;
+  }
+  blk->free = false;
+  used_blocks_[blk->ptr] = blk;
+  used_ += size;
+  wasted_ += blk->size - size;
+  return blk->ptr;
+}
+
+template <class DeviceStorage>
+void ArenaStorageManager<DeviceStorage>::Free(void* ptr, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FreeUnlocked(ptr, size);
+}
+
+template <class DeviceStorage>
+void ArenaStorageManager<DeviceStorage>::FreeBatch(
+    const std::vector<std::pair<void*, size_t> >& blocks) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto&& b : blocks) FreeUnlocked(b.first, b.second);
+}
+
+template <class DeviceStorage>
+void ArenaStorageManager<DeviceStorage>::FreeUnlocked(void* ptr, size_t size) {
+  if (!InArena(ptr)) {
+    auto it = overflow_.find(ptr);
+    CHECK(it != overflow_.end()) << "Free a block that is not allocated";
+    DeviceStorage::Free(ptr);
+    overflow_bytes_ -= it->second;
+    used_ -= it->second;
+    overflow_.erase(it);
+    return;
+  }
+  auto it = used_blocks_.find(ptr);
+  CHECK(it != used_blocks_.end()) << "Free a block that is not allocated";
+  Block* blk = it->second;
+  used_blocks_.erase(it);
+  used_ -= size;
+  wasted_ -= blk->size - size;
+  cached_ += blk->size;
+  blk->free = true;
+  // coalesce with next
+  Block* next = blk->next;
+  if (next != nullptr && next->free) {
+    free_.erase(std::make_pair(next->size, next));
+    blk->size += next->size;
+    blk->next = next->next;
+    if (next->next != nullptr) next->next->prev = blk;
+    delete next;
+  }
+  // coalesce with prev
+  Block* prev = blk->prev;
+  if (prev != nullptr && prev->free) {
+    free_.erase(std::make_pair(prev->size, prev));
+    prev->size += blk->size;
+    prev->next = blk->next;
+    if (blk->next != nullptr) blk->next->prev = prev;
+    delete blk;
+    blk = prev;
+  }
+  free_.insert(std::make_pair(blk->size, blk));
+}
+
+template <class DeviceStorage>
+void ArenaStorageManager<DeviceStorage>::GetStats(
+    size_t* used, size_t* cached, size_t* wasted) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  *used = used_;
+  *cached = cached_;
+  *wasted = wasted_;
+}
+
+template <class DeviceStorage>
+void ArenaStorageManager<DeviceStorage>::GetArenaStats(
+    size_t* capacity, size_t* free, size_t* largest_free, size_t* overflow) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  *capacity = capacity_;
+  *free = cached_;
+  *largest_free = free_.size() != 0 ? free_.rbegin()->first : 0;
+  *overflow = overflow_bytes_;
+}
+
+}  // namespace storage
+}  // namespace mxnet
+
+#endif  // MXNET_STORAGE_ARENA_STORAGE_MANAGER_H_
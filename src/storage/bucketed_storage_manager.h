@@ -0,0 +1,275 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file bucketed_storage_manager.h
+ * \brief Storage manager that pools memory by size classes.
+ */
+#ifndef MXNET_STORAGE_BUCKETED_STORAGE_MANAGER_H_
+#define MXNET_STORAGE_BUCKETED_STORAGE_MANAGER_H_
+
+#include <dmlc/logging.h>
+#include <mxnet/base.h>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <new>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "./storage_manager.h"
+
+namespace mxnet {
+namespace storage {
+
+/*!
+ * \brief Storage manager with a memory pool bucketed by size classes.
+ *
+ *  Small requests are rounded up to a geometric size class
+ *  (power-of-two, or any factor such as 1.25), so that blocks of
+ *  similar size can be reused by each other.
+ *
+ *  Large requests are served from device segments by best fit.
+ *  A free block bigger than needed is split, and freed blocks are
+ *  coalesced with their free neighbours in the same segment.
+ */
+template <class DeviceStorage>
+class BucketedStorageManager final : public StorageManager {
+ public:
+  /*!
+   * \brief constructor
+   * \param round_factor growth factor between consecutive size classes.
+   * \param large_block requests of at least this size use split and coalesce.
+   */
+  BucketedStorageManager(double round_factor, size_t large_block)
+      : round_factor_(round_factor), large_block_(large_block) {
+    CHECK_GT(round_factor_, 1.0) << "size class factor must be bigger than 1";
+    CHECK_GE(large_block_, static_cast<size_t>(kMinSize));
+  }
+  ~BucketedStorageManager() {
+    ReleaseAll();
+  }
+  void* Alloc(size_t size) override;
+  void Free(void* ptr, size_t size) override;
+  void FreeBatch(const std::vector<std::pair<void*, size_t> >& blocks) override;
+  void GetStats(size_t* used, size_t* cached, size_t* wasted) override;
+
+ private:
+  /*! \brief a block inside a large segment */
+  struct Block {
+    /*! \brief address of the block */
+    char* ptr;
+    /*! \brief size of the block */
+    size_t size;
+    /*! \brief whether the block is free */
+    bool free;
+    /*! \brief neighbours in the same segment */
+    Block* prev;
+    Block* next;
+  };
+  /*! \brief minimum size class */
+  static constexpr size_t kMinSize = 512;
+  /*! \brief alignment of blocks */
+  static constexpr size_t kAlign = 512;
+  /*! \brief allocation granularity of large segments */
+  static constexpr size_t kSegmentAlign = 2 << 20;
+  /*! \brief round up to multiple of align */
+  static inline size_t RoundUp(size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+  }
+  /*! \return the size class of a small request */
+  inline size_t SizeClass(size_t size) const {
+    size_t c = kMinSize;
+    while (c < size) {
+      size_t next = RoundUp(static_cast<size_t>(std::ceil(c * round_factor_)), kAlign);
+      c = std::max(next, c + kAlign);
+    }
+    return c;
+  }
+  /*! \brief allocate from device, release cache and retry on failure */
+  inline void* DeviceAlloc(size_t size) {
+    for (int i = 0; i < 2; ++i) {
+      try {
+        return DeviceStorage::Alloc(size);
+      } catch (const std::bad_alloc& e) {
+        ReleaseAll();
+      }
+    }
+    LOG(FATAL) << "Memory allocation failed.";
+    return NULL;
+  }
+  void FreeUnlocked(void* ptr, size_t size);
+  void* AllocLarge(size_t size);
+  void FreeLarge(void* ptr, size_t size);
+  void ReleaseAll();
+  /*! \brief growth factor of size classes */
+  double round_factor_;
+  /*! \brief threshold of large requests */
+  size_t large_block_;
+  // internal mutex
+  std::mutex mutex_;
+  // bytes handed out, as requested
+  size_t used_ = 0;
+  // bytes free in the pool
+  size_t cached_ = 0;
+  // bytes lost by rounding of handed out blocks
+  size_t wasted_ = 0;
+  // free small blocks, indexed by size class
+  std::unordered_map<size_t, std::vector<void*> > small_pool_;
+  // free large blocks, ordered by size for best fit
+  std::set<std::pair<size_t, Block*> > large_free_;
+  // large blocks handed out
+  std::unordered_map<void*, Block*> large_used_;
+  DISALLOW_COPY_AND_ASSIGN(BucketedStorageManager);
+};  // class BucketedStorageManager
+
+template <class DeviceStorage>
+void* BucketedStorageManager<DeviceStorage>::Alloc(size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (size >= large_block_) return AllocLarge(size);
+  size_t csize = SizeClass(size);
+  void* ret;
+  auto&& pool = small_pool_[csize];
+  if (pool.size() != 0) {
+    ret = pool.back();
+    pool.pop_back();
+    cached_ -= csize;
+  } else {
+    ret = DeviceAlloc(csize);
+  }
+  used_ += size;
+  wasted_ += csize - size;
+  return ret;
+}
+
+template <class DeviceStorage>
+void BucketedStorageManager<DeviceStorage>::Free(void* ptr, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FreeUnlocked(ptr, size);
+}
+
+template <class DeviceStorage>
+void BucketedStorageManager<DeviceStorage>::FreeBatch(
+    const std::vector<std::pair<void*, size_t> >& blocks) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto&& b : blocks) FreeUnlocked(b.first, b.second);
+}
+
+template <class DeviceStorage>
+void BucketedStorageManager<DeviceStorage>::FreeUnlocked(void* ptr, size_t size) {
+  if (size >= large_block_) {
+    FreeLarge(ptr, size);
+    return;
+  }
+  size_t csize = SizeClass(size);
+  small_pool_[csize].push_back(ptr);
+  used_ -= size;
+  wasted_ -= csize - size;
+  cached_ += csize;
+}
+
+template <class DeviceStorage>
+void* BucketedStorageManager<DeviceStorage>::AllocLarge(size_t size) {
+  size_t rsize = RoundUp(size, kAlign);
+  Block* blk;
+  auto it = large_free_.lower_bound(std::make_pair(rsize, static_cast<Block*>(nullptr)));
+  if (it != large_free_.end()) {
+    blk = it->second;
+    large_free_.erase(it);
+    cached_ -= blk->size;
+  } else {
+    size_t seg_size = RoundUp(rsize, kSegmentAlign);
+    blk = new Block();
+    blk->ptr = static_cast<char*>(DeviceAlloc(seg_size));
+    blk->size = seg_size;
+    blk->prev = nullptr;
+    blk->next = nullptr;
+  }
+  // split if the remainder is still a large block
+  if (blk->size - rsize >= large_block_) {
+    Block* rest = new Block();
+    rest->ptr = blk->ptr + rsize;
+    rest->size = blk->size - rsize;
+    rest->free = true;
+    rest->prev = blk;
+    rest->next = blk->next;
+    if (blk->next != nullptr) blk->next->prev = rest;
+    blk->next = rest;
+    blk->size = rsize;
+    large_free_.insert(std::make_pair(rest->size, rest));
+    cached_ += rest->size;
+  }
+  blk->free = false;
+  large_used_[blk->ptr] = blk;
+  used_ += size;
+  wasted_ += blk->size - size;
+  return blk->ptr;
+}
+
+template <class DeviceStorage>
+void BucketedStorageManager<DeviceStorage>::FreeLarge(void* ptr, size_t size) {
+  auto it = large_used_.find(ptr);
+  CHECK(it != large_used_.end()) << "Free a block that is not allocated";
+  Block* blk = it->second;
+  large_used_.erase(it);
+  used_ -= size;
+  wasted_ -= blk->size - size;
+  cached_ += blk->size;
+  blk->free = true;
+  // coalesce with next
+  Block* next = blk->next;
+  if (next != nullptr && next->free) {
+    large_free_.erase(std::make_pair(next->size, next));
+    blk->size += next->size;
+    blk->next = next->next;
+    if (next->next != nullptr) next->next->prev = blk;
+    delete next;
+  }
+  // coalesce with prev
+  Block* prev = blk->prev;
+  if (prev != nullptr && prev->free) {
+    large_free_.erase(std::make_pair(prev->size, prev));
+    prev->size += blk->size;
+    prev->next = blk->next;
+    if (blk->next != nullptr) blk->next->prev = prev;
+    delete blk;
+    blk = prev;
+  }
+  large_free_.insert(std::make_pair(blk->size, blk));
+}
+
+template <class DeviceStorage>
+void BucketedStorageManager<DeviceStorage>::GetStats(
+    size_t* used, size_t* cached, size_t* wasted) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  *used = used_;
+  *cached = cached_;
+  *wasted = wasted_;
+}
+
+template <class DeviceStorage>
+void BucketedStorageManager<DeviceStorage>::ReleaseAll() {
+  for (auto&& i : small_pool_) {
+    for (auto&& j : i.second) {
+      DeviceStorage::Free(j);
+      cached_ -= i.first;
+    }
+  }
+  small_pool_.clear();
+  // only whole segments that are entirely free can be returned.
+  for (auto it = large_free_.begin(); it != large_free_.end();) {
+    Block* blk = it->second;
+    if (blk->prev == nullptr && blk->next == nullptr) {
+      DeviceStorage::Free(blk->ptr);
+      cached_ -= blk->size;
+      delete blk;
+      it = large_free_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace storage
+}  // namespace mxnet
+
+#endif  // MXNET_STORAGE_BUCKETED_STORAGE_MANAGER_H_
@@ -7,15 +7,24 @@
 #define MXNET_STORAGE_CPU_DEVICE_STORAGE_H_
 
 #include <dmlc/logging.h>
+#include <dmlc/parameter.h>
 #include <cstdlib>
 #include <new>
 #include "mxnet/base.h"
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif  // defined(__linux__)
+
 namespace mxnet {
 namespace storage {
 
 /*!
  * \brief CPU storage implementation.
+ *
+ *  Blocks are aligned for AVX-512 loads. Blocks of at least
+ *  MXNET_CPU_HUGE_PAGE_THRESHOLD bytes are aligned to huge pages and
+ *  advised to be backed by them, which saves the TLB misses of 4K pages.
  */
 class CPUDeviceStorage {
  public:
@@ -35,7 +44,18 @@ class CPUDeviceStorage {
   /*!
    * \brief Alignment of allocation.
    */
-  static constexpr size_t alignment_ = 16;
+  static constexpr size_t alignment_ = 64;
+  /*!
+   * \brief Size of a transparent huge page, the alignment of the blocks backed by them.
+   */
+  static constexpr size_t huge_page_size_ = 2 << 20;
+  /*!
+   * \return the smallest block backed by huge pages, 0 to disable them.
+   */
+  inline static size_t HugePageThreshold() {
+    static size_t threshold = dmlc::GetEnv("MXNET_CPU_HUGE_PAGE_THRESHOLD", huge_page_size_);
+    return threshold;
+  }
 };  // class CPUDeviceStorage
 
 inline void* CPUDeviceStorage::Alloc(size_t size) {
@@ -44,8 +64,15 @@ inline void* CPUDeviceStorage::Alloc(size_t size) {
   ptr = _aligned_malloc(size, alignment_);
   if (ptr == NULL) throw std::bad_alloc();
 #else
-  int ret = posix_memalign(&ptr, alignment_, size);
+  const size_t threshold = HugePageThreshold();
+  const bool huge = threshold != 0 && size >= threshold;
+  int ret = posix_memalign(&ptr, huge ? huge_page_size_ : alignment_, size);
   if (ret != 0) throw std::bad_alloc();
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  // only whole huge pages, the tail may share a page with other blocks
+  const size_t huge_size = size / huge_page_size_ * huge_page_size_;
+  if (huge && huge_size != 0) madvise(ptr, huge_size, MADV_HUGEPAGE);
+#endif  // defined(__linux__) && defined(MADV_HUGEPAGE)
 #endif
   return ptr;
 }
@@ -0,0 +1,99 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file numa_storage_manager.h
+ * \brief Storage manager that places host memory on a NUMA node.
+ */
+#ifndef MXNET_STORAGE_NUMA_STORAGE_MANAGER_H_
+#define MXNET_STORAGE_NUMA_STORAGE_MANAGER_H_
+
+#include <mxnet/base.h>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "./storage_manager.h"
+#include "../common/numa.h"
+
+namespace mxnet {
+namespace storage {
+
+/*!
+ * \brief Storage manager that asks the kernel to place the pages of
+ *  blocks allocated by the base manager on one NUMA node.
+ *
+ *  Pages get their node on first touch, so the policy only affects
+ *  memory not used yet, which is the case for fresh device allocations.
+ *  The first allocation of a large block touches its pages from all the
+ *  OpenMP threads, instead of faulting them one by one in the first
+ *  operator writing it.
+ */
+class NUMAStorageManager final : public StorageManager {
+ public:
+  /*!
+   * \brief constructor
+   * \param base the storage manager to allocate from, ownership is taken.
+   * \param node the NUMA node.
+   */
+  NUMAStorageManager(StorageManager* base, int node)
+      : base_(base), node_(node) {}
+  void* Alloc(size_t size) override {
+    void* ptr = base_->Alloc(size);
+    // smaller blocks hardly cover a whole page.
+    if (size >= kMinBindSize) {
+      common::BindMemoryToNUMANode(ptr, size, node_);
+    }
+    if (size >= kMinTouchSize) {
+      bool fresh;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fresh = touched_.insert(ptr).second;
+      }
+      if (fresh) Touch(ptr, size);
+    }
+    return ptr;
+  }
+  void Free(void* ptr, size_t size) override {
+    base_->Free(ptr, size);
+  }
+  void FreeBatch(const std::vector<std::pair<void*, size_t> >& blocks) override {
+    base_->FreeBatch(blocks);
+  }
+  void GetStats(size_t* used, size_t* cached, size_t* wasted) override {
+    base_->GetStats(used, cached, wasted);
+  }
+
+ private:
+  /*! \brief blocks smaller than this are not bound */
+  static constexpr size_t kMinBindSize = 64 << 10;
+  /*! \brief blocks smaller than this are left to be touched by their users */
+  static constexpr size_t kMinTouchSize = 4 << 20;
+  /*! \brief write a byte of each page of a block in parallel */
+  static void Touch(void* ptr, size_t size) {
+    const size_t page = 4096;
+    const int64_t npages = static_cast<int64_t>((size + page - 1) / page);
+    volatile char* data = static_cast<char*>(ptr);
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < npages; ++i) {
+      data[i * page] = 0;
+    }
+  }
+  /*! \brief the base storage manager */
+  std::unique_ptr<StorageManager> base_;
+  /*! \brief the NUMA node */
+  int node_;
+  /*! \brief mutex of touched_ */
+  std::mutex mutex_;
+  /*!
+   * \brief the large blocks already touched. They are kept by the pools of
+   *  the base manager once freed, a block given back to the system and
+   *  allocated again at the same address is just faulted by its users.
+   */
+  std::unordered_set<void*> touched_;
+  DISALLOW_COPY_AND_ASSIGN(NUMAStorageManager);
+};  // class NUMAStorageManager
+
+}  // namespace storage
+}  // namespace mxnet
+
+#endif  // MXNET_STORAGE_NUMA_STORAGE_MANAGER_H_
@@ -0,0 +1,120 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file pinned_storage_manager.h
+ * \brief Storage manager that pools pinned host memory by size classes.
+ */
+#ifndef MXNET_STORAGE_PINNED_STORAGE_MANAGER_H_
+#define MXNET_STORAGE_PINNED_STORAGE_MANAGER_H_
+
+#include <dmlc/logging.h>
+#include <mxnet/base.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "./storage_manager.h"
+#include "./pinned_memory_storage.h"
+
+namespace mxnet {
+namespace storage {
+
+/*!
+ * \brief Storage manager of pinned host memory.
+ *
+ *  Pinning and unpinning synchronize the device, so the freed blocks are
+ *  kept for the later requests of the same size class: powers of two up to
+ *  kMaxPow2, multiples of kLargeAlign above. The free blocks kept are
+ *  bounded by a high-water mark, a block freed over it is unpinned at once,
+ *  since pinned pages are taken from the pageable memory of the host.
+ */
+class PinnedStorageManager final : public StorageManager {
+ public:
+  /*!
+   * \brief constructor
+   * \param max_cached maximum bytes of free blocks kept.
+   */
+  explicit PinnedStorageManager(size_t max_cached) : max_cached_(max_cached) {}
+  ~PinnedStorageManager() {
+    ReleaseAll();
+  }
+  void* Alloc(size_t size) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t csize = SizeClass(size);
+    void* ret = nullptr;
+    std::vector<void*>& pool = pool_[csize];
+    if (!pool.empty()) {
+      ret = pool.back();
+      pool.pop_back();
+      cached_ -= csize;
+    } else {
+      try {
+        ret = PinnedMemoryStorage::Alloc(csize);
+      } catch (const dmlc::Error&) {
+        // the blocks of the other size classes may be enough
+        ReleaseAll();
+        ret = PinnedMemoryStorage::Alloc(csize);
+      }
+    }
+    used_ += size;
+    wasted_ += csize - size;
+    return ret;
+  }
+  void Free(void* ptr, size_t size) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t csize = SizeClass(size);
+    used_ -= size;
+    wasted_ -= csize - size;
+    if (cached_ + csize > max_cached_) {
+      PinnedMemoryStorage::Free(ptr);
+    } else {
+      pool_[csize].push_back(ptr);
+      cached_ += csize;
+    }
+  }
+  void GetStats(size_t* used, size_t* cached, size_t* wasted) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    *used = used_;
+    *cached = cached_;
+    *wasted = wasted_;
+  }
+
+ private:
+  /*! \brief minimum size class, a page */
+  static constexpr size_t kMinSize = 4096;
+  /*! \brief largest power of two size class */
+  static constexpr size_t kMaxPow2 = 4 << 20;
+  /*! \brief granularity of the size classes above kMaxPow2 */
+  static constexpr size_t kLargeAlign = 2 << 20;
+  /*! \return the size class of a request */
+  static inline size_t SizeClass(size_t size) {
+    if (size > kMaxPow2) return (size + kLargeAlign - 1) / kLargeAlign * kLargeAlign;
+    size_t c = kMinSize;
+    while (c < size) c <<= 1;
+    return c;
+  }
+  /*! \brief unpin all the free blocks */
+  void ReleaseAll() {
+    for (auto& kv : pool_) {
+      for (void* ptr : kv.second) PinnedMemoryStorage::Free(ptr);
+    }
+    pool_.clear();
+    cached_ = 0;
+  }
+  /*! \brief maximum bytes of free blocks kept */
+  size_t max_cached_;
+  // internal mutex
+  std::mutex mutex_;
+  // bytes handed out, as requested
+  size_t used_ = 0;
+  // bytes of the free blocks
+  size_t cached_ = 0;
+  // bytes lost by rounding of handed out blocks
+  size_t wasted_ = 0;
+  // free blocks, indexed by size class
+  std::unordered_map<size_t, std::vector<void*> > pool_;
+  DISALLOW_COPY_AND_ASSIGN(PinnedStorageManager);
+};  // class PinnedStorageManager
+
+}  // namespace storage
+}  // namespace mxnet
+
+#endif  // MXNET_STORAGE_PINNED_STORAGE_MANAGER_H_
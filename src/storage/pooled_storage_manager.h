@@ -8,6 +8,7 @@
 
 #include <mxnet/base.h>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include <mutex>
 #include <new>
@@ -34,6 +35,8 @@ class PooledStorageManager final : public StorageManager {
   }
   void* Alloc(size_t size) override;
   void Free(void* ptr, size_t size) override;
+  void FreeBatch(const std::vector<std::pair<void*, size_t> >& blocks) override;
+  void GetStats(size_t* used, size_t* cached, size_t* wasted) override;
 
  private:
   void ReleaseAll();
@@ -41,6 +44,10 @@ class PooledStorageManager final : public StorageManager {
   std::mutex mutex_;
   // used memory
   size_t used_memory_ = 0;
+  // memory currently handed out
+  size_t handed_out_ = 0;
+  // memory cached in pool
+  size_t cached_memory_ = 0;
   // memory pool
   std::unordered_map<size_t, std::vector<void*>> memory_pool_;
   DISALLOW_COPY_AND_ASSIGN(PooledStorageManager);
@@ -54,7 +61,9 @@ void* PooledStorageManager<DeviceStorage>::Alloc(size_t size) {
     used_memory_ += size;
     for (int i = 0; i < 2; ++i) {
       try {
-        return DeviceStorage::Alloc(size);
+        void* ret = DeviceStorage::Alloc(size);
+        handed_out_ += size;
+        return ret;
       } catch (const std::bad_alloc& e) {
         ReleaseAll();
       }
@@ -65,6 +74,8 @@ void* PooledStorageManager<DeviceStorage>::Alloc(size_t size) {
     auto&& reuse_pool = reuse_it->second;
     auto ret = reuse_pool.back();
     reuse_pool.pop_back();
+    handed_out_ += size;
+    cached_memory_ -= size;
     return ret;
   }
 }
@@ -74,6 +85,28 @@ void PooledStorageManager<DeviceStorage>::Free(void* ptr, size_t size) {
   std::lock_guard<std::mutex> lock(mutex_);
   auto&& reuse_pool = memory_pool_[size];
   reuse_pool.push_back(ptr);
+  handed_out_ -= size;
+  cached_memory_ += size;
+}
+
+template <class DeviceStorage>
+void PooledStorageManager<DeviceStorage>::FreeBatch(
+    const std::vector<std::pair<void*, size_t> >& blocks) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto&& b : blocks) {
+    memory_pool_[b.second].push_back(b.first);
+    handed_out_ -= b.second;
+    cached_memory_ += b.second;
+  }
+}
+
+template <class DeviceStorage>
+void PooledStorageManager<DeviceStorage>::GetStats(
+    size_t* used, size_t* cached, size_t* wasted) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  *used = handed_out_;
+  *cached = cached_memory_;
+  *wasted = 0;
 }
 
 template <class DeviceStorage>
@@ -85,6 +118,7 @@ void PooledStorageManager<DeviceStorage>::ReleaseAll() {
     }
   }
   memory_pool_.clear();
+  cached_memory_ = 0;
 }
 
 }  // namespace storage
@@ -4,15 +4,33 @@
 #include <mxnet/storage.h>
 #include <mshadow/tensor.h>
 #include <dmlc/logging.h>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "./storage_manager.h"
 #include "./naive_storage_manager.h"
 #include "./pooled_storage_manager.h"
+#include "./bucketed_storage_manager.h"
+#include "./arena_storage_manager.h"
+#include "./thread_cached_storage_manager.h"
+#include "./numa_storage_manager.h"
+#include "./stream_ordered_storage_manager.h"
 #include "./cpu_device_storage.h"
 #include "./gpu_device_storage.h"
 #include "./pinned_memory_storage.h"
+#include "./pinned_storage_manager.h"
 #include "../common/cuda_utils.h"
 #include "../common/lazy_alloc_array.h"
+#include "../common/numa.h"
+#include "../common/thread_local.h"
 
 namespace mxnet {
 
@@ -21,6 +39,13 @@ class StorageImpl : public Storage {
  public:
   Handle Alloc(size_t size, Context ctx) override;
   void Free(Handle handle) override;
+  void GetStats(Context ctx, size_t* used, size_t* cached, size_t* wasted) override;
+  void GetArenaStats(Context ctx, size_t* capacity, size_t* free,
+                     size_t* largest_free, size_t* overflow) override;
+  void RegisterHostMemory(void* ptr, size_t size) override;
+  void UnregisterHostMemory(void* ptr) override;
+  void DumpTrace(std::ostream* os) override;
+  void SetOriginQuota(const std::string& origin, size_t bytes) override;
   StorageImpl() {}
   virtual ~StorageImpl() = default;
 
@@ -28,9 +53,78 @@ class StorageImpl : public Storage {
   static constexpr size_t kMaxNumberOfDevices = Context::kMaxDevType + 1;
   static constexpr size_t kMaxNumberOfDeviceIDs = Context::kMaxDevID + 1;
 
+  /*!
+   * \brief create the storage manager selected by MXNET_MEM_POOL_TYPE.
+   *  - Exact: reuse a freed block only for a request of the same size.
+   *  - Bucketed: round requests to size classes, split and coalesce large blocks.
+   */
   template <class DeviceStorage>
-  using CurrentStorageManager =
-      storage::PooledStorageManager<DeviceStorage>;
+  static storage::StorageManager* CreateStorageManager() {
+    static std::string type = dmlc::GetEnv("MXNET_MEM_POOL_TYPE", std::string("Exact"));
+    if (type == "Exact") {
+      return new storage::PooledStorageManager<DeviceStorage>();
+    } else if (type == "Bucketed") {
+      double factor = dmlc::GetEnv("MXNET_MEM_POOL_ROUND_FACTOR", 2.0);
+      size_t large_block = dmlc::GetEnv("MXNET_MEM_POOL_LARGE_BLOCK", 4 << 20);
+      return new storage::BucketedStorageManager<DeviceStorage>(factor, large_block);
+    }
+    LOG(FATAL) << "Unknown memory pool type " << type;
+    return nullptr;
+  }
+  /*!
+   * \brief create the storage manager for host memory,
+   *  with per-thread caches in front of the shared pool.
+   * \param numa_node NUMA node to place the memory on, -1 for no placement.
+   */
+  template <class DeviceStorage>
+  static storage::StorageManager* CreateHostStorageManager(int numa_node = -1) {
+    static size_t capacity = dmlc::GetEnv("MXNET_CPU_MEM_THREAD_CACHE", 16 << 20);
+    storage::StorageManager* base = CreateStorageManager<DeviceStorage>();
+    if (numa_node >= 0) {
+      base = new storage::NUMAStorageManager(base, numa_node);
+    }
+    if (capacity == 0) return base;
+    return new storage::ThreadCachedStorageManager(base, capacity);
+  }
+
+  /*!
+   * \brief create the storage manager for pinned memory, with size classes
+   *  and a bound on the free memory kept.
+   */
+  static storage::StorageManager* CreatePinnedStorageManager() {
+    static size_t capacity = dmlc::GetEnv("MXNET_CPU_MEM_THREAD_CACHE", 16 << 20);
+    static size_t max_cached = dmlc::GetEnv("MXNET_PINNED_MEM_POOL_LIMIT", 512 << 20);
+    storage::StorageManager* base = new storage::PinnedStorageManager(max_cached);
+    if (capacity == 0) return base;
+    return new storage::ThreadCachedStorageManager(base, capacity);
+  }
+  /*!
+   * \brief create the storage manager for gpu memory, deferring the reuse of
+   *  the blocks freed before their kernels complete in stream ordered mode.
+   *  When MXNET_GPU_MEM_ARENA_FRACTION is set, that fraction of the free memory
+   *  of the device is reserved at once and all requests are served from it.
+   */
+  static storage::StorageManager* CreateGPUStorageManager(int dev_id) {
+    storage::StorageManager* base = nullptr;
+#if MXNET_USE_CUDA
+    static double arena_fraction = dmlc::GetEnv("MXNET_GPU_MEM_ARENA_FRACTION", 0.0);
+    CHECK(arena_fraction >= 0.0 && arena_fraction < 1.0)
+        << "MXNET_GPU_MEM_ARENA_FRACTION must be in [0, 1)";
+    if (arena_fraction > 0.0) {
+      size_t free_bytes, total_bytes;
+      CUDA_CALL(cudaSetDevice(dev_id));
+      CUDA_CALL(cudaMemGetInfo(&free_bytes, &total_bytes));
+      base = new storage::ArenaStorageManager<storage::GPUDeviceStorage>(
+          static_cast<size_t>(free_bytes * arena_fraction));
+    }
+#endif  // MXNET_USE_CUDA
+    if (base == nullptr) base = CreateStorageManager<storage::GPUDeviceStorage>();
+#if MXNET_USE_CUDA
+    static bool stream_ordered = dmlc::GetEnv("MXNET_GPU_STREAM_ORDERED", false);
+    if (stream_ordered) return new storage::StreamOrderedStorageManager(base);
+#endif  // MXNET_USE_CUDA
+    return base;
+  }
 
   static void ActivateDevice(Context ctx) {
     switch (ctx.dev_type) {
@@ -47,9 +141,59 @@ class StorageImpl : public Storage {
         LOG(FATAL) << "Unimplemented device";
     }
   }
+  /*! \brief the allocation trace of a context */
+  struct ContextTrace {
+    /*! \brief bytes allocated now */
+    size_t used = 0;
+    /*! \brief peak of used */
+    size_t peak = 0;
+    /*! \brief bytes allocated now by each origin */
+    std::map<std::string, size_t> by_origin;
+    /*! \brief by_origin at the last recorded peak */
+    std::map<std::string, size_t> at_peak;
+    /*! \brief time in microseconds and bytes of the recorded peaks */
+    std::vector<std::pair<uint64_t, size_t> > timeline;
+  };
+  /*! \brief a traced allocation */
+  struct TracedBlock {
+    /*! \brief its origin */
+    std::string origin;
+    /*! \brief its size */
+    size_t size;
+  };
+  /*! \brief a new peak is recorded when it grows by this many bytes */
+  static constexpr size_t kPeakStep = 1 << 20;
+  /*! \brief record an allocation in the trace */
+  void TraceAlloc(const Handle& handle);
+  /*! \brief record a free in the trace */
+  void TraceFree(const Handle& handle);
+  /*! \brief log the allocations of a context by origin, after a failed allocation */
+  void LogTrace(Context ctx, size_t size);
+  /*! \brief fail if an allocation goes over the quota of its origin */
+  void CheckQuota(Context ctx, size_t size);
+  /*! \return whether the allocations are recorded, for the trace or the quotas */
+  inline bool Traced() const {
+    return TraceEnabled() || quota_enabled_.load(std::memory_order_relaxed);
+  }
   // internal storage managers
   std::array<common::LazyAllocArray<storage::StorageManager>,
              kMaxNumberOfDevices> storage_managers_;
+  // mutex of registered_
+  std::mutex registered_mutex_;
+  // host memory pinned by RegisterHostMemory, and its size
+  std::unordered_map<void*, size_t> registered_;
+  // mutex of the trace
+  std::mutex trace_mutex_;
+  // start of the trace, the times of the timeline are relative to it
+  const std::chrono::steady_clock::time_point trace_start_ = std::chrono::steady_clock::now();
+  // trace of each context
+  std::map<Context, ContextTrace> trace_;
+  // the traced allocations alive
+  std::map<std::pair<Context, void*>, TracedBlock> traced_blocks_;
+  // the quota of each origin, guarded by trace_mutex_
+  std::unordered_map<std::string, size_t> quotas_;
+  // whether a quota was ever set, the allocations are then traced
+  std::atomic<bool> quota_enabled_{false};
 };  // struct Storage::Impl
 
 Storage::Handle StorageImpl::Alloc(size_t size, Context ctx) {
@@ -63,15 +207,16 @@ Storage::Handle StorageImpl::Alloc(size_t size, Context ctx) {
         storage::StorageManager *ptr = nullptr;
         switch (ctx.dev_type) {
           case Context::kCPU: {
-            ptr = new CurrentStorageManager<storage::CPUDeviceStorage>();
+            ptr = CreateHostStorageManager<storage::CPUDeviceStorage>(
+                common::CPUContextNUMANode(ctx.dev_id));
             break;
           }
           case Context::kCPUPinned: {
-            ptr = new CurrentStorageManager<storage::PinnedMemoryStorage>();
+            ptr = CreatePinnedStorageManager();
             break;
           }
           case Context::kGPU: {
-            ptr = new CurrentStorageManager<storage::GPUDeviceStorage>();
+            ptr = CreateGPUStorageManager(ctx.dev_id);
             break;
           }
           default: LOG(FATAL) <<  "Unimplemented device " << ctx.dev_type;
@@ -79,7 +224,18 @@ Storage::Handle StorageImpl::Alloc(size_t size, Context ctx) {
         return ptr;
       });
   this->ActivateDevice(ctx);
-  hd.dptr = manager->Alloc(size);
+  if (!Traced()) {
+    hd.dptr = manager->Alloc(size);
+    return hd;
+  }
+  this->CheckQuota(ctx, size);
+  try {
+    hd.dptr = manager->Alloc(size);
+  } catch (const dmlc::Error&) {
+    this->LogTrace(ctx, size);
+    throw;
+  }
+  this->TraceAlloc(hd);
   return hd;
 }
 
@@ -92,9 +248,191 @@ void StorageImpl::Free(Storage::Handle handle) {
         return nullptr;
       });
   this->ActivateDevice(ctx);
+  if (Traced()) this->TraceFree(handle);
   maneger->Free(handle.dptr, handle.size);
 }
 
+void StorageImpl::GetStats(Context ctx, size_t* used, size_t* cached, size_t* wasted) {
+  auto&& device = storage_managers_.at(ctx.dev_type);
+  storage::StorageManager *manager = device.Get(
+      ctx.dev_id, []() {
+        // nothing allocated on this device yet
+        return static_cast<storage::StorageManager*>(nullptr);
+      });
+  if (manager == nullptr) {
+    *used = *cached = *wasted = 0;
+  } else {
+    manager->GetStats(used, cached, wasted);
+  }
+}
+
+void StorageImpl::GetArenaStats(Context ctx, size_t* capacity, size_t* free,
+                                size_t* largest_free, size_t* overflow) {
+  auto&& device = storage_managers_.at(ctx.dev_type);
+  storage::StorageManager *manager = device.Get(
+      ctx.dev_id, []() {
+        return static_cast<storage::StorageManager*>(nullptr);
+      });
+  if (manager == nullptr) {
+    *capacity = *free = *largest_free = *overflow = 0;
+  } else {
+    manager->GetArenaStats(capacity, free, largest_free, overflow);
+  }
+}
+
+void StorageImpl::RegisterHostMemory(void* ptr, size_t size) {
+#if MXNET_USE_CUDA
+  std::lock_guard<std::mutex> lock(registered_mutex_);
+  CHECK(registered_.count(ptr) == 0) << "host memory " << ptr << " is already registered";
+  // make the memory available across all devices
+  CUDA_CALL(cudaHostRegister(ptr, size, cudaHostRegisterPortable));
+  registered_[ptr] = size;
+#else   // MXNET_USE_CUDA
+  LOG(FATAL) << "Please compile with CUDA enabled";
+#endif  // MXNET_USE_CUDA
+}
+
+void StorageImpl::UnregisterHostMemory(void* ptr) {
+#if MXNET_USE_CUDA
+  std::lock_guard<std::mutex> lock(registered_mutex_);
+  CHECK(registered_.erase(ptr) != 0) << "host memory " << ptr << " is not registered";
+  CUDA_CALL(cudaHostUnregister(ptr));
+#else   // MXNET_USE_CUDA
+  LOG(FATAL) << "Please compile with CUDA enabled";
+#endif  // MXNET_USE_CUDA
+}
+
+void StorageImpl::TraceAlloc(const Handle& handle) {
+  const char* origin = GetAllocOrigin();
+  std::lock_guard<std::mutex> lock(trace_mutex_);
+  TracedBlock& block = traced_blocks_[std::make_pair(handle.ctx, handle.dptr)];
+  block.origin = origin != nullptr ? origin : "untagged";
+  block.size = handle.size;
+  ContextTrace& trace = trace_[handle.ctx];
+  trace.used += handle.size;
+  trace.by_origin[block.origin] += handle.size;
+  if (trace.used > trace.peak) {
+    trace.peak = trace.used;
+    if (trace.timeline.size() == 0 || trace.peak >= trace.timeline.back().second + kPeakStep) {
+      const uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - trace_start_).count();
+      trace.timeline.push_back(std::make_pair(micros, trace.peak));
+      trace.at_peak = trace.by_origin;
+    }
+  }
+}
+
+void StorageImpl::TraceFree(const Handle& handle) {
+  std::lock_guard<std::mutex> lock(trace_mutex_);
+  auto it = traced_blocks_.find(std::make_pair(handle.ctx, handle.dptr));
+  // allocated before the trace was enabled
+  if (it == traced_blocks_.end()) return;
+  ContextTrace& trace = trace_[handle.ctx];
+  trace.used -= it->second.size;
+  size_t& bytes = trace.by_origin[it->second.origin];
+  bytes -= it->second.size;
+  if (bytes == 0) trace.by_origin.erase(it->second.origin);
+  traced_blocks_.erase(it);
+}
+
+/*! \brief name of a context in the trace */
+static std::string TraceContextName(Context ctx) {
+  const char* type = ctx.dev_type == Context::kGPU ? "gpu" :
+      ctx.dev_type == Context::kCPUPinned ? "cpu_pinned" : "cpu";
+  return std::string(type) + "(" + std::to_string(ctx.dev_id) + ")";
+}
+
+void StorageImpl::LogTrace(Context ctx, size_t size) {
+  std::lock_guard<std::mutex> lock(trace_mutex_);
+  const ContextTrace& trace = trace_[ctx];
+  std::vector<std::pair<size_t, std::string> > origins;
+  for (const auto& kv : trace.by_origin) origins.push_back(std::make_pair(kv.second, kv.first));
+  std::sort(origins.rbegin(), origins.rend());
+  std::ostringstream os;
+  os << "failed to allocate " << size << " bytes on " << TraceContextName(ctx)
+     << ", " << trace.used << " bytes allocated, by origin:";
+  for (const auto& kv : origins) os << "\n  " << kv.second << ": " << kv.first;
+  LOG(WARNING) << os.str();
+}
+
+void StorageImpl::CheckQuota(Context ctx, size_t size) {
+  const char* origin = GetAllocOrigin();
+  if (origin == nullptr) return;
+  std::lock_guard<std::mutex> lock(trace_mutex_);
+  auto quota = quotas_.find(origin);
+  if (quota == quotas_.end()) return;
+  const std::map<std::string, size_t>& by_origin = trace_[ctx].by_origin;
+  auto used = by_origin.find(origin);
+  const size_t bytes = used != by_origin.end() ? used->second : 0;
+  CHECK_LE(bytes + size, quota->second)
+      << "allocating " << size << " bytes on " << TraceContextName(ctx) << " for "
+      << origin << " exceeds its quota of " << quota->second << " bytes, "
+      << bytes << " bytes are allocated";
+}
+
+void StorageImpl::SetOriginQuota(const std::string& origin, size_t bytes) {
+  std::lock_guard<std::mutex> lock(trace_mutex_);
+  if (bytes == 0) {
+    quotas_.erase(origin);
+  } else {
+    quotas_[origin] = bytes;
+    quota_enabled_ = true;
+  }
+}
+
+void StorageImpl::DumpTrace(std::ostream* os) {
+  std::lock_guard<std::mutex> lock(trace_mutex_);
+  auto write_origins = [os](const std::map<std::string, size_t>& origins) {
+    *os << '{';
+    bool first = true;
+    for (const auto& kv : origins) {
+      if (!first) *os << ", ";
+      first = false;
+      *os << '"' << kv.first << "\": " << kv.second;
+    }
+    *os << '}';
+  };
+  *os << "{\n";
+  bool first = true;
+  for (const auto& kv : trace_) {
+    const ContextTrace& trace = kv.second;
+    if (!first) *os << ",\n";
+    first = false;
+    *os << "  \"" << TraceContextName(kv.first) << "\": {\n"
+        << "    \"used\": " << trace.used << ",\n"
+        << "    \"peak\": " << trace.peak << ",\n"
+        << "    \"by_origin\": ";
+    write_origins(trace.by_origin);
+    *os << ",\n    \"at_peak\": ";
+    write_origins(trace.at_peak);
+    *os << ",\n    \"timeline\": [";
+    for (size_t i = 0; i < trace.timeline.size(); ++i) {
+      if (i != 0) *os << ", ";
+      *os << '[' << trace.timeline[i].first << ", " << trace.timeline[i].second << ']';
+    }
+    *os << "]\n  }";
+  }
+  *os << "\n}\n";
+}
+
+bool Storage::TraceEnabled() {
+  static bool enabled = dmlc::GetEnv("MXNET_STORAGE_TRACE", false);
+  return enabled;
+}
+
+/*! \brief origin of the allocations of each thread */
+static MX_TREAD_LOCAL const char* alloc_origin = nullptr;
+
+const char* Storage::SetAllocOrigin(const char* origin) {
+  const char* prev = alloc_origin;
+  alloc_origin = origin;
+  return prev;
+}
+
+const char* Storage::GetAllocOrigin() {
+  return alloc_origin;
+}
+
 std::shared_ptr<Storage> Storage::_GetSharedRef() {
 #ifdef __MXNET_JS__
   // dummy code needed for emscripten code to pass
@@ -7,6 +7,8 @@
 #define MXNET_STORAGE_STORAGE_MANAGER_H_
 
 #include <cstddef>
+#include <utility>
+#include <vector>
 
 namespace mxnet {
 namespace storage {
@@ -28,6 +30,39 @@ class StorageManager {
    * \param size Size of the storage.
    */
   virtual void Free(void* ptr, size_t size) = 0;
+  /*!
+   * \brief Deallocation of several blocks at once.
+   * \param blocks Pointers and sizes of the storages.
+   */
+  virtual void FreeBatch(const std::vector<std::pair<void*, size_t> >& blocks) {
+    for (auto& b : blocks) this->Free(b.first, b.second);
+  }
+  /*!
+   * \brief Get memory statistics of the manager.
+   * \param used Bytes currently handed out to callers.
+   * \param cached Bytes held from the device but currently free.
+   * \param wasted Bytes lost to rounding of handed out blocks.
+   */
+  virtual void GetStats(size_t* used, size_t* cached, size_t* wasted) {
+    *used = 0;
+    *cached = 0;
+    *wasted = 0;
+  }
+  /*!
+   * \brief Get statistics of the region reserved up front by the manager.
+   * \param capacity Bytes reserved, 0 for the managers without one.
+   * \param free Bytes free in the region.
+   * \param largest_free Bytes of its largest free block, smaller than free
+   *  when it is fragmented.
+   * \param overflow Bytes handed out from outside of the region.
+   */
+  virtual void GetArenaStats(size_t* capacity, size_t* free,
+                             size_t* largest_free, size_t* overflow) {
+    *capacity = 0;
+    *free = 0;
+    *largest_free = 0;
+    *overflow = 0;
+  }
   /*!
    * \brief Destructor.
    */
@@ -0,0 +1,157 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file stream_ordered_storage_manager.h
+ * \brief Storage manager that defers the reuse of gpu memory still used by queued kernels.
+ */
+#ifndef MXNET_STORAGE_STREAM_ORDERED_STORAGE_MANAGER_H_
+#define MXNET_STORAGE_STREAM_ORDERED_STORAGE_MANAGER_H_
+
+#if MXNET_USE_CUDA
+#include <mxnet/base.h>
+#include <dmlc/logging.h>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "./storage_manager.h"
+#include "../engine/stream_event_pool.h"
+
+namespace mxnet {
+namespace storage {
+
+/*!
+ * \brief Storage manager for the stream ordered mode of the engine, where the
+ *  deletion of a variable completes before the kernels using it on the gpu.
+ *
+ *  A block freed by such a deletion keeps the events of its last uses. It is
+ *  reused at once by an operation running on the stream of all of them, whose
+ *  kernels are queued after, and goes back to the base manager once the
+ *  events complete. The allocations running out of memory wait for them.
+ */
+class StreamOrderedStorageManager final : public StorageManager {
+ public:
+  /*!
+   * \brief constructor
+   * \param base the storage manager to allocate from, ownership is taken.
+   */
+  explicit StreamOrderedStorageManager(StorageManager* base) : base_(base) {}
+  ~StreamOrderedStorageManager() {
+    // no CUDA_CALL, the driver may be shutting down
+    for (Deferred& d : deferred_) {
+      for (const engine::StreamEventPtr& e : d.events) cudaEventSynchronize(e->event);
+      base_->Free(d.ptr, d.size);
+    }
+  }
+  void* Alloc(size_t size) override {
+    cudaStream_t stream = engine::StreamUseStore::Get()->stream;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stream != nullptr) {
+        for (size_t i = deferred_.size(); i != 0; --i) {
+          Deferred& d = deferred_[i - 1];
+          if (d.size != size || !OnStream(d, stream)) continue;
+          void* ptr = d.ptr;
+          deferred_bytes_ -= size;
+          deferred_.erase(deferred_.begin() + (i - 1));
+          return ptr;
+        }
+      }
+      ReleaseCompleted(false);
+    }
+    try {
+      return base_->Alloc(size);
+    } catch (const dmlc::Error&) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (deferred_.empty()) throw;
+        ReleaseCompleted(true);
+      }
+      return base_->Alloc(size);
+    }
+  }
+  void Free(void* ptr, size_t size) override {
+    engine::StreamUse* use = engine::StreamUseStore::Get();
+    if (use->free_after.empty()) {
+      base_->Free(ptr, size);
+      return;
+    }
+    use->freed = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    deferred_.push_back(Deferred{ptr, size, use->free_after});
+    deferred_bytes_ += size;
+  }
+  void GetStats(size_t* used, size_t* cached, size_t* wasted) override {
+    base_->GetStats(used, cached, wasted);
+    std::lock_guard<std::mutex> lock(mutex_);
+    // the deferred blocks are free for their users
+    *used -= deferred_bytes_;
+    *cached += deferred_bytes_;
+  }
+  void GetArenaStats(size_t* capacity, size_t* free,
+                     size_t* largest_free, size_t* overflow) override {
+    base_->GetArenaStats(capacity, free, largest_free, overflow);
+  }
+
+ private:
+  /*! \brief a freed block waiting for the kernels using it */
+  struct Deferred {
+    /*! \brief the block */
+    void* ptr;
+    /*! \brief its size */
+    size_t size;
+    /*! \brief the events of its last uses */
+    std::vector<engine::StreamEventPtr> events;
+  };
+  /*! \brief whether all the last uses of d are on stream */
+  static bool OnStream(const Deferred& d, cudaStream_t stream) {
+    for (const engine::StreamEventPtr& e : d.events) {
+      if (e->stream != stream) return false;
+    }
+    return true;
+  }
+  /*!
+   * \brief give the blocks whose events completed back to the base manager.
+   * \param wait whether to wait for all the events.
+   */
+  void ReleaseCompleted(bool wait) {
+    size_t kept = 0;
+    for (size_t i = 0; i < deferred_.size(); ++i) {
+      Deferred& d = deferred_[i];
+      bool done = true;
+      for (const engine::StreamEventPtr& e : d.events) {
+        if (wait) {
+          CUDA_CALL(cudaEventSynchronize(e->event));
+          continue;
+        }
+        cudaError_t err = cudaEventQuery(e->event);
+        if (err == cudaErrorNotReady) {
+          done = false;
+          break;
+        }
+        CUDA_CALL(err);
+      }
+      if (done) {
+        base_->Free(d.ptr, d.size);
+        deferred_bytes_ -= d.size;
+      } else {
+        if (kept != i) deferred_[kept] = std::move(d);
+        ++kept;
+      }
+    }
+    deferred_.erase(deferred_.begin() + kept, deferred_.end());
+  }
+  /*! \brief the base storage manager */
+  std::unique_ptr<StorageManager> base_;
+  /*! \brief mutex of deferred_ */
+  std::mutex mutex_;
+  /*! \brief the freed blocks still in use, in free order */
+  std::vector<Deferred> deferred_;
+  /*! \brief bytes of deferred_ */
+  size_t deferred_bytes_ = 0;
+  DISALLOW_COPY_AND_ASSIGN(StreamOrderedStorageManager);
+};  // class StreamOrderedStorageManager
+
+}  // namespace storage
+}  // namespace mxnet
+#endif  // MXNET_USE_CUDA
+#endif  // MXNET_STORAGE_STREAM_ORDERED_STORAGE_MANAGER_H_
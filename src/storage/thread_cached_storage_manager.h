@@ -0,0 +1,118 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file thread_cached_storage_manager.h
+ * \brief Per-thread free-list caches in front of a storage manager.
+ */
+#ifndef MXNET_STORAGE_THREAD_CACHED_STORAGE_MANAGER_H_
+#define MXNET_STORAGE_THREAD_CACHED_STORAGE_MANAGER_H_
+
+#include <dmlc/logging.h>
+#include <mxnet/base.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "./storage_manager.h"
+#include "../common/thread_local.h"
+
+namespace mxnet {
+namespace storage {
+
+/*!
+ * \brief Storage manager that keeps a bounded free-list cache per thread,
+ *  similar to tcmalloc, in front of a shared storage manager.
+ *
+ *  Alloc and Free of small blocks hit the cache of the calling thread
+ *  without taking any lock. When a thread cache grows over its capacity,
+ *  half of it is returned to the shared manager in one batch.
+ */
+class ThreadCachedStorageManager final : public StorageManager {
+ public:
+  /*!
+   * \brief constructor
+   * \param base the shared storage manager, ownership is taken.
+   * \param capacity maximum bytes cached by each thread.
+   */
+  ThreadCachedStorageManager(StorageManager* base, size_t capacity)
+      : base_(base), capacity_(capacity), max_block_(capacity / 8) {}
+  void* Alloc(size_t size) override {
+    if (size > max_block_) return base_->Alloc(size);
+    ThreadCache* cache = GetCache();
+    auto it = cache->free_list.find(size);
+    if (it != cache->free_list.end() && it->second.size() != 0) {
+      void* ret = it->second.back();
+      it->second.pop_back();
+      cache->bytes -= size;
+      thread_cached_ -= size;
+      return ret;
+    }
+    return base_->Alloc(size);
+  }
+  void Free(void* ptr, size_t size) override {
+    if (size > max_block_) {
+      base_->Free(ptr, size);
+      return;
+    }
+    ThreadCache* cache = GetCache();
+    cache->free_list[size].push_back(ptr);
+    cache->bytes += size;
+    thread_cached_ += size;
+    if (cache->bytes > capacity_) Flush(cache);
+  }
+  void FreeBatch(const std::vector<std::pair<void*, size_t> >& blocks) override {
+    base_->FreeBatch(blocks);
+  }
+  void GetStats(size_t* used, size_t* cached, size_t* wasted) override {
+    base_->GetStats(used, cached, wasted);
+    // blocks in thread caches are still handed out from the view of base.
+    size_t tc = thread_cached_.load();
+    *used -= std::min(*used, tc);
+    *cached += tc;
+  }
+
+ private:
+  /*! \brief cache of one thread */
+  struct ThreadCache {
+    /*! \brief free blocks indexed by size */
+    std::unordered_map<size_t, std::vector<void*> > free_list;
+    /*! \brief total bytes in the cache */
+    size_t bytes = 0;
+  };
+  /*! \brief caches of all managers on current thread */
+  typedef std::unordered_map<const ThreadCachedStorageManager*, ThreadCache> CacheMap;
+  /*! \return the cache of this manager on current thread */
+  inline ThreadCache* GetCache() {
+    return &(*common::ThreadLocalStore<CacheMap>::Get())[this];
+  }
+  /*! \brief return half of the cache to the shared manager in one batch */
+  inline void Flush(ThreadCache* cache) {
+    std::vector<std::pair<void*, size_t> > batch;
+    for (auto& kv : cache->free_list) {
+      std::vector<void*>& blocks = kv.second;
+      size_t nkeep = blocks.size() / 2;
+      for (size_t i = nkeep; i < blocks.size(); ++i) {
+        batch.push_back(std::make_pair(blocks[i], kv.first));
+        cache->bytes -= kv.first;
+        thread_cached_ -= kv.first;
+      }
+      blocks.resize(nkeep);
+    }
+    base_->FreeBatch(batch);
+  }
+  /*! \brief shared storage manager */
+  std::unique_ptr<StorageManager> base_;
+  /*! \brief capacity of each thread cache */
+  size_t capacity_;
+  /*! \brief blocks bigger than this bypass the cache */
+  size_t max_block_;
+  /*! \brief bytes held by all thread caches */
+  std::atomic<size_t> thread_cached_{0};
+  DISALLOW_COPY_AND_ASSIGN(ThreadCachedStorageManager);
+};  // class ThreadCachedStorageManager
+
+}  // namespace storage
+}  // namespace mxnet
+
+#endif  // MXNET_STORAGE_THREAD_CACHED_STORAGE_MANAGER_H_
@@ -7,13 +7,80 @@
 #include <mxnet/resource.h>
 #include <mxnet/symbolic.h>
 #include <dmlc/timer.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <memory>
 #include <map>
+#include <mutex>
 #include <set>
+#include <string>
+#include <thread>
+#include <utility>
 #include "./graph_executor.h"
 #include "./graph_algorithm.h"
+#include "../common/cuda_utils.h"
 
 namespace mxnet {
+namespace {
+/*!
+ * \brief times the nodes run one after another in a run context, by the events
+ *  recorded on its stream on a gpu, by the host clock otherwise.
+ */
+class NodeTimer {
+ public:
+  NodeTimer(RunContext ctx, bool is_gpu) : ctx_(ctx), is_gpu_(is_gpu) {
+    this->Mark();
+  }
+  ~NodeTimer() {
+#if MXNET_USE_CUDA
+    for (cudaEvent_t event : events_) cudaEventDestroy(event);
+#endif
+  }
+  // mark the end of a node, and the beginning of the next one
+  inline void Mark() {
+    if (is_gpu_) {
+#if MXNET_USE_CUDA
+      cudaEvent_t event;
+      CUDA_CALL(cudaEventCreate(&event));
+      events_.push_back(event);
+      CUDA_CALL(cudaEventRecord(
+          event, mshadow::Stream<gpu>::GetStream(ctx_.get_stream<gpu>())));
+#endif
+    } else {
+      host_.push_back(dmlc::GetTime());
+    }
+  }
+  // the milliseconds between each two marks, waits for the kernels on a gpu
+  inline std::vector<double> Elapsed() {
+    std::vector<double> ms;
+    if (is_gpu_) {
+#if MXNET_USE_CUDA
+      CUDA_CALL(cudaEventSynchronize(events_.back()));
+      for (size_t i = 1; i < events_.size(); ++i) {
+        float t;
+        CUDA_CALL(cudaEventElapsedTime(&t, events_[i - 1], events_[i]));
+        ms.push_back(t);
+      }
+#endif
+    } else {
+      for (size_t i = 1; i < host_.size(); ++i) {
+        ms.push_back((host_[i] - host_[i - 1]) * 1e3);
+      }
+    }
+    return ms;
+  }
+
+ private:
+  RunContext ctx_;
+  bool is_gpu_;
+#if MXNET_USE_CUDA
+  std::vector<cudaEvent_t> events_;
+#endif
+  std::vector<double> host_;
+};
+}  // namespace
+
 /*!
  * \brief wrapper class that wraps Backward operation as Forward.
  */
@@ -252,7 +319,8 @@ GraphExecutor::GetOpExecEntry(uint32_t nid) {
   OpContext* op_ctx_ptr = &op_node.op_ctx;
   bool is_gpu = op_node.ctx.dev_mask() == gpu::kDevMask;
   bool is_async = op->exec_type() == Operator::kAsync;
-  exec.exec_fun = [op, is_gpu, is_async, op_ctx_ptr, in_array, req, out_array, aux_array]
+  exec.exec_fun = [this, nid, op, is_gpu, is_async, op_ctx_ptr,
+                   in_array, req, out_array, aux_array]
       (RunContext ctx, Engine::CallbackOnComplete on_complete) {
     std::vector<TBlob> in_data(in_array.size());
     std::vector<TBlob> out_data(out_array.size());
@@ -270,13 +338,20 @@ GraphExecutor::GetOpExecEntry(uint32_t nid) {
     if (is_async) {
       op_ctx_ptr->async_on_complete = on_complete;
     }
+    // an async operator completes later, only its launch would be timed
+    std::unique_ptr<NodeTimer> timer;
+    if (profiling_ && !is_async) timer.reset(new NodeTimer(ctx, is_gpu));
     op->Forward(*op_ctx_ptr, in_data, req, out_data, aux_data);
+    if (timer) {
+      timer->Mark();
+      AddNodeTimes({nid}, timer->Elapsed());
+    }
     // call on complete only if it is async op
     if (!is_async) {
       if (is_gpu) {
         #if MXNET_USE_CUDA
-        // Wait GPU kernel to finish.
-        ctx.get_stream<gpu>()->Wait();
+        // Wait GPU kernel to finish, or order the dependents after it.
+        Engine::Get()->WaitForStream(ctx);
         #else
         LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
         #endif
@@ -306,12 +381,43 @@ void GraphExecutor::InitGraph(const Symbol &symbol,
                               const std::vector<NDArray> &in_args,
                               const std::vector<NDArray> &arg_grad_store,
                               const std::vector<OpReqType> &grad_req_type,
-                              bool need_backward) {
+                              bool need_backward,
+                              size_t mem_budget) {
   // initialize all internal data structures
   graph_.FromSymbol(symbol);
+  if (dmlc::GetEnv("MXNET_EXEC_SIMPLIFY_GRAPH", true)) graph_.Simplify();
+  // fused kernels on gpu are compiled with NVRTC, group2ctx placement is kept as is.
+  bool fuse = dmlc::GetEnv("MXNET_EXEC_FUSE_ELEMWISE", false) && ctx_map.size() == 0;
+#if !MXNET_USE_NVRTC
+  fuse = fuse && default_ctx.dev_mask() == cpu::kDevMask;
+#endif  // !MXNET_USE_NVRTC
+  if (fuse) graph_.FuseElemwise();
+  // the nodes of a subgraph backend are grouped for inference, before the
+  // context assignment which they are not part of
+  const std::string backend = dmlc::GetEnv("MXNET_SUBGRAPH_BACKEND", std::string());
+  if (!backend.empty() && !need_backward && ctx_map.size() == 0) {
+    std::vector<TShape> arg_shapes;
+    for (const NDArray& arr : in_args) arg_shapes.push_back(arr.shape());
+    graph_.PartitionSubgraphs(backend, default_ctx, arg_shapes);
+  }
   if (need_backward) {
     std::map<uint32_t, uint32_t> mirror;
-    graph_.MakeBackwardPass(&head_grad_nodes_, &arg_grads_, &mirror);
+    // the backward of the layers below the arguments that need a gradient is not built
+    std::vector<bool> need_arg_grad(grad_req_type.size());
+    for (size_t i = 0; i < grad_req_type.size(); ++i) {
+      need_arg_grad[i] = grad_req_type[i] != kNullOp;
+    }
+    if (mem_budget != 0) {
+      std::vector<TShape> arg_shapes;
+      for (const NDArray& arr : in_args) arg_shapes.push_back(arr.shape());
+      std::unordered_set<uint32_t> mirror_nodes;
+      graph_.PlanMirror(arg_shapes, mem_budget, &mirror_nodes);
+      graph_.MakeBackwardPass(&head_grad_nodes_, &arg_grads_, &mirror, &mirror_nodes,
+                              &need_arg_grad);
+    } else {
+      graph_.MakeBackwardPass(&head_grad_nodes_, &arg_grads_, &mirror, nullptr,
+                              &need_arg_grad);
+    }
     for (auto kv : mirror) {
       if (kv.first != kv.second) {
         mirror_source_map_[kv.second] = kv.first;
@@ -324,6 +430,16 @@ void GraphExecutor::InitGraph(const Symbol &symbol,
   this->AssignContext(default_ctx, ctx_map,
                       in_args, arg_grad_store, grad_req_type,
                       &ctx_assignment);
+  // copy the chosen activations to the host and back, this will change the graph.
+  std::vector<std::pair<uint32_t, uint32_t> > offload;
+  if (need_backward) {
+    this->AssignOffload(in_args, &ctx_assignment, &offload);
+  }
+  // blocked layouts are only assigned for inference, this will change the graph.
+  std::vector<int> layout_assignment(graph_.nodes.size(), kLayoutNCHW);
+  if (!need_backward && dmlc::GetEnv("MXNET_CPU_BLOCKED_LAYOUT", false)) {
+    this->AssignLayouts(in_args, &ctx_assignment, &layout_assignment);
+  }
 
   // organize topo order so that backward node always falls after forward.
   std::vector<uint32_t> head_nodes;
@@ -332,6 +448,9 @@ void GraphExecutor::InitGraph(const Symbol &symbol,
   }
   std::vector<uint32_t> fwd_nodes = graph_.PostDFSOrder(head_nodes);
   num_forward_nodes_ = fwd_nodes.size();
+  if (prefer_bulk_execution_ && dmlc::GetEnv("MXNET_EXEC_BRANCH_SEGMENTS", true)) {
+    this->AssignBranches(&fwd_nodes);
+  }
 
   std::unordered_set<uint32_t> fwd_set(fwd_nodes.begin(), fwd_nodes.end());
   std::vector<uint32_t> topo = graph_.TopoSort();
@@ -345,11 +464,8 @@ void GraphExecutor::InitGraph(const Symbol &symbol,
   }
   for (uint32_t nid : topo) {
     if (fwd_set.count(nid) == 0) {
-      // TODO(tqchen) find less hacky way to decide mirror node.
-      const std::string& name = graph_.nodes[nid].name;
-      bool is_mirror = graph_.nodes[nid].is_forward() &&
-          name.substr(name.length() - 7, 7) ==  "_mirror";
-      if (!is_mirror) backward.push_back(nid);
+      // mirror nodes are pulled in by the backward nodes that need them.
+      if (mirror_source_map_.count(nid) == 0) backward.push_back(nid);
     }
   }
   std::unordered_set<uint32_t> finished(fwd_nodes.begin(), fwd_nodes.end());
@@ -380,12 +496,18 @@ void GraphExecutor::InitGraph(const Symbol &symbol,
   for (uint32_t nid : topo) {
     if (finished.count(nid) == 0) topo_order_.push_back(nid);
   }
+  if (offload.size() != 0) this->PlaceOffload(offload);
   // setup all the operator nodes data structure
   op_nodes_.resize(graph_.nodes.size());
   for (size_t i = 0; i < graph_.nodes.size(); ++i) {
     op_nodes_[i].ctx = ctx_assignment[i];
     op_nodes_[i].outputs.resize(GetNumOutputs(i));
+    for (DataEntryInfo &info : op_nodes_[i].outputs) {
+      info.layout = layout_assignment[i];
+    }
   }
+  // the graph is final, the executors reshaped from this one share its inference memo
+  graph_.infer_cache = std::make_shared<StaticGraph::InferCache>();
 }
 
 void GraphExecutor::AssignContext(const Context default_ctx,
@@ -507,6 +629,207 @@ void GraphExecutor::AssignContext(const Context default_ctx,
   CHECK_EQ(graph_.nodes.size(), ctx_plan->size());
 }
 
+void GraphExecutor::AssignOffload(const std::vector<NDArray> &in_args,
+                                  std::vector<Context> *ctx_plan,
+                                  std::vector<std::pair<uint32_t, uint32_t> > *offload) {
+  const bool enabled = dmlc::GetEnv("MXNET_EXEC_OFFLOAD", false);
+  const size_t min_bytes = dmlc::GetEnv("MXNET_EXEC_OFFLOAD_MIN_BYTES", size_t(1) << 20);
+  const size_t num_nodes = graph_.nodes.size();
+  std::vector<uint32_t> head_nodes;
+  for (const auto& head : graph_.heads) {
+    head_nodes.push_back(head.source_id);
+  }
+  std::vector<uint32_t> fwd_nodes = graph_.PostDFSOrder(head_nodes);
+  std::vector<bool> is_fwd(num_nodes, false);
+  for (uint32_t nid : fwd_nodes) is_fwd[nid] = true;
+  std::set<StaticGraph::DataEntry> heads(graph_.heads.begin(), graph_.heads.end());
+  // the inputs of the backward pass, mirror nodes included, that are forward entries
+  std::map<StaticGraph::DataEntry, std::vector<StaticGraph::DataEntry*> > readers;
+  for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+    if (is_fwd[nid]) continue;
+    for (StaticGraph::DataEntry &e : graph_.nodes[nid].inputs) {
+      if (is_fwd[e.source_id]) readers[e].push_back(&e);
+    }
+  }
+  std::vector<std::vector<TShape> > out_shapes(num_nodes), aux_shapes(num_nodes);
+  if (enabled) {
+    for (size_t i = 0; i < num_nodes; ++i) {
+      out_shapes[i].resize(GetNumOutputs(i));
+    }
+    for (size_t i = 0; i < graph_.arg_nodes.size(); ++i) {
+      out_shapes[graph_.arg_nodes[i]][0] = in_args[i].shape();
+    }
+    graph_.InferNodeShapes(fwd_nodes, &out_shapes, &aux_shapes, true);
+  }
+  // an offload node copies the entry to pinned memory after the forward pass is done
+  // with it, a prefetch node copies it back to the gpu for the backward pass.
+  std::vector<StaticGraph::Node> new_nodes;
+  for (auto &kv : readers) {
+    const StaticGraph::DataEntry &e = kv.first;
+    const StaticGraph::Node &src = graph_.nodes[e.source_id];
+    const Context ctx = ctx_plan->at(e.source_id);
+    if (src.is_variable() || ctx.dev_mask() != gpu::kDevMask || heads.count(e) != 0) continue;
+    if (!src.get_attr("force_offload", false)) {
+      if (!enabled) continue;
+      const TShape &shape = out_shapes[e.source_id][e.index];
+      if (shape.ndim() == 0 || shape.Size() * sizeof(real_t) < min_bytes) continue;
+    }
+    uint32_t offload_id = static_cast<uint32_t>(num_nodes + new_nodes.size());
+    std::ostringstream os;
+    os << src.name << '_' << e.index;
+    StaticGraph::Node offload_node = StaticGraph::CreateCopyNode(e);
+    offload_node.name = os.str() + "_offload";
+    new_nodes.push_back(offload_node);
+    ctx_plan->push_back(Context::CPUPinned(ctx.dev_id));
+    StaticGraph::Node prefetch_node =
+        StaticGraph::CreateCopyNode(StaticGraph::DataEntry(offload_id, 0));
+    prefetch_node.name = os.str() + "_prefetch";
+    new_nodes.push_back(prefetch_node);
+    ctx_plan->push_back(ctx);
+    for (StaticGraph::DataEntry *r : kv.second) {
+      *r = StaticGraph::DataEntry(offload_id + 1, 0);
+    }
+    offload->push_back(std::make_pair(offload_id, offload_id + 1));
+  }
+  graph_.nodes.insert(graph_.nodes.end(), new_nodes.begin(), new_nodes.end());
+  CHECK_EQ(graph_.nodes.size(), ctx_plan->size());
+}
+
+void GraphExecutor::PlaceOffload(const std::vector<std::pair<uint32_t, uint32_t> > &offload) {
+  const size_t steps = dmlc::GetEnv("MXNET_EXEC_OFFLOAD_PREFETCH_STEPS", 4);
+  offload_nodes_.assign(graph_.nodes.size(), false);
+  for (const auto &kv : offload) {
+    const uint32_t offload_id = kv.first, prefetch_id = kv.second;
+    const StaticGraph::DataEntry e = graph_.nodes[offload_id].inputs[0];
+    offload_nodes_[offload_id] = true;
+    // the copies are only reached from the backward pass, after num_forward_nodes_
+    topo_order_.erase(std::remove_if(topo_order_.begin() + num_forward_nodes_, topo_order_.end(),
+                                     [=](uint32_t nid) {
+                                       return nid == offload_id || nid == prefetch_id;
+                                     }),
+                      topo_order_.end());
+    // the offload runs right after the last forward user, the entry is then released
+    size_t pos = 0;
+    for (size_t i = 0; i < num_forward_nodes_; ++i) {
+      const uint32_t nid = topo_order_[i];
+      if (nid == e.source_id) pos = i + 1;
+      for (const StaticGraph::DataEntry &in : graph_.nodes[nid].inputs) {
+        if (in == e) pos = i + 1;
+      }
+    }
+    topo_order_.insert(topo_order_.begin() + pos, offload_id);
+    ++num_forward_nodes_;
+    // the prefetch runs a few steps ahead of the first backward user
+    size_t first = topo_order_.size();
+    for (size_t i = num_forward_nodes_; i < topo_order_.size() && first == topo_order_.size();
+         ++i) {
+      for (const StaticGraph::DataEntry &in : graph_.nodes[topo_order_[i]].inputs) {
+        if (in.source_id == prefetch_id) first = i;
+      }
+    }
+    pos = std::max(num_forward_nodes_, first > steps ? first - steps : 0);
+    topo_order_.insert(topo_order_.begin() + pos, prefetch_id);
+  }
+}
+
+void GraphExecutor::AssignLayouts(const std::vector<NDArray> &in_args,
+                                  std::vector<Context> *ctx_plan,
+                                  std::vector<int> *layout_plan) {
+  for (const Context &ctx : *ctx_plan) {
+    if (ctx.dev_mask() != cpu::kDevMask) return;
+  }
+  const size_t num_nodes = graph_.nodes.size();
+  std::vector<uint32_t> topo = graph_.TopoSort();
+  std::vector<std::vector<TShape> > out_shapes(num_nodes), aux_shapes(num_nodes);
+  std::vector<std::vector<int> > out_types(num_nodes), aux_types(num_nodes);
+  for (size_t i = 0; i < num_nodes; ++i) {
+    out_shapes[i].resize(GetNumOutputs(i));
+    out_types[i].resize(GetNumOutputs(i), -1);
+  }
+  for (size_t i = 0; i < graph_.arg_nodes.size(); ++i) {
+    out_shapes[graph_.arg_nodes[i]][0] = in_args[i].shape();
+    out_types[graph_.arg_nodes[i]][0] = in_args[i].dtype();
+  }
+  // a graph that cannot be inferred keeps the plain layout, InitDataEntryInfo reports it.
+  if (!graph_.InferNodeShapes(topo, &out_shapes, &aux_shapes, true) ||
+      !graph_.InferNodeTypes(topo, &out_types, &aux_types)) {
+    return;
+  }
+  auto blockable = [&](const TShape &shape, int type_flag) {
+    return type_flag == mshadow::kFloat32 && shape.ndim() == 4 && shape[1] % 8 == 0;
+  };
+  auto layout_name = [](int layout) {
+    return layout == kLayoutNCHW8c ? "NCHW8c" : "NCHW";
+  };
+  // automatically create reorder node
+  std::map<StaticGraph::DataEntry, std::map<int, uint32_t> > reorder_node;
+  std::vector<StaticGraph::Node> new_nodes;
+  auto convert = [&](StaticGraph::DataEntry *e, int layout) {
+    const int src = layout_plan->at(e->source_id);
+    if (src == layout) return;
+    std::map<int, uint32_t>& rmap = reorder_node[*e];
+    if (rmap.count(layout) == 0) {
+      uint32_t new_node_id = static_cast<uint32_t>(num_nodes + new_nodes.size());
+      StaticGraph::Node new_node;
+      new_node.op.reset(OperatorProperty::Create("_LayoutReorder"));
+      new_node.op->Init({{"src_layout", layout_name(src)}, {"dst_layout", layout_name(layout)}});
+      new_node.inputs = {*e};
+      std::ostringstream os;
+      os << graph_.nodes[e->source_id].name << '_' << e->index << "_reorder";
+      new_node.name = os.str();
+      new_nodes.push_back(std::move(new_node));
+      rmap[layout] = new_node_id;
+      ctx_plan->push_back(ctx_plan->at(e->source_id));
+      layout_plan->push_back(layout);
+      CHECK_EQ(layout_plan->size(), new_node_id + 1);
+    }
+    *e = StaticGraph::DataEntry(rmap[layout], 0);
+  };
+
+  for (uint32_t nid : topo) {
+    StaticGraph::Node &node = graph_.nodes[nid];
+    if (!node.is_forward()) continue;
+    // all the inputs and outputs of a blocked node are blocked, including weights.
+    bool all_blockable = node.inputs.size() != 0;
+    std::vector<TShape> in_shapes;
+    for (const StaticGraph::DataEntry &e : node.inputs) {
+      in_shapes.push_back(out_shapes[e.source_id][e.index]);
+      all_blockable = all_blockable &&
+          blockable(out_shapes[e.source_id][e.index], out_types[e.source_id][e.index]);
+    }
+    for (size_t j = 0; j < out_shapes[nid].size(); ++j) {
+      all_blockable = all_blockable && blockable(out_shapes[nid][j], out_types[nid][j]);
+    }
+    int layout = kLayoutNCHW;
+    if (all_blockable) {
+      const int preferred = node.op->ListCPULayouts(in_shapes)[0];
+      if (preferred == kLayoutAny) {
+        // element-wise ops keep the layout of their first input, the others follow it.
+        for (const TShape &shape : in_shapes) {
+          all_blockable = all_blockable && shape == out_shapes[nid][0];
+        }
+        if (all_blockable) layout = layout_plan->at(node.inputs[0].source_id);
+      } else if (preferred != kLayoutNCHW) {
+        layout = preferred;
+        std::string type = node.op->TypeString();
+        std::map<std::string, std::string> kwargs = node.op->GetParams();
+        kwargs["layout"] = layout_name(layout);
+        node.op.reset(OperatorProperty::Create(type.c_str()));
+        node.op->Init(std::vector<std::pair<std::string, std::string> >(
+            kwargs.begin(), kwargs.end()));
+      }
+    }
+    layout_plan->at(nid) = layout;
+    for (StaticGraph::DataEntry &e : node.inputs) convert(&e, layout);
+  }
+  // the outputs are returned in the plain layout
+  for (StaticGraph::DataEntry &e : graph_.heads) convert(&e, kLayoutNCHW);
+  for (StaticGraph::Node &node : new_nodes) {
+    graph_.nodes.push_back(std::move(node));
+  }
+  CHECK_EQ(graph_.nodes.size(), ctx_plan->size());
+}
+
 void GraphExecutor::InitDataEntryInfo(const std::vector<NDArray> &in_args,
                                       const std::vector<NDArray> &arg_grad_store,
                                       const std::vector<OpReqType> &grad_req_type,
@@ -528,15 +851,23 @@ void GraphExecutor::InitDataEntryInfo(const std::vector<NDArray> &in_args,
     op_nodes_[e.source_id].activated = true;
   }
   // need Backward pass
+  grad_ready_args_.clear();
+  grad_ready_early_.clear();
   if (arg_grads_.size() != 0) {
     CHECK_EQ(arg_grads_.size(), arg_grad_store.size());
     CHECK_EQ(arg_grads_.size(), grad_req_type.size());
+    grad_ready_args_.resize(graph_.nodes.size());
     // setup gradient placeholders
     for (size_t i = 0; i < arg_grads_.size(); ++i) {
       if (grad_req_type[i] == kNullOp) continue;
       CHECK_NE(grad_req_type[i], kWriteInplace)
           << "Gradient request can only be nullop, add, write";
       StaticGraph::DataEntry &grad_source = arg_grads_[i];
+      if (graph_.nodes[grad_source.source_id].is_backward()) {
+        grad_ready_args_[grad_source.source_id].push_back(static_cast<uint32_t>(i));
+      } else {
+        grad_ready_early_.push_back(static_cast<uint32_t>(i));
+      }
       DataEntryInfo &info = op_nodes_[grad_source.source_id].outputs[grad_source.index];
       info.type = kBindByExternal;
       info.op_req = grad_req_type[i];
@@ -632,6 +963,116 @@ void GraphExecutor::InitDataEntryInfo(const std::vector<NDArray> &in_args,
   }
 }
 
+int GraphExecutor::GetConcatDim(uint32_t concat_nid, const TShape &out_shape) const {
+  const StaticGraph::Node &node = graph_.nodes[concat_nid];
+  if (node.op == nullptr || node.op->TypeString() != "Concat") return -1;
+  std::map<std::string, std::string> params = node.op->GetParams();
+  const int dim = params.count("dim") ? atoi(params["dim"].c_str()) : 1;
+  // the slices are contiguous only if all of the leading dimensions are 1
+  for (int i = 0; i < dim; ++i) {
+    if (out_shape[i] != 1) return -1;
+  }
+  return dim;
+}
+
+int GraphExecutor::GetSliceDim(uint32_t slice_nid, const TShape &in_shape) const {
+  const StaticGraph::Node &node = graph_.nodes[slice_nid];
+  if (node.op == nullptr || node.op->TypeString() != "SliceChannel") return -1;
+  std::map<std::string, std::string> params = node.op->GetParams();
+  const int axis = params.count("axis") ? atoi(params["axis"].c_str()) : 1;
+  if (axis < 0 || axis >= static_cast<int>(in_shape.ndim())) return -1;
+  // the slices are contiguous only if all of the leading dimensions are 1
+  for (int i = 0; i < axis; ++i) {
+    if (in_shape[i] != 1) return -1;
+  }
+  return axis;
+}
+
+bool GraphExecutor::IsReshape(uint32_t nid) const {
+  const StaticGraph::Node &node = graph_.nodes[nid];
+  if (node.addto_index.size() != 0 || node.inputs.size() != 1) return false;
+  const StaticGraph::Node &fwd =
+      node.is_forward() ? node : graph_.nodes[node.backward_source_id];
+  if (fwd.op == nullptr) return false;
+  const std::string type = fwd.op->TypeString();
+  return type == "Reshape" || type == "Flatten";
+}
+
+bool GraphExecutor::IsFusedCast(uint32_t nid) const {
+  const StaticGraph::Node &node = graph_.nodes[nid];
+  if (!node.is_forward() || node.inputs.size() != 1) return false;
+  if (node.op->TypeString() != "Cast") return false;
+  auto is_float = [](int type_flag) {
+    return type_flag == mshadow::kFloat16 || type_flag == mshadow::kFloat32 ||
+        type_flag == mshadow::kFloat64;
+  };
+  const DataEntryInfo &in = op_nodes_[node.inputs[0].source_id].outputs[node.inputs[0].index];
+  if (!is_float(in.type_flag) || !is_float(op_nodes_[nid].outputs[0].type_flag)) return false;
+  for (const StaticGraph::DataEntry &e : graph_.heads) {
+    if (e.source_id == nid) return false;
+  }
+  bool has_reader = false;
+  for (uint32_t reader : topo_order_) {
+    if (!op_nodes_[reader].activated) continue;
+    const StaticGraph::Node &rnode = graph_.nodes[reader];
+    for (size_t k = 0; k < rnode.inputs.size(); ++k) {
+      if (rnode.inputs[k].source_id != nid) continue;
+      if (!rnode.is_forward() || op_nodes_[reader].ctx != op_nodes_[nid].ctx) return false;
+      std::vector<int> fused = rnode.op->CastOnLoadInputs(op_nodes_[reader].ctx);
+      if (std::find(fused.begin(), fused.end(), static_cast<int>(k)) == fused.end()) {
+        return false;
+      }
+      has_reader = true;
+    }
+  }
+  return has_reader;
+}
+
+void GraphExecutor::InitConcatGroups(std::vector<uint32_t> *group_nodes) {
+  group_nodes->clear();
+  if (!enable_concat_alias_ && !enable_slice_alias_) return;
+  for (uint32_t nid : topo_order_) {
+    const StaticGraph::Node &node = graph_.nodes[nid];
+    if (!op_nodes_[nid].activated || node.is_variable()) continue;
+    DataEntryInfo &out = op_nodes_[nid].outputs[0];
+    if (out.type != kNotInitialized) continue;
+    // the backward of a slice channel concatenates the output gradients, which
+    // the backward of the readers of the slices then write in place
+    const bool slice_backward = enable_slice_alias_ && node.is_backward() &&
+        node.addto_index.size() == 0 && op_nodes_[nid].outputs.size() == 1 &&
+        GetSliceDim(node.backward_source_id, out.shape) >= 0;
+    if (!slice_backward && !(enable_concat_alias_ && node.is_forward() &&
+                             GetConcatDim(nid, out.shape) >= 0)) {
+      continue;
+    }
+    // every input must be the internal output of another node, used once, the
+    // output gradients can be written by backward nodes
+    bool ok = true;
+    for (size_t i = 0; i < node.inputs.size() && ok; ++i) {
+      const StaticGraph::DataEntry &e = node.inputs[i];
+      const DataEntryInfo &info = op_nodes_[e.source_id].outputs[e.index];
+      ok = (slice_backward || graph_.nodes[e.source_id].is_forward()) &&
+          info.type == kNotInitialized && info.concat_group == -1 &&
+          info.type_flag == out.type_flag &&
+          op_nodes_[e.source_id].ctx == op_nodes_[nid].ctx;
+      for (size_t j = 0; j < i && ok; ++j) ok = !(node.inputs[j] == e);
+    }
+    if (!ok) continue;
+    // the backward of a slice channel writes nothing, like a reshape
+    if (slice_backward) output_alias_[nid] = true;
+    const int group = static_cast<int>(group_nodes->size());
+    size_t offset = 0;
+    for (const StaticGraph::DataEntry &e : node.inputs) {
+      DataEntryInfo &info = op_nodes_[e.source_id].outputs[e.index];
+      info.concat_group = group;
+      info.storage_offset = offset;
+      offset += info.shape.Size();
+    }
+    out.concat_group = group;
+    group_nodes->push_back(nid);
+  }
+}
+
 void GraphExecutor::InitDataEntryMemory() {
   // setup the temp ref counter for allocator algorithms
   for (OpNode &op : op_nodes_) {
@@ -639,9 +1080,22 @@ void GraphExecutor::InitDataEntryMemory() {
       node.temp_ref_count = node.ref_count;
     }
   }
+  output_alias_.assign(graph_.nodes.size(), false);
+  // the storage of a concat group is requested by its first producer
+  std::vector<uint32_t> group_nodes;
+  this->InitConcatGroups(&group_nodes);
+  std::vector<GraphStorageAllocator::StorageID> group_storage(
+      group_nodes.size(), GraphStorageAllocator::kBadStorageID);
+  // number of entries holding each storage, which is released when none holds it
+  std::map<GraphStorageAllocator::StorageID, int> storage_ref;
 
   // use allocator to allocate memory.
   GraphStorageAllocator allocator(&graph_, topo_order_, shared_mem_);
+  auto release = [&allocator, &storage_ref](DataEntryInfo *info, uint32_t nid) {
+    if (--storage_ref[info->storage_id] == 0) {
+      allocator.Release(info->storage_id, nid);
+    }
+  };
   for (size_t i = 0; i < topo_order_.size(); ++i) {
     uint32_t nid = topo_order_[i];
     if (!op_nodes_[nid].activated) continue;
@@ -663,34 +1117,163 @@ void GraphExecutor::InitDataEntryMemory() {
       CHECK_NE(out_data[i]->type, kInternalAllocated);
     }
 
+    const StaticGraph::Node &gnode = graph_.nodes[nid];
+    std::vector<bool> aliased(out_data.size(), false);
+    // a reshape outputs its input in the new shape, without running
+    if (enable_reoutput_alias_ && out_data.size() == 1 && IsReshape(nid)) {
+      DataEntryInfo *in = in_data[0];
+      DataEntryInfo *out = out_data[0];
+      if (in->type == kInternalAllocated && in->concat_group == -1 &&
+          out->type == kNotInitialized && out->concat_group == -1 &&
+          in->type_flag == out->type_flag && in->layout == out->layout &&
+          op_nodes_[gnode.inputs[0].source_id].ctx == op_nodes_[nid].ctx) {
+        out->type = kInternalAllocated;
+        out->storage_id = in->storage_id;
+        out->storage_offset = in->storage_offset;
+        if (in->temp_ref_count == 1 && !in->shared_storage) {
+          // the storage passes to the output, as inplace
+          in->temp_ref_count = 0;
+          in->inplace_op_id = static_cast<int>(nid);
+        } else {
+          in->shared_storage = true;
+          out->shared_storage = true;
+          ++storage_ref[in->storage_id];
+        }
+        aliased[0] = true;
+        output_alias_[nid] = true;
+      }
+    }
+
+    // the readers of a cast read its input, converting on load
+    if (enable_cast_alias_ && out_data.size() == 1 && IsFusedCast(nid)) {
+      DataEntryInfo *in = in_data[0];
+      DataEntryInfo *out = out_data[0];
+      if ((in->type == kInternalAllocated || in->type == kBindByExternal) &&
+          in->concat_group == -1 && out->type == kNotInitialized &&
+          out->concat_group == -1 && in->layout == out->layout &&
+          op_nodes_[gnode.inputs[0].source_id].ctx == op_nodes_[nid].ctx) {
+        // the storage is always shared, the readers can not write inplace
+        // into the storage of another type
+        if (in->type == kBindByExternal) {
+          out->type = kBindByExternal;
+          out->data = in->data;
+        } else {
+          out->type = kInternalAllocated;
+          out->storage_id = in->storage_id;
+          out->storage_offset = in->storage_offset;
+          in->shared_storage = true;
+          out->shared_storage = true;
+          ++storage_ref[in->storage_id];
+        }
+        aliased[0] = true;
+        output_alias_[nid] = true;
+      }
+    }
+
+    // the outputs of a slice channel are views of their slices of the input
+    if (enable_slice_alias_ && gnode.is_forward() && in_data.size() == 1 &&
+        GetSliceDim(nid, in_data[0]->shape) >= 0) {
+      DataEntryInfo *in = in_data[0];
+      if (in->type == kInternalAllocated && in->concat_group == -1 &&
+          op_nodes_[gnode.inputs[0].source_id].ctx == op_nodes_[nid].ctx) {
+        size_t offset = in->storage_offset;
+        bool all = true;
+        for (size_t k = 0; k < out_data.size(); ++k) {
+          DataEntryInfo *out = out_data[k];
+          if (out->type == kNotInitialized && out->concat_group == -1 &&
+              out->type_flag == in->type_flag) {
+            // the storage is shared, the readers can not write inplace into a slice
+            out->type = kInternalAllocated;
+            out->storage_id = in->storage_id;
+            out->storage_offset = offset;
+            out->shared_storage = true;
+            in->shared_storage = true;
+            ++storage_ref[in->storage_id];
+            aliased[k] = true;
+          } else {
+            all = false;
+          }
+          offset += out->shape.Size();
+        }
+        output_alias_[nid] = all;
+      }
+    }
+
     auto inplace = GetInplaceOption(nid, in_data, out_data);
 
     for (std::pair<DataEntryInfo*, DataEntryInfo*> kv : inplace) {
       DataEntryInfo* in = kv.first;
       DataEntryInfo* out = kv.second;
+      // the slices of a concat are read through the concat output later on
       if (enable_inplace_allocation_ &&
           in->temp_ref_count == 1 &&
           in->type == kInternalAllocated &&
-          out->type == kNotInitialized) {
+          in->concat_group == -1 &&
+          !in->shared_storage &&
+          out->type == kNotInitialized &&
+          out->concat_group == -1) {
         // we can only do inplace if we are last user of in
         // and out is not initialized.
         out->type = kInternalAllocated;
         out->op_req = kWriteInplace;
         out->storage_id = in->storage_id;
+        out->storage_offset = in->storage_offset;
         // set inplace op id
         in->temp_ref_count = 0;
         in->inplace_op_id = static_cast<int>(nid);
       }
     }
+    // the gradients of a concat backward are slices of the output gradient
+    if (enable_concat_alias_ && gnode.is_backward() && gnode.addto_index.size() == 0 &&
+        in_data.size() == 1 && in_data[0]->type == kInternalAllocated &&
+        in_data[0]->temp_ref_count == 1 && !in_data[0]->shared_storage &&
+        GetConcatDim(gnode.backward_source_id, in_data[0]->shape) >= 0) {
+      DataEntryInfo *grad = in_data[0];
+      size_t offset = grad->storage_offset;
+      for (size_t k = 0; k < out_data.size(); ++k) {
+        DataEntryInfo *out = out_data[k];
+        if (out->type == kNotInitialized && out->concat_group == -1 &&
+            out->type_flag == grad->type_flag) {
+          out->type = kInternalAllocated;
+          out->storage_id = grad->storage_id;
+          out->storage_offset = offset;
+          ++storage_ref[grad->storage_id];
+          aliased[k] = true;
+        }
+        offset += out->shape.Size();
+      }
+    }
     // allocate output,
     for (DataEntryInfo *out : out_data) {
       if (out->op_req == kNullOp && out->temp_ref_count != 0) {
         out->op_req = kWriteTo;
       }
+      if (out->type == kNotInitialized && out->concat_group != -1) {
+        GraphStorageAllocator::StorageID &id = group_storage[out->concat_group];
+        if (id == GraphStorageAllocator::kBadStorageID) {
+          const uint32_t concat_nid = group_nodes[out->concat_group];
+          CHECK_NE(concat_nid, nid) << "concat output planned before its inputs";
+          id = allocator.Request(op_nodes_[nid].ctx, out->type_flag,
+                                 op_nodes_[concat_nid].outputs[0].shape, nid);
+          storage_ref[id] = 0;
+        }
+        out->storage_id = id;
+        out->type = kInternalAllocated;
+        ++storage_ref[id];
+      }
       if (out->type == kNotInitialized) {
         out->storage_id = allocator.Request(
             op_nodes_[nid].ctx, out->type_flag, out->shape, nid);
         out->type = kInternalAllocated;
+        storage_ref[out->storage_id] = 1;
+      }
+    }
+    // the concat, and its backward, only write the slices that are not aliased, as
+    // does a slice channel, and a reshape or the backward of a slice channel writes nothing
+    for (size_t k = 0; k < out_data.size(); ++k) {
+      if (aliased[k] || (out_data[k]->concat_group != -1 &&
+                         group_nodes[out_data[k]->concat_group] == nid)) {
+        out_data[k]->op_req = kNullOp;
       }
     }
     // then free inputs
@@ -703,18 +1286,20 @@ void GraphExecutor::InitDataEntryMemory() {
       // if we decrease it to zero, means we are ready to relase
       --in->temp_ref_count;
       if (in->temp_ref_count == 0 && in->type == kInternalAllocated) {
-        allocator.Release(in->storage_id, nid);
+        release(in, nid);
       }
     }
     // check out again, if there is temp_ref_count == 0, release it
     for (DataEntryInfo *out : out_data) {
       if (out->temp_ref_count == 0 && out->type == kInternalAllocated) {
-        allocator.Release(out->storage_id, nid);
+        release(out, nid);
       }
     }
   }
   // one pass complete, allocate real memory
   this->total_allocated_bytes_ = allocator.InitStorages();
+  this->planned_bytes_ = allocator.planned_bytes();
+  this->num_storage_chunks_ = allocator.num_chunks();
   // get the real data NDArray into the DataEntryInfo
   for (size_t i = 0; i < topo_order_.size(); ++i) {
     uint32_t nid = topo_order_[i];
@@ -722,7 +1307,7 @@ void GraphExecutor::InitDataEntryMemory() {
     for (DataEntryInfo &out : op_nodes_[nid].outputs) {
       CHECK_NE(out.type, kNotInitialized);
       if (out.type == kInternalAllocated) {
-        out.data = allocator.Get(out.storage_id, out.shape);
+        out.data = allocator.Get(out.storage_id, out.shape, out.storage_offset);
       }
     }
   }
@@ -782,7 +1367,8 @@ void GraphExecutor::InitResources() {
           cmap[color] = r;
           ++total_allocated_temp_;
         }
-      } else if (req.type == ResourceRequest::kRandom) {
+      } else if (req.type == ResourceRequest::kRandom ||
+                 req.type == ResourceRequest::kParallelRandom) {
         requested.push_back(ResourceManager::Get()->Request(ctx, req));
       } else {
         LOG(FATAL) << "resource type not yet supported";
@@ -791,26 +1377,87 @@ void GraphExecutor::InitResources() {
   }
 }
 
-void GraphExecutor::InitOperators() {
+void GraphExecutor::CreateForwardOperator(uint32_t nid, const GraphExecutor* src) {
+  OpNode& op_node = op_nodes_[nid];
+  std::vector<int> in_types;
+  std::vector<TShape> in_shapes;
+  bool same_inputs = src != nullptr && src->op_nodes_[nid].op != nullptr;
+  for (auto e : graph_.nodes[nid].inputs) {
+    const DataEntryInfo& info = op_nodes_[e.source_id].outputs[e.index];
+    in_types.push_back(info.type_flag);
+    in_shapes.push_back(info.shape);
+    if (same_inputs) {
+      const DataEntryInfo& src_info = src->op_nodes_[e.source_id].outputs[e.index];
+      same_inputs = src_info.shape == info.shape && src_info.type_flag == info.type_flag;
+    }
+  }
+  if (same_inputs) {
+    op_node.op = src->op_nodes_[nid].op;
+    return;
+  }
+  op_node.op.reset(graph_.nodes[nid].op->CreateOperatorEx(op_node.ctx, &in_shapes, &in_types));
+}
+
+void GraphExecutor::InitOperators(const GraphExecutor* src) {
+  // the forward nodes by device
+  std::map<Context, std::vector<uint32_t> > fwd_nodes;
+  size_t num_fwd = 0;
   for (size_t i = 0; i < topo_order_.size(); ++i) {
     uint32_t nid = topo_order_[i];
     if (!op_nodes_[nid].activated) continue;
     if (graph_.nodes[nid].is_variable()) continue;
-    OpNode& op_node = op_nodes_[nid];
     if (graph_.nodes[nid].is_forward()) {
-      std::vector<int> in_types;
-      std::vector<TShape> in_shapes;
-      for (auto e : graph_.nodes[nid].inputs) {
-        in_types.push_back(op_nodes_[e.source_id].outputs[e.index].type_flag);
-        in_shapes.push_back(op_nodes_[e.source_id].outputs[e.index].shape);
+      fwd_nodes[op_nodes_[nid].ctx].push_back(nid);
+      ++num_fwd;
+    }
+  }
+  // the creation of an operator, such as that of cudnn, can take long, the
+  // threads of a device take its nodes in turn after setting the device
+  const int num_threads = dmlc::GetEnv("MXNET_EXEC_INIT_THREADS", 4);
+  if (num_threads <= 1 || num_fwd < 2) {
+    for (const auto& kv : fwd_nodes) {
+      for (uint32_t nid : kv.second) CreateForwardOperator(nid, src);
+    }
+  } else {
+    const int threads_per_ctx = std::max(1, num_threads / static_cast<int>(fwd_nodes.size()));
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<std::atomic<size_t> > > next;
+    std::mutex error_mu;
+    std::string error;
+    for (const auto& kv : fwd_nodes) {
+      next.emplace_back(new std::atomic<size_t>(0));
+      std::atomic<size_t>* next_node = next.back().get();
+      const Context ctx = kv.first;
+      const std::vector<uint32_t>* nodes = &kv.second;
+      const int n = std::min<int>(threads_per_ctx, nodes->size());
+      for (int t = 0; t < n; ++t) {
+        threads.emplace_back([this, src, ctx, nodes, next_node, &error_mu, &error]() {
+            try {
+#if MXNET_USE_CUDA
+              if (ctx.dev_mask() == gpu::kDevMask) mshadow::SetDevice<gpu>(ctx.dev_id);
+#endif
+              for (size_t i = (*next_node)++; i < nodes->size(); i = (*next_node)++) {
+                CreateForwardOperator((*nodes)[i], src);
+              }
+            } catch (const dmlc::Error& e) {
+              std::lock_guard<std::mutex> lock(error_mu);
+              if (error.empty()) error = e.what();
+            }
+          });
       }
-      op_node.op.reset(graph_.nodes[nid].op->CreateOperatorEx(op_node.ctx, &in_shapes, &in_types));
-    } else {
-      CHECK(graph_.nodes[nid].is_backward());
-      op_node.op.reset(new BackwardOpWrapper(
-          graph_.nodes[graph_.nodes[nid].backward_source_id].op.get(),
-          op_nodes_[graph_.nodes[nid].backward_source_id].op));
     }
+    for (std::thread& t : threads) t.join();
+    if (!error.empty()) LOG(FATAL) << error;
+  }
+  for (size_t i = 0; i < topo_order_.size(); ++i) {
+    uint32_t nid = topo_order_[i];
+    if (!op_nodes_[nid].activated) continue;
+    if (graph_.nodes[nid].is_variable()) continue;
+    if (graph_.nodes[nid].is_forward()) continue;
+    CHECK(graph_.nodes[nid].is_backward());
+    op_nodes_[nid].op.reset(new BackwardOpWrapper(
+        graph_.nodes[graph_.nodes[nid].backward_source_id].op.get(),
+        op_nodes_[graph_.nodes[nid].backward_source_id].op));
   }
 }
 
@@ -819,6 +1466,7 @@ void GraphExecutor::InitCachedOps() {
     uint32_t nid = topo_order_[i];
     if (!op_nodes_[nid].activated) continue;
     if (graph_.nodes[nid].is_variable()) continue;
+    if (output_alias_[nid]) continue;
     OpNode& op_node = op_nodes_[nid];
     bool allow_cache = true;
     for (StaticGraph::DataEntry e : graph_.nodes[nid].inputs) {
@@ -834,28 +1482,155 @@ void GraphExecutor::InitCachedOps() {
           op_node.cached_exec.exec_fun,
           op_node.cached_exec.use_vars,
           op_node.cached_exec.mutate_vars,
-          FnProperty::kNormal);
+          FnProperty::kNormal,
+          graph_.nodes[nid].name.c_str());
     }
   }
 }
 
+void GraphExecutor::AssignBranches(std::vector<uint32_t> *fwd_nodes) {
+  std::vector<int> num_uses(graph_.nodes.size(), 0);
+  for (uint32_t nid : *fwd_nodes) {
+    for (const StaticGraph::DataEntry& e : graph_.nodes[nid].inputs) ++num_uses[e.source_id];
+  }
+  // a node continues the branch of its only operator input, when it is the only user of it.
+  branch_.assign(graph_.nodes.size(), -1);
+  std::vector<std::vector<uint32_t> > branches;
+  std::vector<uint32_t> order;
+  for (uint32_t nid : *fwd_nodes) {
+    const StaticGraph::Node& node = graph_.nodes[nid];
+    if (node.is_variable()) {
+      order.push_back(nid);
+      continue;
+    }
+    int src = -1, num_src = 0;
+    for (const StaticGraph::DataEntry& e : node.inputs) {
+      if (graph_.nodes[e.source_id].is_variable()) continue;
+      src = static_cast<int>(e.source_id);
+      ++num_src;
+    }
+    if (num_src == 1 && num_uses[src] == 1) {
+      branch_[nid] = branch_[src];
+    } else {
+      branch_[nid] = static_cast<int>(branches.size());
+      branches.emplace_back();
+    }
+    branches[branch_[nid]].push_back(nid);
+  }
+  // only the first node of a branch has inputs from other branches, which start before it.
+  // so the branches can be placed one after another in the order they start.
+  for (const std::vector<uint32_t>& b : branches) {
+    order.insert(order.end(), b.begin(), b.end());
+  }
+  fwd_nodes->swap(order);
+}
+
+GraphExecutor::NodeCost GraphExecutor::GetNodeCost(uint32_t nid) const {
+  const StaticGraph::Node& gnode = graph_.nodes[nid];
+  const OpNode& op_node = op_nodes_[nid];
+  auto bytes = [](const DataEntryInfo& info) {
+    return static_cast<double>(info.shape.Size()) *
+        (info.type_flag < 0 ? sizeof(real_t) : mshadow::mshadow_sizeof(info.type_flag));
+  };
+  NodeCost cost;
+  if (nid < output_alias_.size() && output_alias_[nid]) return cost;
+  for (const StaticGraph::DataEntry& e : gnode.inputs) {
+    cost.read_bytes += bytes(op_nodes_[e.source_id].outputs[e.index]);
+  }
+  for (const DataEntryInfo& out : op_node.outputs) cost.write_bytes += bytes(out);
+  const uint32_t fwd_nid = gnode.is_forward() ? nid : gnode.backward_source_id;
+  const StaticGraph::Node& fwd = graph_.nodes[fwd_nid];
+  // the parameters are the inputs of the forward node from variables, other
+  // than the data, and the auxiliary states
+  double flops = 0.0;
+  std::vector<std::string> args = fwd.op->ListArguments();
+  for (size_t i = 0; i < args.size() && i < fwd.inputs.size(); ++i) {
+    const StaticGraph::DataEntry& e = fwd.inputs[i];
+    if (args[i] == "data" || args[i] == "label") continue;
+    if (!graph_.nodes[e.source_id].is_variable()) continue;
+    const DataEntryInfo& info = op_nodes_[e.source_id].outputs[e.index];
+    if (gnode.is_forward()) cost.param_bytes += bytes(info);
+    if (args[i] == "weight" && info.shape.ndim() != 0 && info.shape[0] != 0 &&
+        op_nodes_[fwd_nid].outputs.size() != 0) {
+      flops += 2.0 * op_nodes_[fwd_nid].outputs[0].shape.Size() *
+          info.shape.Size() / info.shape[0];
+    }
+  }
+  if (flops == 0.0 && op_nodes_[fwd_nid].outputs.size() != 0) {
+    flops = op_nodes_[fwd_nid].outputs[0].shape.Size();
+  }
+  cost.flops = gnode.is_forward() ? flops : 2.0 * flops;
+  for (const DataEntryInfo& aux : op_node.aux_states) {
+    cost.read_bytes += bytes(aux);
+    cost.param_bytes += bytes(aux);
+  }
+  // the workspace of an operator is bounded by its workspace parameter, in MB
+  for (const ResourceRequest& req : GetResource(nid)) {
+    if (req.type != ResourceRequest::kTempSpace) continue;
+    std::map<std::string, std::string> params = fwd.op->GetParams();
+    auto it = params.find("workspace");
+    if (it != params.end()) cost.workspace_bytes = std::stod(it->second) * (1 << 20);
+  }
+  return cost;
+}
+
+void GraphExecutor::InitPriorities() {
+  if (!dmlc::GetEnv("MXNET_EXEC_CRITICAL_PATH_PRIORITY", true)) return;
+  // the cost of a node is its multiply-adds and the elements it reads and writes
+  std::vector<double> cost(graph_.nodes.size(), 0.0);
+  for (uint32_t nid : topo_order_) {
+    if (!op_nodes_[nid].activated || graph_.nodes[nid].is_variable()) continue;
+    NodeCost c = GetNodeCost(nid);
+    cost[nid] = c.flops / 2 + (c.read_bytes + c.write_bytes) / sizeof(real_t);
+  }
+  // bottom level, the longest path of costs from a node to the outputs
+  std::vector<double> level(graph_.nodes.size(), 0.0);
+  double max_level = 0.0;
+  for (auto it = topo_order_.rbegin(); it != topo_order_.rend(); ++it) {
+    const uint32_t nid = *it;
+    if (!op_nodes_[nid].activated) continue;
+    level[nid] += cost[nid];
+    max_level = std::max(max_level, level[nid]);
+    for (const StaticGraph::DataEntry& e : graph_.nodes[nid].inputs) {
+      level[e.source_id] = std::max(level[e.source_id], level[nid]);
+    }
+  }
+  if (max_level == 0.0) return;
+  const int kMaxPriority = 1000;
+  for (uint32_t nid : topo_order_) {
+    op_nodes_[nid].priority = static_cast<int>(level[nid] / max_level * kMaxPriority);
+  }
+}
+
 void GraphExecutor::InitOpSegs() {
   // heurestic to enable bulk execution.
   cached_seg_opr_.clear();
   CachedSegOpr p;
   p.opr = nullptr;
+  p.priority = 0;
   cached_seg_opr_.resize(topo_order_.size(), p);
 
   if (!prefer_bulk_execution_) return;
-  if (num_forward_nodes_ == topo_order_.size()) {
+  const bool forward_only = num_forward_nodes_ == topo_order_.size();
+  if (forward_only && branch_.size() == 0) {
     cached_seg_opr_[0] = this->CreateCachedSegOpr(0, topo_order_.size());
     return;
   }
+  // the learned weights, updated between the iterations
+  std::vector<bool> is_weight(graph_.nodes.size(), false);
+  if (dmlc::GetEnv("MXNET_EXEC_WEIGHT_SEGMENTS", true)) {
+    for (size_t i = 0; i < graph_.arg_nodes.size(); ++i) {
+      if (grad_req_type_[i] != kNullOp) is_weight[graph_.arg_nodes[i]] = true;
+    }
+  }
   int num_cseg = 0;
   // normal procedure
   for (size_t i = 0; i < topo_order_.size(); ++i) {
     size_t j = i;
     int hit_count = 0;
+    int branch = -1;
+    bool has_weight = false;
+    const Context *seg_ctx = nullptr;
     for (; j < topo_order_.size(); ++j) {
       if (j == num_forward_nodes_) break;
       uint32_t nid = topo_order_[j];
@@ -863,8 +1638,18 @@ void GraphExecutor::InitOpSegs() {
       const StaticGraph::Node& gnode = graph_.nodes[nid];
       if (!op_node.activated) continue;
       if (graph_.nodes[nid].is_variable()) continue;
+      if (output_alias_[nid]) continue;
       if (op_node.op->exec_type() != Operator::kSync) break;
-      bool hit = false, tobind = false;
+      // a segment runs on one device, the stages of a model parallel graph
+      // get their own segments and overlap across micro-batches
+      if (seg_ctx == nullptr) seg_ctx = &op_node.ctx;
+      if (op_node.ctx != *seg_ctx) break;
+      // independent branches go to different segments, so they can run on different streams.
+      if (branch_.size() != 0) {
+        if (branch == -1) branch = branch_[nid];
+        if (branch_[nid] != branch) break;
+      }
+      bool hit = false, tobind = false, weight = false;
 
       for (const DataEntryInfo& out : op_node.outputs) {
         if (out.type == kBindByExternal) hit = true;
@@ -875,9 +1660,14 @@ void GraphExecutor::InitOpSegs() {
         const DataEntryInfo &info = op_nodes_[e.source_id].outputs[e.index];
         if (info.type == kBindByExternal) hit = true;
         if (info.type == kTobeBindByExternal) tobind = true;
+        if (is_weight[e.source_id]) weight = true;
       }
-      if (hit) ++hit_count;
+      if (hit && !forward_only) ++hit_count;
       if (tobind) break;
+      // a forward segment waits for the updated weights of one operator only,
+      // so that the next forward starts while the later weights are pulled
+      if (weight && has_weight) break;
+      has_weight = has_weight || weight;
       // if encounter consecutive 3 blocks containing parameters, use as segment.
       // this usually means conv-relu-bn
       const int kHitMaxMagic = 2;
@@ -904,7 +1694,10 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
     if (!monitor_callback_) {
       auto seg_op = cached_seg_opr_[i];
       if (seg_op.opr != nullptr && seg_op.topo_end <= topo_end) {
-        Engine::Get()->Push(seg_op.opr, seg_op.ctx);
+        Engine::Get()->Push(seg_op.opr, seg_op.ctx, seg_op.priority + priority_offset_);
+        for (size_t j = i; j < seg_op.topo_end; ++j) {
+          NotifyGradReady(topo_order_[j]);
+        }
         i = seg_op.topo_end - 1;
         continue;
       }
@@ -916,15 +1709,21 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
     OpNode& opnode = op_nodes_[nid];
     // special handle cross device copy op
     if (opnode.op->exec_type() == Operator::kCrossDeviceCopy) {
+      // the activations are only needed on the host for a backward pass
+      if (!is_train && nid < offload_nodes_.size() && offload_nodes_[nid]) continue;
       CHECK_EQ(graph_.nodes[nid].inputs.size(), 1);
       CHECK_EQ(opnode.outputs.size(), 1);
       auto in = graph_.nodes[nid].inputs[0];
       CopyFromTo(op_nodes_[in.source_id].outputs[in.index].data,
                  &(opnode.outputs[0].data));
+      NotifyGradReady(nid);
       continue;
     }
-    if (opnode.cached_opr != nullptr) {
-      Engine::Get()->Push(opnode.cached_opr, opnode.ctx);
+    if (output_alias_[nid]) {
+      // the output is a view of the input, there is nothing to run
+    } else if (opnode.cached_opr != nullptr) {
+      Engine::Get()->Push(opnode.cached_opr, opnode.ctx,
+                          opnode.priority + priority_offset_);
     } else {
       auto exec = GetOpExecEntry(nid);
       Engine::Get()->PushAsync(
@@ -932,8 +1731,11 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
           opnode.ctx,
           exec.use_vars,
           exec.mutate_vars,
-          FnProperty::kNormal);
+          FnProperty::kNormal,
+          opnode.priority + priority_offset_,
+          graph_.nodes[nid].name.c_str());
     }
+    NotifyGradReady(nid);
     if (monitor_callback_) {
       std::vector<std::string> output_names;
       if (graph_.nodes[nid].is_forward()) {
@@ -964,8 +1766,10 @@ void GraphExecutor::Print(std::ostream &os) const {
     for (size_t j = 0; j < op_nodes_[nid].outputs.size(); ++j) {
       const DataEntryInfo &info = op_nodes_[nid].outputs[j];
       os << "\toutput[" << j << "]: shape=" << info.shape;
+      if (info.layout == kLayoutNCHW8c) os << ", layout=NCHW8c";
       if (info.storage_id != GraphStorageAllocator::kBadStorageID) {
         os << ", storage_id=" << info.storage_id;
+        if (info.storage_offset != 0) os << ", storage_offset=" << info.storage_offset;
       }
       if (info.inplace_op_id != -1) {
         os << ", inplace_consumer=" << graph_.nodes[info.inplace_op_id].name;
@@ -979,12 +1783,157 @@ void GraphExecutor::Print(std::ostream &os) const {
         os << "type=TempSpace, id=" << resource.id;
       } else if (resource.req.type == ResourceRequest::kRandom) {
         os << "type=RandomNumber";
+      } else if (resource.req.type == ResourceRequest::kParallelRandom) {
+        os << "type=ParallelRandomNumber, id=" << resource.id;
       }
       os << '\n';
     }
   }
   os << "Total " << (total_allocated_bytes_ >> 20UL) <<" MB allocated\n";
+  for (const auto& kv : planned_bytes_) {
+    os << "Peak " << (kv.second >> 20UL) << " MB planned on dev_type="
+       << kv.first.dev_type << " dev_id=" << kv.first.dev_id << '\n';
+  }
   os << "Total " << total_allocated_temp_ <<" TempSpace resource requested\n";
+  os << "Total " << num_storage_chunks_ << " storage chunks\n";
+  for (const auto& kv : init_times_) {
+    os << "Init " << kv.first << " " << kv.second << " ms\n";
+  }
+}
+
+void GraphExecutor::PrintCost(std::ostream &os) const {
+  auto print = [&os](const NodeCost& c) {
+    os << "\"flops\": " << c.flops << ", \"read_bytes\": " << c.read_bytes
+       << ", \"write_bytes\": " << c.write_bytes << ", \"param_bytes\": " << c.param_bytes
+       << ", \"workspace_bytes\": " << c.workspace_bytes;
+  };
+  // the workspace of a pass is the largest one, the operators run one by one
+  auto add = [](NodeCost* total, const NodeCost& c) {
+    total->flops += c.flops;
+    total->read_bytes += c.read_bytes;
+    total->write_bytes += c.write_bytes;
+    total->param_bytes += c.param_bytes;
+    total->workspace_bytes = std::max(total->workspace_bytes, c.workspace_bytes);
+  };
+  NodeCost totals[2];
+  os << "{\"nodes\": [";
+  bool first = true;
+  for (uint32_t nid : topo_order_) {
+    const StaticGraph::Node& gnode = graph_.nodes[nid];
+    if (!op_nodes_[nid].activated || gnode.is_variable()) continue;
+    NodeCost c = GetNodeCost(nid);
+    const bool forward = gnode.is_forward();
+    const StaticGraph::Node& fwd = forward ? gnode : graph_.nodes[gnode.backward_source_id];
+    os << (first ? "" : ", ") << "{\"name\": \"" << fwd.name << "\", \"op\": \""
+       << fwd.op->TypeString() << "\", \"pass\": \"" << (forward ? "forward" : "backward")
+       << "\", ";
+    print(c);
+    os << "}";
+    first = false;
+    add(&totals[forward ? 0 : 1], c);
+  }
+  os << "]";
+  NodeCost total;
+  const char* passes[] = {"forward", "backward"};
+  for (int i = 0; i < 2; ++i) {
+    os << ", \"" << passes[i] << "\": {";
+    print(totals[i]);
+    os << "}";
+    add(&total, totals[i]);
+  }
+  total.param_bytes = totals[0].param_bytes;
+  const double bytes = total.read_bytes + total.write_bytes;
+  os << ", \"total\": {";
+  print(total);
+  os << ", \"intensity\": " << (bytes == 0 ? 0.0 : total.flops / bytes) << "}}";
+}
+
+void GraphExecutor::AddNodeTimes(const std::vector<uint32_t> &nids,
+                                 const std::vector<double> &ms) {
+  CHECK_EQ(nids.size(), ms.size());
+  std::lock_guard<std::mutex> lock(node_times_mutex_);
+  if (node_times_.size() == 0) node_times_.resize(graph_.nodes.size());
+  for (size_t i = 0; i < nids.size(); ++i) {
+    NodeTime& t = node_times_[nids[i]];
+    ++t.count;
+    t.total_ms += ms[i];
+    t.max_ms = std::max(t.max_ms, ms[i]);
+  }
+}
+
+void GraphExecutor::PrintProfile(std::ostream &os, bool reset) {
+  std::lock_guard<std::mutex> lock(node_times_mutex_);
+  // the mean time of a pass is the sum of the mean times of its nodes
+  double pass_ms[2] = {0, 0};
+  os << "{\"nodes\": [";
+  bool first = true;
+  for (uint32_t nid : topo_order_) {
+    if (nid >= node_times_.size() || node_times_[nid].count == 0) continue;
+    const NodeTime& t = node_times_[nid];
+    const StaticGraph::Node& gnode = graph_.nodes[nid];
+    const bool forward = gnode.is_forward();
+    const StaticGraph::Node& fwd = forward ? gnode : graph_.nodes[gnode.backward_source_id];
+    const double mean_ms = t.total_ms / t.count;
+    os << (first ? "" : ", ") << "{\"name\": \"" << fwd.name << "\", \"op\": \""
+       << fwd.op->TypeString() << "\", \"pass\": \"" << (forward ? "forward" : "backward")
+       << "\", \"count\": " << t.count << ", \"total_ms\": " << t.total_ms
+       << ", \"mean_ms\": " << mean_ms << ", \"max_ms\": " << t.max_ms << "}";
+    first = false;
+    pass_ms[forward ? 0 : 1] += mean_ms;
+  }
+  os << "], \"forward\": {\"mean_ms\": " << pass_ms[0]
+     << "}, \"backward\": {\"mean_ms\": " << pass_ms[1] << "}}";
+  if (reset) node_times_.clear();
+}
+
+Executor *GraphExecutor::Reshape(const std::vector<NDArray> &in_args,
+                                 const std::vector<NDArray> &arg_grad_store,
+                                 const std::vector<NDArray> &aux_states) {
+  CHECK_EQ(arg_grad_store.size(), grad_req_type_.size());
+  for (size_t i = 0; i < grad_req_type_.size(); ++i) {
+    CHECK(grad_req_type_[i] == kNullOp || !arg_grad_store[i].is_none())
+        << "Reshape must provide the gradient of argument " << i;
+  }
+  // the graph is reused, only the shape dependent states are initialized.
+  GraphExecutor *exec = new GraphExecutor();
+  exec->enable_inplace_allocation_ = enable_inplace_allocation_;
+  exec->enable_concat_alias_ = enable_concat_alias_;
+  exec->enable_reoutput_alias_ = enable_reoutput_alias_;
+  exec->enable_slice_alias_ = enable_slice_alias_;
+  exec->enable_cast_alias_ = enable_cast_alias_;
+  exec->prefer_bulk_execution_ = prefer_bulk_execution_;
+  exec->profiling_ = profiling_.load();
+  exec->priority_offset_ = priority_offset_;
+  exec->shared_mem_ = shared_mem_;
+  exec->graph_ = graph_;
+  exec->topo_order_ = topo_order_;
+  exec->branch_ = branch_;
+  exec->num_forward_nodes_ = num_forward_nodes_;
+  exec->offload_nodes_ = offload_nodes_;
+  exec->head_grad_nodes_ = head_grad_nodes_;
+  exec->mirror_source_map_ = mirror_source_map_;
+  exec->arg_grads_ = arg_grads_;
+  exec->grad_req_type_ = grad_req_type_;
+  exec->op_nodes_.resize(op_nodes_.size());
+  for (size_t i = 0; i < op_nodes_.size(); ++i) {
+    exec->op_nodes_[i].ctx = op_nodes_[i].ctx;
+    exec->op_nodes_[i].outputs.resize(op_nodes_[i].outputs.size());
+  }
+  InitTimer timer(&exec->init_times_);
+  exec->InitDataEntryInfo(in_args, arg_grad_store, grad_req_type_, aux_states);
+  timer.Lap("InitDataEntryInfo");
+  exec->InitOperators(this);
+  timer.Lap("InitOperators");
+  exec->InitDataEntryMemory();
+  timer.Lap("InitDataEntryMemory");
+  exec->InitResources();
+  timer.Lap("InitResources");
+  exec->InitCachedOps();
+  timer.Lap("InitCachedOps");
+  exec->InitPriorities();
+  exec->InitOpSegs();
+  timer.Lap("InitOpSegs");
+  return exec;
 }
 
 void GraphExecutor::Forward(bool is_train) {
@@ -1000,6 +1949,15 @@ void GraphExecutor::PartialForward(bool is_train, int step, int *step_left) {
   *step_left = static_cast<int>(num_forward_nodes_ - sstep - 1);
 }
 
+void GraphExecutor::Warmup() {
+  // the pages of the memory are mapped on their first write, the memory of the
+  // executors sharing the pool is touched too
+  for (NDArray& arr : shared_mem_->pool) arr = 0.0f;
+  this->Forward(false);
+  for (const NDArray& arr : shared_mem_->pool) arr.WaitToRead();
+  for (const NDArray& arr : heads_ndarray_) arr.WaitToRead();
+}
+
 void GraphExecutor::Backward(const std::vector<NDArray> &head_grads) {
   if (head_grads.size() != 0) {
     // TODO(bing, min): consider pass a map for backward
@@ -1024,6 +1982,10 @@ void GraphExecutor::Backward(const std::vector<NDArray> &head_grads) {
         << "head_gradient is required in calling backward.";
   }
   RunOps(true, num_forward_nodes_, topo_order_.size());
+  // gradients written in the forward pass, or directly bound to a variable
+  if (grad_ready_callback_) {
+    for (uint32_t i : grad_ready_early_) grad_ready_callback_(i);
+  }
 }
 
 GraphExecutor::CachedSegOpr
@@ -1035,13 +1997,16 @@ GraphExecutor::CreateCachedSegOpr(size_t topo_start, size_t topo_end) {
   ret.topo_begin = topo_start;
   ret.topo_end = topo_end;
   ret.opr = nullptr;
+  ret.priority = 0;
   for (size_t k = topo_start; k < topo_end; ++k) {
     uint32_t nid = topo_order_[k];
     OpNode& op_node = op_nodes_[nid];
     const StaticGraph::Node& gnode = graph_.nodes[nid];
     if (!op_nodes_[nid].activated) continue;
     if (graph_.nodes[nid].is_variable()) continue;
+    if (output_alias_[nid]) continue;
     if (op_node.op->exec_type() != Operator::kSync) return ret;
+    ret.priority = std::max(ret.priority, op_node.priority);
     if (pctx == nullptr) pctx = &(op_node.ctx);
     if (*pctx != op_node.ctx) {
       return ret;
@@ -1092,10 +2057,15 @@ GraphExecutor::CreateCachedSegOpr(size_t topo_start, size_t topo_end) {
       (RunContext ctx, Engine::CallbackOnComplete on_complete) {
     std::vector<OpReqType> req;
     std::vector<TBlob> in_data, out_data, aux_data;
+    // the nodes of the segment are timed between the marks recorded after each of them
+    std::unique_ptr<NodeTimer> timer;
+    std::vector<uint32_t> timed;
+    if (profiling_) timer.reset(new NodeTimer(ctx, is_gpu));
     for (size_t k = topo_start; k < topo_end; ++k) {
       uint32_t nid = topo_order_[k];
       if (!op_nodes_[nid].activated) continue;
       if (graph_.nodes[nid].is_variable()) continue;
+      if (output_alias_[nid]) continue;
       OpNode& op_node = op_nodes_[nid];
       const StaticGraph::Node& gnode = graph_.nodes[nid];
       CHECK_NE(op_node.op->exec_type(), Operator::kCrossDeviceCopy);
@@ -1132,11 +2102,16 @@ GraphExecutor::CreateCachedSegOpr(size_t topo_start, size_t topo_end) {
       OpContext* op_ctx_ptr = &op_node.op_ctx;
       op_ctx_ptr->run_ctx = ctx;
       op->Forward(*op_ctx_ptr, in_data, req, out_data, aux_data);
+      if (timer) {
+        timer->Mark();
+        timed.push_back(nid);
+      }
     }
+    if (timer) AddNodeTimes(timed, timer->Elapsed());
     if (is_gpu) {
 #if MXNET_USE_CUDA
-      // Wait GPU kernel to finish.
-      ctx.get_stream<gpu>()->Wait();
+      // Wait GPU kernel to finish, or order the dependents after it.
+      Engine::Get()->WaitForStream(ctx);
 #else
       LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
 #endif
@@ -1144,7 +2119,7 @@ GraphExecutor::CreateCachedSegOpr(size_t topo_start, size_t topo_end) {
     on_complete();
   };
   ret.opr =  Engine::Get()->NewOperator(
-      exec_fun, read_vars, write_vars, FnProperty::kNormal);
+      exec_fun, read_vars, write_vars, FnProperty::kNormal, "BulkExecSegment");
   return ret;
 }
 
@@ -1155,10 +2130,12 @@ Executor *Executor::Bind(Symbol symbol,
                          const std::vector<NDArray> &arg_grad_store,
                          const std::vector<OpReqType> &grad_req_type,
                          const std::vector<NDArray> &aux_states,
-                         Executor* shared_exec) {
+                         Executor* shared_exec,
+                         size_t mem_budget) {
   GraphExecutor *exec = new GraphExecutor();
   exec->Init(symbol, default_ctx, group2ctx,
-             in_args, arg_grad_store, grad_req_type, aux_states, shared_exec);
+             in_args, arg_grad_store, grad_req_type, aux_states, shared_exec,
+             mem_budget);
   return exec;
 }
 }  // namespace mxnet
@@ -6,9 +6,12 @@
 #ifndef MXNET_SYMBOL_GRAPH_EXECUTOR_H_
 #define MXNET_SYMBOL_GRAPH_EXECUTOR_H_
 
+#include <dmlc/timer.h>
 #include <mxnet/c_api.h>
 #include <mxnet/symbolic.h>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <map>
@@ -31,11 +34,27 @@ class GraphExecutor : public Executor {
     return heads_ndarray_;
   }
   void Print(std::ostream &os) const override; // NOLINT(*)
+  void PrintCost(std::ostream &os) const override; // NOLINT(*)
+  void SetProfiling(bool enable) override {
+    profiling_ = enable;
+  }
+  void PrintProfile(std::ostream &os, bool reset) override; // NOLINT(*)
+  void SetPriority(int priority) override {
+    priority_offset_ = priority * kHighPriority;
+  }
+  void Warmup() override;
+  Executor *Reshape(const std::vector<NDArray> &in_args,
+                    const std::vector<NDArray> &arg_grad_store,
+                    const std::vector<NDArray> &aux_states) override;
   // install callback
   void SetMonitorCallback(const MonitorCallback& callback) {
     CHECK(callback) << "invalid callback";
     monitor_callback_ = callback;
   }
+  void SetGradReadyCallback(const GradReadyCallback& callback) {
+    CHECK(callback) << "invalid callback";
+    grad_ready_callback_ = callback;
+  }
   // implement Executor::Bind, only call it once.
   inline void Init(Symbol symbol,
                    const Context& default_ctx,
@@ -44,9 +63,15 @@ class GraphExecutor : public Executor {
                    const std::vector<NDArray> &arg_grad_store,
                    const std::vector<OpReqType> &grad_req_type,
                    const std::vector<NDArray> &aux_states,
-                   Executor* shared_exec = nullptr) {
+                   Executor* shared_exec = nullptr,
+                   size_t mem_budget = 0) {
     enable_inplace_allocation_ = dmlc::GetEnv("MXNET_EXEC_ENABLE_INPLACE", true);
+    enable_concat_alias_ = dmlc::GetEnv("MXNET_EXEC_ZERO_COPY_CONCAT", true);
+    enable_reoutput_alias_ = dmlc::GetEnv("MXNET_EXEC_ZERO_COPY_RESHAPE", true);
+    enable_slice_alias_ = dmlc::GetEnv("MXNET_EXEC_ZERO_COPY_SLICE", true);
+    enable_cast_alias_ = dmlc::GetEnv("MXNET_EXEC_FUSE_CAST", true);
     prefer_bulk_execution_ = dmlc::GetEnv("MXNET_EXEC_PREFER_BULK_EXEC", true);
+    InitTimer timer(&init_times_);
     if (shared_exec != NULL) {
       GraphExecutor* gexec = dynamic_cast<GraphExecutor*>(shared_exec);
       CHECK(gexec) << "Input executor for sharing memory must have GraphExecutor type.";
@@ -56,24 +81,60 @@ class GraphExecutor : public Executor {
     }
 
     CHECK_EQ(grad_req_type.size(), arg_grad_store.size());
+    grad_req_type_ = grad_req_type;
     bool need_backward = false;
     for (auto req : grad_req_type) {
       if (req != kNullOp) need_backward = true;
     }
     this->InitGraph(symbol, default_ctx, ctx_map,
                     in_args, arg_grad_store, grad_req_type,
-                    need_backward);
+                    need_backward, mem_budget);
+    timer.Lap("InitGraph");
     this->InitDataEntryInfo(in_args, arg_grad_store, grad_req_type, aux_states);
+    timer.Lap("InitDataEntryInfo");
     this->InitOperators();
+    timer.Lap("InitOperators");
     this->InitDataEntryMemory();
+    timer.Lap("InitDataEntryMemory");
+    if (mem_budget != 0) {
+      for (const auto& kv : planned_bytes_) {
+        if (kv.second > mem_budget) {
+          LOG(WARNING) << "Planned memory " << (kv.second >> 20) << " MB on dev_type="
+                       << kv.first.dev_type << " dev_id=" << kv.first.dev_id
+                       << " exceeds the memory budget " << (mem_budget >> 20) << " MB";
+        }
+      }
+    }
     this->InitResources();
+    timer.Lap("InitResources");
     this->InitCachedOps();
+    timer.Lap("InitCachedOps");
+    this->InitPriorities();
     this->InitOpSegs();
+    timer.Lap("InitOpSegs");
   }
 
  protected:
   // internal class of wrapping BackwardOp as ForwardOp
   class BackwardOpWrapper;
+  // records the milliseconds of the phases of the initialization
+  class InitTimer {
+   public:
+    explicit InitTimer(std::vector<std::pair<std::string, double> > *times)
+        : times_(times), tic_(dmlc::GetTime()) {
+      times_->clear();
+    }
+    // end a phase started at the end of the previous one
+    inline void Lap(const char *phase) {
+      const double toc = dmlc::GetTime();
+      times_->emplace_back(phase, (toc - tic_) * 1e3);
+      tic_ = toc;
+    }
+
+   private:
+    std::vector<std::pair<std::string, double> > *times_;
+    double tic_;
+  };
   // type of data entry
   enum DataEntryType {
     // memory is bound by external NDArray in Bind
@@ -100,8 +161,17 @@ class GraphExecutor : public Executor {
     TShape shape;
     // data type of this entry
     int type_flag;
+    // memory layout of this entry, a DataLayout, blocked layouts are only used on cpu
+    int layout;
     // storage id from allocator if it is internal allocation.
     GraphStorageAllocator::StorageID storage_id;
+    // offset in the storage in number of elements, non zero for a slice of a concat
+    size_t storage_offset;
+    // the group of a forward concat output and its inputs sharing the storage, or -1
+    int concat_group;
+    // whether the storage is also read in another shape by a reshape, it is then
+    // never written inplace
+    bool shared_storage;
     // reference count on how many times this entry is being used.
     // That is how many operators and heads need this DataEntry
     // this is a temporal variable that is used during initialization.
@@ -113,7 +183,9 @@ class GraphExecutor : public Executor {
         : op_req(kNullOp),
           inplace_op_id(-1),
           type(kNotInitialized),
+          layout(kLayoutNCHW),
           storage_id(GraphStorageAllocator::kBadStorageID),
+          storage_offset(0), concat_group(-1), shared_storage(false),
           temp_ref_count(0), ref_count(0) {}
   };
   // all the information needed to push the op to engine
@@ -148,6 +220,8 @@ class GraphExecutor : public Executor {
     OpExecEntry cached_exec;
     // cached operator handle
     Engine::OprHandle cached_opr{nullptr};
+    // engine priority, the longer the path to the outputs the higher
+    int priority{0};
     // constructor
     OpNode() : activated(false) {}
     // Manual option for delete operator
@@ -169,7 +243,35 @@ class GraphExecutor : public Executor {
     size_t topo_end;
     // the cached operator
     Engine::OprHandle opr;
+    // the highest priority of its nodes
+    int priority;
   };
+  // the estimated cost of a node
+  struct NodeCost {
+    // floating point operations, a multiply-add counts as two
+    double flops{0};
+    // bytes of the inputs and auxiliary states read, and of the outputs written
+    double read_bytes{0};
+    double write_bytes{0};
+    // bytes of the parameters among the inputs and auxiliary states
+    double param_bytes{0};
+    // bytes of the temporary workspace, the limit given to the operator
+    double workspace_bytes{0};
+  };
+  // the times of a node summed over the iterations it was timed
+  struct NodeTime {
+    uint64_t count{0};
+    double total_ms{0};
+    double max_ms{0};
+  };
+  /*!
+   * \brief estimate the cost of an activated node from the shapes of its inputs
+   *  and outputs. A forward node with a weight does out * weight / channels
+   *  multiply-adds, another node a flop per output element. A backward node
+   *  does twice the flops of its forward node.
+   * \param node_id node index of node in StaticGraph
+   */
+  NodeCost GetNodeCost(uint32_t node_id) const;
   /*!
    * \brief Get input option of a node.
    *  This function is overriden for both Forward and Backward node.
@@ -213,6 +315,13 @@ class GraphExecutor : public Executor {
    * The ret.opr can be nullptr if tyhe creation failed
    */
   CachedSegOpr CreateCachedSegOpr(size_t topo_start, size_t topo_end);
+  /*!
+   * \brief split the forward nodes into branches, chains of nodes where each node
+   *  is the only user of its previous node, and reorder them so that each branch is
+   *  contiguous. Independent branches then become separate segments.
+   * \param fwd_nodes the forward nodes in topo order, reordered inplace.
+   */
+  void AssignBranches(std::vector<uint32_t> *fwd_nodes);
   // initialize the internal graph structure
   void InitGraph(const Symbol &symbol,
                  const Context& default_ctx,
@@ -220,7 +329,8 @@ class GraphExecutor : public Executor {
                  const std::vector<NDArray> &in_args,
                  const std::vector<NDArray> &arg_grad_store,
                  const std::vector<OpReqType> &grad_req_type,
-                 bool need_backward);
+                 bool need_backward,
+                 size_t mem_budget);
   // initialize internal DataEntryInfo, reference counting
   void InitDataEntryInfo(const std::vector<NDArray> &in_args,
                          const std::vector<NDArray> &arg_grad_store,
@@ -228,12 +338,32 @@ class GraphExecutor : public Executor {
                          const std::vector<NDArray> &aux_states);
   // initialize internal data entries NDArray
   void InitDataEntryMemory();
+  // assign the groups of the forward concat nodes, and of the backward of the slice
+  // channel nodes, whose inputs are written into slices of the output, group_nodes
+  // is the concat node of each group
+  void InitConcatGroups(std::vector<uint32_t> *group_nodes);
+  // the dimension of a concat node if its slices are contiguous, -1 otherwise
+  int GetConcatDim(uint32_t concat_nid, const TShape &out_shape) const;
+  // the axis of a slice channel node if its slices are contiguous, -1 otherwise
+  int GetSliceDim(uint32_t slice_nid, const TShape &in_shape) const;
+  // whether a node only changes the shape of its input, a Reshape or a Flatten
+  // or their backward, so that its output can be a view of its input
+  bool IsReshape(uint32_t nid) const;
+  // whether a node is a forward Cast between float types that is only read
+  // by forward nodes converting the input on load, so that they can read its input
+  bool IsFusedCast(uint32_t nid) const;
   // initialize the internal resources for each op
   void InitResources();
-  // initialize OpNode data structure
-  void InitOperators();
+  // initialize OpNode data structure, operators of src with the same inputs are reused.
+  // The forward operators are created concurrently by the threads of their devices.
+  void InitOperators(const GraphExecutor* src = nullptr);
+  // create the operator of a forward node, or reuse the one of src with the same inputs
+  void CreateForwardOperator(uint32_t nid, const GraphExecutor* src);
   // initialize OpNode data structure
   void InitCachedOps();
+  // assign the priority of each node from its estimated cost and the longest
+  // path of costs from it to the outputs, so that the critical path runs first.
+  void InitPriorities();
   // initialize segments of code to run together as a group.
   void InitOpSegs();
   // assign context to the graph, this will mutate the graph.
@@ -243,8 +373,29 @@ class GraphExecutor : public Executor {
                      const std::vector<NDArray> &arg_grad_store,
                      const std::vector<OpReqType> &grad_req_type,
                      std::vector<Context> *ctx_plan);
+  // insert an offload node copying each chosen forward entry read by the backward pass to
+  // pinned memory, and a prefetch node copying it back for the backward readers, this will
+  // mutate the graph. offload gets the pairs of offload and prefetch nodes.
+  void AssignOffload(const std::vector<NDArray> &in_args,
+                     std::vector<Context> *ctx_plan,
+                     std::vector<std::pair<uint32_t, uint32_t> > *offload);
+  // move each offload node after the last forward user of its entry, and each prefetch
+  // node a few steps before its first backward user in topo_order_.
+  void PlaceOffload(const std::vector<std::pair<uint32_t, uint32_t> > &offload);
+  // assign the cpu layout of each node from the layouts its operator supports, inserting
+  // reorder nodes where a node reads an entry in another layout, this will mutate the graph.
+  void AssignLayouts(const std::vector<NDArray> &in_args,
+                     std::vector<Context> *ctx_plan,
+                     std::vector<int> *layout_plan);
   // run ops from topo order start to end
   void RunOps(bool is_train, size_t topo_start, size_t topo_end);
+  // add the times in milliseconds of nodes timed by profiling
+  void AddNodeTimes(const std::vector<uint32_t> &nids, const std::vector<double> &ms);
+  // call grad_ready_callback_ on the arguments whose gradient is written by node nid
+  inline void NotifyGradReady(uint32_t nid) {
+    if (!grad_ready_callback_ || nid >= grad_ready_args_.size()) return;
+    for (uint32_t i : grad_ready_args_[nid]) grad_ready_callback_(i);
+  }
   // internal computational graph
   StaticGraph graph_;
   // topological order of nodes in computation graph
@@ -252,12 +403,33 @@ class GraphExecutor : public Executor {
   std::vector<uint32_t> topo_order_;
   // whether to enable inplace space
   bool enable_inplace_allocation_;
+  // whether the inputs of concat, and the gradients of its backward, are slices of the output
+  bool enable_concat_alias_;
+  // whether the output of a reshape is a view of its input
+  bool enable_reoutput_alias_;
+  // whether the outputs of slice channel, and the output gradients of its backward,
+  // are slices of the input
+  bool enable_slice_alias_;
+  // whether the forward readers of a cast read its input
+  bool enable_cast_alias_;
+  // whether each node outputs a view of its input in another shape, it is then not run
+  std::vector<bool> output_alias_;
   // total allocated space in bytes
   size_t total_allocated_bytes_;
+  // planned space of data entries in bytes on each context
+  std::map<Context, size_t> planned_bytes_;
+  // number of the arrays the internal data entries are placed in
+  size_t num_storage_chunks_{0};
+  // milliseconds of the phases of Init or Reshape, in order
+  std::vector<std::pair<std::string, double> > init_times_;
   // total allocated temp space
   size_t total_allocated_temp_;
   // number of forward nodes in the graph
   size_t num_forward_nodes_;
+  // whether each node copies an activation to the host, skipped when not training
+  std::vector<bool> offload_nodes_;
+  // branch of each forward operator node, empty when branches are not split
+  std::vector<int> branch_;
   // whether to enable bulk execution
   bool prefer_bulk_execution_;
   // head gradient node in the graph, if there is backward pass
@@ -266,6 +438,8 @@ class GraphExecutor : public Executor {
   std::map<uint32_t, uint32_t> mirror_source_map_;
   // argument node in the graph, if there is backward pass
   std::vector<StaticGraph::DataEntry> arg_grads_;
+  // gradient request of each argument
+  std::vector<OpReqType> grad_req_type_;
   // operational nodes
   std::vector<OpNode> op_nodes_;
   // head NDArrays
@@ -274,8 +448,22 @@ class GraphExecutor : public Executor {
   std::shared_ptr<GraphStoragePool> shared_mem_;
   // monitor call back
   std::function<void(const char*, void*)> monitor_callback_;
+  // callback notified when the gradient of an argument is pushed
+  GradReadyCallback grad_ready_callback_;
+  // indices of the arguments whose gradient is written by each backward node
+  std::vector<std::vector<uint32_t> > grad_ready_args_;
+  // indices of the arguments whose gradient is not written by a backward node
+  std::vector<uint32_t> grad_ready_early_;
   // cached segment operator
   std::vector<CachedSegOpr> cached_seg_opr_;
+  // whether to time the nodes, read by the engine threads running them
+  std::atomic<bool> profiling_{false};
+  // added to the priority of each operation, set by SetPriority
+  int priority_offset_{0};
+  // times of each node, indexed by node id
+  std::vector<NodeTime> node_times_;
+  // lock of node_times_
+  std::mutex node_times_mutex_;
 };  // class GraphExecutor
 }  // namespace mxnet
 #endif  // MXNET_SYMBOL_GRAPH_EXECUTOR_H_
@@ -4,21 +4,30 @@
  * \brief Memory allocator for graph executor.
 */
 #include "graph_memory_allocator.h"
+#include <limits>
+#include <string>
 
 namespace mxnet {
 const uint32_t GraphStorageAllocator::kDummyColor = 1 << 31;
+const size_t GraphStorageAllocator::kNeverReleased = std::numeric_limits<size_t>::max();
 
 GraphStorageAllocator::GraphStorageAllocator(
     StaticGraph *graph,
     const std::vector<uint32_t>& topo_order,
     std::shared_ptr<GraphStoragePool> shared_mem) noexcept(false)
-    : graph_(graph) , num_match_color_(0), shared_mem_(shared_mem) {
+    : graph_(graph) , num_match_color_(0), shared_mem_(shared_mem), step_(0) {
   match_range_ = dmlc::GetEnv("MXNET_EXEC_MATCH_RANGE", 16);
+  std::string plan = dmlc::GetEnv("MXNET_EXEC_MEM_PLAN", std::string("Match"));
+  CHECK(plan == "Match" || plan == "Arena")
+      << "Unknown memory plan " << plan << ", expect Match or Arena";
+  arena_plan_ = (plan == "Arena");
   // if we set this to 1, this means no color based match.
   // color based match will cost a bit more memory usually
   // but also enables more parallelization.
   num_match_color_ = static_cast<uint32_t>(common::GetExecNumMatchColor());
   this->InitColor(topo_order);
+  // the shared pool is matched against the arenas in InitArenaStorages
+  if (arena_plan_) return;
 
   for (auto& it : shared_mem_->pool) {
     CHECK(!it.is_none());
@@ -55,10 +64,11 @@ void GraphStorageAllocator::InitColor(const std::vector<uint32_t>& topo_order) {
 }
 
 GraphStorageAllocator::StorageID
-GraphStorageAllocator::Alloc(Context ctx, int type_flag, size_t size) {
+GraphStorageAllocator::Alloc(Context ctx, int type_flag, size_t size, uint32_t node_id) {
   StorageID id = static_cast<StorageID>(data_.size());
   std::unique_ptr<StorageEntry> ptr(new StorageEntry());
   ptr->id = id;
+  ptr->first_node = node_id;
   ptr->ctx = ctx;
   ptr->type_flag = type_flag;
   ptr->max_size = size;
@@ -70,7 +80,14 @@ GraphStorageAllocator::StorageID
 GraphStorageAllocator::Request(Context ctx, int type_flag, TShape shape, uint32_t node_id) {
   // search memory block in [size / match_range_, size * match_range_)
   size_t size = shape.Size();
-  if (match_range_ == 0) return this->Alloc(ctx, type_flag, size);
+  if (arena_plan_) {
+    StorageID id = this->Alloc(ctx, type_flag, size, node_id);
+    StorageEntry *e = data_[id].get();
+    e->live_begin = step_++;
+    e->color = node_color_[node_id];
+    return id;
+  }
+  if (match_range_ == 0) return this->Alloc(ctx, type_flag, size, node_id);
   auto begin = free_.lower_bound(size / match_range_);
   auto mid = free_.lower_bound(size);
   auto end = free_.upper_bound(size * match_range_);
@@ -82,7 +99,6 @@ GraphStorageAllocator::Request(Context ctx, int type_flag, TShape shape, uint32_
     if (e->type_flag != type_flag) continue;
     if (node_color_[e->released_by_node] != kDummyColor
         && node_color_[e->released_by_node] != node_color_[node_id]) continue;
-    if (!e->data.is_none() && size > e->max_size) continue;
     // Use exect matching strategy
     e->max_size = std::max(size, e->max_size);
     // find a exact match, erase from map and return
@@ -97,7 +113,6 @@ GraphStorageAllocator::Request(Context ctx, int type_flag, TShape shape, uint32_
     if (e->type_flag != type_flag) continue;
     if (node_color_[e->released_by_node] != kDummyColor
         && node_color_[e->released_by_node] != node_color_[node_id]) continue;
-    if (!e->data.is_none() && size > e->max_size) continue;
     // Use exect matching strategy
     e->max_size = std::max(size, e->max_size);
     // find a exact match, erase from map and return
@@ -105,34 +120,152 @@ GraphStorageAllocator::Request(Context ctx, int type_flag, TShape shape, uint32_
     return e->id;
   }
   // cannot find anything return a new one.
-  return this->Alloc(ctx, type_flag, size);
+  return this->Alloc(ctx, type_flag, size, node_id);
 }
 
 void GraphStorageAllocator::Release(StorageID id, uint32_t node_id) {
   CHECK_NE(id, kBadStorageID);
   StorageEntry *e = data_[id].get();
+  if (arena_plan_) {
+    e->live_end = step_++;
+    return;
+  }
   e->released_by_node = node_id;
   free_.insert({e->max_size, e});
 }
 
 size_t GraphStorageAllocator::InitStorages() {
+  if (arena_plan_) return this->InitArenaStorages();
   size_t total = 0;
   for (size_t i = 0; i < data_.size(); ++i) {
     StorageEntry *e = data_[i].get();
+    size_t nbytes = e->max_size * mshadow::mshadow_sizeof(e->type_flag);
     if (e->data.is_none()) {
       TShape shape = mshadow::Shape1(e->max_size);
+      // attributed to the first of the entries sharing it
+      std::string origin = "executor/" + graph_->nodes[e->first_node].name;
+      Storage::AllocOriginScope scope(origin.c_str());
       e->data = NDArray(shape, e->ctx, false, e->type_flag);
-      total += e->max_size * mshadow::mshadow_sizeof(e->type_flag);
+      total += nbytes;
       shared_mem_->pool.push_back(e->data);
+    } else if (e->data.shape()[0] < e->max_size) {
+      // a pool array seeded in the constructor, grown in place so that the
+      // executors that already share it see the larger storage
+      total += (e->max_size - e->data.shape()[0]) * mshadow::mshadow_sizeof(e->type_flag);
+      e->data = e->data.GrowStorage(e->max_size);
+      shared_mem_->pool[i] = e->data;
     }
+    planned_bytes_[e->ctx] += nbytes;
   }
   CHECK_EQ(shared_mem_->pool.size(), data_.size());
   return total;
 }
 
-NDArray GraphStorageAllocator::Get(StorageID id, TShape shape) {
+void GraphStorageAllocator::PlanArena(Arena* arena) {
+  // keep offsets aligned to 256 bytes
+  const size_t align = std::max(
+      static_cast<size_t>(256 / mshadow::mshadow_sizeof(arena->type_flag)), size_t(1));
+  // place big entries first, each at the lowest offset that does not
+  // overlap placed entries alive at the same time.
+  std::vector<StorageEntry*> order = arena->entries;
+  std::stable_sort(order.begin(), order.end(),
+                   [](const StorageEntry* a, const StorageEntry* b) {
+                     return a->max_size > b->max_size;
+                   });
+  std::vector<StorageEntry*> placed;
+  arena->size = 0;
+  for (StorageEntry* e : order) {
+    std::vector<StorageEntry*> conflicts;
+    for (StorageEntry* p : placed) {
+      if (p->live_begin <= e->live_end && e->live_begin <= p->live_end) {
+        conflicts.push_back(p);
+      }
+    }
+    std::sort(conflicts.begin(), conflicts.end(),
+              [](const StorageEntry* a, const StorageEntry* b) {
+                return a->offset < b->offset;
+              });
+    size_t size = (e->max_size + align - 1) / align * align;
+    size_t offset = 0;
+    for (StorageEntry* p : conflicts) {
+      if (offset + size <= p->offset) break;
+      offset = std::max(offset, p->offset + (p->max_size + align - 1) / align * align);
+    }
+    e->offset = offset;
+    arena->size = std::max(arena->size, offset + size);
+    placed.push_back(e);
+  }
+}
+
+size_t GraphStorageAllocator::InitArenaStorages() {
+  // group entries by context, type and color
+  for (size_t i = 0; i < data_.size(); ++i) {
+    StorageEntry *e = data_[i].get();
+    size_t k = 0;
+    for (; k < arenas_.size(); ++k) {
+      if (arenas_[k].ctx == e->ctx && arenas_[k].type_flag == e->type_flag &&
+          arenas_[k].color == e->color) break;
+    }
+    if (k == arenas_.size()) {
+      Arena arena;
+      arena.ctx = e->ctx;
+      arena.type_flag = e->type_flag;
+      arena.color = e->color;
+      arena.size = 0;
+      arenas_.push_back(arena);
+    }
+    e->arena = k;
+    arenas_[k].entries.push_back(e);
+  }
+  size_t total = 0;
+  std::vector<bool> taken(shared_mem_->pool.size(), false);
+  for (Arena& arena : arenas_) {
+    PlanArena(&arena);
+    // reuse the smallest large enough array of the shared pool, otherwise grow the
+    // largest one, so the pool stays at the arenas of the largest sharing executor
+    int best = -1;
+    for (size_t i = 0; i < taken.size(); ++i) {
+      const NDArray& nd = shared_mem_->pool[i];
+      if (taken[i] || nd.ctx() != arena.ctx || nd.dtype() != arena.type_flag) continue;
+      if (best == -1) {
+        best = static_cast<int>(i);
+        continue;
+      }
+      const size_t best_size = shared_mem_->pool[best].shape()[0], size = nd.shape()[0];
+      if (best_size >= arena.size ? (size >= arena.size && size < best_size)
+                                  : size > best_size) {
+        best = static_cast<int>(i);
+      }
+    }
+    size_t nbytes = arena.size * mshadow::mshadow_sizeof(arena.type_flag);
+    if (best != -1) {
+      taken[best] = true;
+      NDArray& nd = shared_mem_->pool[best];
+      if (nd.shape()[0] < arena.size) {
+        total += (arena.size - nd.shape()[0]) * mshadow::mshadow_sizeof(arena.type_flag);
+        nd = nd.GrowStorage(arena.size);
+      }
+      arena.data = nd;
+    }
+    if (arena.data.is_none()) {
+      Storage::AllocOriginScope scope("executor/arena");
+      arena.data = NDArray(mshadow::Shape1(arena.size), arena.ctx, false, arena.type_flag);
+      total += nbytes;
+      shared_mem_->pool.push_back(arena.data);
+    }
+    planned_bytes_[arena.ctx] += nbytes;
+  }
+  return total;
+}
+
+NDArray GraphStorageAllocator::Get(StorageID id, TShape shape, size_t offset) {
   CHECK_NE(id, kBadStorageID);
   StorageEntry *e = data_[id].get();
-  return e->data.Slice(0, shape.Size()).Reshape(shape);
+  CHECK_LE(offset + shape.Size(), e->max_size);
+  if (arena_plan_) {
+    offset += e->offset;
+    return arenas_[e->arena].data.Slice(offset, offset + shape.Size()).Reshape(shape);
+  }
+  return e->data.Slice(offset, offset + shape.Size()).Reshape(shape);
 }
 }  // namespace mxnet
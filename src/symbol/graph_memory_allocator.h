@@ -9,6 +9,7 @@
 #include <mxnet/symbolic.h>
 #include <mxnet/ndarray.h>
 #include <map>
+#include <string>
 #include <vector>
 #include <algorithm>
 #include "./static_graph.h"
@@ -18,6 +19,8 @@
 namespace mxnet {
 /*!
  * \brief Memory pool holding a list of NDArrays for sharing between executors.
+ *  An array too small for a later executor is grown in place rather than
+ *  replaced, so the pool is bounded by the largest executor's plan.
  */
 struct GraphStoragePool {
   std::vector<NDArray> pool;
@@ -36,6 +39,13 @@ struct GraphStoragePool {
  *  (2) Allocating phase: GraphExecutor call InitMemory.
  *      - Then each DataEntry will call Get to get the real NDArray.
  *  (3) All the memory will be freed up when reference to all the related NDArray ends.
+ *
+ *  Two planning algorithms are selected by MXNET_EXEC_MEM_PLAN:
+ *  - Match: a released storage is reused by a later request of similar size.
+ *  - Arena: the exact live range of each request is recorded over the
+ *    planning order, and the requests of the same context, type and color
+ *    are packed at offsets of one arena, so that only requests with
+ *    disjoint live ranges share memory.
  */
 class GraphStorageAllocator {
  public:
@@ -72,8 +82,25 @@ class GraphStorageAllocator {
    * \brief Get the the memory allocated in planning phase.
    * \param id the storage id allocated in planning phase.
    * \param shape the shape of the NDArray requested.
+   * \param offset the offset of the NDArray in the storage in number of elements,
+   *  used by the entries that are slices of a larger one.
+   */
+  NDArray Get(StorageID id, TShape shape, size_t offset = 0);
+  /*!
+   * \brief Get the memory planned for each context, valid after InitStorages.
+   *  It includes the memory reused from the shared pool.
+   * \return map from context to bytes.
    */
-  NDArray Get(StorageID id, TShape shape);
+  inline const std::map<Context, size_t>& planned_bytes() const {
+    return planned_bytes_;
+  }
+  /*!
+   * \brief Get the number of storage chunks, the arrays the entries are placed in,
+   *  valid after InitStorages.
+   */
+  inline size_t num_chunks() const {
+    return arena_plan_ ? arenas_.size() : data_.size();
+  }
 
  protected:
   /*! \brief internal storage entry */
@@ -88,22 +115,64 @@ class GraphStorageAllocator {
     size_t max_size;
     /*! \brief node index that released it last time */
     uint32_t released_by_node;
+    /*! \brief node index that requested it first, its origin in the allocation trace */
+    uint32_t first_node;
     /*! \brief the actual NDArray to hold the data */
     NDArray data;
+    /*! \brief planning step of the request, used by arena plan */
+    size_t live_begin;
+    /*! \brief planning step of the release, used by arena plan */
+    size_t live_end;
+    /*! \brief color of the requesting node, used by arena plan */
+    uint32_t color;
+    /*! \brief index of the arena, used by arena plan */
+    size_t arena;
+    /*! \brief offset in the arena in number of elements, used by arena plan */
+    size_t offset;
     /*! \brief constructor */
-    StorageEntry() : max_size(0), released_by_node(0) {}
+    StorageEntry()
+        : max_size(0), released_by_node(0), first_node(0), live_begin(0),
+          live_end(kNeverReleased), color(0), arena(0), offset(0) {}
+  };
+  /*! \brief arena holding the storage of a group of entries */
+  struct Arena {
+    /*! \brief the context of the arena */
+    Context ctx;
+    /*! \brief the data type enum of the arena */
+    int type_flag;
+    /*! \brief color of the entries in the arena */
+    uint32_t color;
+    /*! \brief size of the arena in number of elements */
+    size_t size;
+    /*! \brief entries in the arena */
+    std::vector<StorageEntry*> entries;
+    /*! \brief the NDArray holding the arena */
+    NDArray data;
   };
+  /*! \brief live_end of entries that are never released */
+  static const size_t kNeverReleased;
   /*!
    * \brief Allocate a StorageID when Request cannot found existing ones.
    * \param ctx the context of the graph
    * \param shape shape of the NDArray we want
+   * \param node_id the node that is requesting the memory.
    */
-  StorageID Alloc(Context ctx, int type_flag, size_t size);
+  StorageID Alloc(Context ctx, int type_flag, size_t size, uint32_t node_id);
   /*!
    * \brief Initialize the colors of graph nodes.
    * \param topo_order the topological order in the graph.
    */
   void InitColor(const std::vector<uint32_t> &topo_order);
+  /*!
+   * \brief assign the offsets of the entries in one arena.
+   * \param arena the arena.
+   */
+  static void PlanArena(Arena* arena);
+  /*!
+   * \brief Initialize the memories with arena plan.
+   * \return size of memory allocated.
+   */
+  size_t InitArenaStorages();
   /*! \brief reference to the computation graph */
   StaticGraph *graph_;
   /*! \brief all the resources available */
@@ -122,6 +191,14 @@ class GraphStorageAllocator {
   uint32_t num_match_color_;
   /*! \brief shared memory pool */
   std::shared_ptr<GraphStoragePool> shared_mem_;
+  /*! \brief whether to use arena plan */
+  bool arena_plan_;
+  /*! \brief current planning step, used by arena plan */
+  size_t step_;
+  /*! \brief arenas, used by arena plan */
+  std::vector<Arena> arenas_;
+  /*! \brief memory planned for each context in bytes */
+  std::map<Context, size_t> planned_bytes_;
 };
 }  // namespace mxnet
 #endif  // MXNET_SYMBOL_GRAPH_MEMORY_ALLOCATOR_H_
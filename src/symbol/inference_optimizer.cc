@@ -0,0 +1,295 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file inference_optimizer.cc
+ * \brief rewrite a symbol and its parameters for inference only execution.
+ */
+#include <dmlc/logging.h>
+#include <dmlc/json.h>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "./inference_optimizer.h"
+#include "./static_graph.h"
+
+namespace mxnet {
+namespace {
+typedef StaticGraph::DataEntry DataEntry;
+typedef std::unordered_map<std::string, NDArray> ParamMap;
+
+/*! \brief convert a graph back into a symbol through its json */
+Symbol ToSymbol(const StaticGraph& graph) {
+  std::ostringstream os;
+  dmlc::JSONWriter writer(&os);
+  graph.Save(&writer);
+  std::istringstream is(os.str());
+  dmlc::JSONReader reader(&is);
+  Symbol sym;
+  sym.Load(&reader);
+  return sym;
+}
+/*! \return nodes that the heads depend on, in topo order */
+std::vector<uint32_t> LiveNodes(const StaticGraph& graph) {
+  std::vector<uint32_t> head_nodes;
+  for (const DataEntry& e : graph.heads) head_nodes.push_back(e.source_id);
+  return graph.PostDFSOrder(head_nodes);
+}
+/*! \return number of times the output entries of each node are used by live nodes and heads */
+std::vector<int> NumUses(const StaticGraph& graph, const std::vector<uint32_t>& live) {
+  std::vector<int> uses(graph.nodes.size(), 0);
+  for (uint32_t nid : live) {
+    for (const DataEntry& e : graph.nodes[nid].inputs) ++uses[e.source_id];
+  }
+  for (const DataEntry& e : graph.heads) ++uses[e.source_id];
+  return uses;
+}
+/*! \brief redirect every use of an entry in rep to its replacement */
+void Replace(StaticGraph* graph, const std::map<DataEntry, DataEntry>& rep) {
+  if (rep.size() == 0) return;
+  auto update = [&rep](DataEntry* e) {
+    for (auto it = rep.find(*e); it != rep.end(); it = rep.find(*e)) *e = it->second;
+  };
+  for (StaticGraph::Node& node : graph->nodes) {
+    for (DataEntry& e : node.inputs) update(&e);
+  }
+  for (DataEntry& e : graph->heads) update(&e);
+}
+/*! \return a new variable name based on name */
+std::string UniqueName(const StaticGraph& graph, const ParamMap& arg_params,
+                       const std::string& name) {
+  std::unordered_set<std::string> used;
+  for (const StaticGraph::Node& node : graph.nodes) used.insert(node.name);
+  std::string ret = name;
+  for (int i = 1; used.count(ret) != 0 || arg_params.count(ret) != 0; ++i) {
+    ret = name + std::to_string(i);
+  }
+  return ret;
+}
+/*! \brief add a variable node and return its output */
+DataEntry AddVariable(StaticGraph* graph, const std::string& name) {
+  StaticGraph::Node node;
+  node.name = name;
+  graph->nodes.push_back(std::move(node));
+  return DataEntry(static_cast<uint32_t>(graph->nodes.size() - 1), 0);
+}
+/*! \return content of a float32 array */
+std::vector<real_t> ToVector(const NDArray& arr) {
+  std::vector<real_t> ret(arr.shape().Size());
+  arr.SyncCopyToCPU(ret.data(), ret.size());
+  return ret;
+}
+/*! \return a cpu array of content data */
+NDArray FromVector(const std::vector<real_t>& data, const TShape& shape) {
+  NDArray ret(shape, Context::CPU());
+  ret.SyncCopyFromCPU(data.data(), data.size());
+  return ret;
+}
+
+/*! \brief bypass Dropout and the operators whose output equals their input in inference */
+void RemoveIdentity(StaticGraph* graph) {
+  static const std::unordered_set<std::string> identity = {
+    "Dropout", "BlockGrad", "IdentityAttachKLSparseReg", "_CrossDeviceCopy"
+  };
+  std::map<DataEntry, DataEntry> rep;
+  for (uint32_t nid : LiveNodes(*graph)) {
+    const StaticGraph::Node& node = graph->nodes[nid];
+    if (node.is_forward() && identity.count(node.op->TypeString()) != 0) {
+      rep[DataEntry(nid, 0)] = node.inputs[0];
+    }
+  }
+  Replace(graph, rep);
+}
+
+/*!
+ * \brief fold BatchNorm into the weight and bias of the Convolution or FullyConnected
+ *  that feeds it, when the BatchNorm is the only use of the output and of the weights.
+ *  Inference BatchNorm is out = (in - mean) * gamma / sqrt(var + eps) + beta.
+ */
+void FoldBatchNorm(StaticGraph* graph, ParamMap* arg_params, const ParamMap& aux_params) {
+  std::vector<uint32_t> live = LiveNodes(*graph);
+  std::vector<int> uses = NumUses(*graph, live);
+  // nodes whose outputs other than the first are used
+  std::vector<bool> extra_outputs(graph->nodes.size(), false);
+  for (uint32_t nid : live) {
+    for (const DataEntry& e : graph->nodes[nid].inputs) {
+      if (e.index != 0) extra_outputs[e.source_id] = true;
+    }
+  }
+  for (const DataEntry& e : graph->heads) {
+    if (e.index != 0) extra_outputs[e.source_id] = true;
+  }
+  auto param = [graph, arg_params](const DataEntry& e) -> const NDArray* {
+    const StaticGraph::Node& node = graph->nodes[e.source_id];
+    if (!node.is_variable()) return nullptr;
+    auto it = arg_params->find(node.name);
+    if (it == arg_params->end() || it->second.dtype() != mshadow::kFloat32) return nullptr;
+    return &it->second;
+  };
+  std::map<DataEntry, DataEntry> rep;
+  for (uint32_t nid : live) {
+    if (!graph->nodes[nid].is_forward()) continue;
+    std::string type = graph->nodes[nid].op->TypeString();
+    if (type != "BatchNorm" && type != "CuDNNBatchNorm") continue;
+    if (extra_outputs[nid]) continue;
+    const uint32_t cid = graph->nodes[nid].inputs[0].source_id;
+    if (!graph->nodes[cid].is_forward() || uses[cid] != 1) continue;
+    std::string conv_type = graph->nodes[cid].op->TypeString();
+    if (conv_type != "Convolution" && conv_type != "FullyConnected") continue;
+    if (conv_type == "Convolution" &&
+        graph->nodes[cid].op->GetParams()["act_type"] != "none") continue;
+    const StaticGraph::Node& bn = graph->nodes[nid];
+    const StaticGraph::Node& conv = graph->nodes[cid];
+    const bool has_bias = conv.inputs.size() > 2;
+    const NDArray *gamma = param(bn.inputs[1]), *beta = param(bn.inputs[2]);
+    const NDArray *weight = param(conv.inputs[1]);
+    const NDArray *bias = has_bias ? param(conv.inputs[2]) : nullptr;
+    if (gamma == nullptr || beta == nullptr || weight == nullptr) continue;
+    if (has_bias && (bias == nullptr || uses[conv.inputs[2].source_id] != 1)) continue;
+    if (uses[conv.inputs[1].source_id] != 1) continue;
+    std::vector<std::string> aux = bn.op->ListAuxiliaryStates();
+    auto mean_it = aux_params.find(bn.name + "_" + aux[0]);
+    auto var_it = aux_params.find(bn.name + "_" + aux[1]);
+    if (mean_it == aux_params.end() || var_it == aux_params.end()) continue;
+
+    const TShape wshape = weight->shape();
+    const index_t channels = wshape[0];
+    const size_t inner = wshape.Size() / channels;
+    std::vector<real_t> w = ToVector(*weight);
+    std::vector<real_t> b = has_bias ? ToVector(*bias) : std::vector<real_t>(channels, 0.0f);
+    std::vector<real_t> g = ToVector(*gamma), bt = ToVector(*beta);
+    std::vector<real_t> mean = ToVector(mean_it->second), var = ToVector(var_it->second);
+    if (g.size() != channels || bt.size() != channels ||
+        mean.size() != channels || var.size() != channels) continue;
+    std::map<std::string, std::string> bn_param = bn.op->GetParams();
+    const real_t eps = std::stof(bn_param["eps"]);
+    const std::string& fix = bn_param["fix_gamma"];
+    const bool fix_gamma = fix == "1" || fix == "True" || fix == "true";
+    for (index_t c = 0; c < channels; ++c) {
+      real_t scale = (fix_gamma ? 1.0f : g[c]) / std::sqrt(var[c] + eps);
+      for (size_t j = 0; j < inner; ++j) w[c * inner + j] *= scale;
+      b[c] = (b[c] - mean[c]) * scale + bt[c];
+    }
+    const TShape bshape = mshadow::Shape1(channels);
+    (*arg_params)[graph->nodes[conv.inputs[1].source_id].name] = FromVector(w, wshape);
+    if (has_bias) {
+      (*arg_params)[graph->nodes[conv.inputs[2].source_id].name] = FromVector(b, bshape);
+    } else {
+      std::string name = UniqueName(*graph, *arg_params, conv.name + "_bias");
+      (*arg_params)[name] = FromVector(b, bshape);
+      std::map<std::string, std::string> kwargs = conv.op->GetParams();
+      kwargs["no_bias"] = "False";
+      // nodes may be reallocated by AddVariable
+      DataEntry e = AddVariable(graph, name);
+      StaticGraph::Node& node = graph->nodes[cid];
+      node.op.reset(OperatorProperty::Create(conv_type.c_str()));
+      node.op->Init(std::vector<std::pair<std::string, std::string> >(
+          kwargs.begin(), kwargs.end()));
+      node.inputs.push_back(e);
+    }
+    rep[DataEntry(nid, 0)] = DataEntry(cid, 0);
+  }
+  Replace(graph, rep);
+}
+
+/*!
+ * \brief fuse an Activation into the Convolution that feeds it, when the Activation
+ *  is the only use of the output. The Convolution applies it after the bias.
+ */
+void FuseActivation(StaticGraph* graph) {
+  std::vector<uint32_t> live = LiveNodes(*graph);
+  std::vector<int> uses = NumUses(*graph, live);
+  std::map<DataEntry, DataEntry> rep;
+  for (uint32_t nid : live) {
+    const StaticGraph::Node& act = graph->nodes[nid];
+    if (!act.is_forward() || act.op->TypeString() != "Activation") continue;
+    const uint32_t cid = act.inputs[0].source_id;
+    StaticGraph::Node& conv = graph->nodes[cid];
+    if (!conv.is_forward() || uses[cid] != 1) continue;
+    if (conv.op->TypeString() != "Convolution") continue;
+    std::map<std::string, std::string> kwargs = conv.op->GetParams();
+    if (kwargs["act_type"] != "none") continue;
+    kwargs["act_type"] = act.op->GetParams()["act_type"];
+    conv.op.reset(OperatorProperty::Create("Convolution"));
+    conv.op->Init(std::vector<std::pair<std::string, std::string> >(
+        kwargs.begin(), kwargs.end()));
+    rep[DataEntry(nid, 0)] = DataEntry(cid, 0);
+  }
+  Replace(graph, rep);
+}
+
+/*!
+ * \brief compute the operators that only depend on parameters once,
+ *  and replace their outputs by new parameters.
+ */
+void FoldConstant(StaticGraph* graph, ParamMap* arg_params) {
+  std::vector<uint32_t> live = LiveNodes(*graph);
+  std::vector<bool> is_const(graph->nodes.size(), false);
+  for (uint32_t nid : live) {
+    const StaticGraph::Node& node = graph->nodes[nid];
+    if (node.is_variable()) {
+      is_const[nid] = arg_params->count(node.name) != 0;
+    } else if (node.is_forward() && node.inputs.size() != 0 &&
+               node.op->TypeString() != "Custom" &&
+               node.op->ListAuxiliaryStates().size() == 0) {
+      bool all = true;
+      for (const DataEntry& e : node.inputs) all = all && is_const[e.source_id];
+      is_const[nid] = all;
+    }
+  }
+  // constant outputs used by the rest of the graph
+  std::set<DataEntry> targets;
+  for (uint32_t nid : live) {
+    if (is_const[nid]) continue;
+    for (const DataEntry& e : graph->nodes[nid].inputs) {
+      if (is_const[e.source_id] && !graph->nodes[e.source_id].is_variable()) targets.insert(e);
+    }
+  }
+  if (targets.size() == 0) return;
+  StaticGraph sub;
+  sub.nodes = graph->nodes;
+  sub.arg_nodes = graph->arg_nodes;
+  sub.heads.assign(targets.begin(), targets.end());
+  Symbol sym = ToSymbol(sub);
+  std::vector<NDArray> args;
+  for (const std::string& name : sym.ListArguments()) args.push_back(arg_params->at(name));
+  std::vector<NDArray> grads(args.size());
+  std::vector<OpReqType> grad_req(args.size(), kNullOp);
+  std::unique_ptr<Executor> exec(Executor::Bind(sym, Context::CPU(),
+                                                std::map<std::string, Context>(),
+                                                args, grads, grad_req,
+                                                std::vector<NDArray>()));
+  exec->Forward(false);
+  const std::vector<NDArray>& outputs = exec->outputs();
+  std::map<DataEntry, DataEntry> rep;
+  size_t i = 0;
+  for (const DataEntry& e : targets) {
+    const NDArray& out = outputs[i++];
+    NDArray value(out.shape(), Context::CPU(), false, out.dtype());
+    CopyFromTo(out, &value);
+    value.WaitToRead();
+    std::string name = graph->nodes[e.source_id].name + "_output";
+    if (e.index != 0) name += std::to_string(e.index);
+    name = UniqueName(*graph, *arg_params, name);
+    (*arg_params)[name] = value;
+    rep[e] = AddVariable(graph, name);
+  }
+  Replace(graph, rep);
+}
+}  // namespace
+
+void OptimizeForInference(Symbol *sym, ParamMap *arg_params, ParamMap *aux_params) {
+  StaticGraph graph;
+  graph.FromSymbol(*sym);
+  RemoveIdentity(&graph);
+  FoldBatchNorm(&graph, arg_params, *aux_params);
+  FuseActivation(&graph);
+  FoldConstant(&graph, arg_params);
+  // nodes that are no longer used are dropped by the conversion
+  *sym = ToSymbol(graph);
+}
+}  // namespace mxnet
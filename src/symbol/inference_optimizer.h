@@ -0,0 +1,33 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file inference_optimizer.h
+ * \brief rewrite a symbol and its parameters for inference only execution.
+ */
+#ifndef MXNET_SYMBOL_INFERENCE_OPTIMIZER_H_
+#define MXNET_SYMBOL_INFERENCE_OPTIMIZER_H_
+
+#include <mxnet/ndarray.h>
+#include <mxnet/symbolic.h>
+#include <string>
+#include <unordered_map>
+
+namespace mxnet {
+/*!
+ * \brief optimize a symbol for inference, the outputs of Forward(false) are kept.
+ *
+ *  - Dropout and identity operators are removed.
+ *  - BatchNorm after Convolution or FullyConnected is folded into the weight and bias.
+ *  - Activation after Convolution is fused into it.
+ *  - Operators whose inputs only depend on the parameters are computed once,
+ *    their outputs become new parameters.
+ *
+ *  Arguments without a parameter are the inputs, they are never folded.
+ * \param sym the symbol, rewritten inplace.
+ * \param arg_params parameters of the arguments by name, updated with the new parameters.
+ * \param aux_params auxiliary states by name.
+ */
+void OptimizeForInference(Symbol *sym,
+                          std::unordered_map<std::string, NDArray> *arg_params,
+                          std::unordered_map<std::string, NDArray> *aux_params);
+}  // namespace mxnet
+#endif  // MXNET_SYMBOL_INFERENCE_OPTIMIZER_H_
@@ -3,14 +3,26 @@
  * \file static_graph.cc
  * \brief static graph of mxnet
  */
+#include <dmlc/json.h>
 #include <dmlc/logging.h>
+#include <mxnet/subgraph.h>
 #include <mxnet/symbolic.h>
+#include <algorithm>
+#include <functional>
 #include <vector>
 #include <queue>
 #include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include "./static_graph.h"
 #include "./graph_algorithm.h"
 #include "../operator/operator_common.h"
+#include "../operator/fused_elemwise-inl.h"
 
 namespace mxnet {
 
@@ -56,10 +68,161 @@ std::vector<uint32_t> StaticGraph::TopoSort() const {
   return PostDFSOrder(head_nodes);
 }
 
+namespace {
+/*! \brief whether an attribute is unknown, to be inferred */
+inline bool IsUnknown(const TShape &shape) {
+  return shape.ndim() == 0;
+}
+inline bool IsUnknown(int type) {
+  return type == -1;
+}
+}  // namespace
+
+template<typename AttrType>
+int StaticGraph::MatchInferMemo(const InferMemo<AttrType> &memo,
+                                const std::vector<uint32_t> &topo_order,
+                                const std::vector<std::vector<AttrType> > &in_attrs,
+                                bool partial_infer,
+                                std::vector<bool> *dirty) const {
+  if (memo.topo_order != topo_order || memo.partial_infer != partial_infer ||
+      memo.inputs.size() != nodes.size()) {
+    return 0;
+  }
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (memo.inputs[i] != nodes[i].inputs ||
+        memo.backward_source_ids[i] != nodes[i].backward_source_id) {
+      return 0;
+    }
+  }
+  std::vector<uint32_t> changed;
+  for (uint32_t nid : topo_order) {
+    if (memo.in_attrs[nid] == in_attrs[nid]) continue;
+    if (!nodes[nid].is_variable() || memo.in_attrs[nid].size() != in_attrs[nid].size()) {
+      return 0;
+    }
+    changed.push_back(nid);
+  }
+  if (changed.empty()) return 1;
+  if (!memo.complete) return 0;
+  // the nodes reached from the changed variables, and the variables inferred
+  // by a dirty node, whose other consumers are then dirty too
+  std::vector<std::vector<uint32_t> > consumers(nodes.size());
+  for (uint32_t nid : topo_order) {
+    for (const DataEntry &e : nodes[nid].inputs) consumers[e.source_id].push_back(nid);
+    if (nodes[nid].is_backward()) consumers[nodes[nid].backward_source_id].push_back(nid);
+  }
+  dirty->assign(nodes.size(), false);
+  std::vector<uint32_t> stack;
+  auto mark = [&](uint32_t nid) {
+    if (!(*dirty)[nid]) {
+      (*dirty)[nid] = true;
+      stack.push_back(nid);
+    }
+  };
+  for (uint32_t nid : changed) mark(nid);
+  while (!stack.empty()) {
+    const uint32_t nid = stack.back();
+    stack.pop_back();
+    for (uint32_t c : consumers[nid]) mark(c);
+    for (const DataEntry &e : nodes[nid].inputs) {
+      if (nodes[e.source_id].is_variable() && IsUnknown(in_attrs[e.source_id][0])) {
+        mark(e.source_id);
+      }
+    }
+  }
+  return 2;
+}
+
+template<typename AttrType, typename FInfer>
+bool StaticGraph::MemoizedInfer(InferMemo<AttrType> *memo,
+                                const std::vector<uint32_t> &topo_order,
+                                std::vector<std::vector<AttrType> > *node_out_attrs,
+                                std::vector<std::vector<AttrType> > *node_aux_attrs,
+                                bool partial_infer,
+                                FInfer infer) const {
+  std::vector<bool> dirty;
+  const int match = MatchInferMemo(*memo, topo_order, *node_out_attrs, partial_infer, &dirty);
+  if (match == 1) {
+    *node_out_attrs = memo->out_attrs;
+    *node_aux_attrs = memo->aux_attrs;
+    return true;
+  }
+  std::vector<std::vector<AttrType> > in_attrs = *node_out_attrs;
+  bool success;
+  if (match == 2) {
+    // the clean nodes keep their results, the dirty ones start from the call
+    std::vector<uint32_t> dirty_order;
+    for (uint32_t nid : topo_order) {
+      if (dirty[nid]) {
+        dirty_order.push_back(nid);
+        (*node_aux_attrs)[nid].clear();
+      } else {
+        (*node_out_attrs)[nid] = memo->out_attrs[nid];
+        (*node_aux_attrs)[nid] = memo->aux_attrs[nid];
+      }
+    }
+    success = infer(dirty_order, node_out_attrs, node_aux_attrs);
+  } else {
+    success = infer(topo_order, node_out_attrs, node_aux_attrs);
+  }
+  if (!success) return false;
+  memo->topo_order = topo_order;
+  memo->inputs.resize(nodes.size());
+  memo->backward_source_ids.resize(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    memo->inputs[i] = nodes[i].inputs;
+    memo->backward_source_ids[i] = nodes[i].backward_source_id;
+  }
+  memo->partial_infer = partial_infer;
+  memo->in_attrs = std::move(in_attrs);
+  memo->out_attrs = *node_out_attrs;
+  memo->aux_attrs = *node_aux_attrs;
+  memo->complete = true;
+  for (uint32_t nid : topo_order) {
+    for (const AttrType &attr : (*node_out_attrs)[nid]) {
+      if (IsUnknown(attr)) memo->complete = false;
+    }
+  }
+  return true;
+}
+
 bool StaticGraph::InferNodeShapes(const std::vector<uint32_t> &topo_order,
                                   std::vector<std::vector<TShape> > *node_out_shapes,
                                   std::vector<std::vector<TShape> > *node_aux_shapes,
                                   bool partial_infer) const {
+  auto infer = [this, partial_infer](const std::vector<uint32_t> &order,
+                                     std::vector<std::vector<TShape> > *out_shapes,
+                                     std::vector<std::vector<TShape> > *aux_shapes) {
+    return InferNodeShapesImpl(order, out_shapes, aux_shapes, partial_infer);
+  };
+  if (infer_cache == nullptr) {
+    return infer(topo_order, node_out_shapes, node_aux_shapes);
+  }
+  std::lock_guard<std::mutex> lock(infer_cache->mutex);
+  return MemoizedInfer(&infer_cache->shape, topo_order, node_out_shapes, node_aux_shapes,
+                       partial_infer, infer);
+}
+
+bool StaticGraph::InferNodeTypes(const std::vector<uint32_t> &topo_order,
+                                 std::vector<std::vector<int> > *node_out_types,
+                                 std::vector<std::vector<int> > *node_aux_types) const {
+  auto infer = [this](const std::vector<uint32_t> &order,
+                      std::vector<std::vector<int> > *out_types,
+                      std::vector<std::vector<int> > *aux_types) {
+    return InferNodeTypesImpl(order, out_types, aux_types);
+  };
+  if (infer_cache == nullptr) {
+    return infer(topo_order, node_out_types, node_aux_types);
+  }
+  std::lock_guard<std::mutex> lock(infer_cache->mutex);
+  return MemoizedInfer(&infer_cache->type, topo_order, node_out_types, node_aux_types,
+                       false, infer);
+}
+
+bool StaticGraph::InferNodeShapesImpl(const std::vector<uint32_t> &topo_order,
+                                      std::vector<std::vector<TShape> > *node_out_shapes,
+                                      std::vector<std::vector<TShape> > *node_aux_shapes,
+                                      bool partial_infer) const {
   for (uint32_t nid : topo_order) {
     const Node& node = nodes[nid];
     if (node.is_forward()) {
@@ -157,9 +320,9 @@ bool StaticGraph::InferNodeShapes(const std::vector<uint32_t> &topo_order,
   return true;
 }
 
-bool StaticGraph::InferNodeTypes(const std::vector<uint32_t> &topo_order,
-                                  std::vector<std::vector<int> > *node_out_types,
-                                  std::vector<std::vector<int> > *node_aux_types) const {
+bool StaticGraph::InferNodeTypesImpl(const std::vector<uint32_t> &topo_order,
+                                     std::vector<std::vector<int> > *node_out_types,
+                                     std::vector<std::vector<int> > *node_aux_types) const {
   for (uint32_t nid : topo_order) {
     const Node& node = nodes[nid];
     if (node.is_forward()) {
@@ -392,9 +555,435 @@ StaticGraph::Node StaticGraph::CreateCopyNode(const DataEntry &source) {
   return copy_node;
 }
 
+void StaticGraph::PlanMirror(const std::vector<TShape>& arg_shapes,
+                             size_t mem_budget,
+                             std::unordered_set<uint32_t>* mirror_nodes) const {
+  mirror_nodes->clear();
+  std::vector<uint32_t> topo_order = TopoSort();
+  std::vector<std::vector<TShape> > node_out_shapes(nodes.size());
+  std::vector<std::vector<TShape> > node_aux_shapes(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    node_out_shapes[i].resize(nodes[i].is_forward() ? nodes[i].op->NumOutputs() : 1);
+  }
+  CHECK_EQ(arg_shapes.size(), arg_nodes.size());
+  for (size_t i = 0; i < arg_nodes.size(); ++i) {
+    node_out_shapes[arg_nodes[i]][0] = arg_shapes[i];
+  }
+  // unknown shapes count as empty
+  InferNodeShapes(topo_order, &node_out_shapes, &node_aux_shapes, true);
+  std::unordered_set<uint32_t> head_set;
+  for (const DataEntry& e : heads) head_set.insert(e.source_id);
+
+  struct Candidate {
+    uint32_t nid;
+    size_t bytes;
+    double cost;
+  };
+  // group of each node, nodes without ctx_group follow their first input
+  std::vector<std::string> group(nodes.size());
+  std::map<std::string, size_t> group_bytes;
+  std::map<std::string, std::vector<Candidate> > candidates;
+  for (uint32_t nid : topo_order) {
+    const Node& node = nodes[nid];
+    auto it = node.attr.find("ctx_group");
+    if (it != node.attr.end()) {
+      group[nid] = it->second;
+    } else if (node.inputs.size() != 0) {
+      group[nid] = group[node.inputs[0].source_id];
+    }
+    size_t bytes = 0;
+    for (const TShape& s : node_out_shapes[nid]) bytes += s.Size() * sizeof(real_t);
+    group_bytes[group[nid]] += bytes;
+    if (node.is_variable() || head_set.count(nid) != 0) continue;
+    std::string type = node.op->TypeString();
+    if (type == "Dropout" || type == "CuDNNBatchNorm") continue;
+    if (node.get_attr("force_mirroring", false)) {
+      mirror_nodes->insert(nid);
+      group_bytes[group[nid]] -= bytes;
+      continue;
+    }
+    if (bytes == 0) continue;
+    // recompute cost is about the output size times the weight size per output channel
+    double weight = 0;
+    for (const DataEntry& e : node.inputs) {
+      if (nodes[e.source_id].is_variable() && e.source_id != node.inputs[0].source_id) {
+        weight += node_out_shapes[e.source_id][0].Size();
+      }
+    }
+    const TShape& oshape = node_out_shapes[nid][0];
+    double channel = oshape.ndim() > 1 ? oshape[1] : 1;
+    double cost = static_cast<double>(oshape.Size()) * std::max(1.0, weight / channel);
+    candidates[group[nid]].push_back(Candidate{nid, bytes, cost});
+  }
+  for (auto& kv : candidates) {
+    std::vector<Candidate>& cands = kv.second;
+    std::sort(cands.begin(), cands.end(), [](const Candidate& a, const Candidate& b) {
+        return a.cost * b.bytes < b.cost * a.bytes;
+      });
+    size_t& total = group_bytes[kv.first];
+    for (const Candidate& c : cands) {
+      if (total <= mem_budget) break;
+      mirror_nodes->insert(c.nid);
+      total -= c.bytes;
+    }
+  }
+  for (const auto& kv : group_bytes) {
+    if (kv.second > mem_budget) {
+      LOG(WARNING) << "Estimated memory " << (kv.second >> 20) << " MB of ctx_group \""
+                   << kv.first << "\" exceeds the budget " << (mem_budget >> 20)
+                   << " MB even with all possible nodes mirrored";
+    }
+  }
+}
+
+size_t StaticGraph::FuseElemwise() {
+  std::vector<uint32_t> topo_order = TopoSort();
+  std::vector<int> opcode(nodes.size(), -1);
+  std::vector<std::vector<uint32_t> > consumers(nodes.size());
+  for (uint32_t nid : topo_order) {
+    const Node& node = nodes[nid];
+    if (node.is_forward()) opcode[nid] = op::fused::NodeOpCode(*node.op);
+    for (const DataEntry& e : node.inputs) consumers[e.source_id].push_back(nid);
+  }
+  std::vector<uint32_t> pos(nodes.size());
+  for (size_t i = 0; i < topo_order.size(); ++i) pos[topo_order[i]] = static_cast<uint32_t>(i);
+  std::unordered_set<uint32_t> head_set;
+  for (const DataEntry& e : heads) head_set.insert(e.source_id);
+  auto ctx_group = [this](uint32_t nid) {
+    auto it = nodes[nid].attr.find("ctx_group");
+    return it == nodes[nid].attr.end() ? std::string() : it->second;
+  };
+  // root of the fused node each node is in
+  std::vector<int> root(nodes.size(), -1);
+  std::vector<bool> removed(nodes.size(), false);
+  size_t num_removed = 0;
+  for (auto rit = topo_order.rbegin(); rit != topo_order.rend(); ++rit) {
+    uint32_t rid = *rit;
+    if (opcode[rid] == -1 || root[rid] != -1) continue;
+    root[rid] = rid;
+    std::vector<uint32_t> members{rid};
+    std::string group = ctx_group(rid);
+    // absorb inputs in reverse topo order, so all consumers of a candidate are decided.
+    // cands holds topo positions.
+    std::set<uint32_t, std::greater<uint32_t> > cands;
+    auto add_inputs = [&](uint32_t nid) {
+      for (const DataEntry& e : nodes[nid].inputs) {
+        if (opcode[e.source_id] != -1 && root[e.source_id] == -1) cands.insert(pos[e.source_id]);
+      }
+    };
+    add_inputs(rid);
+    while (!cands.empty()) {
+      uint32_t cid = topo_order[*cands.begin()];
+      cands.erase(cands.begin());
+      if (head_set.count(cid) != 0 || ctx_group(cid) != group) continue;
+      bool inside = true;
+      for (uint32_t c : consumers[cid]) inside = inside && root[c] == static_cast<int>(rid);
+      if (!inside) continue;
+      root[cid] = rid;
+      members.push_back(cid);
+      add_inputs(cid);
+    }
+    if (members.size() < 2) continue;
+    std::sort(members.begin(), members.end(), [&pos](uint32_t a, uint32_t b) {
+        return pos[a] < pos[b];
+      });
+    // external inputs become the arguments, members become registers after them
+    std::vector<DataEntry> args;
+    std::map<DataEntry, int> arg_index;
+    for (uint32_t nid : members) {
+      for (const DataEntry& e : nodes[nid].inputs) {
+        if (root[e.source_id] == static_cast<int>(rid) || arg_index.count(e) != 0) continue;
+        arg_index[e] = static_cast<int>(args.size());
+        args.push_back(e);
+      }
+    }
+    std::map<uint32_t, int> reg;
+    std::vector<op::fused::Instr> prog;
+    for (uint32_t nid : members) {
+      const Node& node = nodes[nid];
+      std::vector<int> operands;
+      for (const DataEntry& e : node.inputs) {
+        operands.push_back(root[e.source_id] == static_cast<int>(rid) ?
+                           reg.at(e.source_id) : arg_index.at(e));
+      }
+      op::fused::Instr ins;
+      ins.op = opcode[nid];
+      ins.lhs = operands[0];
+      ins.rhs = operands.size() > 1 ? operands[1] : -1;
+      ins.scalar = op::fused::HasScalar(ins.op) ?
+          std::stof(node.op->GetParams()["scalar"]) : 0.0f;
+      reg[nid] = static_cast<int>(args.size() + prog.size());
+      prog.push_back(ins);
+    }
+    Node& fused = nodes[rid];
+    fused.op.reset(OperatorProperty::Create("_FusedElemwise"));
+    fused.op->Init({{"num_args", std::to_string(args.size())},
+                    {"program", op::fused::PrintProgram(prog)}});
+    fused.inputs = args;
+    for (uint32_t nid : members) {
+      if (nid == rid) continue;
+      removed[nid] = true;
+      ++num_removed;
+    }
+  }
+  // removed nodes are only referred to inside their fused node
+  if (num_removed != 0) RemoveNodes(removed);
+  return num_removed;
+}
+
+namespace {
+/*! \brief whether a node only forwards its single input */
+inline bool IsIdentity(const OperatorProperty& op) {
+  const std::string type = op.TypeString();
+  std::map<std::string, std::string> param = op.GetParams();
+  if (type == "_plus_scalar" || type == "_minus_scalar") {
+    return std::stof(param["scalar"]) == 0.0f;
+  }
+  if (type == "_mul_scalar" || type == "_div_scalar" || type == "_power_scalar") {
+    return std::stof(param["scalar"]) == 1.0f;
+  }
+  if (type == "ElementWiseSum" || type == "Concat") {
+    return param["num_args"] == "1";
+  }
+  return false;
+}
+
+/*!
+ * \brief whether two nodes of the op with the same inputs compute the same outputs and
+ *  gradients. The random and stateful ops are not, and neither are the losses, as their
+ *  backward ignores the output gradient, so each of them adds its own gradient.
+ */
+inline bool IsPure(const OperatorProperty& op) {
+  static const std::unordered_set<std::string> impure = {
+    "Dropout", "_sample_uniform", "_sample_normal", "sample_multinomial",
+    "Custom", "_Native", "_NDArray"};
+  if (impure.count(op.TypeString()) != 0 || op.ListAuxiliaryStates().size() != 0) {
+    return false;
+  }
+  const int nvisible = op.NumVisibleOutputs();
+  std::vector<int> out_grad, in_data, out_data;
+  int id = 0;
+  for (int i = 0; i < nvisible; ++i) out_grad.push_back(id++);
+  for (size_t i = 0; i < op.ListArguments().size(); ++i) in_data.push_back(id++);
+  for (int i = 0; i < op.NumOutputs(); ++i) out_data.push_back(id++);
+  for (int dep : op.DeclareBackwardDependency(out_grad, in_data, out_data)) {
+    if (dep < nvisible) return true;
+  }
+  return false;
+}
+}  // namespace
+
+size_t StaticGraph::Simplify() {
+  std::vector<uint32_t> topo_order = TopoSort();
+  std::unordered_set<uint32_t> head_set;
+  for (const DataEntry& e : heads) head_set.insert(e.source_id);
+  std::map<DataEntry, DataEntry> replaced;
+  // the first node of each (op, params, attributes, inputs)
+  std::unordered_map<std::string, uint32_t> computed;
+  for (uint32_t nid : topo_order) {
+    Node& node = nodes[nid];
+    for (DataEntry& e : node.inputs) {
+      auto it = replaced.find(e);
+      if (it != replaced.end()) e = it->second;
+    }
+    // the heads are kept, so are the outputs of the graph
+    if (!node.is_forward() || head_set.count(nid) != 0) continue;
+    if (node.inputs.size() == 1 && node.op->NumOutputs() == 1 && IsIdentity(*node.op)) {
+      replaced[DataEntry(nid, 0)] = node.inputs[0];
+      continue;
+    }
+    if (!IsPure(*node.op)) continue;
+    std::ostringstream key;
+    key << node.op->TypeString() << '(';
+    for (const auto& kv : node.op->GetParams()) key << kv.first << '=' << kv.second << ',';
+    key << ")[";
+    for (const auto& kv : node.attr) key << kv.first << '=' << kv.second << ',';
+    key << "]";
+    for (const DataEntry& e : node.inputs) key << ' ' << e.source_id << ':' << e.index;
+    auto it = computed.find(key.str());
+    if (it == computed.end()) {
+      computed[key.str()] = nid;
+      continue;
+    }
+    for (int i = 0; i < node.op->NumOutputs(); ++i) {
+      replaced[DataEntry(nid, static_cast<uint32_t>(i))] =
+          DataEntry(it->second, static_cast<uint32_t>(i));
+    }
+  }
+  // the nodes no head reaches any more are removed, the arguments are kept
+  std::vector<uint32_t> head_nodes(head_set.begin(), head_set.end());
+  std::vector<bool> removed(nodes.size(), true);
+  for (uint32_t nid : PostDFSOrder(head_nodes)) removed[nid] = false;
+  for (uint32_t nid : arg_nodes) removed[nid] = false;
+  size_t num_removed = 0;
+  for (bool r : removed) num_removed += r;
+  if (num_removed != 0) RemoveNodes(removed);
+  return num_removed;
+}
+
+void StaticGraph::RemoveNodes(const std::vector<bool>& removed) {
+  std::vector<uint32_t> new_id(nodes.size());
+  std::vector<Node> new_nodes;
+  for (uint32_t nid = 0; nid < nodes.size(); ++nid) {
+    if (removed[nid]) continue;
+    new_id[nid] = static_cast<uint32_t>(new_nodes.size());
+    new_nodes.push_back(std::move(nodes[nid]));
+  }
+  for (Node& node : new_nodes) {
+    for (DataEntry& e : node.inputs) e.source_id = new_id[e.source_id];
+  }
+  for (uint32_t& nid : arg_nodes) nid = new_id[nid];
+  for (DataEntry& e : heads) e.source_id = new_id[e.source_id];
+  nodes = std::move(new_nodes);
+}
+
+size_t StaticGraph::PartitionSubgraphs(const std::string& backend_name, const Context& ctx,
+                                       const std::vector<TShape>& arg_shapes) {
+  SubgraphBackend* backend = SubgraphBackend::Get(backend_name);
+  CHECK(backend != nullptr) << "unknown subgraph backend " << backend_name;
+  std::vector<uint32_t> topo_order = TopoSort();
+  std::vector<std::vector<TShape> > node_out_shapes(nodes.size());
+  std::vector<std::vector<TShape> > node_aux_shapes(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    node_out_shapes[i].resize(nodes[i].is_forward() ? nodes[i].op->NumOutputs() : 1);
+  }
+  CHECK_EQ(arg_shapes.size(), arg_nodes.size());
+  for (size_t i = 0; i < arg_nodes.size(); ++i) {
+    node_out_shapes[arg_nodes[i]][0] = arg_shapes[i];
+  }
+  // unknown shapes are given as empty
+  InferNodeShapes(topo_order, &node_out_shapes, &node_aux_shapes, true);
+  auto ctx_group = [this](uint32_t nid) {
+    auto it = nodes[nid].attr.find("ctx_group");
+    return it == nodes[nid].attr.end() ? std::string() : it->second;
+  };
+  // subgraph of each node, -1 if none, and the subgraphs each node depends on
+  std::vector<int> group(nodes.size(), -1);
+  std::vector<std::set<int> > deps(nodes.size());
+  std::vector<std::vector<uint32_t> > members;
+  for (uint32_t nid : topo_order) {
+    const Node& node = nodes[nid];
+    for (const DataEntry& e : node.inputs) {
+      deps[nid].insert(deps[e.source_id].begin(), deps[e.source_id].end());
+      if (group[e.source_id] != -1) deps[nid].insert(group[e.source_id]);
+    }
+    if (!node.is_forward()) continue;
+    if (node.op->ListAuxiliaryStates().size() != 0) continue;
+    if (node.op->NumVisibleOutputs() != node.op->NumOutputs()) continue;
+    std::vector<TShape> in_shapes;
+    for (const DataEntry& e : node.inputs) {
+      in_shapes.push_back(node_out_shapes[e.source_id][e.index]);
+    }
+    if (!backend->Supports(*node.op, in_shapes, ctx)) continue;
+    // join the first subgraph of an input no other input depends on
+    int join = -1;
+    for (const DataEntry& e : node.inputs) {
+      const int g = group[e.source_id];
+      if (g == -1 || ctx_group(members[g][0]) != ctx_group(nid)) continue;
+      bool acyclic = true;
+      for (const DataEntry& other : node.inputs) {
+        if (group[other.source_id] != g && deps[other.source_id].count(g) != 0) acyclic = false;
+      }
+      if (acyclic) {
+        join = g;
+        break;
+      }
+    }
+    if (join == -1) {
+      join = static_cast<int>(members.size());
+      members.emplace_back();
+    }
+    group[nid] = join;
+    members[join].push_back(nid);
+  }
+  if (members.empty()) return 0;
+
+  // the entries of the members read by the other nodes or the heads
+  std::vector<std::vector<DataEntry> > outputs(members.size());
+  std::vector<std::set<DataEntry> > output_set(members.size());
+  auto add_output = [&](const DataEntry& e) {
+    const int g = group[e.source_id];
+    if (g != -1 && output_set[g].insert(e).second) outputs[g].push_back(e);
+  };
+  for (uint32_t nid : topo_order) {
+    for (const DataEntry& e : nodes[nid].inputs) {
+      if (group[e.source_id] != group[nid]) add_output(e);
+    }
+  }
+  for (const DataEntry& e : heads) add_output(e);
+
+  std::vector<bool> removed(nodes.size(), false);
+  std::map<DataEntry, DataEntry> replaced;
+  for (size_t g = 0; g < members.size(); ++g) {
+    // the members are in topological order, the last one becomes the subgraph node
+    const uint32_t last = members[g].back();
+    StaticGraph sub;
+    std::vector<DataEntry> args;
+    std::map<DataEntry, uint32_t> arg_node;
+    std::map<uint32_t, uint32_t> sub_id;
+    for (uint32_t nid : members[g]) {
+      Node node(nodes[nid]);
+      for (DataEntry& e : node.inputs) {
+        if (group[e.source_id] == static_cast<int>(g)) {
+          e.source_id = sub_id.at(e.source_id);
+          continue;
+        }
+        if (arg_node.count(e) == 0) {
+          Node var;
+          var.name = "arg" + std::to_string(args.size());
+          arg_node[e] = static_cast<uint32_t>(sub.nodes.size());
+          sub.arg_nodes.push_back(static_cast<uint32_t>(sub.nodes.size()));
+          sub.nodes.push_back(std::move(var));
+          args.push_back(e);
+        }
+        e = DataEntry(arg_node.at(e), 0);
+      }
+      sub_id[nid] = static_cast<uint32_t>(sub.nodes.size());
+      sub.nodes.push_back(std::move(node));
+    }
+    for (size_t j = 0; j < outputs[g].size(); ++j) {
+      const DataEntry& e = outputs[g][j];
+      sub.heads.push_back(DataEntry(sub_id.at(e.source_id), e.index));
+      replaced[e] = DataEntry(last, static_cast<uint32_t>(j));
+    }
+    Symbol symbol;
+    symbol.FromStaticGraph(sub);
+    std::ostringstream os;
+    dmlc::JSONWriter writer(&os);
+    symbol.Save(&writer);
+
+    Node& node = nodes[last];
+    node.op.reset(OperatorProperty::Create("_Subgraph"));
+    node.op->Init({{"backend", backend_name},
+                   {"symbol", os.str()},
+                   {"num_args", std::to_string(args.size())},
+                   {"num_outputs", std::to_string(outputs[g].size())}});
+    node.inputs = args;
+    for (uint32_t nid : members[g]) {
+      if (nid != last) removed[nid] = true;
+    }
+  }
+  // the members outside of their subgraph are read through its outputs
+  for (uint32_t nid = 0; nid < nodes.size(); ++nid) {
+    if (removed[nid]) continue;
+    for (DataEntry& e : nodes[nid].inputs) {
+      auto it = replaced.find(e);
+      if (it != replaced.end()) e = it->second;
+    }
+  }
+  for (DataEntry& e : heads) {
+    auto it = replaced.find(e);
+    if (it != replaced.end()) e = it->second;
+  }
+  RemoveNodes(removed);
+  return members.size();
+}
+
 void StaticGraph::MakeBackwardPass(std::vector<uint32_t> *head_grad_nodes,
                                    std::vector<DataEntry>* arg_grads,
-                                   std::map<uint32_t, uint32_t>* out_mirror_map) {
+                                   std::map<uint32_t, uint32_t>* out_mirror_map,
+                                   const std::unordered_set<uint32_t>* mirror_nodes,
+                                   const std::vector<bool>* need_arg_grad) {
   // get topo order of nodes, before new nodes are added
   std::vector<uint32_t> topo_order = TopoSort();
 
@@ -406,7 +995,8 @@ void StaticGraph::MakeBackwardPass(std::vector<uint32_t> *head_grad_nodes,
   int counter = 0;
   int *pcounter = &counter;
 
-  auto need_mirror = [this, do_mirror, pcounter, mirror_step](uint32_t nid) {
+  auto need_mirror = [this, do_mirror, pcounter, mirror_step, mirror_nodes](uint32_t nid) {
+    if (mirror_nodes != nullptr) return mirror_nodes->count(nid) != 0;
     if (nodes[nid].is_variable()) return false;
     if (!nodes[nid].is_forward()) return false;
     std::string type = nodes[nid].op->TypeString();
@@ -423,8 +1013,40 @@ void StaticGraph::MakeBackwardPass(std::vector<uint32_t> *head_grad_nodes,
     return true;
   };
 
+  std::vector<bool> mirrored(nodes.size(), false);
+  for (uint32_t nid : topo_order) mirrored[nid] = need_mirror(nid);
+
+  // a forward node needs its backward node when one of its inputs depends on an
+  // argument that needs a gradient, the others only feed gradients no one reads.
+  std::vector<bool> need_backward(nodes.size(), true);
+  if (need_arg_grad != nullptr) {
+    CHECK_EQ(need_arg_grad->size(), arg_nodes.size());
+    std::vector<bool> need_grad(nodes.size(), false);
+    for (size_t i = 0; i < arg_nodes.size(); ++i) {
+      need_grad[arg_nodes[i]] = (*need_arg_grad)[i];
+    }
+    for (uint32_t nid : topo_order) {
+      if (nodes[nid].is_variable()) continue;
+      for (const DataEntry& e : nodes[nid].inputs) {
+        if (need_grad[e.source_id]) need_grad[nid] = true;
+      }
+      need_backward[nid] = need_grad[nid];
+    }
+    // only mirror the nodes read by the remaining backward nodes
+    std::vector<bool> read(nodes.size(), false);
+    for (auto it = topo_order.rbegin(); it != topo_order.rend(); ++it) {
+      const Node& node = nodes[*it];
+      if (node.is_variable()) continue;
+      if (need_backward[*it]) read[*it] = true;
+      if (need_backward[*it] || (read[*it] && mirrored[*it])) {
+        for (const DataEntry& e : node.inputs) read[e.source_id] = true;
+      }
+    }
+    for (uint32_t nid : topo_order) mirrored[nid] = mirrored[nid] && read[nid];
+  }
+
   for (uint32_t nid : topo_order) {
-    if (need_mirror(nid)) {
+    if (mirrored[nid]) {
       uint32_t dup_node_id = static_cast<uint32_t>(nodes.size());
       Node node(nodes[nid]);
       node.name += "_mirror";
@@ -468,8 +1090,8 @@ void StaticGraph::MakeBackwardPass(std::vector<uint32_t> *head_grad_nodes,
   for (auto it = topo_order.rbegin(); it != topo_order.rend(); ++it) {
     uint32_t nid = *it;
     uint32_t mirror_nid = mirror_map[nid];
-    // skip variables
-    if (nodes[nid].is_variable()) continue;
+    // skip variables, and the nodes whose gradients are not needed
+    if (nodes[nid].is_variable() || !need_backward[nid]) continue;
     CHECK(nodes[nid].is_forward()) << "Do not support Backward of Backward";
     // get out_grad and out_data entry
     std::vector<DataEntry> out_grad, out_data;
@@ -531,6 +1153,7 @@ void StaticGraph::MakeBackwardPass(std::vector<uint32_t> *head_grad_nodes,
   // create return values of arg_grads
   arg_grads->resize(arg_nodes.size());
   for (size_t i = 0; i < arg_nodes.size(); ++i) {
+    if (need_arg_grad != nullptr && !(*need_arg_grad)[i]) continue;
     DataEntry odata(arg_nodes[i], 0);
     auto it = grad_map.find(odata);
     CHECK(it != grad_map.end()) << "bad graph";
@@ -569,7 +1192,79 @@ void StaticGraph::Node::Save(dmlc::JSONWriter *writer) const {
   writer->EndObject();
 }
 
+namespace {
+/*! \brief the key of an operator in StaticGraph::OpCache */
+template<typename Params>
+std::string OpCacheKey(const std::string &type, const Params &param) {
+  std::string key = type;
+  for (const auto &kv : param) {
+    key.push_back('\0');
+    key += kv.first;
+    key.push_back('\0');
+    key += kv.second;
+  }
+  return key;
+}
+
+/*! \brief the entries as source_id, index pairs */
+std::vector<uint32_t> FlattenEntries(const std::vector<StaticGraph::DataEntry> &entries) {
+  std::vector<uint32_t> ret;
+  ret.reserve(entries.size() * 2);
+  for (const auto &e : entries) {
+    ret.push_back(e.source_id);
+    ret.push_back(e.index);
+  }
+  return ret;
+}
+
+bool UnflattenEntries(const std::vector<uint32_t> &flat,
+                      std::vector<StaticGraph::DataEntry> *entries) {
+  if (flat.size() % 2 != 0) return false;
+  entries->clear();
+  entries->reserve(flat.size() / 2);
+  for (size_t i = 0; i < flat.size(); i += 2) {
+    entries->push_back(StaticGraph::DataEntry(flat[i], flat[i + 1]));
+  }
+  return true;
+}
+
+/*!
+ * \brief the binary graph format: the magic, a reserved word, the distinct operators
+ *  as their types then the keys and values of each, the nodes, the arguments and the heads
+ */
+const uint64_t kBinaryGraphMagic = 0x114;
+}  // namespace
+
+void StaticGraph::Node::InitOp(const std::string &type,
+                               const std::vector<std::pair<std::string, std::string> > &param,
+                               OpCache *cache) {
+  std::string key;
+  if (cache != nullptr) {
+    key = OpCacheKey(type, param);
+    auto it = cache->find(key);
+    if (it != cache->end()) {
+      op.reset(it->second->Copy());
+      return;
+    }
+  }
+  try {
+    op.reset(OperatorProperty::Create(type.c_str()));
+    op->Init(param);
+  } catch (const dmlc::Error &err) {
+    std::ostringstream os;
+    os << "Failed loading Op " << name << " of type " << type << ": " << err.what();
+    throw dmlc::Error(os.str());
+  }
+  if (cache != nullptr) {
+    cache->emplace(key, std::unique_ptr<OperatorProperty>(op->Copy()));
+  }
+}
+
 void StaticGraph::Node::Load(dmlc::JSONReader *reader) {
+  this->Load(reader, nullptr);
+}
+
+void StaticGraph::Node::Load(dmlc::JSONReader *reader, OpCache *cache) {
   attr.clear();
   dmlc::JSONObjectReadHelper helper;
   std::string op_type_str;
@@ -583,15 +1278,8 @@ void StaticGraph::Node::Load(dmlc::JSONReader *reader) {
   helper.ReadAllFields(reader);
 
   if (op_type_str != "null") {
-    try {
-      op.reset(OperatorProperty::Create(op_type_str.c_str()));
-      std::vector<std::pair<std::string, std::string> > vec(param.begin(), param.end());
-      op->Init(vec);
-    } catch (const dmlc::Error &err) {
-      std::ostringstream os;
-      os << "Failed loading Op " << name << " of type " << op_type_str << ": " << err.what();
-      throw dmlc::Error(os.str());
-    }
+    std::vector<std::pair<std::string, std::string> > vec(param.begin(), param.end());
+    this->InitOp(op_type_str, vec, cache);
   } else {
     op.reset(nullptr);
   }
@@ -606,10 +1294,132 @@ void StaticGraph::Save(dmlc::JSONWriter *writer) const {
 }
 
 void StaticGraph::Load(dmlc::JSONReader *reader) {
-  dmlc::JSONObjectReadHelper helper;
-  helper.DeclareField("nodes", &nodes);
-  helper.DeclareField("arg_nodes", &arg_nodes);
-  helper.DeclareField("heads", &heads);
-  helper.ReadAllFields(reader);
+  // the nodes are read one by one, so that they share the operators of the cache
+  OpCache cache;
+  bool has_nodes = false, has_arg_nodes = false, has_heads = false;
+  std::string key;
+  nodes.clear();
+  reader->BeginObject();
+  while (reader->NextObjectItem(&key)) {
+    if (key == "nodes") {
+      reader->BeginArray();
+      while (reader->NextArrayItem()) {
+        nodes.emplace_back();
+        nodes.back().Load(reader, &cache);
+      }
+      has_nodes = true;
+    } else if (key == "arg_nodes") {
+      reader->Read(&arg_nodes);
+      has_arg_nodes = true;
+    } else if (key == "heads") {
+      reader->Read(&heads);
+      has_heads = true;
+    } else {
+      LOG(FATAL) << "JSONReader: Unknown field " << key;
+    }
+  }
+  CHECK(has_nodes && has_arg_nodes && has_heads)
+      << "JSONReader: Missing field, a graph needs nodes, arg_nodes and heads";
+}
+
+void StaticGraph::Save(dmlc::Stream *fo) const {
+  // the distinct operators, node_ops[i] is the operator of node i or -1
+  std::vector<std::string> op_types;
+  std::vector<std::vector<std::string> > op_keys, op_values;
+  std::unordered_map<std::string, int32_t> op_index;
+  std::vector<int32_t> node_ops(nodes.size(), -1);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const Node &node = nodes[i];
+    CHECK_EQ(node.addto_index.size(), 0)
+        << "Not support serializing addto_index for now";
+    if (node.op == nullptr) continue;
+    std::string type = node.op->TypeString();
+    std::map<std::string, std::string> param = node.op->GetParams();
+    auto it = op_index.find(OpCacheKey(type, param));
+    if (it == op_index.end()) {
+      it = op_index.emplace(OpCacheKey(type, param),
+                            static_cast<int32_t>(op_types.size())).first;
+      op_types.push_back(type);
+      op_keys.emplace_back();
+      op_values.emplace_back();
+      for (const auto &kv : param) {
+        op_keys.back().push_back(kv.first);
+        op_values.back().push_back(kv.second);
+      }
+    }
+    node_ops[i] = it->second;
+  }
+  uint64_t header = kBinaryGraphMagic, reserved = 0;
+  fo->Write(&header, sizeof(header));
+  fo->Write(&reserved, sizeof(reserved));
+  fo->Write(op_types);
+  for (size_t k = 0; k < op_types.size(); ++k) {
+    fo->Write(op_keys[k]);
+    fo->Write(op_values[k]);
+  }
+  uint64_t num_nodes = nodes.size();
+  fo->Write(&num_nodes, sizeof(num_nodes));
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const Node &node = nodes[i];
+    std::vector<std::string> attr_keys, attr_values;
+    for (const auto &kv : node.attr) {
+      attr_keys.push_back(kv.first);
+      attr_values.push_back(kv.second);
+    }
+    fo->Write(&node_ops[i], sizeof(node_ops[i]));
+    fo->Write(node.name);
+    fo->Write(FlattenEntries(node.inputs));
+    fo->Write(&node.backward_source_id, sizeof(node.backward_source_id));
+    fo->Write(attr_keys);
+    fo->Write(attr_values);
+  }
+  fo->Write(arg_nodes);
+  fo->Write(FlattenEntries(heads));
+}
+
+bool StaticGraph::Load(dmlc::Stream *fi) {
+  uint64_t header, reserved;
+  if (fi->Read(&header, sizeof(header)) != sizeof(header)) return false;
+  if (header != kBinaryGraphMagic) return false;
+  if (fi->Read(&reserved, sizeof(reserved)) != sizeof(reserved)) return false;
+  std::vector<std::string> op_types;
+  if (!fi->Read(&op_types)) return false;
+  std::vector<std::vector<std::pair<std::string, std::string> > > op_params(op_types.size());
+  for (size_t k = 0; k < op_types.size(); ++k) {
+    std::vector<std::string> keys, values;
+    if (!fi->Read(&keys) || !fi->Read(&values)) return false;
+    if (keys.size() != values.size()) return false;
+    for (size_t j = 0; j < keys.size(); ++j) {
+      op_params[k].emplace_back(std::move(keys[j]), std::move(values[j]));
+    }
+  }
+  uint64_t num_nodes;
+  if (fi->Read(&num_nodes, sizeof(num_nodes)) != sizeof(num_nodes)) return false;
+  OpCache cache;
+  nodes.clear();
+  nodes.resize(num_nodes);
+  for (Node &node : nodes) {
+    int32_t op_id;
+    std::vector<uint32_t> inputs;
+    std::vector<std::string> attr_keys, attr_values;
+    if (fi->Read(&op_id, sizeof(op_id)) != sizeof(op_id)) return false;
+    if (!fi->Read(&node.name) || !fi->Read(&inputs)) return false;
+    if (!UnflattenEntries(inputs, &node.inputs)) return false;
+    if (fi->Read(&node.backward_source_id, sizeof(node.backward_source_id)) !=
+        sizeof(node.backward_source_id)) return false;
+    if (!fi->Read(&attr_keys) || !fi->Read(&attr_values)) return false;
+    if (attr_keys.size() != attr_values.size()) return false;
+    for (size_t j = 0; j < attr_keys.size(); ++j) {
+      node.attr[attr_keys[j]] = attr_values[j];
+    }
+    if (op_id >= 0) {
+      CHECK_LT(static_cast<size_t>(op_id), op_types.size())
+          << "Invalid operator of node " << node.name;
+      node.InitOp(op_types[op_id], op_params[op_id], &cache);
+    }
+  }
+  std::vector<uint32_t> flat_heads;
+  if (!fi->Read(&arg_nodes) || !fi->Read(&flat_heads)) return false;
+  return UnflattenEntries(flat_heads, &heads);
 }
 }  // namespace mxnet
@@ -9,6 +9,7 @@
 #define MXNET_SYMBOL_STATIC_GRAPH_H_
 
 #include <dmlc/base.h>
+#include <dmlc/io.h>
 #include <dmlc/json.h>
 #include <dmlc/type_traits.h>
 #include <dmlc/parameter.h>
@@ -18,6 +19,9 @@
 #include <utility>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace mxnet {
 /*!
@@ -31,6 +35,12 @@ namespace mxnet {
  */
 class StaticGraph {
  public:
+  /*!
+   * \brief the operators created while loading a graph, by type and parameters.
+   *  The nodes of an unrolled graph share a few of them, the other nodes copy
+   *  the parsed parameters instead of parsing their strings again.
+   */
+  typedef std::unordered_map<std::string, std::unique_ptr<OperatorProperty> > OpCache;
   /*! \brief represents a data in the graph */
   struct DataEntry {
     /*! \brief the source node id in the computation graph */
@@ -181,6 +191,21 @@ class StaticGraph {
      * \param reader the JSON read to read json.
      */
     void Load(dmlc::JSONReader *reader);
+    /*!
+     * \brief interface for json serialization.
+     * \param reader the JSON read to read json.
+     * \param cache the operators already created, nullptr to create the operator
+     */
+    void Load(dmlc::JSONReader *reader, OpCache *cache);
+    /*!
+     * \brief create the operator of the node, copied from the cache when possible.
+     * \param type the type of the operator
+     * \param param the parameters of the operator
+     * \param cache the operators already created, can be nullptr
+     */
+    void InitOp(const std::string &type,
+                const std::vector<std::pair<std::string, std::string> > &param,
+                OpCache *cache);
   };
   /*! \brief all nodes in the graph */
   std::vector<Node> nodes;
@@ -188,6 +213,41 @@ class StaticGraph {
   std::vector<uint32_t> arg_nodes;
   /*! \brief heads outputs of the graph */
   std::vector<DataEntry> heads;
+  /*!
+   * \brief the last call of InferNodeShapes or InferNodeTypes and its results.
+   *  A call with the same topological order and prefilled attributes returns the
+   *  results, a call where only the variables differ re-infers the nodes they reach.
+   */
+  template<typename AttrType>
+  struct InferMemo {
+    /*! \brief the topological order of the call */
+    std::vector<uint32_t> topo_order;
+    /*! \brief the inputs of each node, to detect a changed graph */
+    std::vector<std::vector<DataEntry> > inputs;
+    /*! \brief the backward source of each node, to detect a changed graph */
+    std::vector<int32_t> backward_source_ids;
+    /*! \brief whether the call allowed partial inference */
+    bool partial_infer = false;
+    /*! \brief the prefilled attributes of the call */
+    std::vector<std::vector<AttrType> > in_attrs;
+    /*! \brief the inferred attributes of the outputs */
+    std::vector<std::vector<AttrType> > out_attrs;
+    /*! \brief the inferred attributes of the auxiliary states */
+    std::vector<std::vector<AttrType> > aux_attrs;
+    /*! \brief whether all the outputs are known, required to re-infer part of the graph */
+    bool complete = false;
+  };
+  /*! \brief the inference memos of a graph */
+  struct InferCache {
+    std::mutex mutex;
+    InferMemo<TShape> shape;
+    InferMemo<int> type;
+  };
+  /*!
+   * \brief the inference memos, nullptr disables them. Only set it when the nodes
+   *  and their operators no longer change, copies of the graph share it.
+   */
+  std::shared_ptr<InferCache> infer_cache;
   /*!
    * \brief interface for json serialization.
    * \param writer the JSON writer write json.
@@ -198,6 +258,18 @@ class StaticGraph {
    * \param reader the JSON read to read json.
    */
   void Load(dmlc::JSONReader *reader);
+  /*!
+   * \brief save the graph in the binary format. The distinct operators are saved once
+   *  and the nodes refer to them, loading then parses each of them once.
+   * \param fo the stream to write to.
+   */
+  void Save(dmlc::Stream *fo) const;
+  /*!
+   * \brief load the graph from the binary format.
+   * \param fi the stream to read from.
+   * \return whether the load succeeded, false when the stream is not a binary graph.
+   */
+  bool Load(dmlc::Stream *fi);
   // funtions to help inference in static graph
   /*!
    * \brief Perform a topological sort on the graph
@@ -223,6 +295,8 @@ class StaticGraph {
    * \param node_aux_shapes The shapes of the each auxiliary states of nodes in the graph.
    * \param partial_infer Whether return partially inferred results.
    * \return if the shape inference is successful, return true, else return false.
+   *  When infer_cache is set, the results are memoized: repeated calls return them,
+   *  and calls that only change the shapes of variables re-infer the nodes downstream.
    */
   bool InferNodeShapes(const std::vector<uint32_t> &topo_order,
                        std::vector<std::vector<TShape> > *node_out_shapes,
@@ -230,6 +304,7 @@ class StaticGraph {
                        bool partial_infer = false) const;
   /*!
    * \brief infer the node types in the computation graph.
+   *  Like InferNodeShapes, the results are memoized when infer_cache is set.
    *
    *  When calling this function, user can setup the shape information known into right position.
    *  Unknown shape are indicated by shape.ndim() == 0.
@@ -295,10 +370,114 @@ class StaticGraph {
    * \param head_grad_nodes used to store the created head gradient inputs for backward pass.
    * \param arg_grads used to store gradients to args, can be multiple one if an argument is used by operator
    * \param out_mirror_map The mirror map of the backward plan.
+   * \param mirror_nodes The forward nodes recomputed in backward, as planned by PlanMirror.
+   *  When it is nullptr, they are decided by MXNET_BACKWARD_DO_MIRROR.
+   * \param need_arg_grad Whether each argument needs its gradient, in the order of arg_nodes.
+   *  When given, the backward nodes of the forward nodes that depend on no argument needing
+   *  a gradient are not created, and neither are the gradients of the arguments that do not
+   *  need one, these entries of arg_grads are left undefined.
    */
   void MakeBackwardPass(std::vector<uint32_t> *head_grad_nodes,
                         std::vector<DataEntry> *arg_grads,
-                        std::map<uint32_t, uint32_t>* out_mirror_map);
+                        std::map<uint32_t, uint32_t>* out_mirror_map,
+                        const std::unordered_set<uint32_t>* mirror_nodes = nullptr,
+                        const std::vector<bool>* need_arg_grad = nullptr);
+  /*!
+   * \brief choose the forward nodes to recompute in backward, so that the estimated
+   *  memory of the arguments and the outputs kept for backward fits a budget.
+   *
+   *  Nodes are grouped by their ctx_group, the budget applies to each group.
+   *  Nodes that save the most memory for the least recompute are chosen first,
+   *  the recompute cost is estimated from output size and weight size.
+   *  Must be called before MakeBackwardPass.
+   *
+   * \param arg_shapes The shapes of the arguments, in the order of arg_nodes.
+   * \param mem_budget The memory budget of each group in bytes.
+   * \param mirror_nodes The chosen nodes.
+   */
+  void PlanMirror(const std::vector<TShape>& arg_shapes,
+                  size_t mem_budget,
+                  std::unordered_set<uint32_t>* mirror_nodes) const;
+  /*!
+   * \brief fuse each maximal chain of elementwise nodes into one _FusedElemwise node.
+   *
+   *  A node is fused into a consumer when all its consumers are in the same fused node,
+   *  it is not a head, and it has the same ctx_group. The fused node keeps the name
+   *  of its last node. Nodes are renumbered, so it must be called before MakeBackwardPass.
+   * \return number of nodes removed.
+   */
+  size_t FuseElemwise();
+  /*!
+   * \brief simplify the forward graph before it is planned.
+   *
+   *  The identities, such as a multiplication by one or a Concat of one input, are
+   *  bypassed, and a node with the same op, parameters, attributes and inputs as an
+   *  earlier one is replaced by it, unless it is random, has auxiliary states or is a
+   *  loss. The heads are kept. Then the nodes no head reaches are removed, except the
+   *  arguments. Nodes are renumbered, so it must be called before MakeBackwardPass.
+   * \return number of nodes removed.
+   */
+  size_t Simplify();
+  /*!
+   * \brief group the forward nodes a subgraph backend supports into _Subgraph
+   *  nodes run by the backend, the other nodes are kept as they are.
+   *
+   *  A supported node joins the subgraph of one of its inputs unless another of
+   *  its inputs depends on that subgraph, so that the graph stays acyclic, and
+   *  the nodes of a subgraph have the same ctx_group. The nodes with auxiliary
+   *  states or hidden outputs are not grouped. A subgraph keeps the name of
+   *  its last node. Nodes are renumbered, so it must be called before
+   *  MakeBackwardPass, and the graph is only for inference.
+   * \param backend The name of the registered backend.
+   * \param ctx The context the nodes run on.
+   * \param arg_shapes The shapes of the arguments, in the order of arg_nodes.
+   * \return number of subgraphs.
+   */
+  size_t PartitionSubgraphs(const std::string& backend, const Context& ctx,
+                            const std::vector<TShape>& arg_shapes);
+  /*!
+   * \brief remove nodes only referred to by the removed nodes, and renumber the others.
+   * \param removed Whether each node is removed.
+   */
+  void RemoveNodes(const std::vector<bool>& removed);
+  /*!
+   * \brief compare a call of the inference to its memo.
+   * \param memo The memo of the last call.
+   * \param topo_order The topological order of the call.
+   * \param in_attrs The prefilled attributes of the call.
+   * \param partial_infer Whether the call allows partial inference.
+   * \param dirty Set to the nodes to re-infer, when only variables changed.
+   * \return 0 when the graph must be inferred, 1 when the memo holds the results,
+   *  2 when the dirty nodes must be re-inferred.
+   */
+  template<typename AttrType>
+  int MatchInferMemo(const InferMemo<AttrType> &memo,
+                     const std::vector<uint32_t> &topo_order,
+                     const std::vector<std::vector<AttrType> > &in_attrs,
+                     bool partial_infer,
+                     std::vector<bool> *dirty) const;
+  /*!
+   * \brief run the memoized inference.
+   * \param memo The memo to use and update.
+   * \param infer The inference over a topological order, of signature
+   *  bool(const std::vector<uint32_t>&, out_attrs, aux_attrs).
+   */
+  template<typename AttrType, typename FInfer>
+  bool MemoizedInfer(InferMemo<AttrType> *memo,
+                     const std::vector<uint32_t> &topo_order,
+                     std::vector<std::vector<AttrType> > *node_out_attrs,
+                     std::vector<std::vector<AttrType> > *node_aux_attrs,
+                     bool partial_infer,
+                     FInfer infer) const;
+  /*! \brief InferNodeShapes without the memo */
+  bool InferNodeShapesImpl(const std::vector<uint32_t> &topo_order,
+                           std::vector<std::vector<TShape> > *node_out_shapes,
+                           std::vector<std::vector<TShape> > *node_aux_shapes,
+                           bool partial_infer) const;
+  /*! \brief InferNodeTypes without the memo */
+  bool InferNodeTypesImpl(const std::vector<uint32_t> &topo_order,
+                          std::vector<std::vector<int> > *node_out_types,
+                          std::vector<std::vector<int> > *node_aux_types) const;
   /*!
    * \brief Convert symbol into static graph.
    * \param symbol the symbol to convert from.
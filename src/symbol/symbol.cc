@@ -4,7 +4,12 @@
  * \brief symbol of mxnet
  */
 #include <dmlc/logging.h>
+#include <dmlc/memory_io.h>
+#include <dmlc/parameter.h>
 #include <mxnet/symbolic.h>
+#include <cctype>
+#include <list>
+#include <mutex>
 #include <vector>
 #include <sstream>
 #include <unordered_map>
@@ -617,7 +622,7 @@ bool Symbol::InferShape(std::vector<TShape> *arg_shapes,
                         std::vector<TShape> *aux_shapes,
                         bool partial_infer) const {
   StaticGraph g;
-  this->ToStaticGraph(&g);
+  this->ToCachedStaticGraph(&g);
   return g.InferShape(arg_shapes, out_shapes, aux_shapes, partial_infer);
 }
 
@@ -627,7 +632,7 @@ bool Symbol::InferShape(const std::unordered_map<std::string, TShape>& known_arg
                         std::vector<TShape> *aux_shapes,
                         bool partial_infer) const {
   StaticGraph g;
-  this->ToStaticGraph(&g);
+  this->ToCachedStaticGraph(&g);
   arg_shapes->clear();
   arg_shapes->resize(g.arg_nodes.size(), TShape());
   size_t nmatched = 0;
@@ -654,7 +659,7 @@ bool Symbol::InferType(std::vector<int> *arg_types,
                         std::vector<int> *out_types,
                         std::vector<int> *aux_types) const {
   StaticGraph g;
-  this->ToStaticGraph(&g);
+  this->ToCachedStaticGraph(&g);
   return g.InferType(arg_types, out_types, aux_types);
 }
 
@@ -663,7 +668,7 @@ bool Symbol::InferType(const std::unordered_map<std::string, int>& known_arg_typ
                         std::vector<int> *out_types,
                         std::vector<int> *aux_types) const {
   StaticGraph g;
-  this->ToStaticGraph(&g);
+  this->ToCachedStaticGraph(&g);
   arg_types->clear();
   arg_types->resize(g.arg_nodes.size(), -1);
   size_t nmatched = 0;
@@ -697,6 +702,46 @@ void Symbol::Load(dmlc::JSONReader *reader) {
   this->FromStaticGraph(g);
 }
 
+void Symbol::Save(dmlc::Stream *fo) const {
+  StaticGraph g;
+  this->ToStaticGraph(&g);
+  g.Save(fo);
+}
+
+bool Symbol::Load(dmlc::Stream *fi) {
+  StaticGraph g;
+  if (!g.Load(fi)) return false;
+  this->FromStaticGraph(g);
+  return true;
+}
+
+void Symbol::LoadBuffer(const char *data, size_t size) {
+  // JSON starts with a brace, the binary format with its magic number
+  size_t begin = 0;
+  while (begin < size && std::isspace(static_cast<unsigned char>(data[begin]))) ++begin;
+  if (begin < size && data[begin] == '{') {
+    std::istringstream is(std::string(data + begin, size - begin));
+    dmlc::JSONReader reader(&is);
+    this->Load(&reader);
+  } else {
+    dmlc::MemoryFixedSizeStream fi(const_cast<char*>(data), size);
+    CHECK(this->Load(&fi)) << "Invalid symbol, neither JSON nor the binary format";
+  }
+}
+
+void Symbol::LoadFile(const std::string &fname) {
+  std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(fname.c_str(), "r"));
+  std::string buf;
+  const size_t kChunk = 1 << 20;
+  for (size_t nread = kChunk; nread != 0;) {
+    size_t size = buf.size();
+    buf.resize(size + kChunk);
+    nread = fi->Read(&buf[size], kChunk);
+    buf.resize(size + nread);
+  }
+  this->LoadBuffer(buf.data(), buf.size());
+}
+
 Symbol Symbol::Create(OperatorProperty *op)  {
   // use special representation for atomic symbol
   auto node = std::make_shared<Node>(op, "");
@@ -774,6 +819,48 @@ void Symbol::ToStaticGraph(StaticGraph *out_graph) const {
   }
 }
 
+void Symbol::ToCachedStaticGraph(StaticGraph *out_graph) const {
+  // an entry holds the nodes of its graph, their addresses cannot be reused
+  struct Entry {
+    std::vector<std::shared_ptr<Node> > nodes;
+    std::vector<const void*> signature;
+    std::shared_ptr<StaticGraph::InferCache> cache;
+  };
+  static const size_t kCapacity = dmlc::GetEnv("MXNET_SYMBOL_INFER_CACHE_SIZE", 4);
+  static std::mutex mutex;
+  static std::list<Entry> entries;
+  this->ToStaticGraph(out_graph);
+  if (kCapacity == 0) return;
+  Entry entry;
+  this->DFSVisit([&entry](const std::shared_ptr<Node> &n) {
+      entry.nodes.push_back(n);
+      entry.signature.push_back(n.get());
+      entry.signature.push_back(n->op.get());
+      entry.signature.push_back(n->backward_source_node.get());
+      entry.signature.push_back(reinterpret_cast<const void*>(n->inputs.size()));
+      for (const DataEntry &e : n->inputs) {
+        entry.signature.push_back(e.source.get());
+        entry.signature.push_back(reinterpret_cast<const void*>(static_cast<size_t>(e.index)));
+      }
+    });
+  for (const DataEntry &head : heads_) {
+    entry.signature.push_back(head.source.get());
+    entry.signature.push_back(reinterpret_cast<const void*>(static_cast<size_t>(head.index)));
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (it->signature == entry.signature) {
+      out_graph->infer_cache = it->cache;
+      entries.splice(entries.begin(), entries, it);
+      return;
+    }
+  }
+  entry.cache = std::make_shared<StaticGraph::InferCache>();
+  out_graph->infer_cache = entry.cache;
+  entries.push_front(std::move(entry));
+  if (entries.size() > kCapacity) entries.pop_back();
+}
+
 void Symbol::FromStaticGraph(const StaticGraph &graph) {
   std::unordered_map<uint32_t, std::shared_ptr<Node> > nodes;
   std::vector<uint32_t> topo_order = graph.TopoSort();
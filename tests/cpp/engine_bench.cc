@@ -0,0 +1,210 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file engine_bench.cc
+ * \brief dispatch overhead of the engines, for the engines and numbers of cpu
+ *  workers given on the command line.
+ *
+ *  Usage, the configurations are the product of the engines and the workers
+ *
+ *    tests/cpp/engine_bench --engine ThreadedEnginePerDevice --engine NaiveEngine \
+ *        --workers 1 --workers 4 --ops 100000 --work-us 0 --output engine.json
+ *
+ *  Each configuration measures, with operations spinning --work-us microseconds
+ *    - push_wait_us: the time from the push of an operation to the return of
+ *      WaitForVar on the variable it writes
+ *    - wait_var_us: WaitForVar on a variable with nothing pending
+ *    - chain_ops_per_s: operations all writing the same variable
+ *    - fanout_ops_per_s: operations reading one variable and writing their own
+ *  The workers are MXNET_CPU_WORKER_NTHREADS of the per device engines,
+ *  ThreadedEnginePooled has a fixed pool and NaiveEngine runs on the pushing thread.
+ *  Built by `make tests/cpp/engine_bench`.
+ */
+#include <dmlc/json.h>
+#include <dmlc/logging.h>
+#include <mxnet/engine.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/engine/engine_impl.h"
+
+namespace mxnet {
+namespace bench {
+
+struct Options {
+  std::vector<std::string> engines;
+  std::vector<int> workers;
+  int ops = 100000;
+  int latency_iters = 10000;
+  int fanout_vars = 256;
+  int work_us = 0;
+  std::string output;
+};
+
+/*! \brief timings of one measure, in microseconds */
+struct Timing {
+  double mean = 0, p50 = 0, p90 = 0, p99 = 0;
+
+  inline void Save(dmlc::JSONWriter *writer) const {
+    writer->BeginObject();
+    writer->WriteObjectKeyValue("mean", mean);
+    writer->WriteObjectKeyValue("p50", p50);
+    writer->WriteObjectKeyValue("p90", p90);
+    writer->WriteObjectKeyValue("p99", p99);
+    writer->EndObject();
+  }
+};
+
+inline Timing Summarize(std::vector<double> us) {
+  Timing t;
+  if (us.size() == 0) return t;
+  std::sort(us.begin(), us.end());
+  for (double x : us) t.mean += x;
+  t.mean /= us.size();
+  t.p50 = us[(us.size() - 1) / 2];
+  t.p90 = us[(us.size() - 1) * 9 / 10];
+  t.p99 = us[(us.size() - 1) * 99 / 100];
+  return t;
+}
+
+inline double NowUs() {
+  return std::chrono::duration<double, std::micro>(
+      std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+inline Engine *CreateEngine(const std::string &name) {
+  if (name == "NaiveEngine") return engine::CreateNaiveEngine();
+  if (name == "ThreadedEnginePooled") return engine::CreateThreadedEnginePooled();
+  if (name == "ThreadedEnginePerDevice") return engine::CreateThreadedEnginePerDevice();
+  if (name == "ThreadedEngineWorkStealing") return engine::CreateThreadedEngineWorkStealing();
+  LOG(FATAL) << "unknown engine " << name;
+  return nullptr;
+}
+
+/*! \brief push an operation spinning work_us microseconds */
+inline void PushWork(Engine *engine, int work_us, const std::vector<Engine::VarHandle> &reads,
+                     const std::vector<Engine::VarHandle> &writes) {
+  engine->PushAsync([work_us](RunContext ctx, Engine::CallbackOnComplete cb) {
+      if (work_us > 0) {
+        const double end = NowUs() + work_us;
+        while (NowUs() < end) {}
+      }
+      cb();
+    }, Context::CPU(), reads, writes, FnProperty::kNormal, 0, "BenchWork");
+}
+
+/*! \brief run one configuration, and write its report */
+void Run(const Options &opt, const std::string &name, int workers, dmlc::JSONWriter *writer) {
+  // read by the engines when they are created
+  if (workers > 0) setenv("MXNET_CPU_WORKER_NTHREADS", std::to_string(workers).c_str(), 1);
+  std::unique_ptr<Engine> engine(CreateEngine(name));
+  Engine::VarHandle var = engine->NewVariable();
+  std::vector<Engine::VarHandle> vars;
+  for (int i = 0; i < opt.fanout_vars; ++i) vars.push_back(engine->NewVariable());
+
+  std::vector<double> push_wait, wait_var;
+  for (int i = 0; i < opt.latency_iters; ++i) {
+    double tic = NowUs();
+    PushWork(engine.get(), opt.work_us, {}, {var});
+    engine->WaitForVar(var);
+    double toc = NowUs();
+    engine->WaitForVar(var);
+    push_wait.push_back(toc - tic);
+    wait_var.push_back(NowUs() - toc);
+  }
+
+  double tic = NowUs();
+  for (int i = 0; i < opt.ops; ++i) PushWork(engine.get(), opt.work_us, {}, {var});
+  engine->WaitForAll();
+  const double chain = opt.ops / ((NowUs() - tic) * 1e-6);
+
+  tic = NowUs();
+  for (int i = 0; i < opt.ops; ++i) {
+    PushWork(engine.get(), opt.work_us, {var}, {vars[i % vars.size()]});
+  }
+  engine->WaitForAll();
+  const double fanout = opt.ops / ((NowUs() - tic) * 1e-6);
+
+  engine->DeleteVariable([](RunContext) {}, Context::CPU(), var);
+  for (Engine::VarHandle v : vars) engine->DeleteVariable([](RunContext) {}, Context::CPU(), v);
+  engine->WaitForAll();
+
+  Timing push_wait_us = Summarize(push_wait), wait_var_us = Summarize(wait_var);
+  std::cout << name << " workers=" << workers << ": push-wait " << push_wait_us.p50
+            << " us, wait " << wait_var_us.p50 << " us (p50), chain " << chain
+            << " ops/s, fanout " << fanout << " ops/s" << std::endl;
+  writer->BeginObject();
+  writer->WriteObjectKeyValue("engine", name);
+  writer->WriteObjectKeyValue("workers", workers);
+  writer->WriteObjectKeyValue("work_us", opt.work_us);
+  writer->WriteObjectKeyValue("ops", opt.ops);
+  writer->WriteObjectKeyValue("push_wait_us", push_wait_us);
+  writer->WriteObjectKeyValue("wait_var_us", wait_var_us);
+  writer->WriteObjectKeyValue("chain_ops_per_s", chain);
+  writer->WriteObjectKeyValue("fanout_ops_per_s", fanout);
+  writer->EndObject();
+}
+
+inline Options ParseArgs(int argc, char *argv[]) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string key = argv[i], value = argv[i + 1];
+    if (key == "--engine") {
+      opt.engines.push_back(value);
+    } else if (key == "--workers") {
+      opt.workers.push_back(std::atoi(value.c_str()));
+    } else if (key == "--ops") {
+      opt.ops = std::atoi(value.c_str());
+    } else if (key == "--latency-iters") {
+      opt.latency_iters = std::atoi(value.c_str());
+    } else if (key == "--fanout-vars") {
+      opt.fanout_vars = std::atoi(value.c_str());
+    } else if (key == "--work-us") {
+      opt.work_us = std::atoi(value.c_str());
+    } else if (key == "--output") {
+      opt.output = value;
+    } else {
+      LOG(FATAL) << "unknown option " << key << ", usage: " << argv[0]
+                 << " [--engine name] [--workers n] [--ops 100000] [--latency-iters 10000]"
+                 << " [--fanout-vars 256] [--work-us 0] [--output report.json]";
+    }
+  }
+  CHECK_GT(opt.fanout_vars, 0);
+  if (opt.engines.size() == 0) {
+    opt.engines = {"NaiveEngine", "ThreadedEnginePooled", "ThreadedEnginePerDevice",
+                   "ThreadedEngineWorkStealing"};
+  }
+  if (opt.workers.size() == 0) opt.workers = {1, 2, 4, 8};
+  return opt;
+}
+}  // namespace bench
+}  // namespace mxnet
+
+int main(int argc, char *argv[]) {
+  using namespace mxnet::bench;
+  Options opt = ParseArgs(argc, argv);
+  std::ostringstream os;
+  dmlc::JSONWriter writer(&os);
+  writer.BeginArray();
+  for (const std::string &engine : opt.engines) {
+    // the workers only size the per device engines
+    const bool sized = engine == "ThreadedEnginePerDevice" ||
+        engine == "ThreadedEngineWorkStealing";
+    for (size_t i = 0; i < (sized ? opt.workers.size() : 1); ++i) {
+      writer.WriteArraySeperator();
+      Run(opt, engine, sized ? opt.workers[i] : 0, &writer);
+    }
+  }
+  writer.EndArray();
+  if (opt.output.length() != 0) {
+    std::ofstream fo(opt.output.c_str());
+    fo << os.str() << std::endl;
+  }
+  return 0;
+}
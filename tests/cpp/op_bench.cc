@@ -0,0 +1,319 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file op_bench.cc
+ * \brief forward and backward throughput of an operator, for the shapes,
+ *  data types and contexts given on the command line.
+ *
+ *  Usage, the configurations are the product of the shapes, dtypes and ctxs
+ *
+ *    tests/cpp/op_bench --op Convolution --param kernel=(3,3) --param num_filter=64 \
+ *        --shape "(32,3,224,224)" --shape "(64,3,224,224)" --ctx cpu --ctx gpu(0) \
+ *        --dtype float32 --warmup 5 --iters 20 --output conv.json
+ *
+ *  A shape gives the shapes of the leading arguments separated by ';', the
+ *  others are inferred. The report has one json object per configuration.
+ *  Built by `make tests/cpp/op_bench`.
+ */
+#include <dmlc/json.h>
+#include <dmlc/logging.h>
+#include <mxnet/engine.h>
+#include <mxnet/ndarray.h>
+#include <mxnet/operator.h>
+#include <mxnet/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace bench {
+
+struct Options {
+  std::string op;
+  std::vector<std::pair<std::string, std::string> > params;
+  std::vector<std::string> shapes;
+  std::vector<std::string> ctxs;
+  std::vector<std::string> dtypes;
+  int warmup = 5;
+  int iters = 20;
+  bool backward = true;
+  std::string output;
+};
+
+/*! \brief timings of one configuration, in milliseconds */
+struct Timing {
+  double mean = 0, p50 = 0, p90 = 0, min = 0;
+
+  inline void Save(dmlc::JSONWriter *writer) const {
+    writer->BeginObject();
+    writer->WriteObjectKeyValue("mean", mean);
+    writer->WriteObjectKeyValue("p50", p50);
+    writer->WriteObjectKeyValue("p90", p90);
+    writer->WriteObjectKeyValue("min", min);
+    writer->EndObject();
+  }
+};
+
+inline Timing Summarize(std::vector<double> ms) {
+  Timing t;
+  if (ms.size() == 0) return t;
+  std::sort(ms.begin(), ms.end());
+  for (double x : ms) t.mean += x;
+  t.mean /= ms.size();
+  t.p50 = ms[(ms.size() - 1) / 2];
+  t.p90 = ms[(ms.size() - 1) * 9 / 10];
+  t.min = ms[0];
+  return t;
+}
+
+inline TShape ParseShape(std::string str) {
+  std::vector<index_t> dims;
+  for (char &c : str) {
+    if (c == '(' || c == ')' || c == ',') c = ' ';
+  }
+  std::istringstream is(str);
+  index_t d;
+  while (is >> d) dims.push_back(d);
+  return TShape(dims.begin(), dims.end());
+}
+
+inline std::vector<TShape> ParseShapes(const std::string &str) {
+  std::vector<TShape> ret;
+  std::istringstream is(str);
+  std::string item;
+  while (std::getline(is, item, ';')) ret.push_back(ParseShape(item));
+  return ret;
+}
+
+inline Context ParseContext(const std::string &str) {
+  const int dev_id = str.size() > 3 ? std::atoi(str.c_str() + 3 + (str[3] == '(')) : 0;
+  if (str.compare(0, 3, "gpu") == 0) return Context::GPU(dev_id);
+  CHECK_EQ(str.compare(0, 3, "cpu"), 0) << "unknown context " << str;
+  return Context::CPU(dev_id);
+}
+
+inline int ParseDType(const std::string &str) {
+  static const std::map<std::string, int> kTypes = {
+    {"float32", mshadow::kFloat32}, {"float64", mshadow::kFloat64},
+    {"float16", mshadow::kFloat16}, {"uint8", mshadow::kUint8},
+    {"int32", mshadow::kInt32}};
+  auto it = kTypes.find(str);
+  CHECK(it != kTypes.end()) << "unknown dtype " << str;
+  return it->second;
+}
+
+inline double NowMs() {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+inline std::vector<TBlob> Blobs(const std::vector<NDArray> &arrs) {
+  std::vector<TBlob> ret;
+  for (const NDArray &a : arrs) ret.push_back(a.data());
+  return ret;
+}
+
+inline std::vector<Engine::VarHandle> Vars(const std::vector<NDArray> &arrs) {
+  std::vector<Engine::VarHandle> ret;
+  for (const NDArray &a : arrs) ret.push_back(a.var());
+  return ret;
+}
+
+inline std::vector<NDArray> Alloc(const std::vector<TShape> &shapes,
+                                  const std::vector<int> &types, Context ctx, bool fill) {
+  std::vector<NDArray> ret;
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    ret.emplace_back(shapes[i], ctx, false, types[i]);
+    if (fill && types[i] == mshadow::kFloat32) {
+      SampleUniform(-1.0f, 1.0f, &ret.back());
+    } else {
+      ret.back() = fill ? 0.5f : 0.0f;
+    }
+  }
+  return ret;
+}
+
+/*! \brief run one configuration, and write its report */
+void Run(const Options &opt, const std::string &shape_str, const std::string &ctx_str,
+         const std::string &dtype_str, dmlc::JSONWriter *writer) {
+  const Context ctx = ParseContext(ctx_str);
+  std::unique_ptr<OperatorProperty> prop(OperatorProperty::Create(opt.op.c_str()));
+  CHECK(prop != nullptr) << "unknown operator " << opt.op;
+  prop->Init(opt.params);
+  std::vector<TShape> in_shape = ParseShapes(shape_str), out_shape, aux_shape;
+  in_shape.resize(prop->ListArguments().size());
+  CHECK(prop->InferShape(&in_shape, &out_shape, &aux_shape))
+      << "cannot infer the shapes of " << opt.op << " from " << shape_str;
+  std::vector<int> in_type(in_shape.size(), -1), out_type, aux_type;
+  in_type[0] = ParseDType(dtype_str);
+  CHECK(prop->InferType(&in_type, &out_type, &aux_type))
+      << "cannot infer the types of " << opt.op;
+  std::shared_ptr<Operator> op(prop->CreateOperatorEx(ctx, &in_shape, &in_type));
+
+  std::vector<NDArray> in_data = Alloc(in_shape, in_type, ctx, true);
+  std::vector<NDArray> out_data = Alloc(out_shape, out_type, ctx, false);
+  std::vector<NDArray> aux = Alloc(aux_shape, aux_type, ctx, true);
+  std::vector<NDArray> in_grad = Alloc(in_shape, in_type, ctx, false);
+  std::vector<TShape> grad_shape(out_shape.begin(), out_shape.begin() + prop->NumVisibleOutputs());
+  std::vector<int> grad_type(out_type.begin(), out_type.begin() + prop->NumVisibleOutputs());
+  std::vector<NDArray> out_grad = Alloc(grad_shape, grad_type, ctx, true);
+
+  std::vector<Resource> fwd_res, bwd_res;
+  for (const ResourceRequest &req : prop->ForwardResource(in_shape)) {
+    fwd_res.push_back(ResourceManager::Get()->Request(ctx, req));
+  }
+  for (const ResourceRequest &req : prop->BackwardResource(in_shape)) {
+    bwd_res.push_back(ResourceManager::Get()->Request(ctx, req));
+  }
+  std::vector<Engine::VarHandle> fwd_read = Vars(in_data), fwd_write = Vars(out_data);
+  std::vector<Engine::VarHandle> aux_vars = Vars(aux);
+  fwd_write.insert(fwd_write.end(), aux_vars.begin(), aux_vars.end());
+  for (const Resource &r : fwd_res) fwd_write.push_back(r.var);
+  std::vector<Engine::VarHandle> bwd_read = Vars(out_grad), bwd_write = Vars(in_grad);
+  std::vector<Engine::VarHandle> data_vars = Vars(in_data), out_vars = Vars(out_data);
+  bwd_read.insert(bwd_read.end(), data_vars.begin(), data_vars.end());
+  bwd_read.insert(bwd_read.end(), out_vars.begin(), out_vars.end());
+  bwd_write.insert(bwd_write.end(), aux_vars.begin(), aux_vars.end());
+  for (const Resource &r : bwd_res) bwd_write.push_back(r.var);
+  // several requests can share a resource
+  for (std::vector<Engine::VarHandle> *vars : {&fwd_write, &bwd_write}) {
+    std::sort(vars->begin(), vars->end());
+    vars->erase(std::unique(vars->begin(), vars->end()), vars->end());
+  }
+
+  const bool is_gpu = ctx.dev_mask() == gpu::kDevMask;
+  auto forward = [&]() {
+    Engine::Get()->PushSync([op, in_data, out_data, aux, fwd_res, is_gpu](RunContext rctx) {
+        OpContext octx;
+        octx.is_train = true;
+        octx.run_ctx = rctx;
+        octx.requested = fwd_res;
+        std::vector<OpReqType> req(out_data.size(), kWriteTo);
+        op->Forward(octx, Blobs(in_data), req, Blobs(out_data), Blobs(aux));
+#if MXNET_USE_CUDA
+        if (is_gpu) rctx.get_stream<gpu>()->Wait();
+#endif
+      }, ctx, fwd_read, fwd_write, FnProperty::kNormal, 0, "BenchForward");
+  };
+  auto backward = [&]() {
+    Engine::Get()->PushSync([op, in_data, out_data, aux, in_grad, out_grad, bwd_res, is_gpu](
+        RunContext rctx) {
+        OpContext octx;
+        octx.is_train = true;
+        octx.run_ctx = rctx;
+        octx.requested = bwd_res;
+        std::vector<OpReqType> req(in_grad.size(), kWriteTo);
+        op->Backward(octx, Blobs(out_grad), Blobs(in_data), Blobs(out_data), req,
+                     Blobs(in_grad), Blobs(aux));
+#if MXNET_USE_CUDA
+        if (is_gpu) rctx.get_stream<gpu>()->Wait();
+#endif
+      }, ctx, bwd_read, bwd_write, FnProperty::kNormal, 0, "BenchBackward");
+  };
+
+  std::vector<double> fwd_ms, bwd_ms;
+  for (int i = 0; i < opt.warmup + opt.iters; ++i) {
+    Engine::Get()->WaitForAll();
+    double tic = NowMs();
+    forward();
+    Engine::Get()->WaitForAll();
+    double toc = NowMs();
+    if (i >= opt.warmup) fwd_ms.push_back(toc - tic);
+    if (!opt.backward) continue;
+    backward();
+    Engine::Get()->WaitForAll();
+    if (i >= opt.warmup) bwd_ms.push_back(NowMs() - toc);
+  }
+  Timing fwd = Summarize(fwd_ms), bwd = Summarize(bwd_ms);
+  std::cout << opt.op << " " << shape_str << " " << ctx_str << " " << dtype_str
+            << ": forward " << fwd.p50 << " ms";
+  if (opt.backward) std::cout << ", backward " << bwd.p50 << " ms";
+  std::cout << " (p50 of " << opt.iters << ")" << std::endl;
+
+  std::map<std::string, std::string> params(opt.params.begin(), opt.params.end());
+  writer->BeginObject();
+  writer->WriteObjectKeyValue("op", opt.op);
+  writer->WriteObjectKeyValue("params", params);
+  writer->WriteObjectKeyValue("shape", shape_str);
+  writer->WriteObjectKeyValue("ctx", ctx_str);
+  writer->WriteObjectKeyValue("dtype", dtype_str);
+  writer->WriteObjectKeyValue("warmup", opt.warmup);
+  writer->WriteObjectKeyValue("iters", opt.iters);
+  writer->WriteObjectKeyValue("forward_ms", fwd);
+  if (opt.backward) writer->WriteObjectKeyValue("backward_ms", bwd);
+  writer->EndObject();
+}
+
+inline Options ParseArgs(int argc, char *argv[]) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string key = argv[i], value = argv[i + 1];
+    if (key == "--op") {
+      opt.op = value;
+    } else if (key == "--param") {
+      size_t pos = value.find('=');
+      CHECK_NE(pos, std::string::npos) << "--param expects key=value, got " << value;
+      opt.params.emplace_back(value.substr(0, pos), value.substr(pos + 1));
+    } else if (key == "--shape") {
+      opt.shapes.push_back(value);
+    } else if (key == "--ctx") {
+      opt.ctxs.push_back(value);
+    } else if (key == "--dtype") {
+      opt.dtypes.push_back(value);
+    } else if (key == "--warmup") {
+      opt.warmup = std::atoi(value.c_str());
+    } else if (key == "--iters") {
+      opt.iters = std::atoi(value.c_str());
+    } else if (key == "--backward") {
+      opt.backward = std::atoi(value.c_str()) != 0;
+    } else if (key == "--output") {
+      opt.output = value;
+    } else {
+      LOG(FATAL) << "unknown option " << key;
+    }
+  }
+  CHECK(opt.op.length() != 0 && opt.shapes.size() != 0)
+      << "usage: " << argv[0] << " --op name --shape (d0,d1,..)[;(..)] [--param key=value]"
+      << " [--ctx cpu|gpu(i)] [--dtype float32] [--warmup 5] [--iters 20] [--backward 1]"
+      << " [--output report.json]";
+  if (opt.ctxs.size() == 0) opt.ctxs.push_back("cpu");
+  if (opt.dtypes.size() == 0) opt.dtypes.push_back("float32");
+  return opt;
+}
+}  // namespace bench
+}  // namespace mxnet
+
+int main(int argc, char *argv[]) {
+  using namespace mxnet::bench;
+  Options opt = ParseArgs(argc, argv);
+  std::ostringstream os;
+  dmlc::JSONWriter writer(&os);
+  writer.BeginArray();
+  for (const std::string &shape : opt.shapes) {
+    for (const std::string &ctx : opt.ctxs) {
+#if !MXNET_USE_CUDA
+      if (ctx.compare(0, 3, "gpu") == 0) {
+        LOG(WARNING) << "skip " << ctx << ", mxnet is built without cuda";
+        continue;
+      }
+#endif
+      for (const std::string &dtype : opt.dtypes) {
+        writer.WriteArraySeperator();
+        Run(opt, shape, ctx, dtype, &writer);
+      }
+    }
+  }
+  writer.EndArray();
+  if (opt.output.length() != 0) {
+    std::ofstream fo(opt.output.c_str());
+    fo << os.str() << std::endl;
+  }
+  return 0;
+}
@@ -1,7 +1,12 @@
 #include <cstdio>
+#include <vector>
 #include <gtest/gtest.h>
 #include <dmlc/logging.h>
 #include <mxnet/storage.h>
+#include "../src/storage/arena_storage_manager.h"
+#include "../src/storage/bucketed_storage_manager.h"
+#include "../src/storage/cpu_device_storage.h"
+#include "../src/storage/pinned_storage_manager.h"
 
 TEST(Storage, Basic_CPU) {
   constexpr size_t kSize = 1024;
@@ -33,4 +38,130 @@ TEST(Storage, Basic_GPU) {
   EXPECT_EQ(handle.size, kSize);
   EXPECT_EQ(handle.dptr, ptr);
 }
+
+TEST(Storage, Pinned) {
+  using namespace mxnet::storage;
+  PinnedStorageManager manager(1 << 20);
+  size_t used, cached, wasted;
+  // requests of the same size class reuse the block
+  void* ptr = manager.Alloc(3000);
+  manager.Free(ptr, 3000);
+  EXPECT_EQ(manager.Alloc(4000), ptr);
+  manager.GetStats(&used, &cached, &wasted);
+  EXPECT_EQ(used, 4000U);
+  EXPECT_EQ(wasted, 96U);
+  EXPECT_EQ(cached, 0U);
+  // blocks freed over the high-water mark are unpinned
+  void* big = manager.Alloc(2 << 20);
+  manager.Free(ptr, 4000);
+  manager.Free(big, 2 << 20);
+  manager.GetStats(&used, &cached, &wasted);
+  EXPECT_EQ(used, 0U);
+  EXPECT_EQ(cached, 4096U);
+}
+
+TEST(Storage, RegisterHostMemory) {
+  constexpr size_t kSize = 1 << 20;
+  std::vector<float> host(kSize, 1.0f);
+  mxnet::Context context_gpu = mxnet::Context::GPU(0);
+  auto&& storage = mxnet::Storage::Get();
+  storage->RegisterHostMemory(host.data(), kSize * sizeof(float));
+  auto&& handle = storage->Alloc(kSize * sizeof(float), context_gpu);
+  CUDA_CALL(cudaMemcpyAsync(handle.dptr, host.data(), kSize * sizeof(float),
+                            cudaMemcpyHostToDevice, 0));
+  CUDA_CALL(cudaStreamSynchronize(0));
+  storage->Free(handle);
+  storage->UnregisterHostMemory(host.data());
+}
 #endif  // MXNET_USE_CUDA
+
+TEST(Storage, Bucketed_CPU) {
+  using namespace mxnet::storage;
+  constexpr size_t kLarge = 1 << 19;
+  BucketedStorageManager<CPUDeviceStorage> manager(2.0, kLarge);
+  size_t used, cached, wasted;
+  // blocks of close size share the same size class
+  void* ptr = manager.Alloc(1000);
+  manager.Free(ptr, 1000);
+  EXPECT_EQ(manager.Alloc(900), ptr);
+  manager.GetStats(&used, &cached, &wasted);
+  EXPECT_EQ(used, 900U);
+  EXPECT_EQ(wasted, 1024U - 900U);
+  manager.Free(ptr, 900);
+  // large blocks are split and coalesced
+  void* a = manager.Alloc(2 * kLarge);
+  void* b = manager.Alloc(kLarge);
+  EXPECT_EQ(static_cast<char*>(b), static_cast<char*>(a) + 2 * kLarge);
+  manager.Free(a, 2 * kLarge);
+  manager.Free(b, kLarge);
+  EXPECT_EQ(manager.Alloc(3 * kLarge), a);
+  manager.Free(a, 3 * kLarge);
+  manager.GetStats(&used, &cached, &wasted);
+  EXPECT_EQ(used, 0U);
+  EXPECT_EQ(wasted, 0U);
+}
+
+TEST(Storage, Arena_CPU) {
+  using namespace mxnet::storage;
+  constexpr size_t kCapacity = 1 << 20;
+  ArenaStorageManager<CPUDeviceStorage> manager(kCapacity);
+  size_t capacity, free, largest_free, overflow;
+  // blocks are carved from the start of the arena
+  void* a = manager.Alloc(1000);
+  void* b = manager.Alloc(4096);
+  EXPECT_EQ(static_cast<char*>(b), static_cast<char*>(a) + 1024);
+  // a hole between used blocks fragments the arena
+  manager.Free(a, 1000);
+  manager.GetArenaStats(&capacity, &free, &largest_free, &overflow);
+  EXPECT_EQ(capacity, kCapacity);
+  EXPECT_EQ(free, kCapacity - 4096);
+  EXPECT_EQ(largest_free, kCapacity - 4096 - 1024);
+  // best fit reuses the hole
+  EXPECT_EQ(manager.Alloc(512), a);
+  manager.Free(a, 512);
+  manager.Free(b, 4096);
+  manager.GetArenaStats(&capacity, &free, &largest_free, &overflow);
+  EXPECT_EQ(largest_free, kCapacity);
+  // requests bigger than the arena go to the device
+  void* big = manager.Alloc(2 * kCapacity);
+  manager.GetArenaStats(&capacity, &free, &largest_free, &overflow);
+  EXPECT_EQ(overflow, 2 * kCapacity);
+  manager.Free(big, 2 * kCapacity);
+  manager.GetArenaStats(&capacity, &free, &largest_free, &overflow);
+  EXPECT_EQ(overflow, 0U);
+}
+
+TEST(Storage, OriginQuota) {
+  using mxnet::Storage;
+  auto&& storage = Storage::Get();
+  mxnet::Context context_cpu{};
+  storage->SetOriginQuota("quota_test", 64 << 10);
+  {
+    Storage::AllocOriginScope scope("quota_test");
+    auto&& a = storage->Alloc(48 << 10, context_cpu);
+    EXPECT_THROW(storage->Alloc(32 << 10, context_cpu), dmlc::Error);
+    storage->Free(a);
+    // the freed bytes are available again
+    auto&& b = storage->Alloc(32 << 10, context_cpu);
+    storage->Free(b);
+  }
+  // the other origins are not limited
+  auto&& c = storage->Alloc(128 << 10, context_cpu);
+  storage->Free(c);
+  storage->SetOriginQuota("quota_test", 0);
+}
+
+TEST(Storage, AllocOrigin) {
+  using mxnet::Storage;
+  EXPECT_EQ(Storage::GetAllocOrigin(), nullptr);
+  {
+    Storage::AllocOriginScope outer("weights");
+    EXPECT_STREQ(Storage::GetAllocOrigin(), "weights");
+    {
+      Storage::AllocOriginScope inner("workspace");
+      EXPECT_STREQ(Storage::GetAllocOrigin(), "workspace");
+    }
+    EXPECT_STREQ(Storage::GetAllocOrigin(), "weights");
+  }
+  EXPECT_EQ(Storage::GetAllocOrigin(), nullptr);
+}
@@ -5,6 +5,9 @@
 #include <gtest/gtest.h>
 #include <thread>
 #include <chrono>
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <mxnet/engine.h>
@@ -96,7 +99,7 @@ double EvaluateWorloads(const std::vector<Workload>& workloads,
 TEST(Engine, RandSumExpr) {
   std::vector<Workload> workloads;
   int num_repeat = 5;
-  const int num_engine = 4;
+  const int num_engine = 6;
 
   std::vector<double> t(num_engine, 0.0);
   std::vector<mxnet::Engine*> engine(num_engine);
@@ -105,6 +108,8 @@ TEST(Engine, RandSumExpr) {
   engine[1] = mxnet::engine::CreateNaiveEngine();
   engine[2] = mxnet::engine::CreateThreadedEnginePooled();
   engine[3] = mxnet::engine::CreateThreadedEnginePerDevice();
+  engine[4] = mxnet::engine::CreateThreadedEngineWorkStealing();
+  engine[5] = mxnet::engine::CreateInlineEngine();
 
   for (int repeat = 0; repeat < num_repeat; ++repeat) {
     srand(time(NULL) + repeat);
@@ -127,6 +132,8 @@ TEST(Engine, RandSumExpr) {
   LOG(INFO) << "NaiveEngine\t\t"  << t[1] << " sec";
   LOG(INFO) << "ThreadedEnginePooled\t" << t[2] << " sec";
   LOG(INFO) << "ThreadedEnginePerDevice\t" << t[3] << " sec";
+  LOG(INFO) << "ThreadedEngineWorkStealing\t" << t[4] << " sec";
+  LOG(INFO) << "InlineEngine\t\t" << t[5] << " sec";
 }
 
 void Foo(mxnet::RunContext, int i) { printf("The fox says %d\n", i); }
@@ -229,3 +236,122 @@ TEST(Engine, basics) {
   oprs.clear();
   LOG(INFO) << "All pass";
 }
+
+TEST(Engine, BulkSync) {
+  mxnet::Engine* engine = mxnet::engine::CreateThreadedEnginePerDevice();
+  EXPECT_EQ(engine->set_bulk_size(16), 0);
+  auto a = engine->NewVariable();
+  auto b = engine->NewVariable();
+  double da = 0, db = 0;
+  for (int i = 0; i < 100; ++i) {
+    engine->PushSync([&da](mxnet::RunContext) { da = da * 2 + 1; },
+                     mxnet::Context::CPU(), {}, {a});
+    // reads a and writes b inside the same bulk
+    engine->PushSync([&da, &db](mxnet::RunContext) { db = db * 0.5 + da; },
+                     mxnet::Context::CPU(), {a}, {b});
+  }
+  engine->WaitForVar(b);
+  double ea = 0, eb = 0;
+  for (int i = 0; i < 100; ++i) {
+    ea = ea * 2 + 1;
+    eb = eb * 0.5 + ea;
+  }
+  EXPECT_EQ(da, ea);
+  EXPECT_EQ(db, eb);
+  EXPECT_EQ(engine->set_bulk_size(0), 16);
+  engine->DeleteVariable([](mxnet::RunContext) {}, mxnet::Context::CPU(), a);
+  engine->DeleteVariable([](mxnet::RunContext) {}, mxnet::Context::CPU(), b);
+  engine->WaitForAll();
+  delete engine;
+}
+
+TEST(Engine, CaptureReplay) {
+  mxnet::Engine* engine = mxnet::engine::CreateThreadedEnginePerDevice();
+  auto a = engine->NewVariable();
+  auto b = engine->NewVariable();
+  double da = 0, db = 0;
+  engine->BeginCapture();
+  for (int i = 0; i < 10; ++i) {
+    engine->PushSync([&da](mxnet::RunContext) { da = da * 2 + 1; },
+                     mxnet::Context::CPU(), {}, {a});
+    engine->PushSync([&da, &db](mxnet::RunContext) { db = db * 0.5 + da; },
+                     mxnet::Context::CPU(), {a}, {b});
+  }
+  auto graph = engine->EndCapture();
+  // nothing is executed by the capture
+  engine->WaitForAll();
+  EXPECT_EQ(da, 0);
+  EXPECT_EQ(db, 0);
+  for (int i = 0; i < 5; ++i) {
+    engine->PushGraph(graph);
+    // ordered with the other operations on the same variables
+    engine->PushSync([&db](mxnet::RunContext) { db = -db; },
+                     mxnet::Context::CPU(), {}, {b});
+  }
+  engine->WaitForVar(b);
+  double ea = 0, eb = 0;
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 10; ++j) {
+      ea = ea * 2 + 1;
+      eb = eb * 0.5 + ea;
+    }
+    eb = -eb;
+  }
+  EXPECT_EQ(da, ea);
+  EXPECT_EQ(db, eb);
+  engine->DeleteGraph(graph);
+  engine->DeleteVariable([](mxnet::RunContext) {}, mxnet::Context::CPU(), a);
+  engine->DeleteVariable([](mxnet::RunContext) {}, mxnet::Context::CPU(), b);
+  engine->WaitForAll();
+  delete engine;
+}
+
+TEST(Engine, Stats) {
+  mxnet::Engine* engine = mxnet::engine::CreateThreadedEnginePerDevice();
+  auto a = engine->NewVariable();
+  for (int i = 0; i < 10; ++i) {
+    engine->PushSync([](mxnet::RunContext) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }, mxnet::Context::CPU(), {}, {a});
+  }
+  engine->WaitForAll();
+  std::vector<std::pair<std::string, uint64_t> > stats;
+  engine->GetStats(&stats);
+  std::map<std::string, uint64_t> values(stats.begin(), stats.end());
+  EXPECT_EQ(values["pushed"], 10);
+  EXPECT_EQ(values["completed"], 10);
+  EXPECT_EQ(values["pending"], 0);
+  // the writes of a wait for each other
+  EXPECT_GE(values["dep_blocked"], 1);
+  EXPECT_EQ(values["cpu(0)/normal/queued"], 10);
+  // the worker may still be accounting the last operation
+  EXPECT_GE(values["cpu(0)/normal/busy_us"], 9000);
+  EXPECT_EQ(values["host_waits"], 1);
+  engine->DeleteVariable([](mxnet::RunContext) {}, mxnet::Context::CPU(), a);
+  engine->WaitForAll();
+  delete engine;
+}
+
+TEST(Engine, SpinWait) {
+  setenv("MXNET_ENGINE_WAIT_SPIN_US", "100000", 1);
+  mxnet::Engine* engine = mxnet::engine::CreateThreadedEnginePerDevice();
+  unsetenv("MXNET_ENGINE_WAIT_SPIN_US");
+  auto a = engine->NewVariable();
+  int value = 0;
+  for (int i = 0; i < 10; ++i) {
+    engine->PushSync([&value](mxnet::RunContext) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        ++value;
+      }, mxnet::Context::CPU(), {}, {a});
+    engine->WaitForVar(a);
+    EXPECT_EQ(value, i + 1);
+  }
+  std::vector<std::pair<std::string, uint64_t> > stats;
+  engine->GetStats(&stats);
+  std::map<std::string, uint64_t> values(stats.begin(), stats.end());
+  EXPECT_EQ(values["host_waits"], 10);
+  EXPECT_EQ(values["host_wait_spun"], 10);
+  engine->DeleteVariable([](mxnet::RunContext) {}, mxnet::Context::CPU(), a);
+  engine->WaitForAll();
+  delete engine;
+}
@@ -9,3 +9,13 @@ tests/cpp/% : tests/cpp/%.cc lib/libmxnet.a
 	$(CXX) -std=c++0x $(CFLAGS) -I$(GTEST_INC) -o $@ $(filter %.cc %.a, $^) $(LDFLAGS) -L$(GTEST_LIB) -lgtest -lgtest_main
 
 -include tests/cpp/*.d
+
+# the operator benchmark, which does not use gtest
+tests/cpp/op_bench : tests/cpp/op_bench.cc lib/libmxnet.a
+	$(CXX) -std=c++0x $(CFLAGS) -MM -MT tests/cpp/op_bench $< >tests/cpp/op_bench.d
+	$(CXX) -std=c++0x $(CFLAGS) -o $@ $(filter %.cc %.a, $^) $(LDFLAGS)
+
+# the engine dispatch benchmark, which does not use gtest
+tests/cpp/engine_bench : tests/cpp/engine_bench.cc lib/libmxnet.a
+	$(CXX) -std=c++0x $(CFLAGS) -MM -MT tests/cpp/engine_bench $< >tests/cpp/engine_bench.d
+	$(CXX) -std=c++0x $(CFLAGS) -o $@ $(filter %.cc %.a, $^) $(LDFLAGS)
@@ -0,0 +1,281 @@
+#!/usr/bin/env python
+"""
+Benchmark the training throughput of standard networks.
+
+Every configuration trains a network with a Module for some iterations, with
+the forward, backward and update of each step waited for. It reports the
+samples per second of all the workers, the percentiles of the step time and the
+peak memory of the devices, the bytes used by the arrays and held by the memory
+pool, as one json per configuration.
+
+Examples
+
+    python tests/nightly/benchmark.py --networks resnet,inception-bn --gpus 1,2,4,8
+    python tests/nightly/benchmark.py --networks inception-bn --data real \\
+        --data-train data/imagenet/train.rec --gpus 4 --kv-stores device,dist_sync
+
+The distributed modes are run by tools/launch.py with the local launcher.
+
+Regression gating: --save-baseline stores the results, and --baseline compares
+the results to stored ones, exiting with status 1 if the throughput dropped, or
+the median step time or the memory grew, by more than --tolerance.
+"""
+from __future__ import print_function
+import argparse
+import importlib
+import itertools
+import json
+import os
+import subprocess
+import sys
+import time
+
+curr_path = os.path.abspath(os.path.dirname(__file__))
+sys.path.insert(0, os.path.join(curr_path, "../../python"))
+sys.path.insert(0, os.path.join(curr_path, "../../example/image-classification"))
+
+RESULT = 'TRAIN_BENCH '
+
+# the image shape and the number of classes of the image networks
+IMAGE_NETWORKS = {
+    'resnet': ((3, 32, 32), 10),
+    'inception-bn': ((3, 224, 224), 1000),
+    'inception-v3': ((3, 299, 299), 1000),
+    'vgg': ((3, 224, 224), 1000),
+    'alexnet': ((3, 224, 224), 1000),
+}
+
+def int_list(s):
+    return [int(x) for x in s.split(',') if x != '']
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Benchmark the training throughput')
+    parser.add_argument('--networks', type=str, default='resnet,inception-bn,vgg,lstm',
+                        help='the networks, of ' + ', '.join(sorted(IMAGE_NETWORKS)) +
+                        ' and lstm, a language model')
+    parser.add_argument('--data', type=str, default='synthetic',
+                        help='synthetic, real or both, the image networks read real data '
+                        'from --data-train, the lstm always uses synthetic data')
+    parser.add_argument('--data-train', type=str, default=None,
+                        help='the ImageRecordIter .rec file of the real data')
+    parser.add_argument('--gpus', type=int_list, default=[1, 2, 4, 8],
+                        help='the numbers of gpus of each worker, 0 for one cpu')
+    parser.add_argument('--kv-stores', type=str, default='local,device',
+                        help='the kvstore types, device is skipped with one device')
+    parser.add_argument('--num-workers', type=int, default=2,
+                        help='the number of workers of the distributed modes')
+    parser.add_argument('--num-servers', type=int, default=1,
+                        help='the number of servers of the distributed modes')
+    parser.add_argument('--batch-size', type=int, default=32,
+                        help='the batch size of each device')
+    parser.add_argument('--seq-len', type=int, default=35,
+                        help='the sequence length of the lstm')
+    parser.add_argument('--num-hidden', type=int, default=650,
+                        help='the hidden size of the lstm')
+    parser.add_argument('--vocab', type=int, default=10000,
+                        help='the vocabulary size of the lstm')
+    parser.add_argument('--iters', type=int, default=50,
+                        help='the number of timed iterations')
+    parser.add_argument('--warmup', type=int, default=10,
+                        help='the number of iterations before timing')
+    parser.add_argument('--output', type=str, default=None,
+                        help='also append the results to this file, one json per line')
+    parser.add_argument('--baseline', type=str, default=None,
+                        help='compare the results to the baseline of this file')
+    parser.add_argument('--save-baseline', type=str, default=None,
+                        help='store the results as the baseline in this file')
+    parser.add_argument('--tolerance', type=float, default=0.1,
+                        help='the relative regression tolerated against the baseline')
+    parser.add_argument('--run', type=str, default=None,
+                        help=argparse.SUPPRESS)
+    return parser.parse_args()
+
+def percentile(values, q):
+    values = sorted(values)
+    k = min(len(values) - 1, max(0, int(round(q / 100.0 * (len(values) - 1)))))
+    return values[k]
+
+def lstm_symbol(num_hidden, vocab):
+    """a two layers lstm language model, fused by the RNN operator"""
+    import mxnet as mx
+    data = mx.sym.Variable('data')
+    label = mx.sym.Variable('softmax_label')
+    embed = mx.sym.Embedding(data=data, input_dim=vocab, output_dim=num_hidden, name='embed')
+    embed = mx.sym.SwapAxis(data=embed, dim1=0, dim2=1)
+    rnn = mx.sym.RNN(data=embed, state_size=num_hidden, num_layers=2, mode='lstm', name='lstm')
+    pred = mx.sym.FullyConnected(data=mx.sym.Reshape(data=rnn, shape=(-1, num_hidden)),
+                                 num_hidden=vocab, name='pred')
+    label = mx.sym.Reshape(data=mx.sym.SwapAxis(data=label, dim1=0, dim2=1), shape=(-1,))
+    return mx.sym.SoftmaxOutput(data=pred, label=label, name='softmax')
+
+def get_network(config, args):
+    """the symbol, the data shape without the batch and the label shape without the batch"""
+    if config['network'] == 'lstm':
+        return (lstm_symbol(args.num_hidden, args.vocab), (args.seq_len,), (args.seq_len,))
+    image_shape, num_classes = IMAGE_NETWORKS[config['network']]
+    net = importlib.import_module('symbol_' + config['network'])
+    return net.get_symbol(num_classes), image_shape, ()
+
+def get_iter(config, args, data_shape, label_shape, batch_size, kv):
+    """the iterator of the batches, restarted at the end of the data"""
+    import mxnet as mx
+    import numpy as np
+    if config['data'] == 'real':
+        data = mx.io.ImageRecordIter(
+            path_imgrec=args.data_train, data_shape=data_shape, batch_size=batch_size,
+            rand_crop=True, rand_mirror=True, num_parts=kv.num_workers, part_index=kv.rank)
+        while True:
+            for batch in data:
+                yield batch
+            data.reset()
+    # the same batch again and again, the time of the input is not measured
+    high = args.vocab if config['network'] == 'lstm' else IMAGE_NETWORKS[config['network']][1]
+    batch = mx.io.DataBatch(
+        data=[mx.nd.array(np.random.randint(0, high, (batch_size,) + data_shape))],
+        label=[mx.nd.array(np.random.randint(0, high, (batch_size,) + label_shape))])
+    while True:
+        yield batch
+
+class _Init(object):
+    """uniform initialization of all the parameters, whatever their names"""
+    def __call__(self, name, arr):
+        import mxnet as mx
+        mx.random.uniform(-0.01, 0.01, out=arr)
+
+def run_config(config, args):
+    """run one configuration in this process, return the result or None on
+    the workers other than the first one"""
+    import mxnet as mx
+    from mxnet import storage
+    kv = mx.kv.create(config['kv_store'])
+    if config['gpus'] == 0:
+        devs = [mx.cpu()]
+    else:
+        devs = [mx.gpu(i) for i in range(config['gpus'])]
+    sym, data_shape, label_shape = get_network(config, args)
+    batch_size = args.batch_size * len(devs)
+    mod = mx.mod.Module(sym, context=devs)
+    mod.bind(data_shapes=[('data', (batch_size,) + data_shape)],
+             label_shapes=[('softmax_label', (batch_size,) + label_shape)])
+    mod.init_params(_Init())
+    mod.init_optimizer(kvstore=kv, optimizer='sgd',
+                       optimizer_params={'learning_rate': 0.01, 'wd': 0.0001,
+                                         'rescale_grad': 1.0 / batch_size})
+    data = get_iter(config, args, data_shape, label_shape, batch_size, kv)
+
+    times = []
+    peak = [0] * len(devs)
+    tic = time.time()
+    for i in range(args.warmup + args.iters):
+        mod.forward_backward(next(data))
+        mod.update()
+        mx.nd.waitall()
+        toc = time.time()
+        if i >= args.warmup:
+            times.append(toc - tic)
+        for k, dev in enumerate(devs):
+            stats = storage.stats(dev)
+            peak[k] = max(peak[k], stats['used'] + stats['cached'])
+        tic = toc
+    if kv.rank != 0:
+        return None
+    result = dict(config)
+    result['samples_per_sec'] = batch_size * config['num_workers'] * len(times) / sum(times)
+    result['p50_ms'] = percentile(times, 50) * 1e3
+    result['p90_ms'] = percentile(times, 90) * 1e3
+    result['p99_ms'] = percentile(times, 99) * 1e3
+    result['peak_mem_mb'] = max(peak) / float(1 << 20)
+    return result
+
+def launch_config(config, args):
+    """run one configuration of a distributed mode by launch.py"""
+    cmd = [sys.executable, os.path.join(curr_path, '../../tools/launch.py'),
+           '-n', str(args.num_workers), '-s', str(args.num_servers),
+           '--launcher', 'local', sys.executable, os.path.abspath(__file__)]
+    cmd += sys.argv[1:] + ['--run', json.dumps(config)]
+    out = subprocess.check_output(cmd, env=os.environ.copy(), universal_newlines=True)
+    for line in out.splitlines():
+        if line.startswith(RESULT):
+            return json.loads(line[len(RESULT):])
+    raise RuntimeError('no result of %s:\n%s' % (config, out))
+
+def configs(args):
+    """all of the configurations to run"""
+    datas = ['synthetic', 'real'] if args.data == 'both' else [args.data]
+    for network, data, kv_store, gpus in itertools.product(
+            args.networks.split(','), datas, args.kv_stores.split(','), args.gpus):
+        if network != 'lstm' and network not in IMAGE_NETWORKS:
+            raise ValueError('unknown network ' + network)
+        if data == 'real' and network == 'lstm':
+            continue
+        if kv_store == 'device' and gpus <= 1:
+            continue
+        dist = kv_store.startswith('dist')
+        yield {'network': network, 'data': data, 'kv_store': kv_store, 'gpus': gpus,
+               'num_workers': args.num_workers if dist else 1}
+
+def key(result):
+    """the configuration of a result"""
+    return (result['network'], result['data'], result['kv_store'], result['gpus'],
+            result['num_workers'])
+
+def regressions(result, baseline, tolerance):
+    """the metrics of a result which regressed from its baseline"""
+    found = []
+    if result['samples_per_sec'] < baseline['samples_per_sec'] * (1 - tolerance):
+        found.append('samples_per_sec')
+    for metric in ['p50_ms', 'peak_mem_mb']:
+        if result[metric] > baseline[metric] * (1 + tolerance):
+            found.append(metric)
+    return ['%s %.2f -> %.2f' % (m, baseline[m], result[m]) for m in found]
+
+def main():
+    args = parse_args()
+    if args.run is not None:
+        # a worker or a server started by launch.py
+        result = run_config(json.loads(args.run), args)
+        if result is not None:
+            print(RESULT + json.dumps(result))
+            sys.stdout.flush()
+        return
+    if args.data != 'synthetic' and args.data_train is None:
+        raise ValueError('--data-train is required by the real data')
+
+    baselines = {}
+    if args.baseline is not None:
+        with open(args.baseline) as fin:
+            baselines = dict((key(r), r) for r in json.load(fin))
+    results = []
+    failed = []
+    print('%-14s %-9s %-10s %4s %7s %10s %8s %8s %8s %9s' % (
+        'network', 'data', 'kvstore', 'gpus', 'workers', 'samples/s', 'p50(ms)',
+        'p90(ms)', 'p99(ms)', 'peak(MB)'))
+    for config in configs(args):
+        if config['kv_store'].startswith('dist'):
+            result = launch_config(config, args)
+        else:
+            result = run_config(config, args)
+        print('%-14s %-9s %-10s %4d %7d %10.2f %8.2f %8.2f %8.2f %9.1f' % (
+            result['network'], result['data'], result['kv_store'], result['gpus'],
+            result['num_workers'], result['samples_per_sec'], result['p50_ms'],
+            result['p90_ms'], result['p99_ms'], result['peak_mem_mb']))
+        sys.stdout.flush()
+        results.append(result)
+        if args.output is not None:
+            with open(args.output, 'a') as fout:
+                fout.write(json.dumps(result) + '\n')
+        if key(result) in baselines:
+            regressed = regressions(result, baselines[key(result)], args.tolerance)
+            if regressed:
+                failed.append('%s: %s' % (key(result), ', '.join(regressed)))
+
+    if args.save_baseline is not None:
+        with open(args.save_baseline, 'w') as fout:
+            json.dump(results, fout, indent=2, sort_keys=True)
+    if failed:
+        print('Regressions against %s:' % args.baseline)
+        print('\n'.join(failed))
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
@@ -22,6 +22,10 @@ kv = mx.kv.create('dist_sync')
 # init kv
 kv.init(keys, [mx.nd.ones(shape)] * len(keys))
 kv.init(99, mx.nd.ones(big_shape))
+# keys sent in float16, whose sums stay exact
+kv.set_wire_dtype([9, 100], 'float16')
+kv.init(9, mx.nd.ones(shape))
+kv.init(100, mx.nd.ones(big_shape))
 # init updater on servers
 kv.set_optimizer(mx.optimizer.create('test', rate))
 
@@ -44,5 +48,21 @@ def test_sync_push_pull():
     kv.pull(99, out = val2)
     check_diff_to_scalar(val2, num)
 
+def test_sync_push_pull_half():
+    nrepeat = 3
+    for i in range(nrepeat):
+        kv.push(9, mx.nd.ones(shape)*(my_rank+1))
+        kv.push(100, mx.nd.ones(big_shape)*(my_rank+1))
+
+    num = (nworker + 1 ) * nworker * rate / 2 * nrepeat + 1
+    val = mx.nd.zeros(shape)
+    kv.pull(9, out = val)
+    check_diff_to_scalar(val, num)
+
+    val2 = mx.nd.zeros(big_shape)
+    kv.pull(100, out = val2)
+    check_diff_to_scalar(val2, num)
+
 if __name__ == "__main__":
     test_sync_push_pull()
+    test_sync_push_pull_half()
@@ -81,6 +81,17 @@ test_inception_cifar10() {
 }
 juLog -name=Python.Inception.Cifar10 -error=Fail test_inception_cifar10
 
+# python: training throughput, compared to the baseline of the machine if any
+test_benchmark() {
+    baseline=benchmark_baseline.json
+    if [ -f $baseline ]; then
+        python benchmark.py --gpus 1,${num_gpus} --baseline $baseline
+    else
+        python benchmark.py --gpus 1,${num_gpus} --save-baseline $baseline
+    fi
+}
+juLog -name=Python.Benchmark -error=Error test_benchmark
+
 # build without CUDNN
 cat >>../../config.mk <<EOF
 USE_CUDNN=0
@@ -104,6 +104,12 @@ def test_convolution_with_type():
                 {'ctx': mx.cpu(0), 'conv_data': (2, 2, 10, 10), 'type_dict': {'conv_data': np.float32}}]
     check_consistency(sym, ctx_list)
 
+def test_convolution_auto_workspace():
+    sym = mx.sym.Convolution(num_filter=8, kernel=(3,3), pad=(1,1), cudnn_tune='auto', name='conv')
+    ctx_list = [{'ctx': mx.gpu(0), 'conv_data': (4, 4, 16, 16), 'type_dict': {'conv_data': np.float32}},
+                {'ctx': mx.cpu(0), 'conv_data': (4, 4, 16, 16), 'type_dict': {'conv_data': np.float64}}]
+    check_consistency(sym, ctx_list)
+
 def test_deconvolution_with_type():
     sym = mx.sym.Deconvolution(num_filter=2, kernel=(3,3), name='deconv')
     ctx_list = [{'ctx': mx.gpu(0), 'deconv_data': (2, 2, 10, 10), 'type_dict': {'deconv_data': np.float64}},
@@ -207,9 +213,23 @@ def test_embedding_with_type():
                 {'ctx': mx.cpu(0), 'embedding_data': (2, 10), 'type_dict': {'embedding_data': np.float16}}]
     check_consistency(sym, ctx_list, grad_req={'embedding_data': 'null','embedding_weight': 'write'})
 
+def test_correlation_with_type():
+    for kernel_size, max_displacement, stride1, stride2 in [(1, 4, 1, 1), (3, 2, 2, 1), (1, 20, 1, 2)]:
+        sym = mx.sym.Correlation(name='corr', kernel_size=kernel_size, max_displacement=max_displacement,
+                                 stride1=stride1, stride2=stride2, pad_size=max_displacement)
+        shape = (2, 40, 12, 14)
+        ctx_list = [{'ctx': mx.gpu(0), 'corr_data1': shape, 'corr_data2': shape,
+                     'type_dict': {'corr_data1': np.float32}},
+                    {'ctx': mx.gpu(0), 'corr_data1': shape, 'corr_data2': shape,
+                     'type_dict': {'corr_data1': np.float16}},
+                    {'ctx': mx.cpu(0), 'corr_data1': shape, 'corr_data2': shape,
+                     'type_dict': {'corr_data1': np.float64}}]
+        check_consistency(sym, ctx_list)
+
 if __name__ == '__main__':
     test_batchnorm_with_type()
     test_convolution_with_type()
+    test_convolution_auto_workspace()
     test_deconvolution_with_type()
     test_upsampling_with_type()
     test_concat_with_type()
@@ -220,6 +240,7 @@ if __name__ == '__main__':
     test_fullyconnected_with_type()
     test_activation_with_type()
     test_embedding_with_type()
+    test_correlation_with_type()
     #test_softmax_with_shape((3,4), mx.gpu())
     #test_multi_softmax_with_shape((3,4,5), mx.gpu())
 
@@ -1,3 +1,4 @@
+import os
 import numpy as np
 import mxnet as mx
 
@@ -128,7 +129,351 @@ def test_reshape():
     # test base exec forward
     exe.forward(is_train=False)
     assert np.all(exe.outputs[0].asnumpy() == 4)
+    # test backward of reshaped exec
+    new_exe.forward(is_train=True)
+    new_exe.backward([mx.nd.ones((3,4))])
+    assert np.all(new_exe.grad_arrays[1].asnumpy() == 3)
+    assert np.all(new_exe.grad_arrays[0].asnumpy() == 4)
+
+def test_arena_mem_plan():
+    x = mx.sym.Variable('x')
+    net = mx.sym.FullyConnected(x, num_hidden=16, name='fc1')
+    net = mx.sym.Activation(net, act_type='relu')
+    net = mx.sym.FullyConnected(net, num_hidden=8, name='fc2')
+    net = mx.sym.Activation(net, act_type='tanh')
+    net = mx.sym.FullyConnected(net, num_hidden=4, name='fc3')
+    outputs = []
+    for plan in ['Match', 'Arena']:
+        os.environ['MXNET_EXEC_MEM_PLAN'] = plan
+        exe = net.simple_bind(mx.cpu(), x=(5, 10))
+        for i, arr in enumerate(exe.arg_arrays):
+            arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones((5, 4))])
+        outputs.append([exe.outputs[0].asnumpy()] +
+                       [g.asnumpy() for g in exe.grad_arrays])
+    del os.environ['MXNET_EXEC_MEM_PLAN']
+    for a, b in zip(outputs[0], outputs[1]):
+        assert reldiff(a, b) < 1e-6
+
+def test_mem_budget_mirror():
+    x = mx.sym.Variable('x')
+    net = mx.sym.FullyConnected(x, num_hidden=256, name='fc1')
+    net = mx.sym.Activation(net, act_type='relu')
+    net = mx.sym.FullyConnected(net, num_hidden=256, name='fc2')
+    net = mx.sym.Activation(net, act_type='tanh')
+    net = mx.sym.FullyConnected(net, num_hidden=4, name='fc3')
+    outputs = []
+    # the arguments and activations take about 3 MB
+    for budget in [0, 2]:
+        exe = net.simple_bind(mx.cpu(), x=(512, 256), mem_budget=budget)
+        for i, arr in enumerate(exe.arg_arrays):
+            arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape) * 0.1
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones((512, 4))])
+        outputs.append([exe.outputs[0].asnumpy()] +
+                       [g.asnumpy() for g in exe.grad_arrays])
+    for a, b in zip(outputs[0], outputs[1]):
+        assert reldiff(a, b) < 1e-6
+
+def test_fuse_elemwise():
+    x = mx.sym.Variable('x')
+    y = mx.sym.Variable('y')
+    w = mx.sym.Variable('w')
+    gate = mx.sym.Activation(x * y + 2, act_type='sigmoid')
+    net = mx.sym.Activation(gate * mx.sym.exp(y) - x / 3, act_type='tanh')
+    net = mx.sym.FullyConnected(net, w, num_hidden=3, no_bias=True, name='fc')
+    net = mx.sym.maximum(net, 0.1 * net) + mx.sym.square(net)
+    outputs = []
+    for fuse in ['0', '1']:
+        os.environ['MXNET_EXEC_FUSE_ELEMWISE'] = fuse
+        exe = net.simple_bind(mx.cpu(), x=(8, 5), y=(8, 5))
+        for i, arr in enumerate(exe.arg_arrays):
+            arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones((8, 3))])
+        outputs.append([exe.outputs[0].asnumpy()] +
+                       [g.asnumpy() for g in exe.grad_arrays])
+    del os.environ['MXNET_EXEC_FUSE_ELEMWISE']
+    for a, b in zip(outputs[0], outputs[1]):
+        assert reldiff(a, b) < 1e-5
+
+def test_simplify_graph():
+    x = mx.sym.Variable('x')
+    a = mx.sym.exp(mx.sym.Reshape(x, shape=(8, 5)))
+    b = mx.sym.exp(mx.sym.Reshape(x, shape=(8, 5))) * 1
+    net = mx.sym.Group([a + b, mx.sym.sum(a)])
+    outputs = []
+    num_forward = []
+    for simplify in ['0', '1']:
+        os.environ['MXNET_EXEC_SIMPLIFY_GRAPH'] = simplify
+        exe = net.simple_bind(mx.cpu(), x=(4, 10))
+        exe.arg_arrays[0][:] = np.sin(np.arange(40)).reshape((4, 10))
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones((8, 5)), mx.nd.ones((1,))])
+        outputs.append([o.asnumpy() for o in exe.outputs] + [exe.grad_arrays[0].asnumpy()])
+        num_forward.append(len([node for node in exe.cost()['nodes']
+                                if node['pass'] == 'forward']))
+    del os.environ['MXNET_EXEC_SIMPLIFY_GRAPH']
+    for a, b in zip(outputs[0], outputs[1]):
+        assert reldiff(a, b) < 1e-5
+    # one Reshape, one exp and no multiplication are left
+    assert num_forward[1] == num_forward[0] - 3
+
+def test_blocked_layout():
+    x = mx.sym.Variable('x')
+    pool = mx.sym.Pooling(x, kernel=(3, 3), stride=(2, 2), pad=(1, 1), pool_type='max')
+    act = mx.sym.Activation(pool, act_type='relu')
+    net = mx.sym.ElementWiseSum(act, mx.sym.Pooling(act, kernel=(3, 3), pad=(1, 1),
+                                                    pool_type='avg'))
+    net = mx.sym.Group([net, mx.sym.Flatten(pool)])
+    outputs = []
+    for blocked in ['0', '1']:
+        os.environ['MXNET_CPU_BLOCKED_LAYOUT'] = blocked
+        exe = net.simple_bind(mx.cpu(), x=(2, 16, 9, 7), grad_req='null')
+        exe.arg_arrays[0][:] = np.sin(np.arange(exe.arg_arrays[0].size)).reshape((2, 16, 9, 7))
+        exe.forward(is_train=False)
+        outputs.append([out.asnumpy() for out in exe.outputs])
+        assert ('layout=NCHW8c' in exe.debug_str()) == (blocked == '1')
+    del os.environ['MXNET_CPU_BLOCKED_LAYOUT']
+    for a, b in zip(outputs[0], outputs[1]):
+        assert reldiff(a, b) < 1e-6
+
+def test_branch_segments():
+    x = mx.sym.Variable('x')
+    towers = [mx.sym.FullyConnected(mx.sym.Activation(
+        mx.sym.FullyConnected(x, num_hidden=8, name='fc%d_a' % i), act_type='relu'),
+                                    num_hidden=4, name='fc%d_b' % i) for i in range(3)]
+    net = mx.sym.Concat(*towers)
+    outputs = []
+    for split in ['0', '1']:
+        os.environ['MXNET_EXEC_BRANCH_SEGMENTS'] = split
+        for is_train in [False, True]:
+            exe = net.simple_bind(mx.cpu(), x=(6, 5),
+                                  grad_req='write' if is_train else 'null')
+            for i, arr in enumerate(exe.arg_arrays):
+                arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+            exe.forward(is_train=is_train)
+            result = [exe.outputs[0].asnumpy()]
+            if is_train:
+                exe.backward([mx.nd.ones((6, 12))])
+                result += [g.asnumpy() for g in exe.grad_arrays]
+            outputs.append(result)
+    del os.environ['MXNET_EXEC_BRANCH_SEGMENTS']
+    for a, b in zip(outputs[:2], outputs[2:]):
+        for x, y in zip(a, b):
+            assert reldiff(x, y) < 1e-6
+
+def test_zero_copy_concat():
+    x = mx.sym.Variable('x')
+    # the towers write into the slices of the concat along the first dimension
+    towers = [mx.sym.Activation(mx.sym.FullyConnected(x, num_hidden=4, name='fc%d' % i),
+                                act_type='tanh') for i in range(3)]
+    net = mx.sym.FullyConnected(mx.sym.Concat(*towers, dim=0), num_hidden=2, name='fc')
+    outputs = []
+    for plan in ['Match', 'Arena']:
+        for alias in ['0', '1']:
+            os.environ['MXNET_EXEC_MEM_PLAN'] = plan
+            os.environ['MXNET_EXEC_ZERO_COPY_CONCAT'] = alias
+            exe = net.simple_bind(mx.cpu(), x=(5, 6))
+            assert ('storage_offset' in exe.debug_str()) == (alias == '1')
+            for i, arr in enumerate(exe.arg_arrays):
+                arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+            exe.forward(is_train=True)
+            exe.backward([mx.nd.ones((15, 2))])
+            outputs.append([exe.outputs[0].asnumpy()] +
+                           [g.asnumpy() for g in exe.grad_arrays])
+    del os.environ['MXNET_EXEC_MEM_PLAN']
+    del os.environ['MXNET_EXEC_ZERO_COPY_CONCAT']
+    for result in outputs[1:]:
+        for a, b in zip(outputs[0], result):
+            assert reldiff(a, b) < 1e-6
+
+def test_zero_copy_reshape():
+    x = mx.sym.Variable('x')
+    h = mx.sym.Activation(mx.sym.FullyConnected(x, num_hidden=12, name='fc1'), act_type='tanh')
+    # h is read by the reshape and by fc3, the flatten is the last reader of the reshape
+    r = mx.sym.Flatten(mx.sym.Reshape(h, shape=(5, 3, 4), name='reshape'), name='flatten')
+    net = (mx.sym.FullyConnected(r, num_hidden=2, name='fc2') +
+           mx.sym.FullyConnected(h, num_hidden=2, name='fc3'))
+    outputs = []
+    for alias in ['0', '1']:
+        os.environ['MXNET_EXEC_ZERO_COPY_RESHAPE'] = alias
+        exe = net.simple_bind(mx.cpu(), x=(5, 6))
+        # the aliased nodes do not run
+        flops = [node['flops'] for node in exe.cost()['nodes']
+                 if node['name'] in ['reshape', 'flatten']]
+        assert len(flops) == 4
+        assert all((f == 0) == (alias == '1') for f in flops)
+        for i, arr in enumerate(exe.arg_arrays):
+            arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones((5, 2))])
+        outputs.append([exe.outputs[0].asnumpy()] +
+                       [g.asnumpy() for g in exe.grad_arrays])
+    del os.environ['MXNET_EXEC_ZERO_COPY_RESHAPE']
+    for a, b in zip(outputs[0], outputs[1]):
+        assert reldiff(a, b) < 1e-6
+
+def test_zero_copy_slice():
+    x = mx.sym.Variable('x')
+    h = mx.sym.Activation(mx.sym.FullyConnected(x, num_hidden=12, name='fc1'), act_type='tanh')
+    # the steps of a time major sequence are contiguous
+    steps = mx.sym.SliceChannel(mx.sym.Reshape(h, shape=(5, 3, 4)), num_outputs=5, axis=0,
+                                squeeze_axis=True, name='slice')
+    net = mx.sym.ElementWiseSum(*[mx.sym.FullyConnected(steps[i], num_hidden=2, name='fc%d' % i)
+                                  for i in range(5)])
+    outputs = []
+    for alias in ['0', '1']:
+        os.environ['MXNET_EXEC_ZERO_COPY_SLICE'] = alias
+        exe = net.simple_bind(mx.cpu(), x=(5, 6))
+        # the slice channel and its backward do not run
+        flops = [node['flops'] for node in exe.cost()['nodes'] if node['name'] == 'slice']
+        assert len(flops) == 2
+        assert all((f == 0) == (alias == '1') for f in flops)
+        for i, arr in enumerate(exe.arg_arrays):
+            arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones((3, 2))])
+        outputs.append([exe.outputs[0].asnumpy()] +
+                       [g.asnumpy() for g in exe.grad_arrays])
+    del os.environ['MXNET_EXEC_ZERO_COPY_SLICE']
+    for a, b in zip(outputs[0], outputs[1]):
+        assert reldiff(a, b) < 1e-6
+
+def test_fuse_cast():
+    x = mx.sym.Variable('x')
+    h = mx.sym.Cast(x, dtype='float32', name='cast')
+    # both readers of the cast convert on load
+    net = mx.sym.Concat(mx.sym.FullyConnected(h, num_hidden=4, name='fc'),
+                        mx.sym.Activation(h, act_type='tanh'), dim=1)
+    outputs = []
+    for fuse in ['0', '1']:
+        os.environ['MXNET_EXEC_FUSE_CAST'] = fuse
+        exe = net.simple_bind(mx.cpu(), grad_req='null', type_dict={'x': np.float16}, x=(5, 4))
+        # the fused cast does not run
+        flops = [node['flops'] for node in exe.cost()['nodes'] if node['name'] == 'cast']
+        assert len(flops) == 1
+        assert all((f == 0) == (fuse == '1') for f in flops)
+        for i, arr in enumerate(exe.arg_arrays):
+            arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+        exe.forward(is_train=False)
+        outputs.append(exe.outputs[0].asnumpy())
+    del os.environ['MXNET_EXEC_FUSE_CAST']
+    assert reldiff(outputs[0], outputs[1]) < 1e-6
+
+def test_grad_ready_callback():
+    data = mx.symbol.Variable('data')
+    fc1 = mx.symbol.FullyConnected(data=data, name='fc1', num_hidden=8)
+    act = mx.symbol.Activation(data=fc1, act_type='relu')
+    net = mx.symbol.FullyConnected(data=act, name='fc2', num_hidden=4)
+    arg_names = net.list_arguments()
+    grad_req = {name: 'null' if name == 'data' else 'write' for name in arg_names}
+    exe = net.simple_bind(ctx=mx.cpu(), data=(5, 6), grad_req=grad_req)
+    for arr in exe.arg_arrays:
+        arr[:] = np.random.uniform(-1, 1, arr.shape)
+    ready = []
+    # the gradient is complete when read in the callback
+    grads = {}
+    def callback(index):
+        ready.append(index)
+        grads[index] = exe.grad_arrays[index].asnumpy()
+    exe.set_grad_ready_callback(callback)
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.ones((5, 4))])
+    assert sorted(ready) == [i for i, name in enumerate(arg_names) if name != 'data']
+    # top layer gradients are ready first
+    assert ready.index(arg_names.index('fc2_weight')) < ready.index(arg_names.index('fc1_weight'))
+    for index, grad in grads.items():
+        assert reldiff(grad, exe.grad_arrays[index].asnumpy()) < 1e-6
+
+def test_cost():
+    data = mx.symbol.Variable('data')
+    fc1 = mx.symbol.FullyConnected(data=data, name='fc1', num_hidden=8)
+    net = mx.symbol.Activation(data=fc1, name='relu1', act_type='relu')
+    exe = net.simple_bind(ctx=mx.cpu(), data=(5, 6))
+    cost = exe.cost()
+    nodes = {(node['name'], node['pass']): node for node in cost['nodes']}
+    fc1_fwd = nodes[('fc1', 'forward')]
+    # 5 x 8 outputs of 6 multiply-adds each
+    assert fc1_fwd['flops'] == 2 * 5 * 8 * 6
+    assert fc1_fwd['param_bytes'] == (8 * 6 + 8) * 4
+    assert fc1_fwd['write_bytes'] == 5 * 8 * 4
+    assert nodes[('fc1', 'backward')]['flops'] == 2 * fc1_fwd['flops']
+    assert nodes[('relu1', 'forward')]['flops'] == 5 * 8
+    total = cost['total']
+    assert total['flops'] == cost['forward']['flops'] + cost['backward']['flops']
+    assert abs(total['intensity'] -
+               total['flops'] / (total['read_bytes'] + total['write_bytes'])) < 1e-6
+
+def test_profiling():
+    data = mx.symbol.Variable('data')
+    fc1 = mx.symbol.FullyConnected(data=data, name='fc1', num_hidden=8)
+    net = mx.symbol.Activation(data=fc1, name='relu1', act_type='relu')
+    exe = net.simple_bind(ctx=mx.cpu(), data=(5, 6))
+    exe.set_profiling()
+    for _ in range(3):
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones((5, 8))])
+    mx.nd.waitall()
+    profile = exe.profile(reset=True)
+    nodes = {(node['name'], node['pass']): node for node in profile['nodes']}
+    for key in [('fc1', 'forward'), ('fc1', 'backward'), ('relu1', 'forward')]:
+        assert nodes[key]['count'] == 3
+        assert nodes[key]['max_ms'] >= nodes[key]['mean_ms'] >= 0
+    assert profile['forward']['mean_ms'] >= nodes[('fc1', 'forward')]['mean_ms']
+    assert len(exe.profile()['nodes']) == 0
+
+def test_backward_pruning():
+    data = mx.symbol.Variable('data')
+    fc1 = mx.symbol.FullyConnected(data=data, name='fc1', num_hidden=8)
+    relu1 = mx.symbol.Activation(data=fc1, name='relu1', act_type='relu')
+    net = mx.symbol.FullyConnected(data=relu1, name='fc2', num_hidden=4)
+    arg_names = net.list_arguments()
+    grad_req = {name: 'write' if name.startswith('fc2') else 'null' for name in arg_names}
+    exe = net.simple_bind(ctx=mx.cpu(), grad_req=grad_req, data=(5, 6))
+    ref = net.simple_bind(ctx=mx.cpu(), data=(5, 6))
+    for arr, ref_arr in zip(exe.arg_arrays, ref.arg_arrays):
+        arr[:] = np.random.uniform(-1, 1, arr.shape)
+        ref_arr[:] = arr
+    # the frozen layers run no backward
+    nodes = set((node['name'], node['pass']) for node in exe.cost()['nodes'])
+    assert ('fc2', 'backward') in nodes
+    assert ('relu1', 'backward') not in nodes and ('fc1', 'backward') not in nodes
+    for e in [exe, ref]:
+        e.forward(is_train=True)
+        e.backward([mx.nd.ones((5, 4))])
+    for name in ['fc2_weight', 'fc2_bias']:
+        assert reldiff(exe.grad_dict[name].asnumpy(), ref.grad_dict[name].asnumpy()) < 1e-6
+
+def test_warmup():
+    data = mx.symbol.Variable('data')
+    net = mx.symbol.Convolution(data, num_filter=4, kernel=(3, 3), name='conv')
+    net = mx.symbol.FullyConnected(mx.symbol.Activation(net, act_type='relu'), num_hidden=3)
+    outputs = []
+    for warmup in [False, True]:
+        exe = net.simple_bind(ctx=mx.cpu(), grad_req='null', warmup=warmup, data=(2, 3, 6, 6))
+        for i, arr in enumerate(exe.arg_arrays):
+            arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+        exe.forward(is_train=False)
+        outputs.append(exe.outputs[0].asnumpy())
+    assert reldiff(outputs[0], outputs[1]) < 1e-6
 
 if __name__ == "__main__":
     test_bind()
     test_reshape()
+    test_arena_mem_plan()
+    test_mem_budget_mirror()
+    test_fuse_elemwise()
+    test_simplify_graph()
+    test_blocked_layout()
+    test_branch_segments()
+    test_zero_copy_concat()
+    test_zero_copy_reshape()
+    test_zero_copy_slice()
+    test_fuse_cast()
+    test_grad_ready_callback()
+    test_cost()
+    test_profiling()
+    test_backward_pruning()
+    test_warmup()
@@ -88,7 +88,274 @@ def test_NDArrayIter():
         else:
             assert(labelcount[i] == 100)
 
+def test_DeviceImageIter():
+    class Uint8Iter(mx.io.DataIter):
+        def __init__(self, images):
+            super(Uint8Iter, self).__init__()
+            self.images = images
+            self.batch_size = images.shape[0]
+            self.provide_data = [('data', images.shape)]
+            self.provide_label = [('softmax_label', (self.batch_size,))]
+            self.done = False
+        def reset(self):
+            self.done = False
+        def next(self):
+            if self.done:
+                raise StopIteration
+            self.done = True
+            data = mx.nd.array(self.images, dtype=np.uint8)
+            label = mx.nd.array(np.arange(self.batch_size))
+            return mx.io.DataBatch([data], [label], 0, None)
+    images = np.random.randint(0, 256, (8, 3, 4, 5)).astype(np.uint8)
+    mean = [123.0, 117.0, 104.0]
+    dataiter = mx.io.DeviceImageIter(Uint8Iter(images), mx.cpu(), mean=mean,
+                                     scale=0.5, rand_mirror=True, seed=1)
+    batches = [batch for batch in dataiter]
+    assert len(batches) == 1
+    out = batches[0].data[0].asnumpy()
+    expect = (images.astype(np.float32) - np.array(mean).reshape((1, 3, 1, 1))) * 0.5
+    for i in range(images.shape[0]):
+        assert (out[i] == expect[i]).all() or (out[i] == expect[i][:, :, ::-1]).all()
+    assert (batches[0].label[0].asnumpy() == np.arange(8)).all()
+
+def test_CSVIter():
+    import tempfile
+    tmp = tempfile.mkdtemp()
+    data = np.random.uniform(-10, 10, (20, 6)).astype(np.float32)
+    label = np.arange(20).astype(np.float32)
+    data_csv = os.path.join(tmp, 'data.csv')
+    label_csv = os.path.join(tmp, 'label.csv')
+    np.savetxt(data_csv, data, delimiter=',', fmt='%.8e')
+    np.savetxt(label_csv, label, delimiter=',', fmt='%d')
+    for num_parts in [1, 2]:
+        rows = []
+        for part_index in range(num_parts):
+            dataiter = mx.io.CSVIter(data_csv=data_csv, data_shape=(2, 3),
+                                     label_csv=label_csv, batch_size=5,
+                                     preprocess_threads=3, num_parts=num_parts,
+                                     part_index=part_index)
+            for batch in dataiter:
+                out = batch.data[0].asnumpy().reshape((5, 6))
+                for x, y in zip(out, batch.label[0].asnumpy()):
+                    assert int(y) % num_parts == part_index
+                    assert np.allclose(x, data[int(y)])
+                    rows.append(int(y))
+        assert sorted(rows) == list(range(20))
+    stats = dataiter.get_stats(reset=True)
+    stages = dict((s['name'], s) for s in stats['stages'])
+    assert stages['batch']['items'] > 0 and stages['prefetch']['items'] > 0
+    assert stages['prefetch']['queue_capacity'] == 4
+    stages = dict((s['name'], s) for s in dataiter.get_stats()['stages'])
+    assert stages['batch']['items'] == 0
+
+def test_CSVIter_cache():
+    import tempfile
+    tmp = tempfile.mkdtemp()
+    data = np.random.uniform(-10, 10, (23, 4)).astype(np.float32)
+    label = np.arange(23).astype(np.float32)
+    data_csv = os.path.join(tmp, 'data.csv')
+    label_csv = os.path.join(tmp, 'label.csv')
+    cache_file = os.path.join(tmp, 'data.cache')
+    np.savetxt(data_csv, data, delimiter=',', fmt='%.8e')
+    np.savetxt(label_csv, label, delimiter=',', fmt='%d')
+    def read_epoch(dataiter):
+        rows = []
+        for batch in dataiter:
+            out = batch.data[0].asnumpy()
+            for x, y in list(zip(out, batch.label[0].asnumpy()))[:5 - batch.pad]:
+                assert np.allclose(x, data[int(y)])
+                rows.append(int(y))
+        dataiter.reset()
+        return rows
+    kwargs = dict(data_csv=data_csv, data_shape=(4,), label_csv=label_csv, batch_size=5,
+                  cache_file=cache_file, cache_group_rows=4, shuffle=True, round_batch=False)
+    dataiter = mx.io.CSVIter(**kwargs)
+    # the first pass parses the csv files in order and writes the cache
+    assert read_epoch(dataiter) == list(range(23))
+    assert os.path.exists(cache_file)
+    shuffled = read_epoch(dataiter)
+    assert sorted(shuffled) == list(range(23)) and shuffled != list(range(23))
+    # a new iterator reads the cache without the csv files
+    os.remove(data_csv)
+    os.remove(label_csv)
+    assert sorted(read_epoch(mx.io.CSVIter(**kwargs))) == list(range(23))
+
+def _shared_memory_writer(writer, num_batches):
+    for i in range(num_batches):
+        writer.put([np.full((4, 3), i, dtype=np.float32)], [np.arange(4) + i])
+    writer.end_epoch()
+
+def test_SharedMemoryIter():
+    import multiprocessing
+    dataiter = mx.io.SharedMemoryIter([('data', (4, 3))], [('softmax_label', (4,))],
+                                      num_slots=2)
+    assert dataiter.provide_data == [('data', (4, 3))]
+    for epoch in range(2):
+        proc = multiprocessing.Process(target=_shared_memory_writer,
+                                       args=(dataiter.writer(), 5))
+        proc.start()
+        batches = 0
+        for i, batch in enumerate(dataiter):
+            assert np.all(batch.data[0].asnumpy() == i)
+            assert np.all(batch.label[0].asnumpy() == np.arange(4) + i)
+            batches += 1
+        assert batches == 5
+        proc.join()
+        dataiter.reset()
+
+def test_LibSVMIter():
+    import tempfile
+    tmp = tempfile.mkdtemp()
+    dense = np.random.uniform(-1, 1, (10, 20)) * (np.random.uniform(0, 1, (10, 20)) < 0.3)
+    data_libsvm = os.path.join(tmp, 'data.libsvm')
+    with open(data_libsvm, 'w') as fout:
+        for i, row in enumerate(dense):
+            fout.write('%d %s\n' % (i, ' '.join('%d:%.8e' % (j, v) for j, v in enumerate(row)
+                                                if v != 0)))
+    dataiter = mx.io.LibSVMIter(data_libsvm=data_libsvm, data_shape=(20,),
+                                batch_size=4, max_nnz=80)
+    assert [name for name, _ in dataiter.provide_data] == ['data', 'data_indices', 'data_indptr']
+    assert dataiter.batch_size == 4
+    rows = []
+    for batch in dataiter:
+        data, indices, indptr = batch.data
+        csr = mx.nd.CSRNDArray(data, indices, indptr, (4, 20))
+        out = csr.todense().asnumpy()
+        for k, y in enumerate(batch.label[0].asnumpy()[:4 - batch.pad]):
+            assert np.allclose(out[k], dense[int(y)])
+            rows.append(int(y))
+        assert np.all(out[4 - batch.pad:] == 0)
+    assert sorted(rows) == list(range(10))
+
+def test_SequenceRecordIter():
+    import tempfile
+    tmp = tempfile.mkdtemp()
+    path = os.path.join(tmp, 'seq.rec')
+    lengths = [3, 5, 7, 2, 9, 4, 6, 12]
+    writer = mx.recordio.MXRecordIO(path, 'w')
+    for i, n in enumerate(lengths):
+        data = np.arange(n) + 100 * i
+        writer.write(mx.recordio.pack_sequence(data, data + 1))
+    writer.close()
+    dataiter = mx.io.SequenceRecordIter(path_seqrec=path, buckets=(4, 8), batch_size=2,
+                                        data_pad=-1)
+    assert dataiter.default_bucket_key == 8
+    assert dataiter.provide_data == [('data', (2, 8))]
+    seen = []
+    for batch in dataiter:
+        key = batch.bucket_key
+        data = batch.data[0].asnumpy()
+        label = batch.label[0].asnumpy()
+        assert data.shape == (2, key) and batch.provide_data == [('data', (2, key))]
+        for k in range(2 - batch.pad):
+            i = int(data[k][0]) // 100
+            n = lengths[i]
+            assert n <= key and (key == 4 or n > 4)
+            assert np.all(data[k][:n] == np.arange(n) + 100 * i)
+            assert np.all(data[k][n:] == -1)
+            assert np.all(label[k][:n] == data[k][:n] + 1)
+            seen.append(i)
+    # the sequence longer than the largest bucket is dropped
+    assert sorted(seen) == list(range(7))
+
+def test_ImageDetRecordIter():
+    try:
+        import cv2
+    except ImportError:
+        return
+    import tempfile
+    tmp = tempfile.mkdtemp()
+    path = os.path.join(tmp, 'det.rec')
+    writer = mx.recordio.MXRecordIO(path, 'w')
+    boxes = [[[0, 0.1, 0.2, 0.4, 0.6]],
+             [[1, 0.5, 0.5, 0.9, 0.8], [2, 0.0, 0.0, 0.3, 0.3]]]
+    for i, objs in enumerate(boxes):
+        img = np.zeros((40, 60, 3), dtype=np.uint8)
+        label = [5] + sum(objs, [])
+        header = mx.recordio.IRHeader(0, label, i, 0)
+        writer.write(mx.recordio.pack_img(header, img, img_fmt='.png'))
+    writer.close()
+    dataiter = mx.io.ImageDetRecordIter(path_imgrec=path, data_shape=(3, 20, 30),
+                                        label_pad_width=15, batch_size=2,
+                                        rand_mirror_prob=1.0)
+    batch = dataiter.next()
+    assert batch.data[0].shape == (2, 3, 20, 30)
+    label = batch.label[0].asnumpy()
+    assert label.shape == (2, 15)
+    for row in range(2):
+        objs = boxes[int(batch.index[row])]
+        out = label[row]
+        for k, obj in enumerate(objs):
+            # the boxes flip with the images
+            expect = [obj[0], 1 - obj[3], obj[2], 1 - obj[1], obj[4]]
+            assert np.allclose(out[k * 5:(k + 1) * 5], expect)
+        assert np.all(out[len(objs) * 5:] == -1)
+
+def test_ImageRecordIter_reset_shape():
+    try:
+        import cv2
+    except ImportError:
+        return
+    import tempfile
+    tmp = tempfile.mkdtemp()
+    path = os.path.join(tmp, 'img.rec')
+    writer = mx.recordio.MXRecordIO(path, 'w')
+    for i in range(6):
+        img = np.full((48, 48, 3), i * 10, dtype=np.uint8)
+        header = mx.recordio.IRHeader(0, i, i, 0)
+        writer.write(mx.recordio.pack_img(header, img, img_fmt='.png'))
+    writer.close()
+    dataiter = mx.io.ImageRecordIter(path_imgrec=path, data_shape=(3, 16, 16),
+                                     batch_size=3, preprocess_threads=2)
+    assert dataiter.provide_data[0][1] == (3, 3, 16, 16)
+    assert len(list(dataiter)) == 2
+    # progressive resizing, the same iterator at a larger resolution
+    dataiter.reset(data_shape=(3, 32, 32))
+    assert dataiter.provide_data[0][1] == (3, 3, 32, 32)
+    batches = list(dataiter)
+    assert len(batches) == 2
+    for batch in batches:
+        assert batch.data[0].shape == (3, 3, 32, 32)
+        for row in range(3):
+            assert np.all(batch.data[0].asnumpy()[row] == batch.label[0].asnumpy()[row] * 10)
+    # a plain reset keeps the new shape
+    dataiter.reset()
+    assert dataiter.next().data[0].shape == (3, 3, 32, 32)
+
+def test_ImageRecordIter_reduced_decode():
+    try:
+        import cv2
+    except ImportError:
+        return
+    import tempfile
+    tmp = tempfile.mkdtemp()
+    path = os.path.join(tmp, 'img.rec')
+    writer = mx.recordio.MXRecordIO(path, 'w')
+    for i in range(6):
+        img = np.full((96, 128, 3), i * 40, dtype=np.uint8)
+        header = mx.recordio.IRHeader(0, i, i, 0)
+        writer.write(mx.recordio.pack_img(header, img, quality=95, img_fmt='.jpg'))
+    writer.close()
+    # the 96 x 128 images are decoded at 24 x 32, then resized and cropped
+    dataiter = mx.io.ImageRecordIter(path_imgrec=path, data_shape=(3, 24, 24), resize=24,
+                                     decode_min_edge=24, batch_size=3, preprocess_threads=2)
+    batches = list(dataiter)
+    assert len(batches) == 2
+    for batch in batches:
+        for row in range(3):
+            expected = batch.label[0].asnumpy()[row] * 40
+            assert np.all(np.abs(batch.data[0].asnumpy()[row] - expected) <= 4)
+
 if __name__ == "__main__":
     test_NDArrayIter()
     test_MNISTIter()
     test_Cifar10Rec()
+    test_DeviceImageIter()
+    test_CSVIter()
+    test_CSVIter_cache()
+    test_SharedMemoryIter()
+    test_LibSVMIter()
+    test_SequenceRecordIter()
+    test_ImageDetRecordIter()
+    test_ImageRecordIter_reset_shape()
+    test_ImageRecordIter_reduced_decode()
@@ -111,6 +111,24 @@ def test_updater(dev = 'cpu'):
         for v in vv:
             check_diff_to_scalar(v, num_devs * num_push)
 
+def test_row_sparse_push_pull():
+    """push and pull of some rows"""
+    kv = mx.kv.create()
+    kv.init(3, mx.nd.ones((6, 3)))
+    kv._set_updater(updater)
+    devs = [mx.Context('cpu', i) for i in range(2)]
+    ids = [[0, 2], [2, 5]]
+    vals = [mx.nd.row_sparse(mx.nd.ones((6, 3), d) * (i + 1), ids[i])
+            for i, d in enumerate(devs)]
+    kv.push(3, vals)
+    out = mx.nd.RowSparseNDArray(mx.nd.array([0, 1, 2, 5]), mx.nd.empty((4, 3)), (6, 3))
+    kv.pull(3, out=out)
+    expected = np.array([2, 1, 4, 3])
+    assert np.sum(np.abs(out.values.asnumpy() - expected[:, None])) == 0
+    dense = mx.nd.empty((6, 3))
+    kv.pull(3, out=dense)
+    assert np.sum(np.abs(dense.asnumpy()[:, 0] - np.array([2, 1, 4, 1, 1, 3]))) == 0
+
 def test_get_type():
     kvtype = 'local_allreduce_cpu'
     kv = mx.kv.create(kvtype)
@@ -123,3 +141,4 @@ if __name__ == '__main__':
     test_list_kv_pair()
     test_aggregator()
     test_updater()
+    test_row_sparse_push_pull()
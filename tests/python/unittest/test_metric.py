@@ -0,0 +1,36 @@
+import mxnet as mx
+import numpy as np
+
+def check_metric(metric, labels, preds, expected):
+    metric.update([mx.nd.array(l) for l in labels], [mx.nd.array(p) for p in preds])
+    _, value = metric.get()
+    assert abs(value - expected) < 1e-5 * max(1, abs(expected))
+
+def test_classification_metrics():
+    np.random.seed(0)
+    preds = [np.random.permutation(8 * 5).reshape(8, 5).astype(np.float32) for _ in range(3)]
+    labels = [np.random.randint(0, 5, 8).astype(np.float32) for _ in range(3)]
+    pred_all, label_all = np.concatenate(preds), np.concatenate(labels).astype(np.int64)
+    acc = np.mean(np.argmax(pred_all, axis=1) == label_all)
+    check_metric(mx.metric.Accuracy(), labels, preds, acc)
+    rank = np.argsort(np.argsort(-pred_all, axis=1), axis=1)
+    top3 = np.mean(rank[np.arange(len(label_all)), label_all] < 3)
+    check_metric(mx.metric.TopKAccuracy(top_k=3), labels, preds, top3)
+    probs = [np.exp(p / 40) / np.exp(p / 40).sum(axis=1, keepdims=True) for p in preds]
+    prob_all = np.concatenate(probs)
+    ce = np.mean(-np.log(prob_all[np.arange(len(label_all)), label_all]))
+    check_metric(mx.metric.CrossEntropy(), labels, probs, ce)
+
+def test_metric_reset():
+    metric = mx.metric.Accuracy()
+    metric.update([mx.nd.array([0, 1])], [mx.nd.array([[1, 0], [1, 0]])])
+    assert metric.get()[1] == 0.5
+    metric.reset()
+    assert np.isnan(metric.get()[1])
+    metric.update([mx.nd.array([1])], [mx.nd.array([[0, 1]])])
+    assert metric.get()[1] == 1
+
+
+if __name__ == '__main__':
+    test_classification_metrics()
+    test_metric_reset()
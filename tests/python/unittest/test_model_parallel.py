@@ -49,6 +49,39 @@ def test_chain():
     for a, b in zip(arr_grad, arr_grad2):
         assert reldiff(a.asnumpy(), b.asnumpy()) < 1e-6
 
+def test_micro_batches():
+    with mx.AttrScope(ctx_group='stage1'):
+        data = mx.sym.Variable('data')
+        net = mx.sym.FullyConnected(data=data, name='fc1', num_hidden=8)
+        net = mx.sym.Activation(data=net, act_type='relu')
+    with mx.AttrScope(ctx_group='stage2'):
+        net = mx.sym.FullyConnected(data=net, name='fc2', num_hidden=4)
+        net = mx.sym.SoftmaxOutput(data=net, name='softmax')
+    group2ctx = {'stage1': mx.cpu(0), 'stage2': mx.cpu(1)}
+
+    batch = mx.io.DataBatch(data=[mx.nd.array(np.random.uniform(-1, 1, (8, 6)))],
+                            label=[mx.nd.array(np.random.randint(0, 4, (8,)))])
+    grads = []
+    outputs = []
+    arg_params = None
+    for num_micro_batches in [1, 4]:
+        mod = mx.mod.Module(net, context=mx.cpu(), group2ctx=group2ctx,
+                            num_micro_batches=num_micro_batches)
+        mod.bind(data_shapes=[('data', (8, 6))], label_shapes=[('softmax_label', (8,))])
+        if arg_params is None:
+            mod.init_params()
+            arg_params, _ = mod.get_params()
+        else:
+            mod.init_params(arg_params=arg_params)
+        mod.forward(batch)
+        mod.backward()
+        outputs.append(mod.get_outputs()[0].asnumpy())
+        grads.append([block[0].asnumpy() for block in mod._exec_group.grad_arrays])
+    assert reldiff(outputs[0], outputs[1]) < 1e-6
+    for a, b in zip(grads[0], grads[1]):
+        assert reldiff(a, b) < 1e-5
+
 
 if __name__ == '__main__':
     test_chain()
+    test_micro_batches()
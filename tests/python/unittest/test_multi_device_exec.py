@@ -1,5 +1,6 @@
 import os
 import mxnet as mx
+import numpy as np
 
 def test_ctx_group():
     with mx.AttrScope(ctx_group='stage1'):
@@ -31,5 +32,70 @@ def test_ctx_group():
         else:
             assert arr.context == group2ctx['stage2']
 
+def test_init_params_broadcast():
+    data = mx.symbol.Variable('data')
+    fc = mx.symbol.FullyConnected(data=data, name='fc', num_hidden=16)
+    net = mx.symbol.SoftmaxOutput(data=mx.symbol.BatchNorm(fc, name='bn'), name='softmax')
+    contexts = [mx.cpu(i) for i in range(5)]
+    mod = mx.mod.Module(net, context=contexts)
+    mod.bind(data_shapes=[('data', (10, 8))], label_shapes=[('softmax_label', (10,))])
+    fc_bias = mx.nd.ones((16,)) * 3
+    mod.init_params(mx.init.Uniform(0.5), arg_params={'fc_bias': fc_bias}, allow_missing=True)
+    arg_params, aux_params = mod.get_params()
+    exec_group = mod._exec_group
+    for names, blocks, params in [(exec_group.param_names, exec_group.param_arrays, arg_params),
+                                  (exec_group.aux_names, exec_group.aux_arrays, aux_params)]:
+        for name, block in zip(names, blocks):
+            assert len(block) == len(contexts)
+            for arr in block:
+                assert np.array_equal(arr.asnumpy(), params[name].asnumpy())
+    assert np.all(arg_params['fc_weight'].asnumpy() != 0)
+    assert np.all(arg_params['fc_bias'].asnumpy() == 3)
+    assert np.all(aux_params['bn_moving_var'].asnumpy() == 1)
+
+def test_accumulation_steps():
+    data = mx.symbol.Variable('data')
+    net = mx.symbol.FullyConnected(data=data, name='fc1', num_hidden=8)
+    net = mx.symbol.Activation(data=net, act_type='relu')
+    net = mx.symbol.FullyConnected(data=net, name='fc2', num_hidden=4)
+    net = mx.symbol.SoftmaxOutput(data=net, name='softmax')
+    batch = mx.io.DataBatch(data=[mx.nd.array(np.random.uniform(-1, 1, (16, 6)))],
+                            label=[mx.nd.array(np.random.randint(0, 4, (16,)))])
+    contexts = [mx.cpu(0), mx.cpu(1)]
+    results = []
+    arg_params = None
+    for num_accumulation_steps in [1, 4]:
+        mod = mx.mod.Module(net, context=contexts,
+                            num_accumulation_steps=num_accumulation_steps)
+        mod.bind(data_shapes=[('data', (16, 6))], label_shapes=[('softmax_label', (16,))])
+        if arg_params is None:
+            mod.init_params()
+            arg_params, _ = mod.get_params()
+        else:
+            mod.init_params(arg_params=arg_params)
+        mod.init_optimizer(kvstore='local', optimizer_params={'learning_rate': 0.1})
+        # the executors only hold a micro-batch
+        assert mod._exec_group.execs[0].arg_dict['data'].shape == (8 // num_accumulation_steps, 6)
+        metric = mx.metric.create('ce')
+        for _ in range(2):
+            mod.forward(batch)
+            mod.backward()
+            grads = [block[0].asnumpy() for block in mod._exec_group.grad_arrays]
+            mod.update_metric(metric, batch.label)
+            mod.update()
+        outputs = mod.get_outputs()[0].asnumpy()
+        mod.forward(batch, is_train=False)
+        predicts = mod.get_outputs()[0].asnumpy()
+        results.append((outputs, predicts, grads, metric.get()[1],
+                        mod.get_params()[0]['fc1_weight'].asnumpy()))
+    for a, b in zip(results[0], results[1]):
+        if isinstance(a, list):
+            for x, y in zip(a, b):
+                assert np.allclose(x, y, rtol=1e-4, atol=1e-6)
+        else:
+            assert np.allclose(a, b, rtol=1e-4, atol=1e-6)
+
 if __name__ == '__main__':
     test_ctx_group()
+    test_init_params_broadcast()
+    test_accumulation_steps()
@@ -176,6 +176,83 @@ def test_ndarray_saveload():
             assert np.sum(x.asnumpy() != y.asnumpy()) == 0
     os.remove(fname)
 
+def test_ndarray_save_aligned():
+    np.random.seed(0)
+    fname = 'tmp_aligned.bin'
+    dmap = {'arg:w%d' % i : random_ndarray(np.random.randint(1, 5)) for i in range(10)}
+    mx.nd.save(fname, dmap, aligned=True)
+    dmap2 = mx.nd.load(fname)
+    assert len(dmap2) == len(dmap)
+    for k, x in dmap.items():
+        assert np.sum(x.asnumpy() != dmap2[k].asnumpy()) == 0
+    # the snapshot is not changed by the later updates
+    expected = {k : x.asnumpy() for k, x in dmap.items()}
+    mx.nd.save(fname, dmap, background=True)
+    for x in dmap.values():
+        x += 1
+    mx.nd.waitall()
+    dmap2 = mx.nd.load(fname)
+    for k, x in expected.items():
+        assert np.sum(x != dmap2[k].asnumpy()) == 0
+    os.remove(fname)
+
+
+def test_ndarray_numpy_zero_copy():
+    src = np.random.uniform(-1, 1, (3, 4)).astype(np.float32)
+    A = mx.nd.array(src, ctx=mx.cpu(), copy=False)
+    assert same(A.asnumpy(), src)
+    # the writes on either side are seen by the other one
+    A += 1
+    A.wait_to_read()
+    assert same(A.asnumpy(), src)
+    src[1, 2] = 7
+    assert A.asnumpy()[1, 2] == 7
+    # the numpy array is kept alive by the NDArray and its copies
+    B = (A * 2)
+    del src
+    C = A.reshape((4, 3))
+    del A
+    assert same(B.asnumpy().reshape((4, 3)), C.asnumpy() * 2)
+    # numpy views the memory of a CPU NDArray
+    view = np.asarray(C)
+    assert view.ctypes.data == np.asarray(C).ctypes.data
+    C[:] = 3
+    assert (np.asarray(C) == 3).all()
+    view[0, 0] = 5
+    assert C.asnumpy()[0, 0] == 5
+    # other dtypes and readonly sources are wrapped, mismatches are copied
+    src = np.arange(6, dtype=np.int32)
+    D = mx.nd.array(src, dtype=np.int32, copy=False)
+    assert np.asarray(D).ctypes.data == src.ctypes.data
+    src.flags.writeable = False
+    assert not mx.nd.array(src, dtype=np.int32, copy=False).writable
+    E = mx.nd.array(src, copy=False)
+    assert np.asarray(E).ctypes.data != src.ctypes.data
+    assert same(E.asnumpy(), src.astype(np.float32))
+    # strided views are copied
+    step = mx.nd.array(np.ones((2, 3, 4))).slice_view(1, 0, 2)
+    assert same(np.asarray(step), np.ones((2, 2, 4)))
+
+
+def test_ndarray_slice_view():
+    A = mx.nd.array(np.random.uniform(-10, 10, (4, 5, 3)))
+    A2 = A.asnumpy()
+    step = A.slice_view(1, 2, 3)
+    assert not step.is_contiguous
+    assert same(step.asnumpy(), A2[:, 2:3, :])
+    assert same((step * 2 + 1).asnumpy(), A2[:, 2:3, :] * 2 + 1)
+    assert abs(mx.nd.sum(step).asnumpy()[0] - np.sum(A2[:, 2:3, :])) < 1e-3
+    assert same(A.slice_view(2, 1, 3).asnumpy(), A2[:, :, 1:3])
+    assert A.slice_view(0, 1, 3).is_contiguous
+    # the writes go to the viewed array
+    step[:] = 7
+    A2[:, 2:3, :] = 7
+    assert same(A.asnumpy(), A2)
+    step += 1
+    A2[:, 2:3, :] += 1
+    assert same(A.asnumpy(), A2)
+    assert same(step.copy().asnumpy(), A2[:, 2:3, :])
+
 
 def test_ndarray_slice():
     shape = (10,)
@@ -195,6 +272,62 @@ def test_clip():
         assert B1[i] >= -2
         assert B1[i] <= 2
 
+def test_invoke_batch():
+    xs = [mx.nd.array(np.random.uniform(-4, 4, (3, 4))) for _ in range(5)]
+    clipped = [mx.nd.empty((3, 4)) for _ in xs]
+    sums = [mx.nd.empty((3,)) for _ in xs]
+    params = mx.nd.FunctionParams(mx.nd.sum, axis=1)
+    calls = [(mx.nd.clip, (x, -2.0, 2.0), out) for x, out in zip(xs, clipped)]
+    calls += [(mx.nd.sum, (x,), out, params) for x, out in zip(xs, sums)]
+    # the later calls read the results of the earlier ones
+    calls += [(mx.nd._internal._plus, (x, y), x) for x, y in zip(xs, clipped)]
+    expected = [x.asnumpy() for x in xs]
+    mx.nd.invoke_batch(calls)
+    for x, y, z, e in zip(xs, clipped, sums, expected):
+        assert same(y.asnumpy(), np.clip(e, -2.0, 2.0))
+        assert reldiff(z.asnumpy(), np.sum(e, axis=1)) < 1e-5
+        assert same(x.asnumpy(), e + y.asnumpy())
+    try:
+        mx.nd.invoke_batch([(mx.nd.clip, (xs[0], -2.0, 2.0), clipped[0], params)])
+        assert False
+    except TypeError:
+        pass
+
+def test_ndarray_lazy():
+    shape = (4, 5)
+    w = mx.nd.array(np.random.uniform(-1, 1, shape))
+    g = mx.nd.array(np.random.uniform(-1, 1, shape))
+    w0, g0 = w.asnumpy(), g.asnumpy()
+    lr, wd = 0.1, 0.01
+    with mx.nd.lazy():
+        w -= lr * (g + wd * w)
+        x = (g - 1) / 2 + w * g
+        assert isinstance(x, mx.nd.NDArray)
+        assert x.shape == shape
+        y = -g * 2
+        # y is evaluated before g is modified
+        g[:] = 3
+        # the assigned expressions can read their targets
+        z = mx.nd.zeros(shape)
+        z[:] = 1 + z * 2
+        # more operands than one kernel takes
+        s = w
+        for _ in range(40):
+            s = s * 1 + g
+        # mismatched shapes and dtypes use the eager operators
+        a = mx.nd.ones((1, 5)) + mx.nd.ones(shape)
+        b = mx.nd.ones(shape, dtype=np.float64) * 2
+    w1 = w0 - lr * (g0 + wd * w0)
+    assert reldiff(w.asnumpy(), w1) < 1e-6
+    assert reldiff(x.asnumpy(), (g0 - 1) / 2 + w1 * g0) < 1e-6
+    assert reldiff(y.asnumpy(), -g0 * 2) < 1e-6
+    assert same(g.asnumpy(), np.full(shape, 3, dtype=np.float32))
+    assert same(z.asnumpy(), np.ones(shape))
+    assert reldiff(s.asnumpy(), w1 + 40 * 3) < 1e-6
+    assert same(a.asnumpy(), np.full(shape, 2))
+    assert b.dtype == np.float64
+    assert same(b.asnumpy(), np.full(shape, 2))
+
 def test_dot():
     a = np.random.uniform(-3, 3, (3, 4))
     b = np.random.uniform(-3, 3, (4, 5))
@@ -262,13 +395,18 @@ def test_broadcast():
 
 if __name__ == '__main__':
     test_ndarray_slice()
+    test_ndarray_slice_view()
+    test_ndarray_numpy_zero_copy()
     test_ndarray_pickle()
     test_ndarray_saveload()
+    test_ndarray_save_aligned()
     test_ndarray_copy()
     test_ndarray_elementwise()
     test_ndarray_negate()
     test_ndarray_scalar()
     test_clip()
+    test_invoke_batch()
+    test_ndarray_lazy()
     test_dot()
     test_ndarray_choose()
     test_ndarray_onehot()
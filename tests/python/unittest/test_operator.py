@@ -1,4 +1,5 @@
 # pylint: skip-file
+import json
 import numpy as np
 import mxnet as mx
 import random
@@ -48,6 +49,8 @@ def test_elementwise_sum():
         for dim in range(1, maxdim):
             shape = tuple(np.random.randint(1, int(1000**(1.0/dim)), size=dim))
             check_elementwise_sum_with_shape(shape, np.random.randint(1, 8))
+    # more inputs than one gpu kernel sums, and a size not a multiple of the blocks
+    check_elementwise_sum_with_shape((3001,), 40)
 
 def check_slice_channel(dim, num):
     ins = []
@@ -257,8 +260,51 @@ def check_softmax_with_shape(shape, xpu):
     exec1.backward()
     assert_allclose(grad.asnumpy(), np_softmax(x.asnumpy()) - l.asnumpy())
 
+def check_softmax_fused_loss(xpu):
+    # the fused gradient and loss against SoftmaxOutput and numpy
+    shape = (12, 50)
+    x_np = np.random.normal(0, 3, shape)
+    l_np = np.random.randint(0, shape[1], (shape[0],))
+    l_np[:3] = 0
+    X = mx.symbol.Variable('X')
+    L = mx.symbol.Variable('L')
+    for normalization in ['null', 'batch', 'valid']:
+        grads = []
+        for fused in [False, True]:
+            Y = mx.symbol.SoftmaxOutput(data=X, label=L, ignore_label=0, use_ignore=True,
+                                        normalization=normalization, grad_scale=2.0,
+                                        fused_loss=fused)
+            grad = mx.nd.empty(shape, ctx=xpu)
+            exe = Y.bind(xpu, args=[mx.nd.array(x_np, ctx=xpu), mx.nd.array(l_np, ctx=xpu)],
+                         args_grad={'X': grad})
+            exe.forward(is_train=False)
+            prob = exe.outputs[0].asnumpy()
+            assert_allclose(prob, np_softmax(x_np), rtol=1e-5, atol=1e-7)
+            exe.forward(is_train=True)
+            exe.backward()
+            grads.append(grad.asnumpy())
+        assert reldiff(grads[0], grads[1]) < 1e-5
+    loss = exe.outputs[1].asnumpy()
+    prob = np_softmax(x_np)
+    expect = -np.log(prob[np.arange(shape[0]), l_np])
+    expect[:3] = 0
+    assert reldiff(loss, expect) < 1e-5
+    # label smoothing
+    alpha = 0.1
+    Y = mx.symbol.SoftmaxOutput(data=X, label=L, fused_loss=True, smooth_alpha=alpha)
+    grad = mx.nd.empty(shape, ctx=xpu)
+    exe = Y.bind(xpu, args=[mx.nd.array(x_np, ctx=xpu), mx.nd.array(l_np, ctx=xpu)],
+                 args_grad={'X': grad})
+    exe.forward(is_train=True)
+    exe.backward()
+    target = np.full(shape, alpha / shape[1])
+    target[np.arange(shape[0]), l_np] += 1 - alpha
+    assert reldiff(grad.asnumpy(), prob - target) < 1e-5
+    assert reldiff(exe.outputs[1].asnumpy(), -np.sum(target * np.log(prob), axis=1)) < 1e-5
+
 def test_softmax():
     check_softmax_with_shape((3, 4), mx.cpu())
+    check_softmax_fused_loss(mx.cpu())
 
 def check_multi_softmax_with_shape(shape, xpu):
     X = mx.symbol.Variable('X')
@@ -307,6 +353,18 @@ def test_swapaxes():
 
     assert reldiff(out, swap_) < 1e-6
 
+    # time/batch swap with its gradient
+    shape = (35, 40, 3)
+    data_tmp = np.random.normal(size=shape)
+    grad_tmp = np.random.normal(size=(40, 35, 3))
+    arr_grad = mx.nd.empty(shape)
+    exe = mx.symbol.SwapAxis(data=data, dim1=0, dim2=1).bind(
+        mx.cpu(), args=[mx.nd.array(data_tmp)], args_grad=[arr_grad])
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.array(grad_tmp)])
+    assert reldiff(exe.outputs[0].asnumpy(), np.swapaxes(data_tmp, 0, 1)) < 1e-6
+    assert reldiff(arr_grad.asnumpy(), np.swapaxes(grad_tmp, 0, 1)) < 1e-6
+
 def test_scalarop():
     data = mx.symbol.Variable('data')
     shape = (3, 4)
@@ -390,6 +448,69 @@ def test_embedding():
     exe_test.backward([grad])
     assert reldiff(grad_map["embed_weight"].asnumpy(), np.dot(np_onehot.T, np_grad)) < 1e-6
 
+def test_embedding_sparse_grad():
+    # only the rows of data are written, and they match the dense gradient
+    in_dim = 10
+    out_dim = 4
+    batch = 6
+    data = mx.sym.Variable("data")
+    outputs = []
+    for sparse in [False, True]:
+        embed = mx.sym.Embedding(data=data, input_dim=in_dim, output_dim=out_dim,
+                                 sparse_grad=sparse, name="embed")
+        exe = embed.simple_bind(mx.cpu(), grad_req={'data': 'null', 'embed_weight': 'write'},
+                                data=(batch,))
+        exe.arg_dict["data"][:] = np.array([1, 3, 3, 7, 1, 0])
+        exe.arg_dict["embed_weight"][:] = np.random.uniform(-1, 1, (in_dim, out_dim))
+        exe.grad_dict["embed_weight"][:] = 5
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.array(np.arange(batch * out_dim).reshape((batch, out_dim)))])
+        outputs.append(exe.grad_dict["embed_weight"].asnumpy())
+    rows = [0, 1, 3, 7]
+    assert reldiff(outputs[0][rows], outputs[1][rows]) < 1e-6
+    assert np.all(np.delete(outputs[1], rows, axis=0) == 5)
+    rs = mx.nd.row_sparse(mx.nd.array(outputs[0]), rows)
+    assert reldiff(rs.todense().asnumpy(), outputs[0]) < 1e-6
+
+def test_sparse_fully_connected():
+    in_dim = 50
+    num_hidden = 6
+    batch = 8
+    dense = np.random.uniform(-1, 1, (batch, in_dim)) * (np.random.uniform(0, 1, (batch, in_dim)) < 0.1)
+    dense[3] = 0
+    csr = mx.nd.csr_matrix(dense)
+    assert reldiff(csr.todense().asnumpy(), dense) < 1e-6
+    nnz = csr.data.shape[0]
+    # the value and index arrays are longer than the non-zeros
+    cap = nnz + 5
+    fc = mx.sym.SparseFullyConnected(data=mx.sym.Variable('data'),
+                                     indices=mx.sym.Variable('data_indices'),
+                                     indptr=mx.sym.Variable('data_indptr'),
+                                     input_dim=in_dim, num_hidden=num_hidden, name='fc')
+    assert fc.list_arguments() == ['data', 'data_indices', 'data_indptr', 'fc_weight', 'fc_bias']
+    exe = fc.simple_bind(mx.cpu(), data=(cap,), data_indptr=(batch + 1,),
+                         grad_req={'data': 'write', 'data_indices': 'null',
+                                   'data_indptr': 'null', 'fc_weight': 'write',
+                                   'fc_bias': 'write'})
+    assert exe.outputs[0].shape == (batch, num_hidden)
+    exe.arg_dict['data'][:] = np.concatenate([csr.data.asnumpy(), np.ones(5)])
+    exe.arg_dict['data_indices'][:] = np.concatenate([csr.indices.asnumpy(), np.zeros(5)])
+    exe.arg_dict['data_indptr'][:] = csr.indptr
+    weight = np.random.uniform(-1, 1, (in_dim, num_hidden))
+    bias = np.random.uniform(-1, 1, (num_hidden,))
+    exe.arg_dict['fc_weight'][:] = weight
+    exe.arg_dict['fc_bias'][:] = bias
+    exe.forward(is_train=True)
+    assert reldiff(exe.outputs[0].asnumpy(), np.dot(dense, weight) + bias) < 1e-5
+    grad = np.random.uniform(-1, 1, (batch, num_hidden))
+    exe.backward([mx.nd.array(grad)])
+    assert reldiff(exe.grad_dict['fc_weight'].asnumpy(), np.dot(dense.T, grad)) < 1e-5
+    assert reldiff(exe.grad_dict['fc_bias'].asnumpy(), grad.sum(axis=0)) < 1e-5
+    rows, cols = np.nonzero(dense)
+    gdata = exe.grad_dict['data'].asnumpy()
+    assert reldiff(gdata[:nnz], np.dot(grad, weight.T)[rows, cols]) < 1e-5
+    assert np.all(gdata[nnz:] == 0)
+
 # check ops handle duplicate input correctly.
 def test_binary_op_duplicate_input():
     data = mx.symbol.Variable('data')
@@ -713,6 +834,36 @@ def test_nearest_upsampling():
                     shapes = [(1,3,base*root_scale*scale**(num_shape-1-i),base*root_scale*scale**(num_shape-1-i)) for i in range(num_shape)]
                     check_nearest_upsampling_with_shape(shapes, scale, root_scale)
 
+def check_bilinear_upsampling_with_shape(shape, scale):
+    data = mx.random.uniform(-10.0, 10.0, shape)
+    kernel = 2 * scale - scale % 2
+    weight = mx.nd.zeros((shape[1], 1, kernel, kernel))
+    mx.init.Xavier()('upsampling_weight', weight)
+    ref = mx.sym.UpSampling(mx.sym.Variable('data'), mx.sym.Variable('upsampling_weight'),
+                            sample_type='bilinear', scale=scale, num_filter=shape[1])
+    up = mx.sym.UpSampling(mx.sym.Variable('data'), sample_type='bilinear', scale=scale,
+                           use_weight=False)
+    assert up.list_arguments() == ['data']
+    ref_grad = mx.nd.zeros(shape)
+    ref_exe = ref.bind(mx.cpu(), args={'data': data, 'upsampling_weight': weight},
+                       args_grad={'data': ref_grad},
+                       grad_req={'data': 'write', 'upsampling_weight': 'null'})
+    grad = mx.nd.zeros(shape)
+    exe = up.bind(mx.cpu(), args={'data': data}, args_grad={'data': grad})
+    ref_exe.forward(is_train=True)
+    exe.forward(is_train=True)
+    assert_allclose(ref_exe.outputs[0].asnumpy(), exe.outputs[0].asnumpy(), rtol=1e-4, atol=1e-4)
+    out_grad = mx.random.uniform(-1.0, 1.0, exe.outputs[0].shape)
+    ref_exe.backward([out_grad])
+    exe.backward([out_grad])
+    assert_allclose(ref_grad.asnumpy(), grad.asnumpy(), rtol=1e-4, atol=1e-4)
+
+
+def test_bilinear_upsampling():
+    for scale in [1, 2, 3, 4]:
+        for base in [1, 2, 5]:
+            check_bilinear_upsampling_with_shape((2, 3, base, base + 1), scale)
+
 def test_batchnorm_training():
     for shape in [(2, 3), (2, 3, 2, 2)]:
         data_tmp = np.random.normal(size=shape)
@@ -730,6 +881,136 @@ def test_batchnorm_training():
 
         check_numeric_gradient(test, [data_tmp, gamma, beta], [rolling_mean, rolling_std], numeric_eps=1e-3, check_eps=5e-2)
 
+def test_batchnorm_training_stats():
+    # batch statistics of data far from 0 and the fused backward against numpy
+    shape = (4, 3, 5, 7)
+    data = mx.symbol.Variable('data')
+    net = mx.symbol.BatchNorm(data, fix_gamma=False, eps=1e-5, name='bn')
+    x = 1000 + np.random.normal(size=shape)
+    gamma = np.random.uniform(0.5, 1.5, size=(shape[1],))
+    beta = np.random.normal(size=(shape[1],))
+    dy = np.random.normal(size=shape)
+    exe = net.simple_bind(mx.cpu(), data=shape)
+    exe.arg_dict['data'][:] = x
+    exe.arg_dict['bn_gamma'][:] = gamma
+    exe.arg_dict['bn_beta'][:] = beta
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.array(dy)])
+    axes = (0, 2, 3)
+    bshape = (1, shape[1], 1, 1)
+    mean = x.mean(axis=axes).reshape(bshape)
+    invstd = 1 / np.sqrt(x.var(axis=axes).reshape(bshape) + 1e-5)
+    xhat = (x - mean) * invstd
+    out = gamma.reshape(bshape) * xhat + beta.reshape(bshape)
+    dxhat = dy * gamma.reshape(bshape)
+    dx = invstd * (dxhat - dxhat.mean(axis=axes).reshape(bshape) -
+                   xhat * (dxhat * xhat).mean(axis=axes).reshape(bshape))
+    assert reldiff(exe.outputs[0].asnumpy(), out) < 1e-3
+    assert reldiff(exe.grad_dict['data'].asnumpy(), dx) < 1e-3
+    assert reldiff(exe.grad_dict['bn_gamma'].asnumpy(), (dy * xhat).sum(axis=axes)) < 1e-3
+    assert reldiff(exe.grad_dict['bn_beta'].asnumpy(), dy.sum(axis=axes)) < 1e-4
+
+def test_layer_norm():
+    shape = (3, 4, 37)
+    data = mx.symbol.Variable('data')
+    net = mx.symbol.LayerNorm(data, eps=1e-5, name='ln')
+    # rows far from 0 check the precision of the variance
+    x = 100 + np.random.normal(size=shape)
+    gamma = np.random.uniform(0.5, 1.5, size=(shape[-1],))
+    beta = np.random.normal(size=(shape[-1],))
+    dy = np.random.normal(size=shape)
+    exe = net.simple_bind(mx.cpu(), data=shape)
+    exe.arg_dict['data'][:] = x
+    exe.arg_dict['ln_gamma'][:] = gamma
+    exe.arg_dict['ln_beta'][:] = beta
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.array(dy)])
+    mean = x.mean(axis=-1, keepdims=True)
+    invstd = 1 / np.sqrt(x.var(axis=-1, keepdims=True) + 1e-5)
+    xhat = (x - mean) * invstd
+    dxhat = dy * gamma
+    dx = invstd * (dxhat - dxhat.mean(axis=-1, keepdims=True) -
+                   xhat * (dxhat * xhat).mean(axis=-1, keepdims=True))
+    assert reldiff(exe.outputs[0].asnumpy(), gamma * xhat + beta) < 1e-4
+    assert reldiff(exe.grad_dict['data'].asnumpy(), dx) < 1e-3
+    assert reldiff(exe.grad_dict['ln_gamma'].asnumpy(), (dy * xhat).sum(axis=(0, 1))) < 1e-3
+    assert reldiff(exe.grad_dict['ln_beta'].asnumpy(), dy.sum(axis=(0, 1))) < 1e-4
+    check_numeric_gradient(net, [np.random.normal(size=(2, 5)), gamma[:5], beta[:5]],
+                           numeric_eps=1e-3, check_eps=5e-2)
+
+def test_l2_normalization():
+    shape = (4, 3, 5)
+    data = mx.symbol.Variable('data')
+    net = mx.symbol.L2Normalization(data, eps=1e-10)
+    x = np.random.normal(size=shape)
+    dy = np.random.normal(size=shape)
+    exe = net.simple_bind(mx.cpu(), data=shape)
+    exe.arg_dict['data'][:] = x
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.array(dy)])
+    x2 = x.reshape((shape[0], -1))
+    dy2 = dy.reshape(x2.shape)
+    norm = np.sqrt((x2 * x2).sum(axis=1, keepdims=True))
+    y = x2 / norm
+    dx = (dy2 - y * (dy2 * y).sum(axis=1, keepdims=True)) / norm
+    assert reldiff(exe.outputs[0].asnumpy(), y.reshape(shape)) < 1e-5
+    assert reldiff(exe.grad_dict['data'].asnumpy(), dx.reshape(shape)) < 1e-4
+
+def test_dot_product_attention():
+    # more keys than a tile of the operator
+    B, Tq, Tk, D, Dv = 2, 5, 300, 4, 3
+    q = np.random.normal(size=(B, Tq, D))
+    k = np.random.normal(size=(B, Tk, D))
+    v = np.random.normal(size=(B, Tk, Dv))
+    length = np.array([Tk, 170])
+    dy = np.random.normal(size=(B, Tq, Dv))
+    for causal in [False, True]:
+        for use_length in [False, True]:
+            args = [mx.symbol.Variable('q'), mx.symbol.Variable('k'), mx.symbol.Variable('v')]
+            arrays = [mx.nd.array(q), mx.nd.array(k), mx.nd.array(v)]
+            if use_length:
+                args.append(mx.symbol.Variable('length'))
+                arrays.append(mx.nd.array(length))
+            net = mx.symbol.DotProductAttention(*args, causal=causal, use_length=use_length)
+            grads = [mx.nd.zeros(a.shape) for a in arrays]
+            exe = net.bind(mx.cpu(), args=arrays, args_grad=grads)
+            exe.forward(is_train=True)
+            exe.backward([mx.nd.array(dy)])
+            # reference
+            mask = np.zeros((B, Tq, Tk), dtype=bool)
+            if use_length:
+                mask |= np.arange(Tk)[None, None, :] >= length[:, None, None]
+            if causal:
+                mask |= np.arange(Tk)[None, None, :] > np.arange(Tq)[None, :, None] + Tk - Tq
+            s = np.einsum('bqd,bkd->bqk', q, k) / np.sqrt(D)
+            s = np.where(mask, -np.inf, s)
+            p = np.exp(s - s.max(axis=2, keepdims=True))
+            p /= p.sum(axis=2, keepdims=True)
+            y = np.einsum('bqk,bkd->bqd', p, v)
+            dp = np.einsum('bqd,bkd->bqk', dy, v)
+            ds = p * (dp - (dp * p).sum(axis=2, keepdims=True)) / np.sqrt(D)
+            assert reldiff(exe.outputs[0].asnumpy(), y) < 1e-5
+            assert reldiff(grads[0].asnumpy(), np.einsum('bqk,bkd->bqd', ds, k)) < 1e-4
+            assert reldiff(grads[1].asnumpy(), np.einsum('bqk,bqd->bkd', ds, q)) < 1e-4
+            assert reldiff(grads[2].asnumpy(), np.einsum('bqk,bqd->bkd', p, dy)) < 1e-4
+
+def test_softmax_activation_channel():
+    # more positions than a tile of the cpu kernel
+    shape = (2, 5, 23, 31)
+    data = mx.symbol.Variable('data')
+    net = mx.symbol.SoftmaxActivation(data, mode='channel')
+    x = 10 * np.random.normal(size=shape)
+    dy = np.random.normal(size=shape)
+    exe = net.simple_bind(mx.cpu(), data=shape)
+    exe.arg_dict['data'][:] = x
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.array(dy)])
+    e = np.exp(x - x.max(axis=1, keepdims=True))
+    y = e / e.sum(axis=1, keepdims=True)
+    dx = y * (dy - (dy * y).sum(axis=1, keepdims=True))
+    assert reldiff(exe.outputs[0].asnumpy(), y) < 1e-5
+    assert reldiff(exe.grad_dict['data'].asnumpy(), dx) < 1e-5
+
 def test_convolution_grouping():
     num_filter = 4
     num_group = 2
@@ -760,6 +1041,60 @@ def test_convolution_grouping():
     for arr1, arr2 in zip(exe1.outputs + exe1.grad_arrays, exe2.outputs + exe2.grad_arrays):
         np.testing.assert_allclose(arr1.asnumpy(), arr2.asnumpy(), rtol=1e-3)
 
+def test_convolution_depthwise():
+    # direct depthwise and grouped kernels against the per group GEMM
+    import os
+    configs = [dict(kernel=(3, 3), pad=(1, 1), num_filter=8, num_group=8),
+               dict(kernel=(3, 3), stride=(2, 2), pad=(1, 1), num_filter=16, num_group=8),
+               dict(kernel=(5, 3), dilate=(2, 1), pad=(2, 0), num_filter=8, num_group=4),
+               dict(kernel=(3, 3), stride=(2, 1), num_filter=4, num_group=2, no_bias=True)]
+    shape = (2, 8, 9, 7)
+    for config in configs:
+        net = mx.sym.Convolution(data=mx.sym.Variable('data'), name='conv', **config)
+        results = []
+        for opt in ['0', '1']:
+            os.environ['MXNET_GROUP_CONV_OPT'] = opt
+            exe = net.simple_bind(mx.cpu(), data=shape)
+            for i, arr in enumerate(exe.arg_arrays):
+                arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+            exe.forward(is_train=True)
+            exe.backward([mx.nd.array(np.cos(np.arange(exe.outputs[0].size)).reshape(
+                exe.outputs[0].shape))])
+            results.append([arr.asnumpy() for arr in exe.outputs + exe.grad_arrays])
+        for arr1, arr2 in zip(results[0], results[1]):
+            np.testing.assert_allclose(arr1, arr2, rtol=1e-4, atol=1e-5)
+    del os.environ['MXNET_GROUP_CONV_OPT']
+
+def test_pooling_cpu_opt():
+    # direct cpu pooling and LRN against the mshadow expressions
+    import os
+    configs = [dict(op='Pooling', kernel=(3, 3), stride=(2, 2), pool_type='max'),
+               dict(op='Pooling', kernel=(3, 3), pad=(1, 1), pool_type='max'),
+               dict(op='Pooling', kernel=(2, 2), stride=(2, 2), pool_type='avg'),
+               dict(op='Pooling', kernel=(3, 3), stride=(2, 2), pad=(1, 1), pool_type='max'),
+               dict(op='Pooling', kernel=(2, 3), stride=(1, 2), pad=(1, 0), pool_type='avg'),
+               dict(op='Pooling', kernel=(3, 2), pad=(0, 1), pool_type='sum'),
+               dict(op='Pooling', kernel=(1, 1), global_pool=True, pool_type='max'),
+               dict(op='LRN', nsize=3),
+               dict(op='LRN', nsize=5, alpha=0.01, beta=0.5, knorm=1.5)]
+    shape = (2, 6, 9, 7)
+    for config in configs:
+        config = dict(config)
+        op = getattr(mx.sym, config.pop('op'))
+        net = op(data=mx.sym.Variable('data'), name='op', **config)
+        results = []
+        for opt in ['0', '1']:
+            os.environ['MXNET_CPU_POOL_OPT'] = opt
+            exe = net.simple_bind(mx.cpu(), data=shape)
+            exe.arg_arrays[0][:] = np.sin(np.arange(np.prod(shape))).reshape(shape)
+            exe.forward(is_train=True)
+            exe.backward([mx.nd.array(np.cos(np.arange(exe.outputs[0].size)).reshape(
+                exe.outputs[0].shape))])
+            results.append([arr.asnumpy() for arr in exe.outputs + exe.grad_arrays])
+        for arr1, arr2 in zip(results[0], results[1]):
+            np.testing.assert_allclose(arr1, arr2, rtol=1e-4, atol=1e-5)
+    del os.environ['MXNET_CPU_POOL_OPT']
+
 def _gen_broadcast_data():
     # Generate random data that has ndim between 1-7 and all the shape dims between 1-5
     ndim = np.random.randint(1, 8)
@@ -818,6 +1153,208 @@ def _check_broadcast_op_backward(symbol, baseline):
         assert err_1 < 1e-5 and err_2 < 1e-5, 'lhs error %f, rhs error %f, shapes are %s %s' % (
             err_1, err_2, d[0].shape, d[1].shape)
 
+def test_convolution_cpu_opt():
+    # pointwise, winograd and im2col forward against the generic implementation
+    import os
+    configs = [dict(kernel=(1, 1), num_group=1),
+               dict(kernel=(1, 1), num_group=2),
+               dict(kernel=(3, 3), pad=(1, 1), num_group=1),
+               dict(kernel=(3, 3), pad=(2, 0), num_group=2),
+               dict(kernel=(3, 3), stride=(2, 2), num_group=1),
+               dict(kernel=(5, 3), dilate=(2, 1), pad=(1, 1), num_group=2),
+               dict(kernel=(1, 1), stride=(2, 2), no_bias=True, num_group=1)]
+    shape = (3, 4, 9, 7)
+    for config in configs:
+        net = mx.sym.Convolution(data=mx.sym.Variable('data'), num_filter=6, name='conv', **config)
+        outputs = []
+        for opt in ['0', '1']:
+            os.environ['MXNET_CPU_CONV_OPT'] = opt
+            exe = net.simple_bind(mx.cpu(), data=shape, grad_req='null')
+            for i, arr in enumerate(exe.arg_arrays):
+                arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+            exe.forward(is_train=False)
+            outputs.append(exe.outputs[0].asnumpy())
+        assert reldiff(outputs[0], outputs[1]) < 1e-5
+    del os.environ['MXNET_CPU_CONV_OPT']
+
+def test_fully_connected_cpu_pack():
+    # the forward on the packed weight against the blas, and after the weight changes
+    import os
+    net = mx.sym.FullyConnected(data=mx.sym.Variable('data'), num_hidden=13, name='fc')
+    for batch in [1, 3, 6]:
+        shape = (batch, 2, 5)
+        outputs = []
+        for pack in ['0', '4']:
+            os.environ['MXNET_CPU_FC_PACK_BATCH'] = pack
+            exe = net.simple_bind(mx.cpu(), data=shape, grad_req='null')
+            for i, arr in enumerate(exe.arg_arrays):
+                arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+            exe.forward(is_train=False)
+            outputs.append(exe.outputs[0].asnumpy())
+            exe.arg_dict['fc_weight'][:] = np.cos(np.arange(13 * 10)).reshape((13, 10))
+            exe.forward(is_train=False)
+            outputs.append(exe.outputs[0].asnumpy())
+        assert reldiff(outputs[0], outputs[2]) < 1e-5
+        assert reldiff(outputs[1], outputs[3]) < 1e-5
+    del os.environ['MXNET_CPU_FC_PACK_BATCH']
+
+def test_sparse_weight_cpu():
+    # the forward on the CSR weight of a pruned layer against the dense one
+    import os
+    data = mx.sym.Variable('data')
+    nets = [(mx.sym.FullyConnected(data, num_hidden=13, name='fc'), (3, 2, 5)),
+            (mx.sym.Convolution(data, num_filter=8, kernel=(3, 3), pad=(1, 1), name='conv'),
+             (2, 4, 7, 6)),
+            (mx.sym.Convolution(data, num_filter=6, kernel=(1, 1), num_group=2, name='conv'),
+             (2, 20, 5, 5))]
+    for net, shape in nets:
+        outputs = []
+        for density in ['0', '0.25']:
+            os.environ['MXNET_CPU_SPARSE_WEIGHT_DENSITY'] = density
+            exe = net.simple_bind(mx.cpu(), data=shape, grad_req='null')
+            for i, arr in enumerate(exe.arg_arrays):
+                value = np.sin(np.arange(arr.size) + i)
+                if i == 1:
+                    # keep one weight in five
+                    value[np.arange(arr.size) % 5 != 0] = 0
+                arr[:] = value.reshape(arr.shape)
+            exe.forward(is_train=False)
+            outputs.append(exe.outputs[0].asnumpy())
+            # a dense weight again
+            weight = exe.arg_arrays[1]
+            weight[:] = np.cos(np.arange(weight.size)).reshape(weight.shape)
+            exe.forward(is_train=False)
+            outputs.append(exe.outputs[0].asnumpy())
+        assert reldiff(outputs[0], outputs[2]) < 1e-5
+        assert reldiff(outputs[1], outputs[3]) < 1e-5
+    del os.environ['MXNET_CPU_SPARSE_WEIGHT_DENSITY']
+
+def _np_windows3d(x, kernel, stride, pad):
+    # (n, c, d, y, x) -> (n, c, od, oy, ox, kd, ky, kx), the padding is zero
+    x = np.pad(x, [(0, 0), (0, 0)] + [(p, p) for p in pad], 'constant')
+    oshape = [(x.shape[i + 2] - kernel[i]) // stride[i] + 1 for i in range(3)]
+    win = np.empty(x.shape[:2] + tuple(oshape) + tuple(kernel), dtype=x.dtype)
+    for od in range(oshape[0]):
+        for oy in range(oshape[1]):
+            for ox in range(oshape[2]):
+                d, y, z = od * stride[0], oy * stride[1], ox * stride[2]
+                win[:, :, od, oy, ox] = x[:, :, d:d + kernel[0], y:y + kernel[1], z:z + kernel[2]]
+    return win
+
+def test_convolution_3d():
+    kernel, stride, pad = (2, 3, 3), (1, 2, 1), (1, 1, 0)
+    x = np.random.uniform(-1, 1, (2, 3, 4, 7, 6))
+    w = np.random.uniform(-1, 1, (4, 3) + kernel)
+    b = np.random.uniform(-1, 1, (4,))
+    conv = mx.sym.Convolution(data=mx.sym.Variable('data'), num_filter=4, kernel=kernel,
+                              stride=stride, pad=pad, name='conv')
+    expected = np.einsum('ncdyxijk,fcijk->nfdyx', _np_windows3d(x, kernel, stride, pad), w)
+    expected += b.reshape((1, 4, 1, 1, 1))
+    check_symbolic_forward(conv, [x, w, b], [expected], check_eps=1e-4)
+    check_numeric_gradient(conv, [x, w, b], numeric_eps=1e-3, check_eps=5e-2)
+    # the deconvolution is the transpose of the convolution with the same weight
+    deconv = mx.sym.Deconvolution(data=mx.sym.Variable('data'), num_filter=3, kernel=kernel,
+                                  stride=stride, pad=pad, adj=(0, 0, 0), name='deconv')
+    y = np.random.uniform(-1, 1, expected.shape)
+    exe = deconv.simple_bind(mx.cpu(), data=y.shape, grad_req='null')
+    assert exe.outputs[0].shape == x.shape
+    exe.arg_dict['data'][:] = y
+    exe.arg_dict['deconv_weight'][:] = w
+    exe.forward(is_train=False)
+    assert reldiff(np.sum(exe.outputs[0].asnumpy() * x), np.sum(expected * y) -
+                   np.sum(b.reshape((1, 4, 1, 1, 1)) * y)) < 1e-4
+    check_numeric_gradient(deconv, [y, w], numeric_eps=1e-3, check_eps=5e-2)
+
+def test_pooling_3d():
+    kernel, stride, pad = (2, 3, 2), (2, 2, 1), (1, 1, 0)
+    x = np.random.uniform(-1, 1, (2, 3, 5, 7, 6))
+    win = _np_windows3d(x, kernel, stride, pad)
+    for pool_type, expected in [('max', win.max(axis=(5, 6, 7))),
+                                ('avg', win.mean(axis=(5, 6, 7))),
+                                ('sum', win.sum(axis=(5, 6, 7)))]:
+        pool = mx.sym.Pooling(data=mx.sym.Variable('data'), kernel=kernel, stride=stride,
+                              pad=pad, pool_type=pool_type)
+        check_symbolic_forward(pool, [x], [expected], check_eps=1e-4)
+        check_numeric_gradient(pool, [x], numeric_eps=1e-3, check_eps=5e-2)
+    pool = mx.sym.Pooling(data=mx.sym.Variable('data'), kernel=(1, 1, 1), global_pool=True,
+                          pool_type='avg')
+    check_symbolic_forward(pool, [x], [x.mean(axis=(2, 3, 4), keepdims=True)], check_eps=1e-4)
+
+def test_convolution_fused_activation():
+    # Convolution with act_type against Convolution followed by Activation
+    import os
+    shape = (2, 4, 9, 7)
+    data = mx.sym.Variable('data')
+    for act_type in ['relu', 'sigmoid', 'tanh', 'softrelu']:
+        for opt in ['0', '1']:
+            os.environ['MXNET_CPU_CONV_OPT'] = opt
+            outputs = []
+            for fused in [False, True]:
+                if fused:
+                    net = mx.sym.Convolution(data=data, kernel=(3, 3), pad=(1, 1), num_filter=6,
+                                             act_type=act_type, name='conv')
+                else:
+                    net = mx.sym.Convolution(data=data, kernel=(3, 3), pad=(1, 1), num_filter=6,
+                                             name='conv')
+                    net = mx.sym.Activation(data=net, act_type=act_type)
+                exe = net.simple_bind(mx.cpu(), data=shape, grad_req='null')
+                for i, arr in enumerate(exe.arg_arrays):
+                    arr[:] = np.sin(np.arange(arr.size) + i).reshape(arr.shape)
+                exe.forward(is_train=False)
+                outputs.append(exe.outputs[0].asnumpy())
+            assert reldiff(outputs[0], outputs[1]) < 1e-5
+    del os.environ['MXNET_CPU_CONV_OPT']
+
+def test_image_normalize():
+    data = mx.sym.Variable('data', dtype='uint8')
+    net = mx.sym.ImageNormalize(data=data, mean_r=123.0, mean_g=117.0, mean_b=104.0,
+                                scale=0.5, mirror=True)
+    shape = (2, 3, 4, 5)
+    exe = net.simple_bind(mx.cpu(), data=shape, grad_req='null')
+    assert exe.arg_dict['data'].dtype == np.uint8
+    images = np.random.randint(0, 256, shape).astype(np.uint8)
+    exe.arg_dict['data'][:] = images
+    exe.forward(is_train=False)
+    mean = np.array([123.0, 117.0, 104.0]).reshape((1, 3, 1, 1))
+    expect = ((images.astype(np.float32) - mean) * 0.5)[:, :, :, ::-1]
+    assert reldiff(exe.outputs[0].asnumpy(), expect) < 1e-6
+
+def test_quantization():
+    # int8 network from calibration against the float32 network
+    from mxnet import quantization
+    data = mx.sym.Variable('data')
+    net = mx.sym.Convolution(data=data, kernel=(3, 3), pad=(1, 1), num_filter=8, name='conv')
+    net = mx.sym.Activation(data=net, act_type='relu', name='relu')
+    net = mx.sym.Pooling(data=net, kernel=(2, 2), stride=(2, 2), pool_type='max', name='pool')
+    net = mx.sym.FullyConnected(data=net, num_hidden=5, name='fc')
+    shape = (4, 3, 8, 8)
+    exe = net.simple_bind(mx.cpu(), data=shape, grad_req='null')
+    arg_params = {}
+    for i, name in enumerate(net.list_arguments()):
+        if name != 'data':
+            arr = exe.arg_dict[name]
+            arg_params[name] = mx.nd.array(np.sin(np.arange(arr.size) + i).reshape(arr.shape))
+    x = np.random.uniform(-1, 1, (16,) + shape[1:])
+    calib = mx.io.NDArrayIter(x, np.zeros(16), batch_size=shape[0])
+    ranges = quantization.calibrate(net, arg_params, {}, calib)
+    assert 'data' in ranges and 'conv_output' in ranges
+    qnet, qarg_params, _ = quantization.quantize_model(net, arg_params, {}, ranges)
+    assert qnet.list_arguments() == net.list_arguments()
+    assert qnet.list_outputs() == net.list_outputs()
+    ops = [node['op'] for node in json.loads(qnet.tojson())['nodes']]
+    for op in ['QuantizedConvolution', 'QuantizedPooling', 'QuantizedFullyConnected']:
+        assert op in ops
+    assert qarg_params['conv_weight'].dtype == np.uint8
+    outputs = []
+    for symbol, params in [(net, arg_params), (qnet, qarg_params)]:
+        exe = symbol.simple_bind(mx.cpu(), grad_req='null', type_dict={'data': np.float32},
+                                 data=shape)
+        exe.copy_params_from(params)
+        exe.arg_dict['data'][:] = x[:shape[0]]
+        exe.forward(is_train=False)
+        outputs.append(exe.outputs[0].asnumpy())
+    assert reldiff(outputs[0], outputs[1]) < 0.05
+
 def test_broadcast_binary_op():
     a = mx.sym.Variable('a')
     b = mx.sym.Variable('b')
@@ -1046,6 +1583,37 @@ def test_broadcast():
         test_broadcasting_ele(sym_bcast_axis)
         test_broadcasting_ele(sym_bcast_to)
 
+def test_reduce_broadcast_high_ndim():
+    # ndim beyond MXNET_SPECIAL_MAX_NDIM with non-contiguous axes
+    for i in range(20):
+        ndim = np.random.randint(8, 11)
+        shape = np.random.randint(1, 4, size=(ndim,))
+        axes = tuple(ax for ax in range(ndim) if np.random.randint(0, 2)) or (0,)
+        keepdims = np.random.randint(0, 2)
+        dat_npy = np.random.rand(*shape)
+        for mx_func, np_func in [(mx.nd.sum, np.sum), (mx.nd.max, np.max), (mx.nd.min, np.min)]:
+            out = mx_func(mx.nd.array(dat_npy), axis=axes, keepdims=keepdims).asnumpy()
+            groundtruth = _np_reduce(dat_npy, axes, keepdims, np_func)
+            assert reldiff(out.reshape(groundtruth.shape), groundtruth) < 1E-4
+        rhs_shape = shape.copy()
+        for ax in axes:
+            rhs_shape[ax] = 1
+        rhs_npy = np.random.rand(*rhs_shape)
+        a = mx.sym.Variable('a')
+        b = mx.sym.Variable('b')
+        c = mx.sym.broadcast_mul(a, b)
+        grad_a = mx.nd.empty(shape)
+        grad_b = mx.nd.empty(rhs_shape)
+        net = c.bind(mx.cpu(), args={'a': mx.nd.array(dat_npy), 'b': mx.nd.array(rhs_npy)},
+                     args_grad={'a': grad_a, 'b': grad_b})
+        net.forward(is_train=True)
+        assert reldiff(net.outputs[0].asnumpy(), dat_npy * rhs_npy) < 1E-4
+        outgrad_npy = np.random.rand(*shape)
+        net.backward(out_grads=mx.nd.array(outgrad_npy))
+        assert reldiff(grad_a.asnumpy(), outgrad_npy * rhs_npy) < 1E-4
+        assert reldiff(grad_b.asnumpy(),
+                       _np_reduce(outgrad_npy * dat_npy, axes, 1, np.sum)) < 1E-4
+
 def test_transpose():
     for ndim in range(1, 6):
         for t in range(5):
@@ -1059,6 +1627,13 @@ def test_transpose():
 
             y = mx.nd.transpose(x)
             assert_allclose(np.transpose(x.asnumpy()), y.asnumpy())
+    # shapes that span several tiles, with dims of size 1 and merged dims
+    for dims, axes in [((70, 45), (1, 0)), ((3, 40, 33), (2, 1, 0)),
+                       ((2, 1, 50, 37), (3, 1, 0, 2)), ((4, 5, 6, 35), (2, 3, 0, 1)),
+                       ((2, 3, 1, 4, 2, 3, 2), (6, 0, 1, 5, 2, 3, 4))]:
+        x = mx.nd.array(np.random.normal(size=dims))
+        y = mx.nd.transpose(x, axes=axes)
+        assert_allclose(np.transpose(x.asnumpy(), axes=axes), y.asnumpy())
 
 
 def test_expand_dims():
@@ -1368,6 +1943,43 @@ def test_correlation():
     unittest_correlation((5,1,4,4), kernel_size = 3,max_displacement = 1,stride1 = 2,stride2 = 1,pad_size = 2,is_multiply = False)
     unittest_correlation((5,1,6,4), kernel_size = 3,max_displacement = 1,stride1 = 2,stride2 = 1,pad_size = 2,is_multiply = False)
     unittest_correlation((5,1,11,11), kernel_size = 5,max_displacement = 1,stride1 = 1,stride2 = 1,pad_size = 2,is_multiply = False)
+    unittest_correlation((2,3,8,8), kernel_size = 3,max_displacement = 2,stride1 = 1,stride2 = 1,pad_size = 3,is_multiply = True)
+    unittest_correlation((2,3,8,8), kernel_size = 3,max_displacement = 2,stride1 = 1,stride2 = 2,pad_size = 3,is_multiply = False)
+
+def test_roipooling():
+    data = np.random.normal(size=(2, 3, 12, 10))
+    rois = np.array([[0, 0, 0, 9, 11], [1, 2, 3, 7, 8], [0, 4, 4, 4, 4], [1, 1, 0, 8, 5]])
+    pooled_size = (3, 2)
+    spatial_scale = 0.5
+    net = mx.sym.ROIPooling(data=mx.sym.Variable('data'), rois=mx.sym.Variable('rois'),
+                            pooled_size=pooled_size, spatial_scale=spatial_scale)
+    exe = net.simple_bind(mx.cpu(), data=data.shape, rois=rois.shape)
+    exe.arg_dict['data'][:] = data
+    exe.arg_dict['rois'][:] = rois
+    exe.forward(is_train=True)
+    ograd = np.random.normal(size=exe.outputs[0].shape)
+    exe.backward([mx.nd.array(ograd)])
+    # python forward and backward
+    out = np.zeros(exe.outputs[0].shape)
+    grad = np.zeros(data.shape)
+    for n, roi in enumerate(rois):
+        b = int(roi[0])
+        x1, y1, x2, y2 = [int(np.round(v * spatial_scale)) for v in roi[1:]]
+        bin_h = max(y2 - y1 + 1, 1) / float(pooled_size[0])
+        bin_w = max(x2 - x1 + 1, 1) / float(pooled_size[1])
+        for ph in range(pooled_size[0]):
+            for pw in range(pooled_size[1]):
+                hs = min(max(int(np.floor(ph * bin_h)) + y1, 0), data.shape[2])
+                he = min(max(int(np.ceil((ph + 1) * bin_h)) + y1, 0), data.shape[2])
+                ws = min(max(int(np.floor(pw * bin_w)) + x1, 0), data.shape[3])
+                we = min(max(int(np.ceil((pw + 1) * bin_w)) + x1, 0), data.shape[3])
+                for c in range(data.shape[1]):
+                    patch = data[b, c, hs:he, ws:we]
+                    idx = np.unravel_index(np.argmax(patch), patch.shape)
+                    out[n, c, ph, pw] = patch[idx]
+                    grad[b, c, hs + idx[0], ws + idx[1]] += ograd[n, c, ph, pw]
+    assert reldiff(exe.outputs[0].asnumpy(), out) < 1e-5
+    assert reldiff(exe.grad_dict['data'].asnumpy(), grad) < 1e-5
     
 def test_dot(ctx=mx.cpu()):
     for m in range(1, 5):
@@ -1419,6 +2031,41 @@ def test_batch_dot(ctx=mx.cpu()):
                     assert reldiff(exe.grad_dict['b'].asnumpy(), bgrad_npy) < 1E-3
 
 
+def test_dot_transpose(ctx=mx.cpu()):
+    # transpose flags of dot and batch_dot, with float64 and float16 inputs
+    def npdot(a, b, ta, tb):
+        a = np.swapaxes(a, -1, -2) if ta else a
+        b = np.swapaxes(b, -1, -2) if tb else b
+        return np.matmul(a, b)
+    for dtype, tol in [(np.float32, 1e-5), (np.float64, 1e-10), (np.float16, 1e-2)]:
+        for ta in [False, True]:
+            for tb in [False, True]:
+                for batch in [0, 3]:
+                    m, k, n = 5, 4, 6
+                    ashape = (k, m) if ta else (m, k)
+                    bshape = (n, k) if tb else (k, n)
+                    if batch:
+                        ashape, bshape = (batch,) + ashape, (batch,) + bshape
+                    a_npy = np.random.normal(0, 1, ashape).astype(dtype)
+                    b_npy = np.random.normal(0, 1, bshape).astype(dtype)
+                    c_npy = npdot(a_npy, b_npy, ta, tb)
+                    ograd_npy = np.random.normal(0, 1, c_npy.shape).astype(dtype)
+                    a_grad = npdot(ograd_npy, b_npy, False, not tb)
+                    a_grad = np.swapaxes(a_grad, -1, -2) if ta else a_grad
+                    b_grad = npdot(a_npy, ograd_npy, not ta, False)
+                    b_grad = np.swapaxes(b_grad, -1, -2) if tb else b_grad
+                    op = mx.sym.batch_dot if batch else mx.sym.dot
+                    c = op(mx.sym.Variable('a'), mx.sym.Variable('b'),
+                           transpose_a=ta, transpose_b=tb)
+                    exe = c.simple_bind(ctx=ctx, a=ashape, b=bshape,
+                                        type_dict={'a': dtype, 'b': dtype})
+                    outputs = exe.forward(is_train=True, a=a_npy, b=b_npy)
+                    assert reldiff(outputs[0].asnumpy(), c_npy) < tol
+                    exe.backward(out_grads=[mx.nd.array(ograd_npy, ctx=ctx, dtype=dtype)])
+                    assert reldiff(exe.grad_dict['a'].asnumpy(), a_grad) < tol
+                    assert reldiff(exe.grad_dict['b'].asnumpy(), b_grad) < tol
+
+
 def test_support_vector_machine_l1_svm():
     xpu = mx.cpu()
     shape = (20, 10)
@@ -1476,6 +2123,325 @@ def test_support_vector_machine_l2_svm():
     grad_np = grad_np.astype(np.float32)
     assert_allclose(grad_np, grad.asnumpy())
 
+def np_rnn(mode, x, params, hx, cx, state_size, num_layers, bidirectional):
+    """numpy reference of the RNN operator, returns the output and the final states"""
+    sigmoid = lambda v: 1. / (1. + np.exp(-v))
+    T, N, I = x.shape
+    H, D = state_size, 2 if bidirectional else 1
+    G = {'lstm': 4, 'gru': 3}.get(mode, 1)
+    pos, weights = 0, []
+    for l in range(num_layers):
+        width = I if l == 0 else D * H
+        for d in range(D):
+            wx = params[pos:pos + G * H * width].reshape(G * H, width)
+            pos += G * H * width
+            wh = params[pos:pos + G * H * H].reshape(G * H, H)
+            pos += G * H * H
+            weights.append([wx, wh])
+    for w in weights:
+        w += [params[pos:pos + G * H], params[pos + G * H:pos + 2 * G * H]]
+        pos += 2 * G * H
+    hy, cy = np.zeros_like(hx), np.zeros_like(hx)
+    inp = x
+    for l in range(num_layers):
+        out = np.zeros((T, N, D * H))
+        for d in range(D):
+            wx, wh, bx, bh = weights[l * D + d]
+            h, c = hx[l * D + d], cx[l * D + d] if cx is not None else None
+            steps = range(T) if d == 0 else reversed(range(T))
+            for t in steps:
+                xp, hp = np.dot(inp[t], wx.T) + bx, np.dot(h, wh.T) + bh
+                if mode == 'lstm':
+                    i, f = sigmoid(xp[:, :H] + hp[:, :H]), sigmoid(xp[:, H:2*H] + hp[:, H:2*H])
+                    g, o = np.tanh(xp[:, 2*H:3*H] + hp[:, 2*H:3*H]), sigmoid(xp[:, 3*H:] + hp[:, 3*H:])
+                    c = f * c + i * g
+                    h = o * np.tanh(c)
+                elif mode == 'gru':
+                    r, z = sigmoid(xp[:, :H] + hp[:, :H]), sigmoid(xp[:, H:2*H] + hp[:, H:2*H])
+                    n = np.tanh(xp[:, 2*H:] + r * hp[:, 2*H:])
+                    h = (1 - z) * n + z * h
+                elif mode == 'rnn_tanh':
+                    h = np.tanh(xp + hp)
+                else:
+                    h = np.maximum(xp + hp, 0)
+                out[t, :, d * H:(d + 1) * H] = h
+            hy[l * D + d] = h
+            if c is not None:
+                cy[l * D + d] = c
+        inp = out
+    return out, hy, cy
+
+def test_rnn():
+    T, N, I, H = 3, 2, 4, 3
+    for mode in ['rnn_relu', 'rnn_tanh', 'lstm', 'gru']:
+        for num_layers, bidirectional in [(1, False), (2, True)]:
+            sym = mx.sym.RNN(data=mx.sym.Variable('data'), state_size=H, num_layers=num_layers,
+                             bidirectional=bidirectional, mode=mode, state_outputs=True,
+                             name='rnn')
+            arg_shapes, out_shapes, _ = sym.infer_shape(data=(T, N, I))
+            location = [np.random.uniform(-0.5, 0.5, s) for s in arg_shapes]
+            cx = location[3] if mode == 'lstm' else None
+            out, hy, cy = np_rnn(mode, location[0], location[1], location[2], cx,
+                                 H, num_layers, bidirectional)
+            expected = [out, hy, cy] if mode == 'lstm' else [out, hy]
+            check_symbolic_forward(sym, location, expected, check_eps=1e-4)
+            # the gradients through the output only
+            sym = mx.sym.RNN(data=mx.sym.Variable('data'), state_size=H, num_layers=num_layers,
+                             bidirectional=bidirectional, mode=mode, name='rnn')
+            check_numeric_gradient(sym, location, numeric_eps=1e-3, check_eps=5e-2)
+
+
+def test_rnn_sequence_length():
+    T, N, I, H = 4, 3, 2, 3
+    for mode in ['rnn_relu', 'rnn_tanh', 'lstm', 'gru']:
+        for num_layers, bidirectional in [(1, False), (2, True)]:
+            # sorted and unsorted batches
+            for lens in [[4, 2, 1], [1, 4, 3]]:
+                sym = mx.sym.RNN(data=mx.sym.Variable('data'), state_size=H,
+                                 num_layers=num_layers, bidirectional=bidirectional, mode=mode,
+                                 state_outputs=True, use_sequence_length=True, name='rnn')
+                assert sym.list_arguments()[-1] == 'rnn_sequence_length'
+                arg_shapes, _, _ = sym.infer_shape(data=(T, N, I))
+                location = [np.random.uniform(-0.5, 0.5, s) for s in arg_shapes[:-1]]
+                location.append(np.array(lens, dtype=np.float32))
+                x, params, hx = location[0], location[1], location[2]
+                cx = location[3] if mode == 'lstm' else None
+                # each sequence alone, without its padding
+                D = 2 if bidirectional else 1
+                out, hy, cy = np.zeros((T, N, D * H)), np.zeros_like(hx), np.zeros_like(hx)
+                for n, l in enumerate(lens):
+                    o, h, c = np_rnn(mode, x[:l, n:n + 1], params, hx[:, n:n + 1],
+                                     cx[:, n:n + 1] if cx is not None else None,
+                                     H, num_layers, bidirectional)
+                    out[:l, n], hy[:, n], cy[:, n] = o[:, 0], h[:, 0], c[:, 0]
+                expected = [out, hy, cy] if mode == 'lstm' else [out, hy]
+                check_symbolic_forward(sym, location, expected, check_eps=1e-4)
+                sym = mx.sym.RNN(data=mx.sym.Variable('data'), state_size=H,
+                                 num_layers=num_layers, bidirectional=bidirectional, mode=mode,
+                                 use_sequence_length=True, name='rnn')
+                check_numeric_gradient(sym, location, numeric_eps=1e-3, check_eps=5e-2)
+
+
+def test_sequence_mask_last():
+    T, N, K = 4, 3, 2
+    lens = np.array([4, 1, 2], dtype=np.float32)
+    x = np.random.uniform(-1, 1, (T, N, K))
+    og = np.random.uniform(-1, 1, (T, N, K))
+    data, length = mx.sym.Variable('data'), mx.sym.Variable('sequence_length')
+    sym = mx.sym.SequenceMask(data=data, sequence_length=length, use_sequence_length=True,
+                              value=-1)
+    mask = (np.arange(T).reshape(T, 1) < lens.reshape(1, N)).reshape(T, N, 1)
+    check_symbolic_forward(sym, [x, lens], [np.where(mask, x, -1)])
+    check_symbolic_backward(sym, [x, lens], [og], [np.where(mask, og, 0), np.zeros(N)])
+    sym = mx.sym.SequenceMask(data=data)
+    check_symbolic_forward(sym, [x], [x])
+
+    sym = mx.sym.SequenceLast(data=data, sequence_length=length, use_sequence_length=True)
+    last = lens.astype(np.int32) - 1
+    check_symbolic_forward(sym, [x, lens], [x[last, np.arange(N)]])
+    dx = np.zeros_like(x)
+    dx[last, np.arange(N)] = og[0]
+    check_symbolic_backward(sym, [x, lens], [og[0]], [dx, np.zeros(N)])
+    sym = mx.sym.SequenceLast(data=data)
+    check_symbolic_forward(sym, [x], [x[-1]])
+
+def test_transcendental_cpu():
+    # odd sizes cover the tails of the vectorized kernels
+    for shape in [(7,), (3, 37), (2, 5000)]:
+        x = np.random.uniform(-20, 20, shape).astype(np.float32)
+        pos = np.random.uniform(1e-6, 100, shape).astype(np.float32)
+        assert_allclose(mx.nd.exp(mx.nd.array(x)).asnumpy(), np.exp(x), rtol=1e-5)
+        assert_allclose(mx.nd.log(mx.nd.array(pos)).asnumpy(), np.log(pos), rtol=1e-5, atol=1e-6)
+        data = mx.sym.Variable('data')
+        for act_type, ref in [('sigmoid', lambda v: 1 / (1 + np.exp(-v))),
+                              ('tanh', np.tanh),
+                              ('softrelu', lambda v: np.log1p(np.exp(v)))]:
+            sym = mx.sym.Activation(data=data, act_type=act_type)
+            check_symbolic_forward(sym, [x], [ref(x.astype(np.float64))], check_eps=1e-5)
+    special = mx.nd.array(np.array([0, -1, np.inf, np.nan, 1e-40], dtype=np.float32))
+    out = mx.nd.log(special).asnumpy()
+    assert out[0] == -np.inf and np.isnan(out[1]) and out[2] == np.inf and np.isnan(out[3])
+    assert_allclose(out[4], np.log(1e-40), rtol=1e-5)
+    out = mx.nd.exp(mx.nd.array(np.array([-np.inf, np.inf, np.nan, -100], dtype=np.float32)))
+    out = out.asnumpy()
+    assert out[0] == 0 and out[1] == np.inf and np.isnan(out[2])
+    assert_allclose(out[3], np.exp(-100.0), rtol=1e-3)
+
+
+def test_take():
+    a = np.random.normal(size=(3, 7, 4))
+    idx = np.array([[6, 0, 2], [2, 9, -1]])
+    for axis, mode in [(1, 'clip'), (-1, 'wrap'), (0, 'clip')]:
+        ax = axis % a.ndim
+        ref_idx = (np.clip(idx, 0, a.shape[ax] - 1) if mode == 'clip'
+                   else np.mod(idx, a.shape[ax]))
+        y = np.take(a, ref_idx, axis=ax)
+        out = mx.nd.take(mx.nd.array(a), mx.nd.array(idx), axis=axis, mode=mode)
+        assert reldiff(out.asnumpy(), y) < 1e-6
+        # the gradient adds the repeated indices
+        net = mx.symbol.take(mx.symbol.Variable('a'), mx.symbol.Variable('idx'),
+                             axis=axis, mode=mode)
+        dy = np.random.normal(size=y.shape)
+        grads = [mx.nd.zeros(a.shape), mx.nd.zeros(idx.shape)]
+        exe = net.bind(mx.cpu(), args=[mx.nd.array(a), mx.nd.array(idx)], args_grad=grads)
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.array(dy)])
+        da = np.zeros(a.shape)
+        da_view = np.moveaxis(da, ax, 0)
+        np.add.at(da_view, ref_idx, np.moveaxis(dy, list(range(ax, ax + idx.ndim)),
+                                                list(range(idx.ndim))))
+        assert reldiff(grads[0].asnumpy(), da) < 1e-5
+        assert np.all(grads[1].asnumpy() == 0)
+    # scatter_add is the gradient of take
+    data = np.random.normal(size=(2, 2, 3, 5))
+    out = mx.nd.scatter_add(mx.nd.array(data), mx.nd.array(idx), axis=1, axis_size=10)
+    ref = np.zeros((2, 10, 5))
+    for i in range(2):
+        np.add.at(ref[i], idx.clip(0, 9).ravel(), data[i].reshape(-1, 5))
+    assert out.shape == (2, 10, 5)
+    assert reldiff(out.asnumpy(), ref) < 1e-5
+    net = mx.symbol.scatter_add(mx.symbol.Variable('data'), mx.symbol.Variable('idx'),
+                                axis=1, axis_size=10)
+    grads = [mx.nd.zeros(data.shape), mx.nd.zeros(idx.shape)]
+    exe = net.bind(mx.cpu(), args=[mx.nd.array(data), mx.nd.array(idx)], args_grad=grads)
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.array(ref)])
+    assert reldiff(grads[0].asnumpy(), np.take(ref, idx.clip(0, 9), axis=1)) < 1e-5
+    # batch_take
+    a = np.random.normal(size=(5, 4))
+    idx = np.array([0, 3, 1, 7, 2])
+    out = mx.nd.batch_take(mx.nd.array(a), mx.nd.array(idx))
+    assert reldiff(out.asnumpy(), a[np.arange(5), idx.clip(0, 3)]) < 1e-6
+    net = mx.symbol.batch_take(mx.symbol.Variable('a'), mx.symbol.Variable('idx'))
+    dy = np.random.normal(size=(5,))
+    grads = [mx.nd.zeros(a.shape), mx.nd.zeros(idx.shape)]
+    exe = net.bind(mx.cpu(), args=[mx.nd.array(a), mx.nd.array(idx)], args_grad=grads)
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.array(dy)])
+    da = np.zeros(a.shape)
+    da[np.arange(5), idx.clip(0, 3)] = dy
+    assert reldiff(grads[0].asnumpy(), da) < 1e-6
+
+def test_order():
+    a = np.random.permutation(3 * 7 * 5).reshape(3, 7, 5).astype(np.float32)
+    nd = mx.nd.array(a)
+    for axis in [0, 1, -1]:
+        order = np.argsort(-a, axis=axis)
+        k = 2
+        idx = mx.nd.topk(nd, axis=axis, k=k).asnumpy()
+        assert same(idx, np.take(order, np.arange(k), axis=axis))
+        val = mx.nd.topk(nd, axis=axis, k=k, ret_typ='value').asnumpy()
+        assert same(val, -np.take(np.sort(-a, axis=axis), np.arange(k), axis=axis))
+        mask = mx.nd.topk(nd, axis=axis, k=k, ret_typ='mask').asnumpy()
+        assert same(mask, (np.argsort(order, axis=axis) < k).astype(np.float32))
+        smallest = mx.nd.topk(nd, axis=axis, k=k, is_ascend=True).asnumpy()
+        assert same(smallest, np.take(np.argsort(a, axis=axis), np.arange(k), axis=axis))
+        assert same(mx.nd.sort(nd, axis=axis).asnumpy(), np.sort(a, axis=axis))
+        assert same(mx.nd.sort(nd, axis=axis, is_ascend=False).asnumpy(),
+                    -np.sort(-a, axis=axis))
+        assert same(mx.nd.argsort(nd, axis=axis).asnumpy(), np.argsort(a, axis=axis))
+    # equal values keep the order of their positions
+    b = mx.nd.array(np.array([[1, 3, 3, 2, 3]], dtype=np.float32))
+    assert same(mx.nd.topk(b, k=3).asnumpy(), [[1, 2, 4]])
+    # the gradient of the values goes to the chosen positions
+    data = mx.sym.Variable('data')
+    sym = mx.sym.topk(data, axis=1, k=3, ret_typ='value')
+    x = np.random.permutation(4 * 6).reshape(4, 6).astype(np.float32)
+    og = np.random.uniform(-1, 1, (4, 3))
+    expected = np.zeros_like(x)
+    pos = np.argsort(-x, axis=1)[:, :3]
+    for r in range(4):
+        expected[r, pos[r]] = og[r]
+    check_symbolic_backward(sym, [x], [og], [expected])
+
+
+def np_nms(boxes, scores, ids, thresh, offset):
+    keep = []
+    removed = np.zeros(len(boxes), dtype=bool)
+    for i in range(len(boxes)):
+        if removed[i]:
+            continue
+        keep.append(i)
+        w = np.minimum(boxes[i, 2], boxes[:, 2]) - np.maximum(boxes[i, 0], boxes[:, 0]) + offset
+        h = np.minimum(boxes[i, 3], boxes[:, 3]) - np.maximum(boxes[i, 1], boxes[:, 1]) + offset
+        inter = np.maximum(w, 0) * np.maximum(h, 0)
+        area = (boxes[:, 2] - boxes[:, 0] + offset) * (boxes[:, 3] - boxes[:, 1] + offset)
+        union = area[i] + area - inter
+        suppressed = (inter > thresh * union) & (ids == ids[i])
+        suppressed[:i + 1] = False
+        removed |= suppressed
+    return keep
+
+def test_box_nms():
+    np.random.seed(0)
+    corners = np.random.uniform(0, 1, (2, 3, 20, 4)).astype(np.float32)
+    corners[..., 2:] += corners[..., :2]
+    score = np.random.permutation(2 * 3 * 20).reshape(2, 3, 20, 1).astype(np.float32) - 10
+    cls = np.random.randint(0, 3, (2, 3, 20, 1)).astype(np.float32)
+    a = np.concatenate([cls, score, corners], axis=-1)
+    for id_index, topk in [(-1, -1), (0, 12)]:
+        out = mx.nd.BoxNMS(mx.nd.array(a), overlap_thresh=0.3, valid_thresh=0, topk=topk,
+                           coord_start=2, score_index=1, id_index=id_index).asnumpy()
+        expected = -np.ones_like(a)
+        for b in np.ndindex(2, 3):
+            rows = a[b][np.argsort(-a[b][:, 1], kind='mergesort')]
+            rows = rows[:topk] if topk > 0 else rows
+            ids = rows[:, 0] if id_index >= 0 else np.zeros(len(rows))
+            keep = [k for k in np_nms(rows[:, 2:], rows[:, 1], ids, 0.3, 0)
+                    if rows[k, 1] >= 0]
+            expected[b][:len(keep)] = rows[keep]
+        assert same(out, expected)
+
+def test_proposal():
+    np.random.seed(0)
+    A, H, W, stride = 9, 6, 8, 16
+    cls_prob = np.random.uniform(0, 1, (2, 2 * A, H, W)).astype(np.float32)
+    bbox_pred = np.random.uniform(-0.3, 0.3, (2, 4 * A, H, W)).astype(np.float32)
+    im_info = np.array([[90, 120, 1], [80, 110, 0.5]], dtype=np.float32)
+    pre, post = 200, 30
+    out, score = mx.nd.Proposal(mx.nd.array(cls_prob), mx.nd.array(bbox_pred),
+                                mx.nd.array(im_info), rpn_pre_nms_top_n=pre,
+                                rpn_post_nms_top_n=post, threshold=0.7, rpn_min_size=8,
+                                feature_stride=stride, output_score=True)
+    out, score = out.asnumpy(), score.asnumpy()
+    assert out.shape == (2 * post, 5) and score.shape == (2 * post, 1)
+    # the anchors of example/rcnn
+    anchors = []
+    for ratio in [0.5, 1, 2]:
+        ws = np.round(np.sqrt(stride * stride / ratio))
+        hs = np.round(ws * ratio)
+        for scale in [8, 16, 32]:
+            w, h = ws * scale, hs * scale
+            c = 0.5 * (stride - 1)
+            anchors.append([c - 0.5 * (w - 1), c - 0.5 * (h - 1),
+                            c + 0.5 * (w - 1), c + 0.5 * (h - 1)])
+    anchors = np.array(anchors)
+    sx, sy = np.meshgrid(np.arange(W) * stride, np.arange(H) * stride)
+    shifts = np.stack([sx, sy, sx, sy], axis=-1).reshape(-1, 1, 4)
+    anchors = (anchors.reshape(1, A, 4) + shifts).reshape(-1, 4)
+    for b in range(2):
+        d = bbox_pred[b].reshape(A, 4, H, W).transpose(2, 3, 0, 1).reshape(-1, 4)
+        s = cls_prob[b, A:].transpose(1, 2, 0).reshape(-1)
+        w = anchors[:, 2] - anchors[:, 0] + 1
+        h = anchors[:, 3] - anchors[:, 1] + 1
+        cx = anchors[:, 0] + 0.5 * (w - 1) + d[:, 0] * w
+        cy = anchors[:, 1] + 0.5 * (h - 1) + d[:, 1] * h
+        pw, ph = np.exp(d[:, 2]) * w, np.exp(d[:, 3]) * h
+        boxes = np.stack([cx - 0.5 * (pw - 1), cy - 0.5 * (ph - 1),
+                          cx + 0.5 * (pw - 1), cy + 0.5 * (ph - 1)], axis=1)
+        boxes[:, 0::2] = np.clip(boxes[:, 0::2], 0, im_info[b, 1] - 1)
+        boxes[:, 1::2] = np.clip(boxes[:, 1::2], 0, im_info[b, 0] - 1)
+        min_size = 8 * im_info[b, 2]
+        small = ((boxes[:, 2] - boxes[:, 0] + 1 < min_size) |
+                 (boxes[:, 3] - boxes[:, 1] + 1 < min_size))
+        s = np.where(small, -1, s)
+        order = np.argsort(-s, kind='mergesort')[:pre]
+        keep = np_nms(boxes[order], s[order], np.zeros(pre), 0.7, 1)[:post]
+        keep = order[np.resize(keep, post)]
+        assert np.all(out[b * post:(b + 1) * post, 0] == b)
+        assert reldiff(out[b * post:(b + 1) * post, 1:], boxes[keep]) < 1e-4
+        assert reldiff(score[b * post:(b + 1) * post, 0], s[keep]) < 1e-6
+
 
 if __name__ == '__main__':
     test_expand_dims()
@@ -1485,8 +2451,16 @@ if __name__ == '__main__':
     test_flip()
     test_crop()
     test_transpose()
+    test_batchnorm_training_stats()
+    test_layer_norm()
+    test_l2_normalization()
+    test_dot_product_attention()
+    test_softmax_activation_channel()
     test_convolution_grouping()
+    test_convolution_depthwise()
+    test_pooling_cpu_opt()
     test_nearest_upsampling()
+    test_bilinear_upsampling()
     test_binary_op_duplicate_input()
     test_elementwise_sum()
     test_concat()
@@ -1499,6 +2473,8 @@ if __name__ == '__main__':
     test_symbol_pow()
     test_pow_fn()
     test_embedding()
+    test_embedding_sparse_grad()
+    test_sparse_fully_connected()
     test_rsqrt_cos_sin()
     test_maximum_minimum()
     test_maximum_minimum_scalar()
@@ -1508,12 +2484,31 @@ if __name__ == '__main__':
     test_batchnorm_training()
     check_softmax_with_ignore_label(mx.cpu())
     test_convolution_dilated_impulse_response()
+    test_convolution_cpu_opt()
+    test_fully_connected_cpu_pack()
+    test_sparse_weight_cpu()
+    test_convolution_3d()
+    test_pooling_3d()
+    test_convolution_fused_activation()
+    test_quantization()
+    test_image_normalize()
     test_reshape()
     test_reduce()
     test_broadcast()
+    test_reduce_broadcast_high_ndim()
     test_stn()
     test_dot()
     test_batch_dot()
+    test_dot_transpose()
     test_correlation()
+    test_roipooling()
     test_support_vector_machine_l1_svm()
     test_support_vector_machine_l2_svm()
+    test_rnn()
+    test_rnn_sequence_length()
+    test_sequence_mask_last()
+    test_transcendental_cpu()
+    test_order()
+    test_take()
+    test_box_nms()
+    test_proposal()
@@ -0,0 +1,66 @@
+# pylint: skip-file
+import pickle
+import mxnet as mx
+import numpy as np
+
+shape = (3, 5)
+
+def compare_optimizer(opt1, opt2, num_weights=3, num_steps=4):
+    """run the same updates with both optimizers, opt2 by update_multi"""
+    np.random.seed(0)
+    w1 = [mx.nd.array(np.random.uniform(-1, 1, shape)) for i in range(num_weights)]
+    w2 = [w.copyto(mx.cpu()) for w in w1]
+    states = [opt1.create_state(i, w) for i, w in enumerate(w1)]
+    for step in range(num_steps):
+        grads = [np.random.uniform(-1, 1, shape) for i in range(num_weights)]
+        for i in range(num_weights):
+            opt1.update(i, w1[i], mx.nd.array(grads[i]), states[i])
+        opt2.update_multi(list(range(num_weights)), w2,
+                          [mx.nd.array(g) for g in grads])
+    for a, b in zip(w1, w2):
+        assert np.allclose(a.asnumpy(), b.asnumpy(), rtol=1e-4, atol=1e-5)
+
+def test_ccsgd():
+    kwargs = {'learning_rate': 0.1, 'momentum': 0.9, 'wd': 0.01, 'rescale_grad': 0.5}
+    compare_optimizer(mx.optimizer.SGD(**kwargs), mx.optimizer.ccSGD(**kwargs))
+
+def test_ccadam():
+    kwargs = {'learning_rate': 0.01, 'wd': 0.01, 'rescale_grad': 0.5}
+    compare_optimizer(mx.optimizer.Adam(**kwargs), mx.optimizer.ccAdam(**kwargs))
+    compare_optimizer(mx.optimizer.Adam(clip_gradient=0.2, **kwargs),
+                      mx.optimizer.ccAdam(clip_gradient=0.2, **kwargs))
+
+def test_ccrmsprop():
+    kwargs = {'learning_rate': 0.01, 'wd': 0.01, 'rescale_grad': 0.5}
+    compare_optimizer(mx.optimizer.RMSProp(**kwargs), mx.optimizer.ccRMSProp(**kwargs))
+
+def test_cc_pickle():
+    opt = pickle.loads(pickle.dumps(mx.optimizer.ccAdam(learning_rate=0.01)))
+    assert opt.handle is not None
+    w = mx.nd.ones(shape)
+    opt.update(0, w, mx.nd.ones(shape), None)
+    assert np.all(w.asnumpy() < 1)
+
+def test_ccsgd_row_sparse():
+    """the lazy updates are the dense ones once every row is touched"""
+    np.random.seed(0)
+    nrow = 6
+    for momentum in [0.0, 0.9]:
+        kwargs = {'learning_rate': 0.1, 'momentum': momentum, 'wd': 0.05}
+        dense, lazy = mx.optimizer.ccSGD(**kwargs), mx.optimizer.ccSGD(**kwargs)
+        w1 = mx.nd.array(np.random.uniform(-1, 1, (nrow, 4)))
+        w2 = w1.copyto(mx.cpu())
+        for step in range(5):
+            rows = np.array([1, 4]) if step < 4 else np.arange(nrow)
+            grad = np.zeros((nrow, 4))
+            grad[rows] = np.random.uniform(-1, 1, (len(rows), 4))
+            dense.update(0, w1, mx.nd.array(grad), None)
+            lazy.update_row_sparse(0, w2, mx.nd.array(rows), mx.nd.array(grad[rows]))
+        assert np.allclose(w1.asnumpy(), w2.asnumpy(), rtol=1e-4, atol=1e-5)
+
+if __name__ == '__main__':
+    test_ccsgd()
+    test_ccadam()
+    test_ccrmsprop()
+    test_cc_pickle()
+    test_ccsgd_row_sparse()
@@ -48,16 +48,81 @@ def check_symbolic_random(dev):
     mx.random.seed(128)
     yexec.forward()
     ret1 = yexec.outputs[0].copyto(dev)
+    # the executor keeps its copy of the generator
     mx.random.seed(128)
-    ret2 = mx.random.normal(mu, sigma, shape)
+    yexec.forward()
+    ret2 = yexec.outputs[0].copyto(dev)
     assert same(ret1.asnumpy(), ret2.asnumpy())
     assert abs(np.mean(ret1.asnumpy()) - mu) < 0.1
     assert abs(np.std(ret1.asnumpy()) - sigma) < 0.1
 
 
+def check_parallel_random(dev):
+    shape = (100, 100)
+    mx.random.seed(128)
+    # consecutive samples use different copies of the generator
+    un1 = [mx.random.uniform(0, 1, shape, ctx=dev) for _ in range(8)]
+    mx.random.seed(128)
+    un2 = [mx.random.uniform(0, 1, shape, ctx=dev) for _ in range(8)]
+    for i in range(8):
+        assert same(un1[i].asnumpy(), un2[i].asnumpy())
+        for j in range(i):
+            assert not same(un1[i].asnumpy(), un1[j].asnumpy())
+    x = mx.nd.ones(shape, ctx=dev)
+    exe = mx.sym.Dropout(mx.sym.Variable("x"), p=0.5).bind(dev, {"x": x})
+    mx.random.seed(128)
+    exe.forward(is_train=True)
+    out1 = exe.outputs[0].asnumpy()
+    mx.random.seed(128)
+    exe.forward(is_train=True)
+    out2 = exe.outputs[0].asnumpy()
+    assert same(out1, out2)
+    assert abs(np.mean(out1 == 0) - 0.5) < 0.05
+    # the mask generated again in the backward, and the stored mask, are the same one
+    for regenerate_mask in [True, False]:
+        grad = mx.nd.zeros(shape, ctx=dev)
+        exe = mx.sym.Dropout(mx.sym.Variable("x"), p=0.5, regenerate_mask=regenerate_mask).bind(
+            dev, {"x": x}, args_grad={"x": grad})
+        mx.random.seed(128)
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones(shape, ctx=dev)])
+        assert same(exe.outputs[0].asnumpy(), out1)
+        assert same(grad.asnumpy(), out1)
+
+
+def check_multinomial(dev):
+    prob = np.array([[0.1, 0.0, 0.6, 0.3], [0.0, 0.0, 1.0, 0.0]])
+    mx.random.seed(128)
+    out1 = mx.nd.sample_multinomial(mx.nd.array(prob, ctx=dev), shape=(10000,)).asnumpy()
+    mx.random.seed(128)
+    out2 = mx.nd.sample_multinomial(mx.nd.array(prob, ctx=dev), shape=(10000,)).asnumpy()
+    assert out1.shape == (2, 10000)
+    assert same(out1, out2)
+    for i in range(prob.shape[0]):
+        freq = np.bincount(out1[i].astype(np.int32), minlength=4) / 10000.0
+        assert np.abs(freq - prob[i]).max() < 0.02
+    # the gradient of the log probabilities is 1 / p at the samples
+    exe = mx.sym.sample_multinomial(mx.sym.Variable('prob'), shape=(3,), get_prob=True).bind(
+        dev, {'prob': mx.nd.array(prob, ctx=dev)},
+        args_grad={'prob': mx.nd.zeros(prob.shape, ctx=dev)})
+    exe.forward(is_train=True)
+    samples = exe.outputs[0].asnumpy().astype(np.int32)
+    assert samples.shape == (2, 3)
+    assert same(exe.outputs[1].asnumpy(),
+                np.log(prob[np.arange(2)[:, None], samples]).astype(np.float32))
+    exe.backward([mx.nd.zeros((2, 3), ctx=dev), mx.nd.ones((2, 3), ctx=dev)])
+    grad = np.zeros(prob.shape)
+    for i in range(2):
+        for k in samples[i]:
+            grad[i, k] += 1 / prob[i, k]
+    assert np.abs(exe.grad_dict['prob'].asnumpy() - grad).max() < 1e-4
+
+
 def test_random():
     check_with_device(mx.cpu())
     check_symbolic_random(mx.cpu())
+    check_parallel_random(mx.cpu())
+    check_multinomial(mx.cpu())
 
 
 if __name__ == '__main__':
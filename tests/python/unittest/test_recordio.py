@@ -0,0 +1,47 @@
+# pylint: skip-file
+import mxnet as mx
+import tempfile
+import random
+import os
+
+def test_recordio():
+    frec = tempfile.mktemp()
+    N = 255
+
+    writer = mx.recordio.MXRecordIO(frec, 'w')
+    for i in range(N):
+        writer.write(bytes(bytearray([i] * (i + 1))))
+    writer.close()
+
+    reader = mx.recordio.MXRecordIO(frec, 'r')
+    for i in range(N):
+        res = reader.read()
+        assert res == bytes(bytearray([i] * (i + 1)))
+    assert reader.read() is None
+    reader.close()
+    os.remove(frec)
+
+def test_indexed_recordio():
+    fidx = tempfile.mktemp()
+    frec = tempfile.mktemp()
+    N = 255
+
+    writer = mx.recordio.MXIndexedRecordIO(fidx, frec, 'w')
+    for i in range(N):
+        writer.write_idx(i, bytes(bytearray([i] * (i + 1))))
+    writer.close()
+
+    reader = mx.recordio.MXIndexedRecordIO(fidx, frec, 'r')
+    keys = reader.keys
+    assert sorted(keys) == list(range(N))
+    random.shuffle(keys)
+    for i in keys:
+        res = reader.read_idx(i)
+        assert res == bytes(bytearray([i] * (i + 1)))
+    reader.close()
+    os.remove(fidx)
+    os.remove(frec)
+
+if __name__ == '__main__':
+    test_recordio()
+    test_indexed_recordio()
@@ -67,6 +67,11 @@ def test_symbol_saveload():
     # save because of order
     assert sym.tojson() == data2.tojson()
     os.remove(fname)
+    fname = 'tmp_sym.bin'
+    sym.save(fname, binary=True)
+    data3 = mx.symbol.load(fname)
+    assert sym.tojson() == data3.tojson()
+    os.remove(fname)
 
 def test_symbol_infer_type():
     data = mx.symbol.Variable('data')
@@ -127,6 +132,27 @@ def test_symbol_infer_shape_var():
     assert arg_shapes[1] == overwrite_shape
     assert out_shapes[0] == overwrite_shape
 
+def test_symbol_amp_convert():
+    data = mx.symbol.Variable('data')
+    fc1 = mx.symbol.FullyConnected(data=data, name='fc1', num_hidden=16)
+    act = mx.symbol.Activation(data=fc1, name='relu1', act_type='relu')
+    fc2 = mx.symbol.FullyConnected(data=act, name='fc2', num_hidden=8)
+    fc3 = mx.symbol.FullyConnected(data=fc2, name='fc3', num_hidden=4)
+    net = mx.symbol.SoftmaxOutput(data=fc3, name='softmax')
+    amp_net = mx.amp.convert_symbol(net, loss_scale=128.0)
+    assert amp_net.list_arguments() == net.list_arguments()
+    assert amp_net.list_outputs() == net.list_outputs()
+    arg, out, aux = amp_net.infer_type(data=np.float32)
+    assert arg == [np.float32] * len(arg)
+    assert out == [np.float32]
+    internals = amp_net.get_internals()
+    _, out, _ = internals.infer_type(data=np.float32)
+    types = dict(zip(internals.list_outputs(), out))
+    assert types['fc1_float16_output'] == np.float16
+    assert types['fc1_output'] == np.float32
+    # fc2 feeds fc3 without casting back
+    assert 'fc2_output' in types
+    assert 'fc2_0_float16_output' not in types
 
 
 if __name__ == '__main__':
@@ -138,3 +164,4 @@ if __name__ == '__main__':
     test_symbol_compose()
     test_symbol_saveload()
     test_symbol_pickle()
+    test_symbol_amp_convert()
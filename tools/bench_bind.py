@@ -0,0 +1,218 @@
+#!/usr/bin/env python
+"""
+Report the memory plan and the bind time of the model symbols.
+
+Every configuration binds a symbol of example/image-classification or
+example/rnn at a batch size, without running it, and reports the internal
+memory planned on each context, the number of storage chunks the entries are
+placed in, and the milliseconds of the phases of the initialization of the
+executor, InitGraph, InitDataEntryMemory, InitCachedOps and the others, as
+one json per configuration. The numbers are parsed from the debug string of
+the executor.
+
+Examples
+
+    python tools/bench_bind.py
+    python tools/bench_bind.py --models inception-bn,lstm --batch-sizes 32,256 --ctx gpu
+    MXNET_BACKWARD_DO_MIRROR=1 python tools/bench_bind.py --models resnet
+
+Regression gating: --save-baseline stores the results, and --baseline compares
+the results to stored ones, exiting with status 1 if the planned memory or the
+number of chunks grew by more than --tolerance, or if the bind time grew by
+more than --time-tolerance when it is given.
+"""
+from __future__ import print_function
+import argparse
+import importlib
+import itertools
+import json
+import os
+import re
+import sys
+import time
+
+curr_path = os.path.abspath(os.path.dirname(__file__))
+sys.path.insert(0, os.path.join(curr_path, "../python"))
+sys.path.insert(0, os.path.join(curr_path, "../example/image-classification"))
+sys.path.insert(0, os.path.join(curr_path, "../example/rnn"))
+import mxnet as mx
+
+# the image shape and the number of classes of the image models
+IMAGE_MODELS = {
+    'alexnet': ((3, 224, 224), 1000),
+    'googlenet': ((3, 224, 224), 1000),
+    'inception-bn': ((3, 224, 224), 1000),
+    'inception-bn-28-small': ((3, 28, 28), 10),
+    'inception-v3': ((3, 299, 299), 1000),
+    'resnet': ((3, 32, 32), 10),
+    'resnet-28-small': ((3, 28, 28), 10),
+    'vgg': ((3, 224, 224), 1000),
+}
+
+# the module and the unroll function of the recurrent models, and whether they
+# have a cell state besides the hidden one
+RNN_MODELS = {
+    'lstm': ('lstm', 'lstm_unroll', True),
+    'gru': ('gru', 'gru_unroll', False),
+    'rnn': ('rnn', 'rnn_unroll', False),
+}
+
+def int_list(s):
+    return [int(x) for x in s.split(',') if x != '']
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Report the memory plan and the bind time')
+    parser.add_argument('--models', type=str,
+                        default='alexnet,inception-bn,inception-v3,resnet,vgg,lstm',
+                        help='the models, of ' + ', '.join(sorted(IMAGE_MODELS) +
+                                                           sorted(RNN_MODELS)))
+    parser.add_argument('--batch-sizes', type=int_list, default=[1, 32, 128],
+                        help='the batch sizes')
+    parser.add_argument('--ctx', type=str, default='cpu',
+                        help='bind on cpu or gpu, the memory is allocated but not used')
+    parser.add_argument('--grad-req', type=str, default='write',
+                        help='write for training, null for inference')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='the number of binds of each configuration, the median '
+                        'of the times is reported')
+    parser.add_argument('--seq-len', type=int, default=35,
+                        help='the sequence length of the recurrent models')
+    parser.add_argument('--num-layers', type=int, default=2,
+                        help='the number of layers of the recurrent models')
+    parser.add_argument('--num-hidden', type=int, default=200,
+                        help='the hidden and the embedding size of the recurrent models')
+    parser.add_argument('--vocab', type=int, default=10000,
+                        help='the vocabulary size of the recurrent models')
+    parser.add_argument('--output', type=str, default=None,
+                        help='also append the results to this file, one json per line')
+    parser.add_argument('--baseline', type=str, default=None,
+                        help='compare the results to the baseline of this file')
+    parser.add_argument('--save-baseline', type=str, default=None,
+                        help='store the results as the baseline in this file')
+    parser.add_argument('--tolerance', type=float, default=0.02,
+                        help='the relative growth of the memory and of the chunks '
+                        'tolerated against the baseline')
+    parser.add_argument('--time-tolerance', type=float, default=None,
+                        help='the relative growth of the bind time tolerated against '
+                        'the baseline, the time is not compared if not given')
+    return parser.parse_args()
+
+def median(values):
+    values = sorted(values)
+    return values[(len(values) - 1) // 2]
+
+def get_model(name, batch_size, args):
+    """the symbol and the shapes of its inputs"""
+    if name in IMAGE_MODELS:
+        image_shape, num_classes = IMAGE_MODELS[name]
+        net = importlib.import_module('symbol_' + name)
+        shapes = {'data': (batch_size,) + image_shape, 'softmax_label': (batch_size,)}
+        return net.get_symbol(num_classes), shapes
+    if name not in RNN_MODELS:
+        raise ValueError('unknown model ' + name)
+    module, unroll, has_cell = RNN_MODELS[name]
+    unroll = getattr(importlib.import_module(module), unroll)
+    sym = unroll(args.num_layers, args.seq_len, args.vocab, num_hidden=args.num_hidden,
+                 num_embed=args.num_hidden, num_label=args.vocab)
+    shapes = {'data': (batch_size, args.seq_len),
+              'softmax_label': (batch_size, args.seq_len)}
+    for i in range(args.num_layers):
+        shapes['l%d_init_h' % i] = (batch_size, args.num_hidden)
+        if has_cell:
+            shapes['l%d_init_c' % i] = (batch_size, args.num_hidden)
+    return sym, shapes
+
+def parse_debug_str(text):
+    """the planned MB on each context, the chunks, the allocated MB and the
+    milliseconds of the phases of the initialization"""
+    planned = {}
+    for m in re.finditer(r'^Peak (\d+) MB planned on dev_type=(\d+) dev_id=(\d+)$', text, re.M):
+        # dev_type 2 is gpu, 1 and 3 are cpu and cpu pinned
+        dev = '%s(%s)' % ('gpu' if m.group(2) == '2' else 'cpu', m.group(3))
+        planned[dev] = planned.get(dev, 0) + int(m.group(1))
+    chunks = re.search(r'^Total (\d+) storage chunks$', text, re.M)
+    allocated = re.search(r'^Total (\d+) MB allocated$', text, re.M)
+    phases = dict((m.group(1), float(m.group(2))) for m in re.finditer(
+        r'^Init (\w+) ([\d.e+-]+) ms$', text, re.M))
+    return (planned, int(chunks.group(1)) if chunks else None,
+            int(allocated.group(1)) if allocated else None, phases)
+
+def run_config(config, args):
+    """bind one configuration --repeat times"""
+    ctx = mx.gpu() if args.ctx == 'gpu' else mx.cpu()
+    sym, shapes = get_model(config['model'], config['batch_size'], args)
+    binds, phases = [], []
+    for _ in range(max(1, args.repeat)):
+        tic = time.time()
+        exe = sym.simple_bind(ctx, grad_req=args.grad_req, **shapes)
+        binds.append((time.time() - tic) * 1e3)
+        planned, chunks, allocated, times = parse_debug_str(exe.debug_str())
+        phases.append(times)
+        del exe
+    result = dict(config)
+    result['planned_mb'] = planned
+    result['chunks'] = chunks
+    result['allocated_mb'] = allocated
+    result['bind_ms'] = median(binds)
+    result['init_ms'] = dict((p, median([t.get(p, 0.0) for t in phases])) for p in phases[0])
+    return result
+
+def key(result):
+    """the configuration of a result"""
+    return (result['model'], result['batch_size'], result['ctx'], result['grad_req'])
+
+def regressions(result, baseline, tolerance, time_tolerance):
+    """the metrics of a result which regressed from its baseline"""
+    found = []
+    for dev, mb in result['planned_mb'].items():
+        base = baseline['planned_mb'].get(dev, 0)
+        if mb > base * (1 + tolerance):
+            found.append('planned_mb[%s] %d -> %d' % (dev, base, mb))
+    if result['chunks'] > baseline['chunks'] * (1 + tolerance):
+        found.append('chunks %d -> %d' % (baseline['chunks'], result['chunks']))
+    if time_tolerance is not None and \
+       result['bind_ms'] > baseline['bind_ms'] * (1 + time_tolerance):
+        found.append('bind_ms %.2f -> %.2f' % (baseline['bind_ms'], result['bind_ms']))
+    return found
+
+def main():
+    args = parse_args()
+    baselines = {}
+    if args.baseline is not None:
+        with open(args.baseline) as fin:
+            baselines = dict((key(r), r) for r in json.load(fin))
+    results = []
+    failed = []
+    print('%-22s %6s %12s %7s %10s %10s %10s %10s' % (
+        'model', 'batch', 'planned(MB)', 'chunks', 'bind(ms)', 'graph(ms)', 'memory(ms)',
+        'cached(ms)'))
+    for model, batch_size in itertools.product(args.models.split(','), args.batch_sizes):
+        config = {'model': model, 'batch_size': batch_size, 'ctx': args.ctx,
+                  'grad_req': args.grad_req}
+        result = run_config(config, args)
+        init_ms = result['init_ms']
+        print('%-22s %6d %12d %7d %10.2f %10.2f %10.2f %10.2f' % (
+            model, batch_size, sum(result['planned_mb'].values()), result['chunks'],
+            result['bind_ms'], init_ms.get('InitGraph', 0), init_ms.get('InitDataEntryMemory', 0),
+            init_ms.get('InitCachedOps', 0)))
+        sys.stdout.flush()
+        results.append(result)
+        if args.output is not None:
+            with open(args.output, 'a') as fout:
+                fout.write(json.dumps(result) + '\n')
+        if key(result) in baselines:
+            regressed = regressions(result, baselines[key(result)], args.tolerance,
+                                    args.time_tolerance)
+            if regressed:
+                failed.append('%s: %s' % (key(result), ', '.join(regressed)))
+
+    if args.save_baseline is not None:
+        with open(args.save_baseline, 'w') as fout:
+            json.dump(results, fout, indent=2, sort_keys=True)
+    if failed:
+        print('Regressions against %s:' % args.baseline)
+        print('\n'.join(failed))
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
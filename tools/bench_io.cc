@@ -0,0 +1,171 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file bench_io.cc
+ * \brief drain a data iterator for a duration, apart from any training, and
+ *  report its throughput as json
+ *
+ *  Usage: bench_io iter=ImageRecordIter [duration=30] [warmup=5] key=value ...
+ *
+ *  The other key=value arguments are the parameters of the iterator, such as
+ *  path_imgrec=train.rec data_shape=(3,224,224) batch_size=128 preprocess_threads=8.
+ *  The iterator restarts at the end of its data. The report has the batches,
+ *  samples and bytes per second after the warmup, the cpu usage of each thread of
+ *  the process, on Linux, and the counters of the stages of the io pipeline.
+ */
+#include <dmlc/logging.h>
+#include <dmlc/timer.h>
+#include <mxnet/io.h>
+#if defined(__linux__)
+#include <dirent.h>
+#include <unistd.h>
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../src/io/io_stats.h"
+
+using namespace mxnet;
+
+/*! \brief the name and the cpu clock ticks of a thread */
+struct ThreadTime {
+  std::string name;
+  uint64_t ticks;
+};
+
+/*! \return the threads of the process by id, empty if not supported */
+std::map<int, ThreadTime> GetThreadTimes() {
+  std::map<int, ThreadTime> ret;
+#if defined(__linux__)
+  DIR *dir = opendir("/proc/self/task");
+  if (dir == nullptr) return ret;
+  while (dirent *ent = readdir(dir)) {
+    if (ent->d_name[0] == '.') continue;
+    std::ifstream fin(std::string("/proc/self/task/") + ent->d_name + "/stat");
+    std::string stat((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+    // pid (comm) state ..., comm may have spaces
+    size_t open = stat.find('('), close = stat.rfind(')');
+    if (open == std::string::npos || close == std::string::npos) continue;
+    std::istringstream is(stat.substr(close + 2));
+    std::string field;
+    uint64_t utime = 0, stime = 0;
+    // state is field 3, utime and stime are fields 14 and 15
+    for (int i = 3; i <= 15 && is >> field; ++i) {
+      if (i == 14) utime = std::stoull(field);
+      if (i == 15) stime = std::stoull(field);
+    }
+    ret[atoi(ent->d_name)] = ThreadTime{stat.substr(open + 1, close - open - 1), utime + stime};
+  }
+  closedir(dir);
+#endif
+  return ret;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s iter=NAME [duration=SECONDS] [warmup=SECONDS] key=value ...\n",
+            argv[0]);
+    return 1;
+  }
+  std::string iter_name;
+  double duration = 30, warmup = 5;
+  std::vector<std::pair<std::string, std::string> > kwargs;
+  for (int i = 1; i < argc; ++i) {
+    const char *eq = strchr(argv[i], '=');
+    CHECK(eq != nullptr) << "argument " << argv[i] << " is not key=value";
+    std::string key(argv[i], eq), val(eq + 1);
+    if (key == "iter") {
+      iter_name = val;
+    } else if (key == "duration") {
+      duration = atof(val.c_str());
+    } else if (key == "warmup") {
+      warmup = atof(val.c_str());
+    } else {
+      kwargs.push_back({key, val});
+    }
+  }
+  const DataIteratorReg *reg = dmlc::Registry<DataIteratorReg>::Find(iter_name);
+  if (reg == nullptr) {
+    std::ostringstream os;
+    for (const DataIteratorReg *e : dmlc::Registry<DataIteratorReg>::List()) {
+      os << ' ' << e->name;
+    }
+    LOG(FATAL) << "unknown iterator " << iter_name << ", the iterators are" << os.str();
+  }
+  std::unique_ptr<IIterator<DataBatch> > iter(reg->body());
+  iter->Init(kwargs);
+  iter->BeforeFirst();
+
+  uint64_t batches = 0, samples = 0, bytes = 0;
+  size_t epochs = 0;
+  std::map<int, ThreadTime> start_times;
+  const double begin = dmlc::GetTime();
+  double start = begin, now = begin;
+  bool timing = false;
+  // restart the counters after the warmup
+  auto start_timing = [&]() {
+    timing = true;
+    start = now;
+    start_times = GetThreadTimes();
+    std::ostringstream discard;
+    io::IOStats::Get()->Dump(&discard, true);
+  };
+  if (warmup <= 0) start_timing();
+  while (!timing || now - start < duration) {
+    if (!iter->Next()) {
+      ++epochs;
+      iter->BeforeFirst();
+      CHECK(iter->Next()) << "the iterator has no data";
+    }
+    const DataBatch &batch = iter->Value();
+    now = dmlc::GetTime();
+    if (!timing) {
+      if (now - begin >= warmup) start_timing();
+      continue;
+    }
+    ++batches;
+    if (batch.data.size() != 0 && batch.data[0].shape().ndim() != 0) {
+      samples += batch.data[0].shape()[0] - batch.num_batch_padd;
+    }
+    for (const NDArray &arr : batch.data) {
+      bytes += arr.shape().Size() * mshadow::mshadow_sizeof(arr.dtype());
+    }
+  }
+  const double elapsed = now - start;
+  std::map<int, ThreadTime> end_times = GetThreadTimes();
+
+  std::ostringstream os;
+  os.setf(std::ios::fixed);
+  os.precision(3);
+  os << "{\"iter\": \"" << iter_name << "\", \"elapsed_s\": " << elapsed
+     << ", \"epochs\": " << epochs
+     << ", \"batches_per_s\": " << batches / elapsed
+     << ", \"samples_per_s\": " << samples / elapsed
+     << ", \"mbytes_per_s\": " << bytes / elapsed / (1 << 20)
+     << ", \"threads\": [";
+#if defined(__linux__)
+  const double tick = 1.0 / sysconf(_SC_CLK_TCK);
+  bool first = true;
+  for (const auto &kv : end_times) {
+    auto it = start_times.find(kv.first);
+    const uint64_t ticks = kv.second.ticks - (it == start_times.end() ? 0 : it->second.ticks);
+    os << (first ? "" : ", ") << "{\"tid\": " << kv.first
+       << ", \"name\": \"" << kv.second.name << "\""
+       << ", \"cpu\": " << ticks * tick / elapsed << '}';
+    first = false;
+  }
+#endif
+  os << "], \"stages\": ";
+  io::IOStats::Get()->Dump(&os, false);
+  os << '}';
+  std::cout << os.str() << std::endl;
+  return 0;
+}
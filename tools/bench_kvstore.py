@@ -0,0 +1,162 @@
+#!/usr/bin/env python
+"""
+Benchmark the push and pull of the kvstore.
+
+Every iteration pushes the values of all keys from all devices, which are
+updated by ccSGD on the kvstore, and then pulls them back. The throughput is
+the pushed and pulled bytes of the devices of a worker per second, the latency
+is the time of an iteration.
+
+Examples, on a single machine
+
+    python tools/bench_kvstore.py --modes local,device --gpus 1,2,4
+    python tools/bench_kvstore.py --modes dist_sync,dist_async --num-servers 1,2,4
+
+The distributed modes are run by tools/launch.py with the local launcher. The
+environment variables of the kvstore, such as MXNET_KVSTORE_BIGARRAY_BOUND,
+can be swept with --env.
+"""
+from __future__ import print_function
+import argparse
+import itertools
+import json
+import os
+import subprocess
+import sys
+import time
+
+curr_path = os.path.abspath(os.path.dirname(__file__))
+sys.path.insert(0, os.path.join(curr_path, "../python"))
+
+RESULT = 'KVSTORE_BENCH '
+
+def int_list(s):
+    return [int(x) for x in s.split(',') if x != '']
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Benchmark the kvstore push and pull')
+    parser.add_argument('--modes', type=str, default='local,device,dist_sync,dist_async',
+                        help='the kvstore types to run')
+    parser.add_argument('--num-keys', type=int_list, default=[1, 16, 128],
+                        help='the numbers of keys')
+    parser.add_argument('--sizes', type=int_list, default=[1024, 262144, 4194304],
+                        help='the numbers of float32 elements of each value')
+    parser.add_argument('--gpus', type=int_list, default=[0],
+                        help='the numbers of gpus of each worker, 0 for one cpu')
+    parser.add_argument('--num-servers', type=int_list, default=[1],
+                        help='the numbers of servers of the distributed modes')
+    parser.add_argument('--num-workers', type=int, default=2,
+                        help='the number of workers of the distributed modes')
+    parser.add_argument('--env', type=str, action='append', default=[],
+                        help='an environment variable NAME=V1,V2,... to sweep, can be repeated')
+    parser.add_argument('--iters', type=int, default=20,
+                        help='the number of timed iterations')
+    parser.add_argument('--warmup', type=int, default=3,
+                        help='the number of iterations before timing')
+    parser.add_argument('--output', type=str, default=None,
+                        help='also append the results to this file, one json per line')
+    parser.add_argument('--run', type=str, default=None,
+                        help=argparse.SUPPRESS)
+    return parser.parse_args()
+
+def percentile(values, q):
+    values = sorted(values)
+    k = min(len(values) - 1, max(0, int(round(q / 100.0 * (len(values) - 1)))))
+    return values[k]
+
+def run_config(config, iters, warmup):
+    """run one configuration in this process, return the result or None on
+    the workers other than the first one"""
+    import mxnet as mx
+    kv = mx.kv.create(config['mode'])
+    if config['gpus'] == 0:
+        devs = [mx.cpu()]
+    else:
+        devs = [mx.gpu(i) for i in range(config['gpus'])]
+    keys = list(range(config['num_keys']))
+    shape = (config['size'],)
+    kv.init(keys, [mx.nd.zeros(shape) for _ in keys])
+    kv.set_optimizer(mx.optimizer.ccSGD(learning_rate=0.0))
+    grads = [[mx.nd.ones(shape, d) for d in devs] for _ in keys]
+    weights = [[mx.nd.zeros(shape, d) for d in devs] for _ in keys]
+
+    times = []
+    for i in range(warmup + iters):
+        tic = time.time()
+        for k in keys:
+            kv.push(k, grads[k], priority=-k)
+            kv.pull(k, weights[k], priority=-k)
+        for w in weights:
+            for x in w:
+                x.wait_to_read()
+        if i >= warmup:
+            times.append(time.time() - tic)
+    if kv.rank != 0:
+        return None
+    nbytes = 2.0 * config['num_keys'] * config['size'] * 4 * len(devs)
+    result = dict(config)
+    result['gbps'] = nbytes * len(times) / sum(times) / 1e9
+    result['p50_ms'] = percentile(times, 50) * 1e3
+    result['p99_ms'] = percentile(times, 99) * 1e3
+    return result
+
+def launch_config(config, args):
+    """run one configuration of a distributed mode by launch.py"""
+    cmd = [sys.executable, os.path.join(curr_path, 'launch.py'),
+           '-n', str(args.num_workers), '-s', str(config['num_servers']),
+           '--launcher', 'local',
+           sys.executable, os.path.abspath(__file__),
+           '--iters', str(args.iters), '--warmup', str(args.warmup),
+           '--run', json.dumps(config)]
+    out = subprocess.check_output(cmd, env=os.environ.copy(), universal_newlines=True)
+    for line in out.splitlines():
+        if line.startswith(RESULT):
+            return json.loads(line[len(RESULT):])
+    raise RuntimeError('no result of %s:\n%s' % (config, out))
+
+def configs(args):
+    """all of the configurations to run"""
+    sweeps = []
+    for e in args.env:
+        name, values = e.split('=', 1)
+        sweeps.append([(name, v) for v in values.split(',')])
+    for env in itertools.product(*sweeps):
+        for mode in args.modes.split(','):
+            dist = mode.startswith('dist')
+            for gpus, num_servers, num_keys, size in itertools.product(
+                    args.gpus, args.num_servers if dist else [0], args.num_keys, args.sizes):
+                if mode == 'device' and gpus == 0:
+                    continue
+                yield {'mode': mode, 'gpus': gpus, 'num_servers': num_servers,
+                       'num_workers': args.num_workers if dist else 1,
+                       'num_keys': num_keys, 'size': size, 'env': dict(env)}
+
+def main():
+    args = parse_args()
+    if args.run is not None:
+        # a worker or a server started by launch.py
+        result = run_config(json.loads(args.run), args.iters, args.warmup)
+        if result is not None:
+            print(RESULT + json.dumps(result))
+            sys.stdout.flush()
+        return
+
+    print('%-10s %4s %7s %7s %6s %10s %8s %9s %9s  %s' % (
+        'mode', 'gpus', 'servers', 'workers', 'keys', 'size', 'GB/s', 'p50(ms)', 'p99(ms)', 'env'))
+    for config in configs(args):
+        os.environ.update(config['env'])
+        if config['mode'].startswith('dist'):
+            result = launch_config(config, args)
+        else:
+            result = run_config(config, args.iters, args.warmup)
+        print('%-10s %4d %7d %7d %6d %10d %8.3f %9.3f %9.3f  %s' % (
+            result['mode'], result['gpus'], result['num_servers'], result['num_workers'],
+            result['num_keys'], result['size'], result['gbps'], result['p50_ms'],
+            result['p99_ms'], ' '.join('%s=%s' % kv for kv in sorted(config['env'].items()))))
+        sys.stdout.flush()
+        if args.output is not None:
+            with open(args.output, 'a') as fout:
+                fout.write(json.dumps(result) + '\n')
+
+if __name__ == '__main__':
+    main()
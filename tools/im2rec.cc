@@ -8,14 +8,17 @@
  *  Image List Format: unique-image-index label[s] path-to-image
  * \sa dmlc/recordio.h
  */
+#include <algorithm>
 #include <cctype>
 #include <cstring>
 #include <string>
 #include <vector>
 #include <iomanip>
 #include <sstream>
+#include <unordered_map>
 #include <dmlc/base.h>
 #include <dmlc/io.h>
+#include <dmlc/omp.h>
 #include <dmlc/timer.h>
 #include <dmlc/logging.h>
 #include <dmlc/recordio.h>
@@ -42,6 +45,46 @@ int GetInterMethod(int inter_method, int old_width, int old_height, int new_widt
         return inter_method;
     }
 }
+/*! \brief encoding settings, the same for all images or of a class */
+struct EncodeParam {
+  /*! \brief size of the shorter edge, no resize if <= 0 */
+  int new_size;
+  /*! \brief jpeg quality or png compression */
+  int quality;
+};
+
+/*! \brief an image to pack */
+struct PackTask {
+  /*! \brief the record, header and encoded image */
+  mxnet::io::ImageRecordIO rec;
+  /*! \brief path to the image */
+  std::string path;
+  /*! \brief the packed record */
+  std::string blob;
+  PackTask() {
+    std::memset(&rec.header, 0, sizeof(rec.header));
+  }
+};
+
+/*! \brief read the lines "label resize quality" of the settings of some classes */
+std::unordered_map<int, EncodeParam> LoadClassParams(const char *fname, const EncodeParam &dflt) {
+  std::unordered_map<int, EncodeParam> params;
+  dmlc::Stream *fi = dmlc::Stream::Create(fname, "r");
+  dmlc::istream is(fi);
+  std::string line;
+  while (std::getline(is, line)) {
+    std::istringstream ls(line);
+    float label;
+    EncodeParam param = dflt;
+    if (!(ls >> label)) continue;
+    CHECK(ls >> param.new_size >> param.quality)
+        << "Invalid class_param line \"" << line << "\", expect: label resize quality";
+    params[static_cast<int>(label)] = param;
+  }
+  delete fi;
+  return params;
+}
+
 int main(int argc, char *argv[]) {
   if (argc < 4) {
     printf("Usage: <image.lst> <image_root_dir> <output.rec> [additional parameters in form key=value]\n"\
@@ -55,7 +98,10 @@ int main(int argc, char *argv[]) {
            "\tquality=QUALITY[default=80] JPEG quality for encoding (1-100, default: 80) or PNG compression for encoding (1-9, default: 3).\n"\
            "\tencoding=ENCODING[default='.jpg'] Encoding type. Can be '.jpg' or '.png'\n"\
            "\tinter_method=INTER_METHOD[default=1] NN(0) BILINEAR(1) CUBIC(2) AREA(3) LANCZOS4(4) AUTO(9) RAND(10).\n"\
-           "\tunchanged=UNCHANGED[default=0] Keep the original image encoding, size and color. If set to 1, it will ignore the others parameters.\n");
+           "\tunchanged=UNCHANGED[default=0] Keep the original image encoding, size and color. If set to 1, it will ignore the others parameters.\n"\
+           "\tindex=INDEX[default=0] Also write the offsets of the records to <output.rec>.idx, for shuffling over the whole file.\n"\
+           "\tnum_thread=NUM_THREAD[default=number of cores] Number of threads decoding, resizing and encoding the images, the records keep the order of the list.\n"\
+           "\tclass_param=FILE Lines \"label resize quality\" overriding resize and quality for the images of some classes.\n");
     return 0;
   }
   int label_width = 1;
@@ -67,6 +113,9 @@ int main(int argc, char *argv[]) {
   int color_mode = CV_LOAD_IMAGE_COLOR;
   int unchanged = 0;
   int inter_method = CV_INTER_LINEAR;
+  int write_index = 0;
+  int num_thread = omp_get_num_procs();
+  std::string class_param;
   std::string encoding(".jpg");
   for (int i = 4; i < argc; ++i) {
     char key[128], val[128];
@@ -81,6 +130,9 @@ int main(int argc, char *argv[]) {
       if (!strcmp(key, "encoding")) encoding = std::string(val);
       if (!strcmp(key, "unchanged")) unchanged = atoi(val);
       if (!strcmp(key, "inter_method")) inter_method = atoi(val);
+      if (!strcmp(key, "index")) write_index = atoi(val);
+      if (!strcmp(key, "num_thread")) num_thread = std::max(atoi(val), 1);
+      if (!strcmp(key, "class_param")) class_param = val;
     }
   }
   // Check parameters ranges
@@ -135,11 +187,14 @@ int main(int argc, char *argv[]) {
       }
   }
   std::random_device rd;
-  std::mt19937 prnd(rd());
+  std::vector<std::mt19937> prnds;
+  for (int i = 0; i < num_thread; ++i) prnds.emplace_back(rd());
+  LOG(INFO) << "Use " << num_thread << " threads";
   using namespace dmlc;
   const static size_t kBufferSize = 1 << 20UL;
+  // number of images read and encoded together, written in order
+  const size_t kTaskBatch = 32 * num_thread;
   std::string root = argv[2];
-  mxnet::io::ImageRecordIO rec;
   size_t imcnt = 0;
   double tstart = dmlc::GetTime();
   dmlc::InputSplit *flist = dmlc::InputSplit::
@@ -154,44 +209,47 @@ int main(int argc, char *argv[]) {
   dmlc::Stream *fo = dmlc::Stream::Create(os.str().c_str(), "w");
   LOG(INFO) << "Output: " << os.str();
   dmlc::RecordIOWriter writer(fo);
-  std::string fname, path, blob;
-  std::vector<unsigned char> decode_buf;
-  std::vector<unsigned char> encode_buf;
-  std::vector<int> encode_params;
+  // index of the records: image index and offset of each record
+  dmlc::Stream *fidx = NULL;
+  dmlc::SeekStream *fseek = NULL;
+  if (write_index) {
+    fseek = dynamic_cast<dmlc::SeekStream*>(fo);
+    CHECK(fseek != NULL) << "index needs a local output file";
+    fidx = dmlc::Stream::Create((os.str() + ".idx").c_str(), "w");
+    LOG(INFO) << "Index: " << os.str() << ".idx";
+  }
+  std::ostringstream idx_line;
+  std::string fname;
+  const EncodeParam default_param = {new_size, quality};
+  std::unordered_map<int, EncodeParam> class_params;
+  if (class_param.length() != 0) {
+    class_params = LoadClassParams(class_param.c_str(), default_param);
+    LOG(INFO) << "Settings of " << class_params.size() << " classes from " << class_param;
+  }
   if (encoding == std::string(".png")) {
-      encode_params.push_back(CV_IMWRITE_PNG_COMPRESSION);
-      encode_params.push_back(quality);
       LOG(INFO) << "PNG encoding compression: " << quality;
   } else {
-      encode_params.push_back(CV_IMWRITE_JPEG_QUALITY);
-      encode_params.push_back(quality);
       LOG(INFO) << "JPEG encoding quality: " << quality;
   }
-  dmlc::InputSplit::Blob line;
-
-  while (flist->NextRecord(&line)) {
-    std::string sline(static_cast<char*>(line.dptr), line.size);
-    std::istringstream is(sline);
-    if (!(is >> rec.header.image_id[0] >> rec.header.label)) continue;
-    for (int k = 1; k < label_width; ++k) {
-      float tmp;
-      CHECK(is >> tmp)
-          << "Invalid ImageList, did you provide the correct label_width?";
-    }
-    CHECK(std::getline(is, fname));
-    // eliminate invalid chars in the end
-    while (fname.length() != 0 &&
-           (isspace(*fname.rbegin()) || !isprint(*fname.rbegin()))) {
-      fname.resize(fname.length() - 1);
+  // pack an image, thread safe
+  auto pack = [&](PackTask *task, std::mt19937 &prnd) {
+    auto it = class_params.find(static_cast<int>(task->rec.header.label));
+    const EncodeParam &param = it == class_params.end() ? default_param : it->second;
+    const int new_size = param.new_size;
+    std::vector<int> encode_params;
+    if (encoding == std::string(".png")) {
+        encode_params.push_back(CV_IMWRITE_PNG_COMPRESSION);
+        encode_params.push_back(param.quality);
+    } else {
+        encode_params.push_back(CV_IMWRITE_JPEG_QUALITY);
+        encode_params.push_back(param.quality);
     }
-    // eliminate invalid chars in beginning.
-    const char *p = fname.c_str();
-    while (isspace(*p)) ++p;
-    path = root + p;
+    std::string &blob = task->blob;
+    const std::string &path = task->path;
     // use "r" is equal to rb in dmlc::Stream
     dmlc::Stream *fi = dmlc::Stream::Create(path.c_str(), "r");
-    rec.SaveHeader(&blob);
-    decode_buf.clear();
+    task->rec.SaveHeader(&blob);
+    std::vector<unsigned char> decode_buf;
     size_t imsize = 0;
     while (true) {
       decode_buf.resize(imsize + kBufferSize);
@@ -232,7 +290,7 @@ int main(int argc, char *argv[]) {
             }
         }
       }
-      encode_buf.clear();
+      std::vector<unsigned char> encode_buf;
       CHECK(cv::imencode(encoding, res, encode_buf, encode_params));
       size_t bsize = blob.size();
       blob.resize(bsize + encode_buf.size());
@@ -244,15 +302,59 @@ int main(int argc, char *argv[]) {
       memcpy(BeginPtr(blob) + bsize,
              BeginPtr(decode_buf), decode_buf.size());
     }
-    writer.WriteRecord(BeginPtr(blob), blob.size());
-    // write header
-    ++imcnt;
-    if (imcnt % 1000 == 0) {
-      LOG(INFO) << imcnt << " images processed, " << GetTime() - tstart << " sec elapsed";
+  };
+  dmlc::InputSplit::Blob line;
+  std::vector<PackTask> tasks;
+  bool more = true;
+  while (more) {
+    // read the next images of the list
+    tasks.clear();
+    while (tasks.size() < kTaskBatch && (more = flist->NextRecord(&line))) {
+      std::string sline(static_cast<char*>(line.dptr), line.size);
+      std::istringstream is(sline);
+      PackTask task;
+      if (!(is >> task.rec.header.image_id[0] >> task.rec.header.label)) continue;
+      for (int k = 1; k < label_width; ++k) {
+        float tmp;
+        CHECK(is >> tmp)
+            << "Invalid ImageList, did you provide the correct label_width?";
+      }
+      CHECK(std::getline(is, fname));
+      // eliminate invalid chars in the end
+      while (fname.length() != 0 &&
+             (isspace(*fname.rbegin()) || !isprint(*fname.rbegin()))) {
+        fname.resize(fname.length() - 1);
+      }
+      // eliminate invalid chars in beginning.
+      const char *p = fname.c_str();
+      while (isspace(*p)) ++p;
+      task.path = root + p;
+      tasks.push_back(task);
+    }
+    // decode, resize and encode them in parallel
+    const int ntask = static_cast<int>(tasks.size());
+    #pragma omp parallel for schedule(dynamic) num_threads(num_thread)
+    for (int i = 0; i < ntask; ++i) {
+      pack(&tasks[i], prnds[omp_get_thread_num()]);
+    }
+    // write them in the order of the list
+    for (PackTask &task : tasks) {
+      if (fidx != NULL) {
+        idx_line.str("");
+        idx_line << task.rec.header.image_id[0] << '\t' << fseek->Tell() << '\n';
+        fidx->Write(idx_line.str().c_str(), idx_line.str().length());
+      }
+      writer.WriteRecord(BeginPtr(task.blob), task.blob.size());
+      // write header
+      ++imcnt;
+      if (imcnt % 1000 == 0) {
+        LOG(INFO) << imcnt << " images processed, " << GetTime() - tstart << " sec elapsed";
+      }
     }
   }
   LOG(INFO) << "Total: " << imcnt << " images processed, " << GetTime() - tstart << " sec elapsed";
   delete fo;
+  delete fidx;
   delete flist;
   return 0;
 }
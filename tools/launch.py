@@ -18,7 +18,10 @@ def dmlc_opts(opts):
             '--cluster', opts.launcher,
             '--host-file', opts.hostfile,
             '--sync-dst-dir', opts.sync_dst_dir]
-    args += opts.command;
+    command = opts.command
+    if opts.kv_stats_interval:
+        command = ['env', 'MXNET_KVSTORE_STATS_INTERVAL=%g' % opts.kv_stats_interval] + command
+    args += command;
     from dmlc_tracker import opts
     dmlc_opts = opts.get_opts(args)
     return dmlc_opts
@@ -41,6 +44,10 @@ def main():
     parser.add_argument('--launcher', type=str, default='ssh',
                         choices = ['local', 'ssh', 'mpi', 'sge', 'yarn'],
                         help = 'the launcher to use')
+    parser.add_argument('--kv-stats-interval', type=float, default=0,
+                        help = 'if positive, the workers and the servers log \
+                        the counters of the communication of the kvstore to \
+                        the job log every KV_STATS_INTERVAL seconds')
     parser.add_argument('command', nargs='+',
                         help = 'command for launching the program')
     args, unknown = parser.parse_known_args()